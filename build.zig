@@ -8,13 +8,31 @@ pub fn build(b: *std.Build) void {
     const disp_horiz = b.option(u32, "horiz", "display horizontal pixels count; default: 800") orelse 800;
     const disp_vert = b.option(u32, "vert", "display vertical pixels count; default: 480") orelse 480;
     const lvgl_loglevel = b.option(LVGLLogLevel, "lvgl_loglevel", "LVGL lib logging level") orelse LVGLLogLevel.default(optimize);
+    const lvgl_img_cache = b.option(u16, "lvgl_img_cache", "LVGL image cache entries; default: 4") orelse 4;
+    const lvgl_grad_cache = b.option(u32, "lvgl_grad_cache", "LVGL gradient cache size in bytes; default: 4096") orelse 4096;
+    const lvgl_circle_cache = b.option(u16, "lvgl_circle_cache", "LVGL circle mask cache entries; default: 8") orelse 8;
+    const lvgl_style_cache = b.option(u16, "lvgl_style_cache", "LVGL resolved style properties cache entries; 0 disables; default: 512") orelse 512;
+    const lvgl_txt_cache = b.option(u16, "lvgl_txt_cache", "LVGL text layout cache entries; 0 disables; default: 128") orelse 128;
+    const lvgl_cache_stats = b.option(bool, "lvgl_cache_stats", "periodically log LVGL cache hit rates and memory usage; default: false") orelse false;
+    const lvgl_all_widgets = b.option(bool, "lvgl_all_widgets", "compile in LVGL widgets and themes unused by ngui; default: false") orelse false;
+    const trace = b.option(bool, "trace", "record startup tracing spans in nd and ngui, written with -trace; default: false") orelse false;
+    const allocprof = b.option(bool, "allocprof", "profile heap allocations per call site in nd and ngui, dumped on USR1; default: false") orelse false;
+    const lockprof = b.option(bool, "lockprof", "profile lock wait and hold times per call site in nd and ngui, dumped on USR1; default: false") orelse false;
     const inver = b.option([]const u8, "version", "semantic version of the build; must match git tag when available");
 
     const buildopts = b.addOptions();
     const buildopts_mod = buildopts.createModule();
-    buildopts.addOption(DriverTarget, "driver", drv);
-    const semver_step = VersionStep.create(b, buildopts, inver);
-    buildopts.step.dependOn(semver_step);
+    const benchopts = b.addOptions(); // of lvbench, the ngui rendering benchmark
+    for ([_]*std.Build.Step.Options{ buildopts, benchopts }) |o| {
+        o.addOption(DriverTarget, "driver", drv);
+        o.addOption(bool, "lvgl_cache_stats", lvgl_cache_stats);
+        o.addOption(bool, "trace", trace);
+        o.addOption(bool, "allocprof", allocprof);
+        o.addOption(bool, "lockprof", lockprof);
+        o.addOption(bool, "lvbench", o == benchopts);
+        const semver_step = VersionStep.create(b, o, inver);
+        o.step.dependOn(semver_step);
+    }
 
     // network interface (nif) standalone library used by the daemon and tests.
     const libnif_dep = b.lazyDependency("nif", .{ .target = target, .optimize = optimize }) orelse return;
@@ -22,90 +40,40 @@ pub fn build(b: *std.Build) void {
     // ini file format parser
     const libini_dep = b.lazyDependency("ini", .{ .target = target, .optimize = optimize }) orelse return;
 
-    const common_cflags = .{
-        "-Wall",
-        "-Wextra",
-        "-Wundef",
-        // strip source file paths for repro builds
-        b.fmt("-ffile-prefix-map={s}/=/", .{b.pathFromRoot("")}),
-    };
-
     // gui build
-    const ngui = b.addExecutable(.{
-        .name = "ngui",
-        .root_source_file = b.path("src/ngui.zig"),
+    const ngui_opt = NguiOpt{
         .target = target,
         .optimize = optimize,
-        .link_libc = true,
         .strip = strip,
-    });
-    ngui.pie = true;
-    ngui.root_module.addImport("build_options", buildopts_mod);
-    ngui.addIncludePath(b.path("lib"));
-    ngui.addIncludePath(b.path("src/ui/c"));
-
-    const lvgl_flags = .{
-        "-std=c11",
-        "-fstack-protector",
-        "-Wformat",
-        "-Wformat-security",
-    } ++ common_cflags;
-    ngui.addCSourceFiles(.{ .files = lvgl_generic_src, .flags = &lvgl_flags });
-
-    const ngui_cflags = .{
-        "-std=c11",
-        "-Wshadow",
-        "-Wunused-parameter",
-        "-Werror",
-    } ++ common_cflags;
-    ngui.addCSourceFiles(.{
-        .root = b.path("src/ui/c"),
-        .files = &.{
-            "ui.c",
-            "lv_font_courierprimecode_14.c",
-            "lv_font_courierprimecode_16.c",
-            "lv_font_courierprimecode_24.c",
-        },
-        .flags = &ngui_cflags,
-    });
-
-    ngui.root_module.addCMacro("NM_DISP_HOR", b.fmt("{d}", .{disp_horiz}));
-    ngui.root_module.addCMacro("NM_DISP_VER", b.fmt("{d}", .{disp_vert}));
-    ngui.defineCMacro("LV_CONF_INCLUDE_SIMPLE", "1");
-    ngui.defineCMacro("LV_LOG_LEVEL", lvgl_loglevel.text());
-    ngui.defineCMacro("LV_TICK_CUSTOM", "1");
-    ngui.defineCMacro("LV_TICK_CUSTOM_INCLUDE", "\"lv_custom_tick.h\"");
-    ngui.defineCMacro("LV_TICK_CUSTOM_SYS_TIME_EXPR", "(nm_get_curr_tick())");
-    switch (drv) {
-        .sdl2 => {
-            ngui.addCSourceFiles(.{ .files = lvgl_sdl2_src, .flags = &lvgl_flags });
-            ngui.addCSourceFile(.{ .file = b.path("src/ui/c/drv_sdl2.c"), .flags = &ngui_cflags });
-            ngui.defineCMacro("USE_SDL", "1");
-            ngui.linkSystemLibrary("SDL2");
-        },
-        .x11 => {
-            ngui.addCSourceFiles(.{ .files = lvgl_x11_src, .flags = &lvgl_flags });
-            ngui.addCSourceFiles(.{
-                .files = &.{
-                    "src/ui/c/drv_x11.c",
-                    "src/ui/c/mouse_cursor_icon.c",
-                },
-                .flags = &ngui_cflags,
-            });
-            ngui.defineCMacro("USE_X11", "1");
-            ngui.linkSystemLibrary("X11");
-        },
-        .fbev => {
-            ngui.addCSourceFiles(.{ .files = lvgl_fbev_src, .flags = &lvgl_flags });
-            ngui.addCSourceFile(.{ .file = b.path("src/ui/c/drv_fbev.c"), .flags = &ngui_cflags });
-            ngui.defineCMacro("USE_FBDEV", "1");
-            ngui.defineCMacro("USE_EVDEV", "1");
-        },
-    }
+        .buildopts = buildopts_mod,
+        .drv = drv,
+        .disp_horiz = disp_horiz,
+        .disp_vert = disp_vert,
+        .lvgl_loglevel = lvgl_loglevel,
+        .lvgl_img_cache = lvgl_img_cache,
+        .lvgl_grad_cache = lvgl_grad_cache,
+        .lvgl_circle_cache = lvgl_circle_cache,
+        .lvgl_style_cache = lvgl_style_cache,
+        .lvgl_txt_cache = lvgl_txt_cache,
+        .lvgl_cache_stats = lvgl_cache_stats,
+        .lvgl_all_widgets = lvgl_all_widgets,
+    };
+    const ngui = addNgui(b, "ngui", ngui_opt);
 
     const ngui_build_step = b.step("ngui", "build ngui (nakamochi gui)");
     ngui_build_step.dependOn(&b.addInstallArtifact(ngui, .{}).step);
 
+    // on-device rendering benchmark: ngui running the LVGL demo benchmark
+    // and ndg scenes instead of talking to nd; see ui/lvbench.zig.
+    {
+        var opt = ngui_opt;
+        opt.buildopts = benchopts.createModule();
+        opt.lvbench = true;
+        const lvbench = addNgui(b, "lvbench", opt);
+        const lvbench_step = b.step("lvbench", "build LVGL rendering benchmark; run on the device, results on stdout");
+        lvbench_step.dependOn(&b.addInstallArtifact(lvbench, .{}).step);
+    }
+
     // daemon build
     const nd = b.addExecutable(.{
         .name = "nd",
@@ -157,6 +125,81 @@ pub fn build(b: *std.Build) void {
         guiplay_build_step.dependOn(ngui_build_step);
     }
 
+    // ngui render benchmark
+    {
+        const benchui = b.addExecutable(.{
+            .name = "benchui",
+            .root_source_file = b.path("src/test/benchui.zig"),
+            .target = target,
+            .optimize = optimize,
+        });
+        benchui.root_module.addImport("comm", b.createModule(.{ .root_source_file = b.path("src/comm.zig") }));
+
+        const run = b.addRunArtifact(benchui);
+        run.addArgs(&.{ "-ngui", b.getInstallPath(.bin, "ngui") });
+        if (b.args) |args| {
+            run.addArgs(args);
+        }
+        run.step.dependOn(ngui_build_step);
+        const bench_step = b.step("bench-ui", "run ngui render benchmark; use with -Ddriver=headless");
+        bench_step.dependOn(&run.step);
+    }
+
+    // comm protocol benchmark
+    {
+        const benchcomm = b.addExecutable(.{
+            .name = "benchcomm",
+            .root_source_file = b.path("src/test/benchcomm.zig"),
+            .target = target,
+            .optimize = optimize,
+        });
+        benchcomm.root_module.addImport("comm", b.createModule(.{ .root_source_file = b.path("src/comm.zig") }));
+
+        const run = b.addRunArtifact(benchcomm);
+        if (b.args) |args| {
+            run.addArgs(args);
+        }
+        const bench_step = b.step("bench-comm", "run comm protocol encoding benchmark; use with -Doptimize=ReleaseFast");
+        bench_step.dependOn(&run.step);
+    }
+
+    // comm protocol fuzzer with valid and mutated frames
+    {
+        const fuzzcomm = b.addExecutable(.{
+            .name = "fuzzcomm",
+            .root_source_file = b.path("src/test/fuzzcomm.zig"),
+            .target = target,
+            .optimize = optimize,
+        });
+        fuzzcomm.root_module.addImport("comm", b.createModule(.{ .root_source_file = b.path("src/comm.zig") }));
+
+        const run = b.addRunArtifact(fuzzcomm);
+        if (b.args) |args| {
+            run.addArgs(args);
+        }
+        const fuzz_step = b.step("fuzz-comm", "run comm read against valid and mutated frames; use with -Doptimize=ReleaseSafe");
+        fuzz_step.dependOn(&run.step);
+    }
+
+    // bitcoind and lnd clients benchmark against mock servers and recorded responses
+    {
+        const benchrpc = b.addExecutable(.{
+            .name = "benchrpc",
+            .root_source_file = b.path("src/test/benchrpc.zig"),
+            .target = target,
+            .optimize = optimize,
+        });
+        benchrpc.root_module.addImport("bitcoindrpc", b.createModule(.{ .root_source_file = b.path("src/bitcoindrpc.zig") }));
+        benchrpc.root_module.addImport("lightning", b.createModule(.{ .root_source_file = b.path("src/lightning.zig") }));
+
+        const run = b.addRunArtifact(benchrpc);
+        if (b.args) |args| {
+            run.addArgs(args);
+        }
+        const bench_step = b.step("bench-rpc", "run bitcoind and lnd clients benchmark with mock servers and recorded responses");
+        bench_step.dependOn(&run.step);
+    }
+
     // bitcoind RPC client playground
     {
         const btcrpc = b.addExecutable(.{
@@ -187,6 +230,22 @@ pub fn build(b: *std.Build) void {
         lndhc_build_step.dependOn(&b.addInstallArtifact(lndhc, .{}).step);
     }
 
+    // regtest bitcoind and lnd nodes with many channels, for nd -devnet
+    {
+        const scaleenv = b.addExecutable(.{
+            .name = "scaleenv",
+            .root_source_file = b.path("src/test/scaleenv.zig"),
+            .target = target,
+            .optimize = optimize,
+        });
+        const run = b.addRunArtifact(scaleenv);
+        if (b.args) |args| {
+            run.addArgs(args);
+        }
+        const scaleenv_step = b.step("scale-env", "run a regtest bitcoind and lnd nodes with many channels and forwards; see -h");
+        scaleenv_step.dependOn(&run.step);
+    }
+
     // default build step
     const build_all_step = b.step("all", "build nd and ngui (default step)");
     build_all_step.dependOn(ngui_build_step);
@@ -194,10 +253,171 @@ pub fn build(b: *std.Build) void {
     b.default_step.dependOn(build_all_step);
 }
 
+/// ngui build configuration; see addNgui.
+const NguiOpt = struct {
+    target: std.Build.ResolvedTarget,
+    optimize: std.builtin.OptimizeMode,
+    strip: bool,
+    buildopts: *std.Build.Module,
+    drv: DriverTarget,
+    disp_horiz: u32,
+    disp_vert: u32,
+    lvgl_loglevel: LVGLLogLevel,
+    lvgl_img_cache: u16,
+    lvgl_grad_cache: u32,
+    lvgl_circle_cache: u16,
+    lvgl_style_cache: u16,
+    lvgl_txt_cache: u16,
+    lvgl_cache_stats: bool,
+    lvgl_all_widgets: bool,
+    /// compiles in the LVGL demo benchmark; see ui/lvbench.zig.
+    lvbench: bool = false,
+};
+
+/// creates an ngui executable with LVGL and the display and input drivers.
+fn addNgui(b: *std.Build, name: []const u8, o: NguiOpt) *std.Build.Step.Compile {
+    const common_cflags = .{
+        "-Wall",
+        "-Wextra",
+        "-Wundef",
+        // strip source file paths for repro builds
+        b.fmt("-ffile-prefix-map={s}/=/", .{b.pathFromRoot("")}),
+    };
+
+    const exe = b.addExecutable(.{
+        .name = name,
+        .root_source_file = b.path("src/ngui.zig"),
+        .target = o.target,
+        .optimize = o.optimize,
+        .link_libc = true,
+        .strip = o.strip,
+    });
+    exe.pie = true;
+    exe.root_module.addImport("build_options", o.buildopts);
+    exe.addIncludePath(b.path("lib"));
+    exe.addIncludePath(b.path("src/ui/c"));
+
+    const lvgl_flags = .{
+        "-std=c11",
+        "-fstack-protector",
+        "-Wformat",
+        "-Wformat-security",
+    } ++ common_cflags;
+    exe.addCSourceFiles(.{ .files = lvgl_generic_src, .flags = &lvgl_flags });
+
+    const ui_cflags = .{
+        "-std=c11",
+        "-Wshadow",
+        "-Wunused-parameter",
+        "-Werror",
+    } ++ common_cflags;
+    exe.addCSourceFiles(.{
+        .root = b.path("src/ui/c"),
+        .files = &.{
+            "ui.c",
+            "perf.c",
+            "spinner.c",
+            "lv_font_courierprimecode_14.c",
+            "lv_font_courierprimecode_16.c",
+            "lv_font_courierprimecode_24.c",
+        },
+        .flags = &ui_cflags,
+    });
+
+    exe.root_module.addCMacro("NM_DISP_HOR", b.fmt("{d}", .{o.disp_horiz}));
+    exe.root_module.addCMacro("NM_DISP_VER", b.fmt("{d}", .{o.disp_vert}));
+    exe.defineCMacro("LV_CONF_INCLUDE_SIMPLE", "1");
+    exe.defineCMacro("LV_LOG_LEVEL", o.lvgl_loglevel.text());
+    exe.defineCMacro("LV_IMG_CACHE_DEF_SIZE", b.fmt("{d}", .{o.lvgl_img_cache}));
+    exe.defineCMacro("LV_GRAD_CACHE_DEF_SIZE", b.fmt("{d}", .{o.lvgl_grad_cache}));
+    exe.defineCMacro("LV_CIRCLE_CACHE_SIZE", b.fmt("{d}", .{o.lvgl_circle_cache}));
+    exe.defineCMacro("LV_STYLE_CACHE_SIZE", b.fmt("{d}", .{o.lvgl_style_cache}));
+    exe.defineCMacro("LV_TXT_CACHE_SIZE", b.fmt("{d}", .{o.lvgl_txt_cache}));
+    exe.defineCMacro("LV_CACHE_STATS", if (o.lvgl_cache_stats) "1" else "0");
+    exe.defineCMacro("NM_LVGL_ALL_WIDGETS", if (o.lvgl_all_widgets or o.lvbench) "1" else "0");
+    exe.defineCMacro("LV_TICK_CUSTOM", "1");
+    exe.defineCMacro("LV_TICK_CUSTOM_INCLUDE", "\"lv_custom_tick.h\"");
+    exe.defineCMacro("LV_TICK_CUSTOM_SYS_TIME_EXPR", "(nm_get_curr_tick())");
+    switch (o.drv) {
+        .sdl2 => {
+            exe.addCSourceFiles(.{ .files = lvgl_sdl2_src, .flags = &lvgl_flags });
+            exe.addCSourceFile(.{ .file = b.path("src/ui/c/drv_sdl2.c"), .flags = &ui_cflags });
+            exe.defineCMacro("USE_SDL", "1");
+            exe.linkSystemLibrary("SDL2");
+        },
+        .sdl2gpu => {
+            exe.addCSourceFiles(.{ .files = lvgl_sdl2gpu_src, .flags = &lvgl_flags });
+            exe.addCSourceFile(.{ .file = b.path("src/ui/c/drv_sdl2.c"), .flags = &ui_cflags });
+            exe.defineCMacro("USE_SDL_GPU", "1");
+            exe.defineCMacro("LV_USE_GPU_SDL", "1");
+            exe.linkSystemLibrary("SDL2");
+        },
+        .x11 => {
+            exe.addCSourceFiles(.{ .files = lvgl_x11_src, .flags = &lvgl_flags });
+            exe.addCSourceFiles(.{
+                .files = &.{
+                    "src/ui/c/drv_x11.c",
+                    "src/ui/c/mouse_cursor_icon.c",
+                },
+                .flags = &ui_cflags,
+            });
+            exe.defineCMacro("USE_X11", "1");
+            exe.linkSystemLibrary("X11");
+            exe.linkSystemLibrary("Xext"); // MIT-SHM
+        },
+        .headless => {
+            exe.addCSourceFile(.{ .file = b.path("src/ui/c/drv_headless.c"), .flags = &ui_cflags });
+        },
+        .fbev, .drmev, .drmgl => {
+            exe.addCSourceFiles(.{ .files = lvgl_evdev_src, .flags = &lvgl_flags });
+            exe.addCSourceFile(.{ .file = b.path("src/ui/c/drv_evdev.c"), .flags = &ui_cflags });
+            exe.defineCMacro("USE_EVDEV", "1");
+            if (o.drv == .drmgl) {
+                exe.addCSourceFiles(.{
+                    .files = &.{
+                        "src/ui/c/drv_drmgl.c",
+                        "src/ui/c/draw_gles.c",
+                    },
+                    .flags = &ui_cflags,
+                });
+                exe.defineCMacro("USE_DRM_GL", "1");
+                exe.linkSystemLibrary("libdrm");
+                exe.linkSystemLibrary("gbm");
+                exe.linkSystemLibrary("EGL");
+                exe.linkSystemLibrary("GLESv2");
+            } else if (o.drv == .drmev) {
+                exe.addCSourceFiles(.{ .files = lvgl_drm_src, .flags = &lvgl_flags });
+                exe.addCSourceFile(.{ .file = b.path("src/ui/c/drv_drm.c"), .flags = &ui_cflags });
+                exe.defineCMacro("USE_DRM", "1");
+                exe.linkSystemLibrary("libdrm");
+            } else {
+                exe.addCSourceFiles(.{ .files = lvgl_fbdev_src, .flags = &lvgl_flags });
+                exe.addCSourceFile(.{ .file = b.path("src/ui/c/drv_fbev.c"), .flags = &ui_cflags });
+                exe.defineCMacro("USE_FBDEV", "1");
+            }
+            if (o.drv != .drmgl and o.target.result.cpu.arch == .aarch64) {
+                // SIMD blending for the release target; NEON is mandatory on aarch64.
+                exe.addCSourceFile(.{ .file = b.path("src/ui/c/draw_neon.c"), .flags = &ui_cflags });
+                exe.defineCMacro("NM_DRAW_NEON", "1");
+            }
+        },
+    }
+    exe.defineCMacro("NM_LVBENCH", if (o.lvbench) "1" else "0");
+    if (o.lvbench) {
+        exe.addCSourceFiles(.{ .files = lvgl_benchmark_src, .flags = &lvgl_flags });
+        exe.addCSourceFile(.{ .file = b.path("src/ui/c/lvbench.c"), .flags = &ui_cflags });
+    }
+    return exe;
+}
+
 const DriverTarget = enum {
     sdl2,
+    sdl2gpu, // sdl2 with LVGL drawing through SDL_Renderer; compare to sdl2 software rendering
     x11,
     fbev, // framebuffer + evdev
+    drmev, // DRM/KMS with vsync'ed page flips + evdev
+    drmgl, // drmev with LVGL drawing through OpenGL ES 2 on EGL/GBM
+    headless, // offscreen display and no input, for benchmarks
 };
 
 const lvgl_sdl2_src: []const []const u8 = &.{
@@ -205,15 +425,40 @@ const lvgl_sdl2_src: []const []const u8 = &.{
     "lib/lv_drivers/sdl/sdl_common.c",
 };
 
+const lvgl_sdl2gpu_src: []const []const u8 = &.{
+    "lib/lv_drivers/sdl/sdl_gpu.c",
+    "lib/lv_drivers/sdl/sdl_common.c",
+};
+
 const lvgl_x11_src: []const []const u8 = &.{
     "lib/lv_drivers/x11/x11.c",
 };
 
-const lvgl_fbev_src: []const []const u8 = &.{
+const lvgl_fbdev_src: []const []const u8 = &.{
     "lib/lv_drivers/display/fbdev.c",
+};
+
+const lvgl_drm_src: []const []const u8 = &.{
+    "lib/lv_drivers/display/drm.c",
+};
+
+const lvgl_evdev_src: []const []const u8 = &.{
     "lib/lv_drivers/indev/evdev.c",
 };
 
+const lvgl_benchmark_src: []const []const u8 = &.{
+    "lib/lvgl/demos/benchmark/lv_demo_benchmark.c",
+    "lib/lvgl/demos/benchmark/assets/img_benchmark_cogwheel_alpha16.c",
+    "lib/lvgl/demos/benchmark/assets/img_benchmark_cogwheel_argb.c",
+    "lib/lvgl/demos/benchmark/assets/img_benchmark_cogwheel_chroma_keyed.c",
+    "lib/lvgl/demos/benchmark/assets/img_benchmark_cogwheel_indexed16.c",
+    "lib/lvgl/demos/benchmark/assets/img_benchmark_cogwheel_rgb.c",
+    "lib/lvgl/demos/benchmark/assets/img_benchmark_cogwheel_rgb565a8.c",
+    "lib/lvgl/demos/benchmark/assets/lv_font_bechmark_montserrat_12_compr_az.c.c",
+    "lib/lvgl/demos/benchmark/assets/lv_font_bechmark_montserrat_16_compr_az.c.c",
+    "lib/lvgl/demos/benchmark/assets/lv_font_bechmark_montserrat_28_compr_az.c.c",
+};
+
 const lvgl_generic_src: []const []const u8 = &.{
     "lib/lvgl/src/core/lv_disp.c",
     "lib/lvgl/src/core/lv_event.c",
@@ -288,6 +533,7 @@ const lvgl_generic_src: []const []const u8 = &.{
     "lib/lvgl/src/extra/libs/rlottie/lv_rlottie.c",
     "lib/lvgl/src/extra/libs/sjpg/lv_sjpg.c",
     "lib/lvgl/src/extra/libs/sjpg/tjpgd.c",
+    "lib/lvgl/src/extra/libs/tiny_ttf/lv_tiny_ttf.c",
     "lib/lvgl/src/extra/lv_extra.c",
     "lib/lvgl/src/extra/others/fragment/lv_fragment.c",
     "lib/lvgl/src/extra/others/fragment/lv_fragment_manager.c",
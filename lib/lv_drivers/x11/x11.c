@@ -13,6 +13,11 @@
 #include <string.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#if X11_USE_SHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
 
 /*********************
  *      DEFINES
@@ -40,6 +45,11 @@ static Window      window = (XID)-1;
 static GC          gc = NULL;
 static XImage*     ximage = NULL;
 static lv_timer_t* timer = NULL;
+#if X11_USE_SHM
+static XShmSegmentInfo shminfo;
+static bool        shm_used = false;     /* ximage is in shared memory */
+static bool        shm_error = false;    /* set by shm_error_handler */
+#endif
 
 static char        kb_buffer[KEYBOARD_BUFFER_SIZE];
 static lv_point_t  mouse_pos = { 0, 0 };
@@ -57,6 +67,73 @@ static int16_t     wheel_cnt = 0;
  **********************/
 static int predicate(Display* disp, XEvent* evt, XPointer arg) { return 1; }
 
+/* copies an area of ximage to the same position in the window */
+static void put_image(int x, int y, unsigned int w, unsigned int h)
+{
+#if X11_USE_SHM
+    if (shm_used) {
+        XShmPutImage(display, window, gc, ximage, x, y, x, y, w, h, False);
+        /* the server reads the segment asynchronously: wait until it is done
+         * before lvgl renders into the image again */
+        XSync(display, False);
+        return;
+    }
+#endif
+    XPutImage(display, window, gc, ximage, x, y, x, y, w, h);
+}
+
+#if X11_USE_SHM
+static int shm_error_handler(Display* disp, XErrorEvent* evt)
+{
+    (void) disp;
+    (void) evt;
+    shm_error = true;
+    return 0;
+}
+
+/* creates ximage in a shared memory segment attached to by the server.
+ * returns false if the server can't do it, for example over the network. */
+static bool create_shm_image(Visual* visual, int depth, lv_coord_t width, lv_coord_t height)
+{
+    if (!XShmQueryExtension(display)) {
+        return false;
+    }
+    ximage = XShmCreateImage(display, visual, depth, ZPixmap, NULL, &shminfo, width, height);
+    if (ximage == NULL) {
+        return false;
+    }
+    shminfo.shmid = shmget(IPC_PRIVATE, ximage->bytes_per_line * ximage->height, IPC_CREAT | 0600);
+    if (shminfo.shmid < 0) {
+        XDestroyImage(ximage);
+        ximage = NULL;
+        return false;
+    }
+    shminfo.shmaddr = shmat(shminfo.shmid, NULL, 0);
+    shminfo.readOnly = False;
+    /* the server reports a failed attach asynchronously, as an X error */
+    shm_error = false;
+    Bool attached = False;
+    if (shminfo.shmaddr != (char*)-1) {
+        XErrorHandler prev = XSetErrorHandler(shm_error_handler);
+        attached = XShmAttach(display, &shminfo);
+        XSync(display, False);
+        XSetErrorHandler(prev);
+    }
+    /* released once both the server and this process detach */
+    shmctl(shminfo.shmid, IPC_RMID, NULL);
+    if (!attached || shm_error) {
+        if (shminfo.shmaddr != (char*)-1) {
+            shmdt(shminfo.shmaddr);
+        }
+        XDestroyImage(ximage);
+        ximage = NULL;
+        return false;
+    }
+    ximage->data = shminfo.shmaddr;
+    return true;
+}
+#endif
+
 static void x11_event_handler(lv_timer_t * t)
 {
     XEvent myevent;
@@ -70,7 +147,7 @@ static void x11_event_handler(lv_timer_t * t)
         case Expose:
             if(myevent.xexpose.count==0)
             {
-                XPutImage(display, window, gc, ximage, 0, 0, 0, 0, LV_HOR_RES, LV_VER_RES);
+                put_image(0, 0, LV_HOR_RES, LV_VER_RES);
             }
             break;
         case MotionNotify:
@@ -161,7 +238,7 @@ void lv_x11_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *co
 
     for (lv_coord_t y = area->y1; y <= area->y2; y++)
     {
-        uint32_t  dst_offs = area->x1 + y * LV_HOR_RES;
+        uint32_t  dst_offs = area->x1 + y * (ximage->bytes_per_line / sizeof(uint32_t));
         uint32_t* dst_data = &((uint32_t*)ximage->data)[dst_offs];
         for (lv_coord_t x = area->x1; x <= area->x2; x++, color_p++, dst_data++)
         {
@@ -175,7 +252,7 @@ void lv_x11_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *co
         /* refresh collected display update area only */
         lv_coord_t upd_w = upd_area.x2 - upd_area.x1 + 1;
         lv_coord_t upd_h = upd_area.y2 - upd_area.y1 + 1;
-        XPutImage(display, window, gc, ximage, upd_area.x1, upd_area.y1, upd_area.x1, upd_area.y1, upd_w, upd_h);
+        put_image(upd_area.x1, upd_area.y1, upd_w, upd_h);
         /* invalidate collected area */
         upd_area.x1 = 0xFFFF;
         upd_area.x2 = 0;
@@ -183,7 +260,7 @@ void lv_x11_flush(lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *co
         upd_area.y2 = 0;
 #else
         /* refresh full display */
-        XPutImage(display, window, gc, ximage, 0, 0, 0, 0, LV_HOR_RES, LV_VER_RES);
+        put_image(0, 0, LV_HOR_RES, LV_VER_RES);
 #endif
     }
     lv_disp_flush_ready(disp_drv);
@@ -254,8 +331,16 @@ void lv_x11_init(char const* title, lv_coord_t width, lv_coord_t height)
     /* create cache XImage */
     Visual* visual = XDefaultVisual(display, screen);
     int dplanes = DisplayPlanes(display, screen);
-    ximage = XCreateImage(display, visual, dplanes, ZPixmap, 0,
-                          malloc(width * height * sizeof(uint32_t)), width, height, 32, 0);
+#if X11_USE_SHM
+    shm_used = create_shm_image(visual, dplanes, width, height);
+    if (!shm_used) {
+        LV_LOG_WARN("MIT-SHM unavailable; falling back to XPutImage");
+    }
+#endif
+    if (ximage == NULL) {
+        ximage = XCreateImage(display, visual, dplanes, ZPixmap, 0,
+                              malloc(width * height * sizeof(uint32_t)), width, height, 32, 0);
+    }
 
     timer = lv_timer_create(x11_event_handler, 10, NULL);
 
@@ -267,6 +352,14 @@ void lv_x11_deinit(void)
 {
     lv_timer_del(timer);
 
+#if X11_USE_SHM
+    if (shm_used) {
+        XShmDetach(display, &shminfo);
+        shmdt(shminfo.shmaddr);
+        ximage->data = NULL;
+        shm_used = false;
+    }
+#endif
     free(ximage->data);
 
     XDestroyImage(ximage);
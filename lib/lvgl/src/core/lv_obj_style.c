@@ -15,6 +15,10 @@
  *********************/
 #define MY_CLASS &lv_obj_class
 
+#ifndef LV_STYLE_CACHE_SIZE
+    #define LV_STYLE_CACHE_SIZE 0
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -27,6 +31,22 @@ typedef struct {
     lv_style_value_t end_value;
 } trans_t;
 
+#if LV_STYLE_CACHE_SIZE
+/*A resolved property of a single object, before inheritance from the parents.
+ *The object state is part of the key because widgets temporarily switch
+ *`obj->state` to draw their parts or items.*/
+typedef struct {
+    const lv_obj_t * obj;
+    uint32_t gen;   /*`_lv_style_gen` at the time of the lookup; 0 means unused*/
+    lv_style_value_t value;
+    lv_part_t part;
+    lv_style_prop_t prop;
+    lv_state_t state;
+    uint8_t skip_trans : 1;
+    uint8_t res : 2;
+} style_cache_entry_t;
+#endif
+
 typedef enum {
     CACHE_ZERO = 0,
     CACHE_TRUE = 1,
@@ -45,6 +65,8 @@ typedef enum {
 static lv_style_t * get_local_style(lv_obj_t * obj, lv_style_selector_t selector);
 static _lv_obj_style_t * get_trans_style(lv_obj_t * obj, uint32_t part);
 static lv_style_res_t get_prop_core(const lv_obj_t * obj, lv_part_t part, lv_style_prop_t prop, lv_style_value_t * v);
+static lv_style_res_t get_prop_cached(const lv_obj_t * obj, lv_part_t part, lv_style_prop_t prop,
+                                      lv_style_value_t * v);
 static void report_style_change_core(void * style, lv_obj_t * obj);
 static void refresh_children_style(lv_obj_t * obj);
 static bool trans_del(lv_obj_t * obj, lv_part_t part, lv_style_prop_t prop, trans_t * tr_limit);
@@ -59,6 +81,9 @@ static void fade_in_anim_ready(lv_anim_t * a);
  *  STATIC VARIABLES
  **********************/
 static bool style_refr = true;
+#if LV_STYLE_CACHE_SIZE
+static style_cache_entry_t style_cache[LV_STYLE_CACHE_SIZE];
+#endif
 
 /**********************
  *      MACROS
@@ -99,6 +124,7 @@ void lv_obj_add_style(lv_obj_t * obj, lv_style_t * style, lv_style_selector_t se
     lv_memset_00(&obj->styles[i], sizeof(_lv_obj_style_t));
     obj->styles[i].style = style;
     obj->styles[i].selector = selector;
+    _lv_style_gen++;
 
     lv_obj_refresh_style(obj, selector, LV_STYLE_PROP_ANY);
 }
@@ -133,6 +159,7 @@ void lv_obj_remove_style(lv_obj_t * obj, lv_style_t * style, lv_style_selector_t
         }
 
         /*Shift the styles after `i` by one*/
+        _lv_style_gen++;
         uint32_t j;
         for(j = i; j < (uint32_t)obj->style_cnt - 1 ; j++) {
             obj->styles[j] = obj->styles[j + 1];
@@ -152,6 +179,7 @@ void lv_obj_remove_style(lv_obj_t * obj, lv_style_t * style, lv_style_selector_t
 
 void lv_obj_report_style_change(lv_style_t * style)
 {
+    _lv_style_gen++; /*The style might have been modified directly*/
     if(!style_refr) return;
     lv_disp_t * d = lv_disp_get_next(NULL);
 
@@ -168,6 +196,7 @@ void lv_obj_refresh_style(lv_obj_t * obj, lv_style_selector_t selector, lv_style
 {
     LV_ASSERT_OBJ(obj, MY_CLASS);
 
+    _lv_style_gen++;
     if(!style_refr) return;
 
     lv_obj_invalidate(obj);
@@ -226,7 +255,7 @@ lv_style_value_t lv_obj_get_style_prop(const lv_obj_t * obj, lv_part_t part, lv_
     bool inheritable = lv_style_prop_has_flag(prop, LV_STYLE_PROP_INHERIT);
     lv_style_res_t found = LV_STYLE_RES_NOT_FOUND;
     while(obj) {
-        found = get_prop_core(obj, part, prop, &value_act);
+        found = get_prop_cached(obj, part, prop, &value_act);
         if(found == LV_STYLE_RES_FOUND) break;
         if(!inheritable) break;
 
@@ -567,6 +596,7 @@ static lv_style_t * get_local_style(lv_obj_t * obj, lv_style_selector_t selector
     lv_style_init(obj->styles[i].style);
     obj->styles[i].is_local = 1;
     obj->styles[i].selector = selector;
+    _lv_style_gen++;
     return obj->styles[i].style;
 }
 
@@ -599,6 +629,7 @@ static _lv_obj_style_t * get_trans_style(lv_obj_t * obj,  lv_style_selector_t se
     lv_style_init(obj->styles[0].style);
     obj->styles[0].is_trans = 1;
     obj->styles[0].selector = selector;
+    _lv_style_gen++;
     return &obj->styles[0];
 }
 
@@ -670,6 +701,47 @@ static lv_style_res_t get_prop_core(const lv_obj_t * obj, lv_part_t part, lv_sty
     else return LV_STYLE_RES_NOT_FOUND;
 }
 
+/**
+ * Same as `get_prop_core` but remembers the results in a direct mapped cache.
+ * Drawing looks up dozens of properties per object and part, each scanning all
+ * the styles of the object. Any change of a style or of the styles attached to
+ * an object increments `_lv_style_gen`, which invalidates all entries at once.
+ */
+static lv_style_res_t get_prop_cached(const lv_obj_t * obj, lv_part_t part, lv_style_prop_t prop,
+                                      lv_style_value_t * v)
+{
+#if LV_STYLE_CACHE_SIZE
+    uint32_t h = (uint32_t)((uintptr_t)obj >> 3) * 2654435761u;
+    h ^= (uint32_t)prop * 40503u ^ part ^ ((uint32_t)obj->state << 8);
+    style_cache_entry_t * e = &style_cache[(h ^ (h >> 16)) % LV_STYLE_CACHE_SIZE];
+    if(e->gen == _lv_style_gen && e->obj == obj && e->prop == prop && e->part == part &&
+       e->state == obj->state && e->skip_trans == obj->skip_trans) {
+        LV_CACHE_STAT(style_hit);
+        if(e->res == LV_STYLE_RES_FOUND) *v = e->value;
+        return e->res;
+    }
+    LV_CACHE_STAT(style_miss);
+
+    /*Skip 0 on wrap around since it marks unused entries*/
+    if(_lv_style_gen == 0) {
+        lv_memset_00(style_cache, sizeof(style_cache));
+        _lv_style_gen = 1;
+    }
+    lv_style_res_t res = get_prop_core(obj, part, prop, v);
+    e->obj = obj;
+    e->gen = _lv_style_gen;
+    e->part = part;
+    e->prop = prop;
+    e->state = obj->state;
+    e->skip_trans = obj->skip_trans;
+    e->res = res;
+    if(res == LV_STYLE_RES_FOUND) e->value = *v;
+    return res;
+#else
+    return get_prop_core(obj, part, prop, v);
+#endif
+}
+
 /**
  * Refresh the style of all children of an object. (Called recursively)
  * @param style refresh objects only with this
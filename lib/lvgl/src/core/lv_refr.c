@@ -52,6 +52,9 @@ typedef struct {
  *  STATIC PROTOTYPES
  **********************/
 static void lv_refr_join_area(void);
+static void inv_area_add(lv_disp_t * disp, const lv_area_t * area_p);
+static int32_t inv_join_cost(const lv_area_t * a, const lv_area_t * b);
+static void inv_absorb_contained(lv_disp_t * disp, uint16_t idx);
 static void refr_invalid_areas(void);
 static void refr_sync_areas(void);
 static void refr_area(const lv_area_t * area_p);
@@ -242,21 +245,7 @@ void _lv_inv_area(lv_disp_t * disp, const lv_area_t * area_p)
 
     if(disp->driver->rounder_cb) disp->driver->rounder_cb(disp->driver, &com_area);
 
-    /*Save only if this area is not in one of the saved areas*/
-    uint16_t i;
-    for(i = 0; i < disp->inv_p; i++) {
-        if(_lv_area_is_in(&com_area, &disp->inv_areas[i], 0) != false) return;
-    }
-
-    /*Save the area*/
-    if(disp->inv_p < LV_INV_BUF_SIZE) {
-        lv_area_copy(&disp->inv_areas[disp->inv_p], &com_area);
-    }
-    else {   /*If no place for the area add the screen*/
-        disp->inv_p = 0;
-        lv_area_copy(&disp->inv_areas[disp->inv_p], &scr_area);
-    }
-    disp->inv_p++;
+    inv_area_add(disp, &com_area);
     if(disp->refr_timer) lv_timer_resume(disp->refr_timer);
 }
 
@@ -509,6 +498,94 @@ static void lv_refr_join_area(void)
     }
 }
 
+/**
+ * Save an on-screen area in the invalidated areas of a display.
+ * Areas covered by the new one are dropped. If the buffer is full, the two
+ * areas, the new one included, whose bounding box adds the fewest extra pixels
+ * are merged, instead of falling back to redrawing the whole screen.
+ */
+static void inv_area_add(lv_disp_t * disp, const lv_area_t * area_p)
+{
+    /*Save only if this area is not in one of the saved areas*/
+    uint16_t i;
+    for(i = 0; i < disp->inv_p; i++) {
+        if(_lv_area_is_in(area_p, &disp->inv_areas[i], 0) != false) return;
+    }
+
+    if(disp->inv_p < LV_INV_BUF_SIZE) {
+        lv_area_copy(&disp->inv_areas[disp->inv_p], area_p);
+        disp->inv_p++;
+        inv_absorb_contained(disp, disp->inv_p - 1);
+        return;
+    }
+
+    /*Find the cheapest pair; j == LV_INV_BUF_SIZE stands for the new area*/
+    uint16_t best_i = 0;
+    uint16_t best_j = LV_INV_BUF_SIZE;
+    int32_t best_cost = INT32_MAX;
+    uint16_t j;
+    for(i = 0; i < LV_INV_BUF_SIZE; i++) {
+        int32_t cost = inv_join_cost(&disp->inv_areas[i], area_p);
+        if(cost < best_cost) {
+            best_cost = cost;
+            best_i = i;
+            best_j = LV_INV_BUF_SIZE;
+        }
+        for(j = i + 1; j < LV_INV_BUF_SIZE; j++) {
+            cost = inv_join_cost(&disp->inv_areas[i], &disp->inv_areas[j]);
+            if(cost < best_cost) {
+                best_cost = cost;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+
+    if(best_j == LV_INV_BUF_SIZE) {
+        _lv_area_join(&disp->inv_areas[best_i], &disp->inv_areas[best_i], area_p);
+        inv_absorb_contained(disp, best_i);
+        return;
+    }
+
+    /*Merge the pair into best_i, free best_j, then save the new area into the free slot*/
+    _lv_area_join(&disp->inv_areas[best_i], &disp->inv_areas[best_i], &disp->inv_areas[best_j]);
+    disp->inv_p--;
+    disp->inv_areas[best_j] = disp->inv_areas[disp->inv_p];
+    if(best_i == disp->inv_p) best_i = best_j;
+    inv_absorb_contained(disp, best_i);
+    inv_area_add(disp, area_p);
+}
+
+/**
+ * The number of pixels the bounding box of two areas adds to redrawing them
+ * separately. Negative for overlapping areas.
+ */
+static int32_t inv_join_cost(const lv_area_t * a, const lv_area_t * b)
+{
+    lv_area_t joined;
+    _lv_area_join(&joined, a, b);
+    return (int32_t)lv_area_get_size(&joined) - (int32_t)lv_area_get_size(a) - (int32_t)lv_area_get_size(b);
+}
+
+/**
+ * Remove the invalidated areas fully covered by the area at idx.
+ * The last area is moved into the freed slots, so the order is not preserved.
+ */
+static void inv_absorb_contained(lv_disp_t * disp, uint16_t idx)
+{
+    lv_area_t area = disp->inv_areas[idx];
+    uint16_t i = 0;
+    while(i < disp->inv_p) {
+        if(i != idx && _lv_area_is_in(&disp->inv_areas[i], &area, 0)) {
+            disp->inv_p--;
+            disp->inv_areas[i] = disp->inv_areas[disp->inv_p];
+            if(idx == disp->inv_p) idx = i;
+            continue;
+        }
+        i++;
+    }
+}
+
 /**
  * Refresh the sync areas
  */
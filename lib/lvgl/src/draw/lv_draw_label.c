@@ -35,6 +35,8 @@ typedef uint8_t cmd_state_t;
  **********************/
 
 static uint8_t hex_char_to_num(char hex);
+static inline uint32_t layout_line_end(const _lv_txt_layout_t * layout, uint32_t line_idx, uint32_t line_start);
+static inline lv_coord_t layout_line_width(const _lv_txt_layout_t * layout, uint32_t line_idx);
 
 /**********************
  *  STATIC VARIABLES
@@ -151,13 +153,22 @@ void LV_ATTRIBUTE_FAST_MEM lv_draw_label(lv_draw_ctx_t * draw_ctx, const lv_draw
         pos.y += hint->y;
     }
 
-    uint32_t line_end = line_start + _lv_txt_get_next_line(&txt[line_start], font, dsc->letter_space, w, NULL, dsc->flag);
+    /*The cached layout indexes lines from the start of the text, not from the hint*/
+    _lv_txt_layout_t layout;
+    bool cached = last_line_start < 0 &&
+                  _lv_txt_get_layout(&layout, txt, font, dsc->letter_space, w, dsc->flag);
+    uint32_t line_idx = 0;
+
+    uint32_t line_end = cached ? layout_line_end(&layout, line_idx, line_start) :
+                        line_start + _lv_txt_get_next_line(&txt[line_start], font, dsc->letter_space, w, NULL, dsc->flag);
 
     /*Go the first visible line*/
     while(pos.y + line_height_font < draw_ctx->clip_area->y1) {
         /*Go to next line*/
         line_start = line_end;
-        line_end += _lv_txt_get_next_line(&txt[line_start], font, dsc->letter_space, w, NULL, dsc->flag);
+        line_idx++;
+        line_end = cached ? layout_line_end(&layout, line_idx, line_start) :
+                   line_start + _lv_txt_get_next_line(&txt[line_start], font, dsc->letter_space, w, NULL, dsc->flag);
         pos.y += line_height;
 
         /*Save at the threshold coordinate*/
@@ -172,14 +183,16 @@ void LV_ATTRIBUTE_FAST_MEM lv_draw_label(lv_draw_ctx_t * draw_ctx, const lv_draw
 
     /*Align to middle*/
     if(align == LV_TEXT_ALIGN_CENTER) {
-        line_width = lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
+        line_width = cached ? layout_line_width(&layout, line_idx) :
+                     lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
 
         pos.x += (lv_area_get_width(coords) - line_width) / 2;
 
     }
     /*Align to the right*/
     else if(align == LV_TEXT_ALIGN_RIGHT) {
-        line_width = lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
+        line_width = cached ? layout_line_width(&layout, line_idx) :
+                     lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
         pos.x += lv_area_get_width(coords) - line_width;
     }
     uint32_t sel_start = dsc->sel_start;
@@ -334,21 +347,23 @@ void LV_ATTRIBUTE_FAST_MEM lv_draw_label(lv_draw_ctx_t * draw_ctx, const lv_draw
 #endif
         /*Go to next line*/
         line_start = line_end;
-        line_end += _lv_txt_get_next_line(&txt[line_start], font, dsc->letter_space, w, NULL, dsc->flag);
+        line_idx++;
+        line_end = cached ? layout_line_end(&layout, line_idx, line_start) :
+                   line_start + _lv_txt_get_next_line(&txt[line_start], font, dsc->letter_space, w, NULL, dsc->flag);
 
         pos.x = coords->x1;
         /*Align to middle*/
         if(align == LV_TEXT_ALIGN_CENTER) {
-            line_width =
-                lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
+            line_width = cached ? layout_line_width(&layout, line_idx) :
+                         lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
 
             pos.x += (lv_area_get_width(coords) - line_width) / 2;
 
         }
         /*Align to the right*/
         else if(align == LV_TEXT_ALIGN_RIGHT) {
-            line_width =
-                lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
+            line_width = cached ? layout_line_width(&layout, line_idx) :
+                         lv_txt_get_width(&txt[line_start], line_end - line_start, font, dsc->letter_space, dsc->flag);
             pos.x += lv_area_get_width(coords) - line_width;
         }
 
@@ -377,6 +392,23 @@ void lv_draw_letter(lv_draw_ctx_t * draw_ctx, const lv_draw_label_dsc_t * dsc,
  * @param hex Pointer to a hexadecimal character (0..9, A..F)
  * @return the numerical value of `hex` or 0 on error
  */
+/**
+ * Same as `line_start + _lv_txt_get_next_line()` from a cached layout.
+ * Past the last line the text is at its '\0', so the line is empty.
+ */
+static inline uint32_t layout_line_end(const _lv_txt_layout_t * layout, uint32_t line_idx, uint32_t line_start)
+{
+    return line_idx < layout->line_cnt ? layout->ends[line_idx] : line_start;
+}
+
+/**
+ * Same as `lv_txt_get_width()` of a line from a cached layout.
+ */
+static inline lv_coord_t layout_line_width(const _lv_txt_layout_t * layout, uint32_t line_idx)
+{
+    return line_idx < layout->line_cnt ? layout->widths[line_idx] : 0;
+}
+
 static uint8_t hex_char_to_num(char hex)
 {
     uint8_t result = 0;
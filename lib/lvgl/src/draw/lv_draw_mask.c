@@ -499,9 +499,11 @@ void lv_draw_mask_radius_init(lv_draw_mask_radius_param_t * param, const lv_area
             LV_GC_ROOT(_lv_circle_cache[i]).used_cnt++;
             CIRCLE_CACHE_AGING(LV_GC_ROOT(_lv_circle_cache[i]).life, radius);
             param->circle = &LV_GC_ROOT(_lv_circle_cache[i]);
+            LV_CACHE_STAT(circle_hit);
             return;
         }
     }
+    LV_CACHE_STAT(circle_miss);
 
     /*If not found find a free entry with lowest life*/
     _lv_draw_mask_radius_circle_dsc_t * entry = NULL;
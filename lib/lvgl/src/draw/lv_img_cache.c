@@ -97,7 +97,10 @@ _lv_img_cache_entry_t * _lv_img_cache_open(const void * src, lv_color_t color, i
     }
 
     /*The image is not cached then cache it now*/
-    if(cached_src) return cached_src;
+    if(cached_src) {
+        LV_CACHE_STAT(img_hit);
+        return cached_src;
+    }
 
     /*Find an entry to reuse. Select the entry with the least life*/
     cached_src = &cache[0];
@@ -118,6 +121,7 @@ _lv_img_cache_entry_t * _lv_img_cache_open(const void * src, lv_color_t color, i
 #else
     cached_src = &LV_GC_ROOT(_lv_img_cache_single);
 #endif
+    LV_CACHE_STAT(img_miss);
     /*Open the image and measure the time to open*/
     uint32_t t_start  = lv_tick_get();
     lv_res_t open_res = lv_img_decoder_open(&cached_src->dec_dsc, src, color, frame_id);
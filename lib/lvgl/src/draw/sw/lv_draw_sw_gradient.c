@@ -266,8 +266,10 @@ lv_grad_t * lv_gradient_get(const lv_grad_dsc_t * g, lv_coord_t w, lv_coord_t h)
     lv_grad_t * item = NULL;
     if(iterate_cache(&find_item, &key, &item) == LV_RES_OK) {
         item->life++; /* Don't forget to bump the counter */
+        LV_CACHE_STAT(grad_hit);
         return item;
     }
+    LV_CACHE_STAT(grad_miss);
 
     /* Step 2: Need to allocate an item for it */
     item = allocate_item(g, w, h);
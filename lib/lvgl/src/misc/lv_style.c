@@ -138,6 +138,8 @@ uint32_t _lv_style_custom_prop_flag_lookup_table_size = 0;
  **********************/
 
 static uint16_t last_custom_prop_id = (uint16_t)_LV_STYLE_LAST_BUILT_IN_PROP;
+
+uint32_t _lv_style_gen = 1;
 static const lv_style_value_t null_style_value = { .num = 0 };
 
 /**********************
@@ -173,6 +175,7 @@ void lv_style_reset(lv_style_t * style)
 
     if(style->prop_cnt > 1) lv_mem_free(style->v_p.values_and_props);
     lv_memset_00(style, sizeof(lv_style_t));
+    _lv_style_gen++;
 #if LV_USE_ASSERT_STYLE
     style->sentinel = LV_STYLE_SENTINEL_VALUE;
 #endif
@@ -230,6 +233,7 @@ bool lv_style_remove_prop(lv_style_t * style, lv_style_prop_t prop)
 
     if(style->prop_cnt == 0)  return false;
 
+    _lv_style_gen++;
     if(style->prop_cnt == 1) {
         if(LV_STYLE_PROP_ID_MASK(style->prop1) == prop) {
             style->prop1 = LV_STYLE_PROP_INV;
@@ -423,6 +427,7 @@ static void lv_style_set_prop_internal(lv_style_t * style, lv_style_prop_t prop_
     }
 
     lv_style_prop_t prop_id = LV_STYLE_PROP_ID_MASK(prop_and_meta);
+    _lv_style_gen++;
 
     if(style->prop_cnt > 1) {
         uint8_t * tmp = style->v_p.values_and_props + style->prop_cnt * sizeof(lv_style_value_t);
@@ -511,6 +511,13 @@ bool lv_style_is_empty(const lv_style_t * style);
  */
 uint8_t _lv_style_get_prop_group(lv_style_prop_t prop);
 
+/**
+ * Incremented on every change of any style's properties, and by lv_obj_style
+ * when the styles attached to an object change. Resolved style caches
+ * compare against it to detect stale entries.
+ */
+extern uint32_t _lv_style_gen;
+
 /**
  * Get the flags of a built-in or custom property.
  *
@@ -27,6 +27,10 @@
  **********************/
 static bool lv_timer_exec(lv_timer_t * timer);
 static uint32_t lv_timer_time_remaining(lv_timer_t * timer);
+static bool heap_reserve(uint32_t n);
+static void heap_push(lv_timer_t * timer);
+static void heap_remove(lv_timer_t * timer);
+static void heap_update(lv_timer_t * timer);
 
 /**********************
  *  STATIC VARIABLES
@@ -34,7 +38,19 @@ static uint32_t lv_timer_time_remaining(lv_timer_t * timer);
 static bool lv_timer_run = false;
 static uint8_t idle_last = 0;
 static bool timer_deleted;
-static bool timer_created;
+
+/*Min-heap of the non-paused timers ordered by deadline, i.e. `last_run + period`.
+ *The list in `_lv_timer_ll` still owns all timers; the heap makes a handler pass
+ *cost O(ready timers * log n) and the next deadline lookup O(1).*/
+static lv_timer_t ** heap;
+static uint32_t heap_len;
+static uint32_t heap_cap;
+static uint32_t timer_cnt;
+/*Timers which ran in the current handler pass and became ready again, for example
+ *by calling `lv_timer_ready` on themselves. Pushed back into the heap after the pass
+ *so that they don't starve others. Same capacity as the heap.*/
+static lv_timer_t ** deferred;
+static uint32_t deferred_len;
 
 /**********************
  *      MACROS
@@ -55,6 +71,12 @@ static bool timer_created;
 void _lv_timer_core_init(void)
 {
     _lv_ll_init(&LV_GC_ROOT(_lv_timer_ll), sizeof(lv_timer_t));
+    heap = NULL;
+    heap_len = 0;
+    heap_cap = 0;
+    timer_cnt = 0;
+    deferred = NULL;
+    deferred_len = 0;
 
     /*Initially enable the lv_timer handling*/
     lv_timer_enable(true);
@@ -95,40 +117,26 @@ uint32_t LV_ATTRIBUTE_TIMER_HANDLER lv_timer_handler(void)
         }
     }
 
-    /*Run all timer from the list*/
-    lv_timer_t * next;
-    do {
-        timer_deleted             = false;
-        timer_created             = false;
-        LV_GC_ROOT(_lv_timer_act) = _lv_ll_get_head(&LV_GC_ROOT(_lv_timer_ll));
-        while(LV_GC_ROOT(_lv_timer_act)) {
-            /*The timer might be deleted if it runs only once ('repeat_count = 1')
-             *So get next element until the current is surely valid*/
-            next = _lv_ll_get_next(&LV_GC_ROOT(_lv_timer_ll), LV_GC_ROOT(_lv_timer_act));
-
-            if(lv_timer_exec(LV_GC_ROOT(_lv_timer_act))) {
-                /*If a timer was created or deleted then this or the next item might be corrupted*/
-                if(timer_created || timer_deleted) {
-                    TIMER_TRACE("Start from the first timer again because a timer was created or deleted");
-                    break;
-                }
-            }
-
-            LV_GC_ROOT(_lv_timer_act) = next; /*Load the next timer*/
+    /*Run the ready timers, earliest deadline first. A timer runs at most once
+     *per pass, even if its callback makes it ready again.*/
+    while(heap_len > 0 && lv_timer_time_remaining(heap[0]) == 0) {
+        lv_timer_t * timer = heap[0];
+        lv_timer_exec(timer);
+        bool in_heap = !timer_deleted && !timer->paused && !(timer->heap_idx & LV_TIMER_DEFERRED_FLAG);
+        if(in_heap && lv_timer_time_remaining(timer) == 0) {
+            heap_remove(timer);
+            timer->heap_idx = LV_TIMER_DEFERRED_FLAG | deferred_len;
+            deferred[deferred_len++] = timer;
         }
-    } while(LV_GC_ROOT(_lv_timer_act));
+    }
+    while(deferred_len > 0) {
+        lv_timer_t * timer = deferred[--deferred_len];
+        timer->heap_idx = LV_TIMER_NO_HEAP_IDX;
+        heap_push(timer);
+    }
 
     uint32_t time_till_next = LV_NO_TIMER_READY;
-    next = _lv_ll_get_head(&LV_GC_ROOT(_lv_timer_ll));
-    while(next) {
-        if(!next->paused) {
-            uint32_t delay = lv_timer_time_remaining(next);
-            if(delay < time_till_next)
-                time_till_next = delay;
-        }
-
-        next = _lv_ll_get_next(&LV_GC_ROOT(_lv_timer_ll), next); /*Find the next timer*/
-    }
+    if(heap_len > 0) time_till_next = lv_timer_time_remaining(heap[0]);
 
     busy_time += lv_tick_elaps(handler_start);
     uint32_t idle_period_time = lv_tick_elaps(idle_period_start);
@@ -168,6 +176,9 @@ lv_timer_t * lv_timer_create(lv_timer_cb_t timer_xcb, uint32_t period, void * us
 {
     lv_timer_t * new_timer = NULL;
 
+    /*Reserve heap space for all timers upfront so that resuming never allocates*/
+    if(!heap_reserve(timer_cnt + 1)) return NULL;
+
     new_timer = _lv_ll_ins_head(&LV_GC_ROOT(_lv_timer_ll));
     LV_ASSERT_MALLOC(new_timer);
     if(new_timer == NULL) return NULL;
@@ -178,8 +189,10 @@ lv_timer_t * lv_timer_create(lv_timer_cb_t timer_xcb, uint32_t period, void * us
     new_timer->paused = 0;
     new_timer->last_run = lv_tick_get();
     new_timer->user_data = user_data;
+    new_timer->heap_idx = LV_TIMER_NO_HEAP_IDX;
 
-    timer_created = true;
+    timer_cnt++;
+    heap_push(new_timer);
 
     return new_timer;
 }
@@ -200,8 +213,10 @@ void lv_timer_set_cb(lv_timer_t * timer, lv_timer_cb_t timer_cb)
  */
 void lv_timer_del(lv_timer_t * timer)
 {
+    heap_remove(timer);
     _lv_ll_remove(&LV_GC_ROOT(_lv_timer_ll), timer);
-    timer_deleted = true;
+    timer_cnt--;
+    if(timer == LV_GC_ROOT(_lv_timer_act)) timer_deleted = true;
 
     lv_mem_free(timer);
 }
@@ -213,11 +228,13 @@ void lv_timer_del(lv_timer_t * timer)
 void lv_timer_pause(lv_timer_t * timer)
 {
     timer->paused = true;
+    heap_remove(timer);
 }
 
 void lv_timer_resume(lv_timer_t * timer)
 {
     timer->paused = false;
+    if(timer->heap_idx == LV_TIMER_NO_HEAP_IDX) heap_push(timer);
 }
 
 /**
@@ -228,6 +245,7 @@ void lv_timer_resume(lv_timer_t * timer)
 void lv_timer_set_period(lv_timer_t * timer, uint32_t period)
 {
     timer->period = period;
+    heap_update(timer);
 }
 
 /**
@@ -237,6 +255,7 @@ void lv_timer_set_period(lv_timer_t * timer, uint32_t period)
 void lv_timer_ready(lv_timer_t * timer)
 {
     timer->last_run = lv_tick_get() - timer->period - 1;
+    heap_update(timer);
 }
 
 /**
@@ -257,6 +276,7 @@ void lv_timer_set_repeat_count(lv_timer_t * timer, int32_t repeat_count)
 void lv_timer_reset(lv_timer_t * timer)
 {
     timer->last_run = lv_tick_get();
+    heap_update(timer);
 }
 
 /**
@@ -301,6 +321,8 @@ static bool lv_timer_exec(lv_timer_t * timer)
 {
     if(timer->paused) return false;
 
+    timer_deleted = false;
+    LV_GC_ROOT(_lv_timer_act) = timer;
     bool exec = false;
     if(lv_timer_time_remaining(timer) == 0) {
         /* Decrement the repeat count before executing the timer_cb.
@@ -309,6 +331,7 @@ static bool lv_timer_exec(lv_timer_t * timer)
         int32_t original_repeat_count = timer->repeat_count;
         if(timer->repeat_count > 0) timer->repeat_count--;
         timer->last_run = lv_tick_get();
+        heap_update(timer);
         TIMER_TRACE("calling timer callback: %p", *((void **)&timer->timer_cb));
         if(timer->timer_cb && original_repeat_count != 0) timer->timer_cb(timer);
         TIMER_TRACE("timer callback %p finished", *((void **)&timer->timer_cb));
@@ -322,6 +345,7 @@ static bool lv_timer_exec(lv_timer_t * timer)
             lv_timer_del(timer);
         }
     }
+    LV_GC_ROOT(_lv_timer_act) = NULL;
 
     return exec;
 }
@@ -339,3 +363,111 @@ static uint32_t lv_timer_time_remaining(lv_timer_t * timer)
         return 0;
     return timer->period - elp;
 }
+
+/**
+ * Compare the deadlines of two timers.
+ * Tick wrap around is fine as long as the deadlines are less than 2^31 ms apart.
+ * @return true if `a` is due before `b`
+ */
+static inline bool heap_less(const lv_timer_t * a, const lv_timer_t * b)
+{
+    return (int32_t)((a->last_run + a->period) - (b->last_run + b->period)) < 0;
+}
+
+static inline void heap_set(uint32_t i, lv_timer_t * timer)
+{
+    heap[i] = timer;
+    timer->heap_idx = i;
+}
+
+static void heap_sift_up(uint32_t i)
+{
+    lv_timer_t * timer = heap[i];
+    while(i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if(!heap_less(timer, heap[parent])) break;
+        heap_set(i, heap[parent]);
+        i = parent;
+    }
+    heap_set(i, timer);
+}
+
+static void heap_sift_down(uint32_t i)
+{
+    lv_timer_t * timer = heap[i];
+    while(true) {
+        uint32_t child = 2 * i + 1;
+        if(child >= heap_len) break;
+        if(child + 1 < heap_len && heap_less(heap[child + 1], heap[child])) child++;
+        if(!heap_less(heap[child], timer)) break;
+        heap_set(i, heap[child]);
+        i = child;
+    }
+    heap_set(i, timer);
+}
+
+/**
+ * Make sure the heap can hold `n` timers.
+ * @return false if out of memory
+ */
+static bool heap_reserve(uint32_t n)
+{
+    if(n <= heap_cap) return true;
+    uint32_t cap = heap_cap ? heap_cap * 2 : 16;
+    while(cap < n) cap *= 2;
+    lv_timer_t ** h = lv_mem_realloc(heap, cap * sizeof(lv_timer_t *));
+    LV_ASSERT_MALLOC(h);
+    if(h == NULL) return false;
+    heap = h;
+    lv_timer_t ** d = lv_mem_realloc(deferred, cap * sizeof(lv_timer_t *));
+    LV_ASSERT_MALLOC(d);
+    if(d == NULL) return false;
+    deferred = d;
+    heap_cap = cap;
+    return true;
+}
+
+/**
+ * Insert a timer in the heap. The capacity is reserved in `lv_timer_create`.
+ */
+static void heap_push(lv_timer_t * timer)
+{
+    LV_ASSERT(heap_len < heap_cap);
+    heap_set(heap_len, timer);
+    heap_len++;
+    heap_sift_up(timer->heap_idx);
+}
+
+/**
+ * Remove a timer from the heap or the deferred list, if present.
+ */
+static void heap_remove(lv_timer_t * timer)
+{
+    uint32_t i = timer->heap_idx;
+    if(i == LV_TIMER_NO_HEAP_IDX) return;
+    timer->heap_idx = LV_TIMER_NO_HEAP_IDX;
+    if(i & LV_TIMER_DEFERRED_FLAG) {
+        i &= ~LV_TIMER_DEFERRED_FLAG;
+        deferred_len--;
+        if(i < deferred_len) {
+            deferred[i] = deferred[deferred_len];
+            deferred[i]->heap_idx = LV_TIMER_DEFERRED_FLAG | i;
+        }
+        return;
+    }
+    heap_len--;
+    if(i == heap_len) return;
+    heap_set(i, heap[heap_len]);
+    heap_update(heap[i]);
+}
+
+/**
+ * Restore the heap order after the deadline of a timer changed.
+ */
+static void heap_update(lv_timer_t * timer)
+{
+    uint32_t i = timer->heap_idx;
+    if(i == LV_TIMER_NO_HEAP_IDX || (i & LV_TIMER_DEFERRED_FLAG)) return;
+    if(i > 0 && heap_less(timer, heap[(i - 1) / 2])) heap_sift_up(i);
+    else heap_sift_down(i);
+}
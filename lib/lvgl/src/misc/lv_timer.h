@@ -48,8 +48,12 @@ typedef struct _lv_timer_t {
     void * user_data; /**< Custom user data*/
     int32_t repeat_count; /**< 1: One time;  -1 : infinity;  n>0: residual times*/
     uint32_t paused : 1;
+    uint32_t heap_idx; /**< Position in the deadline heap; LV_TIMER_NO_HEAP_IDX if paused*/
 } lv_timer_t;
 
+#define LV_TIMER_NO_HEAP_IDX UINT32_MAX
+#define LV_TIMER_DEFERRED_FLAG 0x80000000 /*Set in `heap_idx` when out of the heap until the handler pass ends*/
+
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
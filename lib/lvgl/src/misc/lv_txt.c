@@ -19,10 +19,30 @@
  *********************/
 #define NO_BREAK_FOUND UINT32_MAX
 
+#ifndef LV_TXT_CACHE_SIZE
+    #define LV_TXT_CACHE_SIZE 0
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
 
+#if LV_TXT_CACHE_SIZE
+/*The layout of a text, keyed by its content rather than its pointer:
+ *labels re-set the same strings into new buffers, and a changed text is
+ *simply a different key. So entries never need to be invalidated.*/
+typedef struct {
+    const lv_font_t * font;
+    uint64_t hash;      /*FNV-1a of the text; 0 means unused*/
+    uint32_t len;
+    lv_coord_t letter_space;
+    lv_coord_t max_width;
+    lv_text_flag_t flag;
+    bool fits;          /*false if the text has too many lines to be cached*/
+    _lv_txt_layout_t layout;
+} txt_cache_entry_t;
+#endif
+
 /**********************
  *  STATIC PROTOTYPES
  **********************/
@@ -46,9 +66,17 @@
     static uint32_t lv_txt_iso8859_1_get_char_id(const char * txt, uint32_t byte_id);
     static uint32_t lv_txt_iso8859_1_get_length(const char * txt);
 #endif
+#if LV_TXT_CACHE_SIZE
+    static bool txt_layout(_lv_txt_layout_t * layout, const char * txt, const lv_font_t * font,
+                           lv_coord_t letter_space, lv_coord_t max_width, lv_text_flag_t flag);
+#endif
+
 /**********************
  *  STATIC VARIABLES
  **********************/
+#if LV_TXT_CACHE_SIZE
+static txt_cache_entry_t txt_cache[LV_TXT_CACHE_SIZE];
+#endif
 
 /**********************
  *  GLOBAL VARIABLES
@@ -103,6 +131,18 @@ void lv_txt_get_size(lv_point_t * size_res, const char * text, const lv_font_t *
     uint32_t new_line_start = 0;
     uint16_t letter_height = lv_font_get_line_height(font);
 
+    _lv_txt_layout_t layout;
+    if(_lv_txt_get_layout(&layout, text, font, letter_space, max_width, flag)) {
+        /*Same as the loop below, which also handles the overflow*/
+        int64_t lines = layout.line_cnt + layout.trailing_nl;
+        int64_t h = lines * ((int64_t)letter_height + line_space);
+        if(h >= 0 && (uint64_t)h <= LV_MAX_OF(lv_coord_t)) {
+            size_res->x = layout.max_width;
+            size_res->y = h == 0 ? letter_height : h - line_space;
+            return;
+        }
+    }
+
     /*Calc. the height and longest line*/
     while(text[line_start] != '\0') {
         new_line_start += _lv_txt_get_next_line(&text[line_start], font, letter_space, max_width, NULL, flag);
@@ -136,6 +176,80 @@ void lv_txt_get_size(lv_point_t * size_res, const char * text, const lv_font_t *
         size_res->y -= line_space;
 }
 
+bool _lv_txt_get_layout(_lv_txt_layout_t * layout, const char * txt, const lv_font_t * font,
+                        lv_coord_t letter_space, lv_coord_t max_width, lv_text_flag_t flag)
+{
+#if LV_TXT_CACHE_SIZE
+    if(txt == NULL || font == NULL) return false;
+
+    /*The width doesn't matter without word wrapping*/
+    if(flag & (LV_TEXT_FLAG_EXPAND | LV_TEXT_FLAG_FIT)) max_width = LV_COORD_MAX;
+
+    /*Hashing is cheap compared to walking the glyph descriptors of the font*/
+    uint64_t h = 14695981039346656037ull;
+    uint32_t len;
+    for(len = 0; txt[len] != '\0'; len++) {
+        h = (h ^ (uint8_t)txt[len]) * 1099511628211ull;
+    }
+    if(h == 0) h = 1;
+
+    uint32_t k = (uint32_t)(h ^ (h >> 32)) ^ (uint32_t)((uintptr_t)font >> 3) * 2654435761u;
+    k ^= (uint32_t)max_width * 40503u;
+    txt_cache_entry_t * e = &txt_cache[(k ^ (k >> 16)) % LV_TXT_CACHE_SIZE];
+    if(e->hash == h && e->font == font && e->len == len && e->letter_space == letter_space &&
+       e->max_width == max_width && e->flag == flag) {
+        LV_CACHE_STAT(txt_hit);
+        if(e->fits) *layout = e->layout;
+        return e->fits;
+    }
+    LV_CACHE_STAT(txt_miss);
+
+    e->font = font;
+    e->hash = h;
+    e->len = len;
+    e->letter_space = letter_space;
+    e->max_width = max_width;
+    e->flag = flag;
+    e->fits = txt_layout(&e->layout, txt, font, letter_space, max_width, flag);
+    if(e->fits) *layout = e->layout;
+    return e->fits;
+#else
+    LV_UNUSED(layout);
+    LV_UNUSED(txt);
+    LV_UNUSED(font);
+    LV_UNUSED(letter_space);
+    LV_UNUSED(max_width);
+    LV_UNUSED(flag);
+    return false;
+#endif
+}
+
+#if LV_TXT_CACHE_SIZE
+/**
+ * Compute the line breaks and widths of a text.
+ * @return false if the text has more than `LV_TXT_CACHE_LINES` lines
+ */
+static bool txt_layout(_lv_txt_layout_t * layout, const char * txt, const lv_font_t * font,
+                       lv_coord_t letter_space, lv_coord_t max_width, lv_text_flag_t flag)
+{
+    uint32_t line_start = 0;
+    layout->line_cnt = 0;
+    layout->max_width = 0;
+    while(txt[line_start] != '\0') {
+        if(layout->line_cnt == LV_TXT_CACHE_LINES) return false;
+        uint32_t line_end = line_start + _lv_txt_get_next_line(&txt[line_start], font, letter_space, max_width, NULL, flag);
+        lv_coord_t w = lv_txt_get_width(&txt[line_start], line_end - line_start, font, letter_space, flag);
+        layout->ends[layout->line_cnt] = line_end;
+        layout->widths[layout->line_cnt] = w;
+        layout->line_cnt++;
+        layout->max_width = LV_MAX(layout->max_width, w);
+        line_start = line_end;
+    }
+    layout->trailing_nl = line_start != 0 && (txt[line_start - 1] == '\n' || txt[line_start - 1] == '\r');
+    return true;
+}
+#endif
+
 /**
  * Get the next word of text. A word is delimited by break characters.
  *
@@ -32,6 +32,11 @@ extern "C" {
 #define LV_TXT_ENC_UTF8 1
 #define LV_TXT_ENC_ASCII 2
 
+/*Max number of lines of a text layout kept in the cache; see `_lv_txt_get_layout`*/
+#ifndef LV_TXT_CACHE_LINES
+#define LV_TXT_CACHE_LINES 8
+#endif
+
 /**********************
  *      TYPEDEFS
  **********************/
@@ -65,6 +70,17 @@ enum {
 };
 typedef uint8_t lv_text_align_t;
 
+/**
+ * Line breaks and widths of a text, as computed by `_lv_txt_get_next_line`
+ * and `lv_txt_get_width`.*/
+typedef struct {
+    uint32_t ends[LV_TXT_CACHE_LINES];      /**< Byte index of the first char after each line*/
+    lv_coord_t widths[LV_TXT_CACHE_LINES];  /**< Width of each line*/
+    lv_coord_t max_width;                   /**< Width of the longest line*/
+    uint16_t line_cnt;
+    uint8_t trailing_nl : 1;                /**< The text ends with '\n' or '\r'*/
+} _lv_txt_layout_t;
+
 /**********************
  * GLOBAL PROTOTYPES
  **********************/
@@ -83,6 +99,22 @@ typedef uint8_t lv_text_align_t;
 void lv_txt_get_size(lv_point_t * size_res, const char * text, const lv_font_t * font, lv_coord_t letter_space,
                      lv_coord_t line_space, lv_coord_t max_width, lv_text_flag_t flag);
 
+/**
+ * Get the line breaks of a text from a cache keyed by the font, the text content and the
+ * other arguments, computing and caching them on a miss.
+ * @param layout pointer to a variable to store the result
+ * @param txt a '\0' terminated string
+ * @param font pointer to a font
+ * @param letter_space letter space
+ * @param max_width max width of the text (break the lines to fit this size). Set COORD_MAX to avoid
+ * line breaks
+ * @param flags settings for the text from 'txt_flag_type' enum
+ * @return false if the cache is disabled or the text has more than `LV_TXT_CACHE_LINES` lines;
+ * `layout` is then undefined
+ */
+bool _lv_txt_get_layout(_lv_txt_layout_t * layout, const char * txt, const lv_font_t * font,
+                        lv_coord_t letter_space, lv_coord_t max_width, lv_text_flag_t flag);
+
 /**
  * Get the next line of text. Check line length and break chars too.
  * @param txt a '\0' terminated string
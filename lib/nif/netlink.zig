@@ -0,0 +1,91 @@
+//! rtnetlink(7) notifications of network interfaces and addresses changes.
+
+const std = @import("std");
+const linux = std.os.linux;
+const posix = std.posix;
+
+// multicast groups, see linux/rtnetlink.h.
+const RTMGRP_LINK = 0x1;
+const RTMGRP_IPV4_IFADDR = 0x10;
+const RTMGRP_IPV6_IFADDR = 0x100;
+
+// message types of interest.
+const RTM_NEWLINK = 16;
+const RTM_DELLINK = 17;
+const RTM_NEWADDR = 20;
+const RTM_DELADDR = 21;
+
+/// size of struct nlmsghdr.
+const nlmsghdr_size = 16;
+
+/// listens for IP addresses added or removed, and interfaces going up or down.
+/// the events carry no data: users re-read what they need, for example
+/// with pubAddresses, on each change.
+pub const AddrMonitor = struct {
+    sock: posix.socket_t,
+
+    /// the returned value must be close'd when done.
+    pub fn open() !AddrMonitor {
+        const sock = try posix.socket(
+            linux.AF.NETLINK,
+            linux.SOCK.RAW | linux.SOCK.CLOEXEC | linux.SOCK.NONBLOCK,
+            linux.NETLINK.ROUTE,
+        );
+        errdefer posix.close(sock);
+        var sa = std.mem.zeroes(linux.sockaddr.nl);
+        sa.family = linux.AF.NETLINK;
+        sa.groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+        try posix.bind(sock, @ptrCast(&sa), @sizeOf(linux.sockaddr.nl));
+        return .{ .sock = sock };
+    }
+
+    pub fn close(self: AddrMonitor) void {
+        posix.close(self.sock);
+    }
+
+    /// the socket to wait for events with poll or epoll.
+    pub fn fd(self: AddrMonitor) posix.fd_t {
+        return self.sock;
+    }
+
+    /// reads all pending messages without blocking and reports whether any
+    /// of them is about an address or interface change. also true when the
+    /// kernel dropped messages due to a full socket buffer.
+    pub fn drain(self: AddrMonitor) !bool {
+        var buf: [8192]u8 align(4) = undefined;
+        var changed = false;
+        while (true) {
+            const n = posix.read(self.sock, &buf) catch |err| switch (err) {
+                error.WouldBlock => return changed,
+                error.SystemResources => { // ENOBUFS: some events are lost
+                    changed = true;
+                    continue;
+                },
+                else => return err,
+            };
+            if (n == 0) {
+                return changed;
+            }
+            changed = hasChanges(buf[0..n]) or changed;
+        }
+    }
+};
+
+/// reports whether a batch of netlink messages contains any of interest.
+fn hasChanges(msgs: []const u8) bool {
+    const endian = @import("builtin").cpu.arch.endian();
+    var i: usize = 0;
+    while (i + nlmsghdr_size <= msgs.len) {
+        const len = std.mem.readInt(u32, msgs[i..][0..4], endian);
+        const typ = std.mem.readInt(u16, msgs[i + 4 ..][0..2], endian);
+        switch (typ) {
+            RTM_NEWLINK, RTM_DELLINK, RTM_NEWADDR, RTM_DELADDR => return true,
+            else => {},
+        }
+        if (len < nlmsghdr_size) {
+            break; // malformed
+        }
+        i += std.mem.alignForward(usize, len, 4);
+    }
+    return false;
+}
@@ -3,6 +3,8 @@ const mem = std.mem;
 const net = std.net;
 const posix = std.posix;
 
+pub const netlink = @import("netlink.zig");
+pub const nl80211 = @import("nl80211.zig");
 pub const wpa = @import("wpa.zig");
 
 const IFF_UP = 1 << 0; //0b1;
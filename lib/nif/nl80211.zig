@@ -0,0 +1,302 @@
+//! wifi link quality of a station interface from nl80211 over generic netlink:
+//! signal strength, bitrates and transmit retries of the access point the
+//! interface is associated with, as `iw dev <if> station dump` shows them.
+//! a sample is a single request and reply, cheap enough for polling every
+//! few seconds.
+
+const std = @import("std");
+const linux = std.os.linux;
+const posix = std.posix;
+
+const endian = @import("builtin").cpu.arch.endian();
+
+// netlink(7) and genetlink.h.
+const NETLINK_GENERIC = 16;
+const NLM_F_REQUEST = 0x1;
+const NLM_F_ACK = 0x4;
+const NLM_F_DUMP = 0x300;
+const NLMSG_ERROR = 0x2;
+const NLMSG_DONE = 0x3;
+const NLA_TYPE_MASK = 0x3fff; // without NLA_F_NESTED and NLA_F_NET_BYTEORDER
+const GENL_ID_CTRL = 0x10;
+const CTRL_CMD_GETFAMILY = 3;
+const CTRL_ATTR_FAMILY_ID = 1;
+const CTRL_ATTR_FAMILY_NAME = 2;
+
+// linux/nl80211.h.
+const NL80211_CMD_GET_STATION = 17;
+const NL80211_ATTR_IFINDEX = 3;
+const NL80211_ATTR_STA_INFO = 21;
+const NL80211_STA_INFO_SIGNAL = 7;
+const NL80211_STA_INFO_TX_BITRATE = 8;
+const NL80211_STA_INFO_TX_PACKETS = 10;
+const NL80211_STA_INFO_TX_RETRIES = 11;
+const NL80211_STA_INFO_TX_FAILED = 12;
+const NL80211_STA_INFO_RX_BITRATE = 14;
+const NL80211_RATE_INFO_BITRATE = 1; // u16, 100kbit/s
+const NL80211_RATE_INFO_BITRATE32 = 5; // u32, 100kbit/s
+
+/// sizes of struct nlmsghdr, genlmsghdr and nlattr.
+const nlmsghdr_size = 16;
+const genlmsghdr_size = 4;
+const nlattr_size = 4;
+
+/// replies are awaited for at most this long.
+const timeout_ms = 500;
+
+pub const StationInfo = struct {
+    signal: i8, // dBm
+    tx_bitrate: u32, // kbit/s; 0 if unknown
+    rx_bitrate: u32, // kbit/s; 0 if unknown
+    // cumulative since association.
+    tx_packets: u32,
+    tx_retries: u32,
+    tx_failed: u32,
+};
+
+/// a generic netlink socket to query nl80211 about a single interface.
+pub const LinkMonitor = struct {
+    sock: posix.socket_t,
+    family: u16, // nl80211 generic netlink family id
+    ifindex: u32,
+    seq: u32 = 0,
+
+    /// fails with error.Nl80211Unavailable without a wireless driver using
+    /// cfg80211, and error.NoSuchInterface for an unknown ifname.
+    /// the returned value must be close'd when done.
+    pub fn open(ifname: []const u8) !LinkMonitor {
+        const ifindex = try interfaceIndex(ifname);
+        const sock = try posix.socket(linux.AF.NETLINK, linux.SOCK.RAW | linux.SOCK.CLOEXEC, NETLINK_GENERIC);
+        errdefer posix.close(sock);
+        const tv = posix.timeval{ .tv_sec = 0, .tv_usec = timeout_ms * std.time.us_per_ms };
+        try posix.setsockopt(sock, posix.SOL.SOCKET, posix.SO.RCVTIMEO, std.mem.asBytes(&tv));
+        var sa = std.mem.zeroes(linux.sockaddr.nl);
+        sa.family = linux.AF.NETLINK;
+        try posix.bind(sock, @ptrCast(&sa), @sizeOf(linux.sockaddr.nl));
+
+        var self = LinkMonitor{ .sock = sock, .family = 0, .ifindex = ifindex };
+        self.family = try self.resolveFamily();
+        return self;
+    }
+
+    pub fn close(self: LinkMonitor) void {
+        posix.close(self.sock);
+    }
+
+    /// returns the link quality of the associated access point, or null
+    /// while the interface isn't associated.
+    pub fn sample(self: *LinkMonitor) !?StationInfo {
+        var req: [64]u8 align(4) = undefined;
+        var n = self.header(&req, self.family, NLM_F_REQUEST | NLM_F_DUMP, NL80211_CMD_GET_STATION);
+        n = putAttr(&req, n, NL80211_ATTR_IFINDEX, std.mem.asBytes(&self.ifindex));
+        try self.send(req[0..n]);
+
+        // a station interface has a single station, its access point, but
+        // the dump still ends with NLMSG_DONE: read it all to keep in sync.
+        var info: ?StationInfo = null;
+        var buf: [8192]u8 align(4) = undefined;
+        while (true) {
+            const len = try posix.recv(self.sock, &buf, 0);
+            var it = MsgIterator{ .buf = buf[0..len] };
+            while (it.next()) |m| {
+                switch (m.typ) {
+                    NLMSG_DONE => return info,
+                    NLMSG_ERROR => try checkError(m.payload),
+                    else => if (m.typ == self.family and info == null) {
+                        info = parseStation(m.payload);
+                    },
+                }
+            }
+        }
+    }
+
+    /// looks up the nl80211 family id with the generic netlink controller.
+    fn resolveFamily(self: *LinkMonitor) !u16 {
+        var req: [64]u8 align(4) = undefined;
+        var n = self.header(&req, GENL_ID_CTRL, NLM_F_REQUEST | NLM_F_ACK, CTRL_CMD_GETFAMILY);
+        n = putAttr(&req, n, CTRL_ATTR_FAMILY_NAME, "nl80211\x00");
+        try self.send(req[0..n]);
+
+        var family: ?u16 = null;
+        var buf: [8192]u8 align(4) = undefined;
+        while (true) {
+            const len = try posix.recv(self.sock, &buf, 0);
+            var it = MsgIterator{ .buf = buf[0..len] };
+            while (it.next()) |m| {
+                switch (m.typ) {
+                    NLMSG_ERROR => {
+                        checkError(m.payload) catch |err| switch (err) {
+                            error.FileNotFound => return error.Nl80211Unavailable, // ENOENT
+                            else => return err,
+                        };
+                        // the ack, following the reply.
+                        return family orelse error.Nl80211Unavailable;
+                    },
+                    GENL_ID_CTRL => {
+                        var attrs = AttrIterator{ .buf = genlPayload(m.payload) };
+                        while (attrs.next()) |a| {
+                            if (a.typ == CTRL_ATTR_FAMILY_ID and a.data.len >= 2) {
+                                family = std.mem.readInt(u16, a.data[0..2], endian);
+                            }
+                        }
+                    },
+                    else => {},
+                }
+            }
+        }
+    }
+
+    /// writes nlmsghdr and genlmsghdr to buf and returns their size; the
+    /// length is filled in by send.
+    fn header(self: *LinkMonitor, buf: []u8, typ: u16, flags: u16, cmd: u8) usize {
+        self.seq +%= 1;
+        std.mem.writeInt(u32, buf[0..4], 0, endian);
+        std.mem.writeInt(u16, buf[4..6], typ, endian);
+        std.mem.writeInt(u16, buf[6..8], flags, endian);
+        std.mem.writeInt(u32, buf[8..12], self.seq, endian);
+        std.mem.writeInt(u32, buf[12..16], 0, endian); // the kernel assigns the port
+        buf[16] = cmd;
+        buf[17] = 1; // version
+        std.mem.writeInt(u16, buf[18..20], 0, endian);
+        return nlmsghdr_size + genlmsghdr_size;
+    }
+
+    fn send(self: LinkMonitor, msg: []u8) !void {
+        std.mem.writeInt(u32, msg[0..4], @intCast(msg.len), endian);
+        _ = try posix.send(self.sock, msg, 0);
+    }
+};
+
+/// extracts station info attributes from an NL80211_CMD_NEW_STATION reply.
+fn parseStation(payload: []const u8) ?StationInfo {
+    var attrs = AttrIterator{ .buf = genlPayload(payload) };
+    while (attrs.next()) |a| {
+        if (a.typ != NL80211_ATTR_STA_INFO) {
+            continue;
+        }
+        var info = StationInfo{ .signal = 0, .tx_bitrate = 0, .rx_bitrate = 0, .tx_packets = 0, .tx_retries = 0, .tx_failed = 0 };
+        var sta = AttrIterator{ .buf = a.data };
+        while (sta.next()) |s| {
+            switch (s.typ) {
+                NL80211_STA_INFO_SIGNAL => if (s.data.len >= 1) {
+                    info.signal = @bitCast(s.data[0]);
+                },
+                NL80211_STA_INFO_TX_BITRATE => info.tx_bitrate = rateKbps(s.data),
+                NL80211_STA_INFO_RX_BITRATE => info.rx_bitrate = rateKbps(s.data),
+                NL80211_STA_INFO_TX_PACKETS => info.tx_packets = attrU32(s.data),
+                NL80211_STA_INFO_TX_RETRIES => info.tx_retries = attrU32(s.data),
+                NL80211_STA_INFO_TX_FAILED => info.tx_failed = attrU32(s.data),
+                else => {},
+            }
+        }
+        return info;
+    }
+    return null;
+}
+
+/// returns the bitrate of nested rate info attributes, in kbit/s.
+fn rateKbps(data: []const u8) u32 {
+    var rate: u32 = 0;
+    var it = AttrIterator{ .buf = data };
+    while (it.next()) |r| {
+        switch (r.typ) {
+            NL80211_RATE_INFO_BITRATE32 => return attrU32(r.data) *| 100,
+            NL80211_RATE_INFO_BITRATE => if (r.data.len >= 2) {
+                rate = @as(u32, std.mem.readInt(u16, r.data[0..2], endian)) * 100;
+            },
+            else => {},
+        }
+    }
+    return rate;
+}
+
+fn attrU32(data: []const u8) u32 {
+    return if (data.len >= 4) std.mem.readInt(u32, data[0..4], endian) else 0;
+}
+
+fn genlPayload(payload: []const u8) []const u8 {
+    return if (payload.len >= genlmsghdr_size) payload[genlmsghdr_size..] else &.{};
+}
+
+/// returns an error for an NLMSG_ERROR with a non-zero errno; zero is an ack.
+fn checkError(payload: []const u8) !void {
+    if (payload.len < 4) {
+        return error.Nl80211Malformed;
+    }
+    const code = std.mem.readInt(i32, payload[0..4], endian);
+    if (code == 0) {
+        return;
+    }
+    return switch (@as(posix.E, @enumFromInt(-code))) {
+        .NOENT => error.FileNotFound,
+        .NODEV => error.NoSuchInterface,
+        .OPNOTSUPP => error.Nl80211Unavailable,
+        else => |e| posix.unexpectedErrno(e),
+    };
+}
+
+/// appends an attribute at off in buf and returns the new, aligned, length.
+fn putAttr(buf: []u8, off: usize, typ: u16, data: []const u8) usize {
+    const len = nlattr_size + data.len;
+    std.mem.writeInt(u16, buf[off..][0..2], @intCast(len), endian);
+    std.mem.writeInt(u16, buf[off + 2 ..][0..2], typ, endian);
+    @memcpy(buf[off + nlattr_size ..][0..data.len], data);
+    const end = off + std.mem.alignForward(usize, len, 4);
+    @memset(buf[off + len .. end], 0);
+    return end;
+}
+
+const MsgIterator = struct {
+    buf: []const u8,
+    i: usize = 0,
+
+    const Msg = struct { typ: u16, payload: []const u8 };
+
+    fn next(self: *MsgIterator) ?Msg {
+        if (self.i + nlmsghdr_size > self.buf.len) {
+            return null;
+        }
+        const len = std.mem.readInt(u32, self.buf[self.i..][0..4], endian);
+        const typ = std.mem.readInt(u16, self.buf[self.i + 4 ..][0..2], endian);
+        if (len < nlmsghdr_size or self.i + len > self.buf.len) {
+            return null; // malformed
+        }
+        const m = Msg{ .typ = typ, .payload = self.buf[self.i + nlmsghdr_size .. self.i + len] };
+        self.i += std.mem.alignForward(usize, len, 4);
+        return m;
+    }
+};
+
+const AttrIterator = struct {
+    buf: []const u8,
+    i: usize = 0,
+
+    const Attr = struct { typ: u16, data: []const u8 };
+
+    fn next(self: *AttrIterator) ?Attr {
+        if (self.i + nlattr_size > self.buf.len) {
+            return null;
+        }
+        const len = std.mem.readInt(u16, self.buf[self.i..][0..2], endian);
+        const typ = std.mem.readInt(u16, self.buf[self.i + 2 ..][0..2], endian);
+        if (len < nlattr_size or self.i + len > self.buf.len) {
+            return null; // malformed
+        }
+        const a = Attr{ .typ = typ & NLA_TYPE_MASK, .data = self.buf[self.i + nlattr_size .. self.i + len] };
+        self.i += std.mem.alignForward(usize, len, 4);
+        return a;
+    }
+};
+
+extern "c" fn if_nametoindex(ifname: [*:0]const u8) c_uint;
+
+fn interfaceIndex(ifname: []const u8) !u32 {
+    var buf: [posix.IFNAMESIZE:0]u8 = undefined;
+    if (ifname.len >= buf.len) {
+        return error.NoSuchInterface;
+    }
+    @memcpy(buf[0..ifname.len], ifname);
+    buf[ifname.len] = 0;
+    const i = if_nametoindex(&buf);
+    return if (i == 0) error.NoSuchInterface else i;
+}
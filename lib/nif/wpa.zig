@@ -1,5 +1,6 @@
 const std = @import("std");
 const mem = std.mem;
+const posix = std.posix;
 const Thread = std.Thread;
 
 const WPACtrl = opaque {};
@@ -10,6 +11,7 @@ extern fn wpa_ctrl_close(ctrl: *WPACtrl) void;
 extern fn wpa_ctrl_request(ctrl: *WPACtrl, cmd: [*:0]const u8, clen: usize, reply: [*:0]u8, rlen: *usize, cb: ?ReqCallback) c_int;
 extern fn wpa_ctrl_pending(ctrl: *WPACtrl) c_int;
 extern fn wpa_ctrl_recv(ctrl: *WPACtrl, reply: [*:0]u8, reply_len: *usize) c_int;
+extern fn wpa_ctrl_get_fd(ctrl: *WPACtrl) c_int;
 
 pub const Control = struct {
     //mu: Thread.Mutext = .{},
@@ -21,6 +23,7 @@ pub const Control = struct {
         NameTooLong,
         WpaCtrlFailure,
         WpaCtrlTimeout,
+        WpaCtrlBusy,
         WpaCtrlAttach,
         WpaCtrlDetach,
         WpaCtrlScanStart,
@@ -153,6 +156,13 @@ pub const Control = struct {
         return n > 0;
     }
 
+    /// returns the control interface socket, for example to wait for pending
+    /// messages with poll or epoll instead of polling self.pending.
+    /// the socket is owned by self.
+    pub fn fd(self: Self) std.posix.fd_t {
+        return wpa_ctrl_get_fd(self.wpa_ctrl);
+    }
+
     /// retrieve a pending message using the provided buf.
     /// returned slice is owned by the buf.
     /// requires self to be attach'ed.
@@ -168,6 +178,251 @@ pub const Control = struct {
     }
 };
 
+/// a control interface connection for requests which never block the caller:
+/// submit sends a command and returns right away, and the reply is read with
+/// receive once fd becomes readable, for example in an epoll loop.
+///
+/// the connection is never attached, so that all messages it receives are
+/// replies, in the order the commands were submitted: wpa_supplicant handles
+/// them one at a time. a request with no reply by its deadline is reported
+/// by expire; its reply, if it ever arrives, is dropped.
+/// unsafe for concurrent use.
+pub const AsyncControl = struct {
+    wpa_ctrl: *WPACtrl,
+    next_id: u32 = 1,
+    /// requests awaiting a reply, oldest first; a ring buffer.
+    inflight: [max_inflight]Inflight = undefined,
+    head: usize = 0,
+    len: usize = 0,
+
+    const Self = @This();
+    pub const Error = Control.Error;
+
+    /// max number of requests awaiting a reply; submit fails beyond that.
+    pub const max_inflight = 8;
+
+    /// identifies a submitted request.
+    pub const Request = struct {
+        id: u32,
+    };
+
+    /// a reply to the request req; data is owned by the receive buffer.
+    pub const Reply = struct {
+        req: Request,
+        data: []const u8,
+    };
+
+    const Inflight = struct {
+        req: Request,
+        deadline: i64, // std.time.milliTimestamp
+        expired: bool, // reported by expire
+    };
+
+    /// opens a connection to the control interface at path, in addition to
+    /// any other, for example an attached Control.
+    /// the returned instance must be close'd when done to free resources.
+    pub fn open(path: [:0]const u8) Error!Self {
+        const ctrl = wpa_ctrl_open(path) orelse return error.WpaCtrlFailure;
+        return .{ .wpa_ctrl = ctrl };
+    }
+
+    pub fn close(self: *Self) void {
+        wpa_ctrl_close(self.wpa_ctrl);
+    }
+
+    /// returns the control interface socket to wait for replies on.
+    /// the socket is owned by self.
+    pub fn fd(self: Self) posix.fd_t {
+        return wpa_ctrl_get_fd(self.wpa_ctrl);
+    }
+
+    /// sends the command without waiting for the reply, which is due within
+    /// timeout_ms. fails with WpaCtrlBusy if max_inflight requests are
+    /// awaiting a reply or the socket send buffer is full.
+    /// when full, the oldest expired request is given up on to make room:
+    /// its reply is considered lost.
+    pub fn submit(self: *Self, cmd: []const u8, timeout_ms: u32) Error!Request {
+        if (self.len == max_inflight) {
+            if (!self.inflight[self.head].expired) {
+                return error.WpaCtrlBusy;
+            }
+            self.head = (self.head + 1) % max_inflight;
+            self.len -= 1;
+        }
+        _ = posix.send(self.fd(), cmd, posix.MSG.DONTWAIT) catch |err| return switch (err) {
+            error.WouldBlock => error.WpaCtrlBusy,
+            else => error.WpaCtrlFailure,
+        };
+        const req = Request{ .id = self.next_id };
+        self.next_id +%= 1;
+        self.inflight[(self.head + self.len) % max_inflight] = .{
+            .req = req,
+            .deadline = std.time.milliTimestamp() + timeout_ms,
+            .expired = false,
+        };
+        self.len += 1;
+        return req;
+    }
+
+    /// returns the next reply to a submitted request, or null if none is
+    /// available without blocking. replies to expired requests are skipped.
+    /// buf should be large enough to hold the longest expected reply: the rest
+    /// of a datagram is discarded.
+    pub fn receive(self: *Self, buf: []u8) Error!?Reply {
+        while (true) {
+            const n = posix.recv(self.fd(), buf, posix.MSG.DONTWAIT) catch |err| return switch (err) {
+                error.WouldBlock => null,
+                else => error.WpaCtrlFailure,
+            };
+            if (self.len == 0) {
+                continue; // not a reply to any of ours
+            }
+            const f = self.inflight[self.head];
+            self.head = (self.head + 1) % max_inflight;
+            self.len -= 1;
+            if (!f.expired) {
+                return .{ .req = f.req, .data = buf[0..n] };
+            }
+        }
+    }
+
+    /// returns the oldest request still awaiting a reply past its deadline
+    /// at now, std.time.milliTimestamp, if any. each request is reported once.
+    pub fn expire(self: *Self, now: i64) ?Request {
+        for (0..self.len) |i| {
+            const f = &self.inflight[(self.head + i) % max_inflight];
+            if (!f.expired and f.deadline <= now) {
+                f.expired = true;
+                return f.req;
+            }
+        }
+        return null;
+    }
+
+    /// reports whether any request is awaiting a reply and not yet expired.
+    pub fn busy(self: Self) bool {
+        for (0..self.len) |i| {
+            if (!self.inflight[(self.head + i) % max_inflight].expired) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/// an unsolicited wpa_supplicant message decoded by parseEvent.
+pub const Event = union(enum) {
+    /// CTRL-EVENT-CONNECTED - Connection to <bssid> completed [id=<id> id_str=]
+    connected: struct {
+        id: ?u32,
+    },
+    /// CTRL-EVENT-DISCONNECTED bssid=<bssid> reason=<code> [locally_generated=1]
+    disconnected: struct {
+        reason: ?u16,
+        locally_generated: bool,
+    },
+    /// CTRL-EVENT-SSID-TEMP-DISABLED id=<id> ssid="<ssid>" auth_failures=<n> duration=<sec> reason=<str>
+    ssid_temp_disabled: struct {
+        id: ?u32,
+        ssid: ?[]const u8, // as escaped by wpa_supplicant, without quotes
+        auth_failures: u32,
+        reason: ?[]const u8, // for example, WRONG_KEY
+    },
+    /// CTRL-EVENT-SCAN-RESULTS
+    scan_results,
+    /// CTRL-EVENT-BSS-ADDED <id> <bssid> or CTRL-EVENT-BSS-REMOVED <id> <bssid>,
+    /// as a BSS shows up or expires from the table between scans too.
+    bss_changed,
+    /// CTRL-EVENT-TERMINATING
+    terminating,
+    /// anything else; the value is event name, such as CTRL-EVENT-SCAN-STARTED.
+    other: []const u8,
+};
+
+/// decodes a "<level>EVENT-NAME params" message. the returned value references msg.
+/// a message cut short by a receive buffer too small still decodes, with the
+/// missing params reported as null or zero.
+pub fn parseEvent(msg: []const u8) Event {
+    var rest = mem.trimRight(u8, msg, "\r\n\x00");
+    if (rest.len > 0 and rest[0] == '<') { // priority level, such as <3>
+        if (mem.indexOfScalar(u8, rest, '>')) |i| {
+            rest = rest[i + 1 ..];
+        }
+    }
+    const name_end = mem.indexOfScalar(u8, rest, ' ') orelse rest.len;
+    const name = rest[0..name_end];
+    const params = rest[name_end..];
+
+    const Kind = enum { connected, disconnected, ssid_temp_disabled, scan_results, bss_changed, terminating };
+    const kinds = std.ComptimeStringMap(Kind, .{
+        .{ "CTRL-EVENT-CONNECTED", .connected },
+        .{ "CTRL-EVENT-DISCONNECTED", .disconnected },
+        .{ "CTRL-EVENT-SSID-TEMP-DISABLED", .ssid_temp_disabled },
+        .{ "CTRL-EVENT-SCAN-RESULTS", .scan_results },
+        .{ "CTRL-EVENT-BSS-ADDED", .bss_changed },
+        .{ "CTRL-EVENT-BSS-REMOVED", .bss_changed },
+        .{ "CTRL-EVENT-TERMINATING", .terminating },
+    });
+    const kind = kinds.get(name) orelse return .{ .other = name };
+    return switch (kind) {
+        .connected => .{ .connected = .{
+            .id = parseParam(u32, params, "id"),
+        } },
+        .disconnected => .{ .disconnected = .{
+            .reason = parseParam(u16, params, "reason"),
+            .locally_generated = mem.eql(u8, eventParam(params, "locally_generated") orelse "0", "1"),
+        } },
+        .ssid_temp_disabled => .{ .ssid_temp_disabled = .{
+            .id = parseParam(u32, params, "id"),
+            .ssid = eventParam(params, "ssid"),
+            .auth_failures = parseParam(u32, params, "auth_failures") orelse 0,
+            .reason = eventParam(params, "reason"),
+        } },
+        .scan_results => .scan_results,
+        .bss_changed => .bss_changed,
+        .terminating => .terminating,
+    };
+}
+
+/// returns the value of a key=value param in space separated event params.
+/// a double quoted value may contain spaces; the quotes are stripped.
+/// an unterminated quoted value is treated as missing.
+pub fn eventParam(params: []const u8, key: []const u8) ?[]const u8 {
+    var i: usize = 0;
+    while (i < params.len) {
+        if (params[i] == ' ') {
+            i += 1;
+            continue;
+        }
+        const start = i;
+        const eq = mem.indexOfScalarPos(u8, params, i, '=');
+        const space = mem.indexOfScalarPos(u8, params, i, ' ') orelse params.len;
+        if (eq == null or eq.? > space) { // not a key=value token
+            i = space;
+            continue;
+        }
+        const vstart = eq.? + 1;
+        var value: ?[]const u8 = undefined;
+        if (vstart < params.len and params[vstart] == '"') {
+            const q = mem.indexOfScalarPos(u8, params, vstart + 1, '"');
+            value = if (q) |e| params[vstart + 1 .. e] else null;
+            i = if (q) |e| e + 1 else params.len;
+        } else {
+            value = params[vstart..space];
+            i = space;
+        }
+        if (mem.eql(u8, params[start..eq.?], key)) {
+            return value;
+        }
+    }
+    return null;
+}
+
+fn parseParam(comptime T: type, params: []const u8, key: []const u8) ?T {
+    const v = eventParam(params, key) orelse return null;
+    return std.fmt.parseInt(T, v, 10) catch null;
+}
+
 //pub const WPA_CTRL_REQ = "CTRL-REQ-";
 //pub const WPA_CTRL_RSP = "CTRL-RSP-";
 //pub const WPA_EVENT_CONNECTED = "CTRL-EVENT-CONNECTED ";
@@ -0,0 +1,348 @@
+//! allocation profiler for nd and ngui: counts allocations, bytes and their
+//! lifetimes per call site, the return address the allocator sees, and per
+//! tag of the allocator passed to a subsystem. aimed at finding code paths
+//! which churn memory rather than leak it.
+//!
+//! compiled in only with -Dallocprof=true; wrap and tagged return the child
+//! allocator as is otherwise, at no cost. the profile is written to stderr
+//! on dumpRequest, such as on SIGUSR1, heaviest sites first. addresses
+//! resolve to source lines with addr2line on an unstripped binary.
+//!
+//! the bookkeeping of every allocation and free takes a lock: profiled
+//! builds are slower and never meant for release.
+//! safe for concurrent use.
+
+const buildopts = @import("build_options");
+const std = @import("std");
+const posix = std.posix;
+const Allocator = std.mem.Allocator;
+
+const logger = std.log.scoped(.allocprof);
+
+pub const enabled = buildopts.allocprof;
+
+/// subsystems of interest, set with tagged; untagged for all others.
+pub const Tag = enum { untagged, comm, bitcoindrpc, lndhttp, ui_lightning };
+
+/// number of log2 lifetime buckets of microseconds; the last bucket,
+/// open-ended, starts at about 18min.
+const nbuckets = 32;
+/// max number of sites in a dump.
+const max_dump = 64;
+/// the dumper polls for dump requests at this interval.
+const poll_interval = 200 * std.time.ns_per_ms;
+
+var global: Profiler = .{};
+var dumper: ?std.Thread = null;
+var dump_requested = std.atomic.Value(bool).init(false);
+var stopping = std.atomic.Value(bool).init(false);
+
+/// returns a profiling allocator of untagged allocations on top of child.
+pub fn wrap(child: Allocator) Allocator {
+    return tagged(.untagged, child);
+}
+
+/// returns a profiling allocator on top of child which attributes allocations
+/// to the tag. each tag has a single child: the last one set wins. a child
+/// which is itself profiling is replaced with its own child, so that its
+/// allocations are counted once.
+pub fn tagged(tag: Tag, child: Allocator) Allocator {
+    if (!enabled) {
+        return child;
+    }
+    const t = &global.tags[@intFromEnum(tag)];
+    t.* = .{ .prof = &global, .tag = tag, .child = unwrap(child) };
+    return t.allocator();
+}
+
+fn unwrap(a: Allocator) Allocator {
+    if (a.vtable == &Tagged.vtable) {
+        const t: *Tagged = @ptrCast(@alignCast(a.ptr));
+        return t.child;
+    }
+    return a;
+}
+
+/// spawns the dumper thread, if enabled.
+pub fn start() !void {
+    if (!enabled or dumper != null) {
+        return;
+    }
+    stopping.store(false, .release);
+    dumper = try std.Thread.spawn(.{}, dumpLoop, .{});
+    logger.info("allocation profiling enabled; dumped on USR1", .{});
+}
+
+pub fn stop() void {
+    const th = dumper orelse return;
+    stopping.store(true, .release);
+    th.join();
+    dumper = null;
+}
+
+/// makes the dumper write the profile to stderr. safe for use in a signal
+/// handler.
+pub fn requestDump() void {
+    dump_requested.store(true, .release);
+}
+
+fn dumpLoop() void {
+    const stderr = std.io.getStdErr();
+    while (!stopping.load(.acquire)) {
+        if (dump_requested.swap(false, .acq_rel)) {
+            global.dump(stderr.writer()) catch {};
+        }
+        std.time.sleep(poll_interval);
+    }
+}
+
+/// an allocator attributing allocations to the tag in prof.
+pub const Tagged = struct {
+    prof: *Profiler,
+    tag: Tag,
+    child: Allocator,
+
+    const vtable = Allocator.VTable{ .alloc = alloc, .resize = resize, .free = free };
+
+    pub fn allocator(self: *Tagged) Allocator {
+        return .{ .ptr = self, .vtable = &vtable };
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, log2_align: u8, ret_addr: usize) ?[*]u8 {
+        const self: *Tagged = @ptrCast(@alignCast(ctx));
+        const p = self.child.rawAlloc(len, log2_align, ret_addr) orelse return null;
+        self.prof.recordAlloc(.{ .tag = self.tag, .addr = ret_addr }, @intFromPtr(p), len);
+        return p;
+    }
+
+    fn resize(ctx: *anyopaque, buf: []u8, log2_align: u8, new_len: usize, ret_addr: usize) bool {
+        const self: *Tagged = @ptrCast(@alignCast(ctx));
+        if (!self.child.rawResize(buf, log2_align, new_len, ret_addr)) {
+            return false;
+        }
+        self.prof.recordResize(@intFromPtr(buf.ptr), new_len);
+        return true;
+    }
+
+    fn free(ctx: *anyopaque, buf: []u8, log2_align: u8, ret_addr: usize) void {
+        const self: *Tagged = @ptrCast(@alignCast(ctx));
+        self.prof.recordFree(@intFromPtr(buf.ptr));
+        self.child.rawFree(buf, log2_align, ret_addr);
+    }
+};
+
+pub const Profiler = struct {
+    mu: std.Thread.Mutex = .{},
+    /// bookkeeping memory; never profiled.
+    meta: Allocator = std.heap.page_allocator,
+    sites: std.AutoHashMapUnmanaged(SiteKey, Site) = .{},
+    /// allocations not yet freed, by address.
+    live: std.AutoHashMapUnmanaged(usize, Live) = .{},
+    /// allocations left out for lack of bookkeeping memory.
+    untracked: u64 = 0,
+    tags: [std.meta.fields(Tag).len]Tagged = undefined,
+
+    pub const SiteKey = struct {
+        tag: Tag,
+        addr: usize, // return address of the allocating call
+    };
+
+    pub const Site = struct {
+        count: u64 = 0, // allocations
+        bytes: u64 = 0, // allocated, including resize growth
+        live: u64 = 0, // allocations not yet freed
+        live_bytes: u64 = 0,
+        /// lifetimes of freed allocations; log2 buckets of microseconds,
+        /// the same layout as nd metrics histograms.
+        lifetime: [nbuckets]u64 = [_]u64{0} ** nbuckets,
+
+        /// returns the upper bound of the lifetime percentile, in microseconds;
+        /// null if none were freed.
+        pub fn percentile(self: Site, p: u8) ?u64 {
+            var total: u64 = 0;
+            for (self.lifetime) |n| total += n;
+            if (total == 0) {
+                return null;
+            }
+            const want = (total * p + 99) / 100;
+            var cum: u64 = 0;
+            for (self.lifetime, 0..) |n, i| {
+                cum += n;
+                if (cum >= want) {
+                    return (@as(u64, 1) << @intCast(i)) - 1;
+                }
+            }
+            unreachable;
+        }
+    };
+
+    const Live = struct {
+        site: SiteKey,
+        len: usize,
+        time_us: u64, // of the allocation; monotonic
+    };
+
+    pub fn deinit(self: *Profiler) void {
+        self.sites.deinit(self.meta);
+        self.live.deinit(self.meta);
+    }
+
+    fn recordAlloc(self: *Profiler, key: SiteKey, addr: usize, len: usize) void {
+        const now = nowUs();
+        self.mu.lock();
+        defer self.mu.unlock();
+        const res = self.sites.getOrPut(self.meta, key) catch {
+            self.untracked += 1;
+            return;
+        };
+        if (!res.found_existing) {
+            res.value_ptr.* = .{};
+        }
+        const site = res.value_ptr;
+        site.count += 1;
+        site.bytes += len;
+        self.live.put(self.meta, addr, .{ .site = key, .len = len, .time_us = now }) catch {
+            self.untracked += 1;
+            return;
+        };
+        site.live += 1;
+        site.live_bytes += len;
+    }
+
+    fn recordResize(self: *Profiler, addr: usize, new_len: usize) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        const l = self.live.getPtr(addr) orelse return;
+        const site = self.sites.getPtr(l.site) orelse return;
+        if (new_len > l.len) {
+            site.bytes += new_len - l.len;
+        }
+        site.live_bytes = site.live_bytes + new_len -| l.len;
+        l.len = new_len;
+    }
+
+    fn recordFree(self: *Profiler, addr: usize) void {
+        const now = nowUs();
+        self.mu.lock();
+        defer self.mu.unlock();
+        const kv = self.live.fetchRemove(addr) orelse return;
+        const site = self.sites.getPtr(kv.value.site) orelse return;
+        site.live -|= 1;
+        site.live_bytes -|= kv.value.len;
+        const us = now -| kv.value.time_us;
+        site.lifetime[@min(nbuckets - 1, 64 - @as(usize, @clz(us)))] += 1;
+    }
+
+    const Entry = struct { key: SiteKey, site: Site };
+
+    /// writes up to max_dump sites with the most bytes allocated to w.
+    pub fn dump(self: *Profiler, w: anytype) !void {
+        // copy out under the lock so that allocations don't wait for w.
+        var top: [max_dump]Entry = undefined;
+        var n: usize = 0;
+        var nsites: usize = 0;
+        var untracked: u64 = 0;
+        {
+            self.mu.lock();
+            defer self.mu.unlock();
+            nsites = self.sites.count();
+            untracked = self.untracked;
+            var it = self.sites.iterator();
+            while (it.next()) |kv| {
+                const e = Entry{ .key = kv.key_ptr.*, .site = kv.value_ptr.* };
+                if (n < top.len) {
+                    top[n] = e;
+                    n += 1;
+                    continue;
+                }
+                // replace the lightest one.
+                var min: usize = 0;
+                for (top[1..], 1..) |x, i| {
+                    if (x.site.bytes < top[min].site.bytes) {
+                        min = i;
+                    }
+                }
+                if (e.site.bytes > top[min].site.bytes) {
+                    top[min] = e;
+                }
+            }
+        }
+        std.mem.sort(Entry, top[0..n], {}, heavier);
+
+        try w.print("allocprof: dump start; {d} sites, {d} allocations untracked\n", .{ nsites, untracked });
+        for (top[0..n]) |e| {
+            try w.print("allocprof: {s} 0x{x}: {d} allocs, {d} bytes; {d} live, {d} bytes", .{
+                @tagName(e.key.tag),
+                e.key.addr,
+                e.site.count,
+                e.site.bytes,
+                e.site.live,
+                e.site.live_bytes,
+            });
+            if (e.site.percentile(50)) |p50| {
+                try w.print("; lifetime p50 {d}us, p99 {d}us", .{ p50, e.site.percentile(99).? });
+            }
+            try w.writeByte('\n');
+        }
+        try w.writeAll("allocprof: dump end\n");
+    }
+
+    fn heavier(_: void, a: Entry, b: Entry) bool {
+        return a.site.bytes > b.site.bytes;
+    }
+};
+
+fn nowUs() u64 {
+    var ts: posix.timespec = undefined;
+    posix.clock_gettime(posix.CLOCK.MONOTONIC, &ts) catch return 0;
+    return @as(u64, @intCast(ts.tv_sec)) * std.time.us_per_s + @as(u64, @intCast(ts.tv_nsec)) / std.time.ns_per_us;
+}
+
+test "profiler" {
+    const t = std.testing;
+    const tt = @import("test.zig");
+
+    var prof = Profiler{ .meta = t.allocator };
+    defer prof.deinit();
+    var tg = Tagged{ .prof = &prof, .tag = .comm, .child = t.allocator };
+    const a = tg.allocator();
+
+    var bufs: [3][]u8 = undefined;
+    for (&bufs) |*b| {
+        b.* = try a.alloc(u8, 100);
+    }
+    const other = try a.alloc(u8, 10);
+    defer a.free(other);
+    for (bufs[0..2]) |b| {
+        a.free(b);
+    }
+    try t.expectEqual(@as(usize, 2), prof.sites.count());
+    var it = prof.sites.iterator();
+    while (it.next()) |kv| {
+        try t.expectEqual(Tag.comm, kv.key_ptr.tag);
+        const s = kv.value_ptr.*;
+        if (s.count == 3) {
+            try t.expectEqual(@as(u64, 300), s.bytes);
+            try t.expectEqual(@as(u64, 1), s.live);
+            try t.expectEqual(@as(u64, 100), s.live_bytes);
+            try t.expect(s.percentile(50) != null);
+        } else {
+            try t.expectEqual(@as(u64, 1), s.count);
+            try t.expect(s.percentile(50) == null);
+        }
+    }
+    a.free(bufs[2]);
+
+    var out = std.ArrayList(u8).init(t.allocator);
+    defer out.deinit();
+    try prof.dump(out.writer());
+    try tt.expectSubstring("allocprof: dump start; 2 sites, 0 allocations untracked\n", out.items);
+    try tt.expectSubstring(": 3 allocs, 300 bytes; 0 live, 0 bytes; lifetime p50 ", out.items);
+    try tt.expectSubstring(": 1 allocs, 10 bytes; 1 live, 10 bytes\n", out.items);
+
+    var lt = Profiler.Site{};
+    lt.lifetime[3] = 98;
+    lt.lifetime[10] = 2;
+    try t.expectEqual(@as(?u64, 7), lt.percentile(50));
+    try t.expectEqual(@as(?u64, 1023), lt.percentile(99));
+}
@@ -1,10 +1,12 @@
-//! a bitcoin core RPC client.
+//! a bitcoin core RPC client, with a few REST endpoints on the side.
 
 const std = @import("std");
 const ArenaAllocator = std.heap.ArenaAllocator;
 const Atomic = std.atomic.Value;
+const Sha256 = std.crypto.hash.sha2.Sha256;
 const base64enc = std.base64.standard.Encoder;
 
+const deadline = @import("deadline.zig");
 const types = @import("types.zig");
 
 pub const Client = struct {
@@ -12,15 +14,76 @@ pub const Client = struct {
     cookiepath: []const u8,
     addr: []const u8 = "127.0.0.1",
     port: u16 = 8332,
+    /// use HTTP/1.1 persistent connections, reusing them across calls.
+    /// otherwise, each call opens a new connection and closes it upon return.
+    /// keep-alive clients must be deinit'ed to close idle connections.
+    keepalive: bool = false,
+    /// max response body size; larger responses fail with error.StreamTooLong.
+    /// bodies are parsed as they stream in, never buffered in whole.
+    max_body_size: usize = 1 << 20,
+    /// notified upon completion of each call, for example to collect latency
+    /// metrics. must be safe for concurrent use as the client is.
+    observer: ?Observer = null,
+    /// call results take their arenas from the pool, if set. the pool must
+    /// outlive the results.
+    arena_pool: ?*types.ArenaPool = null,
+    /// bitcoind serves the REST interface, enabled with rest=1 in its config.
+    /// the rest functions don't check it: callers do, to pick them over RPC.
+    rest: bool = false,
+    /// connecting to bitcoind takes this long at most. calls are otherwise
+    /// bounded only by the deadline of the calling thread, if any: see deadline.zig.
+    connect_timeout_ms: u32 = 5 * std.time.ms_per_s,
 
     // each request gets a new ID with a value of reqid.fetchAdd(1, .monotonic)
     reqid: Atomic(u64) = Atomic(u64).init(1),
 
+    /// guards all fields below.
+    mu: std.Thread.Mutex = .{},
+    /// idle keep-alive connections ready for reuse; only the first nidle are valid.
+    idle: [max_idle_conns]std.net.Stream = undefined,
+    nidle: usize = 0,
+    /// base64 encoded cookie file content, cached until the file mtime changes.
+    auth: ?struct { mtime: i128, base64: []const u8 } = null,
+
+    /// max number of idle connections kept in the keep-alive pool.
+    const max_idle_conns = 2;
+
+    /// max number of headers bitcoind returns for a single REST request.
+    pub const max_rest_headers = 2000;
+
+    pub const Observer = struct {
+        ctx: *anyopaque,
+        /// method is null for batch calls and REST requests. ok is false if
+        /// the call failed as a whole; batch entries errors are not reported.
+        func: *const fn (ctx: *anyopaque, method: ?Method, elapsed_ns: u64, ok: bool) void,
+    };
+
     pub const Method = enum {
+        disconnectnode,
+        estimatesmartfee,
+        getblock,
         getblockchaininfo,
         getblockhash,
+        getblockheader,
+        getblockstats,
+        getchainstates,
+        getmempoolentry,
         getmempoolinfo,
+        getnettotals,
         getnetworkinfo,
+        getpeerinfo,
+        getrawmempool,
+        gettxoutsetinfo,
+        loadtxoutset,
+        savemempool,
+    };
+
+    /// errors of REST requests, from the HTTP status. a 503 during bitcoind
+    /// startup is reported as error.RpcInWarmup instead, same as RPC calls.
+    pub const RestError = error{
+        RestNotFound, // 404: unknown block or the REST interface is disabled
+        RestBadStatus, // any other non-200 status
+        InvalidRestResponse, // a body of unexpected size
     };
 
     pub const RpcError = error{
@@ -56,23 +119,91 @@ pub const Client = struct {
         RpcClientMempoolDisabled,
     };
 
+    /// errors reported for individual entries of a batch call.
+    pub const BatchError = RpcError || error{
+        OutOfMemory,
+        UnknownError,
+        NullResult,
+        MissingBatchResponse,
+        InvalidBatchResponse,
+    };
+
+    /// a return type of `callBatch`: a tuple of per-method results in the same
+    /// order as the requested methods, all sharing a single arena.
+    pub fn BatchResult(comptime methods: []const Method) type {
+        return types.Deinitable(BatchResultValue(methods));
+    }
+
+    pub fn BatchResultValue(comptime methods: []const Method) type {
+        var fields: [methods.len]type = undefined;
+        for (methods, 0..) |m, i| {
+            fields[i] = BatchError!ResultValue(m);
+        }
+        return std.meta.Tuple(&fields);
+    }
+
+    /// a tuple of method args, in the same order as methods, for `callBatch`.
+    pub fn BatchArgs(comptime methods: []const Method) type {
+        var fields: [methods.len]type = undefined;
+        for (methods, 0..) |m, i| {
+            fields[i] = MethodArgs(m);
+        }
+        return std.meta.Tuple(&fields);
+    }
+
     pub fn Result(comptime m: Method) type {
         return types.Deinitable(ResultValue(m));
     }
 
+    /// a return type of `callMany`: per-call results in the order of the args,
+    /// all sharing a single arena.
+    pub fn ManyResult(comptime m: Method) type {
+        return types.Deinitable([]const (BatchError!ResultValue(m)));
+    }
+
     pub fn ResultValue(comptime m: Method) type {
         return switch (m) {
+            .disconnectnode => void, // null result
+            .estimatesmartfee => SmartFee,
+            .getblock => BlockTxids,
             .getblockchaininfo => BlockchainInfo,
             .getblockhash => []const u8,
+            .getblockheader => BlockHeader,
+            .getblockstats => BlockStats,
+            .getchainstates => ChainStates,
+            .getmempoolentry => MempoolEntry,
             .getmempoolinfo => MempoolInfo,
+            .getnettotals => NetTotals,
             .getnetworkinfo => NetworkInfo,
+            .getpeerinfo => []const PeerInfo,
+            .getrawmempool => RawMempool,
+            .gettxoutsetinfo => TxOutSetInfo,
+            .loadtxoutset => LoadTxOutSet,
+            .savemempool => SaveMempool,
         };
     }
 
     pub fn MethodArgs(comptime m: Method) type {
         return switch (m) {
-            .getblockchaininfo, .getmempoolinfo, .getnetworkinfo => void,
+            .getblockchaininfo, .getchainstates, .getmempoolinfo, .getnettotals, .getnetworkinfo, .getpeerinfo, .savemempool => void,
             .getblockhash => struct { height: u64 },
+            // address is ignored in favor of nodeid but the two go together.
+            .disconnectnode => struct { address: []const u8 = "", nodeid: u64 },
+            .getblockheader => struct { blockhash: []const u8 }, // hex
+            // only the stats in BlockStats: some of the others cost more to compute.
+            .getblockstats => struct { hash_or_height: []const u8, stats: []const []const u8 = &BlockStats.names }, // hash hex
+            .estimatesmartfee => struct { conf_target: u16 },
+            // verbosity 1 lists txids only.
+            .getblock => struct { blockhash: []const u8, verbosity: u8 = 1 },
+            .getmempoolentry => struct { txid: []const u8 }, // hex
+            // the only non-verbose form with a sequence: txids and mempool_sequence.
+            .getrawmempool => struct { verbose: bool = false, mempool_sequence: bool = true },
+            // with no index, bitcoind flushes the chainstate to disk before
+            // walking the UTXO set; the walk takes minutes on a full node.
+            .gettxoutsetinfo => struct { hash_type: []const u8 = "none", use_index: bool = false },
+            // the file must be readable by bitcoind; the call returns once
+            // the snapshot is loaded, which may take tens of minutes.
+            .loadtxoutset => struct { path: []const u8 },
         };
     }
 
@@ -85,10 +216,16 @@ pub const Client = struct {
         };
     }
 
+    /// the JSON-RPC result field type of m: a method with no result still
+    /// needs a parseable type for its null.
+    fn ResultField(comptime m: Method) type {
+        return if (ResultValue(m) == void) std.json.Value else ResultValue(m);
+    }
+
     fn RpcResponse(comptime m: Method) type {
         return struct {
             id: u64,
-            result: ?ResultValue(m),
+            result: ?ResultField(m),
             @"error": ?struct {
                 code: isize,
                 //message: ?[]const u8, // no use for it atm
@@ -96,30 +233,480 @@ pub const Client = struct {
         };
     }
 
+    /// closes all idle keep-alive connections and releases resources.
+    /// the client can still be used afterwards.
+    pub fn deinit(self: *Client) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        for (self.idle[0..self.nidle]) |stream| {
+            stream.close();
+        }
+        self.nidle = 0;
+        if (self.auth) |a| {
+            self.allocator.free(a.base64);
+        }
+        self.auth = null;
+    }
+
     /// makes an RPC call to the addr:port endpoint.
     /// the returned value must be deinit'ed when done.
     pub fn call(self: *Client, comptime method: Method, args: MethodArgs(method)) !Result(method) {
-        const addrport = try std.net.Address.resolveIp(self.addr, self.port);
+        const start = std.time.nanoTimestamp();
+        const res = self.callUnobserved(method, args);
+        self.observe(method, start, !std.meta.isError(res));
+        return res;
+    }
+
+    fn callUnobserved(self: *Client, comptime method: Method, args: MethodArgs(method)) !Result(method) {
         const reqbytes = try self.formatreq(method, args);
         defer self.allocator.free(reqbytes);
+        var resp = try self.initResult(RpcResponse(method));
+        errdefer resp.deinit();
+        resp.value = try self.roundtrip(RpcResponse(method), .rpc, resp.arena.allocator(), reqbytes);
+        return unwrapResponse(method, resp);
+    }
+
+    /// parses body as a JSON-RPC response of method, as if it were received
+    /// from bitcoind, without any network roundtrip. meant for benchmarks and tests.
+    /// the returned value must be deinit'ed when done.
+    pub fn parseResponse(self: *Client, comptime method: Method, body: []const u8) !Result(method) {
+        var resp = try self.initResult(RpcResponse(method));
+        errdefer resp.deinit();
+        var fbs = std.io.fixedBufferStream(body);
+        resp.value = try self.parseBody(RpcResponse(method), resp.arena.allocator(), fbs.reader(), body.len);
+        return unwrapResponse(method, resp);
+    }
+
+    /// moves the result out of resp, or returns the RPC error it carries.
+    /// resp is left to the caller to deinit on error.
+    fn unwrapResponse(comptime method: Method, resp: types.Deinitable(RpcResponse(method))) !Result(method) {
+        if (resp.value.@"error") |errfield| {
+            return rpcErrorFromCode(errfield.code) orelse error.UnknownError;
+        }
+        if (comptime ResultValue(method) == void) {
+            return .{ .value = {}, .arena = resp.arena, .pool = resp.pool };
+        }
+        const result = resp.value.result orelse return error.NullResult;
+        return .{ .value = result, .arena = resp.arena, .pool = resp.pool };
+    }
+
+    fn initResult(self: *Client, comptime T: type) !types.Deinitable(T) {
+        if (self.arena_pool) |pool| {
+            return types.Deinitable(T).initPooled(pool);
+        }
+        return types.Deinitable(T).init(self.allocator);
+    }
+
+    /// makes a JSON-RPC batch call to the addr:port endpoint, sending all methods
+    /// in a single HTTP request. individual entry errors are reported in the
+    /// corresponding tuple fields of the returned value, while a returned error
+    /// indicates the whole batch failed.
+    /// the returned value must be deinit'ed when done.
+    pub fn callBatch(self: *Client, comptime methods: []const Method, args: BatchArgs(methods)) !BatchResult(methods) {
+        const start = std.time.nanoTimestamp();
+        const res = self.callBatchUnobserved(methods, args);
+        self.observe(null, start, !std.meta.isError(res));
+        return res;
+    }
+
+    fn callBatchUnobserved(self: *Client, comptime methods: []const Method, args: BatchArgs(methods)) !BatchResult(methods) {
+        var ids: [methods.len]u64 = undefined;
+        var jreq = std.ArrayList(u8).init(self.allocator);
+        defer jreq.deinit();
+        const jw = jreq.writer();
+        try jw.writeByte('[');
+        inline for (methods, 0..) |m, i| {
+            if (i > 0) {
+                try jw.writeByte(',');
+            }
+            ids[i] = self.reqid.fetchAdd(1, .monotonic);
+            const req = RpcRequest(m){
+                .id = ids[i],
+                .method = @tagName(m),
+                .params = args[i],
+            };
+            try std.json.stringify(req, .{}, jw);
+        }
+        try jw.writeByte(']');
+
+        const reqbytes = try self.formathttp(jreq.items);
+        defer self.allocator.free(reqbytes);
+        var res = try self.initResult(BatchResultValue(methods));
+        errdefer res.deinit();
+        const arena = res.arena.allocator();
+        const entries = try self.roundtrip([]std.json.Value, .rpc, arena, reqbytes);
+        inline for (methods, 0..) |m, i| {
+            res.value[i] = parseBatchEntry(m, arena, entries, ids[i]);
+        }
+        return res;
+    }
+
+    /// makes a JSON-RPC batch call of the same method with each of args, in a
+    /// single HTTP request. errors are reported as in `callBatch`.
+    /// the returned value must be deinit'ed when done.
+    pub fn callMany(self: *Client, comptime method: Method, args: []const MethodArgs(method)) !ManyResult(method) {
+        const start = std.time.nanoTimestamp();
+        const res = self.callManyUnobserved(method, args);
+        self.observe(null, start, !std.meta.isError(res));
+        return res;
+    }
+
+    fn callManyUnobserved(self: *Client, comptime method: Method, args: []const MethodArgs(method)) !ManyResult(method) {
+        var jreq = std.ArrayList(u8).init(self.allocator);
+        defer jreq.deinit();
+        const jw = jreq.writer();
+        try jw.writeByte('[');
+        const first_id = self.reqid.fetchAdd(args.len, .monotonic);
+        for (args, 0..) |a, i| {
+            if (i > 0) {
+                try jw.writeByte(',');
+            }
+            const req = RpcRequest(method){
+                .id = first_id + i,
+                .method = @tagName(method),
+                .params = a,
+            };
+            try std.json.stringify(req, .{}, jw);
+        }
+        try jw.writeByte(']');
+
+        const reqbytes = try self.formathttp(jreq.items);
+        defer self.allocator.free(reqbytes);
+        var res = try self.initResult([]const (BatchError!ResultValue(method)));
+        errdefer res.deinit();
+        const arena = res.arena.allocator();
+        const entries = try self.roundtrip([]std.json.Value, .rpc, arena, reqbytes);
+        const values = try arena.alloc(BatchError!ResultValue(method), args.len);
+        for (values, 0..) |*v, i| {
+            v.* = parseBatchEntry(method, arena, entries, first_id + i);
+        }
+        res.value = values;
+        return res;
+    }
+
+    /// fetches the headers of up to out.len blocks of the active chain over
+    /// the REST interface, starting at the block start and going towards the tip.
+    /// returns the filled part of out; shorter if the tip is nearer. at most
+    /// max_rest_headers are fetched in one request.
+    pub fn restHeaders(self: *Client, start: types.Hash, out: []RawBlockHeader) ![]RawBlockHeader {
+        const t0 = std.time.nanoTimestamp();
+        const res = self.restHeadersUnobserved(start, out);
+        self.observe(null, t0, !std.meta.isError(res));
+        return res;
+    }
+
+    fn restHeadersUnobserved(self: *Client, start: types.Hash, out: []RawBlockHeader) ![]RawBlockHeader {
+        const count = @min(out.len, max_rest_headers);
+        var pathbuf: [128]u8 = undefined;
+        const path = try std.fmt.bufPrint(&pathbuf, "/rest/headers/{}.bin?count={d}", .{ start, count });
+        var arena_state = ArenaAllocator.init(self.allocator);
+        defer arena_state.deinit();
+        const body = try self.restGet(arena_state.allocator(), path);
+        if (body.len % RawBlockHeader.size != 0 or body.len / RawBlockHeader.size > count) {
+            return error.InvalidRestResponse;
+        }
+        const n = body.len / RawBlockHeader.size;
+        for (out[0..n], 0..) |*h, i| {
+            h.* = RawBlockHeader.decode(body[i * RawBlockHeader.size ..][0..RawBlockHeader.size]);
+        }
+        return out[0..n];
+    }
+
+    /// returns the hash of the active chain block at height, over the REST
+    /// interface. a height above the tip fails with error.RestNotFound.
+    pub fn restBlockHash(self: *Client, height: u64) !types.Hash {
+        const t0 = std.time.nanoTimestamp();
+        const res = self.restBlockHashUnobserved(height);
+        self.observe(null, t0, !std.meta.isError(res));
+        return res;
+    }
+
+    fn restBlockHashUnobserved(self: *Client, height: u64) !types.Hash {
+        var pathbuf: [64]u8 = undefined;
+        const path = try std.fmt.bufPrint(&pathbuf, "/rest/blockhashbyheight/{d}.bin", .{height});
+        var arena_state = ArenaAllocator.init(self.allocator);
+        defer arena_state.deinit();
+        const body = try self.restGet(arena_state.allocator(), path);
+        if (body.len != 32) {
+            return error.InvalidRestResponse;
+        }
+        return reversedHash(body[0..32]);
+    }
+
+    /// same as getblockchaininfo but over the REST interface, with no auth
+    /// and no JSON-RPC envelope around the result.
+    /// the returned value must be deinit'ed when done.
+    pub fn restChainInfo(self: *Client) !types.Deinitable(BlockchainInfo) {
+        const t0 = std.time.nanoTimestamp();
+        const res = self.restChainInfoUnobserved();
+        self.observe(null, t0, !std.meta.isError(res));
+        return res;
+    }
+
+    fn restChainInfoUnobserved(self: *Client) !types.Deinitable(BlockchainInfo) {
+        const reqbytes = try self.formatget("/rest/chaininfo.json");
+        defer self.allocator.free(reqbytes);
+        var res = try self.initResult(BlockchainInfo);
+        errdefer res.deinit();
+        res.value = try self.roundtrip(BlockchainInfo, .rest, res.arena.allocator(), reqbytes);
+        return res;
+    }
+
+    /// makes a REST GET request of path, returning the raw response body
+    /// allocated in arena.
+    fn restGet(self: *Client, arena: std.mem.Allocator, path: []const u8) ![]const u8 {
+        const reqbytes = try self.formatget(path);
+        defer self.allocator.free(reqbytes);
+        return self.roundtrip([]const u8, .rest, arena, reqbytes);
+    }
+
+    fn observe(self: *Client, method: ?Method, start: i128, ok: bool) void {
+        const o = self.observer orelse return;
+        o.func(o.ctx, method, std.math.lossyCast(u64, std.time.nanoTimestamp() - start), ok);
+    }
+
+    /// finds a response matching the request id and parses its result.
+    /// the server may respond with batch entries in any order.
+    fn parseBatchEntry(comptime m: Method, arena: std.mem.Allocator, entries: []const std.json.Value, id: u64) BatchError!ResultValue(m) {
+        for (entries) |v| {
+            if (v != .object) {
+                continue;
+            }
+            const idval = v.object.get("id") orelse continue;
+            if (idval != .integer or idval.integer != id) {
+                continue;
+            }
+            // strings of v are in arena already: borrowed, not copied.
+            const resp = std.json.parseFromValueLeaky(RpcResponse(m), arena, v, .{
+                .ignore_unknown_fields = true,
+                .allocate = .alloc_if_needed,
+            }) catch |err| {
+                return if (err == error.OutOfMemory) error.OutOfMemory else error.InvalidBatchResponse;
+            };
+            if (resp.@"error") |errfield| {
+                return rpcErrorFromCode(errfield.code) orelse error.UnknownError;
+            }
+            if (comptime ResultValue(m) == void) {
+                return;
+            }
+            return resp.result orelse error.NullResult;
+        }
+        return error.MissingBatchResponse;
+    }
+
+    /// sends raw request bytes and parses the JSON response body as T,
+    /// allocating the value in arena; see parseBody. REST responses must
+    /// be 200 OK, while RPC errors come with any status and are in the body.
+    /// in keep-alive mode, an idle connection is tried first. if it turns out
+    /// to be stale, for example due to bitcoind restart, the request is retried
+    /// once over a new connection.
+    /// a call past the thread deadline fails with error.DeadlineExceeded.
+    fn roundtrip(self: *Client, comptime T: type, comptime api: Api, arena: std.mem.Allocator, reqbytes: []const u8) !T {
+        const d = deadline.get();
+        return self.roundtripDeadline(T, api, arena, reqbytes, d) catch |err| {
+            return if (deadline.exceeded(d)) error.DeadlineExceeded else err;
+        };
+    }
+
+    fn roundtripDeadline(self: *Client, comptime T: type, comptime api: Api, arena: std.mem.Allocator, reqbytes: []const u8, d: ?i64) !T {
+        if (!self.keepalive) {
+            const stream = try self.connect();
+            defer stream.close();
+            if (d != null) {
+                try deadline.setSocketTimeout(stream.handle, d);
+            }
+            try stream.writer().writeAll(reqbytes);
+            var dr = deadline.reader(stream.reader(), d);
+            var br = std.io.bufferedReader(dr.reader());
+            const head = try readResponseHead(br.reader(), 4096);
+            if (api == .rest) {
+                try restStatus(head.status);
+            }
+            var body = bodyReader(br.reader(), self.max_body_size, .until_close);
+            return self.parseBody(T, arena, body.reader(), null);
+        }
+
+        var head_read = false;
+        if (self.takeIdle()) |stream| {
+            if (self.exchange(T, api, arena, stream, reqbytes, d, &head_read)) |v| {
+                return v;
+            } else |err| {
+                if (head_read or err == error.OutOfMemory or deadline.exceeded(d)) {
+                    return err; // the server did respond, out of memory or time: not stale
+                }
+                // most likely a stale connection; retry below
+            }
+        }
+        head_read = false;
+        return self.exchange(T, api, arena, try self.connect(), reqbytes, d, &head_read);
+    }
+
+    const Api = enum { rpc, rest };
+
+    fn restStatus(status: u16) (RestError || error{RpcInWarmup})!void {
+        return switch (status) {
+            200 => {},
+            404 => error.RestNotFound,
+            503 => error.RpcInWarmup,
+            else => error.RestBadStatus,
+        };
+    }
+
+    /// performs a single request-response over a keep-alive connection, parsing
+    /// the response body as T. head_read is set once response headers are received.
+    /// the stream is returned to the idle pool on success, as long as the server
+    /// allows it, and closed otherwise. reads and writes are bounded by d, if set.
+    fn exchange(
+        self: *Client,
+        comptime T: type,
+        comptime api: Api,
+        arena: std.mem.Allocator,
+        stream: std.net.Stream,
+        reqbytes: []const u8,
+        d: ?i64,
+        head_read: *bool,
+    ) !T {
+        var reuse = false;
+        defer if (!reuse) stream.close();
+
+        if (d != null) {
+            try deadline.setSocketTimeout(stream.handle, d);
+        }
+        try stream.writer().writeAll(reqbytes);
+        var dr = deadline.reader(stream.reader(), d);
+        var br = std.io.bufferedReader(dr.reader());
+        const head = try readResponseHead(br.reader(), 4096);
+        head_read.* = true;
+        if (api == .rest) {
+            try restStatus(head.status); // the body is left unread: not reused
+        }
+        var body = blk: {
+            const len = head.content_length orelse {
+                // no way to find body end other than reading until connection close.
+                break :blk bodyReader(br.reader(), self.max_body_size, .until_close);
+            };
+            if (len > self.max_body_size) {
+                return error.StreamTooLong;
+            }
+            break :blk bodyReader(br.reader(), len, .exact);
+        };
+        const v = try self.parseBody(T, arena, body.reader(), head.content_length);
+        // any leftover bytes mean the stream is out of sync: don't reuse it.
+        reuse = head.content_length != null and !head.close and body.left == 0 and br.start == br.end;
+        if (reuse and d != null) {
+            // idle connections are reused by calls of no deadline, too.
+            deadline.setSocketTimeout(stream.handle, null) catch {
+                reuse = false;
+            };
+        }
+        if (reuse) {
+            reuse = self.putIdle(stream);
+        }
+        return v;
+    }
+
+    /// reads a JSON document of len bytes, or until the end of r if null, into
+    /// arena and parses it as T. the document stays in arena, next to the value:
+    /// strings borrow from it, and only those with escapes are allocated anew.
+    /// a T of []const u8 is the body as is, for REST binary responses.
+    fn parseBody(self: Client, comptime T: type, arena: std.mem.Allocator, r: anytype, len: ?usize) !T {
+        const body = if (len) |n| blk: {
+            const b = try arena.alloc(u8, n);
+            try r.readNoEof(b);
+            break :blk b;
+        } else try r.readAllAlloc(arena, self.max_body_size);
+        if (T == []const u8) {
+            return body;
+        }
+        return std.json.parseFromSliceLeaky(T, arena, body, .{
+            .ignore_unknown_fields = true,
+            .allocate = .alloc_if_needed,
+        });
+    }
+
+    fn connect(self: Client) !std.net.Stream {
+        const addrport = try std.net.Address.resolveIp(self.addr, self.port);
+        return deadline.tcpConnect(addrport, deadline.within(self.connect_timeout_ms));
+    }
+
+    fn takeIdle(self: *Client) ?std.net.Stream {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.nidle == 0) {
+            return null;
+        }
+        self.nidle -= 1;
+        return self.idle[self.nidle];
+    }
 
-        // connect and send the request
-        const stream = try std.net.tcpConnectToAddress(addrport);
-        defer stream.close();
-        const reader = stream.reader();
-        _ = try stream.writer().writeAll(reqbytes);
+    /// reports whether the stream is placed in the idle pool.
+    fn putIdle(self: *Client, stream: std.net.Stream) bool {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.nidle == self.idle.len) {
+            return false;
+        }
+        self.idle[self.nidle] = stream;
+        self.nidle += 1;
+        return true;
+    }
 
-        // read and parse the response
-        try skipResponseHeaders(reader, 4096);
-        const body = try reader.readAllAlloc(self.allocator, 1 << 20); // 1Mb should be enough for all response types
-        defer self.allocator.free(body);
-        return self.parseResponse(method, body);
+    /// a reader of HTTP response body, at most limit bytes of the underlying reader r.
+    /// in .exact mode the body is exactly limit bytes long, as per content-length.
+    /// in .until_close mode the body ends at the stream end, and reads past
+    /// the limit fail with error.StreamTooLong.
+    fn bodyReader(r: anytype, limit: usize, mode: BodyEnd) BodyReader(@TypeOf(r)) {
+        return .{ .inner = r, .left = limit, .mode = mode };
     }
 
-    /// reads all response headers, at most `limit` bytes, and returns the index
-    /// at which response body starts or error.EndOfStream.
+    const BodyEnd = enum { exact, until_close };
+
+    fn BodyReader(comptime R: type) type {
+        return struct {
+            inner: R,
+            left: usize, // bytes until limit
+            mode: BodyEnd,
+
+            const Self = @This();
+            pub const Error = R.Error || error{StreamTooLong};
+            pub const Reader = std.io.Reader(*Self, Error, read);
+
+            pub fn reader(self: *Self) Reader {
+                return .{ .context = self };
+            }
+
+            fn read(self: *Self, buf: []u8) Error!usize {
+                if (self.left == 0) {
+                    if (self.mode == .exact) {
+                        return 0;
+                    }
+                    var probe: [1]u8 = undefined;
+                    if (try self.inner.read(&probe) == 0) {
+                        return 0;
+                    }
+                    return error.StreamTooLong;
+                }
+                const n = try self.inner.read(buf[0..@min(buf.len, self.left)]);
+                self.left -= n;
+                return n;
+            }
+        };
+    }
+
+    const ResponseHead = struct {
+        status: u16 = 0, // 0 if the status line is malformed
+        content_length: ?usize = null,
+        /// whether the server closes the connection after the response.
+        close: bool = false,
+    };
+
+    /// reads all response headers, at most `limit` bytes, leaving the reader
+    /// at the position where response body starts. returns error.EndOfStream
+    /// if the stream ends before the headers.
     /// single header length must be at most `limit` or 1024, whichever is smaller.
-    fn skipResponseHeaders(r: anytype, comptime limit: usize) !void {
+    fn readResponseHead(r: anytype, comptime limit: usize) !ResponseHead {
+        var head: ResponseHead = .{};
+        var status_line = true;
         var n: usize = 0;
         var buf: [@min(1024, limit)]u8 = undefined;
         while (true) {
@@ -128,28 +715,34 @@ pub const Client = struct {
             if (n > limit) {
                 return error.StreamTooLong;
             }
-            if (slice.len == 0 or (slice.len == 1 and slice[0] == '\r')) {
-                return;
+            const line = std.mem.trimRight(u8, slice, "\r");
+            if (line.len == 0) {
+                return head;
+            }
+            if (status_line) {
+                // HTTP/1.0 servers close connections by default.
+                head.close = std.mem.startsWith(u8, line, "HTTP/1.0");
+                var it = std.mem.tokenizeScalar(u8, line, ' ');
+                _ = it.next(); // version
+                head.status = std.fmt.parseUnsigned(u16, it.next() orelse "", 10) catch 0;
+                status_line = false;
+                continue;
+            }
+            const colon = std.mem.indexOfScalar(u8, line, ':') orelse continue;
+            const name = line[0..colon];
+            const value = std.mem.trim(u8, line[colon + 1 ..], " \t");
+            if (std.ascii.eqlIgnoreCase(name, "content-length")) {
+                head.content_length = try std.fmt.parseUnsigned(usize, value, 10);
+            } else if (std.ascii.eqlIgnoreCase(name, "connection")) {
+                if (std.ascii.eqlIgnoreCase(value, "close")) {
+                    head.close = true;
+                } else if (std.ascii.eqlIgnoreCase(value, "keep-alive")) {
+                    head.close = false;
+                }
             }
         }
     }
 
-    fn parseResponse(self: Client, comptime m: Method, b: []const u8) !Result(m) {
-        var resp = try types.Deinitable(RpcResponse(m)).init(self.allocator);
-        errdefer resp.deinit();
-        resp.value = try std.json.parseFromSliceLeaky(RpcResponse(m), resp.arena.allocator(), b, .{
-            .ignore_unknown_fields = true,
-            .allocate = .alloc_always,
-        });
-        if (resp.value.@"error") |errfield| {
-            return rpcErrorFromCode(errfield.code) orelse error.UnknownError;
-        }
-        if (resp.value.result == null) {
-            return error.NullResult;
-        }
-        return .{ .value = resp.value.result.?, .arena = resp.arena };
-    }
-
     /// callers own returned value.
     fn formatreq(self: *Client, comptime m: Method, args: MethodArgs(m)) ![]const u8 {
         const req = RpcRequest(m){
@@ -160,31 +753,77 @@ pub const Client = struct {
         var jreq = std.ArrayList(u8).init(self.allocator);
         defer jreq.deinit();
         try std.json.stringify(req, .{}, jreq.writer());
+        return self.formathttp(jreq.items);
+    }
 
+    /// wraps JSON-RPC request body in an HTTP request.
+    /// callers own returned value.
+    fn formathttp(self: *Client, jreq: []const u8) ![]const u8 {
         const auth = try self.getAuthBase64();
         defer self.allocator.free(auth);
 
         var bytes = std.ArrayList(u8).init(self.allocator); // return value as owned slice
+        errdefer bytes.deinit();
         const w = bytes.writer();
-        try w.writeAll("POST / HTTP/1.0\r\n");
-        //try w.writeAll("Host: 127.0.0.1\n", .{});
-        try w.writeAll("Connection: close\r\n");
+        if (self.keepalive) {
+            try w.writeAll("POST / HTTP/1.1\r\n");
+            try w.print("Host: {s}\r\n", .{self.addr});
+        } else {
+            try w.writeAll("POST / HTTP/1.0\r\n");
+            try w.writeAll("Connection: close\r\n");
+        }
         try w.print("Authorization: Basic {s}\r\n", .{auth});
         try w.writeAll("Accept: application/json-rpc\r\n");
         try w.writeAll("Content-Type: application/json-rpc\r\n");
-        try w.print("Content-Length: {d}\r\n", .{jreq.items.len});
+        try w.print("Content-Length: {d}\r\n", .{jreq.len});
+        try w.writeAll("\r\n");
+        try w.writeAll(jreq);
+        return try bytes.toOwnedSlice();
+    }
+
+    /// formats a REST GET request of path. unlike RPC, REST takes no auth.
+    /// callers own returned value.
+    fn formatget(self: *Client, path: []const u8) ![]const u8 {
+        var bytes = std.ArrayList(u8).init(self.allocator); // return value as owned slice
+        errdefer bytes.deinit();
+        const w = bytes.writer();
+        if (self.keepalive) {
+            try w.print("GET {s} HTTP/1.1\r\n", .{path});
+            try w.print("Host: {s}\r\n", .{self.addr});
+        } else {
+            try w.print("GET {s} HTTP/1.0\r\n", .{path});
+            try w.writeAll("Connection: close\r\n");
+        }
         try w.writeAll("\r\n");
-        try w.writeAll(jreq.items);
         return try bytes.toOwnedSlice();
     }
 
-    fn getAuthBase64(self: Client) ![]const u8 {
+    /// returns base64 encoded cookie file content. the file is re-read only
+    /// when its mtime changes, which is the case when bitcoind restarts.
+    /// callers own returned value.
+    fn getAuthBase64(self: *Client) ![]const u8 {
+        const stat = try std.fs.cwd().statFile(self.cookiepath);
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.auth) |a| {
+            if (a.mtime == stat.mtime) {
+                return self.allocator.dupe(u8, a.base64);
+            }
+        }
+
         const file = try std.fs.openFileAbsolute(self.cookiepath, .{ .mode = .read_only });
         defer file.close();
         const cookie = try file.readToEndAlloc(self.allocator, 1024);
         defer self.allocator.free(cookie);
         const auth = try self.allocator.alloc(u8, base64enc.calcSize(cookie.len));
-        return base64enc.encode(auth, cookie);
+        errdefer self.allocator.free(auth);
+        _ = base64enc.encode(auth, cookie);
+        const res = try self.allocator.dupe(u8, auth);
+        if (self.auth) |a| {
+            self.allocator.free(a.base64);
+        }
+        self.auth = .{ .mtime = stat.mtime, .base64 = auth };
+        return res;
     }
 
     // taken from bitcoind source code.
@@ -230,7 +869,7 @@ pub const BlockchainInfo = struct {
     chain: []const u8,
     blocks: u64,
     headers: u64,
-    bestblockhash: []const u8,
+    bestblockhash: types.Hash,
     difficulty: f64,
     time: u64, // block time, unix epoch
     mediantime: u64, // median block time, unix epoch
@@ -244,6 +883,131 @@ pub const BlockchainInfo = struct {
     warnings: []const u8,
 };
 
+/// a block header; only the fields in use.
+pub const BlockHeader = struct {
+    hash: types.Hash,
+    height: u64,
+    previousblockhash: ?types.Hash = null, // missing in the genesis block
+};
+
+/// a block header as serialized in blocks and REST .bin responses: 80 bytes
+/// of little endian fields, hashes in internal byte order.
+pub const RawBlockHeader = struct {
+    version: i32,
+    prev: types.Hash, // all zeros in the genesis block
+    merkle_root: types.Hash,
+    time: u32, // unix epoch
+    bits: u32,
+    nonce: u32,
+    hash: types.Hash, // double sha256 of the serialized header
+
+    pub const size = 80;
+
+    pub fn decode(b: *const [size]u8) RawBlockHeader {
+        var d1: [Sha256.digest_length]u8 = undefined;
+        Sha256.hash(b, &d1, .{});
+        var d2: [Sha256.digest_length]u8 = undefined;
+        Sha256.hash(&d1, &d2, .{});
+        return .{
+            .version = std.mem.readInt(i32, b[0..4], .little),
+            .prev = reversedHash(b[4..36]),
+            .merkle_root = reversedHash(b[36..68]),
+            .time = std.mem.readInt(u32, b[68..72], .little),
+            .bits = std.mem.readInt(u32, b[72..76], .little),
+            .nonce = std.mem.readInt(u32, b[76..80], .little),
+            .hash = reversedHash(&d2),
+        };
+    }
+
+    /// the parent hash, unless it's the genesis block.
+    pub fn parent(self: RawBlockHeader) ?types.Hash {
+        return if (std.mem.allEqual(u8, &self.prev.bytes, 0)) null else self.prev;
+    }
+};
+
+/// converts a hash in internal byte order to the hex order of types.Hash.
+fn reversedHash(b: *const [32]u8) types.Hash {
+    var h = types.Hash{ .bytes = b.* };
+    std.mem.reverse(u8, &h.bytes);
+    return h;
+}
+
+/// getblockstats result. fee rates exclude the coinbase and are 0 in a block
+/// with no other transactions.
+pub const BlockStats = struct {
+    blockhash: types.Hash,
+    height: u64,
+    time: u64, // unix epoch
+    txs: u32, // including the coinbase
+    minfeerate: u32, // sat/vB
+    maxfeerate: u32, // sat/vB
+    total_size: u64, // bytes, all transactions but the coinbase
+
+    /// stats names requested from bitcoind.
+    pub const names = [_][]const u8{ "blockhash", "height", "time", "txs", "minfeerate", "maxfeerate", "total_size" };
+};
+
+/// chainstates of an assumeutxo node; bitcoind v26 and newer.
+pub const ChainStates = struct {
+    headers: u64,
+    /// the fully validated chainstate first, if any, and the active one last.
+    /// a single one once the snapshot is validated.
+    chainstates: []const struct {
+        blocks: u64,
+        bestblockhash: types.Hash,
+        verificationprogress: f32, // estimate in [0..1]
+        snapshot_blockhash: ?types.Hash = null, // set if loaded from a snapshot
+        validated: bool,
+    },
+};
+
+/// estimatesmartfee result. feerate is missing while bitcoind has too little
+/// data, such as in initial block download.
+pub const SmartFee = struct {
+    feerate: ?f64 = null, // BTC/kvB
+    blocks: u32, // target the estimate is for
+};
+
+/// getblock result at verbosity 1; only the fields in use.
+pub const BlockTxids = struct {
+    hash: types.Hash,
+    tx: []const []const u8, // txids, hex
+};
+
+/// getmempoolentry result; only the fields in use.
+pub const MempoolEntry = struct {
+    vsize: u64,
+    fees: struct {
+        base: f64, // BTC
+    },
+};
+
+/// getrawmempool result with mempool_sequence.
+pub const RawMempool = struct {
+    txids: []const []const u8, // hex
+    /// the mempool sequence number as of the txids list, for syncing with
+    /// ZMQ sequence notifications.
+    mempool_sequence: u64,
+};
+
+/// gettxoutsetinfo result; only the fields in use.
+pub const TxOutSetInfo = struct {
+    height: u64,
+    txouts: u64, // unspent outputs
+};
+
+/// savemempool result.
+pub const SaveMempool = struct {
+    filename: []const u8, // mempool.dat path
+};
+
+/// loadtxoutset result.
+pub const LoadTxOutSet = struct {
+    coins_loaded: u64,
+    tip_hash: types.Hash,
+    base_height: u64,
+};
+
 pub const MempoolInfo = struct {
     loaded: bool, // whether the mempool is fully loaded
     size: usize, // tx count
@@ -280,3 +1044,214 @@ pub const NetworkInfo = struct {
     },
     warnings: []const u8,
 };
+
+/// p2p traffic since bitcoind started, in bytes; only the fields in use.
+pub const NetTotals = struct {
+    totalbytesrecv: u64,
+    totalbytessent: u64,
+};
+
+/// a connected peer; only the fields in use.
+pub const PeerInfo = struct {
+    id: u64,
+    addr: []const u8, // ip:port
+    inbound: bool,
+    /// outbound-full-relay, block-relay-only, inbound, manual, addr-fetch or feeler.
+    connection_type: []const u8 = "",
+    conntime: i64 = 0, // unix time of the connection
+    last_block: i64 = 0, // unix time of the last block received from the peer; 0 if none
+    /// heights of the blocks requested from the peer, not yet received.
+    inflight: []const u64 = &.{},
+    bytesrecv_per_msg: struct {
+        block: u64 = 0,
+    } = .{},
+};
+
+test "readResponseHead" {
+    const t = std.testing;
+
+    {
+        var fbs = std.io.fixedBufferStream("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 13\r\n\r\n{\"result\":1}");
+        const head = try Client.readResponseHead(fbs.reader(), 4096);
+        try t.expectEqual(@as(u16, 200), head.status);
+        try t.expectEqual(@as(?usize, 13), head.content_length);
+        try t.expect(!head.close);
+        var rest: [32]u8 = undefined;
+        const n = try fbs.reader().readAll(&rest);
+        try t.expectEqualStrings("{\"result\":1}", rest[0..n]);
+    }
+    {
+        var fbs = std.io.fixedBufferStream("HTTP/1.1 200 OK\r\nconnection: close\r\n\r\n");
+        const head = try Client.readResponseHead(fbs.reader(), 4096);
+        try t.expectEqual(@as(?usize, null), head.content_length);
+        try t.expect(head.close);
+    }
+    {
+        var fbs = std.io.fixedBufferStream("HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n");
+        const head = try Client.readResponseHead(fbs.reader(), 4096);
+        try t.expect(head.close);
+    }
+    {
+        var fbs = std.io.fixedBufferStream("HTTP/1.1 404 Not Found\r\n\r\n");
+        const head = try Client.readResponseHead(fbs.reader(), 4096);
+        try t.expectEqual(@as(u16, 404), head.status);
+    }
+    {
+        var fbs = std.io.fixedBufferStream("HTTP/1.1 200 OK\r\n");
+        try t.expectError(error.EndOfStream, Client.readResponseHead(fbs.reader(), 4096));
+    }
+}
+
+test "RawBlockHeader" {
+    const t = std.testing;
+    const xfmt = @import("xfmt.zig");
+
+    const genesis = try xfmt.parseHex(80, "0100000000000000000000000000000000000000000000000000000000000000000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a29ab5f49ffff001d1dac2b7c");
+    const h = RawBlockHeader.decode(&genesis);
+    try t.expectEqual(@as(i32, 1), h.version);
+    try t.expectEqual(@as(?types.Hash, null), h.parent());
+    try t.expectEqual(types.Hash.literal("4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b"), h.merkle_root);
+    try t.expectEqual(@as(u32, 1231006505), h.time);
+    try t.expectEqual(@as(u32, 0x1d00ffff), h.bits);
+    try t.expectEqual(@as(u32, 2083236893), h.nonce);
+    try t.expectEqual(types.Hash.literal("000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f"), h.hash);
+}
+
+test "bodyReader" {
+    const t = std.testing;
+    var buf: [16]u8 = undefined;
+
+    {
+        var fbs = std.io.fixedBufferStream("{\"result\":1}NEXT");
+        var body = Client.bodyReader(fbs.reader(), 12, .exact);
+        const n = try body.reader().readAll(&buf);
+        try t.expectEqualStrings("{\"result\":1}", buf[0..n]);
+        try t.expectEqual(@as(usize, 0), body.left);
+    }
+    {
+        var fbs = std.io.fixedBufferStream("{\"result\":1}");
+        var body = Client.bodyReader(fbs.reader(), 12, .until_close);
+        const n = try body.reader().readAll(&buf);
+        try t.expectEqualStrings("{\"result\":1}", buf[0..n]);
+    }
+    {
+        var fbs = std.io.fixedBufferStream("{\"result\":1}");
+        var body = Client.bodyReader(fbs.reader(), 8, .until_close);
+        try t.expectError(error.StreamTooLong, body.reader().readAll(&buf));
+    }
+    {
+        // strings borrow from the body in the arena, unless escaped.
+        var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+        defer arena_state.deinit();
+        const client = Client{ .allocator = t.allocator, .cookiepath = "" };
+        for ([_]?usize{ null, 43 }) |len| {
+            var fbs = std.io.fixedBufferStream("{\"id\": 1, \"result\": \"00ab\", \"error\": null}\n");
+            var body = Client.bodyReader(fbs.reader(), fbs.buffer.len, .exact);
+            const resp = try client.parseBody(Client.RpcResponse(.getblockhash), arena_state.allocator(), body.reader(), len);
+            try t.expectEqualStrings("00ab", resp.result.?);
+        }
+        var fbs = std.io.fixedBufferStream("{\"id\": 1, \"result\": \"0\\u0030ab\", \"error\": null}");
+        var body = Client.bodyReader(fbs.reader(), fbs.buffer.len, .exact);
+        const resp = try client.parseBody(Client.RpcResponse(.getblockhash), arena_state.allocator(), body.reader(), null);
+        try t.expectEqualStrings("00ab", resp.result.?);
+    }
+}
+
+test "parseBatchEntry" {
+    const t = std.testing;
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const body =
+        \\[{"id": 12, "result": null, "error": {"code": -28, "message": "Loading block index..."}},
+        \\ {"id": 11, "result": "00000000000000000002bf8029f6be4e40b4a3e0e161b6a1044ddaf9eb126504", "error": null}]
+    ;
+    const entries = try std.json.parseFromSliceLeaky([]std.json.Value, arena, body, .{});
+    const hash = try Client.parseBatchEntry(.getblockhash, arena, entries, 11);
+    try t.expectEqualStrings("00000000000000000002bf8029f6be4e40b4a3e0e161b6a1044ddaf9eb126504", hash);
+    try t.expectError(error.RpcInWarmup, Client.parseBatchEntry(.getblockhash, arena, entries, 12));
+    try t.expectError(error.MissingBatchResponse, Client.parseBatchEntry(.getblockhash, arena, entries, 13));
+}
+
+test "parseResponse" {
+    const t = std.testing;
+    var client = Client{ .allocator = t.allocator, .cookiepath = "" };
+    const res = try client.parseResponse(.getblockhash, "{\"id\": 1, \"result\": \"00ab\", \"error\": null}");
+    defer res.deinit();
+    try t.expectEqualStrings("00ab", res.value);
+    try t.expectError(error.RpcInWarmup, client.parseResponse(.getblockhash, "{\"id\": 1, \"result\": null, \"error\": {\"code\": -28, \"message\": \"\"}}"));
+    try t.expectError(error.NullResult, client.parseResponse(.getblockhash, "{\"id\": 1, \"result\": null, \"error\": null}"));
+    // no result expected.
+    const dis = try client.parseResponse(.disconnectnode, "{\"id\": 1, \"result\": null, \"error\": null}");
+    dis.deinit();
+    try t.expectError(error.RpcClientNodeNotConnected, client.parseResponse(.disconnectnode, "{\"id\": 1, \"result\": null, \"error\": {\"code\": -29}}"));
+}
+
+test "mock server roundtrip" {
+    const t = std.testing;
+    const tt = @import("test.zig");
+
+    const srv = try tt.MockRpcServer.start(t.allocator, .bitcoind);
+    defer srv.stop();
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    try tmp.dir.writeFile("cookie", "__cookie__:secret");
+    var client = Client{
+        .allocator = t.allocator,
+        .cookiepath = try tmp.join(&.{"cookie"}),
+        .port = srv.port(),
+        .keepalive = true,
+    };
+    defer client.deinit();
+
+    const res = try client.callBatch(&.{ .getblockchaininfo, .getpeerinfo }, .{ {}, {} });
+    defer res.deinit();
+    try t.expectEqual(@as(u64, 800000), (try res.value[0]).blocks);
+    try t.expectEqual(@as(usize, 10), (try res.value[1]).len);
+
+    // the idle connection is dropped by the server: retried over a new one.
+    srv.knobs.fail_every.store(2, .monotonic);
+    const hash = try client.call(.getblockhash, .{ .height = 800000 });
+    defer hash.deinit();
+    try t.expectEqual(@as(usize, 64), hash.value.len);
+    try t.expectEqual(@as(u32, 3), srv.nreq.load(.monotonic));
+    try t.expectEqual(@as(u32, 2), srv.nconn.load(.monotonic));
+
+    srv.knobs.fail_every.store(0, .monotonic);
+    const fees = try client.callMany(.estimatesmartfee, &.{ .{ .conf_target = 1 }, .{ .conf_target = 144 } });
+    defer fees.deinit();
+    try t.expectEqual(@as(usize, 2), fees.value.len);
+    try t.expectApproxEqAbs(@as(f64, 144e-5), (try fees.value[0]).feerate.?, 1e-9);
+    try t.expectEqual(@as(u32, 144), (try fees.value[1]).blocks);
+
+    srv.knobs.fault.store(.rpc_warmup, .monotonic);
+    srv.knobs.fail_every.store(1, .monotonic);
+    try t.expectError(error.RpcInWarmup, client.call(.getpeerinfo, {}));
+    try t.expectError(error.RpcInWarmup, client.restBlockHash(1));
+}
+
+test "mock server rest" {
+    const t = std.testing;
+    const tt = @import("test.zig");
+
+    const srv = try tt.MockRpcServer.start(t.allocator, .bitcoind);
+    defer srv.stop();
+    srv.knobs.height.store(100, .monotonic);
+    var client = Client{ .allocator = t.allocator, .cookiepath = "", .port = srv.port(), .keepalive = true };
+    defer client.deinit();
+
+    const info = try client.restChainInfo();
+    defer info.deinit();
+    try t.expectEqual(@as(u64, 100), info.value.blocks);
+
+    const hash = try client.restBlockHash(98);
+    var headers: [4]RawBlockHeader = undefined;
+    const got = try client.restHeaders(hash, &headers);
+    try t.expectEqual(@as(usize, 3), got.len); // 98 to the tip
+    try t.expectEqual(@as(u32, 1700000000 + 98 * 600), got[0].time);
+    try t.expectEqual(hash, got[1].prev);
+    try t.expectError(error.RestNotFound, client.restBlockHash(101));
+    // all over a single connection, 404 aside.
+    try t.expectEqual(@as(u32, 1), srv.nconn.load(.monotonic));
+}
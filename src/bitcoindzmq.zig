@@ -0,0 +1,261 @@
+//! a bitcoind ZMQ notifications subscriber.
+//!
+//! implements just enough of ZMTP 3.0, the ZeroMQ message transport protocol,
+//! to receive bitcoind zmqpubxxx notifications over TCP: a SUB socket with
+//! NULL security mechanism. see https://rfc.zeromq.org/spec/23/ for the spec
+//! and bitcoin core doc/zmq.md for the notification messages format.
+
+const std = @import("std");
+const posix = std.posix;
+
+pub const Subscriber = struct {
+    stream: std.net.Stream,
+
+    /// a single notification. topic and body reference the buffer passed to next.
+    pub const Notification = struct {
+        topic: []const u8, // e.g. "hashblock" or "rawblock"; empty if too long
+        /// e.g. block hash for hashblock; null if it doesn't fit in the buffer.
+        body: ?[]const u8,
+        seq: ?u32, // per topic message sequence number
+    };
+
+    /// connects to a bitcoind ZMQ publisher at addr:port and subscribes to
+    /// the topics. the returned value must be close'd when done.
+    pub fn connect(addr: []const u8, port: u16, topics: []const []const u8) !Subscriber {
+        const addrport = try std.net.Address.resolveIp(addr, port);
+        const stream = try std.net.tcpConnectToAddress(addrport);
+        errdefer stream.close();
+        try handshake(stream.reader(), stream.writer());
+        for (topics) |t| {
+            try subscribe(stream.writer(), t);
+        }
+        return .{ .stream = stream };
+    }
+
+    pub fn close(self: Subscriber) void {
+        self.stream.close();
+    }
+
+    /// the underlying socket, for example to poll until a notification arrives.
+    pub fn fd(self: Subscriber) posix.fd_t {
+        return self.stream.handle;
+    }
+
+    /// blocks until the next notification is received.
+    /// a large body, for example a rawblock, is discarded: see Notification.
+    pub fn next(self: Subscriber, buf: []u8) !Notification {
+        return readNotification(self.stream.reader(), buf);
+    }
+};
+
+const flag_more = 0x01;
+const flag_long = 0x02;
+const flag_command = 0x04;
+
+/// max command frame size accepted from the peer during handshake.
+const max_command_size = 512;
+
+/// exchanges greetings and READY commands with the publisher.
+fn handshake(r: anytype, w: anytype) !void {
+    var greeting = [_]u8{0} ** 64;
+    greeting[0] = 0xff; // signature
+    greeting[9] = 0x7f;
+    greeting[10] = 3; // version major
+    greeting[11] = 0; // version minor
+    @memcpy(greeting[12..16], "NULL"); // mechanism, zero padded
+    try w.writeAll(&greeting); // as-server and filler are zeros
+
+    var peer: [64]u8 = undefined;
+    try r.readNoEof(&peer);
+    if (peer[0] != 0xff or peer[9] & 1 == 0) {
+        return error.ZmqBadSignature;
+    }
+    if (peer[10] < 3) {
+        return error.ZmqUnsupportedVersion;
+    }
+    if (!std.mem.eql(u8, std.mem.sliceTo(peer[12..32], 0), "NULL")) {
+        return error.ZmqUnsupportedMechanism;
+    }
+
+    const socktype = "Socket-Type";
+    const ready = [_]u8{ flag_command, 1 + 5 + 1 + socktype.len + 4 + 3, 5 } ++ "READY".* ++
+        [_]u8{socktype.len} ++ socktype.* ++ [_]u8{ 0, 0, 0, 3 } ++ "SUB".*;
+    try w.writeAll(&ready);
+
+    var buf: [max_command_size]u8 = undefined;
+    const cmd = blk: {
+        const head = try readFrameHead(r);
+        if (head.flags & flag_command == 0 or head.size > buf.len) {
+            return error.ZmqBadHandshake;
+        }
+        const b = buf[0..@intCast(head.size)];
+        try r.readNoEof(b);
+        break :blk b;
+    };
+    if (cmd.len < 1 or cmd.len < 1 + @as(usize, cmd[0])) {
+        return error.ZmqBadHandshake;
+    }
+    const name = cmd[1 .. 1 + @as(usize, cmd[0])];
+    if (std.mem.eql(u8, name, "ERROR")) {
+        return error.ZmqHandshakeRejected;
+    }
+    if (!std.mem.eql(u8, name, "READY")) {
+        return error.ZmqBadHandshake;
+    }
+    const peertype = try findProperty(cmd[1 + name.len ..], socktype) orelse return error.ZmqBadHandshake;
+    if (!std.mem.eql(u8, peertype, "PUB") and !std.mem.eql(u8, peertype, "XPUB")) {
+        return error.ZmqIncompatibleSocketType;
+    }
+}
+
+/// returns the value of metadata property name in a READY command properties.
+fn findProperty(props: []const u8, name: []const u8) !?[]const u8 {
+    var i: usize = 0;
+    while (i < props.len) {
+        const nlen = props[i];
+        i += 1;
+        if (i + nlen + 4 > props.len) {
+            return error.ZmqBadHandshake;
+        }
+        const pname = props[i .. i + nlen];
+        i += nlen;
+        const vlen = std.mem.readInt(u32, props[i..][0..4], .big);
+        i += 4;
+        if (vlen > props.len - i) {
+            return error.ZmqBadHandshake;
+        }
+        const value = props[i .. i + vlen];
+        i += vlen;
+        if (std.ascii.eqlIgnoreCase(pname, name)) {
+            return value;
+        }
+    }
+    return null;
+}
+
+/// sends a ZMTP 3.0 style subscription message.
+fn subscribe(w: anytype, topic: []const u8) !void {
+    if (topic.len > 254) {
+        return error.ZmqTopicTooLong;
+    }
+    try w.writeAll(&[_]u8{ 0, @intCast(1 + topic.len), 1 });
+    try w.writeAll(topic);
+}
+
+const FrameHead = struct {
+    flags: u8,
+    size: u64,
+};
+
+fn readFrameHead(r: anytype) !FrameHead {
+    const flags = try r.readByte();
+    const size: u64 = if (flags & flag_long != 0) try r.readInt(u64, .big) else try r.readByte();
+    return .{ .flags = flags, .size = size };
+}
+
+/// reads a multipart message of topic, body and optional sequence number,
+/// skipping any commands in between. parts not fitting in the remaining buf
+/// space are discarded, keeping the stream in sync.
+fn readNotification(r: anytype, buf: []u8) !Notification {
+    var n = Notification{ .topic = &.{}, .body = null, .seq = null };
+    var used: usize = 0;
+    var part: usize = 0;
+    while (true) {
+        const head = try readFrameHead(r);
+        if (head.flags & flag_command != 0) {
+            try r.skipBytes(head.size, .{ .buf_size = 4096 });
+            continue;
+        }
+        const fits = head.size <= buf.len - used;
+        var data: []const u8 = &.{};
+        if (fits) {
+            const b = buf[used..][0..@intCast(head.size)];
+            try r.readNoEof(b);
+            used += b.len;
+            data = b;
+        } else {
+            try r.skipBytes(head.size, .{ .buf_size = 4096 });
+        }
+        switch (part) {
+            0 => n.topic = data,
+            1 => n.body = if (fits) data else null,
+            2 => n.seq = if (data.len == 4) std.mem.readInt(u32, data[0..4], .little) else null,
+            else => {}, // unknown extra parts
+        }
+        part += 1;
+        if (head.flags & flag_more == 0) {
+            return n;
+        }
+    }
+}
+
+const Notification = Subscriber.Notification;
+
+test "handshake" {
+    const t = std.testing;
+
+    var peer = std.ArrayList(u8).init(t.allocator);
+    defer peer.deinit();
+    var greeting = [_]u8{0} ** 64;
+    greeting[0] = 0xff;
+    greeting[9] = 0x7f;
+    greeting[10] = 3;
+    greeting[11] = 1;
+    @memcpy(greeting[12..16], "NULL");
+    try peer.appendSlice(&greeting);
+    try peer.appendSlice(&[_]u8{ flag_command, 1 + 5 + 1 + 11 + 4 + 3, 5 });
+    try peer.appendSlice("READY");
+    try peer.append(11);
+    try peer.appendSlice("Socket-Type");
+    try peer.appendSlice(&[_]u8{ 0, 0, 0, 3 });
+    try peer.appendSlice("PUB");
+
+    var out = std.ArrayList(u8).init(t.allocator);
+    defer out.deinit();
+    var fbs = std.io.fixedBufferStream(peer.items);
+    try handshake(fbs.reader(), out.writer());
+    try t.expectEqual(@as(usize, 64 + 2 + 25), out.items.len);
+    try t.expectEqual(@as(u8, 0xff), out.items[0]);
+    try t.expectEqualStrings("NULL", out.items[12..16]);
+    try t.expectEqualStrings("SUB", out.items[out.items.len - 3 ..]);
+
+    // an incompatible peer
+    @memcpy(peer.items[peer.items.len - 3 ..], "REQ");
+    fbs = std.io.fixedBufferStream(peer.items);
+    out.clearRetainingCapacity();
+    try t.expectError(error.ZmqIncompatibleSocketType, handshake(fbs.reader(), out.writer()));
+    // not a zmtp peer
+    var http = std.io.fixedBufferStream("HTTP/1.1 400 Bad Request\r\n\r\n" ++ [_]u8{0} ** 64);
+    try t.expectError(error.ZmqBadSignature, handshake(http.reader(), out.writer()));
+
+    out.clearRetainingCapacity();
+    try subscribe(out.writer(), "hashblock");
+    try t.expectEqualSlices(u8, &[_]u8{ 0, 10, 1 } ++ "hashblock".*, out.items);
+}
+
+test "readNotification" {
+    const t = std.testing;
+
+    const hash = [_]u8{0xab} ** 32;
+    const msg = [_]u8{ flag_more, 9 } ++ "hashblock".* ++
+        [_]u8{ flag_command, 5 } ++ "\x04PING".* ++ // skipped
+        [_]u8{ flag_more, 32 } ++ hash ++
+        [_]u8{ 0, 4, 7, 0, 0, 0 } ++
+        // a long frame body not fitting in the buffer
+        [_]u8{ flag_more | flag_long, 0, 0, 0, 0, 0, 0, 0, 8 } ++ "rawblock".* ++
+        [_]u8{ flag_more | flag_long, 0, 0, 0, 0, 0, 0, 1, 0 } ++ [_]u8{0xcd} ** 256 ++
+        [_]u8{ 0, 4, 8, 0, 0, 0 };
+    var fbs = std.io.fixedBufferStream(&msg);
+    var buf: [64]u8 = undefined;
+
+    var n = try readNotification(fbs.reader(), &buf);
+    try t.expectEqualStrings("hashblock", n.topic);
+    try t.expectEqualSlices(u8, &hash, n.body.?);
+    try t.expectEqual(@as(?u32, 7), n.seq);
+
+    n = try readNotification(fbs.reader(), &buf);
+    try t.expectEqualStrings("rawblock", n.topic);
+    try t.expect(n.body == null);
+    try t.expectEqual(@as(?u32, 8), n.seq);
+    try t.expectError(error.EndOfStream, readNotification(fbs.reader(), &buf));
+}
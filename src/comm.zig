@@ -1,33 +1,49 @@
 //! daemon/gui communication.
 //! the protocol is a simple TLV construct: MessageTag(u16), length(u64), json-marshalled Message;
 //! little endian.
+//! the payload may instead be encoded in a compact binary format, see comm/binary.zig,
+//! in which case the tag has binary_tag_flag bit set. peers announce binary support
+//! with a comm_features message and use json otherwise.
+//! a frame may carry a u32 request id after the length, flagged with id_tag_flag,
+//! so that a reply matches up with its request.
 
 const std = @import("std");
 const json = std.json;
 const mem = std.mem;
 
+const binary = @import("comm/binary.zig");
 const types = @import("types.zig");
 
+pub const ShmSnapshot = @import("comm/ShmSnapshot.zig");
+
+/// fixed size ids used in messages, for modules importing comm on its own.
+pub const Hash = types.Hash;
+pub const PubKey = types.PubKey;
+pub const OutPoint = types.OutPoint;
+
 const logger = std.log.scoped(.comm);
 
 var plumb: struct {
     a: std.mem.Allocator,
     r: std.fs.File.Reader,
-    w: std.fs.File.Writer,
+    w: Writer,
+    wmu: std.Thread.Mutex = .{}, // guards w
 
-    fn pipeRead(self: @This()) !ParsedMessage {
+    fn pipeRead(self: *@This()) !ParsedMessage {
         return read(self.a, self.r);
     }
 
-    fn pipeWrite(self: @This(), m: Message) !void {
-        return write(self.a, self.w, m);
+    fn pipeWrite(self: *@This(), m: Message, id: u32) !void {
+        self.wmu.lock();
+        defer self.wmu.unlock();
+        return self.w.writeId(m, .json, id);
     }
 } = undefined;
 
 /// initializes a global comm pipe, making `pipeRead` and `pipeWrite` ready to use from any module.
 /// a message sent with `pipeWrite` can be subsequently read with `pipeRead`.
 pub fn initPipe(a: std.mem.Allocator, p: types.IoPipe) void {
-    plumb = .{ .a = a, .r = p.r.reader(), .w = p.w.writer() };
+    plumb = .{ .a = a, .r = p.r.reader(), .w = Writer.init(a, p.w) };
 }
 
 /// similar to `read` but uses a global pipe initialized with `initPipe`.
@@ -37,17 +53,23 @@ pub fn pipeRead() !ParsedMessage {
 }
 
 /// similar to `write` but uses a global pipe initialized with `initPipe`.
-/// blocking but normally buffered.
-/// callers must deallocate resources with ParsedMessage.deinit when done.
+/// blocking but normally buffered. safe for concurrent use.
 pub fn pipeWrite(m: Message) !void {
-    return plumb.pipeWrite(m);
+    return plumb.pipeWrite(m, 0);
+}
+
+/// similar to `pipeWrite` but with a request id; see `Writer.writeId`.
+pub fn pipeWriteId(m: Message, id: u32) !void {
+    return plumb.pipeWrite(m, id);
 }
 
 /// common errors returned by read/write functions.
 pub const Error = error{
     CommReadInvalidTag,
     CommReadZeroLenInNonVoidTag,
+    CommReadTooLarge,
     CommWriteTooLarge,
+    CommWriteQueueFull,
 };
 
 /// it is important to preserve ordinal values for future compatiblity,
@@ -95,7 +117,178 @@ pub const MessageTag = enum(u16) {
     screen_unlock_result = 0x18,
     // ngui -> nd: set or disable screenlock pin code
     slock_set_pincode = 0x19,
-    // next: 0x1a
+    // nd -> ngui: changes since the previous lightning_report or delta
+    lightning_report_delta = 0x1a,
+    // ngui -> nd: supported protocol features; sent once at startup
+    comm_features = 0x1b,
+    // ngui -> nd: UI frame and render time stats; no reply
+    ui_perf_report = 0x1c,
+    // -> ngui: send ui_perf_report now, since the previous one; used by benchmarks
+    get_ui_perf_report = 0x1d,
+    // nd -> ngui: downsampled trends of mempool, fees and balances
+    history_report = 0x1e,
+    // nd -> ngui: output of a running system update
+    sysupdates_progress = 0x1f,
+    // ngui -> nd: a sorted and filtered page of lightning channels
+    lightning_get_channels = 0x20,
+    // nd -> ngui: lightning_get_channels result; resent when channels change
+    lightning_channels = 0x21,
+    // ngui -> nd: a page of settled lightning invoices and payments, newest first
+    lightning_get_payments = 0x22,
+    // nd -> ngui: lightning_get_payments result; resent when the history grows
+    lightning_payments = 0x23,
+    // nd -> ngui: node resources usage of services, disks and cpu
+    system_report = 0x24,
+    // nd -> ngui: progress and outcome of a scheduled lnd database compaction
+    lnd_compaction = 0x25,
+    // nd -> ngui: progress of a node bootstrap from a UTXO set snapshot
+    bitcoin_bootstrap = 0x26,
+    // nd -> ngui: bitcoind startup progress while its RPC is in warmup
+    bitcoind_startup = 0x27,
+    // ngui -> nd: screen about to time out; dim the backlight until wakeup; no reply
+    dim = 0x28,
+    // nd -> ngui: a new lightning_report is in the shared ShmSnapshot
+    lightning_report_shm = 0x29,
+    // nd -> ngui: outcome of a static channel backup export
+    channel_backup = 0x2a,
+    // nd -> ngui: state and progress of a background maintenance job
+    job_progress = 0x2b,
+    // nd -> ngui: outcome of a task run on behalf of an ngui request
+    task_result = 0x2c,
+    // ngui -> nd: push network reports on wifi and ip address changes, starting
+    // with a wifi scan, until unsubscribe_network; no reply
+    subscribe_network = 0x2d,
+    // ngui -> nd: stop pushing network reports; no reply
+    unsubscribe_network = 0x2e,
+    // nd -> ngui: tor bootstrap progress and circuit builds
+    tor_status = 0x2f,
+    // ngui -> nd: a page of onchain wallet transactions, newest first
+    onchain_get_transactions = 0x30,
+    // nd -> ngui: onchain_get_transactions result; resent when the history changes
+    onchain_transactions = 0x31,
+    // ngui -> nd: a page of onchain wallet unspent outputs, largest first
+    onchain_get_utxos = 0x32,
+    // nd -> ngui: onchain_get_utxos result; resent when the wallet outputs change
+    onchain_utxos = 0x33,
+    // ngui -> nd: routing policies and peer of a single channel
+    lightning_get_channel_detail = 0x34,
+    // nd -> ngui: lightning_get_channel_detail result
+    lightning_channel_detail = 0x35,
+    // nd -> ngui: shed optional work while the node is under resource pressure, or stop
+    load_shed = 0x36,
+    // nd -> ngui: live routing activity summary, at most every few seconds
+    htlc_activity = 0x37,
+    // nd -> ngui: lightning network graph statistics
+    lightning_graph = 0x38,
+    // ngui -> nd: push the list of connected lightning peers while it changes,
+    // until unsubscribe_lightning_peers; no reply
+    subscribe_lightning_peers = 0x39,
+    // ngui -> nd: stop pushing lightning peers; no reply
+    unsubscribe_lightning_peers = 0x3a,
+    // nd -> ngui: connected lightning peers, all or those changed
+    lightning_peers = 0x3b,
+    // nd -> ngui: when the onchain and lightning reports were last collected
+    report_freshness = 0x3c,
+    // next: 0x3d
+};
+
+/// set in the wire tag value when the payload is binary-encoded.
+/// MessageTag ordinals must stay below this value.
+pub const binary_tag_flag: u16 = 0x8000;
+/// set in the wire tag value when a request id follows the payload length.
+/// MessageTag ordinals must stay below this value too.
+pub const id_tag_flag: u16 = 0x4000;
+
+/// delivery class of a message. a control message is sent ahead of queued
+/// bulk messages, see QueueWriter, and applied before them by ngui.
+/// the class is a function of the tag and thus not sent over the wire.
+pub const Priority = enum { control, bulk };
+
+pub fn priority(tag: MessageTag) Priority {
+    return switch (tag) {
+        // reports are superseded by newer ones; lightning_error takes the
+        // place of a lightning_report and keeps its order relative to reports.
+        .network_report,
+        .onchain_report,
+        .lightning_report,
+        .lightning_report_delta,
+        .lightning_report_shm,
+        .lightning_error,
+        .ui_perf_report,
+        .history_report,
+        .sysupdates_progress,
+        .lightning_channels,
+        .lightning_payments,
+        .onchain_transactions,
+        .onchain_utxos,
+        .system_report,
+        .lnd_compaction,
+        .bitcoin_bootstrap,
+        .bitcoind_startup,
+        .channel_backup,
+        .job_progress,
+        .tor_status,
+        .lightning_peers,
+        .report_freshness,
+        => .bulk,
+        else => .control,
+    };
+}
+
+/// max payload length read accepts for a tag, checked before allocating the
+/// payload: a corrupt frame head must not make a reader allocate arbitrary
+/// amounts of memory. only messages listing lightning channels, payments or
+/// trends grow with the node; all others stay well below small_max_payload.
+pub fn maxPayload(tag: MessageTag) usize {
+    return switch (tag) {
+        .ping,
+        .pong,
+        .poweroff,
+        .standby,
+        .wakeup,
+        .dim,
+        .lightning_get_ctrlconn,
+        .lightning_reset,
+        .get_ui_perf_report,
+        .lightning_report_shm,
+        .subscribe_network,
+        .unsubscribe_network,
+        .subscribe_lightning_peers,
+        .unsubscribe_lightning_peers,
+        => 0,
+        .lightning_report,
+        .lightning_report_delta,
+        .lightning_channels,
+        .lightning_payments,
+        .onchain_transactions,
+        .onchain_utxos,
+        .history_report,
+        => default_max_payload,
+        else => small_max_payload,
+    };
+}
+
+/// max payload length of messages of a fixed or slowly growing size.
+pub const small_max_payload = 1 << 20;
+
+/// generates a new non-zero request id; safe for concurrent use.
+/// the zero value means no id.
+pub fn nextRequestId() u32 {
+    const S = struct {
+        var last = std.atomic.Value(u32).init(0);
+    };
+    while (true) {
+        const id = S.last.fetchAdd(1, .monotonic) +% 1;
+        if (id != 0) {
+            return id;
+        }
+    }
+}
+
+/// message payload encoding.
+pub const Encoding = enum {
+    json,
+    binary,
 };
 
 /// daemon and gui exchange messages of this type.
@@ -106,6 +299,7 @@ pub const Message = union(MessageTag) {
     poweroff_progress: PoweroffProgress,
     standby: void,
     wakeup: void,
+    dim: void,
     wifi_connect: WifiConnect,
     network_report: NetworkReport,
     get_network_report: GetNetworkReport,
@@ -124,6 +318,51 @@ pub const Message = union(MessageTag) {
     unlock_screen: []const u8, // pincode
     screen_unlock_result: ScreenUnlockResult,
     slock_set_pincode: ?[]const u8,
+    lightning_report_delta: LightningReportDelta,
+    comm_features: CommFeatures,
+    ui_perf_report: UiPerfReport,
+    get_ui_perf_report: void,
+    history_report: HistoryReport,
+    sysupdates_progress: SysupdatesProgress,
+    lightning_get_channels: LightningChannelsQuery,
+    lightning_channels: LightningChannelsPage,
+    lightning_get_payments: LightningPaymentsQuery,
+    lightning_payments: LightningPaymentsPage,
+    system_report: SystemReport,
+    lnd_compaction: LndCompaction,
+    bitcoin_bootstrap: BitcoinBootstrap,
+    bitcoind_startup: BitcoindStartup,
+    lightning_report_shm: void,
+    channel_backup: ChannelBackup,
+    job_progress: JobProgress,
+    task_result: TaskResult,
+    subscribe_network: void,
+    unsubscribe_network: void,
+    tor_status: TorStatus,
+    onchain_get_transactions: OnchainTxQuery,
+    onchain_transactions: OnchainTxPage,
+    onchain_get_utxos: OnchainUtxoQuery,
+    onchain_utxos: OnchainUtxoPage,
+    lightning_get_channel_detail: LightningChannelDetailQuery,
+    lightning_channel_detail: LightningChannelDetail,
+    load_shed: LoadShed,
+    htlc_activity: HtlcActivity,
+    lightning_graph: LightningGraph,
+    subscribe_lightning_peers: void,
+    unsubscribe_lightning_peers: void,
+    lightning_peers: LightningPeers,
+    report_freshness: ReportFreshness,
+
+    /// always sent json-encoded.
+    pub const CommFeatures = struct {
+        binary: bool = false, // understands binary-encoded payloads
+        request_ids: bool = false, // understands frames with id_tag_flag
+        /// reads channels with lightning_get_channels: reports carry none.
+        channel_pages: bool = false,
+        /// reads full lightning reports from the ShmSnapshot it inherited
+        /// when notified with lightning_report_shm.
+        shm_reports: bool = false,
+    };
 
     pub const WifiConnect = struct {
         ssid: []const u8,
@@ -133,9 +372,19 @@ pub const Message = union(MessageTag) {
     pub const NetworkReport = struct {
         ipaddrs: []const []const u8,
         wifi_ssid: ?[]const u8, // null indicates disconnected from wifi
-        wifi_scan_networks: []const []const u8,
+        wifi_scan_networks: []const []const u8, // strongest signal first
+        /// quality of the connected wifi link; null if unknown or disconnected.
+        wifi_link: ?WifiLink = null,
+
+        pub const WifiLink = struct {
+            signal: i8, // dBm
+            tx_bitrate: u32, // kbit/s; 0 if unknown
+            rx_bitrate: u32, // kbit/s; 0 if unknown
+            retries: u8, // percent of tx packets retried since the previous sample
+        };
     };
 
+    /// a single network report regardless of subscribe_network.
     pub const GetNetworkReport = struct {
         scan: bool, // true starts a wifi scan and send NetworkReport only after completion
     };
@@ -150,13 +399,24 @@ pub const Message = union(MessageTag) {
         };
     };
 
+    /// nd holds back a report unchanged since the last one for up to
+    /// 10 minutes; see nd/ReportDedup.zig.
     pub const OnchainReport = struct {
         blocks: u64,
         headers: u64,
         timestamp: u64, // unix epoch
-        hash: []const u8, // best block hash
+        hash: types.Hash, // best block hash
         ibd: bool, // initial block download
         verifyprogress: u8, // 0-100%
+        /// initial block download pace, averaged over the last several reports;
+        /// null when not syncing or until known.
+        sync: ?struct {
+            blocks_per_min: f32,
+            disk_bytes_per_sec: u64, // size on disk growth
+            eta_sec: ?u64, // time left at this pace; null if stalled
+        } = null,
+        /// bitcoind p2p traffic since the previous report; null until known.
+        net: ?NetRates = null,
         diskusage: u64, // estimated size on disk, in bytes
         version: []const u8, // bitcoin core version string
         conn_in: u16,
@@ -175,7 +435,15 @@ pub const Message = union(MessageTag) {
             totalfee: f32, // in BTC
             minfee: f32, // BTC/kvB
             fullrbf: bool,
+            /// fee rates of the mempool transactions, lowest first; empty
+            /// until bitcoind publishes ZMQ sequence notifications.
+            feerates: []const FeeRateBucket = &.{},
+            /// estimatesmartfee rates, refreshed once per block; null while
+            /// bitcoind has too little data.
+            estimates: ?FeeEstimates = null,
         },
+        /// the latest blocks, newest first; empty during initial block download.
+        recent_blocks: []const BlockStats = &.{},
         /// on-chain balance, all values in satoshis.
         /// may not be available due to disabled wallet, if bitcoin core is used,
         /// or lnd turned off/nonfunctional.
@@ -187,40 +455,206 @@ pub const Message = union(MessageTag) {
             locked: i64, // output leases
             reserved: i64, // for fee bumps
         } = null,
+        /// seconds since the report was collected, if restored from a previous
+        /// nd run or resent after a refresh ran out of time; null for a live report.
+        stale_sec: ?u64 = null,
+
+        /// rounded to two significant digits.
+        pub const NetRates = struct {
+            recv_bytes_per_sec: u64,
+            sent_bytes_per_sec: u64,
+        };
+
+        pub const FeeRateBucket = struct {
+            min: u32, // lower bound, sat/vB
+            count: u32, // number of transactions
+            vsize: u64, // total virtual size, vB
+        };
+
+        /// fee rates in sat/vB for confirmation within a number of blocks.
+        pub const FeeEstimates = struct {
+            next_block: f32,
+            hour: f32, // 6 blocks
+            day: f32, // 144 blocks
+        };
+
+        pub const BlockStats = struct {
+            height: u64,
+            time: u64, // unix epoch
+            txs: u32, // including the coinbase
+            minfeerate: u32, // sat/vB, excluding the coinbase
+            maxfeerate: u32, // sat/vB
+            size: u64, // bytes, excluding the coinbase
+        };
     };
 
     pub const LightningReport = struct {
         version: []const u8,
-        pubkey: []const u8,
+        pubkey: types.PubKey,
         alias: []const u8,
         npeers: u32,
         height: u32,
-        hash: []const u8,
+        hash: types.Hash,
         sync: struct { chain: bool, graph: bool },
         uris: []const []const u8,
         /// only lightning channels balance is reported here
         totalbalance: struct { local: i64, remote: i64, unsettled: i64, pending: i64 },
         totalfees: struct { day: u64, week: u64, month: u64 }, // sats
-        channels: []const struct {
-            id: ?[]const u8 = null, // null for pending_xxx state
-            state: enum { active, inactive, pending_open, pending_close },
-            private: bool,
-            point: []const u8, // funding txid:index
-            closetxid: ?[]const u8 = null, // non-null for pending_close
-            peer_pubkey: []const u8,
-            peer_alias: []const u8,
-            capacity: i64,
-            balance: struct { local: i64, remote: i64, unsettled: i64, limbo: i64 },
-            totalsats: struct { sent: i64, received: i64 },
-            fees: struct {
-                base: i64, // msat
-                ppm: i64, // per milli-satoshis, in millionths of satoshi
-                // TODO: remote base and ppm from getchaninfo
-                // https://docs.lightning.engineering/lightning-network-tools/lnd/channel-fees
-            },
+        channels: []const LightningChannel,
+        /// seconds since the report was collected, if restored from a previous
+        /// nd run or resent after a refresh ran out of time; null for a live report.
+        stale_sec: ?u64 = null,
+    };
+
+    pub const LightningChannel = struct {
+        id: ?[]const u8 = null, // null for pending_xxx state
+        state: enum { active, inactive, pending_open, pending_close },
+        private: bool,
+        point: types.OutPoint, // funding tx output
+        closetxid: ?types.Hash = null, // non-null for pending_close
+        peer_pubkey: types.PubKey,
+        peer_alias: []const u8,
+        capacity: i64,
+        balance: struct { local: i64, remote: i64, unsettled: i64, limbo: i64 },
+        totalsats: struct { sent: i64, received: i64 },
+        fees: struct {
+            base: i64, // msat
+            ppm: i64, // per milli-satoshis, in millionths of satoshi
+            earned: u64 = 0, // msat, forwarding out over the last 30 days
+            // TODO: remote base and ppm from getchaninfo
+            // https://docs.lightning.engineering/lightning-network-tools/lnd/channel-fees
         },
     };
 
+    /// changes to the last LightningReport, keyed by channel point.
+    /// nd sends a full LightningReport on start, wakeup and after a lightning_error;
+    /// deltas in between. see applyLightningDelta.
+    pub const LightningReportDelta = struct {
+        /// all report fields except channels, set only if any of them changed.
+        /// summary.channels is always empty.
+        summary: ?LightningReport = null,
+        /// added and changed channels.
+        upsert: []const LightningChannel = &.{},
+        /// funding points of channels gone since the previous report.
+        remove: []const types.OutPoint = &.{},
+    };
+
+    /// ngui UI loop stats since the previous report; durations are in microseconds.
+    pub const UiPerfReport = struct {
+        period: u32, // ms covered by the report
+        timers: Histogram, // lv_timer_handler run time in the UI loop
+        queue: Histogram, // UI loop time applying messages and reports from the comm thread
+        render: Histogram, // per redrawn frame, excluding flush
+        flush: Histogram, // per redrawn frame, including vsync wait if any
+        area: Histogram, // redrawn pixels per frame
+        // touch presses and releases latency, see ui/perf.zig.
+        touch_read: Histogram = .{}, // evdev event to LVGL input read
+        touch_event: Histogram = .{}, // input read to object event dispatch
+        touch_photon: Histogram = .{}, // evdev event to the end of the redraw flush
+        mem_peak: u64 = 0, // LVGL heap peak bytes since ngui start
+        objects: u32 = 0, // LVGL objects on screen at the time of the report
+        /// set only in reports answering get_ui_perf_report: it walks all objects.
+        census: ?Census = null,
+        /// unix time of the report collections the data on screen is from,
+        /// as in ReportFreshness; 0 if none yet.
+        collected: Collected = .{},
+
+        pub const Collected = struct {
+            onchain: u64 = 0,
+            lightning: u64 = 0,
+        };
+
+        /// what LVGL objects and ngui heap memory are made of, to tell
+        /// UI memory growth causes apart: widgets, styles or labels text.
+        pub const Census = struct {
+            objects: u32, // same as UiPerfReport.objects, counted in the same walk
+            styles: u32, // added to objects; shared styles count once per object
+            label_bytes: u64, // label texts owned by LVGL, static ones excluded
+            classes: []const Class, // objects per class, most first
+            subtrees: []const Subtree, // largest children of the screen and layers
+            lvgl_mem: Heap,
+            heap: ?Heap = null, // ngui allocator; null in debug builds
+
+            pub const Class = struct {
+                name: []const u8, // LVGL widget class, or "other"
+                count: u32,
+            };
+
+            pub const Subtree = struct {
+                root: enum { screen, top, sys },
+                index: u32, // child index in the root
+                class: []const u8, // of the subtree top object
+                objects: u32,
+                styles: u32,
+                label_bytes: u64,
+            };
+
+            pub const Heap = struct {
+                used: u64,
+                peak: u64,
+                large: u64, // passed on to libc malloc
+                pooled: u64, // slab bytes obtained from the OS
+            };
+        };
+
+        /// log2 buckets: buckets[0] counts zero values and buckets[i] values
+        /// in [2^(i-1), 2^i) range. the last bucket is open-ended.
+        pub const Histogram = struct {
+            count: u32 = 0,
+            sum: u64 = 0,
+            max: u32 = 0,
+            buckets: []const u32 = &.{},
+
+            /// returns an upper bound of the p-th percentile, p in 1..100 range.
+            pub fn percentile(self: Histogram, p: u8) u64 {
+                const rank = @max(1, (@as(u64, self.count) * p + 99) / 100);
+                var n: u64 = 0;
+                for (self.buckets, 0..) |b, i| {
+                    n += b;
+                    if (n >= rank) {
+                        const upper = if (i == 0) 0 else (@as(u64, 1) << @intCast(i)) - 1;
+                        return @min(upper, self.max);
+                    }
+                }
+                return self.max;
+            }
+        };
+    };
+
+    /// averages of a few onchain and lightning values over time, recorded by nd
+    /// from its reports; see nd/History.zig. each range has a fixed number of
+    /// points regardless of how much history nd has stored.
+    pub const HistoryReport = struct {
+        ranges: []const Range,
+
+        /// number of points in every series.
+        pub const points = 60;
+
+        pub const Kind = enum(u8) {
+            mempool_txcount,
+            mempool_usage, // bytes
+            mempool_minfee, // sat/kvB
+            onchain_balance, // sat
+            ln_local, // sat
+            ln_remote, // sat
+            ln_fees_day, // sat, forwarding fees earned over the preceding day
+        };
+
+        pub const Span = enum(u8) { hour, day, month, year };
+
+        pub const Range = struct {
+            span: Span,
+            step: u32, // seconds covered by a point
+            end: u64, // unix epoch at the end of the last point, which is in progress
+            series: []const Series,
+        };
+
+        pub const Series = struct {
+            kind: Kind,
+            values: []const ?i64, // oldest first; null if there were no samples
+        };
+    };
+
     pub const LightningCtrlConn = []const LnCtrlConnItem;
 
     pub const LnCtrlConnItem = struct {
@@ -258,6 +692,342 @@ pub const Message = union(MessageTag) {
         edge, // dev branch in sysupdates
     };
 
+    /// a view of lightning channels: those matching the filter in sort order,
+    /// starting at offset, at most limit of them.
+    pub const LightningChannelsQuery = struct {
+        sort: Sort = .none,
+        desc: bool = false, // descending sort order
+        filter: Filter = .all,
+        /// only channels whose peer alias, pubkey hex or short channel id
+        /// contains the text, case-insensitive; all if empty.
+        /// truncated to max_search_len.
+        search: []const u8 = "",
+        offset: u32 = 0,
+        limit: u32 = 20,
+
+        pub const max_search_len = 64;
+
+        pub const Sort = enum {
+            none, // lnd order: pending first, then open channels
+            capacity,
+            local_balance,
+            fee_rate, // ppm
+            fees_earned, // over the last 30 days
+            inactive_first, // inactive, pending and active, in that order
+        };
+
+        pub const Filter = enum { all, active, inactive, pending };
+    };
+
+    pub const LightningChannelsPage = struct {
+        query: LightningChannelsQuery, // as served: offset and limit are clamped
+        total: u32, // number of channels matching the query filter
+        channels: []const LightningChannel,
+    };
+
+    pub const LightningChannelDetailQuery = struct {
+        id: []const u8, // LightningChannel.id
+    };
+
+    /// a channel as announced in the lnd graph; details too costly to carry
+    /// in every lightning report.
+    pub const LightningChannelDetail = struct {
+        id: []const u8, // as queried
+        info: ?Info, // null on error
+        err: ?[]const u8 = null, // lookup failure; null on success
+
+        pub const Info = struct {
+            capacity: i64, // sat
+            last_update: u64, // unix seconds of the channel announcement update
+            // policies are null until announced.
+            local: ?RoutingPolicy,
+            remote: ?RoutingPolicy,
+            peer: Peer,
+        };
+
+        /// terms a node sets for forwarding payments through the channel.
+        pub const RoutingPolicy = struct {
+            base_fee: i64, // msat
+            fee_ppm: i64,
+            timelock_delta: u32, // blocks
+            min_htlc: i64, // msat
+            max_htlc: u64, // msat
+            disabled: bool,
+            last_update: u64, // unix seconds
+        };
+
+        pub const Peer = struct {
+            pubkey: []const u8, // hex
+            alias: []const u8, // empty if unknown
+            num_channels: u32,
+            total_capacity: i64, // sat
+        };
+    };
+
+    /// a settled invoice or a succeeded payment.
+    pub const LightningPayment = struct {
+        dir: enum { received, sent },
+        time: u64, // unix seconds: invoice settlement or payment creation
+        amount: i64, // msat
+        fee: i64, // msat; 0 for received
+        memo: []const u8, // invoice description; empty for sent
+    };
+
+    /// payments history items are indexed newest first.
+    pub const LightningPaymentsQuery = struct {
+        offset: u32 = 0,
+        limit: u32 = 20,
+    };
+
+    pub const LightningPaymentsPage = struct {
+        query: LightningPaymentsQuery, // as served: offset and limit are clamped
+        total: u32, // number of items in the history
+        payments: []const LightningPayment,
+    };
+
+    /// an onchain wallet transaction.
+    pub const OnchainTx = struct {
+        txid: []const u8, // hex
+        height: u32, // block height; 0 while unconfirmed
+        confirmations: u32, // as of the last sync with lnd
+        time: u64, // unix seconds the tx was first seen
+        amount: i64, // sat; negative if the wallet funds were spent
+        fee: i64, // sat; 0 unless paid by the wallet
+        label: []const u8,
+    };
+
+    /// onchain transactions are indexed newest first, unconfirmed ones ahead.
+    pub const OnchainTxQuery = struct {
+        offset: u32 = 0,
+        limit: u32 = 20,
+    };
+
+    pub const OnchainTxPage = struct {
+        query: OnchainTxQuery, // as served: offset and limit are clamped
+        total: u32, // number of transactions in the history
+        transactions: []const OnchainTx,
+    };
+
+    /// an onchain wallet unspent output.
+    pub const OnchainUtxo = struct {
+        outpoint: types.OutPoint,
+        amount: i64, // sat
+        confirmations: u32, // as of the last listing; 0 while unconfirmed
+        address: []const u8,
+    };
+
+    /// unspent outputs are indexed by amount, largest first.
+    pub const OnchainUtxoQuery = struct {
+        offset: u32 = 0,
+        limit: u32 = 20,
+    };
+
+    pub const OnchainUtxoPage = struct {
+        query: OnchainUtxoQuery, // as served: offset and limit are clamped
+        total: u32, // number of unspent outputs in the wallet
+        loaded: bool, // false until first listed from lnd; the set is empty meanwhile
+        /// all unspent outputs by amount, smallest bucket first.
+        buckets: []const Bucket,
+        utxos: []const OnchainUtxo,
+
+        pub const Bucket = struct {
+            min: u64, // sat; up to the next bucket min
+            count: u32,
+            amount: u64, // sat
+        };
+    };
+
+    /// rates are averages over the period since the previous report.
+    pub const SystemReport = struct {
+        period: u32, // ms covered by the rates
+        services: []const Service,
+        disks: []const Disk,
+        temps: []const i32, // cpu thermal zones, millidegrees celsius
+        throttled: ?u32, // raspberry pi firmware get_throttled bits, if available
+
+        pub const Service = struct {
+            name: []const u8,
+            running: bool,
+            cpu: u16, // percent of a single cpu; over 100 when using more than one
+            rss: u64, // resident memory, bytes
+            read: ?u64, // storage bytes per second; null if unavailable
+            write: ?u64,
+        };
+
+        pub const Disk = struct {
+            name: []const u8,
+            read: u64, // bytes per second
+            write: u64,
+            busy: u8, // percent of the period with i/o in flight
+        };
+    };
+
+    /// sent when nd restarts lnd to compact channel.db, and once lnd is back up.
+    pub const LndCompaction = struct {
+        state: enum { running, done, failed },
+        before: u64, // channel.db size, bytes
+        estimate: u64, // expected size after the compaction, bytes
+        after: ?u64, // size once done; null while running or if unavailable
+        duration: u32, // restart time in ms, until lnd is ready; 0 while running
+    };
+
+    /// sent after each export of the lnd static channel backup, on nd start
+    /// and whenever channels open or close.
+    pub const ChannelBackup = struct {
+        state: enum { written, unchanged, failed },
+        path: []const u8, // the exported file
+        channels: u32, // in the backup
+        size: u64, // backup file size, bytes
+        timestamp: u64, // unix time of the export, seconds
+    };
+
+    /// sent as a background job of nd is queued, runs and completes;
+    /// see nd/JobScheduler.zig.
+    pub const JobProgress = struct {
+        name: []const u8,
+        state: enum { queued, running, done, failed, expired },
+        progress: ?u8, // percent done, if known
+    };
+
+    /// sent as the node comes under cpu, memory or io pressure, and once it
+    /// subsides; see sys/Pressure.zig. ngui drops optional caches and renders
+    /// at a lower frame rate while on.
+    pub const LoadShed = struct {
+        on: bool,
+    };
+
+    /// lightning network graph statistics, off a graph nd keeps in memory and
+    /// up to date with the lnd graph topology stream; see nd/ChannelGraph.zig.
+    /// sent after the graph is loaded, then every few minutes while it changes.
+    pub const LightningGraph = struct {
+        nodes: u32 = 0, // with at least one channel
+        channels: u32 = 0,
+        capacity_sat: u64 = 0,
+        /// number of channels by capacity, split at capacity_bounds.
+        capacity_dist: [capacity_bounds.len + 1]u32 = [_]u32{0} ** (capacity_bounds.len + 1),
+        /// nodes within reach of the own node over any number of channels.
+        reachable: u32 = 0,
+        avg_hops: f32 = 0, // from the own node to reachable ones
+        own_channels: u32 = 0,
+        /// the own node rank by number of channels, 1 for the most connected;
+        /// 0 if it's not in the graph.
+        own_rank: u32 = 0,
+
+        /// channel capacity distribution bucket bounds, in sats.
+        pub const capacity_bounds = [_]u64{ 100_000, 1_000_000, 5_000_000, 10_000_000, 50_000_000 };
+    };
+
+    /// routing activity off the lnd HTLC events stream, sent while it changes
+    /// but at most every few seconds, and once a minute as counts age out;
+    /// see nd/HtlcActivity.zig.
+    pub const HtlcActivity = struct {
+        in_flight: u32 = 0, // forwards offered onwards, not yet settled or failed
+        recent: Totals = .{}, // last 5 minutes
+        hour: Totals = .{}, // last 60 minutes
+
+        pub const Totals = struct {
+            forwards: u32 = 0, // settled
+            routed_sat: u64 = 0, // outgoing amount of settled forwards
+            fees_msat: u64 = 0,
+            failures: Failures = .{},
+        };
+
+        /// failed forwards by reason.
+        pub const Failures = struct {
+            balance: u32 = 0, // insufficient outgoing balance
+            fee: u32 = 0, // fee below the channel policy
+            policy: u32 = 0, // amount or cltv expiry outside the channel policy
+            unavailable: u32 = 0, // unknown next peer, channel or forwards disabled
+            downstream: u32 = 0, // failed back by a node further along the route
+            other: u32 = 0,
+        };
+    };
+
+    /// when nd last collected the onchain and lightning reports, sent after
+    /// each successful collection whether or not the report itself was sent:
+    /// an unchanged report is held back, see nd/ReportDedup.zig. ngui tells
+    /// data gone stale from data which is merely unchanged by the age of
+    /// the collection.
+    pub const ReportFreshness = struct {
+        onchain: ?Freshness = null, // null until collected once
+        lightning: ?Freshness = null,
+
+        pub const Freshness = struct {
+            collected_at: u64, // unix time the collection completed
+            collect_ms: u32, // how long it took
+            /// the data is stale once older than this, a few collection
+            /// intervals: a backend stalled or failing.
+            stale_after_sec: u32,
+        };
+    };
+
+    /// connected lnd peers, sent every few seconds while they change after a
+    /// subscribe_lightning_peers; see nd/PeerView.zig. the first message after
+    /// subscribing is full, listing all peers. the others list only those new
+    /// or changed, and the pubkeys of the peers gone since the previous one.
+    pub const LightningPeers = struct {
+        full: bool,
+        peers: []const LightningPeer,
+        removed: []const []const u8 = &.{}, // pubkey hex
+    };
+
+    pub const LightningPeer = struct {
+        pubkey: []const u8, // hex
+        alias: []const u8, // empty if unknown yet
+        address: []const u8, // host:port
+        inbound: bool,
+        ping_us: u64, // last ping round trip
+        bytes_sent: u64, // since the connection opened
+        bytes_recv: u64,
+        // rates between the last two refreshes
+        sent_bps: u64 = 0,
+        recv_bps: u64 = 0,
+    };
+
+    /// sent once a request such as set_nodename completes in the background,
+    /// or fails right away.
+    pub const TaskResult = struct {
+        name: []const u8,
+        state: enum { done, failed, cancelled },
+        err: ?[]const u8, // error name if failed
+    };
+
+    /// sent every few seconds while a UTXO set snapshot downloads, and with
+    /// onchain reports while bitcoind validates the chain up to the snapshot
+    /// in the background.
+    pub const BitcoinBootstrap = struct {
+        state: enum { downloading, loading, validating, done, failed },
+        downloaded: u64, // snapshot bytes
+        size: ?u64, // snapshot file size, if known
+        height: u64, // snapshot base block height; 0 until loaded
+        validated: u64, // background validation height, up to the base height
+    };
+
+    /// sent instead of onchain reports while bitcoind loads its block index
+    /// and verifies the latest blocks, until it answers RPC calls.
+    pub const BitcoindStartup = struct {
+        phase: []const u8, // bitcoind init message, such as "Loading block index…"
+        progress: ?u8, // 0-100% of the phase, if it reports one
+    };
+
+    /// sent as tor bootstraps and with each circuit built, while nd follows
+    /// tor on its control port.
+    pub const TorStatus = struct {
+        progress: u8, // bootstrap, 0-100%
+        summary: []const u8, // bootstrap phase, such as "Connecting to a relay"
+        circuits: u32, // built since nd connected to the control port
+        failed: u32, // circuits failed to build
+        build_ms: ?u32, // build time of the latest built circuit
+    };
+
+    /// sent at most every few seconds while an update runs, and once it exits.
+    pub const SysupdatesProgress = struct {
+        done: bool, // the update process exited
+        ok: bool, // exited with success; always true while running
+        lines: u32, // script output lines so far, stdout and stderr
+        last: []const u8, // the most recent output line
+    };
+
     pub const Settings = struct {
         slock_enabled: bool,
         hostname: []const u8, // see .set_nodename
@@ -276,6 +1046,8 @@ pub const Message = union(MessageTag) {
 pub const ParsedMessage = struct {
     value: Message,
     arena: ?*std.heap.ArenaAllocator = null, // null for void message tags
+    /// request id set by the sender, or 0; a reply carries the id of its request.
+    id: u32 = 0,
 
     /// releases all resources used by the message.
     pub fn deinit(self: @This()) void {
@@ -290,12 +1062,33 @@ pub const ParsedMessage = struct {
 /// reads and parses a single message from the input stream reader.
 /// propagates reader errors as is. for example, a closed reader returns
 /// error.EndOfStream.
+/// a payload longer than maxPayload of its tag results in CommReadTooLarge,
+/// with the stream left out of sync: the frame head is likely corrupt.
 ///
 /// callers must deallocate resources with ParsedMessage.deinit when done.
 pub fn read(allocator: mem.Allocator, reader: anytype) !ParsedMessage {
-    // alternative is @intToEnum(reader.ReadIntLittle(u16)) but it may panic.
-    const tag = try reader.readEnum(MessageTag, .little);
+    const wiretag = try reader.readInt(u16, .little);
     const len = try reader.readInt(u64, .little);
+    const id = if (wiretag & id_tag_flag != 0) try reader.readInt(u32, .little) else 0;
+    var res = try readPayload(allocator, reader, wiretag & ~id_tag_flag, len);
+    res.id = id;
+    return res;
+}
+
+fn readPayload(allocator: mem.Allocator, reader: anytype, wiretag: u16, len: u64) !ParsedMessage {
+    const enc: Encoding = if (wiretag & binary_tag_flag != 0) .binary else .json;
+    const tag = std.meta.intToEnum(MessageTag, wiretag & ~binary_tag_flag) catch {
+        if (len > default_max_payload) {
+            return Error.CommReadTooLarge;
+        }
+        // skip the payload to keep the stream in sync, for example when
+        // the peer is of a newer version.
+        try reader.skipBytes(len, .{});
+        return Error.CommReadInvalidTag;
+    };
+    if (len > maxPayload(tag)) {
+        return Error.CommReadTooLarge;
+    }
     if (len == 0) {
         return switch (tag) {
             .lightning_get_ctrlconn => .{ .value = .lightning_get_ctrlconn },
@@ -305,6 +1098,13 @@ pub fn read(allocator: mem.Allocator, reader: anytype) !ParsedMessage {
             .poweroff => .{ .value = .{ .poweroff = {} } },
             .standby => .{ .value = .{ .standby = {} } },
             .wakeup => .{ .value = .{ .wakeup = {} } },
+            .dim => .{ .value = .{ .dim = {} } },
+            .get_ui_perf_report => .{ .value = .get_ui_perf_report },
+            .lightning_report_shm => .{ .value = .lightning_report_shm },
+            .subscribe_network => .{ .value = .subscribe_network },
+            .unsubscribe_network => .{ .value = .unsubscribe_network },
+            .subscribe_lightning_peers => .{ .value = .subscribe_lightning_peers },
+            .unsubscribe_lightning_peers => .{ .value = .unsubscribe_lightning_peers },
             else => Error.CommReadZeroLenInNonVoidTag,
         };
     }
@@ -316,20 +1116,37 @@ pub fn read(allocator: mem.Allocator, reader: anytype) !ParsedMessage {
         .poweroff,
         .standby,
         .wakeup,
+        .dim,
+        .get_ui_perf_report,
+        .lightning_report_shm,
+        .subscribe_network,
+        .unsubscribe_network,
+        .subscribe_lightning_peers,
+        .unsubscribe_lightning_peers,
         => unreachable, // handled above
         inline else => |t| {
-            const bytes = try allocator.alloc(u8, len);
-            defer allocator.free(bytes);
-            try reader.readNoEof(bytes);
-
             var arena = try allocator.create(std.heap.ArenaAllocator);
             arena.* = std.heap.ArenaAllocator.init(allocator);
             errdefer {
                 arena.deinit();
                 allocator.destroy(arena);
             }
-            const jopt = std.json.ParseOptions{ .ignore_unknown_fields = true, .allocate = .alloc_always };
-            const v = try json.parseFromSliceLeaky(std.meta.TagPayload(Message, t), arena.allocator(), bytes, jopt);
+            const T = std.meta.TagPayload(Message, t);
+            const v = switch (enc) {
+                .json => blk: {
+                    const bytes = try allocator.alloc(u8, len);
+                    defer allocator.free(bytes);
+                    try reader.readNoEof(bytes);
+                    const jopt = std.json.ParseOptions{ .ignore_unknown_fields = true, .allocate = .alloc_always };
+                    break :blk try json.parseFromSliceLeaky(T, arena.allocator(), bytes, jopt);
+                },
+                .binary => blk: {
+                    // decoded strings point into the bytes: keep them in the arena.
+                    const bytes = try arena.allocator().alloc(u8, len);
+                    try reader.readNoEof(bytes);
+                    break :blk try binary.decode(T, arena.allocator(), bytes);
+                },
+            };
             const parsed = ParsedMessage{
                 .arena = arena,
                 .value = @unionInit(Message, @tagName(t), v),
@@ -342,10 +1159,280 @@ pub fn read(allocator: mem.Allocator, reader: anytype) !ParsedMessage {
 /// outputs the message msg using writer.
 /// all allocated resources are freed upon return.
 pub fn write(allocator: mem.Allocator, writer: anytype, msg: Message) !void {
+    return writeEncoded(allocator, writer, msg, .json);
+}
+
+/// similar to write but encodes the payload according to enc.
+/// comm_features and void payloads are always sent as json.
+/// callers must use binary only with peers which announced support for it.
+pub fn writeEncoded(allocator: mem.Allocator, writer: anytype, msg: Message, enc: Encoding) !void {
     var data = types.ByteArrayList.init(allocator);
     defer data.deinit();
+    const wiretag = try encodePayload(&data, msg, enc);
+    return writeFrame(writer, wiretag, data.items, default_max_payload);
+}
+
+/// max encoded payload size accepted by write functions by default.
+/// the largest messages, lightning reports, are normally well below 1MiB.
+pub const default_max_payload = 16 << 20;
+
+/// a message frame writer to a file such as a pipe, with a re-usable payload
+/// buffer: once the buffer has grown to fit the typical messages, each one
+/// is sent with no allocations, header and payload in a single writev call.
+/// not safe for concurrent use.
+pub const Writer = struct {
+    file: std.fs.File,
+    buf: types.ByteArrayList,
+    /// messages with a larger encoded payload result in CommWriteTooLarge.
+    max_payload: usize = default_max_payload,
+
+    /// the file is referenced, not owned. release resources with deinit.
+    pub fn init(allocator: mem.Allocator, file: std.fs.File) Writer {
+        return .{ .file = file, .buf = types.ByteArrayList.init(allocator) };
+    }
+
+    pub fn deinit(self: *Writer) void {
+        self.buf.deinit();
+    }
+
+    /// sends msg with its payload encoded according to enc; see writeEncoded.
+    pub fn write(self: *Writer, msg: Message, enc: Encoding) !void {
+        return self.writeId(msg, enc, 0);
+    }
+
+    /// same as write but with a request id in the frame, unless 0.
+    /// callers must use non-zero ids only with peers which announced support for it.
+    pub fn writeId(self: *Writer, msg: Message, enc: Encoding, id: u32) !void {
+        const wiretag = try encodePayload(&self.buf, msg, enc);
+        if (self.buf.items.len > self.max_payload) {
+            return Error.CommWriteTooLarge;
+        }
+        var hbuf: [max_frame_head_size]u8 = undefined;
+        const head = frameHead(&hbuf, wiretag, self.buf.items.len, id);
+        var iov = [_]std.posix.iovec_const{
+            .{ .iov_base = head.ptr, .iov_len = head.len },
+            .{ .iov_base = self.buf.items.ptr, .iov_len = self.buf.items.len },
+        };
+        return self.file.writevAll(&iov);
+    }
+};
+
+/// a Writer in front of a dedicated writer thread, so that a slow reader never
+/// blocks the writing side. once started, write encodes a message into an owned
+/// frame and queues it; the thread sends frames to the file in order.
+/// a queued report superseded by a newer one of the same kind is dropped,
+/// see `supersedes`, and control messages are sent ahead of queued bulk ones,
+/// see `priority`. messages of the same class are otherwise never reordered.
+/// while not started, write sends messages directly like a Writer.
+/// safe for concurrent use.
+pub const QueueWriter = struct {
+    allocator: mem.Allocator,
+    w: Writer, // used by the writer thread, or directly while not started
+    /// queued frames above this count result in CommWriteQueueFull.
+    max_frames: usize = 64,
+
+    mu: std.Thread.Mutex = .{}, // guards all fields below, and w while not started
+    cond: std.Thread.Condition = .{},
+    frames: std.ArrayListUnmanaged(Frame) = .{},
+    queued: bool = false, // whether write queues frames, set while started
+    thread: ?std.Thread = null,
+    stopping: bool = false,
+    detached: bool = false, // frames are dropped until attach; see detach
+    sending: bool = false, // the thread is writing a frame to the file
+    sent: std.Thread.Condition = .{}, // signalled once sending is reset
+
+    const Frame = struct {
+        tag: MessageTag,
+        data: []u8, // frame head and payload
+    };
+
+    /// the file is referenced, not owned. release resources with deinit.
+    pub fn init(allocator: mem.Allocator, file: std.fs.File) QueueWriter {
+        return .{ .allocator = allocator, .w = Writer.init(allocator, file) };
+    }
+
+    /// drops all frames not yet sent. the writer must be stopped.
+    pub fn deinit(self: *QueueWriter) void {
+        for (self.frames.items) |f| self.allocator.free(f.data);
+        self.frames.deinit(self.allocator);
+        self.w.deinit();
+    }
+
+    /// spawns the writer thread.
+    pub fn start(self: *QueueWriter) !void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.thread != null) {
+            return;
+        }
+        self.stopping = false;
+        self.thread = try std.Thread.spawn(.{}, loop, .{self});
+        self.queued = true;
+    }
+
+    /// sends all queued frames and joins the writer thread.
+    /// the file reader must keep reading or close its end for stop to return.
+    pub fn stop(self: *QueueWriter) void {
+        self.mu.lock();
+        const th = self.thread orelse {
+            self.mu.unlock();
+            return;
+        };
+        self.stopping = true;
+        self.cond.signal();
+        self.mu.unlock();
+        th.join();
+        self.mu.lock();
+        self.thread = null;
+        self.queued = false;
+        self.mu.unlock();
+    }
+
+    /// drops all queued frames, and all messages written until attach, for
+    /// example while the file reader restarts. returns once no frame is being
+    /// sent, so that the file can be closed.
+    pub fn detach(self: *QueueWriter) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        self.detached = true;
+        for (self.frames.items) |f| self.allocator.free(f.data);
+        self.frames.clearRetainingCapacity();
+        while (self.sending) {
+            self.sent.wait(&self.mu);
+        }
+    }
+
+    /// makes a detached writer send messages to file from now on.
+    /// the file is referenced, not owned.
+    pub fn attach(self: *QueueWriter, file: std.fs.File) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        self.w.file = file;
+        self.detached = false;
+    }
+
+    /// sends msg with its payload encoded according to enc; see Writer.write.
+    /// once started, returns as soon as the message is queued.
+    pub fn write(self: *QueueWriter, msg: Message, enc: Encoding) !void {
+        return self.writeId(msg, enc, 0);
+    }
+
+    /// same as write but with a request id; see Writer.writeId.
+    pub fn writeId(self: *QueueWriter, msg: Message, enc: Encoding, id: u32) !void {
+        {
+            self.mu.lock();
+            defer self.mu.unlock();
+            if (self.detached) {
+                return;
+            }
+            if (!self.queued) {
+                return self.w.writeId(msg, enc, id);
+            }
+        }
+
+        // encode outside of the lock; other writers and the thread go on meanwhile.
+        var payload = types.ByteArrayList.init(self.allocator);
+        defer payload.deinit();
+        const wiretag = try encodePayload(&payload, msg, enc);
+        if (payload.items.len > self.w.max_payload) {
+            return Error.CommWriteTooLarge;
+        }
+        var hbuf: [max_frame_head_size]u8 = undefined;
+        const head = frameHead(&hbuf, wiretag, payload.items.len, id);
+        var buf = try types.ByteArrayList.initCapacity(self.allocator, head.len + payload.items.len);
+        defer buf.deinit();
+        buf.appendSliceAssumeCapacity(head);
+        buf.appendSliceAssumeCapacity(payload.items);
+        const frame = Frame{ .tag = msg, .data = try buf.toOwnedSlice() };
+        errdefer self.allocator.free(frame.data);
+
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.detached) { // detached meanwhile
+            self.allocator.free(frame.data);
+            return;
+        }
+        if (!self.queued) { // stopped meanwhile
+            defer self.allocator.free(frame.data);
+            return self.w.file.writeAll(frame.data);
+        }
+        var i: usize = 0;
+        while (i < self.frames.items.len) {
+            const old = self.frames.items[i];
+            if (supersedes(frame.tag, old.tag)) {
+                self.allocator.free(old.data);
+                _ = self.frames.orderedRemove(i);
+            } else {
+                i += 1;
+            }
+        }
+        if (self.frames.items.len >= self.max_frames) {
+            return Error.CommWriteQueueFull;
+        }
+        // control messages go ahead of bulk ones, after those of their own class.
+        var pos = self.frames.items.len;
+        if (priority(frame.tag) == .control) {
+            for (self.frames.items, 0..) |f, j| {
+                if (priority(f.tag) == .bulk) {
+                    pos = j;
+                    break;
+                }
+            }
+        }
+        try self.frames.insert(self.allocator, pos, frame);
+        self.cond.signal();
+    }
+
+    /// reports whether a queued message with the old tag becomes obsolete
+    /// once a message with the new tag is queued: a full report replaces the
+    /// previous ones of the same kind, including lightning deltas.
+    fn supersedes(new: MessageTag, old: MessageTag) bool {
+        return switch (new) {
+            .network_report, .history_report, .sysupdates_progress, .system_report, .lnd_compaction, .bitcoin_bootstrap, .bitcoind_startup, .channel_backup, .tor_status => old == new,
+            // bitcoind is past its startup once it reports.
+            .onchain_report => old == .onchain_report or old == .bitcoind_startup,
+            .lightning_channels, .lightning_payments, .onchain_transactions, .onchain_utxos, .report_freshness => old == new,
+            // the shared snapshot holds the latest full report, as does a new one.
+            .lightning_report, .lightning_report_shm => old == .lightning_report or old == .lightning_report_delta or old == .lightning_report_shm,
+            else => false,
+        };
+    }
+
+    fn loop(self: *QueueWriter) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        while (true) {
+            while (self.frames.items.len == 0 and !self.stopping) {
+                self.cond.wait(&self.mu);
+            }
+            if (self.frames.items.len == 0) {
+                return; // stopping and all sent
+            }
+            const f = self.frames.orderedRemove(0);
+            const file = self.w.file;
+            self.sending = true;
+            self.mu.unlock();
+            file.writeAll(f.data) catch |err| logger.err("write {s}: {!}", .{ @tagName(f.tag), err });
+            self.allocator.free(f.data);
+            self.mu.lock();
+            self.sending = false;
+            self.sent.broadcast();
+        }
+    }
+};
+
+/// encodes msg payload into data, replacing its contents, and returns the wire tag.
+fn encodePayload(data: *types.ByteArrayList, msg: Message, enc: Encoding) !u16 {
+    data.clearRetainingCapacity();
+    const wiretag: u16 = @intFromEnum(msg);
+    if (enc == .binary and !jsonOnly(msg)) {
+        switch (msg) {
+            inline else => |v| try binary.encode(data.writer(), v),
+        }
+        return wiretag | binary_tag_flag;
+    }
     switch (msg) {
-        .ping, .pong, .poweroff, .standby, .wakeup => {}, // zero length payload
+        .ping, .pong, .poweroff, .standby, .wakeup, .dim => {}, // zero length payload
         .wifi_connect => try json.stringify(msg.wifi_connect, .{}, data.writer()),
         .network_report => try json.stringify(msg.network_report, .{}, data.writer()),
         .get_network_report => try json.stringify(msg.get_network_report, .{}, data.writer()),
@@ -365,14 +1452,250 @@ pub fn write(allocator: mem.Allocator, writer: anytype, msg: Message) !void {
         .unlock_screen => try json.stringify(msg.unlock_screen, .{}, data.writer()),
         .screen_unlock_result => try json.stringify(msg.screen_unlock_result, .{}, data.writer()),
         .slock_set_pincode => try json.stringify(msg.slock_set_pincode, .{}, data.writer()),
+        .lightning_report_delta => try json.stringify(msg.lightning_report_delta, .{}, data.writer()),
+        .comm_features => try json.stringify(msg.comm_features, .{}, data.writer()),
+        .ui_perf_report => try json.stringify(msg.ui_perf_report, .{}, data.writer()),
+        .get_ui_perf_report => {}, // zero length payload
+        .lightning_report_shm => {}, // zero length payload
+        .subscribe_network, .unsubscribe_network => {}, // zero length payload
+        .history_report => try json.stringify(msg.history_report, .{}, data.writer()),
+        .sysupdates_progress => try json.stringify(msg.sysupdates_progress, .{}, data.writer()),
+        .lightning_get_channels => try json.stringify(msg.lightning_get_channels, .{}, data.writer()),
+        .lightning_channels => try json.stringify(msg.lightning_channels, .{}, data.writer()),
+        .lightning_get_payments => try json.stringify(msg.lightning_get_payments, .{}, data.writer()),
+        .lightning_payments => try json.stringify(msg.lightning_payments, .{}, data.writer()),
+        .system_report => try json.stringify(msg.system_report, .{}, data.writer()),
+        .lnd_compaction => try json.stringify(msg.lnd_compaction, .{}, data.writer()),
+        .bitcoin_bootstrap => try json.stringify(msg.bitcoin_bootstrap, .{}, data.writer()),
+        .bitcoind_startup => try json.stringify(msg.bitcoind_startup, .{}, data.writer()),
+        .channel_backup => try json.stringify(msg.channel_backup, .{}, data.writer()),
+        .job_progress => try json.stringify(msg.job_progress, .{}, data.writer()),
+        .task_result => try json.stringify(msg.task_result, .{}, data.writer()),
+        .tor_status => try json.stringify(msg.tor_status, .{}, data.writer()),
+        .onchain_get_transactions => try json.stringify(msg.onchain_get_transactions, .{}, data.writer()),
+        .onchain_transactions => try json.stringify(msg.onchain_transactions, .{}, data.writer()),
+        .onchain_get_utxos => try json.stringify(msg.onchain_get_utxos, .{}, data.writer()),
+        .lightning_get_channel_detail => try json.stringify(msg.lightning_get_channel_detail, .{}, data.writer()),
+        .lightning_channel_detail => try json.stringify(msg.lightning_channel_detail, .{}, data.writer()),
+        .load_shed => try json.stringify(msg.load_shed, .{}, data.writer()),
+        .htlc_activity => try json.stringify(msg.htlc_activity, .{}, data.writer()),
+        .lightning_graph => try json.stringify(msg.lightning_graph, .{}, data.writer()),
+        .subscribe_lightning_peers, .unsubscribe_lightning_peers => {}, // zero length payload
+        .lightning_peers => try json.stringify(msg.lightning_peers, .{}, data.writer()),
+        .report_freshness => try json.stringify(msg.report_freshness, .{}, data.writer()),
+        .onchain_utxos => try json.stringify(msg.onchain_utxos, .{}, data.writer()),
     }
-    if (data.items.len > std.math.maxInt(u64)) {
+    return wiretag;
+}
+
+fn jsonOnly(msg: Message) bool {
+    return switch (msg) {
+        .ping, .pong, .poweroff, .standby, .wakeup, .dim => true, // zero length payload
+        .lightning_get_ctrlconn, .lightning_reset, .get_ui_perf_report, .lightning_report_shm => true, // zero length payload
+        .subscribe_network, .unsubscribe_network => true, // zero length payload
+        .subscribe_lightning_peers, .unsubscribe_lightning_peers => true, // zero length payload
+        .comm_features => true, // may be read by peers unaware of binary
+        else => false,
+    };
+}
+
+/// size of the wire tag and payload length preceding a payload.
+const frame_head_size = 2 + 8;
+/// frame head followed by a request id.
+const max_frame_head_size = frame_head_size + 4;
+
+/// writes the frame head into buf and returns its used part.
+fn frameHead(buf: *[max_frame_head_size]u8, wiretag: u16, len: usize, id: u32) []const u8 {
+    const tag = if (id != 0) wiretag | id_tag_flag else wiretag;
+    mem.writeInt(u16, buf[0..2], tag, .little);
+    mem.writeInt(u64, buf[2..10], len, .little);
+    if (id == 0) {
+        return buf[0..frame_head_size];
+    }
+    mem.writeInt(u32, buf[10..14], id, .little);
+    return buf;
+}
+
+fn writeFrame(writer: anytype, wiretag: u16, data: []const u8, max_payload: usize) !void {
+    if (data.len > max_payload) {
         return Error.CommWriteTooLarge;
     }
+    var head: [max_frame_head_size]u8 = undefined;
+    try writer.writeAll(frameHead(&head, wiretag, data.len, 0));
+    try writer.writeAll(data);
+}
+
+/// returns the base report with delta applied. existing channels keep their
+/// position in the list and new ones are appended at the end.
+/// the result is deep-copied and shares no memory with base or delta.
+/// allocator is expected to be an arena: partial allocations are not freed on error.
+pub fn applyLightningDelta(
+    allocator: mem.Allocator,
+    base: Message.LightningReport,
+    delta: Message.LightningReportDelta,
+) !Message.LightningReport {
+    var upsert = std.AutoHashMap(types.OutPoint, usize).init(allocator);
+    defer upsert.deinit();
+    for (delta.upsert, 0..) |ch, i| {
+        try upsert.put(ch.point, i);
+    }
+    var remove = std.AutoHashMap(types.OutPoint, void).init(allocator);
+    defer remove.deinit();
+    for (delta.remove) |point| {
+        try remove.put(point, {});
+    }
+
+    var channels = std.ArrayList(Message.LightningChannel).init(allocator);
+    for (base.channels) |ch| {
+        if (remove.contains(ch.point)) {
+            continue;
+        }
+        if (upsert.fetchRemove(ch.point)) |kv| {
+            try channels.append(delta.upsert[kv.value]);
+        } else {
+            try channels.append(ch);
+        }
+    }
+    for (delta.upsert) |ch| {
+        if (upsert.contains(ch.point)) {
+            try channels.append(ch); // new channel
+        }
+    }
+
+    var rep = delta.summary orelse base;
+    rep.channels = channels.items;
+    return dupeDeep(Message.LightningReport, allocator, rep);
+}
+
+/// deep-copies v, including all slices it points to.
+pub fn dupeDeep(comptime T: type, allocator: mem.Allocator, v: T) !T {
+    switch (@typeInfo(T)) {
+        .Pointer => |p| {
+            if (p.size != .Slice) {
+                @compileError("dupeDeep: unsupported pointer type " ++ @typeName(T));
+            }
+            if (p.child == u8) {
+                return allocator.dupe(u8, v);
+            }
+            const dup = try allocator.alloc(p.child, v.len);
+            for (v, dup) |x, *y| {
+                y.* = try dupeDeep(p.child, allocator, x);
+            }
+            return dup;
+        },
+        .Struct => |st| {
+            var dup: T = undefined;
+            inline for (st.fields) |f| {
+                @field(dup, f.name) = try dupeDeep(f.type, allocator, @field(v, f.name));
+            }
+            return dup;
+        },
+        .Optional => |opt| return if (v) |x| try dupeDeep(opt.child, allocator, x) else null,
+        else => return v,
+    }
+}
 
-    try writer.writeInt(u16, @intFromEnum(msg), .little);
-    try writer.writeInt(u64, data.items.len, .little);
-    try writer.writeAll(data.items);
+/// returns the end offset of all allocations dupeDeep makes for v from a
+/// FixedBufferAllocator starting at offset off, with a buffer aligned to at
+/// least compact_align.
+fn dupeDeepSize(comptime T: type, v: T, off: usize) usize {
+    switch (@typeInfo(T)) {
+        .Pointer => |p| {
+            var end = off;
+            // zero-length allocations take no space, nor alignment padding.
+            if (v.len * @sizeOf(p.child) > 0) {
+                end = mem.alignForward(usize, off, @alignOf(p.child)) + v.len * @sizeOf(p.child);
+            }
+            if (p.child != u8) {
+                for (v) |x| end = dupeDeepSize(p.child, x, end);
+            }
+            return end;
+        },
+        .Struct => |st| {
+            var end = off;
+            inline for (st.fields) |f| {
+                end = dupeDeepSize(f.type, @field(v, f.name), end);
+            }
+            return end;
+        },
+        .Optional => |opt| return if (v) |x| dupeDeepSize(opt.child, x, off) else off,
+        else => return off,
+    }
+}
+
+const compact_align = 16;
+
+/// a deep copy of a message in a single allocation of the exact size, with no
+/// parser leftovers. for messages retained long after they're read.
+pub const CompactMessage = struct {
+    value: Message,
+    buf: []align(compact_align) u8,
+    allocator: mem.Allocator,
+
+    /// deep-copies msg which may be deinit'ed right after.
+    pub fn init(allocator: mem.Allocator, msg: Message) !CompactMessage {
+        const size = switch (msg) {
+            inline else => |v| dupeDeepSize(@TypeOf(v), v, 0),
+        };
+        const buf = try allocator.alignedAlloc(u8, compact_align, size);
+        var fba = std.heap.FixedBufferAllocator.init(buf);
+        const value: Message = switch (msg) {
+            // the buffer is sized exactly by dupeDeepSize.
+            inline else => |v, tag| @unionInit(Message, @tagName(tag), dupeDeep(@TypeOf(v), fba.allocator(), v) catch unreachable),
+        };
+        std.debug.assert(fba.end_index == size);
+        return .{ .value = value, .buf = buf, .allocator = allocator };
+    }
+
+    pub fn deinit(self: CompactMessage) void {
+        self.allocator.free(self.buf);
+    }
+};
+
+test "CompactMessage" {
+    const t = std.testing;
+
+    const rep = Message{ .lightning_report = .{
+        .version = "0.17.0",
+        .pubkey = types.PubKey.literal("02" ++ "ab" ** 32),
+        .alias = "",
+        .npeers = 2,
+        .height = 800000,
+        .hash = types.Hash.literal("00" ** 32),
+        .sync = .{ .chain = true, .graph = true },
+        .uris = &.{ "02abcdef@1.2.3.4:9735", "02abcdef@onion:9735" },
+        .totalbalance = .{ .local = 1, .remote = 2, .unsettled = 0, .pending = 0 },
+        .totalfees = .{ .day = 1, .week = 2, .month = 3 },
+        .channels = &.{
+            .{
+                .id = "1",
+                .state = .active,
+                .private = false,
+                .point = types.OutPoint.literal("cd" ** 32 ++ ":0"),
+                .peer_pubkey = types.PubKey.literal("03" ++ "ef" ** 32),
+                .peer_alias = "peer",
+                .capacity = 100,
+                .balance = .{ .local = 1, .remote = 99, .unsettled = 0, .limbo = 0 },
+                .totalsats = .{ .sent = 0, .received = 0 },
+                .fees = .{ .base = 1000, .ppm = 1 },
+            },
+        },
+    } };
+    // init asserts the allocation is used up in full.
+    const c = try CompactMessage.init(t.allocator, rep);
+    defer c.deinit();
+    const got = c.value.lightning_report;
+    try t.expectEqualStrings("0.17.0", got.version);
+    try t.expectEqual(rep.lightning_report.height, got.height);
+    try t.expectEqualStrings("02abcdef@onion:9735", got.uris[1]);
+    try t.expectEqualStrings("peer", got.channels[0].peer_alias);
+    try t.expect(got.channels[0].closetxid == null);
+    const p = @intFromPtr(got.version.ptr);
+    try t.expect(p >= @intFromPtr(c.buf.ptr) and p < @intFromPtr(c.buf.ptr) + c.buf.len);
+
+    const v = try CompactMessage.init(t.allocator, .ping);
+    defer v.deinit();
+    try t.expectEqual(0, v.buf.len);
 }
 
 // TODO: use fifo
@@ -463,6 +1786,13 @@ test "write/read void tags" {
         Message.poweroff,
         Message.standby,
         Message.wakeup,
+        Message.dim,
+        Message.get_ui_perf_report,
+        Message.lightning_report_shm,
+        Message.subscribe_network,
+        Message.unsubscribe_network,
+        Message.subscribe_lightning_peers,
+        Message.unsubscribe_lightning_peers,
     };
 
     for (msg) |m| {
@@ -502,3 +1832,297 @@ test "msg sequence" {
         try t.expectEqual(@as(MessageTag, m), @as(MessageTag, res.value));
     }
 }
+
+test "applyLightningDelta" {
+    const t = std.testing;
+    const tt = @import("test.zig");
+
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const chan = Message.LightningChannel{
+        .state = .active,
+        .private = false,
+        .point = types.OutPoint.literal("01" ** 32 ++ ":0"),
+        .peer_pubkey = types.PubKey.literal("02" ++ "01" ** 32),
+        .peer_alias = "",
+        .capacity = 100,
+        .balance = .{ .local = 60, .remote = 40, .unsettled = 0, .limbo = 0 },
+        .totalsats = .{ .sent = 0, .received = 0 },
+        .fees = .{ .base = 1, .ppm = 1 },
+    };
+    var chan2 = chan;
+    chan2.point = types.OutPoint.literal("02" ** 32 ++ ":0");
+    var chan3 = chan;
+    chan3.point = types.OutPoint.literal("01" ** 32 ++ ":1");
+    const base = Message.LightningReport{
+        .version = "v1",
+        .pubkey = types.PubKey.literal("03" ++ "ab" ** 32),
+        .alias = "alias",
+        .npeers = 2,
+        .height = 800000,
+        .hash = types.Hash.literal("00" ** 32),
+        .sync = .{ .chain = true, .graph = true },
+        .uris = &.{},
+        .totalbalance = .{ .local = 120, .remote = 80, .unsettled = 0, .pending = 0 },
+        .totalfees = .{ .day = 0, .week = 0, .month = 0 },
+        .channels = &.{ chan, chan2 },
+    };
+
+    // no changes
+    const same = try applyLightningDelta(arena, base, .{});
+    try tt.expectDeepEqual(base, same);
+    try t.expect(same.version.ptr != base.version.ptr);
+
+    var chan1upd = chan;
+    chan1upd.peer_alias = "bob";
+    var summary = base;
+    summary.channels = &.{};
+    summary.height = 800001;
+    const rep = try applyLightningDelta(arena, base, .{
+        .summary = summary,
+        .upsert = &.{ chan3, chan1upd },
+        .remove = &.{chan2.point},
+    });
+    var want = base;
+    want.height = 800001;
+    want.channels = &.{ chan1upd, chan3 };
+    try tt.expectDeepEqual(want, rep);
+}
+
+test "write/read binary" {
+    const t = std.testing;
+    const tt = @import("test.zig");
+
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+
+    const msgs = [_]Message{
+        Message.ping,
+        Message{ .comm_features = .{ .binary = true } },
+        Message{ .network_report = .{
+            .ipaddrs = &.{"192.168.0.2"},
+            .wifi_ssid = null,
+            .wifi_scan_networks = &.{ "foo", "bar" },
+        } },
+        Message{ .lightning_report_delta = .{ .remove = &.{types.OutPoint.literal("ab" ** 32 ++ ":0")} } },
+        Message{ .lightning_genseed = .{} },
+        Message{ .ui_perf_report = .{
+            .period = 60000,
+            .timers = .{ .count = 2, .sum = 5, .max = 4, .buckets = &.{ 0, 1, 0, 1 } },
+            .queue = .{},
+            .render = .{},
+            .flush = .{},
+            .area = .{},
+            .objects = 12,
+            .census = .{
+                .objects = 12,
+                .styles = 30,
+                .label_bytes = 64,
+                .classes = &.{ .{ .name = "obj", .count = 8 }, .{ .name = "label", .count = 4 } },
+                .subtrees = &.{.{ .root = .sys, .index = 1, .class = "msgbox_backdrop", .objects = 5, .styles = 11, .label_bytes = 40 }},
+                .lvgl_mem = .{ .used = 4096, .peak = 8192, .large = 0, .pooled = 65536 },
+            },
+        } },
+    };
+    for (msgs) |m| {
+        try writeEncoded(t.allocator, buf.writer(), m, .binary);
+    }
+
+    var bs = std.io.fixedBufferStream(buf.items);
+    for (msgs) |m| {
+        const res = try read(t.allocator, bs.reader());
+        defer res.deinit();
+        try tt.expectDeepEqual(m, res.value);
+    }
+}
+
+test "Writer" {
+    const t = std.testing;
+
+    const fds = try std.posix.pipe();
+    const r = std.fs.File{ .handle = fds[0] };
+    defer r.close();
+    const f = std.fs.File{ .handle = fds[1] };
+    defer f.close();
+
+    var w = Writer.init(t.allocator, f);
+    defer w.deinit();
+    const msgs = [_]Message{
+        Message.ping,
+        Message{ .network_report = .{
+            .ipaddrs = &.{"192.168.0.2"},
+            .wifi_ssid = "wlan",
+            .wifi_scan_networks = &.{ "foo", "bar" },
+            .wifi_link = .{ .signal = -61, .tx_bitrate = 72200, .rx_bitrate = 65000, .retries = 4 },
+        } },
+        Message{ .lightning_report_delta = .{ .remove = &.{types.OutPoint.literal("ab" ** 32 ++ ":0")} } },
+    };
+    for (msgs, 0..) |m, i| {
+        try w.write(m, if (i % 2 == 0) .json else .binary);
+    }
+    for (msgs) |m| {
+        const res = try read(t.allocator, r.reader());
+        defer res.deinit();
+        try @import("test.zig").expectDeepEqual(m, res.value);
+    }
+
+    w.max_payload = 8;
+    try t.expectError(Error.CommWriteTooLarge, w.write(msgs[1], .json));
+    try w.write(Message.pong, .json); // void payload
+    const res = try read(t.allocator, r.reader());
+    defer res.deinit();
+    try t.expectEqual(Message.pong, res.value);
+}
+
+test "QueueWriter" {
+    const t = std.testing;
+
+    const fds = try std.posix.pipe();
+    const r = std.fs.File{ .handle = fds[0] };
+    defer r.close();
+    const f = std.fs.File{ .handle = fds[1] };
+    defer f.close();
+
+    var w = QueueWriter.init(t.allocator, f);
+    defer w.deinit();
+    try w.write(Message.ping, .json); // not started: sent directly
+    {
+        const res = try read(t.allocator, r.reader());
+        defer res.deinit();
+        try t.expectEqual(Message.ping, res.value);
+    }
+
+    // queue without the writer thread to inspect frames.
+    w.queued = true;
+    const report = Message{ .network_report = .{ .ipaddrs = &.{}, .wifi_ssid = null, .wifi_scan_networks = &.{} } };
+    const delta = Message{ .lightning_report_delta = .{ .remove = &.{types.OutPoint.literal("ab" ** 32 ++ ":0")} } };
+    try w.write(report, .json);
+    try w.write(delta, .binary);
+    try w.write(Message.pong, .json);
+    try w.write(report, .binary);
+    try w.write(delta, .binary); // deltas build on each other
+    // pong is a control message and goes ahead of the reports.
+    const want = [_]MessageTag{ .pong, .lightning_report_delta, .network_report, .lightning_report_delta };
+    try t.expectEqual(want.len, w.frames.items.len);
+    for (want, w.frames.items) |tag, fr| try t.expectEqual(tag, fr.tag);
+    try t.expect(QueueWriter.supersedes(.lightning_report, .lightning_report_delta));
+    try t.expect(QueueWriter.supersedes(.report_freshness, .report_freshness));
+    try t.expect(!QueueWriter.supersedes(.lightning_report_delta, .lightning_report));
+    try t.expect(QueueWriter.supersedes(.onchain_report, .bitcoind_startup));
+    try t.expect(!QueueWriter.supersedes(.bitcoind_startup, .onchain_report));
+
+    w.max_frames = want.len;
+    try t.expectError(Error.CommWriteQueueFull, w.write(Message.ping, .json));
+
+    w.max_frames = 64;
+    try w.writeId(Message.ping, .json, 7);
+
+    // the writer thread sends queued frames in order.
+    w.queued = false;
+    try w.start();
+    w.stop();
+    for ([_]MessageTag{ .pong, .ping, .lightning_report_delta, .network_report, .lightning_report_delta }) |tag| {
+        const res = try read(t.allocator, r.reader());
+        defer res.deinit();
+        try t.expectEqual(tag, @as(MessageTag, res.value));
+        try t.expectEqual(@as(u32, if (tag == .ping) 7 else 0), res.id);
+    }
+
+    // a detached writer drops frames until attached to a new reader.
+    w.queued = true;
+    try w.write(report, .json);
+    w.detach();
+    try t.expectEqual(@as(usize, 0), w.frames.items.len);
+    try w.write(report, .json);
+    try t.expectEqual(@as(usize, 0), w.frames.items.len);
+    const fds2 = try std.posix.pipe();
+    const r2 = std.fs.File{ .handle = fds2[0] };
+    defer r2.close();
+    const f2 = std.fs.File{ .handle = fds2[1] };
+    defer f2.close();
+    w.attach(f2);
+    w.queued = false;
+    try w.write(Message.pong, .json);
+    const res = try read(t.allocator, r2.reader());
+    defer res.deinit();
+    try t.expectEqual(Message.pong, res.value);
+}
+
+test "request id" {
+    const t = std.testing;
+
+    const fds = try std.posix.pipe();
+    const r = std.fs.File{ .handle = fds[0] };
+    defer r.close();
+    const f = std.fs.File{ .handle = fds[1] };
+    defer f.close();
+
+    var w = Writer.init(t.allocator, f);
+    defer w.deinit();
+    const id = nextRequestId();
+    try t.expect(id != 0 and nextRequestId() != id);
+    try w.writeId(.{ .lightning_genseed_result = &.{ "word1", "word2" } }, .binary, id);
+    try w.writeId(.{ .screen_unlock_result = .{ .ok = true } }, .binary, id);
+    try w.write(Message.pong, .json);
+    for ([_]u32{ id, id, 0 }) |want| {
+        const res = try read(t.allocator, r.reader());
+        defer res.deinit();
+        try t.expectEqual(want, res.id);
+    }
+    try t.expectEqual(Priority.control, priority(.screen_unlock_result));
+    try t.expectEqual(Priority.bulk, priority(.lightning_report));
+}
+
+test "ui perf histogram percentile" {
+    const t = std.testing;
+    const h = Message.UiPerfReport.Histogram{
+        .count = 10,
+        .sum = 0,
+        .max = 100,
+        // 1 zero, 8 in [4, 8), 1 in [64, 128)
+        .buckets = &.{ 1, 0, 0, 8, 0, 0, 0, 1 },
+    };
+    try t.expectEqual(@as(u64, 0), h.percentile(10));
+    try t.expectEqual(@as(u64, 7), h.percentile(50));
+    try t.expectEqual(@as(u64, 7), h.percentile(90));
+    try t.expectEqual(@as(u64, 100), h.percentile(99));
+    try t.expectEqual(@as(u64, 0), (Message.UiPerfReport.Histogram{}).percentile(50));
+}
+
+test "read unknown tag" {
+    const t = std.testing;
+
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    // no flags: an unknown tag of a newer peer.
+    try buf.writer().writeInt(u16, 0x3fff, .little);
+    try buf.writer().writeInt(u64, 3, .little);
+    try buf.appendSlice("abc");
+    try write(t.allocator, buf.writer(), Message.pong);
+
+    var bs = std.io.fixedBufferStream(buf.items);
+    try t.expectError(Error.CommReadInvalidTag, read(t.allocator, bs.reader()));
+    const res = try read(t.allocator, bs.reader());
+    try t.expectEqual(Message.pong, res.value);
+}
+
+test "read too large" {
+    const t = std.testing;
+
+    const heads = [_]struct { tag: u16, len: u64 }{
+        .{ .tag = @intFromEnum(MessageTag.onchain_report), .len = small_max_payload + 1 },
+        .{ .tag = @intFromEnum(MessageTag.lightning_report), .len = default_max_payload + 1 },
+        .{ .tag = @intFromEnum(MessageTag.ping), .len = 1 },
+        .{ .tag = 0x3fff, .len = std.math.maxInt(u64) },
+    };
+    for (heads) |h| {
+        var buf: [frame_head_size]u8 = undefined;
+        std.mem.writeInt(u16, buf[0..2], h.tag, .little);
+        std.mem.writeInt(u64, buf[2..10], h.len, .little);
+        var bs = std.io.fixedBufferStream(&buf);
+        // nothing is allocated: the testing allocator would fail on huge sizes.
+        try t.expectError(Error.CommReadTooLarge, read(t.failing_allocator, bs.reader()));
+    }
+}
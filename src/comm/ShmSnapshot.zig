@@ -0,0 +1,179 @@
+//! the latest bulk report in a memory region shared by nd and ngui, so that
+//! neither serializes a large report through the comm pipe each cycle: nd
+//! encodes the report right into the region and sends a tiny notification
+//! message, upon which ngui picks the report up from the region.
+//!
+//! the region is a memfd: nd creates it and ngui inherits its descriptor.
+//! a header is followed by two slots, each holding a comm frame with a
+//! binary payload. the writer fills the slot not marked latest and then marks
+//! it, so a reader is never in the way of the next report. each slot has a
+//! seqlock counter, odd while the slot is written: a reader copies the frame
+//! out of the slot and retries should the counter have changed meanwhile,
+//! which happens only if two reports are written during a single read.
+//!
+//! a single writer process and thread; any number of readers.
+
+const std = @import("std");
+const posix = std.posix;
+
+const binary = @import("binary.zig");
+const comm = @import("../comm.zig");
+
+/// region mapping, header followed by the slots.
+mem: []align(std.mem.page_size) u8,
+fd: posix.fd_t,
+
+const ShmSnapshot = @This();
+
+const Header = extern struct {
+    magic: [4]u8 = magic,
+    slot_size: u32,
+    latest: u32 = 0, // slot index of the newest complete frame
+    seq: [2]u32 = .{ 0, 0 }, // per slot; odd while written, 0 if never written
+    len: [2]u32 = .{ 0, 0 }, // frame length in each slot
+};
+
+const magic = "ndsh".*;
+const slots_offset = 64;
+/// size of the frame head preceding a payload: wire tag and length.
+const frame_head_size = 2 + 8;
+/// reads retried this many times give up with ShmSnapshotBusy.
+const max_read_tries = 16;
+
+comptime {
+    std.debug.assert(@sizeOf(Header) <= slots_offset);
+}
+
+/// creates a region with slots of slot_size, a frame each, and maps it.
+/// the descriptor is inherited by child processes, to be opened from
+/// there with open. callers must deinit when done.
+pub fn create(slot_size: u32) !ShmSnapshot {
+    const fd = try posix.memfd_create("ndg-reports", 0);
+    errdefer posix.close(fd);
+    const size = slots_offset + 2 * @as(usize, slot_size);
+    try posix.ftruncate(fd, size);
+    const m = try posix.mmap(null, size, posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, fd, 0);
+    const hdr: *Header = @ptrCast(m.ptr);
+    hdr.* = .{ .slot_size = slot_size };
+    return .{ .mem = m, .fd = fd };
+}
+
+/// maps a region created with create, for reading, and takes ownership of fd.
+/// callers must deinit when done.
+pub fn open(fd: posix.fd_t) !ShmSnapshot {
+    const stat = try posix.fstat(fd);
+    const size: usize = @intCast(stat.size);
+    if (size < slots_offset) {
+        return error.ShmSnapshotInvalid;
+    }
+    const m = try posix.mmap(null, size, posix.PROT.READ, .{ .TYPE = .SHARED }, fd, 0);
+    errdefer posix.munmap(m);
+    const hdr: *const Header = @ptrCast(m.ptr);
+    if (!std.mem.eql(u8, &hdr.magic, &magic) or slots_offset + 2 * @as(usize, hdr.slot_size) > size) {
+        return error.ShmSnapshotInvalid;
+    }
+    return .{ .mem = m, .fd = fd };
+}
+
+/// unmaps the region and closes its descriptor.
+pub fn deinit(self: *ShmSnapshot) void {
+    posix.munmap(self.mem);
+    posix.close(self.fd);
+}
+
+fn header(self: ShmSnapshot) *Header {
+    return @ptrCast(self.mem.ptr);
+}
+
+fn slot(self: ShmSnapshot, i: u32) []u8 {
+    const size: usize = self.header().slot_size;
+    return self.mem[slots_offset + i * size ..][0..size];
+}
+
+/// encodes msg, a report of a non-void payload, straight into the free slot
+/// and marks it latest. a frame larger than a slot results in
+/// error.NoSpaceLeft, leaving the latest one in place.
+/// only the process which created the region may write to it.
+pub fn write(self: *ShmSnapshot, msg: comm.Message) !void {
+    const hdr = self.header();
+    const i = 1 - @atomicLoad(u32, &hdr.latest, .monotonic);
+    const seq = @atomicLoad(u32, &hdr.seq[i], .monotonic);
+    @atomicStore(u32, &hdr.seq[i], seq +% 1, .monotonic);
+    @fence(.release); // the odd seq is visible before any slot change
+    const data = self.slot(i);
+    var fbs = std.io.fixedBufferStream(data[frame_head_size..]);
+    const res = switch (msg) {
+        inline else => |v| binary.encode(fbs.writer(), v),
+    };
+    res catch |err| {
+        // the slot holds no complete frame anymore.
+        @atomicStore(u32, &hdr.len[i], 0, .monotonic);
+        @atomicStore(u32, &hdr.seq[i], seq +% 2, .release);
+        return err;
+    };
+    const len = fbs.pos;
+    std.mem.writeInt(u16, data[0..2], @intFromEnum(msg) | comm.binary_tag_flag, .little);
+    std.mem.writeInt(u64, data[2..frame_head_size], len, .little);
+    @atomicStore(u32, &hdr.len[i], @intCast(frame_head_size + len), .monotonic);
+    @atomicStore(u32, &hdr.seq[i], seq +% 2, .release);
+    @atomicStore(u32, &hdr.latest, i, .release);
+}
+
+/// returns a copy of the latest message written, or error.ShmSnapshotEmpty
+/// if none. callers own the result and must deinit it.
+pub fn read(self: ShmSnapshot, allocator: std.mem.Allocator) !comm.ParsedMessage {
+    const hdr = self.header();
+    var buf = std.ArrayList(u8).init(allocator);
+    defer buf.deinit();
+    for (0..max_read_tries) |_| {
+        const i = @atomicLoad(u32, &hdr.latest, .acquire);
+        if (i > 1) {
+            return error.ShmSnapshotInvalid;
+        }
+        const seq = @atomicLoad(u32, &hdr.seq[i], .acquire);
+        if (seq == 0) {
+            return error.ShmSnapshotEmpty;
+        }
+        if (seq & 1 != 0) {
+            std.atomic.spinLoopHint();
+            continue;
+        }
+        const len = @atomicLoad(u32, &hdr.len[i], .monotonic);
+        if (len < frame_head_size or len > hdr.slot_size) {
+            continue; // torn read
+        }
+        try buf.resize(len);
+        @memcpy(buf.items, self.slot(i)[0..len]);
+        @fence(.acquire); // the copy is done before the seq check
+        if (@atomicLoad(u32, &hdr.seq[i], .monotonic) != seq) {
+            continue;
+        }
+        var fbs = std.io.fixedBufferStream(buf.items);
+        return comm.read(allocator, fbs.reader());
+    }
+    return error.ShmSnapshotBusy;
+}
+
+test "shm snapshot" {
+    const t = std.testing;
+
+    var w = try ShmSnapshot.create(4096);
+    defer w.deinit();
+    var r = try ShmSnapshot.open(try posix.dup(w.fd));
+    defer r.deinit();
+    try t.expectError(error.ShmSnapshotEmpty, r.read(t.allocator));
+
+    for ([_]u64{ 1, 2, 3 }) |v| {
+        try w.write(.{ .lightning_report_delta = .{ .remove = &.{.{ .txid = .{ .bytes = [_]u8{@intCast(v)} ** 32 }, .index = @intCast(v) }} } });
+        const msg = try r.read(t.allocator);
+        defer msg.deinit();
+        try t.expectEqual(@as(u32, @intCast(v)), msg.value.lightning_report_delta.remove[0].index);
+    }
+
+    // a frame too large keeps the latest one.
+    const big = [_]u8{'x'} ** 8192;
+    try t.expectError(error.NoSpaceLeft, w.write(.{ .set_nodename = &big }));
+    const msg = try r.read(t.allocator);
+    defer msg.deinit();
+    try t.expectEqual(@as(u32, 3), msg.value.lightning_report_delta.remove[0].index);
+}
@@ -0,0 +1,249 @@
+//! compact binary encoding of comm message payloads, derived at comptime from
+//! the payload types. unlike json, no field names are sent over the wire and
+//! strings are decoded without copying.
+//!
+//! an encoded value starts with the format version byte, followed by, all
+//! integers in little endian:
+//!
+//!   - bool: u8, 0 or 1
+//!   - int: byte aligned width of the type; usize and isize as 64 bits
+//!   - float: raw bits as unsigned int of the same width
+//!   - enum: the tag value as int
+//!   - optional: u8 presence flag followed by the value, if non-null
+//!   - slice: u32 elements count followed by the elements
+//!   - array: the elements
+//!   - struct: all fields in declaration order
+//!   - tagged union: the tag followed by the active field value
+//!   - void: nothing
+//!
+//! field order is a part of the format: reordering fields of a message payload
+//! type requires a version bump.
+
+const std = @import("std");
+
+pub const version: u8 = 1;
+
+pub const Error = error{
+    BinaryUnsupportedVersion,
+    BinaryShortBuffer,
+    BinaryInvalidValue,
+    BinaryTrailingBytes,
+    BinaryTooLarge,
+};
+
+pub const DecodeError = Error || std.mem.Allocator.Error;
+
+/// outputs v in binary format using writer.
+pub fn encode(writer: anytype, v: anytype) !void {
+    try writer.writeByte(version);
+    try encodeValue(writer, v);
+}
+
+fn encodeValue(writer: anytype, v: anytype) !void {
+    const T = @TypeOf(v);
+    switch (@typeInfo(T)) {
+        .Void => {},
+        .Bool => try writer.writeByte(@intFromBool(v)),
+        .Int => try writer.writeInt(WireInt(T), v, .little),
+        .Float => |f| try writer.writeInt(std.meta.Int(.unsigned, f.bits), @bitCast(v), .little),
+        .Enum => try encodeValue(writer, @intFromEnum(v)),
+        .Optional => {
+            if (v) |x| {
+                try writer.writeByte(1);
+                try encodeValue(writer, x);
+            } else {
+                try writer.writeByte(0);
+            }
+        },
+        .Pointer => |p| {
+            if (p.size != .Slice or p.sentinel != null) {
+                @compileError("binary: unsupported pointer type " ++ @typeName(T));
+            }
+            if (v.len > std.math.maxInt(u32)) {
+                return Error.BinaryTooLarge;
+            }
+            try writer.writeInt(u32, @intCast(v.len), .little);
+            if (p.child == u8) {
+                try writer.writeAll(v);
+            } else {
+                for (v) |x| try encodeValue(writer, x);
+            }
+        },
+        .Array => for (v) |x| try encodeValue(writer, x),
+        .Struct => |st| inline for (st.fields) |f| {
+            try encodeValue(writer, @field(v, f.name));
+        },
+        .Union => |u| {
+            const Tag = u.tag_type orelse @compileError("binary: untagged union " ++ @typeName(T));
+            try encodeValue(writer, @as(Tag, v));
+            switch (v) {
+                inline else => |x| try encodeValue(writer, x),
+            }
+        },
+        else => @compileError("binary: unsupported type " ++ @typeName(T)),
+    }
+}
+
+/// decodes a value of type T from buf, as produced by encode.
+/// const u8 slices in the result point into buf which must outlive the value.
+/// other slices are allocated using the allocator, expected to be an arena:
+/// partial allocations are not freed on error.
+pub fn decode(comptime T: type, allocator: std.mem.Allocator, buf: []const u8) DecodeError!T {
+    var d = Decoder{ .allocator = allocator, .buf = buf };
+    if (try d.byte() != version) {
+        return Error.BinaryUnsupportedVersion;
+    }
+    const v = try d.value(T);
+    if (d.pos != buf.len) {
+        return Error.BinaryTrailingBytes;
+    }
+    return v;
+}
+
+const Decoder = struct {
+    allocator: std.mem.Allocator,
+    buf: []const u8,
+    pos: usize = 0,
+
+    fn take(self: *Decoder, n: usize) Error![]const u8 {
+        if (n > self.buf.len - self.pos) {
+            return Error.BinaryShortBuffer;
+        }
+        defer self.pos += n;
+        return self.buf[self.pos..][0..n];
+    }
+
+    fn byte(self: *Decoder) Error!u8 {
+        return (try self.take(1))[0];
+    }
+
+    fn int(self: *Decoder, comptime W: type) Error!W {
+        const n = @divExact(@typeInfo(W).Int.bits, 8);
+        const b = try self.take(n);
+        return std.mem.readInt(W, b[0..n], .little);
+    }
+
+    fn value(self: *Decoder, comptime T: type) DecodeError!T {
+        switch (@typeInfo(T)) {
+            .Void => return {},
+            .Bool => return switch (try self.byte()) {
+                0 => false,
+                1 => true,
+                else => Error.BinaryInvalidValue,
+            },
+            .Int => return std.math.cast(T, try self.int(WireInt(T))) orelse Error.BinaryInvalidValue,
+            .Float => |f| return @bitCast(try self.int(std.meta.Int(.unsigned, f.bits))),
+            .Enum => |e| {
+                const tag = try self.value(e.tag_type);
+                return std.meta.intToEnum(T, tag) catch Error.BinaryInvalidValue;
+            },
+            .Optional => |opt| return switch (try self.byte()) {
+                0 => null,
+                1 => try self.value(opt.child),
+                else => Error.BinaryInvalidValue,
+            },
+            .Pointer => |p| {
+                if (p.size != .Slice or p.sentinel != null) {
+                    @compileError("binary: unsupported pointer type " ++ @typeName(T));
+                }
+                const n = try self.int(u32);
+                if (p.child == u8) {
+                    const b = try self.take(n);
+                    return if (p.is_const) b else self.allocator.dupe(u8, b);
+                }
+                // all message payload elements take at least one byte:
+                // reject bogus counts before allocating.
+                if (n > self.buf.len - self.pos) {
+                    return Error.BinaryShortBuffer;
+                }
+                const s = try self.allocator.alloc(p.child, n);
+                for (s) |*x| x.* = try self.value(p.child);
+                return s;
+            },
+            .Array => |a| {
+                var arr: T = undefined;
+                for (&arr) |*x| x.* = try self.value(a.child);
+                return arr;
+            },
+            .Struct => |st| {
+                var v: T = undefined;
+                inline for (st.fields) |f| {
+                    @field(v, f.name) = try self.value(f.type);
+                }
+                return v;
+            },
+            .Union => |u| {
+                const Tag = u.tag_type orelse @compileError("binary: untagged union " ++ @typeName(T));
+                switch (try self.value(Tag)) {
+                    inline else => |t| {
+                        const payload = try self.value(std.meta.TagPayload(T, t));
+                        return @unionInit(T, @tagName(t), payload);
+                    },
+                }
+            },
+            else => @compileError("binary: unsupported type " ++ @typeName(T)),
+        }
+    }
+};
+
+/// returns the wire int type for T.
+fn WireInt(comptime T: type) type {
+    const info = @typeInfo(T).Int;
+    const bits: u16 = if (T == usize or T == isize) 64 else info.bits;
+    return std.meta.Int(info.signedness, std.mem.alignForward(u16, bits, 8));
+}
+
+test "binary roundtrip" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    const Mut = struct { x: i16 };
+    const T = struct {
+        b: bool,
+        u: u7,
+        i: i64,
+        n: usize,
+        f: f32,
+        e: enum { one, two },
+        name: []const u8,
+        opt: ?[]const u8,
+        none: ?u16,
+        list: []const struct { s: []const u8, v: u32 },
+        mut: []Mut,
+        arr: [2]u8,
+        un: union(enum) { a: void, b: u8 },
+    };
+    var mut = [_]Mut{ .{ .x = -1 }, .{ .x = 2 } };
+    const v = T{
+        .b = true,
+        .u = 100,
+        .i = -12345678901,
+        .n = 42,
+        .f = 1.5,
+        .e = .two,
+        .name = "hello",
+        .opt = "world",
+        .none = null,
+        .list = &.{ .{ .s = "a", .v = 1 }, .{ .s = "", .v = 2 } },
+        .mut = &mut,
+        .arr = .{ 3, 4 },
+        .un = .{ .b = 5 },
+    };
+
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    try encode(buf.writer(), v);
+
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const res = try decode(T, arena_state.allocator(), buf.items);
+    try tt.expectDeepEqual(v, res);
+    // zero-copy strings
+    try t.expect(@intFromPtr(res.name.ptr) >= @intFromPtr(buf.items.ptr));
+    try t.expect(@intFromPtr(res.name.ptr) < @intFromPtr(buf.items.ptr) + buf.items.len);
+
+    try t.expectError(Error.BinaryShortBuffer, decode(T, arena_state.allocator(), buf.items[0 .. buf.items.len - 1]));
+    try t.expectError(Error.BinaryUnsupportedVersion, decode(T, arena_state.allocator(), &.{0}));
+    try buf.append(0);
+    try t.expectError(Error.BinaryTrailingBytes, decode(T, arena_state.allocator(), buf.items));
+}
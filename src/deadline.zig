@@ -0,0 +1,165 @@
+//! per-thread call deadlines, set by a caller such as a report loop around
+//! a batch of RPC client calls which must complete in time as a whole.
+//! clients honour the deadline of the calling thread, if any: connects,
+//! socket reads and writes are bounded by the time left, and calls fail with
+//! error.DeadlineExceeded past it. threads spawned to make calls on behalf of
+//! the caller take its deadline with get and inherit.
+
+const std = @import("std");
+const posix = std.posix;
+const time = std.time;
+
+/// the deadline of the calling thread, in time.milliTimestamp; null if none.
+threadlocal var current: ?i64 = null;
+
+/// sets the thread deadline to timeout_ms from now, unless an earlier one is
+/// set already. returns the previous deadline, to be restored with end.
+pub fn begin(timeout_ms: u32) ?i64 {
+    const prev = current;
+    current = earliest(prev, time.milliTimestamp() + timeout_ms);
+    return prev;
+}
+
+/// restores the thread deadline as returned by begin.
+pub fn end(prev: ?i64) void {
+    current = prev;
+}
+
+/// returns the thread deadline, for passing on to another thread.
+pub fn get() ?i64 {
+    return current;
+}
+
+/// sets the thread deadline as returned by get in another thread.
+pub fn inherit(d: ?i64) void {
+    current = d;
+}
+
+/// returns the earlier of the thread deadline and timeout_ms from now.
+pub fn within(timeout_ms: u32) i64 {
+    return earliest(current, time.milliTimestamp() + timeout_ms).?;
+}
+
+fn earliest(a: ?i64, b: ?i64) ?i64 {
+    const x = a orelse return b;
+    const y = b orelse return x;
+    return @min(x, y);
+}
+
+/// reports whether d is set and past.
+pub fn exceeded(d: ?i64) bool {
+    const v = d orelse return false;
+    return time.milliTimestamp() >= v;
+}
+
+/// returns the time left until d in ms, at least 1.
+pub fn remainingMs(d: i64) error{DeadlineExceeded}!u32 {
+    const left = d - time.milliTimestamp();
+    if (left <= 0) {
+        return error.DeadlineExceeded;
+    }
+    return std.math.lossyCast(u32, left);
+}
+
+/// opens a TCP connection to addr, waiting for it until d at most.
+pub fn tcpConnect(addr: std.net.Address, d: i64) !std.net.Stream {
+    const flags = posix.SOCK.STREAM | posix.SOCK.NONBLOCK | posix.SOCK.CLOEXEC;
+    const sock = try posix.socket(addr.any.family, flags, posix.IPPROTO.TCP);
+    errdefer posix.close(sock);
+    posix.connect(sock, &addr.any, addr.getOsSockLen()) catch |err| switch (err) {
+        error.WouldBlock => {
+            var fds = [_]posix.pollfd{.{ .fd = sock, .events = posix.POLL.OUT, .revents = 0 }};
+            const ms: i32 = std.math.lossyCast(i32, try remainingMs(d));
+            if (try posix.poll(&fds, ms) == 0) {
+                return error.DeadlineExceeded;
+            }
+            try posix.getsockoptError(sock);
+        },
+        else => |e| return e,
+    };
+    // blocking from now on, as std.net streams are; see setSocketTimeout.
+    const fl = try posix.fcntl(sock, posix.F.GETFL, 0);
+    const nonblock: usize = @as(u32, @bitCast(posix.O{ .NONBLOCK = true }));
+    _ = try posix.fcntl(sock, posix.F.SETFL, fl & ~nonblock);
+    return .{ .handle = sock };
+}
+
+/// bounds each blocking read and write on the socket to the time left until d,
+/// or lifts the bound if d is null. a read or write timing out fails with
+/// error.WouldBlock; callers map it to error.DeadlineExceeded with exceeded.
+pub fn setSocketTimeout(sock: posix.socket_t, d: ?i64) !void {
+    const ms: u32 = if (d) |v| try remainingMs(v) else 0;
+    const tv = posix.timeval{
+        .tv_sec = @intCast(ms / time.ms_per_s),
+        .tv_usec = @intCast(ms % time.ms_per_s * time.us_per_ms),
+    };
+    try posix.setsockopt(sock, posix.SOL.SOCKET, posix.SO.RCVTIMEO, std.mem.asBytes(&tv));
+    try posix.setsockopt(sock, posix.SOL.SOCKET, posix.SO.SNDTIMEO, std.mem.asBytes(&tv));
+}
+
+/// returns a reader of r failing with error.DeadlineExceeded once past d,
+/// checked ahead of each read and upon a failed one. socket timeouts bound
+/// each read on its own; the reader bounds them all together.
+pub fn reader(r: anytype, d: ?i64) Reader(@TypeOf(r)) {
+    return .{ .inner = r, .deadline = d };
+}
+
+pub fn Reader(comptime R: type) type {
+    return struct {
+        inner: R,
+        deadline: ?i64,
+
+        const Self = @This();
+        pub const Error = R.Error || error{DeadlineExceeded};
+        pub const GenericReader = std.io.Reader(*Self, Error, read);
+
+        pub fn reader(self: *Self) GenericReader {
+            return .{ .context = self };
+        }
+
+        fn read(self: *Self, buf: []u8) Error!usize {
+            const d = self.deadline orelse return self.inner.read(buf);
+            _ = try remainingMs(d);
+            return self.inner.read(buf) catch |err| {
+                return if (exceeded(d)) error.DeadlineExceeded else err;
+            };
+        }
+    };
+}
+
+test "deadline" {
+    const t = std.testing;
+
+    try t.expect(get() == null);
+    const prev = begin(60 * time.ms_per_s);
+    try t.expect(prev == null);
+    const d = get().?;
+    // a later deadline doesn't extend an earlier one.
+    const prev2 = begin(120 * time.ms_per_s);
+    try t.expectEqual(d, get().?);
+    try t.expect(within(1) <= d);
+    try t.expect(within(120 * time.ms_per_s) == d);
+    end(prev2);
+    try t.expectEqual(d, get().?);
+    end(prev);
+    try t.expect(get() == null);
+
+    try t.expect(!exceeded(null));
+    try t.expect(exceeded(time.milliTimestamp() - 1));
+    try t.expectError(error.DeadlineExceeded, remainingMs(time.milliTimestamp()));
+
+    // a peer which accepts and never responds.
+    const addr = try std.net.Address.parseIp4("127.0.0.1", 0);
+    var srv = try addr.listen(.{ .reuse_address = true });
+    defer srv.deinit();
+    const dl = time.milliTimestamp() + 100;
+    const stream = try tcpConnect(srv.listen_address, dl);
+    defer stream.close();
+    const conn = try srv.accept();
+    defer conn.stream.close();
+    try setSocketTimeout(stream.handle, dl);
+    var dr = reader(stream.reader(), dl);
+    var buf: [16]u8 = undefined;
+    try t.expectError(error.DeadlineExceeded, dr.reader().read(&buf));
+    try t.expect(exceeded(dl));
+}
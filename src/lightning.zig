@@ -1,5 +1,7 @@
+pub const bbolt = @import("lightning/bbolt.zig");
 pub const LndConf = @import("lightning/LndConf.zig");
 pub const lndhttp = @import("lightning/lndhttp.zig");
+pub const lndrpc = @import("lightning/lndrpc.zig");
 
 test {
     const std = @import("std");
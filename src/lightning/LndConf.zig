@@ -3,6 +3,11 @@
 //!
 //! see https://docs.lightning.engineering/lightning-network-tools/lnd/lnd.conf
 //! for lnd config docs.
+//!
+//! a loaded config retains the file contents, and the position of each
+//! property line in it. serializing writes the contents back byte for byte,
+//! patching only the lines of changed properties: comments and formatting are
+//! preserved and an unmodified config reproduces the file exactly.
 
 const std = @import("std");
 const ini = @import("ini");
@@ -10,10 +15,17 @@ const ini = @import("ini");
 const logger = std.log.scoped(.lndconf);
 
 sections: std.ArrayList(Section),
+/// section name to the index of its first occurrence in `sections`.
+index: std.StringHashMapUnmanaged(usize) = .{},
+/// the config file contents as loaded; empty for configs created with `init`.
+source: []const u8 = "",
 // holds section allocations and their key/value pairs.
 // initialized at `init` and dropped at `deinit`.
 arena: *std.heap.ArenaAllocator,
 
+/// max size of a config file `load` reads.
+const max_file_size = 1 << 20;
+
 // case-insensitive default group name according to source doc comments
 // at github.com/jessevdk/go-flags
 pub const MainSection = "application options";
@@ -29,6 +41,14 @@ pub const Section = struct {
     /// initialized in `appendSection`.
     alloc: std.mem.Allocator,
 
+    /// property lines of the section in `LndConf.source`, in order.
+    lines: std.ArrayListUnmanaged(SourceLine) = .{},
+    /// key to the number of its lines in `lines`.
+    nlines: std.StringHashMapUnmanaged(usize) = .{},
+    /// offset in `LndConf.source` where new properties are inserted: the end of
+    /// the last line of the section. null for sections appended after load.
+    insert_at: ?usize = null,
+
     /// key and value are dup'ed by `Section.alloc`.
     /// if an existing property exist, it necessarily becomes an array and the
     /// new value is appended to the array.
@@ -69,6 +89,23 @@ pub const Section = struct {
         res.value_ptr.* = .{ .str = vdup };
     }
 
+    /// records a property line of the section as loaded from source.
+    fn addSourceLine(self: *Section, span: Span, key: []const u8, value: []const u8) !void {
+        const kdup = try self.alloc.dupe(u8, key);
+        const res = try self.nlines.getOrPut(self.alloc, kdup);
+        if (!res.found_existing) {
+            res.value_ptr.* = 0;
+        }
+        try self.lines.append(self.alloc, .{
+            .span = span,
+            .key = kdup,
+            .value = try self.alloc.dupe(u8, value),
+            .nth = res.value_ptr.*,
+        });
+        res.value_ptr.* += 1;
+        self.insert_at = span.end;
+    }
+
     /// formats value using `std.fmt.format` and calls `setPropStr`.
     /// the resulting formatted value cannot exceed 512 characters.
     pub fn setPropFmt(self: *Section, key: []const u8, comptime fmt: []const u8, args: anytype) !void {
@@ -83,6 +120,14 @@ pub const PropValue = union(enum) {
     str: []const u8, // a "string"
     astr: [][]const u8, // an array of strings, all values of repeated keys
 
+    /// returns all values in order: a single one for `str`.
+    pub fn values(self: *const PropValue) []const []const u8 {
+        return switch (self.*) {
+            .str => |*s| s[0..1],
+            .astr => |a| a,
+        };
+    }
+
     /// used internally when replacing an existing value in functions such as
     /// `Section.setPropStr`
     fn free(self: PropValue, allocator: std.mem.Allocator) void {
@@ -96,6 +141,20 @@ pub const PropValue = union(enum) {
     }
 };
 
+/// a byte range of `LndConf.source`.
+const Span = struct {
+    start: usize,
+    end: usize, // exclusive; includes the newline, if any
+};
+
+/// a property line as loaded.
+const SourceLine = struct {
+    span: Span,
+    key: []const u8,
+    value: []const u8, // as parsed, without comments
+    nth: usize, // index of the value among all values of the key in the section
+};
+
 const LndConf = @This();
 
 /// creates a empty config, ready to be populated start with `appendSection`.
@@ -119,6 +178,7 @@ pub fn deinit(self: LndConf) void {
 
 /// parses an existing config at the specified file path.
 /// a thin wrapper around `loadReader` passing it a file reader.
+/// the file size is limited to 1MiB.
 pub fn load(allocator: std.mem.Allocator, filepath: []const u8) !LndConf {
     const f = try std.fs.cwd().openFile(filepath, .{ .mode = .read_only });
     defer f.close();
@@ -130,21 +190,30 @@ pub fn load(allocator: std.mem.Allocator, filepath: []const u8) !LndConf {
 /// in the encountered order, with ascii characters of the name converted to lower case.
 /// values of identical key names are grouped into `PropValue.astr`.
 pub fn loadReader(allocator: std.mem.Allocator, r: anytype) !LndConf {
-    var parser = ini.parse(allocator, r);
-    defer parser.deinit();
-
     var conf = try LndConf.init(allocator);
     errdefer conf.deinit();
+    conf.source = try r.readAllAlloc(conf.arena.allocator(), max_file_size);
+
+    // the parser reads a line per record: the stream position after a record
+    // is the end of its line.
+    var fbs = std.io.fixedBufferStream(conf.source);
+    var parser = ini.parse(allocator, fbs.reader());
+    defer parser.deinit();
 
     var currsect: ?*Section = null;
     while (try parser.next()) |record| {
+        const line = lineEndingAt(conf.source, fbs.pos);
         switch (record) {
-            .section => |name| currsect = try conf.appendSection(name),
+            .section => |name| {
+                currsect = try conf.appendSection(name);
+                currsect.?.insert_at = line.end;
+            },
             .property => |kv| {
                 if (currsect == null) {
                     currsect = try conf.appendDefaultSection();
                 }
                 try currsect.?.appendPropStr(kv.key, kv.value);
+                try currsect.?.addSourceLine(line, kv.key, kv.value);
             },
             .enumeration => |v| logger.warn("ignoring key without value: {s}", .{v}),
         }
@@ -153,12 +222,65 @@ pub fn loadReader(allocator: std.mem.Allocator, r: anytype) !LndConf {
     return conf;
 }
 
+/// returns the line of source ending at offset end.
+fn lineEndingAt(source: []const u8, end: usize) Span {
+    const body_end = if (end > 0 and source[end - 1] == '\n') end - 1 else end;
+    const start = if (std.mem.lastIndexOfScalar(u8, source[0..body_end], '\n')) |i| i + 1 else 0;
+    return .{ .start = start, .end = end };
+}
+
 /// serializes the config into writer `w`.
+/// loaded sections are written as in `source` except for changed properties:
+/// a line of a changed value is replaced, one of a removed value is dropped,
+/// and new values are inserted after the last line of their section.
+/// sections appended after load follow at the end.
 pub fn dumpWriter(self: LndConf, w: anytype) !void {
-    for (self.sections.items, 0..) |*sec, i| {
-        if (i > 0) {
+    var pos: usize = 0; // source bytes written so far
+    for (self.sections.items) |*sec| {
+        const insert_at = sec.insert_at orelse continue;
+        for (sec.lines.items) |line| {
+            try w.writeAll(self.source[pos..line.span.start]);
+            pos = line.span.end;
+            const vals = if (sec.props.getPtr(line.key)) |v| v.values() else &[_][]const u8{};
+            if (line.nth >= vals.len) {
+                continue; // removed
+            }
+            if (std.mem.eql(u8, vals[line.nth], line.value)) {
+                try w.writeAll(self.source[line.span.start..line.span.end]);
+            } else {
+                try w.print("{s}={s}\n", .{ line.key, vals[line.nth] });
+            }
+        }
+        try w.writeAll(self.source[pos..insert_at]);
+        pos = insert_at;
+        var newline = pos > 0 and self.source[pos - 1] != '\n';
+        var it = sec.props.iterator();
+        while (it.next()) |kv| {
+            const vals = kv.value_ptr.values();
+            const n = @min(sec.nlines.get(kv.key_ptr.*) orelse 0, vals.len);
+            for (vals[n..]) |v| {
+                if (newline) {
+                    try w.writeByte('\n'); // the section ends the file with no newline
+                    newline = false;
+                }
+                try w.print("{s}={s}\n", .{ kv.key_ptr.*, v });
+            }
+        }
+    }
+    try w.writeAll(self.source[pos..]);
+
+    var sep = self.source.len > 0;
+    if (sep and self.source[self.source.len - 1] != '\n') {
+        try w.writeByte('\n');
+    }
+    for (self.sections.items) |*sec| {
+        if (sec.insert_at != null) {
+            continue;
+        }
+        if (sep) {
             try w.writeByte('\n');
         }
+        sep = true;
         try w.print("[{s}]\n", .{sec.name});
         var it = sec.props.iterator();
         while (it.next()) |kv| {
@@ -186,7 +308,12 @@ pub fn appendSection(self: *LndConf, name: []const u8) !*Section {
         .props = std.StringArrayHashMap(PropValue).init(alloc),
         .alloc = alloc,
     });
-    return &self.sections.items[self.sections.items.len - 1];
+    const i = self.sections.items.len - 1;
+    const res = try self.index.getOrPut(alloc, low_name);
+    if (!res.found_existing) {
+        res.value_ptr.* = i;
+    }
+    return &self.sections.items[i];
 }
 
 /// returns a section named `MainSection`, if any.
@@ -194,14 +321,10 @@ pub fn mainSection(self: LndConf) ?*Section {
     return self.findSection(MainSection);
 }
 
-/// O(n); name must be in lower case.
+/// returns the first section of the name which must be in lower case.
 pub fn findSection(self: *const LndConf, name: []const u8) ?*Section {
-    for (self.sections.items) |*sec| {
-        if (std.mem.eql(u8, sec.name, name)) {
-            return sec;
-        }
-    }
-    return null;
+    const i = self.index.get(name) orelse return null;
+    return &self.sections.items[i];
 }
 
 /// returns alias field value from the main section.
@@ -240,24 +363,15 @@ test "lnd: conf load dump" {
         \\[AutopiloT]
         \\autopilot.active=false
     );
-    const clean_conf =
-        \\[application options]
-        \\foo=bar
-        \\baz=quix1
-        \\baz=quix2
-        \\
-        \\[autopilot]
-        \\autopilot.active=false
-        \\
-    ;
-
     const conf = try LndConf.load(t.allocator, try tmp.join(&.{"conf.ini"}));
     defer conf.deinit();
 
+    // unmodified config is serialized as is.
     var dump = std.ArrayList(u8).init(t.allocator);
     defer dump.deinit();
     try conf.dumpWriter(dump.writer());
-    try t.expectEqualStrings(clean_conf, dump.items);
+    try t.expectEqualStrings(conf.source, dump.items);
+    try t.expect(conf.findSection("autopilot") != null);
 
     const sec = conf.mainSection().?;
     try t.expectEqualStrings("bar", sec.props.get("foo").?.str);
@@ -327,3 +441,58 @@ test "lnd: conf alias" {
     ;
     try t.expectEqualStrings(want_alias2, buf.items);
 }
+
+test "lnd: conf patch loaded" {
+    const t = std.testing;
+
+    const source =
+        \\; top comment
+        \\alias = oldname ; the node alias
+        \\
+        \\[Bitcoin]
+        \\bitcoin.active=true
+        \\; peers
+        \\bitcoin.node = bitcoind
+        \\
+        \\[tor]
+        \\tor.active=true
+        \\tor.v3=true
+    ;
+    var fbs = std.io.fixedBufferStream(source);
+    var conf = try LndConf.loadReader(t.allocator, fbs.reader());
+    defer conf.deinit();
+    try t.expectEqualStrings("oldname", conf.alias());
+
+    try conf.setAlias("newname");
+    const btc = conf.findSection("bitcoin").?;
+    try btc.setPropStr("bitcoin.node", "neutrino");
+    try btc.appendPropStr("bitcoin.node", "btcd");
+    try btc.setPropStr("bitcoin.mainnet", "true");
+    try conf.findSection("tor").?.setPropStr("tor.skip-proxy-for-clearnet-targets", "true");
+    const sec = try conf.appendSection("autopilot");
+    try sec.setPropStr("autopilot.active", "false");
+
+    var dump = std.ArrayList(u8).init(t.allocator);
+    defer dump.deinit();
+    try conf.dumpWriter(dump.writer());
+    try t.expectEqualStrings(
+        \\; top comment
+        \\alias=newname
+        \\
+        \\[Bitcoin]
+        \\bitcoin.active=true
+        \\; peers
+        \\bitcoin.node=neutrino
+        \\bitcoin.node=btcd
+        \\bitcoin.mainnet=true
+        \\
+        \\[tor]
+        \\tor.active=true
+        \\tor.v3=true
+        \\tor.skip-proxy-for-clearnet-targets=true
+        \\
+        \\[autopilot]
+        \\autopilot.active=false
+        \\
+    , dump.items);
+}
@@ -0,0 +1,233 @@
+//! read-only inspection of bbolt database files, the key-value store of lnd
+//! channel.db, to estimate the space a compaction reclaims without opening
+//! the database. see https://github.com/etcd-io/bbolt for the file format.
+//!
+//! the estimate walks all pages reachable from the root bucket: those which
+//! a compaction copies. the file may be in use by lnd meanwhile: pages freed
+//! and reused mid-walk make the count approximate but never unbounded, since
+//! each page is counted at most once.
+
+const std = @import("std");
+
+const magic: u32 = 0xED0CDAED;
+const version: u32 = 2;
+
+/// page flags.
+const branch_page: u16 = 0x01;
+const leaf_page: u16 = 0x02;
+/// leaf element flags.
+const bucket_leaf: u32 = 0x01;
+
+/// in native byte order, as written by bbolt.
+const PageHeader = extern struct {
+    id: u64,
+    flags: u16,
+    count: u16, // number of elements
+    overflow: u32, // number of pages following this one, as part of it
+};
+
+const Meta = extern struct {
+    magic: u32,
+    version: u32,
+    page_size: u32,
+    flags: u32,
+    root: u64, // root bucket page
+    sequence: u64,
+    freelist: u64,
+    pgid: u64, // high water mark
+    txid: u64,
+    checksum: u64, // fnv-1a of all fields above
+};
+
+const BranchElement = extern struct {
+    pos: u32, // key offset from the element
+    ksize: u32,
+    pgid: u64,
+};
+
+const LeafElement = extern struct {
+    flags: u32,
+    pos: u32, // key offset from the element; the value follows the key
+    ksize: u32,
+    vsize: u32,
+};
+
+/// a bucket leaf element value starts with its header. a zero root means
+/// an inline bucket: its page follows in the value.
+const BucketHeader = extern struct {
+    root: u64,
+    sequence: u64,
+};
+
+pub const Usage = struct {
+    size: u64, // file size, bytes
+    /// bytes of the pages reachable from the root bucket, including meta pages:
+    /// about the size of the file after a compaction.
+    live: u64,
+
+    /// estimated number of bytes a compaction reclaims.
+    pub fn reclaimable(self: Usage) u64 {
+        return self.size -| self.live;
+    }
+};
+
+/// walks the tree of the database file at path and reports its usage.
+/// temporary allocations are freed before returning.
+pub fn usage(allocator: std.mem.Allocator, path: []const u8) !Usage {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+    const size = (try file.stat()).size;
+    const meta = try readMeta(file);
+    const psize: u64 = meta.page_size;
+    const npages = size / psize;
+
+    var seen = try std.DynamicBitSetUnmanaged.initEmpty(allocator, @intCast(npages));
+    defer seen.deinit(allocator);
+    var stack = std.ArrayList(u64).init(allocator);
+    defer stack.deinit();
+    var buf = std.ArrayList(u8).init(allocator);
+    defer buf.deinit();
+
+    var live: u64 = 2; // meta pages
+    try stack.append(meta.root);
+    while (stack.popOrNull()) |id| {
+        if (id < 2 or id >= npages or seen.isSet(@intCast(id))) {
+            continue;
+        }
+        var head: [@sizeOf(PageHeader)]u8 = undefined;
+        if (try file.preadAll(&head, id * psize) < head.len) {
+            continue;
+        }
+        const hdr = std.mem.bytesToValue(PageHeader, &head);
+        const span = @as(u64, hdr.overflow) + 1;
+        if (hdr.id != id or id + span > npages) {
+            continue; // reused or torn mid-walk
+        }
+        seen.setRangeValue(.{ .start = @intCast(id), .end = @intCast(id + span) }, true);
+        live += span;
+        if (hdr.flags != branch_page and hdr.flags != leaf_page) {
+            continue;
+        }
+        try buf.resize(@intCast(span * psize));
+        const n = try file.preadAll(buf.items, id * psize);
+        const data = buf.items[0..n];
+        for (0..hdr.count) |i| {
+            const off = @sizeOf(PageHeader) + i * 16; // both element types
+            if (off + 16 > data.len) {
+                break;
+            }
+            if (hdr.flags == branch_page) {
+                const el = std.mem.bytesToValue(BranchElement, data[off..][0..@sizeOf(BranchElement)]);
+                try stack.append(el.pgid);
+                continue;
+            }
+            const el = std.mem.bytesToValue(LeafElement, data[off..][0..@sizeOf(LeafElement)]);
+            if (el.flags & bucket_leaf == 0) {
+                continue;
+            }
+            const voff = off + @as(usize, el.pos) + el.ksize;
+            if (voff + @sizeOf(BucketHeader) > data.len) {
+                continue;
+            }
+            const bucket = std.mem.bytesToValue(BucketHeader, data[voff..][0..@sizeOf(BucketHeader)]);
+            if (bucket.root != 0) {
+                try stack.append(bucket.root); // inline buckets have no nested ones
+            }
+        }
+    }
+    return .{ .size = size, .live = @min(live * psize, size) };
+}
+
+/// returns the valid meta page with the highest txid.
+fn readMeta(file: std.fs.File) !Meta {
+    const m0 = try readMetaAt(file, 0);
+    // the second meta page is found with the page size of the first, if valid.
+    const m1 = try readMetaAt(file, if (m0) |m| m.page_size else 4096);
+    if (m0 != null and m1 != null) {
+        return if (m1.?.txid > m0.?.txid) m1.? else m0.?;
+    }
+    return m0 orelse m1 orelse error.BoltInvalidMeta;
+}
+
+fn readMetaAt(file: std.fs.File, offset: u64) !?Meta {
+    var buf: [@sizeOf(PageHeader) + @sizeOf(Meta)]u8 = undefined;
+    if (try file.preadAll(&buf, offset) < buf.len) {
+        return null;
+    }
+    const m = std.mem.bytesToValue(Meta, buf[@sizeOf(PageHeader)..][0..@sizeOf(Meta)]);
+    const sum = std.hash.Fnv1a_64.hash(buf[@sizeOf(PageHeader)..][0..@offsetOf(Meta, "checksum")]);
+    if (m.magic != magic or m.version != version or m.checksum != sum) {
+        return null;
+    }
+    if (m.page_size < 512 or !std.math.isPowerOfTwo(m.page_size)) {
+        return null;
+    }
+    return m;
+}
+
+test "bbolt usage" {
+    const t = std.testing;
+
+    const psize = 4096;
+    // pages: 0 and 1 meta, 2 root bucket leaf, 3 free, 4-5 a nested bucket
+    // leaf with an overflow page, and 6-7 beyond the high water mark.
+    var db = [_]u8{0} ** (8 * psize);
+    const putPage = struct {
+        fn f(buf: []u8, id: u64, flags: u16, count: u16, overflow: u32) []u8 {
+            const p = buf[id * psize ..];
+            @memcpy(p[0..@sizeOf(PageHeader)], std.mem.asBytes(&PageHeader{ .id = id, .flags = flags, .count = count, .overflow = overflow }));
+            return p[@sizeOf(PageHeader)..];
+        }
+    }.f;
+    for ([_]u64{ 0, 1 }) |id| {
+        const body = putPage(&db, id, 0x04, 0, 0);
+        var m = Meta{
+            .magic = magic,
+            .version = version,
+            .page_size = psize,
+            .flags = 0,
+            .root = 2,
+            .sequence = 0,
+            .freelist = std.math.maxInt(u64), // not synced, as in lnd
+            .pgid = 6,
+            .txid = 10 + id,
+            .checksum = 0,
+        };
+        m.checksum = std.hash.Fnv1a_64.hash(std.mem.asBytes(&m)[0..@offsetOf(Meta, "checksum")]);
+        @memcpy(body[0..@sizeOf(Meta)], std.mem.asBytes(&m));
+    }
+    // root bucket: a key of a bucket rooted at page 4 and an inline bucket.
+    {
+        const body = putPage(&db, 2, leaf_page, 2, 0);
+        const el0 = LeafElement{ .flags = bucket_leaf, .pos = 32, .ksize = 1, .vsize = 16 };
+        const el1 = LeafElement{ .flags = bucket_leaf, .pos = 16 + 17, .ksize = 1, .vsize = 16 };
+        @memcpy(body[0..16], std.mem.asBytes(&el0));
+        @memcpy(body[16..32], std.mem.asBytes(&el1));
+        body[32] = 'a';
+        @memcpy(body[33..49], std.mem.asBytes(&BucketHeader{ .root = 4, .sequence = 0 }));
+        body[49] = 'b';
+        @memcpy(body[50..66], std.mem.asBytes(&BucketHeader{ .root = 0, .sequence = 0 }));
+    }
+    _ = putPage(&db, 4, leaf_page, 0, 1);
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile("channel.db", &db);
+    const path = try tmp.dir.realpathAlloc(t.allocator, "channel.db");
+    defer t.allocator.free(path);
+
+    const u = try usage(t.allocator, path);
+    try t.expectEqual(@as(u64, 8 * psize), u.size);
+    try t.expectEqual(@as(u64, 5 * psize), u.live);
+    try t.expectEqual(@as(u64, 3 * psize), u.reclaimable());
+
+    // a torn second meta page falls back to the first.
+    db[psize + @sizeOf(PageHeader) + @offsetOf(Meta, "txid")] ^= 0xff;
+    try tmp.dir.writeFile("channel.db", &db);
+    try t.expectEqual(u, try usage(t.allocator, path));
+
+    // no valid meta page.
+    db[@sizeOf(PageHeader)] ^= 0xff;
+    try tmp.dir.writeFile("channel.db", &db);
+    try t.expectError(error.BoltInvalidMeta, usage(t.allocator, path));
+}
@@ -0,0 +1,1020 @@
+//! HTTP/2 client connection, as much of it as a gRPC client needs: requests
+//! multiplexed as streams over a single TCP or TLS connection, each stream
+//! safe to use from its own thread, with HPACK header compression.
+//!
+//! a reader thread of the connection receives all frames and hands headers
+//! and data over to their streams. receive windows are opened wide at start
+//! and refilled as data arrives, so that a slow stream consumer never stalls
+//! the others; data waits in the stream buffer instead, unbounded.
+//! requests are expected to be small: the peer send window is not tracked,
+//! and a request body is limited to the initial window of 64KiB.
+//! server push is disabled and priorities are ignored.
+
+const std = @import("std");
+const posix = std.posix;
+
+pub const Header = std.http.Header;
+
+pub const Error = error{
+    Http2Protocol,
+    Http2FrameSize,
+    Http2GoAway,
+    Http2ConnectionLost,
+    Http2StreamReset,
+    Http2StreamsExhausted,
+    Http2RequestTooLarge,
+    HpackIndex,
+    HpackInteger,
+    HpackTableSize,
+    HpackTruncated,
+};
+
+const preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/// max frame payload received: the protocol default, never changed.
+const max_frame_size = 16384;
+/// receive window of the connection and of each stream.
+const max_window = std.math.maxInt(u31);
+/// the initial send window of the peer, which requests must fit in.
+const default_window = 65535;
+
+const FrameType = enum(u8) {
+    data = 0,
+    headers = 1,
+    priority = 2,
+    rst_stream = 3,
+    settings = 4,
+    push_promise = 5,
+    ping = 6,
+    goaway = 7,
+    window_update = 8,
+    continuation = 9,
+    _,
+};
+
+const flag_end_stream = 0x1;
+const flag_ack = 0x1;
+const flag_end_headers = 0x4;
+const flag_padded = 0x8;
+const flag_priority = 0x20;
+
+const settings_enable_push = 0x2;
+const settings_initial_window_size = 0x4;
+const settings_max_frame_size = 0x5;
+
+const error_cancel = 0x8;
+
+pub const ConnectOpt = struct {
+    host: []const u8,
+    port: u16,
+    /// TLS server certificates; null for cleartext HTTP/2.
+    ca: ?std.crypto.Certificate.Bundle,
+};
+
+/// a connection and its reader thread; reference counted: streams hold
+/// a reference each, and the connection closes with the last one released.
+pub const Conn = struct {
+    allocator: std.mem.Allocator,
+    transport: Transport,
+    scheme: []const u8,
+    authority: []const u8, // host:port
+    reader: std.Thread = undefined,
+
+    /// serializes frames. also held from a stream id assignment until its
+    /// HEADERS are sent, as stream ids must increase on the wire.
+    write_mu: std.Thread.Mutex = .{},
+    next_id: u32 = 1, // guarded by write_mu
+    peer_max_frame: std.atomic.Value(u32) = std.atomic.Value(u32).init(max_frame_size),
+
+    mu: std.Thread.Mutex = .{},
+    streams: std.AutoHashMapUnmanaged(u32, *Stream) = .{}, // guarded by mu
+    failure: ?anyerror = null, // the connection is unusable; guarded by mu
+    refs: u32 = 1, // guarded by mu
+
+    const Transport = union(enum) {
+        plain: std.net.Stream,
+        tls: struct {
+            stream: std.net.Stream,
+            client: std.crypto.tls.Client,
+        },
+
+        fn socket(self: Transport) std.net.Stream {
+            return switch (self) {
+                .plain => |s| s,
+                .tls => |t| t.stream,
+            };
+        }
+    };
+
+    /// connects to the server and spawns the reader thread. the returned
+    /// connection holds a single reference; see release.
+    pub fn connect(allocator: std.mem.Allocator, opt: ConnectOpt) !*Conn {
+        const sock = try std.net.tcpConnectToHost(allocator, opt.host, opt.port);
+        errdefer sock.close();
+        const self = try allocator.create(Conn);
+        errdefer allocator.destroy(self);
+        const authority = try std.fmt.allocPrint(allocator, "{s}:{d}", .{ opt.host, opt.port });
+        errdefer allocator.free(authority);
+        self.* = .{
+            .allocator = allocator,
+            .transport = if (opt.ca) |ca| .{ .tls = .{
+                .stream = sock,
+                .client = try std.crypto.tls.Client.init(sock, ca, opt.host),
+            } } else .{ .plain = sock },
+            .scheme = if (opt.ca != null) "https" else "http",
+            .authority = authority,
+        };
+
+        var settings: [12]u8 = undefined;
+        std.mem.writeInt(u16, settings[0..2], settings_enable_push, .big);
+        std.mem.writeInt(u32, settings[2..6], 0, .big);
+        std.mem.writeInt(u16, settings[6..8], settings_initial_window_size, .big);
+        std.mem.writeInt(u32, settings[8..12], max_window, .big);
+        try self.writeAll(preface);
+        try self.writeFrame(.settings, 0, 0, &settings);
+        try self.writeWindowUpdate(0, max_window - default_window);
+
+        self.reader = try std.Thread.spawn(.{}, readLoop, .{self});
+        return self;
+    }
+
+    pub fn ref(self: *Conn) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        self.refs += 1;
+    }
+
+    /// drops a reference. the last one closes the connection, joins the
+    /// reader thread and frees self.
+    pub fn release(self: *Conn) void {
+        self.mu.lock();
+        self.refs -= 1;
+        const last = self.refs == 0;
+        self.mu.unlock();
+        if (!last) {
+            return;
+        }
+        const sock = self.transport.socket();
+        posix.shutdown(sock.handle, .both) catch {};
+        self.reader.join();
+        sock.close();
+        self.streams.deinit(self.allocator);
+        self.allocator.free(self.authority);
+        self.allocator.destroy(self);
+    }
+
+    /// reports whether the connection failed and new streams cannot open.
+    pub fn failed(self: *Conn) bool {
+        self.mu.lock();
+        defer self.mu.unlock();
+        return self.failure != null;
+    }
+
+    /// opens a POST request stream to path, sending its headers: the pseudo
+    /// headers followed by extra. the body follows with Stream.send.
+    /// the stream holds a connection reference until closed.
+    pub fn openStream(self: *Conn, path: []const u8, extra: []const Header) !*Stream {
+        var blockbuf = std.heap.stackFallback(2048, self.allocator);
+        var block = std.ArrayList(u8).init(blockbuf.get());
+        defer block.deinit();
+        try encodeRequest(block.writer(), self.scheme, self.authority, path, extra);
+
+        const st = try self.allocator.create(Stream);
+        errdefer self.allocator.destroy(st);
+        self.mu.lock();
+        if (self.failure) |err| {
+            self.mu.unlock();
+            return err;
+        }
+        self.refs += 1;
+        self.mu.unlock();
+        errdefer self.release();
+
+        self.write_mu.lock();
+        const id = self.next_id;
+        if (id > std.math.maxInt(u31)) {
+            self.write_mu.unlock();
+            return Error.Http2StreamsExhausted;
+        }
+        self.next_id += 2;
+        st.* = .{ .conn = self, .id = id };
+        self.mu.lock();
+        self.streams.put(self.allocator, id, st) catch |err| {
+            self.mu.unlock();
+            self.write_mu.unlock();
+            return err;
+        };
+        self.mu.unlock();
+        const res = self.writeHeadersLocked(id, block.items);
+        self.write_mu.unlock();
+        res catch |err| {
+            self.mu.lock();
+            _ = self.streams.remove(id);
+            self.mu.unlock();
+            return err;
+        };
+        return st;
+    }
+
+    /// writes a header block as HEADERS and CONTINUATION frames.
+    /// callers must hold write_mu.
+    fn writeHeadersLocked(self: *Conn, id: u32, block: []const u8) !void {
+        const max = self.peer_max_frame.load(.monotonic);
+        var rest = block;
+        var ftype = FrameType.headers;
+        while (true) {
+            const n = @min(rest.len, max);
+            const flags: u8 = if (n == rest.len) flag_end_headers else 0;
+            try self.writeFrameLocked(ftype, flags, id, rest[0..n]);
+            rest = rest[n..];
+            if (rest.len == 0) {
+                return;
+            }
+            ftype = .continuation;
+        }
+    }
+
+    fn writeFrame(self: *Conn, ftype: FrameType, flags: u8, id: u32, payload: []const u8) !void {
+        self.write_mu.lock();
+        defer self.write_mu.unlock();
+        return self.writeFrameLocked(ftype, flags, id, payload);
+    }
+
+    /// callers must hold write_mu.
+    fn writeFrameLocked(self: *Conn, ftype: FrameType, flags: u8, id: u32, payload: []const u8) !void {
+        var head: [9]u8 = undefined;
+        std.mem.writeInt(u24, head[0..3], @intCast(payload.len), .big);
+        head[3] = @intFromEnum(ftype);
+        head[4] = flags;
+        std.mem.writeInt(u32, head[5..9], id, .big);
+        try self.writeAll(&head);
+        try self.writeAll(payload);
+    }
+
+    fn writeWindowUpdate(self: *Conn, id: u32, n: u32) !void {
+        var p: [4]u8 = undefined;
+        std.mem.writeInt(u32, &p, n, .big);
+        return self.writeFrame(.window_update, 0, id, &p);
+    }
+
+    fn writeAll(self: *Conn, bytes: []const u8) !void {
+        switch (self.transport) {
+            .plain => |s| try s.writeAll(bytes),
+            .tls => |*t| try t.client.writeAll(t.stream, bytes),
+        }
+    }
+
+    fn read(self: *Conn, buf: []u8) anyerror!usize {
+        return switch (self.transport) {
+            .plain => |s| s.read(buf),
+            .tls => |*t| t.client.read(t.stream, buf),
+        };
+    }
+
+    /// reader thread entry point; exits when the connection fails or closes.
+    fn readLoop(self: *Conn) void {
+        const err = if (self.readFrames()) Error.Http2ConnectionLost else |e| e;
+        self.mu.lock();
+        defer self.mu.unlock();
+        self.failure = err;
+        var it = self.streams.valueIterator();
+        while (it.next()) |st| {
+            st.*.cond.signal();
+        }
+    }
+
+    fn readFrames(self: *Conn) !void {
+        var br = std.io.bufferedReader(std.io.Reader(*Conn, anyerror, read){ .context = self });
+        const r = br.reader();
+        var dec = Decoder.init(self.allocator);
+        defer dec.deinit();
+        var block = std.ArrayList(u8).init(self.allocator); // headers being received
+        defer block.deinit();
+        var block_id: ?u32 = null; // stream of the block; null if none
+        var block_end = false; // the block ends the stream
+        var payload: [max_frame_size]u8 = undefined;
+        var unacked: u32 = 0; // data received since the last connection window update
+
+        while (true) {
+            var head: [9]u8 = undefined;
+            r.readNoEof(&head) catch |err| switch (err) {
+                error.EndOfStream => return,
+                else => return err,
+            };
+            const len = std.mem.readInt(u24, head[0..3], .big);
+            const ftype: FrameType = @enumFromInt(head[3]);
+            const flags = head[4];
+            const id = std.mem.readInt(u32, head[5..9], .big) & 0x7fffffff;
+            if (len > payload.len) {
+                return Error.Http2FrameSize;
+            }
+            const p = payload[0..len];
+            try r.readNoEof(p);
+            if (block_id != null and ftype != .continuation) {
+                return Error.Http2Protocol;
+            }
+
+            switch (ftype) {
+                .data => {
+                    const data = try unpad(flags, p);
+                    if (len > 0) {
+                        unacked += len;
+                        if (unacked > max_window / 2) {
+                            try self.writeWindowUpdate(0, unacked);
+                            unacked = 0;
+                        }
+                    }
+                    try self.deliverData(id, len, data, flags & flag_end_stream != 0);
+                },
+                .headers => {
+                    var frag = try unpad(flags, p);
+                    if (flags & flag_priority != 0) {
+                        if (frag.len < 5) return Error.Http2Protocol;
+                        frag = frag[5..];
+                    }
+                    try block.appendSlice(frag);
+                    block_id = id;
+                    block_end = flags & flag_end_stream != 0;
+                },
+                .continuation => {
+                    if (block_id == null or block_id.? != id) {
+                        return Error.Http2Protocol;
+                    }
+                    try block.appendSlice(p);
+                },
+                .rst_stream => {
+                    if (len != 4) return Error.Http2FrameSize;
+                    self.resetStream(id, std.mem.readInt(u32, p[0..4], .big));
+                },
+                .settings => if (flags & flag_ack == 0) {
+                    if (len % 6 != 0) return Error.Http2FrameSize;
+                    var i: usize = 0;
+                    while (i < len) : (i += 6) {
+                        const v = std.mem.readInt(u32, p[i + 2 ..][0..4], .big);
+                        if (std.mem.readInt(u16, p[i..][0..2], .big) == settings_max_frame_size) {
+                            self.peer_max_frame.store(v, .monotonic);
+                        }
+                    }
+                    try self.writeFrame(.settings, flag_ack, 0, &.{});
+                },
+                .ping => if (flags & flag_ack == 0) {
+                    if (len != 8) return Error.Http2FrameSize;
+                    try self.writeFrame(.ping, flag_ack, 0, p);
+                },
+                .goaway => return Error.Http2GoAway,
+                .push_promise => return Error.Http2Protocol, // disabled in settings
+                else => {}, // window_update, priority and unknown types
+            }
+
+            if ((ftype == .headers or ftype == .continuation) and flags & flag_end_headers != 0) {
+                // decoded even for unknown streams: the decoder state is
+                // shared by all of them.
+                const hdrs = try dec.decode(self.allocator, block.items);
+                self.deliverHeaders(block_id.?, hdrs, block_end);
+                block.clearRetainingCapacity();
+                block_id = null;
+            }
+        }
+    }
+
+    /// hands data over to its stream, if still open. n is the frame length,
+    /// including padding.
+    fn deliverData(self: *Conn, id: u32, n: u32, data: []const u8, end: bool) !void {
+        var update: u32 = 0;
+        {
+            self.mu.lock();
+            defer self.mu.unlock();
+            const st = self.streams.get(id) orelse return;
+            try st.data.appendSlice(self.allocator, data);
+            st.ended = st.ended or end;
+            st.unacked += n;
+            if (!end and st.unacked > max_window / 2) {
+                update = st.unacked;
+                st.unacked = 0;
+            }
+            st.cond.signal();
+        }
+        if (update > 0) {
+            try self.writeWindowUpdate(id, update);
+        }
+    }
+
+    /// hands headers over to their stream, or frees them if it is gone.
+    fn deliverHeaders(self: *Conn, id: u32, hdrs: []Header, end: bool) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        const st = self.streams.get(id) orelse {
+            freeHeaders(self.allocator, hdrs);
+            self.allocator.free(hdrs);
+            return;
+        };
+        st.headers.appendSlice(self.allocator, hdrs) catch {
+            st.reset = error_cancel;
+            freeHeaders(self.allocator, hdrs);
+            st.cond.signal();
+            return;
+        };
+        self.allocator.free(hdrs); // the strings are now the stream's
+        st.ended = st.ended or end;
+        st.cond.signal();
+    }
+
+    fn resetStream(self: *Conn, id: u32, code: u32) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        const st = self.streams.get(id) orelse return;
+        st.reset = code;
+        st.cond.signal();
+    }
+};
+
+/// a request stream; see Conn.openStream.
+pub const Stream = struct {
+    conn: *Conn,
+    id: u32,
+    cond: std.Thread.Condition = .{}, // signalled on any change below
+    // all fields below are guarded by conn.mu.
+    headers: std.ArrayListUnmanaged(Header) = .{}, // response headers and trailers
+    data: std.ArrayListUnmanaged(u8) = .{}, // received and not yet read
+    data_pos: usize = 0, // read position in data
+    ended: bool = false, // peer sent END_STREAM
+    reset: ?u32 = null, // RST_STREAM error code, or cancel
+    unacked: u32 = 0, // data received since the last window update
+
+    pub const ReadError = error{ Http2StreamReset, Http2ConnectionLost };
+    pub const Reader = std.io.Reader(*Stream, ReadError, read);
+
+    /// sends data as the request body, or its part, ending the request
+    /// if end is true.
+    pub fn send(self: *Stream, data: []const u8, end: bool) !void {
+        if (data.len > default_window) {
+            return Error.Http2RequestTooLarge;
+        }
+        const max = self.conn.peer_max_frame.load(.monotonic);
+        var rest = data;
+        while (true) {
+            const n = @min(rest.len, max);
+            const flags: u8 = if (end and n == rest.len) flag_end_stream else 0;
+            try self.conn.writeFrame(.data, flags, self.id, rest[0..n]);
+            rest = rest[n..];
+            if (rest.len == 0) {
+                return;
+            }
+        }
+    }
+
+    /// blocks until any data is received, and copies up to buf.len of it.
+    /// returns 0 once the response ended and all data is read.
+    pub fn read(self: *Stream, buf: []u8) ReadError!usize {
+        const c = self.conn;
+        c.mu.lock();
+        defer c.mu.unlock();
+        while (true) {
+            if (self.reset != null) {
+                return ReadError.Http2StreamReset;
+            }
+            const avail = self.data.items[self.data_pos..];
+            if (avail.len > 0) {
+                const n = @min(buf.len, avail.len);
+                @memcpy(buf[0..n], avail[0..n]);
+                self.data_pos += n;
+                if (self.data_pos == self.data.items.len) {
+                    self.data.clearRetainingCapacity();
+                    self.data_pos = 0;
+                }
+                return n;
+            }
+            if (self.ended) {
+                return 0;
+            }
+            if (c.failure != null) {
+                return ReadError.Http2ConnectionLost;
+            }
+            self.cond.wait(&c.mu);
+        }
+    }
+
+    pub fn reader(self: *Stream) Reader {
+        return .{ .context = self };
+    }
+
+    /// blocks until the response ends, with its trailers if any.
+    pub fn waitEnd(self: *Stream) ReadError!void {
+        const c = self.conn;
+        c.mu.lock();
+        defer c.mu.unlock();
+        while (!self.ended) {
+            if (self.reset != null) {
+                return ReadError.Http2StreamReset;
+            }
+            if (c.failure != null) {
+                return ReadError.Http2ConnectionLost;
+            }
+            self.cond.wait(&c.mu);
+        }
+    }
+
+    /// returns the value of the first response header or trailer named name,
+    /// received so far. the value is valid until the stream is closed.
+    pub fn header(self: *Stream, name: []const u8) ?[]const u8 {
+        self.conn.mu.lock();
+        defer self.conn.mu.unlock();
+        for (self.headers.items) |h| {
+            if (std.mem.eql(u8, h.name, name)) {
+                return h.value;
+            }
+        }
+        return null;
+    }
+
+    /// makes blocked and future reads fail, from any thread.
+    /// the stream must still be closed.
+    pub fn cancel(self: *Stream) void {
+        self.conn.mu.lock();
+        defer self.conn.mu.unlock();
+        if (self.reset == null) {
+            self.reset = error_cancel;
+        }
+        self.cond.signal();
+    }
+
+    /// resets the stream unless the response ended, and frees it.
+    pub fn close(self: *Stream) void {
+        const c = self.conn;
+        c.mu.lock();
+        _ = c.streams.remove(self.id);
+        const rst = !self.ended and c.failure == null;
+        c.mu.unlock();
+        if (rst) {
+            var p: [4]u8 = undefined;
+            std.mem.writeInt(u32, &p, error_cancel, .big);
+            c.writeFrame(.rst_stream, 0, self.id, &p) catch {};
+        }
+        // the reader thread no longer finds the stream: safe without the lock.
+        freeHeaders(c.allocator, self.headers.items);
+        self.headers.deinit(c.allocator);
+        self.data.deinit(c.allocator);
+        c.allocator.destroy(self);
+        c.release();
+    }
+};
+
+/// strips the padding of DATA and HEADERS frames.
+fn unpad(flags: u8, p: []const u8) ![]const u8 {
+    if (flags & flag_padded == 0) {
+        return p;
+    }
+    if (p.len == 0 or p[0] >= p.len) {
+        return Error.Http2Protocol;
+    }
+    return p[1 .. p.len - p[0]];
+}
+
+/// frees headers returned by Decoder.decode.
+pub fn freeHeaders(allocator: std.mem.Allocator, hdrs: []const Header) void {
+    for (hdrs) |h| {
+        allocator.free(h.name);
+        allocator.free(h.value);
+    }
+}
+
+/// writes the HPACK header block of a POST request. nothing is added to the
+/// peer's dynamic table, and no strings are huffman coded: both would only
+/// save a few bytes of small requests.
+fn encodeRequest(w: anytype, scheme: []const u8, authority: []const u8, path: []const u8, extra: []const Header) !void {
+    try w.writeByte(0x80 | 3); // :method POST
+    try w.writeByte(0x80 | @as(u8, if (std.mem.eql(u8, scheme, "https")) 7 else 6)); // :scheme
+    try writeInt(w, 0x00, 4, 4); // :path, literal without indexing
+    try writeString(w, path);
+    try writeInt(w, 0x00, 4, 1); // :authority
+    try writeString(w, authority);
+    for (extra) |h| {
+        try w.writeByte(0x00); // literal without indexing, new name
+        try writeString(w, h.name);
+        try writeString(w, h.value);
+    }
+}
+
+fn writeInt(w: anytype, first: u8, comptime prefix: u4, v: usize) !void {
+    const max = (1 << prefix) - 1;
+    if (v < max) {
+        return w.writeByte(first | @as(u8, @intCast(v)));
+    }
+    try w.writeByte(first | max);
+    var rest = v - max;
+    while (rest >= 0x80) : (rest >>= 7) {
+        try w.writeByte(@as(u8, @truncate(rest)) | 0x80);
+    }
+    try w.writeByte(@intCast(rest));
+}
+
+fn writeString(w: anytype, s: []const u8) !void {
+    try writeInt(w, 0x00, 7, s.len);
+    try w.writeAll(s);
+}
+
+/// HPACK header block decoder, keeping the dynamic table across blocks
+/// of a connection.
+pub const Decoder = struct {
+    allocator: std.mem.Allocator,
+    table: std.ArrayListUnmanaged(Entry) = .{}, // dynamic table, oldest first
+    size: usize = 0, // of the dynamic table entries, as defined by HPACK
+    max_size: usize = table_size_limit, // as last set by the peer
+
+    /// SETTINGS_HEADER_TABLE_SIZE; the protocol default, never changed.
+    const table_size_limit = 4096;
+
+    const Entry = struct {
+        buf: []u8, // name followed by value
+        name_len: usize,
+
+        fn header(self: Entry) Header {
+            return .{ .name = self.buf[0..self.name_len], .value = self.buf[self.name_len..] };
+        }
+    };
+
+    pub fn init(allocator: std.mem.Allocator) Decoder {
+        return .{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *Decoder) void {
+        for (self.table.items) |e| {
+            self.allocator.free(e.buf);
+        }
+        self.table.deinit(self.allocator);
+    }
+
+    /// decodes a complete header block. callers own the result and must free
+    /// it with freeHeaders followed by allocator.free.
+    pub fn decode(self: *Decoder, allocator: std.mem.Allocator, block: []const u8) ![]Header {
+        var res = std.ArrayList(Header).init(allocator);
+        errdefer {
+            freeHeaders(allocator, res.items);
+            res.deinit();
+        }
+        var r = Cursor{ .data = block };
+        while (r.pos < block.len) {
+            const b = try r.byte();
+            if (b & 0x80 != 0) {
+                // indexed header field
+                const h = try self.get(try r.int(b, 7));
+                try appendHeader(&res, h.name, h.value);
+                continue;
+            }
+            if (b & 0xe0 == 0x20) {
+                const size = try r.int(b, 5);
+                if (size > table_size_limit) {
+                    return Error.HpackTableSize;
+                }
+                self.max_size = size;
+                self.evict(0);
+                continue;
+            }
+            // literals: with incremental indexing, without indexing, never indexed
+            const indexing = b & 0xc0 == 0x40;
+            const index = if (indexing) try r.int(b, 6) else try r.int(b, 4);
+            const h = blk: {
+                const name = if (index == 0) try r.string(allocator) else try allocator.dupe(u8, (try self.get(index)).name);
+                errdefer allocator.free(name);
+                const value = try r.string(allocator);
+                errdefer allocator.free(value);
+                try res.append(.{ .name = name, .value = value });
+                break :blk res.items[res.items.len - 1];
+            };
+            if (indexing) {
+                try self.add(h.name, h.value);
+            }
+        }
+        return res.toOwnedSlice();
+    }
+
+    fn appendHeader(res: *std.ArrayList(Header), name: []const u8, value: []const u8) !void {
+        const n = try res.allocator.dupe(u8, name);
+        errdefer res.allocator.free(n);
+        const v = try res.allocator.dupe(u8, value);
+        errdefer res.allocator.free(v);
+        try res.append(.{ .name = n, .value = v });
+    }
+
+    fn get(self: *Decoder, index: usize) !Header {
+        if (index == 0) {
+            return Error.HpackIndex;
+        }
+        if (index <= static_table.len) {
+            return static_table[index - 1];
+        }
+        const i = index - static_table.len - 1; // 0 is the newest
+        if (i >= self.table.items.len) {
+            return Error.HpackIndex;
+        }
+        return self.table.items[self.table.items.len - 1 - i].header();
+    }
+
+    fn add(self: *Decoder, name: []const u8, value: []const u8) !void {
+        const esize = name.len + value.len + 32;
+        if (esize > self.max_size) {
+            self.evict(self.max_size + 1); // clears the table
+            return;
+        }
+        self.evict(esize);
+        const buf = try self.allocator.alloc(u8, name.len + value.len);
+        errdefer self.allocator.free(buf);
+        @memcpy(buf[0..name.len], name);
+        @memcpy(buf[name.len..], value);
+        try self.table.append(self.allocator, .{ .buf = buf, .name_len = name.len });
+        self.size += esize;
+    }
+
+    /// drops the oldest entries until another of size n fits.
+    fn evict(self: *Decoder, n: usize) void {
+        var drop: usize = 0;
+        while (drop < self.table.items.len and self.size + n > self.max_size) : (drop += 1) {
+            const e = self.table.items[drop];
+            self.size -= e.buf.len + 32;
+            self.allocator.free(e.buf);
+        }
+        std.mem.copyForwards(Entry, self.table.items, self.table.items[drop..]);
+        self.table.shrinkRetainingCapacity(self.table.items.len - drop);
+    }
+};
+
+const Cursor = struct {
+    data: []const u8,
+    pos: usize = 0,
+
+    fn byte(self: *Cursor) !u8 {
+        if (self.pos >= self.data.len) {
+            return Error.HpackTruncated;
+        }
+        defer self.pos += 1;
+        return self.data[self.pos];
+    }
+
+    /// decodes an integer with an n-bit prefix in the first byte.
+    fn int(self: *Cursor, first: u8, comptime n: u4) !usize {
+        const max = (1 << n) - 1;
+        var v: usize = first & max;
+        if (v < max) {
+            return v;
+        }
+        var shift: u5 = 0;
+        while (true) {
+            const b = try self.byte();
+            v += @as(usize, b & 0x7f) << shift;
+            if (b & 0x80 == 0) {
+                return v;
+            }
+            if (shift >= 21) {
+                return Error.HpackInteger; // more than any sane length
+            }
+            shift += 7;
+        }
+    }
+
+    fn string(self: *Cursor, allocator: std.mem.Allocator) ![]u8 {
+        const b = try self.byte();
+        const len = try self.int(b, 7);
+        if (len > self.data.len - self.pos) {
+            return Error.HpackTruncated;
+        }
+        const s = self.data[self.pos..][0..len];
+        self.pos += len;
+        if (b & 0x80 == 0) {
+            return allocator.dupe(u8, s);
+        }
+        return huffmanDecode(allocator, s);
+    }
+};
+
+const static_table = [_]Header{
+    .{ .name = ":authority", .value = "" },
+    .{ .name = ":method", .value = "GET" },
+    .{ .name = ":method", .value = "POST" },
+    .{ .name = ":path", .value = "/" },
+    .{ .name = ":path", .value = "/index.html" },
+    .{ .name = ":scheme", .value = "http" },
+    .{ .name = ":scheme", .value = "https" },
+    .{ .name = ":status", .value = "200" },
+    .{ .name = ":status", .value = "204" },
+    .{ .name = ":status", .value = "206" },
+    .{ .name = ":status", .value = "304" },
+    .{ .name = ":status", .value = "400" },
+    .{ .name = ":status", .value = "404" },
+    .{ .name = ":status", .value = "500" },
+    .{ .name = "accept-charset", .value = "" },
+    .{ .name = "accept-encoding", .value = "gzip, deflate" },
+    .{ .name = "accept-language", .value = "" },
+    .{ .name = "accept-ranges", .value = "" },
+    .{ .name = "accept", .value = "" },
+    .{ .name = "access-control-allow-origin", .value = "" },
+    .{ .name = "age", .value = "" },
+    .{ .name = "allow", .value = "" },
+    .{ .name = "authorization", .value = "" },
+    .{ .name = "cache-control", .value = "" },
+    .{ .name = "content-disposition", .value = "" },
+    .{ .name = "content-encoding", .value = "" },
+    .{ .name = "content-language", .value = "" },
+    .{ .name = "content-length", .value = "" },
+    .{ .name = "content-location", .value = "" },
+    .{ .name = "content-range", .value = "" },
+    .{ .name = "content-type", .value = "" },
+    .{ .name = "cookie", .value = "" },
+    .{ .name = "date", .value = "" },
+    .{ .name = "etag", .value = "" },
+    .{ .name = "expect", .value = "" },
+    .{ .name = "expires", .value = "" },
+    .{ .name = "from", .value = "" },
+    .{ .name = "host", .value = "" },
+    .{ .name = "if-match", .value = "" },
+    .{ .name = "if-modified-since", .value = "" },
+    .{ .name = "if-none-match", .value = "" },
+    .{ .name = "if-range", .value = "" },
+    .{ .name = "if-unmodified-since", .value = "" },
+    .{ .name = "last-modified", .value = "" },
+    .{ .name = "link", .value = "" },
+    .{ .name = "location", .value = "" },
+    .{ .name = "max-forwards", .value = "" },
+    .{ .name = "proxy-authenticate", .value = "" },
+    .{ .name = "proxy-authorization", .value = "" },
+    .{ .name = "range", .value = "" },
+    .{ .name = "referer", .value = "" },
+    .{ .name = "refresh", .value = "" },
+    .{ .name = "retry-after", .value = "" },
+    .{ .name = "server", .value = "" },
+    .{ .name = "set-cookie", .value = "" },
+    .{ .name = "strict-transport-security", .value = "" },
+    .{ .name = "transfer-encoding", .value = "" },
+    .{ .name = "user-agent", .value = "" },
+    .{ .name = "vary", .value = "" },
+    .{ .name = "via", .value = "" },
+    .{ .name = "www-authenticate", .value = "" },
+};
+
+/// HPACK huffman code lengths of the symbols with codes up to 15 bits long:
+/// printable ascii but backslash, and NUL. the code is canonical, so these
+/// alone make a decoder of them. longer codes, of all the other bytes, never
+/// appear in gRPC headers, which are percent-encoded ascii; a string with one
+/// decodes up to it followed by a '?'.
+const huffman_lengths = blk: {
+    var l = [_]u4{0} ** 128;
+    const groups = .{
+        .{ 5, "012aceiost" },
+        .{ 6, " %-./3456789=A_bdfghlmnpru" },
+        .{ 7, ":BCDEFGHIJKLMNOPQRSTUVWYjkqvwxyz" },
+        .{ 8, "&*,;XZ" },
+        .{ 10, "!\"()?" },
+        .{ 11, "'+|" },
+        .{ 12, "#>" },
+        .{ 13, "\x00$@[]~" },
+        .{ 14, "^}" },
+        .{ 15, "<`{" },
+    };
+    for (groups) |g| {
+        for (g[1]) |c| {
+            l[c] = g[0];
+        }
+    }
+    break :blk l;
+};
+
+const huffman = blk: {
+    const max_len = 15;
+    var t: struct {
+        first: [max_len + 1]u16, // code of the first symbol of each length
+        count: [max_len + 1]u16, // symbols of each length
+        offset: [max_len + 1]u16, // index in symbols of the first one of each length
+        symbols: [128]u8, // ordered by code
+    } = .{
+        .first = [_]u16{0} ** (max_len + 1),
+        .count = [_]u16{0} ** (max_len + 1),
+        .offset = [_]u16{0} ** (max_len + 1),
+        .symbols = [_]u8{0} ** 128,
+    };
+    for (huffman_lengths) |l| {
+        if (l != 0) t.count[l] += 1;
+    }
+    var code: u16 = 0;
+    var off: u16 = 0;
+    for (1..max_len + 1) |l| {
+        t.first[l] = code;
+        t.offset[l] = off;
+        off += t.count[l];
+        code = (code + t.count[l]) << 1;
+    }
+    var next = t.offset;
+    for (huffman_lengths, 0..) |l, sym| {
+        if (l != 0) {
+            t.symbols[next[l]] = sym;
+            next[l] += 1;
+        }
+    }
+    break :blk t;
+};
+
+fn huffmanDecode(allocator: std.mem.Allocator, s: []const u8) ![]u8 {
+    var out = try std.ArrayList(u8).initCapacity(allocator, s.len * 8 / 5);
+    errdefer out.deinit();
+    var acc: u32 = 0; // unconsumed bits, msb first
+    var nbits: u5 = 0;
+    var i: usize = 0;
+    outer: while (true) {
+        while (nbits <= 15 and i < s.len) : (i += 1) {
+            acc = acc << 8 | s[i];
+            nbits += 8;
+        }
+        if (nbits == 0) {
+            break;
+        }
+        var l: u5 = 5;
+        while (l <= 15 and l <= nbits) : (l += 1) {
+            const code: u16 = @intCast(acc >> (nbits - l) & ((@as(u32, 1) << l) - 1));
+            if (code -% huffman.first[l] < huffman.count[l]) {
+                out.appendAssumeCapacity(huffman.symbols[huffman.offset[l] + code - huffman.first[l]]);
+                nbits -= l;
+                acc &= (@as(u32, 1) << nbits) - 1;
+                continue :outer;
+            }
+        }
+        // no symbol: the padding of the last byte, all ones, or a long code.
+        const ones = (@as(u32, 1) << nbits) - 1;
+        if (i < s.len or nbits >= 8 or acc != ones) {
+            try out.append('?');
+        }
+        break;
+    }
+    return out.toOwnedSlice();
+}
+
+test "hpack huffman" {
+    const t = std.testing;
+
+    // RFC 7541, appendix C.4 and C.6.
+    const cases = .{
+        .{ "www.example.com", "\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff" },
+        .{ "no-cache", "\xa8\xeb\x10\x64\x9c\xbf" },
+        .{ "custom-key", "\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f" },
+        .{ "custom-value", "\x25\xa8\x49\xe9\x5b\xb8\xe8\xb4\xbf" },
+        .{ "302", "\x64\x02" },
+        .{ "", "" },
+    };
+    inline for (cases) |c| {
+        const s = try huffmanDecode(t.allocator, c[1]);
+        defer t.allocator.free(s);
+        try t.expectEqualStrings(c[0], s);
+    }
+
+    // a long code, of byte 0xff here, ends the string.
+    const s = try huffmanDecode(t.allocator, "\x1f\xff\xff\xff\xff");
+    defer t.allocator.free(s);
+    try t.expectEqualStrings("a?", s);
+}
+
+test "hpack decode" {
+    const t = std.testing;
+
+    var dec = Decoder.init(t.allocator);
+    defer dec.deinit();
+    // RFC 7541, appendix C.4.1 and C.4.2: requests with huffman coding.
+    const blocks = [_][]const u8{
+        "\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff",
+        "\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf",
+    };
+    for (blocks, 0..) |b, n| {
+        const hdrs = try dec.decode(t.allocator, b);
+        defer {
+            freeHeaders(t.allocator, hdrs);
+            t.allocator.free(hdrs);
+        }
+        try t.expectEqual(@as(usize, 4 + n), hdrs.len);
+        try t.expectEqualStrings(":method", hdrs[0].name);
+        try t.expectEqualStrings("GET", hdrs[0].value);
+        try t.expectEqualStrings(":authority", hdrs[3].name);
+        try t.expectEqualStrings("www.example.com", hdrs[3].value);
+        if (n == 1) {
+            try t.expectEqualStrings("cache-control", hdrs[4].name);
+            try t.expectEqualStrings("no-cache", hdrs[4].value);
+        }
+    }
+    try t.expectEqual(@as(usize, 2), dec.table.items.len);
+    try t.expectEqual(@as(usize, 110), dec.size);
+
+    // a table size update evicts.
+    const hdrs = try dec.decode(t.allocator, "\x3f\x21");
+    defer t.allocator.free(hdrs);
+    try t.expectEqual(@as(usize, 1), dec.table.items.len);
+    try t.expectError(Error.HpackIndex, dec.decode(t.allocator, "\xc0"));
+
+    // own request encoding reads back.
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    try encodeRequest(buf.writer(), "http", "localhost:10009", "/lnrpc.Lightning/GetInfo", &.{.{ .name = "te", .value = "trailers" }});
+    const req = try dec.decode(t.allocator, buf.items);
+    defer {
+        freeHeaders(t.allocator, req);
+        t.allocator.free(req);
+    }
+    try t.expectEqual(@as(usize, 5), req.len);
+    try t.expectEqualStrings("POST", req[0].value);
+    try t.expectEqualStrings("/lnrpc.Lightning/GetInfo", req[2].value);
+    try t.expectEqualStrings("trailers", req[4].value);
+}
@@ -0,0 +1,363 @@
+//! JSON decoding off a structural index, for large RPC responses of which most
+//! fields are ignored, such as lnd listchannels.
+//!
+//! the index is a list of positions of the structural characters {}[]:,
+//! outside of strings, found 64 bytes at a time with vector compares, which
+//! compile to NEON or SSE. the decoder, unrolled at comptime for the result
+//! type, then walks the index instead of the bytes: values are text spans
+//! between structurals, and an unknown subtree is skipped by counting
+//! brackets in the index, never looking at its contents.
+//!
+//! strings without escapes are borrowed from the document. those with escapes
+//! and types with a jsonParse function, such as types.PubKey, are handed over
+//! to std.json, off their value span. as with std.json, numbers decode from
+//! strings too, unknown fields are ignored and missing fields take their
+//! defaults.
+
+const std = @import("std");
+
+pub const Error = error{
+    JsonScanSyntax,
+    JsonScanMissingField,
+    JsonScanTooLarge,
+} || std.mem.Allocator.Error;
+
+const block_size = 64;
+const Block = @Vector(block_size, u8);
+
+/// returns the positions of structural characters outside of strings.
+/// callers own the returned slice.
+pub fn index(allocator: std.mem.Allocator, data: []const u8) Error![]u32 {
+    if (data.len > std.math.maxInt(u32)) {
+        return Error.JsonScanTooLarge;
+    }
+    var res = std.ArrayList(u32).init(allocator);
+    errdefer res.deinit();
+    try res.ensureTotalCapacity(data.len / 8 + 16); // typical structural density
+
+    var in_string: u64 = 0; // all ones if the previous block ended inside a string
+    var escape_next = false; // the previous block ended with an escaping backslash
+    var i: usize = 0;
+    while (i < data.len) : (i += block_size) {
+        const v: Block = if (data.len - i >= block_size) data[i..][0..block_size].* else tail: {
+            var b = [_]u8{' '} ** block_size;
+            @memcpy(b[0 .. data.len - i], data[i..]);
+            break :tail b;
+        };
+
+        // backslashes are rare: the escaped characters are found one by one.
+        var escaped: u64 = @intFromBool(escape_next);
+        escape_next = false;
+        var bs = eq(v, '\\');
+        while (bs != 0) : (bs &= bs - 1) {
+            const b: u6 = @intCast(@ctz(bs));
+            if (escaped & (@as(u64, 1) << b) != 0) {
+                continue;
+            }
+            if (b == block_size - 1) {
+                escape_next = true;
+            } else {
+                escaped |= @as(u64, 2) << b;
+            }
+        }
+
+        // inside includes opening quotes, excludes closing ones.
+        const inside = prefixXor(eq(v, '"') & ~escaped) ^ in_string;
+        in_string = @bitCast(@as(i64, @bitCast(inside)) >> block_size - 1);
+        var structural = (eq(v, '{') | eq(v, '}') | eq(v, '[') | eq(v, ']') | eq(v, ':') | eq(v, ',')) & ~inside;
+        try res.ensureUnusedCapacity(@popCount(structural));
+        while (structural != 0) : (structural &= structural - 1) {
+            res.appendAssumeCapacity(@intCast(i + @ctz(structural)));
+        }
+    }
+    if (in_string != 0) {
+        return Error.JsonScanSyntax; // unterminated string
+    }
+    return res.toOwnedSlice();
+}
+
+/// a bitmask of block bytes equal to c; bit 0 is the first byte.
+fn eq(v: Block, c: u8) u64 {
+    return @bitCast(v == @as(Block, @splat(c)));
+}
+
+/// each bit set to the parity of the set bits up to and including it.
+fn prefixXor(x: u64) u64 {
+    var m = x;
+    inline for (.{ 1, 2, 4, 8, 16, 32 }) |n| {
+        m ^= m << n;
+    }
+    return m;
+}
+
+/// decodes a JSON object or array into T. the index is allocated with
+/// allocator and freed before return; all slices of the result are allocated
+/// with arena, except strings borrowed from data: it must outlive the result.
+pub fn parseLeaky(comptime T: type, allocator: std.mem.Allocator, arena: std.mem.Allocator, data: []const u8) Error!T {
+    const idx = try index(allocator, data);
+    defer allocator.free(idx);
+    if (idx.len == 0 or trim(data[0..idx[0]]).len != 0) {
+        return Error.JsonScanSyntax;
+    }
+    var s = Scanner{ .data = data, .idx = idx, .arena = arena };
+    const v = try parseComposite(T, &s);
+    if (s.p != idx.len - 1 or trim(data[idx[s.p] + 1 ..]).len != 0) {
+        return Error.JsonScanSyntax;
+    }
+    return v;
+}
+
+const Scanner = struct {
+    data: []const u8,
+    idx: []const u32,
+    arena: std.mem.Allocator,
+    /// current position in idx. a value is parsed from the structural
+    /// preceding it, and the position left at the one following it.
+    p: usize = 0,
+
+    /// the structural character at index position p; 0 past the end.
+    fn at(self: Scanner, p: usize) u8 {
+        return if (p < self.idx.len) self.data[self.idx[p]] else 0;
+    }
+
+    /// the trimmed text between the structurals at p and p+1:
+    /// a key, a scalar, or empty if a composite starts at p+1.
+    fn between(self: Scanner, p: usize) Error![]const u8 {
+        if (p + 1 >= self.idx.len) {
+            return Error.JsonScanSyntax;
+        }
+        return trim(self.data[self.idx[p] + 1 .. self.idx[p + 1]]);
+    }
+};
+
+fn trim(s: []const u8) []const u8 {
+    return std.mem.trim(u8, s, &std.ascii.whitespace);
+}
+
+fn parseValue(comptime T: type, s: *Scanner) Error!T {
+    const text = try s.between(s.p);
+    s.p += 1;
+    if (text.len > 0) {
+        return parseScalar(T, s.arena, text);
+    }
+    const v = try parseComposite(T, s);
+    s.p += 1;
+    return v;
+}
+
+fn skipValue(s: *Scanner) Error!void {
+    const text = try s.between(s.p);
+    s.p += 1;
+    if (text.len > 0) {
+        return;
+    }
+    try skipComposite(s);
+    s.p += 1;
+}
+
+/// parses the object or array opening at p, leaving p at its closing.
+fn parseComposite(comptime T: type, s: *Scanner) Error!T {
+    switch (@typeInfo(T)) {
+        .Struct => if (comptime !std.meta.hasFn(T, "jsonParse")) return parseObject(T, s),
+        .Pointer => |info| if (info.size == .Slice and info.child != u8) return parseArray(T, s),
+        .Optional => |info| return try parseComposite(info.child, s),
+        else => {},
+    }
+    const start = s.idx[s.p];
+    try skipComposite(s);
+    return parseStd(T, s.arena, s.data[start .. s.idx[s.p] + 1]);
+}
+
+fn parseObject(comptime T: type, s: *Scanner) Error!T {
+    if (s.at(s.p) != '{') {
+        return Error.JsonScanSyntax;
+    }
+    const fields = std.meta.fields(T);
+    var res: T = undefined;
+    var seen = [_]bool{false} ** fields.len;
+    if ((try s.between(s.p)).len == 0 and s.at(s.p + 1) == '}') {
+        s.p += 1;
+    } else while (true) {
+        const key = try s.between(s.p);
+        s.p += 1;
+        if (s.at(s.p) != ':' or key.len < 2 or key[0] != '"' or key[key.len - 1] != '"') {
+            return Error.JsonScanSyntax;
+        }
+        const name = key[1 .. key.len - 1];
+        var found = false;
+        inline for (fields, 0..) |f, i| {
+            if (!found and std.mem.eql(u8, f.name, name)) {
+                @field(res, f.name) = try parseValue(f.type, s);
+                seen[i] = true;
+                found = true;
+            }
+        }
+        if (!found) {
+            try skipValue(s);
+        }
+        switch (s.at(s.p)) {
+            ',' => continue,
+            '}' => break,
+            else => return Error.JsonScanSyntax,
+        }
+    }
+    inline for (fields, 0..) |f, i| {
+        if (!seen[i]) {
+            const d = f.default_value orelse return Error.JsonScanMissingField;
+            @field(res, f.name) = @as(*const f.type, @ptrCast(@alignCast(d))).*;
+        }
+    }
+    return res;
+}
+
+fn parseArray(comptime T: type, s: *Scanner) Error!T {
+    if (s.at(s.p) != '[') {
+        return Error.JsonScanSyntax;
+    }
+    var list = std.ArrayList(std.meta.Child(T)).init(s.arena);
+    if ((try s.between(s.p)).len == 0 and s.at(s.p + 1) == ']') {
+        s.p += 1;
+    } else while (true) {
+        try list.append(try parseValue(std.meta.Child(T), s));
+        switch (s.at(s.p)) {
+            ',' => continue,
+            ']' => break,
+            else => return Error.JsonScanSyntax,
+        }
+    }
+    return list.toOwnedSlice();
+}
+
+/// moves p from an opening bracket to its closing one.
+fn skipComposite(s: *Scanner) Error!void {
+    const c = s.at(s.p);
+    if (c != '{' and c != '[') {
+        return Error.JsonScanSyntax;
+    }
+    var depth: usize = 0;
+    while (s.p < s.idx.len) : (s.p += 1) {
+        switch (s.at(s.p)) {
+            '{', '[' => depth += 1,
+            '}', ']' => {
+                depth -= 1;
+                if (depth == 0) {
+                    return;
+                }
+            },
+            else => {},
+        }
+    }
+    return Error.JsonScanSyntax;
+}
+
+fn parseScalar(comptime T: type, arena: std.mem.Allocator, text: []const u8) Error!T {
+    switch (@typeInfo(T)) {
+        .Bool => {
+            if (std.mem.eql(u8, text, "true")) return true;
+            if (std.mem.eql(u8, text, "false")) return false;
+            return Error.JsonScanSyntax;
+        },
+        .Int => return std.fmt.parseInt(T, unquote(text), 10) catch return parseStd(T, arena, text),
+        .Float => return std.fmt.parseFloat(T, unquote(text)) catch return parseStd(T, arena, text),
+        .Optional => |info| {
+            if (std.mem.eql(u8, text, "null")) return null;
+            return try parseScalar(info.child, arena, text);
+        },
+        .Pointer => |info| if (info.size == .Slice and info.child == u8 and info.sentinel == null) {
+            if (text.len < 2 or text[0] != '"' or text[text.len - 1] != '"') {
+                return Error.JsonScanSyntax;
+            }
+            const str = text[1 .. text.len - 1];
+            if (std.mem.indexOfScalar(u8, str, '\\') == null) {
+                return str;
+            }
+        },
+        else => {},
+    }
+    return parseStd(T, arena, text);
+}
+
+/// strips the quotes of a number in a string, as lnd sends 64 bit integers.
+fn unquote(text: []const u8) []const u8 {
+    if (text.len >= 2 and text[0] == '"' and text[text.len - 1] == '"') {
+        return text[1 .. text.len - 1];
+    }
+    return text;
+}
+
+fn parseStd(comptime T: type, arena: std.mem.Allocator, text: []const u8) Error!T {
+    return std.json.parseFromSliceLeaky(T, arena, text, .{
+        .ignore_unknown_fields = true,
+        .allocate = .alloc_if_needed,
+    }) catch |err| switch (err) {
+        error.OutOfMemory => Error.OutOfMemory,
+        else => Error.JsonScanSyntax,
+    };
+}
+
+test "jsonscan index" {
+    const t = std.testing;
+
+    // escaped quotes, and backslash runs across a block boundary.
+    const data = "{\"a\\\"{\":[1,{\"b\":\"" ++ "x" ** 46 ++ "\\\\\"},2]}";
+    const idx = try index(t.allocator, data);
+    defer t.allocator.free(idx);
+    var got: [16]u8 = undefined;
+    for (idx, 0..) |p, i| {
+        got[i] = data[p];
+    }
+    try t.expectEqualStrings("{:[,{:},]}", got[0..idx.len]);
+
+    try t.expectError(Error.JsonScanSyntax, index(t.allocator, "{\"a\":\"b}"));
+}
+
+test "jsonscan parse" {
+    const t = std.testing;
+    const types = @import("../types.zig");
+
+    const T = struct {
+        channels: []struct {
+            chan_id: []const u8,
+            remote_pubkey: types.PubKey,
+            capacity: i64,
+            active: bool,
+            peer_alias: []const u8 = "",
+            fee: ?f64 = null,
+        },
+        total: u32 = 7,
+    };
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    const w = buf.writer();
+    try w.writeAll("{\"unknown\": {\"x\": [1, {\"y\": \"}]\"}]}, \"channels\": [");
+    for (0..50) |i| {
+        if (i > 0) try w.writeAll(",\n");
+        try w.print(
+            \\ {{"chan_id": "{d}", "remote_pubkey": "02{s}", "capacity": "{d}",
+            \\   "pending_htlcs": [{{"a": 1}}, {{"b": [2, 3]}}], "active": {}, "peer_alias": "n\"{d}",
+            \\   "fee": {d}}}
+        , .{ 870000 + i, "ab" ** 32, i * 1000, i % 2 == 0, i, 0.5 });
+    }
+    try w.writeAll("] }\n");
+
+    var arena = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena.deinit();
+    const v = try parseLeaky(T, t.allocator, arena.allocator(), buf.items);
+    try t.expectEqual(@as(u32, 7), v.total);
+    try t.expectEqual(@as(usize, 50), v.channels.len);
+    const c = v.channels[49];
+    try t.expectEqualStrings("870049", c.chan_id);
+    try t.expectEqual(@as(u8, 0xab), c.remote_pubkey.bytes[32]);
+    try t.expectEqual(@as(i64, 49000), c.capacity);
+    try t.expect(!c.active);
+    try t.expectEqualStrings("n\"49", c.peer_alias);
+    try t.expectEqual(@as(?f64, 0.5), c.fee);
+
+    // the same as std.json.
+    const want = try std.json.parseFromSliceLeaky(T, arena.allocator(), buf.items, .{ .ignore_unknown_fields = true });
+    try t.expectEqualDeep(want, v);
+
+    try t.expectError(Error.JsonScanMissingField, parseLeaky(T, t.allocator, arena.allocator(), "{}"));
+    try t.expectError(Error.JsonScanSyntax, parseLeaky(T, t.allocator, arena.allocator(), "{\"channels\": [} "));
+    try t.expectError(Error.JsonScanSyntax, parseLeaky(T, t.allocator, arena.allocator(), "{\"channels\": []"));
+}
@@ -3,24 +3,40 @@
 const std = @import("std");
 const base64enc = std.base64.standard.Encoder;
 
+const deadline = @import("../deadline.zig");
+const jsonscan = @import("jsonscan.zig");
 const types = @import("../types.zig");
 
 /// safe for concurrent use as long as Client.allocator is.
 pub const Client = struct {
     allocator: std.mem.Allocator,
-    hostname: []const u8 = "localhost",
+    hostname: []const u8 = "localhost", // slice of apibase
     port: u16 = 10010,
     apibase: []const u8, // https://localhost:10010
+    plain_http: bool = false, // see InitOpt
     macaroon: struct {
         readonly: ?[]const u8,
         admin: ?[]const u8,
     },
     httpClient: std.http.Client,
+    observer: ?Observer = null,
+    arena_pool: ?*types.ArenaPool = null, // see InitOpt
+
+    /// notified upon completion of each call, for example to collect latency
+    /// metrics. must be safe for concurrent use as the client is.
+    pub const Observer = struct {
+        ctx: *anyopaque,
+        func: *const fn (ctx: *anyopaque, method: ApiMethod, elapsed_ns: u64, ok: bool) void,
+    };
+
+    /// max response body size.
+    const max_body_size = 64 * 1024 * 1024;
 
     pub const Error = error{
         LndHttpMissingMacaroon,
         LndHttpBadStatusCode,
         LndPayloadWriteFail,
+        LndStreamError,
     };
 
     pub const ApiMethod = enum {
@@ -30,23 +46,40 @@ pub const Client = struct {
         initwallet, // commit a seed and create a node wallet
         unlockwallet, // required after successfull initwallet
         // read-only
+        exportchanbackups, // static channel backup of all channels
         feereport, // fees of all active channels
+        fwdinghistory, // forwarded payments, a batch at a time
+        getchaninfo, // graph channel edge with routing policies of both ends
         getinfo, // general host node info
         getnetworkinfo, // visible graph info
+        getnodeinfo, // graph node info such as alias
+        gettransactions, // onchain wallet transactions in a block height range
         listchannels, // active channels
+        listinvoices, // invoices by add_index, a page at a time
+        listpeers, // connected peers with ping times and traffic counters
+        listpayments, // outgoing payments by payment_index, a page at a time
+        listunspent, // onchain wallet unspent outputs
         pendingchannels, // pending open/close channels
         walletbalance, // onchain balance
-        // fwdinghistory, getchaninfo, getnodeinfo
         // watchtower: getinfo, stats, list, add, remove
 
         fn apipath(self: @This()) []const u8 {
             return switch (self) {
+                .exportchanbackups => "v1/channels/backup",
                 .feereport => "v1/fees",
+                .fwdinghistory => "v1/switch",
                 .genseed => "v1/genseed",
+                .getchaninfo => "v1/graph/edge", // + /{chan_id}
                 .getinfo => "v1/getinfo",
                 .getnetworkinfo => "v1/graph/info",
+                .getnodeinfo => "v1/graph/node", // + /{pub_key}
+                .gettransactions => "v1/transactions",
                 .initwallet => "v1/initwallet",
                 .listchannels => "v1/channels",
+                .listinvoices => "v1/invoices",
+                .listpeers => "v1/peers",
+                .listpayments => "v1/payments",
+                .listunspent => "v2/wallet/utxos",
                 .pendingchannels => "v1/channels/pending",
                 .unlockwallet => "v1/unlockwallet",
                 .walletbalance => "v1/balance/blockchain",
@@ -55,6 +88,172 @@ pub const Client = struct {
         }
     };
 
+    /// streaming endpoints: lnd responds with newline delimited JSON objects,
+    /// one per event, for as long as the connection is open.
+    pub const StreamMethod = enum {
+        subscribechannelevents, // channel opened, closed, active or inactive
+        subscribeinvoices, // invoice added or settled
+        subscribechanbackups, // static channel backup, once channels change
+        subscribehtlcevents, // htlc forwarded, settled or failed
+        subscribechannelgraph, // graph nodes and channels announced or closed
+
+        fn apipath(self: @This()) []const u8 {
+            return switch (self) {
+                .subscribechannelevents => "v1/channels/subscribe",
+                .subscribeinvoices => "v1/invoices/subscribe",
+                .subscribechanbackups => "v1/channels/backup/subscribe",
+                .subscribehtlcevents => "v2/router/htlcevents",
+                .subscribechannelgraph => "v1/graph/subscribe",
+            };
+        }
+    };
+
+    pub fn StreamEvent(comptime m: StreamMethod) type {
+        return switch (m) {
+            .subscribechannelevents => ChannelEventUpdate,
+            .subscribeinvoices => Invoice,
+            .subscribechanbackups => ChanBackupSnapshot,
+            .subscribehtlcevents => HtlcEvent,
+            .subscribechannelgraph => GraphTopologyUpdate,
+        };
+    }
+
+    /// a describegraph response being read, decoded a node or a channel at
+    /// a time rather than all at once: the mainnet graph is tens of MB of JSON.
+    /// see describeGraph.
+    pub const GraphReader = struct {
+        allocator: std.mem.Allocator,
+        url: []const u8,
+        xheaders: [1]std.http.Header,
+        headersbuf: [8 * 1024]u8,
+        req: std.http.Client.Request,
+        json: std.json.Reader(std.json.default_buffer_size, std.http.Client.Request.Reader),
+        arena: std.heap.ArenaAllocator, // of the last returned item
+        section: Section = .start,
+
+        const Section = enum { start, keys, nodes, edges, end };
+
+        pub const Item = union(enum) {
+            node: GraphNode,
+            edge: GraphEdge,
+        };
+
+        const parse_opt = std.json.ParseOptions{
+            .ignore_unknown_fields = true,
+            .allocate = .alloc_if_needed,
+            .max_value_len = std.json.default_max_value_len,
+        };
+
+        /// blocks until the next node or channel is read, and returns null
+        /// at the end of the graph. the item is valid until the next call.
+        pub fn next(self: *GraphReader) !?Item {
+            _ = self.arena.reset(.retain_capacity);
+            const arena = self.arena.allocator();
+            while (true) {
+                switch (self.section) {
+                    .start => {
+                        if (try self.json.next() != .object_begin) {
+                            return error.SyntaxError;
+                        }
+                        self.section = .keys;
+                    },
+                    .keys => switch (try self.json.nextAlloc(arena, .alloc_if_needed)) {
+                        .object_end => self.section = .end,
+                        .string, .allocated_string => |key| {
+                            if (std.mem.eql(u8, key, "nodes")) {
+                                try self.beginList(.nodes);
+                            } else if (std.mem.eql(u8, key, "edges")) {
+                                try self.beginList(.edges);
+                            } else {
+                                try self.json.skipValue();
+                            }
+                        },
+                        else => return error.SyntaxError,
+                    },
+                    .nodes, .edges => |list| {
+                        if (try self.json.peekNextTokenType() == .array_end) {
+                            _ = try self.json.next();
+                            self.section = .keys;
+                            continue;
+                        }
+                        if (list == .nodes) {
+                            return .{ .node = try std.json.innerParse(GraphNode, arena, &self.json, parse_opt) };
+                        }
+                        return .{ .edge = try std.json.innerParse(GraphEdge, arena, &self.json, parse_opt) };
+                    },
+                    .end => return null,
+                }
+            }
+        }
+
+        fn beginList(self: *GraphReader, list: Section) !void {
+            if (try self.json.next() != .array_begin) {
+                return error.SyntaxError;
+            }
+            self.section = list;
+        }
+
+        pub fn deinit(self: *GraphReader) void {
+            self.json.deinit();
+            self.arena.deinit();
+            self.req.deinit();
+            self.allocator.free(self.url);
+            self.allocator.destroy(self);
+        }
+    };
+
+    /// an open subscription to a streaming endpoint; see subscribe.
+    pub fn Stream(comptime m: StreamMethod) type {
+        return struct {
+            allocator: std.mem.Allocator,
+            url: []const u8,
+            xheaders: [1]std.http.Header,
+            headersbuf: [8 * 1024]u8,
+            req: std.http.Client.Request,
+            line: std.ArrayList(u8), // event being received
+
+            const Self = @This();
+
+            /// max size of a single event JSON object. backups grow with
+            /// the number of channels, a few hundred bytes each.
+            const max_event_size = if (m == .subscribechanbackups) 16 * 1024 * 1024 else 64 * 1024;
+
+            /// blocks until the next event is received, and returns null when
+            /// the server ends the stream. chunked transfer encoding is decoded
+            /// by the HTTP reader; events are split at newlines.
+            /// the returned value must be deinit'ed when done.
+            pub fn next(self: *Self) !?types.Deinitable(StreamEvent(m)) {
+                while (true) {
+                    self.line.clearRetainingCapacity();
+                    self.req.reader().streamUntilDelimiter(self.line.writer(), '\n', max_event_size) catch |err| switch (err) {
+                        // the last event may not be newline terminated
+                        error.EndOfStream => if (self.line.items.len == 0) return null,
+                        else => return err,
+                    };
+                    const line = std.mem.trim(u8, self.line.items, &std.ascii.whitespace);
+                    if (line.len == 0) {
+                        continue;
+                    }
+                    return try parseStreamEvent(StreamEvent(m), self.allocator, line);
+                }
+            }
+
+            /// the underlying socket. shutting it down from another thread
+            /// unblocks next, making it fail; the stream must still be deinit'ed.
+            pub fn fd(self: *const Self) ?std.posix.fd_t {
+                const conn = self.req.connection orelse return null;
+                return conn.stream.handle;
+            }
+
+            pub fn deinit(self: *Self) void {
+                self.req.deinit();
+                self.line.deinit();
+                self.allocator.free(self.url);
+                self.allocator.destroy(self);
+            }
+        };
+    }
+
     pub fn MethodArgs(comptime m: ApiMethod) type {
         return switch (m) {
             .initwallet => struct {
@@ -77,18 +276,58 @@ pub const Client = struct {
                 peer: ?[]const u8 = null, // hex pubkey; filter out non-matching peers
                 peer_alias_lookup: bool, // performance penalty if set to true
             },
+            .getnodeinfo => struct {
+                pubkey: []const u8, // hex
+                include_channels: bool = false,
+            },
+            .getchaninfo => struct {
+                chan_id: u64, // short channel id
+            },
+            .gettransactions => struct {
+                start_height: i32 = 0,
+                end_height: i32 = -1, // inclusive; -1 is the tip, unconfirmed transactions included
+            },
+            .listinvoices => struct {
+                index_offset: u64 = 0, // add_index after which to start the page
+                num_max_invoices: u64 = 1000,
+            },
+            .listpayments => struct {
+                index_offset: u64 = 0, // payment_index after which to start the page
+                max_payments: u64 = 1000,
+                include_incomplete: bool = true, // in flight and failed too
+            },
+            .listunspent => struct {
+                min_confs: i32 = 0, // 0 includes unconfirmed outputs
+                max_confs: i32 = std.math.maxInt(i32),
+            },
+            .fwdinghistory => struct {
+                // lnd defaults a zero start_time to a day ago; 1 is the whole history.
+                start_time: u64 = 1, // unix time, seconds
+                end_time: u64 = 0, // unix time, seconds; 0 is now
+                index_offset: u32 = 0, // events to skip in the start..end range
+                num_max_events: u32 = 1000, // lnd max is 50000
+            },
             else => void,
         };
     }
 
     pub fn ResultValue(comptime m: ApiMethod) type {
         return switch (m) {
+            .exportchanbackups => ChanBackupSnapshot,
             .feereport => FeeReport,
+            .fwdinghistory => ForwardingHistory,
             .genseed => GeneratedSeed,
+            .getchaninfo => ChannelEdge,
             .getinfo => LndInfo,
             .getnetworkinfo => NetworkInfo,
+            .getnodeinfo => NodeInfo,
+            .gettransactions => TransactionList,
             .initwallet => InitedWallet,
             .listchannels => ChannelsList,
+            .listinvoices => InvoiceList,
+            .listpeers => PeersList,
+            .listpayments => PaymentList,
+            .listunspent => UtxoList,
             .pendingchannels => PendingList,
             .unlockwallet => struct {},
             .walletbalance => WalletBalance,
@@ -103,24 +342,38 @@ pub const Client = struct {
         tlscert_path: []const u8, // must contain the hostname in SANs
         macaroon_ro_path: ?[]const u8 = null, // readonly macaroon path
         macaroon_admin_path: ?[]const u8 = null, // required only for requests mutating lnd state
+        /// talk HTTP without TLS, ignoring tlscert_path; only for tests with a mock server.
+        plain_http: bool = false,
+        observer: ?Observer = null,
+        /// call results take their arenas from the pool, if set.
+        /// the pool must outlive the results.
+        arena_pool: ?*types.ArenaPool = null,
     };
 
     /// opt slices are dup'ed and need not be kept alive.
     /// must deinit when done.
     pub fn init(opt: InitOpt) !Client {
         var ca = std.crypto.Certificate.Bundle{}; // deinit'ed by http.Client.deinit
-        try ca.addCertsFromFilePathAbsolute(opt.allocator, opt.tlscert_path);
+        if (!opt.plain_http) {
+            try ca.addCertsFromFilePathAbsolute(opt.allocator, opt.tlscert_path);
+        }
         errdefer ca.deinit(opt.allocator);
         const mac_ro: ?[]const u8 = if (opt.macaroon_ro_path) |p| try readMacaroonOrNull(opt.allocator, p) else null;
         errdefer if (mac_ro) |v| opt.allocator.free(v);
         const mac_admin: ?[]const u8 = if (opt.macaroon_admin_path) |p| try readMacaroonOrNull(opt.allocator, p) else null;
         errdefer if (mac_admin) |v| opt.allocator.free(v);
-        const apibase = try std.fmt.allocPrint(opt.allocator, "https://{s}:{d}", .{ opt.hostname, opt.port });
+        const apibase = try std.fmt.allocPrint(opt.allocator, "{s}://{s}:{d}", .{ if (opt.plain_http) "http" else "https", opt.hostname, opt.port });
         errdefer opt.allocator.free(apibase);
+        const host_start = std.mem.indexOf(u8, apibase, "://").? + 3;
         return .{
             .allocator = opt.allocator,
+            .hostname = apibase[host_start..std.mem.lastIndexOfScalar(u8, apibase, ':').?],
+            .port = opt.port,
             .apibase = apibase,
+            .plain_http = opt.plain_http,
             .macaroon = .{ .readonly = mac_ro, .admin = mac_admin },
+            .observer = opt.observer,
+            .arena_pool = opt.arena_pool,
             .httpClient = std.http.Client{
                 .allocator = opt.allocator,
                 .ca_bundle = ca,
@@ -141,7 +394,29 @@ pub const Client = struct {
     }
 
     pub fn call(self: *Client, comptime apimethod: ApiMethod, args: MethodArgs(apimethod)) !Result(apimethod) {
-        const formatted = try self.formatreq(apimethod, args);
+        const start = std.time.nanoTimestamp();
+        const res = self.callUnobserved(apimethod, args);
+        if (self.observer) |o| {
+            o.func(o.ctx, apimethod, std.math.lossyCast(u64, std.time.nanoTimestamp() - start), !std.meta.isError(res));
+        }
+        return res;
+    }
+
+    /// a call past the thread deadline fails with error.DeadlineExceeded;
+    /// see deadline.zig.
+    fn callUnobserved(self: *Client, comptime apimethod: ApiMethod, args: MethodArgs(apimethod)) !Result(apimethod) {
+        const d = deadline.get();
+        return self.callDeadline(apimethod, args, d) catch |err| {
+            return if (deadline.exceeded(d)) error.DeadlineExceeded else err;
+        };
+    }
+
+    fn callDeadline(self: *Client, comptime apimethod: ApiMethod, args: MethodArgs(apimethod), d: ?i64) !Result(apimethod) {
+        // requests are formatted on the stack: no heap allocations unless
+        // a payload is unusually large. stack, unlike a per-client buffer,
+        // keeps concurrent calls lock-free; see callGroup.
+        var reqalloc = std.heap.stackFallback(4096, self.allocator);
+        const formatted = try self.formatreq(reqalloc.get(), apimethod, args);
         defer formatted.deinit();
 
         var headersbuf: [8 * 1024]u8 = undefined;
@@ -152,8 +427,22 @@ pub const Client = struct {
             .privileged_headers = reqinfo.xheaders,
             .server_header_buffer = &headersbuf,
         };
+        if (d) |v| {
+            try self.preconnect(v);
+        }
         var req = try self.httpClient.open(reqinfo.httpmethod, reqinfo.url, opt);
         defer req.deinit();
+        if (d != null) {
+            try deadline.setSocketTimeout(req.connection.?.stream.handle, d);
+        }
+        // lifted ahead of req.deinit, which puts the connection back in the pool.
+        defer if (d != null) {
+            if (req.connection) |conn| {
+                deadline.setSocketTimeout(conn.stream.handle, null) catch {
+                    conn.closing = true;
+                };
+            }
+        };
         if (reqinfo.payload) |p| {
             req.transfer_encoding = .{ .content_length = p.len };
         }
@@ -174,17 +463,243 @@ pub const Client = struct {
             return; // void response; need no json parsing
         }
 
-        const body = try req.reader().readAllAlloc(self.allocator, 1 << 20); // 1Mb should be enough for all response types
-        defer self.allocator.free(body);
-        var res = try Result(apimethod).init(self.allocator);
+        var res = try self.initResult(apimethod);
         errdefer res.deinit();
-        res.value = try std.json.parseFromSliceLeaky(ResultValue(apimethod), res.arena.allocator(), body, .{
+        // the body is read whole into the result arena, next to the value:
+        // strings borrow from it, and only those with escapes are allocated anew.
+        const arena = res.arena.allocator();
+        var dr = deadline.reader(req.reader(), d);
+        const body = if (req.response.content_length) |n| blk: {
+            if (n > max_body_size) {
+                return error.StreamTooLong;
+            }
+            const b = try arena.alloc(u8, @intCast(n));
+            try dr.reader().readNoEof(b);
+            break :blk b;
+        } else try dr.reader().readAllAlloc(arena, max_body_size);
+        res.value = try self.decodeBody(apimethod, arena, body);
+        return res;
+    }
+
+    /// opens a connection to lnd and leaves it in the httpClient pool, unless
+    /// one is idle there already, so that connecting and the TLS handshake
+    /// are bounded by d: std.http.Client has no timeouts of its own.
+    /// mirrors std.http.Client.connectTcp.
+    fn preconnect(self: *Client, d: i64) !void {
+        const pool = &self.httpClient.connection_pool;
+        pool.mutex.lock();
+        const idle = pool.free_len > 0;
+        pool.mutex.unlock();
+        if (idle) {
+            return;
+        }
+
+        const list = try std.net.getAddressList(self.allocator, self.hostname, self.port);
+        defer list.deinit();
+        if (list.addrs.len == 0) {
+            return error.UnknownHostName;
+        }
+        const stream = try deadline.tcpConnect(list.addrs[0], d);
+        errdefer stream.close();
+        try deadline.setSocketTimeout(stream.handle, d);
+        const node = try self.allocator.create(std.http.Client.ConnectionPool.Node);
+        errdefer self.allocator.destroy(node);
+        node.* = .{ .data = .{
+            .stream = stream,
+            .tls_client = undefined,
+            .protocol = if (self.plain_http) .plain else .tls,
+            .host = try self.allocator.dupe(u8, self.hostname),
+            .port = self.port,
+        } };
+        errdefer self.allocator.free(node.data.host);
+        if (!self.plain_http) {
+            const tls = try self.allocator.create(std.crypto.tls.Client);
+            errdefer self.allocator.destroy(tls);
+            tls.* = std.crypto.tls.Client.init(stream, self.httpClient.ca_bundle, self.hostname) catch {
+                return if (deadline.exceeded(d)) error.DeadlineExceeded else error.TlsInitializationFailed;
+            };
+            tls.allow_truncation_attacks = true;
+            node.data.tls_client = tls;
+        }
+        // pooled connections are taken by streams of no deadline, too.
+        try deadline.setSocketTimeout(stream.handle, null);
+        pool.addUsed(node);
+        pool.release(self.allocator, &node.data);
+    }
+
+    /// parses body as a response of apimethod, as if it were received from lnd,
+    /// without any network roundtrip. meant for benchmarks and tests.
+    /// the returned value must be deinit'ed when done.
+    pub fn parseResponse(self: *Client, comptime apimethod: ApiMethod, body: []const u8) !Result(apimethod) {
+        var res = try self.initResult(apimethod);
+        errdefer res.deinit();
+        const arena = res.arena.allocator();
+        res.value = try self.decodeBody(apimethod, arena, try arena.dupe(u8, body));
+        return res;
+    }
+
+    fn initResult(self: *Client, comptime apimethod: ApiMethod) !Result(apimethod) {
+        if (self.arena_pool) |pool| {
+            return Result(apimethod).initPooled(pool);
+        }
+        return Result(apimethod).init(self.allocator);
+    }
+
+    /// decodes a response body held in arena; the value borrows strings from it.
+    fn decodeBody(self: *Client, comptime apimethod: ApiMethod, arena: std.mem.Allocator, body: []const u8) !ResultValue(apimethod) {
+        if (comptime apimethod == .listchannels or apimethod == .pendingchannels) {
+            // large responses of mostly ignored fields: decoded off a structural
+            // index, skipping unknown subtrees in bulk.
+            return jsonscan.parseLeaky(ResultValue(apimethod), self.allocator, arena, body);
+        }
+        return std.json.parseFromSliceLeaky(ResultValue(apimethod), arena, body, .{
+            .ignore_unknown_fields = true,
+            .allocate = .alloc_if_needed,
+        });
+    }
+
+    /// opens a subscription to the streaming endpoint m.
+    /// the returned value must be deinit'ed when done.
+    pub fn subscribe(self: *Client, comptime m: StreamMethod) !*Stream(m) {
+        const mac = self.macaroon.readonly orelse return Error.LndHttpMissingMacaroon;
+        const st = try self.allocator.create(Stream(m));
+        errdefer self.allocator.destroy(st);
+        const url = try std.fmt.allocPrint(self.allocator, "{s}/{s}", .{ self.apibase, m.apipath() });
+        errdefer self.allocator.free(url);
+        st.* = .{
+            .allocator = self.allocator,
+            .url = url,
+            .xheaders = .{.{ .name = "grpc-metadata-macaroon", .value = mac }},
+            .headersbuf = undefined,
+            .req = undefined,
+            .line = std.ArrayList(u8).init(self.allocator),
+        };
+        errdefer st.line.deinit();
+        st.req = try self.httpClient.open(.GET, try std.Uri.parse(st.url), .{
+            .redirect_behavior = .not_allowed, // no redirects in REST API
+            .privileged_headers = &st.xheaders,
+            .server_header_buffer = &st.headersbuf,
+        });
+        errdefer st.req.deinit();
+        try st.req.send();
+        try st.req.wait();
+        if (st.req.response.status.class() != .success) {
+            return Error.LndHttpBadStatusCode;
+        }
+        return st;
+    }
+
+    /// starts reading the public channel graph, as describegraph does.
+    /// the returned value must be deinit'ed when done.
+    pub fn describeGraph(self: *Client) !*GraphReader {
+        const mac = self.macaroon.readonly orelse return Error.LndHttpMissingMacaroon;
+        const gr = try self.allocator.create(GraphReader);
+        errdefer self.allocator.destroy(gr);
+        const url = try std.fmt.allocPrint(self.allocator, "{s}/v1/graph", .{self.apibase});
+        errdefer self.allocator.free(url);
+        gr.* = .{
+            .allocator = self.allocator,
+            .url = url,
+            .xheaders = .{.{ .name = "grpc-metadata-macaroon", .value = mac }},
+            .headersbuf = undefined,
+            .req = undefined,
+            .json = undefined,
+            .arena = std.heap.ArenaAllocator.init(self.allocator),
+        };
+        errdefer gr.arena.deinit();
+        gr.req = try self.httpClient.open(.GET, try std.Uri.parse(gr.url), .{
+            .redirect_behavior = .not_allowed, // no redirects in REST API
+            .privileged_headers = &gr.xheaders,
+            .server_header_buffer = &gr.headersbuf,
+        });
+        errdefer gr.req.deinit();
+        try gr.req.send();
+        try gr.req.wait();
+        if (gr.req.response.status.class() != .success) {
+            return Error.LndHttpBadStatusCode;
+        }
+        gr.json = std.json.reader(self.allocator, gr.req.reader());
+        return gr;
+    }
+
+    /// parses a single streaming endpoint event: {"result": T} or {"error": {...}}.
+    fn parseStreamEvent(comptime T: type, allocator: std.mem.Allocator, line: []const u8) !types.Deinitable(T) {
+        var res = try types.Deinitable(T).init(allocator);
+        errdefer res.deinit();
+        const msg = try std.json.parseFromSliceLeaky(struct {
+            result: ?T = null,
+            @"error": ?struct {
+                code: i32 = 0,
+                message: []const u8 = "",
+            } = null,
+        }, res.arena.allocator(), line, .{
             .ignore_unknown_fields = true,
             .allocate = .alloc_always,
         });
+        if (msg.@"error" != null) {
+            return Error.LndStreamError;
+        }
+        res.value = msg.result orelse return Error.LndStreamError;
         return res;
     }
 
+    /// a return type of `callGroup`: a tuple of results in the same order as methods.
+    /// each successful result must be deinit'ed; see `deinitGroup`.
+    pub fn GroupResult(comptime methods: []const ApiMethod) type {
+        var fields: [methods.len]type = undefined;
+        for (methods, 0..) |m, i| {
+            fields[i] = anyerror!Result(m);
+        }
+        return std.meta.Tuple(&fields);
+    }
+
+    /// a tuple of method args, in the same order as methods, for `callGroup`.
+    pub fn GroupArgs(comptime methods: []const ApiMethod) type {
+        var fields: [methods.len]type = undefined;
+        for (methods, 0..) |m, i| {
+            fields[i] = MethodArgs(m);
+        }
+        return std.meta.Tuple(&fields);
+    }
+
+    /// calls all methods concurrently, each in a separate thread except the first
+    /// one which runs in the calling thread, and waits for all of them to complete.
+    /// the total latency is thus bounded by the slowest call.
+    /// if a thread cannot be spawned, the method is called sequentially instead.
+    /// the calls all run to the deadline of the calling thread.
+    pub fn callGroup(self: *Client, comptime methods: []const ApiMethod, args: GroupArgs(methods)) GroupResult(methods) {
+        var res: GroupResult(methods) = undefined;
+        var threads = [_]?std.Thread{null} ** methods.len;
+        inline for (methods[1..], 1..) |m, i| {
+            threads[i] = std.Thread.spawn(.{}, GroupWorker(m).run, .{ self, args[i], deadline.get(), &res[i] }) catch null;
+        }
+        res[0] = self.call(methods[0], args[0]);
+        inline for (methods[1..], 1..) |m, i| {
+            if (threads[i]) |th| {
+                th.join();
+            } else {
+                res[i] = self.call(m, args[i]);
+            }
+        }
+        return res;
+    }
+
+    /// releases resources of all successful results returned by `callGroup`.
+    pub fn deinitGroup(res: anytype) void {
+        inline for (res) |r| {
+            if (r) |v| v.deinit() else |_| {}
+        }
+    }
+
+    fn GroupWorker(comptime m: ApiMethod) type {
+        return struct {
+            fn run(client: *Client, args: MethodArgs(m), d: ?i64, out: *anyerror!Result(m)) void {
+                deadline.inherit(d); // of the callGroup caller
+                out.* = client.call(m, args);
+            }
+        };
+    }
+
     const HttpReqInfo = struct {
         httpmethod: std.http.Method,
         url: std.Uri,
@@ -193,9 +708,9 @@ pub const Client = struct {
         payload: ?[]const u8 = null,
     };
 
-    fn formatreq(self: Client, comptime apimethod: ApiMethod, args: MethodArgs(apimethod)) !types.Deinitable(HttpReqInfo) {
-        const authHeaderName = "grpc-metadata-macaroon";
-        var reqinfo = try types.Deinitable(HttpReqInfo).init(self.allocator);
+    /// the result and all its slices are allocated with the allocator.
+    fn formatreq(self: Client, allocator: std.mem.Allocator, comptime apimethod: ApiMethod, args: MethodArgs(apimethod)) !types.Deinitable(HttpReqInfo) {
+        var reqinfo = try types.Deinitable(HttpReqInfo).init(allocator);
         errdefer reqinfo.deinit();
         const arena = reqinfo.arena.allocator();
         reqinfo.value = switch (apimethod) {
@@ -241,17 +756,76 @@ pub const Client = struct {
                     .payload = payload,
                 };
             },
-            .feereport, .getinfo, .getnetworkinfo, .pendingchannels, .walletbalance => |m| .{
+            .fwdinghistory, .listunspent => |m| blk: {
+                var buf = std.ArrayList(u8).init(arena);
+                try std.json.stringify(args, .{}, buf.writer());
+                break :blk .{
+                    .httpmethod = .POST,
+                    .url = try std.Uri.parse(try std.fmt.allocPrint(arena, "{s}/{s}", .{ self.apibase, m.apipath() })),
+                    .xheaders = try self.readonlyAuth(arena),
+                    .payload = try buf.toOwnedSlice(),
+                };
+            },
+            .exportchanbackups, .feereport, .getinfo, .getnetworkinfo, .listpeers, .pendingchannels, .walletbalance => |m| .{
                 .httpmethod = .GET,
                 .url = try std.Uri.parse(try std.fmt.allocPrint(arena, "{s}/{s}", .{ self.apibase, m.apipath() })),
-                .xheaders = blk: {
-                    if (self.macaroon.readonly == null) {
-                        return Error.LndHttpMissingMacaroon;
-                    }
-                    var h = std.ArrayList(std.http.Header).init(arena);
-                    try h.append(.{ .name = authHeaderName, .value = self.macaroon.readonly.? });
-                    break :blk try h.toOwnedSlice();
+                .xheaders = try self.readonlyAuth(arena),
+                .payload = null,
+            },
+            .getnodeinfo => |m| .{
+                .httpmethod = .GET,
+                .url = blk: {
+                    // pubkeys are hex; no escaping needed
+                    for (args.pubkey) |c| if (!std.ascii.isHex(c)) return error.InvalidPubkey;
+                    const url = try std.fmt.allocPrint(arena, "{s}/{s}/{s}?include_channels={}", .{
+                        self.apibase,
+                        m.apipath(),
+                        args.pubkey,
+                        args.include_channels,
+                    });
+                    break :blk try std.Uri.parse(url);
                 },
+                .xheaders = try self.readonlyAuth(arena),
+                .payload = null,
+            },
+            .getchaninfo => |m| .{
+                .httpmethod = .GET,
+                .url = try std.Uri.parse(try std.fmt.allocPrint(arena, "{s}/{s}/{d}", .{ self.apibase, m.apipath(), args.chan_id })),
+                .xheaders = try self.readonlyAuth(arena),
+                .payload = null,
+            },
+            .listinvoices => |m| .{
+                .httpmethod = .GET,
+                .url = try std.Uri.parse(try std.fmt.allocPrint(arena, "{s}/{s}?index_offset={d}&num_max_invoices={d}", .{
+                    self.apibase,
+                    m.apipath(),
+                    args.index_offset,
+                    args.num_max_invoices,
+                })),
+                .xheaders = try self.readonlyAuth(arena),
+                .payload = null,
+            },
+            .gettransactions => |m| .{
+                .httpmethod = .GET,
+                .url = try std.Uri.parse(try std.fmt.allocPrint(arena, "{s}/{s}?start_height={d}&end_height={d}", .{
+                    self.apibase,
+                    m.apipath(),
+                    args.start_height,
+                    args.end_height,
+                })),
+                .xheaders = try self.readonlyAuth(arena),
+                .payload = null,
+            },
+            .listpayments => |m| .{
+                .httpmethod = .GET,
+                .url = try std.Uri.parse(try std.fmt.allocPrint(arena, "{s}/{s}?index_offset={d}&max_payments={d}&include_incomplete={}", .{
+                    self.apibase,
+                    m.apipath(),
+                    args.index_offset,
+                    args.max_payments,
+                    args.include_incomplete,
+                })),
+                .xheaders = try self.readonlyAuth(arena),
                 .payload = null,
             },
             .listchannels => .{
@@ -274,23 +848,23 @@ pub const Client = struct {
                     }
                     break :blk try std.Uri.parse(buf.items); // uri point to the original buf
                 },
-                .xheaders = blk: {
-                    if (self.macaroon.readonly == null) {
-                        return Error.LndHttpMissingMacaroon;
-                    }
-                    var h = std.ArrayList(std.http.Header).init(arena);
-                    try h.append(.{ .name = authHeaderName, .value = self.macaroon.readonly.? });
-                    break :blk try h.toOwnedSlice();
-                },
+                .xheaders = try self.readonlyAuth(arena),
                 .payload = null,
             },
         };
         return reqinfo;
     }
 
+    /// returns the readonly macaroon auth header. the macaroon is hex-encoded
+    /// once at init; only the slice is allocated.
+    fn readonlyAuth(self: Client, arena: std.mem.Allocator) ![]const std.http.Header {
+        const mac = self.macaroon.readonly orelse return Error.LndHttpMissingMacaroon;
+        return arena.dupe(std.http.Header, &.{.{ .name = "grpc-metadata-macaroon", .value = mac }});
+    }
+
     /// returns null if file not found.
     /// callers own returned value.
-    fn readMacaroonOrNull(gpa: std.mem.Allocator, path: []const u8) !?[]const u8 {
+    pub fn readMacaroonOrNull(gpa: std.mem.Allocator, path: []const u8) !?[]const u8 {
         const file = std.fs.openFileAbsolute(path, .{ .mode = .read_only }) catch |err| switch (err) {
             error.FileNotFound => return null,
             else => return err,
@@ -311,7 +885,7 @@ pub const Client = struct {
 /// general info and stats around the host lnd.
 pub const LndInfo = struct {
     version: []const u8,
-    identity_pubkey: []const u8,
+    identity_pubkey: types.PubKey,
     alias: []const u8,
     color: []const u8,
     num_pending_channels: u32,
@@ -319,7 +893,7 @@ pub const LndInfo = struct {
     num_inactive_channels: u32,
     num_peers: u32,
     block_height: u32,
-    block_hash: []const u8,
+    block_hash: types.Hash,
     synced_to_chain: bool,
     synced_to_graph: bool,
     chains: []const struct {
@@ -344,6 +918,41 @@ pub const NetworkInfo = struct {
     num_zombie_chans: u64,
 };
 
+/// https://lightning.engineering/api-docs/api/lnd/lightning/get-node-info
+pub const NodeInfo = struct {
+    node: struct {
+        pub_key: []const u8,
+        alias: []const u8,
+        color: []const u8,
+        last_update: u64, // unix epoch
+    },
+    num_channels: u32,
+    total_capacity: i64,
+};
+
+/// https://lightning.engineering/api-docs/api/lnd/lightning/get-chan-info
+pub const ChannelEdge = struct {
+    channel_id: u64,
+    chan_point: []const u8, // txid:index
+    last_update: u64 = 0, // unix epoch
+    node1_pub: []const u8,
+    node2_pub: []const u8,
+    capacity: i64 = 0, // satoshis
+    // a policy is unknown until its node announces one.
+    node1_policy: ?RoutingPolicy = null,
+    node2_policy: ?RoutingPolicy = null,
+
+    pub const RoutingPolicy = struct {
+        time_lock_delta: u32 = 0,
+        min_htlc: i64 = 0, // msat
+        fee_base_msat: i64 = 0,
+        fee_rate_milli_msat: i64 = 0, // ppm
+        disabled: bool = false,
+        max_htlc_msat: u64 = 0,
+        last_update: u64 = 0, // unix epoch
+    };
+};
+
 pub const FeeReport = struct {
     day_fee_sum: u64,
     week_fee_sum: u64,
@@ -357,11 +966,25 @@ pub const FeeReport = struct {
     },
 };
 
+/// a batch of forwarding events, oldest first.
+pub const ForwardingHistory = struct {
+    forwarding_events: []struct {
+        timestamp_ns: u64, // unix time of the settlement, nanoseconds
+        chan_id_in: []const u8, // uint64 as a decimal string
+        chan_id_out: []const u8,
+        amt_in_msat: u64,
+        amt_out_msat: u64,
+        fee_msat: u64,
+    } = &.{},
+    /// index of the last event in the batch; the offset of the next call.
+    last_offset_index: u32 = 0,
+};
+
 pub const ChannelsList = struct {
     channels: []struct {
         chan_id: []const u8, // [0..3]: height, [3..6]: index within block, [6..8]: chan out idx
-        remote_pubkey: []const u8,
-        channel_point: []const u8, // txid:index of the funding tx
+        remote_pubkey: types.PubKey,
+        channel_point: types.OutPoint, // funding tx output
         capacity: i64,
         local_balance: i64,
         remote_balance: i64,
@@ -386,7 +1009,7 @@ pub const PendingList = struct {
     },
     pending_force_closing_channels: []struct {
         channel: PendingChannel,
-        closing_txid: []const u8,
+        closing_txid: []const u8, // may be empty
         limbo_balance: i64,
         maturity_height: u32,
         blocks_til_maturity: i32, // negative indicates n blocks since maturity
@@ -402,8 +1025,8 @@ pub const PendingList = struct {
 };
 
 pub const PendingChannel = struct {
-    remote_node_pub: []const u8,
-    channel_point: []const u8,
+    remote_node_pub: types.PubKey,
+    channel_point: types.OutPoint,
     capacity: i64,
     local_balance: i64,
     remote_balance: i64,
@@ -411,6 +1034,148 @@ pub const PendingChannel = struct {
     // local_chan_reserve_sat, remote_chan_reserve_sat, initiator, chan_status_flags, memo
 };
 
+/// https://lightning.engineering/api-docs/api/lnd/lightning/subscribe-channel-events
+pub const ChannelEventUpdate = struct {
+    // OPEN_CHANNEL, CLOSED_CHANNEL, ACTIVE_CHANNEL, INACTIVE_CHANNEL,
+    // PENDING_OPEN_CHANNEL, FULLY_RESOLVED_CHANNEL
+    type: []const u8,
+};
+
+/// https://lightning.engineering/api-docs/api/lnd/router/subscribe-htlc-events
+pub const HtlcEvent = struct {
+    incoming_channel_id: u64 = 0,
+    outgoing_channel_id: u64 = 0,
+    incoming_htlc_id: u64 = 0,
+    outgoing_htlc_id: u64 = 0,
+    timestamp_ns: u64 = 0,
+    event_type: []const u8 = "UNKNOWN", // SEND, RECEIVE, FORWARD
+    // one of the following is set
+    forward_event: ?struct { info: Info = .{} } = null,
+    forward_fail_event: ?struct {} = null,
+    settle_event: ?struct {} = null,
+    link_fail_event: ?struct {
+        info: Info = .{},
+        wire_failure: []const u8 = "", // FEE_INSUFFICIENT, UNKNOWN_NEXT_PEER, ...
+        failure_detail: []const u8 = "", // INSUFFICIENT_BALANCE, ...
+    } = null,
+    subscribed_event: ?struct {} = null, // first on the stream
+    // final_htlc_event
+
+    pub const Info = struct {
+        incoming_amt_msat: u64 = 0,
+        outgoing_amt_msat: u64 = 0,
+    };
+};
+
+/// a node of the describegraph response; see Client.GraphReader.
+/// https://lightning.engineering/api-docs/api/lnd/lightning/describe-graph
+pub const GraphNode = struct {
+    pub_key: types.PubKey,
+};
+
+/// a channel of the describegraph response; routing policies are skipped.
+pub const GraphEdge = struct {
+    channel_id: u64,
+    node1_pub: types.PubKey,
+    node2_pub: types.PubKey,
+    capacity: u64 = 0, // satoshis
+};
+
+/// https://lightning.engineering/api-docs/api/lnd/lightning/subscribe-channel-graph
+pub const GraphTopologyUpdate = struct {
+    node_updates: []struct { identity_key: types.PubKey } = &.{},
+    channel_updates: []struct {
+        chan_id: u64,
+        capacity: u64 = 0, // satoshis
+        advertising_node: types.PubKey,
+        connecting_node: types.PubKey,
+    } = &.{},
+    closed_chans: []struct { chan_id: u64 } = &.{},
+};
+
+/// https://lightning.engineering/api-docs/api/lnd/lightning/export-all-channel-backups
+pub const ChanBackupSnapshot = struct {
+    multi_chan_backup: struct {
+        chan_points: []struct { output_index: u32 = 0 } = &.{}, // channels in the backup
+        /// base64 of the encrypted packed backup, the content of lnd channel.backup.
+        multi_chan_backup: []const u8 = "",
+    } = .{},
+    // single_chan_backups
+};
+
+/// https://lightning.engineering/api-docs/api/lnd/lightning/subscribe-invoices
+pub const Invoice = struct {
+    memo: []const u8 = "",
+    value: i64 = 0, // in satoshis
+    amt_paid_sat: i64 = 0,
+    amt_paid_msat: i64 = 0,
+    state: []const u8, // OPEN, SETTLED, CANCELED, ACCEPTED
+    add_index: u64 = 0, // increases with each new invoice
+    settle_index: u64 = 0, // increases with each settled invoice; 0 if unsettled
+    settle_date: i64 = 0, // unix time, seconds
+};
+
+/// a page of invoices in add_index order.
+pub const InvoiceList = struct {
+    invoices: []Invoice = &.{},
+    /// add_index of the last invoice in the page; index_offset of the next one.
+    last_index_offset: u64 = 0,
+};
+
+/// a page of outgoing payments in payment_index order.
+pub const PaymentList = struct {
+    payments: []struct {
+        payment_hash: []const u8, // hex
+        value_msat: i64 = 0,
+        fee_msat: i64 = 0,
+        creation_time_ns: i64 = 0,
+        status: []const u8, // UNKNOWN, IN_FLIGHT, SUCCEEDED, FAILED, INITIATED
+        payment_index: u64 = 0, // increases with each new payment
+    } = &.{},
+    /// payment_index of the last payment in the page; index_offset of the next one.
+    last_index_offset: u64 = 0,
+};
+
+/// on-chain wallet transactions of a block height range, in no particular order.
+pub const TransactionList = struct {
+    transactions: []struct {
+        tx_hash: []const u8, // hex, in block explorers byte order
+        amount: i64 = 0, // satoshis; negative if the wallet funds were spent
+        num_confirmations: i32 = 0,
+        block_height: i32 = 0, // 0 while unconfirmed
+        time_stamp: i64 = 0, // unix seconds the tx was first seen
+        total_fees: i64 = 0, // satoshis; 0 unless the wallet paid them
+        label: []const u8 = "",
+    } = &.{},
+};
+
+/// on-chain wallet unspent outputs, in no particular order.
+pub const UtxoList = struct {
+    utxos: []struct {
+        address: []const u8 = "",
+        amount_sat: i64 = 0,
+        outpoint: struct {
+            txid_str: []const u8 = "", // hex, in block explorers byte order
+            output_index: u32 = 0,
+        } = .{},
+        confirmations: i64 = 0, // 0 while unconfirmed
+    } = &.{},
+};
+
+/// https://lightning.engineering/api-docs/api/lnd/lightning/list-peers
+pub const PeersList = struct {
+    peers: []Peer = &.{},
+
+    pub const Peer = struct {
+        pub_key: []const u8, // hex
+        address: []const u8, // host:port
+        bytes_sent: u64, // since the connection opened
+        bytes_recv: u64,
+        inbound: bool = false,
+        ping_time: i64 = 0, // last ping round trip, microseconds
+    };
+};
+
 /// on-chain balance, in satoshis.
 pub const WalletBalance = struct {
     total_balance: i64,
@@ -440,3 +1205,145 @@ pub const GeneratedSeed = struct {
 pub const InitedWallet = struct {
     admin_macaroon: []const u8, // base64?
 };
+
+test "parseStreamEvent" {
+    const t = std.testing;
+
+    const ev = try Client.parseStreamEvent(ChannelEventUpdate, t.allocator,
+        \\{"result":{"type":"ACTIVE_CHANNEL","active_channel":{"funding_txid_str":"ab","output_index":1}}}
+    );
+    defer ev.deinit();
+    try t.expectEqualStrings("ACTIVE_CHANNEL", ev.value.type);
+
+    const inv = try Client.parseStreamEvent(Invoice, t.allocator,
+        \\{"result":{"memo":"coffee","value":"2100","amt_paid_sat":"2100","state":"SETTLED"}}
+    );
+    defer inv.deinit();
+    try t.expectEqual(@as(i64, 2100), inv.value.amt_paid_sat);
+    try t.expectEqualStrings("SETTLED", inv.value.state);
+
+    const htlc = try Client.parseStreamEvent(HtlcEvent, t.allocator,
+        \\{"result":{"incoming_channel_id":"873000000000000001","outgoing_channel_id":"873000000000000002",
+        \\"incoming_htlc_id":"12","outgoing_htlc_id":"4","timestamp_ns":"1700000000000000000","event_type":"FORWARD",
+        \\"forward_event":{"info":{"incoming_timelock":800100,"outgoing_timelock":800060,
+        \\"incoming_amt_msat":"100500","outgoing_amt_msat":"100000"}}}}
+    );
+    defer htlc.deinit();
+    try t.expectEqual(@as(u64, 873000000000000001), htlc.value.incoming_channel_id);
+    try t.expectEqual(@as(u64, 12), htlc.value.incoming_htlc_id);
+    try t.expectEqual(@as(u64, 100500), htlc.value.forward_event.?.info.incoming_amt_msat);
+    try t.expect(htlc.value.link_fail_event == null);
+
+    try t.expectError(error.LndStreamError, Client.parseStreamEvent(Invoice, t.allocator,
+        \\{"error":{"code":2,"message":"permission denied"}}
+    ));
+}
+
+test "parse gettransactions" {
+    const t = std.testing;
+
+    var client = try Client.init(.{ .allocator = t.allocator, .tlscert_path = "", .plain_http = true });
+    defer client.deinit();
+    const res = try client.parseResponse(.gettransactions,
+        \\{"transactions":[{"tx_hash":"ab01","amount":"-21000","num_confirmations":3,"block_hash":"00","block_height":800001,
+        \\"time_stamp":"1700000000","total_fees":"210","dest_addresses":["bc1q"],"raw_tx_hex":"02","label":"open channel"},
+        \\{"tx_hash":"cd02","amount":"5000","num_confirmations":0,"block_height":0,"time_stamp":"1700000600","total_fees":"0"}]}
+    );
+    defer res.deinit();
+    const txs = res.value.transactions;
+    try t.expectEqual(@as(usize, 2), txs.len);
+    try t.expectEqualStrings("ab01", txs[0].tx_hash);
+    try t.expectEqual(@as(i64, -21000), txs[0].amount);
+    try t.expectEqual(@as(i32, 800001), txs[0].block_height);
+    try t.expectEqual(@as(i64, 210), txs[0].total_fees);
+    try t.expectEqualStrings("open channel", txs[0].label);
+    try t.expectEqual(@as(i32, 0), txs[1].block_height);
+    try t.expectEqualStrings("", txs[1].label);
+}
+
+test "parse getchaninfo" {
+    const t = std.testing;
+
+    var client = try Client.init(.{ .allocator = t.allocator, .tlscert_path = "", .plain_http = true });
+    defer client.deinit();
+    const res = try client.parseResponse(.getchaninfo,
+        \\{"channel_id":"870000001234567890","chan_point":"ab01:1","last_update":1700000000,"node1_pub":"02aa","node2_pub":"03bb",
+        \\"capacity":"5000000","node1_policy":{"time_lock_delta":80,"min_htlc":"1000","fee_base_msat":"1000","fee_rate_milli_msat":"250",
+        \\"disabled":false,"max_htlc_msat":"4950000000","last_update":1700000000},"node2_policy":null,"custom_records":{}}
+    );
+    defer res.deinit();
+    const edge = res.value;
+    try t.expectEqual(@as(u64, 870000001234567890), edge.channel_id);
+    try t.expectEqualStrings("03bb", edge.node2_pub);
+    try t.expectEqual(@as(i64, 5000000), edge.capacity);
+    const policy = edge.node1_policy.?;
+    try t.expectEqual(@as(u32, 80), policy.time_lock_delta);
+    try t.expectEqual(@as(i64, 250), policy.fee_rate_milli_msat);
+    try t.expectEqual(@as(u64, 4950000000), policy.max_htlc_msat);
+    try t.expect(edge.node2_policy == null);
+}
+
+test "parse listunspent" {
+    const t = std.testing;
+
+    var client = try Client.init(.{ .allocator = t.allocator, .tlscert_path = "", .plain_http = true });
+    defer client.deinit();
+    const res = try client.parseResponse(.listunspent,
+        \\{"utxos":[{"address_type":"TAPROOT_PUBKEY","address":"bc1p","amount_sat":"150000","pk_script":"5120",
+        \\"outpoint":{"txid_bytes":"q83v","txid_str":"ab01","output_index":1},"confirmations":"12"},
+        \\{"address":"bc1q","amount_sat":"2000","outpoint":{"txid_str":"cd02"}}]}
+    );
+    defer res.deinit();
+    const utxos = res.value.utxos;
+    try t.expectEqual(@as(usize, 2), utxos.len);
+    try t.expectEqualStrings("bc1p", utxos[0].address);
+    try t.expectEqual(@as(i64, 150000), utxos[0].amount_sat);
+    try t.expectEqualStrings("ab01", utxos[0].outpoint.txid_str);
+    try t.expectEqual(@as(u32, 1), utxos[0].outpoint.output_index);
+    try t.expectEqual(@as(i64, 12), utxos[0].confirmations);
+    try t.expectEqual(@as(u32, 0), utxos[1].outpoint.output_index);
+    try t.expectEqual(@as(i64, 0), utxos[1].confirmations);
+}
+
+test "mock server call" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    const srv = try tt.MockRpcServer.start(t.allocator, .lnd);
+    defer srv.stop();
+    srv.knobs.size.store(3, .monotonic);
+    var client = try Client.init(.{
+        .allocator = t.allocator,
+        .hostname = "127.0.0.1",
+        .port = srv.port(),
+        .tlscert_path = "",
+        .plain_http = true,
+    });
+    defer client.deinit();
+    client.macaroon.readonly = try t.allocator.dupe(u8, "0201"); // not checked by the mock
+
+    const res = client.callGroup(&.{ .getinfo, .listchannels }, .{ {}, .{ .peer_alias_lookup = false } });
+    defer Client.deinitGroup(res);
+    try t.expectEqual(@as(u32, 800000), (try res[0]).value.block_height);
+    try t.expectEqual(@as(usize, 3), (try res[1]).value.channels.len);
+
+    const graph = try client.describeGraph();
+    defer graph.deinit();
+    var nodes: usize = 0;
+    var edges: usize = 0;
+    var capacity: u64 = 0;
+    while (try graph.next()) |item| switch (item) {
+        .node => nodes += 1,
+        .edge => |e| {
+            edges += 1;
+            capacity += e.capacity;
+        },
+    };
+    try t.expectEqual(@as(usize, 4), nodes);
+    try t.expectEqual(@as(usize, 5), edges);
+    try t.expectEqual(@as(u64, 3 * 1000000 + 2 * 5000000), capacity);
+
+    srv.knobs.fault.store(.http_500, .monotonic);
+    srv.knobs.fail_every.store(1, .monotonic);
+    try t.expectError(Error.LndHttpBadStatusCode, client.call(.walletbalance, {}));
+}
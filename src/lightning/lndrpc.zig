@@ -0,0 +1,700 @@
+//! lnd lightning gRPC client: the same API as lndhttp.Client, with the same
+//! result types, talking to the native lnd RPC port instead of the REST proxy.
+//! lnd serves REST through a gateway which transcodes each call to JSON and
+//! back; the native port skips that, and a single HTTP/2 connection carries
+//! all calls and subscriptions at once.
+//!
+//! messages are decoded with comptime descriptors in place of generated code;
+//! see protobuf.zig. the descriptors below cover only the fields of the
+//! result types.
+//!
+//! zig 0.12 TLS client negotiates no ALPN. lnd built with grpc-go 1.67 or
+//! later rejects such TLS handshakes unless GRPC_ENFORCE_ALPN_ENABLED=false
+//! is set in its environment; cleartext HTTP/2 is unaffected.
+
+const std = @import("std");
+const base64enc = std.base64.standard.Encoder;
+
+const http2 = @import("http2.zig");
+const lndhttp = @import("lndhttp.zig");
+const protobuf = @import("protobuf.zig");
+const types = @import("../types.zig");
+
+/// safe for concurrent use as long as Client.allocator is.
+pub const Client = struct {
+    allocator: std.mem.Allocator,
+    hostname: []const u8,
+    port: u16,
+    ca: ?std.crypto.Certificate.Bundle, // null for cleartext HTTP/2
+    macaroon: struct {
+        readonly: ?[]const u8, // hex
+        admin: ?[]const u8,
+    },
+    observer: ?Observer = null,
+    arena_pool: ?*types.ArenaPool = null, // see InitOpt
+
+    mu: std.Thread.Mutex = .{},
+    conn: ?*http2.Conn = null, // reconnected on failure; guarded by mu
+
+    pub const ApiMethod = lndhttp.Client.ApiMethod;
+    pub const StreamMethod = lndhttp.Client.StreamMethod;
+    pub const MethodArgs = lndhttp.Client.MethodArgs;
+    pub const ResultValue = lndhttp.Client.ResultValue;
+    pub const Result = lndhttp.Client.Result;
+    pub const StreamEvent = lndhttp.Client.StreamEvent;
+    pub const Observer = lndhttp.Client.Observer;
+    pub const GroupResult = lndhttp.Client.GroupResult;
+    pub const GroupArgs = lndhttp.Client.GroupArgs;
+    pub const deinitGroup = lndhttp.Client.deinitGroup;
+
+    pub const Error = error{
+        LndRpcMissingMacaroon,
+        LndRpcBadStatusCode, // HTTP status other than 200
+        LndRpcStatus, // gRPC status other than OK
+        LndRpcBadResponse,
+        LndRpcMessageTooLarge,
+    };
+
+    /// max size of a single response message. lnd default is 200MiB; enough
+    /// for listchannels of a few thousand channels.
+    const max_message_size = 32 * 1024 * 1024;
+
+    pub const InitOpt = struct {
+        allocator: std.mem.Allocator,
+        hostname: []const u8 = "localhost", // must be present in tlscert_path SANs
+        port: u16 = 10009, // gRPC port
+        tlscert_path: []const u8, // must contain the hostname in SANs
+        macaroon_ro_path: ?[]const u8 = null, // readonly macaroon path
+        macaroon_admin_path: ?[]const u8 = null, // required only for requests mutating lnd state
+        /// talk HTTP/2 without TLS, ignoring tlscert_path; only for tests with a mock server.
+        plain_http: bool = false,
+        observer: ?Observer = null,
+        /// call results take their arenas from the pool, if set.
+        /// the pool must outlive the results.
+        arena_pool: ?*types.ArenaPool = null,
+    };
+
+    /// opt slices are dup'ed and need not be kept alive. connects lazily,
+    /// at the first call. must deinit when done.
+    pub fn init(opt: InitOpt) !Client {
+        var ca: ?std.crypto.Certificate.Bundle = null;
+        if (!opt.plain_http) {
+            ca = .{};
+            try ca.?.addCertsFromFilePathAbsolute(opt.allocator, opt.tlscert_path);
+        }
+        errdefer if (ca) |*b| b.deinit(opt.allocator);
+        const mac_ro: ?[]const u8 = if (opt.macaroon_ro_path) |p| try lndhttp.Client.readMacaroonOrNull(opt.allocator, p) else null;
+        errdefer if (mac_ro) |v| opt.allocator.free(v);
+        const mac_admin: ?[]const u8 = if (opt.macaroon_admin_path) |p| try lndhttp.Client.readMacaroonOrNull(opt.allocator, p) else null;
+        errdefer if (mac_admin) |v| opt.allocator.free(v);
+        return .{
+            .allocator = opt.allocator,
+            .hostname = try opt.allocator.dupe(u8, opt.hostname),
+            .port = opt.port,
+            .ca = ca,
+            .macaroon = .{ .readonly = mac_ro, .admin = mac_admin },
+            .observer = opt.observer,
+            .arena_pool = opt.arena_pool,
+        };
+    }
+
+    /// closes the connection. calls and subscriptions must be done.
+    pub fn deinit(self: *Client) void {
+        if (self.conn) |c| c.release();
+        if (self.ca) |*b| b.deinit(self.allocator);
+        self.allocator.free(self.hostname);
+        if (self.macaroon.readonly) |ro| self.allocator.free(ro);
+        if (self.macaroon.admin) |a| self.allocator.free(a);
+    }
+
+    /// an open subscription to a streaming method; see subscribe.
+    pub fn Stream(comptime m: StreamMethod) type {
+        return struct {
+            allocator: std.mem.Allocator,
+            st: *http2.Stream,
+
+            const Self = @This();
+
+            /// blocks until the next event is received, and returns null when
+            /// the server ends the stream.
+            /// the returned value must be deinit'ed when done.
+            pub fn next(self: *Self) !?types.Deinitable(StreamEvent(m)) {
+                const msg = try readMessage(self.allocator, self.st) orelse {
+                    try self.st.waitEnd();
+                    try checkStatus(self.st);
+                    return null;
+                };
+                defer self.allocator.free(msg);
+                var res = try types.Deinitable(StreamEvent(m)).init(self.allocator);
+                errdefer res.deinit();
+                res.value = try protobuf.decode(StreamEvent(m), @field(descriptors, @tagName(m)), res.arena.allocator(), msg);
+                if (m == .subscribechanbackups) { // base64 as in lndhttp
+                    const b = &res.value.multi_chan_backup.multi_chan_backup;
+                    b.* = try base64Alloc(res.arena.allocator(), b.*);
+                }
+                return res;
+            }
+
+            /// unblocks next from another thread, making it fail.
+            /// the stream must still be deinit'ed.
+            pub fn cancel(self: *Self) void {
+                self.st.cancel();
+            }
+
+            pub fn deinit(self: *Self) void {
+                self.st.close();
+                self.allocator.destroy(self);
+            }
+        };
+    }
+
+    pub fn call(self: *Client, comptime apimethod: ApiMethod, args: MethodArgs(apimethod)) !Result(apimethod) {
+        const start = std.time.nanoTimestamp();
+        const res = self.callUnobserved(apimethod, args);
+        if (self.observer) |o| {
+            o.func(o.ctx, apimethod, std.math.lossyCast(u64, std.time.nanoTimestamp() - start), !std.meta.isError(res));
+        }
+        return res;
+    }
+
+    fn callUnobserved(self: *Client, comptime apimethod: ApiMethod, args: MethodArgs(apimethod)) !Result(apimethod) {
+        // requests are encoded on the stack, as in lndhttp.
+        var reqalloc = std.heap.stackFallback(4096, self.allocator);
+        var req = std.ArrayList(u8).init(reqalloc.get());
+        defer req.deinit();
+        try req.appendNTimes(0, 5); // message prefix: uncompressed, length
+        try encodeRequest(req.writer(), apimethod, args);
+        std.mem.writeInt(u32, req.items[1..5], @intCast(req.items.len - 5), .big);
+
+        const mac = switch (apimethod) {
+            .genseed, .walletstatus, .initwallet, .unlockwallet => null,
+            else => self.macaroon.readonly orelse return Error.LndRpcMissingMacaroon,
+        };
+        const st = try self.openStream(rpcpath(apimethod), mac);
+        defer st.close();
+        try st.send(req.items, true);
+
+        const msg = try readMessage(self.allocator, st);
+        defer if (msg) |v| self.allocator.free(v);
+        try st.waitEnd();
+        try checkStatus(st);
+        const data = msg orelse return Error.LndRpcBadResponse;
+
+        var res = if (self.arena_pool) |pool|
+            try Result(apimethod).initPooled(pool)
+        else
+            try Result(apimethod).init(self.allocator);
+        errdefer res.deinit();
+        const arena = res.arena.allocator();
+        res.value = try protobuf.decode(ResultValue(apimethod), @field(descriptors, @tagName(apimethod)), arena, data);
+        // raw bytes on the wire; base64 as in lndhttp.
+        if (apimethod == .initwallet) {
+            res.value.admin_macaroon = try base64Alloc(arena, res.value.admin_macaroon);
+        }
+        if (apimethod == .exportchanbackups) {
+            const b = &res.value.multi_chan_backup.multi_chan_backup;
+            b.* = try base64Alloc(arena, b.*);
+        }
+        return res;
+    }
+
+    /// opens a subscription to the streaming method m.
+    /// the returned value must be deinit'ed when done.
+    pub fn subscribe(self: *Client, comptime m: StreamMethod) !*Stream(m) {
+        const mac = self.macaroon.readonly orelse return Error.LndRpcMissingMacaroon;
+        const sub = try self.allocator.create(Stream(m));
+        errdefer self.allocator.destroy(sub);
+        const st = try self.openStream(switch (m) {
+            .subscribechannelevents => "/lnrpc.Lightning/SubscribeChannelEvents",
+            .subscribeinvoices => "/lnrpc.Lightning/SubscribeInvoices",
+            .subscribechanbackups => "/lnrpc.Lightning/SubscribeChannelBackups",
+        }, mac);
+        errdefer st.close();
+        try st.send(&[_]u8{0} ** 5, true); // an empty request message
+        sub.* = .{ .allocator = self.allocator, .st = st };
+        return sub;
+    }
+
+    /// calls all methods concurrently, each in a separate thread except the first
+    /// one which runs in the calling thread, and waits for all of them to complete.
+    /// the calls share a single connection. see lndhttp.Client.callGroup.
+    pub fn callGroup(self: *Client, comptime methods: []const ApiMethod, args: GroupArgs(methods)) GroupResult(methods) {
+        var res: GroupResult(methods) = undefined;
+        var threads = [_]?std.Thread{null} ** methods.len;
+        inline for (methods[1..], 1..) |m, i| {
+            threads[i] = std.Thread.spawn(.{}, GroupWorker(m).run, .{ self, args[i], &res[i] }) catch null;
+        }
+        res[0] = self.call(methods[0], args[0]);
+        inline for (methods[1..], 1..) |m, i| {
+            if (threads[i]) |th| {
+                th.join();
+            } else {
+                res[i] = self.call(m, args[i]);
+            }
+        }
+        return res;
+    }
+
+    fn GroupWorker(comptime m: ApiMethod) type {
+        return struct {
+            fn run(client: *Client, args: MethodArgs(m), out: *anyerror!Result(m)) void {
+                out.* = client.call(m, args);
+            }
+        };
+    }
+
+    /// opens a request stream on the current connection, connecting anew
+    /// if there's none or it failed.
+    fn openStream(self: *Client, path: []const u8, macaroon: ?[]const u8) !*http2.Stream {
+        const conn = try self.connection();
+        defer conn.release();
+        var hdrs = [_]http2.Header{
+            .{ .name = "content-type", .value = "application/grpc" },
+            .{ .name = "te", .value = "trailers" },
+            .{ .name = "macaroon", .value = "" },
+        };
+        var n: usize = 2;
+        if (macaroon) |v| {
+            hdrs[2].value = v;
+            n = 3;
+        }
+        return conn.openStream(path, hdrs[0..n]);
+    }
+
+    /// returns the current connection with a reference callers must release.
+    fn connection(self: *Client) !*http2.Conn {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.conn) |c| {
+            if (!c.failed()) {
+                c.ref();
+                return c;
+            }
+            c.release();
+            self.conn = null;
+        }
+        const c = try http2.Conn.connect(self.allocator, .{ .host = self.hostname, .port = self.port, .ca = self.ca });
+        self.conn = c;
+        c.ref();
+        return c;
+    }
+
+    fn rpcpath(comptime m: ApiMethod) []const u8 {
+        return switch (m) {
+            .exportchanbackups => "/lnrpc.Lightning/ExportAllChannelBackups",
+            .feereport => "/lnrpc.Lightning/FeeReport",
+            .fwdinghistory => "/lnrpc.Lightning/ForwardingHistory",
+            .genseed => "/lnrpc.WalletUnlocker/GenSeed",
+            .getchaninfo => "/lnrpc.Lightning/GetChanInfo",
+            .getinfo => "/lnrpc.Lightning/GetInfo",
+            .getnetworkinfo => "/lnrpc.Lightning/GetNetworkInfo",
+            .getnodeinfo => "/lnrpc.Lightning/GetNodeInfo",
+            .gettransactions => "/lnrpc.Lightning/GetTransactions",
+            .initwallet => "/lnrpc.WalletUnlocker/InitWallet",
+            .listchannels => "/lnrpc.Lightning/ListChannels",
+            .listinvoices => "/lnrpc.Lightning/ListInvoices",
+            .listpeers => "/lnrpc.Lightning/ListPeers",
+            .listpayments => "/lnrpc.Lightning/ListPayments",
+            .listunspent => "/walletrpc.WalletKit/ListUnspent",
+            .pendingchannels => "/lnrpc.Lightning/PendingChannels",
+            .unlockwallet => "/lnrpc.WalletUnlocker/UnlockWallet",
+            .walletbalance => "/lnrpc.Lightning/WalletBalance",
+            .walletstatus => "/lnrpc.State/GetState",
+        };
+    }
+
+    /// writes the request message of m, without the gRPC message prefix.
+    fn encodeRequest(w: anytype, comptime m: ApiMethod, args: MethodArgs(m)) !void {
+        switch (m) {
+            .initwallet => try protobuf.encode(w, .{ .wallet_password = 1, .cipher_seed_mnemonic = 2, .aezeed_passphrase = 3 }, .{
+                .wallet_password = args.unlock_password,
+                .cipher_seed_mnemonic = args.mnemonic,
+                .aezeed_passphrase = args.passphrase,
+            }),
+            .unlockwallet => try protobuf.encode(w, .{ .wallet_password = 1 }, .{ .wallet_password = args.unlock_password }),
+            .getnodeinfo => {
+                for (args.pubkey) |c| if (!std.ascii.isHex(c)) return error.InvalidPubkey;
+                try protobuf.encode(w, .{ .pub_key = 1, .include_channels = 2 }, .{
+                    .pub_key = args.pubkey,
+                    .include_channels = args.include_channels,
+                });
+            },
+            .listchannels => {
+                var peer: [33]u8 = undefined;
+                const peer_bytes: []const u8 = if (args.peer) |hex|
+                    std.fmt.hexToBytes(&peer, hex) catch return error.InvalidPubkey
+                else
+                    &.{};
+                try protobuf.encode(w, .{ .active_only = 1, .inactive_only = 2, .public_only = 3, .private_only = 4, .peer = 5, .peer_alias_lookup = 6 }, .{
+                    .active_only = args.status != null and args.status.? == .active,
+                    .inactive_only = args.status != null and args.status.? == .inactive,
+                    .public_only = args.advert != null and args.advert.? == .public,
+                    .private_only = args.advert != null and args.advert.? == .private,
+                    .peer = peer_bytes,
+                    .peer_alias_lookup = args.peer_alias_lookup,
+                });
+            },
+            .getchaninfo => try protobuf.encode(w, .{ .chan_id = 1 }, args),
+            .gettransactions => try protobuf.encode(w, .{ .start_height = 1, .end_height = 2 }, args),
+            .listunspent => try protobuf.encode(w, .{ .min_confs = 1, .max_confs = 2 }, args),
+            .listinvoices => try protobuf.encode(w, .{ .index_offset = 4, .num_max_invoices = 5 }, args),
+            .listpayments => try protobuf.encode(w, .{ .include_incomplete = 1, .index_offset = 2, .max_payments = 3 }, args),
+            .fwdinghistory => try protobuf.encode(w, .{ .start_time = 1, .end_time = 2, .index_offset = 3, .num_max_events = 4 }, args),
+            else => {}, // empty request messages
+        }
+    }
+};
+
+fn base64Alloc(arena: std.mem.Allocator, raw: []const u8) ![]const u8 {
+    return base64enc.encode(try arena.alloc(u8, base64enc.calcSize(raw.len)), raw);
+}
+
+/// reads a gRPC length-prefixed message; null if the response ended before any.
+/// callers own the returned value.
+fn readMessage(allocator: std.mem.Allocator, st: *http2.Stream) !?[]u8 {
+    const r = st.reader();
+    var prefix: [5]u8 = undefined;
+    const n = try r.readAll(&prefix);
+    if (n == 0) {
+        return null;
+    }
+    if (n < prefix.len or prefix[0] != 0) { // no compression is accepted
+        return Client.Error.LndRpcBadResponse;
+    }
+    const len = std.mem.readInt(u32, prefix[1..5], .big);
+    if (len > Client.max_message_size) {
+        return Client.Error.LndRpcMessageTooLarge;
+    }
+    const buf = try allocator.alloc(u8, len);
+    errdefer allocator.free(buf);
+    r.readNoEof(buf) catch |err| switch (err) {
+        error.EndOfStream => return Client.Error.LndRpcBadResponse,
+        else => |e| return e,
+    };
+    return buf;
+}
+
+/// checks the HTTP status and the gRPC status of a response ended with trailers,
+/// or of a trailers-only response.
+fn checkStatus(st: *http2.Stream) !void {
+    const status = st.header(":status") orelse return Client.Error.LndRpcBadResponse;
+    if (!std.mem.eql(u8, status, "200")) {
+        return Client.Error.LndRpcBadStatusCode;
+    }
+    const grpc = st.header("grpc-status") orelse return Client.Error.LndRpcBadResponse;
+    if (!std.mem.eql(u8, grpc, "0")) {
+        return Client.Error.LndRpcStatus;
+    }
+}
+
+/// protobuf message descriptors of the result types, by method name.
+/// field numbers are from lnd lnrpc/lightning.proto, walletunlocker.proto
+/// and stateservice.proto.
+const descriptors = struct {
+    const pending_channel = .{
+        .remote_node_pub = 1,
+        .channel_point = 2,
+        .capacity = 3,
+        .local_balance = 4,
+        .remote_balance = 5,
+        .private = 12,
+    };
+    const invoice = .{
+        .memo = 1,
+        .value = 5,
+        .settle_date = 8,
+        .add_index = 16,
+        .settle_index = 17,
+        .amt_paid_sat = 19,
+        .amt_paid_msat = 20,
+        .state = .{ 21, .{ "OPEN", "SETTLED", "CANCELED", "ACCEPTED" } },
+    };
+
+    const getinfo = .{
+        .version = 14,
+        .identity_pubkey = 1,
+        .alias = 2,
+        .color = 17,
+        .num_pending_channels = 3,
+        .num_active_channels = 4,
+        .num_inactive_channels = 15,
+        .num_peers = 5,
+        .block_height = 6,
+        .block_hash = 8,
+        .synced_to_chain = 9,
+        .synced_to_graph = 18,
+        .chains = .{ 16, .{ .chain = 1, .network = 2 } },
+        .uris = 12,
+    };
+    const getnetworkinfo = .{
+        .graph_diameter = 1,
+        .avg_out_degree = 2,
+        .max_out_degree = 3,
+        .num_nodes = 4,
+        .num_channels = 5,
+        .total_network_capacity = 6,
+        .avg_channel_size = 7,
+        .min_channel_size = 8,
+        .max_channel_size = 9,
+        .median_channel_size_sat = 10,
+        .num_zombie_chans = 11,
+    };
+    const getnodeinfo = .{
+        .node = .{ 1, .{ .last_update = 1, .pub_key = 2, .alias = 3, .color = 5 } },
+        .num_channels = 2,
+        .total_capacity = 3,
+    };
+    const routing_policy = .{
+        .time_lock_delta = 1,
+        .min_htlc = 2,
+        .fee_base_msat = 3,
+        .fee_rate_milli_msat = 4,
+        .disabled = 5,
+        .max_htlc_msat = 6,
+        .last_update = 7,
+    };
+    const getchaninfo = .{
+        .channel_id = 1,
+        .chan_point = 2,
+        .last_update = 3,
+        .node1_pub = 4,
+        .node2_pub = 5,
+        .capacity = 6,
+        .node1_policy = .{ 7, routing_policy },
+        .node2_policy = .{ 8, routing_policy },
+    };
+    const gettransactions = .{
+        .transactions = .{ 1, .{
+            .tx_hash = 1,
+            .amount = 2,
+            .num_confirmations = 3,
+            .block_height = 5,
+            .time_stamp = 6,
+            .total_fees = 7,
+            .label = 10,
+        } },
+    };
+    const listunspent = .{
+        .utxos = .{ 1, .{
+            .address = 2,
+            .amount_sat = 3,
+            .outpoint = .{ 5, .{ .txid_str = 2, .output_index = 3 } },
+            .confirmations = 6,
+        } },
+    };
+    const feereport = .{
+        .channel_fees = .{ 1, .{ .chan_id = 5, .channel_point = 1, .base_fee_msat = 2, .fee_per_mil = 3, .fee_rate = 4 } },
+        .day_fee_sum = 2,
+        .week_fee_sum = 3,
+        .month_fee_sum = 4,
+    };
+    const fwdinghistory = .{
+        .forwarding_events = .{ 1, .{
+            .timestamp_ns = 11,
+            .chan_id_in = 2,
+            .chan_id_out = 4,
+            .amt_in_msat = 9,
+            .amt_out_msat = 10,
+            .fee_msat = 8,
+        } },
+        .last_offset_index = 2,
+    };
+    const listchannels = .{
+        .channels = .{ 11, .{
+            .active = 1,
+            .remote_pubkey = 2,
+            .channel_point = 3,
+            .chan_id = 4,
+            .capacity = 5,
+            .local_balance = 6,
+            .remote_balance = 7,
+            .unsettled_balance = 11,
+            .total_satoshis_sent = 12,
+            .total_satoshis_received = 13,
+            .private = 17,
+            .initiator = 18,
+            .peer_alias = 34,
+        } },
+    };
+    const pendingchannels = .{
+        .total_limbo_balance = 1,
+        .pending_open_channels = .{ 2, .{ .channel = .{ 1, pending_channel }, .commit_fee = 4 } },
+        .pending_force_closing_channels = .{ 4, .{
+            .channel = .{ 1, pending_channel },
+            .closing_txid = 2,
+            .limbo_balance = 3,
+            .maturity_height = 4,
+            .blocks_til_maturity = 5,
+            .recovered_balance = 6,
+        } },
+        .waiting_close_channels = .{ 5, .{ .channel = .{ 1, pending_channel }, .limbo_balance = 2, .closing_txid = 4 } },
+    };
+    const listinvoices = .{
+        .invoices = .{ 1, invoice },
+        .last_index_offset = 2,
+    };
+    const listpeers = .{
+        .peers = .{ 1, .{
+            .pub_key = 1,
+            .address = 3,
+            .bytes_sent = 4,
+            .bytes_recv = 5,
+            .inbound = 8,
+            .ping_time = 9,
+        } },
+    };
+    const listpayments = .{
+        .payments = .{ 1, .{
+            .payment_hash = 1,
+            .value_msat = 8,
+            .fee_msat = 12,
+            .creation_time_ns = 13,
+            .status = .{ 10, .{ "UNKNOWN", "IN_FLIGHT", "SUCCEEDED", "FAILED", "INITIATED" } },
+            .payment_index = 15,
+        } },
+        .last_index_offset = 3,
+    };
+    const walletbalance = .{
+        .total_balance = 1,
+        .confirmed_balance = 2,
+        .unconfirmed_balance = 3,
+        .locked_balance = 5,
+        .reserved_balance_anchor_chan = 6,
+    };
+    const walletstatus = .{ .state = 1 };
+    const genseed = .{ .cipher_seed_mnemonic = 1 };
+    const initwallet = .{ .admin_macaroon = 1 };
+    const unlockwallet = .{};
+
+    const subscribechannelevents = .{
+        .type = .{ 5, .{
+            "OPEN_CHANNEL",
+            "CLOSED_CHANNEL",
+            "ACTIVE_CHANNEL",
+            "INACTIVE_CHANNEL",
+            "PENDING_OPEN_CHANNEL",
+            "FULLY_RESOLVED_CHANNEL",
+        } },
+    };
+    const subscribeinvoices = invoice;
+    const exportchanbackups = .{
+        .multi_chan_backup = .{ 2, .{ .chan_points = .{ 1, .{ .output_index = 3 } }, .multi_chan_backup = 2 } },
+    };
+    const subscribechanbackups = exportchanbackups;
+};
+
+test {
+    _ = http2;
+    _ = protobuf;
+}
+
+/// a minimal cleartext HTTP/2 gRPC server for a single connection: answers
+/// getinfo, and walletbalance with an error.
+fn testServe(srv: *std.net.Server) !void {
+    const t = std.testing;
+    const conn = try srv.accept();
+    defer conn.stream.close();
+    const r = conn.stream.reader();
+    const w = conn.stream.writer();
+
+    var preface: [24]u8 = undefined;
+    try r.readNoEof(&preface);
+    try t.expectEqualStrings("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", &preface);
+    try testWriteFrame(w, 4, 0, 0, ""); // settings
+
+    var dec = http2.Decoder.init(t.allocator);
+    defer dec.deinit();
+    var payload: [16384]u8 = undefined;
+    var path: [64]u8 = undefined;
+    var path_len: usize = 0;
+    while (true) {
+        var head: [9]u8 = undefined;
+        r.readNoEof(&head) catch |err| switch (err) {
+            error.EndOfStream => return, // client closed
+            else => return err,
+        };
+        const len = std.mem.readInt(u24, head[0..3], .big);
+        const p = payload[0..len];
+        try r.readNoEof(p);
+        const id = std.mem.readInt(u32, head[5..9], .big);
+        switch (head[3]) {
+            1 => { // headers
+                const hdrs = try dec.decode(t.allocator, p);
+                defer {
+                    http2.freeHeaders(t.allocator, hdrs);
+                    t.allocator.free(hdrs);
+                }
+                for (hdrs) |h| {
+                    if (std.mem.eql(u8, h.name, ":path")) {
+                        @memcpy(path[0..h.value.len], h.value);
+                        path_len = h.value.len;
+                    }
+                }
+            },
+            0 => if (head[4] & 1 != 0) { // data, end of stream
+                if (std.mem.eql(u8, path[0..path_len], "/lnrpc.Lightning/WalletBalance")) {
+                    // trailers-only: :status 200, grpc-status 12
+                    try testWriteFrame(w, 1, 0x5, id, "\x88\x00\x0bgrpc-status\x0212");
+                    continue;
+                }
+                // :status 200, content-type application/grpc
+                try testWriteFrame(w, 1, 0x4, id, "\x88\x00\x0ccontent-type\x10application/grpc");
+                var msg = std.ArrayList(u8).init(t.allocator);
+                defer msg.deinit();
+                try msg.appendNTimes(0, 5);
+                try protobuf.encode(msg.writer(), .{ .alias = 2, .block_height = 6, .synced_to_chain = 9 }, .{
+                    .alias = "testnode",
+                    .block_height = @as(u32, 800000),
+                    .synced_to_chain = true,
+                });
+                std.mem.writeInt(u32, msg.items[1..5], @intCast(msg.items.len - 5), .big);
+                try testWriteFrame(w, 0, 0, id, msg.items);
+                // trailers, grpc-status 0, with incremental indexing
+                try testWriteFrame(w, 1, 0x5, id, "\x40\x0bgrpc-status\x010");
+            },
+            else => {}, // settings, window updates and acks
+        }
+    }
+}
+
+fn testWriteFrame(w: anytype, ftype: u8, flags: u8, id: u32, payload: []const u8) !void {
+    var head: [9]u8 = undefined;
+    std.mem.writeInt(u24, head[0..3], @intCast(payload.len), .big);
+    head[3] = ftype;
+    head[4] = flags;
+    std.mem.writeInt(u32, head[5..9], id, .big);
+    try w.writeAll(&head);
+    try w.writeAll(payload);
+}
+
+test "grpc call" {
+    const t = std.testing;
+
+    var srv = try (try std.net.Address.parseIp("127.0.0.1", 0)).listen(.{ .reuse_address = true });
+    defer srv.deinit();
+    const th = try std.Thread.spawn(.{}, testServe, .{&srv});
+    defer th.join();
+
+    var client = try Client.init(.{
+        .allocator = t.allocator,
+        .hostname = "127.0.0.1",
+        .port = srv.listen_address.getPort(),
+        .tlscert_path = "",
+        .plain_http = true,
+    });
+    defer client.deinit();
+    try t.expectError(Client.Error.LndRpcMissingMacaroon, client.call(.getinfo, {}));
+    client.macaroon.readonly = try t.allocator.dupe(u8, "0201"); // not checked by the server
+
+    const res = client.callGroup(&.{ .getinfo, .getinfo }, .{ {}, {} });
+    defer Client.deinitGroup(res);
+    inline for (res) |r| {
+        const info = (try r).value;
+        try t.expectEqualStrings("testnode", info.alias);
+        try t.expectEqual(@as(u32, 800000), info.block_height);
+        try t.expect(info.synced_to_chain);
+        try t.expect(!info.synced_to_graph);
+        try t.expectEqual(@as(usize, 0), info.chains.len);
+    }
+    try t.expectError(Client.Error.LndRpcStatus, client.call(.walletbalance, {}));
+}
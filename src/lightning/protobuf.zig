@@ -0,0 +1,438 @@
+//! protobuf wire format codec for zig structs, driven by comptime message
+//! descriptors instead of generated code: a descriptor maps zig field names
+//! to protobuf field numbers, and the decoder is unrolled from it at comptime.
+//!
+//! a descriptor is a struct literal, each field value either a protobuf field
+//! number, or a tuple of the number and a nested descriptor for message
+//! fields, or the value names of a protobuf enum decoded into a string:
+//!
+//!     .{ .alias = 2, .state = .{ 21, .{ "OPEN", "SETTLED" } }, .chains = .{ 16, .{ .chain = 1 } } }
+//!
+//! zig fields missing from a descriptor keep their defaults, and protobuf
+//! fields missing from it are skipped. proto3 omits default values on the
+//! wire, so a field absent from a message is its default, zero or empty value,
+//! or the first value name of an enum.
+//!
+//! zig fields decode by their type, whatever the protobuf type:
+//!   - integers and bools from varints; negative proto int32 and int64 alike
+//!   - floats from fixed32 and fixed64, such as a proto double into f32
+//!   - strings from strings or bytes, and from varints as decimal numbers
+//!     or enum value names
+//!   - types with a parse function, such as types.PubKey, from strings
+//!   - structs from nested messages, and slices from repeated fields
+//!   - zig enums from proto enums by value
+
+const std = @import("std");
+
+pub const Error = error{
+    ProtobufTruncated,
+    ProtobufVarint,
+    ProtobufWireType,
+    ProtobufOverflow,
+    ProtobufInvalidValue,
+} || std.mem.Allocator.Error;
+
+pub const WireType = enum(u3) {
+    varint = 0,
+    fixed64 = 1,
+    len = 2,
+    fixed32 = 5,
+    _,
+};
+
+/// decodes a message into T as described by desc. all slices of the result
+/// are allocated with arena, including strings: data needs not outlive it.
+pub fn decode(comptime T: type, comptime desc: anytype, arena: std.mem.Allocator, data: []const u8) Error!T {
+    const fields = std.meta.fields(T);
+    var res = defaultValue(T, desc);
+
+    // repeated fields are counted first, so that each slice is allocated once.
+    var counts = [_]usize{0} ** fields.len;
+    var r = Reader{ .data = data };
+    while (r.more()) {
+        const key = try r.key();
+        inline for (fields, 0..) |f, i| {
+            if (comptime isRepeated(f.type) and @hasField(@TypeOf(desc), f.name)) {
+                if (key.num == comptime fieldNumber(@field(desc, f.name))) {
+                    counts[i] += 1;
+                }
+            }
+        }
+        try r.skip(key.wt);
+    }
+    inline for (fields, 0..) |f, i| {
+        if (comptime isRepeated(f.type) and @hasField(@TypeOf(desc), f.name)) {
+            if (counts[i] > 0) {
+                @field(res, f.name) = try arena.alloc(std.meta.Child(f.type), counts[i]);
+            }
+            counts[i] = 0; // the position of the next item from now on
+        }
+    }
+
+    r = .{ .data = data };
+    while (r.more()) {
+        const key = try r.key();
+        var known = false;
+        inline for (fields, 0..) |f, i| {
+            if (comptime @hasField(@TypeOf(desc), f.name)) {
+                const entry = @field(desc, f.name);
+                if (key.num == comptime fieldNumber(entry)) {
+                    known = true;
+                    if (comptime isRepeated(f.type)) {
+                        const v = try decodeValue(std.meta.Child(f.type), fieldSub(entry), arena, &r, key.wt);
+                        @constCast(@field(res, f.name))[counts[i]] = v;
+                        counts[i] += 1;
+                    } else {
+                        @field(res, f.name) = try decodeValue(f.type, fieldSub(entry), arena, &r, key.wt);
+                    }
+                }
+            }
+        }
+        if (!known) {
+            try r.skip(key.wt);
+        }
+    }
+    return res;
+}
+
+/// encodes the fields of v described by desc as a message. proto3 default
+/// values, zero and empty, are omitted.
+/// only scalars, strings and repeated strings are supported: enough for requests.
+pub fn encode(w: anytype, comptime desc: anytype, v: anytype) !void {
+    inline for (std.meta.fields(@TypeOf(v))) |f| {
+        if (comptime @hasField(@TypeOf(desc), f.name)) {
+            try encodeField(w, comptime fieldNumber(@field(desc, f.name)), @field(v, f.name));
+        }
+    }
+}
+
+fn encodeField(w: anytype, comptime num: u32, value: anytype) !void {
+    const V = @TypeOf(value);
+    switch (@typeInfo(V)) {
+        .Bool => if (value) {
+            try writeKey(w, num, .varint);
+            try writeVarint(w, 1);
+        },
+        .Int => |info| if (value != 0) {
+            try writeKey(w, num, .varint);
+            // negative values are sign-extended to 64 bits, as for proto int64.
+            const u: u64 = if (info.signedness == .signed) @bitCast(@as(i64, value)) else value;
+            try writeVarint(w, u);
+        },
+        .Optional => if (value) |x| try encodeField(w, num, x),
+        .Pointer => |info| {
+            if (info.size != .Slice) {
+                @compileError("protobuf: unsupported type " ++ @typeName(V));
+            }
+            if (info.child == u8) {
+                if (value.len > 0) {
+                    try writeKey(w, num, .len);
+                    try writeVarint(w, value.len);
+                    try w.writeAll(value);
+                }
+            } else for (value) |s| {
+                // repeated strings; empty items are kept.
+                try writeKey(w, num, .len);
+                try writeVarint(w, s.len);
+                try w.writeAll(s);
+            }
+        },
+        else => @compileError("protobuf: unsupported type " ++ @typeName(V)),
+    }
+}
+
+pub fn writeKey(w: anytype, num: u32, wt: WireType) !void {
+    try writeVarint(w, @as(u64, num) << 3 | @intFromEnum(wt));
+}
+
+pub fn writeVarint(w: anytype, v: u64) !void {
+    var x = v;
+    while (x >= 0x80) : (x >>= 7) {
+        try w.writeByte(@as(u8, @truncate(x)) | 0x80);
+    }
+    try w.writeByte(@truncate(x));
+}
+
+const Reader = struct {
+    data: []const u8,
+    pos: usize = 0,
+
+    const Key = struct { num: u64, wt: WireType };
+
+    fn more(self: Reader) bool {
+        return self.pos < self.data.len;
+    }
+
+    fn key(self: *Reader) Error!Key {
+        const k = try self.varint();
+        return .{ .num = k >> 3, .wt = @enumFromInt(@as(u3, @truncate(k))) };
+    }
+
+    fn varint(self: *Reader) Error!u64 {
+        var v: u64 = 0;
+        var shift: u32 = 0;
+        while (true) {
+            if (self.pos >= self.data.len) {
+                return Error.ProtobufTruncated;
+            }
+            const b = self.data[self.pos];
+            self.pos += 1;
+            if (shift == 63 and b > 1) {
+                return Error.ProtobufVarint;
+            }
+            v |= @as(u64, b & 0x7f) << @intCast(shift);
+            if (b & 0x80 == 0) {
+                return v;
+            }
+            shift += 7;
+            if (shift > 63) {
+                return Error.ProtobufVarint;
+            }
+        }
+    }
+
+    fn fixed(self: *Reader, comptime T: type) Error!T {
+        const n = @sizeOf(T);
+        if (self.data.len - self.pos < n) {
+            return Error.ProtobufTruncated;
+        }
+        defer self.pos += n;
+        return std.mem.readInt(T, self.data[self.pos..][0..n], .little);
+    }
+
+    fn bytes(self: *Reader) Error![]const u8 {
+        const n = try self.varint();
+        if (n > self.data.len - self.pos) {
+            return Error.ProtobufTruncated;
+        }
+        const len: usize = @intCast(n);
+        defer self.pos += len;
+        return self.data[self.pos..][0..len];
+    }
+
+    fn skip(self: *Reader, wt: WireType) Error!void {
+        switch (wt) {
+            .varint => _ = try self.varint(),
+            .fixed64 => _ = try self.fixed(u64),
+            .len => _ = try self.bytes(),
+            .fixed32 => _ = try self.fixed(u32),
+            _ => return Error.ProtobufWireType, // including deprecated groups
+        }
+    }
+};
+
+fn decodeValue(comptime F: type, comptime sub: anytype, arena: std.mem.Allocator, r: *Reader, wt: WireType) Error!F {
+    switch (@typeInfo(F)) {
+        .Bool => {
+            if (wt != .varint) return Error.ProtobufWireType;
+            return try r.varint() != 0;
+        },
+        .Int => |info| {
+            if (wt != .varint) return Error.ProtobufWireType;
+            const v = try r.varint();
+            if (info.signedness == .signed) {
+                return std.math.cast(F, @as(i64, @bitCast(v))) orelse Error.ProtobufOverflow;
+            }
+            return std.math.cast(F, v) orelse Error.ProtobufOverflow;
+        },
+        .Float => return switch (wt) {
+            .fixed64 => @floatCast(@as(f64, @bitCast(try r.fixed(u64)))),
+            .fixed32 => @floatCast(@as(f32, @bitCast(try r.fixed(u32)))),
+            else => Error.ProtobufWireType,
+        },
+        .Enum => {
+            if (wt != .varint) return Error.ProtobufWireType;
+            return std.meta.intToEnum(F, try r.varint()) catch Error.ProtobufInvalidValue;
+        },
+        .Optional => |info| return try decodeValue(info.child, sub, arena, r, wt),
+        .Struct => {
+            if (wt != .len) return Error.ProtobufWireType;
+            const b = try r.bytes();
+            if (comptime @hasDecl(F, "parse")) {
+                return F.parse(b) catch Error.ProtobufInvalidValue;
+            }
+            return decode(F, sub, arena, b);
+        },
+        .Pointer => |info| {
+            if (info.size != .Slice or info.child != u8) {
+                @compileError("protobuf: unsupported type " ++ @typeName(F));
+            }
+            switch (wt) {
+                .len => return arena.dupe(u8, try r.bytes()),
+                .varint => {
+                    const v = try r.varint();
+                    if (comptime @TypeOf(sub) != void) {
+                        inline for (sub, 0..) |name, i| {
+                            if (v == i) return name;
+                        }
+                        return Error.ProtobufInvalidValue;
+                    }
+                    return std.fmt.allocPrint(arena, "{d}", .{v});
+                },
+                else => return Error.ProtobufWireType,
+            }
+        },
+        else => @compileError("protobuf: unsupported type " ++ @typeName(F)),
+    }
+}
+
+fn isRepeated(comptime F: type) bool {
+    return switch (@typeInfo(F)) {
+        .Pointer => |info| info.size == .Slice and info.child != u8,
+        else => false,
+    };
+}
+
+fn fieldNumber(comptime entry: anytype) u64 {
+    return if (@TypeOf(entry) == comptime_int) entry else entry[0];
+}
+
+fn fieldSub(comptime entry: anytype) if (@TypeOf(entry) == comptime_int) void else @TypeOf(entry[1]) {
+    return if (@TypeOf(entry) == comptime_int) {} else entry[1];
+}
+
+/// T with the defaults of its fields, or zero values of their types,
+/// and enum strings set to the zero enum value name.
+fn defaultValue(comptime T: type, comptime desc: anytype) T {
+    var v: T = undefined;
+    inline for (std.meta.fields(T)) |f| {
+        if (f.default_value) |p| {
+            @field(v, f.name) = @as(*const f.type, @ptrCast(@alignCast(p))).*;
+        } else {
+            @field(v, f.name) = zeroValue(f.type);
+        }
+        if (comptime f.type == []const u8 and @hasField(@TypeOf(desc), f.name)) {
+            const entry = @field(desc, f.name);
+            if (@TypeOf(entry) != comptime_int) {
+                @field(v, f.name) = entry[1][0];
+            }
+        }
+    }
+    return v;
+}
+
+fn zeroValue(comptime F: type) F {
+    return switch (@typeInfo(F)) {
+        .Bool => false,
+        .Int, .Float => 0,
+        .Optional => null,
+        .Enum => @enumFromInt(0),
+        .Pointer => &.{},
+        .Struct => defaultValue(F, .{}),
+        .Array => std.mem.zeroes(F),
+        else => @compileError("protobuf: unsupported type " ++ @typeName(F)),
+    };
+}
+
+test "protobuf decode" {
+    const t = std.testing;
+    const types = @import("../types.zig");
+
+    const Msg = struct {
+        id: []const u8, // from uint64
+        height: u32,
+        delta: i32,
+        ratio: f32, // from double
+        ok: bool = true,
+        state: []const u8,
+        key: types.PubKey,
+        names: []const []const u8,
+        items: []struct {
+            val: i64,
+            tag: []const u8 = "none",
+        },
+        status: enum(u8) { a = 0, b = 1 },
+    };
+    const desc = .{
+        .id = 1,
+        .height = 2,
+        .delta = 3,
+        .ratio = 4,
+        .ok = 5,
+        .state = .{ 6, .{ "OPEN", "SETTLED" } },
+        .key = 7,
+        .names = 8,
+        .items = .{ 9, .{ .val = 1, .tag = 2 } },
+        .status = 10,
+    };
+
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    const w = buf.writer();
+    try writeKey(w, 99, .varint); // unknown; skipped
+    try writeVarint(w, 12345);
+    try writeKey(w, 1, .varint);
+    try writeVarint(w, 870000000000000000);
+    try writeKey(w, 2, .varint);
+    try writeVarint(w, 800000);
+    try writeKey(w, 3, .varint);
+    try writeVarint(w, @bitCast(@as(i64, -2)));
+    try writeKey(w, 4, .fixed64);
+    try w.writeInt(u64, @bitCast(@as(f64, 1.5)), .little);
+    try writeKey(w, 6, .varint);
+    try writeVarint(w, 1);
+    const key = "02" ++ "ab" ** 32;
+    try writeKey(w, 7, .len);
+    try writeVarint(w, key.len);
+    try w.writeAll(key);
+    for ([_][]const u8{ "x", "yz" }) |s| {
+        try writeKey(w, 8, .len);
+        try writeVarint(w, s.len);
+        try w.writeAll(s);
+    }
+    for ([_]i64{ -7, 42 }) |v| {
+        var item = std.ArrayList(u8).init(t.allocator);
+        defer item.deinit();
+        try encode(item.writer(), .{ .val = 1 }, .{ .val = v });
+        try writeKey(w, 9, .len);
+        try writeVarint(w, item.items.len);
+        try w.writeAll(item.items);
+    }
+    try writeKey(w, 10, .varint);
+    try writeVarint(w, 1);
+
+    var arena = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena.deinit();
+    const m = try decode(Msg, desc, arena.allocator(), buf.items);
+    try t.expectEqualStrings("870000000000000000", m.id);
+    try t.expectEqual(@as(u32, 800000), m.height);
+    try t.expectEqual(@as(i32, -2), m.delta);
+    try t.expectEqual(@as(f32, 1.5), m.ratio);
+    try t.expect(m.ok);
+    try t.expectEqualStrings("SETTLED", m.state);
+    try t.expectEqual(types.PubKey.literal(key), m.key);
+    try t.expectEqual(@as(usize, 2), m.names.len);
+    try t.expectEqualStrings("yz", m.names[1]);
+    try t.expectEqual(@as(usize, 2), m.items.len);
+    try t.expectEqual(@as(i64, -7), m.items[0].val);
+    try t.expectEqualStrings("none", m.items[1].tag);
+    try t.expectEqual(@TypeOf(m.status).b, m.status);
+
+    // absent fields are defaults.
+    const empty = try decode(Msg, desc, arena.allocator(), "");
+    try t.expectEqualStrings("OPEN", empty.state);
+    try t.expectEqual(@as(usize, 0), empty.items.len);
+    try t.expectEqual(@TypeOf(empty.status).a, empty.status);
+
+    try t.expectError(Error.ProtobufTruncated, decode(Msg, desc, arena.allocator(), buf.items[0 .. buf.items.len - 1]));
+    try t.expectError(Error.ProtobufWireType, decode(Msg, desc, arena.allocator(), &.{ 2 << 3 | 2, 0 }));
+    try t.expectError(Error.ProtobufOverflow, decode(Msg, desc, arena.allocator(), &.{ 2 << 3, 0xff, 0xff, 0xff, 0xff, 0x7f }));
+}
+
+test "protobuf encode" {
+    const t = std.testing;
+
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    const req = .{
+        .password = @as([]const u8, "secret"),
+        .words = @as([]const []const u8, &.{ "a", "bc" }),
+        .offset = @as(u64, 300),
+        .empty = @as([]const u8, ""),
+        .flag = false,
+        .neg = @as(i32, -1),
+    };
+    try encode(buf.writer(), .{ .password = 1, .words = 2, .offset = 3, .empty = 4, .flag = 5, .neg = 6 }, req);
+    try t.expectEqualSlices(u8, "\x0a\x06secret" ++ "\x12\x01a" ++ "\x12\x02bc" ++ "\x18\xac\x02" ++
+        "\x30\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", buf.items);
+}
@@ -0,0 +1,382 @@
+//! lock contention profiler for nd and ngui: wait and hold time histograms
+//! of named locks per call site, the return address of the lock call.
+//! aimed at finding code which holds a lock across slow work, like RPCs,
+//! and the threads it stalls meanwhile.
+//!
+//! compiled in only with -Dlockprof=true; Mutex is a bare
+//! std.Thread.Mutex otherwise, at no cost. the profile is written to stderr
+//! on dumpRequest, such as on SIGUSR1, longest total holds first. addresses
+//! resolve to source lines with addr2line on an unstripped binary.
+//!
+//! a watchdog warns of a lock held longer than hold_warn_ms while still held,
+//! and the holder dumps its stack trace once it releases the lock.
+//! safe for concurrent use.
+
+const buildopts = @import("build_options");
+const std = @import("std");
+const posix = std.posix;
+const Allocator = std.mem.Allocator;
+
+const logger = std.log.scoped(.lockprof);
+
+pub const enabled = buildopts.lockprof;
+
+/// profiled locks; see Mutex.
+pub const Lock = enum { daemon, config, ngui_reports };
+
+/// number of log2 buckets of microseconds; the last bucket, open-ended,
+/// starts at about 18min.
+const nbuckets = 32;
+/// max number of sites in a dump.
+const max_dump = 64;
+/// holds longer than this are logged, with the holder stack trace.
+pub const hold_warn_ms = 500;
+/// the watchdog polls for long holds and dump requests at this interval.
+const poll_interval = 100 * std.time.ns_per_ms;
+
+var global: Profiler = .{};
+var watchdog: ?std.Thread = null;
+var dump_requested = std.atomic.Value(bool).init(false);
+var stopping = std.atomic.Value(bool).init(false);
+
+/// a std.Thread.Mutex of a named lock whose wait and hold times are
+/// profiled per call site; a bare std.Thread.Mutex if not enabled.
+/// not for use with std.Thread.Condition, which takes the std mutex.
+pub const Mutex = struct {
+    inner: std.Thread.Mutex = .{},
+    name: Lock,
+    hold: Hold = .{}, // set by the holder
+
+    pub fn lock(self: *Mutex) void {
+        if (!enabled) {
+            return self.inner.lock();
+        }
+        if (self.inner.tryLock()) {
+            self.hold = acquired(self.name, @returnAddress(), null);
+            return;
+        }
+        const start = nowUs();
+        self.inner.lock();
+        self.hold = acquired(self.name, @returnAddress(), start);
+    }
+
+    pub fn tryLock(self: *Mutex) bool {
+        if (!self.inner.tryLock()) {
+            return false;
+        }
+        if (enabled) {
+            self.hold = acquired(self.name, @returnAddress(), null);
+        }
+        return true;
+    }
+
+    pub fn unlock(self: *Mutex) void {
+        if (!enabled) {
+            return self.inner.unlock();
+        }
+        const hold = self.hold;
+        self.inner.unlock();
+        released(self.name, hold);
+    }
+};
+
+/// lock site and time of a holder, kept in the mutex while held.
+const Hold = if (enabled) struct { site: usize = 0, since_us: u64 = 0 } else struct {};
+
+/// records a lock acquired at site, waited for since wait_start_us or not
+/// at all if null. called by the holder right after locking.
+fn acquired(lock: Lock, site: usize, wait_start_us: ?u64) Hold {
+    const now = nowUs();
+    global.recordAcquire(lock, site, if (wait_start_us) |t| now -| t else 0, now);
+    return .{ .site = site, .since_us = now };
+}
+
+/// records the end of a hold. called by the holder right after unlocking,
+/// so that the stack trace of a long hold doesn't extend it.
+fn released(lock: Lock, hold: Hold) void {
+    const us = nowUs() -| hold.since_us;
+    global.recordRelease(lock, hold.site, us);
+    if (us >= hold_warn_ms * std.time.us_per_ms) {
+        logger.warn("{s} held for {d}ms from 0x{x}; holder stack:", .{ @tagName(lock), us / std.time.us_per_ms, hold.site });
+        std.debug.dumpCurrentStackTrace(null);
+    }
+}
+
+/// spawns the watchdog thread, if enabled.
+pub fn start() !void {
+    if (!enabled or watchdog != null) {
+        return;
+    }
+    stopping.store(false, .release);
+    watchdog = try std.Thread.spawn(.{}, watchdogLoop, .{});
+    logger.info("lock profiling enabled; dumped on USR1", .{});
+}
+
+pub fn stop() void {
+    const th = watchdog orelse return;
+    stopping.store(true, .release);
+    th.join();
+    watchdog = null;
+}
+
+/// makes the watchdog write the profile to stderr. safe for use in a signal
+/// handler.
+pub fn requestDump() void {
+    dump_requested.store(true, .release);
+}
+
+fn watchdogLoop() void {
+    const stderr = std.io.getStdErr();
+    while (!stopping.load(.acquire)) {
+        if (dump_requested.swap(false, .acq_rel)) {
+            global.dump(stderr.writer()) catch {};
+        }
+        for (global.overdue(nowUs())) |h| {
+            const v = h orelse continue;
+            logger.warn("{s} held for over {d}ms from 0x{x}", .{ @tagName(v.lock), v.us / std.time.us_per_ms, v.site });
+        }
+        std.time.sleep(poll_interval);
+    }
+}
+
+/// counts of log2 buckets of microseconds, the same layout as
+/// nd metrics histograms.
+pub const Histogram = struct {
+    buckets: [nbuckets]u64 = [_]u64{0} ** nbuckets,
+    max: u64 = 0,
+
+    pub fn record(self: *Histogram, us: u64) void {
+        self.buckets[@min(nbuckets - 1, 64 - @as(usize, @clz(us)))] += 1;
+        self.max = @max(self.max, us);
+    }
+
+    /// returns the upper bound of the percentile, in microseconds;
+    /// null if empty.
+    pub fn percentile(self: Histogram, p: u8) ?u64 {
+        var total: u64 = 0;
+        for (self.buckets) |n| total += n;
+        if (total == 0) {
+            return null;
+        }
+        const want = (total * p + 99) / 100;
+        var cum: u64 = 0;
+        for (self.buckets, 0..) |n, i| {
+            cum += n;
+            if (cum >= want) {
+                return (@as(u64, 1) << @intCast(i)) - 1;
+            }
+        }
+        unreachable;
+    }
+};
+
+pub const Profiler = struct {
+    mu: std.Thread.Mutex = .{},
+    /// bookkeeping memory.
+    meta: Allocator = std.heap.page_allocator,
+    sites: std.AutoHashMapUnmanaged(SiteKey, Site) = .{},
+    /// locks left out for lack of bookkeeping memory.
+    untracked: u64 = 0,
+    /// current holders by lock, for the watchdog. with several mutexes of
+    /// the same name, the last one locked.
+    holders: [nlocks]Holder = [_]Holder{.{}} ** nlocks,
+
+    const nlocks = std.meta.fields(Lock).len;
+
+    pub const SiteKey = struct {
+        lock: Lock,
+        addr: usize, // return address of the lock call
+    };
+
+    pub const Site = struct {
+        count: u64 = 0, // acquisitions
+        contended: u64 = 0, // acquisitions which had to wait
+        wait_us: u64 = 0, // total
+        hold_us: u64 = 0, // total
+        wait: Histogram = .{},
+        hold: Histogram = .{},
+    };
+
+    const Holder = struct {
+        since_us: std.atomic.Value(u64) = std.atomic.Value(u64).init(0), // 0 if not held
+        site: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+        warned: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    };
+
+    pub const Overdue = struct { lock: Lock, site: usize, us: u64 };
+
+    pub fn deinit(self: *Profiler) void {
+        self.sites.deinit(self.meta);
+    }
+
+    fn recordAcquire(self: *Profiler, lock: Lock, site: usize, wait_us: u64, now: u64) void {
+        const h = &self.holders[@intFromEnum(lock)];
+        h.site.store(site, .monotonic);
+        h.warned.store(false, .monotonic);
+        h.since_us.store(now, .release);
+        self.mu.lock();
+        defer self.mu.unlock();
+        const s = self.siteOf(.{ .lock = lock, .addr = site }) orelse return;
+        s.count += 1;
+        if (wait_us > 0) {
+            s.contended += 1;
+        }
+        s.wait_us += wait_us;
+        s.wait.record(wait_us);
+    }
+
+    fn recordRelease(self: *Profiler, lock: Lock, site: usize, hold_us: u64) void {
+        self.holders[@intFromEnum(lock)].since_us.store(0, .release);
+        self.mu.lock();
+        defer self.mu.unlock();
+        const s = self.siteOf(.{ .lock = lock, .addr = site }) orelse return;
+        s.hold_us += hold_us;
+        s.hold.record(hold_us);
+    }
+
+    fn siteOf(self: *Profiler, key: SiteKey) ?*Site {
+        const res = self.sites.getOrPut(self.meta, key) catch {
+            self.untracked += 1;
+            return null;
+        };
+        if (!res.found_existing) {
+            res.value_ptr.* = .{};
+        }
+        return res.value_ptr;
+    }
+
+    /// returns locks held longer than hold_warn_ms as of now, each only once
+    /// per hold.
+    pub fn overdue(self: *Profiler, now: u64) [nlocks]?Overdue {
+        var out = [_]?Overdue{null} ** nlocks;
+        for (&self.holders, 0..) |*h, i| {
+            const since = h.since_us.load(.acquire);
+            if (since == 0 or now -| since < hold_warn_ms * std.time.us_per_ms) {
+                continue;
+            }
+            if (h.warned.swap(true, .monotonic)) {
+                continue;
+            }
+            out[i] = .{ .lock = @enumFromInt(i), .site = h.site.load(.monotonic), .us = now - since };
+        }
+        return out;
+    }
+
+    const Entry = struct { key: SiteKey, site: Site };
+
+    /// writes up to max_dump sites with the longest total hold time to w.
+    pub fn dump(self: *Profiler, w: anytype) !void {
+        // copy out under the lock so that locking doesn't wait for w.
+        var top: [max_dump]Entry = undefined;
+        var n: usize = 0;
+        var nsites: usize = 0;
+        var untracked: u64 = 0;
+        {
+            self.mu.lock();
+            defer self.mu.unlock();
+            nsites = self.sites.count();
+            untracked = self.untracked;
+            var it = self.sites.iterator();
+            while (it.next()) |kv| {
+                const e = Entry{ .key = kv.key_ptr.*, .site = kv.value_ptr.* };
+                if (n < top.len) {
+                    top[n] = e;
+                    n += 1;
+                    continue;
+                }
+                // replace the lightest one.
+                var min: usize = 0;
+                for (top[1..], 1..) |x, i| {
+                    if (x.site.hold_us < top[min].site.hold_us) {
+                        min = i;
+                    }
+                }
+                if (e.site.hold_us > top[min].site.hold_us) {
+                    top[min] = e;
+                }
+            }
+        }
+        std.mem.sort(Entry, top[0..n], {}, heavier);
+
+        try w.print("lockprof: dump start; {d} sites, {d} locks untracked\n", .{ nsites, untracked });
+        for (top[0..n]) |e| {
+            const s = e.site;
+            try w.print("lockprof: {s} 0x{x}: {d} locks, {d} contended; wait {d}us", .{
+                @tagName(e.key.lock),
+                e.key.addr,
+                s.count,
+                s.contended,
+                s.wait_us,
+            });
+            if (s.contended > 0) {
+                try w.print(" p50 {d}us p99 {d}us max {d}us", .{ s.wait.percentile(50).?, s.wait.percentile(99).?, s.wait.max });
+            }
+            try w.print("; hold {d}us", .{s.hold_us});
+            if (s.hold.percentile(50)) |p50| {
+                try w.print(" p50 {d}us p99 {d}us max {d}us", .{ p50, s.hold.percentile(99).?, s.hold.max });
+            }
+            try w.writeByte('\n');
+        }
+        try w.writeAll("lockprof: dump end\n");
+    }
+
+    fn heavier(_: void, a: Entry, b: Entry) bool {
+        return a.site.hold_us > b.site.hold_us;
+    }
+};
+
+fn nowUs() u64 {
+    var ts: posix.timespec = undefined;
+    posix.clock_gettime(posix.CLOCK.MONOTONIC, &ts) catch return 0;
+    return @as(u64, @intCast(ts.tv_sec)) * std.time.us_per_s + @as(u64, @intCast(ts.tv_nsec)) / std.time.ns_per_us;
+}
+
+test "mutex" {
+    var mu = Mutex{ .name = .daemon };
+    mu.lock();
+    try std.testing.expect(!mu.tryLock());
+    mu.unlock();
+    try std.testing.expect(mu.tryLock());
+    mu.unlock();
+}
+
+test "profiler" {
+    const t = std.testing;
+    const tt = @import("test.zig");
+
+    var prof = Profiler{ .meta = t.allocator };
+    defer prof.deinit();
+
+    prof.recordAcquire(.daemon, 0x10, 0, 1000);
+    try t.expectEqual(@as(?Profiler.Overdue, null), prof.overdue(1000 + hold_warn_ms * std.time.us_per_ms - 1)[0]);
+    const late = 1000 + hold_warn_ms * std.time.us_per_ms;
+    try t.expectEqual(@as(?Profiler.Overdue, .{ .lock = .daemon, .site = 0x10, .us = late - 1000 }), prof.overdue(late)[0]);
+    try t.expectEqual(@as(?Profiler.Overdue, null), prof.overdue(late + 1)[0]); // only once per hold
+    prof.recordRelease(.daemon, 0x10, 700_000);
+    try t.expectEqual(@as(?Profiler.Overdue, null), prof.overdue(late + 1)[0]);
+
+    prof.recordAcquire(.daemon, 0x10, 300, 2000);
+    prof.recordRelease(.daemon, 0x10, 100);
+    prof.recordAcquire(.config, 0x20, 0, 3000);
+    prof.recordRelease(.config, 0x20, 10);
+
+    const s = prof.sites.get(.{ .lock = .daemon, .addr = 0x10 }).?;
+    try t.expectEqual(@as(u64, 2), s.count);
+    try t.expectEqual(@as(u64, 1), s.contended);
+    try t.expectEqual(@as(u64, 700_100), s.hold_us);
+    try t.expectEqual(@as(u64, 700_000), s.hold.max);
+
+    var out = std.ArrayList(u8).init(t.allocator);
+    defer out.deinit();
+    try prof.dump(out.writer());
+    try tt.expectSubstring("lockprof: dump start; 2 sites, 0 locks untracked\n", out.items);
+    try tt.expectSubstring("lockprof: daemon 0x10: 2 locks, 1 contended; wait 300us p50 0us p99 511us max 300us; hold 700100us p50 127us p99 1048575us max 700000us\n", out.items);
+    try tt.expectSubstring("lockprof: config 0x20: 1 locks, 0 contended; wait 0us; hold 10us p50 15us p99 15us max 10us\n", out.items);
+    try t.expect(std.mem.indexOf(u8, out.items, "daemon").? < std.mem.indexOf(u8, out.items, "config").?);
+
+    var h = Histogram{};
+    h.buckets[3] = 98;
+    h.buckets[10] = 2;
+    try t.expectEqual(@as(?u64, 7), h.percentile(50));
+    try t.expectEqual(@as(?u64, 1023), h.percentile(99));
+}
@@ -0,0 +1,296 @@
+//! an in-memory std.log backend for nd and ngui. a log call formats its message
+//! into a fixed size ring buffer and returns without doing any I/O; a background
+//! flusher thread copies new records to stderr. the ring retains the most recent
+//! records, including those below the flush level, for an on-demand dump.
+//!
+//! use as `pub const std_options: std.Options = .{ .logFn = logring.logFn }`
+//! in the root file and call `start` early in main, `stop` on exit.
+//! until started and after stopped, log calls write to stderr synchronously.
+
+const std = @import("std");
+const builtin = @import("builtin");
+
+/// messages longer than this are truncated.
+pub const max_record = 1024;
+/// record header: 2 bytes length of the text which follows, 1 byte level.
+const header_len = 3;
+
+/// records with a level above this stay in the ring and are written to stderr
+/// only on dump. debug builds flush everything, like the std default logFn.
+pub var flush_level: std.log.Level = if (builtin.mode == .Debug) .debug else .info;
+
+var global: Ring(64 * 1024) = .{};
+var flusher: ?std.Thread = null;
+var running = std.atomic.Value(bool).init(false);
+var dump_requested = std.atomic.Value(bool).init(false);
+
+/// the flusher polls for dump requests at this interval.
+const poll_interval = 200 * std.time.ns_per_ms;
+
+/// std_options.logFn implementation.
+pub fn logFn(
+    comptime level: std.log.Level,
+    comptime scope: @TypeOf(.EnumLiteral),
+    comptime format: []const u8,
+    args: anytype,
+) void {
+    const prefix = comptime level.asText() ++ if (scope == .default) ": " else "(" ++ @tagName(scope) ++ "): ";
+    var buf: [max_record]u8 = undefined;
+    const text = formatRecord(&buf, prefix ++ format ++ "\n", args);
+    if (!running.load(.acquire)) {
+        const mu = std.debug.getStderrMutex();
+        mu.lock();
+        defer mu.unlock();
+        std.io.getStdErr().writeAll(text) catch {};
+        return;
+    }
+    global.push(level, text);
+}
+
+/// formats into buf, truncating the output with an ellipsis if buf is too short.
+fn formatRecord(buf: []u8, comptime format: []const u8, args: anytype) []const u8 {
+    return std.fmt.bufPrint(buf, format, args) catch {
+        const ellipsis = "...\n";
+        @memcpy(buf[buf.len - ellipsis.len ..], ellipsis);
+        return buf;
+    };
+}
+
+/// spawns the flusher thread. log calls go to the ring afterwards.
+pub fn start() !void {
+    if (flusher != null) {
+        return;
+    }
+    global.mu.lock();
+    global.stopping = false;
+    global.mu.unlock();
+    flusher = try std.Thread.spawn(.{}, flushLoop, .{});
+    running.store(true, .release);
+}
+
+/// flushes remaining records and joins the flusher thread.
+/// log calls write to stderr synchronously afterwards.
+pub fn stop() void {
+    const th = flusher orelse return;
+    running.store(false, .release);
+    global.mu.lock();
+    global.stopping = true;
+    global.cond.signal();
+    global.mu.unlock();
+    th.join();
+    flusher = null;
+}
+
+/// makes the flusher write all retained records to stderr, regardless of
+/// their level. safe for use in a signal handler.
+pub fn requestDump() void {
+    dump_requested.store(true, .release);
+}
+
+fn flushLoop() void {
+    const stderr = std.io.getStdErr();
+    var buf: [max_record]u8 = undefined;
+    while (true) {
+        if (dump_requested.swap(false, .acq_rel)) {
+            dump(stderr.writer()) catch {};
+        }
+        const rec = global.next(&buf, poll_interval) orelse {
+            global.mu.lock();
+            defer global.mu.unlock();
+            if (global.stopping and global.flushed == global.head) {
+                return;
+            }
+            continue;
+        };
+        if (rec.dropped > 0) {
+            stderr.writer().print("logring: {d} records dropped\n", .{rec.dropped}) catch {};
+        }
+        if (@intFromEnum(rec.level) <= @intFromEnum(flush_level)) {
+            stderr.writeAll(rec.text) catch {};
+        }
+    }
+}
+
+/// writes all records retained in the ring to w, oldest first.
+pub fn dump(w: anytype) !void {
+    // copy out under the lock so that log calls don't wait for w.
+    var dumpbuf: [@TypeOf(global).size]u8 = undefined;
+    const data = global.snapshot(&dumpbuf);
+    try w.writeAll("logring: dump start\n");
+    var it = RecordIterator{ .data = data };
+    while (it.next()) |rec| {
+        try w.writeAll(rec.text);
+    }
+    try w.writeAll("logring: dump end\n");
+}
+
+const Record = struct {
+    level: std.log.Level,
+    text: []const u8,
+    /// number of records overwritten before they could be flushed.
+    dropped: usize = 0,
+};
+
+/// iterates over records contiguously laid out in data, like in a snapshot.
+const RecordIterator = struct {
+    data: []const u8,
+    pos: usize = 0,
+
+    fn next(self: *RecordIterator) ?Record {
+        if (self.pos + header_len > self.data.len) {
+            return null;
+        }
+        const h = self.data[self.pos..][0..header_len];
+        const len = std.mem.readInt(u16, h[0..2], .little);
+        const start = self.pos + header_len;
+        self.pos = start + len;
+        return .{ .level = @enumFromInt(h[2]), .text = self.data[start..self.pos] };
+    }
+};
+
+/// a byte ring of variable length records. head, tail and flushed are
+/// monotonic byte offsets; a position in buf is offset modulo size.
+/// writing past the free space overwrites the oldest records.
+fn Ring(comptime ring_size: usize) type {
+    return struct {
+        const Self = @This();
+        pub const size = ring_size;
+
+        comptime {
+            std.debug.assert(std.math.isPowerOfTwo(size));
+            std.debug.assert(size >= header_len + max_record);
+        }
+
+        buf: [size]u8 = undefined,
+        mu: std.Thread.Mutex = .{},
+        cond: std.Thread.Condition = .{},
+        head: usize = 0, // end of the newest record
+        tail: usize = 0, // start of the oldest retained record
+        flushed: usize = 0, // start of the next record to flush
+        dropped: usize = 0, // records lost since last flushed
+        stopping: bool = false,
+
+        fn push(self: *Self, level: std.log.Level, text: []const u8) void {
+            const len: u16 = @intCast(@min(text.len, max_record));
+            var h: [header_len]u8 = undefined;
+            std.mem.writeInt(u16, h[0..2], len, .little);
+            h[2] = @intFromEnum(level);
+
+            self.mu.lock();
+            defer self.mu.unlock();
+            const n = header_len + len;
+            while (self.head + n - self.tail > size) {
+                if (self.tail >= self.flushed) {
+                    self.dropped += 1;
+                }
+                self.tail += header_len + self.readLen(self.tail);
+            }
+            self.flushed = @max(self.flushed, self.tail);
+            self.copyIn(self.head, &h);
+            self.copyIn(self.head + header_len, text[0..len]);
+            self.head += n;
+            self.cond.signal();
+        }
+
+        /// copies the next record to flush into buf, waiting up to timeout_ns
+        /// if there are none. returned text is a slice of buf.
+        fn next(self: *Self, buf: *[max_record]u8, timeout_ns: u64) ?Record {
+            self.mu.lock();
+            defer self.mu.unlock();
+            if (self.flushed == self.head and !self.stopping) {
+                self.cond.timedWait(&self.mu, timeout_ns) catch {};
+            }
+            if (self.flushed == self.head) {
+                return null;
+            }
+            const len = self.readLen(self.flushed);
+            const level = self.buf[(self.flushed + 2) % size];
+            self.copyOut(self.flushed + header_len, buf[0..len]);
+            self.flushed += header_len + len;
+            const dropped = self.dropped;
+            self.dropped = 0;
+            return .{ .level = @enumFromInt(level), .text = buf[0..len], .dropped = dropped };
+        }
+
+        /// copies all retained records into out, oldest first.
+        fn snapshot(self: *Self, out: *[size]u8) []const u8 {
+            self.mu.lock();
+            defer self.mu.unlock();
+            const data = out[0 .. self.head - self.tail];
+            self.copyOut(self.tail, data);
+            return data;
+        }
+
+        fn readLen(self: *const Self, off: usize) u16 {
+            var b: [2]u8 = undefined;
+            self.copyOut(off, &b);
+            return std.mem.readInt(u16, &b, .little);
+        }
+
+        fn copyIn(self: *Self, off: usize, data: []const u8) void {
+            const i = off % size;
+            const first = @min(data.len, size - i);
+            @memcpy(self.buf[i..][0..first], data[0..first]);
+            @memcpy(self.buf[0 .. data.len - first], data[first..]);
+        }
+
+        fn copyOut(self: *const Self, off: usize, out: []u8) void {
+            const i = off % size;
+            const first = @min(out.len, size - i);
+            @memcpy(out[0..first], self.buf[i..][0..first]);
+            @memcpy(out[first..], self.buf[0 .. out.len - first]);
+        }
+    };
+}
+
+test "ring push and flush" {
+    const t = std.testing;
+
+    var ring: Ring(2048) = .{};
+    var buf: [max_record]u8 = undefined;
+    try t.expect(ring.next(&buf, 0) == null);
+
+    ring.push(.info, "hello\n");
+    ring.push(.debug, "world\n");
+    const r1 = ring.next(&buf, 0).?;
+    try t.expectEqual(.info, r1.level);
+    try t.expectEqualStrings("hello\n", r1.text);
+    const r2 = ring.next(&buf, 0).?;
+    try t.expectEqual(.debug, r2.level);
+    try t.expectEqualStrings("world\n", r2.text);
+    try t.expect(ring.next(&buf, 0) == null);
+}
+
+test "ring overwrite and snapshot" {
+    const t = std.testing;
+
+    var ring: Ring(2048) = .{};
+    var buf: [max_record]u8 = undefined;
+    const msg = "x" ** 500;
+    // 503 bytes per record: only four fit, with wrap around.
+    for (0..6) |i| {
+        ring.push(.warn, msg);
+        if (i == 0) {
+            _ = ring.next(&buf, 0).?;
+        }
+    }
+    // the 2nd record was overwritten before it could be flushed.
+    const r = ring.next(&buf, 0).?;
+    try t.expectEqual(1, r.dropped);
+    try t.expectEqualStrings(msg, r.text);
+
+    var out: [2048]u8 = undefined;
+    var it = RecordIterator{ .data = ring.snapshot(&out) };
+    var n: usize = 0;
+    while (it.next()) |rec| : (n += 1) {
+        try t.expectEqual(.warn, rec.level);
+        try t.expectEqualStrings(msg, rec.text);
+    }
+    try t.expectEqual(4, n);
+}
+
+test "format truncation" {
+    var buf: [16]u8 = undefined;
+    try std.testing.expectEqualStrings("short\n", formatRecord(&buf, "{s}\n", .{"short"}));
+    try std.testing.expectEqualStrings("a long messa...\n", formatRecord(&buf, "{s}\n", .{"a long message here"}));
+}
@@ -0,0 +1,121 @@
+//! live heap bytes per nd subsystem, for the metrics file. tagged returns
+//! a thin allocator on top of a child which counts the bytes it has out:
+//! an atomic add per alloc, resize and free, cheap enough to stay on in
+//! release builds, unlike allocprof.
+//!
+//! allocations made with the child directly, or freed with a different
+//! allocator than the one they were made with, are not accounted for.
+//! safe for concurrent use.
+
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const Atomic = std.atomic.Value;
+
+/// subsystems accounted for.
+pub const Tag = enum {
+    comm, // ngui pipe and subscribers
+    rpc, // bitcoind and lnd clients
+    config, // nd config and its mutations
+    network, // wifi scans and network reports
+};
+
+const ntags = std.meta.fields(Tag).len;
+/// distinct tag and child pairs at most; others are left unaccounted.
+const max_accounts = 16;
+
+var live = [_]Atomic(usize){Atomic(usize).init(0)} ** ntags;
+/// guards accounts and naccounts; taken only by tagged.
+var mu: std.Thread.Mutex = .{};
+var accounts: [max_accounts]Account = undefined;
+var naccounts: usize = 0;
+
+/// returns an allocator on top of child which accounts allocations to the tag.
+/// the same tag and child pair always maps to the same allocator. a child
+/// which is itself accounting is replaced with its own child, so that its
+/// allocations are counted once.
+pub fn tagged(tag: Tag, child: Allocator) Allocator {
+    const c = unwrap(child);
+    mu.lock();
+    defer mu.unlock();
+    for (accounts[0..naccounts]) |*a| {
+        if (a.tag == tag and a.child.ptr == c.ptr and a.child.vtable == c.vtable) {
+            return a.allocator();
+        }
+    }
+    if (naccounts == max_accounts) {
+        return c;
+    }
+    const a = &accounts[naccounts];
+    a.* = .{ .tag = tag, .live = &live[@intFromEnum(tag)], .child = c };
+    naccounts += 1;
+    return a.allocator();
+}
+
+fn unwrap(a: Allocator) Allocator {
+    if (a.vtable == &Account.vtable) {
+        const acct: *Account = @ptrCast(@alignCast(a.ptr));
+        return acct.child;
+    }
+    return a;
+}
+
+/// returns the number of bytes currently allocated with the tag allocator.
+pub fn liveBytes(tag: Tag) usize {
+    return live[@intFromEnum(tag)].load(.monotonic);
+}
+
+const Account = struct {
+    tag: Tag,
+    live: *Atomic(usize),
+    child: Allocator,
+
+    const vtable = Allocator.VTable{ .alloc = alloc, .resize = resize, .free = free };
+
+    fn allocator(self: *Account) Allocator {
+        return .{ .ptr = self, .vtable = &vtable };
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, log2_align: u8, ret_addr: usize) ?[*]u8 {
+        const self: *Account = @ptrCast(@alignCast(ctx));
+        const p = self.child.rawAlloc(len, log2_align, ret_addr) orelse return null;
+        _ = self.live.fetchAdd(len, .monotonic);
+        return p;
+    }
+
+    fn resize(ctx: *anyopaque, buf: []u8, log2_align: u8, new_len: usize, ret_addr: usize) bool {
+        const self: *Account = @ptrCast(@alignCast(ctx));
+        if (!self.child.rawResize(buf, log2_align, new_len, ret_addr)) {
+            return false;
+        }
+        if (new_len > buf.len) {
+            _ = self.live.fetchAdd(new_len - buf.len, .monotonic);
+        } else {
+            _ = self.live.fetchSub(buf.len - new_len, .monotonic);
+        }
+        return true;
+    }
+
+    fn free(ctx: *anyopaque, buf: []u8, log2_align: u8, ret_addr: usize) void {
+        const self: *Account = @ptrCast(@alignCast(ctx));
+        self.child.rawFree(buf, log2_align, ret_addr);
+        _ = self.live.fetchSub(buf.len, .monotonic);
+    }
+};
+
+test "memacct" {
+    const t = std.testing;
+
+    const base = liveBytes(.network);
+    const a = tagged(.network, tagged(.network, t.allocator));
+    var list = std.ArrayList(u8).init(a);
+    try list.appendNTimes('x', 100);
+    try t.expectEqual(base + list.capacity, liveBytes(.network));
+    list.shrinkAndFree(10);
+    try t.expectEqual(base + 10, liveBytes(.network));
+    const rpc_base = liveBytes(.rpc);
+    const other = try tagged(.rpc, t.allocator).alloc(u8, 7);
+    defer tagged(.rpc, t.allocator).free(other);
+    try t.expectEqual(rpc_base + 7, liveBytes(.rpc));
+    list.deinit();
+    try t.expectEqual(base, liveBytes(.network));
+}
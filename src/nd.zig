@@ -1,4 +1,5 @@
 const buildopts = @import("build_options");
+const builtin = @import("builtin");
 const std = @import("std");
 const posix = std.posix;
 const time = std.time;
@@ -6,10 +7,27 @@ const Address = std.net.Address;
 
 const nif = @import("nif");
 
+const allocprof = @import("allocprof.zig");
+const lockprof = @import("lockprof.zig");
 const comm = @import("comm.zig");
+const logring = @import("logring.zig");
+const memacct = @import("memacct.zig");
 const Config = @import("nd/Config.zig");
 const Daemon = @import("nd/Daemon.zig");
+const UtxoSnapshot = @import("nd/UtxoSnapshot.zig");
 const screen = @import("ui/screen.zig");
+const sys = @import("sys.zig");
+const tcalloc = @import("tcalloc.zig");
+const trace = @import("trace.zig");
+const types = @import("types.zig");
+
+/// log calls go to an in-memory ring flushed by a background thread, so that
+/// the loops don't block on stderr. release builds keep debug records in the
+/// ring only, written out on SIGUSR1 dump; see logring.zig.
+pub const std_options: std.Options = .{
+    .log_level = .debug,
+    .logFn = logring.logFn,
+};
 
 const logger = std.log.scoped(.nd);
 const stderr = std.io.getStdErr().writer();
@@ -17,15 +35,48 @@ const stderr = std.io.getStdErr().writer();
 /// prints usage help text to stderr.
 fn usage(prog: []const u8) !void {
     try stderr.print(
-        \\usage: {[prog]s} -gui path/to/ngui -gui-user username -wpa path [-conf {[confpath]s}]
+        \\usage: {[prog]s} -gui path/to/ngui -gui-user username -wpa path [-conf {[confpath]s}] [-metrics path] [-history {[histpath]s}] [-forwards {[fwdpath]s}] [-payments {[paypath]s}] [-txhistory {[txpath]s}] [-reports {[reppath]s}] [-chanbackup {[backuppath]s}] [-subscribe path] [-trace path] [-utxo-snapshot url -utxo-snapshot-sha256 hex] [-ibd-evict] [-bitcoind-rest] [-devnet dir]
         \\
         \\nd is a short for nakamochi daemon.
         \\the daemon executes ngui as a child process and runs until
         \\TERM or INT signal is received.
         \\
-        \\nd logs messages to stderr.
+        \\nd logs messages to stderr. on USR1 signal, it dumps recent log records
+        \\kept in memory, including debug ones not written out in release builds.
+        \\with -metrics, it also exports timing metrics and resource usage of
+        \\services and disks to the file in prometheus text format, such as
+        \\the node_exporter textfile collector reads.
+        \\mempool, fees and balances trends are kept in the -history file;
+        \\an empty value disables them.
+        \\per-channel forwarding earnings are synced from lnd into the -forwards
+        \\file, settled invoices and payments into the -payments file and onchain
+        \\wallet transactions into the -txhistory file; an empty value disables each.
+        \\the last onchain and lightning reports are kept in the -reports file
+        \\and shown as stale right after a restart; an empty value disables it.
+        \\lnd static channel backup is exported to the -chanbackup file, such as
+        \\on a USB stick, at start and whenever channels open or close; the file
+        \\is rewritten only if the backup changed. its directory must exist.
+        \\an empty value disables the export.
+        \\with -subscribe, reports sent to ngui are also streamed, as comm frames
+        \\with json payloads, to each client connected to the unix socket at path.
+        \\nd manages bitcoind dbcache, par, maxmempool and blocksonly settings,
+        \\sized to the host memory and restarting bitcoind when the initial
+        \\block download starts or completes.
+        \\lnd channel.db is compacted with an lnd restart while in standby,
+        \\once grown by a quarter or more over its live data.
+        \\a fresh node far behind the chain tip downloads the -utxo-snapshot file,
+        \\checked against its published -utxo-snapshot-sha256 digest, and loads it
+        \\into bitcoind which then validates the chain up to it in the background.
+        \\with -ibd-evict, outbound full-relay and inbound peers lagging behind the
+        \\others in the initial block download are disconnected, a few per hour.
+        \\with -bitcoind-rest, headers of recent blocks are fetched from the
+        \\bitcoind REST interface, which must be enabled with rest=1.
+        \\builds with -Dtrace record startup spans of nd and ngui to the -trace
+        \\file in Chrome trace format, for chrome://tracing or ui.perfetto.dev.
+        \\with -devnet, nd talks to the regtest bitcoind and lnd hub node set up
+        \\in dir by zig build scale-env, instead of the mainnet ones.
         \\
-    , .{ .prog = prog, .confpath = NdArgs.defaultConf });
+    , .{ .prog = prog, .confpath = NdArgs.defaultConf, .histpath = NdArgs.defaultHistory, .fwdpath = NdArgs.defaultForwards, .paypath = NdArgs.defaultPayments, .txpath = NdArgs.defaultTxHistory, .reppath = NdArgs.defaultReports, .backuppath = NdArgs.defaultChanBackup });
 }
 
 /// nd program flags. see usage.
@@ -34,15 +85,53 @@ const NdArgs = struct {
     gui: ?[:0]const u8 = null,
     gui_user: ?[:0]const u8 = null,
     wpa: ?[:0]const u8 = null,
+    metrics: ?[:0]const u8 = null,
+    history: ?[:0]const u8 = null,
+    forwards: ?[:0]const u8 = null,
+    payments: ?[:0]const u8 = null,
+    txhistory: ?[:0]const u8 = null,
+    reports: ?[:0]const u8 = null,
+    chanbackup: ?[:0]const u8 = null,
+    subscribe: ?[:0]const u8 = null,
+    trace: ?[:0]const u8 = null,
+    utxo_snapshot: ?[:0]const u8 = null,
+    utxo_snapshot_sha256: ?[:0]const u8 = null,
+    ibd_evict: bool = false,
+    bitcoind_rest: bool = false,
+    devnet: ?[:0]const u8 = null,
 
     /// default path for nd config file, read or created during startup.
     const defaultConf = "/home/uiuser/conf.json";
+    /// default path for the reports history file, created during startup.
+    const defaultHistory = "/ssd/ndg/history.bin";
+    /// default path for the forwarding history aggregates file.
+    const defaultForwards = "/ssd/ndg/forwards.bin";
+    /// default path for the lightning payments history file.
+    const defaultPayments = "/ssd/ndg/payments.bin";
+    /// default path for the onchain transactions history file.
+    const defaultTxHistory = "/ssd/ndg/txhistory.bin";
+    /// default path for the last reports snapshot file.
+    const defaultReports = "/ssd/ndg/reports.bin";
+    /// default path for the static channel backup export.
+    const defaultChanBackup = "/ssd/ndg/channel.backup";
 
     fn deinit(self: @This(), allocator: std.mem.Allocator) void {
         if (self.conf) |p| allocator.free(p);
         if (self.gui) |p| allocator.free(p);
         if (self.gui_user) |p| allocator.free(p);
         if (self.wpa) |p| allocator.free(p);
+        if (self.metrics) |p| allocator.free(p);
+        if (self.history) |p| allocator.free(p);
+        if (self.forwards) |p| allocator.free(p);
+        if (self.payments) |p| allocator.free(p);
+        if (self.txhistory) |p| allocator.free(p);
+        if (self.reports) |p| allocator.free(p);
+        if (self.chanbackup) |p| allocator.free(p);
+        if (self.subscribe) |p| allocator.free(p);
+        if (self.trace) |p| allocator.free(p);
+        if (self.utxo_snapshot) |p| allocator.free(p);
+        if (self.utxo_snapshot_sha256) |p| allocator.free(p);
+        if (self.devnet) |p| allocator.free(p);
     }
 };
 
@@ -60,6 +149,18 @@ fn parseArgs(gpa: std.mem.Allocator) !NdArgs {
         gui,
         gui_user,
         wpa,
+        metrics,
+        history,
+        forwards,
+        payments,
+        txhistory,
+        reports,
+        chanbackup,
+        subscribe,
+        trace,
+        utxo_snapshot,
+        utxo_snapshot_sha256,
+        devnet,
     } = .none;
     while (args.next()) |a| {
         switch (lastarg) {
@@ -83,6 +184,66 @@ fn parseArgs(gpa: std.mem.Allocator) !NdArgs {
                 lastarg = .none;
                 continue;
             },
+            .metrics => {
+                flags.metrics = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .history => {
+                flags.history = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .forwards => {
+                flags.forwards = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .payments => {
+                flags.payments = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .txhistory => {
+                flags.txhistory = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .reports => {
+                flags.reports = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .chanbackup => {
+                flags.chanbackup = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .subscribe => {
+                flags.subscribe = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .trace => {
+                flags.trace = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .utxo_snapshot => {
+                flags.utxo_snapshot = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .utxo_snapshot_sha256 => {
+                flags.utxo_snapshot_sha256 = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .devnet => {
+                flags.devnet = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
             .none => {},
         }
         if (std.mem.eql(u8, a, "-h") or std.mem.eql(u8, a, "-help") or std.mem.eql(u8, a, "--help")) {
@@ -99,6 +260,34 @@ fn parseArgs(gpa: std.mem.Allocator) !NdArgs {
             lastarg = .gui_user;
         } else if (std.mem.eql(u8, a, "-wpa")) {
             lastarg = .wpa;
+        } else if (std.mem.eql(u8, a, "-metrics")) {
+            lastarg = .metrics;
+        } else if (std.mem.eql(u8, a, "-history")) {
+            lastarg = .history;
+        } else if (std.mem.eql(u8, a, "-forwards")) {
+            lastarg = .forwards;
+        } else if (std.mem.eql(u8, a, "-payments")) {
+            lastarg = .payments;
+        } else if (std.mem.eql(u8, a, "-txhistory")) {
+            lastarg = .txhistory;
+        } else if (std.mem.eql(u8, a, "-reports")) {
+            lastarg = .reports;
+        } else if (std.mem.eql(u8, a, "-chanbackup")) {
+            lastarg = .chanbackup;
+        } else if (std.mem.eql(u8, a, "-subscribe")) {
+            lastarg = .subscribe;
+        } else if (std.mem.eql(u8, a, "-trace")) {
+            lastarg = .trace;
+        } else if (std.mem.eql(u8, a, "-utxo-snapshot")) {
+            lastarg = .utxo_snapshot;
+        } else if (std.mem.eql(u8, a, "-utxo-snapshot-sha256")) {
+            lastarg = .utxo_snapshot_sha256;
+        } else if (std.mem.eql(u8, a, "-devnet")) {
+            lastarg = .devnet;
+        } else if (std.mem.eql(u8, a, "-ibd-evict")) {
+            flags.ibd_evict = true;
+        } else if (std.mem.eql(u8, a, "-bitcoind-rest")) {
+            flags.bitcoind_rest = true;
         } else {
             logger.err("unknown arg name {s}", .{a});
             return error.UnknownArgName;
@@ -112,6 +301,24 @@ fn parseArgs(gpa: std.mem.Allocator) !NdArgs {
     if (flags.conf == null) {
         flags.conf = NdArgs.defaultConf;
     }
+    if (flags.history == null) {
+        flags.history = try gpa.dupeZ(u8, NdArgs.defaultHistory);
+    }
+    if (flags.forwards == null) {
+        flags.forwards = try gpa.dupeZ(u8, NdArgs.defaultForwards);
+    }
+    if (flags.payments == null) {
+        flags.payments = try gpa.dupeZ(u8, NdArgs.defaultPayments);
+    }
+    if (flags.txhistory == null) {
+        flags.txhistory = try gpa.dupeZ(u8, NdArgs.defaultTxHistory);
+    }
+    if (flags.reports == null) {
+        flags.reports = try gpa.dupeZ(u8, NdArgs.defaultReports);
+    }
+    if (flags.chanbackup == null) {
+        flags.chanbackup = try gpa.dupeZ(u8, NdArgs.defaultChanBackup);
+    }
     if (flags.gui == null) {
         logger.err("missing -gui arg", .{});
         return error.MissingGuiFlag;
@@ -124,10 +331,34 @@ fn parseArgs(gpa: std.mem.Allocator) !NdArgs {
         logger.err("missing -wpa arg", .{});
         return error.MissingWpaFlag;
     }
+    if ((flags.utxo_snapshot == null) != (flags.utxo_snapshot_sha256 == null)) {
+        logger.err("-utxo-snapshot and -utxo-snapshot-sha256 go together", .{});
+        return error.UtxoSnapshotFlags;
+    }
+    if (flags.utxo_snapshot_sha256) |hex| {
+        _ = UtxoSnapshot.parseDigest(hex) catch |err| {
+            logger.err("invalid -utxo-snapshot-sha256: {!}", .{err});
+            return err;
+        };
+    }
 
     return flags;
 }
 
+/// points nd at the regtest bitcoind and lnd hub node of a scale-env dir,
+/// laid out as in src/test/scaleenv.zig. must be called before nd.start.
+fn useDevnet(nd: *Daemon, arena: std.mem.Allocator, dir: []const u8) !void {
+    const root = try std.fs.cwd().realpathAlloc(arena, dir);
+    const macdir = try std.fs.path.join(arena, &.{ root, "lnd0/data/chain/bitcoin/regtest" });
+    nd.bitcoind.cookiepath = try std.fs.path.join(arena, &.{ root, "rpc.cookie" });
+    nd.bitcoind.port = 18443;
+    nd.lndc.opt.port = 10010;
+    nd.lndc.opt.tlscert_path = try std.fs.path.join(arena, &.{ root, "lnd0/tls.cert" });
+    nd.lndc.opt.macaroon_ro_path = try std.fs.path.join(arena, &.{ macdir, "readonly.macaroon" });
+    nd.lndc.opt.macaroon_admin_path = try std.fs.path.join(arena, &.{ macdir, "admin.macaroon" });
+    logger.info("devnet: bitcoind and lnd of {s}", .{root});
+}
+
 /// sigquit tells nd to exit.
 var sigquit: std.Thread.ResetEvent = .{};
 
@@ -137,86 +368,257 @@ fn sighandler(sig: c_int) callconv(.C) void {
     }
     switch (sig) {
         posix.SIG.INT, posix.SIG.TERM => sigquit.set(),
+        posix.SIG.USR1 => {
+            logring.requestDump();
+            allocprof.requestDump();
+            lockprof.requestDump();
+        },
         else => {},
     }
 }
 
+/// max size of a lightning report frame in the region shared with ngui;
+/// larger ones are sent over the pipe. the region takes two such slots,
+/// backed by memory only as far as written.
+const shm_slot_size = 4 << 20;
+
+/// the ngui child process, respawned by the daemon once it exits.
+/// safe for concurrent use: the daemon respawns it from its comm thread.
+const Gui = struct {
+    gpa: std.mem.Allocator,
+    path: []const u8,
+    conf: Config,
+    trace: ?[]const u8, // chrome trace file, if any
+    shm: ?*comm.ShmSnapshot, // shared with each ngui process, if any
+    shm_arg: [16]u8 = undefined, // shm descriptor as a decimal string
+    mu: std.Thread.Mutex = .{},
+    args: std.ArrayList([]const u8), // guarded by mu
+    proc: std.ChildProcess = undefined, // valid once spawned; guarded by mu
+    stopped: bool = false, // no more respawns; guarded by mu
+
+    fn init(gpa: std.mem.Allocator, path: []const u8, conf: Config, trace_path: ?[]const u8, shm: ?*comm.ShmSnapshot) Gui {
+        return .{
+            .gpa = gpa,
+            .path = path,
+            .conf = conf,
+            .trace = trace_path,
+            .shm = shm,
+            .args = std.ArrayList([]const u8).init(gpa),
+        };
+    }
+
+    fn deinit(self: *Gui) void {
+        self.args.deinit();
+    }
+
+    /// starts ngui with its stdin and stdout piped, screen-locked if so
+    /// configured at the time.
+    fn spawn(self: *Gui) !types.IoPipe {
+        self.mu.lock();
+        defer self.mu.unlock();
+        return self.spawnLocked();
+    }
+
+    fn spawnLocked(self: *Gui) !types.IoPipe {
+        self.args.clearRetainingCapacity();
+        try self.args.append(self.path);
+        if (self.conf.snapshot().data.slock != null) {
+            try self.args.append("-slock");
+        }
+        if (trace.enabled and self.trace != null) {
+            try self.args.appendSlice(&.{ "-trace", self.trace.? });
+        }
+        if (self.shm) |shm| {
+            // the descriptor is inherited: ngui maps the same region.
+            const fd = try std.fmt.bufPrint(&self.shm_arg, "{d}", .{shm.fd});
+            try self.args.appendSlice(&.{ "-shm", fd });
+        }
+        self.proc = std.ChildProcess.init(self.args.items, self.gpa);
+        self.proc.stdin_behavior = .Pipe;
+        self.proc.stdout_behavior = .Pipe;
+        self.proc.stderr_behavior = .Inherit;
+        // fix zig std: child_process.zig:125:33: error: container 'std.os' has no member called 'getUserInfo'
+        //self.proc.setUserName(args.gui_user) catch |err| {
+        //    fatal("unable to set gui username to {s}: {s}", .{args.gui_user.?, err});
+        //};
+        // TODO: the following fails with "cannot open framebuffer device: Permission denied"
+        // but works with "doas -u uiuser ngui"
+        // ftr, zig uses setreuid and setregid
+        //const uiuser = std.process.getUserInfo(args.gui_user.?) catch |err| {
+        //    fatal("unable to set gui username to {s}: {any}", .{ args.gui_user.?, err });
+        //};
+        //self.proc.uid = uiuser.uid;
+        //self.proc.gid = uiuser.gid;
+        // self.proc.env_map = ...
+        self.proc.spawn() catch |err| {
+            logger.err("unable to start ngui at path {s}", .{self.path});
+            return err;
+        };
+        // the i/o is closed as soon as ngui child process terminates.
+        // note: read(2) indicates file destriptor i/o is atomic linux since 3.14.
+        return .{ .r = self.proc.stdout.?, .w = self.proc.stdin.? };
+    }
+
+    /// terminates ngui for good, if still running, reaps it and closes its pipe.
+    fn stop(self: *Gui) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        self.stopped = true;
+        self.killLocked();
+    }
+
+    fn killLocked(self: *Gui) void {
+        _ = self.proc.kill() catch |err| logger.err("ngui.kill: {any}", .{err});
+    }
+
+    fn spawner(self: *Gui) Daemon.UiSpawner {
+        return .{ .ctx = self, .func = respawn };
+    }
+
+    fn respawn(ctx: *anyopaque) anyerror!types.IoPipe {
+        const self: *Gui = @ptrCast(@alignCast(ctx));
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.stopped) {
+            return error.NguiStopped;
+        }
+        self.killLocked(); // reaps the exited process
+        return self.spawnLocked();
+    }
+};
+
 pub fn main() !void {
-    // main heap allocator used throughout the lifetime of nd
+    // main heap allocator used throughout the lifetime of nd: the thread-caching
+    // tcalloc in release builds, GeneralPurposeAllocator for its leak detection
+    // in debug. subsystems of interest account their live bytes in metrics.
     var gpa_state = std.heap.GeneralPurposeAllocator(.{}){};
-    defer if (gpa_state.deinit() == .leak) {
+    defer if (builtin.mode == .Debug and gpa_state.deinit() == .leak) {
         logger.err("memory leaks detected", .{});
     };
-    const gpa = gpa_state.allocator();
+    const gpa = allocprof.wrap(if (builtin.mode == .Debug) gpa_state.allocator() else tcalloc.allocator);
+
+    // startup timeline, logged once the daemon is started.
+    var startup = try time.Timer.start();
 
     // parse program args first thing and fail fast if invalid
     const args = try parseArgs(gpa);
     defer args.deinit(gpa);
+    logring.start() catch |err| logger.err("logring.start: {any}", .{err});
+    defer logring.stop();
+    allocprof.start() catch |err| logger.err("allocprof.start: {any}", .{err});
+    defer allocprof.stop();
+    lockprof.start() catch |err| logger.err("lockprof.start: {any}", .{err});
+    defer lockprof.stop();
     logger.info("ndg version {any}", .{buildopts.semver});
+    if (args.trace) |path| {
+        trace.open(path, "nd", .{}) catch |err| logger.err("trace.open {s}: {any}", .{ path, err });
+    }
 
     // reset the screen backlight to normal power regardless
     // of its previous state.
     screen.backlight(.on) catch |err| logger.err("backlight: {any}", .{err});
+    screen.setBrightness(screen.max_brightness) catch |err| logger.err("brightness: {any}", .{err});
 
     // load config file to figure out whether to start ngui in screenlocked mode.
-    const conf = try Config.init(gpa, args.conf.?);
+    const conf_span = trace.begin("config init");
+    const conf = try Config.init(memacct.tagged(.config, gpa), args.conf.?);
     defer conf.deinit();
+    conf_span.end();
+    const conf_ms = startup.read() / time.ns_per_ms;
 
-    // start ngui, unless -nogui mode
-    const gui_path = args.gui.?; // guaranteed to be non-null
-    var ngui_args = std.ArrayList([]const u8).init(gpa);
-    defer ngui_args.deinit();
-    try ngui_args.append(gui_path);
-    if (conf.data.slock != null) {
-        try ngui_args.append("-slock");
-    }
-    var ngui = std.ChildProcess.init(ngui_args.items, gpa);
-    ngui.stdin_behavior = .Pipe;
-    ngui.stdout_behavior = .Pipe;
-    ngui.stderr_behavior = .Inherit;
-    // fix zig std: child_process.zig:125:33: error: container 'std.os' has no member called 'getUserInfo'
-    //ngui.setUserName(args.gui_user) catch |err| {
-    //    fatal("unable to set gui username to {s}: {s}", .{args.gui_user.?, err});
-    //};
-    // TODO: the following fails with "cannot open framebuffer device: Permission denied"
-    // but works with "doas -u uiuser ngui"
-    // ftr, zig uses setreuid and setregid
-    //const uiuser = std.process.getUserInfo(args.gui_user.?) catch |err| {
-    //    fatal("unable to set gui username to {s}: {any}", .{ args.gui_user.?, err });
-    //};
-    //ngui.uid = uiuser.uid;
-    //ngui.gid = uiuser.gid;
-    // ngui.env_map = ...
-    ngui.spawn() catch |err| {
-        logger.err("unable to start ngui at path {s}", .{gui_path});
-        return err;
+    // large lightning reports reach ngui through shared memory rather than
+    // the pipe, if available.
+    var shm: ?comm.ShmSnapshot = comm.ShmSnapshot.create(shm_slot_size) catch |err| blk: {
+        logger.warn("shm snapshot: {any}; reports go over the pipe", .{err});
+        break :blk null;
     };
+    defer if (shm) |*s| s.deinit();
+
+    // nd and ngui run in a cgroup of their own, ahead of a syncing bitcoind;
+    // the daemon places the services and sets the limits.
+    var cgroups: ?sys.Cgroups = sys.Cgroups.init("/") catch |err| blk: {
+        logger.warn("cgroups: {any}; services share the node resources", .{err});
+        break :blk null;
+    };
+    defer if (cgroups) |*cg| cg.deinit();
+    if (cgroups) |*cg| {
+        cg.placeSelf(Daemon.ui_cgroup) catch |err| logger.err("cgroups: place nd: {any}", .{err});
+    }
+
+    // start ngui, unless -nogui mode
+    const ngui_span = trace.begin("ngui spawn");
+    var ngui = Gui.init(gpa, args.gui.?, conf, args.trace, if (shm) |*s| s else null); // gui is guaranteed to be non-null
+    defer ngui.deinit();
+    const uipipe = try ngui.spawn();
     // if the daemon fails to start and its process exits, ngui may hang forever
     // preventing system services monitoring to detect a failure and restart nd.
     // so, make sure to kill the ngui child process on fatal failures.
-    errdefer _ = ngui.kill() catch {};
+    errdefer ngui.stop();
 
-    // the i/o is closed as soon as ngui child process terminates.
-    // note: read(2) indicates file destriptor i/o is atomic linux since 3.14.
-    const uireader = ngui.stdout.?.reader();
-    const uiwriter = ngui.stdin.?.writer();
-    comm.initPipe(gpa, .{ .r = ngui.stdout.?, .w = ngui.stdin.? });
+    const uireader = uipipe.reader();
+    const uiwriter = uipipe.writer();
+    comm.initPipe(memacct.tagged(.comm, allocprof.tagged(.comm, gpa)), uipipe);
 
     // send UI a ping right away to make sure pipes are working, crash otherwise.
     comm.pipeWrite(.ping) catch |err| {
         logger.err("comm.write ping: {any}", .{err});
         return err;
     };
+    ngui_span.end();
+    const ngui_ms = startup.read() / time.ns_per_ms;
+
+    // holds -devnet paths; outlives nd.
+    var devnet_arena = std.heap.ArenaAllocator.init(gpa);
+    defer devnet_arena.deinit();
 
+    const init_span = trace.begin("daemon init");
     var nd = try Daemon.init(.{
         .allocator = gpa,
         .conf = conf,
         .uir = uireader,
         .uiw = uiwriter,
         .wpa = args.wpa.?,
+        // a crashed ngui is restarted without restarting nd.
+        .ui_spawner = ngui.spawner(),
+        .ui_shm = if (shm) |*s| s else null,
+        .cgroups = if (cgroups) |*cg| cg else null,
+        .cpufreq_root = "/",
+        .zram_root = "/",
+        .ibd_evict = args.ibd_evict,
+        .bitcoind_rest = args.bitcoind_rest,
+        .metrics_path = args.metrics,
+        .history_path = if (args.history.?.len > 0) args.history else null,
+        .forwards_path = if (args.forwards.?.len > 0) args.forwards else null,
+        .payments_path = if (args.payments.?.len > 0) args.payments else null,
+        .txhistory_path = if (args.txhistory.?.len > 0) args.txhistory else null,
+        .snapshot_path = if (args.reports.?.len > 0) args.reports else null,
+        .chanbackup_path = if (args.chanbackup.?.len > 0) args.chanbackup else null,
+        .subscribers_path = args.subscribe,
+        .bitcoind_conf_path = Config.BITCOIND_CONFIG_PATH,
+        .bitcoind_log_path = Config.BITCOIND_DEBUG_LOG_PATH,
+        .lnd_channeldb_path = Config.LND_CHANNELDB_PATH,
+        .utxo_snapshot = if (args.utxo_snapshot) |url| .{
+            .url = url,
+            .sha256 = try UtxoSnapshot.parseDigest(args.utxo_snapshot_sha256.?),
+            .path = Config.BITCOIND_UTXO_SNAPSHOT_PATH,
+        } else null,
     });
     defer nd.deinit();
+    if (args.devnet) |dir| {
+        try useDevnet(&nd, devnet_arena.allocator(), dir);
+    }
+    init_span.end();
+    const init_ms = startup.read() / time.ns_per_ms;
+    const start_span = trace.begin("daemon start");
     try nd.start();
+    start_span.end();
+    trace.flush();
+    logger.info("startup: config {d}ms, ngui {d}ms, daemon init {d}ms, started {d}ms", .{
+        conf_ms,
+        ngui_ms,
+        init_ms,
+        startup.read() / time.ns_per_ms,
+    });
 
     // graceful shutdown; see sigaction(2)
     const sa = posix.Sigaction{
@@ -226,6 +628,7 @@ pub fn main() !void {
     };
     try posix.sigaction(posix.SIG.INT, &sa, null);
     try posix.sigaction(posix.SIG.TERM, &sa, null);
+    try posix.sigaction(posix.SIG.USR1, &sa, null);
     sigquit.wait();
     logger.info("sigquit: terminating ...", .{});
 
@@ -234,6 +637,6 @@ pub fn main() !void {
     nd.stop();
     // once ngui exits, it'll close uireader/writer i/o from child proc
     // which lets the daemon's wait() to return.
-    _ = ngui.kill() catch |err| logger.err("ngui.kill: {any}", .{err});
+    ngui.stop();
     nd.wait();
 }
@@ -0,0 +1,141 @@
+//! follows bitcoind debug.log for startup progress while its RPC is in warmup,
+//! when bitcoind answers nothing but "in warmup" for up to tens of minutes.
+//! each poll reads only what was appended since the previous one, resuming
+//! at a saved offset.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+path: []const u8,
+/// where the next poll resumes; null until the file is first read.
+offset: ?u64 = null,
+/// startup progress as of the last line read.
+status: Status = .{},
+
+const BitcoindLogTail = @This();
+
+/// bytes read back from the end of the file on first poll or after rotation,
+/// and at most in a single poll: older lines are only history.
+const max_backlog = 64 * 1024;
+
+pub const Status = struct {
+    /// the latest bitcoind init message, such as "Loading block index…".
+    phase: std.BoundedArray(u8, 64) = .{},
+    /// percentage completed of the phase, if it reports one.
+    progress: ?u8 = null,
+};
+
+/// reads lines appended since the last poll and returns the startup status.
+pub fn poll(self: *BitcoindLogTail) !Status {
+    const file = try std.fs.cwd().openFile(self.path, .{});
+    defer file.close();
+    const size = (try file.stat()).size;
+    var pos: u64 = 0;
+    var skip_partial = false;
+    // start over once the file shrinks, as on rotation, or fell far behind.
+    const resume_ok = if (self.offset) |off| off <= size and size - off <= max_backlog else false;
+    if (resume_ok) {
+        pos = self.offset.?;
+    } else if (size > max_backlog) {
+        pos = size - max_backlog;
+        skip_partial = true; // likely in the middle of a line
+    }
+
+    var buf: [16 * 1024]u8 = undefined;
+    while (pos < size) {
+        const n = try file.preadAll(&buf, pos);
+        if (n == 0) {
+            break;
+        }
+        var chunk = buf[0..n];
+        // only complete lines are consumed; the rest is read again next time.
+        const end = std.mem.lastIndexOfScalar(u8, chunk, '\n') orelse {
+            if (n < buf.len) {
+                break;
+            }
+            pos += n; // a line longer than buf: drop it
+            skip_partial = true;
+            continue;
+        };
+        chunk = chunk[0..end];
+        pos += end + 1;
+        var it = std.mem.splitScalar(u8, chunk, '\n');
+        if (skip_partial) {
+            _ = it.next();
+            skip_partial = false;
+        }
+        while (it.next()) |line| {
+            self.parseLine(line);
+        }
+    }
+    self.offset = pos;
+    return self.status;
+}
+
+fn parseLine(self: *BitcoindLogTail, line: []const u8) void {
+    if (std.mem.indexOf(u8, line, "Bitcoin Core version") != null) {
+        // a new bitcoind process.
+        self.status = .{};
+        self.status.phase.appendSliceAssumeCapacity("starting");
+        return;
+    }
+    const init_mark = "init message: ";
+    if (std.mem.indexOf(u8, line, init_mark)) |i| {
+        const msg = line[i + init_mark.len ..];
+        self.status.phase.len = 0;
+        self.status.phase.appendSliceAssumeCapacity(msg[0..@min(msg.len, self.status.phase.capacity())]);
+        self.status.progress = null;
+        return;
+    }
+    const progress_mark = "Verification progress: ";
+    if (std.mem.indexOf(u8, line, progress_mark)) |i| {
+        const rest = line[i + progress_mark.len ..];
+        const end = std.mem.indexOfScalar(u8, rest, '%') orelse return;
+        self.status.progress = std.fmt.parseUnsigned(u8, rest[0..end], 10) catch return;
+    }
+}
+
+test "bitcoind log tail" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const path = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(path);
+    const logpath = try std.fs.path.join(t.allocator, &.{ path, "debug.log" });
+    defer t.allocator.free(logpath);
+
+    const file = try tmp.dir.createFile("debug.log", .{});
+    defer file.close();
+    try file.writeAll(
+        \\2024-05-01T10:00:00Z Bitcoin Core version v27.0.0 (release build)
+        \\2024-05-01T10:00:01Z init message: Loading block index…
+        \\2024-05-01T10:00:02Z Opening LevelDB in /ssd/bitcoind/mainnet/blocks/index
+        \\
+    );
+    var tail = BitcoindLogTail{ .path = logpath };
+    var st = try tail.poll();
+    try t.expectEqualStrings("Loading block index…", st.phase.constSlice());
+    try t.expectEqual(@as(?u8, null), st.progress);
+
+    // a partial line is read once complete.
+    try file.writeAll("2024-05-01T10:01:00Z init message: Verifying blocks…\n2024-05-01T10:01:01Z Verification progress: 5");
+    st = try tail.poll();
+    try t.expectEqualStrings("Verifying blocks…", st.phase.constSlice());
+    try t.expectEqual(@as(?u8, null), st.progress);
+    try file.writeAll("0%\n");
+    st = try tail.poll();
+    try t.expectEqual(@as(?u8, 50), st.progress);
+
+    // nothing new.
+    st = try tail.poll();
+    try t.expectEqual(@as(?u8, 50), st.progress);
+
+    // rotated: a new process starts over.
+    try file.setEndPos(0);
+    try file.seekTo(0);
+    try file.writeAll("2024-05-02T08:00:00Z Bitcoin Core version v27.0.0 (release build)\n");
+    st = try tail.poll();
+    try t.expectEqualStrings("starting", st.phase.constSlice());
+    try t.expectEqual(@as(?u8, null), st.progress);
+}
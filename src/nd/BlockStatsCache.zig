@@ -0,0 +1,231 @@
+//! stats of recent blocks, keyed by block hash, for the recent blocks list
+//! of onchain reports. the stats of a block never change: each is fetched
+//! once with getblockstats, so that a new tip costs a single lookup.
+//! entries also keep the parent hash, to walk back from the tip without
+//! asking bitcoind. a reorg needs no special handling: the new tip, or one of
+//! its parents, shows as a hash which is not cached yet.
+//! with the bitcoind REST interface, a run of missing blocks is fetched in
+//! three requests rather than one batch each: the headers from the oldest
+//! block onwards, then the stats of all at once.
+//! the least recently used entries are evicted first.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+const bitcoindrpc = @import("../bitcoindrpc.zig");
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+
+const logger = std.log.scoped(.blockstats);
+
+allocator: std.mem.Allocator,
+capacity: usize, // max number of entries
+map: std.AutoHashMapUnmanaged(types.Hash, Entry) = .{},
+/// incremented on each lookup, to order entries by their last use.
+tick: u64 = 0,
+
+const BlockStatsCache = @This();
+
+pub const BlockStats = comm.Message.OnchainReport.BlockStats;
+
+const Entry = struct {
+    stats: BlockStats,
+    prev: ?types.Hash, // null for the genesis block
+    used: u64, // tick of the last lookup
+};
+
+/// the capacity is best kept a few entries above the number of blocks
+/// requested from recent, to keep blocks replaced by a reorg from evicting
+/// those still in the chain.
+pub fn init(allocator: std.mem.Allocator, capacity: usize) BlockStatsCache {
+    return .{ .allocator = allocator, .capacity = capacity };
+}
+
+pub fn deinit(self: *BlockStatsCache) void {
+    self.map.deinit(self.allocator);
+}
+
+/// returns the stats of a block and its parent hash, if cached.
+pub fn get(self: *BlockStatsCache, hash: types.Hash) ?struct { stats: BlockStats, prev: ?types.Hash } {
+    const e = self.map.getPtr(hash) orelse return null;
+    self.tick += 1;
+    e.used = self.tick;
+    return .{ .stats = e.stats, .prev = e.prev };
+}
+
+/// stores the stats of a block, evicting the least recently used entry if full.
+pub fn put(self: *BlockStatsCache, hash: types.Hash, stats: BlockStats, prev: ?types.Hash) !void {
+    if (!self.map.contains(hash) and self.map.count() >= self.capacity) {
+        var oldest: ?types.Hash = null;
+        var oldest_used: u64 = std.math.maxInt(u64);
+        var it = self.map.iterator();
+        while (it.next()) |kv| {
+            if (kv.value_ptr.used < oldest_used) {
+                oldest = kv.key_ptr.*;
+                oldest_used = kv.value_ptr.used;
+            }
+        }
+        if (oldest) |h| {
+            _ = self.map.remove(h);
+        }
+    }
+    self.tick += 1;
+    try self.map.put(self.allocator, hash, .{ .stats = stats, .prev = prev, .used = self.tick });
+}
+
+/// max number of blocks fetched by prefetch at once.
+const max_prefetch = 16;
+
+/// fills out with the stats of the blocks from tip at height back, newest
+/// first, and returns the filled part. blocks missing from the cache are
+/// fetched from bitcoind. a failed fetch ends the list early, unless it's the tip.
+pub fn recent(self: *BlockStatsCache, client: *bitcoindrpc.Client, tip: types.Hash, height: u64, out: []BlockStats) ![]BlockStats {
+    var n: usize = 0;
+    var next: ?types.Hash = tip;
+    var use_rest = client.rest;
+    while (n < out.len) : (n += 1) {
+        const hash = next orelse break;
+        if (self.get(hash)) |c| {
+            out[n] = c.stats;
+            next = c.prev;
+            continue;
+        }
+        if (use_rest and out.len - n > 1) {
+            self.prefetch(client, hash, height -| n, out.len - n) catch |err| {
+                logger.info("prefetch {}: {!}", .{ hash, err });
+                use_rest = false; // no second try in the same walk
+            };
+            if (self.get(hash)) |c| {
+                out[n] = c.stats;
+                next = c.prev;
+                continue;
+            }
+        }
+        const e = fetch(client, hash) catch |err| {
+            if (n == 0) {
+                return err;
+            }
+            logger.info("getblockstats {}: {!}", .{ hash, err });
+            break;
+        };
+        try self.put(hash, e.stats, e.prev);
+        out[n] = e.stats;
+        next = e.prev;
+    }
+    return out[0..n];
+}
+
+/// caches the stats of the block hash at height and up to count-1 of its
+/// parents, over REST and a single callMany. nothing is cached if the headers
+/// from the oldest block don't lead up to hash, as in a reorg in between.
+fn prefetch(self: *BlockStatsCache, client: *bitcoindrpc.Client, hash: types.Hash, height: u64, count: usize) !void {
+    const n: usize = @intCast(@min(count, max_prefetch, height + 1));
+    const oldest = try client.restBlockHash(height + 1 - n);
+    var headers: [max_prefetch]bitcoindrpc.RawBlockHeader = undefined;
+    const got = try client.restHeaders(oldest, headers[0..n]);
+    if (got.len != n or !std.meta.eql(got[n - 1].hash, hash)) {
+        return error.ChainMismatch;
+    }
+    var hexes: [max_prefetch][types.Hash.hex_len]u8 = undefined;
+    var args: [max_prefetch]bitcoindrpc.Client.MethodArgs(.getblockstats) = undefined;
+    for (got, 0..) |h, i| {
+        hexes[i] = h.hash.hex();
+        args[i] = .{ .hash_or_height = &hexes[i] };
+    }
+    const res = try client.callMany(.getblockstats, args[0..n]);
+    defer res.deinit();
+    for (got, res.value) |h, v| {
+        const s = v catch |err| {
+            logger.info("getblockstats {}: {!}", .{ h.hash, err });
+            continue;
+        };
+        try self.put(h.hash, statsOf(s), h.parent());
+    }
+}
+
+/// fetches block stats and the parent hash in a single batch.
+fn fetch(client: *bitcoindrpc.Client, hash: types.Hash) !struct { stats: BlockStats, prev: ?types.Hash } {
+    const hex = hash.hex();
+    const res = try client.callBatch(&.{ .getblockstats, .getblockheader }, .{
+        .{ .hash_or_height = &hex },
+        .{ .blockhash = &hex },
+    });
+    defer res.deinit();
+    const s = try res.value[0];
+    const h = try res.value[1];
+    return .{ .stats = statsOf(s), .prev = h.previousblockhash };
+}
+
+fn statsOf(s: bitcoindrpc.BlockStats) BlockStats {
+    return .{
+        .height = s.height,
+        .time = s.time,
+        .txs = s.txs,
+        .minfeerate = s.minfeerate,
+        .maxfeerate = s.maxfeerate,
+        .size = s.total_size,
+    };
+}
+
+test "block stats cache" {
+    const t = std.testing;
+
+    var cache = BlockStatsCache.init(t.allocator, 2);
+    defer cache.deinit();
+    const h1 = types.Hash{ .bytes = [_]u8{1} ** 32 };
+    const h2 = types.Hash{ .bytes = [_]u8{2} ** 32 };
+    const h3 = types.Hash{ .bytes = [_]u8{3} ** 32 };
+    const stats = BlockStats{ .height = 1, .time = 1700000000, .txs = 3000, .minfeerate = 1, .maxfeerate = 500, .size = 1500000 };
+
+    try cache.put(h1, stats, null);
+    try cache.put(h2, .{ .height = 2, .time = 0, .txs = 1, .minfeerate = 0, .maxfeerate = 0, .size = 0 }, h1);
+    try t.expectEqual(@as(?types.Hash, null), cache.get(h1).?.prev);
+    try t.expectEqual(@as(u64, 3000), cache.get(h1).?.stats.txs);
+
+    // h2 is the least recently used.
+    try cache.put(h3, stats, h2);
+    try t.expect(cache.get(h2) == null);
+    try t.expect(cache.get(h1) != null);
+    try t.expectEqual(@as(?types.Hash, h2), cache.get(h3).?.prev);
+
+    // replacing an entry evicts nothing.
+    try cache.put(h3, stats, h1);
+    try t.expectEqual(@as(usize, 2), cache.map.count());
+    try t.expectEqual(@as(?types.Hash, h1), cache.get(h3).?.prev);
+}
+
+test "recent blocks" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    const srv = try tt.MockRpcServer.start(t.allocator, .bitcoind);
+    defer srv.stop();
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    try tmp.dir.writeFile("cookie", "__cookie__:secret");
+    var client = bitcoindrpc.Client{
+        .allocator = t.allocator,
+        .cookiepath = try tmp.join(&.{"cookie"}),
+        .port = srv.port(),
+        .keepalive = true,
+        .rest = true,
+    };
+    defer client.deinit();
+
+    var cache = BlockStatsCache.init(t.allocator, 10);
+    defer cache.deinit();
+    var out: [6]BlockStats = undefined;
+    // mock headers don't hash to the mock block hashes: a run of missing
+    // blocks is fetched one by one, as without REST.
+    const tip = types.Hash.literal("00000000000000000000000000000000000000000000000000000000000c3500");
+    const got = try cache.recent(&client, tip, 800000, &out);
+    try t.expectEqual(@as(usize, 6), got.len);
+    try t.expectEqual(@as(u64, 800000), got[0].height);
+    try t.expectEqual(@as(u64, 799995), got[5].height);
+
+    // all cached now.
+    client.rest = false;
+    const nreq = srv.nreq.load(.monotonic);
+    _ = try cache.recent(&client, tip, 800000, &out);
+    try t.expectEqual(nreq, srv.nreq.load(.monotonic));
+}
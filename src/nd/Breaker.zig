@@ -0,0 +1,149 @@
+//! a circuit breaker of the report calls to a backend, bitcoind or lnd, which
+//! fail for as long as it's starting up, locked or otherwise unwell. closed,
+//! calls go through as usual. a failed call opens it: calls are held back for
+//! a backoff, doubled with each failure up to max_backoff_ns and jittered so
+//! that backends restarted together aren't retried in lockstep. once the
+//! backoff elapses, the breaker is half-open: a single cheap probe call tells
+//! whether the backend is back, closing the breaker, or opens it again.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+
+mu: std.Thread.Mutex = .{},
+/// all fields below are guarded by mu.
+state: State = .closed,
+failures: u32 = 0, // consecutive
+/// when the open breaker turns half-open, a Daemon.clock reading.
+until_ns: u64 = 0,
+min_backoff_ns: u64,
+max_backoff_ns: u64,
+prng: std.rand.DefaultPrng,
+
+const Breaker = @This();
+
+pub const State = enum { closed, open, half_open };
+
+pub const Action = union(enum) {
+    call, // closed: make the calls
+    probe, // half-open: make the probe call first
+    wait: u64, // open: ns until the next probe
+};
+
+/// backoff jitter, as a share of the backoff either way.
+const jitter_pct = 20;
+
+pub const InitOpt = struct {
+    min_backoff_ns: u64,
+    max_backoff_ns: u64,
+    seed: u64, // of the jitter
+};
+
+pub fn init(opt: InitOpt) Breaker {
+    return .{
+        .min_backoff_ns = opt.min_backoff_ns,
+        .max_backoff_ns = opt.max_backoff_ns,
+        .prng = std.rand.DefaultPrng.init(opt.seed),
+    };
+}
+
+/// returns what to do at now_ns, a monotonic clock reading. an open breaker
+/// past its backoff turns half-open.
+pub fn check(self: *Breaker, now_ns: u64) Action {
+    self.mu.lock();
+    defer self.mu.unlock();
+    switch (self.state) {
+        .closed => return .call,
+        .half_open => return .probe,
+        .open => {
+            if (now_ns < self.until_ns) {
+                return .{ .wait = self.until_ns - now_ns };
+            }
+            self.state = .half_open;
+            return .probe;
+        },
+    }
+}
+
+/// reports whether calls go through, with no probe first.
+pub fn closed(self: *Breaker) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    return self.state == .closed;
+}
+
+/// closes the breaker after a successful call or probe.
+/// reports whether it was open or half-open.
+pub fn success(self: *Breaker) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const was = self.state;
+    self.state = .closed;
+    self.failures = 0;
+    return was != .closed;
+}
+
+/// opens the breaker after a failed call or probe at now_ns, and returns
+/// the backoff in ns, at most cap_ns if set: a backend telling when to try
+/// again, such as bitcoind in warmup, is probed no later than that.
+pub fn failure(self: *Breaker, now_ns: u64, cap_ns: ?u64) u64 {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.failures +|= 1;
+    var backoff = self.min_backoff_ns;
+    var i: u32 = 1;
+    while (i < self.failures and backoff < self.max_backoff_ns) : (i += 1) {
+        backoff *|= 2;
+    }
+    backoff = @min(backoff, self.max_backoff_ns);
+    const spread = backoff / 100 * jitter_pct;
+    backoff = backoff - spread + self.prng.random().uintAtMost(u64, 2 * spread);
+    if (cap_ns) |v| {
+        backoff = @min(backoff, v);
+    }
+    self.state = .open;
+    self.until_ns = now_ns + backoff;
+    return backoff;
+}
+
+/// closes the breaker regardless, as when the backend is known to have
+/// changed: calls go through right away.
+pub fn reset(self: *Breaker) void {
+    _ = self.success();
+}
+
+test "breaker" {
+    const t = std.testing;
+    const s = std.time.ns_per_s;
+
+    var b = Breaker.init(.{ .min_backoff_ns = 1 * s, .max_backoff_ns = 8 * s, .seed = 1 });
+    try t.expectEqual(@as(Action, .call), b.check(0));
+    try t.expect(!b.success());
+    try t.expect(b.closed());
+
+    var backoff = b.failure(0, null);
+    try t.expect(backoff >= 800 * std.time.ns_per_ms and backoff <= 1200 * std.time.ns_per_ms);
+    try t.expectEqual(Action{ .wait = backoff - 100 }, b.check(100));
+    try t.expectEqual(@as(Action, .probe), b.check(backoff));
+    try t.expectEqual(State.half_open, b.state);
+    try t.expect(!b.closed());
+    try t.expectEqual(@as(Action, .probe), b.check(backoff + 1)); // a probe's due
+
+    // failed probes double the backoff, up to max.
+    var now: u64 = backoff;
+    var i: usize = 0;
+    while (i < 5) : (i += 1) {
+        backoff = b.failure(now, null);
+        now += backoff;
+        try t.expectEqual(@as(Action, .probe), b.check(now));
+    }
+    try t.expect(backoff >= 6400 * std.time.ns_per_ms and backoff <= 9600 * std.time.ns_per_ms);
+
+    try t.expect(b.success());
+    try t.expectEqual(@as(Action, .call), b.check(now));
+    try t.expect(b.failure(now, null) <= 1200 * std.time.ns_per_ms); // back to min
+    try t.expectEqual(@as(u64, 10), b.failure(now, 10));
+
+    b.reset();
+    try t.expectEqual(@as(Action, .call), b.check(now));
+}
@@ -0,0 +1,115 @@
+//! lnd static channel backup export to a file, typically on an SSD or a USB
+//! stick, to recover channel funds with should the node be lost.
+//! lnd hands over a new backup each time channels open or close; the file is
+//! replaced only if its content actually changed, so that restarts and repeated
+//! backups of the same channels cause no flash wear. writes are atomic and
+//! fsync'ed: the file is either the previous backup or the new one, even
+//! across a power loss.
+//!
+//! not safe for concurrent use.
+
+const std = @import("std");
+const posix = std.posix;
+const Sha256 = std.crypto.hash.sha2.Sha256;
+
+allocator: std.mem.Allocator,
+path: []const u8,
+/// content digest of the file as last read or written; null if unknown.
+digest: ?[Sha256.digest_length]u8 = null,
+
+const ChanBackup = @This();
+
+/// outcome of an update.
+pub const Export = struct {
+    written: bool, // false if the file already held the backup
+    size: u64, // backup bytes
+};
+
+/// path must outlive the returned value. the directory must exist: the file
+/// is never exported to a media which is not mounted.
+/// an existing file is read to skip rewriting the same backup after a restart.
+pub fn init(allocator: std.mem.Allocator, path: []const u8) ChanBackup {
+    return .{ .allocator = allocator, .path = path, .digest = fileDigest(path) catch null };
+}
+
+/// writes the backup b64, base64-encoded as in lnd API responses, to the file
+/// unless that's what it already holds.
+pub fn update(self: *ChanBackup, b64: []const u8) !Export {
+    const dec = std.base64.standard.Decoder;
+    const data = try self.allocator.alloc(u8, try dec.calcSizeForSlice(b64));
+    defer self.allocator.free(data);
+    try dec.decode(data, b64);
+    if (data.len == 0) {
+        return error.ChanBackupEmpty;
+    }
+    var digest: [Sha256.digest_length]u8 = undefined;
+    Sha256.hash(data, &digest, .{});
+    if (self.digest != null and std.mem.eql(u8, &self.digest.?, &digest)) {
+        return .{ .written = false, .size = data.len };
+    }
+    self.digest = null; // a failed write leaves the file unknown
+    try writeFile(self.path, data);
+    self.digest = digest;
+    return .{ .written = true, .size = data.len };
+}
+
+fn fileDigest(path: []const u8) ![Sha256.digest_length]u8 {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+    var h = Sha256.init(.{});
+    var buf: [16 * 1024]u8 = undefined;
+    while (true) {
+        const n = try file.read(&buf);
+        if (n == 0) {
+            break;
+        }
+        h.update(buf[0..n]);
+    }
+    return h.finalResult();
+}
+
+/// atomically replaces the file at path with data, syncing both the file
+/// and the directory entry of the rename to disk.
+fn writeFile(path: []const u8, data: []const u8) !void {
+    var dir = try std.fs.cwd().openDir(std.fs.path.dirname(path) orelse ".", .{});
+    defer dir.close();
+    var af = try dir.atomicFile(std.fs.path.basename(path), .{ .mode = 0o600 });
+    defer af.deinit();
+    try af.file.writeAll(data);
+    try af.file.sync();
+    try af.finish();
+    try posix.fsync(dir.fd);
+}
+
+test "chan backup" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "channel.backup" });
+    defer t.allocator.free(path);
+
+    var cb = ChanBackup.init(t.allocator, path);
+    try t.expect(cb.digest == null);
+    try t.expectEqual(Export{ .written = true, .size = 6 }, try cb.update("YmFja3Vw")); // "backup"
+    try t.expectEqual(Export{ .written = false, .size = 6 }, try cb.update("YmFja3Vw"));
+    var buf: [16]u8 = undefined;
+    try t.expectEqualStrings("backup", try tmp.dir.readFile("channel.backup", &buf));
+
+    // an unchanged file is left as is across restarts.
+    cb = ChanBackup.init(t.allocator, path);
+    try t.expectEqual(Export{ .written = false, .size = 6 }, try cb.update("YmFja3Vw"));
+    try t.expectEqual(Export{ .written = true, .size = 7 }, try cb.update("YmFja3VwMg==")); // "backup2"
+    try t.expectEqualStrings("backup2", try tmp.dir.readFile("channel.backup", &buf));
+
+    try t.expectError(error.ChanBackupEmpty, cb.update(""));
+    try t.expectError(error.InvalidCharacter, cb.update("!!!!"));
+
+    // no media mounted at the directory.
+    const missing = try std.fs.path.join(t.allocator, &.{ dir, "usb", "channel.backup" });
+    defer t.allocator.free(missing);
+    var nodir = ChanBackup.init(t.allocator, missing);
+    try t.expectError(error.FileNotFound, nodir.update("YmFja3Vw"));
+}
@@ -0,0 +1,147 @@
+//! lightning channel details from the lnd graph, with time-based expiry.
+//! routing policies are left out of lightning reports; ngui asks for those of
+//! a single channel on demand instead, and the daemon fills this cache with
+//! getchaninfo and getnodeinfo of the peer on a miss. entries live for the
+//! ttl, or until channel events from lnd drop them all.
+//! safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+
+const Info = comm.Message.LightningChannelDetail.Info;
+
+allocator: std.mem.Allocator,
+ttl: i64, // entry lifetime, in milliseconds
+
+/// guards all fields below.
+mu: std.Thread.Mutex = .{},
+/// keyed by short channel id.
+map: std.AutoHashMapUnmanaged(u64, Entry) = .{},
+
+const ChanInfoCache = @This();
+
+/// a detail view shows one channel at a time: a few entries suffice for
+/// going back and forth between channels.
+pub const max_entries = 32;
+
+const Entry = struct {
+    arena: std.heap.ArenaAllocator.State, // holds info
+    info: Info,
+    expires: i64, // ms timestamp
+};
+
+/// ttl is the entry lifetime in milliseconds.
+pub fn init(allocator: std.mem.Allocator, ttl: i64) ChanInfoCache {
+    return .{ .allocator = allocator, .ttl = ttl };
+}
+
+pub fn deinit(self: *ChanInfoCache) void {
+    self.clear();
+    self.map.deinit(self.allocator);
+}
+
+/// returns the info of channel id dup'ed using the allocator, or null if
+/// unknown or expired.
+pub fn get(self: *ChanInfoCache, allocator: std.mem.Allocator, id: u64, now: i64) !?Info {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const e = self.map.get(id) orelse return null;
+    if (e.expires <= now) {
+        return null;
+    }
+    return try comm.dupeDeep(Info, allocator, e.info);
+}
+
+/// stores a copy of channel id info fetched at now, replacing any.
+/// expired entries are evicted, and the one expiring first if still full.
+pub fn put(self: *ChanInfoCache, id: u64, info: Info, now: i64) !void {
+    var arena = std.heap.ArenaAllocator.init(self.allocator);
+    errdefer arena.deinit();
+    const dup = try comm.dupeDeep(Info, arena.allocator(), info);
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.removeLocked(id);
+    self.evictLocked(now);
+    try self.map.put(self.allocator, id, .{ .arena = arena.state, .info = dup, .expires = now + self.ttl });
+}
+
+/// drops all entries, such as when the channel graph changed.
+pub fn clear(self: *ChanInfoCache) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    var it = self.map.valueIterator();
+    while (it.next()) |e| {
+        e.arena.promote(self.allocator).deinit();
+    }
+    self.map.clearRetainingCapacity();
+}
+
+/// caller holds self.mu.
+fn removeLocked(self: *ChanInfoCache, id: u64) void {
+    const kv = self.map.fetchRemove(id) orelse return;
+    kv.value.arena.promote(self.allocator).deinit();
+}
+
+/// makes room for a new entry. caller holds self.mu.
+fn evictLocked(self: *ChanInfoCache, now: i64) void {
+    var expired: std.BoundedArray(u64, max_entries) = .{};
+    var first: ?u64 = null; // expiring first
+    var first_at: i64 = std.math.maxInt(i64);
+    var it = self.map.iterator();
+    while (it.next()) |kv| {
+        if (kv.value_ptr.expires <= now) {
+            expired.append(kv.key_ptr.*) catch {};
+        } else if (kv.value_ptr.expires < first_at) {
+            first = kv.key_ptr.*;
+            first_at = kv.value_ptr.expires;
+        }
+    }
+    for (expired.constSlice()) |id| {
+        self.removeLocked(id);
+    }
+    if (self.map.count() >= max_entries) {
+        if (first) |id| {
+            self.removeLocked(id);
+        }
+    }
+}
+
+test "chan info cache" {
+    const t = std.testing;
+    var cache = ChanInfoCache.init(t.allocator, 100);
+    defer cache.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    var info: Info = .{
+        .capacity = 1_000_000,
+        .last_update = 1700000000,
+        .local = .{ .base_fee = 1000, .fee_ppm = 100, .timelock_delta = 80, .min_htlc = 1000, .max_htlc = 990_000_000, .disabled = false, .last_update = 1700000000 },
+        .remote = null,
+        .peer = .{ .pubkey = "03ef", .alias = "peer", .num_channels = 12, .total_capacity = 50_000_000 },
+    };
+    try t.expect(try cache.get(arena, 1, 10) == null);
+    try cache.put(1, info, 10);
+    info.peer.alias = "other";
+    const got = (try cache.get(arena, 1, 50)).?;
+    try t.expectEqualStrings("peer", got.peer.alias);
+    try t.expectEqual(@as(i64, 100), got.local.?.fee_ppm);
+    try t.expect(got.remote == null);
+    try t.expect(try cache.get(arena, 1, 110) == null); // expired
+
+    // a full cache evicts the entry expiring first.
+    for (0..max_entries) |i| {
+        try cache.put(100 + i, info, @intCast(200 + i));
+    }
+    try t.expectEqual(@as(u32, max_entries), cache.map.count());
+    try cache.put(1, info, 250);
+    try t.expectEqual(@as(u32, max_entries), cache.map.count());
+    try t.expect(try cache.get(arena, 100, 250) == null);
+    try t.expect(try cache.get(arena, 101, 250) != null);
+    try t.expect(try cache.get(arena, 1, 250) != null);
+
+    cache.clear();
+    try t.expect(try cache.get(arena, 1, 250) == null);
+}
@@ -0,0 +1,230 @@
+//! lightning network channel graph topology in a compact adjacency form, for
+//! statistics which would take a full describegraph to compute otherwise.
+//! bootstrapped from a single describegraph read a channel at a time, then
+//! kept up to date by the lnd graph topology stream.
+//!
+//! nodes are numbered on first sight and never removed: a node of no channels
+//! only stays in a degree histogram bucket of its own. capacity and degree
+//! distributions are updated with each change; reachability from the own node
+//! takes a breadth-first walk, run only when stats are taken.
+//! not safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+
+const Stats = comm.Message.LightningGraph;
+
+allocator: std.mem.Allocator,
+node_ids: std.AutoHashMapUnmanaged([33]u8, u32) = .{},
+/// indexed by node id.
+nodes: std.ArrayListUnmanaged(Node) = .{},
+chans: std.AutoHashMapUnmanaged(u64, Chan) = .{},
+capacity_sat: u64 = 0,
+/// channels by capacity; see Stats.capacity_bounds.
+capacity_dist: [Stats.capacity_bounds.len + 1]u32 = [_]u32{0} ** (Stats.capacity_bounds.len + 1),
+/// nodes by number of channels, the last bucket for max_degree and more.
+degree_dist: [max_degree + 1]u32 = [_]u32{0} ** (max_degree + 1),
+
+const ChannelGraph = @This();
+
+/// beyond which nodes aren't told apart by the number of channels.
+const max_degree = 4096;
+
+const Node = struct {
+    /// a node id per channel, parallel channels included.
+    peers: std.ArrayListUnmanaged(u32) = .{},
+};
+
+const Chan = struct {
+    node1: u32,
+    node2: u32,
+    capacity: u64, // sats
+};
+
+pub fn init(allocator: std.mem.Allocator) ChannelGraph {
+    return .{ .allocator = allocator };
+}
+
+pub fn deinit(self: *ChannelGraph) void {
+    for (self.nodes.items) |*n| {
+        n.peers.deinit(self.allocator);
+    }
+    self.nodes.deinit(self.allocator);
+    self.node_ids.deinit(self.allocator);
+    self.chans.deinit(self.allocator);
+}
+
+/// removes all nodes and channels, as before a new bootstrap.
+pub fn clear(self: *ChannelGraph) void {
+    self.deinit();
+    self.* = init(self.allocator);
+}
+
+/// returns the id of a node, adding it if unknown.
+pub fn addNode(self: *ChannelGraph, pubkey: types.PubKey) !u32 {
+    const res = try self.node_ids.getOrPut(self.allocator, pubkey.bytes);
+    if (!res.found_existing) {
+        errdefer self.node_ids.removeByPtr(res.key_ptr);
+        res.value_ptr.* = @intCast(self.nodes.items.len);
+        try self.nodes.append(self.allocator, .{});
+        self.degree_dist[0] += 1;
+    }
+    return res.value_ptr.*;
+}
+
+/// adds a channel or updates its capacity.
+pub fn upsertChannel(self: *ChannelGraph, chan_id: u64, node1: types.PubKey, node2: types.PubKey, capacity: u64) !void {
+    if (self.chans.getPtr(chan_id)) |ch| {
+        self.countCapacity(ch.capacity, .remove);
+        ch.capacity = capacity;
+        self.countCapacity(capacity, .add);
+        return;
+    }
+    const n1 = try self.addNode(node1);
+    const n2 = try self.addNode(node2);
+    try self.chans.ensureUnusedCapacity(self.allocator, 1);
+    try self.nodes.items[n1].peers.ensureUnusedCapacity(self.allocator, 1);
+    try self.nodes.items[n2].peers.ensureUnusedCapacity(self.allocator, 1);
+    self.chans.putAssumeCapacity(chan_id, .{ .node1 = n1, .node2 = n2, .capacity = capacity });
+    self.linkPeer(n1, n2);
+    self.linkPeer(n2, n1);
+    self.countCapacity(capacity, .add);
+}
+
+/// removes a closed channel; unknown ones are ignored.
+pub fn removeChannel(self: *ChannelGraph, chan_id: u64) void {
+    const kv = self.chans.fetchRemove(chan_id) orelse return;
+    self.unlinkPeer(kv.value.node1, kv.value.node2);
+    self.unlinkPeer(kv.value.node2, kv.value.node1);
+    self.countCapacity(kv.value.capacity, .remove);
+}
+
+fn linkPeer(self: *ChannelGraph, n: u32, peer: u32) void {
+    const peers = &self.nodes.items[n].peers;
+    self.moveDegree(peers.items.len, peers.items.len + 1);
+    peers.appendAssumeCapacity(peer);
+}
+
+fn unlinkPeer(self: *ChannelGraph, n: u32, peer: u32) void {
+    const peers = &self.nodes.items[n].peers;
+    const i = std.mem.indexOfScalar(u32, peers.items, peer) orelse return;
+    self.moveDegree(peers.items.len, peers.items.len - 1);
+    _ = peers.swapRemove(i);
+}
+
+fn moveDegree(self: *ChannelGraph, from: usize, to: usize) void {
+    self.degree_dist[@min(from, max_degree)] -= 1;
+    self.degree_dist[@min(to, max_degree)] += 1;
+}
+
+fn countCapacity(self: *ChannelGraph, capacity: u64, op: enum { add, remove }) void {
+    const b = for (Stats.capacity_bounds, 0..) |bound, i| {
+        if (capacity < bound) break i;
+    } else Stats.capacity_bounds.len;
+    switch (op) {
+        .add => {
+            self.capacity_sat += capacity;
+            self.capacity_dist[b] += 1;
+        },
+        .remove => {
+            self.capacity_sat -|= capacity;
+            self.capacity_dist[b] -|= 1;
+        },
+    }
+}
+
+/// returns the graph statistics as seen from the own node, if known.
+/// scratch is used for the reachability walk and freed before return.
+pub fn stats(self: *const ChannelGraph, scratch: std.mem.Allocator, own: ?types.PubKey) !Stats {
+    var res = Stats{
+        .nodes = @intCast(self.nodes.items.len - self.degree_dist[0]),
+        .channels = self.chans.count(),
+        .capacity_sat = self.capacity_sat,
+        .capacity_dist = self.capacity_dist,
+    };
+    const pk = own orelse return res;
+    const start = self.node_ids.get(pk.bytes) orelse return res;
+    const degree = self.nodes.items[start].peers.items.len;
+    res.own_channels = @intCast(degree);
+    res.own_rank = 1;
+    for (self.degree_dist[@min(degree, max_degree) + 1 ..]) |n| {
+        res.own_rank += n;
+    }
+
+    // breadth-first walk from the own node, over channels either way.
+    const hops = try scratch.alloc(u16, self.nodes.items.len);
+    defer scratch.free(hops);
+    @memset(hops, std.math.maxInt(u16));
+    var queue = try std.ArrayList(u32).initCapacity(scratch, self.nodes.items.len);
+    defer queue.deinit();
+    hops[start] = 0;
+    queue.appendAssumeCapacity(start);
+    var head: usize = 0;
+    var hops_sum: u64 = 0;
+    while (head < queue.items.len) : (head += 1) {
+        const n = queue.items[head];
+        for (self.nodes.items[n].peers.items) |peer| {
+            if (hops[peer] != std.math.maxInt(u16)) {
+                continue;
+            }
+            hops[peer] = hops[n] + 1;
+            hops_sum += hops[peer];
+            queue.appendAssumeCapacity(peer);
+        }
+    }
+    res.reachable = @intCast(queue.items.len - 1);
+    if (res.reachable > 0) {
+        res.avg_hops = @floatCast(@as(f64, @floatFromInt(hops_sum)) / @as(f64, @floatFromInt(res.reachable)));
+    }
+    return res;
+}
+
+test "channel graph" {
+    const t = std.testing;
+
+    var g = ChannelGraph.init(t.allocator);
+    defer g.deinit();
+    const own = types.PubKey{ .bytes = [_]u8{3} ** 33 };
+    const a = types.PubKey{ .bytes = [_]u8{2} ++ [_]u8{0xa} ** 32 };
+    const b = types.PubKey{ .bytes = [_]u8{2} ++ [_]u8{0xb} ** 32 };
+    const c = types.PubKey{ .bytes = [_]u8{2} ++ [_]u8{0xc} ** 32 };
+    const lonely = types.PubKey{ .bytes = [_]u8{2} ++ [_]u8{0xd} ** 32 };
+
+    _ = try g.addNode(lonely);
+    try g.upsertChannel(1, own, a, 500_000);
+    try g.upsertChannel(2, a, b, 2_000_000);
+    try g.upsertChannel(3, a, b, 2_000_000); // parallel
+    try g.upsertChannel(4, b, c, 60_000_000);
+    try g.upsertChannel(4, b, c, 70_000_000); // update
+
+    var s = try g.stats(t.allocator, own);
+    try t.expectEqual(@as(u32, 4), s.nodes);
+    try t.expectEqual(@as(u32, 4), s.channels);
+    try t.expectEqual(@as(u64, 74_500_000), s.capacity_sat);
+    try t.expectEqual([_]u32{ 0, 1, 2, 0, 0, 1 }, s.capacity_dist);
+    try t.expectEqual(@as(u32, 3), s.reachable);
+    try t.expectEqual(@as(f32, 2), s.avg_hops); // 1 + 2 + 3
+    try t.expectEqual(@as(u32, 1), s.own_channels);
+    try t.expectEqual(@as(u32, 3), s.own_rank); // a and b have more
+
+    g.removeChannel(2);
+    g.removeChannel(1);
+    g.removeChannel(1); // unknown
+    s = try g.stats(t.allocator, own);
+    try t.expectEqual(@as(u32, 3), s.nodes);
+    try t.expectEqual(@as(u32, 2), s.channels);
+    try t.expectEqual(@as(u32, 0), s.reachable);
+    try t.expectEqual(@as(u32, 0), s.own_channels);
+    try t.expectEqual(@as(u32, 4), s.own_rank);
+
+    // the own node unknown to the graph.
+    s = try g.stats(t.allocator, types.PubKey{ .bytes = [_]u8{4} ** 33 });
+    try t.expectEqual(@as(u32, 0), s.own_rank);
+    try t.expectEqual(@as(u32, 2), s.channels);
+
+    g.clear();
+    s = try g.stats(t.allocator, null);
+    try t.expectEqual(@as(u32, 0), s.nodes);
+    try t.expectEqual(@as(u64, 0), s.capacity_sat);
+}
@@ -0,0 +1,251 @@
+//! the lightning channel set of the last report, served to ngui a page at a time.
+//! a view, a sort order and filter, is an index into the channel set built on
+//! first use and kept until the set changes: a page is then a slice of the index,
+//! at the same cost regardless of the number of channels.
+//! views of a search query are built on each page from the matches of
+//! the search index, kept up to date across channel sets; see ChannelSearch.
+//! safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+const ChannelSearch = @import("ChannelSearch.zig");
+
+const Channel = comm.Message.LightningChannel;
+const Query = comm.Message.LightningChannelsQuery;
+
+/// max number of channels in a page.
+pub const max_page = 100;
+
+mu: std.Thread.Mutex = .{},
+/// holds channels and views; reset when the channel set changes.
+arena: std.heap.ArenaAllocator,
+/// a copy of the current channel set, in lnd order.
+channels: []const Channel = &.{},
+/// hash of channels, to detect changes.
+hash: u64 = 0,
+/// channels indices in view order.
+views: std.AutoHashMapUnmanaged(View, []const u32) = .{},
+/// channels by peer alias, pubkey and id; updated along with channels.
+search: ChannelSearch,
+
+const ChannelIndex = @This();
+
+const View = struct {
+    sort: Query.Sort,
+    desc: bool,
+    filter: Query.Filter,
+};
+
+pub fn init(allocator: std.mem.Allocator) ChannelIndex {
+    return .{
+        .arena = std.heap.ArenaAllocator.init(allocator),
+        .search = ChannelSearch.init(allocator),
+    };
+}
+
+pub fn deinit(self: *ChannelIndex) void {
+    self.search.deinit();
+    self.arena.deinit();
+}
+
+/// replaces the channel set with a copy of channels, dropping all views.
+/// returns false and keeps the views if the set is unchanged.
+pub fn set(self: *ChannelIndex, channels: []const Channel) !bool {
+    var h = std.hash.Wyhash.init(0);
+    std.hash.autoHashStrat(&h, channels, .Deep);
+    const hash = h.final();
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (hash == self.hash and channels.len == self.channels.len) {
+        return false;
+    }
+    self.views = .{}; // allocated in the arena
+    self.channels = &.{};
+    self.hash = 0;
+    _ = self.arena.reset(.retain_capacity);
+    self.channels = try comm.dupeDeep([]const Channel, self.arena.allocator(), channels);
+    self.hash = hash;
+    try self.search.update(self.channels);
+    return true;
+}
+
+/// returns the page of channels for the query q, deep-copied with the
+/// allocator; an arena is best.
+pub fn page(self: *ChannelIndex, allocator: std.mem.Allocator, q: Query) !comm.Message.LightningChannelsPage {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const v: View = .{ .sort = q.sort, .desc = q.desc, .filter = q.filter };
+    const index = if (q.search.len == 0) try self.view(v) else try self.searchView(allocator, v, q.search);
+    const start = @min(q.offset, index.len);
+    const end = @min(start + @min(q.limit, max_page), index.len);
+    const out = try allocator.alloc(Channel, end - start);
+    for (index[start..end], out) |i, *ch| {
+        ch.* = try comm.dupeDeep(Channel, allocator, self.channels[i]);
+    }
+    var served = q;
+    served.offset = @intCast(start);
+    served.limit = @intCast(end - start);
+    return .{ .query = served, .total = @intCast(index.len), .channels = out };
+}
+
+/// returns the peer of the channel with the short channel id, or null if none
+/// in the current set.
+pub fn peerOf(self: *ChannelIndex, id: []const u8) ?types.PubKey {
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (self.channels) |ch| {
+        if (ch.id != null and std.mem.eql(u8, ch.id.?, id)) {
+            return ch.peer_pubkey;
+        }
+    }
+    return null;
+}
+
+/// returns the index of the view v, building it if needed. caller holds self.mu.
+fn view(self: *ChannelIndex, v: View) ![]const u32 {
+    const res = try self.views.getOrPut(self.arena.allocator(), v);
+    if (res.found_existing) {
+        return res.value_ptr.*;
+    }
+    errdefer self.views.removeByPtr(res.key_ptr);
+    var index = try std.ArrayList(u32).initCapacity(self.arena.allocator(), self.channels.len);
+    for (self.channels, 0..) |ch, i| {
+        if (matches(v.filter, ch)) {
+            index.appendAssumeCapacity(@intCast(i));
+        }
+    }
+    // stable: equal channels remain in lnd order, in both directions.
+    std.mem.sort(u32, index.items, SortContext{ .channels = self.channels, .view = v }, SortContext.lessThan);
+    res.value_ptr.* = index.items;
+    return index.items;
+}
+
+/// returns the index of the view v of channels matching the search text,
+/// allocated with the allocator. caller holds self.mu.
+fn searchView(self: *ChannelIndex, allocator: std.mem.Allocator, v: View, text: []const u8) ![]const u32 {
+    const found = try self.search.search(allocator, text);
+    var n: usize = 0;
+    for (found) |i| {
+        // the search index is behind after a failed set.
+        if (i < self.channels.len and matches(v.filter, self.channels[i])) {
+            found[n] = i;
+            n += 1;
+        }
+    }
+    std.mem.sort(u32, found[0..n], SortContext{ .channels = self.channels, .view = v }, SortContext.lessThan);
+    return found[0..n];
+}
+
+fn matches(f: Query.Filter, ch: Channel) bool {
+    return switch (f) {
+        .all => true,
+        .active => ch.state == .active,
+        .inactive => ch.state == .inactive,
+        .pending => ch.state == .pending_open or ch.state == .pending_close,
+    };
+}
+
+const SortContext = struct {
+    channels: []const Channel,
+    view: View,
+
+    fn lessThan(ctx: SortContext, a: u32, b: u32) bool {
+        const x = if (ctx.view.desc) ctx.channels[b] else ctx.channels[a];
+        const y = if (ctx.view.desc) ctx.channels[a] else ctx.channels[b];
+        return switch (ctx.view.sort) {
+            .none => if (ctx.view.desc) b < a else a < b,
+            .capacity => x.capacity < y.capacity,
+            .local_balance => x.balance.local < y.balance.local,
+            .fee_rate => x.fees.ppm < y.fees.ppm,
+            .fees_earned => x.fees.earned < y.fees.earned,
+            .inactive_first => stateRank(x.state) < stateRank(y.state),
+        };
+    }
+
+    fn stateRank(s: std.meta.FieldType(Channel, .state)) u8 {
+        return switch (s) {
+            .inactive => 0,
+            .pending_open, .pending_close => 1,
+            .active => 2,
+        };
+    }
+};
+
+test "channel index pages" {
+    const t = std.testing;
+
+    var idx = ChannelIndex.init(t.allocator);
+    defer idx.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    var chans: [5]Channel = undefined;
+    const states = [_]std.meta.FieldType(Channel, .state){ .active, .inactive, .active, .pending_open, .active };
+    for (&chans, 0..) |*ch, i| {
+        ch.* = .{
+            .id = null,
+            .state = states[i],
+            .private = false,
+            .point = .{ .txid = .{ .bytes = [_]u8{@intCast(i)} ** 32 }, .index = 0 },
+            .peer_pubkey = .{ .bytes = [_]u8{0} ** 33 },
+            .peer_alias = "peer",
+            .capacity = [_]i64{ 300, 100, 500, 200, 400 }[i],
+            .balance = .{ .local = @intCast(i), .remote = 0, .unsettled = 0, .limbo = 0 },
+            .totalsats = .{ .sent = 0, .received = 0 },
+            .fees = .{ .base = 0, .ppm = 0 },
+        };
+    }
+    try t.expect(try idx.set(&chans));
+    try t.expect(!try idx.set(&chans));
+
+    const p1 = try idx.page(arena, .{ .sort = .capacity, .desc = true, .offset = 1, .limit = 2 });
+    try t.expectEqual(@as(u32, 5), p1.total);
+    try t.expectEqual(@as(usize, 2), p1.channels.len);
+    try t.expectEqual(@as(i64, 400), p1.channels[0].capacity);
+    try t.expectEqual(@as(i64, 300), p1.channels[1].capacity);
+
+    const p2 = try idx.page(arena, .{ .filter = .active, .sort = .capacity, .offset = 2, .limit = 10 });
+    try t.expectEqual(@as(u32, 3), p2.total);
+    try t.expectEqual(@as(u32, 2), p2.query.offset);
+    try t.expectEqual(@as(u32, 1), p2.query.limit);
+    try t.expectEqual(@as(i64, 500), p2.channels[0].capacity);
+
+    const p3 = try idx.page(arena, .{ .sort = .inactive_first });
+    try t.expect(p3.channels[0].state == .inactive);
+    try t.expect(p3.channels[1].state == .pending_open);
+    // ties keep lnd order.
+    try t.expectEqual(@as(i64, 0), p3.channels[2].balance.local);
+    try t.expectEqual(@as(i64, 2), p3.channels[3].balance.local);
+
+    const p4 = try idx.page(arena, .{ .offset = 10 });
+    try t.expectEqual(@as(u32, 5), p4.total);
+    try t.expectEqual(@as(usize, 0), p4.channels.len);
+    try t.expectEqual(@as(u32, 5), p4.query.offset);
+
+    // a changed set drops the views.
+    chans[0].capacity = 1000;
+    try t.expect(try idx.set(&chans));
+    const p5 = try idx.page(arena, .{ .sort = .capacity, .desc = true, .limit = 1 });
+    try t.expectEqual(@as(i64, 1000), p5.channels[0].capacity);
+
+    chans[2].id = "869000000000000000";
+    chans[2].peer_pubkey = .{ .bytes = [_]u8{2} ** 33 };
+    try t.expect(try idx.set(&chans));
+    try t.expectEqual(@as(u8, 2), idx.peerOf("869000000000000000").?.bytes[0]);
+    try t.expect(idx.peerOf("1") == null);
+
+    // a search view, filtered and sorted as any other.
+    chans[4].peer_alias = "other";
+    try t.expect(try idx.set(&chans));
+    const p6 = try idx.page(arena, .{ .search = "PEE", .filter = .active, .sort = .capacity, .desc = true });
+    try t.expectEqual(@as(u32, 2), p6.total);
+    try t.expectEqualStrings("PEE", p6.query.search);
+    try t.expectEqual(@as(i64, 1000), p6.channels[0].capacity);
+    try t.expectEqual(@as(i64, 500), p6.channels[1].capacity);
+    const p7 = try idx.page(arena, .{ .search = "8690000" });
+    try t.expectEqual(@as(u32, 1), p7.total);
+    try t.expectEqual(@as(i64, 500), p7.channels[0].capacity);
+}
@@ -0,0 +1,298 @@
+//! a search index over channels by peer alias, peer pubkey and short channel
+//! id, for filtering the channel list as an operator types in a query.
+//! n-grams of up to 3 lowercased characters map to the channels containing
+//! them: a query of up to 3 characters is a single lookup, and a longer one
+//! the intersection of its trigrams, checked against the channels text.
+//! entries are keyed by funding point and updated in place across channel
+//! sets: only channels which appear, go or change their text are re-indexed.
+//! not safe for concurrent use; see ChannelIndex.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+
+const Channel = comm.Message.LightningChannel;
+
+/// longer queries are truncated.
+pub const max_query_len = comm.Message.LightningChannelsQuery.max_search_len;
+/// longer peer aliases are indexed by their prefix.
+const max_alias_len = 64;
+/// alias, pubkey and id joined with a separator: n-grams never span fields.
+const max_text_len = max_alias_len + 1 + types.PubKey.hex_len + 1 + 20;
+const sep = 0;
+const no_pos = std.math.maxInt(u32);
+
+allocator: std.mem.Allocator,
+/// slot ids by funding point.
+ids: std.AutoHashMapUnmanaged(types.OutPoint, u32) = .{},
+/// indexed channels, by slot id.
+slots: std.ArrayListUnmanaged(Slot) = .{},
+/// ids of unused slots.
+free_ids: std.ArrayListUnmanaged(u32) = .{},
+/// n-grams to slot ids, sorted ascending.
+grams: std.AutoHashMapUnmanaged(u32, std.ArrayListUnmanaged(u32)) = .{},
+/// incremented by update, to spot channels gone.
+generation: u64 = 0,
+
+const ChannelSearch = @This();
+
+const Slot = struct {
+    text: []u8 = &.{}, // lowercase; empty if unused
+    pos: u32 = no_pos, // channel set index as of the last update
+    seen: u64 = 0, // generation of the last update listing the channel
+};
+
+pub fn init(allocator: std.mem.Allocator) ChannelSearch {
+    return .{ .allocator = allocator };
+}
+
+pub fn deinit(self: *ChannelSearch) void {
+    self.clear();
+    self.ids.deinit(self.allocator);
+    self.slots.deinit(self.allocator);
+    self.free_ids.deinit(self.allocator);
+    self.grams.deinit(self.allocator);
+}
+
+/// drops all entries.
+pub fn clear(self: *ChannelSearch) void {
+    for (self.slots.items) |s| self.allocator.free(s.text);
+    var it = self.grams.valueIterator();
+    while (it.next()) |list| list.deinit(self.allocator);
+    self.ids.clearRetainingCapacity();
+    self.slots.clearRetainingCapacity();
+    self.free_ids.clearRetainingCapacity();
+    self.grams.clearRetainingCapacity();
+}
+
+/// brings the index in line with the channel set, indexing new and changed
+/// channels and dropping those gone. search results refer to channels
+/// by their index in the set. on error, the index is left empty.
+pub fn update(self: *ChannelSearch, channels: []const Channel) !void {
+    errdefer self.clear();
+    self.generation += 1;
+    var buf: [max_text_len]u8 = undefined;
+    for (channels, 0..) |ch, i| {
+        const text = channelText(&buf, ch);
+        const res = try self.ids.getOrPut(self.allocator, ch.point);
+        if (!res.found_existing) {
+            res.value_ptr.* = self.newSlot() catch |err| {
+                self.ids.removeByPtr(res.key_ptr);
+                return err;
+            };
+        }
+        const id = res.value_ptr.*;
+        const slot = &self.slots.items[id];
+        if (!std.mem.eql(u8, slot.text, text)) {
+            self.unindex(id);
+            self.allocator.free(slot.text);
+            slot.text = &.{};
+            slot.text = try self.allocator.dupe(u8, text); // clear frees it on error
+            try self.index(id);
+        }
+        slot.pos = @intCast(i);
+        slot.seen = self.generation;
+    }
+
+    var gone = std.ArrayList(types.OutPoint).init(self.allocator);
+    defer gone.deinit();
+    var it = self.ids.iterator();
+    while (it.next()) |kv| {
+        if (self.slots.items[kv.value_ptr.*].seen != self.generation) {
+            try gone.append(kv.key_ptr.*);
+        }
+    }
+    for (gone.items) |point| {
+        const id = self.ids.fetchRemove(point).?.value;
+        self.unindex(id);
+        const slot = &self.slots.items[id];
+        self.allocator.free(slot.text);
+        slot.* = .{};
+        try self.free_ids.append(self.allocator, id);
+    }
+}
+
+/// returns the channel set indices of channels whose peer alias, pubkey hex
+/// or short channel id contains the query, ascending. case-insensitive.
+/// the result is allocated with the allocator.
+pub fn search(self: *const ChannelSearch, allocator: std.mem.Allocator, query: []const u8) ![]u32 {
+    var qbuf: [max_query_len]u8 = undefined;
+    const q = std.ascii.lowerString(&qbuf, query[0..@min(query.len, max_query_len)]);
+    var out = std.ArrayList(u32).init(allocator);
+    defer out.deinit();
+    if (q.len == 0 or std.mem.indexOfScalar(u8, q, sep) != null) {
+        return out.toOwnedSlice();
+    }
+    if (q.len <= 3) {
+        const ids = self.postings(q);
+        try out.ensureTotalCapacity(ids.len);
+        for (ids) |id| out.appendAssumeCapacity(self.slots.items[id].pos);
+    } else {
+        // candidates of the rarest trigram, in all the others too.
+        var rarest: []const u32 = self.postings(q[0..3]);
+        var i: usize = 1;
+        while (i + 3 <= q.len) : (i += 1) {
+            const ids = self.postings(q[i..][0..3]);
+            if (ids.len < rarest.len) rarest = ids;
+        }
+        next: for (rarest) |id| {
+            i = 0;
+            while (i + 3 <= q.len) : (i += 1) {
+                if (!contains(self.postings(q[i..][0..3]), id)) continue :next;
+            }
+            if (std.mem.indexOf(u8, self.slots.items[id].text, q) != null) {
+                try out.append(self.slots.items[id].pos);
+            }
+        }
+    }
+    std.mem.sort(u32, out.items, {}, std.sort.asc(u32));
+    return out.toOwnedSlice();
+}
+
+fn newSlot(self: *ChannelSearch) !u32 {
+    if (self.free_ids.popOrNull()) |id| {
+        return id;
+    }
+    try self.slots.append(self.allocator, .{});
+    return @intCast(self.slots.items.len - 1);
+}
+
+/// adds slot id to the postings of each of its text n-grams.
+fn index(self: *ChannelSearch, id: u32) !void {
+    const text = self.slots.items[id].text;
+    for (1..4) |n| {
+        var i: usize = 0;
+        while (i + n <= text.len) : (i += 1) {
+            const g = text[i..][0..n];
+            if (std.mem.indexOfScalar(u8, g, sep) != null) continue;
+            const res = try self.grams.getOrPut(self.allocator, gramKey(g));
+            if (!res.found_existing) res.value_ptr.* = .{};
+            const list = res.value_ptr;
+            const at = lowerBound(list.items, id);
+            if (at < list.items.len and list.items[at] == id) continue; // repeated n-gram
+            try list.insert(self.allocator, at, id);
+        }
+    }
+}
+
+/// removes slot id from the postings of each of its text n-grams.
+fn unindex(self: *ChannelSearch, id: u32) void {
+    const text = self.slots.items[id].text;
+    for (1..4) |n| {
+        var i: usize = 0;
+        while (i + n <= text.len) : (i += 1) {
+            const g = text[i..][0..n];
+            if (std.mem.indexOfScalar(u8, g, sep) != null) continue;
+            const key = gramKey(g);
+            const list = self.grams.getPtr(key) orelse continue;
+            const at = lowerBound(list.items, id);
+            if (at < list.items.len and list.items[at] == id) {
+                _ = list.orderedRemove(at);
+            }
+            if (list.items.len == 0) {
+                list.deinit(self.allocator);
+                _ = self.grams.remove(key);
+            }
+        }
+    }
+}
+
+fn postings(self: *const ChannelSearch, g: []const u8) []const u32 {
+    const list = self.grams.get(gramKey(g)) orelse return &.{};
+    return list.items;
+}
+
+/// n-grams of 1 to 3 bytes, with the length in the top byte.
+fn gramKey(g: []const u8) u32 {
+    var k: u32 = @as(u32, @intCast(g.len)) << 24;
+    for (g, 0..) |c, i| {
+        k |= @as(u32, c) << @intCast(8 * i);
+    }
+    return k;
+}
+
+fn lowerBound(items: []const u32, v: u32) usize {
+    var lo: usize = 0;
+    var hi: usize = items.len;
+    while (lo < hi) {
+        const mid = lo + (hi - lo) / 2;
+        if (items[mid] < v) lo = mid + 1 else hi = mid;
+    }
+    return lo;
+}
+
+fn contains(items: []const u32, v: u32) bool {
+    const at = lowerBound(items, v);
+    return at < items.len and items[at] == v;
+}
+
+/// writes the lowercase indexed text of ch into buf.
+fn channelText(buf: *[max_text_len]u8, ch: Channel) []const u8 {
+    const alias = ch.peer_alias[0..@min(ch.peer_alias.len, max_alias_len)];
+    var n = std.ascii.lowerString(buf, alias).len;
+    buf[n] = sep;
+    n += 1;
+    const pubkey = ch.peer_pubkey.hex();
+    @memcpy(buf[n..][0..pubkey.len], &pubkey);
+    n += pubkey.len;
+    if (ch.id) |id| {
+        buf[n] = sep;
+        n += 1;
+        const idlen = @min(id.len, buf.len - n);
+        @memcpy(buf[n..][0..idlen], id[0..idlen]);
+        n += idlen;
+    }
+    return buf[0..n];
+}
+
+test "channel search" {
+    const t = std.testing;
+
+    var idx = ChannelSearch.init(t.allocator);
+    defer idx.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    var chans: [4]Channel = undefined;
+    const aliases = [_][]const u8{ "ACINQ", "Bitrefill", "bitrefill thor", "WalletOfSatoshi" };
+    for (&chans, aliases, 0..) |*ch, alias, i| {
+        ch.* = .{
+            .id = null,
+            .state = .active,
+            .private = false,
+            .point = .{ .txid = .{ .bytes = [_]u8{@intCast(i)} ** 32 }, .index = 0 },
+            .peer_pubkey = .{ .bytes = [_]u8{@intCast(0x10 * i + 2)} ** 33 },
+            .peer_alias = alias,
+            .capacity = 0,
+            .balance = .{ .local = 0, .remote = 0, .unsettled = 0, .limbo = 0 },
+            .totalsats = .{ .sent = 0, .received = 0 },
+            .fees = .{ .base = 0, .ppm = 0 },
+        };
+    }
+    chans[2].id = "869000123000010001";
+    try idx.update(&chans);
+
+    try t.expectEqualSlices(u32, &.{ 1, 2 }, try idx.search(arena, "BiT"));
+    try t.expectEqualSlices(u32, &.{ 1, 2 }, try idx.search(arena, "refill"));
+    try t.expectEqualSlices(u32, &.{2}, try idx.search(arena, "ll th"));
+    try t.expectEqualSlices(u32, &.{2}, try idx.search(arena, "86900012"));
+    try t.expectEqualSlices(u32, &.{0}, try idx.search(arena, "0202"));
+    try t.expectEqualSlices(u32, &.{}, try idx.search(arena, "refillz"));
+    try t.expectEqualSlices(u32, &.{}, try idx.search(arena, "q0202")); // no match across fields
+    try t.expectEqualSlices(u32, &.{}, try idx.search(arena, ""));
+
+    // a new set: a channel gone, one renamed and the others moved.
+    chans[3].peer_alias = "ZEUS";
+    const next = [_]Channel{ chans[3], chans[2], chans[0] };
+    try idx.update(&next);
+    try t.expectEqualSlices(u32, &.{1}, try idx.search(arena, "bit"));
+    try t.expectEqualSlices(u32, &.{0}, try idx.search(arena, "zeus"));
+    try t.expectEqualSlices(u32, &.{}, try idx.search(arena, "wallet"));
+    try t.expectEqual(@as(usize, 1), idx.free_ids.items.len);
+
+    // gone channels leave no postings behind.
+    try idx.update(&.{});
+    try t.expectEqual(@as(u32, 0), idx.grams.count());
+    try t.expectEqual(@as(u32, 0), idx.ids.count());
+}
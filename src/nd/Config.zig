@@ -3,6 +3,7 @@
 
 const std = @import("std");
 const lightning = @import("../lightning.zig");
+const lockprof = @import("../lockprof.zig");
 const types = @import("../types.zig");
 const sys = @import("../sys.zig");
 
@@ -25,21 +26,34 @@ pub const LND_TLSCERT_PATH = LND_HOMEDIR ++ "/.lnd/tls.cert";
 pub const LND_WALLETUNLOCK_PATH = LND_HOMEDIR ++ "/walletunlock.txt";
 pub const LND_MACAROON_RO_PATH = LND_DATA_DIR ++ "/chain/bitcoin/mainnet/readonly.macaroon";
 pub const LND_MACAROON_ADMIN_PATH = LND_DATA_DIR ++ "/chain/bitcoin/mainnet/admin.macaroon";
+pub const LND_CHANNELDB_PATH = LND_DATA_DIR ++ "/graph/mainnet/channel.db";
 
 pub const BITCOIND_CONFIG_PATH = "/home/bitcoind/mainnet.conf";
+pub const BITCOIND_DEBUG_LOG_PATH = "/ssd/bitcoind/mainnet/debug.log";
+/// a UTXO set snapshot is downloaded to, for bitcoind loadtxoutset.
+pub const BITCOIND_UTXO_SNAPSHOT_PATH = "/ssd/bitcoind/utxo-snapshot.dat";
 pub const TOR_DATA_DIR = "/ssd/tor";
+/// tor CookieAuthFile, read to authenticate on its control port.
+pub const TOR_CONTROL_COOKIE_PATH = TOR_DATA_DIR ++ "/control_auth_cookie";
 
-arena: *std.heap.ArenaAllocator, // data is allocated here
+arena: *std.heap.ArenaAllocator, // snapshots are allocated here
 confpath: []const u8, // fs path to where data is persisted
 
-/// any heap-alloc'ed field values are in `arena.allocator()`.
-static: StaticData,
-/// guards `data` as well as `static.hostname` when the latter changed using `setHostname`.
-mu: std.Thread.RwLock = .{},
-data: Data,
+/// current config, replaced as a whole by writers. read with `snapshot`.
+snap: std.atomic.Value(*const Snapshot),
+/// serializes writers and arena allocations after init. readers never take it.
+mu: lockprof.Mutex = .{ .name = .config },
+/// whether the current snapshot differs from what's on disk; see `persistPending`.
+unsaved: bool = false,
+
+/// an immutable view of the config. any heap-alloc'ed field values
+/// are in `arena.allocator()`.
+pub const Snapshot = struct {
+    data: Data,
+    static: StaticData,
+};
 
 /// top struct stored on disk.
-/// access with `safeReadOnly` or lock/unlock `mu`.
 ///
 /// for backwards compatibility, all newly introduced fields must have default values.
 pub const Data = struct {
@@ -50,11 +64,14 @@ pub const Data = struct {
     syschannel: SysupdatesChannel,
     syscronscript: []const u8,
     sysrunscript: []const u8,
+    /// max hours between bitcoind chainstate flushes in standby; 0 disables
+    /// them. see Daemon.scheduleBitcoindFlush.
+    bitcoind_flush_hours: u16 = 6,
 };
 
 /// static data is interred at init and never changes except for hostname - see `setHostname`.
 pub const StaticData = struct {
-    hostname: []const u8, // guarded by self.mu
+    hostname: []const u8,
     lnd_user: ?std.process.UserInfo,
     lnd_tor_hostname: ?[]const u8,
     bitcoind_rpc_pass: ?[]const u8,
@@ -76,11 +93,24 @@ pub fn init(allocator: std.mem.Allocator, confpath: []const u8) !Config {
         arena.deinit();
         allocator.destroy(arena);
     }
+    // static data probes read other files; they run while the config is parsed.
+    var probes = try StaticProbes.start();
+    const data = initData(arena.allocator(), confpath) catch |err| {
+        probes.abandon();
+        return err;
+    };
+    return initWith(arena, confpath, data, try probes.wait(arena.allocator()));
+}
+
+/// makes a config with the initial snapshot from data and static, allocated in arena.
+/// the returned config owns the arena: see `deinit`.
+pub fn initWith(arena: *std.heap.ArenaAllocator, confpath: []const u8, data: Data, static: StaticData) !Config {
+    const snap = try arena.allocator().create(Snapshot);
+    snap.* = .{ .data = data, .static = static };
     return .{
         .arena = arena,
         .confpath = confpath,
-        .data = try initData(arena.allocator(), confpath),
-        .static = try inferStaticData(arena.allocator()),
+        .snap = std.atomic.Value(*const Snapshot).init(snap),
     };
 }
 
@@ -128,22 +158,142 @@ fn inferSysupdatesChannel(cron_script_path: []const u8) SysupdatesChannel {
     return .master;
 }
 
-fn inferStaticData(allocator: std.mem.Allocator) !StaticData {
-    const hostname = try sys.hostname(allocator);
-    const lnduser: ?std.process.UserInfo = blk: {
-        const uid = std.os.linux.getuid();
-        const uinfo = types.getUserInfo(LND_OS_USER) catch break :blk null;
-        // assume there's no lnd user if uid is root or same as current process.
-        break :blk if (uinfo.uid == 0 or uinfo.uid == uid) null else uinfo;
-    };
-    return .{
-        .hostname = hostname,
-        .lnd_user = lnduser,
-        .lnd_tor_hostname = inferLndTorHostname(allocator) catch null,
-        .bitcoind_rpc_pass = inferBitcoindRpcPass(allocator) catch null,
+/// max time init waits for static data probes, all running concurrently.
+/// a probe still running past the deadline, for example stuck reading from
+/// a slow SD card, is abandoned and its value left unknown.
+const probe_deadline = 3 * std.time.ns_per_s;
+
+/// concurrent probes of all static data except hostname, which is a syscall.
+const StaticProbes = struct {
+    clock: sys.Clock,
+    started: u64, // clock.now at start
+    lnd_user: Probe(std.process.UserInfo),
+    lnd_tor_hostname: Probe([]const u8),
+    bitcoind_rpc_pass: Probe([]const u8),
+
+    fn start() !StaticProbes {
+        var sp: StaticProbes = undefined;
+        sp.clock = sys.Clock.system;
+        sp.started = sp.clock.now();
+        sp.lnd_user = try Probe(std.process.UserInfo).start("lnd user", inferLndUser);
+        errdefer sp.lnd_user.abandon();
+        sp.lnd_tor_hostname = try Probe([]const u8).start("lnd tor hostname", inferLndTorHostname);
+        errdefer sp.lnd_tor_hostname.abandon();
+        sp.bitcoind_rpc_pass = try Probe([]const u8).start("bitcoind rpc pass", inferBitcoindRpcPass);
+        return sp;
+    }
+
+    /// waits for all probes up to probe_deadline and returns the static data
+    /// allocated with the allocator. the probes are released even on error.
+    fn wait(self: *StaticProbes, allocator: std.mem.Allocator) !StaticData {
+        var static = StaticData{
+            .hostname = undefined,
+            .lnd_user = self.lnd_user.wait(allocator, self.clock, self.started + probe_deadline),
+            .lnd_tor_hostname = self.lnd_tor_hostname.wait(allocator, self.clock, self.started + probe_deadline),
+            .bitcoind_rpc_pass = self.bitcoind_rpc_pass.wait(allocator, self.clock, self.started + probe_deadline),
+        };
+        static.hostname = try sys.hostname(allocator);
+        logger.info("static data inferred in {d}ms", .{self.clock.since(self.started) / std.time.ns_per_ms});
+        return static;
+    }
+
+    /// releases all probes without waiting for their results.
+    fn abandon(self: *StaticProbes) void {
+        self.lnd_user.abandon();
+        self.lnd_tor_hostname.abandon();
+        self.bitcoind_rpc_pass.abandon();
+    }
+};
+
+/// a function of type `fn (std.mem.Allocator) !T` running in its own thread.
+/// the function allocates in an arena owned by the probe, which may outlive
+/// its caller after a timeout; results are copied out by wait.
+fn Probe(comptime T: type) type {
+    return struct {
+        name: []const u8,
+        shared: *Shared,
+
+        const Self = @This();
+
+        const Shared = struct {
+            arena: std.heap.ArenaAllocator,
+            done: std.Thread.ResetEvent = .{},
+            /// the waiting and probe threads; the last one to release frees the state.
+            refs: std.atomic.Value(u8) = std.atomic.Value(u8).init(2),
+            value: ?T = null, // null on error
+            took: u64 = 0, // ns
+
+            fn release(sh: *Shared) void {
+                if (sh.refs.fetchSub(1, .acq_rel) == 1) {
+                    sh.arena.deinit();
+                    std.heap.page_allocator.destroy(sh);
+                }
+            }
+        };
+
+        /// starts the probe func in a new thread, or runs it right away if
+        /// the thread cannot be spawned. callers must wait or abandon.
+        fn start(name: []const u8, comptime func: anytype) !Self {
+            // the page allocator is there for as long as the process, like the probe thread.
+            const sh = try std.heap.page_allocator.create(Shared);
+            sh.* = .{ .arena = std.heap.ArenaAllocator.init(std.heap.page_allocator) };
+            const Run = struct {
+                fn run(shared: *Shared, pname: []const u8) void {
+                    const t0 = std.time.nanoTimestamp();
+                    shared.value = func(shared.arena.allocator()) catch |err| blk: {
+                        logger.debug("probe {s}: {!}", .{ pname, err });
+                        break :blk null;
+                    };
+                    shared.took = @intCast(std.time.nanoTimestamp() - t0);
+                    shared.done.set();
+                    shared.release();
+                }
+            };
+            const th = std.Thread.spawn(.{}, Run.run, .{ sh, name }) catch |err| {
+                logger.warn("probe {s}: spawn: {!}; running inline", .{ name, err });
+                Run.run(sh, name);
+                return .{ .name = name, .shared = sh };
+            };
+            th.detach();
+            return .{ .name = name, .shared = sh };
+        }
+
+        /// waits for the probe to finish until the clock reaches deadline,
+        /// and returns its value allocated with the allocator.
+        /// returns null if the probe failed or timed out.
+        fn wait(self: Self, allocator: std.mem.Allocator, clock: sys.Clock, deadline: u64) ?T {
+            defer self.shared.release();
+            if (!clock.wait(&self.shared.done, deadline -| clock.now())) {
+                logger.warn("probe {s}: no result by the deadline; skipped", .{self.name});
+                return null;
+            }
+            logger.info("probe {s} took {d}ms", .{ self.name, self.shared.took / std.time.ns_per_ms });
+            const v = self.shared.value orelse return null;
+            if (T == []const u8) {
+                return allocator.dupe(u8, v) catch |err| {
+                    logger.err("probe {s}: {!}", .{ self.name, err });
+                    return null;
+                };
+            }
+            return v;
+        }
+
+        fn abandon(self: Self) void {
+            self.shared.release();
+        }
     };
 }
 
+fn inferLndUser(_: std.mem.Allocator) !std.process.UserInfo {
+    const uid = std.os.linux.getuid();
+    const uinfo = try types.getUserInfo(LND_OS_USER);
+    // assume there's no lnd user if uid is root or same as current process.
+    if (uinfo.uid == 0 or uinfo.uid == uid) {
+        return error.NoLndUser;
+    }
+    return uinfo;
+}
+
 fn inferLndTorHostname(allocator: std.mem.Allocator) ![]const u8 {
     const raw = try std.fs.cwd().readFileAlloc(allocator, TOR_DATA_DIR ++ "/lnd/hostname", 1024);
     const hostname = std.mem.trim(u8, raw, &std.ascii.whitespace);
@@ -173,55 +323,95 @@ fn inferBitcoindRpcPass(allocator: std.mem.Allocator) ![]const u8 {
     return error.UninferrableBitcoindRpcPass;
 }
 
-/// calls F while holding a readonly lock and passes on F's result as is.
-/// F is expected to take `Data` and `StaticData` args.
-pub fn safeReadOnly(self: *Config, comptime F: anytype) @typeInfo(@TypeOf(F)).Fn.return_type.? {
-    self.mu.lockShared();
-    defer self.mu.unlockShared();
-    return F(self.data, self.static);
+/// returns the current config. safe for concurrent use and never blocks,
+/// even while a writer persists changes to disk.
+/// the snapshot is never modified and stays valid until `deinit`.
+pub fn snapshot(self: *const Config) *const Snapshot {
+    return self.snap.load(.acquire);
+}
+
+/// makes snap the current config. caller must hold self.mu.
+/// superseded snapshots are kept in the arena until deinit since readers may
+/// still hold them. config changes are rare and user initiated.
+fn publish(self: *Config, snap: Snapshot) !void {
+    const p = try self.arena.allocator().create(Snapshot);
+    p.* = snap;
+    self.snap.store(p, .release);
 }
 
 /// matches the `input` against the hash in `Data.slock.bcrypt_hash` previously set with `setSlockPin`.
 /// incrementing `Data.slock.incorrect_attempts` each unsuccessful result.
-/// the number of attemps are persisted at `Config.confpath` upon function return.
+/// the slow bcrypt verification runs without holding self.mu. the number of
+/// attempts is not persisted until `persistPending`, so that callers can
+/// store the result of several attempts at once.
 pub fn verifySlockPin(self: *Config, input: []const u8) !void {
+    const slock = self.snapshot().data.slock orelse return;
+    const ok = if (std.crypto.pwhash.bcrypt.strVerify(slock.bcrypt_hash, input, .{})) true else |err| switch (err) {
+        error.PasswordVerificationFailed => false,
+        else => {
+            logger.err("bcrypt.strVerify: {!}", .{err});
+            return err;
+        },
+    };
+
     self.mu.lock();
     defer self.mu.unlock();
-    const slock = self.data.slock orelse return;
-    defer self.dumpUnguarded() catch |errdump| logger.err("dumpUnguarded: {!}", .{errdump});
-    std.crypto.pwhash.bcrypt.strVerify(slock.bcrypt_hash, input, .{}) catch |err| {
-        if (err == error.PasswordVerificationFailed) {
-            self.data.slock.?.incorrect_attempts += 1;
-            return error.IncorrectSlockPin;
-        }
-        logger.err("bcrypt.strVerify: {!}", .{err});
-        return err;
-    };
-    self.data.slock.?.incorrect_attempts = 0;
+    var snap = self.snapshot().*;
+    const cur = if (snap.data.slock) |*v| v else return error.SlockPinChanged;
+    if (cur.bcrypt_hash.ptr != slock.bcrypt_hash.ptr) {
+        return error.SlockPinChanged; // set or disabled while verifying
+    }
+    if (!ok) {
+        cur.incorrect_attempts +|= 1;
+    } else if (cur.incorrect_attempts != 0) {
+        cur.incorrect_attempts = 0;
+    } else {
+        return;
+    }
+    try self.publish(snap);
+    self.unsaved = true;
+    if (!ok) {
+        return error.IncorrectSlockPin;
+    }
+}
+
+/// stores the current snapshot to disk if it has changes not yet persisted,
+/// such as the pin attempts counter updated by `verifySlockPin`.
+pub fn persistPending(self: *Config) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.unsaved) {
+        try self.dumpUnguarded();
+    }
 }
 
 /// enables or disables screenlock, persistently. null `code` indicates disabled.
 /// safe for concurrent use.
 pub fn setSlockPin(self: *Config, code: ?[]const u8) !void {
-    self.mu.lock();
-    defer self.mu.unlock();
-    // TODO: free existing slock.bcrypt_hash? it is in arena but still
-    if (code) |s| {
+    // hash before taking the lock: bcrypt is slow by design.
+    var buf: [std.crypto.pwhash.bcrypt.hash_length * 2]u8 = undefined;
+    const hash: ?[]const u8 = if (code) |s| blk: {
         const bcrypt = std.crypto.pwhash.bcrypt;
         const opt: bcrypt.HashOptions = .{
             .params = .{ .rounds_log = 12 },
             .encoding = .phc,
             .silently_truncate_password = false,
         };
-        var buf: [bcrypt.hash_length * 2]u8 = undefined;
-        const hash = try bcrypt.strHash(s, opt, &buf);
-        self.data.slock = .{
-            .bcrypt_hash = try self.arena.allocator().dupe(u8, hash),
+        break :blk try bcrypt.strHash(s, opt, &buf);
+    } else null;
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    var snap = self.snapshot().*;
+    if (hash) |h| {
+        snap.data.slock = .{
+            .bcrypt_hash = try self.arena.allocator().dupe(u8, h),
             .incorrect_attempts = 0,
         };
     } else {
-        self.data.slock = null;
+        snap.data.slock = null;
     }
+    try self.publish(snap);
     try self.dumpUnguarded();
 }
 
@@ -242,7 +432,7 @@ pub fn beginMutateLndConf(self: *Config, opt: MutateLndConfOpt) !LndConfMut {
         .lndconf = try lightning.LndConf.load(allocator, filepath),
         .allocator = allocator,
         .filepath = filepath,
-        .lnduser = self.static.lnd_user,
+        .lnduser = self.snapshot().static.lnd_user,
         .mu = &lndconf_mu,
     };
 }
@@ -255,15 +445,9 @@ pub const LndConfMut = struct {
     lnduser: ?std.process.UserInfo = null,
     mu: *std.Thread.Mutex,
 
+    /// writes the config back to the file it was loaded from, unless unchanged.
     pub fn persist(self: @This()) !void {
-        const file = try std.io.BufferedAtomicFile.create(self.allocator, std.fs.cwd(), self.filepath, .{ .mode = 0o400 });
-        defer file.destroy(); // frees resources; does NOT delete the file
-        try self.lndconf.dumpWriter(file.writer());
-        try file.finish(); // persist the file in the correct location
-        // change ownership to that of the lnd sys user
-        if (self.lnduser) |user| {
-            try chown(self.filepath, user);
-        }
+        _ = try writeLndConf(self.allocator, self.lndconf, self.filepath, self.lndconf.source, self.lnduser);
     }
 
     /// relinquish concurrent access guard and resources.
@@ -273,61 +457,86 @@ pub const LndConfMut = struct {
     }
 };
 
-/// stores current `Config.data` to disk, into `Config.confpath`.
+/// stores current snapshot data to disk, into `Config.confpath`.
 pub fn dump(self: *Config) !void {
-    self.mu.lockShared();
-    defer self.mu.unlockShared();
+    self.mu.lock();
+    defer self.mu.unlock();
     return self.dumpUnguarded();
 }
 
-fn dumpUnguarded(self: Config) !void {
+/// caller must hold self.mu, so that an older snapshot never overwrites a newer one.
+fn dumpUnguarded(self: *Config) !void {
     const allocator = self.arena.child_allocator;
     const opt = .{ .mode = 0o600 };
     const file = try std.io.BufferedAtomicFile.create(allocator, std.fs.cwd(), self.confpath, opt);
     defer file.destroy();
-    try std.json.stringify(self.data, .{ .whitespace = .indent_2 }, file.writer());
+    try std.json.stringify(self.snapshot().data, .{ .whitespace = .indent_2 }, file.writer());
     try file.finish();
+    self.unsaved = false;
 }
 
-/// sets hostname to a new name at runtime in both the OS and `Config.static.hostname`.
+/// sets hostname to a new name at runtime in both the OS and `StaticData.hostname`.
 /// see `sys.setHostname` for `newname` sanitization rules.
 /// the name arg must outlive this function call.
 /// safe for concurrent use.
 pub fn setHostname(self: *Config, newname: []const u8) !void {
-    self.mu.lock(); // for self.static.hostname
+    self.mu.lock();
     defer self.mu.unlock();
     const allocator = self.arena.allocator();
 
-    const dupname = try allocator.dupe(u8, newname);
-    errdefer allocator.free(dupname);
+    var snap = self.snapshot().*;
+    snap.static.hostname = try allocator.dupe(u8, newname);
+    errdefer allocator.free(snap.static.hostname);
     try sys.setHostname(allocator, newname);
-    allocator.free(self.static.hostname);
-    self.static.hostname = dupname;
+    try self.publish(snap);
 }
 
-/// when run is set, executes the update after changing the channel.
+/// receives the output of a running system update, a line at a time,
+/// without the line terminator. the line is valid only during the call.
+pub const SysupdatesOutput = struct {
+    ctx: *anyopaque,
+    lineFn: *const fn (ctx: *anyopaque, line: []const u8) void,
+};
+
+/// serializes system update runs.
+var sysupdates_mu: std.Thread.Mutex = .{};
+
+/// when run is set, executes the update after changing the channel, passing
+/// the script output on to opt.output as it arrives.
 /// executing an update may terminate and start a new nd+ngui instance.
-pub fn switchSysupdates(self: *Config, chan: SysupdatesChannel, opt: struct { run: bool }) !void {
-    self.mu.lock();
-    defer self.mu.unlock();
+pub fn switchSysupdates(self: *Config, chan: SysupdatesChannel, opt: struct {
+    run: bool,
+    output: ?SysupdatesOutput = null,
+}) !void {
+    const scriptpath = blk: {
+        self.mu.lock();
+        defer self.mu.unlock();
 
-    self.data.syschannel = chan;
-    try self.dumpUnguarded();
+        var snap = self.snapshot().*;
+        snap.data.syschannel = chan;
+        try self.publish(snap);
+        try self.dumpUnguarded();
 
-    try self.genSysupdatesCronScript();
+        try self.genSysupdatesCronScript();
+        break :blk snap.data.syscronscript;
+    };
     if (opt.run) {
-        try runSysupdates(self.arena.child_allocator, self.data.syscronscript);
+        // the update may take many minutes; other config writers go on meanwhile.
+        sysupdates_mu.lock();
+        defer sysupdates_mu.unlock();
+        try runSysupdates(self.arena.child_allocator, scriptpath, opt.output);
     }
 }
 
 /// caller must hold self.mu.
-fn genSysupdatesCronScript(self: Config) !void {
-    if (self.data.sysrunscript.len == 0) {
+fn genSysupdatesCronScript(self: *const Config) !void {
+    const data = self.snapshot().data;
+    if (data.sysrunscript.len == 0) {
         return error.NoSysRunScriptPath;
     }
     const allocator = self.arena.child_allocator;
     const opt = .{ .mode = 0o755 };
-    const file = try std.io.BufferedAtomicFile.create(allocator, std.fs.cwd(), self.data.syscronscript, opt);
+    const file = try std.io.BufferedAtomicFile.create(allocator, std.fs.cwd(), data.syscronscript, opt);
     defer file.destroy();
 
     const script =
@@ -335,8 +544,8 @@ fn genSysupdatesCronScript(self: Config) !void {
         \\exec {[path]s} "{[chan]s}"
     ;
     try std.fmt.format(file.writer(), script, .{
-        .path = self.data.sysrunscript,
-        .chan = @tagName(self.data.syschannel),
+        .path = data.sysrunscript,
+        .chan = @tagName(data.syschannel),
     });
     try file.finish();
 }
@@ -344,58 +553,78 @@ fn genSysupdatesCronScript(self: Config) !void {
 /// the scriptpath is typically the cronjob script, not a SYSUPDATES_RUN_SCRIPT
 /// because the latter requires command args which is what cron script does.
 ///
+/// stdout and stderr are read through pipes until the script exits and passed
+/// on to output line by line, in the order they're read; the last stderr line
+/// is logged on failure.
+///
 /// the caller must serialize this function calls.
-fn runSysupdates(allocator: std.mem.Allocator, scriptpath: []const u8) !void {
-    const res = try std.ChildProcess.run(.{ .allocator = allocator, .argv = &.{scriptpath} });
-    defer {
-        allocator.free(res.stdout);
-        allocator.free(res.stderr);
+fn runSysupdates(allocator: std.mem.Allocator, scriptpath: []const u8, output: ?SysupdatesOutput) !void {
+    var proc = std.ChildProcess.init(&.{scriptpath}, allocator);
+    proc.stdin_behavior = .Ignore;
+    proc.stdout_behavior = .Pipe;
+    proc.stderr_behavior = .Pipe;
+    try proc.spawn();
+    errdefer if (proc.kill()) |_| {} else |err| logger.err("runSysupdates: kill: {!}", .{err});
+
+    var last_err: types.BufTrimString(256) = .{};
+    const sink = struct {
+        output: ?SysupdatesOutput,
+        last_err: *types.BufTrimString(256),
+
+        fn line(self: @This(), stream: enum { stdout, stderr }, s: []const u8) void {
+            if (stream == .stderr) {
+                self.last_err.set(s);
+            }
+            if (self.output) |out| {
+                out.lineFn(out.ctx, s);
+            }
+        }
+    }{ .output = output, .last_err = &last_err };
+
+    var poller = std.io.poll(allocator, enum { stdout, stderr }, .{
+        .stdout = proc.stdout.?,
+        .stderr = proc.stderr.?,
+    });
+    defer poller.deinit();
+    while (try poller.poll()) {
+        splitLines(poller.fifo(.stdout), false, sink, .stdout);
+        splitLines(poller.fifo(.stderr), false, sink, .stderr);
     }
-    switch (res.term) {
+    splitLines(poller.fifo(.stdout), true, sink, .stdout);
+    splitLines(poller.fifo(.stderr), true, sink, .stderr);
+
+    const term = try proc.wait();
+    switch (term) {
         .Exited => |code| if (code != 0) {
-            logger.err("runSysupdates: {s} exit code = {d}; stderr: {s}", .{ scriptpath, code, res.stderr });
+            logger.err("runSysupdates: {s} exit code = {d}; stderr: {s}", .{ scriptpath, code, last_err.val() });
             return error.RunSysupdatesBadExit;
         },
         else => {
-            logger.err("runSysupdates: {s} term = {any}", .{ scriptpath, res.term });
+            logger.err("runSysupdates: {s} term = {any}", .{ scriptpath, term });
             return error.RunSysupdatesBadTerm;
         },
     }
 }
 
-/// waits until lnd admin macaroon is readable and returns an lndconnect URL.
-/// caller owns returned value.
-pub fn lndConnectWaitMacaroonFile(self: Config, allocator: std.mem.Allocator, typ: enum { tor_rpc, tor_http }) ![]const u8 {
-    var macaroon: []const u8 = undefined;
-    while (true) {
-        macaroon = std.fs.cwd().readFileAlloc(allocator, LND_MACAROON_ADMIN_PATH, 2048) catch |err| {
-            switch (err) {
-                error.FileNotFound => {
-                    std.atomic.spinLoopHint();
-                    std.time.sleep(1 * std.time.ns_per_s);
-                    continue;
-                },
-                else => return err,
-            }
-        };
-        break;
-    }
-    defer allocator.free(macaroon);
+/// lines longer than this are split.
+const max_output_line = 1024;
 
-    const base64enc = std.base64.url_safe_no_pad.Encoder;
-    const buf = try allocator.alloc(u8, base64enc.calcSize(macaroon.len));
-    defer allocator.free(buf);
-    const macaroon_b64 = base64enc.encode(buf, macaroon);
-    const port: u16 = switch (typ) {
-        .tor_rpc => 10009,
-        .tor_http => 10010,
-    };
-    return std.fmt.allocPrint(allocator, "lndconnect://{[host]s}:{[port]d}?macaroon={[macaroon]s}", .{
-        // TODO: return an error instead and propagate to the UI
-        .host = self.static.lnd_tor_hostname orelse "<no-tor-hostname>.onion",
-        .port = port,
-        .macaroon = macaroon_b64,
-    });
+/// passes complete lines buffered in fifo on to sink.line, leaving a trailing
+/// partial one in place unless eof is set.
+fn splitLines(fifo: *std.io.PollFifo, eof: bool, sink: anytype, stream: anytype) void {
+    while (fifo.readableLength() > 0) {
+        if (fifo.readableSlice(0).len < fifo.readableLength()) {
+            fifo.realign(); // make the buffered bytes contiguous
+        }
+        const buf = fifo.readableSlice(0);
+        const nl = std.mem.indexOfScalar(u8, buf, '\n');
+        if (nl == null and !eof and buf.len < max_output_line) {
+            return;
+        }
+        const n = @min(nl orelse buf.len, max_output_line);
+        sink.line(stream, std.mem.trimRight(u8, buf[0..n], "\r"));
+        fifo.discard(if (nl != null and nl.? == n) n + 1 else n);
+    }
 }
 
 /// generates a random bytes sequence of the given size, dumps it into `LND_WALLETUNLOCK_PATH`
@@ -443,7 +672,7 @@ pub fn genLndConfig(self: Config, opt: GenLndConfOpt) !void {
     try sec.setPropStr("alias", "nakamochi"); // TODO: make alias configurable
     try sec.setPropStr("datadir", LND_DATA_DIR);
     try sec.setPropStr("logdir", LND_LOG_DIR);
-    if (self.static.lnd_tor_hostname) |torhost| {
+    if (self.snapshot().static.lnd_tor_hostname) |torhost| {
         try sec.setPropStr("tlsextradomain", torhost);
         try sec.setPropStr("externalhosts", torhost);
     }
@@ -465,7 +694,7 @@ pub fn genLndConfig(self: Config, opt: GenLndConfOpt) !void {
     try sec.setPropStr("bitcoind.zmqpubrawtx", "tcp://127.0.0.1:8330");
     try sec.setPropStr("bitcoind.rpchost", "127.0.0.1");
     try sec.setPropStr("bitcoind.rpcuser", "rpc");
-    if (self.static.bitcoind_rpc_pass) |rpcpass| {
+    if (self.snapshot().static.bitcoind_rpc_pass) |rpcpass| {
         try sec.setPropStr("bitcoind.rpcpass", rpcpass);
     } else {
         return error.GenLndConfigNoBitcoindRpcPass;
@@ -477,20 +706,156 @@ pub fn genLndConfig(self: Config, opt: GenLndConfOpt) !void {
     sec = try conf.appendSection("tor");
     try sec.setPropStr("tor.active", "true");
     try sec.setPropStr("tor.skip-proxy-for-clearnet-targets", "true");
+    // compacted only on restarts scheduled by nd; see Daemon.compactLnd.
+    sec = try conf.appendSection("bolt");
+    try sec.setPropStr("db.bolt.auto-compact", "false");
+    try sec.setPropStr("db.bolt.auto-compact-min-age", "168h");
+
+    // dump config into the file, unless it's already there.
+    const current = std.fs.cwd().readFileAlloc(allocator, confpath, 1 << 20) catch null;
+    defer if (current) |b| allocator.free(b);
+    _ = try writeLndConf(allocator, conf, confpath, current, self.snapshot().static.lnd_user);
+}
+
+/// bitcoind settings managed by nd, depending on the host memory and whether
+/// the chain is in initial block download; see applyBitcoindProfile.
+pub const BitcoindProfile = struct {
+    ibd: bool, // relays no transactions with blocksonly
+    dbcache: u32, // MiB
+    par: i8, // script verification threads; 0 is all cores, negative leaves that many free
+    maxmempool: u32, // MiB
+
+    /// returns the profile of a host with total bytes of memory.
+    pub fn init(total: u64, ibd: bool) BitcoindProfile {
+        const mib: u32 = std.math.lossyCast(u32, total >> 20);
+        if (ibd) {
+            // most memory goes to the utxo cache: lnd has little to do until
+            // the chain is synced and the mempool is unused without tx relay.
+            return .{ .ibd = true, .dbcache = std.math.clamp(mib / 2 -| 512, 450, 4096), .par = 0, .maxmempool = 50 };
+        }
+        return .{
+            .ibd = false,
+            .dbcache = if (mib >= 7 * 1024) 1024 else if (mib >= 3 * 1024) 450 else 300,
+            .par = -1, // a core for lnd and ngui
+            .maxmempool = if (mib >= 3 * 1024) 300 else 100,
+        };
+    }
+};
 
-    // dump config into the file.
-    const file = try std.io.BufferedAtomicFile.create(allocator, std.fs.cwd(), confpath, .{ .mode = 0o400 });
+/// marks the profile settings applyBitcoindProfile places in the bitcoind config.
+const BITCOIND_PROFILE_MARK = "# tuning profile managed by nd; edits to these settings are overwritten";
+const BITCOIND_PROFILE_KEYS = [_][]const u8{ "dbcache", "par", "maxmempool", "blocksonly", "zmqpubsequence" };
+
+/// rewrites the bitcoind config file at path, BITCOIND_CONFIG_PATH in
+/// production, with the profile settings in place of any previous values of
+/// their keys. the file ownership and mode are preserved.
+/// returns whether the file changed, in which case bitcoind must restart to
+/// pick up the new profile. the file must exist: it holds rpc credentials
+/// provisioned by sysupdates.
+pub fn applyBitcoindProfile(self: *const Config, prof: BitcoindProfile, path: []const u8) !bool {
+    const allocator = self.arena.child_allocator;
+    const f = try std.fs.cwd().openFile(path, .{});
+    defer f.close();
+    const stat = try std.posix.fstat(f.handle);
+    const current = try f.readToEndAlloc(allocator, 1 << 20);
+    defer allocator.free(current);
+
+    var buf = std.ArrayList(u8).init(allocator);
+    defer buf.deinit();
+    try writeBitcoindConf(buf.writer(), current, prof);
+    if (std.mem.eql(u8, current, buf.items)) {
+        logger.debug("{s}: unchanged", .{path});
+        return false;
+    }
+    const file = try std.io.BufferedAtomicFile.create(allocator, std.fs.cwd(), path, .{ .mode = stat.mode & 0o7777 });
     defer file.destroy(); // frees resources; does NOT delete the file
-    try conf.dumpWriter(file.writer());
-    try file.finish(); // persist the file in the correct location
+    try file.writer().writeAll(buf.items);
+    try file.finish();
+    try chown(path, .{ .uid = stat.uid, .gid = stat.gid });
+    return true;
+}
+
+/// writes the bitcoind config src with the profile in place of any previous
+/// values of its keys. the profile goes into the default section, ahead of
+/// network sections such as [main]: the latter would take precedence otherwise.
+fn writeBitcoindConf(w: anytype, src: []const u8, prof: BitcoindProfile) !void {
+    var placed = false;
+    var it = std.mem.splitScalar(u8, src, '\n');
+    while (it.next()) |line| {
+        if (it.index == null and line.len == 0) {
+            break; // trailing newline
+        }
+        const l = std.mem.trim(u8, line, " \t\r");
+        if (!placed and std.mem.startsWith(u8, l, "[")) {
+            try writeBitcoindProfile(w, prof);
+            placed = true;
+        }
+        if (std.mem.eql(u8, l, BITCOIND_PROFILE_MARK) or isBitcoindProfileKey(l)) {
+            continue;
+        }
+        try w.print("{s}\n", .{line});
+    }
+    if (!placed) {
+        try writeBitcoindProfile(w, prof);
+    }
+}
 
-    // change file ownership to that of the lnd system user.
-    try self.chownLndUser(confpath);
+fn writeBitcoindProfile(w: anytype, prof: BitcoindProfile) !void {
+    try w.print(BITCOIND_PROFILE_MARK ++ "\ndbcache={d}\npar={d}\nmaxmempool={d}\n", .{ prof.dbcache, prof.par, prof.maxmempool });
+    if (prof.ibd) {
+        try w.writeAll("blocksonly=1\n");
+    } else {
+        // mempool changes for the nd fee rates histogram, over the same
+        // socket as lnd block notifications.
+        try w.writeAll("zmqpubsequence=tcp://127.0.0.1:8331\n");
+    }
+}
+
+fn isBitcoindProfileKey(line: []const u8) bool {
+    const eq = std.mem.indexOfScalar(u8, line, '=') orelse return false;
+    const key = std.mem.trim(u8, line[0..eq], " \t");
+    for (BITCOIND_PROFILE_KEYS) |k| {
+        if (std.mem.eql(u8, key, k)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// atomically replaces the file at filepath with the serialized conf, unless
+/// the bytes are identical to its current contents, and changes the file
+/// ownership to that of user, if any. returns whether the file was written.
+fn writeLndConf(
+    allocator: std.mem.Allocator,
+    conf: lightning.LndConf,
+    filepath: []const u8,
+    current: ?[]const u8,
+    user: ?std.process.UserInfo,
+) !bool {
+    var buf = std.ArrayList(u8).init(allocator);
+    defer buf.deinit();
+    try conf.dumpWriter(buf.writer());
+    if (current) |b| {
+        if (std.mem.eql(u8, b, buf.items)) {
+            logger.debug("{s}: unchanged", .{filepath});
+            return false;
+        }
+    }
+
+    const file = try std.io.BufferedAtomicFile.create(allocator, std.fs.cwd(), filepath, .{ .mode = 0o400 });
+    defer file.destroy(); // frees resources; does NOT delete the file
+    try file.writer().writeAll(buf.items);
+    try file.finish(); // persist the file in the correct location
+    // change ownership to that of the lnd sys user
+    if (user) |u| {
+        try chown(filepath, u);
+    }
+    return true;
 }
 
 /// changes a file ownership to that of `LND_OS_USER`, if the user exists.
 fn chownLndUser(self: Config, filepath: []const u8) !void {
-    if (self.static.lnd_user) |user| {
+    if (self.snapshot().static.lnd_user) |user| {
         try chown(filepath, user);
     }
 }
@@ -516,9 +881,39 @@ test "ndconfig: init existing" {
     );
     const conf = try init(t.allocator, try tmp.join(&.{"conf.json"}));
     defer conf.deinit();
-    try t.expectEqual(SysupdatesChannel.dev, conf.data.syschannel);
-    try t.expectEqualStrings("/cron/sysupdates.sh", conf.data.syscronscript);
-    try t.expectEqualStrings("/sysupdates/run.sh", conf.data.sysrunscript);
+    try t.expectEqual(SysupdatesChannel.dev, conf.snapshot().data.syschannel);
+    try t.expectEqualStrings("/cron/sysupdates.sh", conf.snapshot().data.syscronscript);
+    try t.expectEqualStrings("/sysupdates/run.sh", conf.snapshot().data.sysrunscript);
+    try t.expectEqual(@as(u16, 6), conf.snapshot().data.bitcoind_flush_hours); // default
+}
+
+test "ndconfig: startup probes" {
+    const t = std.testing;
+
+    const fns = struct {
+        fn fast(allocator: std.mem.Allocator) ![]const u8 {
+            return allocator.dupe(u8, "value");
+        }
+        fn slow(_: std.mem.Allocator) ![]const u8 {
+            std.time.sleep(500 * std.time.ns_per_ms);
+            return "late";
+        }
+        fn failing(_: std.mem.Allocator) ![]const u8 {
+            return error.ProbeTestFailure;
+        }
+    };
+    const clock = sys.Clock.system;
+    const fast = try Probe([]const u8).start("fast", fns.fast);
+    const slow = try Probe([]const u8).start("slow", fns.slow);
+    const failing = try Probe([]const u8).start("failing", fns.failing);
+    const deadline = clock.now() + 100 * std.time.ns_per_ms;
+
+    const v = fast.wait(t.allocator, clock, deadline);
+    defer if (v) |s| t.allocator.free(s);
+    try t.expectEqualStrings("value", v.?);
+    // the slow probe frees its state when it eventually finishes.
+    try t.expect(slow.wait(t.allocator, clock, deadline) == null);
+    try t.expect(failing.wait(t.allocator, clock, deadline) == null);
 }
 
 test "ndconfig: init null" {
@@ -526,33 +921,33 @@ test "ndconfig: init null" {
 
     const conf = try init(t.allocator, "/non/existent/config/file");
     defer conf.deinit();
-    try t.expectEqual(SysupdatesChannel.master, conf.data.syschannel);
-    try t.expectEqualStrings(SYSUPDATES_CRON_SCRIPT_PATH, conf.data.syscronscript);
-    try t.expectEqualStrings(SYSUPDATES_RUN_SCRIPT_PATH, conf.data.sysrunscript);
+    try t.expectEqual(SysupdatesChannel.master, conf.snapshot().data.syschannel);
+    try t.expectEqualStrings(SYSUPDATES_CRON_SCRIPT_PATH, conf.snapshot().data.syscronscript);
+    try t.expectEqualStrings(SYSUPDATES_RUN_SCRIPT_PATH, conf.snapshot().data.sysrunscript);
 }
 
 test "ndconfig: dump" {
     const t = std.testing;
     const tt = @import("../test.zig");
 
-    // the arena used only for the config instance.
-    // purposefully skip arena deinit - expecting no mem leaks in conf usage here.
+    // the arena used only for the config snapshots, deinit'ed without conf.deinit
+    // so that t.allocator still catches leaks of the child allocator use.
     var conf_arena = std.heap.ArenaAllocator.init(t.allocator);
+    defer conf_arena.deinit();
     var tmp = try tt.TempDir.create();
     defer tmp.cleanup();
 
     const confpath = try tmp.join(&.{"conf.json"});
-    var conf = Config{
-        .arena = &conf_arena,
-        .confpath = confpath,
-        .data = .{
+    var conf = try initWith(
+        &conf_arena,
+        confpath,
+        .{
             .syschannel = .master,
             .syscronscript = "cronscript.sh",
             .sysrunscript = "runscript.sh",
         },
-        .static = undefined,
-    };
-    // purposefully skip conf.deinit() - expecting no leaking allocations in conf.dump.
+        undefined,
+    );
     try conf.dump();
 
     const parsed = try testLoadConfigData(confpath);
@@ -566,26 +961,26 @@ test "ndconfig: switch sysupdates and infer" {
     const t = std.testing;
     const tt = @import("../test.zig");
 
-    // the arena used only for the config instance.
-    // purposefully skip arena deinit - expecting no mem leaks in conf usage here.
+    // the arena used only for the config snapshots, deinit'ed without conf.deinit
+    // so that t.allocator still catches leaks of the child allocator use.
     var conf_arena = std.heap.ArenaAllocator.init(t.allocator);
+    defer conf_arena.deinit();
     var tmp = try tt.TempDir.create();
     defer tmp.cleanup();
 
     try tmp.dir.writeFile("conf.json", "");
     const confpath = try tmp.join(&.{"conf.json"});
     const cronscript = try tmp.join(&.{"cronscript.sh"});
-    var conf = Config{
-        .arena = &conf_arena,
-        .confpath = confpath,
-        .data = .{
+    var conf = try initWith(
+        &conf_arena,
+        confpath,
+        .{
             .syschannel = .master,
             .syscronscript = cronscript,
             .sysrunscript = SYSUPDATES_RUN_SCRIPT_PATH,
         },
-        .static = undefined,
-    };
-    // purposefully skip conf.deinit() - expecting no leaking allocations.
+        undefined,
+    );
 
     try conf.switchSysupdates(.dev, .{ .run = false });
     const parsed = try testLoadConfigData(confpath);
@@ -608,27 +1003,52 @@ test "ndconfig: switch sysupdates with .run=true" {
     try tmp.dir.writeFile(runscript,
         \\#!/bin/sh
         \\printf "$1" > "$(dirname "$0")/success"
+        \\echo "fetching $1"
+        \\echo "no changes" >&2
+        \\printf "done"
     );
     {
         const file = try tmp.dir.openFile(runscript, .{});
         defer file.close();
         try file.chmod(0o755);
     }
-    var conf = Config{
-        .arena = conf_arena,
-        .confpath = try tmp.join(&.{"conf.json"}),
-        .data = .{
+    var conf = try initWith(
+        conf_arena,
+        try tmp.join(&.{"conf.json"}),
+        .{
             .syschannel = .master,
             .syscronscript = try tmp.join(&.{"cronscript.sh"}),
             .sysrunscript = try tmp.join(&.{runscript}),
         },
-        .static = undefined,
-    };
+        undefined,
+    );
     defer conf.deinit();
 
-    try conf.switchSysupdates(.dev, .{ .run = true });
+    var lines = std.ArrayList([]const u8).init(t.allocator);
+    defer {
+        for (lines.items) |s| t.allocator.free(s);
+        lines.deinit();
+    }
+    const collect = struct {
+        fn line(ctx: *anyopaque, s: []const u8) void {
+            const list: *std.ArrayList([]const u8) = @ptrCast(@alignCast(ctx));
+            list.append(list.allocator.dupe(u8, s) catch unreachable) catch unreachable;
+        }
+    }.line;
+    try conf.switchSysupdates(.dev, .{ .run = true, .output = .{ .ctx = &lines, .lineFn = collect } });
     var buf: [10]u8 = undefined;
     try t.expectEqualStrings("dev", try tmp.dir.readFile("success", &buf));
+
+    // stdout and stderr interleave in any order.
+    try t.expectEqual(3, lines.items.len);
+    for ([_][]const u8{ "fetching dev", "no changes", "done" }) |want| {
+        for (lines.items) |s| {
+            if (std.mem.eql(u8, s, want)) break;
+        } else {
+            std.debug.print("missing output line: {s}\n", .{want});
+            return error.TestExpectedEqual;
+        }
+    }
 }
 
 fn testLoadConfigData(path: []const u8) !std.json.Parsed(Data) {
@@ -649,21 +1069,21 @@ test "ndconfig: genLndConfig" {
     var tmp = try tt.TempDir.create();
     defer tmp.cleanup();
 
-    var conf = Config{
-        .arena = conf_arena,
-        .confpath = undefined, // unused
-        .data = .{
+    var conf = try initWith(
+        conf_arena,
+        undefined, // unused
+        .{
             .syschannel = .master, // unused
             .syscronscript = undefined, // unused
             .sysrunscript = undefined, // unused
         },
-        .static = .{
+        .{
             .hostname = "testhost",
             .lnd_user = null,
             .lnd_tor_hostname = "test.onion",
             .bitcoind_rpc_pass = "test secret",
         },
-    };
+    );
     defer conf.deinit();
 
     const confpath = try tmp.join(&.{"lndconf.ini"});
@@ -675,12 +1095,18 @@ test "ndconfig: genLndConfig" {
     try tt.expectSubstring("externalhosts=test.onion\n", bytes);
     try tt.expectNoSubstring("wallet-unlock-password-file", bytes);
     try tt.expectSubstring("bitcoind.rpcpass=test secret\n", bytes);
+    try tt.expectSubstring("db.bolt.auto-compact=false\n", bytes);
 
     try conf.genLndConfig(.{ .autounlock = true, .path = confpath });
     const bytes2 = try std.fs.cwd().readFileAlloc(t.allocator, confpath, 1 << 20);
     defer t.allocator.free(bytes2);
     try tt.expectSubstring("wallet-unlock-password-file=", bytes2);
 
+    // unchanged config is not rewritten: the atomic replace makes a new inode.
+    const stat = try std.fs.cwd().statFile(confpath);
+    try conf.genLndConfig(.{ .autounlock = true, .path = confpath });
+    try t.expectEqual(stat.inode, (try std.fs.cwd().statFile(confpath)).inode);
+
     const lndconf = try lightning.LndConf.load(t.allocator, confpath);
     defer lndconf.deinit();
     try t.expect(lndconf.mainSection() != null);
@@ -688,6 +1114,76 @@ test "ndconfig: genLndConfig" {
     try t.expect(lndconf.findSection("bitcoind") != null);
     try t.expect(lndconf.findSection("autopilot") != null);
     try t.expect(lndconf.findSection("tor") != null);
+    try t.expect(lndconf.findSection("bolt") != null);
+}
+
+test "ndconfig: bitcoind profile" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    const gib = 1 << 30;
+    try t.expectEqual(BitcoindProfile{ .ibd = true, .dbcache = 3584, .par = 0, .maxmempool = 50 }, BitcoindProfile.init(8 * gib, true));
+    try t.expectEqual(BitcoindProfile{ .ibd = true, .dbcache = 1536, .par = 0, .maxmempool = 50 }, BitcoindProfile.init(4 * gib, true));
+    try t.expectEqual(BitcoindProfile{ .ibd = false, .dbcache = 1024, .par = -1, .maxmempool = 300 }, BitcoindProfile.init(8 * gib - (100 << 20), false));
+    try t.expectEqual(BitcoindProfile{ .ibd = false, .dbcache = 300, .par = -1, .maxmempool = 100 }, BitcoindProfile.init(2 * gib, false));
+
+    const conf_arena = try std.testing.allocator.create(std.heap.ArenaAllocator);
+    conf_arena.* = std.heap.ArenaAllocator.init(t.allocator);
+    var conf = try initWith(conf_arena, undefined, undefined, .{
+        .lnd_user = null,
+        .hostname = undefined,
+        .lnd_tor_hostname = null,
+        .bitcoind_rpc_pass = null,
+    });
+    defer conf.deinit();
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    const path = try tmp.join(&.{"mainnet.conf"});
+    try tmp.dir.writeFile(path,
+        \\# rpcauth.py
+        \\dbcache = 100
+        \\server=1
+        \\[main]
+        \\maxmempool=20
+        \\
+    );
+
+    const ibd = BitcoindProfile.init(4 * gib, true);
+    try t.expect(try conf.applyBitcoindProfile(ibd, path));
+    const want_ibd =
+        \\# rpcauth.py
+        \\server=1
+        \\
+    ++ BITCOIND_PROFILE_MARK ++
+        \\
+        \\dbcache=1536
+        \\par=0
+        \\maxmempool=50
+        \\blocksonly=1
+        \\[main]
+        \\
+    ;
+    var buf: [1024]u8 = undefined;
+    try t.expectEqualStrings(want_ibd, try tmp.dir.readFile(path, &buf));
+    // already applied.
+    try t.expect(!try conf.applyBitcoindProfile(ibd, path));
+
+    try t.expect(try conf.applyBitcoindProfile(BitcoindProfile.init(4 * gib, false), path));
+    try t.expectEqualStrings(
+        \\# rpcauth.py
+        \\server=1
+        \\
+    ++ BITCOIND_PROFILE_MARK ++
+        \\
+        \\dbcache=450
+        \\par=-1
+        \\maxmempool=300
+        \\zmqpubsequence=tcp://127.0.0.1:8331
+        \\[main]
+        \\
+    , try tmp.dir.readFile(path, &buf));
+
+    try t.expectError(error.FileNotFound, conf.applyBitcoindProfile(ibd, try tmp.join(&.{"none.conf"})));
 }
 
 test "ndconfig: mutate LndConf" {
@@ -700,17 +1196,17 @@ test "ndconfig: mutate LndConf" {
     var tmp = try tt.TempDir.create();
     defer tmp.cleanup();
 
-    var conf = Config{
-        .arena = conf_arena,
-        .confpath = undefined, // unused
-        .data = undefined, // unused
-        .static = .{
+    var conf = try initWith(
+        conf_arena,
+        undefined, // unused
+        undefined, // unused
+        .{
             .lnd_user = try types.getUserInfo("ignored"),
             .hostname = undefined,
             .lnd_tor_hostname = null,
             .bitcoind_rpc_pass = null,
         },
-    };
+    );
     defer conf.deinit();
     const lndconf_path = try tmp.join(&.{"lndconf.ini"});
     try tmp.dir.writeFile(lndconf_path,
@@ -730,6 +1226,14 @@ test "ndconfig: mutate LndConf" {
         \\alias=newalias
         \\
     , cont);
+
+    // persisting an unmodified config leaves the file alone.
+    const stat = try tmp.dir.statFile(lndconf_path);
+    var mut2 = try conf.beginMutateLndConf(.{ .filepath = lndconf_path });
+    try mut2.lndconf.setAlias("newalias");
+    try mut2.persist();
+    mut2.finish();
+    try t.expectEqual(stat.inode, (try tmp.dir.statFile(lndconf_path)).inode);
 }
 
 test "ndconfig: screen lock" {
@@ -746,7 +1250,7 @@ test "ndconfig: screen lock" {
     {
         var conf = try init(t.allocator, "/nonexistent.json");
         defer conf.deinit();
-        try t.expect(conf.data.slock == null);
+        try t.expect(conf.snapshot().data.slock == null);
         try conf.verifySlockPin("");
         try conf.verifySlockPin("any");
     }
@@ -763,7 +1267,7 @@ test "ndconfig: screen lock" {
         );
         var conf = try init(t.allocator, confpath);
         defer conf.deinit();
-        try t.expect(conf.data.slock == null);
+        try t.expect(conf.snapshot().data.slock == null);
         try conf.verifySlockPin("");
         try conf.verifySlockPin("0000");
     }
@@ -781,31 +1285,34 @@ test "ndconfig: screen lock" {
         );
         var conf = try init(t.allocator, confpath);
         defer conf.deinit();
-        try t.expect(conf.data.slock == null);
+        try t.expect(conf.snapshot().data.slock == null);
         try conf.verifySlockPin("");
         try conf.verifySlockPin("1111");
     }
 
     const newpinconf = try tmp.join(&.{"newconf.json"});
     {
-        var conf = Config{
-            .arena = conf_arena,
-            .confpath = newpinconf,
-            .data = .{
+        var conf = try initWith(
+            conf_arena,
+            newpinconf,
+            .{
                 .slock = null,
                 .syschannel = .master, // unused
                 .syscronscript = undefined, // unused
                 .sysrunscript = undefined, // unused
             },
-            .static = undefined, // unused
-        };
+            undefined, // unused
+        );
         defer conf.deinit();
 
         // any pin should workd because slock is null
         try conf.verifySlockPin("");
         try conf.verifySlockPin("any");
-        // set a new pin code
+        // set a new pin code; snapshots taken before are unaffected
+        const prev = conf.snapshot();
         try conf.setSlockPin("1357");
+        try t.expect(prev.data.slock == null);
+        try t.expect(conf.snapshot().data.slock != null);
         try conf.verifySlockPin("1357");
         try t.expectError(error.IncorrectSlockPin, conf.verifySlockPin(""));
         try t.expectError(error.IncorrectSlockPin, conf.verifySlockPin("any"));
@@ -814,7 +1321,7 @@ test "ndconfig: screen lock" {
     {
         var conf = try init(t.allocator, newpinconf);
         defer conf.deinit();
-        try t.expect(conf.data.slock != null);
+        try t.expect(conf.snapshot().data.slock != null);
         try conf.setSlockPin("1357");
         try conf.verifySlockPin("1357");
         try t.expectError(error.IncorrectSlockPin, conf.verifySlockPin("any2"));
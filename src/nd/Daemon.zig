@@ -13,30 +13,241 @@
 const builtin = @import("builtin");
 const std = @import("std");
 const mem = std.mem;
+const linux = std.os.linux;
+const posix = std.posix;
 const time = std.time;
 
 const bitcoindrpc = @import("../bitcoindrpc.zig");
+const bitcoindzmq = @import("../bitcoindzmq.zig");
 const comm = @import("../comm.zig");
+const deadline = @import("../deadline.zig");
+const allocprof = @import("../allocprof.zig");
+const lockprof = @import("../lockprof.zig");
+const memacct = @import("../memacct.zig");
 const Config = @import("Config.zig");
+const bbolt = @import("../lightning.zig").bbolt;
 const lndhttp = @import("../lightning.zig").lndhttp;
+const History = @import("History.zig");
+const Forwards = @import("Forwards.zig");
+const PaymentsLog = @import("PaymentsLog.zig");
+const TxHistory = @import("TxHistory.zig");
+const LndClientCache = @import("LndClientCache.zig");
+const Metrics = @import("Metrics.zig");
+const LndReportDiff = @import("LndReportDiff.zig");
+const ChannelIndex = @import("ChannelIndex.zig");
+const UtxoSet = @import("UtxoSet.zig");
 const network = @import("network.zig");
+const nif = @import("nif");
+const PeerAliasCache = @import("PeerAliasCache.zig");
+const ChanInfoCache = @import("ChanInfoCache.zig");
+const UtxoSnapshot = @import("UtxoSnapshot.zig");
+const SyncRate = @import("SyncRate.zig");
+const PeerEvictor = @import("PeerEvictor.zig");
+const LndPairing = @import("LndPairing.zig");
+const BitcoindLogTail = @import("BitcoindLogTail.zig");
+const MempoolTracker = @import("MempoolTracker.zig");
+const BlockStatsCache = @import("BlockStatsCache.zig");
+const ChanBackup = @import("ChanBackup.zig");
+const HtlcActivity = @import("HtlcActivity.zig");
+const ChannelGraph = @import("ChannelGraph.zig");
+const JobScheduler = @import("JobScheduler.zig");
+const WorkerPool = @import("WorkerPool.zig");
+const ReportSnapshot = @import("ReportSnapshot.zig");
+const ReportDedup = @import("ReportDedup.zig");
+const Breaker = @import("Breaker.zig");
+const PeerView = @import("PeerView.zig");
+const TorMonitor = @import("TorMonitor.zig");
+const Subscribers = @import("Subscribers.zig");
 const screen = @import("../ui/screen.zig");
 const sys = @import("../sys.zig");
+const torctl = @import("../torctl.zig");
+const trace = @import("../trace.zig");
 const types = @import("../types.zig");
 
 const logger = std.log.scoped(.daemon);
 
 allocator: mem.Allocator,
+/// time source of the report threads scheduling; see InitOpt.clock.
+clock: sys.Clock,
 conf: Config,
-uireader: std.fs.File.Reader, // ngui stdout
-uiwriter: std.fs.File.Writer, // ngui stdin
+uireader: std.fs.File.Reader, // ngui stdout; replaced by respawnUi
+/// ngui stdin. messages are queued and sent by its own thread once started,
+/// so that a busy ngui never blocks the daemon. safe for concurrent use.
+uiwriter: comm.QueueWriter,
+/// restarts ngui after it exits; see respawnUi. used only in comm thread.
+ui_spawner: ?UiSpawner,
+ui_started: i64, // time.milliTimestamp of the last ngui start
+ui_respawn_delay_ms: u32 = 0, // backoff of the next respawn
+/// guards uiencoding, uireply_ids, uichannel_pages, uishm_reports, channel_view
+/// and payments_view.
+uiwriter_mu: std.Thread.Mutex = .{},
+/// payload encoding of messages sent with uiwrite; ngui opts in to binary
+/// with comm_features. guarded by uiwriter_mu.
+uiencoding: comm.Encoding = .json,
+/// whether replies carry the request id; ngui opts in with comm_features.
+uireply_ids: bool = false,
+/// whether ngui reads channels in pages; if so, reports carry none.
+uichannel_pages: bool = false,
+/// the region ngui inherits to read lightning reports from; see InitOpt.ui_shm.
+/// written only in lnd thread.
+uishm: ?*comm.ShmSnapshot,
+/// whether ngui reads lightning reports from uishm; ngui opts in with comm_features.
+uishm_reports: bool = false,
+/// the last lightning_get_channels query, resent when channels change.
+channel_view: ?ChannelView = null,
+/// the last lightning_get_payments query, resent when the history grows.
+payments_view: ?comm.Message.LightningPaymentsQuery = null,
+/// the last onchain_get_transactions query, resent when the history changes.
+tx_view: ?comm.Message.OnchainTxQuery = null,
+/// the last onchain_get_utxos query, resent when the wallet outputs change.
+/// the outputs are listed from lnd only while ngui views them.
+utxo_view: ?comm.Message.OnchainUtxoQuery = null,
 wpa_ctrl: types.WpaControl, // guarded by mu once start'ed
+/// a second, unattached connection for requests made without blocking the
+/// main thread; see sendNetworkReport.
+wpa_async: types.WpaAsyncControl, // guarded by mu once start'ed
+/// an in-flight STATUS request of a network report, if any.
+wifi_status_req: ?types.WpaAsyncControl.Request = null,
+/// when the network report was started, for metrics.
+wifi_status_started: i128 = 0,
+/// a keep-alive bitcoind RPC client, reused across onchain reports.
+/// safe for concurrent use.
+bitcoind: bitcoindrpc.Client,
+/// a shared lnd HTTP client, re-created when lnd tls cert or macaroons change.
+/// safe for concurrent use.
+lndc: LndClientCache,
+/// arenas of bitcoind and lnd call results, reused across report cycles.
+/// safe for concurrent use.
+arena_pool: types.ArenaPool,
+/// timing metrics; safe for concurrent use.
+metrics: Metrics,
+/// bitcoind config file to apply tuning profiles to; see tuneBitcoind.
+bitcoind_conf_path: ?[]const u8,
+/// resource partitioning of the services; see partitionResources.
+/// null if unavailable. used only in onchain thread.
+cgroups: ?*sys.Cgroups,
+/// lnd database compacted by scheduled restarts; see scheduleLndCompaction.
+lnd_channeldb_path: ?[]const u8,
+/// bootstraps a fresh node with bitcoind assumeutxo; see checkBootstrap.
+utxo_snapshot: ?UtxoSnapshot,
+/// bitcoind debug.log, followed for startup progress while bitcoind RPC is
+/// in warmup; null if disabled. used only in onchain thread.
+bitcoind_log: ?BitcoindLogTail,
+/// node resources usage, sampled by the main thread; see sampleSystem.
+/// null if unavailable.
+sampler: ?sys.Sampler,
+/// the previous sample, for the rates of the next system report.
+last_sample: ?sys.Sampler.Sample = null,
+/// time.milliTimestamp when the next sample is due.
+next_sample: i64 = 0,
+/// mempool, fees and balances trends recorded from reports; null if disabled
+/// or the file failed to open. safe for concurrent use.
+history: ?History,
+/// the last onchain and lightning reports, sent to ngui as stale right
+/// after start; null if disabled. safe for concurrent use.
+snapshot: ?ReportSnapshot,
+/// other consumers of the reports stream, next to ngui; see publish.
+/// null if disabled. safe for concurrent use.
+subscribers: ?Subscribers,
+/// lightning channel peer aliases, refreshed in lnd thread loop.
+/// safe for concurrent use.
+peer_aliases: PeerAliasCache,
+/// connected peers of the ngui peer view; used only in lnd thread.
+peer_view: PeerView,
+/// lndconnect URLs of the pairing screen, prepared after lightning reports.
+lnd_pairing: LndPairing,
+/// channel routing policies and peers looked up for ngui; see queueChannelDetail.
+chan_details: ChanInfoCache,
+/// lightning reports are sent to ngui as deltas; used only in lnd thread.
+lnd_report_diff: LndReportDiff,
+/// sendLightningReport scratch space; accessed only from the lnd thread.
+lnd_report_scratch: LndReportScratch,
+/// channels of the last lightning report, paged out to ngui on request.
+/// safe for concurrent use.
+channel_index: ChannelIndex,
+/// onchain wallet unspent outputs, listed from lnd in the lnd thread loop.
+utxos: UtxoSet,
+/// per-channel forwarding history aggregates, synced from lnd in the lnd thread
+/// loop; null if disabled or the file failed to load. used only in lnd thread.
+forwards: ?Forwards,
+/// settled invoices and payments, synced from lnd in the lnd thread loop;
+/// null if disabled or the file failed to open. safe for concurrent use.
+payments: ?PaymentsLog,
+/// onchain wallet transactions, synced from lnd in the lnd thread loop;
+/// null if disabled or the file failed to open. safe for concurrent use.
+txhistory: ?TxHistory,
+/// static channel backup export, kept fresh by the lnd backups subscription;
+/// null if disabled. used only in its LndStreamWorker thread.
+chanbackup: ?ChanBackup,
+/// routing activity counters, recorded by the lnd htlc events LndStreamWorker
+/// thread and summarized to ngui by the main thread. lock-free.
+htlc_activity: HtlcActivity,
+/// lightning network graph, loaded with describegraph and updated by the lnd
+/// graph topology stream. used only in its LndStreamWorker thread.
+channel_graph: ChannelGraph,
+/// time.milliTimestamp when a summary of new htlc events may be sent next;
+/// main thread only.
+next_htlc_summary: i64 = 0,
+/// time.milliTimestamp of the next summary for the counts to age out, if the
+/// last one showed any activity; main thread only.
+htlc_summary_aging: ?i64 = null,
+/// maintenance jobs restarting services or loading the node, and holders
+/// of their exclusion groups; see JobScheduler. safe for concurrent use.
+jobs: JobScheduler,
+/// runs one-off tasks such as ngui requests taking long, reporting their
+/// outcome to ngui; see WorkerPool. safe for concurrent use.
+workers: WorkerPool,
+/// bitcoind getnetworkinfo result, which rarely changes: refetched at most
+/// every netinfo_ttl. used only in onchain thread.
+netinfo_cache: ?struct {
+    res: bitcoindrpc.Client.Result(.getnetworkinfo),
+    fetched: i64, // time.milliTimestamp
+} = null,
+/// estimatesmartfee results of the best block; used only in onchain thread.
+fee_estimates: ?struct {
+    hash: types.Hash,
+    value: ?comm.Message.OnchainReport.FeeEstimates, // null if unavailable
+} = null,
+/// stats of the recent blocks in onchain reports; used only in onchain thread.
+block_stats: BlockStatsCache,
+/// mempool fee rates histogram, notified of mempool changes from the zmq
+/// thread and refreshed in the onchain thread.
+mempool: MempoolTracker,
 
-/// used only in comm thread; move under mu when no longer the case
-screenstate: enum { locked, unlocked },
+/// read by the comm thread to refuse privileged requests while locked;
+/// set on standby and by the unlock thread.
+screenstate: std.atomic.Value(ScreenState),
+/// pin codes from ngui waiting for verification in the unlock thread; see unlockThreadLoop.
+/// values are allocated with self.allocator.
+unlock_queue: types.MpscQueue([]const u8),
+unlock_wake: std.Thread.ResetEvent = .{},
 
 /// guards all the fields below to sync between pub fns and main/poweroff threads.
-mu: std.Thread.Mutex = .{},
+mu: lockprof.Mutex = .{ .name = .daemon },
+
+/// the bitcoind profile last applied or attempted; see tuneBitcoind.
+bitcoind_profile: ?Config.BitcoindProfile = null,
+/// the channel of the queued sysupdates job; see switchSysupdates.
+sysupdates_chan: comm.Message.SysupdatesChan = .stable,
+/// time.timestamp of the last lnd compaction check; see scheduleLndCompaction.
+lnd_compact_checked: i64 = 0,
+/// bitcoind chain tip and time as of the last flush; see scheduleBitcoindFlush.
+bitcoind_flushed: ?BitcoindFlush = null,
+/// time.timestamp of the last bitcoind flush scheduling.
+bitcoind_flush_checked: i64 = 0,
+/// UTXO snapshot bootstrap progress; see checkBootstrap.
+bootstrap_state: enum { unchecked, off, downloading, validating, done } = .unchecked,
+/// base block height of the loaded snapshot; 0 if unknown yet.
+bootstrap_height: u64 = 0,
+/// cpu frequency governor control; see tuneCpuFreqLocked. null if disabled.
+cpufreq: ?sys.CpuFreq = null,
+/// zram swap; see tuneSwap. null if disabled or unavailable.
+/// used only by the onchain thread.
+zram: ?sys.Zram = null,
+/// whether tuneSwap attempted to set up the device.
+zram_setup: bool = false,
+/// time.timestamp of the last switch to standby.
+standby_since: i64 = 0,
 
 /// daemon state
 state: enum {
@@ -47,28 +258,111 @@ state: enum {
     wallet_reset,
 },
 
+/// whether the screen backlight is dimmed ahead of standby; guarded by mu.
+dimmed: bool = false,
+/// PSI triggers in main_epoll, owned by the main thread; null if unavailable.
+pressure: ?sys.Pressure = null,
+/// whether the node is under resource pressure, shedding load; guarded by mu.
+/// see setPressureLocked.
+pressured: bool = false,
+
 main_thread: ?std.Thread = null,
 comm_thread: ?std.Thread = null,
-poweroff_thread: ?std.Thread = null,
+// report collectors; see onchainThreadLoop and lndThreadLoop.
+onchain_thread: ?std.Thread = null,
+lnd_thread: ?std.Thread = null,
+zmq_thread: ?std.Thread = null, // bitcoind block notifications; see zmqThreadLoop
+tor_thread: ?std.Thread = null, // tor control port events; see torThreadLoop
+unlock_thread: ?std.Thread = null, // screen unlock pin verification; see unlockThreadLoop
+lnd_stream_threads: [lnd_streams.len]?std.Thread = .{null} ** lnd_streams.len, // see LndStreamWorker
 
 want_stop: bool = false, // tells daemon main loop to quit
+/// an eventfd signalled together with want_stop; wakes up the comm and main
+/// threads blocked in poll. created in start.
+stop_event: ?posix.fd_t = null,
+/// an eventfd signalled when main thread want_xxx flags are set; see kickMain.
+main_event: ?posix.fd_t = null,
+/// main thread epoll instance watching stop_event, main_event, wpa_ctrl,
+/// wpa_async and netlink.
+main_epoll: ?posix.fd_t = null,
+/// wake up report collector threads before their next scheduled report.
+onchain_wake: std.Thread.ResetEvent = .{},
+lnd_wake: std.Thread.ResetEvent = .{},
 // send all settings to ngui
 want_settings: bool = false,
 // network flags
 want_network_report: bool, // start gathering network status and send out as soon as ready
 want_wifi_scan: bool, // initiate wifi scan at the next loop cycle
 network_report_ready: bool, // indicates whether the network status is ready to be sent
+/// network reports are sent only while ngui shows them, on subscribe_network,
+/// or once on get_network_report.
+network_subscribed: bool = false,
+network_report_once: bool = false,
+/// the ngui peer view is open, between subscribe_lightning_peers and
+/// unsubscribe_lightning_peers; see servePeerView.
+peer_view_open: bool = false,
+/// the next peer view message lists all peers.
+peer_view_full: bool = false,
 wifi_scan_in_progress: bool = false,
-wpa_save_config_on_connected: bool = false,
+/// latest wifi scan results; updated when a scan completes and merged with
+/// BSS table changes in between, once per main loop cycle.
+wifi_scan: network.WifiScanList,
+wifi_bss_changed: bool = false,
+/// when a scan last completed, time.milliTimestamp; see wifi_scan_fresh_ms.
+wifi_scanned: i64 = 0,
+/// public IP addresses; refreshed on netlink notifications, if available.
+ipaddrs: network.IpAddrList,
+/// notifies the main thread of ipaddrs changes; null if unavailable.
+netlink: ?nif.netlink.AddrMonitor = null,
+/// wifi interface name, as of the wpa_supplicant control socket name.
+wifi_ifname: []const u8,
+/// samples wifi_link every link_sample_interval_ms; null if unavailable.
+link_monitor: ?nif.nl80211.LinkMonitor = null,
+wifi_link: network.WifiLinkQuality = .{},
+/// time.milliTimestamp when the next wifi link sample is due.
+next_link_sample: i64 = 0,
+/// wifi connect procedure progress; see startConnectWifi.
+wifi_connect: WifiConnect = .idle,
 // bitcoin fields
 want_onchain_report: bool,
-bitcoin_timer: time.Timer,
+onchain_reported: u64, // clock.now of the last onchain report
 onchain_report_interval: u64 = 1 * time.ns_per_min,
+/// onchain_report_interval replacement while subscribed to bitcoind new blocks.
+onchain_heartbeat_interval: u64 = 5 * time.ns_per_min,
+zmq_subscribed: bool = false, // whether new blocks trigger onchain reports
+/// tor status as of its control port events; lightning reports wait while
+/// tor bootstraps. guarded by mu.
+tor: TorMonitor = .{},
+onchain_syncing: bool = false, // bitcoind IBD, as of the last onchain report
+/// IBD pace across onchain reports; used only in onchain thread.
+sync_rate: SyncRate = .{},
+/// getnettotals counters of the previous onchain report, for traffic rates;
+/// see netRates. used only in onchain thread.
+net_totals: ?NetTotalsSample = null,
+/// IBD slow peers eviction; null if disabled. used only in onchain thread.
+peer_evictor: ?PeerEvictor = null,
+/// holds back periodic reports unchanged since the last sent; see publishReport.
+report_dedup: ReportDedup = .{},
+/// when the onchain and lightning reports were last collected, sent to ngui
+/// after each collection; see sendReportFreshness.
+report_freshness: comm.Message.ReportFreshness = .{},
+/// hold back onchain and lightning reports while bitcoind or lnd fail them,
+/// probing each with a single call instead; see Breaker.
+bitcoind_breaker: Breaker,
+lnd_breaker: Breaker,
 // lightning fields
 want_lnd_report: bool,
-lnd_timer: time.Timer,
+want_full_lnd_report: bool = false, // send a full report instead of a delta
+lnd_reported: u64, // clock.now of the last lightning report
+/// the lnd wallet balance of onchain reports, as of the last lightning
+/// report or else an onchain report call; see lndBalance.
+lnd_balance: ?LndBalance = null,
 lnd_report_interval: u64 = 1 * time.ns_per_min,
+lnd_syncing: bool = false, // lnd not synced to chain or graph, as of the last report
 lnd_tls_reset_count: usize = 0,
+/// sockets of lnd_streams subscriptions in progress, if any.
+/// shut down by setWantStop to unblock the subscriber threads.
+lnd_stream_fds: [lnd_streams.len]?posix.fd_t = .{null} ** lnd_streams.len,
 
 // TODO: move this to a sys.ServiceList
 /// system services actively managed by the daemon.
@@ -95,6 +389,15 @@ services: struct {
         return error.NoSuchServiceToStart;
     }
 
+    fn startReady(self: @This(), name: []const u8, probe: anytype, opts: sys.Service.ReadyOpts) !void {
+        for (self.list) |*sv| {
+            if (std.mem.eql(u8, sv.name, name)) {
+                return sv.startReady(probe, opts);
+            }
+        }
+        return error.NoSuchServiceToStart;
+    }
+
     fn deinit(self: @This(), allocator: std.mem.Allocator) void {
         for (self.list) |*sv| {
             sv.deinit();
@@ -105,10 +408,34 @@ services: struct {
 
 const Daemon = @This();
 
+const ScreenState = enum(u8) { locked, unlocked };
+
+/// a lightning_get_channels query owning its search text, which is otherwise
+/// freed along with the request message.
+const ChannelView = struct {
+    query: comm.Message.LightningChannelsQuery,
+    search: std.BoundedArray(u8, comm.Message.LightningChannelsQuery.max_search_len) = .{},
+
+    fn init(q: comm.Message.LightningChannelsQuery) ChannelView {
+        var v: ChannelView = .{ .query = q };
+        v.search.appendSliceAssumeCapacity(q.search[0..@min(q.search.len, v.search.buffer.len)]);
+        v.query.search = "";
+        return v;
+    }
+
+    /// the returned search text points into self.
+    fn get(self: *const ChannelView) comm.Message.LightningChannelsQuery {
+        var q = self.query;
+        q.search = self.search.constSlice();
+        return q;
+    }
+};
+
 const Error = error{
     InvalidState,
     WalletResetActive,
     PoweroffActive,
+    MaintenanceActive,
     AlreadyStarted,
     ConnectWifiEmptySSID,
     MakeWalletUnlockFileFail,
@@ -125,8 +452,71 @@ const InitOpt = struct {
     uir: std.fs.File.Reader,
     uiw: std.fs.File.Writer,
     wpa: [:0]const u8,
+    /// prometheus text file to export timing metrics to, if any.
+    metrics_path: ?[]const u8 = null,
+    /// file to store reports history in, if any.
+    history_path: ?[]const u8 = null,
+    /// file to store forwarding history aggregates in, if any.
+    forwards_path: ?[]const u8 = null,
+    /// file to store the payments history in, if any.
+    payments_path: ?[]const u8 = null,
+    /// file to store the onchain transactions history in, if any.
+    txhistory_path: ?[]const u8 = null,
+    /// file to keep the last reports in across restarts, if any.
+    snapshot_path: ?[]const u8 = null,
+    /// file to export lnd static channel backups to, if any; see ChanBackup.
+    chanbackup_path: ?[]const u8 = null,
+    /// unix socket to stream reports to subscribers on, if any.
+    subscribers_path: ?[]const u8 = null,
+    /// bitcoind config file to apply tuning profiles to; null disables tuning.
+    bitcoind_conf_path: ?[]const u8 = null,
+    /// lnd channel.db to compact once grown; null disables compaction.
+    lnd_channeldb_path: ?[]const u8 = null,
+    /// a UTXO set snapshot to bootstrap a fresh node from; null disables it.
+    utxo_snapshot: ?UtxoSnapshot = null,
+    /// bitcoind debug.log to report startup progress from, if any.
+    bitcoind_log_path: ?[]const u8 = null,
+    /// time source of the report threads scheduling; simulated in tests.
+    clock: sys.Clock = sys.Clock.system,
+    /// restarts ngui once its pipe breaks; null stops the daemon instead.
+    ui_spawner: ?UiSpawner = null,
+    /// a shared memory region inherited by ngui, with each new ngui; see
+    /// comm.ShmSnapshot. referenced, not owned.
+    ui_shm: ?*comm.ShmSnapshot = null,
+    /// sysfs root to manage the cpufreq governor under, "/" in production;
+    /// null leaves the governor as is.
+    cpufreq_root: ?[]const u8 = null,
+    /// sysfs and procfs root to set up zram swap under, "/" in production;
+    /// null leaves swap as is.
+    zram_root: ?[]const u8 = null,
+    /// cgroups of the services, with nd and ngui in the ui group already.
+    /// referenced, not owned.
+    cgroups: ?*sys.Cgroups = null,
+    /// disconnect peers lagging behind the others in bitcoind IBD.
+    ibd_evict: bool = false,
+    /// bitcoind serves the REST interface; see bitcoindrpc.Client.rest.
+    bitcoind_rest: bool = false,
 };
 
+/// restarts the ngui process; see respawnUi.
+pub const UiSpawner = struct {
+    ctx: *anyopaque,
+    /// reaps the exited ngui, closing its pipe, and starts a new process.
+    /// returns the pipe to read from its stdout and write to its stdin.
+    func: *const fn (ctx: *anyopaque) anyerror!types.IoPipe,
+};
+
+/// ngui respawn delay after a crash shortly after the previous start,
+/// doubled after each such crash up to the max.
+const ui_respawn_min_delay_ms = 100;
+const ui_respawn_max_delay_ms = 30 * time.ms_per_s;
+/// ngui running for this long is restarted right away once it exits.
+const ui_respawn_stable_ms = 1 * time.ms_per_min;
+
+/// worker threads of self.workers: enough for a long bootstrap download,
+/// a nodename change and a poweroff at the same time.
+const worker_count = 3;
+
 /// initializes a daemon instance using the provided GUI stdout reader and stdin writer,
 /// and a filesystem path to WPA control socket.
 /// callers must deinit when done.
@@ -139,29 +529,116 @@ pub fn init(opt: InitOpt) !Daemon {
     // the order is important. when powering off, the services are shut down
     // in the same order appended here.
     try svlist.append(sys.Service.init(opt.allocator, sys.Service.LND, .{ .stop_wait_sec = 600 }));
-    try svlist.append(sys.Service.init(opt.allocator, sys.Service.BITCOIND, .{ .stop_wait_sec = 600 }));
+    try svlist.append(sys.Service.init(opt.allocator, sys.Service.BITCOIND, .{
+        .stop_wait_sec = 600,
+        .stop_after = &.{sys.Service.LND}, // lnd relies on bitcoind
+    }));
 
     return .{
         .allocator = opt.allocator,
+        .clock = opt.clock,
         .conf = opt.conf,
         .uireader = opt.uir,
-        .uiwriter = opt.uiw,
+        .ui_spawner = opt.ui_spawner,
+        .uishm = opt.ui_shm,
+        .ui_started = time.milliTimestamp(),
+        .uiwriter = comm.QueueWriter.init(memacct.tagged(.comm, allocprof.tagged(.comm, opt.allocator)), opt.uiw.context),
         .wpa_ctrl = try types.WpaControl.open(opt.wpa),
+        .wpa_async = try types.WpaAsyncControl.open(opt.wpa),
+        .bitcoind = .{
+            .allocator = memacct.tagged(.rpc, allocprof.tagged(.bitcoindrpc, opt.allocator)),
+            .cookiepath = "/ssd/bitcoind/mainnet/.cookie",
+            .keepalive = true,
+            .rest = opt.bitcoind_rest,
+        },
+        .lndc = LndClientCache.init(.{
+            .allocator = memacct.tagged(.rpc, allocprof.tagged(.lndhttp, opt.allocator)),
+            .tlscert_path = Config.LND_TLSCERT_PATH,
+            .macaroon_ro_path = Config.LND_MACAROON_RO_PATH,
+            .macaroon_admin_path = Config.LND_MACAROON_ADMIN_PATH,
+        }),
+        .arena_pool = types.ArenaPool.init(opt.allocator),
+        .metrics = Metrics.init(opt.metrics_path),
+        .history = if (opt.history_path) |path| History.open(path) catch |err| blk: {
+            logger.err("history: {s}: {!}; trends disabled", .{ path, err });
+            break :blk null;
+        } else null,
+        .snapshot = if (opt.snapshot_path) |path| ReportSnapshot.init(opt.allocator, path) else null,
+        .subscribers = if (opt.subscribers_path) |path| Subscribers.init(memacct.tagged(.comm, opt.allocator), path) else null,
+        .peer_aliases = PeerAliasCache.init(opt.allocator, 1 * time.ms_per_hour),
+        .peer_view = PeerView.init(opt.allocator),
+        .lnd_pairing = LndPairing.init(opt.allocator, Config.LND_MACAROON_ADMIN_PATH),
+        .chan_details = ChanInfoCache.init(opt.allocator, 10 * time.ms_per_min),
+        .lnd_report_diff = LndReportDiff.init(opt.allocator),
+        .bitcoind_breaker = Breaker.init(.{
+            .min_backoff_ns = 1 * time.ns_per_s,
+            .max_backoff_ns = 30 * time.ns_per_s,
+            .seed = std.crypto.random.int(u64),
+        }),
+        .lnd_breaker = Breaker.init(.{
+            .min_backoff_ns = 1 * time.ns_per_s,
+            .max_backoff_ns = 60 * time.ns_per_s,
+            .seed = std.crypto.random.int(u64),
+        }),
+        .lnd_report_scratch = LndReportScratch.init(opt.allocator),
+        .channel_index = ChannelIndex.init(opt.allocator),
+        .utxos = UtxoSet.init(opt.allocator),
+        .forwards = if (opt.forwards_path) |path| Forwards.load(opt.allocator, path) catch |err| blk: {
+            logger.err("forwards: {s}: {!}; channel earnings disabled", .{ path, err });
+            break :blk null;
+        } else null,
+        .payments = if (opt.payments_path) |path| PaymentsLog.open(opt.allocator, path) catch |err| blk: {
+            logger.err("payments: {s}: {!}; payments history disabled", .{ path, err });
+            break :blk null;
+        } else null,
+        .txhistory = if (opt.txhistory_path) |path| TxHistory.open(opt.allocator, path) catch |err| blk: {
+            logger.err("txhistory: {s}: {!}; transactions history disabled", .{ path, err });
+            break :blk null;
+        } else null,
+        .chanbackup = if (opt.chanbackup_path) |path| ChanBackup.init(opt.allocator, path) else null,
+        .htlc_activity = HtlcActivity.init(opt.allocator),
+        .channel_graph = ChannelGraph.init(opt.allocator),
+        .jobs = JobScheduler.init(opt.allocator),
+        .workers = WorkerPool.init(opt.allocator),
+        .bitcoind_conf_path = opt.bitcoind_conf_path,
+        .cgroups = opt.cgroups,
+        .cpufreq = if (opt.cpufreq_root) |root| sys.CpuFreq.init(root) catch |err| blk: {
+            logger.info("cpufreq: {!}; governor left as is", .{err});
+            break :blk null;
+        } else null,
+        .zram = if (opt.zram_root) |root| sys.Zram.init(root) catch |err| blk: {
+            logger.info("zram: {!}; swap left as is", .{err});
+            break :blk null;
+        } else null,
+        .peer_evictor = if (opt.ibd_evict) .{} else null,
+        .lnd_channeldb_path = opt.lnd_channeldb_path,
+        .utxo_snapshot = opt.utxo_snapshot,
+        .bitcoind_log = if (opt.bitcoind_log_path) |p| .{ .path = p } else null,
+        .mempool = MempoolTracker.init(opt.allocator),
+        .block_stats = BlockStatsCache.init(opt.allocator, recent_blocks_count + 4),
+        .sampler = sys.Sampler.init("/", &.{ sys.Service.LND, sys.Service.BITCOIND }) catch |err| blk: {
+            logger.err("sampler: {!}; system reports disabled", .{err});
+            break :blk null;
+        },
         .state = .stopped,
-        .screenstate = if (opt.conf.data.slock != null) .locked else .unlocked,
+        .screenstate = std.atomic.Value(ScreenState).init(if (opt.conf.snapshot().data.slock != null) .locked else .unlocked),
+        .unlock_queue = types.MpscQueue([]const u8).init(opt.allocator),
         .services = .{ .list = try svlist.toOwnedSlice() },
         // send persisted settings immediately on start
         .want_settings = true,
         // send a network report right at start without wifi scan to make it faster.
         .want_network_report = true,
         .want_wifi_scan = false,
+        .wifi_scan = network.WifiScanList.init(memacct.tagged(.network, opt.allocator)),
+        .ipaddrs = network.IpAddrList.init(memacct.tagged(.network, opt.allocator)),
+        .wifi_ifname = std.fs.path.basename(opt.wpa),
         .network_report_ready = true,
         // report bitcoind status immediately on start
         .want_onchain_report = true,
-        .bitcoin_timer = try time.Timer.start(),
+        .onchain_reported = opt.clock.now(),
         // report lightning status immediately on start
         .want_lnd_report = true,
-        .lnd_timer = try time.Timer.start(),
+        .lnd_reported = opt.clock.now(),
     };
 }
 
@@ -169,7 +646,75 @@ pub fn init(opt: InitOpt) !Daemon {
 /// the daemon must be stop'ed and wait'ed before deiniting.
 pub fn deinit(self: *Daemon) void {
     self.wpa_ctrl.close() catch |err| logger.err("deinit: wpa_ctrl.close: {any}", .{err});
+    self.wpa_async.close();
+    inline for (.{ "stop_event", "main_event", "main_epoll" }) |name| {
+        if (@field(self, name)) |fd| {
+            posix.close(fd);
+        }
+    }
+    self.bitcoind.deinit();
+    self.mempool.deinit();
+    self.block_stats.deinit();
+    self.lndc.deinit();
+    self.peer_aliases.deinit();
+    self.peer_view.deinit();
+    self.lnd_pairing.deinit();
+    self.chan_details.deinit();
+    self.htlc_activity.deinit();
+    self.channel_graph.deinit();
+    if (self.history) |*h| {
+        h.close();
+    }
+    if (self.snapshot) |*snap| {
+        snap.deinit();
+    }
+    self.lnd_report_diff.deinit();
+    self.lnd_report_scratch.deinit();
+    self.channel_index.deinit();
+    self.utxos.deinit();
+    if (self.forwards) |*fw| {
+        fw.deinit();
+    }
+    if (self.payments) |*p| {
+        p.close();
+    }
+    if (self.txhistory) |*h| {
+        h.close();
+    }
+    if (self.sampler) |*s| {
+        s.deinit();
+    }
+    if (self.cpufreq) |*cf| {
+        cf.deinit();
+    }
+    if (self.zram) |*z| {
+        z.deinit();
+    }
+    self.jobs.deinit();
+    self.workers.deinit();
+    self.uiwriter.deinit();
+    self.wifi_scan.deinit();
+    self.ipaddrs.deinit();
+    self.setWifiConnect(.idle);
+    if (self.netlink) |nl| {
+        nl.close();
+    }
+    if (self.link_monitor) |lm| {
+        lm.close();
+    }
+    if (self.pressure) |*p| {
+        p.deinit();
+    }
+    if (self.netinfo_cache) |c| {
+        c.res.deinit();
+    }
     self.services.deinit(self.allocator);
+    var pins = self.unlock_queue.takeAll();
+    while (pins.next()) |pin| {
+        self.allocator.free(pin);
+    }
+    // last: all pooled call results are deinit'ed by now.
+    self.arena_pool.deinit();
 }
 
 /// start launches daemon threads and returns immediately.
@@ -184,32 +729,234 @@ pub fn start(self: *Daemon) !void {
         else => return Error.AlreadyStarted,
     }
 
+    if (self.stop_event == null) {
+        self.stop_event = try posix.eventfd(0, linux.EFD.CLOEXEC);
+    }
+    if (self.main_event == null) {
+        self.main_event = try posix.eventfd(0, linux.EFD.CLOEXEC | linux.EFD.NONBLOCK);
+    }
+    if (self.main_epoll == null) {
+        const epfd = try posix.epoll_create1(linux.EPOLL.CLOEXEC);
+        errdefer posix.close(epfd);
+        try epollAdd(epfd, self.stop_event.?, .stop);
+        try epollAdd(epfd, self.main_event.?, .kick);
+        const wpafd = self.wpa_ctrl.fd();
+        if (wpafd >= 0) { // unavailable in tests
+            try epollAdd(epfd, wpafd, .wpa);
+        }
+        const asyncfd = self.wpa_async.fd();
+        if (asyncfd >= 0) { // unavailable in tests
+            try epollAdd(epfd, asyncfd, .wpa_reply);
+        }
+        // without the monitor, each network report re-reads ipaddrs.
+        if (nif.netlink.AddrMonitor.open()) |mon| {
+            self.netlink = mon;
+            try epollAdd(epfd, mon.fd(), .netlink);
+            self.ipaddrs.watched = if (self.ipaddrs.refresh()) |_| true else |_| false;
+        } else |err| {
+            logger.err("netlink addr monitor: {any}", .{err});
+        }
+        // network reports go without wifi link quality if unavailable.
+        if (nif.nl80211.LinkMonitor.open(self.wifi_ifname)) |lm| {
+            self.link_monitor = lm;
+        } else |err| switch (err) {
+            // no wifi, as on an ethernet-only node.
+            error.NoSuchInterface, error.Nl80211Unavailable => logger.info("nl80211 link monitor {s}: {any}", .{ self.wifi_ifname, err }),
+            else => logger.err("nl80211 link monitor {s}: {any}", .{ self.wifi_ifname, err }),
+        }
+        // reports and jobs keep their usual pace without PSI. the host
+        // pressure must not pace tests.
+        if (!builtin.is_test) {
+            if (sys.Pressure.init()) |p| {
+                self.pressure = p;
+                for (std.enums.values(sys.Pressure.Resource)) |r| {
+                    if (p.fd(r)) |fd| {
+                        try epollAddEvents(epfd, fd, linux.EPOLL.PRI, pressureEvent(r));
+                    }
+                }
+            } else |err| {
+                logger.info("psi: {any}", .{err});
+            }
+        }
+        self.main_epoll = epfd;
+    }
+    // self is at its final address only once started.
+    self.bitcoind.observer = self.metrics.bitcoindObserver();
+    self.lndc.opt.observer = self.metrics.lndObserver();
+    self.bitcoind.arena_pool = &self.arena_pool;
+    self.lndc.opt.arena_pool = &self.arena_pool;
     try self.wpa_ctrl.attach();
     self.want_stop = false;
     errdefer {
         self.wpa_ctrl.detach() catch {};
-        self.want_stop = true;
+        self.setWantStop();
     }
 
+    try self.uiwriter.start();
+    errdefer self.uiwriter.stop();
+    if (self.snapshot) |*snap| {
+        self.sendSnapshot(snap);
+        try snap.start();
+    }
+    errdefer if (self.snapshot) |*snap| snap.stop();
+    if (self.subscribers) |*subs| {
+        try subs.start();
+    }
+    errdefer if (self.subscribers) |*subs| subs.stop();
+    self.jobs.reporter = .{ .ctx = self, .reportFn = sendJobReport };
+    try self.jobs.start();
+    errdefer self.jobs.stop();
+    self.workers.reporter = .{ .ctx = self, .reportFn = sendTaskResult };
+    try self.workers.start(worker_count);
+    errdefer self.workers.stop();
     self.main_thread = try std.Thread.spawn(.{}, mainThreadLoop, .{self});
     self.comm_thread = try std.Thread.spawn(.{}, commThreadLoop, .{self});
+    self.onchain_thread = try std.Thread.spawn(.{}, onchainThreadLoop, .{self});
+    self.lnd_thread = try std.Thread.spawn(.{}, lndThreadLoop, .{self});
+    self.zmq_thread = try std.Thread.spawn(.{}, zmqThreadLoop, .{self});
+    self.tor_thread = try std.Thread.spawn(.{}, torThreadLoop, .{self});
+    self.unlock_thread = try std.Thread.spawn(.{}, unlockThreadLoop, .{self});
+    inline for (&self.lnd_stream_threads, 0..) |*th, i| {
+        th.* = try std.Thread.spawn(.{}, LndStreamWorker(i).run, .{self});
+    }
     self.state = .running;
 }
 
+/// a bitcoind breaker probe: the cheapest call telling whether bitcoind
+/// serves RPC again; see Breaker.
+fn probeBitcoind(self: *Daemon) !void {
+    const res = try self.bitcoind.call(.getblockchaininfo, {});
+    res.deinit();
+}
+
+/// a report refresh, all its bitcoind or lnd calls together, is abandoned
+/// past this deadline; ngui is then sent the last report marked stale.
+const report_deadline_ms = 30 * time.ms_per_s;
+
+/// report data older than this many collection intervals, on top of the
+/// report deadline, is stale; see comm.Message.ReportFreshness.
+const stale_intervals = 3;
+
+/// records a successful collection of the report kind started at start,
+/// a time.nanoTimestamp, with the next one due in interval_ns, and sends ngui
+/// the freshness of all reports. callers must not hold self.mu.
+fn sendReportFreshness(self: *Daemon, kind: ReportSnapshot.Kind, start: i128, interval_ns: u64) void {
+    const now = time.nanoTimestamp();
+    const f: comm.Message.ReportFreshness.Freshness = .{
+        .collected_at = std.math.lossyCast(u64, @divTrunc(now, time.ns_per_s)),
+        .collect_ms = std.math.lossyCast(u32, @divTrunc(now - start, time.ns_per_ms)),
+        .stale_after_sec = std.math.lossyCast(u32, stale_intervals * interval_ns / time.ns_per_s + report_deadline_ms / time.ms_per_s),
+    };
+    self.mu.lock();
+    switch (kind) {
+        .onchain => self.report_freshness.onchain = f,
+        .lightning => self.report_freshness.lightning = f,
+    }
+    const msg = self.report_freshness;
+    self.mu.unlock();
+    self.uiwrite(.{ .report_freshness = msg }) catch |err| logger.err("report_freshness: {!}", .{err});
+}
+
+/// resends ngui the last report of the kind, if kept in the snapshot, with
+/// its age: a refresh ran out of report_deadline_ms.
+fn sendStaleReport(self: *Daemon, kind: ReportSnapshot.Kind) void {
+    const snap = if (self.snapshot) |*s| s else return;
+    const res = snap.stale(kind) catch |err| {
+        logger.err("stale {s} report: {!}", .{ @tagName(kind), err });
+        return;
+    };
+    const msg = res orelse return;
+    defer msg.deinit();
+    // the next live report is sent even if unchanged since the last one.
+    self.report_dedup.forget(std.meta.activeTag(msg.value));
+    self.uiwrite(msg.value) catch |err| logger.err("stale {s} report: {!}", .{ @tagName(kind), err });
+}
+
+/// sends ngui the reports of a previous run, stale until the first live ones.
+/// a restored report is also the base of lightning report deltas in ngui,
+/// which the first live lightning report replaces in full.
+fn sendSnapshot(self: *Daemon, snap: *ReportSnapshot) void {
+    const msgs = snap.load() catch |err| {
+        logger.err("snapshot load: {!}", .{err});
+        return;
+    };
+    for (msgs.constSlice()) |m| {
+        defer m.deinit();
+        self.uiwrite(m.value) catch |err| logger.err("snapshot {s}: {!}", .{ @tagName(m.value), err });
+    }
+}
+
 /// tells the daemon to stop threads to prepare for termination.
 /// stop returns immediately.
 /// callers must `wait` to release all resources.
 pub fn stop(self: *Daemon) void {
     self.mu.lock();
     defer self.mu.unlock();
+    self.setWantStop();
+}
+
+/// sets want_stop and wakes up the comm thread.
+/// callers must hold self.mu.
+fn setWantStop(self: *Daemon) void {
     self.want_stop = true;
+    if (self.stop_event) |fd| {
+        signalEventFd(fd) catch |err| logger.err("stop_event: {any}", .{err});
+    }
+    self.onchain_wake.set();
+    self.lnd_wake.set();
+    self.unlock_wake.set();
+    for (self.lnd_stream_fds) |v| {
+        if (v) |fd| {
+            posix.shutdown(fd, .both) catch {};
+        }
+    }
+}
+
+/// wakes up the main thread to act on want_xxx flags.
+/// callers must hold self.mu.
+fn kickMain(self: *Daemon) void {
+    if (self.main_event) |fd| {
+        signalEventFd(fd) catch |err| logger.err("main_event: {any}", .{err});
+    }
+}
+
+fn signalEventFd(fd: posix.fd_t) !void {
+    const one: u64 = 1;
+    _ = try posix.write(fd, mem.asBytes(&one));
+}
+
+/// main thread epoll event sources.
+const MainEvent = enum(u32) {
+    stop, // stop_event
+    kick, // main_event
+    wpa, // wpa_ctrl monitor messages
+    wpa_reply, // replies to wpa_async requests
+    netlink, // ip addresses changes
+    // PSI triggers; see sys.Pressure
+    pressure_cpu,
+    pressure_memory,
+    pressure_io,
+};
+
+fn pressureEvent(r: sys.Pressure.Resource) MainEvent {
+    return switch (r) {
+        .cpu => .pressure_cpu,
+        .memory => .pressure_memory,
+        .io => .pressure_io,
+    };
+}
+
+fn epollAdd(epfd: posix.fd_t, fd: posix.fd_t, id: MainEvent) !void {
+    return epollAddEvents(epfd, fd, linux.EPOLL.IN, id);
+}
+
+fn epollAddEvents(epfd: posix.fd_t, fd: posix.fd_t, events: u32, id: MainEvent) !void {
+    var ev = linux.epoll_event{ .events = events, .data = .{ .u32 = @intFromEnum(id) } };
+    try posix.epoll_ctl(epfd, linux.EPOLL.CTL_ADD, fd, &ev);
 }
 
 /// blocks and waits for all threads to terminate. the daemon instance cannot
 /// be start'ed afterwards.
-///
-/// note that in order for wait to return, the GUI I/O reader provided at init
-/// must be closed.
 pub fn wait(self: *Daemon) void {
     if (self.main_thread) |th| {
         th.join();
@@ -219,10 +966,44 @@ pub fn wait(self: *Daemon) void {
         th.join();
         self.comm_thread = null;
     }
-    // must be the last one to join because it sends a final poweroff report.
-    if (self.poweroff_thread) |th| {
+    if (self.onchain_thread) |th| {
+        th.join();
+        self.onchain_thread = null;
+    }
+    if (self.lnd_thread) |th| {
         th.join();
-        self.poweroff_thread = null;
+        self.lnd_thread = null;
+    }
+    if (self.zmq_thread) |th| {
+        th.join();
+        self.zmq_thread = null;
+    }
+    if (self.tor_thread) |th| {
+        th.join();
+        self.tor_thread = null;
+    }
+    if (self.unlock_thread) |th| {
+        th.join();
+        self.unlock_thread = null;
+    }
+    for (&self.lnd_stream_threads) |*v| {
+        if (v.*) |th| {
+            th.join();
+            v.* = null;
+        }
+    }
+    // running jobs are left to finish.
+    self.jobs.stop();
+    // must be the last one to stop because the poweroff task sends a final
+    // poweroff report. other tasks are cancelled.
+    self.workers.stop();
+    // sends whatever is left, including the final poweroff report.
+    self.uiwriter.stop();
+    if (self.snapshot) |*snap| {
+        snap.stop();
+    }
+    if (self.subscribers) |*subs| {
+        subs.stop();
     }
 
     self.wpa_ctrl.detach() catch |err| logger.err("wait: wpa_ctrl.detach: {any}", .{err});
@@ -238,35 +1019,73 @@ fn standby(self: *Daemon) !void {
         .stopped, .poweroff => return Error.InvalidState,
         .wallet_reset => return Error.WalletResetActive,
         .running => {
-            const has_lock = self.conf.safeReadOnly(struct {
-                fn f(data: Config.Data, _: Config.StaticData) bool {
-                    return data.slock != null;
-                }
-            }.f);
-            if (has_lock) {
-                self.screenstate = .locked;
+            if (self.conf.snapshot().data.slock != null) {
+                self.screenstate.store(.locked, .monotonic);
             }
             self.state = .standby;
+            self.standby_since = time.timestamp();
+            self.jobs.setStandby(true);
             try screen.backlight(.off);
         },
     }
 }
 
-/// tells the daemon to return from standby, typically due to user interaction.
+/// screen backlight brightness while dimmed.
+const dim_brightness = screen.max_brightness / 8;
+
+/// tells the daemon to dim the screen, typically ahead of standby.
+/// the brightness is restored on wakeup.
+fn dim(self: *Daemon) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    switch (self.state) {
+        .standby => {}, // backlight is off already
+        .stopped, .poweroff => return Error.InvalidState,
+        .running, .wallet_reset => {
+            if (!self.dimmed) {
+                try screen.setBrightness(dim_brightness);
+                self.dimmed = true;
+            }
+        },
+    }
+}
+
+/// restores full screen brightness if dimmed. the caller holds self.mu.
+fn undimLocked(self: *Daemon) !void {
+    if (self.dimmed) {
+        try screen.setBrightness(screen.max_brightness);
+        self.dimmed = false;
+    }
+}
+
+/// tells the daemon to return from standby or dimmed screen, typically due
+/// to user interaction.
 fn wakeup(self: *Daemon) !void {
     self.mu.lock();
     defer self.mu.unlock();
     switch (self.state) {
-        .running, .wallet_reset => {},
+        .running, .wallet_reset => try self.undimLocked(),
         .stopped, .poweroff => return Error.InvalidState,
         .standby => {
             try screen.backlight(.on);
+            try self.undimLocked();
             self.state = .running;
+            self.jobs.setStandby(false);
+            self.tuneCpuFreqLocked();
+            // resync ngui with a full lightning report, and refresh all
+            // reports right away since polling slows down in standby.
+            self.want_full_lnd_report = true;
+            self.want_onchain_report = true;
+            self.want_lnd_report = true;
+            self.bitcoind_breaker.reset();
+            self.lnd_breaker.reset();
+            self.onchain_wake.set();
+            self.lnd_wake.set();
         },
     }
 }
 
-/// initiates system poweroff sequence in a separate thread: shut down select
+/// initiates system poweroff sequence in a worker task: shut down select
 /// system services such as lnd and bitcoind, and issue "poweroff" command.
 ///
 /// beingPoweroff also makes other threads exit but callers must still call `wait`
@@ -279,20 +1098,21 @@ fn beginPoweroff(self: *Daemon) !void {
         .stopped => return Error.InvalidState,
         .wallet_reset => return Error.WalletResetActive,
         .running, .standby => {
-            self.poweroff_thread = try std.Thread.spawn(.{}, poweroffThread, .{self});
+            try self.workers.submit(.{ .name = "poweroff", .report = false, .ctx = self, .runFn = poweroffTask });
             self.state = .poweroff;
-            self.want_stop = true;
+            self.setWantStop();
         },
     }
 }
 
-/// set when poweroff_thread starts. available in tests only.
+/// set when the poweroff task starts. available in tests only.
 var test_poweroff_started = if (builtin.is_test) std.Thread.ResetEvent{} else {};
 
-/// the poweroff thread entry point: stops all monitored services and issues poweroff
-/// command while reporting the progress to ngui.
-/// exits after issuing "poweroff" command.
-fn poweroffThread(self: *Daemon) void {
+/// the poweroff task: stops all monitored services and issues poweroff
+/// command while reporting the progress to ngui. it can't be cancelled.
+/// returns after issuing "poweroff" command.
+fn poweroffTask(ctx: *anyopaque, _: WorkerPool.Token) !void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
     if (builtin.is_test) {
         test_poweroff_started.set();
     }
@@ -300,19 +1120,14 @@ fn poweroffThread(self: *Daemon) void {
     screen.backlight(.on) catch |err| {
         logger.err("screen.backlight(.on) during poweroff: {any}", .{err});
     };
+    self.mu.lock();
+    self.undimLocked() catch |err| logger.err("undim during poweroff: {any}", .{err});
+    self.mu.unlock();
 
-    // initiate shutdown of all services concurrently.
-    for (self.services.list) |*sv| {
-        sv.stop() catch |err| logger.err("sv stop '{s}': {any}", .{ sv.name, err });
-    }
+    // shut down all services concurrently, in dependency order, reporting
+    // progress as each one stops.
     self.sendPoweroffReport() catch |err| logger.err("sendPoweroffReport: {any}", .{err});
-
-    // wait each service until stopped or error.
-    for (self.services.list) |*sv| {
-        _ = sv.stopWait() catch {};
-        logger.info("{s} sv is now stopped; err={any}", .{ sv.name, sv.lastStopError() });
-        self.sendPoweroffReport() catch |err| logger.err("sendPoweroffReport: {any}", .{err});
-    }
+    sys.Service.stopAll(self.allocator, self.services.list, self, onServiceStopped);
 
     // finally, initiate system shutdown and power it off.
     var off = types.ChildProcess.init(&.{"poweroff"}, self.allocator);
@@ -320,53 +1135,106 @@ fn poweroffThread(self: *Daemon) void {
     logger.info("poweroff: {any}", .{res});
 }
 
+/// invoked by sys.Service.stopAll from the service stopping thread.
+fn onServiceStopped(self: *Daemon, sv: *sys.Service) void {
+    logger.info("{s} sv is now stopped; err={any}", .{ sv.name, sv.lastStopError() });
+    self.sendPoweroffReport() catch |err| logger.err("sendPoweroffReport: {any}", .{err});
+}
+
 /// main thread entry point: watches for want_xxx flags and monitors network.
+/// the thread sleeps in epoll until wpa_supplicant sends a message, ip addresses
+/// change, want_xxx flags are set with kickMain, a failed cycle step is due
+/// for a retry or the next system sample is due.
 /// exits when want_stop is true.
 fn mainThreadLoop(self: *Daemon) void {
-    var quit = false;
-    while (!quit) {
+    var events: [4]linux.epoll_event = undefined;
+    var timeout: i32 = 0; // run the first cycle immediately
+    while (true) {
+        const n = posix.epoll_wait(self.main_epoll.?, &events, timeout);
+        for (events[0..n]) |ev| {
+            switch (@as(MainEvent, @enumFromInt(ev.data.u32))) {
+                .stop, .wpa, .wpa_reply, .netlink => {}, // checked below and in the cycle
+                .kick => {
+                    var buf: [8]u8 = undefined;
+                    _ = posix.read(self.main_event.?, &buf) catch {}; // reset the counter
+                },
+                // the epoll_wait consumed the trigger event: noted right away.
+                .pressure_cpu => self.pressure.?.note(.cpu, time.milliTimestamp()),
+                .pressure_memory => self.pressure.?.note(.memory, time.milliTimestamp()),
+                .pressure_io => self.pressure.?.note(.io, time.milliTimestamp()),
+            }
+        }
+
         self.mainThreadLoopCycle() catch |err| logger.err("main thread loop: {any}", .{err});
-        std.atomic.spinLoopHint();
-        time.sleep(1 * time.ns_per_s);
 
         self.mu.lock();
-        quit = self.want_stop;
-        self.mu.unlock();
+        defer self.mu.unlock();
+        if (self.want_stop) {
+            break;
+        }
+        // retry failed steps in a second, otherwise wait for the next event
+        // or sample.
+        const pending = self.want_settings or self.want_wifi_scan or
+            (self.wantNetworkReport() and self.network_report_ready) or
+            self.wifi_status_req != null or // reply timeout check
+            self.wifi_connect != .idle; // pending or timeout check
+        timeout = if (pending) 1000 else -1;
+        if (self.sampler != null) {
+            const until_sample = std.math.lossyCast(i32, @max(0, self.next_sample - time.milliTimestamp()));
+            timeout = if (timeout < 0) until_sample else @min(timeout, until_sample);
+        }
+        if (self.link_monitor != null) {
+            const until_sample = std.math.lossyCast(i32, @max(0, self.next_link_sample - time.milliTimestamp()));
+            timeout = if (timeout < 0) until_sample else @min(timeout, until_sample);
+        }
+        if (self.pressure) |p| {
+            if (p.untilCalm(time.milliTimestamp())) |ms| {
+                const until_calm = std.math.lossyCast(i32, ms);
+                timeout = if (timeout < 0) until_calm else @min(timeout, until_calm);
+            }
+        }
+        if (self.untilHtlcSummary(time.milliTimestamp())) |ms| {
+            const until_summary = std.math.lossyCast(i32, ms);
+            timeout = if (timeout < 0) until_summary else @min(timeout, until_summary);
+        }
     }
     logger.info("exiting main thread loop", .{});
 }
 
 /// runs one cycle of the main thread loop iteration.
-/// the cycle holds self.mu for the whole duration.
+/// the cycle holds self.mu for the whole duration. onchain and lightning reports
+/// are collected in their own threads; see onchainThreadLoop and lndThreadLoop.
 fn mainThreadLoopCycle(self: *Daemon) !void {
     self.mu.lock();
     defer self.mu.unlock();
 
     if (self.want_settings) {
-        const ok = self.conf.safeReadOnly(struct {
-            fn f(conf: Config.Data, static: Config.StaticData) bool {
-                const msg: comm.Message.Settings = .{
-                    .hostname = static.hostname,
-                    .slock_enabled = conf.slock != null,
-                    .sysupdates = .{
-                        .channel = switch (conf.syschannel) {
-                            .dev => .edge,
-                            .master => .stable,
-                        },
-                    },
-                };
-                comm.pipeWrite(.{ .settings = msg }) catch |err| {
-                    logger.err("{}", .{err});
-                    return false;
-                };
-                return true;
-            }
-        }.f);
+        const conf = self.conf.snapshot();
+        const msg: comm.Message.Settings = .{
+            .hostname = conf.static.hostname,
+            .slock_enabled = conf.data.slock != null,
+            .sysupdates = .{
+                .channel = switch (conf.data.syschannel) {
+                    .dev => .edge,
+                    .master => .stable,
+                },
+            },
+        };
+        const ok = if (self.uiwrite(.{ .settings = msg })) true else |err| blk: {
+            logger.err("{}", .{err});
+            break :blk false;
+        };
         self.want_settings = !ok;
     }
 
     // network stats
     self.readWPACtrlMsg() catch |err| logger.err("readWPACtrlMsg: {any}", .{err});
+    self.readNetlinkMsg() catch |err| logger.err("readNetlinkMsg: {any}", .{err});
+    if (self.link_monitor != null and time.milliTimestamp() >= self.next_link_sample) {
+        self.next_link_sample = time.milliTimestamp() + link_sample_interval_ms;
+        self.sampleWifiLink();
+    }
+    self.stepWifiConnect();
     if (self.want_wifi_scan) {
         if (self.startWifiScan()) {
             self.want_wifi_scan = false;
@@ -374,84 +1242,1067 @@ fn mainThreadLoopCycle(self: *Daemon) !void {
             logger.err("startWifiScan: {any}", .{err});
         }
     }
-    if (self.want_network_report and self.network_report_ready) {
-        if (network.sendReport(self.allocator, &self.wpa_ctrl, self.uiwriter)) {
-            self.want_network_report = false;
+    if (self.wifi_bss_changed and !self.wifi_scan_in_progress) {
+        self.wifi_bss_changed = false;
+        self.updateWifiScan();
+    }
+    if (self.wantNetworkReport() and self.network_report_ready and self.wifi_status_req == null) {
+        if (!self.wifi_scan.updated) {
+            // results of scans made before nd started, if any.
+            _ = self.wifi_scan.update(&self.wpa_ctrl) catch |err| logger.err("wifi_scan.update: {any}", .{err});
+        }
+        // the report is sent once wpa_supplicant replies; see readWPAReplies.
+        self.wifi_status_started = time.nanoTimestamp();
+        if (self.wpa_async.submit("STATUS", wpa_request_timeout_ms)) |req| {
+            self.wifi_status_req = req;
         } else |err| {
-            logger.err("network.sendReport: {any}", .{err});
+            logger.err("wpa_async STATUS: {any}", .{err});
+            self.sendNetworkReport(null);
         }
     }
+    self.readWPAReplies();
 
-    // onchain bitcoin stats
-    if (self.want_onchain_report or self.bitcoin_timer.read() > self.onchain_report_interval) {
-        // TODO: this takes too long; run in a separate thread
-        if (self.sendOnchainReport()) {
-            self.bitcoin_timer.reset();
-            self.want_onchain_report = false;
-        } else |err| {
-            logger.err("sendOnchainReport: {any}", .{err});
+    const now = time.milliTimestamp();
+    if (self.sampler != null and now >= self.next_sample) {
+        const interval: i64 = if (self.pressured) sample_interval_ms * pressure_interval_factor else sample_interval_ms;
+        self.next_sample = now + interval;
+        self.sampleSystem();
+    }
+    if (self.pressure) |*p| {
+        if (p.update(now)) |on| {
+            const res = p.resources(now);
+            logger.info("resource pressure {s}: cpu={} memory={} io={}", .{
+                if (on) "on" else "off",
+                res.contains(.cpu),
+                res.contains(.memory),
+                res.contains(.io),
+            });
+            self.setPressureLocked(on);
+        }
+    }
+    if (self.untilHtlcSummary(now)) |ms| {
+        if (ms == 0) {
+            self.sendHtlcSummary(now);
         }
     }
+}
 
-    // lightning stats
-    if (self.state != .wallet_reset) {
-        if (self.want_lnd_report or self.lnd_timer.read() > self.lnd_report_interval) {
-            // TODO: this takes too long; run in a separate thread
-            if (self.sendLightningReport()) {
-                self.lnd_timer.reset();
-                self.want_lnd_report = false;
-            } else |err| {
-                logger.info("sendLightningReport: {!}", .{err});
-                self.processLndReportError(err) catch |err2| logger.err("processLndReportError: {!}", .{err2});
-            }
+/// minimal time between routing activity summaries, in ms.
+const htlc_summary_interval_ms = 5 * time.ms_per_s;
+
+/// returns ms until a routing activity summary is due; null if none is.
+/// main thread only.
+fn untilHtlcSummary(self: *const Daemon, now: i64) ?i64 {
+    if (self.htlc_activity.isDirty()) {
+        return @max(0, self.next_htlc_summary - now);
+    }
+    const aging = self.htlc_summary_aging orelse return null;
+    return @max(0, aging - now);
+}
+
+/// sends ngui and subscribers a summary of routing activity: once per
+/// htlc_summary_interval_ms at most rather than on each htlc event.
+/// main thread only.
+fn sendHtlcSummary(self: *Daemon, now: i64) void {
+    const sum = self.htlc_activity.takeSummary(@divTrunc(now, time.ms_per_s));
+    self.next_htlc_summary = now + htlc_summary_interval_ms;
+    self.htlc_summary_aging = if (HtlcActivity.isActive(sum)) now + time.ms_per_min else null;
+    self.publish(.{ .htlc_activity = sum }) catch |err| logger.err("htlc_activity: {!}", .{err});
+}
+
+/// report intervals are this many times longer while shedding load.
+const pressure_interval_factor = 3;
+
+/// sheds load while the node is under resource pressure: reports are polled
+/// less often, background jobs wait and ngui drops optional work; or resumes
+/// all at the usual pace. the caller holds self.mu.
+fn setPressureLocked(self: *Daemon, on: bool) void {
+    self.pressured = on;
+    self.jobs.setPressure(on);
+    self.uiwrite(.{ .load_shed = .{ .on = on } }) catch |err| logger.err("load_shed: {!}", .{err});
+    if (!on) {
+        // back to the usual intervals rather than at the end of a long one.
+        self.onchain_wake.set();
+        self.lnd_wake.set();
+    }
+}
+
+/// returns interval v, lengthened while shedding load.
+/// callers must hold self.mu.
+fn shedInterval(self: *const Daemon, v: u64) u64 {
+    return if (self.pressured) v * pressure_interval_factor else v;
+}
+
+/// how often node resources are sampled and reported to ngui.
+const sample_interval_ms = 10 * time.ms_per_s;
+
+/// how often the wifi link quality is sampled. changes are reported only
+/// if meaningful; see network.WifiLinkQuality.
+const link_sample_interval_ms = 30 * time.ms_per_s;
+
+/// samples the wifi link quality and schedules a network report if it
+/// changed. the caller holds self.mu; self.link_monitor must be non-null.
+fn sampleWifiLink(self: *Daemon) void {
+    const info = self.link_monitor.?.sample() catch |err| {
+        logger.err("nl80211 sample: {any}", .{err});
+        return;
+    };
+    if (self.wifi_link.update(info)) {
+        self.want_network_report = true;
+    }
+}
+
+/// samples node resources for the metrics and sends a system report with
+/// rates since the previous sample. the caller holds self.mu.
+/// self.sampler must be non-null.
+fn sampleSystem(self: *Daemon) void {
+    var cur: sys.Sampler.Sample = undefined;
+    self.sampler.?.sample(&cur);
+    self.metrics.recordSystem(&cur);
+    if (self.last_sample) |*prev| {
+        self.sendSystemReport(prev, &cur) catch |err| logger.err("system report: {!}", .{err});
+        self.jobs.setLoad(nodeLoad(prev, &cur));
+    }
+    self.last_sample = cur;
+}
+
+/// returns the node load since prev, in percent, for the jobs idle window:
+/// the busiest disk or the cpu time of the services over all cores.
+fn nodeLoad(prev: *const sys.Sampler.Sample, cur: *const sys.Sampler.Sample) u8 {
+    const period: u64 = @intCast(@max(1, cur.time - prev.time)); // ms
+    var load: u64 = 0;
+    for (cur.disks.constSlice()) |*d| {
+        const p = prev.disk(d.name.constSlice()) orelse continue;
+        load = @max(load, (d.io_ms -| p.io_ms) * 100 / period);
+    }
+    var ticks: u64 = 0;
+    for (cur.services.constSlice()) |s| {
+        const p = prev.service(s.name) orelse continue;
+        if (s.pid != 0 and p.pid == s.pid) {
+            ticks += s.cpu_ticks -| p.cpu_ticks;
         }
     }
+    const ncpu: u64 = std.Thread.getCpuCount() catch 1;
+    const cpu_ms = ticks * time.ms_per_s / sys.Sampler.user_hz;
+    load = @max(load, cpu_ms * 100 / period / ncpu);
+    return std.math.lossyCast(u8, @min(100, load));
 }
 
-/// comm thread entry point: reads messages sent from ngui and acts accordinly.
-/// exits when want_stop is true or comm reader is closed.
-/// note: the thread might not exit immediately on want_stop because comm.read
-/// is blocking.
-fn commThreadLoop(self: *Daemon) void {
-    var quit = false;
-    loop: while (!quit) {
-        std.atomic.spinLoopHint();
-        time.sleep(100 * time.ns_per_ms);
+fn sendSystemReport(self: *Daemon, prev: *const sys.Sampler.Sample, cur: *const sys.Sampler.Sample) !void {
+    const Report = comm.Message.SystemReport;
+    const period: u64 = @intCast(@max(1, cur.time - prev.time)); // ms
+    const rate = struct {
+        fn f(new: u64, old: u64, ms: u64) u64 {
+            return (new -| old) * time.ms_per_s / ms;
+        }
+    }.f;
 
-        const res = comm.read(self.allocator, self.uireader) catch |err| {
-            self.mu.lock();
-            defer self.mu.unlock();
-            if (self.want_stop) {
-                break :loop; // pipe is most likely already closed
+    var services: [sys.Sampler.max_services]Report.Service = undefined;
+    for (cur.services.constSlice(), services[0..cur.services.len]) |s, *out| {
+        out.* = .{ .name = s.name, .running = s.pid != 0, .cpu = 0, .rss = s.rss, .read = null, .write = null };
+        // counters of a restarted process start over: rates resume with the next sample.
+        const p = prev.service(s.name) orelse continue;
+        if (s.pid == 0 or p.pid != s.pid) {
+            continue;
+        }
+        const cpu_ms = (s.cpu_ticks -| p.cpu_ticks) * time.ms_per_s / sys.Sampler.user_hz;
+        out.cpu = std.math.lossyCast(u16, cpu_ms * 100 / period);
+        if (s.io != null and p.io != null) {
+            out.read = rate(s.io.?.read, p.io.?.read, period);
+            out.write = rate(s.io.?.write, p.io.?.write, period);
+        }
+    }
+    var disks: [sys.Sampler.max_disks]Report.Disk = undefined;
+    for (cur.disks.constSlice(), disks[0..cur.disks.len]) |*d, *out| {
+        const p = prev.disk(d.name.constSlice()) orelse d.*;
+        out.* = .{
+            .name = d.name.constSlice(),
+            .read = rate(d.read, p.read, period),
+            .write = rate(d.write, p.write, period),
+            .busy = std.math.lossyCast(u8, @min(100, (d.io_ms -| p.io_ms) * 100 / period)),
+        };
+    }
+    try self.publish(.{ .system_report = .{
+        .period = std.math.lossyCast(u32, period),
+        .services = services[0..cur.services.len],
+        .disks = disks[0..cur.disks.len],
+        .temps = cur.temps.constSlice(),
+        .throttled = cur.throttled,
+    } });
+}
+
+/// max time to wait for a wpa_async reply, in milliseconds.
+const wpa_request_timeout_ms = 5000;
+
+/// reads all available wpa_async replies and completes a pending network
+/// report, if any. a report of a timed out request goes without the SSID.
+/// the caller holds self.mu.
+fn readWPAReplies(self: *Daemon) void {
+    var buf: [512]u8 = undefined;
+    while (true) {
+        const reply = self.wpa_async.receive(&buf) catch |err| {
+            logger.err("wpa_async.receive: {any}", .{err});
+            break;
+        } orelse break;
+        if (self.wifi_status_req != null and reply.req.id == self.wifi_status_req.?.id) {
+            self.wifi_status_req = null;
+            self.sendNetworkReport(network.parseStatusSSID(reply.data));
+        }
+    }
+    while (self.wpa_async.expire(time.milliTimestamp())) |req| {
+        if (self.wifi_status_req != null and req.id == self.wifi_status_req.?.id) {
+            logger.err("wpa_async STATUS: timed out", .{});
+            self.wifi_status_req = null;
+            self.sendNetworkReport(null);
+        }
+    }
+}
+
+/// sends out a network report with the currently connected wifi_ssid, if any.
+/// want_network_report remains set on failure, for a retry.
+/// the caller holds self.mu.
+fn sendNetworkReport(self: *Daemon, wifi_ssid: ?[]const u8) void {
+    const res = network.sendReport(wifi_ssid, &self.ipaddrs, &self.wifi_scan, &self.wifi_link, &self.uiwriter);
+    self.metrics.recordReport(.network, self.wifi_status_started, !std.meta.isError(res));
+    if (res) {
+        self.want_network_report = false;
+        self.network_report_once = false;
+    } else |err| {
+        logger.err("network.sendReport: {any}", .{err});
+    }
+}
+
+/// reports whether a network report is due and someone wants it: changes
+/// while unsubscribed are sent once ngui subscribes again.
+/// the caller holds self.mu.
+fn wantNetworkReport(self: *Daemon) bool {
+    return self.want_network_report and (self.network_subscribed or self.network_report_once);
+}
+
+/// onchain report collector thread entry point.
+/// bitcoind RPC calls may take seconds, especially during IBD. so, unlike
+/// mainThreadLoopCycle, self.mu is held only to read and update the scheduling
+/// fields, never during network I/O.
+/// exits when want_stop is true.
+fn onchainThreadLoop(self: *Daemon) void {
+    while (true) {
+        self.onchain_wake.reset();
+        self.mu.lock();
+        if (self.want_stop) {
+            self.mu.unlock();
+            break;
+        }
+        const interval = self.onchainInterval();
+        const elapsed = self.clock.since(self.onchain_reported);
+        const due = self.want_onchain_report or elapsed > interval;
+        // lnd wallet balance is unavailable during wallet reset.
+        const with_balance = self.state != .wallet_reset;
+        self.mu.unlock();
+
+        // sleep until the next report is due unless woken up by onchain_wake.
+        var wait_ns: u64 = interval -| elapsed;
+        if (due) report: {
+            const action = self.bitcoind_breaker.check(self.clock.now());
+            if (action == .wait) {
+                wait_ns = action.wait;
+                break :report;
             }
-            switch (self.state) {
-                .stopped, .poweroff => break :loop,
-                .running, .standby, .wallet_reset => {
-                    logger.err("commThreadLoop: {any}", .{err});
-                    if (err == error.EndOfStream) {
-                        // pointless to continue running if comms I/O is broken.
-                        self.want_stop = true;
-                        break :loop;
-                    }
+            const start = time.nanoTimestamp();
+            const span = trace.begin("onchain report");
+            const prev_deadline = deadline.begin(report_deadline_ms);
+            const res: anyerror!void = blk: {
+                if (action == .probe) {
+                    self.probeBitcoind() catch |err| break :blk err;
+                }
+                break :blk self.sendOnchainReport(.{ .balance = with_balance });
+            };
+            deadline.end(prev_deadline);
+            span.end();
+            trace.flush();
+            self.metrics.recordReport(.onchain, start, !std.meta.isError(res));
+            if (res) {
+                if (self.bitcoind_breaker.success()) {
+                    logger.info("bitcoind is back", .{});
+                }
+                self.mu.lock();
+                self.onchain_reported = self.clock.now();
+                self.want_onchain_report = false;
+                wait_ns = self.onchainInterval(); // sync state may have changed
+                self.mu.unlock();
+                self.sendReportFreshness(.onchain, start, wait_ns);
+            } else |err| switch (err) {
+                error.BitcoindCookieMissing => {
+                    // bitcoind is starting up: report as soon as it creates the cookie.
+                    self.waitBitcoindCookie(interval);
                     continue;
                 },
+                error.RpcInWarmup => {
+                    // probed as often as the startup progress is polled.
+                    wait_ns = self.sendBitcoindStartup();
+                    wait_ns = self.bitcoind_breaker.failure(self.clock.now(), wait_ns);
+                },
+                error.DeadlineExceeded => {
+                    // bitcoind is busy or wedged: no point in retrying right away.
+                    logger.warn("sendOnchainReport: {any}", .{err});
+                    self.sendStaleReport(.onchain);
+                    wait_ns = @max(interval, self.bitcoind_breaker.failure(self.clock.now(), null));
+                },
+                else => {
+                    logger.err("sendOnchainReport: {any}", .{err});
+                    wait_ns = self.bitcoind_breaker.failure(self.clock.now(), null); // then probe
+                },
             }
-        };
-        defer res.deinit();
+        }
+        _ = self.clock.wait(&self.onchain_wake, wait_ns);
+    }
+    logger.info("exiting onchain report thread loop", .{});
+}
 
-        logger.debug("got msg: {s}", .{@tagName(res.value)});
-        switch (res.value) {
-            .pong => {
-                logger.info("received pong from ngui", .{});
+/// restarts ngui after it exited, with a backoff while it keeps crashing
+/// right after start, and replays all it shows: settings, the latest reports
+/// if kept in the snapshot, and fresh reports of all kinds soon after.
+/// the daemon caches and connections stay in place.
+/// returns false if want_stop was set meanwhile. called from comm thread.
+fn respawnUi(self: *Daemon) bool {
+    const sp = self.ui_spawner.?;
+    // frames queued for the exited ngui make no sense to a new one.
+    self.uiwriter.detach();
+    if (time.milliTimestamp() - self.ui_started >= ui_respawn_stable_ms) {
+        self.ui_respawn_delay_ms = 0;
+    }
+    while (true) {
+        if (self.ui_respawn_delay_ms > 0) {
+            logger.info("respawning ngui in {d}ms", .{self.ui_respawn_delay_ms});
+            if (self.waitStop(@intCast(self.ui_respawn_delay_ms))) {
+                return false;
+            }
+        }
+        self.ui_respawn_delay_ms = std.math.clamp(self.ui_respawn_delay_ms * 2, ui_respawn_min_delay_ms, ui_respawn_max_delay_ms);
+        const pipe = sp.func(sp.ctx) catch |err| {
+            logger.err("respawn ngui: {!}", .{err});
+            continue;
+        };
+        self.ui_started = time.milliTimestamp();
+        self.uireader = pipe.reader();
+        self.uiwriter.attach(pipe.w);
+        break;
+    }
+    logger.info("ngui respawned", .{});
+
+    // a new ngui starts with json and no optional features until it says otherwise.
+    self.uiwriter_mu.lock();
+    self.uiencoding = .json;
+    self.uireply_ids = false;
+    self.uichannel_pages = false;
+    self.uishm_reports = false;
+    self.channel_view = null;
+    self.payments_view = null;
+    self.tx_view = null;
+    self.utxo_view = null;
+    self.uiwriter_mu.unlock();
+    const locked = self.conf.snapshot().data.slock != null;
+    self.screenstate.store(if (locked) .locked else .unlocked, .monotonic);
+    self.uiwrite(.ping) catch |err| logger.err("respawn ngui: ping: {!}", .{err});
+    self.mu.lock();
+    const shed = self.pressured;
+    self.mu.unlock();
+    if (shed) {
+        self.uiwrite(.{ .load_shed = .{ .on = true } }) catch |err| logger.err("respawn ngui: load_shed: {!}", .{err});
+    }
+
+    if (self.snapshot) |*snap| {
+        if (snap.reports()) |msgs| {
+            for (msgs.constSlice()) |m| {
+                defer m.deinit();
+                self.uiwrite(m.value) catch |err| logger.err("respawn ngui: {s}: {!}", .{ @tagName(m.value), err });
+            }
+        } else |err| logger.err("respawn ngui: snapshot: {!}", .{err});
+    }
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.want_settings = true;
+    self.want_network_report = true;
+    self.network_subscribed = false; // until the new ngui subscribes
+    self.peer_view_open = false;
+    self.want_onchain_report = true;
+    self.want_lnd_report = true;
+    self.want_full_lnd_report = true;
+    self.kickMain();
+    self.onchain_wake.set();
+    self.lnd_wake.set();
+    return !self.want_stop;
+}
+
+/// blocks until the bitcoind rpc cookie file exists, stop_event is signalled
+/// or timeout_ns elapses. falls back to a plain wait if the file can't be watched.
+fn waitBitcoindCookie(self: *Daemon, timeout_ns: u64) void {
+    const timeout_ms = std.math.lossyCast(u32, timeout_ns / time.ns_per_ms);
+    var watch = sys.FileWatch.init(self.bitcoind.cookiepath) catch |err| {
+        logger.err("bitcoind cookie watch: {any}", .{err});
+        _ = self.waitStop(std.math.lossyCast(i32, timeout_ms));
+        return;
+    };
+    defer watch.deinit();
+    watch.waitExists(.{ .timeout_ms = timeout_ms, .interrupt = self.stop_event }) catch |err| switch (err) {
+        error.FileWatchTimeout, error.FileWatchInterrupted => {},
+        else => {
+            logger.err("bitcoind cookie watch: {any}", .{err});
+            _ = self.waitStop(std.math.lossyCast(i32, timeout_ms));
+        },
+    };
+}
+
+/// onchain polling interval while bitcoind RPC is in warmup, shortened down
+/// to warmup_poll_min as verification nears its end: the first onchain report
+/// then follows closely once bitcoind is ready.
+const warmup_poll_max = 5 * time.ns_per_s;
+const warmup_poll_min = 500 * time.ns_per_ms;
+
+/// sends bitcoind startup progress to ngui while its RPC is in warmup,
+/// and returns when to poll bitcoind next, in ns.
+fn sendBitcoindStartup(self: *Daemon) u64 {
+    var status: BitcoindLogTail.Status = .{};
+    if (self.bitcoind_log) |*tail| {
+        status = tail.poll() catch |err| blk: {
+            logger.warn("bitcoind log: {s}: {!}", .{ tail.path, err });
+            break :blk .{};
+        };
+    }
+    const phase = if (status.phase.len > 0) status.phase.constSlice() else "warming up";
+    self.publish(.{ .bitcoind_startup = .{ .phase = phase, .progress = status.progress } }) catch |err| {
+        logger.err("bitcoind startup: {!}", .{err});
+    };
+    return warmupPollInterval(status.progress);
+}
+
+fn warmupPollInterval(progress: ?u8) u64 {
+    const pct = progress orelse return warmup_poll_max;
+    const left: u64 = 100 - @min(pct, 100);
+    return @max(warmup_poll_min, warmup_poll_max * left / 100);
+}
+
+/// report polling interval while bitcoind or lnd is syncing, for progress to be visible.
+const sync_report_interval = 10 * time.ns_per_s;
+/// min report polling interval while ngui is in standby: nobody's looking.
+const standby_report_interval = 10 * time.ns_per_min;
+
+const PollMode = enum { normal, syncing, standby };
+
+/// returns report polling interval of a collector with the base interval.
+fn pollInterval(base: u64, mode: PollMode) u64 {
+    return switch (mode) {
+        .normal => base,
+        .syncing => @min(base, sync_report_interval),
+        .standby => @max(base, standby_report_interval),
+    };
+}
+
+/// callers must hold self.mu.
+fn pollMode(self: *const Daemon, syncing: bool) PollMode {
+    if (self.state == .standby) {
+        return .standby;
+    }
+    return if (syncing) .syncing else .normal;
+}
+
+/// current onchain report interval; callers must hold self.mu.
+fn onchainInterval(self: *const Daemon) u64 {
+    const base = if (self.zmq_subscribed) self.onchain_heartbeat_interval else self.onchain_report_interval;
+    return self.shedInterval(pollInterval(base, self.pollMode(self.onchain_syncing)));
+}
+
+/// current lightning report interval; callers must hold self.mu.
+fn lndInterval(self: *const Daemon) u64 {
+    return self.shedInterval(pollInterval(self.lnd_report_interval, self.pollMode(self.lnd_syncing)));
+}
+
+/// bitcoind ZMQ new blocks publisher; the same one lnd uses, see Config.genLndConfig.
+/// rawblock bodies are discarded: a notification is all that's needed.
+const zmq_block_addr = "127.0.0.1";
+const zmq_block_port = 8331;
+const zmq_block_topic = "rawblock";
+/// mempool changes, published to the same socket; see Config.applyBitcoindProfile.
+const zmq_sequence_topic = "sequence";
+/// delay before re-subscribing after a connection failure, in ms.
+const zmq_retry_ms = 30 * time.ms_per_s;
+
+/// bitcoind block notifications thread entry point: triggers an onchain report
+/// as soon as a new block arrives, letting onchainThreadLoop drop to a slow
+/// heartbeat. while bitcoind is unreachable, onchain reports fall back to
+/// regular polling and re-subscribing is attempted every zmq_retry_ms.
+/// exits when want_stop is true.
+fn zmqThreadLoop(self: *Daemon) void {
+    while (true) {
+        self.zmqSubscribe() catch |err| logger.debug("bitcoind zmq: {!}", .{err});
+        self.setZmqSubscribed(false);
+        if (self.waitStop(zmq_retry_ms)) {
+            break;
+        }
+    }
+    logger.info("exiting bitcoind zmq thread loop", .{});
+}
+
+/// subscribes to bitcoind new blocks and kicks the onchain report thread on
+/// each, until the connection is lost or stop_event is signalled.
+/// mempool changes go to self.mempool.
+fn zmqSubscribe(self: *Daemon) !void {
+    const sub = try bitcoindzmq.Subscriber.connect(zmq_block_addr, zmq_block_port, &.{ zmq_block_topic, zmq_sequence_topic });
+    defer sub.close();
+    logger.info("subscribed to bitcoind {s} and {s} notifications", .{ zmq_block_topic, zmq_sequence_topic });
+    self.setZmqSubscribed(true);
+
+    var fds = [_]posix.pollfd{
+        .{ .fd = sub.fd(), .events = posix.POLL.IN, .revents = 0 },
+        .{ .fd = self.stop_event.?, .events = posix.POLL.IN, .revents = 0 },
+    };
+    var buf: [64]u8 = undefined;
+    while (true) {
+        _ = try posix.poll(&fds, -1);
+        if (fds[1].revents != 0) {
+            return; // want_stop
+        }
+        const n = try sub.next(&buf);
+        if (std.mem.eql(u8, n.topic, zmq_sequence_topic)) {
+            self.mempool.notify(n.body orelse "", n.seq);
+            continue;
+        }
+        if (!std.mem.eql(u8, n.topic, zmq_block_topic)) {
+            continue;
+        }
+        logger.debug("bitcoind zmq: new block, seq {?d}", .{n.seq});
+        self.mu.lock();
+        self.want_onchain_report = true;
+        self.mu.unlock();
+        self.onchain_wake.set();
+    }
+}
+
+/// switches onchain reports between a heartbeat and regular polling interval.
+/// a report is requested on subscribing to catch up with any blocks missed meanwhile.
+fn setZmqSubscribed(self: *Daemon, v: bool) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.zmq_subscribed == v) {
+        return;
+    }
+    self.zmq_subscribed = v;
+    if (v) {
+        self.want_onchain_report = true;
+    }
+    self.onchain_wake.set(); // re-evaluate report interval
+}
+
+/// tor control port, as set in torrc along with CookieAuthentication.
+const tor_control_addr = "127.0.0.1";
+const tor_control_port = 9051;
+/// delay before reconnecting after a control port connection failure, in ms.
+const tor_retry_ms = 30 * time.ms_per_s;
+
+/// tor control port thread entry point: follows tor bootstrap and circuit
+/// builds, for ngui and the metrics, and holds back lightning reports until
+/// tor is ready. while the control port is unreachable, tor status is unknown
+/// and nothing is held back; reconnecting is attempted every tor_retry_ms.
+/// exits when want_stop is true.
+fn torThreadLoop(self: *Daemon) void {
+    while (true) {
+        self.torFollow() catch |err| logger.debug("tor control: {!}", .{err});
+        self.mu.lock();
+        const was_bootstrapping = self.tor.bootstrapping();
+        self.tor.reset();
+        self.mu.unlock();
+        self.metrics.recordTorBootstrap(null);
+        if (was_bootstrapping) {
+            self.lnd_wake.set(); // no longer held back
+        }
+        if (self.waitStop(tor_retry_ms)) {
+            break;
+        }
+    }
+    logger.info("exiting tor control thread loop", .{});
+}
+
+/// authenticates on the tor control port and processes its bootstrap and
+/// circuit events until the connection is lost or stop_event is signalled.
+fn torFollow(self: *Daemon) !void {
+    var ctl = try torctl.Controller.connect(tor_control_addr, tor_control_port);
+    defer ctl.close();
+    try ctl.authenticate(Config.TOR_CONTROL_COOKIE_PATH);
+    self.torBootstrap(try ctl.bootstrapPhase());
+    try ctl.setEvents(&.{ "STATUS_CLIENT", "CIRC" });
+    logger.info("following tor on its control port", .{});
+
+    var fds = [_]posix.pollfd{
+        .{ .fd = ctl.fd(), .events = posix.POLL.IN, .revents = 0 },
+        .{ .fd = self.stop_event.?, .events = posix.POLL.IN, .revents = 0 },
+    };
+    while (true) {
+        _ = try posix.poll(&fds, -1);
+        if (fds[1].revents != 0) {
+            return; // want_stop
+        }
+        switch (try ctl.next()) {
+            .bootstrap => |b| self.torBootstrap(b),
+            .circuit => |c| {
+                self.mu.lock();
+                const built = self.tor.circuit(c, self.clock.now());
+                const rep = if (built != null) self.tor.report() else null;
+                if (rep) |r| {
+                    self.publish(.{ .tor_status = r }) catch |err| logger.err("tor status: {!}", .{err});
+                }
+                self.mu.unlock();
+                if (built != null or c.status == .failed) {
+                    self.metrics.recordTorCircuit(built);
+                }
+            },
+        }
+    }
+}
+
+/// records a tor bootstrap phase, reports it if changed, and resumes
+/// lightning reports once bootstrapped.
+fn torBootstrap(self: *Daemon, b: torctl.Bootstrap) void {
+    self.metrics.recordTorBootstrap(b.progress);
+    self.mu.lock();
+    defer self.mu.unlock();
+    const was_bootstrapping = self.tor.bootstrapping();
+    if (!self.tor.bootstrap(b)) {
+        return;
+    }
+    logger.info("tor bootstrap {d}%: {s}", .{ b.progress, b.summary });
+    self.publish(.{ .tor_status = self.tor.report().? }) catch |err| logger.err("tor status: {!}", .{err});
+    if (was_bootstrapping and !self.tor.bootstrapping()) {
+        self.lnd_breaker.reset(); // lnd failed its calls over tor meanwhile
+        self.want_lnd_report = true;
+        self.lnd_wake.set();
+    }
+}
+
+/// blocks until stop_event is signalled but at most timeout_ms, and reports
+/// whether want_stop is set.
+fn waitStop(self: *Daemon, timeout_ms: i32) bool {
+    var fds = [_]posix.pollfd{.{ .fd = self.stop_event.?, .events = posix.POLL.IN, .revents = 0 }};
+    _ = posix.poll(&fds, timeout_ms) catch |err| logger.err("waitStop: poll: {any}", .{err});
+    self.mu.lock();
+    defer self.mu.unlock();
+    return self.want_stop;
+}
+
+/// lnd streaming subscriptions; each event triggers a lightning report,
+/// except channel backups which are exported instead, see exportChanBackup,
+/// htlc events counted in htlc_activity and graph updates applied to
+/// channel_graph. the report interval polling stays in place for the changes
+/// not covered here, such as payments and forwards.
+const lnd_streams = [_]lndhttp.Client.StreamMethod{
+    .subscribechannelevents,
+    .subscribeinvoices,
+    .subscribechanbackups,
+    .subscribehtlcevents,
+    .subscribechannelgraph,
+};
+/// delay before re-subscribing to an lnd stream after a failure, in ms.
+const lnd_stream_retry_ms = 10 * time.ms_per_s;
+
+/// lnd events subscriber thread for lnd_streams[i]: requests a lightning report
+/// on each event, which the lnd thread sends to ngui as a delta right away.
+/// while lnd is unavailable, re-subscribing is attempted every lnd_stream_retry_ms.
+/// exits when want_stop is true.
+fn LndStreamWorker(comptime i: usize) type {
+    return struct {
+        const m = lnd_streams[i];
+
+        fn run(self: *Daemon) void {
+            if (m == .subscribechanbackups and self.chanbackup == null) {
+                return; // export disabled
+            }
+            while (true) {
+                subscribe(self) catch |err| logger.debug("lnd {s}: {!}", .{ @tagName(m), err });
+                if (self.waitStop(lnd_stream_retry_ms)) {
+                    break;
+                }
+            }
+            logger.info("exiting lnd {s} thread loop", .{@tagName(m)});
+        }
+
+        /// blocks until the stream ends, fails or setWantStop shuts it down.
+        fn subscribe(self: *Daemon) !void {
+            const lnd = try self.lndc.acquire();
+            defer lnd.release();
+            const stream = try lnd.client.subscribe(m);
+            defer stream.deinit();
+            {
+                self.mu.lock();
+                defer self.mu.unlock();
+                if (self.want_stop) {
+                    return;
+                }
+                self.lnd_stream_fds[i] = stream.fd();
+            }
+            defer {
+                self.mu.lock();
+                self.lnd_stream_fds[i] = null;
+                self.mu.unlock();
+            }
+            logger.info("subscribed to lnd {s}", .{@tagName(m)});
+
+            if (m == .subscribechanbackups) {
+                // lnd streams changes only: start from the current backup.
+                const res = try lnd.client.call(.exportchanbackups, {});
+                defer res.deinit();
+                self.exportChanBackup(res.value);
+            }
+            var graph_report: GraphReport = .{};
+            if (m == .subscribechannelgraph) {
+                // same as above: changes on top of the whole graph.
+                graph_report.own = try self.loadChannelGraph(lnd.client);
+                graph_report.send(self);
+            }
+            while (try stream.next()) |ev| {
+                defer ev.deinit();
+                if (m == .subscribechanbackups) {
+                    self.exportChanBackup(ev.value);
+                    continue;
+                }
+                if (m == .subscribechannelgraph) {
+                    self.applyGraphUpdate(ev.value);
+                    graph_report.sendIfDue(self);
+                    continue;
+                }
+                if (m == .subscribehtlcevents) {
+                    const hev = htlcActivityEvent(ev.value) orelse continue;
+                    if (self.htlc_activity.record(hev, time.timestamp())) {
+                        self.kickMain(); // for a summary, once due
+                    }
+                    continue;
+                }
+                if (m == .subscribechannelevents) {
+                    // policies of channels coming and going may change too.
+                    self.chan_details.clear();
+                }
+                self.mu.lock();
+                self.want_lnd_report = true;
+                self.mu.unlock();
+                self.lnd_wake.set();
+            }
+        }
+    };
+}
+
+/// how often graph statistics are sent at most, as the graph changes.
+const graph_report_interval_ms = 5 * time.ms_per_min;
+
+/// lightning graph statistics sending state of the graph stream worker.
+const GraphReport = struct {
+    own: ?types.PubKey = null, // the lnd node
+    next: i64 = 0, // time.milliTimestamp when the next one is due
+    changed: bool = false, // since the last one sent
+
+    fn send(self: *GraphReport, daemon: *Daemon) void {
+        self.next = time.milliTimestamp() + graph_report_interval_ms;
+        self.changed = false;
+        const stats = daemon.channel_graph.stats(daemon.allocator, self.own) catch |err| {
+            logger.err("channel graph: stats: {!}", .{err});
+            return;
+        };
+        daemon.publish(.{ .lightning_graph = stats }) catch |err| logger.err("lightning_graph: {!}", .{err});
+    }
+
+    /// sends the stats of a changed graph, unless one was sent recently.
+    /// with no further updates, the changes wait until the next one.
+    fn sendIfDue(self: *GraphReport, daemon: *Daemon) void {
+        self.changed = true;
+        if (time.milliTimestamp() >= self.next) {
+            self.send(daemon);
+        }
+    }
+};
+
+/// replaces channel_graph with the whole lnd graph, read a node and channel
+/// at a time, and returns the lnd node pubkey. graph stream worker only.
+fn loadChannelGraph(self: *Daemon, client: *lndhttp.Client) !types.PubKey {
+    const info = try client.call(.getinfo, {});
+    defer info.deinit();
+    const own = info.value.identity_pubkey;
+
+    const start = time.milliTimestamp();
+    const reader = try client.describeGraph();
+    defer reader.deinit();
+    self.channel_graph.clear();
+    while (try reader.next()) |item| switch (item) {
+        .node => |n| _ = try self.channel_graph.addNode(n.pub_key),
+        .edge => |e| try self.channel_graph.upsertChannel(e.channel_id, e.node1_pub, e.node2_pub, e.capacity),
+    };
+    logger.info("channel graph: {d} nodes, {d} channels loaded in {d}ms", .{
+        self.channel_graph.nodes.items.len,
+        self.channel_graph.chans.count(),
+        time.milliTimestamp() - start,
+    });
+    return own;
+}
+
+/// applies an lnd graph topology update to channel_graph. graph stream worker only.
+fn applyGraphUpdate(self: *Daemon, up: lndhttp.GraphTopologyUpdate) void {
+    const g = &self.channel_graph;
+    for (up.node_updates) |n| {
+        _ = g.addNode(n.identity_key) catch |err| logger.err("channel graph: node update: {!}", .{err});
+    }
+    for (up.channel_updates) |ch| {
+        g.upsertChannel(ch.chan_id, ch.advertising_node, ch.connecting_node, ch.capacity) catch |err| {
+            logger.err("channel graph: channel update: {!}", .{err});
+        };
+    }
+    for (up.closed_chans) |ch| {
+        g.removeChannel(ch.chan_id);
+    }
+}
+
+/// returns the routing activity event of an lnd htlc event; null for those
+/// of own payments and invoices.
+fn htlcActivityEvent(ev: lndhttp.HtlcEvent) ?HtlcActivity.Event {
+    if (ev.subscribed_event != null) {
+        return .subscribed;
+    }
+    if (!mem.eql(u8, ev.event_type, "FORWARD")) {
+        return null;
+    }
+    const key = HtlcActivity.Key{ .chan_in = ev.incoming_channel_id, .htlc_in = ev.incoming_htlc_id };
+    if (ev.forward_event) |f| {
+        return .{ .forward = .{ .key = key, .amt_in_msat = f.info.incoming_amt_msat, .amt_out_msat = f.info.outgoing_amt_msat } };
+    }
+    if (ev.settle_event != null) {
+        return .{ .settle = key };
+    }
+    if (ev.forward_fail_event != null) {
+        return .{ .fail = .{ .key = key, .reason = .downstream } };
+    }
+    if (ev.link_fail_event) |f| {
+        return .{ .fail = .{ .key = key, .reason = HtlcActivity.linkFailReason(f.wire_failure, f.failure_detail) } };
+    }
+    return null; // final_htlc_event follows a settle or fail
+}
+
+/// writes the multi-channel backup of snap to the chanbackup file, if changed,
+/// and reports the outcome to ngui.
+fn exportChanBackup(self: *Daemon, snap: lndhttp.ChanBackupSnapshot) void {
+    const cb = &self.chanbackup.?;
+    var rep = comm.Message.ChannelBackup{
+        .state = .failed,
+        .path = cb.path,
+        .channels = @intCast(snap.multi_chan_backup.chan_points.len),
+        .size = 0,
+        .timestamp = std.math.lossyCast(u64, time.timestamp()),
+    };
+    if (cb.update(snap.multi_chan_backup.multi_chan_backup)) |res| {
+        rep.state = if (res.written) .written else .unchanged;
+        rep.size = res.size;
+        if (res.written) {
+            logger.info("channel backup: {d} channels exported to {s}", .{ rep.channels, cb.path });
+        }
+    } else |err| {
+        logger.err("channel backup: {s}: {!}", .{ cb.path, err });
+    }
+    self.publish(.{ .channel_backup = rep }) catch |err| logger.err("channel backup: report: {!}", .{err});
+}
+
+/// lightning report collector thread entry point.
+/// similar to onchainThreadLoop, self.mu is never held during lnd API calls.
+/// exits when want_stop is true.
+fn lndThreadLoop(self: *Daemon) void {
+    var aliases_changed = false;
+    while (true) {
+        self.lnd_wake.reset();
+        self.mu.lock();
+        if (self.want_stop) {
+            self.mu.unlock();
+            break;
+        }
+        const wallet_reset = self.state == .wallet_reset;
+        // lnd calls fail or time out until tor bootstraps; torBootstrap
+        // wakes the thread up once done.
+        const tor_wait = self.tor.bootstrapping();
+        const interval = self.lndInterval();
+        const elapsed = self.clock.since(self.lnd_reported);
+        const due = !wallet_reset and !tor_wait and (self.want_lnd_report or elapsed > interval);
+        self.mu.unlock();
+
+        // sleep until the next report is due unless woken up by lnd_wake.
+        // wallet reset state is re-checked every second.
+        var wait_ns: u64 = if (wallet_reset) 1 * time.ns_per_s else if (tor_wait) interval else interval -| elapsed;
+        if (due) report: {
+            const action = self.lnd_breaker.check(self.clock.now());
+            if (action == .wait) {
+                wait_ns = action.wait;
+                break :report;
+            }
+            if (action == .probe and !self.probeLnd()) {
+                wait_ns = self.lnd_breaker.failure(self.clock.now(), null);
+                break :report;
+            }
+            const start = time.nanoTimestamp();
+            const span = trace.begin("lightning report");
+            const prev_deadline = deadline.begin(report_deadline_ms);
+            const res = self.sendLightningReport();
+            deadline.end(prev_deadline);
+            span.end();
+            trace.flush();
+            self.metrics.recordReport(.lightning, start, !std.meta.isError(res));
+            if (res) {
+                if (self.lnd_breaker.success()) {
+                    logger.info("lnd is back", .{});
+                }
+                self.mu.lock();
+                self.lnd_reported = self.clock.now();
+                self.want_lnd_report = false;
+                wait_ns = self.lndInterval(); // sync state may have changed
+                self.mu.unlock();
+                self.sendReportFreshness(.lightning, start, wait_ns);
+                // a stat of the macaroon file unless it changed, as after a wallet init.
+                self.lnd_pairing.prepare(self.lndPairingHost()) catch |err| logger.debug("lnd pairing: {!}", .{err});
+            } else |err| {
+                logger.info("sendLightningReport: {!}", .{err});
+                // ngui may receive a lightning_error or a stale report;
+                // start over with a full report.
+                self.lnd_report_diff.reset();
+                if (err == error.DeadlineExceeded) {
+                    // lnd is busy or wedged: its wallet state would take as long.
+                    self.sendStaleReport(.lightning);
+                    wait_ns = @max(interval, self.lnd_breaker.failure(self.clock.now(), null));
+                } else {
+                    self.processLndReportError(err) catch |err2| logger.err("processLndReportError: {!}", .{err2});
+                    wait_ns = self.lnd_breaker.failure(self.clock.now(), null); // then probe
+                }
+            }
+        }
+
+        if (wallet_reset or tor_wait or !self.lnd_breaker.closed()) {
+            // lnd is unavailable
+        } else if (self.servePeerView()) |next_ns| {
+            wait_ns = @min(wait_ns, next_ns orelse wait_ns);
+        } else |err| {
+            logger.info("servePeerView: {!}", .{err});
+            wait_ns = @min(wait_ns, PeerView.ttl_ns);
+        }
+
+        // fetch missing peer aliases a few at a time and send a new report
+        // once all are refreshed.
+        if (wallet_reset or tor_wait or !self.lnd_breaker.closed()) {
+            // lnd is unavailable
+        } else if (self.refreshPeerAliases()) |res| {
+            aliases_changed = aliases_changed or res.changed;
+            if (!res.done) {
+                wait_ns = @min(wait_ns, 1 * time.ns_per_s); // next batch
+            } else if (aliases_changed) {
+                aliases_changed = false;
+                self.mu.lock();
+                self.want_lnd_report = true;
+                self.peer_view_full = self.peer_view_open; // with the new aliases
+                self.mu.unlock();
+                continue; // report right away
+            }
+        } else |err| {
+            logger.err("refreshPeerAliases: {!}", .{err});
+        }
+        _ = self.clock.wait(&self.lnd_wake, wait_ns);
+    }
+    logger.info("exiting lnd report thread loop", .{});
+}
+
+/// comm thread entry point: reads messages sent from ngui and acts accordinly.
+/// exits when want_stop is true or comm reader is closed.
+/// messages are handled as soon as they arrive: the thread blocks in poll until
+/// either the reader has data or stop_event is signalled.
+fn commThreadLoop(self: *Daemon) void {
+    var fds = [_]posix.pollfd{
+        .{ .fd = self.uireader.context.handle, .events = posix.POLL.IN, .revents = 0 },
+        .{ .fd = self.stop_event.?, .events = posix.POLL.IN, .revents = 0 },
+    };
+    var quit = false;
+    loop: while (!quit) {
+        _ = posix.poll(&fds, -1) catch |err| {
+            logger.err("commThreadLoop: poll: {any}", .{err});
+            time.sleep(100 * time.ns_per_ms); // avoid a busy loop
+            continue;
+        };
+        if (fds[1].revents != 0) {
+            break; // want_stop
+        }
+        if (fds[0].revents & posix.POLL.NVAL != 0) {
+            logger.err("commThreadLoop: ngui reader is closed", .{});
+            self.mu.lock();
+            self.want_stop = true;
+            self.mu.unlock();
+            break;
+        }
+        if (fds[0].revents == 0) {
+            continue;
+        }
+        // POLL.HUP and POLL.ERR make comm.read fail below.
+
+        const res = comm.read(self.allocator, self.uireader) catch |err| {
+            self.mu.lock();
+            // the pipe is most likely already closed while stopping.
+            const next: enum { quit, retry, respawn } = if (self.want_stop) .quit else switch (self.state) {
+                .stopped, .poweroff => .quit,
+                .running, .standby, .wallet_reset => blk: {
+                    logger.err("commThreadLoop: {any}", .{err});
+                    if (err != error.EndOfStream) {
+                        break :blk .retry;
+                    }
+                    if (self.ui_spawner == null) {
+                        // pointless to continue running if comms I/O is broken.
+                        self.want_stop = true;
+                        break :blk .quit;
+                    }
+                    break :blk .respawn;
+                },
+            };
+            self.mu.unlock();
+            switch (next) {
+                .quit => break :loop,
+                .retry => continue,
+                .respawn => {
+                    if (!self.respawnUi()) {
+                        break :loop; // want_stop
+                    }
+                    fds[0].fd = self.uireader.context.handle;
+                    continue;
+                },
+            }
+        };
+        defer res.deinit();
+
+        logger.debug("got msg: {s}", .{@tagName(res.value)});
+        switch (res.value) {
+            .pong => {
+                logger.info("received pong from ngui", .{});
             },
             .poweroff => {
                 self.beginPoweroff() catch |err| logger.err("beginPoweroff: {any}", .{err});
             },
             .get_network_report => |req| {
-                self.reportNetworkStatus(.{ .scan = req.scan });
+                self.reportNetworkStatus(.{ .scan = req.scan, .once = true });
+            },
+            .subscribe_network => {
+                self.reportNetworkStatus(.{ .scan = true, .subscribe = true });
+            },
+            .unsubscribe_network => {
+                self.mu.lock();
+                self.network_subscribed = false;
+                self.mu.unlock();
+            },
+            .subscribe_lightning_peers => {
+                self.mu.lock();
+                self.peer_view_open = true;
+                self.peer_view_full = true;
+                self.mu.unlock();
+                self.lnd_wake.set();
+            },
+            .unsubscribe_lightning_peers => {
+                self.mu.lock();
+                self.peer_view_open = false;
+                self.mu.unlock();
             },
             .wifi_connect => |req| {
-                if (self.screenstate != .locked) {
+                if (self.screenstate.load(.monotonic) != .locked) {
                     self.startConnectWifi(req.ssid, req.password) catch |err| {
                         logger.err("startConnectWifi: {any}", .{err});
                     };
@@ -467,22 +2318,26 @@ fn commThreadLoop(self: *Daemon) void {
                 logger.info("wakeup from standby", .{});
                 self.wakeup() catch |err| logger.err("nd.wakeup: {any}", .{err});
             },
+            .dim => {
+                logger.info("dimming screen", .{});
+                self.dim() catch |err| logger.err("nd.dim: {any}", .{err});
+            },
             .switch_sysupdates => |chan| {
-                if (self.screenstate != .locked) {
+                if (self.screenstate.load(.monotonic) != .locked) {
                     logger.info("switching sysupdates channel to {s}", .{@tagName(chan)});
                     self.switchSysupdates(chan) catch |err| {
                         logger.err("switchSysupdates: {any}", .{err});
-                        // TODO: send err back to ngui
+                        self.sendTaskError("system update", err);
                     };
                 } else {
                     logger.warn("ignoring sysupdates switch: screen is locked", .{});
                 }
             },
             .set_nodename => |newname| {
-                if (self.screenstate != .locked) {
+                if (self.screenstate.load(.monotonic) != .locked) {
                     self.setNodename(newname) catch |err| {
                         logger.err("setNodename: {!}", .{err});
-                        // TODO: send err back to ngui
+                        self.sendTaskError(nodename_task, err);
                     };
                 } else {
                     logger.warn("ignoring nodename change: screen is locked", .{});
@@ -490,33 +2345,33 @@ fn commThreadLoop(self: *Daemon) void {
             },
             .lightning_genseed => {
                 // non commital: ok even if the screen is locked
-                self.generateWalletSeed() catch |err| {
+                self.generateWalletSeed(res.id) catch |err| {
                     logger.err("generateWalletSeed: {!}", .{err});
-                    // TODO: send err back to ngui
+                    self.sendTaskError("wallet seed", err);
                 };
             },
             .lightning_init_wallet => |req| {
-                if (self.screenstate != .locked) {
+                if (self.screenstate.load(.monotonic) != .locked) {
                     self.initWallet(req) catch |err| {
                         logger.err("initWallet: {!}", .{err});
-                        // TODO: send err back to ngui
+                        self.sendTaskError("wallet init", err);
                     };
                 } else {
                     logger.warn("ignoring lnd wallet init: screen is locked", .{});
                 }
             },
             .lightning_get_ctrlconn => {
-                if (self.screenstate != .locked) {
-                    self.sendLightningPairingConn() catch |err| {
+                if (self.screenstate.load(.monotonic) != .locked) {
+                    self.sendLightningPairingConn(res.id) catch |err| {
                         logger.err("sendLightningPairingConn: {!}", .{err});
-                        // TODO: send err back to ngui
+                        self.sendTaskError("lightning pairing", err);
                     };
                 } else {
                     logger.warn("refusing to give out lnd pairing: screen is locked", .{});
                 }
             },
             .lightning_reset => {
-                if (self.screenstate != .locked) {
+                if (self.screenstate.load(.monotonic) != .locked) {
                     self.resetLndNode() catch |err| logger.err("resetLndNode: {!}", .{err});
                 } else {
                     logger.warn("refusing lnd reset: screen is locked", .{});
@@ -526,28 +2381,189 @@ fn commThreadLoop(self: *Daemon) void {
                 self.conf.setSlockPin(pincode_or_null) catch |err| logger.err("conf.setSlockPin: {!}", .{err});
                 self.mu.lock();
                 self.want_settings = true;
+                self.kickMain();
                 self.mu.unlock();
             },
             .unlock_screen => |pincode| {
-                self.unlockScreen(pincode) catch |err| logger.err("unlockScreen: {!}", .{err});
+                self.queueUnlockScreen(pincode) catch |err| logger.err("queueUnlockScreen: {!}", .{err});
             },
-            else => |v| logger.warn("unhandled msg tag {s}", .{@tagName(v)}),
-        }
-
-        self.mu.lock();
-        quit = self.want_stop;
-        self.mu.unlock();
-    }
-
-    logger.info("exiting comm thread loop", .{});
-}
-
-/// all callers must belong to comm thread due to self.screenstate access.
-fn unlockScreen(self: *Daemon, pincode: []const u8) !void {
+            .comm_features => |feat| {
+                logger.info("ngui comm features: binary={} request_ids={} channel_pages={}", .{ feat.binary, feat.request_ids, feat.channel_pages });
+                self.uiwriter_mu.lock();
+                self.uiencoding = if (feat.binary) .binary else .json;
+                self.uireply_ids = feat.request_ids;
+                self.uichannel_pages = feat.channel_pages;
+                self.uishm_reports = feat.shm_reports and self.uishm != null;
+                self.channel_view = null;
+                self.payments_view = null;
+                self.tx_view = null;
+                self.utxo_view = null;
+                self.uiwriter_mu.unlock();
+                self.report_dedup.reset(); // ngui (re)started
+                self.mu.lock();
+                if (self.tor.report()) |rep| {
+                    self.uiwrite(.{ .tor_status = rep }) catch |err| logger.err("tor status: {!}", .{err});
+                }
+                self.mu.unlock();
+            },
+            .lightning_get_channels => |q| {
+                self.sendChannelsPage(q, res.id) catch |err| logger.err("sendChannelsPage: {!}", .{err});
+            },
+            .lightning_get_payments => |q| {
+                self.sendPaymentsPage(q, res.id) catch |err| logger.err("sendPaymentsPage: {!}", .{err});
+            },
+            .onchain_get_transactions => |q| {
+                self.sendTransactionsPage(q, res.id) catch |err| logger.err("sendTransactionsPage: {!}", .{err});
+            },
+            .onchain_get_utxos => |q| {
+                self.sendUtxosPage(q, res.id) catch |err| logger.err("sendUtxosPage: {!}", .{err});
+            },
+            .lightning_get_channel_detail => |q| {
+                self.queueChannelDetail(q.id, res.id) catch |err| {
+                    logger.err("queueChannelDetail: {!}", .{err});
+                    self.uireply(.{ .lightning_channel_detail = .{ .id = q.id, .info = null, .err = @errorName(err) } }, res.id) catch {};
+                };
+            },
+            .ui_perf_report => |rep| {
+                self.metrics.recordUiPerf(rep);
+                logger.info("ngui perf over {d}ms: {d} frames, {d}px p50; render p50/p99/max {d}/{d}/{d}us; flush {d}/{d}/{d}us; timers {d}/{d}/{d}us; queue {d}/{d}/{d}us; lvgl mem peak {d}, {d} objects", .{
+                    rep.period,
+                    rep.render.count,
+                    rep.area.percentile(50),
+                    rep.render.percentile(50),
+                    rep.render.percentile(99),
+                    rep.render.max,
+                    rep.flush.percentile(50),
+                    rep.flush.percentile(99),
+                    rep.flush.max,
+                    rep.timers.percentile(50),
+                    rep.timers.percentile(99),
+                    rep.timers.max,
+                    rep.queue.percentile(50),
+                    rep.queue.percentile(99),
+                    rep.queue.max,
+                    rep.mem_peak,
+                    rep.objects,
+                });
+                if (rep.census) |census| {
+                    logUiCensus(census);
+                }
+            },
+            else => |v| logger.warn("unhandled msg tag {s}", .{@tagName(v)}),
+        }
+
+        self.mu.lock();
+        quit = self.want_stop;
+        self.mu.unlock();
+    }
+
+    logger.info("exiting comm thread loop", .{});
+}
+
+/// logs an ngui object census, as received in an on-demand ui_perf_report.
+fn logUiCensus(census: comm.Message.UiPerfReport.Census) void {
+    logger.info("ngui census: {d} objects, {d} styles, {d} label text bytes; lvgl mem used {d} peak {d} large {d} pooled {d}", .{
+        census.objects,
+        census.styles,
+        census.label_bytes,
+        census.lvgl_mem.used,
+        census.lvgl_mem.peak,
+        census.lvgl_mem.large,
+        census.lvgl_mem.pooled,
+    });
+    if (census.heap) |h| {
+        logger.info("ngui census: heap used {d} peak {d} large {d} pooled {d}", .{ h.used, h.peak, h.large, h.pooled });
+    }
+    for (census.classes) |cc| {
+        logger.info("ngui census: class {s}: {d}", .{ cc.name, cc.count });
+    }
+    for (census.subtrees) |s| {
+        logger.info("ngui census: {s}[{d}] {s}: {d} objects, {d} styles, {d} label text bytes", .{
+            @tagName(s.root),
+            s.index,
+            s.class,
+            s.objects,
+            s.styles,
+            s.label_bytes,
+        });
+    }
+}
+
+/// sends a message to ngui. once started, returns without waiting for ngui
+/// to read it; reports are dropped in favor of newer ones if ngui lags behind.
+fn uiwrite(self: *Daemon, msg: comm.Message) !void {
+    return self.uireply(msg, 0);
+}
+
+/// same as uiwrite for a report, also sent to subscribers, if any.
+/// ngui and subscribers don't wait on one another.
+fn publish(self: *Daemon, msg: comm.Message) !void {
+    if (self.subscribers) |*subs| {
+        subs.broadcast(msg);
+    }
+    return self.uiwrite(msg);
+}
+
+/// same as publish for a periodic report, unless unchanged since the last one
+/// sent; see ReportDedup. reports whether the msg was sent.
+fn publishReport(self: *Daemon, msg: comm.Message) !bool {
+    if (!self.report_dedup.check(msg, self.clock.now())) {
+        return false;
+    }
+    errdefer self.report_dedup.forget(std.meta.activeTag(msg));
+    try self.publish(msg);
+    return true;
+}
+
+/// same as uiwrite for a reply to the ngui request with the id, as received.
+fn uireply(self: *Daemon, msg: comm.Message, id: u32) !void {
+    self.uiwriter_mu.lock();
+    const enc = self.uiencoding;
+    const reply_id = if (self.uireply_ids) id else 0;
+    self.uiwriter_mu.unlock();
+    const start = time.nanoTimestamp();
+    defer self.metrics.recordCommWrite(start);
+    return self.uiwriter.writeId(msg, enc, reply_id);
+}
+
+/// hands the pin code over to the unlock thread, which replies to ngui
+/// with a screen_unlock_result once verified.
+fn queueUnlockScreen(self: *Daemon, pincode: []const u8) !void {
     const pindup = try self.allocator.dupe(u8, pincode);
-    defer self.allocator.free(pindup);
+    errdefer self.allocator.free(pindup);
+    try self.unlock_queue.push(pindup);
+    self.unlock_wake.set();
+}
+
+/// screen unlock thread entry point: verifies pin codes queued by the comm thread.
+/// bcrypt takes hundreds of ms on a pi; running it here keeps the comm thread
+/// responsive to other ngui messages. results are sent in the order of requests,
+/// and the attempts counter is persisted once per batch of queued pin codes.
+/// exits when want_stop is true.
+fn unlockThreadLoop(self: *Daemon) void {
+    while (true) {
+        self.unlock_wake.wait();
+        self.unlock_wake.reset();
+        self.mu.lock();
+        const quit = self.want_stop;
+        self.mu.unlock();
+        if (quit) {
+            break;
+        }
+        var batch = self.unlock_queue.takeAll();
+        while (batch.next()) |pin| {
+            defer self.allocator.free(pin);
+            self.unlockScreen(pin) catch |err| logger.err("unlockScreen: {!}", .{err});
+        }
+        self.conf.persistPending() catch |err| logger.err("conf.persistPending: {!}", .{err});
+    }
+    logger.info("exiting screen unlock thread loop", .{});
+}
+
+/// called only from the unlock thread.
+fn unlockScreen(self: *Daemon, pincode: []const u8) !void {
     // TODO: slow down
-    self.conf.verifySlockPin(pindup) catch |err| {
+    self.conf.verifySlockPin(pincode) catch |err| {
         if (!builtin.is_test) { // logging err makes some tests fail
             logger.err("verifySlockPin: {!}", .{err});
         }
@@ -555,11 +2571,11 @@ fn unlockScreen(self: *Daemon, pincode: []const u8) !void {
             .ok = false,
             .err = if (err == error.IncorrectSlockPin) "incorrect pin code" else "unlock failed",
         } };
-        return comm.write(self.allocator, self.uiwriter, errmsg);
+        return self.uiwrite(errmsg);
     };
     const ok: comm.Message = .{ .screen_unlock_result = .{ .ok = true } };
-    comm.write(self.allocator, self.uiwriter, ok) catch |err| logger.err("{!}", .{err});
-    self.screenstate = .unlocked;
+    self.uiwrite(ok) catch |err| logger.err("{!}", .{err});
+    self.screenstate.store(.unlocked, .monotonic);
 }
 
 /// sends poweroff progress to uiwriter in comm.Message.PoweroffProgress format.
@@ -574,34 +2590,77 @@ fn sendPoweroffReport(self: *Daemon) !void {
         };
     }
     const report = comm.Message{ .poweroff_progress = .{ .services = svstat } };
-    try comm.write(self.allocator, self.uiwriter, report);
+    try self.uiwrite(report);
 }
 
+/// refreshes ipaddrs on netlink address notifications and, if the addresses
+/// changed, schedules a network report for ngui.
+/// caller must hold self.mu.
+fn readNetlinkMsg(self: *Daemon) !void {
+    const nl = self.netlink orelse return;
+    if (!try nl.drain()) {
+        return;
+    }
+    const changed = self.ipaddrs.refresh() catch |err| {
+        self.ipaddrs.watched = false; // until a refresh succeeds again
+        return err;
+    };
+    self.ipaddrs.watched = true;
+    if (changed) {
+        self.want_network_report = true;
+    }
+}
+
+/// wifi scan results younger than this are reported as is, with no new scan:
+/// a scan takes seconds and slows down the connected link meanwhile.
+const wifi_scan_fresh_ms = 60 * time.ms_per_s;
+
+/// starts a scan in the background. the networks at hand, if any, are reported
+/// right away; wifiScanComplete reports the results if they differ.
 /// caller must hold self.mu.
 fn startWifiScan(self: *Daemon) !void {
     try self.wpa_ctrl.scan();
     self.wifi_scan_in_progress = true;
-    self.network_report_ready = false;
+    if (!self.wifi_scan.updated) {
+        // results of scans made before nd started, if any.
+        _ = self.wifi_scan.update(&self.wpa_ctrl) catch |err| logger.err("wifi_scan.update: {any}", .{err});
+    }
+    if (self.wifi_scan.sorted.items.len == 0) {
+        self.network_report_ready = false; // until the scan completes
+    }
 }
 
 /// invoked when CTRL-EVENT-SCAN-RESULTS event is seen.
 /// caller must hold self.mu.
 fn wifiScanComplete(self: *Daemon) void {
     self.wifi_scan_in_progress = false;
+    self.wifi_bss_changed = false;
+    self.wifi_scanned = time.milliTimestamp();
     self.network_report_ready = true;
+    // wpa_supplicant also scans on its own, for example while disconnected.
+    self.updateWifiScan();
+}
+
+/// re-reads the wpa_supplicant BSS table and pushes the networks to ngui
+/// only when the list has changed.
+/// caller must hold self.mu.
+fn updateWifiScan(self: *Daemon) void {
+    const changed = self.wifi_scan.update(&self.wpa_ctrl) catch |err| blk: {
+        logger.err("wifi_scan.update: {any}", .{err});
+        break :blk false;
+    };
+    if (changed) {
+        self.want_network_report = true;
+    }
 }
 
 /// invoked when CTRL-EVENT-CONNECTED event is seen.
 /// caller must hold self.mu.
 fn wifiConnected(self: *Daemon) void {
-    if (self.wpa_save_config_on_connected) {
+    if (self.wifi_connect == .connecting) {
         // fails if update_config=0 in wpa_supplicant.conf
-        const ok_saved = self.wpa_ctrl.saveConfig();
-        if (ok_saved) {
-            self.wpa_save_config_on_connected = false;
-        } else |err| {
-            logger.err("wifiConnected: {any}", .{err});
-        }
+        self.wpa_ctrl.saveConfig() catch |err| logger.err("wifiConnected: saveConfig: {any}", .{err});
+        self.setWifiConnect(.idle);
     }
     // always send a network report when connected
     self.want_network_report = true;
@@ -610,13 +2669,25 @@ fn wifiConnected(self: *Daemon) void {
 /// invoked when CTRL-EVENT-SSID-TEMP-DISABLED event with authentication failures is seen.
 /// callers must hold self.mu.
 fn wifiInvalidKey(self: *Daemon) void {
-    self.wpa_save_config_on_connected = false;
-    self.want_network_report = true;
-    self.network_report_ready = true;
+    self.setWifiConnect(.idle);
+    self.wifiConnectFailed();
+}
+
+/// invoked when CTRL-EVENT-DISCONNECTED event is seen.
+/// callers must hold self.mu.
+fn wifiDisconnected(self: *Daemon) void {
+    switch (self.wifi_connect) {
+        // selecting a network drops the current connection first;
+        // failures are reported by SSID-TEMP-DISABLED or the timeout.
+        .pending, .connecting => {},
+        .idle => self.want_network_report = true,
+    }
 }
 
 const ReportNetworkStatusOpt = struct {
     scan: bool,
+    once: bool = false, // send a report even if unsubscribed
+    subscribe: bool = false, // and keep pushing reports; see network_subscribed
 };
 
 /// tells the daemon to start preparing network status report, including a wifi
@@ -625,43 +2696,114 @@ fn reportNetworkStatus(self: *Daemon, opt: ReportNetworkStatusOpt) void {
     self.mu.lock();
     defer self.mu.unlock();
     self.want_network_report = true;
-    self.want_wifi_scan = opt.scan and !self.wifi_scan_in_progress;
-    if (self.want_wifi_scan and self.network_report_ready) {
-        self.network_report_ready = false;
+    self.network_report_once = self.network_report_once or opt.once;
+    self.network_subscribed = self.network_subscribed or opt.subscribe;
+    // fresh results are served as they are; see startWifiScan otherwise.
+    const fresh = time.milliTimestamp() - self.wifi_scanned < wifi_scan_fresh_ms;
+    self.want_wifi_scan = opt.scan and !fresh and !self.wifi_scan_in_progress;
+    self.kickMain();
+}
+
+/// wifi connect procedure state machine, driven by the main thread:
+/// startConnectWifi sets a pending request, stepWifiConnect configures
+/// wpa_supplicant and wpa_ctrl events or a timeout complete the procedure.
+const WifiConnect = union(enum) {
+    idle,
+    /// allocated with daemon allocator and owned by the state.
+    pending: struct {
+        ssid: []const u8,
+        password: []const u8,
+    },
+    connecting: struct {
+        id: u32, // wpa_supplicant network id
+        ssid: []const u8, // owned by the state
+        password_hash: u64, // to recognize a repeated request
+        started: i64, // time.milliTimestamp
+    },
+};
+
+/// how long to wait for CTRL-EVENT-CONNECTED, in ms.
+const wifi_connect_timeout_ms = 30 * time.ms_per_s;
+
+/// frees resources of the current wifi_connect state and replaces it with next.
+/// callers must hold self.mu.
+fn setWifiConnect(self: *Daemon, next: WifiConnect) void {
+    switch (self.wifi_connect) {
+        .idle => {},
+        .pending => |p| {
+            self.allocator.free(p.ssid);
+            self.allocator.free(p.password);
+        },
+        .connecting => |c| self.allocator.free(c.ssid),
     }
+    self.wifi_connect = next;
 }
 
-/// initiates wifi connection procedure in a separate thread
+/// requests the main thread to connect to a wifi network. a repeated request
+/// for the same network and password while still in progress is a noop while
+/// a different one supersedes the previous.
 fn startConnectWifi(self: *Daemon, ssid: []const u8, password: []const u8) !void {
     if (ssid.len == 0) {
         return Error.ConnectWifiEmptySSID;
     }
+    self.mu.lock();
+    defer self.mu.unlock();
+    const dup = switch (self.wifi_connect) {
+        .idle => false,
+        .pending => |p| mem.eql(u8, p.ssid, ssid) and mem.eql(u8, p.password, password),
+        .connecting => |c| mem.eql(u8, c.ssid, ssid) and c.password_hash == std.hash.Wyhash.hash(0, password),
+    };
+    if (dup) {
+        logger.info("wifi connect to {s} already in progress", .{ssid});
+        return;
+    }
     const ssid_copy = try self.allocator.dupe(u8, ssid);
+    errdefer self.allocator.free(ssid_copy);
     const pwd_copy = try self.allocator.dupe(u8, password);
-    const th = try std.Thread.spawn(.{}, connectWifiThread, .{ self, ssid_copy, pwd_copy });
-    th.detach();
+    self.setWifiConnect(.{ .pending = .{ .ssid = ssid_copy, .password = pwd_copy } });
+    self.kickMain();
 }
 
-/// the wifi connection procedure thread entry point.
-/// holds self.mu for the whole duration. however the thread lifetime is expected
-/// to be short since all it does is issuing commands to self.wpa_ctrl.
-///
-/// the thread owns ssid and password args, and frees them at exit.
-fn connectWifiThread(self: *Daemon, ssid: []const u8, password: []const u8) void {
-    self.mu.lock();
-    defer {
-        self.mu.unlock();
-        self.allocator.free(ssid);
-        self.allocator.free(password);
+/// advances the wifi connect state machine: configures wpa_supplicant for
+/// a pending request and fails a connection attempt taking too long.
+/// in both failure cases, ngui is sent a network report right away.
+/// callers must hold self.mu.
+fn stepWifiConnect(self: *Daemon) void {
+    switch (self.wifi_connect) {
+        .idle => {},
+        .pending => |p| {
+            // https://hostap.epitest.fi/wpa_supplicant/devel/ctrl_iface_page.html
+            // https://wiki.archlinux.org/title/WPA_supplicant
+            const id = self.configureWifi(p.ssid, p.password) catch |err| {
+                logger.err("wifi connect to {s}: {any}", .{ p.ssid, err });
+                self.setWifiConnect(.idle);
+                self.wifiConnectFailed();
+                return;
+            };
+            const phash = std.hash.Wyhash.hash(0, p.password);
+            self.allocator.free(p.password);
+            // wait for CTRL-EVENT-CONNECTED, SAVE_CONFIG and send network report.
+            self.wifi_connect = .{ .connecting = .{
+                .id = id,
+                .ssid = p.ssid,
+                .password_hash = phash,
+                .started = time.milliTimestamp(),
+            } };
+        },
+        .connecting => |c| {
+            if (time.milliTimestamp() - c.started > wifi_connect_timeout_ms) {
+                logger.err("wifi connect to {s}: timeout", .{c.ssid});
+                self.setWifiConnect(.idle);
+                self.wifiConnectFailed();
+            }
+        },
     }
+}
 
-    // https://hostap.epitest.fi/wpa_supplicant/devel/ctrl_iface_page.html
-    // https://wiki.archlinux.org/title/WPA_supplicant
-
-    const id = network.addWifi(self.allocator, &self.wpa_ctrl, ssid, password) catch |err| {
-        logger.err("addWifi: {any}; exiting", .{err});
-        return;
-    };
+/// adds a new network and makes it the only enabled one. returns its id.
+/// callers must hold self.mu.
+fn configureWifi(self: *Daemon, ssid: []const u8, password: []const u8) !u32 {
+    const id = try network.addWifi(self.allocator, &self.wpa_ctrl, ssid, password);
     // SELECT_NETWORK <id> - this disables others
     // ENABLE_NETWORK <id>
     self.wpa_ctrl.selectNetwork(id) catch |err| {
@@ -669,163 +2811,1170 @@ fn connectWifiThread(self: *Daemon, ssid: []const u8, password: []const u8) void
         // non-critical; can try to continue
     };
     self.wpa_ctrl.enableNetwork(id) catch |err| {
-        logger.err("enableNetwork({d}): {any}; cannot continue", .{ id, err });
         self.wpa_ctrl.removeNetwork(id) catch {};
-        return;
+        return err;
     };
+    return id;
+}
 
-    // wait for CTRL-EVENT-CONNECTED, SAVE_CONFIG and send network report.
-    self.wpa_save_config_on_connected = true;
+/// callers must hold self.mu.
+fn wifiConnectFailed(self: *Daemon) void {
+    self.want_network_report = true;
+    self.network_report_ready = true;
 }
 
 /// reads all available messages from self.wpa_ctrl and acts accordingly.
 /// callers must hold self.mu.
 fn readWPACtrlMsg(self: *Daemon) !void {
-    var buf: [512:0]u8 = undefined;
+    // wpa_supplicant event messages are at most 4096 bytes; anything longer
+    // is truncated by the datagram receive but still decodes.
+    var buf: [4096:0]u8 = undefined;
     while (try self.wpa_ctrl.pending()) {
         const m = try self.wpa_ctrl.receive(&buf);
         logger.debug("wpa_ctrl msg: {s}", .{m});
-        if (mem.indexOf(u8, m, "CTRL-EVENT-SCAN-RESULTS") != null) {
-            self.wifiScanComplete();
-        }
-        if (mem.indexOf(u8, m, "CTRL-EVENT-CONNECTED") != null) {
-            self.wifiConnected();
-        }
-        if (mem.indexOf(u8, m, "CTRL-EVENT-SSID-TEMP-DISABLED") != null) {
-            // TODO: what about CTRL-EVENT-DISCONNECTED bssid=xx:xx:xx:xx:xx:xx reason=15
-            // CTRL-EVENT-SSID-TEMP-DISABLED id=1 ssid="<ssid>" auth_failures=3 duration=49 reason=WRONG_KEY
-            var it = mem.tokenize(u8, m, " ");
-            while (it.next()) |kv_str| {
-                var kv = mem.split(u8, kv_str, "=");
-                if (mem.eql(u8, kv.first(), "auth_failures")) {
-                    const v = kv.next();
-                    if (v != null and !mem.eql(u8, v.?, "0")) {
-                        self.wifiInvalidKey();
-                        break;
-                    }
-                }
-            }
+        switch (nif.wpa.parseEvent(m)) {
+            .scan_results => self.wifiScanComplete(),
+            // a scan in progress reports all its BSSes with the results.
+            .bss_changed => self.wifi_bss_changed = !self.wifi_scan_in_progress,
+            .connected => self.wifiConnected(),
+            .disconnected => self.wifiDisconnected(),
+            .ssid_temp_disabled => |ev| if (ev.auth_failures > 0) {
+                self.wifiInvalidKey();
+            },
+            .terminating, .other => {},
         }
-        // TODO: CTRL-EVENT-DISCONNECTED
     }
 }
 
-/// callers must hold self.mu due to self.state read access via fetchOnchainStats.
-fn sendOnchainReport(self: *Daemon) !void {
-    const stats = self.fetchOnchainStats() catch |err| {
+const OnchainReportOpt = struct {
+    /// whether to include lnd wallet balance in the report.
+    balance: bool,
+};
+
+/// collects onchain stats and sends them to ngui.
+/// callers must not hold self.mu: the function makes blocking network calls.
+fn sendOnchainReport(self: *Daemon, opt: OnchainReportOpt) !void {
+    const stats = self.fetchOnchainStats(opt) catch |err| {
         switch (err) {
-            error.FileNotFound, // cookie file might not exist yet
-            error.RpcInWarmup,
-            // bitcoind is still starting up: pretend the repost is sent.
-            // TODO: report actual startup ptogress to the UI
-            // https://git.qcode.ch/nakamochi/ndg/issues/30
-            => return,
-            // otherwise, propagate the error to the caller.
+            // the cookie file might not exist yet: let the caller wait for it.
+            error.FileNotFound => {
+                std.fs.cwd().access(self.bitcoind.cookiepath, .{}) catch return error.BitcoindCookieMissing;
+                return err;
+            },
+            // otherwise, including error.RpcInWarmup: the caller reports
+            // startup progress instead; see sendBitcoindStartup.
             else => return err,
         }
     };
-    defer {
-        stats.bcinfo.deinit();
-        stats.netinfo.deinit();
-        stats.mempool.deinit();
-        if (stats.balance) |bal| bal.deinit();
+    defer stats.batch.deinit();
+
+    const localaddr = try self.allocator.alloc(LocalAddr, stats.netinfo.localaddresses.len);
+    defer self.allocator.free(localaddr);
+    for (stats.netinfo.localaddresses, localaddr) |a, *out| {
+        out.* = .{ .addr = a.address, .port = a.port, .score = a.score };
+    }
+    // connection counts change often, unlike the cached netinfo.
+    var conn_in: u16 = 0;
+    for (stats.peers) |peer| {
+        if (peer.inbound) {
+            conn_in += 1;
+        }
+    }
+    const conn_out = std.math.lossyCast(u16, stats.peers.len - conn_in);
+
+    const syncing = stats.bcinfo.initialblockdownload or stats.bcinfo.headers > stats.bcinfo.blocks + 1;
+    if (syncing) {
+        self.sync_rate.update(.{
+            .time_ms = time.milliTimestamp(),
+            .blocks = stats.bcinfo.blocks,
+            .diskusage = stats.bcinfo.size_on_disk,
+            .progress = stats.bcinfo.verificationprogress,
+        });
+    } else {
+        self.sync_rate.reset();
+    }
+    const sync_est = self.sync_rate.estimate();
+    const net = self.netRates(stats.nettotals, stats.nettotals_ns);
+    self.evictSlowPeers(stats.bcinfo, stats.peers);
+    self.mempool.refresh(&self.bitcoind) catch |err| logger.err("mempool refresh: {!}", .{err});
+    const feerates = self.mempool.histogram();
+    var recent_buf: [recent_blocks_count]comm.Message.OnchainReport.BlockStats = undefined;
+    const recent_blocks = self.recentBlocks(stats.bcinfo, &recent_buf);
+
+    if (stats.balance) |bal| {
+        self.utxos.observeBalance(bal.total_balance);
+    }
+    const btcrep: comm.Message.OnchainReport = .{
+        .blocks = stats.bcinfo.blocks,
+        .headers = stats.bcinfo.headers,
+        .timestamp = stats.bcinfo.time,
+        .hash = stats.bcinfo.bestblockhash,
+        .ibd = stats.bcinfo.initialblockdownload,
+        .diskusage = stats.bcinfo.size_on_disk,
+        .version = stats.netinfo.subversion,
+        .conn_in = conn_in,
+        .conn_out = conn_out,
+        .warnings = stats.bcinfo.warnings, // TODO: netinfo.result.warnings
+        .localaddr = localaddr,
+        .verifyprogress = @intFromFloat(@round(std.math.clamp(stats.bcinfo.verificationprogress, 0, 1) * 100)),
+        .sync = if (sync_est) |e| .{
+            .blocks_per_min = e.blocks_per_min,
+            .disk_bytes_per_sec = e.disk_bytes_per_sec,
+            .eta_sec = e.eta_sec,
+        } else null,
+        .net = net,
+        .mempool = .{
+            .loaded = stats.mempool.loaded,
+            .txcount = stats.mempool.size,
+            .usage = stats.mempool.usage,
+            .max = stats.mempool.maxmempool,
+            .totalfee = stats.mempool.total_fee,
+            .minfee = stats.mempool.mempoolminfee,
+            .fullrbf = stats.mempool.fullrbf,
+            .feerates = if (feerates) |*h| h else &.{},
+            .estimates = self.feeEstimates(stats.bcinfo),
+        },
+        .recent_blocks = recent_blocks,
+        .balance = if (stats.balance) |bal| .{
+            .source = .lnd,
+            .total = bal.total_balance,
+            .confirmed = bal.confirmed_balance,
+            .unconfirmed = bal.unconfirmed_balance,
+            .locked = bal.locked_balance,
+            .reserved = bal.reserved_balance_anchor_chan,
+        } else null,
+    };
+
+    if (!try self.publishReport(.{ .onchain_report = btcrep })) {
+        self.metrics.recordUnchanged(.onchain);
+    }
+    if (self.snapshot) |*snap| {
+        snap.update(.{ .onchain_report = btcrep }); // as of now, changed or not
+    }
+    self.mu.lock();
+    self.onchain_syncing = syncing;
+    self.tuneCpuFreqLocked();
+    self.mu.unlock();
+    self.tuneBitcoind(btcrep);
+    self.partitionResources(btcrep);
+    self.tuneSwap(btcrep);
+    self.scheduleBitcoindFlush(btcrep);
+    self.checkBootstrap(btcrep);
+
+    self.recordHistory(.{
+        .mempool_txcount = std.math.lossyCast(i64, btcrep.mempool.txcount),
+        .mempool_usage = std.math.lossyCast(i64, btcrep.mempool.usage),
+        .mempool_minfee = @intFromFloat(@round(btcrep.mempool.minfee * 1e8)), // BTC/kvB to sat/kvB
+        .onchain_balance = if (btcrep.balance) |bal| bal.total else null,
+    });
+}
+
+/// min number of blocks behind for an initial block download to switch bitcoind
+/// to the ibd profile: catching up after some downtime isn't worth a restart.
+const ibd_profile_min_blocks = 1000;
+
+/// applies the bitcoind tuning profile for the memory of the host and the
+/// chain sync state in rep, if enabled, and restarts bitcoind once the
+/// profile switches. the ibd profile stays until the download completes.
+/// a failed profile is not retried until the next switch.
+fn tuneBitcoind(self: *Daemon, rep: comm.Message.OnchainReport) void {
+    const path = self.bitcoind_conf_path orelse return;
+    const total = sys.totalMemory() catch |err| {
+        logger.err("bitcoind profile: totalMemory: {!}", .{err});
+        return;
+    };
+    self.mu.lock();
+    const in_ibd = if (self.bitcoind_profile) |p| p.ibd else false;
+    const ibd = rep.ibd and (in_ibd or rep.headers -| rep.blocks >= ibd_profile_min_blocks);
+    const prof = Config.BitcoindProfile.init(total, ibd);
+    const same = if (self.bitcoind_profile) |p| std.meta.eql(p, prof) else false;
+    // restart only when nothing else manages the services.
+    const safe = self.state == .running or self.state == .standby;
+    if (same or !safe) {
+        self.mu.unlock();
+        return;
+    }
+    self.bitcoind_profile = prof;
+    self.mu.unlock();
+
+    const changed = self.conf.applyBitcoindProfile(prof, path) catch |err| {
+        logger.err("bitcoind profile: {s}: {!}", .{ path, err });
+        return;
+    };
+    if (!changed) {
+        return;
+    }
+    logger.info("bitcoind profile: ibd={}, dbcache={d}MiB; restarting bitcoind", .{ prof.ibd, prof.dbcache });
+    // a restart already queued picks up the new profile too.
+    _ = self.jobs.submit(.{
+        .name = "bitcoind restart",
+        .groups = JobScheduler.Groups.initMany(&.{ .bitcoind, .lnd }),
+        .ctx = self,
+        .runFn = restartBitcoindJob,
+    }) catch |err| logger.err("bitcoind profile: restart job: {!}", .{err});
+}
+
+/// restarts bitcoind to pick up a new profile. lnd relies on bitcoind:
+/// it is stopped first and started last, as in poweroff.
+fn restartBitcoindJob(ctx: *anyopaque, p: JobScheduler.Progress) !void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    self.services.stopWait(sys.Service.LND) catch |err| logger.err("bitcoind restart: stop lnd: {!}", .{err});
+    p.set(25);
+    self.services.stopWait(sys.Service.BITCOIND) catch |err| logger.err("bitcoind restart: stop bitcoind: {!}", .{err});
+    p.set(50);
+    self.services.start(sys.Service.BITCOIND) catch |err| logger.err("bitcoind restart: start bitcoind: {!}", .{err});
+    p.set(75);
+    try self.services.start(sys.Service.LND);
+}
+
+/// standby time after which the cpus go into powersave, once chains are synced.
+const powersave_after = 15 * time.s_per_min;
+
+/// switches the cpufreq governor for the node state: performance while
+/// bitcoind syncs, a dynamic governor while the user is around or the node
+/// has just gone into standby, and powersave in a long standby with both
+/// chains synced. checked with each onchain report and on wakeup.
+/// the caller holds self.mu.
+fn tuneCpuFreqLocked(self: *Daemon) void {
+    const cf = if (self.cpufreq) |*v| v else return;
+    const long_standby = self.state == .standby and time.timestamp() - self.standby_since >= powersave_after;
+    const prefs: []const sys.CpuFreq.Governor = if (self.onchain_syncing)
+        &.{ .performance, .schedutil, .ondemand }
+    else if (long_standby and !self.lnd_syncing)
+        &.{ .powersave, .conservative }
+    else
+        &.{ .schedutil, .ondemand };
+    const gov = cf.pick(prefs) orelse return;
+    if (cf.set(gov)) |changed| {
+        if (changed) {
+            logger.info("cpufreq: switched to {s}", .{@tagName(gov)});
+            self.metrics.recordGovernor(gov);
+        }
+    } else |err| {
+        logger.err("cpufreq: {s}: {!}", .{ @tagName(gov), err });
+    }
+}
+
+/// the cgroup nd and ngui run in; see nd.zig.
+pub const ui_cgroup = "ui";
+/// cgroups of partitionResources; the runit services in the same named ones.
+const resource_groups = [_]struct { name: []const u8, service: bool }{
+    .{ .name = sys.Service.BITCOIND, .service = true },
+    .{ .name = sys.Service.LND, .service = true },
+    .{ .name = sys.Service.TOR, .service = true },
+    .{ .name = ui_cgroup, .service = false },
+};
+
+/// returns the limits of a resource_groups entry on a host with total bytes
+/// of memory. while in ibd, bitcoind gets a small share of cpu and disk
+/// whenever lnd or ngui want them, and the page cache of its block reads
+/// is kept from pushing them out of memory.
+fn resourceLimits(name: []const u8, ibd: bool, total: u64) sys.Cgroups.Limits {
+    if (mem.eql(u8, name, sys.Service.BITCOIND)) {
+        return if (ibd) .{ .cpu_weight = 50, .io_weight = 50, .memory_high = total / 4 * 3 } else .{};
+    }
+    if (mem.eql(u8, name, sys.Service.LND)) {
+        return if (ibd) .{ .cpu_weight = 400, .io_weight = 400 } else .{ .cpu_weight = 200, .io_weight = 200 };
+    }
+    if (mem.eql(u8, name, ui_cgroup)) {
+        return if (ibd) .{ .cpu_weight = 800, .io_weight = 200 } else .{ .cpu_weight = 400, .io_weight = 200 };
+    }
+    return .{};
+}
+
+/// applies cgroup limits of the node phase, ibd or steady state, following
+/// the bitcoind profile if tuned or the onchain report rep otherwise, and
+/// moves restarted services back into their groups.
+fn partitionResources(self: *Daemon, rep: comm.Message.OnchainReport) void {
+    const cg = self.cgroups orelse return;
+    const total = sys.totalMemory() catch |err| {
+        logger.err("cgroups: totalMemory: {!}", .{err});
+        return;
+    };
+    self.mu.lock();
+    const ibd = if (self.bitcoind_profile) |p| p.ibd else rep.ibd;
+    self.mu.unlock();
+    for (resource_groups) |g| {
+        cg.apply(g.name, resourceLimits(g.name, ibd, total)) catch |err| logger.err("cgroups: {s}: {!}", .{ g.name, err });
+        if (g.service) {
+            _ = cg.placeService(g.name) catch |err| logger.err("cgroups: place {s}: {!}", .{ g.name, err });
+        }
+    }
+}
+
+/// sets up zram swap on first call, then keeps swappiness to the node phase,
+/// ibd or steady state, as partitionResources, and records the swap figures.
+/// a failed setup is not retried: the node runs as before, with no swap
+/// or the OS one.
+fn tuneSwap(self: *Daemon, rep: comm.Message.OnchainReport) void {
+    const z = if (self.zram) |*v| v else return;
+    if (!self.zram_setup) {
+        self.zram_setup = true;
+        if (sys.totalMemory()) |total| {
+            const formatted = z.format(total) catch |err| blk: {
+                logger.err("zram: format: {!}", .{err});
+                break :blk false;
+            };
+            if (formatted) {
+                z.activate() catch |err| logger.err("zram: swapon: {!}", .{err});
+            }
+        } else |err| logger.err("zram: totalMemory: {!}", .{err});
+    }
+    self.mu.lock();
+    const ibd = if (self.bitcoind_profile) |p| p.ibd else rep.ibd;
+    self.mu.unlock();
+    const swappiness = sys.Zram.swappinessFor(ibd);
+    if (z.setSwappiness(swappiness)) |changed| {
+        if (changed) {
+            logger.info("zram: swappiness {d}", .{swappiness});
+        }
+    } else |err| logger.err("zram: swappiness: {!}", .{err});
+    if (z.stats()) |s| {
+        self.metrics.recordZram(s);
+    } else |err| logger.debug("zram: stats: {!}", .{err});
+}
+
+/// when bitcoind state is flushed to disk; see scheduleBitcoindFlush.
+const bitcoind_flush = struct {
+    /// in memory chainstate a block adds to the dbcache, roughly.
+    const bytes_per_block = 1 << 20;
+    /// of the dbcache, filled with blocks since the previous flush.
+    const max_fill_pct = 25;
+    /// bitcoind default dbcache, MiB, with no profile applied.
+    const default_dbcache = 450;
+    /// how often a flush is checked for while in a quiet window.
+    const check_interval = 1 * time.s_per_hour;
+};
+
+const BitcoindFlush = struct {
+    blocks: u64, // chain tip height
+    time: i64, // time.timestamp
+};
+
+/// reports whether the dbcache of dbcache MiB is worth flushing as of tip
+/// height blocks at now: it holds blocks since the last flush and either
+/// interval seconds passed or so many blocks came in a flush on bitcoind
+/// shutdown would take a while.
+fn bitcoindFlushDue(last: BitcoindFlush, blocks: u64, now: i64, dbcache: u32, interval: i64) bool {
+    const nblocks = blocks -| last.blocks;
+    if (nblocks == 0) {
+        return false;
+    }
+    const fill = nblocks * bitcoind_flush.bytes_per_block;
+    return now - last.time >= interval or fill * 100 >= @as(u64, dbcache) * (1 << 20) * bitcoind_flush.max_fill_pct;
+}
+
+/// schedules a write of bitcoind mempool and chainstate to disk in a quiet
+/// window: the screen is off and the chain synced as of the onchain report
+/// rep. bitcoind keeps new coins in the dbcache, flushed only when full or
+/// once a day, so a shutdown on poweroff would otherwise write them all out
+/// with the user watching. the mempool is saved along, for a power cut.
+/// called from the onchain thread.
+fn scheduleBitcoindFlush(self: *Daemon, rep: comm.Message.OnchainReport) void {
+    const hours = self.conf.snapshot().data.bitcoind_flush_hours;
+    if (hours == 0 or rep.ibd) {
+        return;
+    }
+    const now = time.timestamp();
+    self.mu.lock();
+    // bitcoind flushes at startup too; the first report sets the base.
+    const last = self.bitcoind_flushed orelse {
+        self.bitcoind_flushed = .{ .blocks = rep.blocks, .time = now };
+        self.mu.unlock();
+        return;
+    };
+    const dbcache = if (self.bitcoind_profile) |p| p.dbcache else bitcoind_flush.default_dbcache;
+    const quiet = self.state == .standby;
+    const due = bitcoindFlushDue(last, rep.blocks, now, dbcache, @as(i64, hours) * time.s_per_hour);
+    if (!quiet or !due or now - self.bitcoind_flush_checked < bitcoind_flush.check_interval) {
+        self.mu.unlock();
+        return;
+    }
+    self.bitcoind_flush_checked = now;
+    self.mu.unlock();
+
+    // retried with the next check if the node doesn't idle until then.
+    _ = self.jobs.submit(.{
+        .name = "bitcoind flush",
+        .priority = .low,
+        .groups = JobScheduler.Groups.initOne(.bitcoind),
+        .window = .idle,
+        .deadline = now + bitcoind_flush.check_interval,
+        .ctx = self,
+        .runFn = flushBitcoindJob,
+    }) catch |err| logger.err("bitcoind flush: job: {!}", .{err});
+}
+
+/// saves bitcoind mempool and flushes its chainstate to disk.
+fn flushBitcoindJob(ctx: *anyopaque, p: JobScheduler.Progress) !void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    const start = time.milliTimestamp();
+    if (self.bitcoind.call(.savemempool, {})) |res| {
+        res.deinit();
+    } else |err| logger.err("bitcoind flush: savemempool: {!}", .{err});
+    p.set(10);
+    const res = try self.bitcoind.call(.gettxoutsetinfo, .{});
+    defer res.deinit();
+    logger.info("bitcoind flush: {d} coins at height {d} in {d}ms", .{ res.value.txouts, res.value.height, time.milliTimestamp() - start });
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.bitcoind_flushed = .{ .blocks = res.value.height, .time = time.timestamp() };
+}
+
+/// when and how lnd channel.db is compacted; see scheduleLndCompaction.
+const lnd_compact = struct {
+    /// smaller files are never compacted.
+    const min_size = 512 << 20;
+    /// of the file size, estimated to be reclaimed.
+    const min_reclaim_pct = 25;
+    /// since the previous compaction; lnd db.bolt.auto-compact-min-age too.
+    const min_age = 7 * time.s_per_day;
+    /// how often channel.db is checked while in a quiet window.
+    const check_interval = 1 * time.s_per_hour;
+    /// lnd startup time, compaction included.
+    const ready_timeout_ms = 60 * time.ms_per_min;
+};
+
+/// schedules a compaction of lnd channel.db, which otherwise only grows and
+/// slows lnd down, in a quiet window: the screen is off and no HTLCs are in
+/// flight as of the lightning report rep. the job waits for the node to idle,
+/// and compacts only if worth the restart, as estimated by walking the
+/// database pages. called from the lnd thread.
+fn scheduleLndCompaction(self: *Daemon, rep: comm.Message.LightningReport) void {
+    if (self.lnd_channeldb_path == null) {
+        return;
+    }
+    const now = time.timestamp();
+    self.mu.lock();
+    const quiet = self.state == .standby and !self.lnd_syncing and rep.totalbalance.unsettled == 0;
+    if (!quiet or now - self.lnd_compact_checked < lnd_compact.check_interval) {
+        self.mu.unlock();
+        return;
+    }
+    self.lnd_compact_checked = now;
+    self.mu.unlock();
+
+    // retried with the next check if the node doesn't idle until then.
+    _ = self.jobs.submit(.{
+        .name = "lnd compaction",
+        .priority = .low,
+        .groups = JobScheduler.Groups.initOne(.lnd),
+        .window = .idle,
+        .deadline = now + lnd_compact.check_interval,
+        .ctx = self,
+        .runFn = compactLndJob,
+    }) catch |err| logger.err("lnd compaction: job: {!}", .{err});
+}
+
+/// returns the channel.db usage at path or null if not due for a compaction
+/// at now, unix seconds: too small or compacted recently.
+fn lndCompactionUsage(allocator: mem.Allocator, path: []const u8, now: i64) !?bbolt.Usage {
+    const stat = try std.fs.cwd().statFile(path);
+    if (stat.size < lnd_compact.min_size) {
+        return null;
+    }
+    // lnd touches the file after each compaction.
+    var buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+    const lastpath = try std.fmt.bufPrint(&buf, "{s}.last-compacted", .{path});
+    if (std.fs.cwd().statFile(lastpath)) |last| {
+        if (now - @as(i64, @intCast(@divFloor(last.mtime, time.ns_per_s))) < lnd_compact.min_age) {
+            return null;
+        }
+    } else |err| switch (err) {
+        error.FileNotFound => {}, // never compacted
+        else => return err,
+    }
+    return try bbolt.usage(allocator, path);
+}
+
+/// restarts lnd with compaction enabled if channel.db is due, and reports
+/// the progress to ngui.
+fn compactLndJob(ctx: *anyopaque, p: JobScheduler.Progress) !void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    const path = self.lnd_channeldb_path.?; // set if scheduled
+    const before = try lndCompactionUsage(self.allocator, path, time.timestamp()) orelse return;
+    logger.info("lnd compaction: {s}: {d} bytes, {d} live", .{ path, before.size, before.live });
+    if (before.reclaimable() * 100 < before.size * lnd_compact.min_reclaim_pct) {
+        return;
+    }
+    self.mu.lock();
+    // the screen may have turned on while walking the file.
+    const still = self.state == .standby;
+    self.mu.unlock();
+    if (!still) {
+        return;
+    }
+    p.set(10);
+
+    var rep = comm.Message.LndCompaction{
+        .state = .running,
+        .before = before.size,
+        .estimate = before.live,
+        .after = null,
+        .duration = 0,
+    };
+    self.uiwrite(.{ .lnd_compaction = rep }) catch |err| logger.err("lnd compaction: report: {!}", .{err});
+    logger.info("lnd compaction: restarting lnd", .{});
+    const start = time.milliTimestamp();
+    const res = self.compactLnd();
+    rep.duration = std.math.lossyCast(u32, time.milliTimestamp() - start);
+    if (res) {
+        rep.state = .done;
+        rep.after = if (std.fs.cwd().statFile(path)) |st| st.size else |_| null;
+        logger.info("lnd compaction: done in {d}ms; {d} bytes", .{ rep.duration, rep.after orelse 0 });
+    } else |err| {
+        rep.state = .failed;
+        logger.err("lnd compaction: {!}", .{err});
+    }
+    self.uiwrite(.{ .lnd_compaction = rep }) catch |err| logger.err("lnd compaction: report: {!}", .{err});
+    return res;
+}
+
+/// reports the outcome of a worker task to ngui.
+fn sendTaskResult(ctx: *anyopaque, rep: comm.Message.TaskResult) void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    self.uiwrite(.{ .task_result = rep }) catch |err| logger.err("task result {s}: {!}", .{ rep.name, err });
+}
+
+/// reports to ngui a request which failed before it could run as a task.
+fn sendTaskError(self: *Daemon, name: []const u8, err: anyerror) void {
+    sendTaskResult(self, .{ .name = name, .state = .failed, .err = @errorName(err) });
+}
+
+/// reports a background job progress to ngui and subscribers.
+fn sendJobReport(ctx: *anyopaque, rep: comm.Message.JobProgress) void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    self.publish(.{ .job_progress = rep }) catch |err| logger.err("job report {s}: {!}", .{ rep.name, err });
+}
+
+/// restarts lnd to compact its database and waits until it's ready.
+/// the compaction is enabled only for the duration of the restart.
+fn compactLnd(self: *Daemon) !void {
+    try self.setLndAutoCompact(true);
+    defer self.setLndAutoCompact(false) catch |err| logger.err("lnd compaction: disable: {!}", .{err});
+    try self.services.stopWait(sys.Service.LND);
+    // pooled connections are gone with the restart.
+    self.lndc.invalidate();
+    const probe = LndReadyProbe{ .lndc = &self.lndc, .want = .SERVER_ACTIVE };
+    try self.services.startReady(sys.Service.LND, probe, .{
+        .timeout_ms = lnd_compact.ready_timeout_ms,
+        .max_delay_ms = 5 * time.ms_per_s,
+        .clock = self.clock,
+    });
+}
+
+fn setLndAutoCompact(self: *Daemon, enable: bool) !void {
+    var mut = try self.conf.beginMutateLndConf(.{});
+    defer mut.finish();
+    const sec = mut.lndconf.findSection("bolt") orelse try mut.lndconf.appendSection("bolt");
+    try sec.setPropStr("db.bolt.auto-compact", if (enable) "true" else "false");
+    try mut.persist();
+}
+
+/// min number of blocks behind for a bootstrap from a UTXO set snapshot:
+/// a node closer to the tip syncs faster than the snapshot downloads.
+const bootstrap_min_blocks = 50_000;
+/// how often the snapshot download progress is sent to ngui.
+const bootstrap_report_interval_ms = 5 * time.ms_per_s;
+
+/// starts a bootstrap from self.utxo_snapshot on a fresh node far behind the
+/// chain tip as of the onchain report rep, and reports background validation
+/// progress of a loaded snapshot with each onchain report until validated.
+/// called from the onchain thread.
+fn checkBootstrap(self: *Daemon, rep: comm.Message.OnchainReport) void {
+    if (self.utxo_snapshot == null) {
+        return;
+    }
+    self.mu.lock();
+    const st = self.bootstrap_state;
+    self.mu.unlock();
+    if (st != .unchecked and st != .validating) {
+        return;
+    }
+    const res = self.bitcoind.call(.getchainstates, {}) catch |err| {
+        logger.err("bootstrap: getchainstates: {!}", .{err});
+        if (err == error.RpcMethodNotFound) {
+            self.setBootstrapState(.off); // bitcoind predates assumeutxo
+        }
+        return; // retried with the next report
+    };
+    defer res.deinit();
+    const chainstates = res.value.chainstates;
+    const snapshot = for (chainstates) |cs| {
+        if (cs.snapshot_blockhash != null) break cs;
+    } else null;
+
+    if (snapshot == null) {
+        self.mu.lock();
+        const idle = self.state == .running or self.state == .standby;
+        const fresh = rep.ibd and rep.headers -| rep.blocks >= bootstrap_min_blocks;
+        self.bootstrap_state = if (idle and fresh) .downloading else .off;
+        self.mu.unlock();
+        if (idle and fresh) {
+            logger.info("bootstrap: {d} blocks behind; fetching {s}", .{ rep.headers - rep.blocks, self.utxo_snapshot.?.url });
+            // the task reports its own progress and failures.
+            self.workers.submit(.{ .name = "bitcoin bootstrap", .report = false, .ctx = self, .runFn = bootstrapTask }) catch |err| {
+                logger.err("bootstrap: task: {!}", .{err});
+                self.setBootstrapState(.off);
+                return;
+            };
+        }
+        return;
+    }
+
+    // a single chainstate is left once the snapshot is validated.
+    if (chainstates.len == 1) {
+        if (st == .validating) {
+            self.sendBootstrapReport(.{ .state = .done, .downloaded = 0, .size = null, .height = snapshot.?.blocks, .validated = snapshot.?.blocks });
+        }
+        self.setBootstrapState(.done);
+        return;
+    }
+    if (self.bootstrapBaseHeight(snapshot.?.snapshot_blockhash.?)) |height| {
+        self.setBootstrapState(.validating);
+        self.sendBootstrapReport(.{
+            .state = .validating,
+            .downloaded = 0,
+            .size = null,
+            .height = height,
+            .validated = @min(chainstates[0].blocks, height),
+        });
+    } else |err| {
+        logger.err("bootstrap: snapshot base height: {!}", .{err});
+    }
+}
+
+/// returns the height of the snapshot base block, fetched once per run.
+fn bootstrapBaseHeight(self: *Daemon, hash: types.Hash) !u64 {
+    self.mu.lock();
+    const height = self.bootstrap_height;
+    self.mu.unlock();
+    if (height != 0) {
+        return height;
+    }
+    const hex = hash.hex();
+    const res = try self.bitcoind.call(.getblockheader, .{ .blockhash = &hex });
+    defer res.deinit();
+    self.mu.lock();
+    self.bootstrap_height = res.value.height;
+    self.mu.unlock();
+    return res.value.height;
+}
+
+fn setBootstrapState(self: *Daemon, st: std.meta.FieldType(Daemon, .bootstrap_state)) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.bootstrap_state = st;
+}
+
+fn sendBootstrapReport(self: *Daemon, rep: comm.Message.BitcoinBootstrap) void {
+    self.uiwrite(.{ .bitcoin_bootstrap = rep }) catch |err| logger.err("bootstrap report: {!}", .{err});
+}
+
+/// downloads the snapshot and loads it into bitcoind, which then syncs
+/// from the snapshot base block while validating the chain up to it.
+fn bootstrapTask(ctx: *anyopaque, tok: WorkerPool.Token) !void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    const snap = self.utxo_snapshot.?; // set if started
+    var progress = BootstrapProgress{ .daemon = self, .tok = tok };
+    snap.fetch(self.allocator, &progress) catch |err| {
+        logger.err("bootstrap: {s}: {!}", .{ snap.url, err });
+        if (err != error.UtxoSnapshotCancelled) {
+            self.sendBootstrapReport(.{ .state = .failed, .downloaded = progress.done, .size = null, .height = 0, .validated = 0 });
+        }
+        // network errors are retried with the next onchain report, resuming
+        // the download; a bad snapshot is not.
+        const retry = err != error.UtxoSnapshotBadDigest and err != error.UtxoSnapshotHttpStatus;
+        self.setBootstrapState(if (retry) .unchecked else .off);
+        return;
+    };
+
+    // a maintenance restart of bitcoind would abort the loading.
+    const groups = JobScheduler.Groups.initMany(&.{ .bitcoind, .lnd });
+    self.jobs.acquire(groups) catch return; // stopping
+    defer self.jobs.release(groups);
+    logger.info("bootstrap: loading {s}", .{snap.path});
+    self.sendBootstrapReport(.{ .state = .loading, .downloaded = progress.done, .size = progress.done, .height = 0, .validated = 0 });
+    const res = self.bitcoind.call(.loadtxoutset, .{ .path = snap.path }) catch |err| {
+        logger.err("bootstrap: loadtxoutset: {!}", .{err});
+        self.sendBootstrapReport(.{ .state = .failed, .downloaded = progress.done, .size = progress.done, .height = 0, .validated = 0 });
+        self.setBootstrapState(.off);
+        return;
+    };
+    defer res.deinit();
+    logger.info("bootstrap: loaded {d} coins at height {d}", .{ res.value.coins_loaded, res.value.base_height });
+    // bitcoind keeps the coins in its own chainstate.
+    std.fs.cwd().deleteFile(snap.path) catch |err| logger.err("bootstrap: {s}: {!}", .{ snap.path, err });
+    self.mu.lock();
+    self.bootstrap_height = res.value.base_height;
+    self.bootstrap_state = .validating;
+    self.want_onchain_report = true; // reports progress
+    self.mu.unlock();
+    self.onchain_wake.set();
+}
+
+/// sends snapshot download progress to ngui every few seconds, and cancels
+/// the download on daemon stop or once its task is cancelled.
+const BootstrapProgress = struct {
+    daemon: *Daemon,
+    tok: WorkerPool.Token,
+    done: u64 = 0, // bytes
+    last: i64 = 0, // time.milliTimestamp of the last report
+
+    pub fn report(self: *BootstrapProgress, p: UtxoSnapshot.Progress) bool {
+        self.done = p.done;
+        const now = time.milliTimestamp();
+        if (now - self.last >= bootstrap_report_interval_ms) {
+            self.last = now;
+            self.daemon.sendBootstrapReport(.{ .state = .downloading, .downloaded = p.done, .size = p.total, .height = 0, .validated = 0 });
+        }
+        if (self.tok.cancelled()) {
+            return false;
+        }
+        self.daemon.mu.lock();
+        defer self.daemon.mu.unlock();
+        return !self.daemon.want_stop;
+    }
+};
+
+/// adds the sample to self.history, if enabled, and sends a history report
+/// to ngui at most once a minute.
+fn recordHistory(self: *Daemon, sample: History.Sample) void {
+    const h = if (self.history) |*hist| hist else return;
+    const now = time.timestamp();
+    if (!h.record(now, sample)) {
+        return;
+    }
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const rep = h.report(arena_state.allocator(), now) catch |err| {
+        logger.err("history report: {!}", .{err});
+        return;
+    };
+    self.publish(.{ .history_report = rep }) catch |err| logger.err("history report: {!}", .{err});
+}
+
+/// disconnects a peer lagging behind the others in bitcoind initial block
+/// download, if any, and records the sync rate change evictions bring.
+/// see PeerEvictor. makes blocking network calls.
+fn evictSlowPeers(self: *Daemon, bcinfo: bitcoindrpc.BlockchainInfo, peers: []const bitcoindrpc.PeerInfo) void {
+    const ev = if (self.peer_evictor) |*e| e else return;
+    if (!bcinfo.initialblockdownload) {
+        ev.reset();
+        return;
+    }
+    const now = time.milliTimestamp();
+    const rate = if (self.sync_rate.seeded) self.sync_rate.blocks_rate else 0;
+    if (ev.gain(now, rate)) |ratio| {
+        logger.info("ibd: sync rate x{d:.2} since peer evictions", .{ratio});
+        self.metrics.recordEvictionGain(ratio);
+    }
+    const victim = ev.sample(now, rate, peers) orelse return;
+    const res = self.bitcoind.call(.disconnectnode, .{ .nodeid = victim.id }) catch |err| {
+        logger.err("ibd: disconnectnode {s}: {!}", .{ victim.addr, err });
+        return;
+    };
+    res.deinit();
+    logger.info("ibd: disconnected slow {s} peer {s}", .{ @tagName(victim.kind), victim.addr });
+    self.metrics.recordEviction(victim.kind);
+}
+
+const LocalAddr = std.meta.Child(std.meta.FieldType(comm.Message.OnchainReport, .localaddr));
+
+/// bitcoind RPC methods fetched in a single batch call for an onchain report.
+const onchain_batch = [_]bitcoindrpc.Client.Method{ .getblockchaininfo, .getmempoolinfo, .getpeerinfo, .getnettotals };
+/// how often the slow changing getnetworkinfo is refetched, in ms.
+const netinfo_ttl = 10 * time.ms_per_min;
+
+const OnchainStats = struct {
+    batch: bitcoindrpc.Client.BatchResult(&onchain_batch), // owns the values below
+    bcinfo: bitcoindrpc.BlockchainInfo,
+    mempool: bitcoindrpc.MempoolInfo,
+    peers: []const bitcoindrpc.PeerInfo,
+    netinfo: bitcoindrpc.NetworkInfo, // owned by self.netinfo_cache
+    nettotals: ?bitcoindrpc.NetTotals, // null if the call failed
+    nettotals_ns: u64, // a Daemon.clock reading as of the batch call
+    // lnd wallet may be uninitialized
+    balance: ?lndhttp.WalletBalance,
+};
+
+const LndBalance = struct {
+    value: lndhttp.WalletBalance,
+    at_ns: u64, // a Daemon.clock reading
+};
+
+/// records the lnd wallet balance for the next onchain reports.
+fn storeLndBalance(self: *Daemon, bal: lndhttp.WalletBalance) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.lnd_balance = .{ .value = bal, .at_ns = self.clock.now() };
+}
+
+/// returns the lnd wallet balance of an onchain report: the one fetched with
+/// the last lightning report, unless older than the lnd report interval as
+/// when lightning reports fail. it is then fetched again with the shared lnd
+/// client, but not while the lnd breaker is open: lnd is down, and the report
+/// goes without a balance. callers must not hold self.mu.
+fn lndBalance(self: *Daemon) ?lndhttp.WalletBalance {
+    self.mu.lock();
+    const cached = self.lnd_balance;
+    const max_age = self.lndInterval();
+    self.mu.unlock();
+    if (cached) |b| {
+        if (self.clock.since(b.at_ns) <= max_age) {
+            return b.value;
+        }
+    }
+    if (!self.lnd_breaker.closed()) {
+        return null;
+    }
+    const lnd = self.lndc.acquire() catch return null;
+    defer lnd.release();
+    const res = lnd.client.call(.walletbalance, {}) catch |err| {
+        logger.debug("walletbalance: {!}", .{err});
+        return null;
+    };
+    defer res.deinit();
+    self.storeLndBalance(res.value);
+    return res.value;
+}
+
+/// callers own returned value, except for netinfo.
+fn fetchOnchainStats(self: *Daemon, opt: OnchainReportOpt) !OnchainStats {
+    const batch = try self.bitcoind.callBatch(&onchain_batch, .{ {}, {}, {}, {} });
+    errdefer batch.deinit();
+    const nettotals_ns = self.clock.now();
+    const bcinfo = try batch.value[0];
+    const mempool = try batch.value[1];
+    const peers = try batch.value[2];
+    // the report is still of use without traffic rates.
+    const nettotals = batch.value[3] catch |err| blk: {
+        logger.debug("getnettotals: {!}", .{err});
+        break :blk null;
+    };
+    const netinfo = try self.cachedNetworkInfo();
+
+    return .{
+        .batch = batch,
+        .bcinfo = bcinfo,
+        .mempool = mempool,
+        .peers = peers,
+        .netinfo = netinfo,
+        .nettotals = nettotals,
+        .nettotals_ns = nettotals_ns,
+        .balance = if (opt.balance) self.lndBalance() else null,
+    };
+}
+
+const NetTotalsSample = struct {
+    recv: u64, // bytes
+    sent: u64, // bytes
+    time_ns: u64, // a Daemon.clock reading
+};
+
+/// returns the bitcoind p2p traffic rates since the previous call, from the
+/// getnettotals counters deltas over the monotonic clock. null until two
+/// samples, and when the counters go back as after a bitcoind restart.
+fn netRates(self: *Daemon, totals: ?bitcoindrpc.NetTotals, now_ns: u64) ?comm.Message.OnchainReport.NetRates {
+    const cur = totals orelse {
+        self.net_totals = null;
+        return null;
+    };
+    const prev = self.net_totals;
+    self.net_totals = .{ .recv = cur.totalbytesrecv, .sent = cur.totalbytessent, .time_ns = now_ns };
+    const p = prev orelse return null;
+    if (cur.totalbytesrecv < p.recv or cur.totalbytessent < p.sent or now_ns <= p.time_ns) {
+        return null;
+    }
+    const sec = @as(f64, @floatFromInt(now_ns - p.time_ns)) / time.ns_per_s;
+    return .{
+        .recv_bytes_per_sec = roundRate(@as(f64, @floatFromInt(cur.totalbytesrecv - p.recv)) / sec),
+        .sent_bytes_per_sec = roundRate(@as(f64, @floatFromInt(cur.totalbytessent - p.sent)) / sec),
+    };
+}
+
+/// rounds a rate to two significant digits: finer changes are noise which
+/// would otherwise make every onchain report differ; see report_dedup.
+fn roundRate(v: f64) u64 {
+    if (v < 1) {
+        return 0;
+    }
+    const scale = std.math.pow(f64, 10, @floor(@log10(v)) - 1);
+    return @intFromFloat(@round(v / scale) * scale);
+}
+
+/// number of latest blocks in onchain reports.
+const recent_blocks_count = 6;
+
+/// returns stats of the latest blocks up to the best block in bcinfo, using
+/// self.block_stats. skipped in initial block download: the tip moves too fast
+/// for the cache to be of any use.
+fn recentBlocks(self: *Daemon, bcinfo: bitcoindrpc.BlockchainInfo, out: []comm.Message.OnchainReport.BlockStats) []comm.Message.OnchainReport.BlockStats {
+    if (bcinfo.initialblockdownload) {
+        return out[0..0];
+    }
+    return self.block_stats.recent(&self.bitcoind, bcinfo.bestblockhash, bcinfo.blocks, out) catch |err| {
+        logger.err("getblockstats: {!}", .{err});
+        return out[0..0];
+    };
+}
+
+/// returns estimatesmartfee rates for the best block in bcinfo, cached
+/// until the next block.
+fn feeEstimates(self: *Daemon, bcinfo: bitcoindrpc.BlockchainInfo) ?comm.Message.OnchainReport.FeeEstimates {
+    if (bcinfo.initialblockdownload) {
+        return null; // too little data
+    }
+    if (self.fee_estimates) |c| {
+        if (std.meta.eql(c.hash, bcinfo.bestblockhash)) {
+            return c.value;
+        }
+    }
+    const value = self.fetchFeeEstimates() catch |err| blk: {
+        logger.err("estimatesmartfee: {!}", .{err});
+        break :blk null;
+    };
+    self.fee_estimates = .{ .hash = bcinfo.bestblockhash, .value = value };
+    return value;
+}
+
+fn fetchFeeEstimates(self: *Daemon) !?comm.Message.OnchainReport.FeeEstimates {
+    const res = try self.bitcoind.callMany(.estimatesmartfee, &.{
+        .{ .conf_target = 1 },
+        .{ .conf_target = 6 },
+        .{ .conf_target = 144 },
+    });
+    defer res.deinit();
+    var rates: [3]f32 = undefined;
+    for (res.value, &rates) |r, *rate| {
+        const feerate = (try r).feerate orelse return null;
+        rate.* = @floatCast(feerate * 1e5); // BTC/kvB to sat/vB
+    }
+    return .{ .next_block = rates[0], .hour = rates[1], .day = rates[2] };
+}
+
+/// returns getnetworkinfo result from self.netinfo_cache, refetching it if
+/// older than netinfo_ttl. the value is valid until the next call.
+fn cachedNetworkInfo(self: *Daemon) !bitcoindrpc.NetworkInfo {
+    const now = time.milliTimestamp();
+    if (self.netinfo_cache) |c| {
+        if (now - c.fetched < netinfo_ttl) {
+            return c.res.value;
+        }
+    }
+    const res = try self.bitcoind.call(.getnetworkinfo, {});
+    if (self.netinfo_cache) |c| {
+        c.res.deinit();
+    }
+    self.netinfo_cache = .{ .res = res, .fetched = now };
+    return res.value;
+}
+
+/// max number of peer aliases fetched in a single refreshPeerAliases call.
+const peer_alias_refresh_batch = 16;
+
+/// fetches aliases of unknown or expired peers in self.peer_aliases, at most
+/// peer_alias_refresh_batch at a time. done is true when there's nothing
+/// else to refresh.
+fn refreshPeerAliases(self: *Daemon) !struct { changed: bool, done: bool } {
+    const now = time.milliTimestamp();
+    const keys = try self.peer_aliases.staleKeys(self.allocator, peer_alias_refresh_batch, now);
+    defer PeerAliasCache.freeKeys(self.allocator, keys);
+    if (keys.len == 0) {
+        return .{ .changed = false, .done = true };
+    }
+
+    const lnd = try self.lndc.acquire();
+    defer lnd.release();
+    var changed = false;
+    for (keys) |pubkey| {
+        const res = lnd.client.call(.getnodeinfo, .{ .pubkey = pubkey }) catch |err| {
+            logger.debug("getnodeinfo {s}: {!}", .{ pubkey, err });
+            _ = try self.peer_aliases.set(pubkey, null, now); // retry after ttl
+            continue;
+        };
+        defer res.deinit();
+        if (try self.peer_aliases.set(pubkey, res.value.node.alias, now)) {
+            changed = true;
+        }
+    }
+    return .{ .changed = changed, .done = keys.len < peer_alias_refresh_batch };
+}
+
+/// a peer view refresh is abandoned past this deadline, and retried
+/// PeerView.ttl_ns later.
+const peer_view_deadline_ms = 10 * time.ms_per_s;
+
+/// serves the ngui peer view while it's open: refreshes the peers with
+/// listpeers once the list is older than PeerView.ttl_ns, and sends those
+/// changed since the last message, or all of them right after
+/// subscribe_lightning_peers. returns ns until the next refresh is due, or
+/// null if the view is closed. the next message is full after a failure.
+fn servePeerView(self: *Daemon) !?u64 {
+    self.mu.lock();
+    const open = self.peer_view_open;
+    const full = self.peer_view_full;
+    self.peer_view_full = false;
+    self.mu.unlock();
+    if (!open) {
+        return null;
+    }
+    errdefer {
+        self.mu.lock();
+        self.peer_view_full = true;
+        self.mu.unlock();
+    }
+
+    if (!self.peer_view.fresh(self.clock.now())) {
+        const lnd = try self.lndc.acquire();
+        defer lnd.release();
+        const prev_deadline = deadline.begin(peer_view_deadline_ms);
+        defer deadline.end(prev_deadline);
+        const res = try lnd.client.call(.listpeers, {});
+        defer res.deinit();
+        try self.peer_view.update(res.value.peers, self.clock.now());
     }
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const msg = try self.peer_view.message(arena_state.allocator(), full, &self.peer_aliases, time.milliTimestamp());
+    if (msg) |peers| {
+        try self.uiwrite(.{ .lightning_peers = peers });
+    }
+    return self.peer_view.untilStale(self.clock.now());
+}
 
-    const btcrep: comm.Message.OnchainReport = .{
-        .blocks = stats.bcinfo.value.blocks,
-        .headers = stats.bcinfo.value.headers,
-        .timestamp = stats.bcinfo.value.time,
-        .hash = stats.bcinfo.value.bestblockhash,
-        .ibd = stats.bcinfo.value.initialblockdownload,
-        .diskusage = stats.bcinfo.value.size_on_disk,
-        .version = stats.netinfo.value.subversion,
-        .conn_in = stats.netinfo.value.connections_in,
-        .conn_out = stats.netinfo.value.connections_out,
-        .warnings = stats.bcinfo.value.warnings, // TODO: netinfo.result.warnings
-        .localaddr = &.{}, // TODO: populate
-        // something similar to this:
-        // @round(bcinfo.verificationprogress * 100)
-        .verifyprogress = 0,
-        .mempool = .{
-            .loaded = stats.mempool.value.loaded,
-            .txcount = stats.mempool.value.size,
-            .usage = stats.mempool.value.usage,
-            .max = stats.mempool.value.maxmempool,
-            .totalfee = stats.mempool.value.total_fee,
-            .minfee = stats.mempool.value.mempoolminfee,
-            .fullrbf = stats.mempool.value.fullrbf,
-        },
-        .balance = if (stats.balance) |bal| .{
-            .source = .lnd,
-            .total = bal.value.total_balance,
-            .confirmed = bal.value.confirmed_balance,
-            .unconfirmed = bal.value.unconfirmed_balance,
-            .locked = bal.value.locked_balance,
-            .reserved = bal.value.reserved_balance_anchor_chan,
-        } else null,
-    };
+/// the worker task name of queueChannelDetail.
+const chan_detail_task = "channel detail";
 
-    try comm.write(self.allocator, self.uiwriter, .{ .onchain_report = btcrep });
+/// replies to the ngui request id with the details of the channel chan_id,
+/// a short channel id: right away if cached, or else once looked up in a
+/// worker task since it takes a few lnd calls.
+fn queueChannelDetail(self: *Daemon, chan_id: []const u8, id: u32) !void {
+    const scid = std.fmt.parseUnsigned(u64, chan_id, 10) catch return error.InvalidChannelId;
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    if (try self.chan_details.get(arena_state.allocator(), scid, time.milliTimestamp())) |info| {
+        return self.uireply(.{ .lightning_channel_detail = .{ .id = chan_id, .info = info } }, id);
+    }
+    // the task is freed when done.
+    const task = try self.allocator.create(ChanDetailTask);
+    errdefer self.allocator.destroy(task);
+    task.* = .{ .daemon = self, .scid = scid, .id = id };
+    try self.workers.submit(.{ .name = chan_detail_task, .report = false, .ctx = task, .runFn = ChanDetailTask.run });
 }
 
-const OnchainStats = struct {
-    bcinfo: bitcoindrpc.Client.Result(.getblockchaininfo),
-    netinfo: bitcoindrpc.Client.Result(.getnetworkinfo),
-    mempool: bitcoindrpc.Client.Result(.getmempoolinfo),
-    // lnd wallet may be uninitialized
-    balance: ?lndhttp.Client.Result(.walletbalance),
+const ChanDetailTask = struct {
+    daemon: *Daemon,
+    scid: u64,
+    id: u32, // ngui request id
+
+    fn run(ctx: *anyopaque, tok: WorkerPool.Token) !void {
+        const self: *ChanDetailTask = @ptrCast(@alignCast(ctx));
+        const daemon = self.daemon;
+        defer daemon.allocator.destroy(self);
+        if (tok.cancelled()) {
+            return error.Cancelled;
+        }
+        var idbuf: [20]u8 = undefined; // max u64 digits
+        const chan_id = std.fmt.bufPrint(&idbuf, "{d}", .{self.scid}) catch unreachable;
+        var arena_state = std.heap.ArenaAllocator.init(daemon.allocator);
+        defer arena_state.deinit();
+        const detail: comm.Message.LightningChannelDetail = if (daemon.lookupChannelDetail(arena_state.allocator(), self.scid, chan_id)) |info|
+            .{ .id = chan_id, .info = info }
+        else |err| blk: {
+            logger.err("channel detail {s}: {!}", .{ chan_id, err });
+            break :blk .{ .id = chan_id, .info = null, .err = @errorName(err) };
+        };
+        try daemon.uireply(.{ .lightning_channel_detail = detail }, self.id);
+    }
 };
 
-/// call site must hold self.mu due to self.state read access.
-/// callers own returned value.
-fn fetchOnchainStats(self: *Daemon) !OnchainStats {
-    var client = bitcoindrpc.Client{
-        .allocator = self.allocator,
-        .cookiepath = "/ssd/bitcoind/mainnet/.cookie",
+/// looks up the channel scid, chan_id as a string, and its peer in the lnd
+/// graph, and caches the result in self.chan_details.
+fn lookupChannelDetail(self: *Daemon, arena: std.mem.Allocator, scid: u64, chan_id: []const u8) !comm.Message.LightningChannelDetail.Info {
+    const lnd = try self.lndc.acquire();
+    defer lnd.release();
+    const edge = try lnd.client.call(.getchaninfo, .{ .chan_id = scid });
+    defer edge.deinit();
+    // the local end is the one which isn't the peer. a channel gone from the
+    // last report set is taken to be peered with node2.
+    var peerhex: [types.PubKey.hex_len]u8 = undefined;
+    const peer: []const u8 = if (self.channel_index.peerOf(chan_id)) |pk| blk: {
+        peerhex = pk.hex();
+        break :blk &peerhex;
+    } else edge.value.node2_pub;
+    const peer_is_node1 = std.mem.eql(u8, edge.value.node1_pub, peer);
+    var info: comm.Message.LightningChannelDetail.Info = .{
+        .capacity = edge.value.capacity,
+        .last_update = edge.value.last_update,
+        .local = routingPolicy(if (peer_is_node1) edge.value.node2_policy else edge.value.node1_policy),
+        .remote = routingPolicy(if (peer_is_node1) edge.value.node1_policy else edge.value.node2_policy),
+        .peer = .{ .pubkey = try arena.dupe(u8, peer), .alias = "", .num_channels = 0, .total_capacity = 0 },
     };
-    const bcinfo = try client.call(.getblockchaininfo, {});
-    const netinfo = try client.call(.getnetworkinfo, {});
-    const mempool = try client.call(.getmempoolinfo, {});
+    // the channel details are still of use without those of its peer.
+    if (lnd.client.call(.getnodeinfo, .{ .pubkey = peer })) |node| {
+        defer node.deinit();
+        info.peer.alias = try arena.dupe(u8, node.value.node.alias);
+        info.peer.num_channels = node.value.num_channels;
+        info.peer.total_capacity = node.value.total_capacity;
+    } else |err| {
+        logger.debug("getnodeinfo {s}: {!}", .{ peer, err });
+    }
+    try self.chan_details.put(scid, info, time.milliTimestamp());
+    return info;
+}
 
-    const balance: ?lndhttp.Client.Result(.walletbalance) = blk: { // lndhttp.WalletBalance
-        if (self.state == .wallet_reset) {
-            break :blk null;
-        }
-        var lndc = lndhttp.Client.init(.{
-            .allocator = self.allocator,
-            .tlscert_path = Config.LND_TLSCERT_PATH,
-            .macaroon_ro_path = Config.LND_MACAROON_RO_PATH,
-            .macaroon_admin_path = Config.LND_MACAROON_ADMIN_PATH,
-        }) catch break :blk null;
-        defer lndc.deinit();
-        const res = lndc.call(.walletbalance, {}) catch break :blk null;
-        break :blk res;
-    };
+fn routingPolicy(p: ?lndhttp.ChannelEdge.RoutingPolicy) ?comm.Message.LightningChannelDetail.RoutingPolicy {
+    const v = p orelse return null;
     return .{
-        .bcinfo = bcinfo,
-        .netinfo = netinfo,
-        .mempool = mempool,
-        .balance = balance,
+        .base_fee = v.fee_base_msat,
+        .fee_ppm = v.fee_rate_milli_msat,
+        .timelock_delta = v.time_lock_delta,
+        .min_htlc = v.min_htlc,
+        .max_htlc = v.max_htlc_msat,
+        .disabled = v.disabled,
+        .last_update = v.last_update,
     };
 }
 
 fn sendLightningReport(self: *Daemon) !void {
-    var client = try lndhttp.Client.init(.{
-        .allocator = self.allocator,
-        .tlscert_path = Config.LND_TLSCERT_PATH,
-        .macaroon_ro_path = Config.LND_MACAROON_RO_PATH,
-        .macaroon_admin_path = Config.LND_MACAROON_ADMIN_PATH,
-    });
-    defer client.deinit();
+    const lnd = try self.lndc.acquire();
+    defer lnd.release();
+    const client = lnd.client;
+    const scratch = &self.lnd_report_scratch;
+    scratch.reset();
+    // peer aliases are dup'ed from the cache.
+    const arena = scratch.arena.allocator();
+    const now = time.milliTimestamp();
 
-    const info = try client.call(.getinfo, {});
-    defer info.deinit();
-    const feerep = try client.call(.feereport, {});
-    defer feerep.deinit();
-    const chanlist = try client.call(.listchannels, .{ .peer_alias_lookup = true });
-    defer chanlist.deinit();
-    const pending = try client.call(.pendingchannels, {});
-    defer pending.deinit();
+    // fan out all calls concurrently. peer aliases come from self.peer_aliases
+    // because lnd alias lookup is slow on nodes with many channels.
+    // the wallet balance is for onchain reports; see lndBalance.
+    const group = client.callGroup(
+        &.{ .getinfo, .feereport, .listchannels, .pendingchannels, .walletbalance },
+        .{ {}, {}, .{ .peer_alias_lookup = false }, {}, {} },
+    );
+    defer lndhttp.Client.deinitGroup(group);
+    const info = try group[0];
+    const feerep = try group[1];
+    const chanlist = try group[2];
+    const pending = try group[3];
+    if (group[4]) |bal| {
+        self.storeLndBalance(bal.value);
+    } else |err| logger.debug("walletbalance: {!}", .{err});
+    self.mu.lock();
+    self.lnd_syncing = !info.value.synced_to_chain or !info.value.synced_to_graph;
+    self.mu.unlock();
+    // earnings are reported as of the last successful sync.
+    self.syncForwards(client) catch |err| logger.err("syncForwards: {!}", .{err});
+    const new_payments = self.syncPayments(client) catch |err| blk: {
+        logger.err("syncPayments: {!}", .{err});
+        break :blk 0;
+    };
+    const txs_changed = self.syncTransactions(client, info.value.block_height) catch |err| blk: {
+        logger.err("syncTransactions: {!}", .{err});
+        break :blk false;
+    };
 
     var lndrep = comm.Message.LightningReport{
         .version = info.value.version,
@@ -853,14 +4002,13 @@ fn sendLightningReport(self: *Daemon) !void {
         .channels = undefined, // populated below
     };
 
-    var feemap = std.StringHashMap(struct { base: i64, ppm: i64 }).init(self.allocator);
-    defer feemap.deinit();
+    const feemap = &scratch.feemap;
     for (feerep.value.channel_fees) |item| {
-        try feemap.put(item.chan_id, .{ .base = item.base_fee_msat, .ppm = item.fee_per_mil });
+        try feemap.put(self.allocator, item.chan_id, .{ .base = item.base_fee_msat, .ppm = item.fee_per_mil });
     }
 
-    var channels = std.ArrayList(@typeInfo(@TypeOf(lndrep.channels)).Pointer.child).init(self.allocator);
-    defer channels.deinit();
+    var channels = scratch.channels.toManaged(self.allocator);
+    defer scratch.channels = channels.moveToUnmanaged();
     for (pending.value.pending_open_channels) |item| {
         try channels.append(.{
             .id = null,
@@ -869,7 +4017,7 @@ fn sendLightningReport(self: *Daemon) !void {
             .point = item.channel.channel_point,
             .closetxid = null,
             .peer_pubkey = item.channel.remote_node_pub,
-            .peer_alias = "", // TODO: a cached getnodeinfo?
+            .peer_alias = try self.peer_aliases.lookup(arena, &item.channel.remote_node_pub.hex(), now),
             .capacity = item.channel.capacity,
             .balance = .{
                 .local = item.channel.local_balance,
@@ -887,9 +4035,9 @@ fn sendLightningReport(self: *Daemon) !void {
             .state = .pending_close,
             .private = item.channel.private,
             .point = item.channel.channel_point,
-            .closetxid = item.closing_txid,
+            .closetxid = types.Hash.parse(item.closing_txid) catch null,
             .peer_pubkey = item.channel.remote_node_pub,
-            .peer_alias = "", // TODO: a cached getnodeinfo?
+            .peer_alias = try self.peer_aliases.lookup(arena, &item.channel.remote_node_pub.hex(), now),
             .capacity = item.channel.capacity,
             .balance = .{
                 .local = item.channel.local_balance,
@@ -907,9 +4055,9 @@ fn sendLightningReport(self: *Daemon) !void {
             .state = .pending_close,
             .private = item.channel.private,
             .point = item.channel.channel_point,
-            .closetxid = item.closing_txid,
+            .closetxid = types.Hash.parse(item.closing_txid) catch null,
             .peer_pubkey = item.channel.remote_node_pub,
-            .peer_alias = "", // TODO: a cached getnodeinfo?
+            .peer_alias = try self.peer_aliases.lookup(arena, &item.channel.remote_node_pub.hex(), now),
             .capacity = item.channel.capacity,
             .balance = .{
                 .local = item.channel.local_balance,
@@ -932,7 +4080,7 @@ fn sendLightningReport(self: *Daemon) !void {
             .point = ch.channel_point,
             .closetxid = null,
             .peer_pubkey = ch.remote_pubkey,
-            .peer_alias = ch.peer_alias,
+            .peer_alias = try self.peer_aliases.lookup(arena, &ch.remote_pubkey.hex(), now),
             .capacity = ch.capacity,
             .balance = .{
                 .local = ch.local_balance,
@@ -944,40 +4092,446 @@ fn sendLightningReport(self: *Daemon) !void {
                 .sent = ch.total_satoshis_sent,
                 .received = ch.total_satoshis_received,
             },
-            .fees = if (feemap.get(ch.chan_id)) |v| .{ .base = v.base, .ppm = v.ppm } else .{ .base = 0, .ppm = 0 },
+            .fees = .{
+                .base = if (feemap.get(ch.chan_id)) |v| v.base else 0,
+                .ppm = if (feemap.get(ch.chan_id)) |v| v.ppm else 0,
+                .earned = self.channelEarnings(ch.chan_id, now),
+            },
         });
     }
 
     lndrep.channels = channels.items;
-    try comm.write(self.allocator, self.uiwriter, .{ .lightning_report = lndrep });
+    const chans_changed = try self.channel_index.set(lndrep.channels);
+    self.uiwriter_mu.lock();
+    const chview = self.channel_view;
+    if (self.uichannel_pages) {
+        lndrep.channels = &.{}; // see sendChannelsPage
+    }
+    const shm = if (self.uishm_reports) self.uishm else null;
+    self.uiwriter_mu.unlock();
+    self.mu.lock();
+    const full = self.want_full_lnd_report;
+    self.want_full_lnd_report = false;
+    self.mu.unlock();
+    if (full) {
+        self.lnd_report_diff.reset();
+    }
+    const shm_sent = if (shm) |s| try self.sendLightningShm(s, lndrep) else false;
+    if (!shm_sent) {
+        // the caller resets lnd_report_diff on error.
+        const msg = try self.lnd_report_diff.next(arena, lndrep);
+        try self.publish(msg);
+    }
+    if (self.snapshot) |*snap| {
+        snap.update(.{ .lightning_report = lndrep });
+    }
+    if (chview) |v| {
+        if (chans_changed or full) {
+            self.sendChannelsPage(v.get(), 0) catch |err| logger.err("sendChannelsPage: {!}", .{err});
+        }
+    }
+    if (new_payments > 0) {
+        self.uiwriter_mu.lock();
+        const payview = self.payments_view;
+        self.uiwriter_mu.unlock();
+        if (payview) |q| {
+            self.sendPaymentsPage(q, 0) catch |err| logger.err("sendPaymentsPage: {!}", .{err});
+        }
+    }
+    if (txs_changed) {
+        self.uiwriter_mu.lock();
+        const txview = self.tx_view;
+        self.uiwriter_mu.unlock();
+        if (txview) |q| {
+            self.sendTransactionsPage(q, 0) catch |err| logger.err("sendTransactionsPage: {!}", .{err});
+        }
+    }
+    if (txs_changed or chans_changed) {
+        self.utxos.invalidate(); // funds moved, or a channel opened or closed
+    }
+    const utxos_changed = self.refreshUtxos(client, info.value.block_height) catch |err| blk: {
+        logger.err("refreshUtxos: {!}", .{err});
+        break :blk false;
+    };
+    if (utxos_changed) {
+        self.uiwriter_mu.lock();
+        const utxoview = self.utxo_view;
+        self.uiwriter_mu.unlock();
+        if (utxoview) |q| {
+            self.sendUtxosPage(q, 0) catch |err| logger.err("sendUtxosPage: {!}", .{err});
+        }
+    }
+
+    self.recordHistory(.{
+        .ln_local = lndrep.totalbalance.local,
+        .ln_remote = lndrep.totalbalance.remote,
+        .ln_fees_day = std.math.lossyCast(i64, lndrep.totalfees.day),
+    });
+    self.scheduleLndCompaction(lndrep);
+}
+
+/// max number of forwarding events fetched from lnd in a single call.
+const forwards_batch = 1000;
+/// max number of calls per sync; more events are fetched on the next report.
+const forwards_max_batches = 10;
+
+/// fetches forwarding events added to lnd since the last sync into
+/// self.forwards, resuming at its persisted cursor, and saves the aggregates.
+/// the start_time of all calls is the same, so that lnd index offsets
+/// remain stable: new events are appended at the end of the range.
+fn syncForwards(self: *Daemon, client: *lndhttp.Client) !void {
+    const fw = if (self.forwards) |*f| f else return;
+    var synced: usize = 0;
+    defer if (synced > 0) fw.save() catch |err| logger.err("forwards save: {!}", .{err});
+    for (0..forwards_max_batches) |_| {
+        const res = try client.call(.fwdinghistory, .{ .index_offset = fw.cursor, .num_max_events = forwards_batch });
+        defer res.deinit();
+        const events = res.value.forwarding_events;
+        if (events.len == 0) {
+            break; // lnd reports offset 0 for an empty batch
+        }
+        // the cursor follows each event, so that an error midway doesn't
+        // count any of them twice on the next sync.
+        const start = fw.cursor;
+        for (events, 1..) |ev, i| {
+            try fw.add(.{
+                .timestamp_ns = ev.timestamp_ns,
+                .chan_in = try std.fmt.parseInt(u64, ev.chan_id_in, 10),
+                .chan_out = try std.fmt.parseInt(u64, ev.chan_id_out, 10),
+                .amt_in_msat = ev.amt_in_msat,
+                .amt_out_msat = ev.amt_out_msat,
+                .fee_msat = ev.fee_msat,
+            });
+            fw.cursor = start + @as(u32, @intCast(i));
+            synced += 1;
+        }
+        fw.cursor = res.value.last_offset_index;
+        if (events.len < forwards_batch) {
+            break;
+        }
+    }
+    if (synced > 0) {
+        logger.info("synced {d} forwarding events; cursor at {d}", .{ synced, fw.cursor });
+    }
+}
+
+/// returns forwarding fees earned as the outgoing channel chan_id over the
+/// last 30 days, in msat, or 0 if forwards are disabled.
+fn channelEarnings(self: *Daemon, chan_id: []const u8, now_ms: i64) u64 {
+    const fw = if (self.forwards) |*f| f else return 0;
+    const id = std.fmt.parseInt(u64, chan_id, 10) catch return 0;
+    return fw.stats(id, @divFloor(now_ms, time.ms_per_s), 30).fee_msat;
 }
 
+/// sends ngui a page of channels of the last lightning report for the query q,
+/// in reply to the request id, and retains q as the current view: its page
+/// is sent again, with no id, whenever the channels change.
+fn sendChannelsPage(self: *Daemon, q: comm.Message.LightningChannelsQuery, id: u32) !void {
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const page = try self.channel_index.page(arena_state.allocator(), q);
+    self.uiwriter_mu.lock();
+    self.channel_view = ChannelView.init(q);
+    self.uiwriter_mu.unlock();
+    try self.uireply(.{ .lightning_channels = page }, id);
+}
+
+/// max number of invoices or payments listed from lnd in a single call.
+const payments_batch = 1000;
+
+/// appends invoices settled and payments succeeded since the last sync to
+/// self.payments, listing lnd items from the persisted cursors on, and
+/// returns the number of new history items.
+/// lnd REST can't list invoices by settle_index: those settled after they
+/// were first listed are picked up by listing again from the oldest still open.
+fn syncPayments(self: *Daemon, client: *lndhttp.Client) !usize {
+    const plog = if (self.payments) |*p| p else return 0;
+    var items = std.ArrayList(PaymentsLog.Item).init(self.allocator);
+    defer items.deinit();
+    var added: usize = 0;
+
+    var offset = plog.beginSync(.invoices);
+    while (true) {
+        const res = try client.call(.listinvoices, .{ .index_offset = offset, .num_max_invoices = payments_batch });
+        defer res.deinit();
+        items.clearRetainingCapacity();
+        for (res.value.invoices) |inv| {
+            try items.append(.{
+                .index = inv.add_index,
+                .state = if (std.mem.eql(u8, inv.state, "SETTLED")) .settled else if (std.mem.eql(u8, inv.state, "CANCELED")) .failed else .open,
+                .time = inv.settle_date,
+                .amount_msat = inv.amt_paid_msat,
+                .memo = inv.memo,
+            });
+        }
+        added += try plog.merge(.invoices, items.items);
+        if (res.value.invoices.len < payments_batch) {
+            break;
+        }
+        offset = res.value.last_index_offset;
+    }
+
+    offset = plog.beginSync(.payments);
+    while (true) {
+        const res = try client.call(.listpayments, .{ .index_offset = offset, .max_payments = payments_batch });
+        defer res.deinit();
+        items.clearRetainingCapacity();
+        for (res.value.payments) |pay| {
+            try items.append(.{
+                .index = pay.payment_index,
+                .state = if (std.mem.eql(u8, pay.status, "SUCCEEDED")) .settled else if (std.mem.eql(u8, pay.status, "FAILED")) .failed else .open,
+                .time = @divTrunc(pay.creation_time_ns, time.ns_per_s),
+                .amount_msat = pay.value_msat,
+                .fee_msat = pay.fee_msat,
+            });
+        }
+        added += try plog.merge(.payments, items.items);
+        if (res.value.payments.len < payments_batch) {
+            break;
+        }
+        offset = res.value.last_index_offset;
+    }
+    return added;
+}
+
+/// sends ngui a page of the payments history for the query q in reply to
+/// the request id, and retains q as the current view: its page is sent again,
+/// with no id, whenever new items are appended. the history is empty when disabled.
+fn sendPaymentsPage(self: *Daemon, q: comm.Message.LightningPaymentsQuery, id: u32) !void {
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const page: comm.Message.LightningPaymentsPage = if (self.payments) |*p|
+        try p.page(arena_state.allocator(), q)
+    else
+        .{ .query = .{ .offset = 0, .limit = 0 }, .total = 0, .payments = &.{} };
+    self.uiwriter_mu.lock();
+    self.payments_view = q;
+    self.uiwriter_mu.unlock();
+    try self.uireply(.{ .lightning_payments = page }, id);
+}
+
+/// max number of blocks of onchain transactions listed from lnd in a single call.
+const txhistory_window = 10000;
+
+/// syncs self.txhistory with the lnd wallet transactions of blocks from the
+/// last few synced ones up to tip, and unconfirmed ones; see TxHistory.
+/// the first sync lists the whole history a window of blocks at a time.
+/// returns whether the history changed.
+fn syncTransactions(self: *Daemon, client: *lndhttp.Client, tip: u32) !bool {
+    const hist = if (self.txhistory) |*h| h else return false;
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+    var txs = std.ArrayList(TxHistory.Tx).init(arena);
+
+    const start = hist.syncStart();
+    var from = start;
+    while (true) {
+        // the last window goes up to the tip as of the call, unconfirmed included.
+        const last = tip -| from < txhistory_window;
+        const to: i32 = if (last) -1 else @intCast(from + txhistory_window - 1);
+        const res = try client.call(.gettransactions, .{ .start_height = @intCast(from), .end_height = to });
+        defer res.deinit();
+        for (res.value.transactions) |tx| {
+            var txid: [32]u8 = undefined;
+            const valid = if (std.fmt.hexToBytes(&txid, tx.tx_hash)) |b| b.len == txid.len else |_| false;
+            if (!valid) {
+                logger.warn("gettransactions: bad tx_hash {s}", .{tx.tx_hash});
+                continue;
+            }
+            try txs.append(.{
+                .txid = txid,
+                .height = if (tx.num_confirmations > 0) std.math.lossyCast(u32, tx.block_height) else 0,
+                .time = tx.time_stamp,
+                .amount = tx.amount,
+                .fee = tx.total_fees,
+                .label = try arena.dupe(u8, tx.label),
+            });
+        }
+        if (last) {
+            break;
+        }
+        from += txhistory_window;
+    }
+    const changed = try hist.merge(start, tip, txs.items);
+    if (changed) {
+        logger.info("synced onchain transactions from block {d} to {d}; {d} in total", .{ start, tip, hist.total() });
+    }
+    return changed;
+}
+
+/// sends ngui a page of the onchain transactions history for the query q in
+/// reply to the request id, and retains q as the current view: its page is
+/// sent again, with no id, whenever the history changes. the history is empty
+/// when disabled.
+fn sendTransactionsPage(self: *Daemon, q: comm.Message.OnchainTxQuery, id: u32) !void {
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const page: comm.Message.OnchainTxPage = if (self.txhistory) |*h|
+        try h.page(arena_state.allocator(), q)
+    else
+        .{ .query = .{ .offset = 0, .limit = 0 }, .total = 0, .transactions = &.{} };
+    self.uiwriter_mu.lock();
+    self.tx_view = q;
+    self.uiwriter_mu.unlock();
+    try self.uireply(.{ .onchain_transactions = page }, id);
+}
+
+/// lists the lnd wallet unspent outputs into self.utxos if stale as of the
+/// chain tip and viewed in ngui. returns whether the set changed.
+fn refreshUtxos(self: *Daemon, client: *lndhttp.Client, tip: u32) !bool {
+    self.uiwriter_mu.lock();
+    const viewed = self.utxo_view != null;
+    self.uiwriter_mu.unlock();
+    if (!viewed) {
+        return false;
+    }
+    const ticket = self.utxos.refreshTicket(tip) orelse return false;
+    const res = try client.call(.listunspent, .{});
+    defer res.deinit();
+    const utxos = try self.allocator.alloc(comm.Message.OnchainUtxo, res.value.utxos.len);
+    defer self.allocator.free(utxos);
+    var n: usize = 0;
+    for (res.value.utxos) |u| {
+        const txid = types.Hash.parse(u.outpoint.txid_str) catch {
+            logger.warn("listunspent: bad txid_str {s}", .{u.outpoint.txid_str});
+            continue;
+        };
+        utxos[n] = .{
+            .outpoint = .{ .txid = txid, .index = u.outpoint.output_index },
+            .amount = u.amount_sat,
+            .confirmations = std.math.lossyCast(u32, u.confirmations),
+            .address = u.address,
+        };
+        n += 1;
+    }
+    const changed = try self.utxos.set(ticket, tip, utxos[0..n]);
+    if (changed) {
+        logger.info("listed {d} onchain wallet unspent outputs as of block {d}", .{ n, tip });
+    }
+    return changed;
+}
+
+/// sends ngui a page of the onchain wallet unspent outputs for the query q in
+/// reply to the request id, and retains q as the current view: its page is
+/// sent again, with no id, whenever the outputs change. a first view of
+/// outputs not yet listed is followed by a lightning report to list them.
+fn sendUtxosPage(self: *Daemon, q: comm.Message.OnchainUtxoQuery, id: u32) !void {
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    const page = try self.utxos.page(arena_state.allocator(), q);
+    self.uiwriter_mu.lock();
+    self.utxo_view = q;
+    self.uiwriter_mu.unlock();
+    try self.uireply(.{ .onchain_utxos = page }, id);
+    if (!page.loaded) {
+        self.mu.lock();
+        self.want_lnd_report = true;
+        self.mu.unlock();
+        self.lnd_wake.set();
+    }
+}
+
+/// buffers of sendLightningReport re-used across cycles, so that a steady-state
+/// report allocates nothing new besides lnd responses.
+const LndReportScratch = struct {
+    arena: std.heap.ArenaAllocator,
+    feemap: std.StringHashMapUnmanaged(struct { base: i64, ppm: i64 }) = .{},
+    channels: std.ArrayListUnmanaged(comm.Message.LightningChannel) = .{},
+
+    fn init(allocator: std.mem.Allocator) LndReportScratch {
+        return .{ .arena = std.heap.ArenaAllocator.init(allocator) };
+    }
+
+    fn deinit(self: *LndReportScratch) void {
+        const allocator = self.arena.child_allocator;
+        self.feemap.deinit(allocator);
+        self.channels.deinit(allocator);
+        self.arena.deinit();
+    }
+
+    /// empties all buffers, keeping their capacity.
+    fn reset(self: *LndReportScratch) void {
+        _ = self.arena.reset(.retain_capacity);
+        self.feemap.clearRetainingCapacity();
+        self.channels.clearRetainingCapacity();
+    }
+};
+
+/// writes a full lightning report into the region shared with ngui, notifies
+/// ngui and sends the report to subscribers, if any. returns false if the
+/// report is to be sent over the pipe instead, such as once it outgrows a slot.
+fn sendLightningShm(self: *Daemon, shm: *comm.ShmSnapshot, rep: comm.Message.LightningReport) !bool {
+    shm.write(.{ .lightning_report = rep }) catch |err| {
+        logger.warn("lightning report shm: {!}; sending over the pipe", .{err});
+        return false;
+    };
+    // a delta over the pipe must not apply to this report: start over in full.
+    self.lnd_report_diff.reset();
+    if (self.subscribers) |*subs| {
+        subs.broadcast(.{ .lightning_report = rep });
+    }
+    try self.uiwrite(.lightning_report_shm);
+    return true;
+}
+
+const msg_lnd_starting: comm.Message = .{ .lightning_error = .{ .code = .not_ready } };
+const msg_lnd_locked: comm.Message = .{ .lightning_error = .{ .code = .locked } };
+const msg_lnd_uninitialized: comm.Message = .{ .lightning_error = .{ .code = .uninitialized } };
+
 /// evaluates any error returned from `sendLightningReport`.
-/// callers must hold self.mu.
+/// callers must not hold self.mu.
 fn processLndReportError(self: *Daemon, err: anyerror) !void {
-    const msg_starting: comm.Message = .{ .lightning_error = .{ .code = .not_ready } };
-    const msg_locked: comm.Message = .{ .lightning_error = .{ .code = .locked } };
-    const msg_uninitialized: comm.Message = .{ .lightning_error = .{ .code = .uninitialized } };
+    if (try self.processLndCallError(err)) {
+        return;
+    }
+    // active server indicates the lnd is ready to accept calls. so, the error
+    // must have been due to factors other than unoperational lnd state.
+    if (try self.checkLndWallet()) {
+        return err;
+    }
+}
+
+/// a lnd breaker probe: reports whether lnd serves calls again, telling ngui
+/// the lnd state otherwise, as processLndReportError does.
+/// callers must not hold self.mu.
+fn probeLnd(self: *Daemon) bool {
+    return self.checkLndWallet() catch |err| {
+        logger.info("lnd probe: {!}", .{err});
+        _ = self.processLndCallError(err) catch |err2| logger.err("lnd probe: {!}", .{err2});
+        return false;
+    };
+}
 
+/// handles the errors of any lnd call which tell the lnd state on their own,
+/// and reports whether err is one of them.
+fn processLndCallError(self: *Daemon, err: anyerror) !bool {
     switch (err) {
         error.ConnectionRefused,
         error.FileNotFound, // tls cert file missing, not re-generated by lnd yet
-        => return comm.write(self.allocator, self.uiwriter, msg_starting),
+        => {
+            try self.publish(msg_lnd_starting);
+            return true;
+        },
         // old tls cert, refused by our http client
         std.http.Client.ConnectTcpError.TlsInitializationFailed => {
-            try self.resetLndTlsUnguarded();
+            try self.resetLndTls();
             return error.LndReportRetryLater;
         },
-        else => {}, // continue
+        else => return false,
     }
+}
 
+/// asks lnd for its wallet state and reports whether it serves calls.
+/// ngui is told the state otherwise.
+fn checkLndWallet(self: *Daemon) !bool {
     // checking wallet status requires no macaroon auth
-    var client = try lndhttp.Client.init(.{ .allocator = self.allocator, .tlscert_path = Config.LND_TLSCERT_PATH });
-    defer client.deinit();
-    const status = client.call(.walletstatus, {}) catch |err2| {
+    const lnd = try self.lndc.acquire();
+    defer lnd.release();
+    const status = lnd.client.call(.walletstatus, {}) catch |err2| {
         switch (err2) {
             error.TlsInitializationFailed => {
-                try self.resetLndTlsUnguarded();
+                try self.resetLndTls();
                 return error.LndReportRetryLater;
             },
             else => return err2,
@@ -985,45 +4539,48 @@ fn processLndReportError(self: *Daemon, err: anyerror) !void {
     };
     defer status.deinit();
     logger.info("processLndReportError: lnd wallet state: {s}", .{@tagName(status.value.state)});
-    return switch (status.value.state) {
-        .NON_EXISTING => {
-            try comm.write(self.allocator, self.uiwriter, msg_uninitialized);
-            self.lnd_timer.reset();
-            self.want_lnd_report = false;
-        },
-        .LOCKED => {
-            try comm.write(self.allocator, self.uiwriter, msg_locked);
-            self.lnd_timer.reset();
+    switch (status.value.state) {
+        .NON_EXISTING, .LOCKED => |state| {
+            try self.publish(if (state == .LOCKED) msg_lnd_locked else msg_lnd_uninitialized);
+            self.mu.lock();
+            defer self.mu.unlock();
+            self.lnd_reported = self.clock.now();
             self.want_lnd_report = false;
         },
-        .UNLOCKED, .RPC_ACTIVE, .WAITING_TO_START => comm.write(self.allocator, self.uiwriter, msg_starting),
-        // active server indicates the lnd is ready to accept calls. so, the error
-        // must have been due to factors other than unoperational lnd state.
-        .SERVER_ACTIVE => err,
-    };
+        .UNLOCKED, .RPC_ACTIVE, .WAITING_TO_START => try self.publish(msg_lnd_starting),
+        .SERVER_ACTIVE => return true,
+    }
+    return false;
 }
 
-fn sendLightningPairingConn(self: *Daemon) !void {
-    const tor_rpc = try self.conf.lndConnectWaitMacaroonFile(self.allocator, .tor_rpc);
-    defer self.allocator.free(tor_rpc);
-    const tor_http = try self.conf.lndConnectWaitMacaroonFile(self.allocator, .tor_http);
-    defer self.allocator.free(tor_http);
+/// reqid is the lightning_get_ctrlconn request id, if any.
+/// the URLs are usually ready in self.lnd_pairing; see lndPairingHost.
+fn sendLightningPairingConn(self: *Daemon, reqid: u32) !void {
+    const urls = try self.lnd_pairing.get(self.allocator, self.lndPairingHost());
+    defer urls.deinit(self.allocator);
     const conn: comm.Message.LightningCtrlConn = &.{
-        .{ .url = tor_rpc, .typ = .lnd_rpc, .perm = .admin },
-        .{ .url = tor_http, .typ = .lnd_http, .perm = .admin },
+        .{ .url = urls.rpc, .typ = .lnd_rpc, .perm = .admin },
+        .{ .url = urls.http, .typ = .lnd_http, .perm = .admin },
     };
-    try comm.write(self.allocator, self.uiwriter, .{ .lightning_ctrlconn = conn });
+    try self.uireply(.{ .lightning_ctrlconn = conn }, reqid);
+}
+
+/// returns the host of lnd pairing URLs: its tor hidden service.
+fn lndPairingHost(self: *Daemon) []const u8 {
+    // TODO: return an error instead and propagate to the UI
+    return self.conf.snapshot().static.lnd_tor_hostname orelse "<no-tor-hostname>.onion";
 }
 
 /// a non-committal seed generator. can be called any number of times.
-fn generateWalletSeed(self: *Daemon) !void {
+/// reqid is the lightning_genseed request id, if any.
+fn generateWalletSeed(self: *Daemon, reqid: u32) !void {
     // genseed needs no auth
-    var client = try lndhttp.Client.init(.{ .allocator = self.allocator, .tlscert_path = Config.LND_TLSCERT_PATH });
-    defer client.deinit();
-    const res = try client.call(.genseed, {});
+    const lnd = try self.lndc.acquire();
+    defer lnd.release();
+    const res = try lnd.client.call(.genseed, {});
     defer res.deinit();
     const msg = comm.Message{ .lightning_genseed_result = res.value.cipher_seed_mnemonic };
-    return comm.write(self.allocator, self.uiwriter, msg);
+    return self.uireply(msg, reqid);
 }
 
 /// commit req.mnemonic as the new lightning wallet.
@@ -1050,7 +4607,10 @@ fn initWallet(self: *Daemon, req: comm.Message.LightningInitWallet) !void {
         self.mu.unlock();
     }
     self.state = .wallet_reset;
+    self.lnd_balance = null; // of the previous wallet
     self.mu.unlock();
+    // unlockwallet below generates new macaroons.
+    self.lnd_pairing.invalidate();
 
     // generate a new wallet unlock password; used together with seed committal below.
     var buf: [128]u8 = undefined;
@@ -1061,8 +4621,9 @@ fn initWallet(self: *Daemon, req: comm.Message.LightningInitWallet) !void {
 
     // commit the seed: initwallet needs no auth
     logger.info("initwallet: committing new seed and an unlock password", .{});
-    var client = try lndhttp.Client.init(.{ .allocator = self.allocator, .tlscert_path = Config.LND_TLSCERT_PATH });
-    defer client.deinit();
+    const lnd = try self.lndc.acquire();
+    defer lnd.release();
+    const client = lnd.client;
     const res = client.call(.initwallet, .{ .unlock_password = unlock_pwd, .mnemonic = req.mnemonic }) catch |err| {
         logger.err("lnd client initwallet: {!}", .{err});
         return Error.InitLndWallet;
@@ -1080,24 +4641,13 @@ fn initWallet(self: *Daemon, req: comm.Message.LightningInitWallet) !void {
     // restart the lnd service to pick up the newly generated config above.
     logger.info("initwallet: restarting lnd", .{});
     try self.services.stopWait(sys.Service.LND);
-    try self.services.start(sys.Service.LND);
-    var timer = try types.Timer.start();
-    while (timer.read() < 10 * time.ns_per_s) {
-        const status = client.call(.walletstatus, {}) catch |err| {
-            logger.info("initwallet: waiting lnd restart: {!}", .{err});
-            std.time.sleep(1 * time.ns_per_s);
-            continue;
-        };
-        defer status.deinit();
-        switch (status.value.state) {
-            .LOCKED => break,
-            else => |t| {
-                logger.info("initwallet: waiting lnd restart: {s}", .{@tagName(t)});
-                std.time.sleep(1 * time.ns_per_s);
-                continue;
-            },
-        }
-    }
+    // pooled connections are gone with the restart.
+    self.lndc.invalidate();
+    const probe = LndReadyProbe{ .lndc = &self.lndc, .want = .LOCKED };
+    self.services.startReady(sys.Service.LND, probe, .{ .clock = self.clock }) catch |err| {
+        // unlockwallet below reports the actual failure, if any.
+        logger.err("initwallet: waiting lnd restart: {!}", .{err});
+    };
 
     // unlock the wallet for the first time: required after initwallet.
     // it generates macaroon files and completes a wallet initialization.
@@ -1112,8 +4662,29 @@ fn initWallet(self: *Daemon, req: comm.Message.LightningInitWallet) !void {
     // no need to restart lnd: it'll pick up the new config on next boot.
     logger.info("initwallet: re-generating lnd config with auto-unlock", .{});
     try self.conf.genLndConfig(.{ .autounlock = true });
+    self.lnd_breaker.reset(); // report the new wallet right away
 }
 
+/// a sys.Service.waitReady probe: lnd is ready once it responds to walletstatus
+/// in the want state, or in any state if want is null.
+const LndReadyProbe = struct {
+    lndc: *LndClientCache,
+    want: ?std.meta.FieldType(lndhttp.WalletStatus, .state) = null,
+
+    pub fn ready(self: LndReadyProbe) bool {
+        const lnd = self.lndc.acquire() catch return false;
+        defer lnd.release();
+        const res = lnd.client.call(.walletstatus, {}) catch |err| {
+            logger.debug("waiting lnd: {!}", .{err});
+            return false;
+        };
+        defer res.deinit();
+        const want = self.want orelse return true;
+        logger.debug("waiting lnd: {s}", .{@tagName(res.value.state)});
+        return res.value.state == want;
+    }
+};
+
 /// factory-resets lnd node; wipes out the wallet.
 fn resetLndNode(self: *Daemon) !void {
     self.mu.lock();
@@ -1129,6 +4700,12 @@ fn resetLndNode(self: *Daemon) !void {
         // proceed only when in one of the following states
         .running, .standby => {},
     }
+    // not in the middle of a maintenance restart.
+    if (!self.jobs.tryAcquire(JobScheduler.Groups.initOne(.lnd))) {
+        self.mu.unlock();
+        return Error.MaintenanceActive;
+    }
+    defer self.jobs.release(JobScheduler.Groups.initOne(.lnd));
     const prevstate = self.state;
     defer {
         self.mu.lock();
@@ -1136,10 +4713,12 @@ fn resetLndNode(self: *Daemon) !void {
         self.mu.unlock();
     }
     self.state = .wallet_reset;
+    self.lnd_balance = null;
     self.mu.unlock();
 
     // 1. stop lnd service
     try self.services.stopWait(sys.Service.LND);
+    self.lnd_pairing.invalidate();
 
     // 2. delete all data directories
     try std.fs.cwd().deleteTree(Config.LND_DATA_DIR);
@@ -1154,57 +4733,119 @@ fn resetLndNode(self: *Daemon) !void {
     // to status requests.
     try self.conf.genLndConfig(.{ .autounlock = false });
 
-    // 4. start lnd service
-    try self.services.start(sys.Service.LND);
+    // 4. start lnd service; the new tls cert makes lndc re-create its client.
+    self.lndc.invalidate();
+    try self.services.startReady(sys.Service.LND, LndReadyProbe{ .lndc = &self.lndc }, .{ .clock = self.clock });
 }
 
 /// like resetLndNode but resets only tls certs, nothing else.
-/// callers must acquire self.mu.
-fn resetLndTlsUnguarded(self: *Daemon) !void {
-    if (self.lnd_tls_reset_count > 0) {
-        return error.LndTlsResetCount;
-    }
-    switch (self.state) {
-        .stopped, .poweroff, .wallet_reset => {
-            defer self.mu.unlock();
-            switch (self.state) {
-                .poweroff => return Error.PoweroffActive,
-                .wallet_reset => return Error.WalletResetActive,
-                else => return Error.InvalidState,
-            }
-        },
-        // proceed only when in one of the following states
-        .running, .standby => {},
+/// self.mu is held only while checking the daemon state, not during lnd restart.
+fn resetLndTls(self: *Daemon) !void {
+    {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.lnd_tls_reset_count > 0) {
+            return error.LndTlsResetCount;
+        }
+        switch (self.state) {
+            .poweroff => return Error.PoweroffActive,
+            .wallet_reset => return Error.WalletResetActive,
+            .stopped => return Error.InvalidState,
+            // proceed only when in one of the following states
+            .running, .standby => {},
+        }
+        if (!self.jobs.tryAcquire(JobScheduler.Groups.initOne(.lnd))) {
+            return Error.MaintenanceActive;
+        }
+        // only one reset attempt even if the procedure below fails.
+        self.lnd_tls_reset_count += 1;
     }
+    defer self.jobs.release(JobScheduler.Groups.initOne(.lnd));
     logger.info("resetting lnd tls certs", .{});
+    self.lnd_pairing.invalidate();
     try std.fs.cwd().deleteFile(Config.LND_TLSKEY_PATH);
     try std.fs.cwd().deleteFile(Config.LND_TLSCERT_PATH);
     try self.services.stopWait(sys.Service.LND);
-    try self.services.start(sys.Service.LND);
-    self.lnd_tls_reset_count += 1;
+    self.lndc.invalidate();
+    try self.services.startReady(sys.Service.LND, LndReadyProbe{ .lndc = &self.lndc }, .{ .clock = self.clock });
 }
 
+/// queues a job switching to the chan and running an update. a job queued
+/// earlier and not yet started switches to the latest chan.
 fn switchSysupdates(self: *Daemon, chan: comm.Message.SysupdatesChan) !void {
-    const th = try std.Thread.spawn(.{}, switchSysupdatesThread, .{ self, chan });
-    th.detach();
+    self.mu.lock();
+    self.sysupdates_chan = chan;
+    self.mu.unlock();
+    _ = try self.jobs.submit(.{
+        .name = "system update",
+        .priority = .high,
+        .groups = JobScheduler.Groups.initOne(.sysupdates),
+        .ctx = self,
+        .runFn = switchSysupdatesJob,
+    });
 }
 
-fn switchSysupdatesThread(self: *Daemon, chan: comm.Message.SysupdatesChan) void {
+fn switchSysupdatesJob(ctx: *anyopaque, _: JobScheduler.Progress) !void {
+    const self: *Daemon = @ptrCast(@alignCast(ctx));
+    self.mu.lock();
+    const chan = self.sysupdates_chan;
+    self.mu.unlock();
     const conf_chan: Config.SysupdatesChannel = switch (chan) {
         .stable => .master,
         .edge => .dev,
     };
-    self.conf.switchSysupdates(conf_chan, .{ .run = true }) catch |err| {
+    // the thread exists only to run the update: keep it and the update script
+    // from starving bitcoind and lnd of cpu and disk.
+    sys.setIdlePriority() catch |err| logger.warn("sysupdates: setIdlePriority: {!}", .{err});
+    var progress = SysupdatesProgress{ .daemon = self };
+    const output = Config.SysupdatesOutput{ .ctx = &progress, .lineFn = SysupdatesProgress.line };
+    const ok = if (self.conf.switchSysupdates(conf_chan, .{ .run = true, .output = output })) true else |err| blk: {
         logger.err("config.switchSysupdates: {any}", .{err});
-        // TODO: send err back to ngui
+        break :blk false;
     };
+    progress.send(.{ .done = true, .ok = ok, .lines = progress.lines, .last = progress.last.val() });
     // schedule settings report for ngui
     self.mu.lock();
-    defer self.mu.unlock();
     self.want_settings = true;
+    self.kickMain();
+    self.mu.unlock();
+    if (!ok) {
+        return error.SysupdatesFailed;
+    }
 }
 
-/// reconfigures hostname and lnd alias in a detached thread.
+/// forwards the output of a running system update to ngui in
+/// comm.Message.SysupdatesProgress, throttled to a report per interval.
+const SysupdatesProgress = struct {
+    daemon: *Daemon,
+    lines: u32 = 0,
+    last: types.BufTrimString(128) = .{},
+    sent_at: i64 = 0, // ms timestamp
+
+    const interval = 2 * time.ms_per_s;
+
+    fn line(ctx: *anyopaque, s: []const u8) void {
+        const self: *SysupdatesProgress = @ptrCast(@alignCast(ctx));
+        logger.debug("sysupdates: {s}", .{s});
+        self.lines +|= 1;
+        self.last.set(s);
+        const now = time.milliTimestamp();
+        if (now - self.sent_at < interval) {
+            return;
+        }
+        self.sent_at = now;
+        self.send(.{ .done = false, .ok = true, .lines = self.lines, .last = self.last.val() });
+    }
+
+    fn send(self: *SysupdatesProgress, rep: comm.Message.SysupdatesProgress) void {
+        self.daemon.uiwrite(.{ .sysupdates_progress = rep }) catch |err| logger.err("sysupdates progress: {!}", .{err});
+    }
+};
+
+/// the worker task name of setNodename.
+const nodename_task = "set nodename";
+
+/// reconfigures hostname and lnd alias in a worker task.
 /// the procedure is not atomic and may leave names in inconsistent state.
 ///
 /// `newname` must not exceed max hostname length on the running system.
@@ -1214,24 +4855,39 @@ fn switchSysupdatesThread(self: *Daemon, chan: comm.Message.SysupdatesChan) void
 ///
 /// required `newname` lifetime is only until the function returns.
 fn setNodename(self: *Daemon, newname: []const u8) !void {
-    // newly alloc'ed namesan is freed in the detached thread.
-    const namesan = try allocSanitizeNodename(self.allocator, newname);
-    const th = try std.Thread.spawn(.{}, setNodenameThread, .{ self, namesan });
-    th.detach();
-}
-
-/// owns `newname` and frees all resources using `self.allocator`.
-fn setNodenameThread(self: *Daemon, newname: []const u8) void {
-    defer self.allocator.free(newname);
-    self.setNodenameInternal(newname) catch |err| {
-        logger.err("setNodenameIternal: {!}", .{err});
-        // TODO: send err back to ngui
-    };
+    // newly alloc'ed task and namesan are freed in the task.
+    const task = try self.allocator.create(NodenameTask);
+    errdefer self.allocator.destroy(task);
+    task.* = .{ .daemon = self, .name = try allocSanitizeNodename(self.allocator, newname) };
+    errdefer self.allocator.free(task.name);
+    try self.workers.submit(.{ .name = nodename_task, .ctx = task, .runFn = NodenameTask.run });
 }
 
+const NodenameTask = struct {
+    daemon: *Daemon,
+    name: []const u8, // sanitized; owned
+
+    /// frees all resources using daemon allocator.
+    fn run(ctx: *anyopaque, tok: WorkerPool.Token) !void {
+        const self: *NodenameTask = @ptrCast(@alignCast(ctx));
+        const daemon = self.daemon;
+        defer {
+            daemon.allocator.free(self.name);
+            daemon.allocator.destroy(self);
+        }
+        if (tok.cancelled()) {
+            return error.Cancelled;
+        }
+        try daemon.setNodenameInternal(self.name);
+    }
+};
+
 /// assumes `newname` is sanitized for lnd alias.
 /// the args must be alive until the function return.
 fn setNodenameInternal(self: *Daemon, newname: []const u8) !void {
+    // waits for a maintenance restart, which may also mutate lnd config.
+    try self.jobs.acquire(JobScheduler.Groups.initOne(.lnd));
+    defer self.jobs.release(JobScheduler.Groups.initOne(.lnd));
     // change lnd alias
     var mut = try self.conf.beginMutateLndConf(.{});
     defer {
@@ -1253,6 +4909,7 @@ fn setNodenameInternal(self: *Daemon, newname: []const u8) !void {
     // notify the UI
     self.mu.lock();
     self.want_settings = true;
+    self.kickMain();
     self.mu.unlock();
 }
 
@@ -1283,6 +4940,43 @@ fn allocSanitizeNodename(allocator: std.mem.Allocator, name: []const u8) ![]cons
     return allocator.dupe(u8, trimmed);
 }
 
+test "daemon: roundRate" {
+    const t = std.testing;
+    try t.expectEqual(@as(u64, 0), roundRate(0.4));
+    try t.expectEqual(@as(u64, 7), roundRate(7.2));
+    try t.expectEqual(@as(u64, 350), roundRate(347));
+    try t.expectEqual(@as(u64, 12000), roundRate(12345));
+    try t.expectEqual(@as(u64, 1_300_000), roundRate(1_254_000));
+}
+
+test "daemon: pollInterval" {
+    const t = std.testing;
+    const min = time.ns_per_min;
+
+    try t.expectEqual(@as(u64, 1 * min), pollInterval(1 * min, .normal));
+    try t.expectEqual(@as(u64, sync_report_interval), pollInterval(1 * min, .syncing));
+    try t.expectEqual(@as(u64, 1 * time.ns_per_s), pollInterval(1 * time.ns_per_s, .syncing));
+    try t.expectEqual(@as(u64, standby_report_interval), pollInterval(1 * min, .standby));
+    try t.expectEqual(@as(u64, 60 * min), pollInterval(60 * min, .standby));
+
+    try t.expectEqual(@as(u64, warmup_poll_max), warmupPollInterval(null));
+    try t.expectEqual(@as(u64, warmup_poll_max / 2), warmupPollInterval(50));
+    try t.expectEqual(@as(u64, warmup_poll_min), warmupPollInterval(95));
+    try t.expectEqual(@as(u64, warmup_poll_min), warmupPollInterval(200));
+}
+
+test "daemon: bitcoindFlushDue" {
+    const t = std.testing;
+    const h = time.s_per_hour;
+    const last = BitcoindFlush{ .blocks = 800_000, .time = 0 };
+
+    try t.expect(!bitcoindFlushDue(last, 800_000, 24 * h, 450, 6 * h)); // no new blocks
+    try t.expect(!bitcoindFlushDue(last, 800_010, 1 * h, 450, 6 * h));
+    try t.expect(bitcoindFlushDue(last, 800_010, 6 * h, 450, 6 * h));
+    try t.expect(bitcoindFlushDue(last, 800_200, 1 * h, 450, 6 * h)); // a quarter of dbcache
+    try t.expect(!bitcoindFlushDue(last, 800_200, 1 * h, 1024, 6 * h));
+}
+
 test "daemon: start-stop" {
     const t = std.testing;
 
@@ -1305,7 +4999,12 @@ test "daemon: start-stop" {
     try t.expect(daemon.state == .running);
     try t.expect(daemon.main_thread != null);
     try t.expect(daemon.comm_thread != null);
-    try t.expect(daemon.poweroff_thread == null);
+    try t.expect(daemon.onchain_thread != null);
+    try t.expect(daemon.lnd_thread != null);
+    try t.expect(daemon.zmq_thread != null);
+    try t.expect(daemon.tor_thread != null);
+    for (daemon.lnd_stream_threads) |th| try t.expect(th != null);
+    try t.expectEqual(@as(usize, worker_count), daemon.workers.nworkers);
     try t.expect(daemon.wpa_ctrl.opened);
     try t.expect(daemon.wpa_ctrl.attached);
 
@@ -1315,7 +5014,12 @@ test "daemon: start-stop" {
     try t.expect(daemon.state == .stopped);
     try t.expect(daemon.main_thread == null);
     try t.expect(daemon.comm_thread == null);
-    try t.expect(daemon.poweroff_thread == null);
+    try t.expect(daemon.onchain_thread == null);
+    try t.expect(daemon.lnd_thread == null);
+    try t.expect(daemon.zmq_thread == null);
+    try t.expect(daemon.tor_thread == null);
+    for (daemon.lnd_stream_threads) |th| try t.expect(th == null);
+    try t.expectEqual(@as(usize, 0), daemon.workers.nworkers);
     try t.expect(!daemon.wpa_ctrl.attached);
     try t.expect(daemon.wpa_ctrl.opened);
 
@@ -1365,7 +5069,7 @@ test "daemon: start-poweroff" {
     gui_stdout.close();
     daemon.wait();
     try t.expect(daemon.state == .stopped);
-    try t.expect(daemon.poweroff_thread == null);
+    try t.expectEqual(@as(usize, 0), daemon.workers.nworkers);
     for (daemon.services.list) |*sv| {
         try t.expect(sv.stop_proc.spawned);
         try t.expect(sv.stop_proc.waited);
@@ -1429,7 +5133,7 @@ test "daemon: screen unlock" {
     daemon.want_lnd_report = false;
 
     try daemon.start();
-    try t.expect(daemon.screenstate == .locked);
+    try t.expect(daemon.screenstate.load(.monotonic) == .locked);
     try comm.write(arena, gui_stdout.writer(), .{ .unlock_screen = "000" });
     try comm.write(arena, gui_stdout.writer(), .{ .unlock_screen = correct_pin });
 
@@ -1445,27 +5149,107 @@ test "daemon: screen unlock" {
     daemon.stop();
     gui_stdout.close();
     daemon.wait();
-    try t.expect(daemon.screenstate == .unlocked);
+    try t.expect(daemon.screenstate.load(.monotonic) == .unlocked);
+}
+
+test "daemon: reports from slow mock servers" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var arena_alloc = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_alloc.deinit();
+    const arena = arena_alloc.allocator();
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    const cookiepath = try tmp.join(&.{"cookie"});
+    try tmp.dir.writeFile(cookiepath, "__cookie__:secret");
+    const macpath = try tmp.join(&.{"readonly.macaroon"});
+    try tmp.dir.writeFile(macpath, "\x02\x01");
+
+    const btc = try tt.MockRpcServer.start(t.allocator, .bitcoind);
+    defer btc.stop();
+    const lnd = try tt.MockRpcServer.start(t.allocator, .lnd);
+    defer lnd.stop();
+    btc.knobs.latency_ms.store(20, .monotonic);
+    lnd.knobs.latency_ms.store(20, .monotonic);
+
+    const gui_stdin = try types.IoPipe.create();
+    const gui_stdout = try types.IoPipe.create();
+    const gui_reader = gui_stdin.reader();
+    var daemon = try Daemon.init(.{
+        .allocator = arena,
+        .conf = try dummyTestConfig(),
+        .uir = gui_stdout.reader(),
+        .uiw = gui_stdin.writer(),
+        .wpa = "/dev/null",
+    });
+    defer {
+        daemon.deinit();
+        daemon.conf.deinit();
+        gui_stdin.close();
+        gui_stdout.close();
+    }
+    daemon.bitcoind.cookiepath = cookiepath;
+    daemon.bitcoind.port = btc.port();
+    daemon.lndc.opt.hostname = "127.0.0.1";
+    daemon.lndc.opt.port = lnd.port();
+    daemon.lndc.opt.macaroon_ro_path = macpath;
+    daemon.lndc.opt.plain_http = true;
+
+    try daemon.sendOnchainReport(.{ .balance = true });
+    {
+        const msg = try comm.read(arena, gui_reader);
+        const rep = msg.value.onchain_report;
+        try t.expectEqual(@as(u64, 800000), rep.blocks);
+        try t.expectEqual(@as(u16, 5), rep.conn_in);
+        try t.expectEqual(@as(i64, 800000), rep.balance.?.total);
+        try t.expect(rep.net == null); // a single traffic sample
+    }
+    try daemon.sendOnchainReport(.{ .balance = true });
+    {
+        const msg = try comm.read(arena, gui_reader);
+        const net = msg.value.onchain_report.net.?;
+        // mock counters are a function of the block height.
+        try t.expectEqual(@as(u64, 0), net.recv_bytes_per_sec);
+        try t.expectEqual(@as(u64, 0), net.sent_bytes_per_sec);
+    }
+    // nothing changed: held back.
+    try daemon.sendOnchainReport(.{ .balance = true });
+    try t.expectEqual(@as(u64, 1), daemon.metrics.reports.getPtr(.onchain).unchanged.load(.monotonic));
+
+    try daemon.sendLightningReport();
+    {
+        const msg = try comm.read(arena, gui_reader);
+        try t.expectEqual(@as(usize, 10), msg.value.lightning_report.channels.len);
+    }
+    // a new block shows up in a summary-only delta.
+    lnd.knobs.height.store(800001, .monotonic);
+    try daemon.sendLightningReport();
+    {
+        const msg = try comm.read(arena, gui_reader);
+        const delta = msg.value.lightning_report_delta;
+        try t.expectEqual(@as(u32, 800001), delta.summary.?.height);
+        try t.expectEqual(@as(usize, 0), delta.upsert.len);
+    }
+
+    lnd.knobs.fault.store(.http_500, .monotonic);
+    lnd.knobs.fail_every.store(1, .monotonic);
+    try t.expectError(error.LndHttpBadStatusCode, daemon.sendLightningReport());
 }
 
 fn dummyTestConfig() !Config {
     const talloc = std.testing.allocator;
     const arena = try talloc.create(std.heap.ArenaAllocator);
     arena.* = std.heap.ArenaAllocator.init(talloc);
-    return Config{
-        .arena = arena,
-        .confpath = "/dummy.conf",
-        .data = .{
-            .slock = null,
-            .syschannel = .master,
-            .syscronscript = "",
-            .sysrunscript = "",
-        },
-        .static = .{
-            .hostname = "testhost",
-            .lnd_user = null,
-            .lnd_tor_hostname = null,
-            .bitcoind_rpc_pass = null,
-        },
-    };
+    return Config.initWith(arena, "/dummy.conf", .{
+        .slock = null,
+        .syschannel = .master,
+        .syscronscript = "",
+        .sysrunscript = "",
+    }, .{
+        .hostname = "testhost",
+        .lnd_user = null,
+        .lnd_tor_hostname = null,
+        .bitcoind_rpc_pass = null,
+    });
 }
@@ -0,0 +1,238 @@
+//! per-channel aggregates of lnd forwarding history, for routing analytics
+//! which never call lnd: lnd is asked only for events added since the last
+//! sync, starting at a persisted index offset into its forwarding log.
+//!
+//! each channel record holds lifetime totals and a ring of daily slots, so
+//! that adding an event updates the rolling window in place. like History
+//! buckets, a slot holds its day number: one from a previous lap around the
+//! ring is recognized as stale and reset on first use.
+//!
+//! the whole file is rewritten atomically on save, which keeps the cursor
+//! consistent with the aggregates: events are never counted twice.
+//! accessed only from the lnd thread.
+
+const std = @import("std");
+const time = std.time;
+
+const logger = std.log.scoped(.forwards);
+
+/// number of daily slots per channel; longer than the longest window queried.
+pub const ndays = 32;
+
+allocator: std.mem.Allocator,
+path: []const u8,
+/// index offset into lnd forwarding log of the next event to fetch.
+cursor: u32 = 0,
+records: std.ArrayListUnmanaged(Record) = .{},
+/// channel id to an index into records.
+index: std.AutoHashMapUnmanaged(u64, usize) = .{},
+
+const Forwards = @This();
+
+/// the file is re-initialized if its header doesn't match.
+const Header = extern struct {
+    magic: [4]u8 = "ndfw".*,
+    version: u32 = 1,
+    ndays: u32 = ndays,
+    record_size: u32 = @sizeOf(Record),
+    cursor: u32 = 0,
+    count: u32 = 0, // number of records following the header
+};
+
+const Record = extern struct {
+    chan_id: u64,
+    fwd_in: u64, // number of forwards received through the channel
+    fwd_out: u64, // number of forwards sent out through the channel
+    amt_in_msat: u64,
+    amt_out_msat: u64,
+    fee_msat: u64, // earned as the outgoing channel
+    days: [ndays]Day,
+};
+
+const Day = extern struct {
+    day: i64, // days since unix epoch; 0 if never used
+    fwd_out: u64,
+    fee_msat: u64,
+};
+
+/// a forwarding event, as reported by lnd fwdinghistory.
+pub const Event = struct {
+    timestamp_ns: u64,
+    chan_in: u64,
+    chan_out: u64,
+    amt_in_msat: u64,
+    amt_out_msat: u64,
+    fee_msat: u64,
+};
+
+/// channel aggregates of a window, or the lifetime totals.
+pub const Stats = struct {
+    fwd_out: u64 = 0,
+    fee_msat: u64 = 0,
+};
+
+/// reads the file at path, if any. a missing or unknown format file starts
+/// an empty set at cursor 0, which re-syncs the whole lnd history.
+/// path is dup'ed; callers must deinit when done.
+pub fn load(allocator: std.mem.Allocator, path: []const u8) !Forwards {
+    var self = Forwards{ .allocator = allocator, .path = try allocator.dupe(u8, path) };
+    errdefer self.deinit();
+    const data = std.fs.cwd().readFileAlloc(allocator, path, 64 << 20) catch |err| switch (err) {
+        error.FileNotFound => return self,
+        else => return err,
+    };
+    defer allocator.free(data);
+    if (data.len < @sizeOf(Header)) {
+        logger.warn("{s}: unknown format; starting a new forwards index", .{path});
+        return self;
+    }
+    const hdr = std.mem.bytesToValue(Header, data[0..@sizeOf(Header)]);
+    var want = Header{};
+    want.cursor = hdr.cursor;
+    want.count = hdr.count;
+    if (!std.meta.eql(hdr, want) or data.len != @sizeOf(Header) + @as(usize, hdr.count) * @sizeOf(Record)) {
+        logger.warn("{s}: unknown format; starting a new forwards index", .{path});
+        return self;
+    }
+    try self.records.ensureTotalCapacity(allocator, hdr.count);
+    try self.index.ensureTotalCapacity(allocator, hdr.count);
+    var off: usize = @sizeOf(Header);
+    for (0..hdr.count) |i| {
+        const rec = std.mem.bytesToValue(Record, data[off..][0..@sizeOf(Record)]);
+        self.records.appendAssumeCapacity(rec);
+        self.index.putAssumeCapacity(rec.chan_id, i);
+        off += @sizeOf(Record);
+    }
+    self.cursor = hdr.cursor;
+    return self;
+}
+
+pub fn deinit(self: *Forwards) void {
+    self.records.deinit(self.allocator);
+    self.index.deinit(self.allocator);
+    self.allocator.free(self.path);
+}
+
+/// writes out all records and the cursor, including parent directories.
+pub fn save(self: *Forwards) !void {
+    if (std.fs.path.dirname(self.path)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+    const file = try std.io.BufferedAtomicFile.create(self.allocator, std.fs.cwd(), self.path, .{ .mode = 0o644 });
+    defer file.destroy();
+    const w = file.writer();
+    try w.writeAll(std.mem.asBytes(&Header{ .cursor = self.cursor, .count = @intCast(self.records.items.len) }));
+    try w.writeAll(std.mem.sliceAsBytes(self.records.items));
+    try file.finish();
+}
+
+/// adds the event to the aggregates of both channels. the fee is earned by
+/// the outgoing channel. the caller advances the cursor.
+pub fn add(self: *Forwards, ev: Event) !void {
+    const in = try self.record(ev.chan_in);
+    in.fwd_in += 1;
+    in.amt_in_msat +|= ev.amt_in_msat;
+    // chan_in record pointer is invalidated by a new record.
+    const out = try self.record(ev.chan_out);
+    out.fwd_out += 1;
+    out.amt_out_msat +|= ev.amt_out_msat;
+    out.fee_msat +|= ev.fee_msat;
+    const day: i64 = @intCast(ev.timestamp_ns / time.ns_per_day);
+    const slot = &out.days[@intCast(@mod(day, ndays))];
+    if (slot.day < day) {
+        slot.* = .{ .day = day, .fwd_out = 0, .fee_msat = 0 };
+    } else if (slot.day > day) {
+        return; // older than the ring; counted only in the totals
+    }
+    slot.fwd_out += 1;
+    slot.fee_msat +|= ev.fee_msat;
+}
+
+fn record(self: *Forwards, chan_id: u64) !*Record {
+    const res = try self.index.getOrPut(self.allocator, chan_id);
+    if (!res.found_existing) {
+        errdefer self.index.removeByPtr(res.key_ptr);
+        try self.records.append(self.allocator, std.mem.zeroInit(Record, .{ .chan_id = chan_id }));
+        res.value_ptr.* = self.records.items.len - 1;
+    }
+    return &self.records.items[res.value_ptr.*];
+}
+
+/// returns aggregates of the channel as the outgoing one over the last
+/// window days, including the current day at now, unix time in seconds.
+/// a null window returns the lifetime totals.
+pub fn stats(self: Forwards, chan_id: u64, now: i64, window: ?u32) Stats {
+    const i = self.index.get(chan_id) orelse return .{};
+    const rec = self.records.items[i];
+    const n = window orelse return .{ .fwd_out = rec.fwd_out, .fee_msat = rec.fee_msat };
+    std.debug.assert(n <= ndays);
+    const today = @divFloor(now, time.s_per_day);
+    var res = Stats{};
+    for (rec.days) |d| {
+        if (d.day > today - n and d.day <= today) {
+            res.fwd_out += d.fwd_out;
+            res.fee_msat += d.fee_msat;
+        }
+    }
+    return res;
+}
+
+test "forwards add and stats" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "sub", "forwards.bin" });
+    defer t.allocator.free(path);
+
+    const day0: i64 = 19_000;
+    const ns_at = struct {
+        fn f(day: i64) u64 {
+            return @as(u64, @intCast(day)) * time.ns_per_day + time.ns_per_hour;
+        }
+    }.f;
+    const now = (day0 + 40) * time.s_per_day;
+    {
+        var fw = try load(t.allocator, path);
+        defer fw.deinit();
+        try t.expectEqual(@as(u32, 0), fw.cursor);
+        // the first is reset in its slot by the second, a lap around the ring later.
+        try fw.add(.{ .timestamp_ns = ns_at(day0), .chan_in = 1, .chan_out = 2, .amt_in_msat = 1010, .amt_out_msat = 1000, .fee_msat = 10 });
+        try fw.add(.{ .timestamp_ns = ns_at(day0 + 32), .chan_in = 1, .chan_out = 2, .amt_in_msat = 2020, .amt_out_msat = 2000, .fee_msat = 20 });
+        try fw.add(.{ .timestamp_ns = ns_at(day0 + 40), .chan_in = 2, .chan_out = 3, .amt_in_msat = 3030, .amt_out_msat = 3000, .fee_msat = 30 });
+        fw.cursor = 3;
+        try fw.save();
+    }
+
+    // reload: the cursor and aggregates persist.
+    var fw = try load(t.allocator, path);
+    defer fw.deinit();
+    try t.expectEqual(@as(u32, 3), fw.cursor);
+    try t.expectEqual(@as(usize, 3), fw.records.items.len);
+    try t.expectEqual(Stats{ .fwd_out = 2, .fee_msat = 30 }, fw.stats(2, now, null));
+    try t.expectEqual(Stats{ .fwd_out = 1, .fee_msat = 20 }, fw.stats(2, now, 30));
+    try t.expectEqual(Stats{}, fw.stats(2, now, 5));
+    try t.expectEqual(Stats{ .fwd_out = 1, .fee_msat = 30 }, fw.stats(3, now, 1));
+    try t.expectEqual(Stats{}, fw.stats(1, now, 30));
+    try t.expectEqual(Stats{}, fw.stats(42, now, null));
+    const rec1 = fw.records.items[fw.index.get(1).?];
+    try t.expectEqual(@as(u64, 2), rec1.fwd_in);
+    try t.expectEqual(@as(u64, 3030), rec1.amt_in_msat);
+}
+
+test "forwards reset unknown format" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile("forwards.bin", "garbage and more garbage");
+    const path = try tmp.dir.realpathAlloc(t.allocator, "forwards.bin");
+    defer t.allocator.free(path);
+
+    var fw = try load(t.allocator, path);
+    defer fw.deinit();
+    try t.expectEqual(@as(u32, 0), fw.cursor);
+    try t.expectEqual(@as(usize, 0), fw.records.items.len);
+}
@@ -0,0 +1,284 @@
+//! on-device time series of mempool, fees and balances, recorded from nd
+//! reports for trend charts in ngui.
+//!
+//! samples are accumulated into buckets of three resolutions, minute, hour
+//! and day, each a fixed size ring of slots in a file mapped into memory.
+//! recording a sample adds it to the current slot of every resolution, so the
+//! rollups are always up to date and no pass over the history is ever needed.
+//! a slot is addressed by its bucket number modulo the ring length and holds
+//! the bucket start time: a slot from a previous lap around the ring, or from
+//! before a long downtime, is recognized as stale and reset on first use.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+const posix = std.posix;
+const time = std.time;
+
+const comm = @import("../comm.zig");
+
+const logger = std.log.scoped(.history);
+
+pub const Kind = comm.Message.HistoryReport.Kind;
+const Span = comm.Message.HistoryReport.Span;
+const npoints = comm.Message.HistoryReport.points;
+const nkinds = @typeInfo(Kind).Enum.fields.len;
+
+/// a set of values recorded at the same time. null values are not recorded.
+pub const Sample = std.enums.EnumFieldStruct(Kind, ?i64, @as(?i64, null));
+
+/// file mapping, header followed by the slots of all resolutions in levels order.
+mem: []align(std.mem.page_size) u8,
+mu: std.Thread.Mutex = .{},
+/// the minute bucket of the last record call, used to report minute rollovers.
+last_minute: i64 = 0,
+
+const History = @This();
+
+const Level = struct {
+    step: u32, // bucket duration in seconds
+    len: u32, // number of slots in the ring
+};
+
+const levels = [_]Level{
+    .{ .step = time.s_per_min, .len = 24 * 60 }, // a day
+    .{ .step = time.s_per_hour, .len = 60 * 24 }, // 60 days
+    .{ .step = time.s_per_day, .len = 2 * 366 }, // 2 years
+};
+
+/// report ranges: the level they are computed from and the number of its
+/// buckets per point. each range spans npoints such points.
+const ranges = [_]struct { span: Span, level: usize, per_point: u32 }{
+    .{ .span = .hour, .level = 0, .per_point = 1 },
+    .{ .span = .day, .level = 0, .per_point = 24 },
+    .{ .span = .month, .level = 1, .per_point = 12 },
+    .{ .span = .year, .level = 2, .per_point = 6 },
+};
+
+comptime {
+    for (ranges) |r| {
+        std.debug.assert(r.per_point * npoints <= levels[r.level].len);
+    }
+}
+
+const Slot = extern struct {
+    start: i64, // unix time of the bucket start; 0 if never used
+    count: [nkinds]u32,
+    sum: [nkinds]i64,
+
+    fn reset(self: *Slot, start: i64) void {
+        self.* = .{ .start = start, .count = .{0} ** nkinds, .sum = .{0} ** nkinds };
+    }
+};
+
+/// the file is re-initialized if its header doesn't match.
+const Header = extern struct {
+    magic: [4]u8 = "ndts".*,
+    version: u32 = 1,
+    nkinds: u32 = nkinds,
+    slot_size: u32 = @sizeOf(Slot),
+    lens: [levels.len]u32 = blk: {
+        var lens: [levels.len]u32 = undefined;
+        for (levels, &lens) |lv, *n| n.* = lv.len;
+        break :blk lens;
+    },
+};
+
+const slots_offset = std.mem.alignForward(usize, @sizeOf(Header), @alignOf(Slot));
+const file_size = blk: {
+    var n = slots_offset;
+    for (levels) |lv| n += lv.len * @sizeOf(Slot);
+    break :blk n;
+};
+
+/// opens or creates the history file at path, including its parent directories,
+/// and maps it into memory. callers must close when done.
+pub fn open(path: []const u8) !History {
+    if (std.fs.path.dirname(path)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+    const file = try std.fs.cwd().createFile(path, .{ .read = true, .truncate = false });
+    // the mapping stays valid after the file is closed.
+    defer file.close();
+    const stat = try file.stat();
+    if (stat.size != file_size) {
+        try file.setEndPos(0);
+        try file.setEndPos(file_size);
+    }
+    const mem = try posix.mmap(null, file_size, posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, file.handle, 0);
+    const hdr: *Header = @ptrCast(mem.ptr);
+    if (!std.meta.eql(hdr.*, Header{})) {
+        if (stat.size != 0) {
+            logger.warn("{s}: unknown format; starting a new history", .{path});
+        }
+        @memset(mem, 0);
+        hdr.* = .{};
+    }
+    return .{ .mem = mem };
+}
+
+/// unmaps the file; changes are written back by the kernel.
+pub fn close(self: *History) void {
+    posix.munmap(self.mem);
+}
+
+fn slots(self: *History, level: usize) []Slot {
+    var off: usize = slots_offset;
+    for (levels[0..level]) |lv| off += lv.len * @sizeOf(Slot);
+    const bytes = self.mem[off..][0 .. levels[level].len * @sizeOf(Slot)];
+    return @alignCast(std.mem.bytesAsSlice(Slot, bytes));
+}
+
+/// returns the slot of the bucket number b, or null if it holds another one.
+fn bucketSlot(self: *History, level: usize, b: i64) ?*Slot {
+    const lv = levels[level];
+    const slot = &self.slots(level)[@intCast(@mod(b, @as(i64, lv.len)))];
+    return if (slot.start == b * @as(i64, lv.step)) slot else null;
+}
+
+/// adds sample values recorded at now, unix time in seconds, to the current
+/// bucket of all resolutions. returns true if this starts a new minute since
+/// the previous call, which is a good time to send a report.
+pub fn record(self: *History, now: i64, sample: Sample) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (levels, 0..) |lv, i| {
+        const b = @divFloor(now, @as(i64, lv.step));
+        const slot = self.bucketSlot(i, b) orelse s: {
+            const s = &self.slots(i)[@intCast(@mod(b, @as(i64, lv.len)))];
+            s.reset(b * @as(i64, lv.step));
+            break :s s;
+        };
+        inline for (comptime std.enums.values(Kind)) |k| {
+            if (@field(sample, @tagName(k))) |v| {
+                slot.count[@intFromEnum(k)] += 1;
+                slot.sum[@intFromEnum(k)] +|= v;
+            }
+        }
+    }
+    const minute = @divFloor(now, time.s_per_min);
+    defer self.last_minute = minute;
+    return minute != self.last_minute;
+}
+
+/// builds a report of all ranges and kinds as of now, unix time in seconds.
+/// a point is the average of all samples in its buckets; the last one is
+/// the current, still accumulating bucket. the report is allocated with
+/// the allocator, an arena is best.
+pub fn report(self: *History, allocator: std.mem.Allocator, now: i64) !comm.Message.HistoryReport {
+    const out = try allocator.alloc(comm.Message.HistoryReport.Range, ranges.len);
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (ranges, out) |r, *range| {
+        const lv = levels[r.level];
+        const step = lv.step * r.per_point;
+        // the last point ends with the current bucket.
+        const per_point: i64 = r.per_point;
+        const end_bucket = @divFloor(now, @as(i64, lv.step)) + 1;
+        const first = end_bucket - npoints * per_point;
+        const series = try allocator.alloc(comm.Message.HistoryReport.Series, nkinds);
+        var values: [nkinds][]?i64 = undefined;
+        for (series, &values, 0..) |*ser, *vals, k| {
+            vals.* = try allocator.alloc(?i64, npoints);
+            ser.* = .{ .kind = @enumFromInt(k), .values = vals.* };
+        }
+        for (0..npoints) |p| {
+            var count = [_]u64{0} ** nkinds;
+            var sum = [_]i128{0} ** nkinds;
+            const pstart = first + @as(i64, @intCast(p)) * per_point;
+            var b = pstart;
+            while (b < pstart + per_point) : (b += 1) {
+                const slot = self.bucketSlot(r.level, b) orelse continue;
+                for (0..nkinds) |k| {
+                    count[k] += slot.count[k];
+                    sum[k] += slot.sum[k];
+                }
+            }
+            for (&values, count, sum) |vals, n, total| {
+                vals[p] = if (n == 0) null else @intCast(@divTrunc(total, @as(i128, n)));
+            }
+        }
+        range.* = .{
+            .span = r.span,
+            .step = step,
+            .end = @intCast(end_bucket * @as(i64, lv.step)),
+            .series = series,
+        };
+    }
+    return .{ .ranges = out };
+}
+
+test "record and report" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const path = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(path);
+    const fpath = try std.fs.path.join(t.allocator, &.{ path, "sub", "history.bin" });
+    defer t.allocator.free(fpath);
+
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const t0: i64 = 1_700_000_000 - @mod(1_700_000_000, time.s_per_day);
+    {
+        var h = try open(fpath);
+        defer h.close();
+        try t.expect(h.record(t0, .{ .mempool_txcount = 10, .ln_local = 100 }));
+        try t.expect(!h.record(t0 + 30, .{ .mempool_txcount = 20 }));
+        try t.expect(h.record(t0 + 60, .{ .mempool_txcount = 40 }));
+    }
+
+    // reopen: samples persist.
+    var h = try open(fpath);
+    defer h.close();
+    const rep = try h.report(arena, t0 + 60);
+    try t.expectEqual(ranges.len, rep.ranges.len);
+
+    const hour = rep.ranges[0];
+    try t.expectEqual(.hour, hour.span);
+    try t.expectEqual(@as(u32, 60), hour.step);
+    try t.expectEqual(@as(u64, @intCast(t0 + 120)), hour.end);
+    const txcount = hour.series[@intFromEnum(Kind.mempool_txcount)].values;
+    try t.expectEqual(npoints, txcount.len);
+    try t.expectEqual(@as(?i64, 15), txcount[npoints - 2]);
+    try t.expectEqual(@as(?i64, 40), txcount[npoints - 1]);
+    try t.expectEqual(@as(?i64, null), txcount[npoints - 3]);
+    const local = hour.series[@intFromEnum(Kind.ln_local)].values;
+    try t.expectEqual(@as(?i64, 100), local[npoints - 2]);
+    try t.expectEqual(@as(?i64, null), local[npoints - 1]);
+
+    // the day range rolls up all three samples in the same point.
+    const day = rep.ranges[1];
+    try t.expectEqual(@as(?i64, 70 / 3), day.series[@intFromEnum(Kind.mempool_txcount)].values[npoints - 1]);
+
+    // a day later, the minute slots are reused but hours and days are retained.
+    const t1 = t0 + time.s_per_day + 60;
+    _ = h.record(t1, .{ .mempool_txcount = 1 });
+    const rep1 = try h.report(arena, t1);
+    const hour1 = rep1.ranges[0].series[@intFromEnum(Kind.mempool_txcount)].values;
+    try t.expectEqual(@as(?i64, 1), hour1[npoints - 1]);
+    for (hour1[0 .. npoints - 1]) |v| {
+        try t.expectEqual(@as(?i64, null), v);
+    }
+    const year1 = rep1.ranges[3].series[@intFromEnum(Kind.mempool_txcount)].values;
+    try t.expectEqual(@as(?i64, (70 + 1) / 4), year1[npoints - 1]);
+}
+
+test "reset unknown format" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    try tmp.dir.writeFile("history.bin", "garbage");
+    const path = try tmp.dir.realpathAlloc(t.allocator, "history.bin");
+    defer t.allocator.free(path);
+
+    var h = try open(path);
+    defer h.close();
+    const hdr: *const Header = @ptrCast(h.mem.ptr);
+    try t.expect(std.meta.eql(hdr.*, Header{}));
+    try t.expectEqual(@as(u64, file_size), (try tmp.dir.statFile("history.bin")).size);
+}
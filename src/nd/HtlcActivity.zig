@@ -0,0 +1,251 @@
+//! live routing activity off the lnd HTLC events stream: per-minute counters
+//! of settled forwards, failures by reason, sats routed and fees earned in a
+//! ring of slots, and the number of forwards in flight.
+//!
+//! the stream thread is the only writer, and summaries are taken from any
+//! other thread without locks. like Forwards days, a slot holds its minute
+//! number: one from a previous lap around the ring is reset on first use.
+//! readers skip a slot while it's being reset, which only ever undercounts.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+
+const Atomic = std.atomic.Value;
+const Summary = comm.Message.HtlcActivity;
+
+/// number of minute slots; the longest summary window.
+pub const nminutes = 60;
+/// the short summary window, in minutes, the current one included.
+pub const recent_minutes = 5;
+/// forwards tracked in flight at most; settles of untracked ones still count,
+/// without amounts.
+const max_in_flight = 4096;
+
+/// forward failure reasons, as in the summary.
+pub const Reason = std.meta.FieldEnum(Summary.Failures);
+const nreasons = std.meta.fields(Reason).len;
+
+allocator: std.mem.Allocator,
+slots: [nminutes]Slot = [_]Slot{.{}} ** nminutes,
+in_flight_count: Atomic(u32) = Atomic(u32).init(0),
+/// set on each recorded event, cleared by takeSummary.
+dirty: Atomic(bool) = Atomic(bool).init(false),
+/// forwards offered onwards and not yet resolved; writer only.
+in_flight: std.AutoHashMapUnmanaged(Key, Amount) = .{},
+
+const HtlcActivity = @This();
+
+const Slot = struct {
+    minute: Atomic(u64) = Atomic(u64).init(0), // minutes since unix epoch; 0 while reset
+    forwards: Atomic(u32) = Atomic(u32).init(0),
+    failures: [nreasons]Atomic(u32) = [_]Atomic(u32){Atomic(u32).init(0)} ** nreasons,
+    routed_msat: Atomic(u64) = Atomic(u64).init(0),
+    fees_msat: Atomic(u64) = Atomic(u64).init(0),
+};
+
+/// a forwarded HTLC, by its incoming channel and id within the channel.
+pub const Key = struct {
+    chan_in: u64,
+    htlc_in: u64,
+};
+
+const Amount = struct {
+    out_msat: u64,
+    fee_msat: u64,
+};
+
+/// forwarding events of the stream; those of own payments are left out.
+pub const Event = union(enum) {
+    /// the HTLC is offered to the outgoing channel.
+    forward: struct { key: Key, amt_in_msat: u64, amt_out_msat: u64 },
+    /// the outgoing HTLC settled: the forward succeeded.
+    settle: Key,
+    /// failed back from downstream, or by lnd before it was offered onwards.
+    fail: struct { key: Key, reason: Reason },
+    /// the stream (re)started: HTLCs in flight before are unknown.
+    subscribed,
+};
+
+pub fn init(allocator: std.mem.Allocator) HtlcActivity {
+    return .{ .allocator = allocator };
+}
+
+pub fn deinit(self: *HtlcActivity) void {
+    self.in_flight.deinit(self.allocator);
+}
+
+/// records ev which occurred at unix time now_sec, in seconds. writer only.
+/// returns true if it's the first change since the last takeSummary.
+pub fn record(self: *HtlcActivity, ev: Event, now_sec: i64) bool {
+    const slot = self.slotAt(minuteOf(now_sec));
+    switch (ev) {
+        .forward => |f| if (self.in_flight.count() < max_in_flight) {
+            const amt = Amount{ .out_msat = f.amt_out_msat, .fee_msat = f.amt_in_msat -| f.amt_out_msat };
+            self.in_flight.put(self.allocator, f.key, amt) catch {}; // settles without amounts
+        },
+        .settle => |key| {
+            _ = slot.forwards.fetchAdd(1, .monotonic);
+            if (self.in_flight.fetchRemove(key)) |kv| {
+                _ = slot.routed_msat.fetchAdd(kv.value.out_msat, .monotonic);
+                _ = slot.fees_msat.fetchAdd(kv.value.fee_msat, .monotonic);
+            }
+        },
+        .fail => |f| {
+            _ = slot.failures[@intFromEnum(f.reason)].fetchAdd(1, .monotonic);
+            _ = self.in_flight.remove(f.key);
+        },
+        .subscribed => self.in_flight.clearRetainingCapacity(),
+    }
+    self.in_flight_count.store(self.in_flight.count(), .monotonic);
+    return !self.dirty.swap(true, .release);
+}
+
+/// returns the slot of the minute, reset if it held an older one.
+fn slotAt(self: *HtlcActivity, minute: u64) *Slot {
+    const slot = &self.slots[minute % nminutes];
+    if (slot.minute.load(.monotonic) == minute) {
+        return slot;
+    }
+    // readers seeing 0 or a different minute after reading counters skip it.
+    slot.minute.store(0, .monotonic);
+    @fence(.release);
+    slot.forwards.store(0, .monotonic);
+    for (&slot.failures) |*v| v.store(0, .monotonic);
+    slot.routed_msat.store(0, .monotonic);
+    slot.fees_msat.store(0, .monotonic);
+    slot.minute.store(minute, .release);
+    return slot;
+}
+
+/// reports whether events were recorded since the last takeSummary.
+pub fn isDirty(self: *const HtlcActivity) bool {
+    return self.dirty.load(.acquire);
+}
+
+/// returns totals of the windows ending at unix time now_sec, in seconds,
+/// and clears the dirty flag. safe to call from any thread.
+pub fn takeSummary(self: *HtlcActivity, now_sec: i64) Summary {
+    self.dirty.store(false, .monotonic);
+    const now = minuteOf(now_sec);
+    var sum = Summary{ .in_flight = self.in_flight_count.load(.monotonic) };
+    for (&self.slots) |*slot| {
+        const minute = slot.minute.load(.acquire);
+        if (minute == 0 or minute > now or now - minute >= nminutes) {
+            continue;
+        }
+        var t = Summary.Totals{
+            .forwards = slot.forwards.load(.monotonic),
+            .routed_sat = slot.routed_msat.load(.monotonic) / 1000,
+            .fees_msat = slot.fees_msat.load(.monotonic),
+        };
+        inline for (std.meta.fields(Summary.Failures), 0..) |f, i| {
+            @field(t.failures, f.name) = slot.failures[i].load(.monotonic);
+        }
+        @fence(.acquire);
+        if (slot.minute.load(.monotonic) != minute) {
+            continue; // reset while reading
+        }
+        addTotals(&sum.hour, t);
+        if (now - minute < recent_minutes) {
+            addTotals(&sum.recent, t);
+        }
+    }
+    return sum;
+}
+
+/// reports whether s shows any activity, which is going to age out.
+pub fn isActive(s: Summary) bool {
+    return s.in_flight > 0 or !std.meta.eql(s.hour, Summary.Totals{});
+}
+
+fn addTotals(dst: *Summary.Totals, t: Summary.Totals) void {
+    dst.forwards += t.forwards;
+    dst.routed_sat += t.routed_sat;
+    dst.fees_msat += t.fees_msat;
+    inline for (std.meta.fields(Summary.Failures)) |f| {
+        @field(dst.failures, f.name) += @field(t.failures, f.name);
+    }
+}
+
+fn minuteOf(sec: i64) u64 {
+    return @intCast(@divTrunc(@max(0, sec), std.time.s_per_min));
+}
+
+/// returns the reason of a forward failed by lnd, from the lnd link failure
+/// wire_failure and failure_detail enum names.
+pub fn linkFailReason(wire_failure: []const u8, failure_detail: []const u8) Reason {
+    const eql = std.mem.eql;
+    if (eql(u8, failure_detail, "INSUFFICIENT_BALANCE")) {
+        return .balance;
+    }
+    if (eql(u8, failure_detail, "HTLC_EXCEEDS_MAX")) {
+        return .policy;
+    }
+    if (eql(u8, failure_detail, "LINK_NOT_ELIGIBLE") or eql(u8, failure_detail, "FORWARDS_DISABLED")) {
+        return .unavailable;
+    }
+    const by_wire = std.ComptimeStringMap(Reason, .{
+        .{ "FEE_INSUFFICIENT", .fee },
+        .{ "INCORRECT_CLTV_EXPIRY", .policy },
+        .{ "EXPIRY_TOO_SOON", .policy },
+        .{ "EXPIRY_TOO_FAR", .policy },
+        .{ "AMOUNT_BELOW_MINIMUM", .policy },
+        .{ "UNKNOWN_NEXT_PEER", .unavailable },
+        .{ "CHANNEL_DISABLED", .unavailable },
+    });
+    return by_wire.get(wire_failure) orelse .other;
+}
+
+test "record and summary" {
+    const t = std.testing;
+
+    var act = HtlcActivity.init(t.allocator);
+    defer act.deinit();
+    const now: i64 = 1_700_000_000;
+    const key = Key{ .chan_in = 1, .htlc_in = 7 };
+
+    try t.expect(act.record(.subscribed, now));
+    try t.expect(!act.record(.{ .forward = .{ .key = key, .amt_in_msat = 101_000, .amt_out_msat = 100_000 } }, now));
+    var sum = act.takeSummary(now);
+    try t.expect(!act.isDirty());
+    try t.expectEqual(@as(u32, 1), sum.in_flight);
+    try t.expectEqual(@as(u32, 0), sum.hour.forwards);
+    try t.expect(isActive(sum));
+
+    try t.expect(act.record(.{ .settle = key }, now + 10));
+    _ = act.record(.{ .settle = .{ .chan_in = 2, .htlc_in = 1 } }, now + 10); // untracked
+    _ = act.record(.{ .fail = .{ .key = .{ .chan_in = 3, .htlc_in = 1 }, .reason = .balance } }, now - 10 * std.time.s_per_min);
+    sum = act.takeSummary(now + 10);
+    try t.expectEqual(@as(u32, 0), sum.in_flight);
+    try t.expectEqual(@as(u32, 2), sum.recent.forwards);
+    try t.expectEqual(@as(u64, 100), sum.recent.routed_sat);
+    try t.expectEqual(@as(u64, 1000), sum.recent.fees_msat);
+    try t.expectEqual(@as(u32, 0), sum.recent.failures.balance);
+    try t.expectEqual(@as(u32, 1), sum.hour.failures.balance);
+    try t.expectEqual(@as(u32, 2), sum.hour.forwards);
+
+    // counts age out of the windows.
+    sum = act.takeSummary(now + nminutes * std.time.s_per_min);
+    try t.expect(!isActive(sum));
+
+    // a slot of a previous lap is reset.
+    _ = act.record(.{ .fail = .{ .key = key, .reason = .fee } }, now + nminutes * std.time.s_per_min);
+    sum = act.takeSummary(now + nminutes * std.time.s_per_min);
+    try t.expectEqual(@as(u32, 0), sum.hour.forwards);
+    try t.expectEqual(@as(u32, 1), sum.hour.failures.fee);
+
+    // a restarted stream forgets HTLCs in flight.
+    _ = act.record(.{ .forward = .{ .key = key, .amt_in_msat = 2000, .amt_out_msat = 1000 } }, now);
+    _ = act.record(.subscribed, now);
+    try t.expectEqual(@as(u32, 0), act.takeSummary(now).in_flight);
+}
+
+test "linkFailReason" {
+    const t = std.testing;
+
+    try t.expectEqual(Reason.balance, linkFailReason("TEMPORARY_CHANNEL_FAILURE", "INSUFFICIENT_BALANCE"));
+    try t.expectEqual(Reason.fee, linkFailReason("FEE_INSUFFICIENT", "NO_DETAIL"));
+    try t.expectEqual(Reason.policy, linkFailReason("INCORRECT_CLTV_EXPIRY", "NO_DETAIL"));
+    try t.expectEqual(Reason.unavailable, linkFailReason("UNKNOWN_NEXT_PEER", "NO_DETAIL"));
+    try t.expectEqual(Reason.other, linkFailReason("TEMPORARY_NODE_FAILURE", "UNKNOWN"));
+}
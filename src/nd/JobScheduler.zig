@@ -0,0 +1,477 @@
+//! background jobs scheduler of nd maintenance work which restarts services
+//! or loads the node, such as lnd database compaction and bitcoind profile
+//! restarts. a job names its exclusion groups, for instance all the jobs
+//! restarting lnd, and jobs sharing a group run one at a time, higher
+//! priority first. jobs of the idle window wait until the screen is off and
+//! the node isn't busy; a job not started by its deadline is dropped.
+//! while the node is under resource pressure, jobs of the idle window and
+//! low priority jobs wait too; see setPressure.
+//!
+//! work which can't wait in the queue, such as user requests, holds groups
+//! with acquire or tryAcquire instead, and queued jobs wait for it.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+const time = std.time;
+
+const comm = @import("../comm.zig");
+const tcalloc = @import("../tcalloc.zig");
+
+const logger = std.log.scoped(.jobs);
+
+allocator: std.mem.Allocator,
+/// set before start; report calls are made without holding mu.
+reporter: ?Reporter = null,
+
+/// guards all fields below.
+mu: std.Thread.Mutex = .{},
+/// signaled on a change to any of the fields below.
+cond: std.Thread.Condition = .{},
+queue: std.ArrayListUnmanaged(Entry) = .{},
+/// submission counter, to run jobs of the same priority in order.
+seq: u64 = 0,
+/// groups held by running jobs and acquire callers.
+held: Groups = Groups.initEmpty(),
+/// acquire callers waiting for each group; jobs don't start in those.
+waiting: std.EnumArray(Group, u16) = std.EnumArray(Group, u16).initFill(0),
+/// whether the screen is off; see setStandby.
+standby: bool = false,
+/// node load, percent; see setLoad.
+load: u8 = 0,
+/// whether the node is under resource pressure; see setPressure.
+pressure: bool = false,
+stopping: bool = false,
+thread: ?std.Thread = null,
+
+const JobScheduler = @This();
+
+pub const Priority = enum { low, normal, high };
+
+/// resources a job holds for itself while running.
+pub const Group = enum {
+    lnd, // stops or restarts lnd
+    bitcoind, // stops or restarts bitcoind
+    sysupdates, // runs a system update
+};
+pub const Groups = std.EnumSet(Group);
+
+/// when a job may start.
+pub const Window = enum {
+    any, // as soon as its groups are free
+    idle, // also in standby and below idle_load
+};
+
+/// max node load of the idle window, percent.
+pub const idle_load = 25;
+
+pub const Job = struct {
+    name: []const u8, // static; unique in the queue, in logs and reports
+    priority: Priority = .normal,
+    groups: Groups,
+    window: Window = .any,
+    deadline: ?i64 = null, // time.timestamp; dropped if not started by then
+    ctx: *anyopaque,
+    /// runs in a thread of its own.
+    runFn: *const fn (ctx: *anyopaque, p: Progress) anyerror!void,
+};
+
+const Entry = struct {
+    job: Job,
+    seq: u64,
+    running: bool = false,
+};
+
+/// receives job progress reports, typically sent to ngui.
+pub const Reporter = struct {
+    ctx: *anyopaque,
+    reportFn: *const fn (ctx: *anyopaque, rep: comm.Message.JobProgress) void,
+};
+
+/// handed to a running job to report how far it got.
+pub const Progress = struct {
+    sched: *JobScheduler,
+    name: []const u8,
+
+    /// reports pct percent of the job done.
+    pub fn set(self: Progress, pct: u8) void {
+        self.sched.report(.{ .name = self.name, .state = .running, .progress = @min(pct, 100) });
+    }
+};
+
+pub fn init(allocator: std.mem.Allocator) JobScheduler {
+    return .{ .allocator = allocator };
+}
+
+/// the scheduler must be stop'ed first.
+pub fn deinit(self: *JobScheduler) void {
+    self.queue.deinit(self.allocator);
+}
+
+/// starts the dispatcher thread. self must not move until stop.
+pub fn start(self: *JobScheduler) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.stopping = false;
+    self.thread = try std.Thread.spawn(.{}, loop, .{self});
+}
+
+/// drops queued jobs and waits for the running ones to finish.
+/// acquire callers waiting for a group return an error.
+pub fn stop(self: *JobScheduler) void {
+    self.mu.lock();
+    self.stopping = true;
+    self.cond.broadcast();
+    const th = self.thread;
+    self.thread = null;
+    self.mu.unlock();
+    if (th) |t| {
+        t.join();
+    }
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    var i: usize = 0;
+    while (i < self.queue.items.len) {
+        if (self.queue.items[i].running) {
+            i += 1;
+        } else {
+            logger.info("{s}: dropped on stop", .{self.queue.items[i].job.name});
+            _ = self.queue.orderedRemove(i);
+        }
+    }
+    while (self.queue.items.len > 0) {
+        self.cond.wait(&self.mu);
+    }
+}
+
+/// queues the job and reports whether it did: false if a job of the same
+/// name is already queued or running, or the scheduler is stopping.
+pub fn submit(self: *JobScheduler, job: Job) !bool {
+    {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.stopping or self.find(job.name) != null) {
+            return false;
+        }
+        try self.queue.append(self.allocator, .{ .job = job, .seq = self.seq });
+        self.seq += 1;
+        self.cond.broadcast();
+    }
+    logger.info("{s}: queued", .{job.name});
+    self.report(.{ .name = job.name, .state = .queued, .progress = null });
+    return true;
+}
+
+/// reports whether a job of the name is queued or running.
+pub fn pending(self: *JobScheduler, name: []const u8) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    return self.find(name) != null;
+}
+
+/// sets whether the screen is off, for the idle window.
+pub fn setStandby(self: *JobScheduler, v: bool) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.standby = v;
+    self.cond.broadcast();
+}
+
+/// sets the current node load in percent, for the idle window.
+pub fn setLoad(self: *JobScheduler, pct: u8) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.load = pct;
+    self.cond.broadcast();
+}
+
+/// sets whether the node is under cpu, memory or io pressure, deferring
+/// idle window and low priority jobs until it subsides.
+pub fn setPressure(self: *JobScheduler, v: bool) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.pressure = v;
+    self.cond.broadcast();
+}
+
+/// holds the groups if none is held by a running job or another caller.
+/// callers release the groups once done.
+pub fn tryAcquire(self: *JobScheduler, groups: Groups) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.held.intersectWith(groups).count() > 0) {
+        return false;
+    }
+    self.held.setUnion(groups);
+    return true;
+}
+
+/// blocks until the groups are free and holds them, ahead of queued jobs.
+/// callers release the groups once done.
+pub fn acquire(self: *JobScheduler, groups: Groups) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    var it = groups.iterator();
+    while (it.next()) |g| self.waiting.getPtr(g).* += 1;
+    defer {
+        it = groups.iterator();
+        while (it.next()) |g| self.waiting.getPtr(g).* -= 1;
+        self.cond.broadcast();
+    }
+    while (self.held.intersectWith(groups).count() > 0) {
+        if (self.stopping) {
+            return error.JobSchedulerStopping;
+        }
+        self.cond.wait(&self.mu);
+    }
+    self.held.setUnion(groups);
+}
+
+/// lets go of the groups held with acquire or tryAcquire.
+pub fn release(self: *JobScheduler, groups: Groups) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.held = self.held.differenceWith(groups);
+    self.cond.broadcast();
+}
+
+/// the caller holds self.mu.
+fn find(self: *JobScheduler, name: []const u8) ?usize {
+    for (self.queue.items, 0..) |e, i| {
+        if (std.mem.eql(u8, e.job.name, name)) {
+            return i;
+        }
+    }
+    return null;
+}
+
+/// returns the queue index of the next job to start, if any can.
+/// the caller holds self.mu.
+fn next(self: *JobScheduler) ?usize {
+    var waited = Groups.initEmpty();
+    for (std.enums.values(Group)) |g| {
+        if (self.waiting.get(g) > 0) waited.insert(g);
+    }
+    const busy = self.held.unionWith(waited);
+    const idle = self.standby and self.load < idle_load;
+    var best: ?usize = null;
+    for (self.queue.items, 0..) |e, i| {
+        if (e.running or busy.intersectWith(e.job.groups).count() > 0) {
+            continue;
+        }
+        if (e.job.window == .idle and !idle) {
+            continue;
+        }
+        if (self.pressure and (e.job.window == .idle or e.job.priority == .low)) {
+            continue;
+        }
+        if (best) |b| {
+            const cur = self.queue.items[b];
+            const higher = @intFromEnum(e.job.priority) > @intFromEnum(cur.job.priority);
+            if (!higher and (e.job.priority != cur.job.priority or e.seq > cur.seq)) {
+                continue;
+            }
+        }
+        best = i;
+    }
+    return best;
+}
+
+/// dispatcher thread: starts jobs once they can run and drops late ones.
+fn loop(self: *JobScheduler) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    while (!self.stopping) {
+        const now = time.timestamp();
+        const expired = for (self.queue.items, 0..) |e, i| {
+            if (!e.running and e.job.deadline != null and e.job.deadline.? <= now) break i;
+        } else null;
+        if (expired) |i| {
+            const job = self.queue.orderedRemove(i).job;
+            self.mu.unlock();
+            logger.info("{s}: expired", .{job.name});
+            self.report(.{ .name = job.name, .state = .expired, .progress = null });
+            self.mu.lock();
+            continue;
+        }
+
+        if (self.next()) |i| {
+            const e = &self.queue.items[i];
+            e.running = true;
+            self.held.setUnion(e.job.groups);
+            const th = std.Thread.spawn(.{}, runJob, .{ self, e.job }) catch |err| {
+                const job = self.queue.orderedRemove(i).job;
+                self.held = self.held.differenceWith(job.groups);
+                self.mu.unlock();
+                logger.err("{s}: thread: {!}", .{ job.name, err });
+                self.report(.{ .name = job.name, .state = .failed, .progress = null });
+                self.mu.lock();
+                continue;
+            };
+            th.detach();
+            continue;
+        }
+
+        // until the nearest deadline or a change.
+        var until: ?i64 = null;
+        for (self.queue.items) |e| {
+            if (e.running or e.job.deadline == null) continue;
+            until = if (until) |u| @min(u, e.job.deadline.?) else e.job.deadline.?;
+        }
+        if (until) |u| {
+            const ns: u64 = @intCast(@max(1, u - now) * time.ns_per_s);
+            self.cond.timedWait(&self.mu, ns) catch {};
+        } else {
+            self.cond.wait(&self.mu);
+        }
+    }
+}
+
+fn runJob(self: *JobScheduler, job: Job) void {
+    defer tcalloc.releaseThreadCache(); // the thread exits after the job
+    logger.info("{s}: running", .{job.name});
+    self.report(.{ .name = job.name, .state = .running, .progress = null });
+    const start_ms = time.milliTimestamp();
+    const res = job.runFn(job.ctx, .{ .sched = self, .name = job.name });
+    const took = time.milliTimestamp() - start_ms;
+    if (res) {
+        logger.info("{s}: done in {d}ms", .{ job.name, took });
+        self.report(.{ .name = job.name, .state = .done, .progress = 100 });
+    } else |err| {
+        logger.err("{s}: failed after {d}ms: {!}", .{ job.name, took, err });
+        self.report(.{ .name = job.name, .state = .failed, .progress = null });
+    }
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.find(job.name)) |i| {
+        _ = self.queue.orderedRemove(i);
+    }
+    self.held = self.held.differenceWith(job.groups);
+    self.cond.broadcast();
+}
+
+fn report(self: *JobScheduler, rep: comm.Message.JobProgress) void {
+    if (self.reporter) |r| {
+        r.reportFn(r.ctx, rep);
+    }
+}
+
+/// a job blocking until its gate opens, for tests.
+const TestJob = struct {
+    name: []const u8,
+    gate: std.Thread.ResetEvent = .{},
+    ran: std.Thread.ResetEvent = .{},
+    order: *std.BoundedArray(u8, 16),
+    order_mu: *std.Thread.Mutex,
+
+    fn run(ctx: *anyopaque, p: Progress) anyerror!void {
+        const self: *TestJob = @ptrCast(@alignCast(ctx));
+        p.set(50);
+        self.gate.wait();
+        self.order_mu.lock();
+        self.order.appendAssumeCapacity(self.name[0]);
+        self.order_mu.unlock();
+        self.ran.set();
+    }
+
+    fn job(self: *TestJob, prio: Priority, groups: Groups, window: Window) Job {
+        return .{ .name = self.name, .priority = prio, .groups = groups, .window = window, .ctx = self, .runFn = run };
+    }
+};
+
+fn testRunning(sched: *JobScheduler, name: []const u8) bool {
+    sched.mu.lock();
+    defer sched.mu.unlock();
+    const i = sched.find(name) orelse return false;
+    return sched.queue.items[i].running;
+}
+
+test "job scheduler" {
+    const t = std.testing;
+    const lnd = Groups.initOne(.lnd);
+
+    var sched = JobScheduler.init(t.allocator);
+    defer sched.deinit();
+    const Reports = struct {
+        mu: std.Thread.Mutex = .{},
+        expired: u32 = 0,
+        progress: u32 = 0,
+        fn f(ctx: *anyopaque, rep: comm.Message.JobProgress) void {
+            const self: *@This() = @ptrCast(@alignCast(ctx));
+            self.mu.lock();
+            defer self.mu.unlock();
+            if (rep.state == .expired) self.expired += 1;
+            if (rep.progress != null and rep.progress.? == 50) self.progress += 1;
+        }
+    };
+    var reports = Reports{};
+    sched.reporter = .{ .ctx = &reports, .reportFn = Reports.f };
+    try sched.start();
+    defer sched.stop();
+
+    var order = std.BoundedArray(u8, 16){};
+    var order_mu = std.Thread.Mutex{};
+    var a = TestJob{ .name = "a", .order = &order, .order_mu = &order_mu };
+    var b = TestJob{ .name = "b", .order = &order, .order_mu = &order_mu };
+    var c = TestJob{ .name = "c", .order = &order, .order_mu = &order_mu };
+    var d = TestJob{ .name = "d", .order = &order, .order_mu = &order_mu };
+
+    // jobs of a group run one at a time, higher priority first; others run along.
+    try t.expect(try sched.submit(a.job(.normal, lnd, .any)));
+    try t.expect(!try sched.submit(a.job(.normal, lnd, .any)));
+    while (!testRunning(&sched, "a")) time.sleep(time.ns_per_ms);
+    try t.expect(try sched.submit(b.job(.low, lnd, .any)));
+    try t.expect(try sched.submit(c.job(.high, lnd, .any)));
+    d.gate.set();
+    try t.expect(try sched.submit(d.job(.low, Groups.initOne(.bitcoind), .any)));
+    d.ran.wait();
+    try t.expect(!testRunning(&sched, "b") and !testRunning(&sched, "c"));
+    b.gate.set();
+    c.gate.set();
+    a.gate.set();
+    b.ran.wait();
+    try t.expect(c.ran.isSet());
+    try t.expectEqualStrings("dacb", order.constSlice());
+    try t.expectEqual(@as(u32, 4), reports.progress);
+
+    // idle window: screen off and a low load.
+    order.len = 0;
+    a = TestJob{ .name = "a", .order = &order, .order_mu = &order_mu };
+    a.gate.set();
+    try t.expect(try sched.submit(a.job(.low, lnd, .idle)));
+    sched.setStandby(true);
+    sched.setLoad(idle_load + 10);
+    time.sleep(20 * time.ns_per_ms);
+    try t.expect(!a.ran.isSet());
+    // and no resource pressure.
+    sched.setPressure(true);
+    sched.setLoad(idle_load - 10);
+    time.sleep(20 * time.ns_per_ms);
+    try t.expect(!a.ran.isSet());
+    sched.setPressure(false);
+    a.ran.wait();
+
+    // acquired groups keep queued jobs waiting.
+    try t.expect(sched.tryAcquire(lnd));
+    try t.expect(!sched.tryAcquire(Groups.initMany(&.{ .lnd, .bitcoind })));
+    b = TestJob{ .name = "b", .order = &order, .order_mu = &order_mu };
+    b.gate.set();
+    try t.expect(try sched.submit(b.job(.high, lnd, .any)));
+    time.sleep(20 * time.ns_per_ms);
+    try t.expect(!b.ran.isSet());
+    sched.release(lnd);
+    b.ran.wait();
+    try sched.acquire(lnd);
+    sched.release(lnd);
+
+    // late jobs are dropped.
+    var late = c.job(.low, lnd, .idle);
+    late.name = "late";
+    late.deadline = time.timestamp() - 1;
+    sched.setStandby(false);
+    try t.expect(try sched.submit(late));
+    while (sched.pending("late")) time.sleep(time.ns_per_ms);
+    try t.expectEqual(@as(u32, 1), reports.expired);
+}
@@ -0,0 +1,165 @@
+//! a long-lived, lazily created lnd HTTP client shared across daemon threads.
+//! reusing the same client keeps its HTTP connection pool and TLS sessions
+//! alive across report cycles instead of re-parsing the TLS cert bundle and
+//! re-reading macaroons on every call.
+//!
+//! the client is re-created whenever the TLS cert or macaroon files change,
+//! for example after a tls reset or a new wallet init. clients in use are
+//! kept alive until all their handles are released.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+const lndhttp = @import("../lightning.zig").lndhttp;
+
+const logger = std.log.scoped(.lndcache);
+
+allocator: std.mem.Allocator,
+opt: lndhttp.Client.InitOpt,
+
+/// guards all fields below.
+mu: std.Thread.Mutex = .{},
+curr: ?*Entry = null,
+stamp: Stamp = .{},
+
+const LndClientCache = @This();
+
+const Entry = struct {
+    client: lndhttp.Client,
+    refs: usize,
+};
+
+/// files mtime the current client was created with; 0 if a file is missing.
+const Stamp = struct {
+    tlscert: i128 = 0,
+    macaroon_ro: i128 = 0,
+    macaroon_admin: i128 = 0,
+};
+
+/// a reference to a shared client. callers must release it when done.
+pub const Handle = struct {
+    client: *lndhttp.Client,
+    entry: *Entry,
+    cache: *LndClientCache,
+
+    pub fn release(self: Handle) void {
+        self.cache.mu.lock();
+        defer self.cache.mu.unlock();
+        self.cache.unref(self.entry);
+    }
+};
+
+/// opt slices must be alive until deinit.
+/// opt.allocator is used for all allocations.
+pub fn init(opt: lndhttp.Client.InitOpt) LndClientCache {
+    return .{ .allocator = opt.allocator, .opt = opt };
+}
+
+/// releases the current client. all handles must be released before deinit.
+pub fn deinit(self: *LndClientCache) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.curr) |e| {
+        self.unref(e);
+    }
+    self.curr = null;
+}
+
+/// makes the next acquire create a new client.
+pub fn invalidate(self: *LndClientCache) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.curr) |e| {
+        self.unref(e);
+    }
+    self.curr = null;
+}
+
+/// returns a shared client, creating a new one if none exists yet or the
+/// tls cert or macaroon files changed since the last creation.
+pub fn acquire(self: *LndClientCache) !Handle {
+    const stamp = self.readStamp();
+    self.mu.lock();
+    defer self.mu.unlock();
+
+    if (self.curr) |e| {
+        if (std.meta.eql(stamp, self.stamp)) {
+            e.refs += 1;
+            return .{ .client = &e.client, .entry = e, .cache = self };
+        }
+        logger.info("lnd tls cert or macaroon files changed; re-creating client", .{});
+        self.unref(e);
+        self.curr = null;
+    }
+
+    const e = try self.allocator.create(Entry);
+    errdefer self.allocator.destroy(e);
+    e.* = .{
+        .client = try lndhttp.Client.init(self.opt),
+        .refs = 2, // one for self.curr and another for the returned handle
+    };
+    self.curr = e;
+    self.stamp = stamp;
+    return .{ .client = &e.client, .entry = e, .cache = self };
+}
+
+/// callers must hold self.mu.
+fn unref(self: *LndClientCache, e: *Entry) void {
+    e.refs -= 1;
+    if (e.refs == 0) {
+        e.client.deinit();
+        self.allocator.destroy(e);
+    }
+}
+
+fn readStamp(self: LndClientCache) Stamp {
+    return .{
+        .tlscert = fileMtime(self.opt.tlscert_path),
+        .macaroon_ro = if (self.opt.macaroon_ro_path) |p| fileMtime(p) else 0,
+        .macaroon_admin = if (self.opt.macaroon_admin_path) |p| fileMtime(p) else 0,
+    };
+}
+
+fn fileMtime(path: []const u8) i128 {
+    const stat = std.fs.cwd().statFile(path) catch return 0;
+    return stat.mtime;
+}
+
+test "lndcache: reuse and re-create" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    const certpath = try tmp.join(&.{"tls.cert"});
+    try tmp.dir.writeFile(certpath, "");
+    const macpath = try tmp.join(&.{"readonly.macaroon"});
+
+    var cache = LndClientCache.init(.{
+        .allocator = t.allocator,
+        .tlscert_path = certpath,
+        .macaroon_ro_path = macpath,
+    });
+    defer cache.deinit();
+
+    const h1 = try cache.acquire();
+    const h2 = try cache.acquire();
+    try t.expect(h1.client == h2.client);
+    try t.expect(h1.client.macaroon.readonly == null);
+    h2.release();
+
+    // macaroon file appears, for example after wallet init.
+    try tmp.dir.writeFile(macpath, "mac");
+    const h3 = try cache.acquire();
+    defer h3.release();
+    try t.expect(h3.client != h1.client);
+    try t.expectEqualStrings("6d6163", h3.client.macaroon.readonly.?);
+    // the old client is still usable until released.
+    try t.expect(h1.client.macaroon.readonly == null);
+    h1.release();
+
+    cache.invalidate();
+    const h4 = try cache.acquire();
+    defer h4.release();
+    try t.expect(h4.client != h3.client);
+}
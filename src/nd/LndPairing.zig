@@ -0,0 +1,173 @@
+//! lndconnect pairing URLs of the lnd admin macaroon, cached between pairing
+//! requests: the macaroon is read and encoded again only once its file
+//! changes, as after a wallet init, or once invalidated. prepare builds the
+//! URLs ahead of the first request, as soon as the file exists.
+//! safe for concurrent use.
+
+const std = @import("std");
+const sys = @import("../sys.zig");
+
+const logger = std.log.scoped(.pairing);
+
+allocator: std.mem.Allocator,
+/// the admin macaroon file; referenced, not owned.
+macaroon_path: []const u8,
+
+/// guards all fields below.
+mu: std.Thread.Mutex = .{},
+/// the URLs as of the macaroon file stamp; owned.
+cached: ?Cached = null,
+
+const LndPairing = @This();
+
+/// lnd grpc and REST ports of the URLs.
+const rpc_port = 10009;
+const http_port = 10010;
+/// get waits this long for the macaroon file to appear, shortly after a
+/// wallet unlock.
+const wait_ms = 60 * std.time.ms_per_s;
+const max_macaroon_size = 2048;
+
+const Cached = struct {
+    stamp: Stamp,
+    host: []const u8,
+    urls: Urls,
+};
+
+/// identifies a version of the macaroon file.
+const Stamp = struct {
+    inode: std.fs.File.INode,
+    size: u64,
+    mtime: i128,
+};
+
+/// lndconnect URLs of the grpc and REST interfaces.
+pub const Urls = struct {
+    rpc: []const u8,
+    http: []const u8,
+
+    pub fn deinit(self: Urls, allocator: std.mem.Allocator) void {
+        allocator.free(self.rpc);
+        allocator.free(self.http);
+    }
+};
+
+/// macaroon_path must be alive until deinit.
+pub fn init(allocator: std.mem.Allocator, macaroon_path: []const u8) LndPairing {
+    return .{ .allocator = allocator, .macaroon_path = macaroon_path };
+}
+
+pub fn deinit(self: *LndPairing) void {
+    self.invalidate();
+}
+
+/// drops the cached URLs, as ahead of new lnd credentials.
+pub fn invalidate(self: *LndPairing) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.dropLocked();
+}
+
+/// builds the URLs of the host unless cached already for the current
+/// macaroon file. returns error.FileNotFound if there's no macaroon yet.
+pub fn prepare(self: *LndPairing, host: []const u8) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    try self.refreshLocked(host);
+}
+
+/// returns the URLs of the host, waiting for the macaroon file if it doesn't
+/// exist yet. caller owns returned value, allocated with the allocator.
+pub fn get(self: *LndPairing, allocator: std.mem.Allocator, host: []const u8) !Urls {
+    self.prepare(host) catch |err| switch (err) {
+        error.FileNotFound => {
+            var watch = try sys.FileWatch.init(self.macaroon_path);
+            defer watch.deinit();
+            try watch.waitExists(.{ .timeout_ms = wait_ms });
+            try self.prepare(host);
+        },
+        else => return err,
+    };
+    self.mu.lock();
+    defer self.mu.unlock();
+    const c = self.cached orelse return error.LndPairingInvalidated; // in between
+    const rpc = try allocator.dupe(u8, c.urls.rpc);
+    errdefer allocator.free(rpc);
+    return .{ .rpc = rpc, .http = try allocator.dupe(u8, c.urls.http) };
+}
+
+fn refreshLocked(self: *LndPairing, host: []const u8) !void {
+    const st = try std.fs.cwd().statFile(self.macaroon_path);
+    const stamp = Stamp{ .inode = st.inode, .size = st.size, .mtime = st.mtime };
+    if (self.cached) |c| {
+        if (std.meta.eql(c.stamp, stamp) and std.mem.eql(u8, c.host, host)) {
+            return;
+        }
+    }
+
+    const macaroon = try std.fs.cwd().readFileAlloc(self.allocator, self.macaroon_path, max_macaroon_size);
+    defer self.allocator.free(macaroon);
+    const base64enc = std.base64.url_safe_no_pad.Encoder;
+    const b64 = try self.allocator.alloc(u8, base64enc.calcSize(macaroon.len));
+    defer self.allocator.free(b64);
+    const macaroon_b64 = base64enc.encode(b64, macaroon);
+
+    const hostdup = try self.allocator.dupe(u8, host);
+    errdefer self.allocator.free(hostdup);
+    const rpc = try lndconnect(self.allocator, host, rpc_port, macaroon_b64);
+    errdefer self.allocator.free(rpc);
+    const http = try lndconnect(self.allocator, host, http_port, macaroon_b64);
+    self.dropLocked();
+    self.cached = .{ .stamp = stamp, .host = hostdup, .urls = .{ .rpc = rpc, .http = http } };
+    logger.debug("pairing URLs built", .{});
+}
+
+fn lndconnect(allocator: std.mem.Allocator, host: []const u8, port: u16, macaroon_b64: []const u8) ![]const u8 {
+    return std.fmt.allocPrint(allocator, "lndconnect://{[host]s}:{[port]d}?macaroon={[macaroon]s}", .{
+        .host = host,
+        .port = port,
+        .macaroon = macaroon_b64,
+    });
+}
+
+fn dropLocked(self: *LndPairing) void {
+    const c = self.cached orelse return;
+    self.allocator.free(c.host);
+    c.urls.deinit(self.allocator);
+    self.cached = null;
+}
+
+test "cached pairing urls" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    const path = try tmp.join(&.{"admin.macaroon"});
+    var p = LndPairing.init(t.allocator, path);
+    defer p.deinit();
+    try t.expectError(error.FileNotFound, p.prepare("abc.onion"));
+
+    try tmp.dir.writeFile("admin.macaroon", "\x02\x01mac");
+    try p.prepare("abc.onion");
+    const rpc_ptr = p.cached.?.urls.rpc.ptr;
+    var urls = try p.get(t.allocator, "abc.onion");
+    try t.expectEqualStrings("lndconnect://abc.onion:10009?macaroon=AgFtYWM", urls.rpc);
+    try t.expectEqualStrings("lndconnect://abc.onion:10010?macaroon=AgFtYWM", urls.http);
+    urls.deinit(t.allocator);
+    try t.expectEqual(rpc_ptr, p.cached.?.urls.rpc.ptr); // not rebuilt
+
+    // a new macaroon.
+    try tmp.dir.writeFile("admin.macaroon", "\x02\x01mac2");
+    urls = try p.get(t.allocator, "abc.onion");
+    try t.expectEqualStrings("lndconnect://abc.onion:10009?macaroon=AgFtYWMy", urls.rpc);
+    urls.deinit(t.allocator);
+
+    // a new host.
+    urls = try p.get(t.allocator, "xyz.onion");
+    try t.expectEqualStrings("lndconnect://xyz.onion:10010?macaroon=AgFtYWMy", urls.http);
+    urls.deinit(t.allocator);
+
+    p.invalidate();
+    try t.expect(p.cached == null);
+}
@@ -0,0 +1,158 @@
+//! tracks lightning reports sent to ngui and turns each new report into
+//! a comm.Message.LightningReportDelta against the previous one.
+//! only hashes of the previously sent report are retained, keyed by channel point.
+//! not safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+
+allocator: std.mem.Allocator,
+/// hash of the last sent report fields except channels; null if none was sent.
+summary: ?u64 = null,
+/// channel point to a hash of the channel as last sent.
+channels: std.AutoHashMapUnmanaged(types.OutPoint, u64) = .{},
+
+const LndReportDiff = @This();
+
+pub fn init(allocator: std.mem.Allocator) LndReportDiff {
+    return .{ .allocator = allocator };
+}
+
+pub fn deinit(self: *LndReportDiff) void {
+    self.channels.deinit(self.allocator);
+}
+
+/// forgets previously sent reports, making the next message a full report.
+/// callers must reset when next fails, its returned message was not delivered or
+/// ngui may have dropped the report, for example after a lightning_error.
+pub fn reset(self: *LndReportDiff) void {
+    self.channels.clearRetainingCapacity();
+    self.summary = null;
+}
+
+/// returns a message to send to ngui for the report rep: a full lightning_report
+/// after init or reset, and a lightning_report_delta otherwise.
+/// rep is assumed to be sent as soon as next returns.
+/// the returned message references rep and memory allocated with the arena.
+pub fn next(self: *LndReportDiff, arena: std.mem.Allocator, rep: comm.Message.LightningReport) !comm.Message {
+    var summary = rep;
+    summary.channels = &.{};
+    const summary_hash = hashOf(summary);
+
+    if (self.summary == null) {
+        self.reset();
+        for (rep.channels) |ch| {
+            try self.channels.put(self.allocator, ch.point, hashOf(ch));
+        }
+        self.summary = summary_hash;
+        return .{ .lightning_report = rep };
+    }
+
+    var delta = comm.Message.LightningReportDelta{};
+    if (self.summary.? != summary_hash) {
+        delta.summary = summary;
+        self.summary = summary_hash;
+    }
+
+    var upsert = std.ArrayList(comm.Message.LightningChannel).init(arena);
+    var seen = std.AutoHashMap(types.OutPoint, void).init(arena);
+    for (rep.channels) |ch| {
+        try seen.put(ch.point, {});
+        const h = hashOf(ch);
+        if (self.channels.getPtr(ch.point)) |v| {
+            if (v.* == h) {
+                continue;
+            }
+            v.* = h;
+        } else {
+            try self.channels.put(self.allocator, ch.point, h);
+        }
+        try upsert.append(ch);
+    }
+    delta.upsert = upsert.items;
+
+    var remove = std.ArrayList(types.OutPoint).init(arena);
+    var it = self.channels.keyIterator();
+    while (it.next()) |k| {
+        if (!seen.contains(k.*)) {
+            try remove.append(k.*);
+        }
+    }
+    for (remove.items) |point| {
+        _ = self.channels.remove(point);
+    }
+    delta.remove = remove.items;
+
+    return .{ .lightning_report_delta = delta };
+}
+
+fn hashOf(v: anytype) u64 {
+    var h = std.hash.Wyhash.init(0);
+    std.hash.autoHashStrat(&h, v, .Deep);
+    return h.final();
+}
+
+test "lnd report diff" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var diff = LndReportDiff.init(t.allocator);
+    defer diff.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const chan = comm.Message.LightningChannel{
+        .state = .active,
+        .private = false,
+        .point = types.OutPoint.literal("01" ** 32 ++ ":0"),
+        .peer_pubkey = types.PubKey.literal("02" ++ "01" ** 32),
+        .peer_alias = "",
+        .capacity = 100,
+        .balance = .{ .local = 60, .remote = 40, .unsettled = 0, .limbo = 0 },
+        .totalsats = .{ .sent = 0, .received = 0 },
+        .fees = .{ .base = 1, .ppm = 1 },
+    };
+    var chan2 = chan;
+    chan2.point = types.OutPoint.literal("02" ** 32 ++ ":0");
+    var rep = comm.Message.LightningReport{
+        .version = "v1",
+        .pubkey = types.PubKey.literal("03" ++ "ab" ** 32),
+        .alias = "alias",
+        .npeers = 2,
+        .height = 800000,
+        .hash = types.Hash.literal("00" ** 32),
+        .sync = .{ .chain = true, .graph = true },
+        .uris = &.{},
+        .totalbalance = .{ .local = 120, .remote = 80, .unsettled = 0, .pending = 0 },
+        .totalfees = .{ .day = 0, .week = 0, .month = 0 },
+        .channels = &.{ chan, chan2 },
+    };
+
+    // first report is always full
+    try t.expect(try diff.next(arena, rep) == .lightning_report);
+
+    // nothing changed
+    var msg = try diff.next(arena, rep);
+    try tt.expectDeepEqual(comm.Message{ .lightning_report_delta = .{} }, msg);
+
+    // height changed, p1 updated, p2 closed and p3 opened
+    var chan1upd = chan;
+    chan1upd.balance.local = 50;
+    var chan3 = chan;
+    chan3.point = types.OutPoint.literal("01" ** 32 ++ ":1");
+    rep.height = 800001;
+    rep.channels = &.{ chan1upd, chan3 };
+    msg = try diff.next(arena, rep);
+    var summary = rep;
+    summary.channels = &.{};
+    try tt.expectDeepEqual(comm.Message{ .lightning_report_delta = .{
+        .summary = summary,
+        .upsert = &.{ chan1upd, chan3 },
+        .remove = &.{chan2.point},
+    } }, msg);
+
+    diff.reset();
+    try t.expect(try diff.next(arena, rep) == .lightning_report);
+}
@@ -0,0 +1,341 @@
+//! mempool fee rate histogram, kept up to date incrementally from bitcoind
+//! ZMQ "sequence" notifications rather than whole mempool dumps: a full
+//! txids list only on first sync or after missed notifications, then batched
+//! getmempoolentry lookups of the added transactions alone.
+//! transactions are keyed by the first 8 bytes of their txid: collisions are
+//! improbable enough for a histogram.
+//! notify may be called concurrently with the others; refresh and histogram
+//! are called from a single thread.
+
+const std = @import("std");
+const bitcoindrpc = @import("../bitcoindrpc.zig");
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+
+const logger = std.log.scoped(.mempool);
+
+/// lower bounds of the fee rate buckets, in sat/vB.
+pub const bucket_min = [_]u32{ 0, 1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 20, 30, 50, 75, 100, 150, 200, 300, 500, 1000 };
+/// max getmempoolentry calls in a single batch request: about 350KiB of response.
+const lookup_batch = 500;
+/// max notifications queued between refreshes; more forces a resync.
+const max_queued = 100_000;
+/// response size limit of getrawmempool and getblock, at about 67 bytes per txid.
+const max_body_size = 16 << 20;
+
+allocator: std.mem.Allocator,
+
+/// guards queue, zmq_seq, lost and active.
+mu: std.Thread.Mutex = .{},
+/// notifications received since the last refresh.
+queue: std.ArrayListUnmanaged(Event) = .{},
+/// the last ZMQ message sequence number of the topic, to detect gaps.
+zmq_seq: ?u32 = null,
+/// whether notifications were missed, which calls for a resync.
+lost: bool = false,
+/// whether any sequence notification arrived: bitcoind is configured to
+/// publish them. refresh makes no calls until then.
+active: bool = false,
+
+// fields below are used only by refresh and histogram.
+entries: std.AutoHashMapUnmanaged(u64, Entry) = .{},
+buckets: [bucket_min.len]Bucket = [_]Bucket{.{}} ** bucket_min.len,
+/// mempool sequence as of the last applied notification; null until synced.
+sequence: ?u64 = null,
+/// added txids pending fee lookup.
+pending: std.ArrayListUnmanaged(types.Hash) = .{},
+
+const MempoolTracker = @This();
+
+const Entry = struct {
+    vsize: u32,
+    bucket: u8,
+};
+
+const Bucket = struct {
+    count: u32 = 0,
+    vsize: u64 = 0,
+};
+
+/// a sequence notification, in the order bitcoind publishes them.
+const Event = struct {
+    /// block hash or txid, in RPC byte order.
+    hash: types.Hash,
+    kind: enum { block_connected, block_disconnected, tx_added, tx_removed },
+    /// mempool sequence number of tx events; 0 for blocks.
+    sequence: u64,
+
+    /// parses a ZMQ sequence notification body: a 32-byte hash, a label and,
+    /// for tx events, a little-endian mempool sequence number.
+    fn parse(body: []const u8) ?Event {
+        if (body.len < 33) {
+            return null;
+        }
+        var ev = Event{ .hash = .{ .bytes = body[0..32].* }, .kind = undefined, .sequence = 0 };
+        ev.kind = switch (body[32]) {
+            'C' => .block_connected,
+            'D' => .block_disconnected,
+            'A' => .tx_added,
+            'R' => .tx_removed,
+            else => return null,
+        };
+        if (ev.kind == .tx_added or ev.kind == .tx_removed) {
+            if (body.len < 41) {
+                return null;
+            }
+            ev.sequence = std.mem.readInt(u64, body[33..41], .little);
+        }
+        return ev;
+    }
+};
+
+pub fn init(allocator: std.mem.Allocator) MempoolTracker {
+    return .{ .allocator = allocator };
+}
+
+pub fn deinit(self: *MempoolTracker) void {
+    self.queue.deinit(self.allocator);
+    self.entries.deinit(self.allocator);
+    self.pending.deinit(self.allocator);
+}
+
+/// queues a ZMQ sequence notification with the body and message sequence
+/// number seq, for the next refresh.
+pub fn notify(self: *MempoolTracker, body: []const u8, seq: ?u32) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.active = true;
+    if (seq) |s| {
+        if (self.zmq_seq) |last| {
+            if (s != last +% 1) {
+                self.lost = true;
+            }
+        }
+        self.zmq_seq = s;
+    }
+    const ev = Event.parse(body) orelse {
+        self.lost = true;
+        return;
+    };
+    if (self.lost or self.queue.items.len >= max_queued) {
+        self.lost = true;
+        self.queue.clearRetainingCapacity(); // superseded by the resync
+        return;
+    }
+    self.queue.append(self.allocator, ev) catch {
+        self.lost = true;
+    };
+}
+
+/// applies notifications queued since the last call, resyncing from the
+/// mempool txids list if not in sync, and looks up fees of added txs.
+/// client is used for batched lookups; larger responses go over a separate
+/// connection with the same settings.
+pub fn refresh(self: *MempoolTracker, client: *bitcoindrpc.Client) !void {
+    self.mu.lock();
+    if (!self.active) {
+        self.mu.unlock();
+        return;
+    }
+    var queue = self.queue;
+    self.queue = .{};
+    const lost = self.lost;
+    self.lost = false;
+    self.mu.unlock();
+    defer queue.deinit(self.allocator);
+    // the rest of the queue is dropped on error: resync next time.
+    errdefer self.sequence = null;
+
+    var bulk = bitcoindrpc.Client{
+        .allocator = client.allocator,
+        .cookiepath = client.cookiepath,
+        .addr = client.addr,
+        .port = client.port,
+        .max_body_size = max_body_size,
+    };
+    defer bulk.deinit();
+    if (lost or self.sequence == null) {
+        self.sequence = null;
+        const res = try bulk.call(.getrawmempool, .{});
+        defer res.deinit();
+        self.reset();
+        try self.pending.ensureTotalCapacity(self.allocator, res.value.txids.len);
+        for (res.value.txids) |txid| {
+            self.pending.appendAssumeCapacity(types.Hash.parse(txid) catch continue);
+        }
+        self.sequence = res.value.mempool_sequence;
+        logger.info("synced {d} txs at sequence {d}", .{ self.pending.items.len, self.sequence.? });
+    }
+    for (queue.items) |ev| {
+        switch (self.apply(ev)) {
+            .ok => {},
+            .block => |hash| {
+                // txs leave the mempool into a block with no notifications.
+                const hex = hash.hex();
+                const res = try bulk.call(.getblock, .{ .blockhash = &hex });
+                defer res.deinit();
+                for (res.value.tx) |txid| {
+                    const h = types.Hash.parse(txid) catch continue;
+                    self.remove(key(h));
+                }
+            },
+        }
+    }
+    try self.lookupPending(client);
+}
+
+/// applies a tx notification in place; blocks are left to the caller.
+/// notifications already covered by a resync are skipped.
+fn apply(self: *MempoolTracker, ev: Event) union(enum) { ok, block: types.Hash } {
+    switch (ev.kind) {
+        .block_connected => return .{ .block = ev.hash },
+        // txs return to the mempool with tx_added notifications.
+        .block_disconnected => return .ok,
+        .tx_added, .tx_removed => {
+            const seq = self.sequence orelse return .ok; // resyncing anyway
+            if (ev.sequence <= seq) {
+                return .ok;
+            }
+            self.sequence = ev.sequence;
+            if (ev.kind == .tx_added) {
+                self.pending.append(self.allocator, ev.hash) catch {
+                    self.sequence = null; // resync next time
+                };
+            } else {
+                // a pending tx lookup finds it gone.
+                self.remove(key(ev.hash));
+            }
+            return .ok;
+        },
+    }
+}
+
+/// looks up fees of pending txs in batches; those gone meanwhile are skipped.
+/// txs of a failed batch remain pending.
+fn lookupPending(self: *MempoolTracker, client: *bitcoindrpc.Client) !void {
+    if (self.pending.items.len == 0) {
+        return;
+    }
+    const hexes = try self.allocator.alloc([64]u8, lookup_batch);
+    defer self.allocator.free(hexes);
+    var args: [lookup_batch]bitcoindrpc.Client.MethodArgs(.getmempoolentry) = undefined;
+    while (self.pending.items.len > 0) {
+        const n = @min(self.pending.items.len, lookup_batch);
+        const batch = self.pending.items[self.pending.items.len - n ..];
+        for (batch, hexes[0..n], args[0..n]) |h, *hex, *a| {
+            hex.* = h.hex();
+            a.* = .{ .txid = hex };
+        }
+        const res = try client.callMany(.getmempoolentry, args[0..n]);
+        defer res.deinit();
+        for (batch, res.value) |h, r| {
+            const e = r catch continue;
+            self.insert(key(h), e.vsize, e.fees.base);
+        }
+        self.pending.shrinkRetainingCapacity(self.pending.items.len - n);
+    }
+}
+
+/// returns the fee rate histogram, lowest rates first, or null until synced.
+pub fn histogram(self: *const MempoolTracker) ?[bucket_min.len]comm.Message.OnchainReport.FeeRateBucket {
+    if (self.sequence == null or self.pending.items.len > 0) {
+        return null;
+    }
+    var out: [bucket_min.len]comm.Message.OnchainReport.FeeRateBucket = undefined;
+    for (&out, bucket_min, self.buckets) |*o, min, b| {
+        o.* = .{ .min = min, .count = b.count, .vsize = b.vsize };
+    }
+    return out;
+}
+
+fn reset(self: *MempoolTracker) void {
+    self.entries.clearRetainingCapacity();
+    self.pending.clearRetainingCapacity();
+    self.buckets = [_]Bucket{.{}} ** bucket_min.len;
+}
+
+fn insert(self: *MempoolTracker, k: u64, vsize: u64, fee_btc: f64) void {
+    const sats = @round(fee_btc * 1e8);
+    const rate = if (vsize == 0) 0 else sats / @as(f64, @floatFromInt(vsize));
+    var bucket: u8 = 0;
+    for (bucket_min, 0..) |min, i| {
+        if (rate >= @as(f64, @floatFromInt(min))) {
+            bucket = @intCast(i);
+        }
+    }
+    const e = Entry{ .vsize = std.math.lossyCast(u32, vsize), .bucket = bucket };
+    const res = self.entries.getOrPut(self.allocator, k) catch return; // left out
+    if (res.found_existing) {
+        self.sub(res.value_ptr.*);
+    }
+    res.value_ptr.* = e;
+    self.buckets[e.bucket].count += 1;
+    self.buckets[e.bucket].vsize += e.vsize;
+}
+
+fn remove(self: *MempoolTracker, k: u64) void {
+    const kv = self.entries.fetchRemove(k) orelse return;
+    self.sub(kv.value);
+}
+
+fn sub(self: *MempoolTracker, e: Entry) void {
+    self.buckets[e.bucket].count -|= 1;
+    self.buckets[e.bucket].vsize -|= e.vsize;
+}
+
+fn key(h: types.Hash) u64 {
+    return std.mem.readInt(u64, h.bytes[0..8], .little);
+}
+
+test "mempool tracker" {
+    const t = std.testing;
+
+    var mt = MempoolTracker.init(t.allocator);
+    defer mt.deinit();
+    try t.expect(mt.histogram() == null);
+
+    // notifications: tx added with sequence 7, and a malformed one.
+    var body: [41]u8 = undefined;
+    @memset(body[0..32], 0xab);
+    body[32] = 'A';
+    std.mem.writeInt(u64, body[33..41], 7, .little);
+    mt.notify(&body, 1);
+    try t.expect(mt.active and !mt.lost);
+    try t.expectEqual(@as(usize, 1), mt.queue.items.len);
+    mt.notify(&body, 3); // message 2 went missing
+    try t.expect(mt.lost);
+    try t.expectEqual(@as(usize, 0), mt.queue.items.len);
+    mt.lost = false;
+    mt.notify(body[0..33], 4); // no mempool sequence
+    try t.expect(mt.lost);
+
+    // as synced at sequence 5 with two txs.
+    mt.sequence = 5;
+    const a = types.Hash{ .bytes = [_]u8{1} ** 32 };
+    const b = types.Hash{ .bytes = [_]u8{2} ** 32 };
+    mt.insert(key(a), 200, 0.00000400); // 2 sat/vB
+    mt.insert(key(b), 100, 0.00010000); // 100 sat/vB
+    const hist = mt.histogram().?;
+    try t.expectEqual(@as(u32, 1), hist[2].count);
+    try t.expectEqual(@as(u64, 200), hist[2].vsize);
+    try t.expectEqual(@as(u32, 1), hist[15].count);
+    try t.expectEqual(@as(u32, 100), hist[15].min);
+
+    // already covered by the sync; then b is removed and a new tx added.
+    const c = types.Hash{ .bytes = [_]u8{3} ** 32 };
+    try t.expect(mt.apply(.{ .hash = b, .kind = .tx_removed, .sequence = 5 }) == .ok);
+    try t.expectEqual(@as(u32, 1), mt.histogram().?[15].count);
+    _ = mt.apply(.{ .hash = b, .kind = .tx_removed, .sequence = 6 });
+    _ = mt.apply(.{ .hash = c, .kind = .tx_added, .sequence = 7 });
+    try t.expectEqual(@as(?u64, 7), mt.sequence);
+    try t.expect(mt.histogram() == null); // c fee lookup pending
+    mt.pending.clearRetainingCapacity();
+    try t.expectEqual(@as(u32, 0), mt.histogram().?[15].count);
+    try t.expect(mt.apply(.{ .hash = c, .kind = .block_connected, .sequence = 0 }) == .block);
+
+    // a replaced entry moves buckets.
+    mt.insert(key(a), 200, 0.00002000); // 10 sat/vB
+    const hist2 = mt.histogram().?;
+    try t.expectEqual(@as(u32, 0), hist2[2].count);
+    try t.expectEqual(@as(u32, 1), hist2[8].count);
+}
@@ -0,0 +1,694 @@
+//! daemon timing metrics: bitcoind and lnd API calls latency, reports build
+//! time, comm write time, ngui frame times and touch latency, as well as the
+//! time of the last successful report of each kind. exported in prometheus
+//! text format to a file, for example in a node_exporter textfile collector
+//! directory, together with the latest node resources sample; see sys.Sampler,
+//! and live heap bytes per subsystem; see memacct.
+//!
+//! recording is lock-free and safe for concurrent use: a few atomic adds per
+//! sample, negligible next to the calls measured. all values are cumulative
+//! since nd start, as prometheus expects. the resources sample is copied
+//! under a mutex, once per sampler period.
+
+const builtin = @import("builtin");
+const std = @import("std");
+const time = std.time;
+const Atomic = std.atomic.Value;
+
+const bitcoindrpc = @import("../bitcoindrpc.zig");
+const comm = @import("../comm.zig");
+const memacct = @import("../memacct.zig");
+const tcalloc = @import("../tcalloc.zig");
+const lndhttp = @import("../lightning.zig").lndhttp;
+const CpuFreq = @import("../sys.zig").CpuFreq;
+const Sampler = @import("../sys.zig").Sampler;
+const Zram = @import("../sys.zig").Zram;
+const PeerEvictor = @import("PeerEvictor.zig");
+
+const logger = std.log.scoped(.metrics);
+
+/// output file path; null disables writeFile.
+path: ?[]const u8,
+bitcoind: std.EnumArray(bitcoindrpc.Client.Method, Rpc) = std.EnumArray(bitcoindrpc.Client.Method, Rpc).initFill(.{}),
+bitcoind_batch: Rpc = .{},
+lnd: std.EnumArray(lndhttp.Client.ApiMethod, Rpc) = std.EnumArray(lndhttp.Client.ApiMethod, Rpc).initFill(.{}),
+reports: std.EnumArray(Report, ReportStats) = std.EnumArray(Report, ReportStats).initFill(.{}),
+comm_write: Histogram = .{},
+ui: std.EnumArray(UiPhase, Histogram) = std.EnumArray(UiPhase, Histogram).initFill(.{}),
+touch: std.EnumArray(TouchStage, Histogram) = std.EnumArray(TouchStage, Histogram).initFill(.{}),
+/// unix time of the report collections the data ngui shows is from, as of
+/// its last perf report; 0 if none yet.
+ui_collected: std.EnumArray(UiReport, Atomic(u64)) = std.EnumArray(UiReport, Atomic(u64)).initFill(Atomic(u64).init(0)),
+/// cpufreq governor switches made by nd, per governor; see recordGovernor.
+cpufreq_switches: std.EnumArray(CpuFreq.Governor, Atomic(u64)) = std.EnumArray(CpuFreq.Governor, Atomic(u64)).initFill(Atomic(u64).init(0)),
+/// the governor last switched to, as its ordinal + 1; 0 if none.
+cpufreq_current: Atomic(u8) = Atomic(u8).init(0),
+/// peers disconnected for lagging in bitcoind IBD, per kind; see recordEviction.
+ibd_evictions: std.EnumArray(PeerEvictor.Kind, Atomic(u64)) = std.EnumArray(PeerEvictor.Kind, Atomic(u64)).initFill(Atomic(u64).init(0)),
+/// sync rate ratio after and before the latest measured evictions, in
+/// thousandths; negative if none yet.
+ibd_eviction_gain: Atomic(i64) = Atomic(i64).init(-1),
+/// tor bootstrap progress, in percent; negative while unknown.
+tor_bootstrap: Atomic(i16) = Atomic(i16).init(-1),
+tor_circuit_build: Histogram = .{},
+tor_circuit_failures: Atomic(u64) = Atomic(u64).init(0),
+/// the latest node resources sample, if any; guarded by system_mu.
+system: ?Sampler.Sample = null,
+/// the latest zram swap figures, if set up; guarded by system_mu.
+zram: ?Zram.Stats = null,
+system_mu: std.Thread.Mutex = .{},
+
+/// time.milliTimestamp of the last writeFile.
+written: Atomic(i64) = Atomic(i64).init(0),
+/// serializes file writes.
+write_mu: std.Thread.Mutex = .{},
+
+const Metrics = @This();
+
+pub const Report = enum { onchain, lightning, network };
+
+/// ngui UI loop metrics, see comm.Message.UiPerfReport.
+const UiPhase = enum { render, flush, queue };
+
+/// ngui touch input latency stages, see comm.Message.UiPerfReport.
+const TouchStage = enum { read, event, photon };
+
+/// reports whose collection time ngui tracks, see comm.Message.UiPerfReport.collected.
+const UiReport = enum { onchain, lightning };
+
+/// min interval between writeFile output, in ms. values may thus lag
+/// by up to that much, or one report cycle if longer.
+const write_interval = 10 * time.ms_per_s;
+
+/// number of log2 histogram buckets of microseconds; same as ngui's.
+/// the last bucket, open-ended, starts at about 4s.
+const nbuckets = 24;
+
+/// cumulative log2 histogram of microsecond values.
+/// buckets[0] counts zero values and buckets[i] values in [2^(i-1), 2^i) range.
+const Histogram = struct {
+    buckets: [nbuckets]Atomic(u64) = [_]Atomic(u64){Atomic(u64).init(0)} ** nbuckets,
+    sum: Atomic(u64) = Atomic(u64).init(0),
+
+    fn record(self: *Histogram, us: u64) void {
+        const i = @min(nbuckets - 1, 64 - @as(usize, @clz(us)));
+        _ = self.buckets[i].fetchAdd(1, .monotonic);
+        _ = self.sum.fetchAdd(us, .monotonic);
+    }
+
+    /// adds all values of a histogram with the same buckets layout.
+    fn merge(self: *Histogram, h: comm.Message.UiPerfReport.Histogram) void {
+        for (h.buckets[0..@min(h.buckets.len, nbuckets)], 0..) |n, i| {
+            _ = self.buckets[i].fetchAdd(n, .monotonic);
+        }
+        _ = self.sum.fetchAdd(h.sum, .monotonic);
+    }
+};
+
+const Rpc = struct {
+    latency: Histogram = .{},
+    errors: Atomic(u64) = Atomic(u64).init(0),
+
+    fn record(self: *Rpc, elapsed_ns: u64, ok: bool) void {
+        self.latency.record(elapsed_ns / time.ns_per_us);
+        if (!ok) {
+            _ = self.errors.fetchAdd(1, .monotonic);
+        }
+    }
+};
+
+const ReportStats = struct {
+    build: Histogram = .{},
+    errors: Atomic(u64) = Atomic(u64).init(0),
+    unchanged: Atomic(u64) = Atomic(u64).init(0), // held back; see recordUnchanged
+    last_ok: Atomic(i64) = Atomic(i64).init(0), // unix epoch seconds; 0 if never
+};
+
+/// path must be alive until the metrics are no longer in use.
+pub fn init(path: ?[]const u8) Metrics {
+    return .{ .path = path };
+}
+
+/// an observer to set on a bitcoind client. self must outlive the client.
+pub fn bitcoindObserver(self: *Metrics) bitcoindrpc.Client.Observer {
+    return .{ .ctx = self, .func = struct {
+        fn f(ctx: *anyopaque, method: ?bitcoindrpc.Client.Method, elapsed_ns: u64, ok: bool) void {
+            const m: *Metrics = @ptrCast(@alignCast(ctx));
+            const rpc = if (method) |v| m.bitcoind.getPtr(v) else &m.bitcoind_batch;
+            rpc.record(elapsed_ns, ok);
+        }
+    }.f };
+}
+
+/// an observer to set on lnd clients. self must outlive the clients.
+pub fn lndObserver(self: *Metrics) lndhttp.Client.Observer {
+    return .{ .ctx = self, .func = struct {
+        fn f(ctx: *anyopaque, method: lndhttp.Client.ApiMethod, elapsed_ns: u64, ok: bool) void {
+            const m: *Metrics = @ptrCast(@alignCast(ctx));
+            m.lnd.getPtr(method).record(elapsed_ns, ok);
+        }
+    }.f };
+}
+
+/// records a report built and sent to ngui in the time since start,
+/// a time.nanoTimestamp, and writes the output file if due.
+pub fn recordReport(self: *Metrics, r: Report, start: i128, ok: bool) void {
+    const rs = self.reports.getPtr(r);
+    rs.build.record(sinceUs(start));
+    if (ok) {
+        rs.last_ok.store(time.timestamp(), .monotonic);
+    } else {
+        _ = rs.errors.fetchAdd(1, .monotonic);
+    }
+    self.writeFile();
+}
+
+/// records a report not sent to ngui for being the same as the previous one;
+/// see ReportDedup.
+pub fn recordUnchanged(self: *Metrics, r: Report) void {
+    _ = self.reports.getPtr(r).unchanged.fetchAdd(1, .monotonic);
+}
+
+/// records a single message write to ngui started at start, a time.nanoTimestamp.
+pub fn recordCommWrite(self: *Metrics, start: i128) void {
+    self.comm_write.record(sinceUs(start));
+}
+
+/// accumulates ngui frame times and touch latency of a periodic perf report.
+pub fn recordUiPerf(self: *Metrics, rep: comm.Message.UiPerfReport) void {
+    self.ui.getPtr(.render).merge(rep.render);
+    self.ui.getPtr(.flush).merge(rep.flush);
+    self.ui.getPtr(.queue).merge(rep.queue);
+    self.touch.getPtr(.read).merge(rep.touch_read);
+    self.touch.getPtr(.event).merge(rep.touch_event);
+    self.touch.getPtr(.photon).merge(rep.touch_photon);
+    for (std.enums.values(UiReport)) |r| {
+        const v = switch (r) {
+            .onchain => rep.collected.onchain,
+            .lightning => rep.collected.lightning,
+        };
+        if (v > 0) {
+            self.ui_collected.getPtr(r).store(v, .monotonic);
+        }
+    }
+}
+
+/// records a switch of all cpus to the governor.
+pub fn recordGovernor(self: *Metrics, gov: CpuFreq.Governor) void {
+    _ = self.cpufreq_switches.getPtr(gov).fetchAdd(1, .monotonic);
+    self.cpufreq_current.store(@as(u8, @intFromEnum(gov)) + 1, .monotonic);
+}
+
+/// records a peer disconnected for lagging in bitcoind IBD.
+pub fn recordEviction(self: *Metrics, kind: PeerEvictor.Kind) void {
+    _ = self.ibd_evictions.getPtr(kind).fetchAdd(1, .monotonic);
+}
+
+/// records the sync rate ratio of after and before peer evictions;
+/// see PeerEvictor.gain.
+pub fn recordEvictionGain(self: *Metrics, ratio: f64) void {
+    self.ibd_eviction_gain.store(@intFromFloat(@round(@max(0, ratio) * 1000)), .monotonic);
+}
+
+/// records tor bootstrap progress; null if unknown, such as while the control
+/// port is unreachable.
+pub fn recordTorBootstrap(self: *Metrics, progress: ?u8) void {
+    self.tor_bootstrap.store(if (progress) |p| @as(i16, p) else -1, .monotonic);
+}
+
+/// records a tor circuit build time, or a failure to build one if null.
+pub fn recordTorCircuit(self: *Metrics, build_ns: ?u64) void {
+    if (build_ns) |ns| {
+        self.tor_circuit_build.record(ns / time.ns_per_us);
+    } else {
+        _ = self.tor_circuit_failures.fetchAdd(1, .monotonic);
+    }
+}
+
+/// replaces the zram swap figures exported with the other metrics.
+pub fn recordZram(self: *Metrics, s: Zram.Stats) void {
+    self.system_mu.lock();
+    defer self.system_mu.unlock();
+    self.zram = s;
+}
+
+/// replaces the node resources sample exported with the other metrics.
+pub fn recordSystem(self: *Metrics, s: *const Sampler.Sample) void {
+    self.system_mu.lock();
+    defer self.system_mu.unlock();
+    self.system = s.*;
+}
+
+fn sinceUs(start: i128) u64 {
+    return std.math.lossyCast(u64, @divTrunc(time.nanoTimestamp() - start, time.ns_per_us));
+}
+
+/// atomically replaces the output file with the current values, unless
+/// written less than write_interval ago. errors are logged.
+pub fn writeFile(self: *Metrics) void {
+    const path = self.path orelse return;
+    const now = time.milliTimestamp();
+    const prev = self.written.load(.monotonic);
+    if (now - prev < write_interval) {
+        return;
+    }
+    if (self.written.cmpxchgStrong(prev, now, .monotonic, .monotonic) != null) {
+        return; // another thread is writing
+    }
+    self.write_mu.lock();
+    defer self.write_mu.unlock();
+    self.writeFileAtomic(path) catch |err| logger.err("{s}: {!}", .{ path, err });
+}
+
+fn writeFileAtomic(self: *Metrics, path: []const u8) !void {
+    var af = try std.fs.cwd().atomicFile(path, .{});
+    defer af.deinit();
+    var bw = std.io.bufferedWriter(af.file.writer());
+    try self.write(bw.writer());
+    try bw.flush();
+    try af.finish();
+}
+
+/// outputs all metrics in prometheus text exposition format.
+/// histograms with no recorded values are omitted.
+pub fn write(self: *Metrics, w: anytype) !void {
+    try w.writeAll(
+        \\# HELP nd_rpc_duration_seconds bitcoind and lnd API calls latency.
+        \\# TYPE nd_rpc_duration_seconds histogram
+        \\
+    );
+    var labels: [64]u8 = undefined;
+    for (std.enums.values(bitcoindrpc.Client.Method)) |m| {
+        const l = try std.fmt.bufPrint(&labels, "service=\"bitcoind\",method=\"{s}\"", .{@tagName(m)});
+        try writeHistogram(w, "nd_rpc_duration_seconds", l, &self.bitcoind.getPtr(m).latency);
+    }
+    try writeHistogram(w, "nd_rpc_duration_seconds", "service=\"bitcoind\",method=\"batch\"", &self.bitcoind_batch.latency);
+    for (std.enums.values(lndhttp.Client.ApiMethod)) |m| {
+        const l = try std.fmt.bufPrint(&labels, "service=\"lnd\",method=\"{s}\"", .{@tagName(m)});
+        try writeHistogram(w, "nd_rpc_duration_seconds", l, &self.lnd.getPtr(m).latency);
+    }
+
+    try w.writeAll(
+        \\# HELP nd_rpc_errors_total failed bitcoind and lnd API calls.
+        \\# TYPE nd_rpc_errors_total counter
+        \\
+    );
+    for (std.enums.values(bitcoindrpc.Client.Method)) |m| {
+        try w.print("nd_rpc_errors_total{{service=\"bitcoind\",method=\"{s}\"}} {d}\n", .{ @tagName(m), self.bitcoind.getPtr(m).errors.load(.monotonic) });
+    }
+    try w.print("nd_rpc_errors_total{{service=\"bitcoind\",method=\"batch\"}} {d}\n", .{self.bitcoind_batch.errors.load(.monotonic)});
+    for (std.enums.values(lndhttp.Client.ApiMethod)) |m| {
+        try w.print("nd_rpc_errors_total{{service=\"lnd\",method=\"{s}\"}} {d}\n", .{ @tagName(m), self.lnd.getPtr(m).errors.load(.monotonic) });
+    }
+
+    try w.writeAll(
+        \\# HELP nd_report_duration_seconds time to collect and send a report to ngui.
+        \\# TYPE nd_report_duration_seconds histogram
+        \\
+    );
+    for (std.enums.values(Report)) |r| {
+        const l = try std.fmt.bufPrint(&labels, "report=\"{s}\"", .{@tagName(r)});
+        try writeHistogram(w, "nd_report_duration_seconds", l, &self.reports.getPtr(r).build);
+    }
+    try w.writeAll(
+        \\# HELP nd_report_errors_total failed report attempts.
+        \\# TYPE nd_report_errors_total counter
+        \\
+    );
+    for (std.enums.values(Report)) |r| {
+        try w.print("nd_report_errors_total{{report=\"{s}\"}} {d}\n", .{ @tagName(r), self.reports.getPtr(r).errors.load(.monotonic) });
+    }
+    try w.writeAll(
+        \\# HELP nd_report_unchanged_total reports not sent to ngui for being the same as the previous one.
+        \\# TYPE nd_report_unchanged_total counter
+        \\
+    );
+    for (std.enums.values(Report)) |r| {
+        try w.print("nd_report_unchanged_total{{report=\"{s}\"}} {d}\n", .{ @tagName(r), self.reports.getPtr(r).unchanged.load(.monotonic) });
+    }
+    // a timestamp rather than age: the latter is time() minus the value,
+    // and stays correct even if nd stops updating the file.
+    try w.writeAll(
+        \\# HELP nd_report_last_success_timestamp_seconds unix time of the last report sent to ngui or found unchanged; 0 if none yet.
+        \\# TYPE nd_report_last_success_timestamp_seconds gauge
+        \\
+    );
+    for (std.enums.values(Report)) |r| {
+        try w.print("nd_report_last_success_timestamp_seconds{{report=\"{s}\"}} {d}\n", .{ @tagName(r), self.reports.getPtr(r).last_ok.load(.monotonic) });
+    }
+    // the same freshness as seen on screen, after the trip over the pipe.
+    try w.writeAll(
+        \\# HELP nd_ui_report_collected_timestamp_seconds unix time of the report collection the data ngui shows is from; 0 if none yet.
+        \\# TYPE nd_ui_report_collected_timestamp_seconds gauge
+        \\
+    );
+    for (std.enums.values(UiReport)) |r| {
+        try w.print("nd_ui_report_collected_timestamp_seconds{{report=\"{s}\"}} {d}\n", .{ @tagName(r), self.ui_collected.getPtr(r).load(.monotonic) });
+    }
+
+    try w.writeAll(
+        \\# HELP nd_comm_write_duration_seconds time to write a message to ngui.
+        \\# TYPE nd_comm_write_duration_seconds histogram
+        \\
+    );
+    try writeHistogram(w, "nd_comm_write_duration_seconds", "", &self.comm_write);
+    try w.writeAll(
+        \\# HELP nd_ui_frame_duration_seconds ngui frames render and flush time, and UI loop time applying updates.
+        \\# TYPE nd_ui_frame_duration_seconds histogram
+        \\
+    );
+    for (std.enums.values(UiPhase)) |p| {
+        const l = try std.fmt.bufPrint(&labels, "phase=\"{s}\"", .{@tagName(p)});
+        try writeHistogram(w, "nd_ui_frame_duration_seconds", l, self.ui.getPtr(p));
+    }
+    try w.writeAll(
+        \\# HELP nd_ui_touch_latency_seconds ngui touch input latency: evdev event to input read, input read to event dispatch, and evdev event to redraw flushed.
+        \\# TYPE nd_ui_touch_latency_seconds histogram
+        \\
+    );
+    for (std.enums.values(TouchStage)) |s| {
+        const l = try std.fmt.bufPrint(&labels, "stage=\"{s}\"", .{@tagName(s)});
+        try writeHistogram(w, "nd_ui_touch_latency_seconds", l, self.touch.getPtr(s));
+    }
+
+    try w.writeAll(
+        \\# HELP nd_cpufreq_governor_switches_total switches of all cpus to the scaling governor.
+        \\# TYPE nd_cpufreq_governor_switches_total counter
+        \\
+    );
+    for (std.enums.values(CpuFreq.Governor)) |g| {
+        try w.print("nd_cpufreq_governor_switches_total{{governor=\"{s}\"}} {d}\n", .{ @tagName(g), self.cpufreq_switches.getPtr(g).load(.monotonic) });
+    }
+    const cur = self.cpufreq_current.load(.monotonic);
+    if (cur > 0) {
+        try w.writeAll(
+            \\# HELP nd_cpufreq_governor the scaling governor set by nd.
+            \\# TYPE nd_cpufreq_governor gauge
+            \\
+        );
+        const g: CpuFreq.Governor = @enumFromInt(cur - 1);
+        try w.print("nd_cpufreq_governor{{governor=\"{s}\"}} 1\n", .{@tagName(g)});
+    }
+
+    try w.writeAll(
+        \\# HELP nd_ibd_peer_evictions_total peers disconnected for lagging behind the others in bitcoind initial block download.
+        \\# TYPE nd_ibd_peer_evictions_total counter
+        \\
+    );
+    for (std.enums.values(PeerEvictor.Kind)) |k| {
+        try w.print("nd_ibd_peer_evictions_total{{kind=\"{s}\"}} {d}\n", .{ @tagName(k), self.ibd_evictions.getPtr(k).load(.monotonic) });
+    }
+    const gain = self.ibd_eviction_gain.load(.monotonic);
+    if (gain >= 0) {
+        try w.writeAll(
+            \\# HELP nd_ibd_eviction_sync_rate_ratio blocks sync rate after the latest peer evictions over the rate before them.
+            \\# TYPE nd_ibd_eviction_sync_rate_ratio gauge
+            \\
+        );
+        try w.print("nd_ibd_eviction_sync_rate_ratio {d}.{d:0>3}\n", .{ @divTrunc(gain, 1000), @as(u64, @intCast(@mod(gain, 1000))) });
+    }
+
+    const tor = self.tor_bootstrap.load(.monotonic);
+    if (tor >= 0) {
+        try w.writeAll(
+            \\# HELP nd_tor_bootstrap_percent tor bootstrap progress, as reported on its control port.
+            \\# TYPE nd_tor_bootstrap_percent gauge
+            \\
+        );
+        try w.print("nd_tor_bootstrap_percent {d}\n", .{tor});
+    }
+    try w.writeAll(
+        \\# HELP nd_tor_circuit_build_duration_seconds tor circuit build time, from launched to built.
+        \\# TYPE nd_tor_circuit_build_duration_seconds histogram
+        \\
+    );
+    try writeHistogram(w, "nd_tor_circuit_build_duration_seconds", "", &self.tor_circuit_build);
+    try w.writeAll(
+        \\# HELP nd_tor_circuit_failures_total tor circuits failed to build.
+        \\# TYPE nd_tor_circuit_failures_total counter
+        \\
+    );
+    try w.print("nd_tor_circuit_failures_total {d}\n", .{self.tor_circuit_failures.load(.monotonic)});
+
+    try w.writeAll(
+        \\# HELP nd_heap_live_bytes heap bytes currently allocated by the subsystem.
+        \\# TYPE nd_heap_live_bytes gauge
+        \\
+    );
+    for (std.enums.values(memacct.Tag)) |tag| {
+        try w.print("nd_heap_live_bytes{{subsystem=\"{s}\"}} {d}\n", .{ @tagName(tag), memacct.liveBytes(tag) });
+    }
+    // debug builds run on GeneralPurposeAllocator, with no such figures.
+    if (builtin.mode != .Debug) {
+        const hs = tcalloc.stats();
+        try w.writeAll(
+            \\# HELP nd_heap_bytes nd heap totals: allocated and its peak, from libc and pooled slabs.
+            \\# TYPE nd_heap_bytes gauge
+            \\
+        );
+        try w.print("nd_heap_bytes{{kind=\"used\"}} {d}\n", .{hs.used});
+        try w.print("nd_heap_bytes{{kind=\"peak\"}} {d}\n", .{hs.peak});
+        try w.print("nd_heap_bytes{{kind=\"large\"}} {d}\n", .{hs.large});
+        try w.print("nd_heap_bytes{{kind=\"pooled\"}} {d}\n", .{hs.pooled});
+    }
+
+    self.system_mu.lock();
+    defer self.system_mu.unlock();
+    if (self.system) |*s| {
+        try writeSystem(w, s);
+    }
+    if (self.zram) |z| {
+        try writeZram(w, z);
+    }
+}
+
+/// outputs the zram device figures as gauges and swap activity as counters.
+fn writeZram(w: anytype, z: Zram.Stats) !void {
+    try w.writeAll(
+        \\# HELP nd_zram_bytes zram swap device: data stored, its compressed size and memory used.
+        \\# TYPE nd_zram_bytes gauge
+        \\
+    );
+    try w.print("nd_zram_bytes{{kind=\"orig\"}} {d}\n", .{z.orig_bytes});
+    try w.print("nd_zram_bytes{{kind=\"compr\"}} {d}\n", .{z.compr_bytes});
+    try w.print("nd_zram_bytes{{kind=\"used\"}} {d}\n", .{z.mem_used});
+    if (z.compr_bytes > 0) {
+        try w.writeAll(
+            \\# HELP nd_zram_compression_ratio zram swap data stored over its compressed size.
+            \\# TYPE nd_zram_compression_ratio gauge
+            \\
+        );
+        const milli = z.orig_bytes * 1000 / z.compr_bytes;
+        try w.print("nd_zram_compression_ratio {d}.{d:0>3}\n", .{ milli / 1000, milli % 1000 });
+    }
+    try w.writeAll(
+        \\# HELP nd_swap_pages_total pages swapped in and out since boot, all swap devices.
+        \\# TYPE nd_swap_pages_total counter
+        \\
+    );
+    try w.print("nd_swap_pages_total{{dir=\"in\"}} {d}\n", .{z.swap_in});
+    try w.print("nd_swap_pages_total{{dir=\"out\"}} {d}\n", .{z.swap_out});
+}
+
+/// outputs the node resources sample s as gauges and counters.
+/// counters of a service restart from zero with its process.
+fn writeSystem(w: anytype, s: *const Sampler.Sample) !void {
+    try w.writeAll(
+        \\# HELP nd_service_up whether the service process is running.
+        \\# TYPE nd_service_up gauge
+        \\
+    );
+    for (s.services.constSlice()) |sv| {
+        try w.print("nd_service_up{{service=\"{s}\"}} {d}\n", .{ sv.name, @intFromBool(sv.pid != 0) });
+    }
+    try w.writeAll(
+        \\# HELP nd_service_cpu_seconds_total user and system cpu time of the service process.
+        \\# TYPE nd_service_cpu_seconds_total counter
+        \\
+    );
+    for (s.services.constSlice()) |sv| {
+        const hz = Sampler.user_hz;
+        try w.print("nd_service_cpu_seconds_total{{service=\"{s}\"}} {d}.{d:0>2}\n", .{ sv.name, sv.cpu_ticks / hz, sv.cpu_ticks % hz * 100 / hz });
+    }
+    try w.writeAll(
+        \\# HELP nd_service_resident_memory_bytes resident memory size of the service process.
+        \\# TYPE nd_service_resident_memory_bytes gauge
+        \\
+    );
+    for (s.services.constSlice()) |sv| {
+        try w.print("nd_service_resident_memory_bytes{{service=\"{s}\"}} {d}\n", .{ sv.name, sv.rss });
+    }
+    try w.writeAll(
+        \\# HELP nd_service_storage_bytes_total bytes read from and written to storage by the service process.
+        \\# TYPE nd_service_storage_bytes_total counter
+        \\
+    );
+    for (s.services.constSlice()) |sv| {
+        const io = sv.io orelse continue;
+        try w.print("nd_service_storage_bytes_total{{service=\"{s}\",op=\"read\"}} {d}\n", .{ sv.name, io.read });
+        try w.print("nd_service_storage_bytes_total{{service=\"{s}\",op=\"write\"}} {d}\n", .{ sv.name, io.write });
+    }
+
+    try w.writeAll(
+        \\# HELP nd_disk_bytes_total bytes read from and written to the disk since boot.
+        \\# TYPE nd_disk_bytes_total counter
+        \\
+    );
+    for (s.disks.constSlice()) |d| {
+        try w.print("nd_disk_bytes_total{{device=\"{s}\",op=\"read\"}} {d}\n", .{ d.name.constSlice(), d.read });
+        try w.print("nd_disk_bytes_total{{device=\"{s}\",op=\"write\"}} {d}\n", .{ d.name.constSlice(), d.write });
+    }
+    try w.writeAll(
+        \\# HELP nd_disk_io_time_seconds_total time the disk spent with i/o in flight since boot.
+        \\# TYPE nd_disk_io_time_seconds_total counter
+        \\
+    );
+    for (s.disks.constSlice()) |d| {
+        try w.print("nd_disk_io_time_seconds_total{{device=\"{s}\"}} {d}.{d:0>3}\n", .{ d.name.constSlice(), d.io_ms / time.ms_per_s, d.io_ms % time.ms_per_s });
+    }
+
+    try w.writeAll(
+        \\# HELP nd_thermal_zone_celsius cpu thermal zone temperature.
+        \\# TYPE nd_thermal_zone_celsius gauge
+        \\
+    );
+    for (s.temps.constSlice(), 0..) |mc, i| {
+        const sign = if (mc < 0) "-" else "";
+        const v = @abs(mc);
+        try w.print("nd_thermal_zone_celsius{{zone=\"{d}\"}} {s}{d}.{d:0>3}\n", .{ i, sign, v / 1000, v % 1000 });
+    }
+    if (s.throttled) |bits| {
+        try w.writeAll(
+            \\# HELP nd_cpu_throttled_state raspberry pi firmware throttling and under-voltage bits; see vcgencmd get_throttled.
+            \\# TYPE nd_cpu_throttled_state gauge
+            \\
+        );
+        try w.print("nd_cpu_throttled_state {d}\n", .{bits});
+    }
+}
+
+/// outputs a single histogram series with the labels, a comma separated
+/// name="value" list which may be empty.
+fn writeHistogram(w: anytype, name: []const u8, labels: []const u8, h: *const Histogram) !void {
+    var counts: [nbuckets]u64 = undefined;
+    var total: u64 = 0;
+    for (&h.buckets, &counts) |*b, *c| {
+        c.* = b.load(.monotonic);
+        total += c.*;
+    }
+    if (total == 0) {
+        return;
+    }
+    const sep = if (labels.len > 0) "," else "";
+    var cum: u64 = 0;
+    for (counts[0 .. nbuckets - 1], 0..) |c, i| {
+        cum += c;
+        // integer values in bucket i are at most 2^i - 1.
+        const le: u64 = (@as(u64, 1) << @intCast(i)) - 1;
+        try w.print("{s}_bucket{{{s}{s}le=\"{}\"}} {d}\n", .{ name, labels, sep, fmtUs(le), cum });
+    }
+    try w.print("{s}_bucket{{{s}{s}le=\"+Inf\"}} {d}\n", .{ name, labels, sep, total });
+    if (labels.len > 0) {
+        try w.print("{s}_sum{{{s}}} {}\n", .{ name, labels, fmtUs(h.sum.load(.monotonic)) });
+        try w.print("{s}_count{{{s}}} {d}\n", .{ name, labels, total });
+    } else {
+        try w.print("{s}_sum {}\n", .{ name, fmtUs(h.sum.load(.monotonic)) });
+        try w.print("{s}_count {d}\n", .{ name, total });
+    }
+}
+
+/// formats microseconds as seconds with a fractional part.
+fn fmtUs(us: u64) std.fmt.Formatter(formatUs) {
+    return .{ .data = us };
+}
+
+fn formatUs(us: u64, comptime fmt: []const u8, opts: std.fmt.FormatOptions, w: anytype) !void {
+    _ = fmt;
+    _ = opts;
+    try w.print("{d}.{d:0>6}", .{ us / time.us_per_s, us % time.us_per_s });
+}
+
+test "write" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var m = Metrics.init(null);
+    m.bitcoindObserver().func(&m, .getblockchaininfo, 3 * time.ns_per_ms, true);
+    m.bitcoindObserver().func(&m, null, 1500 * time.ns_per_ms, false);
+    m.lndObserver().func(&m, .getinfo, 0, true);
+    m.reports.getPtr(.onchain).last_ok.store(1700000000, .monotonic);
+    m.recordUnchanged(.onchain);
+
+    var buf = std.ArrayList(u8).init(t.allocator);
+    defer buf.deinit();
+    try m.write(buf.writer());
+    const out = buf.items;
+    try tt.expectSubstring("nd_rpc_duration_seconds_bucket{service=\"bitcoind\",method=\"getblockchaininfo\",le=\"0.002047\"} 0\n", out);
+    try tt.expectSubstring("nd_rpc_duration_seconds_bucket{service=\"bitcoind\",method=\"getblockchaininfo\",le=\"0.004095\"} 1\n", out);
+    try tt.expectSubstring("nd_rpc_duration_seconds_sum{service=\"bitcoind\",method=\"getblockchaininfo\"} 0.003000\n", out);
+    try tt.expectSubstring("nd_rpc_duration_seconds_bucket{service=\"bitcoind\",method=\"batch\",le=\"+Inf\"} 1\n", out);
+    try tt.expectSubstring("nd_rpc_errors_total{service=\"bitcoind\",method=\"batch\"} 1\n", out);
+    try tt.expectSubstring("nd_rpc_duration_seconds_bucket{service=\"lnd\",method=\"getinfo\",le=\"0.000000\"} 1\n", out);
+    try tt.expectSubstring("nd_report_last_success_timestamp_seconds{report=\"onchain\"} 1700000000\n", out);
+    try tt.expectSubstring("nd_report_unchanged_total{report=\"onchain\"} 1\n", out);
+    try tt.expectSubstring("nd_ui_report_collected_timestamp_seconds{report=\"lightning\"} 0\n", out);
+    try tt.expectNoSubstring("method=\"walletbalance\",le=", out); // no values
+    try tt.expectNoSubstring("nd_comm_write_duration_seconds_count", out);
+
+    m.recordCommWrite(time.nanoTimestamp());
+    buf.clearRetainingCapacity();
+    try m.write(buf.writer());
+    try tt.expectSubstring("nd_comm_write_duration_seconds_count 1\n", buf.items);
+    try tt.expectNoSubstring("nd_service_up", buf.items);
+    try tt.expectNoSubstring("nd_cpufreq_governor{", buf.items);
+
+    m.recordGovernor(.powersave);
+    buf.clearRetainingCapacity();
+    try m.write(buf.writer());
+    try tt.expectSubstring("nd_cpufreq_governor_switches_total{governor=\"powersave\"} 1\n", buf.items);
+    try tt.expectSubstring("nd_cpufreq_governor{governor=\"powersave\"} 1\n", buf.items);
+    try tt.expectNoSubstring("nd_ibd_eviction_sync_rate_ratio", buf.items);
+
+    m.recordEviction(.outbound);
+    m.recordEvictionGain(1.25);
+    buf.clearRetainingCapacity();
+    try m.write(buf.writer());
+    try tt.expectSubstring("nd_ibd_peer_evictions_total{kind=\"outbound\"} 1\n", buf.items);
+    try tt.expectSubstring("nd_ibd_peer_evictions_total{kind=\"inbound\"} 0\n", buf.items);
+    try tt.expectSubstring("nd_ibd_eviction_sync_rate_ratio 1.250\n", buf.items);
+    try tt.expectNoSubstring("nd_tor_bootstrap_percent", buf.items);
+
+    m.recordTorBootstrap(85);
+    m.recordTorCircuit(1500 * time.ns_per_ms);
+    m.recordTorCircuit(null);
+    buf.clearRetainingCapacity();
+    try m.write(buf.writer());
+    try tt.expectSubstring("nd_tor_bootstrap_percent 85\n", buf.items);
+    try tt.expectSubstring("nd_tor_circuit_build_duration_seconds_sum 1.500000\n", buf.items);
+    try tt.expectSubstring("nd_tor_circuit_failures_total 1\n", buf.items);
+    try tt.expectSubstring("nd_heap_live_bytes{subsystem=\"config\"} ", buf.items);
+
+    var s = Sampler.Sample{ .time = 1, .throttled = 0x50005 };
+    s.services.appendAssumeCapacity(.{ .name = "lnd", .pid = 42, .cpu_ticks = 1234, .rss = 4096, .io = .{ .read = 1, .write = 2 } });
+    s.services.appendAssumeCapacity(.{ .name = "bitcoind", .pid = 0 });
+    s.disks.appendAssumeCapacity(.{ .name = try std.BoundedArray(u8, 32).fromSlice("sda"), .read = 512, .write = 1024, .io_ms = 1500 });
+    s.temps.appendAssumeCapacity(52123);
+    m.recordSystem(&s);
+    buf.clearRetainingCapacity();
+    try m.write(buf.writer());
+    try tt.expectSubstring("nd_service_up{service=\"bitcoind\"} 0\n", buf.items);
+    try tt.expectSubstring("nd_service_cpu_seconds_total{service=\"lnd\"} 12.34\n", buf.items);
+    try tt.expectSubstring("nd_service_storage_bytes_total{service=\"lnd\",op=\"write\"} 2\n", buf.items);
+    try tt.expectNoSubstring("nd_service_storage_bytes_total{service=\"bitcoind\"", buf.items);
+    try tt.expectSubstring("nd_disk_io_time_seconds_total{device=\"sda\"} 1.500\n", buf.items);
+    try tt.expectSubstring("nd_thermal_zone_celsius{zone=\"0\"} 52.123\n", buf.items);
+    try tt.expectSubstring("nd_cpu_throttled_state 327685\n", buf.items);
+    try tt.expectNoSubstring("nd_zram_bytes", buf.items);
+
+    m.recordZram(.{ .orig_bytes = 3000, .compr_bytes = 1200, .mem_used = 1300, .swap_in = 5, .swap_out = 50 });
+    buf.clearRetainingCapacity();
+    try m.write(buf.writer());
+    try tt.expectSubstring("nd_zram_bytes{kind=\"compr\"} 1200\n", buf.items);
+    try tt.expectSubstring("nd_zram_compression_ratio 2.500\n", buf.items);
+    try tt.expectSubstring("nd_swap_pages_total{dir=\"out\"} 50\n", buf.items);
+}
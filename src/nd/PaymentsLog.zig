@@ -0,0 +1,332 @@
+//! on-device history of settled lightning invoices and succeeded payments,
+//! synced from lnd incrementally and served to ngui a page at a time.
+//!
+//! lnd lists invoices by add_index and payments by payment_index. each source
+//! has a persisted cursor: the index up to which all its items are final,
+//! settled or failed, so that a sync lists only items past it. items still
+//! open or in flight are listed again by the next syncs until they are final;
+//! settled items past the cursor are kept in `seen` to be appended only once.
+//! after the first sync, the cost of a sync is thus proportional to the number
+//! of new and open items, not the size of the history.
+//!
+//! records are fixed size and only ever appended to the file, followed by an
+//! update of the cursors in the header. the seen sets are rebuilt on open from
+//! the records past the cursors, which makes a crash in between harmless.
+//! a page is read straight from the file at an offset computed from its index.
+//! safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+
+const logger = std.log.scoped(.payments);
+
+pub const Source = enum(u8) { invoices, payments };
+const nsources = @typeInfo(Source).Enum.fields.len;
+
+/// max number of items in a page.
+pub const max_page = 100;
+/// max length of an invoice memo in a record; longer ones are truncated.
+const max_memo = 88;
+
+allocator: std.mem.Allocator,
+file: std.fs.File,
+mu: std.Thread.Mutex = .{},
+/// number of records in the file.
+count: usize = 0,
+cursors: [nsources]u64 = .{0} ** nsources,
+/// indices of records past the cursors, appended ahead of open items.
+seen: [nsources]std.AutoHashMapUnmanaged(u64, void) = .{.{}} ** nsources,
+/// whether the sync in progress has passed an open item; see merge.
+blocked: [nsources]bool = .{false} ** nsources,
+
+const PaymentsLog = @This();
+
+/// the file is re-initialized if its header doesn't match.
+const Header = extern struct {
+    magic: [4]u8 = "ndpl".*,
+    version: u32 = 1,
+    record_size: u32 = @sizeOf(Record),
+    reserved: u32 = 0,
+    cursors: [nsources]u64 = .{0} ** nsources,
+};
+
+const Record = extern struct {
+    source: u8, // Source
+    memo_len: u8,
+    reserved: [6]u8 = .{0} ** 6,
+    index: u64, // add_index or payment_index
+    time: i64, // unix seconds
+    amount_msat: i64,
+    fee_msat: i64,
+    memo: [max_memo]u8,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(Record) == 128);
+}
+
+/// an invoice or payment as listed by lnd.
+pub const Item = struct {
+    index: u64,
+    state: enum { open, settled, failed }, // open includes in flight payments
+    time: i64, // unix seconds: settlement or creation
+    amount_msat: i64,
+    fee_msat: i64 = 0,
+    memo: []const u8 = "",
+};
+
+/// opens or creates the history file at path, including its parent directories.
+/// callers must close when done.
+pub fn open(allocator: std.mem.Allocator, path: []const u8) !PaymentsLog {
+    if (std.fs.path.dirname(path)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+    const file = try std.fs.cwd().createFile(path, .{ .read = true, .truncate = false });
+    errdefer file.close();
+    var self = PaymentsLog{ .allocator = allocator, .file = file };
+    errdefer for (&self.seen) |*s| s.deinit(allocator);
+
+    const size = (try file.stat()).size;
+    var hdr: Header = undefined;
+    const n = try file.preadAll(std.mem.asBytes(&hdr), 0);
+    var want = Header{};
+    want.cursors = hdr.cursors;
+    if (n < @sizeOf(Header) or !std.meta.eql(hdr, want)) {
+        if (size != 0) {
+            logger.warn("{s}: unknown format; starting a new payments history", .{path});
+        }
+        try file.setEndPos(0);
+        try file.pwriteAll(std.mem.asBytes(&Header{}), 0);
+        return self;
+    }
+    self.cursors = hdr.cursors;
+    self.count = (size - @sizeOf(Header)) / @sizeOf(Record);
+    const end = @sizeOf(Header) + self.count * @sizeOf(Record);
+    if (end != size) {
+        logger.warn("{s}: dropping a partially written record", .{path});
+        try file.setEndPos(end);
+    }
+
+    try file.seekTo(@sizeOf(Header));
+    var br = std.io.bufferedReader(file.reader());
+    for (0..self.count) |_| {
+        var rec: Record = undefined;
+        try br.reader().readNoEof(std.mem.asBytes(&rec));
+        if (rec.source >= nsources) {
+            return error.PaymentsLogCorrupted;
+        }
+        if (rec.index > self.cursors[rec.source]) {
+            try self.seen[rec.source].put(allocator, rec.index, {});
+        }
+    }
+    return self;
+}
+
+pub fn close(self: *PaymentsLog) void {
+    for (&self.seen) |*s| s.deinit(self.allocator);
+    self.file.close();
+}
+
+/// starts a sync of src and returns its cursor, the index_offset to start
+/// listing lnd items at.
+pub fn beginSync(self: *PaymentsLog, src: Source) u64 {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.blocked[@intFromEnum(src)] = false;
+    return self.cursors[@intFromEnum(src)];
+}
+
+/// folds a page of src items listed in index order into the history, the next
+/// page of the sync started with beginSync. settled items not appended before
+/// are appended; the cursor advances over final items up to the first open
+/// one of the sync. returns the number of appended records.
+pub fn merge(self: *PaymentsLog, src: Source, items: []const Item) !usize {
+    const s = @intFromEnum(src);
+    self.mu.lock();
+    defer self.mu.unlock();
+
+    var recs = std.ArrayList(Record).init(self.allocator);
+    defer recs.deinit();
+    var cursor = self.cursors[s];
+    for (items) |it| {
+        if (it.index <= cursor) {
+            continue;
+        }
+        if (it.state == .open) {
+            self.blocked[s] = true;
+            continue;
+        }
+        if (it.state == .settled and !self.seen[s].contains(it.index)) {
+            try recs.append(record(src, it));
+        }
+        if (!self.blocked[s]) {
+            cursor = it.index;
+        }
+    }
+
+    if (recs.items.len > 0) {
+        try self.seen[s].ensureUnusedCapacity(self.allocator, @intCast(recs.items.len));
+        try self.file.pwriteAll(std.mem.sliceAsBytes(recs.items), @sizeOf(Header) + self.count * @sizeOf(Record));
+        self.count += recs.items.len;
+        for (recs.items) |rec| {
+            if (rec.index > cursor) {
+                self.seen[s].putAssumeCapacity(rec.index, {});
+            }
+        }
+    }
+    if (cursor != self.cursors[s]) {
+        var hdr = Header{ .cursors = self.cursors };
+        hdr.cursors[s] = cursor;
+        try self.file.pwriteAll(std.mem.asBytes(&hdr), 0);
+        self.cursors[s] = cursor;
+        self.pruneSeen(s);
+    }
+    return recs.items.len;
+}
+
+fn record(src: Source, it: Item) Record {
+    var rec = Record{
+        .source = @intFromEnum(src),
+        .memo_len = 0,
+        .index = it.index,
+        .time = it.time,
+        .amount_msat = it.amount_msat,
+        .fee_msat = it.fee_msat,
+        .memo = undefined,
+    };
+    var n = @min(it.memo.len, max_memo);
+    // don't cut a UTF-8 sequence in the middle.
+    while (n < it.memo.len and n > 0 and it.memo[n] & 0xc0 == 0x80) {
+        n -= 1;
+    }
+    @memset(&rec.memo, 0);
+    @memcpy(rec.memo[0..n], it.memo[0..n]);
+    rec.memo_len = @intCast(n);
+    return rec;
+}
+
+/// drops indices the cursor of source s has passed. caller holds self.mu.
+fn pruneSeen(self: *PaymentsLog, s: usize) void {
+    var stale = std.ArrayList(u64).init(self.allocator);
+    defer stale.deinit();
+    var it = self.seen[s].keyIterator();
+    while (it.next()) |index| {
+        if (index.* <= self.cursors[s]) {
+            stale.append(index.*) catch return; // retried on the next prune
+        }
+    }
+    for (stale.items) |index| {
+        _ = self.seen[s].remove(index);
+    }
+}
+
+/// returns the page of history items for the query q, newest first,
+/// allocated with the allocator; an arena is best.
+pub fn page(self: *PaymentsLog, allocator: std.mem.Allocator, q: comm.Message.LightningPaymentsQuery) !comm.Message.LightningPaymentsPage {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const start = @min(q.offset, self.count);
+    const end = @min(start + @min(q.limit, max_page), self.count);
+    const recs = try allocator.alloc(Record, end - start);
+    defer allocator.free(recs);
+    const bytes = std.mem.sliceAsBytes(recs);
+    // newest first: items start..end are records count-end..count-start, reversed.
+    if (try self.file.preadAll(bytes, @sizeOf(Header) + (self.count - end) * @sizeOf(Record)) != bytes.len) {
+        return error.EndOfStream;
+    }
+    const out = try allocator.alloc(comm.Message.LightningPayment, recs.len);
+    for (out, 0..) |*p, i| {
+        const rec = recs[recs.len - 1 - i];
+        p.* = .{
+            .dir = if (rec.source == @intFromEnum(Source.invoices)) .received else .sent,
+            .time = @intCast(@max(rec.time, 0)),
+            .amount = rec.amount_msat,
+            .fee = rec.fee_msat,
+            .memo = try allocator.dupe(u8, rec.memo[0..@min(rec.memo_len, max_memo)]),
+        };
+    }
+    var served = q;
+    served.offset = @intCast(start);
+    served.limit = @intCast(end - start);
+    return .{ .query = served, .total = @intCast(self.count), .payments = out };
+}
+
+test "payments log sync and pages" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "sub", "payments.bin" });
+    defer t.allocator.free(path);
+
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    {
+        var plog = try open(t.allocator, path);
+        defer plog.close();
+        try t.expectEqual(@as(u64, 0), plog.beginSync(.invoices));
+        try t.expectEqual(@as(usize, 2), try plog.merge(.invoices, &.{
+            .{ .index = 1, .state = .settled, .time = 100, .amount_msat = 1000, .memo = "coffee" },
+            .{ .index = 2, .state = .open, .time = 0, .amount_msat = 0 },
+            .{ .index = 3, .state = .settled, .time = 300, .amount_msat = 3000 },
+            .{ .index = 4, .state = .failed, .time = 0, .amount_msat = 0 },
+        }));
+        // the cursor stops ahead of the open invoice.
+        try t.expectEqual(@as(u64, 1), plog.cursors[0]);
+        _ = plog.beginSync(.payments);
+        try t.expectEqual(@as(usize, 1), try plog.merge(.payments, &.{
+            .{ .index = 1, .state = .settled, .time = 200, .amount_msat = 500, .fee_msat = 1 },
+        }));
+    }
+
+    // reopen: the history and cursors persist, and the invoice appended
+    // past the cursor is not appended again.
+    var plog = try open(t.allocator, path);
+    defer plog.close();
+    try t.expectEqual(@as(usize, 3), plog.count);
+    try t.expectEqual(@as(u64, 1), plog.beginSync(.invoices));
+    try t.expectEqual(@as(usize, 2), try plog.merge(.invoices, &.{
+        .{ .index = 2, .state = .settled, .time = 400, .amount_msat = 2000 },
+        .{ .index = 3, .state = .settled, .time = 300, .amount_msat = 3000 },
+        .{ .index = 4, .state = .failed, .time = 0, .amount_msat = 0 },
+        .{ .index = 5, .state = .settled, .time = 500, .amount_msat = 5000 },
+    }));
+    try t.expectEqual(@as(u64, 5), plog.cursors[0]);
+    try t.expectEqual(@as(u32, 0), plog.seen[0].count());
+    try t.expectEqual(@as(u64, 1), plog.beginSync(.payments));
+
+    const p1 = try plog.page(arena, .{ .offset = 0, .limit = 2 });
+    try t.expectEqual(@as(u32, 5), p1.total);
+    try t.expectEqual(@as(usize, 2), p1.payments.len);
+    try t.expectEqual(@as(i64, 5000), p1.payments[0].amount);
+    try t.expectEqual(@as(i64, 2000), p1.payments[1].amount);
+
+    const p2 = try plog.page(arena, .{ .offset = 2, .limit = 10 });
+    try t.expectEqual(@as(u32, 2), p2.query.offset);
+    try t.expectEqual(@as(u32, 3), p2.query.limit);
+    try t.expect(p2.payments[0].dir == .sent);
+    try t.expectEqual(@as(i64, 1), p2.payments[0].fee);
+    try t.expect(p2.payments[2].dir == .received);
+    try t.expectEqualStrings("coffee", p2.payments[2].memo);
+    try t.expectEqual(@as(u64, 100), p2.payments[2].time);
+
+    const p3 = try plog.page(arena, .{ .offset = 10 });
+    try t.expectEqual(@as(usize, 0), p3.payments.len);
+    try t.expectEqual(@as(u32, 5), p3.query.offset);
+}
+
+test "payments log memo truncation" {
+    const t = std.testing;
+
+    const long = "ä" ** 60; // 120 bytes
+    const rec = record(.invoices, .{ .index = 1, .state = .settled, .time = 0, .amount_msat = 0, .memo = long });
+    try t.expectEqual(@as(u8, 88), rec.memo_len);
+    try t.expect(std.unicode.utf8ValidateSlice(rec.memo[0..rec.memo_len]));
+    const odd = "a" ++ "ä" ** 60;
+    const rec2 = record(.invoices, .{ .index = 1, .state = .settled, .time = 0, .amount_msat = 0, .memo = odd });
+    try t.expectEqual(@as(u8, 87), rec2.memo_len);
+}
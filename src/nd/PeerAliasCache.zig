@@ -0,0 +1,166 @@
+//! lightning peer pubkey to alias cache with time-based expiry.
+//! lnd's listchannels alias lookup carries a performance penalty on nodes with
+//! many channels. instead, the daemon looks up aliases here while assembling
+//! lightning reports, and refreshes unknown or expired entries separately
+//! using getnodeinfo.
+//! safe for concurrent use.
+
+const std = @import("std");
+
+allocator: std.mem.Allocator,
+ttl: i64, // entry lifetime, in milliseconds
+
+/// guards all fields below.
+mu: std.Thread.Mutex = .{},
+/// keys and aliases are owned by the cache.
+map: std.StringHashMapUnmanaged(Entry) = .{},
+
+const PeerAliasCache = @This();
+
+const Entry = struct {
+    alias: []const u8, // empty if unknown
+    expires: i64, // ms timestamp; 0 if never fetched
+    used: i64, // last lookup ms timestamp
+};
+
+/// ttl is the alias lifetime in milliseconds after which it is refreshed.
+/// entries unused for longer than twice the ttl are evicted.
+pub fn init(allocator: std.mem.Allocator, ttl: i64) PeerAliasCache {
+    return .{ .allocator = allocator, .ttl = ttl };
+}
+
+pub fn deinit(self: *PeerAliasCache) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    var it = self.map.iterator();
+    while (it.next()) |kv| {
+        self.allocator.free(kv.key_ptr.*);
+        self.allocator.free(kv.value_ptr.alias);
+    }
+    self.map.deinit(self.allocator);
+}
+
+/// returns a cached alias dup'ed using the allocator, or an empty string if unknown.
+/// unknown and expired pubkeys are marked for refresh; see staleKeys.
+pub fn lookup(self: *PeerAliasCache, allocator: std.mem.Allocator, pubkey: []const u8, now: i64) ![]const u8 {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.map.getPtr(pubkey)) |e| {
+        e.used = now;
+        return allocator.dupe(u8, e.alias);
+    }
+    const key = try self.allocator.dupe(u8, pubkey);
+    errdefer self.allocator.free(key);
+    try self.map.put(self.allocator, key, .{ .alias = &.{}, .expires = 0, .used = now });
+    return &.{};
+}
+
+/// returns up to max pubkeys which are unknown or expired, in no particular order.
+/// also evicts entries unused for too long.
+/// caller owns returned value, allocated using the allocator; see freeKeys.
+pub fn staleKeys(self: *PeerAliasCache, allocator: std.mem.Allocator, max: usize, now: i64) ![]const []const u8 {
+    self.mu.lock();
+    defer self.mu.unlock();
+
+    // evict first so the removed keys are not returned.
+    var evict = std.ArrayList([]const u8).init(allocator);
+    defer evict.deinit();
+    var it = self.map.iterator();
+    while (it.next()) |kv| {
+        if (kv.value_ptr.used < now - 2 * self.ttl) {
+            try evict.append(kv.key_ptr.*);
+        }
+    }
+    for (evict.items) |k| {
+        const kv = self.map.fetchRemove(k) orelse continue;
+        self.allocator.free(kv.value.alias);
+        self.allocator.free(kv.key);
+    }
+
+    var keys = std.ArrayList([]const u8).init(allocator);
+    errdefer {
+        for (keys.items) |k| allocator.free(k);
+        keys.deinit();
+    }
+    it = self.map.iterator();
+    while (it.next()) |kv| {
+        if (keys.items.len >= max) {
+            break;
+        }
+        if (kv.value_ptr.expires <= now) {
+            try keys.append(try allocator.dupe(u8, kv.key_ptr.*));
+        }
+    }
+    return keys.toOwnedSlice();
+}
+
+/// releases keys returned by staleKeys.
+pub fn freeKeys(allocator: std.mem.Allocator, keys: []const []const u8) void {
+    for (keys) |k| allocator.free(k);
+    allocator.free(keys);
+}
+
+/// stores a freshly fetched alias, extending the entry lifetime by ttl.
+/// a null alias keeps the current value, for example when getnodeinfo failed.
+/// returns true if the alias changed.
+pub fn set(self: *PeerAliasCache, pubkey: []const u8, alias: ?[]const u8, now: i64) !bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const e = self.map.getPtr(pubkey) orelse return false; // evicted meanwhile
+    e.expires = now + self.ttl;
+    const newalias = alias orelse return false;
+    if (std.mem.eql(u8, e.alias, newalias)) {
+        return false;
+    }
+    const dup = try self.allocator.dupe(u8, newalias);
+    self.allocator.free(e.alias);
+    e.alias = dup;
+    return true;
+}
+
+test "peer alias cache" {
+    const t = std.testing;
+    var cache = PeerAliasCache.init(t.allocator, 100);
+    defer cache.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    try t.expectEqualStrings("", try cache.lookup(arena, "pk1", 10));
+    try t.expectEqualStrings("", try cache.lookup(arena, "pk2", 10));
+    {
+        const keys = try cache.staleKeys(t.allocator, 1, 10);
+        defer freeKeys(t.allocator, keys);
+        try t.expectEqual(@as(usize, 1), keys.len);
+    }
+    {
+        const keys = try cache.staleKeys(t.allocator, 10, 10);
+        defer freeKeys(t.allocator, keys);
+        try t.expectEqual(@as(usize, 2), keys.len);
+    }
+
+    try t.expect(try cache.set("pk1", "alias1", 20));
+    try t.expect(!try cache.set("pk1", "alias1", 20));
+    try t.expect(!try cache.set("pk2", null, 20)); // failed fetch
+    try t.expectEqualStrings("alias1", try cache.lookup(arena, "pk1", 30));
+    {
+        const keys = try cache.staleKeys(t.allocator, 10, 30);
+        defer freeKeys(t.allocator, keys);
+        try t.expectEqual(@as(usize, 0), keys.len);
+    }
+
+    // expired
+    {
+        const keys = try cache.staleKeys(t.allocator, 10, 120);
+        defer freeKeys(t.allocator, keys);
+        try t.expectEqual(@as(usize, 2), keys.len);
+    }
+    try t.expectEqualStrings("alias1", try cache.lookup(arena, "pk1", 200));
+    // pk2 is unused since 10 and evicted
+    {
+        const keys = try cache.staleKeys(t.allocator, 10, 215);
+        defer freeKeys(t.allocator, keys);
+        try t.expectEqual(@as(usize, 1), keys.len);
+        try t.expectEqualStrings("pk1", keys[0]);
+    }
+}
@@ -0,0 +1,259 @@
+//! slow peer eviction during bitcoind initial block download. blocks are
+//! validated in order, so a peer holding blocks of the download window but
+//! delivering them at a fraction of the pace of the others holds up the sync
+//! until bitcoind's own, much more patient, stall timeout kicks in.
+//! sampled from getpeerinfo on each onchain report, a peer found lagging in
+//! several samples in a row is picked for a disconnect, and bitcoind connects
+//! another in its place.
+//!
+//! only outbound full-relay and inbound peers are ever evicted: block-relay-only
+//! peers guard against eclipse attacks, and manual ones were added on purpose.
+//! evictions are rate limited and always leave a minimum of outbound peers.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+const bitcoindrpc = @import("../bitcoindrpc.zig");
+
+pub const max_peers = 128;
+
+/// peers as of the last sample.
+peers: std.BoundedArray(Peer, max_peers) = .{},
+/// time of the last sample, in ms; null until the first one.
+last_ms: ?i64 = null,
+/// time of the last eviction, in ms; 0 if none.
+evicted_ms: i64 = 0,
+/// start of the hourly evictions limit window, and evictions within it.
+window_ms: i64 = 0,
+window_count: u8 = 0,
+/// sync rate at the time of an eviction, until gain measures its effect.
+pending: ?struct { time_ms: i64, blocks_rate: f64 } = null,
+
+const PeerEvictor = @This();
+
+/// a peer is lagging if it delivers blocks at less than this fraction of
+/// the median rate of peers with blocks in flight, or delivers none.
+const slow_fraction = 0.1;
+/// consecutive lagging samples before a peer is evicted.
+const lagging_samples = 3;
+/// peers connected for less than this many seconds are left alone.
+const min_conn_age = 2 * std.time.s_per_min;
+/// peers with blocks in flight needed to tell what the median rate is.
+const min_downloading = 4;
+/// outbound full-relay peers are never evicted down below this count.
+const min_outbound = 6;
+/// min time between evictions, and max evictions per hour.
+const evict_interval_ms = 1 * std.time.ms_per_min;
+const max_per_hour = 6;
+/// time after an eviction the sync rate is compared to the one before.
+pub const gain_window_ms = 10 * std.time.ms_per_min;
+
+const Peer = struct {
+    id: u64,
+    bytes: u64, // bytesrecv_per_msg.block
+    lagging: u8 = 0, // consecutive lagging samples
+};
+
+pub const Kind = enum { inbound, outbound };
+
+pub const Eviction = struct {
+    id: u64,
+    addr: []const u8, // references the sampled getpeerinfo
+    kind: Kind,
+};
+
+/// forgets all peers and a pending gain measurement, for example once the
+/// download completes.
+pub fn reset(self: *PeerEvictor) void {
+    self.* = .{};
+}
+
+/// updates the peers block download rates from a getpeerinfo result and
+/// returns a peer to disconnect, if any. blocks_rate is the current sync
+/// rate, in blocks per second; see gain.
+pub fn sample(self: *PeerEvictor, now_ms: i64, blocks_rate: f64, infos: []const bitcoindrpc.PeerInfo) ?Eviction {
+    const prev = self.peers;
+    const dt_ms = if (self.last_ms) |t| now_ms - t else 0;
+    self.last_ms = now_ms;
+    self.peers.len = 0;
+
+    var rates: [max_peers]f64 = undefined;
+    var nrates: usize = 0;
+    if (dt_ms > 0) {
+        for (infos) |p| {
+            if (p.inflight.len == 0 or nrates == rates.len) {
+                continue;
+            }
+            const old = findPeer(prev.constSlice(), p.id) orelse continue;
+            rates[nrates] = blockRate(old, p, dt_ms);
+            nrates += 1;
+        }
+    }
+    // no lagging peers while all of them idle, as when bitcoind is busy
+    // validating or flushing its cache.
+    const median: f64 = blk: {
+        if (nrates < min_downloading) {
+            break :blk 0;
+        }
+        std.mem.sort(f64, rates[0..nrates], {}, std.sort.asc(f64));
+        break :blk rates[nrates / 2];
+    };
+
+    var outbound: usize = 0;
+    for (infos) |p| {
+        if (std.mem.eql(u8, p.connection_type, "outbound-full-relay")) {
+            outbound += 1;
+        }
+    }
+    const now_s = @divTrunc(now_ms, std.time.ms_per_s);
+    var worst: ?Eviction = null;
+    var worst_rate: f64 = 0;
+    for (infos) |p| {
+        if (self.peers.len == max_peers) {
+            break;
+        }
+        var peer = Peer{ .id = p.id, .bytes = p.bytesrecv_per_msg.block };
+        const old = findPeer(prev.constSlice(), p.id) orelse {
+            self.peers.appendAssumeCapacity(peer);
+            continue;
+        };
+        const rate = blockRate(old, p, dt_ms);
+        if (median > 0 and p.inflight.len > 0 and rate < median * slow_fraction) {
+            peer.lagging = old.lagging +| 1;
+        }
+        self.peers.appendAssumeCapacity(peer);
+
+        const kind = peerKind(p) orelse continue;
+        if (peer.lagging < lagging_samples or now_s - p.conntime < min_conn_age) {
+            continue;
+        }
+        if (kind == .outbound and outbound <= min_outbound) {
+            continue;
+        }
+        if (worst == null or rate < worst_rate) {
+            worst = .{ .id = p.id, .addr = p.addr, .kind = kind };
+            worst_rate = rate;
+        }
+    }
+
+    const victim = worst orelse return null;
+    if (self.evicted_ms != 0 and now_ms - self.evicted_ms < evict_interval_ms) {
+        return null;
+    }
+    if (now_ms - self.window_ms >= std.time.ms_per_hour) {
+        self.window_ms = now_ms;
+        self.window_count = 0;
+    }
+    if (self.window_count >= max_per_hour) {
+        return null;
+    }
+    self.window_count += 1;
+    self.evicted_ms = now_ms;
+    if (self.pending == null) {
+        self.pending = .{ .time_ms = now_ms, .blocks_rate = blocks_rate };
+    }
+    return victim;
+}
+
+/// returns the ratio of the current sync rate, in blocks per second, to
+/// the one at the time of an eviction gain_window_ms or more ago, if any.
+/// evictions within the window count towards the same measurement.
+pub fn gain(self: *PeerEvictor, now_ms: i64, blocks_rate: f64) ?f64 {
+    const p = self.pending orelse return null;
+    if (now_ms - p.time_ms < gain_window_ms) {
+        return null;
+    }
+    self.pending = null;
+    return if (p.blocks_rate > 0) blocks_rate / p.blocks_rate else null;
+}
+
+/// returns null for peers never to be evicted.
+fn peerKind(p: bitcoindrpc.PeerInfo) ?Kind {
+    if (std.mem.eql(u8, p.connection_type, "outbound-full-relay")) {
+        return .outbound;
+    }
+    if (std.mem.eql(u8, p.connection_type, "inbound")) {
+        return .inbound;
+    }
+    return null;
+}
+
+fn findPeer(peers: []const Peer, id: u64) ?Peer {
+    for (peers) |p| {
+        if (p.id == id) {
+            return p;
+        }
+    }
+    return null;
+}
+
+/// block bytes per second received since the previous sample.
+fn blockRate(old: Peer, p: bitcoindrpc.PeerInfo, dt_ms: i64) f64 {
+    if (dt_ms <= 0) {
+        return 0;
+    }
+    const bytes: f64 = @floatFromInt(p.bytesrecv_per_msg.block -| old.bytes);
+    return bytes * std.time.ms_per_s / @as(f64, @floatFromInt(dt_ms));
+}
+
+test "peer evictor" {
+    const t = std.testing;
+
+    const start_ms: i64 = 1700000000 * std.time.ms_per_s;
+    var infos: [10]bitcoindrpc.PeerInfo = undefined;
+    for (&infos, 0..) |*p, i| {
+        p.* = .{
+            .id = i,
+            .addr = "10.0.0.1:8333",
+            .inbound = false,
+            .connection_type = switch (i) {
+                8 => "block-relay-only",
+                9 => "manual",
+                else => "outbound-full-relay",
+            },
+            .conntime = 1690000000,
+            .inflight = &.{800000},
+        };
+    }
+    var ev = PeerEvictor{};
+    for (0..4) |n| {
+        for (infos[0..7]) |*p| {
+            p.bytesrecv_per_msg.block = n * 10_000_000;
+        }
+        const now = start_ms + @as(i64, @intCast(n)) * std.time.ms_per_min;
+        const got = ev.sample(now, 1.0, &infos);
+        if (n < 3) {
+            try t.expect(got == null);
+        } else {
+            // peers 7, 8 and 9 lag the same but only 7 may be evicted.
+            try t.expectEqual(@as(u64, 7), got.?.id);
+            try t.expectEqual(Kind.outbound, got.?.kind);
+        }
+    }
+    // still lagging but rate limited.
+    for (infos[0..7]) |*p| {
+        p.bytesrecv_per_msg.block += 5_000_000;
+    }
+    try t.expect(ev.sample(start_ms + 3 * std.time.ms_per_min + 30 * std.time.ms_per_s, 1.0, &infos) == null);
+
+    const later = start_ms + 3 * std.time.ms_per_min + gain_window_ms;
+    try t.expectEqual(@as(?f64, null), ev.gain(later - 1, 1.5));
+    try t.expectEqual(@as(?f64, 1.5), ev.gain(later, 1.5));
+    try t.expectEqual(@as(?f64, null), ev.gain(later, 1.5));
+
+    // no lagging while none of the peers deliver any blocks.
+    ev.reset();
+    for (0..5) |n| {
+        const now = start_ms + @as(i64, @intCast(n)) * std.time.ms_per_min;
+        try t.expect(ev.sample(now, 0, &infos) == null);
+    }
+    // nor below the min outbound peers.
+    ev.reset();
+    for (0..5) |n| {
+        for (infos[0..5]) |*p| {
+            p.bytesrecv_per_msg.block = 100_000_000 + n * 10_000_000;
+        }
+        const now = start_ms + @as(i64, @intCast(n)) * std.time.ms_per_min;
+        try t.expect(ev.sample(now, 0, infos[0..6]) == null);
+    }
+}
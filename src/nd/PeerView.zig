@@ -0,0 +1,256 @@
+//! connected lnd peers of the ngui peer view, refreshed with listpeers while
+//! the view is open. per-peer byte counters of consecutive refreshes are
+//! turned into rates. once the view has its full list, only the peers which
+//! changed or are gone since the last message are sent. a list younger than
+//! ttl_ns is served as is: reopening the view doesn't call lnd again.
+//! not safe for concurrent use.
+
+const std = @import("std");
+const time = std.time;
+
+const comm = @import("../comm.zig");
+const lndhttp = @import("../lightning/lndhttp.zig");
+const PeerAliasCache = @import("PeerAliasCache.zig");
+
+allocator: std.mem.Allocator,
+/// keyed by pubkey hex; keys owned.
+peers: std.StringArrayHashMapUnmanaged(Peer) = .{},
+/// pubkeys of the peers gone since the last message; owned.
+removed: std.ArrayListUnmanaged([]const u8) = .{},
+/// when the list was last refreshed, a Daemon.clock reading; null if never.
+refreshed_ns: ?u64 = null,
+
+const PeerView = @This();
+
+/// how long a refreshed list is served from cache, and so the refresh
+/// interval while the view is open.
+pub const ttl_ns = 5 * time.ns_per_s;
+
+const Peer = struct {
+    address: []const u8, // owned
+    inbound: bool,
+    ping_us: u64,
+    bytes_sent: u64,
+    bytes_recv: u64,
+    sent_bps: u64 = 0,
+    recv_bps: u64 = 0,
+    changed: bool = true, // since the last message
+    seen: bool = true, // in the latest refresh
+};
+
+pub fn init(allocator: std.mem.Allocator) PeerView {
+    return .{ .allocator = allocator };
+}
+
+pub fn deinit(self: *PeerView) void {
+    self.clear();
+    self.peers.deinit(self.allocator);
+    self.removed.deinit(self.allocator);
+}
+
+/// drops all peers, as when lnd is reset: the next refresh starts over.
+pub fn clear(self: *PeerView) void {
+    var it = self.peers.iterator();
+    while (it.next()) |e| {
+        self.allocator.free(e.key_ptr.*);
+        self.allocator.free(e.value_ptr.address);
+    }
+    self.peers.clearRetainingCapacity();
+    self.clearRemoved();
+    self.refreshed_ns = null;
+}
+
+fn clearRemoved(self: *PeerView) void {
+    for (self.removed.items) |k| {
+        self.allocator.free(k);
+    }
+    self.removed.clearRetainingCapacity();
+}
+
+/// reports whether the list was refreshed less than ttl_ns before now_ns.
+pub fn fresh(self: PeerView, now_ns: u64) bool {
+    const r = self.refreshed_ns orelse return false;
+    return now_ns -| r < ttl_ns;
+}
+
+/// returns ns until the list needs a refresh, 0 if it does already.
+pub fn untilStale(self: PeerView, now_ns: u64) u64 {
+    const r = self.refreshed_ns orelse return 0;
+    return ttl_ns -| (now_ns -| r);
+}
+
+/// merges a listpeers result obtained at now_ns. peers missing from the list
+/// are dropped and recorded as removed.
+pub fn update(self: *PeerView, list: []const lndhttp.PeersList.Peer, now_ns: u64) !void {
+    const elapsed: u64 = if (self.refreshed_ns) |r| now_ns -| r else 0;
+    for (self.peers.values()) |*v| {
+        v.seen = false;
+    }
+    for (list) |p| {
+        const ping_us: u64 = std.math.lossyCast(u64, p.ping_time);
+        const res = try self.peers.getOrPut(self.allocator, p.pub_key);
+        if (!res.found_existing) {
+            res.key_ptr.* = self.allocator.dupe(u8, p.pub_key) catch |err| {
+                self.peers.swapRemoveAt(res.index);
+                return err;
+            };
+            const address = self.allocator.dupe(u8, p.address) catch |err| {
+                self.allocator.free(res.key_ptr.*);
+                self.peers.swapRemoveAt(res.index);
+                return err;
+            };
+            res.value_ptr.* = .{
+                .address = address,
+                .inbound = p.inbound,
+                .ping_us = ping_us,
+                .bytes_sent = p.bytes_sent,
+                .bytes_recv = p.bytes_recv,
+            };
+            continue;
+        }
+        const v = res.value_ptr;
+        if (!std.mem.eql(u8, v.address, p.address)) {
+            const address = try self.allocator.dupe(u8, p.address);
+            self.allocator.free(v.address);
+            v.address = address;
+            v.changed = true;
+        }
+        const sent_bps = rate(v.bytes_sent, p.bytes_sent, elapsed);
+        const recv_bps = rate(v.bytes_recv, p.bytes_recv, elapsed);
+        if (sent_bps != v.sent_bps or recv_bps != v.recv_bps or ping_us != v.ping_us or p.inbound != v.inbound) {
+            v.changed = true;
+        }
+        v.inbound = p.inbound;
+        v.ping_us = ping_us;
+        v.bytes_sent = p.bytes_sent;
+        v.bytes_recv = p.bytes_recv;
+        v.sent_bps = sent_bps;
+        v.recv_bps = recv_bps;
+        v.seen = true;
+    }
+
+    try self.removed.ensureUnusedCapacity(self.allocator, self.peers.count() -| list.len);
+    var i: usize = self.peers.count();
+    while (i > 0) {
+        i -= 1;
+        const v = self.peers.values()[i];
+        if (v.seen) {
+            continue;
+        }
+        self.removed.appendAssumeCapacity(self.peers.keys()[i]); // ownership moves
+        self.allocator.free(v.address);
+        self.peers.swapRemoveAt(i);
+    }
+    self.refreshed_ns = now_ns;
+}
+
+/// returns bytes per second between two readings of a counter elapsed_ns
+/// apart. a counter going back is that of a new connection.
+fn rate(prev: u64, cur: u64, elapsed_ns: u64) u64 {
+    if (elapsed_ns == 0 or cur < prev) {
+        return 0;
+    }
+    return std.math.lossyCast(u64, @as(u128, cur - prev) * time.ns_per_s / elapsed_ns);
+}
+
+/// returns the message of the view: all peers if full, or else those changed
+/// or gone since the last message, or null if none. aliases are looked up in
+/// the cache at now_ms, marking unknown ones for refresh. peers are then
+/// marked sent. the message is allocated in arena, referencing the view:
+/// it is valid until the next update.
+pub fn message(self: *PeerView, arena: std.mem.Allocator, full: bool, aliases: *PeerAliasCache, now_ms: i64) !?comm.Message.LightningPeers {
+    var list = std.ArrayList(comm.Message.LightningPeer).init(arena);
+    var it = self.peers.iterator();
+    while (it.next()) |e| {
+        const v = e.value_ptr;
+        if (!full and !v.changed) {
+            continue;
+        }
+        try list.append(.{
+            .pubkey = e.key_ptr.*,
+            .alias = try aliases.lookup(arena, e.key_ptr.*, now_ms),
+            .address = v.address,
+            .inbound = v.inbound,
+            .ping_us = v.ping_us,
+            .bytes_sent = v.bytes_sent,
+            .bytes_recv = v.bytes_recv,
+            .sent_bps = v.sent_bps,
+            .recv_bps = v.recv_bps,
+        });
+    }
+    if (!full and list.items.len == 0 and self.removed.items.len == 0) {
+        return null;
+    }
+    const removed = try arena.alloc([]const u8, if (full) 0 else self.removed.items.len);
+    for (removed, 0..) |*k, i| {
+        k.* = try arena.dupe(u8, self.removed.items[i]);
+    }
+    for (self.peers.values()) |*v| {
+        v.changed = false;
+    }
+    self.clearRemoved();
+    return .{ .full = full, .peers = list.items, .removed = removed };
+}
+
+test "peer view" {
+    const t = std.testing;
+    const s = time.ns_per_s;
+    var aliases = PeerAliasCache.init(t.allocator, 1 * time.ms_per_hour);
+    defer aliases.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+    _ = try aliases.lookup(arena, "a", 0);
+    _ = try aliases.set("a", "alice", 0);
+
+    var v = PeerView.init(t.allocator);
+    defer v.deinit();
+    try t.expect(!v.fresh(0));
+    try t.expectEqual(@as(u64, 0), v.untilStale(0));
+
+    try v.update(&.{
+        .{ .pub_key = "a", .address = "1.2.3.4:9735", .bytes_sent = 100, .bytes_recv = 1000, .ping_time = 250 },
+        .{ .pub_key = "b", .address = "x.onion:9735", .bytes_sent = 0, .bytes_recv = 0, .inbound = true },
+    }, 10 * s);
+    try t.expect(v.fresh(14 * s));
+    try t.expect(!v.fresh(15 * s));
+    try t.expectEqual(@as(u64, 2 * s), v.untilStale(13 * s));
+
+    var msg = (try v.message(arena, true, &aliases, 0)).?;
+    try t.expect(msg.full);
+    try t.expectEqual(@as(usize, 2), msg.peers.len);
+    try t.expectEqualStrings("alice", msg.peers[0].alias);
+    try t.expectEqualStrings("", msg.peers[1].alias); // unknown yet
+    try t.expectEqual(@as(u64, 250), msg.peers[0].ping_us);
+    try t.expect(msg.peers[1].inbound);
+    try t.expect((try v.message(arena, false, &aliases, 0)) == null); // nothing changed
+
+    // a's traffic turns into rates, b is gone and c is new.
+    try v.update(&.{
+        .{ .pub_key = "a", .address = "1.2.3.4:9735", .bytes_sent = 600, .bytes_recv = 6000, .ping_time = 250 },
+        .{ .pub_key = "c", .address = "5.6.7.8:9735", .bytes_sent = 1, .bytes_recv = 2 },
+    }, 15 * s);
+    msg = (try v.message(arena, false, &aliases, 0)).?;
+    try t.expect(!msg.full);
+    try t.expectEqual(@as(usize, 2), msg.peers.len);
+    try t.expectEqualStrings("a", msg.peers[0].pubkey);
+    try t.expectEqual(@as(u64, 100), msg.peers[0].sent_bps);
+    try t.expectEqual(@as(u64, 1000), msg.peers[0].recv_bps);
+    try t.expectEqualStrings("c", msg.peers[1].pubkey);
+    try t.expectEqual(@as(usize, 1), msg.removed.len);
+    try t.expectEqualStrings("b", msg.removed[0]);
+
+    // a reconnected: its counters start over.
+    try v.update(&.{
+        .{ .pub_key = "a", .address = "1.2.3.4:9735", .bytes_sent = 10, .bytes_recv = 10, .ping_time = 250 },
+        .{ .pub_key = "c", .address = "5.6.7.8:9735", .bytes_sent = 1, .bytes_recv = 2 },
+    }, 20 * s);
+    msg = (try v.message(arena, false, &aliases, 0)).?;
+    try t.expectEqual(@as(usize, 1), msg.peers.len);
+    try t.expectEqual(@as(u64, 0), msg.peers[0].sent_bps);
+    try t.expectEqual(@as(usize, 0), msg.removed.len);
+
+    v.clear();
+    try t.expect(!v.fresh(20 * s));
+    try t.expectEqual(@as(usize, 0), v.peers.count());
+}
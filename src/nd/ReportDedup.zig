@@ -0,0 +1,111 @@
+//! suppression of periodic reports identical to the last one sent. nd
+//! collects an onchain report every minute, yet a quiet minute between blocks
+//! with a stable mempool changes nothing ngui shows: skipping it saves the
+//! pipe write and the UI work of applying it.
+//!
+//! reports are compared by a hash of their json encoding, canonical for a
+//! given build. an unchanged report is still sent once heartbeat_ns passed
+//! since the last send, so that a report older than that tells ngui and
+//! subscribers it's stale rather than unchanged.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+
+const comm = @import("../comm.zig");
+
+/// max time an unchanged report is held back for.
+pub const heartbeat_ns = 10 * std.time.ns_per_min;
+
+pub const max_kinds = 8;
+
+mu: std.Thread.Mutex = .{},
+/// the last report of each kind sent; guarded by mu.
+sent: std.BoundedArray(Sent, max_kinds) = .{},
+
+const ReportDedup = @This();
+
+const Sent = struct {
+    tag: comm.MessageTag,
+    hash: u64,
+    time_ns: u64, // a Daemon.clock reading
+};
+
+/// reports whether msg is to be sent at now_ns, a monotonic clock reading,
+/// and records it as sent if so: it differs from the last one sent or the
+/// heartbeat is due. see forget for failed sends.
+pub fn check(self: *ReportDedup, msg: comm.Message, now_ns: u64) bool {
+    const h = hash(msg);
+    self.mu.lock();
+    defer self.mu.unlock();
+    const tag = std.meta.activeTag(msg);
+    for (self.sent.slice()) |*s| {
+        if (s.tag != tag) {
+            continue;
+        }
+        if (s.hash == h and now_ns -| s.time_ns < heartbeat_ns) {
+            return false;
+        }
+        s.* = .{ .tag = tag, .hash = h, .time_ns = now_ns };
+        return true;
+    }
+    self.sent.append(.{ .tag = tag, .hash = h, .time_ns = now_ns }) catch {}; // never skipped
+    return true;
+}
+
+/// makes the next report of the tag be sent regardless, such as after
+/// a failed send.
+pub fn forget(self: *ReportDedup, tag: comm.MessageTag) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (self.sent.constSlice(), 0..) |s, i| {
+        if (s.tag == tag) {
+            _ = self.sent.swapRemove(i);
+            return;
+        }
+    }
+}
+
+/// makes the next report of every kind be sent regardless, such as once
+/// ngui restarted.
+pub fn reset(self: *ReportDedup) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.sent.len = 0;
+}
+
+/// returns the hash of the msg payload json encoding.
+fn hash(msg: comm.Message) u64 {
+    var hasher = std.hash.Wyhash.init(0);
+    const w = std.io.Writer(*std.hash.Wyhash, error{}, hashWrite){ .context = &hasher };
+    switch (msg) {
+        inline else => |v| if (@TypeOf(v) != void) {
+            std.json.stringify(v, .{}, w) catch unreachable;
+        },
+    }
+    return hasher.final();
+}
+
+fn hashWrite(hasher: *std.hash.Wyhash, bytes: []const u8) error{}!usize {
+    hasher.update(bytes);
+    return bytes.len;
+}
+
+test "report dedup" {
+    const t = std.testing;
+
+    var dd = ReportDedup{};
+    const a = comm.Message{ .bitcoind_startup = .{ .phase = "loading", .progress = 10 } };
+    const b = comm.Message{ .bitcoind_startup = .{ .phase = "loading", .progress = 11 } };
+    const now: u64 = 100 * std.time.ns_per_s;
+    try t.expect(dd.check(a, now));
+    try t.expect(!dd.check(a, now + 1));
+    try t.expect(dd.check(b, now + 2));
+    try t.expect(!dd.check(b, now + heartbeat_ns));
+    try t.expect(dd.check(b, now + 2 + heartbeat_ns)); // heartbeat
+    try t.expect(!dd.check(b, now + 3 + heartbeat_ns));
+    dd.forget(.bitcoind_startup);
+    try t.expect(dd.check(b, now + 4 + heartbeat_ns));
+    dd.reset();
+    try t.expect(dd.check(b, now + 5 + heartbeat_ns));
+}
@@ -0,0 +1,336 @@
+//! the last onchain and lightning reports, kept across restarts so that ngui
+//! shows the node as last known within a second of boot, long before bitcoind
+//! leaves warmup or lnd is unlocked.
+//!
+//! the file starts with a magic, followed by an entry per report kind: the
+//! unix time the report was collected at, as u64 little endian, and the report
+//! as a comm frame with a binary payload. a file unreadable as such, written
+//! by a different build for example, is ignored.
+//!
+//! update encodes a report in memory and returns; a writer thread of its own
+//! replaces the file atomically, at most once per write_interval_ms and once
+//! more on stop, so that the report threads never wait on storage.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+const time = std.time;
+
+const comm = @import("../comm.zig");
+const types = @import("../types.zig");
+
+const logger = std.log.scoped(.snapshot);
+
+allocator: std.mem.Allocator,
+path: []const u8,
+mu: std.Thread.Mutex = .{},
+cond: std.Thread.Condition = .{},
+/// encoded reports and the time they were collected at; guarded by mu.
+entries: [nkinds]Entry,
+dirty: bool = false, // entries changed since the last write; guarded by mu
+want_stop: bool = false, // guarded by mu
+thread: ?std.Thread = null,
+
+const ReportSnapshot = @This();
+
+pub const Kind = enum { onchain, lightning };
+const nkinds = @typeInfo(Kind).Enum.fields.len;
+
+const Entry = struct {
+    collected: u64 = 0, // unix epoch; 0 if frame is empty
+    frame: types.ByteArrayList,
+    restored: bool = false, // read from the file of a previous run
+};
+
+const magic = "ndreports1\n";
+
+/// min time between file writes: each rewrites all reports.
+const write_interval_ms = 5 * time.ms_per_min;
+
+/// the path is referenced, not owned. release resources with deinit.
+pub fn init(allocator: std.mem.Allocator, path: []const u8) ReportSnapshot {
+    var self = ReportSnapshot{ .allocator = allocator, .path = path, .entries = undefined };
+    for (&self.entries) |*e| {
+        e.* = .{ .frame = types.ByteArrayList.init(allocator) };
+    }
+    return self;
+}
+
+/// the writer thread must be stopped.
+pub fn deinit(self: *ReportSnapshot) void {
+    for (&self.entries) |*e| {
+        e.frame.deinit();
+    }
+}
+
+/// spawns the writer thread.
+pub fn start(self: *ReportSnapshot) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.thread != null) {
+        return;
+    }
+    self.want_stop = false;
+    self.thread = try std.Thread.spawn(.{}, loop, .{self});
+}
+
+/// writes out pending updates, if any, and joins the writer thread.
+pub fn stop(self: *ReportSnapshot) void {
+    self.mu.lock();
+    const th = self.thread orelse {
+        self.mu.unlock();
+        return;
+    };
+    self.want_stop = true;
+    self.cond.signal();
+    self.mu.unlock();
+    th.join();
+    self.thread = null;
+}
+
+/// replaces the report of msg kind, an onchain or lightning report, to be
+/// written out shortly. errors are logged.
+pub fn update(self: *ReportSnapshot, msg: comm.Message) void {
+    const kind: Kind = switch (msg) {
+        .onchain_report => .onchain,
+        .lightning_report => .lightning,
+        else => unreachable,
+    };
+    self.mu.lock();
+    defer self.mu.unlock();
+    const e = &self.entries[@intFromEnum(kind)];
+    e.frame.clearRetainingCapacity();
+    comm.writeEncoded(self.allocator, e.frame.writer(), msg, .binary) catch |err| {
+        logger.err("{s}: {!}", .{ @tagName(kind), err });
+        e.frame.clearRetainingCapacity();
+        e.collected = 0;
+        return;
+    };
+    e.collected = @intCast(@max(0, time.timestamp()));
+    e.restored = false;
+    self.dirty = true;
+    self.cond.signal();
+}
+
+/// reads the reports saved by a previous run and returns them like reports.
+/// they are also kept for the next write, until replaced with update.
+/// callers own the returned messages and must deinit each.
+pub fn load(self: *ReportSnapshot) !std.BoundedArray(comm.ParsedMessage, nkinds) {
+    const data = std.fs.cwd().readFileAlloc(self.allocator, self.path, 2 * comm.default_max_payload) catch |err| switch (err) {
+        error.FileNotFound => return .{},
+        else => return err,
+    };
+    defer self.allocator.free(data);
+    if (!std.mem.startsWith(u8, data, magic)) {
+        logger.warn("{s}: unknown format; ignored", .{self.path});
+        return .{};
+    }
+
+    var fbs = std.io.fixedBufferStream(data[magic.len..]);
+    const r = fbs.reader();
+    while (fbs.pos < fbs.buffer.len) {
+        const collected = r.readInt(u64, .little) catch {
+            logger.warn("{s}: truncated; ignored what follows", .{self.path});
+            break;
+        };
+        const start = fbs.pos;
+        const msg = comm.read(self.allocator, r) catch |err| {
+            logger.warn("{s}: {!}; ignored what follows", .{ self.path, err });
+            break;
+        };
+        defer msg.deinit();
+        const kind: Kind = switch (msg.value) {
+            .onchain_report => .onchain,
+            .lightning_report => .lightning,
+            else => continue,
+        };
+        self.mu.lock();
+        defer self.mu.unlock();
+        const e = &self.entries[@intFromEnum(kind)];
+        if (e.collected < collected) {
+            e.frame.clearRetainingCapacity();
+            try e.frame.appendSlice(fbs.buffer[start..fbs.pos]);
+            e.collected = collected;
+            e.restored = true;
+        }
+    }
+    return self.reports();
+}
+
+/// returns the latest reports, live or restored by load. the stale_sec of
+/// restored ones is set to the time elapsed since each was collected, as of
+/// the system clock: a clock not yet synced after boot tells a shorter age.
+/// callers own the returned messages and must deinit each.
+pub fn reports(self: *ReportSnapshot) !std.BoundedArray(comm.ParsedMessage, nkinds) {
+    var res = std.BoundedArray(comm.ParsedMessage, nkinds){};
+    errdefer for (res.constSlice()) |m| m.deinit();
+    const now: u64 = @intCast(@max(0, time.timestamp()));
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (self.entries) |e| {
+        if (e.frame.items.len == 0) {
+            continue;
+        }
+        res.appendAssumeCapacity(try self.decode(e, if (e.restored) now -| e.collected else null));
+    }
+    return res;
+}
+
+/// returns the latest report of the kind, live or restored, with stale_sec
+/// set to the time elapsed since it was collected; null if none. meant for
+/// when a refresh fails to complete in time: ngui then tells the age of what
+/// it shows. callers own the returned message and must deinit it.
+pub fn stale(self: *ReportSnapshot, kind: Kind) !?comm.ParsedMessage {
+    const now: u64 = @intCast(@max(0, time.timestamp()));
+    self.mu.lock();
+    defer self.mu.unlock();
+    const e = self.entries[@intFromEnum(kind)];
+    if (e.frame.items.len == 0) {
+        return null;
+    }
+    return try self.decode(e, now -| e.collected);
+}
+
+/// reads the report of the entry, a non-empty one. callers must hold self.mu.
+fn decode(self: *ReportSnapshot, e: Entry, stale_sec: ?u64) !comm.ParsedMessage {
+    var fbs = std.io.fixedBufferStream(e.frame.items);
+    var msg = try comm.read(self.allocator, fbs.reader());
+    switch (msg.value) {
+        .onchain_report => |*rep| rep.stale_sec = stale_sec,
+        .lightning_report => |*rep| rep.stale_sec = stale_sec,
+        else => unreachable, // see update
+    }
+    return msg;
+}
+
+/// writer thread entry point. exits when want_stop is true.
+fn loop(self: *ReportSnapshot) void {
+    var buf = types.ByteArrayList.init(self.allocator);
+    defer buf.deinit();
+    var written: i64 = 0; // time.milliTimestamp of the last write
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    while (true) {
+        if (!self.dirty and !self.want_stop) {
+            self.cond.wait(&self.mu);
+            continue;
+        }
+        const due_in = written + write_interval_ms - time.milliTimestamp();
+        if (!self.want_stop and due_in > 0) {
+            self.cond.timedWait(&self.mu, @as(u64, @intCast(due_in)) * time.ns_per_ms) catch {}; // error.Timeout
+            continue;
+        }
+        if (self.dirty) {
+            self.dirty = false;
+            const ok = if (self.encodeLocked(&buf)) true else |err| blk: {
+                logger.err("{s}: {!}", .{ self.path, err });
+                break :blk false;
+            };
+            // the file is written outside of the lock: updates go on meanwhile.
+            self.mu.unlock();
+            if (ok) {
+                writeFile(self.path, buf.items) catch |err| logger.err("{s}: {!}", .{ self.path, err });
+            }
+            written = time.milliTimestamp();
+            self.mu.lock();
+        }
+        if (self.want_stop and !self.dirty) {
+            return;
+        }
+    }
+}
+
+/// serializes all entries in the file format into buf.
+/// callers must hold self.mu.
+fn encodeLocked(self: *ReportSnapshot, buf: *types.ByteArrayList) !void {
+    buf.clearRetainingCapacity();
+    try buf.appendSlice(magic);
+    for (self.entries) |e| {
+        if (e.frame.items.len == 0) {
+            continue;
+        }
+        try buf.writer().writeInt(u64, e.collected, .little);
+        try buf.appendSlice(e.frame.items);
+    }
+}
+
+/// atomically replaces the file at path with data, including parent directories.
+fn writeFile(path: []const u8, data: []const u8) !void {
+    if (std.fs.path.dirname(path)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+    var af = try std.fs.cwd().atomicFile(path, .{ .mode = 0o644 });
+    defer af.deinit();
+    try af.file.writeAll(data);
+    try af.file.sync();
+    try af.finish();
+}
+
+test "report snapshot" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "ndg", "reports.bin" });
+    defer t.allocator.free(path);
+
+    var snap = ReportSnapshot.init(t.allocator, path);
+    try t.expectEqual(@as(usize, 0), (try snap.load()).len);
+    try snap.start();
+    snap.update(.{ .onchain_report = .{
+        .blocks = 800000,
+        .headers = 800000,
+        .timestamp = 1700000000,
+        .hash = types.Hash{ .bytes = [_]u8{1} ** 32 },
+        .ibd = false,
+        .verifyprogress = 100,
+        .diskusage = 567119364054,
+        .version = "/Satoshi:26.0.0/",
+        .conn_in = 8,
+        .conn_out = 10,
+        .warnings = "",
+        .localaddr = &.{},
+        .mempool = .{
+            .loaded = true,
+            .txcount = 100000,
+            .usage = 200123456,
+            .max = 300000000,
+            .totalfee = 2.23049932,
+            .minfee = 0.00004155,
+            .fullrbf = false,
+        },
+        .balance = null,
+    } });
+    {
+        const live = try snap.reports();
+        defer for (live.constSlice()) |m| m.deinit();
+        try t.expectEqual(@as(?u64, null), live.get(0).value.onchain_report.stale_sec);
+        // a live one resent after a refresh ran out of time.
+        const old = (try snap.stale(.onchain)).?;
+        defer old.deinit();
+        try t.expect(old.value.onchain_report.stale_sec.? < 60);
+        try t.expect(try snap.stale(.lightning) == null);
+    }
+    snap.stop(); // writes out the update
+    snap.deinit();
+
+    // another run restores it, stale.
+    snap = ReportSnapshot.init(t.allocator, path);
+    defer snap.deinit();
+    const res = try snap.load();
+    defer for (res.constSlice()) |m| m.deinit();
+    try t.expectEqual(@as(usize, 1), res.len);
+    const rep = res.get(0).value.onchain_report;
+    try t.expectEqual(@as(u64, 800000), rep.blocks);
+    try t.expectEqualStrings("/Satoshi:26.0.0/", rep.version);
+    try t.expect(rep.stale_sec.? < 60);
+    try t.expect(snap.entries[@intFromEnum(Kind.onchain)].frame.items.len > 0);
+    try t.expectEqual(@as(usize, 0), snap.entries[@intFromEnum(Kind.lightning)].frame.items.len);
+
+    // an unknown format is ignored.
+    try tmp.dir.writeFile("ndg/reports.bin", "garbage");
+    try t.expectEqual(@as(usize, 0), (try snap.load()).len);
+}
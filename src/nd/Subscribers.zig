@@ -0,0 +1,334 @@
+//! report subscribers next to ngui, such as a metrics exporter or a monitoring
+//! client on the LAN, connected to a unix socket. subscribers receive the same
+//! stream of comm frames as ngui does, with json payloads, and send nothing.
+//!
+//! broadcast encodes a report once into a reference counted frame, queued as
+//! is to every subscriber. each subscriber has a writer thread of its own and
+//! a queue of at most max_frames: a subscriber too slow to keep up is
+//! disconnected rather than stalling the others or growing the queue
+//! unbounded; it reconnects to resume, as if new.
+//! a new subscriber receives lightning report deltas only once it got a full
+//! lightning report to apply them to.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+const posix = std.posix;
+
+const comm = @import("../comm.zig");
+const tcalloc = @import("../tcalloc.zig");
+const types = @import("../types.zig");
+
+const logger = std.log.scoped(.subscribers);
+
+allocator: std.mem.Allocator,
+path: []const u8,
+/// queued frames above this count disconnect the subscriber.
+max_frames: usize = 64,
+max_subscribers: usize = 8,
+
+server: ?std.net.Server = null,
+thread: ?std.Thread = null, // accept loop
+mu: std.Thread.Mutex = .{},
+subs: std.ArrayListUnmanaged(*Sub) = .{}, // guarded by mu
+want_stop: bool = false, // guarded by mu
+
+const Subscribers = @This();
+
+/// an encoded message shared by the queues of all subscribers.
+const Frame = struct {
+    refs: std.atomic.Value(u32),
+    data: []u8, // frame head and payload
+
+    fn ref(self: *Frame) void {
+        _ = self.refs.fetchAdd(1, .monotonic);
+    }
+
+    fn unref(self: *Frame, allocator: std.mem.Allocator) void {
+        if (self.refs.fetchSub(1, .release) != 1) {
+            return;
+        }
+        _ = self.refs.load(.acquire); // pairs with other unref's release
+        allocator.free(self.data);
+        allocator.destroy(self);
+    }
+};
+
+const Sub = struct {
+    stream: std.net.Stream,
+    thread: std.Thread = undefined,
+    cond: std.Thread.Condition = .{}, // signalled on frames or closed change
+    frames: std.ArrayListUnmanaged(*Frame) = .{}, // guarded by Subscribers.mu
+    lnd_synced: bool = false, // got a full lightning report
+    closed: bool = false, // the writer thread is to exit; guarded by Subscribers.mu
+    done: bool = false, // the writer thread exited; guarded by Subscribers.mu
+};
+
+/// the path is referenced, not owned. release resources with stop.
+pub fn init(allocator: std.mem.Allocator, path: []const u8) Subscribers {
+    return .{ .allocator = allocator, .path = path };
+}
+
+/// listens on the unix socket at path, replacing a stale one, and spawns
+/// the accept thread.
+pub fn start(self: *Subscribers) !void {
+    std.fs.cwd().deleteFile(self.path) catch |err| switch (err) {
+        error.FileNotFound => {},
+        else => return err,
+    };
+    const addr = try std.net.Address.initUnix(self.path);
+    self.server = try addr.listen(.{});
+    errdefer {
+        self.server.?.deinit();
+        self.server = null;
+    }
+    self.want_stop = false;
+    self.thread = try std.Thread.spawn(.{}, acceptLoop, .{self});
+}
+
+/// disconnects all subscribers, joins all threads and removes the socket.
+pub fn stop(self: *Subscribers) void {
+    self.mu.lock();
+    self.want_stop = true;
+    self.mu.unlock();
+    // unblock the accept call.
+    if (std.net.connectUnixSocket(self.path)) |s| s.close() else |_| {}
+    if (self.thread) |th| {
+        th.join();
+        self.thread = null;
+    }
+    self.mu.lock();
+    for (self.subs.items) |sub| {
+        closeLocked(sub);
+    }
+    self.mu.unlock();
+    // no new subscribers past this point: safe to read subs without the lock.
+    for (self.subs.items) |sub| {
+        self.free(sub);
+    }
+    self.subs.deinit(self.allocator);
+    self.subs = .{};
+    if (self.server) |*srv| {
+        srv.deinit();
+        self.server = null;
+        std.fs.cwd().deleteFile(self.path) catch {};
+    }
+}
+
+/// queues msg to all subscribers. the message is encoded only if there are
+/// any. errors are logged.
+pub fn broadcast(self: *Subscribers, msg: comm.Message) void {
+    self.mu.lock();
+    const nsubs = self.subs.items.len;
+    self.mu.unlock();
+    if (nsubs == 0) {
+        return;
+    }
+
+    // encode outside of the lock; subscriber threads go on meanwhile.
+    var buf = types.ByteArrayList.init(self.allocator);
+    defer buf.deinit();
+    comm.writeEncoded(self.allocator, buf.writer(), msg, .json) catch |err| {
+        logger.err("{s}: {!}", .{ @tagName(msg), err });
+        return;
+    };
+    const frame = self.allocator.create(Frame) catch |err| {
+        logger.err("{s}: {!}", .{ @tagName(msg), err });
+        return;
+    };
+    frame.* = .{ .refs = std.atomic.Value(u32).init(1), .data = buf.toOwnedSlice() catch |err| {
+        self.allocator.destroy(frame);
+        logger.err("{s}: {!}", .{ @tagName(msg), err });
+        return;
+    } };
+    defer frame.unref(self.allocator); // the reference of this function
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (self.subs.items) |sub| {
+        if (sub.closed) {
+            continue;
+        }
+        switch (msg) {
+            .lightning_report => sub.lnd_synced = true,
+            .lightning_report_delta => if (!sub.lnd_synced) continue,
+            else => {},
+        }
+        if (sub.frames.items.len >= self.max_frames) {
+            logger.warn("subscriber too slow; disconnected", .{});
+            closeLocked(sub);
+            continue;
+        }
+        sub.frames.append(self.allocator, frame) catch |err| {
+            logger.err("subscriber {s}: {!}; disconnected", .{ @tagName(msg), err });
+            closeLocked(sub);
+            continue;
+        };
+        frame.ref();
+        sub.cond.signal();
+    }
+}
+
+/// marks sub for its writer thread to exit, unblocking a send in progress.
+/// callers must hold self.mu.
+fn closeLocked(sub: *Sub) void {
+    if (sub.closed) {
+        return;
+    }
+    sub.closed = true;
+    posix.shutdown(sub.stream.handle, .both) catch {};
+    sub.cond.signal();
+}
+
+/// accept thread entry point. exits when want_stop is true.
+fn acceptLoop(self: *Subscribers) void {
+    while (true) {
+        const conn = self.server.?.accept();
+        self.mu.lock();
+        const quit = self.want_stop;
+        self.mu.unlock();
+        if (quit) {
+            if (conn) |c| c.stream.close() else |_| {}
+            return;
+        }
+        const c = conn catch |err| {
+            logger.err("accept: {!}", .{err});
+            std.time.sleep(100 * std.time.ns_per_ms); // avoid a busy loop
+            continue;
+        };
+        self.reap();
+        self.add(c.stream) catch |err| {
+            logger.err("subscribe: {!}", .{err});
+            c.stream.close();
+        };
+    }
+}
+
+fn add(self: *Subscribers, stream: std.net.Stream) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.subs.items.len >= self.max_subscribers) {
+        return error.TooManySubscribers;
+    }
+    try self.subs.ensureUnusedCapacity(self.allocator, 1);
+    const sub = try self.allocator.create(Sub);
+    errdefer self.allocator.destroy(sub);
+    sub.* = .{ .stream = stream };
+    sub.thread = try std.Thread.spawn(.{}, writeLoop, .{ self, sub });
+    self.subs.appendAssumeCapacity(sub);
+    logger.info("subscribed; {d} total", .{self.subs.items.len});
+}
+
+/// frees the subscribers disconnected since the last call.
+fn reap(self: *Subscribers) void {
+    var gone = std.BoundedArray(*Sub, 16){};
+    self.mu.lock();
+    var i: usize = 0;
+    while (i < self.subs.items.len and gone.len < gone.capacity()) {
+        const sub = self.subs.items[i];
+        if (!sub.done) {
+            i += 1;
+            continue;
+        }
+        gone.appendAssumeCapacity(sub);
+        _ = self.subs.swapRemove(i);
+    }
+    self.mu.unlock();
+    for (gone.constSlice()) |sub| {
+        self.free(sub);
+    }
+}
+
+/// joins the writer thread of a closed sub and releases its resources.
+fn free(self: *Subscribers, sub: *Sub) void {
+    sub.thread.join();
+    sub.stream.close();
+    self.allocator.destroy(sub);
+}
+
+/// subscriber writer thread entry point: sends queued frames until the
+/// subscriber is closed or disconnects.
+fn writeLoop(self: *Subscribers, sub: *Sub) void {
+    defer tcalloc.releaseThreadCache(); // the thread exits with the subscriber
+    self.mu.lock();
+    defer self.mu.unlock();
+    while (!sub.closed) {
+        if (sub.frames.items.len == 0) {
+            sub.cond.wait(&self.mu);
+            continue;
+        }
+        const frame = sub.frames.orderedRemove(0);
+        self.mu.unlock();
+        const ok = if (sendAll(sub.stream.handle, frame.data)) true else |err| blk: {
+            logger.info("subscriber gone: {!}", .{err});
+            break :blk false;
+        };
+        frame.unref(self.allocator);
+        self.mu.lock();
+        if (!ok) {
+            closeLocked(sub);
+        }
+    }
+    for (sub.frames.items) |frame| {
+        frame.unref(self.allocator);
+    }
+    sub.frames.deinit(self.allocator);
+    sub.done = true;
+}
+
+/// writes all of data to a socket with no SIGPIPE on a vanished subscriber.
+fn sendAll(fd: posix.socket_t, data: []const u8) !void {
+    var n: usize = 0;
+    while (n < data.len) {
+        n += try posix.send(fd, data[n..], posix.MSG.NOSIGNAL);
+    }
+}
+
+test "subscribers broadcast" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "reports.sock" });
+    defer t.allocator.free(path);
+
+    var subs = Subscribers.init(t.allocator, path);
+    try subs.start();
+    defer subs.stop();
+    subs.broadcast(.ping); // no subscribers: a no-op
+
+    var conns: [2]std.net.Stream = undefined;
+    for (&conns) |*c| {
+        c.* = try std.net.connectUnixSocket(path);
+    }
+    defer for (conns) |c| c.close();
+    // wait for the accept thread.
+    for (0..1000) |_| {
+        subs.mu.lock();
+        const n = subs.subs.items.len;
+        subs.mu.unlock();
+        if (n == conns.len) {
+            break;
+        }
+        std.time.sleep(1 * std.time.ns_per_ms);
+    } else return error.NotSubscribed;
+
+    // deltas are skipped until a full lightning report.
+    subs.broadcast(.{ .lightning_report_delta = .{ .upsert = &.{} } });
+    subs.broadcast(.{ .screen_unlock_result = .{ .ok = true, .err = null } });
+    for (conns) |c| {
+        const msg = try comm.read(t.allocator, c.reader());
+        defer msg.deinit();
+        try t.expectEqual(comm.MessageTag.screen_unlock_result, msg.value);
+    }
+
+    // a disconnected subscriber leaves the others be.
+    conns[1].close();
+    conns[1] = try std.net.connectUnixSocket(path);
+    subs.broadcast(.standby);
+    const msg = try comm.read(t.allocator, conns[0].reader());
+    defer msg.deinit();
+    try t.expectEqual(comm.MessageTag.standby, msg.value);
+}
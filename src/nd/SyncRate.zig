@@ -0,0 +1,121 @@
+//! bitcoind initial block download throughput, kept as exponentially weighted
+//! moving averages across onchain reports, to estimate the time left.
+//! the rates of blocks and of disk usage growth together hint at what bounds
+//! the sync: a disk rate far below what the storage sustains points at
+//! verification, and so the cpu or dbcache size.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+/// time constant of the averages: about the weight of samples older than this
+/// decays by a factor of e. reports arrive unevenly, so the weight of each
+/// sample is derived from the time elapsed since the previous one.
+const tau_sec: f64 = 10 * std.time.s_per_min;
+
+/// the sample averages are computed against; null until the first update.
+last: ?Sample = null,
+/// whether the rates are seeded from at least two samples.
+seeded: bool = false,
+blocks_rate: f64 = 0, // blocks per second
+disk_rate: f64 = 0, // bytes per second; 0 while pruning shrinks it
+progress_rate: f64 = 0, // verification progress, 0-1, per second
+
+const SyncRate = @This();
+
+pub const Sample = struct {
+    time_ms: i64, // time.milliTimestamp
+    blocks: u64,
+    diskusage: u64, // bytes
+    progress: f64, // bitcoind verificationprogress, 0-1
+};
+
+pub const Estimate = struct {
+    blocks_per_min: f32,
+    disk_bytes_per_sec: u64,
+    /// seconds left to complete the sync at the current pace; null if stalled.
+    eta_sec: ?u64,
+};
+
+/// forgets all samples, for example once the sync completes.
+pub fn reset(self: *SyncRate) void {
+    self.* = .{};
+}
+
+/// adds a sample to the averages. a sample going back in blocks, as after
+/// a reindex, restarts the averages. verification progress is an estimate
+/// which may go back slightly as new headers arrive: such ticks count as none.
+pub fn update(self: *SyncRate, s: Sample) void {
+    const prev = self.last orelse {
+        self.last = s;
+        return;
+    };
+    if (s.blocks < prev.blocks) {
+        self.reset();
+        self.last = s;
+        return;
+    }
+    if (s.time_ms <= prev.time_ms) {
+        return;
+    }
+    const dt = @as(f64, @floatFromInt(s.time_ms - prev.time_ms)) / std.time.ms_per_s;
+    const blocks = @as(f64, @floatFromInt(s.blocks - prev.blocks)) / dt;
+    const disk = @as(f64, @floatFromInt(s.diskusage -| prev.diskusage)) / dt;
+    const progress = @max(0, s.progress - prev.progress) / dt;
+    if (!self.seeded) {
+        self.blocks_rate = blocks;
+        self.disk_rate = disk;
+        self.progress_rate = progress;
+        self.seeded = true;
+    } else {
+        const alpha = 1 - @exp(-dt / tau_sec);
+        self.blocks_rate += alpha * (blocks - self.blocks_rate);
+        self.disk_rate += alpha * (disk - self.disk_rate);
+        self.progress_rate += alpha * (progress - self.progress_rate);
+    }
+    self.last = s;
+}
+
+/// returns the current averages, or null until seeded.
+/// the time left is based on verification progress rather than blocks:
+/// the latter vary in size and cost to verify too much across the chain.
+pub fn estimate(self: SyncRate) ?Estimate {
+    if (!self.seeded) {
+        return null;
+    }
+    const left = 1 - std.math.clamp(self.last.?.progress, 0, 1);
+    const eta: ?u64 = if (self.progress_rate > 0) std.math.lossyCast(u64, @round(left / self.progress_rate)) else null;
+    return .{
+        .blocks_per_min = @floatCast(self.blocks_rate * std.time.s_per_min),
+        .disk_bytes_per_sec = std.math.lossyCast(u64, @round(self.disk_rate)),
+        .eta_sec = eta,
+    };
+}
+
+test "sync rate" {
+    const t = std.testing;
+
+    var r = SyncRate{};
+    r.update(.{ .time_ms = 0, .blocks = 1000, .diskusage = 1 << 20, .progress = 0.1 });
+    try t.expect(r.estimate() == null);
+
+    // a minute later: 600 blocks, 6MiB and 1% progress.
+    r.update(.{ .time_ms = 60_000, .blocks = 1600, .diskusage = 7 << 20, .progress = 0.11 });
+    const e1 = r.estimate().?;
+    try t.expectApproxEqAbs(@as(f32, 600), e1.blocks_per_min, 0.01);
+    try t.expectEqual(@as(u64, 104858), e1.disk_bytes_per_sec); // 6MiB/60s
+    try t.expectEqual(@as(?u64, 89 * 60), e1.eta_sec);
+
+    // a slower minute moves the average only part of the way.
+    r.update(.{ .time_ms = 120_000, .blocks = 1900, .diskusage = 7 << 20, .progress = 0.115 });
+    const e2 = r.estimate().?;
+    try t.expect(e2.blocks_per_min < 600 and e2.blocks_per_min > 300);
+    try t.expect(e2.disk_bytes_per_sec < e1.disk_bytes_per_sec);
+
+    // going back in blocks restarts the averages.
+    r.update(.{ .time_ms = 180_000, .blocks = 100, .diskusage = 1 << 20, .progress = 0.01 });
+    try t.expect(r.estimate() == null);
+
+    // a stalled sync has no eta.
+    r.update(.{ .time_ms = 240_000, .blocks = 100, .diskusage = 1 << 20, .progress = 0.01 });
+    try t.expectEqual(@as(?u64, null), r.estimate().?.eta_sec);
+}
@@ -0,0 +1,141 @@
+//! tor bootstrap and circuit builds as followed from tor control port events.
+//! lnd reaches peers and serves remote wallets over tor, and is of little use
+//! until tor bootstraps: lightning reports are held back meanwhile instead of
+//! failing calls to a lnd still waiting for tor.
+//!
+//! circuit build time is measured from the LAUNCHED to the BUILT event of the
+//! same circuit, as nd receives them.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+const comm = @import("../comm.zig");
+const torctl = @import("../torctl.zig");
+
+/// the bootstrap progress, as of the last event; null until connected to
+/// the control port, or once disconnected.
+progress: ?u8 = null,
+summary: std.BoundedArray(u8, max_summary) = .{},
+/// circuits launched and not yet built, failed or closed.
+launched: std.BoundedArray(Launched, max_launched) = .{},
+built: u32 = 0,
+failed: u32 = 0,
+/// build time of the latest built circuit, in ms.
+build_ms: ?u32 = null,
+
+const TorMonitor = @This();
+
+const max_summary = 64;
+/// tor keeps a few circuits in flight at a time; launches beyond this are
+/// left unmeasured.
+const max_launched = 32;
+
+const Launched = struct {
+    id: u32,
+    time_ns: u64, // a Daemon.clock reading
+};
+
+/// forgets all state, such as when the control port connection is lost.
+pub fn reset(self: *TorMonitor) void {
+    self.* = .{};
+}
+
+/// reports whether tor is known to still bootstrap; false while its status
+/// is unknown, so that an unreachable control port holds nothing back.
+pub fn bootstrapping(self: TorMonitor) bool {
+    return self.progress != null and self.progress.? < 100;
+}
+
+/// records the bootstrap phase and reports whether it changed.
+pub fn bootstrap(self: *TorMonitor, b: torctl.Bootstrap) bool {
+    const summary = b.summary[0..@min(b.summary.len, max_summary)];
+    const changed = self.progress == null or self.progress.? != b.progress or
+        !std.mem.eql(u8, self.summary.constSlice(), summary);
+    self.progress = b.progress;
+    self.summary = std.BoundedArray(u8, max_summary).fromSlice(summary) catch unreachable;
+    return changed;
+}
+
+/// records a circuit status event at now_ns, a monotonic clock reading, and
+/// returns the circuit build time in ns if it is now built.
+pub fn circuit(self: *TorMonitor, c: torctl.Circuit, now_ns: u64) ?u64 {
+    switch (c.status) {
+        .launched => {
+            self.forget(c.id);
+            self.launched.append(.{ .id = c.id, .time_ns = now_ns }) catch {};
+            return null;
+        },
+        .extended => return null,
+        .built => {
+            const start = self.forget(c.id) orelse return null;
+            const took = now_ns -| start;
+            self.built +|= 1;
+            self.build_ms = std.math.lossyCast(u32, took / std.time.ns_per_ms);
+            return took;
+        },
+        .failed => {
+            if (self.forget(c.id) != null) {
+                self.failed +|= 1;
+            }
+            return null;
+        },
+        .closed => {
+            _ = self.forget(c.id);
+            return null;
+        },
+    }
+}
+
+/// drops a launched circuit and returns its launch time, if any.
+fn forget(self: *TorMonitor, id: u32) ?u64 {
+    for (self.launched.constSlice(), 0..) |l, i| {
+        if (l.id == id) {
+            _ = self.launched.swapRemove(i);
+            return l.time_ns;
+        }
+    }
+    return null;
+}
+
+/// returns a status report for ngui, or null while the status is unknown.
+/// the report references self.
+pub fn report(self: *const TorMonitor) ?comm.Message.TorStatus {
+    return .{
+        .progress = self.progress orelse return null,
+        .summary = self.summary.constSlice(),
+        .circuits = self.built,
+        .failed = self.failed,
+        .build_ms = self.build_ms,
+    };
+}
+
+test "tor monitor" {
+    const t = std.testing;
+    const ms = std.time.ns_per_ms;
+
+    var mon = TorMonitor{};
+    try t.expect(!mon.bootstrapping());
+    try t.expect(mon.report() == null);
+    try t.expect(mon.bootstrap(.{ .progress = 10, .tag = "conn_done", .summary = "Connected to a relay" }));
+    try t.expect(!mon.bootstrap(.{ .progress = 10, .tag = "conn_done", .summary = "Connected to a relay" }));
+    try t.expect(mon.bootstrapping());
+    try t.expect(mon.bootstrap(.{ .progress = 100, .tag = "done", .summary = "Done" }));
+    try t.expect(!mon.bootstrapping());
+
+    try t.expect(mon.circuit(.{ .id = 1, .status = .launched }, 1000 * ms) == null);
+    try t.expect(mon.circuit(.{ .id = 2, .status = .launched }, 1100 * ms) == null);
+    try t.expect(mon.circuit(.{ .id = 1, .status = .extended }, 1200 * ms) == null);
+    try t.expectEqual(@as(?u64, 750 * ms), mon.circuit(.{ .id = 1, .status = .built }, 1750 * ms));
+    try t.expect(mon.circuit(.{ .id = 2, .status = .failed }, 2000 * ms) == null);
+    try t.expect(mon.circuit(.{ .id = 3, .status = .built }, 2000 * ms) == null); // launch unseen
+    const rep = mon.report().?;
+    try t.expectEqual(@as(u8, 100), rep.progress);
+    try t.expectEqualStrings("Done", rep.summary);
+    try t.expectEqual(@as(u32, 1), rep.circuits);
+    try t.expectEqual(@as(u32, 1), rep.failed);
+    try t.expectEqual(@as(?u32, 750), rep.build_ms);
+    try t.expectEqual(@as(usize, 0), mon.launched.len);
+
+    mon.reset();
+    try t.expect(mon.report() == null);
+}
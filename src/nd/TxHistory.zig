@@ -0,0 +1,342 @@
+//! on-device history of lnd on-chain wallet transactions, synced from lnd
+//! incrementally by block height and served to ngui a page at a time.
+//!
+//! the file holds confirmed transactions in block height order, and the
+//! cursor in its header: the chain tip as of the last sync. a sync lists lnd
+//! transactions of only the last reorg_depth blocks up to the cursor and
+//! those after it, along with unconfirmed ones. records of the rechecked
+//! blocks are replaced with what lnd lists now: transactions reorged out are
+//! dropped and those mined again move to their new block. after the first
+//! sync, the cost of a sync is thus proportional to the number of new blocks,
+//! not the size of the history.
+//!
+//! the records are truncated and appended before the cursor is updated, which
+//! makes a crash in between harmless: the next sync rewrites the same blocks.
+//! unconfirmed transactions are kept in memory only, ahead of the others.
+//! safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+
+const logger = std.log.scoped(.txhistory);
+
+/// max number of items in a page.
+pub const max_page = 100;
+/// blocks below the cursor, itself included, listed again by every sync.
+pub const reorg_depth = 6;
+/// max length of a transaction label in a record; longer ones are truncated.
+const max_label = 64;
+
+allocator: std.mem.Allocator,
+file: std.fs.File,
+mu: std.Thread.Mutex = .{},
+/// number of records in the file.
+count: usize = 0,
+cursor: u32 = 0,
+/// unconfirmed transactions as of the last sync, newest first.
+pending: std.ArrayListUnmanaged(Record) = .{},
+
+const TxHistory = @This();
+
+/// the file is re-initialized if its header doesn't match.
+const Header = extern struct {
+    magic: [4]u8 = "ndtx".*,
+    version: u32 = 1,
+    record_size: u32 = @sizeOf(Record),
+    cursor: u32 = 0,
+};
+
+const Record = extern struct {
+    txid: [32]u8, // display byte order, as the hex lnd reports
+    height: u32, // 0 while unconfirmed
+    label_len: u8,
+    reserved: [3]u8 = .{0} ** 3,
+    time: i64, // unix seconds
+    amount: i64, // sat
+    fee: i64, // sat
+    label: [max_label]u8,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(Record) == 128);
+}
+
+/// a wallet transaction as listed by lnd.
+pub const Tx = struct {
+    txid: [32]u8,
+    height: u32, // 0 while unconfirmed
+    time: i64,
+    amount: i64,
+    fee: i64 = 0,
+    label: []const u8 = "",
+};
+
+/// opens or creates the history file at path, including its parent directories.
+/// callers must close when done.
+pub fn open(allocator: std.mem.Allocator, path: []const u8) !TxHistory {
+    if (std.fs.path.dirname(path)) |dir| {
+        try std.fs.cwd().makePath(dir);
+    }
+    const file = try std.fs.cwd().createFile(path, .{ .read = true, .truncate = false });
+    errdefer file.close();
+    var self = TxHistory{ .allocator = allocator, .file = file };
+
+    const size = (try file.stat()).size;
+    var hdr: Header = undefined;
+    const n = try file.preadAll(std.mem.asBytes(&hdr), 0);
+    var want = Header{};
+    want.cursor = hdr.cursor;
+    if (n < @sizeOf(Header) or !std.meta.eql(hdr, want)) {
+        if (size != 0) {
+            logger.warn("{s}: unknown format; starting a new transactions history", .{path});
+        }
+        try file.setEndPos(0);
+        try file.pwriteAll(std.mem.asBytes(&Header{}), 0);
+        return self;
+    }
+    self.cursor = hdr.cursor;
+    self.count = (size - @sizeOf(Header)) / @sizeOf(Record);
+    const end = @sizeOf(Header) + self.count * @sizeOf(Record);
+    if (end != size) {
+        logger.warn("{s}: dropping a partially written record", .{path});
+        try file.setEndPos(end);
+    }
+    return self;
+}
+
+pub fn close(self: *TxHistory) void {
+    self.pending.deinit(self.allocator);
+    self.file.close();
+}
+
+/// returns the block height to start listing lnd transactions at in the
+/// next sync: the last reorg_depth blocks up to the cursor are rechecked.
+pub fn syncStart(self: *TxHistory) u32 {
+    self.mu.lock();
+    defer self.mu.unlock();
+    return (self.cursor + 1) -| reorg_depth;
+}
+
+/// replaces transactions of blocks from start on, and the unconfirmed ones,
+/// with txs as lnd lists them for blocks start up to tip and unconfirmed,
+/// and advances the cursor to tip. start is as returned by syncStart.
+/// returns whether the history changed.
+pub fn merge(self: *TxHistory, start: u32, tip: u32, txs: []const Tx) !bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+
+    var recs = std.ArrayList(Record).init(self.allocator);
+    defer recs.deinit();
+    var pending = std.ArrayList(Record).init(self.allocator);
+    defer pending.deinit();
+    for (txs) |tx| {
+        if (tx.height == 0) {
+            try pending.append(record(tx));
+        } else if (tx.height >= start) {
+            try recs.append(record(tx));
+        }
+    }
+    std.mem.sort(Record, recs.items, {}, recordLessThan);
+    std.mem.sort(Record, pending.items, {}, recordLessThan);
+    std.mem.reverse(Record, pending.items); // newest first
+
+    // the records of rechecked blocks are at the end of the file.
+    var keep = self.count;
+    var rec: Record = undefined;
+    while (keep > 0) : (keep -= 1) {
+        if (try self.file.preadAll(std.mem.asBytes(&rec), offsetOf(keep - 1)) != @sizeOf(Record)) {
+            return error.EndOfStream;
+        }
+        if (rec.height < start) {
+            break;
+        }
+    }
+    var changed = self.count - keep != recs.items.len;
+    if (!changed) {
+        for (recs.items, keep..) |r, i| {
+            if (try self.file.preadAll(std.mem.asBytes(&rec), offsetOf(i)) != @sizeOf(Record)) {
+                return error.EndOfStream;
+            }
+            if (!std.mem.eql(u8, std.mem.asBytes(&rec), std.mem.asBytes(&r))) {
+                changed = true;
+                break;
+            }
+        }
+    }
+    if (changed) {
+        try self.file.setEndPos(offsetOf(keep));
+        self.count = keep;
+        try self.file.pwriteAll(std.mem.sliceAsBytes(recs.items), offsetOf(keep));
+        self.count += recs.items.len;
+    }
+    if (!std.mem.eql(u8, std.mem.sliceAsBytes(pending.items), std.mem.sliceAsBytes(self.pending.items))) {
+        self.pending.clearRetainingCapacity();
+        try self.pending.appendSlice(self.allocator, pending.items);
+        changed = true;
+    }
+    if (tip != self.cursor) {
+        try self.file.pwriteAll(std.mem.asBytes(&Header{ .cursor = tip }), 0);
+        self.cursor = tip;
+    }
+    return changed;
+}
+
+fn offsetOf(index: usize) u64 {
+    return @sizeOf(Header) + index * @sizeOf(Record);
+}
+
+/// orders records by height, then time and txid, so that the records of
+/// a block listed again in the same state compare equal.
+fn recordLessThan(_: void, a: Record, b: Record) bool {
+    if (a.height != b.height) {
+        return a.height < b.height;
+    }
+    if (a.time != b.time) {
+        return a.time < b.time;
+    }
+    return std.mem.order(u8, &a.txid, &b.txid) == .lt;
+}
+
+fn record(tx: Tx) Record {
+    var rec = Record{
+        .txid = tx.txid,
+        .height = tx.height,
+        .label_len = 0,
+        .time = tx.time,
+        .amount = tx.amount,
+        .fee = tx.fee,
+        .label = undefined,
+    };
+    var n = @min(tx.label.len, max_label);
+    // don't cut a UTF-8 sequence in the middle.
+    while (n < tx.label.len and n > 0 and tx.label[n] & 0xc0 == 0x80) {
+        n -= 1;
+    }
+    @memset(&rec.label, 0);
+    @memcpy(rec.label[0..n], tx.label[0..n]);
+    rec.label_len = @intCast(n);
+    return rec;
+}
+
+/// returns the total number of transactions, unconfirmed included.
+pub fn total(self: *TxHistory) usize {
+    self.mu.lock();
+    defer self.mu.unlock();
+    return self.pending.items.len + self.count;
+}
+
+/// returns the page of transactions for the query q, newest first with
+/// unconfirmed ones ahead, allocated with the allocator; an arena is best.
+pub fn page(self: *TxHistory, allocator: std.mem.Allocator, q: comm.Message.OnchainTxQuery) !comm.Message.OnchainTxPage {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const npending = self.pending.items.len;
+    const all = npending + self.count;
+    const start = @min(q.offset, all);
+    const end = @min(start + @min(q.limit, max_page), all);
+    const recs = try allocator.alloc(Record, end - start);
+    defer allocator.free(recs);
+    // items start..end: pending first, then file records count-1 down to 0.
+    const pstart = @min(start, npending);
+    const pend = @min(end, npending);
+    @memcpy(recs[0 .. pend - pstart], self.pending.items[pstart..pend]);
+    const fstart = start -| npending; // first file item, newest first
+    const fend = end -| npending;
+    if (fend > fstart) {
+        const frecs = recs[pend - pstart ..];
+        const bytes = std.mem.sliceAsBytes(frecs);
+        if (try self.file.preadAll(bytes, offsetOf(self.count - fend)) != bytes.len) {
+            return error.EndOfStream;
+        }
+        std.mem.reverse(Record, frecs);
+    }
+    const out = try allocator.alloc(comm.Message.OnchainTx, recs.len);
+    for (out, recs) |*o, rec| {
+        o.* = .{
+            .txid = try std.fmt.allocPrint(allocator, "{}", .{std.fmt.fmtSliceHexLower(&rec.txid)}),
+            .height = rec.height,
+            .confirmations = if (rec.height == 0) 0 else (self.cursor + 1) -| rec.height,
+            .time = @intCast(@max(rec.time, 0)),
+            .amount = rec.amount,
+            .fee = rec.fee,
+            .label = try allocator.dupe(u8, rec.label[0..@min(rec.label_len, max_label)]),
+        };
+    }
+    var served = q;
+    served.offset = @intCast(start);
+    served.limit = @intCast(end - start);
+    return .{ .query = served, .total = @intCast(all), .transactions = out };
+}
+
+test "tx history sync and pages" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "sub", "txhistory.bin" });
+    defer t.allocator.free(path);
+
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const a = [_]u8{0xaa} ** 32;
+    const b = [_]u8{0xbb} ** 32;
+    const c = [_]u8{0xcc} ** 32;
+    const d = [_]u8{0xdd} ** 32;
+    {
+        var hist = try open(t.allocator, path);
+        defer hist.close();
+        try t.expectEqual(@as(u32, 0), hist.syncStart());
+        try t.expect(try hist.merge(0, 100, &.{
+            .{ .txid = b, .height = 99, .time = 200, .amount = -5000, .fee = 150, .label = "open channel" },
+            .{ .txid = a, .height = 10, .time = 100, .amount = 21000 },
+            .{ .txid = c, .height = 0, .time = 300, .amount = 700 },
+        }));
+        try t.expectEqual(@as(usize, 2), hist.count);
+        try t.expectEqual(@as(u32, 95), hist.syncStart());
+        // nothing new: unchanged.
+        try t.expect(!try hist.merge(95, 100, &.{
+            .{ .txid = b, .height = 99, .time = 200, .amount = -5000, .fee = 150, .label = "open channel" },
+            .{ .txid = c, .height = 0, .time = 300, .amount = 700 },
+        }));
+    }
+
+    // reopen: confirmed transactions and the cursor persist; a reorg moved
+    // b out, c got mined and d arrived in the mempool.
+    var hist = try open(t.allocator, path);
+    defer hist.close();
+    try t.expectEqual(@as(usize, 2), hist.count);
+    try t.expectEqual(@as(u32, 100), hist.cursor);
+    try t.expectEqual(@as(usize, 0), hist.pending.items.len);
+    const start = hist.syncStart();
+    try t.expect(try hist.merge(start, 102, &.{
+        .{ .txid = c, .height = 101, .time = 300, .amount = 700 },
+        .{ .txid = b, .height = 0, .time = 200, .amount = -5000, .fee = 150 },
+        .{ .txid = d, .height = 0, .time = 400, .amount = 1 },
+    }));
+    try t.expectEqual(@as(usize, 2), hist.count);
+    try t.expectEqual(@as(usize, 4), hist.total());
+
+    const p1 = try hist.page(arena, .{ .offset = 0, .limit = 3 });
+    try t.expectEqual(@as(u32, 4), p1.total);
+    try t.expectEqual(@as(usize, 3), p1.transactions.len);
+    try t.expectEqualStrings("dd" ** 32, p1.transactions[0].txid);
+    try t.expectEqual(@as(u32, 0), p1.transactions[0].confirmations);
+    try t.expectEqualStrings("bb" ** 32, p1.transactions[1].txid);
+    try t.expectEqualStrings("cc" ** 32, p1.transactions[2].txid);
+    try t.expectEqual(@as(u32, 2), p1.transactions[2].confirmations);
+
+    const p2 = try hist.page(arena, .{ .offset = 3, .limit = 10 });
+    try t.expectEqual(@as(u32, 3), p2.query.offset);
+    try t.expectEqual(@as(u32, 1), p2.query.limit);
+    try t.expectEqualStrings("aa" ** 32, p2.transactions[0].txid);
+    try t.expectEqual(@as(u32, 93), p2.transactions[0].confirmations);
+    try t.expectEqual(@as(u64, 100), p2.transactions[0].time);
+
+    const p3 = try hist.page(arena, .{ .offset = 10 });
+    try t.expectEqual(@as(usize, 0), p3.transactions.len);
+    try t.expectEqual(@as(u32, 4), p3.query.offset);
+}
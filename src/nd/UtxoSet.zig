@@ -0,0 +1,208 @@
+//! the lnd onchain wallet unspent outputs, served to ngui a page at a time.
+//! listing them is costly on a large wallet: the set is kept until stale,
+//! as of a new block, a wallet balance change or a wallet transaction, and
+//! listed from lnd again only then. it is sorted by amount, largest first,
+//! with bucket summaries computed once per listing, so that a page is a slice
+//! of the set at the same cost regardless of the number of outputs.
+//! safe for concurrent use.
+
+const std = @import("std");
+const comm = @import("../comm.zig");
+
+const Utxo = comm.Message.OnchainUtxo;
+const Query = comm.Message.OnchainUtxoQuery;
+const Bucket = comm.Message.OnchainUtxoPage.Bucket;
+
+/// max number of outputs in a page.
+pub const max_page = 100;
+
+/// lower bounds of the size buckets, in sat.
+const bucket_mins = [_]u64{ 0, 10_000, 100_000, 1_000_000, 10_000_000 };
+
+mu: std.Thread.Mutex = .{},
+/// holds utxos; reset on each listing.
+arena: std.heap.ArenaAllocator,
+/// a copy of the last listed set, largest first.
+utxos: []const Utxo = &.{},
+buckets: [bucket_mins.len]Bucket = emptyBuckets(),
+/// hash of utxos, to detect changes.
+hash: u64 = 0,
+/// whether the set was listed at least once.
+loaded: bool = false,
+/// incremented by invalidate; see refreshTicket.
+generation: u64 = 1,
+/// generation and chain tip of the last listing.
+listed_generation: u64 = 0,
+listed_height: u32 = 0,
+/// the last observed wallet total balance, in sat.
+balance: ?i64 = null,
+
+const UtxoSet = @This();
+
+pub fn init(allocator: std.mem.Allocator) UtxoSet {
+    return .{ .arena = std.heap.ArenaAllocator.init(allocator) };
+}
+
+pub fn deinit(self: *UtxoSet) void {
+    self.arena.deinit();
+}
+
+/// marks the set stale, such as after a wallet transaction.
+pub fn invalidate(self: *UtxoSet) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.generation += 1;
+}
+
+/// marks the set stale if the wallet total balance differs from the last one
+/// observed.
+pub fn observeBalance(self: *UtxoSet, total: i64) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.balance != null and self.balance.? != total) {
+        self.generation += 1;
+    }
+    self.balance = total;
+}
+
+/// returns a ticket to pass on to set once the outputs are listed if the set
+/// is stale as of the chain tip, or null if it is fresh.
+pub fn refreshTicket(self: *UtxoSet, tip: u32) ?u64 {
+    self.mu.lock();
+    defer self.mu.unlock();
+    if (self.loaded and self.listed_generation == self.generation and self.listed_height == tip) {
+        return null;
+    }
+    return self.generation;
+}
+
+/// replaces the set with a copy of utxos listed as of the chain tip, after
+/// a refreshTicket. the set remains stale if invalidated since the ticket.
+/// returns whether the set changed.
+pub fn set(self: *UtxoSet, ticket: u64, tip: u32, utxos: []const Utxo) !bool {
+    var h = std.hash.Wyhash.init(0);
+    std.hash.autoHashStrat(&h, utxos, .Deep);
+    const hash = h.final();
+
+    self.mu.lock();
+    defer self.mu.unlock();
+    const changed = !self.loaded or hash != self.hash or utxos.len != self.utxos.len;
+    if (changed) {
+        self.utxos = &.{};
+        self.buckets = emptyBuckets();
+        self.hash = 0;
+        _ = self.arena.reset(.retain_capacity);
+        const sorted = try self.arena.allocator().alloc(Utxo, utxos.len);
+        for (utxos, sorted) |u, *dup| {
+            dup.* = try comm.dupeDeep(Utxo, self.arena.allocator(), u);
+        }
+        std.mem.sort(Utxo, sorted, {}, largerFirst);
+        for (sorted) |u| {
+            const amount = std.math.lossyCast(u64, u.amount);
+            const b = &self.buckets[bucketIndex(amount)];
+            b.count +|= 1;
+            b.amount +|= amount;
+        }
+        self.utxos = sorted;
+        self.hash = hash;
+    }
+    self.loaded = true;
+    self.listed_generation = ticket;
+    self.listed_height = tip;
+    return changed;
+}
+
+/// returns the page of outputs for the query q, deep-copied with the
+/// allocator; an arena is best.
+pub fn page(self: *UtxoSet, allocator: std.mem.Allocator, q: Query) !comm.Message.OnchainUtxoPage {
+    self.mu.lock();
+    defer self.mu.unlock();
+    const start = @min(q.offset, self.utxos.len);
+    const end = @min(start + @min(q.limit, max_page), self.utxos.len);
+    return .{
+        .query = .{ .offset = @intCast(start), .limit = @intCast(end - start) },
+        .total = @intCast(self.utxos.len),
+        .loaded = self.loaded,
+        .buckets = try allocator.dupe(Bucket, &self.buckets),
+        .utxos = try comm.dupeDeep([]const Utxo, allocator, self.utxos[start..end]),
+    };
+}
+
+fn emptyBuckets() [bucket_mins.len]Bucket {
+    var b: [bucket_mins.len]Bucket = undefined;
+    for (&b, bucket_mins) |*it, min| {
+        it.* = .{ .min = min, .count = 0, .amount = 0 };
+    }
+    return b;
+}
+
+fn bucketIndex(amount: u64) usize {
+    var i: usize = bucket_mins.len - 1;
+    while (amount < bucket_mins[i]) : (i -= 1) {}
+    return i;
+}
+
+/// ties are ordered by outpoint, for a stable order across listings.
+fn largerFirst(_: void, a: Utxo, b: Utxo) bool {
+    if (a.amount != b.amount) {
+        return a.amount > b.amount;
+    }
+    const o = std.mem.order(u8, &a.outpoint.txid.bytes, &b.outpoint.txid.bytes);
+    return o == .lt or (o == .eq and a.outpoint.index < b.outpoint.index);
+}
+
+test "utxo set pages" {
+    const t = std.testing;
+
+    var cache = UtxoSet.init(t.allocator);
+    defer cache.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(t.allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const empty = try cache.page(arena, .{});
+    try t.expect(!empty.loaded);
+    try t.expectEqual(@as(u32, 0), empty.total);
+
+    var utxos: [4]Utxo = undefined;
+    const amounts = [_]i64{ 5000, 2_000_000, 150_000, 5000 };
+    for (&utxos, amounts, 0..) |*u, amount, i| {
+        u.* = .{
+            .outpoint = .{ .txid = .{ .bytes = [_]u8{@intCast(i)} ** 32 }, .index = 0 },
+            .amount = amount,
+            .confirmations = 1,
+            .address = "bc1q",
+        };
+    }
+    const ticket = cache.refreshTicket(800_000).?;
+    try t.expect(try cache.set(ticket, 800_000, &utxos));
+    try t.expect(cache.refreshTicket(800_000) == null);
+    try t.expect(cache.refreshTicket(800_001) != null); // a new block
+
+    const p1 = try cache.page(arena, .{ .offset = 1, .limit = 2 });
+    try t.expect(p1.loaded);
+    try t.expectEqual(@as(u32, 4), p1.total);
+    try t.expectEqual(@as(usize, 2), p1.utxos.len);
+    try t.expectEqual(@as(i64, 150_000), p1.utxos[0].amount);
+    try t.expectEqual(@as(i64, 5000), p1.utxos[1].amount);
+    try t.expectEqual(@as(u8, 0), p1.utxos[1].outpoint.txid.bytes[0]); // ties by outpoint
+    try t.expectEqual(@as(usize, bucket_mins.len), p1.buckets.len);
+    try t.expectEqual(@as(u32, 2), p1.buckets[0].count);
+    try t.expectEqual(@as(u64, 10_000), p1.buckets[0].amount);
+    try t.expectEqual(@as(u32, 1), p1.buckets[2].count);
+    try t.expectEqual(@as(u32, 1), p1.buckets[3].count);
+    try t.expectEqual(@as(u32, 0), p1.buckets[4].count);
+
+    const p2 = try cache.page(arena, .{ .offset = 10 });
+    try t.expectEqual(@as(u32, 4), p2.query.offset);
+    try t.expectEqual(@as(usize, 0), p2.utxos.len);
+
+    // a balance change makes the set stale; an unchanged listing keeps it.
+    cache.observeBalance(2_160_000);
+    try t.expect(cache.refreshTicket(800_000) == null);
+    cache.observeBalance(2_155_000);
+    const ticket2 = cache.refreshTicket(800_000).?;
+    cache.invalidate(); // while listing
+    try t.expect(!try cache.set(ticket2, 800_000, &utxos));
+    try t.expect(cache.refreshTicket(800_000) != null);
+}
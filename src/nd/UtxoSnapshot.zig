@@ -0,0 +1,209 @@
+//! a published UTXO set snapshot to bootstrap a fresh node with bitcoind
+//! assumeutxo, downloaded over HTTP(S) with its SHA-256 checked as it streams
+//! in, never read back as a whole.
+//!
+//! the download goes to a ".part" file renamed once complete and verified.
+//! an interrupted download resumes with a range request: the partial file is
+//! rehashed first, so that the check always covers the whole file.
+//! bitcoind loadtxoutset then validates the snapshot contents against its own
+//! chain parameters: the digest only guards the transfer.
+
+const std = @import("std");
+const Sha256 = std.crypto.hash.sha2.Sha256;
+
+const logger = std.log.scoped(.utxosnapshot);
+
+url: []const u8,
+sha256: [Sha256.digest_length]u8,
+/// file the snapshot is stored in, readable by bitcoind.
+path: []const u8,
+
+const UtxoSnapshot = @This();
+
+pub const Progress = struct {
+    done: u64, // bytes
+    total: ?u64, // if known from the response
+};
+
+/// parses a hex-encoded digest, as published next to snapshot files.
+pub fn parseDigest(hex: []const u8) ![Sha256.digest_length]u8 {
+    var d: [Sha256.digest_length]u8 = undefined;
+    if (hex.len != d.len * 2) {
+        return error.InvalidDigestLength;
+    }
+    _ = try std.fmt.hexToBytes(&d, hex);
+    return d;
+}
+
+/// downloads the snapshot into self.path, unless it already exists.
+/// ctx is any value with a `fn report(ctx, Progress) bool`, called after each
+/// chunk received: returning false cancels the download with
+/// error.UtxoSnapshotCancelled, keeping the partial file for a later resume.
+pub fn fetch(self: UtxoSnapshot, allocator: std.mem.Allocator, ctx: anytype) !void {
+    if (std.fs.cwd().access(self.path, .{})) |_| {
+        return; // downloaded already
+    } else |err| switch (err) {
+        error.FileNotFound => {},
+        else => return err,
+    }
+    var pathbuf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+    const partpath = try std.fmt.bufPrint(&pathbuf, "{s}.part", .{self.path});
+    const file = try std.fs.cwd().createFile(partpath, .{ .read = true, .truncate = false, .mode = 0o644 });
+    defer file.close();
+    var hasher = Sha256.init(.{});
+    var offset = try rehash(file, &hasher);
+
+    var client = std.http.Client{ .allocator = allocator };
+    defer client.deinit();
+    var headersbuf: [16 * 1024]u8 = undefined;
+    var rangebuf: [32]u8 = undefined;
+    const range = [_]std.http.Header{.{
+        .name = "range",
+        .value = try std.fmt.bufPrint(&rangebuf, "bytes={d}-", .{offset}),
+    }};
+    var req = try client.open(.GET, try std.Uri.parse(self.url), .{
+        .server_header_buffer = &headersbuf,
+        // ranges are of the file as stored: no transfer compression.
+        .headers = .{ .accept_encoding = .{ .override = "identity" } },
+        .extra_headers = if (offset > 0) &range else &.{},
+    });
+    defer req.deinit();
+    try req.send();
+    try req.wait();
+
+    var total: ?u64 = null;
+    switch (req.response.status) {
+        .partial_content => {
+            if (req.response.content_length) |n| total = offset + n;
+            logger.info("{s}: resuming at {d} bytes", .{ self.url, offset });
+        },
+        .ok => {
+            if (offset > 0) {
+                logger.info("{s}: no range support; starting over", .{self.url});
+                try file.setEndPos(0);
+                hasher = Sha256.init(.{});
+                offset = 0;
+            }
+            total = req.response.content_length;
+        },
+        // the partial file is as long as the snapshot already.
+        .range_not_satisfiable => total = offset,
+        else => |status| {
+            logger.err("{s}: {d} {s}", .{ self.url, @intFromEnum(status), status.phrase() orelse "" });
+            return error.UtxoSnapshotHttpStatus;
+        },
+    }
+    if (offset < (total orelse std.math.maxInt(u64))) {
+        try file.seekTo(offset);
+        try receive(file, &hasher, offset, total, req.reader(), ctx);
+    }
+    try self.finish(file, &hasher, partpath);
+}
+
+/// hashes the contents of the partial file, returning its size.
+fn rehash(file: std.fs.File, hasher: *Sha256) !u64 {
+    var buf: [64 * 1024]u8 = undefined;
+    var n: u64 = 0;
+    while (true) {
+        const len = try file.read(&buf);
+        if (len == 0) {
+            return n;
+        }
+        hasher.update(buf[0..len]);
+        n += len;
+    }
+}
+
+/// appends the body from r to the file at offset, hashing it.
+fn receive(file: std.fs.File, hasher: *Sha256, offset: u64, total: ?u64, r: anytype, ctx: anytype) !void {
+    var buf: [64 * 1024]u8 = undefined;
+    var done = offset;
+    while (true) {
+        const n = try r.read(&buf);
+        if (n == 0) {
+            break;
+        }
+        hasher.update(buf[0..n]);
+        try file.writeAll(buf[0..n]);
+        done += n;
+        if (!ctx.report(.{ .done = done, .total = total })) {
+            return error.UtxoSnapshotCancelled;
+        }
+    }
+    if (total) |t| {
+        if (done != t) {
+            return error.UtxoSnapshotTruncated;
+        }
+    }
+}
+
+/// checks the digest of the whole partial file and renames it to self.path.
+/// a mismatching file is removed: a resume would never fix it.
+fn finish(self: UtxoSnapshot, file: std.fs.File, hasher: *Sha256, partpath: []const u8) !void {
+    if (!std.mem.eql(u8, &hasher.finalResult(), &self.sha256)) {
+        std.fs.cwd().deleteFile(partpath) catch |err| logger.err("{s}: {!}", .{ partpath, err });
+        return error.UtxoSnapshotBadDigest;
+    }
+    try file.sync();
+    try std.fs.cwd().rename(partpath, self.path);
+}
+
+test "utxo snapshot resume and digest" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "utxo.dat" });
+    defer t.allocator.free(path);
+    const partpath = try std.fs.path.join(t.allocator, &.{ dir, "utxo.dat.part" });
+    defer t.allocator.free(partpath);
+
+    const content = "utxo set snapshot contents";
+    var digest: [Sha256.digest_length]u8 = undefined;
+    Sha256.hash(content, &digest, .{});
+    var hex: [Sha256.digest_length * 2]u8 = undefined;
+    _ = try std.fmt.bufPrint(&hex, "{}", .{std.fmt.fmtSliceHexLower(&digest)});
+    const snap = UtxoSnapshot{ .url = "unused", .sha256 = try parseDigest(&hex), .path = path };
+    try t.expectError(error.InvalidDigestLength, parseDigest(hex[1..]));
+
+    const Ctx = struct {
+        last: u64 = 0,
+        fn report(self: *@This(), p: Progress) bool {
+            self.last = p.done;
+            return true;
+        }
+    };
+
+    // an interrupted download left the first 10 bytes.
+    try tmp.dir.writeFile("utxo.dat.part", content[0..10]);
+    {
+        const file = try std.fs.cwd().openFile(partpath, .{ .mode = .read_write });
+        defer file.close();
+        var hasher = Sha256.init(.{});
+        const offset = try rehash(file, &hasher);
+        try t.expectEqual(@as(u64, 10), offset);
+        var fbs = std.io.fixedBufferStream(content[10..]);
+        var ctx = Ctx{};
+        try receive(file, &hasher, offset, content.len, fbs.reader(), &ctx);
+        try t.expectEqual(@as(u64, content.len), ctx.last);
+        try snap.finish(file, &hasher, partpath);
+    }
+    const got = try tmp.dir.readFileAlloc(t.allocator, "utxo.dat", 1024);
+    defer t.allocator.free(got);
+    try t.expectEqualStrings(content, got);
+    var unused = Ctx{};
+    try snap.fetch(t.allocator, &unused); // already there: no download
+
+    // a corrupted download is dropped.
+    try tmp.dir.writeFile("utxo.dat.part", "garbage");
+    {
+        const file = try std.fs.cwd().openFile(partpath, .{ .mode = .read_write });
+        defer file.close();
+        var hasher = Sha256.init(.{});
+        _ = try rehash(file, &hasher);
+        try t.expectError(error.UtxoSnapshotBadDigest, snap.finish(file, &hasher, partpath));
+    }
+    try t.expectError(error.FileNotFound, tmp.dir.access("utxo.dat.part", .{}));
+}
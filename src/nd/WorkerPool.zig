@@ -0,0 +1,299 @@
+//! fixed pool of nd worker threads for one-off tasks which take too long to
+//! run on the thread taking the request, such as nodename changes, poweroff
+//! and the UTXO snapshot bootstrap. tasks start in submission order as soon
+//! as a worker is free and report their outcome once done. unlike
+//! JobScheduler jobs, tasks don't exclude one another: a task needing a
+//! service for itself acquires its JobScheduler groups.
+//!
+//! workers have small stacks of a fixed size: tasks keep large buffers on
+//! the heap.
+//!
+//! safe for concurrent use.
+
+const std = @import("std");
+const time = std.time;
+const Atomic = std.atomic.Value;
+
+const comm = @import("../comm.zig");
+
+const logger = std.log.scoped(.workers);
+
+pub const max_workers = 4;
+/// stack size of each worker thread.
+pub const stack_size = 512 * 1024;
+
+allocator: std.mem.Allocator,
+/// set before start; report calls are made without holding mu.
+reporter: ?Reporter = null,
+workers: [max_workers]Worker = [_]Worker{.{}} ** max_workers,
+nworkers: usize = 0,
+
+/// guards all fields below, and Worker.name.
+mu: std.Thread.Mutex = .{},
+/// signaled when a task is queued or the pool stops.
+cond: std.Thread.Condition = .{},
+queue: std.ArrayListUnmanaged(Entry) = .{},
+stopping: bool = false,
+
+const WorkerPool = @This();
+
+pub const Task = struct {
+    name: []const u8, // static; in logs, reports and cancel
+    /// whether to report the outcome; see Reporter.
+    report: bool = true,
+    ctx: *anyopaque,
+    /// owns ctx: it is called exactly once per submitted task, even if
+    /// cancelled before it started, so it may release what it owns.
+    runFn: *const fn (ctx: *anyopaque, tok: Token) anyerror!void,
+};
+
+/// tells a running task whether it is cancelled. a task returns
+/// error.Cancelled when it stops short on seeing it.
+pub const Token = struct {
+    flag: *const Atomic(bool),
+
+    pub fn cancelled(self: Token) bool {
+        return self.flag.load(.monotonic);
+    }
+};
+
+/// receives the outcome of finished tasks, typically sent to ngui.
+pub const Reporter = struct {
+    ctx: *anyopaque,
+    reportFn: *const fn (ctx: *anyopaque, rep: comm.Message.TaskResult) void,
+};
+
+const Entry = struct {
+    task: Task,
+    cancelled: bool = false,
+};
+
+const Worker = struct {
+    thread: ?std.Thread = null,
+    /// name of the running task, if any.
+    name: ?[]const u8 = null,
+    cancelled: Atomic(bool) = Atomic(bool).init(false),
+};
+
+pub fn init(allocator: std.mem.Allocator) WorkerPool {
+    return .{ .allocator = allocator };
+}
+
+/// the pool must be stop'ed first.
+pub fn deinit(self: *WorkerPool) void {
+    self.queue.deinit(self.allocator);
+}
+
+/// spawns n worker threads, up to max_workers. self must not move until stop.
+pub fn start(self: *WorkerPool, n: usize) !void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    self.stopping = false;
+    errdefer {
+        self.stopping = true;
+        self.cond.broadcast();
+    }
+    for (self.workers[0..@min(n, max_workers)]) |*w| {
+        w.thread = try std.Thread.spawn(.{ .stack_size = stack_size }, loop, .{ self, w });
+        self.nworkers += 1;
+    }
+}
+
+/// cancels all tasks and waits for the workers to exit. queued tasks still
+/// run, cancelled, before the workers exit.
+pub fn stop(self: *WorkerPool) void {
+    self.mu.lock();
+    self.stopping = true;
+    for (self.queue.items) |*e| {
+        e.cancelled = true;
+    }
+    for (self.workers[0..self.nworkers]) |*w| {
+        w.cancelled.store(true, .monotonic);
+    }
+    self.cond.broadcast();
+    self.mu.unlock();
+
+    for (self.workers[0..self.nworkers]) |*w| {
+        if (w.thread) |th| {
+            th.join();
+        }
+        w.thread = null;
+    }
+    self.nworkers = 0;
+}
+
+/// queues the task to run once a worker is free. a submit while stopping
+/// runs the task right away, cancelled, in the calling thread.
+pub fn submit(self: *WorkerPool, task: Task) !void {
+    {
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (!self.stopping) {
+            try self.queue.append(self.allocator, .{ .task = task });
+            self.cond.signal();
+            return;
+        }
+    }
+    const cancelled = Atomic(bool).init(true);
+    self.run(task, .{ .flag = &cancelled });
+}
+
+/// cancels all queued and running tasks of the name, and reports whether
+/// there were any.
+pub fn cancel(self: *WorkerPool, name: []const u8) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    var found = false;
+    for (self.queue.items) |*e| {
+        if (std.mem.eql(u8, e.task.name, name)) {
+            e.cancelled = true;
+            found = true;
+        }
+    }
+    for (self.workers[0..self.nworkers]) |*w| {
+        if (w.name != null and std.mem.eql(u8, w.name.?, name)) {
+            w.cancelled.store(true, .monotonic);
+            found = true;
+        }
+    }
+    return found;
+}
+
+/// reports whether any task of the name is queued or running.
+pub fn pending(self: *WorkerPool, name: []const u8) bool {
+    self.mu.lock();
+    defer self.mu.unlock();
+    for (self.queue.items) |e| {
+        if (std.mem.eql(u8, e.task.name, name)) {
+            return true;
+        }
+    }
+    for (self.workers[0..self.nworkers]) |w| {
+        if (w.name != null and std.mem.eql(u8, w.name.?, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// worker thread: runs queued tasks until the pool stops with none left.
+fn loop(self: *WorkerPool, w: *Worker) void {
+    self.mu.lock();
+    defer self.mu.unlock();
+    while (true) {
+        if (self.queue.items.len == 0) {
+            if (self.stopping) {
+                return;
+            }
+            self.cond.wait(&self.mu);
+            continue;
+        }
+        const e = self.queue.orderedRemove(0);
+        w.name = e.task.name;
+        w.cancelled.store(e.cancelled or self.stopping, .monotonic);
+        self.mu.unlock();
+        self.run(e.task, .{ .flag = &w.cancelled });
+        self.mu.lock();
+        w.name = null;
+    }
+}
+
+fn run(self: *WorkerPool, task: Task, tok: Token) void {
+    const start_ms = time.milliTimestamp();
+    const res = task.runFn(task.ctx, tok);
+    const took = time.milliTimestamp() - start_ms;
+    var rep = comm.Message.TaskResult{ .name = task.name, .state = .done, .err = null };
+    if (res) {
+        logger.info("{s}: done in {d}ms", .{ task.name, took });
+    } else |err| switch (err) {
+        error.Cancelled => {
+            logger.info("{s}: cancelled after {d}ms", .{ task.name, took });
+            rep.state = .cancelled;
+        },
+        else => {
+            logger.err("{s}: failed after {d}ms: {!}", .{ task.name, took, err });
+            rep.state = .failed;
+            rep.err = @errorName(err);
+        },
+    }
+    if (task.report) {
+        if (self.reporter) |r| {
+            r.reportFn(r.ctx, rep);
+        }
+    }
+}
+
+test "worker pool" {
+    const t = std.testing;
+
+    const Results = struct {
+        mu: std.Thread.Mutex = .{},
+        list: std.BoundedArray(comm.Message.TaskResult, 8) = .{},
+        fn f(ctx: *anyopaque, rep: comm.Message.TaskResult) void {
+            const self: *@This() = @ptrCast(@alignCast(ctx));
+            self.mu.lock();
+            defer self.mu.unlock();
+            self.list.appendAssumeCapacity(rep);
+        }
+    };
+    const TestTask = struct {
+        gate: std.Thread.ResetEvent = .{},
+        started: std.Thread.ResetEvent = .{},
+        fail: bool = false,
+        fn run(ctx: *anyopaque, tok: Token) anyerror!void {
+            const self: *@This() = @ptrCast(@alignCast(ctx));
+            self.started.set();
+            while (!self.gate.isSet()) {
+                if (tok.cancelled()) {
+                    return error.Cancelled;
+                }
+                time.sleep(time.ns_per_ms);
+            }
+            if (self.fail) {
+                return error.TestTaskFailed;
+            }
+        }
+    };
+
+    var results = Results{};
+    var pool = WorkerPool.init(t.allocator);
+    defer pool.deinit();
+    pool.reporter = .{ .ctx = &results, .reportFn = Results.f };
+    try pool.start(1);
+
+    var a = TestTask{};
+    var b = TestTask{ .fail = true };
+    var c = TestTask{};
+    try pool.submit(.{ .name = "a", .ctx = &a, .runFn = TestTask.run });
+    try pool.submit(.{ .name = "b", .ctx = &b, .runFn = TestTask.run });
+    try pool.submit(.{ .name = "c", .ctx = &c, .runFn = TestTask.run, .report = false });
+    a.started.wait();
+    // a single worker: b waits for a.
+    try t.expect(pool.pending("b"));
+    try t.expect(!b.started.isSet());
+    a.gate.set();
+    b.gate.set();
+    c.started.wait();
+    try t.expect(pool.cancel("c"));
+    try t.expect(!pool.cancel("d"));
+    while (pool.pending("c")) time.sleep(time.ns_per_ms);
+
+    // queued tasks still run, cancelled, on stop.
+    var d = TestTask{};
+    var e = TestTask{};
+    try pool.submit(.{ .name = "d", .ctx = &d, .runFn = TestTask.run });
+    try pool.submit(.{ .name = "e", .ctx = &e, .runFn = TestTask.run });
+    d.started.wait();
+    pool.stop();
+    try t.expect(e.started.isSet());
+
+    const list = results.list.constSlice();
+    try t.expectEqual(@as(usize, 4), list.len);
+    try t.expectEqualStrings("a", list[0].name);
+    try t.expect(list[0].state == .done);
+    try t.expect(list[1].state == .failed);
+    try t.expectEqualStrings("TestTaskFailed", list[1].err.?);
+    try t.expectEqualStrings("d", list[2].name);
+    try t.expect(list[2].state == .cancelled);
+    try t.expect(list[3].state == .cancelled);
+}
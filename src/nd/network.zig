@@ -60,91 +60,291 @@ pub fn addWifi(gpa: mem.Allocator, wpa_ctrl: *types.WpaControl, ssid: []const u8
     return new_wifi_id;
 }
 
-/// reports network status to the writer w in `comm.Message.NetworkReport` format.
-pub fn sendReport(gpa: mem.Allocator, wpa_ctrl: *types.WpaControl, w: anytype) !void {
-    var arena_state = std.heap.ArenaAllocator.init(gpa);
-    defer arena_state.deinit();
-    const arena = arena_state.allocator();
-    var report = comm.Message.NetworkReport{
-        .ipaddrs = undefined,
-        .wifi_ssid = null,
-        .wifi_scan_networks = &.{},
+/// reports network status to w in `comm.Message.NetworkReport` format, always json.
+/// wifi_ssid is of the currently connected network, if any: see parseStatusSSID.
+/// the wifi networks list is taken from scan as is: see WifiScanList.update.
+/// addrs are re-read first unless watched. the wifi link quality is the one
+/// cached in link, if still connected.
+pub fn sendReport(wifi_ssid: ?[]const u8, addrs: *IpAddrList, scan: *const WifiScanList, link: *const WifiLinkQuality, w: *comm.QueueWriter) !void {
+    if (!addrs.watched) {
+        _ = try addrs.refresh();
+    }
+    const report = comm.Message.NetworkReport{
+        .ipaddrs = addrs.list,
+        .wifi_ssid = wifi_ssid,
+        .wifi_scan_networks = scan.sorted.items,
+        .wifi_link = if (wifi_ssid != null) link.current else null,
     };
+    return w.write(comm.Message{ .network_report = report }, .json);
+}
+
+/// public IP addresses of all network interfaces, formatted for reports.
+/// unsafe for concurrent use.
+pub const IpAddrList = struct {
+    arena: std.heap.ArenaAllocator,
+    list: []const []const u8 = &.{},
+    /// true while a nif.netlink.AddrMonitor triggers refresh on each change,
+    /// so that reports may use the list as is.
+    watched: bool = false,
 
-    // fetch all public IP addresses using getifaddrs
-    const pubaddr = try nif.pubAddresses(arena, null);
-    var ipaddr = try std.ArrayList([]const u8).initCapacity(arena, pubaddr.len);
-    for (pubaddr) |apub| {
-        try ipaddr.append(try std.fmt.allocPrint(arena, "{}", .{apub}));
+    pub fn init(allocator: mem.Allocator) IpAddrList {
+        return .{ .arena = std.heap.ArenaAllocator.init(allocator) };
     }
-    report.ipaddrs = try ipaddr.toOwnedSlice();
 
-    // get currently connected SSID, if any, from WPA ctrl
-    report.wifi_ssid = queryWifiSSID(arena, wpa_ctrl) catch |err| blk: {
-        logger.err("queryWifiSsid: {any}", .{err});
-        break :blk null;
-    };
+    pub fn deinit(self: *IpAddrList) void {
+        self.arena.deinit();
+    }
 
-    // fetch available wifi networks from scan results using WPA ctrl
-    const wifi_networks: ?types.StringList = if (queryWifiScanResults(arena, wpa_ctrl)) |v| v else |err| blk: {
-        logger.err("queryWifiScanResults: {any}", .{err});
-        break :blk null;
-    };
-    if (wifi_networks) |list| {
-        report.wifi_scan_networks = list.items();
+    /// re-reads the addresses using getifaddrs and reports whether they changed.
+    pub fn refresh(self: *IpAddrList) !bool {
+        var next = std.heap.ArenaAllocator.init(self.arena.child_allocator);
+        errdefer next.deinit();
+        const alloc = next.allocator();
+        const pubaddr = try nif.pubAddresses(alloc, null);
+        const list = try alloc.alloc([]const u8, pubaddr.len);
+        for (pubaddr, list) |a, *out| {
+            out.* = try std.fmt.allocPrint(alloc, "{}", .{a});
+        }
+        const changed = !eqlStrings(self.list, list);
+        self.arena.deinit();
+        self.arena = next;
+        self.list = list;
+        return changed;
     }
+};
 
-    // report everything back to ngui
-    return comm.write(gpa, w, comm.Message{ .network_report = report });
+fn eqlStrings(a: []const []const u8, b: []const []const u8) bool {
+    if (a.len != b.len) {
+        return false;
+    }
+    for (a, b) |x, y| {
+        if (!mem.eql(u8, x, y)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-/// returns SSID of the currenly connected wifi, if any.
-/// callers must free returned value with the same allocator.
-fn queryWifiSSID(gpa: mem.Allocator, wpa_ctrl: *types.WpaControl) !?[]const u8 {
-    var buf: [512:0]u8 = undefined;
-    const resp = try wpa_ctrl.request("STATUS", &buf, null);
-    const ssid = "ssid=";
+/// available wifi networks as of the latest scan results, persistent across
+/// scans so that a report doesn't need to re-query and parse them.
+/// unsafe for concurrent use.
+pub const WifiScanList = struct {
+    allocator: mem.Allocator,
+    /// ssid to the strongest signal level among its BSSes, in dBm.
+    /// keys are owned by the list.
+    nets: std.StringArrayHashMapUnmanaged(Net) = .{},
+    /// ssids sorted by signal level, strongest first, at most max_networks.
+    /// references nets keys; valid until the next update.
+    sorted: std.ArrayListUnmanaged([]const u8) = .{},
+    /// whether update succeeded at least once.
+    updated: bool = false,
+
+    /// long lists are of no use on a small screen.
+    pub const max_networks = 32;
+
+    const Net = struct {
+        level: i32,
+        seen: bool, // in the current update
+    };
+
+    pub fn init(allocator: mem.Allocator) WifiScanList {
+        return .{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *WifiScanList) void {
+        for (self.nets.keys()) |k| {
+            self.allocator.free(k);
+        }
+        self.nets.deinit(self.allocator);
+        self.sorted.deinit(self.allocator);
+    }
+
+    /// re-reads the wpa_supplicant BSS table one entry per request, which keeps
+    /// each response small regardless of how many networks are around.
+    /// returns true if the sorted list changed.
+    pub fn update(self: *WifiScanList, wpa_ctrl: *types.WpaControl) !bool {
+        self.begin();
+        // ID, LEVEL and SSID fields; see WPA_BSS_MASK_xxx in wpa_ctrl.h.
+        const mask = "MASK=0x1081";
+        var cmdbuf: [64:0]u8 = undefined;
+        var cmd: [:0]const u8 = "BSS FIRST " ++ mask;
+        var buf: [512:0]u8 = undefined;
+        var n: usize = 0;
+        while (n < max_bss) : (n += 1) {
+            const resp = try wpa_ctrl.request(cmd, &buf, null);
+            const bss = parseBss(resp) orelse break; // end of the table
+            if (bss.ssid.len > 0) { // hidden networks aren't listed
+                try self.add(bss.ssid, bss.level);
+            }
+            cmd = try std.fmt.bufPrintZ(&cmdbuf, "BSS NEXT-{d} " ++ mask, .{bss.id});
+        }
+        return self.finish();
+    }
+
+    /// a safety net against a misbehaving BSS NEXT iteration.
+    const max_bss = 1024;
+
+    fn begin(self: *WifiScanList) void {
+        for (self.nets.values()) |*v| {
+            v.* = .{ .level = std.math.minInt(i32), .seen = false };
+        }
+    }
+
+    fn add(self: *WifiScanList, ssid: []const u8, level: i32) !void {
+        const res = try self.nets.getOrPut(self.allocator, ssid);
+        if (!res.found_existing) {
+            res.key_ptr.* = self.allocator.dupe(u8, ssid) catch |err| {
+                self.nets.swapRemoveAt(res.index);
+                return err;
+            };
+            res.value_ptr.* = .{ .level = level, .seen = true };
+            return;
+        }
+        res.value_ptr.* = .{ .level = @max(level, res.value_ptr.level), .seen = true };
+    }
+
+    /// drops networks not seen since begin and rebuilds the sorted list.
+    fn finish(self: *WifiScanList) !bool {
+        var top = std.ArrayListUnmanaged([]const u8){};
+        errdefer top.deinit(self.allocator);
+        for (self.nets.keys(), self.nets.values()) |k, v| {
+            if (v.seen) {
+                try top.append(self.allocator, k);
+            }
+        }
+        std.sort.pdq([]const u8, top.items, &self.nets, stronger);
+        top.shrinkRetainingCapacity(@min(top.items.len, max_networks));
+
+        // the old list may reference keys removed below.
+        const changed = !eqlStrings(top.items, self.sorted.items);
+        var i: usize = self.nets.count();
+        while (i > 0) {
+            i -= 1;
+            if (!self.nets.values()[i].seen) {
+                self.allocator.free(self.nets.keys()[i]);
+                self.nets.swapRemoveAt(i);
+            }
+        }
+        self.sorted.deinit(self.allocator);
+        self.sorted = top;
+        self.updated = true;
+        return changed;
+    }
+
+    fn stronger(nets: *const std.StringArrayHashMapUnmanaged(Net), a: []const u8, b: []const u8) bool {
+        const la = nets.get(a).?.level;
+        const lb = nets.get(b).?.level;
+        return la > lb or (la == lb and mem.lessThan(u8, a, b));
+    }
+};
+
+/// wifi link quality as of the latest nl80211 station info sample, cached
+/// across reports. samples are taken on a slow interval and count as a change
+/// only when they differ from the last reported one enough for a user to
+/// notice: signal strength jitters by a dB or two and rate control keeps
+/// stepping bitrates up and down all the time.
+/// unsafe for concurrent use.
+pub const WifiLinkQuality = struct {
+    /// the latest sample; null while not associated.
+    current: ?Link = null,
+    /// the sample as of the last reported change.
+    reported: ?Link = null,
+    /// counters of the previous sample, for the retries ratio.
+    prev: ?nif.nl80211.StationInfo = null,
+
+    pub const Link = comm.Message.NetworkReport.WifiLink;
+
+    /// min signal strength change, in dB.
+    pub const min_signal_delta = 3;
+    /// min bitrate change, in percent.
+    pub const min_bitrate_delta = 20;
+    /// min retries ratio change, in percentage points.
+    pub const min_retries_delta = 5;
+
+    /// records a new sample and reports whether it is a meaningful change;
+    /// info is null while not associated.
+    pub fn update(self: *WifiLinkQuality, info: ?nif.nl80211.StationInfo) bool {
+        const sta = info orelse {
+            self.prev = null;
+            self.current = null;
+            return self.commit();
+        };
+        var retries: u8 = 0;
+        if (self.prev) |p| {
+            // counters start over on reassociation.
+            const sent = sta.tx_packets -| p.tx_packets;
+            if (sent > 0) {
+                const retried: u64 = sta.tx_retries -| p.tx_retries;
+                retries = std.math.lossyCast(u8, @min(100, retried * 100 / sent));
+            }
+        }
+        self.prev = sta;
+        self.current = .{ .signal = sta.signal, .tx_bitrate = sta.tx_bitrate, .rx_bitrate = sta.rx_bitrate, .retries = retries };
+        return self.commit();
+    }
+
+    fn commit(self: *WifiLinkQuality) bool {
+        if (!changed(self.reported, self.current)) {
+            return false;
+        }
+        self.reported = self.current;
+        return true;
+    }
+
+    fn changed(old: ?Link, new: ?Link) bool {
+        const a = old orelse return new != null;
+        const b = new orelse return true;
+        return @abs(@as(i16, a.signal) - b.signal) >= min_signal_delta or
+            bitrateChanged(a.tx_bitrate, b.tx_bitrate) or
+            bitrateChanged(a.rx_bitrate, b.rx_bitrate) or
+            @abs(@as(i16, a.retries) - b.retries) >= min_retries_delta;
+    }
+
+    fn bitrateChanged(old: u32, new: u32) bool {
+        const d: u64 = if (new > old) new - old else old - new;
+        return d * 100 >= @as(u64, old) * min_bitrate_delta and d > 0;
+    }
+};
+
+const Bss = struct {
+    id: u32,
+    level: i32,
+    ssid: []const u8, // as escaped by wpa_supplicant
+};
+
+/// parses a "BSS" command response of key=value lines.
+/// returns null on an empty or FAIL response, meaning no such entry.
+fn parseBss(resp: []const u8) ?Bss {
+    var id: ?u32 = null;
+    var bss = Bss{ .id = 0, .level = std.math.minInt(i32), .ssid = &.{} };
     var it = mem.tokenize(u8, resp, "\n");
     while (it.next()) |line| {
-        if (mem.startsWith(u8, line, ssid)) {
-            // TODO: check line.len vs ssid.len
-            const v = try gpa.dupe(u8, line[ssid.len..]);
-            return v;
+        const eq = mem.indexOfScalar(u8, line, '=') orelse continue;
+        const v = line[eq + 1 ..];
+        const k = line[0..eq];
+        if (mem.eql(u8, k, "id")) {
+            id = std.fmt.parseUnsigned(u32, v, 10) catch return null;
+        } else if (mem.eql(u8, k, "level")) {
+            bss.level = std.fmt.parseInt(i32, v, 10) catch continue;
+        } else if (mem.eql(u8, k, "ssid")) {
+            bss.ssid = v;
         }
     }
-    return null;
+    bss.id = id orelse return null;
+    return bss;
 }
 
-/// returns a list of all available wifi networks once a scan is complete.
-/// the scan is initiated with wpa_ctrl.scan() and it is ready when CTRL-EVENT-SCAN-RESULTS
-/// header is present on wpa_ctrl.
-///
-/// the retuned value must be free'd with StringList.deinit.
-fn queryWifiScanResults(gpa: mem.Allocator, wpa_ctrl: *types.WpaControl) !types.StringList {
-    var buf: [8192:0]u8 = undefined; // TODO: what if isn't enough?
-    // first line is banner: "bssid / frequency / signal level / flags / ssid"
-    const resp = try wpa_ctrl.request("SCAN_RESULTS", &buf, null);
+/// returns SSID of the currenly connected wifi, if any, from a wpa_supplicant
+/// STATUS command response. the returned value references resp.
+pub fn parseStatusSSID(resp: []const u8) ?[]const u8 {
+    const ssid = "ssid=";
     var it = mem.tokenize(u8, resp, "\n");
-    if (it.next() == null) {
-        return error.MissingWifiScanHeader;
-    }
-
-    var seen = std.BufSet.init(gpa);
-    defer seen.deinit();
-    var list = types.StringList.init(gpa);
-    errdefer list.deinit();
     while (it.next()) |line| {
-        // TODO: wpactrl's text protocol won't work for names with control characters
-        if (mem.lastIndexOfScalar(u8, line, '\t')) |i| {
-            const s = mem.trim(u8, line[i..], "\t\n");
-            if (s.len == 0 or seen.contains(s)) {
-                continue;
-            }
-            try seen.insert(s);
-            try list.append(s);
+        if (mem.startsWith(u8, line, ssid)) {
+            return line[ssid.len..];
         }
     }
-    return list;
+    return null;
 }
 
 const WifiNetworksListFilter = struct {
@@ -175,3 +375,76 @@ fn queryWifiNetworksList(gpa: mem.Allocator, wpa_ctrl: *types.WpaControl, filter
     }
     return try list.toOwnedSlice();
 }
+
+test "wifi scan list" {
+    const t = std.testing;
+
+    try t.expect(parseBss("") == null);
+    try t.expect(parseBss("FAIL\n") == null);
+    const bss = parseBss("id=7\nlevel=-61\nssid=home\n").?;
+    try t.expectEqual(@as(u32, 7), bss.id);
+    try t.expectEqual(@as(i32, -61), bss.level);
+    try t.expectEqualStrings("home", bss.ssid);
+
+    try t.expectEqualStrings("home", parseStatusSSID("bssid=00:11:22:33:44:55\nssid=home\nwpa_state=COMPLETED\n").?);
+    try t.expect(parseStatusSSID("wpa_state=DISCONNECTED\n") == null);
+
+    var list = WifiScanList.init(t.allocator);
+    defer list.deinit();
+    list.begin();
+    try list.add("b", -70);
+    try list.add("a", -50);
+    try list.add("b", -40); // another BSS of the same network
+    try list.add("c", -70);
+    try t.expect(try list.finish());
+    try t.expectEqual(@as(usize, 3), list.sorted.items.len);
+    try t.expectEqualStrings("b", list.sorted.items[0]);
+    try t.expectEqualStrings("a", list.sorted.items[1]);
+    try t.expectEqualStrings("c", list.sorted.items[2]);
+
+    // same networks, slightly different levels
+    list.begin();
+    try list.add("a", -52);
+    try list.add("b", -41);
+    try list.add("c", -75);
+    try t.expect(!try list.finish());
+
+    // "a" is gone
+    list.begin();
+    try list.add("c", -60);
+    try list.add("b", -41);
+    try t.expect(try list.finish());
+    try t.expectEqual(@as(usize, 2), list.nets.count());
+    try t.expectEqualStrings("b", list.sorted.items[0]);
+    try t.expectEqualStrings("c", list.sorted.items[1]);
+}
+
+test "wifi link quality" {
+    const t = std.testing;
+
+    var link = WifiLinkQuality{};
+    try t.expect(!link.update(null));
+    var sta = nif.nl80211.StationInfo{ .signal = -60, .tx_bitrate = 72200, .rx_bitrate = 65000, .tx_packets = 1000, .tx_retries = 100, .tx_failed = 0 };
+    try t.expect(link.update(sta));
+    try t.expectEqual(@as(u8, 0), link.current.?.retries);
+
+    // jitter
+    sta.signal = -62;
+    sta.tx_bitrate = 65000;
+    sta.tx_packets = 2000;
+    sta.tx_retries = 130;
+    try t.expect(!link.update(sta));
+    try t.expectEqual(@as(i8, -62), link.current.?.signal);
+    try t.expectEqual(@as(u8, 3), link.current.?.retries);
+    try t.expectEqual(@as(i8, -60), link.reported.?.signal);
+
+    // drifted away from the reported one
+    sta.signal = -63;
+    try t.expect(link.update(sta));
+    sta.tx_bitrate = 39000;
+    try t.expect(link.update(sta));
+    try t.expect(!link.update(sta));
+
+    try t.expect(link.update(null));
+    try t.expect(link.current == null);
+}
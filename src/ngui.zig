@@ -1,9 +1,15 @@
 const buildopts = @import("build_options");
+const builtin = @import("builtin");
 const std = @import("std");
 const posix = std.posix;
 const time = std.time;
 
+const allocprof = @import("allocprof.zig");
+const lockprof = @import("lockprof.zig");
 const comm = @import("comm.zig");
+const logring = @import("logring.zig");
+const tcalloc = @import("tcalloc.zig");
+const trace = @import("trace.zig");
 const types = @import("types.zig");
 const ui = @import("ui/ui.zig");
 const lvgl = @import("ui/lvgl.zig");
@@ -11,23 +17,37 @@ const screen = @import("ui/screen.zig");
 const screenlock = @import("ui/screenlock.zig");
 const symbol = @import("ui/symbol.zig");
 
+/// log calls go to an in-memory ring flushed by a background thread, so that
+/// the loops don't block on stderr. release builds keep debug records in the
+/// ring only, written out on SIGUSR1 dump; see logring.zig.
+pub const std_options: std.Options = .{
+    .log_level = .debug,
+    .logFn = logring.logFn,
+};
+
 const logger = std.log.scoped(.ngui);
 
 // these are auto-closed as soon as main fn terminates.
 const stderr = std.io.getStdErr().writer();
 
 extern "c" fn ui_update_network_status(text: [*:0]const u8, wifi_list: ?[*:0]const u8) void;
+extern "c" fn nm_ui_tab_built(n: u16) bool;
+extern "c" fn nm_ui_prerender_tab(n: u16) c_int;
+extern "c" fn nm_ui_show_tab(n: u16) void;
 
-/// global heap allocator used throughout the GUI program.
-/// TODO: thread-safety?
+/// global heap allocator used throughout the GUI program, from both the UI
+/// and comm threads. release builds use the thread-caching tcalloc; debug builds
+/// GeneralPurposeAllocator for its leak detection. both are safe for concurrent use.
 var gpa: std.mem.Allocator = undefined;
 
-/// the mutex must be held before any call reaching into lv_xxx functions.
-/// all nm_xxx functions assume it is the case since they are invoked from lvgl c code.
-var ui_mutex: std.Thread.Mutex = .{};
+/// messages from the daemon to be applied by the UI thread, other than reports
+/// which go to last_report. only the UI thread calls into lv_xxx functions,
+/// so that it never waits for a lock held by the comm thread.
+/// initialized in main before starting the UI and comm threads.
+var ui_queue: types.MpscQueue(comm.ParsedMessage) = undefined;
 
 /// current state of the GUI.
-/// guarded by `ui_mutex` since some `nm_xxx` funcs branch based off of the state.
+/// accessed only from the UI thread; some `nm_xxx` funcs branch based off of the state.
 var state: enum {
     active, // normal operational mode
     standby, // idling
@@ -39,14 +59,47 @@ var slock_status: enum {
     disabled,
 } = undefined; // set in main after parsing cmd line flags
 
-/// last report received from comm.
+/// last report received from comm: a latest-value mailbox per report type.
+/// the comm thread only swaps in new reports, and the UI thread renders
+/// pending ones; see applyPendingReports.
+/// reports are retained as compact copies, without the parser arenas, so that
+/// memory use is close to the size of the data the widgets show.
 /// deinit'ed at program exit.
 /// while deinit and replace handle concurrency, field access requires holding mu.
 var last_report: struct {
-    mu: std.Thread.Mutex = .{},
-    network: ?comm.ParsedMessage = null, // NetworkReport
-    onchain: ?comm.ParsedMessage = null, // OnchainReport
-    lightning: ?comm.ParsedMessage = null, // LightningReport or LightningError
+    mu: lockprof.Mutex = .{ .name = .ngui_reports },
+    network: ?comm.CompactMessage = null, // NetworkReport
+    onchain: ?comm.CompactMessage = null, // OnchainReport
+    lightning: ?comm.CompactMessage = null, // LightningReport or LightningError
+    history: ?comm.CompactMessage = null, // HistoryReport
+    system: ?comm.CompactMessage = null, // SystemReport
+    compaction: ?comm.CompactMessage = null, // LndCompaction
+    backup: ?comm.CompactMessage = null, // ChannelBackup
+    bootstrap: ?comm.CompactMessage = null, // BitcoinBootstrap
+    startup: ?comm.CompactMessage = null, // BitcoindStartup; dropped with an onchain report
+    tor: ?comm.CompactMessage = null, // TorStatus
+    htlc: ?comm.CompactMessage = null, // HtlcActivity
+    graph: ?comm.CompactMessage = null, // LightningGraph
+    /// when nd last collected the onchain and lightning reports; checked
+    /// periodically by nm_check_freshness.
+    freshness: comm.Message.ReportFreshness = .{},
+    /// reports not yet rendered.
+    pending: struct {
+        network: bool = false, // settings tab
+        onchain: bool = false, // bitcoin tab
+        lightning: bool = false, // lightning tab
+        // history trend charts are in both bitcoin and lightning tabs.
+        bitcoin_history: bool = false,
+        lightning_history: bool = false,
+        system: bool = false, // info tab
+        compaction: bool = false, // info tab
+        backup: bool = false, // info tab
+        bootstrap: bool = false, // bitcoin tab
+        startup: bool = false, // bitcoin tab
+        tor: bool = false, // info tab
+        htlc: bool = false, // lightning tab
+        graph: bool = false, // lightning tab
+    } = .{},
 
     fn deinit(self: *@This()) void {
         self.mu.lock();
@@ -63,9 +116,52 @@ var last_report: struct {
             v.deinit();
             self.lightning = null;
         }
+        if (self.history) |v| {
+            v.deinit();
+            self.history = null;
+        }
+        if (self.system) |v| {
+            v.deinit();
+            self.system = null;
+        }
+        if (self.compaction) |v| {
+            v.deinit();
+            self.compaction = null;
+        }
+        if (self.backup) |v| {
+            v.deinit();
+            self.backup = null;
+        }
+        if (self.bootstrap) |v| {
+            v.deinit();
+            self.bootstrap = null;
+        }
+        if (self.startup) |v| {
+            v.deinit();
+            self.startup = null;
+        }
+        if (self.tor) |v| {
+            v.deinit();
+            self.tor = null;
+        }
+        if (self.htlc) |v| {
+            v.deinit();
+            self.htlc = null;
+        }
+        if (self.graph) |v| {
+            v.deinit();
+            self.graph = null;
+        }
     }
 
-    fn replace(self: *@This(), new: comm.ParsedMessage) void {
+    /// takes ownership of the parsed msg, which is deinit'ed after copying.
+    fn replace(self: *@This(), msg: comm.ParsedMessage) void {
+        defer msg.deinit();
+        // copy outside of the lock: the UI thread may be rendering.
+        const new = comm.CompactMessage.init(gpa, msg.value) catch |err| {
+            logger.err("last_report: replace: {any}", .{err});
+            return;
+        };
         self.mu.lock();
         defer self.mu.unlock();
         const tag: comm.MessageTag = new.value;
@@ -75,24 +171,144 @@ var last_report: struct {
                     old.deinit();
                 }
                 self.network = new;
+                self.pending.network = true;
             },
             .onchain_report => {
                 if (self.onchain) |old| {
                     old.deinit();
                 }
                 self.onchain = new;
+                self.pending.onchain = true;
+                // bitcoind is past its startup: the tab hides its progress.
+                if (self.startup) |old| {
+                    old.deinit();
+                    self.startup = null;
+                }
+                self.pending.startup = false;
             },
             .lightning_report, .lightning_error => {
                 if (self.lightning) |old| {
                     old.deinit();
                 }
                 self.lightning = new;
+                self.pending.lightning = true;
+            },
+            .history_report => {
+                if (self.history) |old| {
+                    old.deinit();
+                }
+                self.history = new;
+                self.pending.bitcoin_history = true;
+                self.pending.lightning_history = true;
+            },
+            .system_report => {
+                if (self.system) |old| {
+                    old.deinit();
+                }
+                self.system = new;
+                self.pending.system = true;
+            },
+            .lnd_compaction => {
+                if (self.compaction) |old| {
+                    old.deinit();
+                }
+                self.compaction = new;
+                self.pending.compaction = true;
+            },
+            .channel_backup => {
+                if (self.backup) |old| {
+                    old.deinit();
+                }
+                self.backup = new;
+                self.pending.backup = true;
+            },
+            .bitcoin_bootstrap => {
+                if (self.bootstrap) |old| {
+                    old.deinit();
+                }
+                self.bootstrap = new;
+                self.pending.bootstrap = true;
+            },
+            .bitcoind_startup => {
+                if (self.startup) |old| {
+                    old.deinit();
+                }
+                self.startup = new;
+                self.pending.startup = true;
             },
-            else => |t| logger.err("last_report: replace: unhandled tag {}", .{t}),
+            .tor_status => {
+                if (self.tor) |old| {
+                    old.deinit();
+                }
+                self.tor = new;
+                self.pending.tor = true;
+            },
+            .htlc_activity => {
+                if (self.htlc) |old| {
+                    old.deinit();
+                }
+                self.htlc = new;
+                self.pending.htlc = true;
+            },
+            .lightning_graph => {
+                if (self.graph) |old| {
+                    old.deinit();
+                }
+                self.graph = new;
+                self.pending.graph = true;
+            },
+            else => |t| {
+                logger.err("last_report: replace: unhandled tag {}", .{t});
+                new.deinit();
+            },
+        }
+    }
+
+    /// applies a lightning report delta to the last received lightning report.
+    fn patchLightning(self: *@This(), delta: comm.Message.LightningReportDelta) !void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        const old = self.lightning orelse return error.NoBaseLightningReport;
+        if (old.value != .lightning_report) {
+            return error.NoBaseLightningReport;
         }
+
+        var scratch = std.heap.ArenaAllocator.init(gpa);
+        defer scratch.deinit();
+        const rep = try comm.applyLightningDelta(scratch.allocator(), old.value.lightning_report, delta);
+        const new = try comm.CompactMessage.init(gpa, .{ .lightning_report = rep });
+        old.deinit();
+        self.lightning = new;
+        self.pending.lightning = true;
     }
 } = .{};
 
+/// main tabview tabs, in nm_ui_init_main_tabview order.
+const Tab = enum(u16) {
+    bitcoin = 0,
+    lightning = 1,
+    settings = 2,
+    info = 3,
+    _,
+};
+
+/// currently visible tab; accessed only from the UI thread.
+var active_tab: Tab = .bitcoin;
+
+/// no user input time after which tabs next to the visible one are built
+/// ahead of a swipe, in ms; see prerenderTabs.
+const prerender_quiet_ms = 1000;
+/// min time till the next LVGL timer for prerenderTabs to run, in ms: a tab
+/// build takes a few frames worth of time.
+const prerender_min_idle_ms = 50;
+/// bit per tab index of failed prerenderTabs builds, which are not retried.
+/// accessed only from the UI thread.
+var prerender_failed: u8 = 0;
+
+/// UI thread time budget for rendering pending reports per loop cycle, in ms.
+/// at least one report is always rendered: the visible tab goes first.
+const apply_budget_ms = 8;
+
 /// the program runs until sigquit is true.
 /// set from sighandler or on unrecoverable comm failure with the daemon.
 var sigquit: std.Thread.ResetEvent = .{};
@@ -100,8 +316,42 @@ var sigquit: std.Thread.ResetEvent = .{};
 /// by setting wakeup brings the screen back from sleep()'ing without waiting for user action.
 /// can be used by comms when an alert is received from the daemon, to draw user attention.
 /// safe for concurrent use except wakeup.reset() is UB during another thread
-/// wakeup.wait()'ing or timedWait'ing.
-var wakeup = std.Thread.ResetEvent{};
+/// screen.sleep'ing. initialized in main before starting the UI thread.
+var wakeup: screen.WakeEvent = .{};
+
+/// no user activity time after which the screen goes standby, in ms.
+const standby_idle_ms = 60000; // 60sec
+/// no user activity time after which the screen dims ahead of standby, in ms.
+const dim_idle_ms = 30000;
+/// display refresh period while dimmed, in ms: nobody is likely watching
+/// closely, so reports may render at a few frames per second.
+const dimmed_refresh_ms = 250;
+/// how often the tabs are checked for data nd failed to collect in time, in ms.
+const freshness_check_ms = 5000;
+/// display refresh period while nd sheds load, in ms: rendering yields cpu
+/// to the node at a still usable frame rate.
+const shed_refresh_ms = 100;
+
+/// whether the screen is dimmed; accessed only from the UI thread.
+var dimmed = false;
+/// whether nd asked to shed optional work; accessed only from the UI thread.
+var shedding = false;
+
+/// set on USR1 for the UI thread to send nd a perf report with an object
+/// census on its next loop cycle; see ui.perf.reportNow.
+var census_requested = std.atomic.Value(bool).init(false);
+
+/// lets the UI thread block while idle; see screen.Idler.
+/// null when unavailable, in which case the UI loop polls LVGL at its timers period.
+/// set once in main before starting the UI and comm threads.
+var ui_idler: ?screen.Idler = null;
+
+/// whether the first message from nd was traced; comm thread only.
+var traced_first_msg = false;
+
+/// the region nd writes lightning reports to, inherited with -shm.
+/// set once in main before starting the comm thread; null if unavailable.
+var report_shm: ?comm.ShmSnapshot = null;
 
 /// a monotonic clock for reporting elapsed ticks to LVGL.
 /// the timer runs throughout the whole duration of the UI program.
@@ -118,18 +368,109 @@ export fn nm_get_curr_tick() u32 {
     return @truncate(ms);
 }
 
-export fn nm_check_idle_time(_: *lvgl.LvTimer) void {
-    const standby_idle_ms = 60000; // 60sec
+/// runs again no later than the next dim or standby deadline, instead of at
+/// a fixed period, to keep an idle UI loop from waking up just to check the
+/// idle time: user activity only ever moves the deadlines further.
+export fn nm_check_idle_time(timer: *lvgl.LvTimer) void {
+    if (buildopts.driver == .headless) {
+        return; // no input device to wake up from standby
+    }
     const idle_ms = lvgl.idleTime();
+    if (idle_ms < dim_idle_ms) {
+        timer.setPeriod(dim_idle_ms - idle_ms);
+        return;
+    }
     if (idle_ms < standby_idle_ms) {
+        if (state == .active) {
+            setDimmed(true);
+        }
+        timer.setPeriod(standby_idle_ms - idle_ms);
         return;
     }
+    timer.setPeriod(standby_idle_ms);
     switch (state) {
         .alert, .standby => {},
         .active => state = .standby,
     }
 }
 
+/// dims the screen backlight, via nd, and throttles rendering, or brings both
+/// back. must be called from the UI thread.
+fn setDimmed(v: bool) void {
+    if (dimmed == v) {
+        return;
+    }
+    dimmed = v;
+    lvgl.setRefreshPeriod(refreshPeriod());
+    const msg = if (v) comm.Message.dim else comm.Message.wakeup;
+    comm.pipeWrite(msg) catch |err| logger.err("{s}: {any}", .{ @tagName(msg), err });
+}
+
+/// marks the bitcoin and lightning tabs stale once nd is past due a report
+/// collection according to last_report.freshness, or current again. reports
+/// are held back by nd while unchanged, so their arrival says nothing of
+/// the age of the data on screen. the collection times also go to nd with
+/// the perf reports.
+export fn nm_check_freshness(_: *lvgl.LvTimer) void {
+    const f = blk: {
+        last_report.mu.lock();
+        defer last_report.mu.unlock();
+        break :blk last_report.freshness;
+    };
+    ui.perf.setCollected(.{
+        .onchain = if (f.onchain) |v| v.collected_at else 0,
+        .lightning = if (f.lightning) |v| v.collected_at else 0,
+    });
+    const now: u64 = std.math.lossyCast(u64, time.timestamp());
+    if (f.onchain) |v| {
+        if (nm_ui_tab_built(@intFromEnum(Tab.bitcoin))) {
+            ui.bitcoin.updateFreshness(staleAge(v, now)) catch |err| logger.err("bitcoin.updateFreshness: {any}", .{err});
+        }
+    }
+    if (f.lightning) |v| {
+        if (nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+            ui.lightning.updateFreshness(staleAge(v, now)) catch |err| logger.err("lightning.updateFreshness: {any}", .{err});
+        }
+    }
+}
+
+/// returns the age of a collection in seconds as of now, if stale.
+fn staleAge(f: comm.Message.ReportFreshness.Freshness, now: u64) ?u64 {
+    const age = now -| f.collected_at;
+    return if (age > f.stale_after_sec) age else null;
+}
+
+/// logs LVGL cache hit rates and memory usage, to tune -Dlvgl_xxx_cache build options,
+/// followed by the ngui heap usage.
+export fn nm_log_lvgl_stats(_: *lvgl.LvTimer) void {
+    const st = lvgl.cacheStats();
+    const rate = lvgl.CacheStats.hitRate;
+    logger.info("lvgl cache hit rate %: img {?d} of {d}, grad {?d} of {d}, circle {?d} of {d}, style {?d} of {d}, txt {?d} of {d}", .{
+        rate(st.img_hit, st.img_miss),
+        @as(u64, st.img_hit) + st.img_miss,
+        rate(st.grad_hit, st.grad_miss),
+        @as(u64, st.grad_hit) + st.grad_miss,
+        rate(st.circle_hit, st.circle_miss),
+        @as(u64, st.circle_hit) + st.circle_miss,
+        rate(st.style_hit, st.style_miss),
+        @as(u64, st.style_hit) + st.style_miss,
+        rate(st.txt_hit, st.txt_miss),
+        @as(u64, st.txt_hit) + st.txt_miss,
+    });
+    const ms = lvgl.mem.stats();
+    logger.info("lvgl mem: used {d} peak {d} large {d} pooled {d} frag {d}%", .{
+        ms.used,
+        ms.peak,
+        ms.large,
+        ms.pooled,
+        ms.fragmentation(),
+    });
+    if (builtin.mode != .Debug) {
+        const hs = tcalloc.stats();
+        logger.info("heap: used {d} peak {d} large {d} pooled {d}", .{ hs.used, hs.peak, hs.large, hs.pooled });
+    }
+}
+
 /// tells the daemon to initiate system shutdown leading to power off.
 /// once all's done, the daemon will send a SIGTERM back to ngui.
 export fn nm_sys_shutdown() void {
@@ -139,16 +480,177 @@ export fn nm_sys_shutdown() void {
     wakeup.set(); // wake up from standby, if any
 }
 
+/// nd pushes network reports, starting with a wifi scan, while the settings
+/// tab is active; see nm_tab_changed.
 export fn nm_tab_settings_active() void {
+    if (active_tab == .settings) {
+        return; // already subscribed
+    }
     logger.info("starting wifi scan", .{});
-    const msg = comm.Message{ .get_network_report = .{ .scan = true } };
-    comm.pipeWrite(msg) catch |err| logger.err("nm_tab_settings_active: {any}", .{err});
+    comm.pipeWrite(.subscribe_network) catch |err| logger.err("nm_tab_settings_active: {any}", .{err});
 }
 
-export fn nm_request_network_status(t: *lvgl.LvTimer) void {
-    t.destroy();
-    const msg: comm.Message = .{ .get_network_report = .{ .scan = false } };
-    comm.pipeWrite(msg) catch |err| logger.err("nm_request_network_status: {any}", .{err});
+/// invoked when the UI is switched to tab index n.
+/// the visible tab pending report, if any, is rendered first in the next loop cycle.
+export fn nm_tab_changed(n: u16) void {
+    const tab: Tab = @enumFromInt(n);
+    if (active_tab == .settings and tab != .settings) {
+        comm.pipeWrite(.unsubscribe_network) catch |err| logger.err("nm_tab_changed: {any}", .{err});
+    }
+    active_tab = tab;
+}
+
+/// builds the first unbuilt tab next to the visible one, if any, and lays
+/// out both neighbours, so that a swipe to either renders what's ready
+/// instead of a skeleton and a build at the end of the animation. runs only
+/// in otherwise idle loop cycles, with till_next_ms until the next LVGL timer,
+/// and yields to user input. returns true if it built a tab.
+/// must be called from the UI thread.
+fn prerenderTabs(till_next_ms: u32) bool {
+    if (till_next_ms < prerender_min_idle_ms or lvgl.idleTime() < prerender_quiet_ms or lvgl.runningAnimations() > 0) {
+        return false;
+    }
+    const cur = @intFromEnum(active_tab);
+    const next = [_]u16{ cur +| 1, cur -| 1 };
+    var built = false;
+    for (next) |n| {
+        if (n == cur or n > @intFromEnum(Tab.info) or prerender_failed & (@as(u8, 1) << @intCast(n)) != 0) {
+            continue;
+        }
+        const was_built = nm_ui_tab_built(n);
+        if (!was_built and (built or screen.inputPending())) {
+            continue; // one build per cycle, none with a tap on its way
+        }
+        const start = tick_timer.read();
+        if (nm_ui_prerender_tab(n) != 0) {
+            logger.err("prerender tab {d} failed", .{n});
+            prerender_failed |= @as(u8, 1) << @intCast(n);
+            continue;
+        }
+        if (!was_built) {
+            built = true;
+            logger.debug("prerendered tab {d} in {d}ms", .{ n, (tick_timer.read() - start) / time.ns_per_ms });
+        }
+    }
+    return built;
+}
+
+/// renders pending last reports into built tab panels, starting with the visible
+/// tab and at most one report per type, within apply_budget_ms.
+/// returns true if anything was rendered.
+/// must be called from the UI thread.
+fn applyPendingReports() bool {
+    last_report.mu.lock();
+    defer last_report.mu.unlock();
+    const pending = &last_report.pending;
+    const start = tick_timer.read();
+    var applied = false;
+    const order = [_]Tab{ active_tab, .bitcoin, .lightning, .settings, .info };
+    for (order) |tab| {
+        if (applied and tick_timer.read() - start >= apply_budget_ms * time.ns_per_ms) {
+            break;
+        }
+        if (!nm_ui_tab_built(@intFromEnum(tab))) {
+            continue;
+        }
+        switch (tab) {
+            .bitcoin => {
+                if (pending.onchain) {
+                    pending.onchain = false;
+                    applied = true;
+                    ui.bitcoin.updateTabPanel(last_report.onchain.?.value.onchain_report) catch |err| {
+                        logger.err("bitcoin.updateTabPanel: {any}", .{err});
+                    };
+                }
+                if (pending.bitcoin_history) {
+                    pending.bitcoin_history = false;
+                    applied = true;
+                    ui.bitcoin.updateHistory(last_report.history.?.value.history_report);
+                }
+                if (pending.bootstrap) {
+                    pending.bootstrap = false;
+                    applied = true;
+                    ui.bitcoin.updateBootstrap(last_report.bootstrap.?.value.bitcoin_bootstrap) catch |err| {
+                        logger.err("bitcoin.updateBootstrap: {any}", .{err});
+                    };
+                }
+                if (pending.startup) {
+                    pending.startup = false;
+                    applied = true;
+                    ui.bitcoin.updateStartup(last_report.startup.?.value.bitcoind_startup) catch |err| {
+                        logger.err("bitcoin.updateStartup: {any}", .{err});
+                    };
+                }
+            },
+            .lightning => {
+                if (pending.lightning) {
+                    pending.lightning = false;
+                    applied = true;
+                    ui.lightning.updateTabPanel(last_report.lightning.?.value) catch |err| {
+                        logger.err("lightning.updateTabPanel: {any}", .{err});
+                    };
+                }
+                if (pending.lightning_history) {
+                    pending.lightning_history = false;
+                    applied = true;
+                    ui.lightning.updateHistory(last_report.history.?.value.history_report);
+                }
+                if (pending.htlc) {
+                    pending.htlc = false;
+                    applied = true;
+                    ui.lightning.updateHtlcActivity(last_report.htlc.?.value.htlc_activity) catch |err| {
+                        logger.err("lightning.updateHtlcActivity: {any}", .{err});
+                    };
+                }
+                if (pending.graph) {
+                    pending.graph = false;
+                    applied = true;
+                    ui.lightning.updateGraph(last_report.graph.?.value.lightning_graph) catch |err| {
+                        logger.err("lightning.updateGraph: {any}", .{err});
+                    };
+                }
+            },
+            .settings => if (pending.network) {
+                pending.network = false;
+                applied = true;
+                updateNetworkStatus(last_report.network.?.value.network_report) catch |err| {
+                    logger.err("updateNetworkStatus: {any}", .{err});
+                };
+            },
+            .info => {
+                if (pending.system) {
+                    pending.system = false;
+                    applied = true;
+                    ui.updateInfoPanel(last_report.system.?.value.system_report) catch |err| {
+                        logger.err("updateInfoPanel: {any}", .{err});
+                    };
+                }
+                if (pending.compaction) {
+                    pending.compaction = false;
+                    applied = true;
+                    ui.updateInfoCompaction(last_report.compaction.?.value.lnd_compaction) catch |err| {
+                        logger.err("updateInfoCompaction: {any}", .{err});
+                    };
+                }
+                if (pending.backup) {
+                    pending.backup = false;
+                    applied = true;
+                    ui.updateInfoBackup(last_report.backup.?.value.channel_backup) catch |err| {
+                        logger.err("updateInfoBackup: {any}", .{err});
+                    };
+                }
+                if (pending.tor) {
+                    pending.tor = false;
+                    applied = true;
+                    ui.updateInfoTor(last_report.tor.?.value.tor_status) catch |err| {
+                        logger.err("updateInfoTor: {any}", .{err});
+                    };
+                }
+            },
+            else => {},
+        }
+    }
+    return applied;
 }
 
 /// ssid and password args must not outlive this function.
@@ -161,21 +663,70 @@ export fn nm_wifi_start_connect(ssid: [*:0]const u8, password: [*:0]const u8) vo
     comm.pipeWrite(msg) catch |err| logger.err("nm_wifi_start_connect: {any}", .{err});
 }
 
+/// ssids of the wifi scan list as shown in the settings dropdown, interned in
+/// wifi_ssids; the dropdown is rebuilt only when the list changes.
+/// accessed only from the UI thread.
+var wifi_ssids: types.StringPool = undefined;
+var wifi_shown: std.ArrayListUnmanaged(types.StringPool.Id) = .{};
+/// the pool starts over past this size, to drop networks long gone.
+const max_wifi_ssids_size = 16 * 1024;
+/// no more networks than this are in the dropdown; nd sends them strongest
+/// first, and capped already.
+const max_wifi_options = 32;
+
+/// returns the dropdown options of the scanned networks, or null if unchanged
+/// since the last call. callers own the returned value, allocated with gpa.
+fn wifiOptions(networks: []const []const u8) !?[:0]const u8 {
+    if (wifi_ssids.size() > max_wifi_ssids_size) {
+        wifi_ssids.reset();
+        wifi_shown.clearRetainingCapacity(); // ids are now stale
+    }
+    var ids: [max_wifi_options]types.StringPool.Id = undefined;
+    const n = @min(networks.len, ids.len);
+    for (networks[0..n], ids[0..n]) |ssid, *id| {
+        // null bytes would cut the options short.
+        id.* = try wifi_ssids.intern(ssid[0 .. std.mem.indexOfScalar(u8, ssid, 0) orelse ssid.len]);
+    }
+    if (std.mem.eql(types.StringPool.Id, ids[0..n], wifi_shown.items)) {
+        return null;
+    }
+    try wifi_shown.resize(gpa, n);
+    @memcpy(wifi_shown.items, ids[0..n]);
+
+    var opts = std.ArrayList(u8).init(gpa);
+    errdefer opts.deinit();
+    for (wifi_shown.items, 0..) |id, i| {
+        if (i > 0) {
+            try opts.append('\n');
+        }
+        try opts.appendSlice(wifi_ssids.get(id));
+    }
+    return try opts.toOwnedSliceSentinel(0);
+}
+
 /// callers must hold ui mutex for the whole duration.
 fn updateNetworkStatus(report: comm.Message.NetworkReport) !void {
     var wifi_list: ?[:0]const u8 = null;
-    var wifi_list_ptr: ?[*:0]const u8 = null;
     if (report.wifi_scan_networks.len > 0) {
-        wifi_list = try std.mem.joinZ(gpa, "\n", report.wifi_scan_networks);
-        wifi_list_ptr = wifi_list.?.ptr;
+        wifi_list = try wifiOptions(report.wifi_scan_networks);
     }
     defer if (wifi_list) |v| gpa.free(v);
+    const wifi_list_ptr: ?[*:0]const u8 = if (wifi_list) |v| v.ptr else null;
 
     var status = std.ArrayList(u8).init(gpa); // free'd as owned slice below
     const w = status.writer();
     if (report.wifi_ssid) |ssid| {
         try w.writeAll(symbol.Ok);
         try w.print(" connected to {s}", .{ssid});
+        if (report.wifi_link) |link| {
+            try w.print("\nsignal {d} dBm, {d}% retries", .{ link.signal, link.retries });
+            if (link.tx_bitrate > 0 or link.rx_bitrate > 0) {
+                try w.print("\nbitrate tx {d}.{d} / rx {d}.{d} Mbit/s", .{
+                    link.tx_bitrate / 1000, link.tx_bitrate % 1000 / 100,
+                    link.rx_bitrate / 1000, link.rx_bitrate % 1000 / 100,
+                });
+            }
+        }
     } else {
         try w.writeAll(symbol.Warning);
         try w.print(" disconnected", .{});
@@ -189,18 +740,9 @@ fn updateNetworkStatus(report: comm.Message.NetworkReport) !void {
 
     const text = try status.toOwnedSliceSentinel(0);
     defer gpa.free(text);
+    // addresses of a fresh connection still in dhcp are pushed by nd once
+    // assigned; see subscribe_network.
     ui_update_network_status(text, wifi_list_ptr);
-
-    // request network status again if we're connected but IP addr list is empty.
-    // can happen with a fresh connection while dhcp is still in progress.
-    if (report.wifi_ssid != null and report.ipaddrs.len == 0) {
-        // TODO: sometimes this is too fast, not all ip addrs are avail (ipv4 vs ipv6)
-        if (lvgl.LvTimer.new(nm_request_network_status, 1000, null)) |t| {
-            t.setRepeatCount(1);
-        } else |err| {
-            logger.err("network status timer failed: {any}", .{err});
-        }
-    }
 }
 
 /// reads messages from nd.
@@ -223,51 +765,157 @@ fn commThreadLoop() void {
     sigquit.set();
 }
 
-/// runs one cycle of the commThreadLoop: read messages from stdin and update
-/// the UI accordingly.
-/// holds ui mutex for most of the duration.
+/// runs one cycle of the commThreadLoop: read messages from stdin and pass them
+/// on to the UI thread via last_report or ui_queue. never calls into LVGL.
 fn commThreadLoopCycle() !void {
     const msg = try comm.pipeRead(); // blocking
-    ui_mutex.lock(); // guards the state and all UI calls below
-    defer ui_mutex.unlock();
+    if (trace.enabled and !traced_first_msg) {
+        trace.instant("first nd message");
+        traced_first_msg = true;
+    }
+    // let an idle UI loop pick up the changes.
+    defer if (ui_idler) |*idl| idl.wake();
+
     switch (msg.value) {
         .ping => {
             defer msg.deinit();
             try comm.pipeWrite(comm.Message.pong);
         },
-        .poweroff_progress => |rep| {
-            ui.poweroff.updateStatus(rep) catch |err| logger.err("poweroff.updateStatus: {any}", .{err});
-            msg.deinit();
+        // reports only go to the mailbox.
+        .network_report, .onchain_report, .lightning_report, .lightning_error, .history_report, .system_report, .lnd_compaction, .bitcoin_bootstrap, .bitcoind_startup, .channel_backup, .tor_status, .htlc_activity, .lightning_graph => last_report.replace(msg),
+        .report_freshness => |f| {
+            defer msg.deinit();
+            last_report.mu.lock();
+            defer last_report.mu.unlock();
+            last_report.freshness = f;
         },
-        .network_report => |rep| {
-            if (state != .standby) {
-                updateNetworkStatus(rep) catch |err| logger.err("updateNetworkStatus: {any}", .{err});
-            }
-            last_report.replace(msg);
+        .lightning_report_delta => |delta| {
+            defer msg.deinit();
+            // nd sends a full report first, so there is always a base to patch.
+            last_report.patchLightning(delta) catch |err| logger.err("last_report.patchLightning: {any}", .{err});
         },
-        .onchain_report => |rep| {
-            if (state != .standby) {
-                ui.bitcoin.updateTabPanel(rep) catch |err| logger.err("bitcoin.updateTabPanel: {any}", .{err});
-            }
-            last_report.replace(msg);
+        .lightning_report_shm => {
+            // nd sends it only once told the region is available.
+            const rep = report_shm.?.read(gpa) catch |err| {
+                logger.err("report_shm.read: {any}", .{err});
+                return;
+            };
+            last_report.replace(rep);
         },
-        .lightning_report, .lightning_error => {
-            if (state != .standby) {
-                ui.lightning.updateTabPanel(msg.value) catch |err| logger.err("lightning.updateTabPanel: {any}", .{err});
-            }
-            last_report.replace(msg);
+        else => ui_queue.push(msg) catch |err| {
+            logger.err("ui_queue.push {s}: {any}", .{ @tagName(msg.value), err });
+            msg.deinit();
+        },
+    }
+}
+
+/// applies all messages queued by the comm thread, in the order received.
+/// must be called from the UI thread.
+fn applyQueuedMessages() void {
+    var batch = ui_queue.takeAll();
+    while (batch.next()) |msg| {
+        defer msg.deinit();
+        applyMessage(msg);
+    }
+}
+
+/// returns the display refresh period for the current dimmed and shedding state.
+fn refreshPeriod() u32 {
+    if (dimmed) {
+        return dimmed_refresh_ms;
+    }
+    return if (shedding) shed_refresh_ms else lvgl.default_refresh_ms;
+}
+
+/// drops caches and throttles rendering while nd is under resource pressure,
+/// or resumes the usual pace. must be called from the UI thread.
+fn setLoadShed(on: bool) void {
+    if (shedding == on) {
+        return;
+    }
+    logger.info("load shedding {s}", .{if (on) "on" else "off"});
+    shedding = on;
+    lvgl.setRefreshPeriod(refreshPeriod());
+    lvgl.Card.scroll_snapshots = !on;
+    if (on) {
+        ui.dropCaches();
+        if (nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+            ui.lightning.dropCaches();
+        }
+    }
+}
+
+fn applyMessage(msg: comm.ParsedMessage) void {
+    switch (msg.value) {
+        .poweroff_progress => |rep| {
+            ui.poweroff.updateStatus(rep) catch |err| logger.err("poweroff.updateStatus: {any}", .{err});
         },
         .lightning_genseed_result,
         .lightning_ctrlconn,
         => {
+            // replies to user actions in the lightning tab, which is thus built.
+            if (!nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+                logger.warn("dropping {s}: lightning tab not built", .{@tagName(msg.value)});
+                return;
+            }
+            if (!ui.lightning.isPendingReply(msg)) {
+                logger.warn("dropping {s}: stale reply id {d}", .{ @tagName(msg.value), msg.id });
+                return;
+            }
             ui.lightning.updateTabPanel(msg.value) catch |err| logger.err("lightning.updateTabPanel: {any}", .{err});
-            msg.deinit();
         },
         .settings => |sett| {
             ui.settings.update(sett) catch |err| logger.err("settings.update: {any}", .{err});
             slock_status = if (sett.slock_enabled) .enabled else .disabled;
-            msg.deinit();
         },
+        .lightning_channels => |page| {
+            if (!nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+                logger.warn("dropping lightning_channels: lightning tab not built", .{});
+                return;
+            }
+            ui.lightning.updateChannelsPage(page) catch |err| logger.err("lightning.updateChannelsPage: {any}", .{err});
+        },
+        .lightning_payments => |page| {
+            if (!nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+                logger.warn("dropping lightning_payments: lightning tab not built", .{});
+                return;
+            }
+            ui.lightning.updatePaymentsPage(page) catch |err| logger.err("lightning.updatePaymentsPage: {any}", .{err});
+        },
+        .lightning_channel_detail => |detail| {
+            if (!nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+                logger.warn("dropping lightning_channel_detail: lightning tab not built", .{});
+                return;
+            }
+            ui.lightning.updateChannelDetail(msg.id, detail) catch |err| logger.err("lightning.updateChannelDetail: {any}", .{err});
+        },
+        .lightning_peers => |peers| {
+            if (!nm_ui_tab_built(@intFromEnum(Tab.lightning))) {
+                logger.warn("dropping lightning_peers: lightning tab not built", .{});
+                return;
+            }
+            ui.lightning.updatePeers(peers) catch |err| logger.err("lightning.updatePeers: {any}", .{err});
+        },
+        .onchain_transactions => |page| {
+            ui.bitcoin.updateTransactionsPage(page) catch |err| logger.err("bitcoin.updateTransactionsPage: {any}", .{err});
+        },
+        .onchain_utxos => |page| {
+            ui.bitcoin.updateUtxosPage(page) catch |err| logger.err("bitcoin.updateUtxosPage: {any}", .{err});
+        },
+        .sysupdates_progress => |rep| {
+            ui.settings.updateSysupdatesProgress(rep) catch |err| logger.err("settings.updateSysupdatesProgress: {any}", .{err});
+        },
+        .job_progress => |rep| {
+            ui.updateInfoJob(rep) catch |err| logger.err("updateInfoJob: {any}", .{err});
+        },
+        .task_result => |rep| {
+            if (rep.state == .failed) {
+                logger.err("{s}: {s}", .{ rep.name, rep.err orelse "failed" });
+            }
+            ui.updateInfoTask(rep) catch |err| logger.err("updateInfoTask: {any}", .{err});
+        },
+        .get_ui_perf_report => ui.perf.reportNow() catch |err| logger.err("perf.reportNow: {any}", .{err}),
+        .load_shed => |ls| setLoadShed(ls.on),
         .screen_unlock_result => |unlock| {
             if (unlock.ok) {
                 ui.screenlock.unlockSuccess();
@@ -279,67 +927,107 @@ fn commThreadLoopCycle() !void {
                 ui.screenlock.unlockFailure(errmsg);
             }
         },
-        else => {
-            logger.warn("unhandled msg tag {s}", .{@tagName(msg.value)});
-            msg.deinit();
-        },
+        else => logger.warn("unhandled msg tag {s}", .{@tagName(msg.value)}),
     }
 }
 
 /// UI thread: LVGL loop runs here.
 /// must never block unless in idle/sleep mode.
 fn uiThreadLoop() void {
+    // from a wakeup until the first frame is drawn.
+    var wakeup_span: ?trace.Span = null;
+    var traced_first_report = false;
     while (true) {
-        ui_mutex.lock();
+        // user input or an alert; before loopCycle to draw at full rate.
+        if (dimmed and (state == .alert or lvgl.idleTime() < dim_idle_ms)) {
+            setDimmed(false);
+        }
+        const queue_start = ui.perf.now();
+        applyQueuedMessages();
+        const loop_start = ui.perf.now();
         const till_next_ms = lvgl.loopCycle(); // UI loop
+        const timers_end = ui.perf.now();
+        if (trace.enabled) {
+            if (wakeup_span) |span| {
+                span.end();
+                wakeup_span = null;
+                trace.flush();
+            }
+        }
         const do_state = state;
-        ui_mutex.unlock();
+        // after loopCycle so that a frame is drawn before rendering reports.
+        const applied = do_state != .standby and applyPendingReports();
+        const apply_end = ui.perf.now();
+        // objects pending deletion, freed a few at a time to avoid a frame hitch.
+        const reaping = lvgl.reapDeferred(lvgl.reap_budget_ns);
+        if (census_requested.swap(false, .monotonic)) {
+            ui.perf.reportNow() catch |err| logger.err("perf.reportNow: {any}", .{err});
+        }
+        if (trace.enabled and applied and !traced_first_report) {
+            trace.instant("first report applied");
+            trace.flush();
+            traced_first_report = true;
+        }
+        // tabs next to the visible one, ahead of a swipe, in an otherwise idle cycle.
+        const prerendered = do_state == .active and !applied and !reaping and prerenderTabs(till_next_ms);
+        var idle = false;
+        if (ui_idler) |*idl| {
+            // an alert keeps the screen on, but a static one needs no redraws either.
+            idle = do_state != .standby and !applied and !reaping and !prerendered and idl.enter();
+        }
+        ui.perf.record(.queue, (loop_start - queue_start) + (apply_end - timers_end));
+        ui.perf.record(.timers, timers_end - loop_start);
 
         switch (do_state) {
             .active => {},
             .alert => {},
             .standby => {
                 // go into a screen sleep mode due to no user activity
+                if (ui_idler) |*idl| {
+                    idl.leave(); // gated input resumes past sleep
+                }
                 wakeup.reset();
                 comm.pipeWrite(comm.Message.standby) catch |err| logger.err("standby: {any}", .{err});
                 if (slock_status == .enabled) {
                     screenlock.activate();
                 }
-                screen.sleep(&ui_mutex, &wakeup); // blocking
+                _ = lvgl.reapDeferred(std.math.maxInt(u64)); // nothing to draw anyway
+                screen.sleep(&wakeup); // blocking
 
                 // wake up due to touch screen activity or wakeup event is set
                 logger.info("waking up from sleep", .{});
-                ui_mutex.lock();
-                defer ui_mutex.unlock();
+                if (trace.enabled) {
+                    wakeup_span = trace.begin("wakeup");
+                }
                 if (state == .standby) {
                     state = .active;
                     comm.pipeWrite(comm.Message.wakeup) catch |err| logger.err("wakeup: {any}", .{err});
-                    lvgl.resetIdle();
-
-                    last_report.mu.lock();
-                    defer last_report.mu.unlock();
-                    if (last_report.network) |msg| {
-                        updateNetworkStatus(msg.value.network_report) catch |err| {
-                            logger.err("updateNetworkStatus: {any}", .{err});
-                        };
-                    }
-                    if (last_report.onchain) |msg| {
-                        ui.bitcoin.updateTabPanel(msg.value.onchain_report) catch |err| {
-                            logger.err("bitcoin.updateTabPanel: {any}", .{err});
-                        };
-                    }
-                    if (last_report.lightning) |msg| {
-                        ui.lightning.updateTabPanel(msg.value) catch |err| {
-                            logger.err("lightning.updateTabPanel: {any}", .{err});
-                        };
+                    if (dimmed) {
+                        // nd restores the brightness on wakeup.
+                        dimmed = false;
+                        lvgl.setRefreshPeriod(refreshPeriod());
                     }
+                    lvgl.resetIdle();
+                    // reports received in standby are rendered by
+                    // applyPendingReports, after the first frame.
                 }
                 continue;
             },
         }
 
+        if (idle) {
+            // nothing to animate and no user input: block until the next LVGL
+            // timer is due, touch screen input or a UI update from comm thread.
+            const idl = &ui_idler.?;
+            if (idl.wait(till_next_ms)) {
+                idl.leave();
+            }
+            continue;
+        }
         std.atomic.spinLoopHint();
-        time.sleep(@max(1, till_next_ms) * time.ns_per_ms); // sleep at least 1ms
+        // come back quickly to draw rendered reports and apply the rest, if any.
+        const sleep_ms = if (applied or reaping or prerendered) 1 else @max(1, till_next_ms);
+        time.sleep(@as(u64, sleep_ms) * time.ns_per_ms); // sleep at least 1ms
     }
 
     logger.info("exiting UI thread loop", .{});
@@ -348,19 +1036,34 @@ fn uiThreadLoop() void {
 /// prints usage help text to stderr.
 fn usage(prog: []const u8) !void {
     try stderr.print(
-        \\usage: {s} [-v] [-slock]
+        \\usage: {s} [-v] [-slock] [-tab name] [-trace path] [-shm fd] [-font {s}]
         \\
         \\ngui is nakamochi GUI interface. it communicates with nd, nakamochi daemon,
         \\via stdio and is typically launched by the daemon as a child process.
         \\
         \\-slock makes the interface start up in a screenlocked mode.
-    , .{prog});
+        \\-tab shows one of bitcoin, lightning, settings or info tabs at start
+        \\instead of bitcoin; for example, in benchmarks.
+        \\-trace appends startup tracing spans to the file, as created by nd;
+        \\see nd -trace.
+        \\-shm is an inherited descriptor of a memory region nd shares lightning
+        \\reports in, instead of sending them through stdio.
+        \\-font is a TrueType font to draw glyphs missing in the built-in fonts
+        \\with, like non-latin peer aliases; such glyphs show as boxes if
+        \\the file does not exist.
+    , .{ prog, default_fallback_font });
 }
 
 const CmdFlags = struct {
     slock: bool, // whether to start the UI in screen locked mode
+    tab: ?Tab = null, // tab initially visible
+    trace: ?[]const u8 = null, // trace file path; allocated
+    shm: ?posix.fd_t = null, // inherited shared reports region
+    font: []const u8 = default_fallback_font, // fallback TrueType font; allocated unless default
 };
 
+const default_fallback_font = "/usr/share/fonts/ndg/fallback.ttf";
+
 fn parseArgs(alloc: std.mem.Allocator) !CmdFlags {
     var flags = CmdFlags{ .slock = false };
 
@@ -369,12 +1072,27 @@ fn parseArgs(alloc: std.mem.Allocator) !CmdFlags {
     const prog = args.next() orelse return error.NoProgName;
 
     while (args.next()) |a| {
-        if (std.mem.eql(u8, a, "-h") or std.mem.eql(u8, a, "-help") or std.mem.eql(u8, a, "--help")) {
+        if (std.mem.eql(u8, a, "-tab")) {
+            const name = args.next() orelse return error.MissingTabName;
+            flags.tab = std.meta.stringToEnum(Tab, name) orelse {
+                logger.err("unknown tab {s}", .{name});
+                return error.UnknownTabName;
+            };
+        } else if (std.mem.eql(u8, a, "-trace")) {
+            const path = args.next() orelse return error.MissingTracePath;
+            flags.trace = try alloc.dupe(u8, path);
+        } else if (std.mem.eql(u8, a, "-h") or std.mem.eql(u8, a, "-help") or std.mem.eql(u8, a, "--help")) {
             usage(prog) catch {};
             std.process.exit(1);
         } else if (std.mem.eql(u8, a, "-v")) {
             try stderr.print("{any}\n", .{buildopts.semver});
             std.process.exit(0);
+        } else if (std.mem.eql(u8, a, "-shm")) {
+            const fd = args.next() orelse return error.MissingShmFd;
+            flags.shm = try std.fmt.parseInt(posix.fd_t, fd, 10);
+        } else if (std.mem.eql(u8, a, "-font")) {
+            const path = args.next() orelse return error.MissingFontPath;
+            flags.font = try alloc.dupe(u8, path);
         } else if (std.mem.eql(u8, a, "-slock")) {
             flags.slock = true;
         } else {
@@ -386,26 +1104,45 @@ fn parseArgs(alloc: std.mem.Allocator) !CmdFlags {
 }
 
 /// handles sig TERM and INT: makes the program exit.
+/// USR1 dumps the in-memory log records to stderr and requests an object
+/// census, logged by nd.
 fn sighandler(sig: c_int) callconv(.C) void {
     if (sigquit.isSet()) {
         return;
     }
     switch (sig) {
         posix.SIG.INT, posix.SIG.TERM => sigquit.set(),
+        posix.SIG.USR1 => {
+            logring.requestDump();
+            allocprof.requestDump();
+            lockprof.requestDump();
+            census_requested.store(true, .monotonic);
+        },
         else => {},
     }
 }
 
 /// nakamochi UI program entry point.
 pub fn main() anyerror!void {
-    // main heap allocator used through the lifetime of nd
+    // main heap allocator used through the lifetime of ngui
     var gpa_state = std.heap.GeneralPurposeAllocator(.{}){};
-    defer if (gpa_state.deinit() == .leak) {
+    defer if (builtin.mode == .Debug and gpa_state.deinit() == .leak) {
         logger.err("memory leaks detected", .{});
     };
-    gpa = gpa_state.allocator();
+    gpa = allocprof.wrap(if (builtin.mode == .Debug) gpa_state.allocator() else tcalloc.allocator);
     const flags = try parseArgs(gpa);
+    defer if (flags.trace) |path| gpa.free(path);
+    defer if (flags.font.ptr != default_fallback_font.ptr) gpa.free(flags.font);
+    logring.start() catch |err| logger.err("logring.start: {any}", .{err});
+    defer logring.stop();
+    allocprof.start() catch |err| logger.err("allocprof.start: {any}", .{err});
+    defer allocprof.stop();
+    lockprof.start() catch |err| logger.err("lockprof.start: {any}", .{err});
+    defer lockprof.stop();
     logger.info("ndg version {any}", .{buildopts.semver});
+    if (flags.trace) |path| {
+        trace.open(path, "ngui", .{ .append = true }) catch |err| logger.err("trace.open {s}: {any}", .{ path, err });
+    }
     slock_status = if (flags.slock) .enabled else .disabled;
 
     // ensure timer is available on this platform before doing anything else;
@@ -413,27 +1150,74 @@ pub fn main() anyerror!void {
     tick_timer = try time.Timer.start();
 
     // initialize global nd/ngui pipe plumbing.
-    comm.initPipe(gpa, .{ .r = std.io.getStdIn(), .w = std.io.getStdOut() });
+    // lvbench talks to no nd: its stdout is for results.
+    const pipe_out = if (buildopts.lvbench) try std.fs.openFileAbsolute("/dev/null", .{ .mode = .write_only }) else std.io.getStdOut();
+    comm.initPipe(allocprof.tagged(.comm, gpa), .{ .r = std.io.getStdIn(), .w = pipe_out });
+    if (flags.shm) |fd| {
+        report_shm = comm.ShmSnapshot.open(fd) catch |err| blk: {
+            logger.err("shm: {any}; reports go through stdio", .{err});
+            break :blk null;
+        };
+    }
+    defer if (report_shm) |*shm| shm.deinit();
+    // ngui reads both json and binary payloads; let nd use the more compact one.
+    // it also matches replies to its requests by id, pages through channels
+    // and reads lightning reports from the shared region, if any.
+    comm.pipeWrite(.{ .comm_features = .{
+        .binary = true,
+        .request_ids = true,
+        .channel_pages = true,
+        .shm_reports = report_shm != null,
+    } }) catch |err| {
+        logger.err("comm_features: {any}", .{err});
+    };
 
     // initalizes display, input driver and finally creates the user interface.
-    ui.init(.{ .allocator = gpa, .slock = flags.slock }) catch |err| {
+    const ui_span = trace.begin("ui init");
+    ui.init(.{ .allocator = gpa, .slock = flags.slock, .fallback_font = flags.font }) catch |err| {
         logger.err("ui.init: {any}", .{err});
         return err;
     };
+    ui_span.end();
 
-    // run idle timer indefinitely.
-    // continue on failure: screen standby won't work at the worst.
-    _ = lvgl.LvTimer.new(nm_check_idle_time, 2000, null) catch |err| {
-        logger.err("lvgl.LvTimer.new(idle check): {any}", .{err});
+    if (flags.tab) |tab| {
+        nm_ui_show_tab(@intFromEnum(tab)); // before the UI thread starts
+    }
+
+    ui_queue = types.MpscQueue(comm.ParsedMessage).init(gpa);
+    wifi_ssids = types.StringPool.init(gpa);
+    wakeup = screen.WakeEvent.init();
+    ui_idler = screen.Idler.init() catch |err| blk: {
+        logger.info("UI loop idle mode unavailable: {any}", .{err});
+        break :blk null;
     };
 
+    if (buildopts.lvbench) {
+        // no standby nor comms; exits when done.
+        try ui.lvbench.start(gpa, &sigquit);
+    } else {
+        // run idle timer indefinitely; it reschedules itself.
+        // continue on failure: screen standby won't work at the worst.
+        _ = lvgl.LvTimer.new(nm_check_idle_time, standby_idle_ms, null) catch |err| {
+            logger.err("lvgl.LvTimer.new(idle check): {any}", .{err});
+        };
+        _ = lvgl.LvTimer.new(nm_check_freshness, freshness_check_ms, null) catch |err| {
+            logger.err("lvgl.LvTimer.new(freshness check): {any}", .{err});
+        };
+    }
+    if (buildopts.lvgl_cache_stats) {
+        _ = lvgl.LvTimer.new(nm_log_lvgl_stats, 60000, null) catch |err| {
+            logger.err("lvgl.LvTimer.new(lvgl stats): {any}", .{err});
+        };
+    }
+
     {
         // start the main UI thread.
         const th = try std.Thread.spawn(.{}, uiThreadLoop, .{});
         th.detach();
     }
 
-    {
+    if (!buildopts.lvbench) {
         // start comms with daemon in a seaparate thread.
         const th = try std.Thread.spawn(.{}, commThreadLoop, .{});
         th.detach();
@@ -447,6 +1231,7 @@ pub fn main() anyerror!void {
     };
     try posix.sigaction(posix.SIG.INT, &sa, null);
     try posix.sigaction(posix.SIG.TERM, &sa, null);
+    try posix.sigaction(posix.SIG.USR1, &sa, null);
     sigquit.wait();
     logger.info("sigquit: terminating ...", .{});
 
@@ -6,7 +6,14 @@ const std = @import("std");
 const types = @import("types.zig");
 const sysimpl = @import("sys/sysimpl.zig");
 
+pub const Cgroups = @import("sys/Cgroups.zig");
+pub const Clock = @import("sys/Clock.zig");
+pub const CpuFreq = @import("sys/CpuFreq.zig");
+pub const FileWatch = @import("sys/FileWatch.zig");
+pub const Pressure = @import("sys/Pressure.zig");
+pub const Sampler = @import("sys/Sampler.zig");
 pub const Service = @import("sys/Service.zig");
+pub const Zram = @import("sys/Zram.zig");
 
 pub usingnamespace if (builtin.is_test) struct {
     // stubs, mocks and overrides for testing.
@@ -19,10 +26,23 @@ pub usingnamespace if (builtin.is_test) struct {
         _ = allocator;
         _ = name;
     }
+
+    pub fn setIdlePriority() !void {}
+
+    pub fn totalMemory() !u64 {
+        return 4 << 30;
+    }
 } else sysimpl; // real implementation for production code.
 
 test {
+    _ = @import("sys/Cgroups.zig");
+    _ = @import("sys/Clock.zig");
+    _ = @import("sys/CpuFreq.zig");
+    _ = @import("sys/FileWatch.zig");
+    _ = @import("sys/Pressure.zig");
+    _ = @import("sys/Sampler.zig");
     _ = @import("sys/Service.zig");
+    _ = @import("sys/Zram.zig");
     _ = @import("sys/sysimpl.zig");
     std.testing.refAllDecls(@This());
 }
@@ -0,0 +1,204 @@
+//! cgroup v2 resource partitioning of the node services: each runs in a group
+//! of its own under ndg, with cpu and io weights and a memory high mark, so
+//! that a syncing bitcoind leaves enough of the node to lnd and ngui.
+//! groups are created on demand under the root cgroup, which must have the
+//! cpu and memory controllers available; io is used if available too.
+//!
+//! runit starts a service anew in the group of its runsv, outside of ndg:
+//! placeService is meant to be called periodically to move it back.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+const logger = std.log.scoped(.cgroups);
+
+/// cgroup2 mount point, relative to the root passed to init.
+const mountpoint = "sys/fs/cgroup";
+/// the parent of all groups.
+const parent = "ndg";
+/// runit services directory, as used by sv.
+const svdir = "var/service";
+
+pub const max_groups = 8;
+
+/// the ndg group directory.
+dir: std.fs.Dir,
+/// runit services are resolved relative to root.
+root: std.fs.Dir,
+/// whether the io controller is enabled; cpu and memory always are.
+io: bool,
+/// the last applied limits and placed service pid of each group.
+groups: std.BoundedArray(Group, max_groups) = .{},
+
+const Cgroups = @This();
+
+/// cpu.weight and io.weight are relative to those of sibling groups.
+pub const Limits = struct {
+    cpu_weight: u16 = 100, // 1 to 10000
+    io_weight: u16 = 100, // 1 to 10000
+    memory_high: ?u64 = null, // bytes, reclaimed under pressure above; null is none
+};
+
+const Group = struct {
+    name: []const u8, // references the apply or placeService arg
+    limits: ?Limits = null,
+    pid: u32 = 0,
+};
+
+/// enables the controllers down to the ndg group, relative to root, "/" in
+/// production.
+pub fn init(root: []const u8) !Cgroups {
+    var rootdir = try std.fs.cwd().openDir(root, .{});
+    errdefer rootdir.close();
+    var cg = rootdir.openDir(mountpoint, .{}) catch |err| switch (err) {
+        error.FileNotFound => return error.CgroupV2Unavailable,
+        else => return err,
+    };
+    defer cg.close();
+
+    var buf: [512]u8 = undefined;
+    const avail = cg.readFile("cgroup.controllers", &buf) catch |err| switch (err) {
+        error.FileNotFound => return error.CgroupV2Unavailable, // v1 or hybrid
+        else => return err,
+    };
+    if (!hasController(avail, "cpu") or !hasController(avail, "memory")) {
+        return error.CgroupControllersUnavailable;
+    }
+    const io = hasController(avail, "io");
+    const ctrl = if (io) "+cpu +io +memory" else "+cpu +memory";
+    try cg.writeFile("cgroup.subtree_control", ctrl);
+    cg.makeDir(parent) catch |err| switch (err) {
+        error.PathAlreadyExists => {},
+        else => return err,
+    };
+    var dir = try cg.openDir(parent, .{});
+    errdefer dir.close();
+    try dir.writeFile("cgroup.subtree_control", ctrl);
+    return .{ .dir = dir, .root = rootdir, .io = io };
+}
+
+pub fn deinit(self: *Cgroups) void {
+    self.dir.close();
+    self.root.close();
+}
+
+/// sets the limits of the named group, creating it as needed. only changed
+/// limits are written. name must outlive self.
+pub fn apply(self: *Cgroups, name: []const u8, limits: Limits) !void {
+    const g = try self.group(name);
+    if (g.limits != null and std.meta.eql(g.limits.?, limits)) {
+        return;
+    }
+    g.limits = limits; // a failed write is not retried until a change
+    var sub = try self.dir.openDir(name, .{});
+    defer sub.close();
+    var buf: [32]u8 = undefined;
+    try sub.writeFile("cpu.weight", try std.fmt.bufPrint(&buf, "{d}", .{limits.cpu_weight}));
+    if (self.io) {
+        try sub.writeFile("io.weight", try std.fmt.bufPrint(&buf, "default {d}", .{limits.io_weight}));
+    }
+    const high = if (limits.memory_high) |v| try std.fmt.bufPrint(&buf, "{d}", .{v}) else "max";
+    try sub.writeFile("memory.high", high);
+    logger.info("{s}: cpu.weight={d} io.weight={d} memory.high={s}", .{ name, limits.cpu_weight, limits.io_weight, high });
+}
+
+/// moves the calling process into the named group, creating it as needed;
+/// processes it starts afterwards run in the group too. name must outlive self.
+pub fn placeSelf(self: *Cgroups, name: []const u8) !void {
+    _ = try self.group(name);
+    try self.writeProcs(name, 0); // 0 is the writer
+}
+
+/// moves the runit service of the same name as the group into that group,
+/// unless already placed or not running. returns whether the service moved.
+/// name must outlive self.
+pub fn placeService(self: *Cgroups, name: []const u8) !bool {
+    const g = try self.group(name);
+    const pid = try self.servicePid(name);
+    if (pid == 0 or pid == g.pid) {
+        return false;
+    }
+    g.pid = pid; // a failed move is not retried until the next restart
+    try self.writeProcs(name, pid);
+    logger.info("{s}: placed pid {d}", .{ name, pid });
+    return true;
+}
+
+fn group(self: *Cgroups, name: []const u8) !*Group {
+    for (self.groups.slice()) |*g| {
+        if (std.mem.eql(u8, g.name, name)) {
+            return g;
+        }
+    }
+    self.dir.makeDir(name) catch |err| switch (err) {
+        error.PathAlreadyExists => {},
+        else => return err,
+    };
+    try self.groups.append(.{ .name = name });
+    return &self.groups.slice()[self.groups.len - 1];
+}
+
+fn writeProcs(self: *Cgroups, name: []const u8, pid: u32) !void {
+    var pathbuf: [128]u8 = undefined;
+    var buf: [16]u8 = undefined;
+    const path = try std.fmt.bufPrint(&pathbuf, "{s}/cgroup.procs", .{name});
+    try self.dir.writeFile(path, try std.fmt.bufPrint(&buf, "{d}", .{pid}));
+}
+
+/// returns the pid of a runit service or 0 if it's down.
+fn servicePid(self: *Cgroups, name: []const u8) !u32 {
+    var pathbuf: [128]u8 = undefined;
+    const path = try std.fmt.bufPrint(&pathbuf, svdir ++ "/{s}/supervise/pid", .{name});
+    var buf: [32]u8 = undefined;
+    const data = self.root.readFile(path, &buf) catch |err| switch (err) {
+        error.FileNotFound => return 0,
+        else => return err,
+    };
+    const s = std.mem.trim(u8, data, &std.ascii.whitespace);
+    return if (s.len == 0) 0 else try std.fmt.parseUnsigned(u32, s, 10);
+}
+
+/// reports whether a cgroup.controllers list has the named controller.
+fn hasController(list: []const u8, name: []const u8) bool {
+    var it = std.mem.tokenizeAny(u8, list, " \n");
+    while (it.next()) |c| {
+        if (std.mem.eql(u8, c, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+test "cgroups" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    try t.expectError(error.CgroupV2Unavailable, Cgroups.init(tmp.abspath));
+    try tmp.dir.makePath("sys/fs/cgroup");
+    try tmp.dir.writeFile("sys/fs/cgroup/cgroup.controllers", "cpuset cpu memory pids\n");
+    try tmp.dir.makePath("var/service/lnd/supervise");
+    try tmp.dir.writeFile("var/service/lnd/supervise/pid", "42\n");
+
+    var cg = try Cgroups.init(tmp.abspath);
+    defer cg.deinit();
+    try t.expect(!cg.io);
+    var buf: [64]u8 = undefined;
+    try t.expectEqualStrings("+cpu +memory", try tmp.dir.readFile("sys/fs/cgroup/ndg/cgroup.subtree_control", &buf));
+
+    try cg.apply("bitcoind", .{ .cpu_weight = 50, .memory_high = 3 << 30 });
+    try t.expectEqualStrings("50", try tmp.dir.readFile("sys/fs/cgroup/ndg/bitcoind/cpu.weight", &buf));
+    try t.expectEqualStrings("3221225472", try tmp.dir.readFile("sys/fs/cgroup/ndg/bitcoind/memory.high", &buf));
+    try cg.apply("bitcoind", .{});
+    try t.expectEqualStrings("max", try tmp.dir.readFile("sys/fs/cgroup/ndg/bitcoind/memory.high", &buf));
+
+    try t.expect(try cg.placeService("lnd"));
+    try t.expectEqualStrings("42", try tmp.dir.readFile("sys/fs/cgroup/ndg/lnd/cgroup.procs", &buf));
+    try t.expect(!try cg.placeService("lnd")); // already placed
+    try tmp.dir.writeFile("var/service/lnd/supervise/pid", ""); // down
+    try t.expect(!try cg.placeService("lnd"));
+    try tmp.dir.writeFile("var/service/lnd/supervise/pid", "43\n"); // restarted
+    try t.expect(try cg.placeService("lnd"));
+    try t.expect(!try cg.placeService("tor")); // no such service
+}
@@ -0,0 +1,121 @@
+//! a monotonic time source for scheduling loops: either the system clock or
+//! a simulated one. simulated time moves forward only when a thread waits
+//! past it or it is advanced explicitly, so that tests and benchmarks can run
+//! days of report cycles in no time, with reproducible deadlines and every
+//! wakeup counted.
+//! a clock is a small value, free to copy; a simulated clock refers to its
+//! Sim, which must outlive all copies.
+
+const std = @import("std");
+
+/// simulated time state; null for the system clock.
+sim: ?*Sim = null,
+
+const Clock = @This();
+
+/// the system monotonic clock.
+pub const system = Clock{};
+
+/// simulated time state; safe for concurrent use.
+pub const Sim = struct {
+    mu: std.Thread.Mutex = .{},
+    now: u64 = 0, // ns since the simulation start
+    waits: u64 = 0, // wait and sleep calls
+    timeouts: u64 = 0, // waits ended by their timeout rather than an event
+
+    /// returns a clock reading the simulated time.
+    pub fn clock(self: *Sim) Clock {
+        return .{ .sim = self };
+    }
+
+    /// moves the simulated time forward by ns.
+    pub fn advance(self: *Sim, ns: u64) void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        self.now += ns;
+    }
+};
+
+/// returns ns elapsed since an arbitrary point in the past; never decreases.
+pub fn now(self: Clock) u64 {
+    if (self.sim) |s| {
+        s.mu.lock();
+        defer s.mu.unlock();
+        return s.now;
+    }
+    var ts: std.posix.timespec = undefined;
+    std.posix.clock_gettime(std.posix.CLOCK.MONOTONIC, &ts) catch return 0;
+    return @as(u64, @intCast(ts.tv_sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.tv_nsec));
+}
+
+/// returns ns elapsed since start, a value previously returned by now.
+pub fn since(self: Clock, start: u64) u64 {
+    return self.now() -| start;
+}
+
+/// blocks until ev is set or timeout_ns elapses, and reports whether ev is set.
+/// a simulated clock never blocks: a wait on an event set already returns
+/// right away, any other moves the time forward by timeout_ns.
+pub fn wait(self: Clock, ev: *std.Thread.ResetEvent, timeout_ns: u64) bool {
+    const s = self.sim orelse {
+        ev.timedWait(timeout_ns) catch return false; // error.Timeout
+        return true;
+    };
+    s.mu.lock();
+    defer s.mu.unlock();
+    s.waits += 1;
+    if (ev.isSet()) {
+        return true;
+    }
+    s.timeouts += 1;
+    s.now += timeout_ns;
+    return false;
+}
+
+/// blocks for ns; a simulated clock moves the time forward instead.
+pub fn sleep(self: Clock, ns: u64) void {
+    const s = self.sim orelse return std.time.sleep(ns);
+    s.mu.lock();
+    defer s.mu.unlock();
+    s.waits += 1;
+    s.timeouts += 1;
+    s.now += ns;
+}
+
+test "simulated clock" {
+    const t = std.testing;
+
+    var sim = Sim{};
+    const clock = sim.clock();
+    try t.expectEqual(@as(u64, 0), clock.now());
+
+    // a day of one minute waits passes instantly.
+    var ev = std.Thread.ResetEvent{};
+    for (0..24 * 60) |_| {
+        try t.expect(!clock.wait(&ev, std.time.ns_per_min));
+    }
+    try t.expectEqual(@as(u64, std.time.ns_per_day), clock.now());
+    try t.expectEqual(@as(u64, 24 * 60), sim.timeouts);
+
+    // a set event ends the wait with no time passing.
+    ev.set();
+    try t.expect(clock.wait(&ev, std.time.ns_per_min));
+    try t.expectEqual(@as(u64, std.time.ns_per_day), clock.now());
+    try t.expectEqual(@as(u64, 24 * 60 + 1), sim.waits);
+
+    const start = clock.now();
+    clock.sleep(5 * std.time.ns_per_s);
+    sim.advance(1);
+    try t.expectEqual(@as(u64, 5 * std.time.ns_per_s + 1), clock.since(start));
+}
+
+test "system clock" {
+    const t = std.testing;
+
+    const start = system.now();
+    var ev = std.Thread.ResetEvent{};
+    try t.expect(!system.wait(&ev, 1 * std.time.ns_per_ms));
+    try t.expect(system.since(start) >= 1 * std.time.ns_per_ms);
+    ev.set();
+    try t.expect(system.wait(&ev, std.time.ns_per_s));
+}
@@ -0,0 +1,135 @@
+//! cpu frequency scaling governor of all cpufreq policies, set through sysfs.
+//! a governor not available in every policy is considered unavailable.
+//! not safe for concurrent use.
+
+const std = @import("std");
+
+/// cpufreq policies directory, relative to the root passed to init.
+const cpufreq_dir = "sys/devices/system/cpu/cpufreq";
+
+pub const max_policies = 8;
+
+dir: std.fs.Dir,
+/// policy directory names, such as "policy0".
+policies: std.BoundedArray(std.BoundedArray(u8, 16), max_policies) = .{},
+/// governors available in all policies.
+available: Governors = Governors.initFull(),
+/// the governor last set, or currently in use if the same in all policies.
+current: ?Governor = null,
+
+const CpuFreq = @This();
+
+pub const Governor = enum { performance, schedutil, ondemand, conservative, powersave };
+pub const Governors = std.EnumSet(Governor);
+
+/// finds cpufreq policies relative to root, "/" in production.
+pub fn init(root: []const u8) !CpuFreq {
+    var rootdir = try std.fs.cwd().openDir(root, .{});
+    defer rootdir.close();
+    var self = CpuFreq{
+        .dir = rootdir.openDir(cpufreq_dir, .{ .iterate = true }) catch |err| switch (err) {
+            error.FileNotFound => return error.CpuFreqUnavailable,
+            else => return err,
+        },
+    };
+    errdefer self.dir.close();
+
+    var cur: ?Governor = null;
+    var same = true;
+    var it = self.dir.iterate();
+    while (try it.next()) |e| {
+        if (!std.mem.startsWith(u8, e.name, "policy") or self.policies.len == max_policies) {
+            continue;
+        }
+        const name = std.BoundedArray(u8, 16).fromSlice(e.name) catch continue;
+        var buf: [256]u8 = undefined;
+        var gov = Governors.initEmpty();
+        var toks = std.mem.tokenizeAny(u8, try self.readPolicy(name.constSlice(), "scaling_available_governors", &buf), " \n");
+        while (toks.next()) |s| {
+            if (std.meta.stringToEnum(Governor, s)) |g| gov.insert(g);
+        }
+        self.available = self.available.intersectWith(gov);
+        const g = std.meta.stringToEnum(Governor, std.mem.trimRight(u8, try self.readPolicy(name.constSlice(), "scaling_governor", &buf), "\n"));
+        if (self.policies.len > 0 and !std.meta.eql(g, cur)) {
+            same = false;
+        }
+        cur = g;
+        self.policies.appendAssumeCapacity(name);
+    }
+    if (self.policies.len == 0) {
+        return error.CpuFreqUnavailable;
+    }
+    self.current = if (same) cur else null;
+    return self;
+}
+
+pub fn deinit(self: *CpuFreq) void {
+    self.dir.close();
+}
+
+/// returns the first of the governors available, if any.
+pub fn pick(self: *const CpuFreq, prefs: []const Governor) ?Governor {
+    for (prefs) |g| {
+        if (self.available.contains(g)) {
+            return g;
+        }
+    }
+    return null;
+}
+
+/// switches all policies to the governor unless already in use, and reports
+/// whether it did.
+pub fn set(self: *CpuFreq, gov: Governor) !bool {
+    if (self.current != null and self.current.? == gov) {
+        return false;
+    }
+    if (!self.available.contains(gov)) {
+        return error.CpuFreqGovernorUnavailable;
+    }
+    self.current = null; // unknown if a write fails halfway
+    var pathbuf: [64]u8 = undefined;
+    for (self.policies.constSlice()) |p| {
+        const path = try std.fmt.bufPrint(&pathbuf, "{s}/scaling_governor", .{p.constSlice()});
+        try self.dir.writeFile(path, @tagName(gov));
+    }
+    self.current = gov;
+    return true;
+}
+
+fn readPolicy(self: *CpuFreq, policy: []const u8, file: []const u8, buf: []u8) ![]const u8 {
+    var pathbuf: [64]u8 = undefined;
+    return self.dir.readFile(try std.fmt.bufPrint(&pathbuf, "{s}/{s}", .{ policy, file }), buf);
+}
+
+test "cpufreq" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    try t.expectError(error.CpuFreqUnavailable, CpuFreq.init(tmp.abspath));
+    const policies = .{
+        .{ "policy0", "ondemand performance schedutil powersave\n" },
+        .{ "policy4", "ondemand schedutil powersave\n" },
+    };
+    inline for (policies) |p| {
+        try tmp.dir.makePath(cpufreq_dir ++ "/" ++ p[0]);
+        try tmp.dir.writeFile(cpufreq_dir ++ "/" ++ p[0] ++ "/scaling_available_governors", p[1]);
+        try tmp.dir.writeFile(cpufreq_dir ++ "/" ++ p[0] ++ "/scaling_governor", "ondemand\n");
+    }
+
+    var cf = try CpuFreq.init(tmp.abspath);
+    defer cf.deinit();
+    try t.expectEqual(@as(usize, 2), cf.policies.len);
+    try t.expectEqual(@as(?Governor, .ondemand), cf.current);
+    // performance isn't available in policy4.
+    try t.expectEqual(@as(?Governor, .schedutil), cf.pick(&.{ .performance, .schedutil }));
+    try t.expectEqual(@as(?Governor, null), cf.pick(&.{.conservative}));
+    try t.expectError(error.CpuFreqGovernorUnavailable, cf.set(.performance));
+
+    try t.expect(!try cf.set(.ondemand));
+    try t.expect(try cf.set(.powersave));
+    var buf: [32]u8 = undefined;
+    try t.expectEqualStrings("powersave", try tmp.dir.readFile(cpufreq_dir ++ "/policy4/scaling_governor", &buf));
+    try t.expectEqualStrings("powersave", try tmp.dir.readFile(cpufreq_dir ++ "/policy0/scaling_governor", &buf));
+}
@@ -0,0 +1,193 @@
+///! watches a file path with inotify(7) for the file to appear or change,
+///! including when some of its parent directories don't exist yet.
+///! not safe for concurrent use.
+const builtin = @import("builtin");
+const std = @import("std");
+const posix = std.posix;
+const IN = std.os.linux.IN;
+
+const Error = error{
+    FileWatchTimeout,
+    FileWatchInterrupted,
+};
+
+/// inotify instance.
+fd: posix.fd_t,
+/// the watched file; referenced, not owned.
+path: []const u8,
+/// the watched directory is path[0..dirlen]: the closest existing ancestor.
+dirlen: usize = 0,
+/// watch descriptor of the directory, if any.
+wd: ?i32 = null,
+
+const FileWatch = @This();
+
+/// events of a watched directory triggering re-evaluation.
+const dir_events = IN.CREATE | IN.MOVED_TO | IN.CLOSE_WRITE | IN.DELETE | IN.MOVED_FROM |
+    IN.DELETE_SELF | IN.MOVE_SELF | IN.ONLYDIR;
+
+pub const WaitOpts = struct {
+    timeout_ms: u32,
+    /// an fd such as an eventfd becoming readable makes wait functions
+    /// return FileWatchInterrupted.
+    interrupt: ?posix.fd_t = null,
+};
+
+/// path must be alive until deinit.
+pub fn init(path: []const u8) !FileWatch {
+    const fd = try posix.inotify_init1(IN.CLOEXEC);
+    return .{ .fd = fd, .path = path };
+}
+
+pub fn deinit(self: *FileWatch) void {
+    posix.close(self.fd);
+}
+
+/// blocks until the file exists.
+pub fn waitExists(self: *FileWatch, opts: WaitOpts) !void {
+    const deadline = std.time.milliTimestamp() + opts.timeout_ms;
+    while (true) {
+        // watch first, then check: a file created in between is still reported.
+        try self.rewatch();
+        if (exists(self.path)) {
+            return;
+        }
+        _ = try self.waitEvent(deadline, opts.interrupt);
+    }
+}
+
+/// blocks until the file is created, finished writing, replaced or deleted.
+pub fn waitChange(self: *FileWatch, opts: WaitOpts) !void {
+    const deadline = std.time.milliTimestamp() + opts.timeout_ms;
+    while (true) {
+        try self.rewatch();
+        if (try self.waitEvent(deadline, opts.interrupt)) {
+            return;
+        }
+    }
+}
+
+fn exists(path: []const u8) bool {
+    std.fs.cwd().access(path, .{}) catch return false;
+    return true;
+}
+
+/// re-targets the watch to the closest existing ancestor directory of path
+/// if it is different from the current one.
+fn rewatch(self: *FileWatch) !void {
+    var dir = std.fs.path.dirname(self.path) orelse ".";
+    while (!exists(dir)) {
+        dir = std.fs.path.dirname(dir) orelse ".";
+    }
+    if (self.wd != null and dir.len == self.dirlen) {
+        return;
+    }
+    if (self.wd) |wd| {
+        posix.inotify_rm_watch(self.fd, wd);
+        self.wd = null;
+    }
+    self.wd = try posix.inotify_add_watch(self.fd, dir, dir_events);
+    // "." isn't a prefix of path but it is never an ancestor of anything else.
+    self.dirlen = if (std.mem.startsWith(u8, self.path, dir)) dir.len else 0;
+}
+
+/// waits for and consumes pending events. returns true if any of them is about
+/// the file itself, false if only something along the path changed.
+fn waitEvent(self: *FileWatch, deadline: i64, interrupt: ?posix.fd_t) !bool {
+    const timeout = deadline - std.time.milliTimestamp();
+    if (timeout <= 0) {
+        return Error.FileWatchTimeout;
+    }
+    var fds = [_]posix.pollfd{
+        .{ .fd = self.fd, .events = posix.POLL.IN, .revents = 0 },
+        .{ .fd = interrupt orelse -1, .events = posix.POLL.IN, .revents = 0 }, // negative fds are ignored
+    };
+    if (try posix.poll(&fds, std.math.lossyCast(i32, timeout)) == 0) {
+        return Error.FileWatchTimeout;
+    }
+    if (fds[1].revents != 0) {
+        return Error.FileWatchInterrupted;
+    }
+
+    var buf: [4096]u8 = undefined;
+    const n = try posix.read(self.fd, &buf);
+    return self.consume(buf[0..n]);
+}
+
+/// processes a batch of raw inotify events read from self.fd. see waitEvent.
+fn consume(self: *FileWatch, events: []const u8) bool {
+    // name of the next path component inside the watched directory.
+    const rest = std.mem.trimLeft(u8, self.path[self.dirlen..], "/");
+    const next = rest[0 .. std.mem.indexOfScalar(u8, rest, '/') orelse rest.len];
+    const is_file = next.len == rest.len;
+
+    const endian = builtin.cpu.arch.endian();
+    var found = false;
+    var i: usize = 0;
+    while (i + 16 <= events.len) {
+        const wd = std.mem.readInt(i32, events[i..][0..4], endian);
+        const mask = std.mem.readInt(u32, events[i + 4 ..][0..4], endian);
+        const len = std.mem.readInt(u32, events[i + 12 ..][0..4], endian);
+        const name = std.mem.sliceTo(events[i + 16 ..][0..@min(len, events.len - i - 16)], 0);
+        i += 16 + len;
+        if (self.wd == null or wd != self.wd.?) {
+            continue; // a watch removed by rewatch
+        }
+        if (mask & (IN.DELETE_SELF | IN.MOVE_SELF | IN.IGNORED) != 0) {
+            self.wd = null; // the directory is gone; rewatch an ancestor
+            found = found or is_file;
+            continue;
+        }
+        if (std.mem.eql(u8, name, next)) {
+            found = found or is_file;
+        }
+    }
+    return found;
+}
+
+test "consume" {
+    const t = std.testing;
+
+    var w = FileWatch{ .fd = -1, .path = "/tmp/a/b.txt", .dirlen = "/tmp/a".len, .wd = 1 };
+    const Event = extern struct { wd: i32, mask: u32, cookie: u32, len: u32, name: [16]u8 };
+    var ev = Event{ .wd = 1, .mask = IN.CREATE, .cookie = 0, .len = 16, .name = [_]u8{0} ** 16 };
+    @memcpy(ev.name[0..5], "c.txt");
+    try t.expect(!w.consume(std.mem.asBytes(&ev)));
+    @memcpy(ev.name[0..5], "b.txt");
+    try t.expect(w.consume(std.mem.asBytes(&ev)));
+    ev.wd = 2; // an old watch
+    try t.expect(!w.consume(std.mem.asBytes(&ev)));
+
+    // an intermediate directory
+    w.dirlen = "/tmp".len;
+    ev.wd = 1;
+    @memcpy(ev.name[0..5], "a\x00\x00\x00\x00");
+    try t.expect(!w.consume(std.mem.asBytes(&ev)));
+}
+
+test "waitExists" {
+    const t = std.testing;
+
+    var tmp = t.tmpDir(.{});
+    defer tmp.cleanup();
+    const dir = try tmp.dir.realpathAlloc(t.allocator, ".");
+    defer t.allocator.free(dir);
+    const path = try std.fs.path.join(t.allocator, &.{ dir, "sub", "file" });
+    defer t.allocator.free(path);
+
+    var w = try FileWatch.init(path);
+    defer w.deinit();
+    try t.expectError(Error.FileWatchTimeout, w.waitExists(.{ .timeout_ms = 10 }));
+
+    const th = try std.Thread.spawn(.{}, struct {
+        fn run(d: std.fs.Dir) void {
+            std.time.sleep(10 * std.time.ns_per_ms);
+            d.makeDir("sub") catch return;
+            std.time.sleep(10 * std.time.ns_per_ms);
+            d.writeFile("sub/file", "x") catch return;
+        }
+    }.run, .{tmp.dir});
+    defer th.join();
+    try w.waitExists(.{ .timeout_ms = 5 * std.time.ms_per_s });
+    try w.waitExists(.{ .timeout_ms = 0 }); // already exists
+}
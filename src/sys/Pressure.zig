@@ -0,0 +1,151 @@
+//! linux PSI (pressure stall information) monitor of cpu, memory and io
+//! stalls, with kernel triggers rather than polling: each /proc/pressure
+//! file is opened with a stall threshold written to it, and the kernel
+//! signals the fd with EPOLLPRI while stalls exceed the threshold, at most
+//! once per window. the owner adds the fds to its epoll set, notes events
+//! as they come and calls update to find out whether the node is under
+//! pressure: since the first trigger until none fired for calm_ms.
+//! see https://docs.kernel.org/accounting/psi.html.
+//! not safe for concurrent use.
+const std = @import("std");
+const posix = std.posix;
+
+const logger = std.log.scoped(.pressure);
+
+/// trigger fds by resource; null if unavailable.
+fds: std.EnumArray(Resource, ?posix.fd_t) = std.EnumArray(Resource, ?posix.fd_t).initFill(null),
+/// time.milliTimestamp of the last trigger of each resource; 0 if none.
+last: std.EnumArray(Resource, i64) = std.EnumArray(Resource, i64).initFill(0),
+/// whether the node is under pressure, as of the last update.
+active: bool = false,
+
+const Pressure = @This();
+
+pub const Resource = enum { cpu, memory, io };
+
+/// stall thresholds: "some" tasks stalled for the first number of us within
+/// a window of the second. windows are a multiple of 2s, the minimum for
+/// unprivileged processes. cpu stalls only when nearly saturated as in
+/// IBD signature checks; memory stalls of any length already mean reclaim
+/// or swap, and io is expected to be busy for a node.
+const triggers = std.EnumArray(Resource, []const u8).init(.{
+    .cpu = "some 1600000 2000000", // 80%
+    .memory = "some 200000 2000000", // 10%
+    .io = "some 1000000 2000000", // 50%
+});
+
+/// time with no triggers for pressure to be considered over.
+pub const calm_ms = 60 * std.time.ms_per_s;
+
+/// opens triggers of all resources the kernel reports. returns
+/// error.PsiUnavailable if none is, as with a kernel built without
+/// CONFIG_PSI or booted with psi=0.
+pub fn init() !Pressure {
+    var self: Pressure = .{};
+    var any = false;
+    for (std.enums.values(Resource)) |r| {
+        const v = openTrigger(r) catch |err| {
+            logger.info("{s}: {!}", .{ @tagName(r), err });
+            continue;
+        };
+        self.fds.set(r, v);
+        any = true;
+    }
+    if (!any) {
+        return error.PsiUnavailable;
+    }
+    return self;
+}
+
+pub fn deinit(self: *Pressure) void {
+    for (std.enums.values(Resource)) |r| {
+        if (self.fds.get(r)) |v| {
+            posix.close(v);
+        }
+        self.fds.set(r, null);
+    }
+}
+
+fn openTrigger(r: Resource) !posix.fd_t {
+    var pathbuf: [32]u8 = undefined;
+    const path = try std.fmt.bufPrintZ(&pathbuf, "/proc/pressure/{s}", .{@tagName(r)});
+    const tfd = try posix.openZ(path, .{ .ACCMODE = .RDWR, .NONBLOCK = true, .CLOEXEC = true }, 0);
+    errdefer posix.close(tfd);
+    // the kernel takes the last byte written for a terminating zero.
+    var buf: [32]u8 = undefined;
+    const spec = try std.fmt.bufPrintZ(&buf, "{s}", .{triggers.get(r)});
+    _ = try posix.write(tfd, spec[0 .. spec.len + 1]);
+    return tfd;
+}
+
+/// returns the trigger fd of r, to add to an epoll set for EPOLLPRI.
+pub fn fd(self: Pressure, r: Resource) ?posix.fd_t {
+    return self.fds.get(r);
+}
+
+/// records a trigger of r, signaled on its fd at time now.
+/// an epoll_wait reporting the fd consumes the event, so callers
+/// note every EPOLLPRI they get.
+pub fn note(self: *Pressure, r: Resource, now: i64) void {
+    self.last.set(r, now);
+}
+
+/// returns the new state if the node came under pressure or got out of it.
+pub fn update(self: *Pressure, now: i64) ?bool {
+    const on = self.latest() != 0 and now - self.latest() < calm_ms;
+    if (on == self.active) {
+        return null;
+    }
+    self.active = on;
+    return on;
+}
+
+/// returns ms until pressure may be over, for a timely update; null if it's
+/// not active.
+pub fn untilCalm(self: Pressure, now: i64) ?i64 {
+    if (!self.active) {
+        return null;
+    }
+    return @max(0, self.latest() + calm_ms - now);
+}
+
+/// returns the resources triggered within calm_ms of now, for logs.
+pub fn resources(self: Pressure, now: i64) std.EnumSet(Resource) {
+    var set = std.EnumSet(Resource).initEmpty();
+    for (std.enums.values(Resource)) |r| {
+        const t = self.last.get(r);
+        if (t != 0 and now - t < calm_ms) {
+            set.insert(r);
+        }
+    }
+    return set;
+}
+
+fn latest(self: Pressure) i64 {
+    var v: i64 = 0;
+    for (std.enums.values(Resource)) |r| v = @max(v, self.last.get(r));
+    return v;
+}
+
+test "pressure" {
+    const t = std.testing;
+
+    var p: Pressure = .{};
+    try t.expectEqual(@as(?bool, null), p.update(1000));
+    try t.expectEqual(@as(?i64, null), p.untilCalm(1000));
+
+    p.note(.memory, 1000);
+    try t.expectEqual(@as(?bool, true), p.update(1000));
+    try t.expectEqual(@as(?bool, null), p.update(2000));
+    try t.expect(p.resources(2000).contains(.memory));
+    try t.expect(!p.resources(2000).contains(.io));
+
+    // repeated triggers within the window keep it on.
+    p.note(.io, 30000);
+    try t.expectEqual(@as(?bool, null), p.update(1000 + calm_ms));
+    try t.expectEqual(@as(?i64, 1000), p.untilCalm(29000 + calm_ms));
+    try t.expect(!p.resources(1000 + calm_ms).contains(.memory));
+
+    try t.expectEqual(@as(?bool, false), p.update(30000 + calm_ms));
+    try t.expectEqual(@as(?i64, null), p.untilCalm(30000 + calm_ms));
+}
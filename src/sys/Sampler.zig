@@ -0,0 +1,445 @@
+//! a node health sampler: cpu, memory and storage i/o of system services,
+//! disks i/o, cpu temperature and throttling state, read from /proc and /sys.
+//!
+//! files are opened once and re-read from the start into fixed buffers, all
+//! of them with a single io_uring submission: a sample makes one syscall and
+//! no allocations. where io_uring is unavailable, before linux 5.6 or under
+//! a seccomp filter, each file is read with a pread of its own. a service
+//! process is resolved from its runit supervise/pid file, re-read only while
+//! the service is down or once its /proc files fail with the process gone.
+//! unavailable files are skipped and their values reported as absent.
+//! unsafe for concurrent use.
+
+const std = @import("std");
+const linux = std.os.linux;
+const posix = std.posix;
+
+const logger = std.log.scoped(.sampler);
+
+pub const max_services = 4;
+pub const max_disks = 8;
+pub const max_zones = 4;
+
+/// /proc cpu times are in USER_HZ clock ticks, fixed at 100 on arm and x86.
+pub const user_hz = 100;
+
+/// runit services directory, as used by sv.
+const svdir = "var/service";
+/// raspberry pi firmware throttling state, a hex bit mask.
+const throttled_path = "sys/devices/platform/soc/soc:firmware/get_throttled";
+
+/// all files are opened relative to root.
+root: std.fs.Dir,
+services: std.BoundedArray(Proc, max_services) = .{},
+diskstats: ?posix.fd_t = null,
+zones: std.BoundedArray(posix.fd_t, max_zones) = .{},
+throttled: ?posix.fd_t = null,
+/// reads all files of a sample at once; null if unavailable.
+ring: ?linux.IoUring = null,
+/// read buffer of /proc/diskstats; long enough for a few dozen devices.
+buf: [8192]u8 = undefined,
+/// read buffers of all other files, one per read slot.
+bufs: [max_reads - 1][512]u8 = undefined,
+
+const Sampler = @This();
+
+/// read slots of a sample: 3 per service, then zones, throttled and diskstats.
+const max_reads = max_services * 3 + max_zones + 2;
+const zone_slot = max_services * 3;
+const throttled_slot = max_reads - 2;
+const diskstats_slot = max_reads - 1;
+
+/// a file read of a sample.
+const Read = struct {
+    fd: posix.fd_t = -1, // not read if -1
+    buf: []u8 = &.{},
+    data: ?[]const u8 = null, // null if unread or failed
+};
+
+const Proc = struct {
+    name: []const u8,
+    pid: u32 = 0, // 0 if not running
+    stat: posix.fd_t = -1,
+    statm: posix.fd_t = -1,
+    io: posix.fd_t = -1, // -1 also if unreadable, which requires privileges
+};
+
+/// a snapshot of all sampled values. counters are cumulative since boot,
+/// or the process start for services.
+pub const Sample = struct {
+    time: i64 = 0, // std.time.milliTimestamp
+    services: std.BoundedArray(Service, max_services) = .{},
+    disks: std.BoundedArray(Disk, max_disks) = .{},
+    temps: std.BoundedArray(i32, max_zones) = .{}, // millidegrees celsius
+    throttled: ?u32 = null,
+
+    pub const Service = struct {
+        name: []const u8, // references Sampler.init services
+        pid: u32, // 0 if not running, in which case all values are 0
+        cpu_ticks: u64 = 0, // user and system time in user_hz ticks
+        rss: u64 = 0, // resident memory, bytes
+        io: ?struct {
+            read: u64, // storage layer bytes, excluding page cache hits
+            write: u64,
+        } = null,
+    };
+
+    pub const Disk = struct {
+        name: std.BoundedArray(u8, 32),
+        read: u64, // bytes
+        write: u64, // bytes
+        io_ms: u64, // time spent with i/o in flight
+    };
+
+    /// returns values of the named service, if sampled.
+    pub fn service(self: *const Sample, name: []const u8) ?Service {
+        for (self.services.constSlice()) |s| {
+            if (std.mem.eql(u8, s.name, name)) {
+                return s;
+            }
+        }
+        return null;
+    }
+
+    /// returns values of the named disk, if sampled.
+    pub fn disk(self: *const Sample, name: []const u8) ?Disk {
+        for (self.disks.constSlice()) |d| {
+            if (std.mem.eql(u8, d.name.constSlice(), name)) {
+                return d;
+            }
+        }
+        return null;
+    }
+};
+
+/// opens all available files relative to root, "/" in production.
+/// services are runit service names, at most max_services, referenced
+/// until deinit.
+pub fn init(root: []const u8, services: []const []const u8) !Sampler {
+    var self = Sampler{ .root = try std.fs.cwd().openDir(root, .{}) };
+    self.ring = linux.IoUring.init(std.math.ceilPowerOfTwoAssert(u16, max_reads), 0) catch |err| blk: {
+        logger.info("io_uring: {!}; reading files one by one", .{err});
+        break :blk null;
+    };
+    for (services[0..@min(services.len, max_services)]) |name| {
+        self.services.appendAssumeCapacity(.{ .name = name });
+    }
+    self.diskstats = self.open("proc/diskstats");
+    self.throttled = self.open(throttled_path);
+    for (0..max_zones) |i| {
+        var pathbuf: [64]u8 = undefined;
+        const path = std.fmt.bufPrint(&pathbuf, "sys/class/thermal/thermal_zone{d}/temp", .{i}) catch unreachable;
+        self.zones.appendAssumeCapacity(self.open(path) orelse break);
+    }
+    return self;
+}
+
+pub fn deinit(self: *Sampler) void {
+    for (self.services.slice()) |*p| {
+        closeProc(p);
+    }
+    if (self.diskstats) |fd| posix.close(fd);
+    if (self.throttled) |fd| posix.close(fd);
+    for (self.zones.constSlice()) |fd| {
+        posix.close(fd);
+    }
+    if (self.ring) |*ring| ring.deinit();
+    self.root.close();
+}
+
+/// reads current values of all open files into s.
+pub fn sample(self: *Sampler, s: *Sample) void {
+    s.* = .{ .time = std.time.milliTimestamp() };
+    var reads = [_]Read{.{}} ** max_reads;
+    for (&reads, 0..) |*r, i| {
+        r.buf = if (i == diskstats_slot) &self.buf else &self.bufs[i];
+    }
+    for (self.services.slice(), 0..) |*p, i| {
+        if (p.pid == 0 and !self.openProc(p)) {
+            continue;
+        }
+        reads[i * 3].fd = p.stat;
+        reads[i * 3 + 1].fd = p.statm;
+        reads[i * 3 + 2].fd = p.io;
+    }
+    for (self.zones.constSlice(), 0..) |fd, i| {
+        reads[zone_slot + i].fd = fd;
+    }
+    reads[throttled_slot].fd = self.throttled orelse -1;
+    reads[diskstats_slot].fd = self.diskstats orelse -1;
+    self.readBatch(&reads);
+
+    for (self.services.slice(), 0..) |*p, i| {
+        s.services.appendAssumeCapacity(self.sampleProc(p, reads[i * 3 ..][0..3]));
+    }
+    if (reads[diskstats_slot].data) |data| {
+        parseDiskstats(data, &s.disks);
+    }
+    for (reads[zone_slot..][0..self.zones.len]) |r| {
+        const data = r.data orelse continue;
+        const v = std.fmt.parseInt(i32, trim(data), 10) catch continue;
+        s.temps.appendAssumeCapacity(v);
+    }
+    if (reads[throttled_slot].data) |data| {
+        s.throttled = std.fmt.parseUnsigned(u32, trim(data), 16) catch null;
+    }
+}
+
+/// parses the service files read into r: stat, statm and io.
+fn sampleProc(self: *Sampler, p: *Proc, r: *[3]Read) Sample.Service {
+    if (p.pid == 0) {
+        return .{ .name = p.name, .pid = 0 };
+    }
+    if (r[0].data == null) {
+        // the process is gone: a restarted one is read right away.
+        closeProc(p);
+        if (!self.openProc(p)) {
+            return .{ .name = p.name, .pid = 0 };
+        }
+        for (r, [_]posix.fd_t{ p.stat, p.statm, p.io }) |*ri, fd| {
+            ri.fd = fd;
+            ri.data = null;
+        }
+        self.readBatch(r);
+        if (r[0].data == null) {
+            closeProc(p);
+            return .{ .name = p.name, .pid = 0 };
+        }
+    }
+    var v = Sample.Service{ .name = p.name, .pid = p.pid };
+    v.cpu_ticks = parseStatCpu(r[0].data.?) orelse 0;
+    if (r[1].data) |statm| {
+        v.rss = (parseStatmRss(statm) orelse 0) * std.mem.page_size;
+    }
+    if (r[2].data) |io| {
+        v.io = .{ .read = parseField(io, "read_bytes:") orelse 0, .write = parseField(io, "write_bytes:") orelse 0 };
+    }
+    return v;
+}
+
+/// reads all files of reads with an fd from the start, with io_uring if
+/// available. a failed submission falls back to pread for good.
+fn readBatch(self: *Sampler, reads: []Read) void {
+    if (self.ring) |*ring| {
+        if (readRing(ring, reads)) {
+            return;
+        } else |err| {
+            logger.err("io_uring: {!}; reading files one by one", .{err});
+            ring.deinit();
+            self.ring = null;
+        }
+    }
+    for (reads) |*r| {
+        r.data = pread(r.fd, r.buf);
+    }
+}
+
+fn readRing(ring: *linux.IoUring, reads: []Read) !void {
+    var n: u32 = 0;
+    for (reads, 0..) |r, i| {
+        if (r.fd >= 0) {
+            _ = try ring.read(i, r.fd, .{ .buffer = r.buf }, 0);
+            n += 1;
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+    _ = try ring.submit_and_wait(n);
+    var cqes: [max_reads]linux.io_uring_cqe = undefined;
+    var done: u32 = 0;
+    while (done < n) {
+        const got = try ring.copy_cqes(cqes[0 .. n - done], 1);
+        // ESRCH is expected of /proc/<pid> files once the process exits.
+        for (cqes[0..got]) |c| {
+            const r = &reads[@intCast(c.user_data)];
+            r.data = if (c.res >= 0) r.buf[0..@intCast(c.res)] else null;
+        }
+        done += got;
+    }
+}
+
+/// resolves the service pid and opens its /proc files.
+/// returns false if the service is not running or unavailable.
+fn openProc(self: *Sampler, p: *Proc) bool {
+    var pathbuf: [256]u8 = undefined;
+    // runit replaces the pid file on each change: open it anew.
+    const pidfile = std.fmt.bufPrint(&pathbuf, svdir ++ "/{s}/supervise/pid", .{p.name}) catch return false;
+    const fd = self.open(pidfile) orelse return false;
+    defer posix.close(fd);
+    var buf: [32]u8 = undefined;
+    const data = pread(fd, &buf) orelse return false;
+    const pid = std.fmt.parseUnsigned(u32, trim(data), 10) catch return false; // empty when down
+    if (pid == 0) {
+        return false;
+    }
+    p.stat = self.open(std.fmt.bufPrint(&pathbuf, "proc/{d}/stat", .{pid}) catch unreachable) orelse return false;
+    p.statm = self.open(std.fmt.bufPrint(&pathbuf, "proc/{d}/statm", .{pid}) catch unreachable) orelse -1;
+    p.io = self.open(std.fmt.bufPrint(&pathbuf, "proc/{d}/io", .{pid}) catch unreachable) orelse -1;
+    p.pid = pid;
+    return true;
+}
+
+fn closeProc(p: *Proc) void {
+    inline for (.{ "stat", "statm", "io" }) |name| {
+        if (@field(p, name) >= 0) {
+            posix.close(@field(p, name));
+            @field(p, name) = -1;
+        }
+    }
+    p.pid = 0;
+}
+
+fn open(self: *const Sampler, path: []const u8) ?posix.fd_t {
+    const f = self.root.openFile(path, .{}) catch return null;
+    return f.handle;
+}
+
+/// returns contents of the file at fd, from the start, in buf.
+/// errors are reported as null: ESRCH is expected of /proc/<pid> files once
+/// the process exits.
+fn pread(fd: posix.fd_t, buf: []u8) ?[]const u8 {
+    if (fd < 0) {
+        return null;
+    }
+    const rc = linux.pread(fd, buf.ptr, buf.len, 0);
+    return switch (linux.getErrno(rc)) {
+        .SUCCESS => buf[0..rc],
+        else => null,
+    };
+}
+
+fn trim(s: []const u8) []const u8 {
+    return std.mem.trim(u8, s, " \n");
+}
+
+/// returns utime + stime of a /proc/<pid>/stat. the comm field in parens may
+/// contain spaces: fields are counted from its closing paren.
+fn parseStatCpu(data: []const u8) ?u64 {
+    const i = std.mem.lastIndexOfScalar(u8, data, ')') orelse return null;
+    var it = std.mem.tokenizeScalar(u8, data[i + 1 ..], ' ');
+    var n: usize = 3; // state is the 3rd field
+    var utime: u64 = 0;
+    while (it.next()) |f| : (n += 1) {
+        switch (n) {
+            14 => utime = std.fmt.parseUnsigned(u64, f, 10) catch return null,
+            15 => return utime + (std.fmt.parseUnsigned(u64, f, 10) catch return null),
+            else => {},
+        }
+    }
+    return null;
+}
+
+/// returns the resident set size in pages of a /proc/<pid>/statm.
+fn parseStatmRss(data: []const u8) ?u64 {
+    var it = std.mem.tokenizeScalar(u8, data, ' ');
+    _ = it.next() orelse return null; // size
+    return std.fmt.parseUnsigned(u64, it.next() orelse return null, 10) catch null;
+}
+
+/// returns the value of a "name value" line.
+fn parseField(data: []const u8, name: []const u8) ?u64 {
+    var lines = std.mem.tokenizeScalar(u8, data, '\n');
+    while (lines.next()) |line| {
+        if (std.mem.startsWith(u8, line, name)) {
+            return std.fmt.parseUnsigned(u64, trim(line[name.len..]), 10) catch null;
+        }
+    }
+    return null;
+}
+
+/// appends whole disks of a /proc/diskstats, skipping partitions, which
+/// follow their disk and are prefixed with its name, as well as virtual
+/// loop and ram devices.
+fn parseDiskstats(data: []const u8, disks: *std.BoundedArray(Sample.Disk, max_disks)) void {
+    const sector = 512; // diskstats unit regardless of the device
+    var lines = std.mem.tokenizeScalar(u8, data, '\n');
+    next: while (lines.next()) |line| {
+        // major minor name reads merged sectors ms writes merged sectors ms inflight io_ms ...
+        var f: [13][]const u8 = undefined;
+        var it = std.mem.tokenizeScalar(u8, line, ' ');
+        for (&f) |*v| {
+            v.* = it.next() orelse continue :next;
+        }
+        const name = f[2];
+        for ([_][]const u8{ "loop", "ram", "zram" }) |virt| {
+            if (std.mem.startsWith(u8, name, virt)) continue :next;
+        }
+        for (disks.constSlice()) |d| {
+            if (std.mem.startsWith(u8, name, d.name.constSlice())) continue :next;
+        }
+        const d = Sample.Disk{
+            .name = std.BoundedArray(u8, 32).fromSlice(name) catch continue,
+            .read = (std.fmt.parseUnsigned(u64, f[5], 10) catch continue) * sector,
+            .write = (std.fmt.parseUnsigned(u64, f[9], 10) catch continue) * sector,
+            .io_ms = std.fmt.parseUnsigned(u64, f[12], 10) catch continue,
+        };
+        disks.append(d) catch return;
+    }
+}
+
+test "sampler" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    try tmp.dir.makePath("var/service/lnd/supervise");
+    try tmp.dir.makePath("var/service/bitcoind/supervise");
+    try tmp.dir.makePath("proc/42");
+    try tmp.dir.makePath("sys/class/thermal/thermal_zone0");
+    try tmp.dir.makePath("sys/devices/platform/soc/soc:firmware");
+    try tmp.dir.writeFile("var/service/lnd/supervise/pid", "42\n");
+    try tmp.dir.writeFile("var/service/bitcoind/supervise/pid", ""); // down
+    try tmp.dir.writeFile("proc/42/stat", "42 (lnd (x) y) S 1 42 42 0 -1 4194560 100 0 0 0 150 25 0 0 20 0 12 0 300 0 0\n");
+    try tmp.dir.writeFile("proc/42/statm", "1000 300 20 1 0 200 0\n");
+    try tmp.dir.writeFile("proc/42/io", "rchar: 10\nwchar: 20\nread_bytes: 4096\nwrite_bytes: 8192\n");
+    try tmp.dir.writeFile("proc/diskstats",
+        \\   7       0 loop0 1 0 2 0 0 0 0 0 0 0 0 0 0
+        \\ 179       0 mmcblk0 100 5 2000 30 50 6 400 70 0 90 100 0 0
+        \\ 179       1 mmcblk0p1 10 0 200 3 5 0 40 7 0 9 10 0 0
+        \\   8       0 sda 300 0 8000 10 200 0 16000 20 1 1500 30 0 0
+        \\
+    );
+    try tmp.dir.writeFile("sys/class/thermal/thermal_zone0/temp", "52123\n");
+    try tmp.dir.writeFile("sys/devices/platform/soc/soc:firmware/get_throttled", "50005\n");
+
+    var sampler = try Sampler.init(tmp.abspath, &.{ "lnd", "bitcoind" });
+    defer sampler.deinit();
+    var s: Sample = undefined;
+    sampler.sample(&s);
+
+    const lnd = s.service("lnd").?;
+    try t.expectEqual(@as(u32, 42), lnd.pid);
+    try t.expectEqual(@as(u64, 175), lnd.cpu_ticks);
+    try t.expectEqual(@as(u64, 300 * std.mem.page_size), lnd.rss);
+    try t.expectEqual(@as(u64, 4096), lnd.io.?.read);
+    try t.expectEqual(@as(u64, 8192), lnd.io.?.write);
+    try t.expectEqual(@as(u32, 0), s.service("bitcoind").?.pid);
+
+    try t.expectEqual(@as(usize, 2), s.disks.len);
+    const mmc = s.disk("mmcblk0").?;
+    try t.expectEqual(@as(u64, 2000 * 512), mmc.read);
+    try t.expectEqual(@as(u64, 400 * 512), mmc.write);
+    try t.expectEqual(@as(u64, 90), mmc.io_ms);
+    try t.expectEqual(@as(u64, 1500), s.disk("sda").?.io_ms);
+
+    try t.expectEqualSlices(i32, &.{52123}, s.temps.constSlice());
+    try t.expectEqual(@as(?u32, 0x50005), s.throttled);
+
+    // the same fd is re-read from the start.
+    try tmp.dir.writeFile("proc/42/stat", "42 (lnd) S 1 42 42 0 -1 4194560 100 0 0 0 200 50 0 0 20 0 12 0 300 0 0\n");
+    sampler.sample(&s);
+    try t.expectEqual(@as(u64, 250), s.service("lnd").?.cpu_ticks);
+
+    // same values without io_uring.
+    if (sampler.ring) |*ring| {
+        ring.deinit();
+        sampler.ring = null;
+    }
+    sampler.sample(&s);
+    try t.expectEqual(@as(u64, 250), s.service("lnd").?.cpu_ticks);
+    try t.expectEqual(@as(u64, 4096), s.service("lnd").?.io.?.read);
+    try t.expectEqual(@as(u64, 1500), s.disk("sda").?.io_ms);
+    try t.expectEqual(@as(?u32, 0x50005), s.throttled);
+}
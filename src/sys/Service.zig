@@ -2,10 +2,12 @@
 ///! safe for concurrent use.
 const std = @import("std");
 const types = @import("../types.zig");
+const Clock = @import("Clock.zig");
 
 // known service names
 pub const LND = "lnd";
 pub const BITCOIND = "bitcoind";
+pub const TOR = "tor";
 
 const Error = error{
     SysServiceStopInProgress,
@@ -13,11 +15,16 @@ const Error = error{
     SysServiceBadStartTerm,
     SysServiceBadStopCode,
     SysServiceBadStopTerm,
+    SysServiceNotReady,
 };
 
 allocator: std.mem.Allocator,
 name: []const u8,
 stop_wait_sec: ?u32 = null,
+/// names of services which must be stopped before this one; see stopAll.
+stop_after: []const []const u8 = &.{},
+/// set once a stopWait completes, successfully or not; see stopAll.
+stop_done: std.Thread.ResetEvent = .{},
 
 /// mutex guards all fields below.
 mu: std.Thread.Mutex = .{},
@@ -48,6 +55,9 @@ pub const InitOpts = struct {
     /// how long to wait for the service to stop before SIGKILL.
     /// if unspecified, default for sv is 7.
     stop_wait_sec: ?u32 = null,
+    /// names of services which stopAll stops before this one.
+    /// for example, lnd must stop before bitcoind it relies on.
+    stop_after: []const []const u8 = &.{},
 };
 
 /// must deinit when done.
@@ -56,6 +66,7 @@ pub fn init(a: std.mem.Allocator, name: []const u8, opts: InitOpts) SysService {
         .allocator = a,
         .name = name,
         .stop_wait_sec = opts.stop_wait_sec,
+        .stop_after = opts.stop_after,
         .stat = .initial,
     };
 }
@@ -98,6 +109,41 @@ pub fn start(self: *SysService) !void {
     }
 }
 
+/// like start but also blocks until the service is ready to serve requests
+/// according to probe, which sv itself has no notion of. see waitReady.
+pub fn startReady(self: *SysService, probe: anytype, opts: ReadyOpts) !void {
+    try self.start();
+    return waitReady(probe, opts);
+}
+
+/// waitReady polling schedule.
+pub const ReadyOpts = struct {
+    /// gives up with SysServiceNotReady after this long.
+    timeout_ms: u32 = 10 * std.time.ms_per_s,
+    /// delay after the first unsuccessful probe, doubled after each next one.
+    min_delay_ms: u32 = 50,
+    max_delay_ms: u32 = 1 * std.time.ms_per_s,
+    /// time source for the timeout and delays.
+    clock: Clock = Clock.system,
+};
+
+/// blocks until probe.ready() returns true, retrying with an exponential backoff
+/// so that a quickly starting service is picked up within milliseconds while
+/// a slow one isn't hammered. probe is any value with a `fn ready(self) bool`.
+pub fn waitReady(probe: anytype, opts: ReadyOpts) !void {
+    const start = opts.clock.now();
+    var delay: u64 = opts.min_delay_ms;
+    while (!probe.ready()) {
+        const elapsed = opts.clock.since(start) / std.time.ns_per_ms;
+        if (elapsed >= opts.timeout_ms) {
+            return Error.SysServiceNotReady;
+        }
+        const d = @min(delay, opts.timeout_ms - elapsed);
+        opts.clock.sleep(d * std.time.ns_per_ms);
+        delay = @min(delay * 2, opts.max_delay_ms);
+    }
+}
+
 /// launches a service stop procedure and returns immediately.
 /// callers must invoke stopWait to release all resources used by the stop.
 pub fn stop(self: *SysService) !void {
@@ -113,6 +159,8 @@ pub fn stop(self: *SysService) !void {
 
 /// blocks until the service stopping procedure terminates.
 /// an error is returned also in the case where stopping a service failed.
+/// the mutex is released while waiting so that status and lastStopError
+/// remain responsive; at most one stopWait may be in progress at a time.
 pub fn stopWait(self: *SysService) !void {
     self.mu.lock();
     defer self.mu.unlock();
@@ -123,7 +171,11 @@ pub fn stopWait(self: *SysService) !void {
         return err;
     };
 
-    const term = self.stop_proc.wait() catch |err| {
+    // stop_proc is left intact while .stopping: see spawnStopUnguarded.
+    self.mu.unlock();
+    const res = self.stop_proc.wait();
+    self.mu.lock();
+    const term = res catch |err| {
         self.stop_err = err;
         return err;
     };
@@ -141,6 +193,58 @@ pub fn stopWait(self: *SysService) !void {
     }
 }
 
+/// stops all services concurrently, each in a separate thread, except a service
+/// is stopped only once all of its stop_after services are done stopping,
+/// successfully or not. stop_after names not in the list are ignored, and
+/// the dependencies must not form a cycle.
+/// onStopped is called with ctx from the stopping threads, possibly concurrently,
+/// as soon as each service stop completes and before its dependents proceed.
+/// if threads are unavailable, services are stopped sequentially in the list
+/// order: dependencies must thus be listed first.
+/// blocks until all services are done.
+pub fn stopAll(
+    allocator: std.mem.Allocator,
+    services: []SysService,
+    ctx: anytype,
+    comptime onStopped: fn (@TypeOf(ctx), *SysService) void,
+) void {
+    const Ctx = @TypeOf(ctx);
+    const Worker = struct {
+        fn run(list: []SysService, sv: *SysService, c: Ctx) void {
+            for (sv.stop_after) |name| {
+                for (list) |*dep| {
+                    if (dep != sv and std.mem.eql(u8, dep.name, name)) {
+                        dep.stop_done.wait();
+                    }
+                }
+            }
+            sv.stopWait() catch {}; // reported by lastStopError
+            onStopped(c, sv);
+            sv.stop_done.set();
+        }
+    };
+
+    for (services) |*sv| {
+        sv.stop_done.reset();
+    }
+    var no_threads = [_]?std.Thread{};
+    const threads = allocator.alloc(?std.Thread, services.len) catch &no_threads;
+    defer allocator.free(threads);
+    for (services, 0..) |*sv, i| {
+        if (i >= threads.len) {
+            Worker.run(services, sv, ctx);
+            continue;
+        }
+        threads[i] = std.Thread.spawn(.{}, Worker.run, .{ services, sv, ctx }) catch null;
+        if (threads[i] == null) {
+            Worker.run(services, sv, ctx);
+        }
+    }
+    for (threads) |th| {
+        if (th) |v| v.join();
+    }
+}
+
 /// actual internal body of SysService.stop: stopWait also uses this.
 /// callers must hold self.mu.
 fn spawnStopUnguarded(self: *SysService) !void {
@@ -206,6 +310,69 @@ test "stopWait" {
     try t.expectEqualStrings("sv -w 14 stop testsv2", cmd);
 }
 
+test "stopAll" {
+    const t = std.testing;
+
+    var list = [_]SysService{
+        SysService.init(t.allocator, "testsv-lnd", .{}),
+        SysService.init(t.allocator, "testsv-btc", .{ .stop_after = &.{ "testsv-lnd", "testsv-missing" } }),
+        SysService.init(t.allocator, "testsv-tor", .{}),
+    };
+    defer for (&list) |*sv| sv.stop_proc.deinit(); // TestChildProcess
+
+    const Ctx = struct {
+        mu: std.Thread.Mutex = .{},
+        order: std.BoundedArray([]const u8, 3) = .{},
+
+        fn stopped(self: *@This(), sv: *SysService) void {
+            self.mu.lock();
+            defer self.mu.unlock();
+            self.order.appendAssumeCapacity(sv.name);
+        }
+    };
+    var ctx = Ctx{};
+    stopAll(t.allocator, &list, &ctx, Ctx.stopped);
+
+    try t.expectEqual(@as(usize, 3), ctx.order.len);
+    var lnd: ?usize = null;
+    var btc: ?usize = null;
+    for (ctx.order.slice(), 0..) |name, i| {
+        if (std.mem.eql(u8, name, "testsv-lnd")) lnd = i;
+        if (std.mem.eql(u8, name, "testsv-btc")) btc = i;
+    }
+    try t.expect(lnd.? < btc.?);
+    for (&list) |*sv| {
+        try t.expect(sv.stop_proc.waited);
+        try t.expectEqual(Status.stopped, sv.status());
+    }
+}
+
+test "waitReady" {
+    const t = std.testing;
+
+    const Probe = struct {
+        calls: usize = 0,
+        ready_after: usize,
+
+        fn ready(self: *@This()) bool {
+            self.calls += 1;
+            return self.calls > self.ready_after;
+        }
+    };
+    var sim = Clock.Sim{};
+    var p = Probe{ .ready_after = 3 };
+    try waitReady(&p, .{ .min_delay_ms = 1, .clock = sim.clock() });
+    try t.expectEqual(@as(usize, 4), p.calls);
+    try t.expectEqual(@as(u64, 7 * std.time.ns_per_ms), sim.now); // 1+2+4 ms
+
+    // 1+2+2 ms of sleeps reach the timeout
+    sim = .{};
+    p = .{ .ready_after = 100 };
+    try t.expectError(Error.SysServiceNotReady, waitReady(&p, .{ .timeout_ms = 5, .min_delay_ms = 1, .clock = sim.clock() }));
+    try t.expectEqual(@as(usize, 4), p.calls);
+    try t.expectEqual(@as(u64, 3), sim.waits);
+}
+
 test "stop with default wait" {
     const t = std.testing;
 
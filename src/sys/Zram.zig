@@ -0,0 +1,208 @@
+//! zram compressed swap in memory for low-memory nodes: a large bitcoind
+//! dbcache in IBD would otherwise get it OOM-killed or swapping to the SSD.
+//! the zram0 device, created by the zram kernel module, is sized to the host
+//! memory and formatted as swap with lz4 compression, unless already in use,
+//! as when set up by the OS or a previous nd run. swappiness follows the node
+//! phase: pages of a cold heap are cheaper to compress than the page cache
+//! of block reads is to refill from the SSD.
+//! files are relative to the root passed to init, "/" in production.
+//! not safe for concurrent use.
+
+const builtin = @import("builtin");
+const std = @import("std");
+const linux = std.os.linux;
+
+const logger = std.log.scoped(.zram);
+
+/// zram0 sysfs directory and device node paths, relative to root.
+const sysfs_dir = "sys/block/zram0";
+const dev_path = "dev/zram0";
+const swappiness_path = "proc/sys/vm/swappiness";
+const page_cluster_path = "proc/sys/vm/page-cluster";
+const vmstat_path = "proc/vmstat";
+
+/// the zram device size is a share of the host memory, up to max_disksize.
+/// it holds about 3 times as much in lz4 compressed pages.
+const max_disksize = 4 << 30;
+/// swap priority of the device, ahead of any swap on disk.
+const swap_priority = 100;
+/// SWAP_FLAG_PREFER of swapon(2).
+const swap_flag_prefer = 0x8000;
+
+root: std.fs.Dir,
+/// the swappiness last set; null if none yet.
+swappiness: ?u8 = null,
+
+const Zram = @This();
+
+/// the device figures and swap activity since boot.
+pub const Stats = struct {
+    orig_bytes: u64 = 0, // uncompressed data stored
+    compr_bytes: u64 = 0, // compressed size of the data
+    mem_used: u64 = 0, // memory taken by the device, compressed data and metadata
+    swap_in: u64 = 0, // pages swapped in, all swap devices
+    swap_out: u64 = 0, // pages swapped out, all swap devices
+};
+
+/// returns error.ZramUnavailable unless the zram0 device exists.
+pub fn init(root: []const u8) !Zram {
+    var rootdir = try std.fs.cwd().openDir(root, .{});
+    errdefer rootdir.close();
+    rootdir.access(sysfs_dir ++ "/disksize", .{}) catch |err| switch (err) {
+        error.FileNotFound => return error.ZramUnavailable,
+        else => return err,
+    };
+    return .{ .root = rootdir };
+}
+
+pub fn deinit(self: *Zram) void {
+    self.root.close();
+}
+
+/// returns the swappiness for the node phase. swapping out to memory is
+/// cheap; zram favours values over 100, the default of disk swap.
+pub fn swappinessFor(ibd: bool) u8 {
+    return if (ibd) 180 else 100;
+}
+
+/// sizes the device to the host total memory, selects lz4 and writes a swap
+/// header, unless the device is initialized already. reports whether it
+/// formatted the device, which is then to be activated.
+pub fn format(self: *Zram, total_mem: u64) !bool {
+    var buf: [256]u8 = undefined;
+    const cur = std.mem.trim(u8, try self.root.readFile(sysfs_dir ++ "/disksize", &buf), " \n");
+    if (!std.mem.eql(u8, cur, "0")) {
+        return false;
+    }
+    const size = @min(total_mem / 2, max_disksize) / std.mem.page_size * std.mem.page_size;
+    if (size == 0) {
+        return error.ZramTooSmall;
+    }
+
+    // the algorithm can only be changed before disksize is set.
+    // the list reads like "lzo [lzo-rle] lz4 zstd", the current in brackets.
+    const algos = try self.root.readFile(sysfs_dir ++ "/comp_algorithm", &buf);
+    var it = std.mem.tokenizeAny(u8, algos, " []\n");
+    const lz4 = while (it.next()) |a| {
+        if (std.mem.eql(u8, a, "lz4")) break true;
+    } else false;
+    if (lz4) {
+        try self.root.writeFile(sysfs_dir ++ "/comp_algorithm", "lz4");
+    } else {
+        logger.info("lz4 unavailable; compression left as {s}", .{std.mem.trim(u8, algos, " \n")});
+    }
+    try self.root.writeFile(sysfs_dir ++ "/disksize", try std.fmt.bufPrint(&buf, "{d}", .{size}));
+
+    var hdr: [std.mem.page_size]u8 = undefined;
+    swapHeader(&hdr, size);
+    const dev = try self.root.openFile(dev_path, .{ .mode = .write_only });
+    defer dev.close();
+    try dev.pwriteAll(&hdr, 0);
+    // swap-ins of neighbouring pages are no cheaper than each on its own.
+    self.root.writeFile(page_cluster_path, "0") catch |err| logger.info("page-cluster: {!}", .{err});
+    logger.info("formatted {d}MiB of swap", .{size >> 20});
+    return true;
+}
+
+/// writes a swap header of a size bytes device, as mkswap(8) with no label,
+/// uuid or bad pages: union swap_header of linux/swap.h, version 1.
+fn swapHeader(buf: *[std.mem.page_size]u8, size: u64) void {
+    const endian = builtin.cpu.arch.endian();
+    @memset(buf, 0);
+    std.mem.writeInt(u32, buf[1024..1028], 1, endian); // version
+    std.mem.writeInt(u32, buf[1028..1032], @intCast(size / std.mem.page_size - 1), endian); // last_page
+    @memcpy(buf[buf.len - 10 ..], "SWAPSPACE2");
+}
+
+/// enables swap on the formatted device.
+pub fn activate(self: *Zram) !void {
+    var pathbuf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+    const path = try std.posix.toPosixPath(try self.root.realpath(dev_path, &pathbuf));
+    const flags: usize = swap_flag_prefer | swap_priority;
+    switch (linux.getErrno(linux.syscall2(.swapon, @intFromPtr(&path), flags))) {
+        .SUCCESS => {},
+        .PERM => return error.AccessDenied,
+        .BUSY => return error.SwapBusy,
+        .INVAL => return error.SwapInvalid,
+        else => |e| return std.posix.unexpectedErrno(e),
+    }
+}
+
+/// sets the swappiness unless last set to the same, and reports whether it did.
+/// a failed write is not retried until v changes.
+pub fn setSwappiness(self: *Zram, v: u8) !bool {
+    if (self.swappiness != null and self.swappiness.? == v) {
+        return false;
+    }
+    self.swappiness = v;
+    var buf: [4]u8 = undefined;
+    try self.root.writeFile(swappiness_path, try std.fmt.bufPrint(&buf, "{d}", .{v}));
+    return true;
+}
+
+/// returns the current device figures and swap counters.
+pub fn stats(self: *Zram) !Stats {
+    var buf: [256]u8 = undefined;
+    // orig_data_size compr_data_size mem_used_total mem_limit ...
+    var mm = std.mem.tokenizeAny(u8, try self.root.readFile(sysfs_dir ++ "/mm_stat", &buf), " \n");
+    var res: Stats = .{};
+    inline for (.{ "orig_bytes", "compr_bytes", "mem_used" }) |name| {
+        @field(res, name) = try std.fmt.parseInt(u64, mm.next() orelse return error.ZramBadMmStat, 10);
+    }
+
+    const f = try self.root.openFile(vmstat_path, .{});
+    defer f.close();
+    var br = std.io.bufferedReader(f.reader());
+    var line: [128]u8 = undefined;
+    while (try br.reader().readUntilDelimiterOrEof(&line, '\n')) |l| {
+        var kv = std.mem.tokenizeScalar(u8, l, ' ');
+        const k = kv.next() orelse continue;
+        const dst = if (std.mem.eql(u8, k, "pswpin")) &res.swap_in else if (std.mem.eql(u8, k, "pswpout")) &res.swap_out else continue;
+        dst.* = std.fmt.parseInt(u64, kv.next() orelse continue, 10) catch continue;
+    }
+    return res;
+}
+
+test "zram" {
+    const t = std.testing;
+    const tt = @import("../test.zig");
+
+    var tmp = try tt.TempDir.create();
+    defer tmp.cleanup();
+    try t.expectError(error.ZramUnavailable, Zram.init(tmp.abspath));
+    try tmp.dir.makePath(sysfs_dir);
+    try tmp.dir.makePath("dev");
+    try tmp.dir.makePath("proc/sys/vm");
+    try tmp.dir.writeFile(sysfs_dir ++ "/disksize", "0\n");
+    try tmp.dir.writeFile(sysfs_dir ++ "/comp_algorithm", "lzo [lzo-rle] lz4 zstd\n");
+    try tmp.dir.writeFile(sysfs_dir ++ "/mm_stat", "  3000000   1000000   1200000        0  1300000      12        0        3\n");
+    try tmp.dir.writeFile(dev_path, "");
+    try tmp.dir.writeFile(vmstat_path, "nr_free_pages 1234\npswpin 42\npswpout 420\nswap_ra 1\n");
+
+    var z = try Zram.init(tmp.abspath);
+    defer z.deinit();
+    try t.expect(try z.format(4 << 30));
+    var buf: [std.mem.page_size]u8 = undefined;
+    try t.expectEqualStrings("2147483648", try tmp.dir.readFile(sysfs_dir ++ "/disksize", &buf));
+    try t.expectEqualStrings("lz4", try tmp.dir.readFile(sysfs_dir ++ "/comp_algorithm", &buf));
+    try t.expectEqualStrings("0", try tmp.dir.readFile(page_cluster_path, &buf));
+    const hdr = try tmp.dir.readFile(dev_path, &buf);
+    try t.expectEqual(@as(usize, std.mem.page_size), hdr.len);
+    try t.expectEqualStrings("SWAPSPACE2", hdr[hdr.len - 10 ..]);
+    const endian = builtin.cpu.arch.endian();
+    try t.expectEqual(@as(u32, 1), std.mem.readInt(u32, hdr[1024..1028], endian));
+    try t.expectEqual(@as(u32, (2 << 30) / std.mem.page_size - 1), std.mem.readInt(u32, hdr[1028..1032], endian));
+    // in use already.
+    try t.expect(!try z.format(4 << 30));
+
+    try t.expect(try z.setSwappiness(swappinessFor(true)));
+    try t.expect(!try z.setSwappiness(swappinessFor(true)));
+    try t.expectEqualStrings("180", try tmp.dir.readFile(swappiness_path, &buf));
+
+    const s = try z.stats();
+    try t.expectEqual(@as(u64, 3000000), s.orig_bytes);
+    try t.expectEqual(@as(u64, 1000000), s.compr_bytes);
+    try t.expectEqual(@as(u64, 1200000), s.mem_used);
+    try t.expectEqual(@as(u64, 42), s.swap_in);
+    try t.expectEqual(@as(u64, 420), s.swap_out);
+}
@@ -10,6 +10,37 @@ pub fn hostname(allocator: std.mem.Allocator) ![]const u8 {
     return allocator.dupe(u8, name);
 }
 
+/// lowers the calling thread cpu and io scheduling priority to that of
+/// `nice -n 19` and `ionice -c 3`. child processes spawned from the thread
+/// afterwards inherit it; on linux, the rest of the process is unaffected.
+/// unprivileged processes cannot raise the priority back.
+pub fn setIdlePriority() !void {
+    const linux = std.os.linux;
+    const PRIO_PROCESS = 0;
+    switch (linux.getErrno(linux.syscall3(.setpriority, PRIO_PROCESS, 0, 19))) {
+        .SUCCESS => {},
+        else => |errno| return std.posix.unexpectedErrno(errno),
+    }
+    const IOPRIO_WHO_PROCESS = 1;
+    const IOPRIO_CLASS_IDLE = 3;
+    const IOPRIO_CLASS_SHIFT = 13;
+    const ioprio = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    switch (linux.getErrno(linux.syscall3(.ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio))) {
+        .SUCCESS => {},
+        else => |errno| return std.posix.unexpectedErrno(errno),
+    }
+}
+
+/// returns the total usable memory of the host, in bytes.
+pub fn totalMemory() !u64 {
+    const linux = std.os.linux;
+    var info: linux.Sysinfo = undefined;
+    switch (linux.getErrno(linux.sysinfo(&info))) {
+        .SUCCESS => return @as(u64, info.totalram) * info.mem_unit,
+        else => |errno| return std.posix.unexpectedErrno(errno),
+    }
+}
+
 /// a variable for tests; must not mutate at runtime otherwise.
 var hostname_filepath: []const u8 = "/etc/hostname";
 
@@ -0,0 +1,279 @@
+//! a thread-caching general purpose allocator for release builds of nd and ngui.
+//!
+//! small allocations are served from per size class pools of fixed size
+//! blocks carved out of 64KiB slabs, like LVGL's in ui/lvmem.zig. each thread
+//! keeps a few free blocks per class in a thread-local cache: an alloc or
+//! free is a list push or pop with no locking. threads exchange blocks with
+//! the shared pool in batches, and only when a cache runs empty or full.
+//! slabs are never returned to the OS. allocations larger than the largest
+//! class are passed on to libc malloc.
+//!
+//! blocks cached by a thread are lost when it exits, unless it calls
+//! releaseThreadCache first. ngui threads run for the lifetime of the program;
+//! short-lived nd ones release their caches.
+//! safe for concurrent use.
+
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+/// block sizes: powers of two from min_class up to max_class.
+const min_class_log2 = 4;
+const max_class_log2 = 12;
+const nclasses = max_class_log2 - min_class_log2 + 1;
+/// size of memory chunks requested from the OS to carve blocks from.
+const slab_size = 64 * 1024;
+/// a thread cache holding more free blocks of a class than this returns
+/// a batch of them to the shared pool.
+const cache_max = 64;
+/// number of blocks moved between a thread cache and the shared pool at once.
+const batch = 32;
+
+comptime {
+    std.debug.assert(@sizeOf(FreeBlock) <= 1 << min_class_log2);
+    std.debug.assert(batch < cache_max);
+}
+
+pub const allocator = Allocator{ .ptr = undefined, .vtable = &vtable };
+
+const vtable = Allocator.VTable{ .alloc = alloc, .resize = resize, .free = free };
+
+/// memory usage figures.
+pub const Stats = struct {
+    used: usize = 0, // bytes currently allocated, as requested by callers
+    peak: usize = 0, // max used bytes since program start
+    large: usize = 0, // bytes currently allocated from libc
+    pooled: usize = 0, // slab bytes obtained from the OS
+};
+
+/// returns a snapshot of the current memory usage figures.
+pub fn stats() Stats {
+    return .{
+        .used = used.load(.monotonic),
+        .peak = peak.load(.monotonic),
+        .large = large.load(.monotonic),
+        .pooled = pooled.load(.monotonic),
+    };
+}
+
+var used = std.atomic.Value(usize).init(0);
+var peak = std.atomic.Value(usize).init(0);
+var large = std.atomic.Value(usize).init(0);
+var pooled = std.atomic.Value(usize).init(0);
+
+/// an unused block.
+const FreeBlock = struct {
+    next: ?*FreeBlock,
+};
+
+const Bin = struct {
+    head: ?*FreeBlock = null,
+    count: usize = 0,
+};
+
+threadlocal var cache = [_]Bin{.{}} ** nclasses;
+
+/// guards shared.
+var mu: std.Thread.Mutex = .{};
+var shared = [_]?*FreeBlock{null} ** nclasses;
+
+/// returns the class index of an allocation, or null if it is passed on to libc.
+/// blocks are aligned to their size, so the alignment is a lower bound too.
+fn classOf(len: usize, log2_align: u8) ?usize {
+    const size = @max(len, @as(usize, 1) << @intCast(log2_align), 1 << min_class_log2);
+    if (size > 1 << max_class_log2) {
+        return null;
+    }
+    return std.math.log2_int_ceil(usize, size) - min_class_log2;
+}
+
+fn alloc(_: *anyopaque, len: usize, log2_align: u8, ret_addr: usize) ?[*]u8 {
+    const ci = classOf(len, log2_align) orelse {
+        const p = std.heap.c_allocator.rawAlloc(len, log2_align, ret_addr) orelse return null;
+        _ = large.fetchAdd(len, .monotonic);
+        account(0, len);
+        return p;
+    };
+    const bin = &cache[ci];
+    if (bin.head == null and !refill(ci, bin)) {
+        return null;
+    }
+    const b = bin.head.?;
+    bin.head = b.next;
+    bin.count -= 1;
+    account(0, len);
+    return @ptrCast(b);
+}
+
+/// small allocations resize in place within the same class; large ones
+/// as long as libc can do it and they remain large.
+fn resize(_: *anyopaque, buf: []u8, log2_align: u8, new_len: usize, ret_addr: usize) bool {
+    if (classOf(buf.len, log2_align)) |ci| {
+        const new_ci = classOf(new_len, log2_align) orelse return false;
+        if (new_ci != ci) {
+            return false;
+        }
+    } else {
+        if (classOf(new_len, log2_align) != null) {
+            return false;
+        }
+        if (!std.heap.c_allocator.rawResize(buf, log2_align, new_len, ret_addr)) {
+            return false;
+        }
+        _ = large.fetchAdd(new_len, .monotonic);
+        _ = large.fetchSub(buf.len, .monotonic);
+    }
+    account(buf.len, new_len);
+    return true;
+}
+
+fn free(_: *anyopaque, buf: []u8, log2_align: u8, ret_addr: usize) void {
+    account(buf.len, 0);
+    const ci = classOf(buf.len, log2_align) orelse {
+        _ = large.fetchSub(buf.len, .monotonic);
+        std.heap.c_allocator.rawFree(buf, log2_align, ret_addr);
+        return;
+    };
+    const bin = &cache[ci];
+    const b: *FreeBlock = @ptrCast(@alignCast(buf.ptr));
+    b.next = bin.head;
+    bin.head = b;
+    bin.count += 1;
+    if (bin.count > cache_max) {
+        flush(ci, bin);
+    }
+}
+
+/// moves a batch of free blocks from the shared pool into the thread cache,
+/// carving a new slab if the pool is empty. returns false if out of memory.
+fn refill(ci: usize, bin: *Bin) bool {
+    mu.lock();
+    defer mu.unlock();
+    if (shared[ci] == null) {
+        const slab = std.heap.page_allocator.alloc(u8, slab_size) catch return false;
+        _ = pooled.fetchAdd(slab_size, .monotonic);
+        const bsize = @as(usize, 1) << @intCast(ci + min_class_log2);
+        var i: usize = slab_size / bsize;
+        while (i > 0) {
+            i -= 1;
+            const b: *FreeBlock = @ptrCast(@alignCast(slab[i * bsize ..].ptr));
+            b.next = shared[ci];
+            shared[ci] = b;
+        }
+    }
+    var n: usize = 0;
+    while (n < batch) : (n += 1) {
+        const b = shared[ci] orelse break;
+        shared[ci] = b.next;
+        b.next = bin.head;
+        bin.head = b;
+    }
+    bin.count += n;
+    return true;
+}
+
+/// returns a batch of free blocks from the thread cache to the shared pool.
+fn flush(ci: usize, bin: *Bin) void {
+    mu.lock();
+    defer mu.unlock();
+    for (0..batch) |_| {
+        const b = bin.head.?;
+        bin.head = b.next;
+        b.next = shared[ci];
+        shared[ci] = b;
+    }
+    bin.count -= batch;
+}
+
+/// returns all free blocks cached by the calling thread to the shared pool;
+/// meant for threads about to exit. the cache refills on next use.
+pub fn releaseThreadCache() void {
+    mu.lock();
+    defer mu.unlock();
+    for (&cache, &shared) |*bin, *head| {
+        while (bin.head) |b| {
+            bin.head = b.next;
+            b.next = head.*;
+            head.* = b;
+        }
+        bin.count = 0;
+    }
+}
+
+fn account(old: usize, new: usize) void {
+    if (new > old) {
+        const v = used.fetchAdd(new - old, .monotonic) + new - old;
+        _ = peak.fetchMax(v, .monotonic);
+    } else {
+        _ = used.fetchSub(old - new, .monotonic);
+    }
+}
+
+test "tcalloc std allocator tests" {
+    try std.heap.testAllocator(allocator);
+    try std.heap.testAllocatorAligned(allocator);
+    try std.heap.testAllocatorAlignedShrink(allocator);
+}
+
+test "tcalloc stats" {
+    const t = std.testing;
+    const base = stats();
+
+    const a = try allocator.alloc(u8, 100);
+    try t.expectEqual(base.used + 100, stats().used);
+    try t.expect(@intFromPtr(a.ptr) % 128 == 0);
+    // grows in place within the same class but not beyond.
+    try t.expect(allocator.resize(a, 128));
+    try t.expectEqual(base.used + 128, stats().used);
+    try t.expect(!allocator.resize(a.ptr[0..128], 129));
+    allocator.free(a.ptr[0..128]);
+
+    const big = try allocator.alloc(u8, 10000);
+    try t.expectEqual(base.large + 10000, stats().large);
+    allocator.free(big);
+    try t.expectEqual(base.used, stats().used);
+    try t.expectEqual(base.large, stats().large);
+}
+
+test "tcalloc cross-thread free" {
+    const t = std.testing;
+    const base = stats();
+
+    // more than a thread cache holds, so blocks go through the shared pool.
+    var ptrs: [cache_max * 3][]u8 = undefined;
+    for (&ptrs) |*p| {
+        p.* = try allocator.alloc(u8, 48);
+    }
+    const th = try std.Thread.spawn(.{}, struct {
+        fn f(list: [][]u8) void {
+            for (list) |p| allocator.free(p);
+        }
+    }.f, .{@as([][]u8, &ptrs)});
+    th.join();
+    try t.expectEqual(base.used, stats().used);
+
+    // and can be allocated again from this thread.
+    for (&ptrs) |*p| {
+        p.* = try allocator.alloc(u8, 48);
+    }
+    for (ptrs) |p| {
+        allocator.free(p);
+    }
+    try t.expectEqual(base.used, stats().used);
+}
+
+test "tcalloc release thread cache" {
+    const t = std.testing;
+
+    // a block freed by a thread of an otherwise empty cache ends up on top
+    // of the shared pool rather than lost with the thread.
+    const a = try allocator.alloc(u8, 200);
+    const th = try std.Thread.spawn(.{}, struct {
+        fn f(buf: []u8) void {
+            allocator.free(buf);
+            releaseThreadCache();
+        }
+    }.f, .{a});
+    th.join();
+    const top = shared[classOf(200, 0).?] orelse return error.TestUnexpectedResult;
+    try t.expectEqual(@intFromPtr(a.ptr), @intFromPtr(top));
+}
@@ -5,6 +5,8 @@ const nif = @import("nif");
 const comm = @import("comm.zig");
 const types = @import("types.zig");
 
+pub const MockRpcServer = @import("test/MockRpcServer.zig");
+
 comptime {
     if (!builtin.is_test) @compileError("test-only module");
 }
@@ -17,11 +19,24 @@ export fn lv_timer_del(timer: *opaque {}) void {
     _ = timer;
 }
 
+export fn lv_timer_set_period(timer: *opaque {}, period: u32) void {
+    _ = timer;
+    _ = period;
+}
+
+export fn _lv_disp_get_refr_timer(disp: ?*opaque {}) ?*opaque {} {
+    _ = disp;
+    return null;
+}
+
 export fn lv_disp_get_inactive_time(disp: *opaque {}) u32 {
     _ = disp;
     return 0;
 }
 
+// referenced by const styles in ui/lvgl.zig.
+export const nm_font_title: u8 = 0;
+
 var global_gpa_state: std.heap.GeneralPurposeAllocator(.{}) = undefined;
 var global_gpa: std.mem.Allocator = undefined;
 var initGlobalOnce = std.once(initGlobalFn);
@@ -192,6 +207,11 @@ pub const TestWpaControl = struct {
         return false;
     }
 
+    /// no socket in tests: callers skip polling.
+    pub fn fd(_: Self) std.posix.fd_t {
+        return -1;
+    }
+
     pub fn receive(_: Self, _: [:0]u8) ![]const u8 {
         return &.{};
     }
@@ -231,6 +251,56 @@ pub const TestWpaControl = struct {
     }
 };
 
+/// a nif.wpa.AsyncControl stub for tests. each request is replied to with
+/// the reply field right away, on the next receive.
+pub const TestWpaAsyncControl = struct {
+    opened: bool,
+    reply: []const u8 = "",
+    /// submitted requests awaiting receive, oldest first.
+    queue: std.BoundedArray(u32, nif.wpa.AsyncControl.max_inflight) = .{},
+    next_id: u32 = 1,
+
+    const Self = @This();
+    pub const Request = nif.wpa.AsyncControl.Request;
+    pub const Reply = nif.wpa.AsyncControl.Reply;
+
+    pub fn open(_: [:0]const u8) !Self {
+        return .{ .opened = true };
+    }
+
+    pub fn close(self: *Self) void {
+        self.opened = false;
+    }
+
+    /// no socket in tests: callers skip polling.
+    pub fn fd(_: Self) std.posix.fd_t {
+        return -1;
+    }
+
+    pub fn submit(self: *Self, _: []const u8, _: u32) !Request {
+        self.queue.append(self.next_id) catch return error.WpaCtrlBusy;
+        defer self.next_id += 1;
+        return .{ .id = self.next_id };
+    }
+
+    pub fn receive(self: *Self, buf: []u8) !?Reply {
+        if (self.queue.len == 0) {
+            return null;
+        }
+        const n = @min(buf.len, self.reply.len);
+        @memcpy(buf[0..n], self.reply[0..n]);
+        return .{ .req = .{ .id = self.queue.orderedRemove(0) }, .data = buf[0..n] };
+    }
+
+    pub fn expire(_: *Self, _: i64) ?Request {
+        return null;
+    }
+
+    pub fn busy(self: Self) bool {
+        return self.queue.len > 0;
+    }
+};
+
 /// similar to std.testing.expectEqualDeep but compares slices with expectEqualSlices
 /// or expectEqualStrings where slice element is a u8.
 /// unhandled types are passed to std.testing.expectEqualDeep.
@@ -326,11 +396,24 @@ pub fn expectNoSubstring(needle: []const u8, haystack: []const u8) !void {
 }
 
 test {
+    _ = @import("allocprof.zig");
+    _ = @import("bitcoindrpc.zig");
+    _ = @import("bitcoindzmq.zig");
+    _ = @import("deadline.zig");
     _ = @import("nd.zig");
     _ = @import("nd/Daemon.zig");
     _ = @import("ngui.zig");
     _ = @import("lightning.zig");
+    _ = @import("lockprof.zig");
+    _ = @import("logring.zig");
+    _ = @import("memacct.zig");
     _ = @import("sys.zig");
+    _ = @import("tcalloc.zig");
+    _ = @import("test/MockRpcServer.zig");
+    _ = @import("torctl.zig");
+    _ = @import("trace.zig");
+    _ = @import("ui/lvmem.zig");
+    _ = @import("ui/perf.zig");
     _ = @import("xfmt.zig");
 
     std.testing.refAllDecls(@This());
@@ -0,0 +1,54 @@
+//! an allocator wrapper counting allocations and tracking peak memory use;
+//! not safe for concurrent use. used by the benchmarks.
+
+const std = @import("std");
+
+child: std.mem.Allocator,
+count: usize = 0, // successful alloc calls
+bytes: usize = 0, // total allocated, including growth in place
+live: usize = 0, // currently allocated
+peak: usize = 0, // max live since last reset
+
+const CountingAllocator = @This();
+
+pub fn allocator(self: *CountingAllocator) std.mem.Allocator {
+    return .{ .ptr = self, .vtable = &.{ .alloc = alloc, .resize = resize, .free = free } };
+}
+
+/// zeroes the counters; peak starts over from what is live at the moment.
+pub fn reset(self: *CountingAllocator) void {
+    self.count = 0;
+    self.bytes = 0;
+    self.peak = self.live;
+}
+
+fn alloc(ctx: *anyopaque, len: usize, ptr_align: u8, ret_addr: usize) ?[*]u8 {
+    const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+    const p = self.child.rawAlloc(len, ptr_align, ret_addr) orelse return null;
+    self.count += 1;
+    self.bytes += len;
+    self.grow(len);
+    return p;
+}
+
+fn resize(ctx: *anyopaque, buf: []u8, buf_align: u8, new_len: usize, ret_addr: usize) bool {
+    const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+    if (!self.child.rawResize(buf, buf_align, new_len, ret_addr)) {
+        return false;
+    }
+    self.bytes += new_len -| buf.len;
+    self.live -|= buf.len;
+    self.grow(new_len);
+    return true;
+}
+
+fn free(ctx: *anyopaque, buf: []u8, buf_align: u8, ret_addr: usize) void {
+    const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+    self.child.rawFree(buf, buf_align, ret_addr);
+    self.live -|= buf.len;
+}
+
+fn grow(self: *CountingAllocator, n: usize) void {
+    self.live += n;
+    self.peak = @max(self.peak, self.live);
+}
@@ -0,0 +1,696 @@
+///! an in-process mock of bitcoind JSON-RPC and REST or lnd REST API server for tests
+///! and benchmarks. responds with synthetic data of adjustable size, after
+///! an adjustable delay, failing some of the requests on purpose; see Knobs.
+///!
+///! speaks plain HTTP/1.1 with keep-alive on a loopback port picked by the OS,
+///! serving each connection in its own thread like the real servers do.
+///! lnd clients must be created with lndhttp.Client.InitOpt.plain_http.
+const std = @import("std");
+const posix = std.posix;
+const Atomic = std.atomic.Value;
+
+pub const Kind = enum { bitcoind, lnd };
+
+pub const Fault = enum(u8) {
+    drop, // close the connection without a response
+    http_500, // respond with 500 internal server error
+    rpc_warmup, // bitcoind: rpc error -28 as during startup; lnd: same as http_500
+};
+
+/// response parameters; adjustable at any time, including while serving.
+pub const Knobs = struct {
+    /// delay before each response.
+    latency_ms: Atomic(u32) = Atomic(u32).init(0),
+    /// every fail_every-th request fails with the fault; 0 never fails.
+    fail_every: Atomic(u32) = Atomic(u32).init(0),
+    fault: Atomic(Fault) = Atomic(Fault).init(.drop),
+    /// number of bitcoind peers or lnd channels in responses.
+    size: Atomic(u32) = Atomic(u32).init(10),
+    /// chain tip reported by both kinds; increment to simulate a new block.
+    height: Atomic(u32) = Atomic(u32).init(800000),
+};
+
+allocator: std.mem.Allocator,
+kind: Kind,
+knobs: Knobs = .{},
+listener: std.net.Server,
+/// total requests received, including failed ones.
+nreq: Atomic(u32) = Atomic(u32).init(0),
+/// total connections accepted.
+nconn: Atomic(u32) = Atomic(u32).init(0),
+
+stopping: Atomic(bool) = Atomic(bool).init(false),
+thread: ?std.Thread = null,
+/// accepted connections; owned by the accept thread until stop.
+conns: std.ArrayListUnmanaged(*Conn) = .{},
+
+const MockRpcServer = @This();
+
+const Conn = struct {
+    stream: std.net.Stream,
+    thread: std.Thread,
+    done: Atomic(bool) = Atomic(bool).init(false),
+};
+
+/// max accepted request body size.
+const max_request_size = 64 * 1024;
+
+/// starts listening on 127.0.0.1 and accepting connections in a new thread.
+/// the returned value must be stop'ed when done.
+pub fn start(allocator: std.mem.Allocator, kind: Kind) !*MockRpcServer {
+    const addr = try std.net.Address.parseIp4("127.0.0.1", 0);
+    const self = try allocator.create(MockRpcServer);
+    errdefer allocator.destroy(self);
+    self.* = .{
+        .allocator = allocator,
+        .kind = kind,
+        .listener = try addr.listen(.{ .reuse_address = true }),
+    };
+    errdefer self.listener.deinit();
+    self.thread = try std.Thread.spawn(.{}, acceptLoop, .{self});
+    return self;
+}
+
+/// stops serving, closes all connections and frees the server.
+pub fn stop(self: *MockRpcServer) void {
+    self.stopping.store(true, .release);
+    // unblock the accept call.
+    if (std.net.tcpConnectToAddress(self.listener.listen_address)) |s| s.close() else |_| {}
+    if (self.thread) |th| th.join();
+    for (self.conns.items) |c| {
+        posix.shutdown(c.stream.handle, .both) catch {}; // unblock reads
+        c.thread.join();
+        c.stream.close();
+        self.allocator.destroy(c);
+    }
+    self.conns.deinit(self.allocator);
+    self.listener.deinit();
+    self.allocator.destroy(self);
+}
+
+/// the listening TCP port.
+pub fn port(self: *const MockRpcServer) u16 {
+    return self.listener.listen_address.getPort();
+}
+
+fn acceptLoop(self: *MockRpcServer) void {
+    while (true) {
+        const conn = self.listener.accept() catch |err| {
+            if (!self.stopping.load(.acquire)) {
+                std.debug.print("mockrpc: accept: {!}\n", .{err});
+            }
+            return;
+        };
+        if (self.stopping.load(.acquire)) {
+            conn.stream.close();
+            return;
+        }
+        self.reap();
+        self.spawnConn(conn.stream) catch |err| {
+            std.debug.print("mockrpc: spawn conn: {!}\n", .{err});
+            conn.stream.close();
+        };
+    }
+}
+
+fn spawnConn(self: *MockRpcServer, stream: std.net.Stream) !void {
+    try self.conns.ensureUnusedCapacity(self.allocator, 1);
+    const c = try self.allocator.create(Conn);
+    errdefer self.allocator.destroy(c);
+    c.* = .{ .stream = stream, .thread = undefined };
+    c.thread = try std.Thread.spawn(.{}, serveConn, .{ self, c });
+    self.conns.appendAssumeCapacity(c);
+    _ = self.nconn.fetchAdd(1, .monotonic);
+}
+
+/// joins and frees connections closed since the last call, so that long
+/// benchmarks with a new connection per request don't pile up threads.
+fn reap(self: *MockRpcServer) void {
+    var i: usize = 0;
+    while (i < self.conns.items.len) {
+        const c = self.conns.items[i];
+        if (!c.done.load(.acquire)) {
+            i += 1;
+            continue;
+        }
+        c.thread.join();
+        c.stream.close();
+        self.allocator.destroy(c);
+        _ = self.conns.swapRemove(i);
+    }
+}
+
+fn serveConn(self: *MockRpcServer, c: *Conn) void {
+    defer {
+        // signal end of response to HTTP/1.0 clients; closed in reap or stop.
+        posix.shutdown(c.stream.handle, .both) catch {};
+        c.done.store(true, .release);
+    }
+    var arena_state = std.heap.ArenaAllocator.init(self.allocator);
+    defer arena_state.deinit();
+    var br = std.io.bufferedReader(c.stream.reader());
+    while (!self.stopping.load(.acquire)) {
+        _ = arena_state.reset(.retain_capacity);
+        const keep = self.serveRequest(arena_state.allocator(), br.reader(), c.stream) catch return;
+        if (!keep) {
+            return;
+        }
+    }
+}
+
+const Request = struct {
+    path: []const u8, // without query
+    query: []const u8, // after '?', if any
+    body: []const u8,
+    keepalive: bool,
+};
+
+/// reads a single request. returns null if the connection is closed
+/// before a new request starts.
+fn readRequest(arena: std.mem.Allocator, r: anytype) !?Request {
+    var buf: [4096]u8 = undefined;
+    const first = try r.readUntilDelimiterOrEof(&buf, '\n') orelse return null;
+    var it = std.mem.tokenizeScalar(u8, std.mem.trimRight(u8, first, "\r"), ' ');
+    _ = it.next() orelse return error.BadRequest; // method
+    const target = it.next() orelse return error.BadRequest;
+    const qmark = std.mem.indexOfScalar(u8, target, '?') orelse target.len;
+    const path = try arena.dupe(u8, target[0..qmark]);
+    const query = try arena.dupe(u8, target[@min(qmark + 1, target.len)..]);
+    var keepalive = std.mem.eql(u8, it.next() orelse "", "HTTP/1.1");
+    var clen: usize = 0;
+    while (true) {
+        const line = std.mem.trimRight(u8, try r.readUntilDelimiter(&buf, '\n'), "\r");
+        if (line.len == 0) {
+            break;
+        }
+        const colon = std.mem.indexOfScalar(u8, line, ':') orelse continue;
+        const name = line[0..colon];
+        const value = std.mem.trim(u8, line[colon + 1 ..], " \t");
+        if (std.ascii.eqlIgnoreCase(name, "content-length")) {
+            clen = try std.fmt.parseUnsigned(usize, value, 10);
+        } else if (std.ascii.eqlIgnoreCase(name, "connection")) {
+            keepalive = !std.ascii.eqlIgnoreCase(value, "close");
+        }
+    }
+    if (clen > max_request_size) {
+        return error.RequestTooLarge;
+    }
+    const body = try arena.alloc(u8, clen);
+    try r.readNoEof(body);
+    return .{ .path = path, .query = query, .body = body, .keepalive = keepalive };
+}
+
+/// serves a single request and reports whether to keep the connection open.
+fn serveRequest(self: *MockRpcServer, arena: std.mem.Allocator, r: anytype, stream: std.net.Stream) !bool {
+    const req = try readRequest(arena, r) orelse return false;
+    const n = self.nreq.fetchAdd(1, .monotonic) + 1;
+    const delay = self.knobs.latency_ms.load(.monotonic);
+    if (delay > 0) {
+        std.time.sleep(delay * std.time.ns_per_ms);
+    }
+    const every = self.knobs.fail_every.load(.monotonic);
+    const failing = every > 0 and n % every == 0;
+    const fault = self.knobs.fault.load(.monotonic);
+    if (failing and fault == .drop) {
+        return false;
+    }
+
+    var body = std.ArrayList(u8).init(arena);
+    var status: std.http.Status = .ok;
+    const rest = self.kind == .bitcoind and std.mem.startsWith(u8, req.path, "/rest/");
+    if (failing and rest) {
+        status = if (fault == .rpc_warmup) .service_unavailable else .internal_server_error;
+        try body.appendSlice("mock fault");
+    } else if (failing and (fault == .http_500 or self.kind == .lnd)) {
+        status = .internal_server_error;
+        try body.appendSlice("{\"code\":2,\"message\":\"mock fault\"}");
+    } else if (rest) {
+        status = try self.bitcoindRest(req.path, req.query, body.writer());
+    } else switch (self.kind) {
+        .bitcoind => try self.bitcoindRespond(arena, req.body, failing, body.writer()),
+        .lnd => status = try self.lndRespond(req.path, body.writer()),
+    }
+
+    // a single write: small segments sent separately may be delayed by
+    // Nagle's algorithm, skewing latency measurements.
+    var resp = std.ArrayList(u8).init(arena);
+    const w = resp.writer();
+    try w.print("HTTP/1.1 {d} {s}\r\n", .{ @intFromEnum(status), status.phrase() orelse "" });
+    try w.writeAll("Content-Type: application/json\r\n");
+    try w.print("Content-Length: {d}\r\n", .{body.items.len});
+    if (!req.keepalive) {
+        try w.writeAll("Connection: close\r\n");
+    }
+    try w.writeAll("\r\n");
+    try w.writeAll(body.items);
+    try stream.writeAll(resp.items);
+    return req.keepalive;
+}
+
+/// writes a JSON-RPC response to a single or batch request.
+/// warmup makes all entries fail with the bitcoind startup error.
+fn bitcoindRespond(self: *MockRpcServer, arena: std.mem.Allocator, reqbody: []const u8, warmup: bool, w: anytype) !void {
+    var jw = std.json.writeStream(w, .{});
+    defer jw.deinit();
+    const doc = std.json.parseFromSliceLeaky(std.json.Value, arena, reqbody, .{}) catch {
+        return self.bitcoindEntry(&jw, .null, warmup);
+    };
+    switch (doc) {
+        .array => |entries| {
+            try jw.beginArray();
+            for (entries.items) |entry| {
+                try self.bitcoindEntry(&jw, entry, warmup);
+            }
+            try jw.endArray();
+        },
+        else => try self.bitcoindEntry(&jw, doc, warmup),
+    }
+}
+
+fn bitcoindEntry(self: *MockRpcServer, jw: anytype, entry: std.json.Value, warmup: bool) !void {
+    const id: std.json.Value = if (entry == .object) entry.object.get("id") orelse .null else .null;
+    const method = blk: {
+        if (entry != .object) break :blk "";
+        const m = entry.object.get("method") orelse break :blk "";
+        break :blk if (m == .string) m.string else "";
+    };
+    const height = self.knobs.height.load(.monotonic);
+    const size = self.knobs.size.load(.monotonic);
+    var hashbuf: [64]u8 = undefined;
+    const hash = try std.fmt.bufPrint(&hashbuf, "{x:0>64}", .{height});
+
+    try jw.beginObject();
+    try jw.objectField("id");
+    try jw.write(id);
+    if (warmup) {
+        return rpcError(jw, -28, "Loading block index...");
+    }
+    if (std.mem.eql(u8, method, "getblockchaininfo")) {
+        try jw.objectField("result");
+        try writeChainInfo(jw, height, hash);
+    } else if (std.mem.eql(u8, method, "getblockhash")) {
+        try jw.objectField("result");
+        try jw.write(hash);
+    } else if (std.mem.eql(u8, method, "getmempoolinfo")) {
+        try jw.objectField("result");
+        try jw.write(.{
+            .loaded = true,
+            .size = 100000,
+            .bytes = 90000000,
+            .usage = 200000000,
+            .total_fee = 2.5,
+            .maxmempool = 300000000,
+            .mempoolminfee = 0.00001,
+            .minrelaytxfee = 0.00001,
+            .incrementalrelayfee = 0.00001,
+            .unbroadcastcount = 0,
+            .fullrbf = false,
+        });
+    } else if (std.mem.eql(u8, method, "getnettotals")) {
+        try jw.objectField("result");
+        try jw.write(.{
+            .totalbytesrecv = 1000000 * @as(u64, height),
+            .totalbytessent = 100000 * @as(u64, height),
+            .timemillis = 1700000000000 + @as(u64, height) * 600000,
+        });
+    } else if (std.mem.eql(u8, method, "getnetworkinfo")) {
+        try jw.objectField("result");
+        try jw.write(.{
+            .version = 260000,
+            .subversion = "/Satoshi:26.0.0/",
+            .protocolversion = 70016,
+            .connections = size,
+            .connections_in = size / 2,
+            .connections_out = size - size / 2,
+            .networkactive = true,
+            .networks = &[_]struct { name: []const u8, limited: bool, reachable: bool }{
+                .{ .name = "ipv4", .limited = false, .reachable = true },
+            },
+            .relayfee = 0.00001,
+            .incrementalfee = 0.00001,
+            .localaddresses = @as([]const u32, &.{}),
+            .warnings = "",
+        });
+    } else if (std.mem.eql(u8, method, "getpeerinfo")) {
+        try jw.objectField("result");
+        try jw.beginArray();
+        for (0..size) |i| {
+            var addrbuf: [32]u8 = undefined;
+            try jw.write(.{
+                .id = i,
+                .addr = try std.fmt.bufPrint(&addrbuf, "10.{d}.{d}.{d}:8333", .{ i >> 16 & 0xff, i >> 8 & 0xff, i & 0xff }),
+                .inbound = i % 2 == 0,
+                .connection_type = if (i % 2 == 0) "inbound" else "outbound-full-relay",
+            });
+        }
+        try jw.endArray();
+    } else if (std.mem.eql(u8, method, "getblockstats") or std.mem.eql(u8, method, "getblockheader")) {
+        // block hashes are hex heights, as in getblockchaininfo.
+        const h: u64 = blk: {
+            const params = entry.object.get("params") orelse break :blk height;
+            if (params != .object) break :blk height;
+            const v = params.object.get("hash_or_height") orelse params.object.get("blockhash") orelse break :blk height;
+            if (v != .string) break :blk height;
+            break :blk std.fmt.parseUnsigned(u64, v.string, 16) catch height;
+        };
+        var prevbuf: [64]u8 = undefined;
+        const prev = try std.fmt.bufPrint(&prevbuf, "{x:0>64}", .{h -| 1});
+        var blockbuf: [64]u8 = undefined;
+        const block = try std.fmt.bufPrint(&blockbuf, "{x:0>64}", .{h});
+        try jw.objectField("result");
+        if (std.mem.eql(u8, method, "getblockheader")) {
+            try jw.write(.{ .hash = block, .height = h, .previousblockhash = prev });
+        } else {
+            try jw.write(.{
+                .blockhash = block,
+                .height = h,
+                .time = 1700000000 + h * 600,
+                .txs = 3000,
+                .minfeerate = 1,
+                .maxfeerate = 500,
+                .total_size = 1500000,
+            });
+        }
+    } else if (std.mem.eql(u8, method, "disconnectnode")) {
+        try jw.objectField("result");
+        try jw.write(null);
+    } else if (std.mem.eql(u8, method, "estimatesmartfee")) {
+        const target = blk: {
+            const params = entry.object.get("params") orelse break :blk 1;
+            if (params != .object) break :blk 1;
+            const v = params.object.get("conf_target") orelse break :blk 1;
+            break :blk if (v == .integer) v.integer else 1;
+        };
+        try jw.objectField("result");
+        // longer targets are cheaper: 1 sat/vB per block short of 144.
+        try jw.write(.{ .feerate = @as(f64, @floatFromInt(@max(1, 145 - target))) * 1e-5, .blocks = target });
+    } else {
+        return rpcError(jw, -32601, "Method not found");
+    }
+    try jw.objectField("error");
+    try jw.write(null);
+    try jw.endObject();
+}
+
+fn writeChainInfo(jw: anytype, height: u32, hash: []const u8) !void {
+    try jw.write(.{
+        .chain = "main",
+        .blocks = height,
+        .headers = height,
+        .bestblockhash = hash,
+        .difficulty = 86388558925171.02,
+        .time = 1700000000 + @as(u64, height) * 600,
+        .mediantime = 1699999000 + @as(u64, height) * 600,
+        .verificationprogress = 0.9999,
+        .initialblockdownload = false,
+        .size_on_disk = 600000000000,
+        .pruned = false,
+        .warnings = "",
+    });
+}
+
+/// writes a bitcoind REST response body for the request path: chain info,
+/// block hashes by height and headers. as in JSON-RPC responses, block hashes
+/// are hex heights, here in the internal byte order of .bin responses.
+fn bitcoindRest(self: *MockRpcServer, path: []const u8, query: []const u8, w: anytype) !std.http.Status {
+    const height = self.knobs.height.load(.monotonic);
+    if (std.mem.eql(u8, path, "/rest/chaininfo.json")) {
+        var jw = std.json.writeStream(w, .{});
+        defer jw.deinit();
+        var hashbuf: [64]u8 = undefined;
+        try writeChainInfo(&jw, height, try std.fmt.bufPrint(&hashbuf, "{x:0>64}", .{height}));
+        return .ok;
+    }
+    if (restArg(path, "/rest/blockhashbyheight/")) |arg| {
+        const h = std.fmt.parseUnsigned(u64, arg, 10) catch return .bad_request;
+        if (h > height) {
+            return .not_found;
+        }
+        try w.writeAll(&mockBlockHash(h));
+        return .ok;
+    }
+    if (restArg(path, "/rest/headers/")) |arg| {
+        const start = std.fmt.parseUnsigned(u64, arg, 16) catch return .bad_request;
+        const count = blk: {
+            if (!std.mem.startsWith(u8, query, "count=")) break :blk 5;
+            break :blk std.fmt.parseUnsigned(u64, query["count=".len..], 10) catch return .bad_request;
+        };
+        if (start > height) {
+            return .not_found;
+        }
+        var h = start;
+        while (h <= height and h - start < count) : (h += 1) {
+            var hdr = [_]u8{0} ** 80;
+            std.mem.writeInt(i32, hdr[0..4], 0x20000000, .little);
+            if (h > 0) {
+                hdr[4..36].* = mockBlockHash(h - 1);
+            }
+            std.mem.writeInt(u32, hdr[68..72], @intCast(1700000000 + h * 600), .little);
+            std.mem.writeInt(u32, hdr[72..76], 0x17030ecd, .little);
+            std.mem.writeInt(u32, hdr[76..80], @truncate(h), .little);
+            try w.writeAll(&hdr);
+        }
+        return .ok;
+    }
+    return .not_found;
+}
+
+/// returns the path segment after prefix, without the .bin extension.
+fn restArg(path: []const u8, prefix: []const u8) ?[]const u8 {
+    if (!std.mem.startsWith(u8, path, prefix) or !std.mem.endsWith(u8, path, ".bin")) {
+        return null;
+    }
+    return path[prefix.len .. @max(prefix.len, path.len - ".bin".len)];
+}
+
+/// the hex height block hash of h, in internal byte order: little endian.
+fn mockBlockHash(h: u64) [32]u8 {
+    var b = [_]u8{0} ** 32;
+    std.mem.writeInt(u64, b[0..8], h, .little);
+    return b;
+}
+
+/// completes a response entry object with a null result and an error.
+fn rpcError(jw: anytype, code: i32, msg: []const u8) !void {
+    try jw.objectField("result");
+    try jw.write(null);
+    try jw.objectField("error");
+    try jw.write(.{ .code = code, .message = msg });
+    try jw.endObject();
+}
+
+/// writes an lnd REST API response body for the request path.
+fn lndRespond(self: *MockRpcServer, path: []const u8, w: anytype) !std.http.Status {
+    var jw = std.json.writeStream(w, .{});
+    defer jw.deinit();
+    const height = self.knobs.height.load(.monotonic);
+    const size = self.knobs.size.load(.monotonic);
+    var hashbuf: [64]u8 = undefined;
+    const hash = try std.fmt.bufPrint(&hashbuf, "{x:0>64}", .{height});
+
+    if (std.mem.eql(u8, path, "/v1/getinfo")) {
+        try jw.write(.{
+            .version = "0.17.3-beta commit=v0.17.3-beta",
+            .identity_pubkey = "03" ++ "ab" ** 32,
+            .alias = "mocknode",
+            .color = "#3399ff",
+            .num_pending_channels = 0,
+            .num_active_channels = size,
+            .num_inactive_channels = 0,
+            .num_peers = size,
+            .block_height = height,
+            .block_hash = hash,
+            .synced_to_chain = true,
+            .synced_to_graph = true,
+            .chains = &[_]struct { chain: []const u8, network: []const u8 }{
+                .{ .chain = "bitcoin", .network = "mainnet" },
+            },
+            .uris = @as([]const []const u8, &.{}),
+        });
+    } else if (std.mem.eql(u8, path, "/v1/fees")) {
+        try jw.beginObject();
+        try jw.objectField("day_fee_sum");
+        try jw.write(13);
+        try jw.objectField("week_fee_sum");
+        try jw.write(132);
+        try jw.objectField("month_fee_sum");
+        try jw.write(1321);
+        try jw.objectField("channel_fees");
+        try jw.beginArray();
+        for (0..size) |i| {
+            var ch: ChanIds = undefined;
+            try jw.write(.{
+                .chan_id = try ch.id(i),
+                .channel_point = try ch.point(i),
+                .base_fee_msat = 1000,
+                .fee_per_mil = 400,
+                .fee_rate = 0.0004,
+            });
+        }
+        try jw.endArray();
+        try jw.endObject();
+    } else if (std.mem.eql(u8, path, "/v1/channels")) {
+        try jw.beginObject();
+        try jw.objectField("channels");
+        try jw.beginArray();
+        for (0..size) |i| {
+            var ch: ChanIds = undefined;
+            var aliasbuf: [32]u8 = undefined;
+            try jw.write(.{
+                .chan_id = try ch.id(i),
+                .remote_pubkey = try ch.pubkey(i),
+                .channel_point = try ch.point(i),
+                .capacity = 1000000,
+                .local_balance = 500000,
+                .remote_balance = 500000,
+                .unsettled_balance = 0,
+                .total_satoshis_sent = i * 1000,
+                .total_satoshis_received = i * 2000,
+                .active = i % 5 != 3,
+                .private = i % 3 == 0,
+                .initiator = true,
+                .peer_alias = try std.fmt.bufPrint(&aliasbuf, "mock-peer{d}", .{i}),
+            });
+        }
+        try jw.endArray();
+        try jw.endObject();
+    } else if (std.mem.eql(u8, path, "/v1/channels/pending")) {
+        try jw.write(.{
+            .total_limbo_balance = 0,
+            .pending_open_channels = @as([]const u32, &.{}),
+            .pending_force_closing_channels = @as([]const u32, &.{}),
+            .waiting_close_channels = @as([]const u32, &.{}),
+        });
+    } else if (std.mem.startsWith(u8, path, "/v1/graph/node/")) {
+        try jw.write(.{
+            .node = .{
+                .pub_key = path["/v1/graph/node/".len..],
+                .alias = "mock-peer",
+                .color = "#3399ff",
+                .last_update = 1700000000,
+            },
+            .num_channels = 1,
+            .total_capacity = 1000000,
+        });
+    } else if (std.mem.eql(u8, path, "/v1/graph")) {
+        // the mock node has a channel to each peer, and peers are chained.
+        const own = "03" ++ "ab" ** 32;
+        try jw.beginObject();
+        try jw.objectField("nodes");
+        try jw.beginArray();
+        try jw.write(.{ .pub_key = own, .alias = "mocknode", .addresses = @as([]const u32, &.{}) });
+        for (0..size) |i| {
+            var ch: ChanIds = undefined;
+            try jw.write(.{ .pub_key = try ch.pubkey(i), .alias = "mock-peer", .addresses = @as([]const u32, &.{}) });
+        }
+        try jw.endArray();
+        try jw.objectField("edges");
+        try jw.beginArray();
+        for (0..size) |i| {
+            var ch: ChanIds = undefined;
+            try jw.write(.{
+                .channel_id = try ch.id(i),
+                .node1_pub = own,
+                .node2_pub = try ch.pubkey(i),
+                .capacity = "1000000",
+                .node1_policy = .{ .time_lock_delta = 80, .disabled = false },
+                .node2_policy = null,
+            });
+            if (i + 1 < size) {
+                var next: ChanIds = undefined;
+                var idbuf: [20]u8 = undefined;
+                try jw.write(.{
+                    .channel_id = try std.fmt.bufPrint(&idbuf, "{d}", .{948352385882718209 + i}),
+                    .node1_pub = try ch.pubkey(i),
+                    .node2_pub = try next.pubkey(i + 1),
+                    .capacity = "5000000",
+                });
+            }
+        }
+        try jw.endArray();
+        try jw.endObject();
+    } else if (std.mem.eql(u8, path, "/v1/balance/blockchain")) {
+        try jw.write(.{
+            .total_balance = 800000,
+            .confirmed_balance = 700000,
+            .unconfirmed_balance = 100000,
+            .locked_balance = 0,
+            .reserved_balance_anchor_chan = 10000,
+        });
+    } else if (std.mem.eql(u8, path, "/v1/state")) {
+        try jw.write(.{ .state = "SERVER_ACTIVE" });
+    } else {
+        try jw.write(.{ .code = 5, .message = "Not Found" });
+        return .not_found;
+    }
+    return .ok;
+}
+
+/// formats synthetic channel identifiers, deterministic for an index.
+const ChanIds = struct {
+    idbuf: [20]u8,
+    pointbuf: [80]u8,
+    pubbuf: [66]u8,
+
+    fn id(self: *ChanIds, i: usize) ![]const u8 {
+        return std.fmt.bufPrint(&self.idbuf, "{d}", .{848352385882718209 + i});
+    }
+
+    fn point(self: *ChanIds, i: usize) ![]const u8 {
+        return std.fmt.bufPrint(&self.pointbuf, "{x:0>64}:{d}", .{ @as(u64, i) *% 0x9e3779b97f4a7c15, i % 2 });
+    }
+
+    fn pubkey(self: *ChanIds, i: usize) ![]const u8 {
+        return std.fmt.bufPrint(&self.pubbuf, "02{x:0>64}", .{@as(u64, i) *% 0xc2b2ae3d27d4eb4f});
+    }
+};
+
+test "bitcoind batch" {
+    const t = std.testing;
+
+    const srv = try start(t.allocator, .bitcoind);
+    defer srv.stop();
+    srv.knobs.size.store(3, .monotonic);
+
+    const stream = try std.net.tcpConnectToAddress(srv.listener.listen_address);
+    defer stream.close();
+    const reqbody =
+        \\[{"id":1,"method":"getpeerinfo"},{"id":2,"method":"nosuchmethod"}]
+    ;
+    try stream.writer().print("POST / HTTP/1.0\r\nContent-Length: {d}\r\n\r\n{s}", .{ reqbody.len, reqbody });
+    const resp = try stream.reader().readAllAlloc(t.allocator, 1 << 20);
+    defer t.allocator.free(resp);
+    try t.expect(std.mem.startsWith(u8, resp, "HTTP/1.1 200 OK\r\n"));
+    const body = resp[(std.mem.indexOf(u8, resp, "\r\n\r\n") orelse return error.NoBody) + 4 ..];
+    const parsed = try std.json.parseFromSlice(std.json.Value, t.allocator, body, .{});
+    defer parsed.deinit();
+    const entries = parsed.value.array.items;
+    try t.expectEqual(@as(usize, 2), entries.len);
+    try t.expectEqual(@as(usize, 3), entries[0].object.get("result").?.array.items.len);
+    try t.expectEqual(@as(i64, -32601), entries[1].object.get("error").?.object.get("code").?.integer);
+    try t.expectEqual(@as(u32, 1), srv.nreq.load(.monotonic));
+}
+
+test "faults" {
+    const t = std.testing;
+
+    const srv = try start(t.allocator, .lnd);
+    defer srv.stop();
+    srv.knobs.fail_every.store(2, .monotonic);
+    srv.knobs.fault.store(.drop, .monotonic);
+
+    const stream = try std.net.tcpConnectToAddress(srv.listener.listen_address);
+    defer stream.close();
+    var br = std.io.bufferedReader(stream.reader());
+    var buf: [4096]u8 = undefined;
+    // first request succeeds and keeps the connection open.
+    try stream.writeAll("GET /v1/state HTTP/1.1\r\n\r\n");
+    const status = try br.reader().readUntilDelimiter(&buf, '\n');
+    try t.expectEqualStrings("HTTP/1.1 200 OK\r", status);
+    while ((try br.reader().readUntilDelimiter(&buf, '\n')).len > 1) {}
+    _ = try br.reader().readUntilDelimiter(&buf, '}');
+    // the second one is dropped.
+    try stream.writeAll("GET /v1/state HTTP/1.1\r\n\r\n");
+    try t.expectEqual(@as(usize, 0), try br.reader().read(&buf));
+    try t.expectEqual(@as(u32, 2), srv.nreq.load(.monotonic));
+}
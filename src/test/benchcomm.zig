@@ -0,0 +1,128 @@
+//! comm protocol benchmark: writes and reads synthetic messages of increasing
+//! size with each payload encoding, and prints time, allocations and bytes
+//! on the wire per message. meant to accompany protocol changes with numbers,
+//! typically run with `zig build bench-comm -Doptimize=ReleaseFast`.
+
+const std = @import("std");
+const time = std.time;
+
+const comm = @import("comm");
+const CountingAllocator = @import("CountingAllocator.zig");
+const reports = @import("reports.zig");
+
+const Case = struct {
+    name: []const u8,
+    kind: enum { onchain, network, lightning, lightning_delta },
+    size: u32 = 0, // wifi networks or lightning channels count
+};
+
+const cases = [_]Case{
+    .{ .name = "onchain", .kind = .onchain },
+    .{ .name = "network-32", .kind = .network, .size = 32 },
+    .{ .name = "lightning-10", .kind = .lightning, .size = 10 },
+    .{ .name = "lightning-100", .kind = .lightning, .size = 100 },
+    .{ .name = "lightning-1000", .kind = .lightning, .size = 1000 },
+    .{ .name = "ln-delta-10", .kind = .lightning_delta, .size = 10 },
+    .{ .name = "ln-delta-100", .kind = .lightning_delta, .size = 100 },
+};
+
+/// per message op figures.
+const Result = struct {
+    ns: u64,
+    allocs: usize,
+    bytes: usize, // allocated
+};
+
+fn message(arena: std.mem.Allocator, c: Case) !comm.Message {
+    return switch (c.kind) {
+        .onchain => .{ .onchain_report = reports.onchain(0) },
+        .network => .{ .network_report = try reports.network(arena, c.size) },
+        .lightning => .{ .lightning_report = try reports.lightning(arena, c.size, 0) },
+        .lightning_delta => blk: {
+            const rep = try reports.lightning(arena, c.size, 1);
+            break :blk .{ .lightning_report_delta = .{ .upsert = rep.channels } };
+        },
+    };
+}
+
+/// number of iterations so that large messages don't take forever.
+fn iterations(c: Case, scale: u32) u32 {
+    return scale * @max(10, 10000 / (c.size + 1));
+}
+
+fn benchWrite(ca: *CountingAllocator, out: *std.ArrayList(u8), msg: comm.Message, enc: comm.Encoding, n: u32) !Result {
+    try comm.writeEncoded(ca.allocator(), out.writer(), msg, enc); // warm up
+    ca.reset();
+    var timer = try time.Timer.start();
+    for (0..n) |_| {
+        out.clearRetainingCapacity();
+        try comm.writeEncoded(ca.allocator(), out.writer(), msg, enc);
+    }
+    return .{ .ns = timer.read() / n, .allocs = ca.count / n, .bytes = ca.bytes / n };
+}
+
+fn benchRead(ca: *CountingAllocator, data: []const u8, n: u32) !Result {
+    ca.reset();
+    var timer = try time.Timer.start();
+    for (0..n) |_| {
+        var fbs = std.io.fixedBufferStream(data);
+        const res = try comm.read(ca.allocator(), fbs.reader());
+        res.deinit();
+    }
+    return .{ .ns = timer.read() / n, .allocs = ca.count / n, .bytes = ca.bytes / n };
+}
+
+pub fn main() !void {
+    var gpa_state = std.heap.GeneralPurposeAllocator(.{}){};
+    defer if (gpa_state.deinit() == .leak) {
+        std.debug.print("memory leaks detected!", .{});
+    };
+    const gpa = gpa_state.allocator();
+
+    var scale: u32 = 1;
+    var args = try std.process.ArgIterator.initWithAllocator(gpa);
+    defer args.deinit();
+    _ = args.next(); // prog name
+    while (args.next()) |a| {
+        if (std.mem.eql(u8, a, "-scale")) {
+            const v = args.next() orelse return error.MissingScaleValue;
+            scale = try std.fmt.parseUnsigned(u32, v, 10);
+        } else {
+            std.debug.print("usage: benchcomm [-scale N]; N multiplies iterations\n", .{});
+            std.process.exit(1);
+        }
+    }
+
+    // gpa safety checks are off in release modes and don't skew the numbers.
+    var ca = CountingAllocator{ .child = gpa };
+    var out = std.ArrayList(u8).init(gpa);
+    defer out.deinit();
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    defer arena_state.deinit();
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("per message; alloc'ed bytes in parens\n", .{});
+    try stdout.print("{s: <16}{s: >8}{s: >10}{s: >12}{s: >18}{s: >12}{s: >18}\n", .{
+        "message", "enc", "wire", "write ns", "write allocs", "read ns", "read allocs",
+    });
+    for (cases) |c| {
+        _ = arena_state.reset(.retain_capacity);
+        const msg = try message(arena_state.allocator(), c);
+        const n = iterations(c, scale);
+        for ([_]comm.Encoding{ .json, .binary }) |enc| {
+            const w = try benchWrite(&ca, &out, msg, enc, n);
+            const r = try benchRead(&ca, out.items, n);
+            var wbuf: [32]u8 = undefined;
+            var rbuf: [32]u8 = undefined;
+            try stdout.print("{s: <16}{s: >8}{d: >10}{d: >12}{s: >18}{d: >12}{s: >18}\n", .{
+                c.name,
+                @tagName(enc),
+                out.items.len,
+                w.ns,
+                try std.fmt.bufPrint(&wbuf, "{d} ({d})", .{ w.allocs, w.bytes }),
+                r.ns,
+                try std.fmt.bufPrint(&rbuf, "{d} ({d})", .{ r.allocs, r.bytes }),
+            });
+        }
+    }
+}
@@ -0,0 +1,250 @@
+//! bitcoind and lnd clients benchmark against in-process mock servers with
+//! injected latency, payload size and failures; see MockRpcServer.zig.
+//! prints the latency of the calls the daemon onchain and lightning report
+//! cycles are made of, and the number of connections the clients opened,
+//! to compare connection reuse and calls fan-out under slow RPC.
+//!
+//! then decodes recorded responses of the report calls, see rpcdata/,
+//! straight from memory with each client's parser, and prints time,
+//! allocations and peak memory per response: the cost of a call minus
+//! the network, to accompany parser changes with numbers.
+
+const std = @import("std");
+const time = std.time;
+
+const bitcoindrpc = @import("bitcoindrpc");
+const lndhttp = @import("lightning").lndhttp;
+const CountingAllocator = @import("CountingAllocator.zig");
+const MockRpcServer = @import("MockRpcServer.zig");
+
+const Scenario = struct {
+    name: []const u8,
+    kind: MockRpcServer.Kind,
+    latency_ms: u32 = 0,
+    size: u32 = 10, // bitcoind peers or lnd channels
+    keepalive: bool = true, // bitcoind only; lnd client always reuses connections
+    fail_every: u32 = 0,
+    fault: MockRpcServer.Fault = .drop,
+};
+
+const scenarios = [_]Scenario{
+    .{ .name = "btc-keepalive", .kind = .bitcoind },
+    .{ .name = "btc-close", .kind = .bitcoind, .keepalive = false },
+    .{ .name = "btc-50ms-keepalive", .kind = .bitcoind, .latency_ms = 50 },
+    .{ .name = "btc-50ms-close", .kind = .bitcoind, .latency_ms = 50, .keepalive = false },
+    .{ .name = "btc-peers-1000", .kind = .bitcoind, .size = 1000 },
+    .{ .name = "btc-drop-1/5", .kind = .bitcoind, .fail_every = 5 },
+    .{ .name = "lnd-chan-10", .kind = .lnd },
+    .{ .name = "lnd-chan-1000", .kind = .lnd, .size = 1000 },
+    .{ .name = "lnd-50ms-chan-100", .kind = .lnd, .latency_ms = 50, .size = 100 },
+    .{ .name = "lnd-500-1/5", .kind = .lnd, .fail_every = 5, .fault = .http_500 },
+};
+
+/// same as the daemon onchain report batch.
+const onchain_batch = [_]bitcoindrpc.Client.Method{ .getblockchaininfo, .getmempoolinfo, .getpeerinfo };
+/// same as the daemon lightning report calls.
+const lnd_group = [_]lndhttp.Client.ApiMethod{ .getinfo, .feereport, .listchannels, .pendingchannels };
+
+const Stats = struct {
+    durations: std.ArrayList(u64), // ns
+    errors: u32 = 0, // failed report cycles
+    conns: u32 = 0, // connections accepted by the server
+
+    fn deinit(self: Stats) void {
+        self.durations.deinit();
+    }
+
+    /// in microseconds.
+    fn percentile(self: Stats, p: usize) u64 {
+        const d = self.durations.items;
+        if (d.len == 0) {
+            return 0;
+        }
+        return d[@min(d.len - 1, d.len * p / 100)] / time.ns_per_us;
+    }
+};
+
+fn run(gpa: std.mem.Allocator, sc: Scenario, n: u32, cookiepath: []const u8) !Stats {
+    const srv = try MockRpcServer.start(gpa, sc.kind);
+    defer srv.stop();
+    srv.knobs.latency_ms.store(sc.latency_ms, .monotonic);
+    srv.knobs.size.store(sc.size, .monotonic);
+    srv.knobs.fail_every.store(sc.fail_every, .monotonic);
+    srv.knobs.fault.store(sc.fault, .monotonic);
+
+    var stats = Stats{ .durations = std.ArrayList(u64).init(gpa) };
+    errdefer stats.deinit();
+    switch (sc.kind) {
+        .bitcoind => {
+            var client = bitcoindrpc.Client{
+                .allocator = gpa,
+                .cookiepath = cookiepath,
+                .port = srv.port(),
+                .keepalive = sc.keepalive,
+            };
+            defer client.deinit();
+            for (0..n) |_| {
+                var timer = try time.Timer.start();
+                if (client.callBatch(&onchain_batch, .{ {}, {}, {} })) |res| res.deinit() else |_| stats.errors += 1;
+                try stats.durations.append(timer.read());
+            }
+        },
+        .lnd => {
+            var client = try lndhttp.Client.init(.{
+                .allocator = gpa,
+                .hostname = "127.0.0.1",
+                .port = srv.port(),
+                .tlscert_path = "",
+                .plain_http = true,
+            });
+            defer client.deinit();
+            client.macaroon.readonly = try gpa.dupe(u8, "0201"); // not checked by the mock
+            for (0..n) |_| {
+                var timer = try time.Timer.start();
+                const group = client.callGroup(&lnd_group, .{ {}, {}, .{ .peer_alias_lookup = false }, {} });
+                const elapsed = timer.read();
+                var failed = false;
+                inline for (group) |r| {
+                    if (r) |_| {} else |_| failed = true;
+                }
+                lndhttp.Client.deinitGroup(group);
+                if (failed) stats.errors += 1;
+                try stats.durations.append(elapsed);
+            }
+        },
+    }
+    std.mem.sort(u64, stats.durations.items, {}, std.sort.asc(u64));
+    stats.conns = srv.nconn.load(.monotonic);
+    return stats;
+}
+
+const DecodeCase = struct {
+    name: []const u8,
+    method: enum { getblockchaininfo, getmempoolinfo, listchannels, pendingchannels },
+    size: u32 = 1, // lnd channels in listchannels
+};
+
+const decode_cases = [_]DecodeCase{
+    .{ .name = "getblockchaininfo", .method = .getblockchaininfo },
+    .{ .name = "getmempoolinfo", .method = .getmempoolinfo },
+    .{ .name = "listchannels-10", .method = .listchannels, .size = 10 },
+    .{ .name = "listchannels-100", .method = .listchannels, .size = 100 },
+    .{ .name = "listchannels-1000", .method = .listchannels, .size = 1000 },
+    .{ .name = "pendingchannels", .method = .pendingchannels },
+};
+
+/// per response figures.
+const DecodeResult = struct {
+    ns: u64,
+    allocs: usize,
+    bytes: usize, // allocated
+    peak: usize, // max bytes live while decoding
+};
+
+/// a listchannels response of n copies of the recorded channel.
+fn listchannelsBody(gpa: std.mem.Allocator, n: u32) ![]u8 {
+    const entry = std.mem.trimRight(u8, @embedFile("rpcdata/listchannels_entry.json"), "\n");
+    var buf = std.ArrayList(u8).init(gpa);
+    errdefer buf.deinit();
+    try buf.appendSlice("{\"channels\":[");
+    for (0..n) |i| {
+        if (i > 0) try buf.append(',');
+        try buf.appendSlice(entry);
+    }
+    try buf.appendSlice("]}");
+    return buf.toOwnedSlice();
+}
+
+fn decode(ca: *CountingAllocator, c: DecodeCase, body: []const u8, n: u32) !DecodeResult {
+    // clients allocate results with the counting allocator; see parseResponse.
+    var btc = bitcoindrpc.Client{ .allocator = ca.allocator(), .cookiepath = "" };
+    defer btc.deinit();
+    var lnd = try lndhttp.Client.init(.{
+        .allocator = ca.allocator(),
+        .hostname = "127.0.0.1",
+        .port = 10010,
+        .tlscert_path = "",
+        .plain_http = true,
+    });
+    defer lnd.deinit();
+
+    var timer: time.Timer = undefined;
+    for (0..n + 1) |i| {
+        if (i == 1) { // the first round is a warm-up
+            ca.reset();
+            timer = try time.Timer.start();
+        }
+        switch (c.method) {
+            .getblockchaininfo => (try btc.parseResponse(.getblockchaininfo, body)).deinit(),
+            .getmempoolinfo => (try btc.parseResponse(.getmempoolinfo, body)).deinit(),
+            .listchannels => (try lnd.parseResponse(.listchannels, body)).deinit(),
+            .pendingchannels => (try lnd.parseResponse(.pendingchannels, body)).deinit(),
+        }
+    }
+    return .{ .ns = timer.read() / n, .allocs = ca.count / n, .bytes = ca.bytes / n, .peak = ca.peak -| ca.live };
+}
+
+pub fn main() !void {
+    var gpa_state = std.heap.GeneralPurposeAllocator(.{}){};
+    defer if (gpa_state.deinit() == .leak) {
+        std.debug.print("memory leaks detected!", .{});
+    };
+    const gpa = gpa_state.allocator();
+
+    var n: u32 = 50;
+    var args = try std.process.ArgIterator.initWithAllocator(gpa);
+    defer args.deinit();
+    _ = args.next(); // prog name
+    while (args.next()) |a| {
+        if (std.mem.eql(u8, a, "-n")) {
+            const v = args.next() orelse return error.MissingNValue;
+            n = try std.fmt.parseUnsigned(u32, v, 10);
+        } else {
+            std.debug.print("usage: benchrpc [-n N]; N report cycles per scenario\n", .{});
+            std.process.exit(1);
+        }
+    }
+
+    // the mock ignores auth but the bitcoind client requires a cookie file.
+    const cookiepath = "/tmp/benchrpc.cookie";
+    try std.fs.cwd().writeFile(cookiepath, "__cookie__:bench");
+    defer std.fs.cwd().deleteFile(cookiepath) catch {};
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("{d} report cycles per scenario; durations in us\n", .{n});
+    try stdout.print("{s: <20}{s: >10}{s: >10}{s: >10}{s: >8}{s: >8}\n", .{
+        "scenario", "p50", "p99", "max", "errors", "conns",
+    });
+    for (scenarios) |sc| {
+        const stats = try run(gpa, sc, n, cookiepath);
+        defer stats.deinit();
+        try stdout.print("{s: <20}{d: >10}{d: >10}{d: >10}{d: >8}{d: >8}\n", .{
+            sc.name,
+            stats.percentile(50),
+            stats.percentile(99),
+            stats.percentile(100),
+            stats.errors,
+            stats.conns,
+        });
+    }
+
+    // gpa safety checks are off in release modes and don't skew the numbers.
+    var ca = CountingAllocator{ .child = gpa };
+    try stdout.print("\nrecorded responses decoding; per response\n", .{});
+    try stdout.print("{s: <20}{s: >10}{s: >12}{s: >10}{s: >12}{s: >12}\n", .{
+        "response", "body", "ns", "allocs", "bytes", "peak",
+    });
+    for (decode_cases) |c| {
+        const body = switch (c.method) {
+            .getblockchaininfo => try gpa.dupe(u8, @embedFile("rpcdata/getblockchaininfo.json")),
+            .getmempoolinfo => try gpa.dupe(u8, @embedFile("rpcdata/getmempoolinfo.json")),
+            .listchannels => try listchannelsBody(gpa, c.size),
+            .pendingchannels => try gpa.dupe(u8, @embedFile("rpcdata/pendingchannels.json")),
+        };
+        defer gpa.free(body);
+        const r = try decode(&ca, c, body, @max(10, n * 200 / c.size));
+        try stdout.print("{s: <20}{d: >10}{d: >12}{d: >10}{d: >12}{d: >12}\n", .{
+            c.name, body.len, r.ns, r.allocs, r.bytes, r.peak,
+        });
+    }
+}
@@ -0,0 +1,184 @@
+//! ngui render benchmark: replays onchain and lightning reports of increasing
+//! size into ngui and prints per-update UI loop stats collected by ngui itself,
+//! see ui/perf.zig. each scenario runs in a fresh ngui process so that LVGL heap
+//! peak and objects count are not skewed by the previous ones.
+//!
+//! ngui is meant to be built with -Ddriver=headless for the benchmark to run
+//! offscreen, for example with `zig build bench-ui -Ddriver=headless`.
+
+const std = @import("std");
+const time = std.time;
+
+const comm = @import("comm");
+const reports = @import("reports.zig");
+
+const stderr = std.io.getStdErr().writer();
+
+fn fatal(comptime fmt: []const u8, args: anytype) noreturn {
+    stderr.print(fmt, args) catch {};
+    if (fmt[fmt.len - 1] != '\n') {
+        stderr.writeByte('\n') catch {};
+    }
+    std.process.exit(1);
+}
+
+const Flags = struct {
+    ngui_path: ?[:0]const u8 = null,
+    updates: u32 = 20, // reports sent per scenario
+    verbose: bool = false, // ngui logs to stderr
+
+    fn deinit(self: @This(), allocator: std.mem.Allocator) void {
+        if (self.ngui_path) |p| allocator.free(p);
+    }
+};
+
+fn parseArgs(gpa: std.mem.Allocator) !Flags {
+    var flags: Flags = .{};
+
+    var args = try std.process.ArgIterator.initWithAllocator(gpa);
+    defer args.deinit();
+    const prog = args.next() orelse return error.NoProgName;
+
+    var lastarg: enum {
+        none,
+        ngui_path,
+        updates,
+    } = .none;
+    while (args.next()) |a| {
+        switch (lastarg) {
+            .none => {},
+            .ngui_path => {
+                flags.ngui_path = try gpa.dupeZ(u8, a);
+                lastarg = .none;
+                continue;
+            },
+            .updates => {
+                flags.updates = std.fmt.parseUnsigned(u32, a, 10) catch fatal("invalid -updates value {s}", .{a});
+                lastarg = .none;
+                continue;
+            },
+        }
+        if (std.mem.eql(u8, a, "-ngui")) {
+            lastarg = .ngui_path;
+        } else if (std.mem.eql(u8, a, "-updates")) {
+            lastarg = .updates;
+        } else if (std.mem.eql(u8, a, "-v")) {
+            flags.verbose = true;
+        } else {
+            fatal("unknown arg name {s}", .{a});
+        }
+    }
+    if (lastarg != .none) {
+        fatal("invalid arg: {s} requires a value", .{@tagName(lastarg)});
+    }
+
+    if (flags.ngui_path == null) {
+        const dir = std.fs.path.dirname(prog) orelse "/";
+        flags.ngui_path = try std.fs.path.joinZ(gpa, &.{ dir, "ngui" });
+    }
+
+    return flags;
+}
+
+const Scenario = struct {
+    name: []const u8,
+    tab: []const u8, // ngui -tab arg
+    kind: enum { onchain, lightning },
+    channels: u32 = 0, // lightning report size
+};
+
+const scenarios = [_]Scenario{
+    .{ .name = "onchain", .tab = "bitcoin", .kind = .onchain },
+    .{ .name = "lightning-10", .tab = "lightning", .kind = .lightning, .channels = 10 },
+    .{ .name = "lightning-100", .tab = "lightning", .kind = .lightning, .channels = 100 },
+    .{ .name = "lightning-1000", .tab = "lightning", .kind = .lightning, .channels = 1000 },
+};
+
+/// delay between reports, long enough for ngui to render each one:
+/// it keeps only the last report of each type not yet rendered.
+const update_interval_ms = 100;
+/// time for ngui to finish rendering at start and after the last report.
+const settle_ms = 500;
+
+/// runs a scenario in a new ngui process and returns its perf report.
+fn run(gpa: std.mem.Allocator, flags: Flags, sc: Scenario) !comm.ParsedMessage {
+    var proc = std.ChildProcess.init(&.{ flags.ngui_path.?, "-tab", sc.tab }, gpa);
+    proc.stdin_behavior = .Pipe;
+    proc.stdout_behavior = .Pipe;
+    proc.stderr_behavior = if (flags.verbose) .Inherit else .Ignore;
+    try proc.spawn();
+    defer if (proc.kill()) |_| {} else |err| std.debug.print("{s}: ngui kill: {!}\n", .{ sc.name, err });
+
+    var w = comm.Writer.init(gpa, proc.stdin.?);
+    defer w.deinit();
+    const r = proc.stdout.?.reader();
+
+    // ngui announces its features before building the UI; then, a first
+    // perf report marks the start, excluding UI init from the results.
+    const feat = try waitFor(gpa, r, .comm_features);
+    const enc: comm.Encoding = if (feat.value.comm_features.binary) .binary else .json;
+    feat.deinit();
+    time.sleep(settle_ms * time.ns_per_ms);
+    try w.write(.get_ui_perf_report, .json);
+    (try waitFor(gpa, r, .ui_perf_report)).deinit();
+
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    defer arena_state.deinit();
+    for (0..flags.updates) |i| {
+        _ = arena_state.reset(.retain_capacity);
+        const msg: comm.Message = switch (sc.kind) {
+            .onchain => .{ .onchain_report = reports.onchain(@intCast(i)) },
+            .lightning => .{ .lightning_report = try reports.lightning(arena_state.allocator(), sc.channels, @intCast(i)) },
+        };
+        try w.write(msg, enc);
+        time.sleep(update_interval_ms * time.ns_per_ms);
+    }
+    time.sleep(settle_ms * time.ns_per_ms);
+    try w.write(.get_ui_perf_report, .json);
+    return waitFor(gpa, r, .ui_perf_report);
+}
+
+/// reads messages until one of the tag arrives, discarding all others.
+fn waitFor(gpa: std.mem.Allocator, r: anytype, tag: comm.MessageTag) !comm.ParsedMessage {
+    while (true) {
+        const msg = try comm.read(gpa, r);
+        if (@as(comm.MessageTag, msg.value) == tag) {
+            return msg;
+        }
+        msg.deinit();
+    }
+}
+
+pub fn main() !void {
+    var gpa_state = std.heap.GeneralPurposeAllocator(.{}){};
+    defer if (gpa_state.deinit() == .leak) {
+        std.debug.print("memory leaks detected!", .{});
+    };
+    const gpa = gpa_state.allocator();
+    const flags = try parseArgs(gpa);
+    defer flags.deinit(gpa);
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("{d} updates per scenario; durations in us\n", .{flags.updates});
+    try stdout.print("{s: <16}{s: >8}{s: >22}{s: >18}{s: >12}{s: >10}{s: >10}{s: >12}\n", .{
+        "scenario", "frames", "render p50/p99/max", "apply p50/max", "lvgl peak", "objects", "styles", "label bytes",
+    });
+    for (scenarios) |sc| {
+        const res = run(gpa, flags, sc) catch |err| fatal("{s}: {!}", .{ sc.name, err });
+        defer res.deinit();
+        const rep = res.value.ui_perf_report;
+        var render: [32]u8 = undefined;
+        var apply: [32]u8 = undefined;
+        const census = rep.census orelse fatal("{s}: no census in ui_perf_report", .{sc.name});
+        try stdout.print("{s: <16}{d: >8}{s: >22}{s: >18}{d: >12}{d: >10}{d: >10}{d: >12}\n", .{
+            sc.name,
+            rep.render.count,
+            try std.fmt.bufPrint(&render, "{d}/{d}/{d}", .{ rep.render.percentile(50), rep.render.percentile(99), rep.render.max }),
+            try std.fmt.bufPrint(&apply, "{d}/{d}", .{ rep.queue.percentile(50), rep.queue.max }),
+            rep.mem_peak,
+            rep.objects,
+            census.styles,
+            census.label_bytes,
+        });
+    }
+}
@@ -12,7 +12,9 @@ pub fn main() !void {
     var client = bitcoinrpc.Client{
         .allocator = gpa,
         .cookiepath = "/ssd/bitcoind/mainnet/.cookie",
+        .keepalive = true,
     };
+    defer client.deinit();
 
     const res = try client.call(.getmempoolinfo, {});
     defer res.deinit();
@@ -0,0 +1,252 @@
+//! comm protocol fuzzer: reads a corpus of valid frames and randomly mutated
+//! copies with comm.read, and prints parse throughput and peak memory per
+//! mutation kind. corrupt input must result in errors, never in a crash,
+//! a leak or allocations beyond alloc_limit; the latter exit with failure.
+//! safety checks catch more with `zig build fuzz-comm -Doptimize=ReleaseSafe`.
+
+const std = @import("std");
+const time = std.time;
+
+const comm = @import("comm");
+const reports = @import("reports.zig");
+
+/// live heap bytes a single read may hold at most. the payload length caps
+/// of comm.maxPayload, and decoding bounded by the actual input, keep reads
+/// of the corpus far below this.
+const alloc_limit = 4 * comm.default_max_payload;
+
+/// an allocator wrapper tracking live and peak bytes, and failing allocations
+/// above a limit; not safe for concurrent use.
+const LimitAllocator = struct {
+    child: std.mem.Allocator,
+    limit: usize,
+    live: usize = 0,
+    peak: usize = 0,
+    refused: usize = 0, // allocations failed due to the limit
+
+    fn allocator(self: *LimitAllocator) std.mem.Allocator {
+        return .{ .ptr = self, .vtable = &.{ .alloc = alloc, .resize = resize, .free = free } };
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, ptr_align: u8, ret_addr: usize) ?[*]u8 {
+        const self: *LimitAllocator = @ptrCast(@alignCast(ctx));
+        if (len > self.limit - self.live) {
+            self.refused += 1;
+            return null;
+        }
+        const p = self.child.rawAlloc(len, ptr_align, ret_addr) orelse return null;
+        self.live += len;
+        self.peak = @max(self.peak, self.live);
+        return p;
+    }
+
+    fn resize(ctx: *anyopaque, buf: []u8, buf_align: u8, new_len: usize, ret_addr: usize) bool {
+        const self: *LimitAllocator = @ptrCast(@alignCast(ctx));
+        if (new_len > buf.len and new_len - buf.len > self.limit - self.live) {
+            self.refused += 1;
+            return false;
+        }
+        if (!self.child.rawResize(buf, buf_align, new_len, ret_addr)) {
+            return false;
+        }
+        self.live = self.live - buf.len + new_len;
+        self.peak = @max(self.peak, self.live);
+        return true;
+    }
+
+    fn free(ctx: *anyopaque, buf: []u8, buf_align: u8, ret_addr: usize) void {
+        const self: *LimitAllocator = @ptrCast(@alignCast(ctx));
+        self.child.rawFree(buf, buf_align, ret_addr);
+        self.live -= buf.len;
+    }
+};
+
+const Mutation = enum {
+    none, // valid frames as is
+    bitflip, // a few random bits flipped anywhere
+    truncate, // cut short at a random position
+    length, // the payload length field overwritten
+    tag, // the wire tag overwritten
+    garbage, // a run of random bytes overwritten
+    splice, // random bytes inserted into the payload
+};
+
+/// read outcomes of a mutation kind.
+const Stats = struct {
+    cases: usize = 0,
+    bytes: usize = 0, // input fed to read
+    ns: u64 = 0, // in read calls
+    ok: usize = 0, // messages parsed
+    too_large: usize = 0,
+    eof: usize = 0, // truncated frames
+    other: usize = 0, // all other errors
+    peak: usize = 0, // max live bytes of a single read
+
+    fn mbps(self: Stats) f64 {
+        if (self.ns == 0) {
+            return 0;
+        }
+        const sec = @as(f64, @floatFromInt(self.ns)) / time.ns_per_s;
+        return @as(f64, @floatFromInt(self.bytes)) / sec / (1 << 20);
+    }
+};
+
+/// encodes the corpus messages in each encoding, one frame per item.
+fn corpus(gpa: std.mem.Allocator, arena: std.mem.Allocator) !std.ArrayList([]const u8) {
+    const lnrep = try reports.lightning(arena, 100, 0);
+    const delta = try reports.lightning(arena, 10, 1);
+    const msgs = [_]comm.Message{
+        .ping,
+        .standby,
+        .{ .wifi_connect = .{ .ssid = "wifi-network-0", .password = "secret" } },
+        .{ .network_report = try reports.network(arena, 32) },
+        .{ .onchain_report = reports.onchain(0) },
+        .{ .lightning_report = lnrep },
+        .{ .lightning_report_delta = .{ .upsert = delta.channels } },
+    };
+    var frames = std.ArrayList([]const u8).init(gpa);
+    errdefer frames.deinit();
+    for (msgs) |msg| {
+        for ([_]comm.Encoding{ .json, .binary }) |enc| {
+            var buf = std.ArrayList(u8).init(arena);
+            try comm.writeEncoded(arena, buf.writer(), msg, enc);
+            try frames.append(buf.items);
+        }
+    }
+    return frames;
+}
+
+/// writes a mutated copy of frame into out.
+fn mutate(rnd: std.rand.Random, m: Mutation, frame: []const u8, out: *std.ArrayList(u8)) !void {
+    out.clearRetainingCapacity();
+    try out.appendSlice(frame);
+    const head = 2 + 8; // wire tag and payload length
+    switch (m) {
+        .none => {},
+        .bitflip => for (0..rnd.intRangeAtMost(usize, 1, 8)) |_| {
+            const i = rnd.uintLessThan(usize, out.items.len);
+            out.items[i] ^= @as(u8, 1) << rnd.int(u3);
+        },
+        .truncate => out.shrinkRetainingCapacity(rnd.uintLessThan(usize, out.items.len)),
+        .length => {
+            const plen = out.items.len - head;
+            const lens = [_]u64{
+                0,
+                plen + 1,
+                plen -| 1,
+                comm.small_max_payload + 1,
+                comm.default_max_payload,
+                std.math.maxInt(u64),
+                rnd.int(u64),
+                rnd.int(u32),
+            };
+            std.mem.writeInt(u64, out.items[2..head], lens[rnd.uintLessThan(usize, lens.len)], .little);
+        },
+        .tag => std.mem.writeInt(u16, out.items[0..2], rnd.int(u16), .little),
+        .garbage => {
+            const i = rnd.uintLessThan(usize, out.items.len);
+            const n = @min(out.items.len - i, rnd.intRangeAtMost(usize, 1, 64));
+            rnd.bytes(out.items[i..][0..n]);
+        },
+        .splice => {
+            var junk: [32]u8 = undefined;
+            const n = rnd.intRangeAtMost(usize, 1, junk.len);
+            rnd.bytes(junk[0..n]);
+            try out.insertSlice(rnd.intRangeAtMost(usize, head, out.items.len), junk[0..n]);
+        },
+    }
+}
+
+/// reads all messages from data until an error or its end, updating stats.
+fn readAll(la: *LimitAllocator, data: []const u8, stats: *Stats) !void {
+    la.peak = la.live;
+    var fbs = std.io.fixedBufferStream(data);
+    var timer = try time.Timer.start();
+    while (fbs.pos < data.len) {
+        if (comm.read(la.allocator(), fbs.reader())) |res| {
+            res.deinit();
+            stats.ok += 1;
+        } else |err| {
+            switch (err) {
+                comm.Error.CommReadTooLarge => stats.too_large += 1,
+                error.EndOfStream => stats.eof += 1,
+                else => stats.other += 1,
+            }
+            break;
+        }
+    }
+    stats.ns += timer.read();
+    stats.cases += 1;
+    stats.bytes += data.len;
+    stats.peak = @max(stats.peak, la.peak);
+}
+
+pub fn main() !void {
+    var gpa_state = std.heap.GeneralPurposeAllocator(.{}){};
+    defer if (gpa_state.deinit() == .leak) {
+        std.debug.print("memory leaks detected!", .{});
+        std.process.exit(1);
+    };
+    const gpa = gpa_state.allocator();
+
+    var iterations: u32 = 10000;
+    var seed: u64 = @bitCast(time.milliTimestamp());
+    var args = try std.process.ArgIterator.initWithAllocator(gpa);
+    defer args.deinit();
+    _ = args.next(); // prog name
+    while (args.next()) |a| {
+        if (std.mem.eql(u8, a, "-iterations")) {
+            const v = args.next() orelse return error.MissingIterationsValue;
+            iterations = try std.fmt.parseUnsigned(u32, v, 10);
+        } else if (std.mem.eql(u8, a, "-seed")) {
+            const v = args.next() orelse return error.MissingSeedValue;
+            seed = try std.fmt.parseUnsigned(u64, v, 10);
+        } else {
+            std.debug.print("usage: fuzzcomm [-iterations N] [-seed S]; N mutated frames per kind\n", .{});
+            std.process.exit(1);
+        }
+    }
+
+    var arena_state = std.heap.ArenaAllocator.init(gpa);
+    defer arena_state.deinit();
+    const frames = try corpus(gpa, arena_state.allocator());
+    defer frames.deinit();
+    var prng = std.rand.DefaultPrng.init(seed);
+    const rnd = prng.random();
+    var la = LimitAllocator{ .child = gpa, .limit = alloc_limit };
+    var input = std.ArrayList(u8).init(gpa);
+    defer input.deinit();
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("seed {d}, {d} corpus frames; peak alloc'ed bytes per read\n", .{ seed, frames.items.len });
+    try stdout.print("{s: <10}{s: >10}{s: >10}{s: >10}{s: >10}{s: >10}{s: >10}{s: >10}\n", .{
+        "mutation", "cases", "ok", "toolarge", "eof", "other", "MB/s", "peak",
+    });
+    for (std.enums.values(Mutation)) |m| {
+        var stats = Stats{};
+        const n = if (m == .none) @max(1, iterations / 100) else iterations;
+        for (0..n) |_| {
+            const frame = frames.items[rnd.uintLessThan(usize, frames.items.len)];
+            try mutate(rnd, m, frame, &input);
+            try readAll(&la, input.items, &stats);
+        }
+        try stdout.print("{s: <10}{d: >10}{d: >10}{d: >10}{d: >10}{d: >10}{d: >10.1}{d: >10}\n", .{
+            @tagName(m),
+            stats.cases,
+            stats.ok,
+            stats.too_large,
+            stats.eof,
+            stats.other,
+            stats.mbps(),
+            stats.peak,
+        });
+        if (m == .none and stats.ok != stats.cases) {
+            std.debug.print("valid frames failed to parse\n", .{});
+            std.process.exit(1);
+        }
+    }
+    if (la.refused > 0) {
+        std.debug.print("{d} reads exceeded the {d} bytes alloc limit\n", .{ la.refused, alloc_limit });
+        std.process.exit(1);
+    }
+}
@@ -0,0 +1,99 @@
+//! synthetic nd reports of parameterized size for benchmarks.
+
+const std = @import("std");
+const comm = @import("comm");
+
+const block_hash = comm.Hash.literal("00000000000000000002bf8029f6be4e40b4a3e0e161b6a1044ddaf9eb126504");
+
+/// returns an id of type T starting with the prefix byte, if non-zero, and ending
+/// with v in big endian, like the hex string of v padded with zeros.
+fn idOf(comptime T: type, prefix: u8, v: u64) T {
+    var id = T{ .bytes = .{0} ** (T.hex_len / 2) };
+    id.bytes[0] = prefix;
+    std.mem.writeInt(u64, id.bytes[id.bytes.len - 8 ..][0..8], v, .big);
+    return id;
+}
+
+/// an onchain report varying with n, for example a block height offset.
+pub fn onchain(n: u32) comm.Message.OnchainReport {
+    return .{
+        .blocks = 800000 + n,
+        .headers = 800000 + n,
+        .timestamp = 1700000000 + @as(u64, n) * 600,
+        .hash = block_hash,
+        .ibd = false,
+        .verifyprogress = 100,
+        .diskusage = 567119364054 + @as(u64, n) * 1500000,
+        .version = "/Satoshi:26.0.0/",
+        .conn_in = @intCast(8 + n % 4),
+        .conn_out = 10,
+        .warnings = "",
+        .localaddr = &.{},
+        .mempool = .{
+            .loaded = true,
+            .txcount = 100000 + n * 17,
+            .usage = 200123456 + @as(u64, n) * 1000,
+            .max = 300000000,
+            .totalfee = 2.23049932,
+            .minfee = 0.00004155,
+            .fullrbf = false,
+        },
+        .balance = .{
+            .source = .lnd,
+            .total = 800000 + n,
+            .confirmed = 350000 + n,
+            .unconfirmed = 350000,
+            .locked = 0,
+            .reserved = 100000,
+        },
+    };
+}
+
+/// a report with nchan channels, changing balances of a few of them with n.
+/// all memory is allocated in arena.
+pub fn lightning(arena: std.mem.Allocator, nchan: u32, n: u32) !comm.Message.LightningReport {
+    const states = [_]std.meta.FieldType(comm.Message.LightningChannel, .state){ .active, .active, .active, .inactive, .pending_open };
+    const channels = try arena.alloc(comm.Message.LightningChannel, nchan);
+    for (channels, 0..) |*ch, i| {
+        const state = states[i % states.len];
+        const shift: i64 = if (i % 7 == n % 7) n * 1000 else 0;
+        ch.* = .{
+            .id = if (state == .pending_open) null else try std.fmt.allocPrint(arena, "{d}", .{848352385882718209 + i}),
+            .state = state,
+            .private = i % 3 == 0,
+            .point = .{ .txid = idOf(comm.Hash, 0, @as(u64, i) *% 0x9e3779b97f4a7c15), .index = @intCast(i % 2) },
+            .peer_pubkey = idOf(comm.PubKey, 0x02, @as(u64, i) *% 0xc2b2ae3d27d4eb4f),
+            .peer_alias = try std.fmt.allocPrint(arena, "chan-peer-alias{d}", .{i}),
+            .capacity = 1000000,
+            .balance = .{ .local = 500000 + shift, .remote = 500000 - shift, .unsettled = 0, .limbo = 0 },
+            .totalsats = .{ .sent = @intCast(i * 1000), .received = @intCast(i * 2000) },
+            .fees = .{ .base = 1000, .ppm = 400 },
+        };
+    }
+    return .{
+        .version = "0.17.3-beta commit=v0.17.3-beta",
+        .pubkey = comm.PubKey.literal("03142874abcdeadbeef8839bdfaf8439fac9b0327bf78acdee8928efbac982de82"),
+        .alias = "benchnode",
+        .npeers = nchan,
+        .height = 800000 + n,
+        .hash = block_hash,
+        .sync = .{ .chain = true, .graph = true },
+        .uris = &.{},
+        .totalbalance = .{ .local = 500000 * @as(i64, nchan), .remote = 500000 * @as(i64, nchan), .unsettled = 0, .pending = 0 },
+        .totalfees = .{ .day = 13 + n, .week = 132 + n, .month = 1321 + n },
+        .channels = channels,
+    };
+}
+
+/// a network report with nwifi scanned networks.
+pub fn network(arena: std.mem.Allocator, nwifi: u32) !comm.Message.NetworkReport {
+    const nets = try arena.alloc([]const u8, nwifi);
+    for (nets, 0..) |*ssid, i| {
+        ssid.* = try std.fmt.allocPrint(arena, "wifi-network-{d}", .{i});
+    }
+    return .{
+        .ipaddrs = &.{ "192.168.1.23", "fd00::1c2b:33ff:fe4a:9a01" },
+        .wifi_ssid = if (nwifi > 0) nets[0] else null,
+        .wifi_scan_networks = nets,
+    };
+}
@@ -0,0 +1,457 @@
+//! regtest scale-test environment: a bitcoind and a few lnd nodes, with
+//! a hub node holding many channels to the others and forwarding payments
+//! between them, for benchmarking nd lightning reports and ngui at
+//! channel counts larger than a dev setup has.
+//!
+//! bitcoind, bitcoin-cli, lnd and lncli are run from PATH unless given
+//! with flags. all state lives in the -dir directory, which must be new or
+//! made by an earlier run; it is wiped at start. once set up, the network
+//! runs until INT or TERM, and nd talks to the hub node with -devnet dir.
+
+const std = @import("std");
+const posix = std.posix;
+
+const stderr = std.io.getStdErr().writer();
+
+/// the layout nd -devnet relies on; see nd.zig.
+const bitcoind_rpc_port = 18443;
+const hub_rest_port = 10010;
+const rpc_user = "scale";
+const rpc_pass = "scale";
+/// marks a dir as made by scale-env, safe to wipe.
+const marker_name = ".scale-env";
+
+const Flags = struct {
+    dir: []const u8 = "/tmp/ndg-scale-env",
+    peers: u32 = 3, // lnd nodes besides the hub
+    channels: u32 = 100, // hub channels, spread over the peers
+    capacity: u64 = 1_000_000, // channel capacity in sat, half pushed to the peer
+    payments: u32 = 200, // payments forwarded by the hub
+    amount: u64 = 1000, // payment amount in sat
+    bitcoind: []const u8 = "bitcoind",
+    bitcoincli: []const u8 = "bitcoin-cli",
+    lnd: []const u8 = "lnd",
+    lncli: []const u8 = "lncli",
+};
+
+fn usage(prog: []const u8) !void {
+    try stderr.print(
+        \\usage: {s} [-dir path] [-peers n] [-channels n] [-capacity sat] [-payments n] [-amount sat]
+        \\    [-bitcoind path] [-bitcoin-cli path] [-lnd path] [-lncli path]
+        \\
+        \\sets up a regtest bitcoind and 1+peers lnd nodes, opens -channels from
+        \\the hub node to the peers and forwards -payments between the peers.
+        \\runs until INT or TERM; point nd at it with -devnet dir.
+        \\
+    , .{prog});
+}
+
+fn parseFlags(arena: std.mem.Allocator) !Flags {
+    var flags: Flags = .{};
+    var args = try std.process.argsWithAllocator(arena);
+    const prog = args.next() orelse return error.NoProgName;
+    while (args.next()) |a| {
+        if (std.mem.eql(u8, a, "-h") or std.mem.eql(u8, a, "-help") or std.mem.eql(u8, a, "--help")) {
+            usage(prog) catch {};
+            std.process.exit(1);
+        }
+        const v = args.next() orelse {
+            std.debug.print("{s} requires a value\n", .{a});
+            return error.MissingArgValue;
+        };
+        if (std.mem.eql(u8, a, "-dir")) {
+            flags.dir = try std.fs.cwd().realpathAlloc(arena, ".");
+            flags.dir = try std.fs.path.resolve(arena, &.{ flags.dir, v });
+        } else if (std.mem.eql(u8, a, "-peers")) {
+            flags.peers = try std.fmt.parseUnsigned(u32, v, 10);
+        } else if (std.mem.eql(u8, a, "-channels")) {
+            flags.channels = try std.fmt.parseUnsigned(u32, v, 10);
+        } else if (std.mem.eql(u8, a, "-capacity")) {
+            flags.capacity = try std.fmt.parseUnsigned(u64, v, 10);
+        } else if (std.mem.eql(u8, a, "-payments")) {
+            flags.payments = try std.fmt.parseUnsigned(u32, v, 10);
+        } else if (std.mem.eql(u8, a, "-amount")) {
+            flags.amount = try std.fmt.parseUnsigned(u64, v, 10);
+        } else if (std.mem.eql(u8, a, "-bitcoind")) {
+            flags.bitcoind = v;
+        } else if (std.mem.eql(u8, a, "-bitcoin-cli")) {
+            flags.bitcoincli = v;
+        } else if (std.mem.eql(u8, a, "-lnd")) {
+            flags.lnd = v;
+        } else if (std.mem.eql(u8, a, "-lncli")) {
+            flags.lncli = v;
+        } else {
+            std.debug.print("unknown arg name {s}\n", .{a});
+            return error.UnknownArgName;
+        }
+    }
+    if (flags.peers < 2) {
+        std.debug.print("-peers must be at least 2 to forward payments\n", .{});
+        return error.TooFewPeers;
+    }
+    return flags;
+}
+
+const Node = struct {
+    dir: []const u8, // lnddir
+    p2p_port: u16,
+    rpc_port: u16,
+    rest_port: u16,
+    proc: ?std.process.Child = null,
+    pubkey: []const u8 = "",
+};
+
+const Env = struct {
+    arena: std.mem.Allocator,
+    flags: Flags,
+    bitcoind: ?std.process.Child = null,
+    /// the hub first.
+    nodes: []Node,
+
+    /// kills running processes; see stop for a graceful shutdown.
+    fn deinit(self: *Env) void {
+        for (self.nodes) |*n| {
+            if (n.proc) |*p| kill(p);
+            n.proc = null;
+        }
+        if (self.bitcoind) |*p| kill(p);
+        self.bitcoind = null;
+    }
+
+    fn stop(self: *Env) void {
+        for (self.nodes, 0..) |*n, i| {
+            if (n.proc == null) continue;
+            if (self.lncli(i, &.{"stop"})) |_| {
+                wait(&n.proc.?);
+            } else |err| {
+                std.debug.print("lnd{d} stop: {!}\n", .{ i, err });
+                kill(&n.proc.?);
+            }
+            n.proc = null;
+        }
+        if (self.bitcoind) |*p| {
+            if (self.btccli(&.{"stop"})) |_| {
+                wait(p);
+            } else |err| {
+                std.debug.print("bitcoind stop: {!}\n", .{err});
+                kill(p);
+            }
+            self.bitcoind = null;
+        }
+    }
+
+    fn path(self: Env, sub: []const u8) ![]const u8 {
+        return std.fs.path.join(self.arena, &.{ self.flags.dir, sub });
+    }
+
+    fn startBitcoind(self: *Env) !void {
+        const datadir = try self.path("bitcoind");
+        try std.fs.cwd().makePath(datadir);
+        // the child keeps argv past this call.
+        const argv = try self.arena.dupe([]const u8, &.{
+            self.flags.bitcoind,
+            "-regtest",
+            try std.fmt.allocPrint(self.arena, "-datadir={s}", .{datadir}),
+            "-server",
+            "-txindex",
+            "-listen=0",
+            "-fallbackfee=0.0002",
+            "-rpcuser=" ++ rpc_user,
+            "-rpcpassword=" ++ rpc_pass,
+            std.fmt.comptimePrint("-rpcport={d}", .{bitcoind_rpc_port}),
+            "-zmqpubrawblock=tcp://127.0.0.1:28332",
+            "-zmqpubrawtx=tcp://127.0.0.1:28333",
+            "-printtoconsole=0",
+        });
+        var proc = std.process.Child.init(argv, self.arena);
+        proc.stdin_behavior = .Ignore;
+        proc.stdout_behavior = .Ignore;
+        try proc.spawn();
+        self.bitcoind = proc;
+        // nd reads bitcoind credentials off a cookie file.
+        try std.fs.cwd().writeFile(try self.path("rpc.cookie"), rpc_user ++ ":" ++ rpc_pass);
+        _ = try self.btccli(&.{ "-rpcwait", "getblockchaininfo" });
+    }
+
+    fn startLnd(self: *Env, i: usize) !void {
+        const n = &self.nodes[i];
+        try std.fs.cwd().makePath(n.dir);
+        const argv = try self.arena.dupe([]const u8, &.{
+            self.flags.lnd,
+            try std.fmt.allocPrint(self.arena, "--lnddir={s}", .{n.dir}),
+            try std.fmt.allocPrint(self.arena, "--alias=scale{d}", .{i}),
+            "--noseedbackup",
+            "--bitcoin.active",
+            "--bitcoin.regtest",
+            "--bitcoin.node=bitcoind",
+            std.fmt.comptimePrint("--bitcoind.rpchost=127.0.0.1:{d}", .{bitcoind_rpc_port}),
+            "--bitcoind.rpcuser=" ++ rpc_user,
+            "--bitcoind.rpcpass=" ++ rpc_pass,
+            "--bitcoind.zmqpubrawblock=tcp://127.0.0.1:28332",
+            "--bitcoind.zmqpubrawtx=tcp://127.0.0.1:28333",
+            try std.fmt.allocPrint(self.arena, "--listen=127.0.0.1:{d}", .{n.p2p_port}),
+            try std.fmt.allocPrint(self.arena, "--rpclisten=127.0.0.1:{d}", .{n.rpc_port}),
+            try std.fmt.allocPrint(self.arena, "--restlisten=127.0.0.1:{d}", .{n.rest_port}),
+            // the hub opens all its channels to each peer in a few blocks.
+            try std.fmt.allocPrint(self.arena, "--maxpendingchannels={d}", .{self.flags.channels}),
+            "--trickledelay=1000",
+            "--debuglevel=info",
+        });
+        var proc = std.process.Child.init(argv, self.arena);
+        proc.stdin_behavior = .Ignore;
+        proc.stdout_behavior = .Ignore;
+        proc.stderr_behavior = .Ignore;
+        try proc.spawn();
+        n.proc = proc;
+
+        const Info = struct { identity_pubkey: []const u8, synced_to_chain: bool };
+        var tries: u32 = 0;
+        while (true) : (tries += 1) {
+            if (self.lncliJson(Info, i, &.{"getinfo"})) |info| {
+                if (info.synced_to_chain) {
+                    n.pubkey = info.identity_pubkey;
+                    return;
+                }
+            } else |err| {
+                if (tries > 120) return err;
+            }
+            if (tries > 120) return error.LndNotSynced;
+            std.time.sleep(500 * std.time.ns_per_ms);
+        }
+    }
+
+    /// runs bitcoin-cli with args, returning its trimmed stdout.
+    fn btccli(self: Env, args: []const []const u8) ![]const u8 {
+        var argv = std.ArrayList([]const u8).init(self.arena);
+        try argv.appendSlice(&.{
+            self.flags.bitcoincli,
+            "-regtest",
+            try std.fmt.allocPrint(self.arena, "-datadir={s}", .{try self.path("bitcoind")}),
+            "-rpcuser=" ++ rpc_user,
+            "-rpcpassword=" ++ rpc_pass,
+            std.fmt.comptimePrint("-rpcport={d}", .{bitcoind_rpc_port}),
+        });
+        try argv.appendSlice(args);
+        return self.run(argv.items);
+    }
+
+    /// runs lncli against node i with args, returning its trimmed stdout.
+    fn lncli(self: Env, i: usize, args: []const []const u8) ![]const u8 {
+        const n = self.nodes[i];
+        var argv = std.ArrayList([]const u8).init(self.arena);
+        try argv.appendSlice(&.{
+            self.flags.lncli,
+            "--network=regtest",
+            try std.fmt.allocPrint(self.arena, "--lnddir={s}", .{n.dir}),
+            try std.fmt.allocPrint(self.arena, "--rpcserver=127.0.0.1:{d}", .{n.rpc_port}),
+        });
+        try argv.appendSlice(args);
+        return self.run(argv.items);
+    }
+
+    fn lncliJson(self: Env, comptime T: type, i: usize, args: []const []const u8) !T {
+        const out = try self.lncli(i, args);
+        return std.json.parseFromSliceLeaky(T, self.arena, out, .{ .ignore_unknown_fields = true });
+    }
+
+    fn run(self: Env, argv: []const []const u8) ![]const u8 {
+        const res = try std.process.Child.run(.{
+            .allocator = self.arena,
+            .argv = argv,
+            .max_output_bytes = 16 << 20,
+        });
+        switch (res.term) {
+            .Exited => |code| if (code == 0) {
+                return std.mem.trim(u8, res.stdout, &std.ascii.whitespace);
+            },
+            else => {},
+        }
+        std.debug.print("{s} {s}: {any}\n{s}\n", .{ argv[0], argv[argv.len - 1], res.term, res.stderr });
+        return error.CommandFailed;
+    }
+
+    fn mine(self: Env, nblocks: u32) !void {
+        const addr = try self.btccli(&.{"getnewaddress"});
+        const n = try std.fmt.allocPrint(self.arena, "{d}", .{nblocks});
+        _ = try self.btccli(&.{ "generatetoaddress", n, addr });
+    }
+
+    /// sends one wallet output of amount sat to the hub per channel.
+    fn fundHub(self: Env) !void {
+        const batch = 100; // outputs per transaction
+        var left = self.flags.channels;
+        while (left > 0) {
+            const count = @min(left, batch);
+            var outs = std.ArrayList(u8).init(self.arena);
+            try outs.append('{');
+            for (0..count) |k| {
+                const Addr = struct { address: []const u8 };
+                const a = try self.lncliJson(Addr, 0, &.{ "newaddress", "p2wkh" });
+                const sat = self.flags.capacity + 10_000; // fee margin
+                try outs.writer().print("{s}\"{s}\":{d}.{d:0>8}", .{ if (k > 0) "," else "", a.address, sat / 100_000_000, sat % 100_000_000 });
+            }
+            try outs.append('}');
+            _ = try self.btccli(&.{ "sendmany", "", outs.items });
+            left -= count;
+        }
+        try self.mine(1);
+    }
+
+    fn openChannels(self: Env) !void {
+        const hub = 0;
+        for (self.nodes[1..]) |n| {
+            const addr = try std.fmt.allocPrint(self.arena, "{s}@127.0.0.1:{d}", .{ n.pubkey, n.p2p_port });
+            _ = try self.lncli(hub, &.{ "connect", addr });
+        }
+        const local = try std.fmt.allocPrint(self.arena, "{d}", .{self.flags.capacity});
+        const push = try std.fmt.allocPrint(self.arena, "{d}", .{self.flags.capacity / 2});
+        const per_block = 20; // keeps unconfirmed change chains short
+        for (0..self.flags.channels) |c| {
+            const peer = self.nodes[1 + c % (self.nodes.len - 1)];
+            _ = try self.lncli(hub, &.{ "openchannel", "--node_key", peer.pubkey, "--local_amt", local, "--push_amt", push, "--sat_per_vbyte", "1" });
+            if ((c + 1) % per_block == 0) {
+                try self.mine(1);
+                std.debug.print("opened {d}/{d} channels\n", .{ c + 1, self.flags.channels });
+            }
+        }
+        // 6 confirmations for the channels to be announced.
+        try self.mine(6);
+
+        const Info = struct { num_active_channels: u32 };
+        const Graph = struct { num_channels: u32 };
+        var tries: u32 = 0;
+        while (true) : (tries += 1) {
+            const info = try self.lncliJson(Info, hub, &.{"getinfo"});
+            var synced = info.num_active_channels >= self.flags.channels;
+            // payments are routed through hub channels the peers learn of
+            // from gossip.
+            for (1..self.nodes.len) |i| {
+                const g = try self.lncliJson(Graph, i, &.{"getnetworkinfo"});
+                synced = synced and g.num_channels >= self.flags.channels;
+            }
+            if (synced) return;
+            if (tries > 300) return error.ChannelsNotActive;
+            if (tries % 10 == 0) {
+                std.debug.print("waiting for {d} active and announced channels ...\n", .{self.flags.channels});
+            }
+            std.time.sleep(std.time.ns_per_s);
+        }
+    }
+
+    /// pays invoices of one peer from another, round robin, each forwarded
+    /// by the hub. returns the number of payments that succeeded.
+    fn forwardPayments(self: Env) !u32 {
+        const amt = try std.fmt.allocPrint(self.arena, "{d}", .{self.flags.amount});
+        const npeers = self.nodes.len - 1;
+        var ok: u32 = 0;
+        for (0..self.flags.payments) |k| {
+            const from = 1 + k % npeers;
+            const to = 1 + (k + 1) % npeers;
+            const Invoice = struct { payment_request: []const u8 };
+            const inv = try self.lncliJson(Invoice, to, &.{ "addinvoice", "--amt", amt });
+            if (self.lncli(from, &.{ "payinvoice", "--force", "--timeout", "30s", inv.payment_request })) |_| {
+                ok += 1;
+            } else |err| {
+                std.debug.print("payment {d}: {!}\n", .{ k, err });
+            }
+            if ((k + 1) % 50 == 0) {
+                std.debug.print("forwarded {d}/{d} payments\n", .{ ok, k + 1 });
+            }
+        }
+        return ok;
+    }
+};
+
+fn kill(p: *std.process.Child) void {
+    if (p.kill()) |_| {} else |err| std.debug.print("kill {s}: {!}\n", .{ p.argv[0], err });
+}
+
+fn wait(p: *std.process.Child) void {
+    if (p.wait()) |_| {} else |err| std.debug.print("wait {s}: {!}\n", .{ p.argv[0], err });
+}
+
+/// wipes dir if made by an earlier run, or fails if it is someone else's.
+fn resetDir(dir: []const u8) !void {
+    var d = std.fs.cwd().openDir(dir, .{}) catch |err| switch (err) {
+        error.FileNotFound => return makeDir(dir),
+        else => return err,
+    };
+    defer d.close();
+    d.access(marker_name, .{}) catch {
+        std.debug.print("{s} exists and is not a scale-env dir\n", .{dir});
+        return error.ForeignDir;
+    };
+    try std.fs.cwd().deleteTree(dir);
+    try makeDir(dir);
+}
+
+fn makeDir(dir: []const u8) !void {
+    try std.fs.cwd().makePath(dir);
+    var d = try std.fs.cwd().openDir(dir, .{});
+    defer d.close();
+    try d.writeFile(marker_name, "");
+}
+
+var sigquit: std.Thread.ResetEvent = .{};
+
+fn sighandler(sig: c_int) callconv(.C) void {
+    _ = sig;
+    sigquit.set();
+}
+
+pub fn main() !void {
+    var arena_state = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    const flags = try parseFlags(arena);
+    try resetDir(flags.dir);
+
+    const nodes = try arena.alloc(Node, flags.peers + 1);
+    for (nodes, 0..) |*n, i| {
+        const port: u16 = @intCast(i);
+        n.* = .{
+            .dir = try std.fs.path.join(arena, &.{ flags.dir, try std.fmt.allocPrint(arena, "lnd{d}", .{i}) }),
+            .p2p_port = 19735 + port,
+            .rpc_port = 11009 + port,
+            .rest_port = if (i == 0) hub_rest_port else 12010 + port,
+        };
+    }
+    var env = Env{ .arena = arena, .flags = flags, .nodes = nodes };
+    defer env.deinit();
+
+    const sa = posix.Sigaction{
+        .handler = .{ .handler = sighandler },
+        .mask = posix.empty_sigset,
+        .flags = 0,
+    };
+    try posix.sigaction(posix.SIG.INT, &sa, null);
+    try posix.sigaction(posix.SIG.TERM, &sa, null);
+
+    var timer = try std.time.Timer.start();
+    try env.startBitcoind();
+    _ = try env.btccli(&.{ "createwallet", "scale" });
+    // matured coinbase of 50 btc each funds the hub channels.
+    const coinbase_sat = 50 * 100_000_000;
+    const funds_sat = @as(u64, flags.channels) * (flags.capacity + 10_000);
+    try env.mine(@intCast(101 + funds_sat / coinbase_sat));
+    for (0..nodes.len) |i| {
+        try env.startLnd(i);
+    }
+    std.debug.print("started bitcoind and {d} lnd nodes in {d}s\n", .{ nodes.len, timer.lap() / std.time.ns_per_s });
+
+    try env.fundHub();
+    try env.openChannels();
+    std.debug.print("opened {d} channels in {d}s\n", .{ flags.channels, timer.lap() / std.time.ns_per_s });
+    const forwarded = try env.forwardPayments();
+    std.debug.print("forwarded {d} of {d} payments in {d}s\n", .{ forwarded, flags.payments, timer.lap() / std.time.ns_per_s });
+
+    std.debug.print(
+        \\scale env ready: hub {s} REST at localhost:{d}
+        \\run nd with -devnet {s}; INT or TERM to stop
+        \\
+    , .{ nodes[0].pubkey, hub_rest_port, flags.dir });
+    sigquit.wait();
+    std.debug.print("stopping ...\n", .{});
+    env.stop();
+}
@@ -0,0 +1,258 @@
+//! a tor control port client.
+//!
+//! implements just enough of the tor control protocol to follow tor
+//! bootstrap and circuit builds: cookie authentication, GETINFO of the
+//! bootstrap phase and STATUS_CLIENT and CIRC asynchronous events.
+//! see https://spec.torproject.org/control-spec/ for the protocol.
+
+const std = @import("std");
+const posix = std.posix;
+
+pub const Controller = struct {
+    stream: std.net.Stream,
+    /// the last line read; events and replies returned by the controller
+    /// reference it until the next call.
+    line: [max_line]u8 = undefined,
+
+    /// CIRC events list the whole path, up to a few hundred bytes.
+    pub const max_line = 1024;
+
+    /// connects to a tor control port at addr:port.
+    /// the returned value must be close'd when done.
+    pub fn connect(addr: []const u8, port: u16) !Controller {
+        const addrport = try std.net.Address.resolveIp(addr, port);
+        const stream = try std.net.tcpConnectToAddress(addrport);
+        return .{ .stream = stream };
+    }
+
+    pub fn close(self: Controller) void {
+        self.stream.close();
+    }
+
+    /// the underlying socket, for example to poll until an event arrives.
+    pub fn fd(self: Controller) posix.fd_t {
+        return self.stream.handle;
+    }
+
+    /// authenticates with the cookie tor writes to its CookieAuthFile.
+    pub fn authenticate(self: *Controller, cookie_path: []const u8) !void {
+        var cookie: [max_cookie_size]u8 = undefined;
+        const n = blk: {
+            const f = try std.fs.cwd().openFile(cookie_path, .{});
+            defer f.close();
+            break :blk try f.readAll(&cookie);
+        };
+        var buf: [32 + 2 * max_cookie_size]u8 = undefined;
+        const cmd = try std.fmt.bufPrint(&buf, "AUTHENTICATE {s}", .{std.fmt.fmtSliceHexUpper(cookie[0..n])});
+        _ = self.command(cmd) catch |err| return switch (err) {
+            error.TorCommandRejected => error.TorAuthFailed,
+            else => err,
+        };
+    }
+
+    /// returns the current bootstrap phase.
+    pub fn bootstrapPhase(self: *Controller) !Bootstrap {
+        const key = "status/bootstrap-phase=";
+        const data = try self.command("GETINFO status/bootstrap-phase");
+        if (!std.mem.startsWith(u8, data, key)) {
+            return error.TorBadReply;
+        }
+        return parseBootstrap(data[key.len..]) orelse error.TorBadReply;
+    }
+
+    /// subscribes to the asynchronous events, replacing any set before.
+    pub fn setEvents(self: *Controller, events: []const []const u8) !void {
+        var buf: [128]u8 = undefined;
+        var fbs = std.io.fixedBufferStream(&buf);
+        try fbs.writer().writeAll("SETEVENTS");
+        for (events) |e| {
+            try fbs.writer().print(" {s}", .{e});
+        }
+        _ = try self.command(fbs.getWritten());
+    }
+
+    /// blocks until the next bootstrap or circuit event is received.
+    /// other events are skipped.
+    pub fn next(self: *Controller) !Event {
+        while (true) {
+            const rep = try self.readReply();
+            if (rep.code != async_code) {
+                continue; // a late reply to a command
+            }
+            if (parseEvent(rep.text)) |ev| {
+                return ev;
+            }
+        }
+    }
+
+    /// sends a command and waits for its reply, skipping any events
+    /// meanwhile. returns the text of the first reply line, without the code.
+    fn command(self: *Controller, cmd: []const u8) ![]const u8 {
+        try self.stream.writer().print("{s}\r\n", .{cmd});
+        var first: ?usize = null; // length of the first line, moved to the start of self.line
+        while (true) {
+            const start = if (first) |n| n else 0;
+            const rep = try readLine(self.stream.reader(), self.line[start..]);
+            if (rep.code == async_code) {
+                continue;
+            }
+            if (rep.code >= 400) {
+                return error.TorCommandRejected;
+            }
+            if (first == null) {
+                first = rep.text.len;
+                std.mem.copyForwards(u8, self.line[0..rep.text.len], rep.text);
+            }
+            if (rep.sep == ' ') {
+                return self.line[0..first.?];
+            }
+        }
+    }
+
+    fn readReply(self: *Controller) !Reply {
+        return readLine(self.stream.reader(), &self.line);
+    }
+};
+
+/// tor cookies are 32 bytes; anything much larger isn't a cookie.
+const max_cookie_size = 64;
+
+/// asynchronous event replies status code.
+const async_code = 650;
+
+pub const Event = union(enum) {
+    bootstrap: Bootstrap,
+    circuit: Circuit,
+};
+
+pub const Bootstrap = struct {
+    progress: u8, // 0-100%
+    tag: []const u8, // e.g. "conn_done" or "done"
+    summary: []const u8, // e.g. "Connected to a relay"; escaped as tor sends it
+};
+
+pub const Circuit = struct {
+    id: u32,
+    status: Status,
+
+    pub const Status = enum { launched, built, extended, failed, closed };
+};
+
+const Reply = struct {
+    code: u16,
+    sep: u8, // ' ' on the last line of a reply, '-' or '+' before it
+    text: []const u8,
+};
+
+/// reads a reply line into buf. data of "+" lines is returned a line at a
+/// time, as if each was a reply line of its own.
+fn readLine(r: anytype, buf: []u8) !Reply {
+    var fbs = std.io.fixedBufferStream(buf);
+    try r.streamUntilDelimiter(fbs.writer(), '\n', buf.len);
+    return parseLine(std.mem.trimRight(u8, fbs.getWritten(), "\r"));
+}
+
+fn parseLine(line: []const u8) Reply {
+    if (line.len < 4 or (line[3] != ' ' and line[3] != '-' and line[3] != '+')) {
+        return .{ .code = 0, .sep = '-', .text = line }; // "+" data line
+    }
+    const code = std.fmt.parseUnsigned(u16, line[0..3], 10) catch 0;
+    return .{ .code = code, .sep = line[3], .text = line[4..] };
+}
+
+/// parses the text of an asynchronous event reply.
+fn parseEvent(text: []const u8) ?Event {
+    var it = std.mem.tokenizeScalar(u8, text, ' ');
+    const name = it.next() orelse return null;
+    if (std.mem.eql(u8, name, "STATUS_CLIENT")) {
+        return .{ .bootstrap = parseBootstrap(it.rest()) orelse return null };
+    }
+    if (std.mem.eql(u8, name, "CIRC")) {
+        const id = std.fmt.parseUnsigned(u32, it.next() orelse return null, 10) catch return null;
+        const status = it.next() orelse return null;
+        inline for (@typeInfo(Circuit.Status).Enum.fields) |f| {
+            if (std.ascii.eqlIgnoreCase(status, f.name)) {
+                return .{ .circuit = .{ .id = id, .status = @enumFromInt(f.value) } };
+            }
+        }
+    }
+    return null;
+}
+
+/// parses a "<severity> BOOTSTRAP PROGRESS=n TAG=t SUMMARY=\"s\" ..." status.
+/// returns null for other statuses.
+fn parseBootstrap(text: []const u8) ?Bootstrap {
+    var it = std.mem.tokenizeScalar(u8, text, ' ');
+    _ = it.next() orelse return null; // severity
+    if (!std.mem.eql(u8, it.next() orelse return null, "BOOTSTRAP")) {
+        return null;
+    }
+    var b = Bootstrap{ .progress = 0, .tag = "", .summary = "" };
+    var progress = false;
+    while (it.next()) |kv| {
+        const eq = std.mem.indexOfScalar(u8, kv, '=') orelse continue;
+        const k = kv[0..eq];
+        if (std.mem.eql(u8, k, "PROGRESS")) {
+            b.progress = std.fmt.parseUnsigned(u8, kv[eq + 1 ..], 10) catch return null;
+            progress = true;
+        } else if (std.mem.eql(u8, k, "TAG")) {
+            b.tag = kv[eq + 1 ..];
+        } else if (std.mem.eql(u8, k, "SUMMARY")) {
+            // a quoted string, possibly with spaces: rewind to its start.
+            const start = it.index - kv.len + eq + 1;
+            b.summary = quoted(text[start..]);
+            it.index = @min(text.len, start + b.summary.len + 2);
+        }
+    }
+    return if (progress) b else null;
+}
+
+/// returns the contents of a quoted string at the start of s, or s up to the
+/// first space if unquoted.
+fn quoted(s: []const u8) []const u8 {
+    if (s.len == 0 or s[0] != '"') {
+        return s[0 .. std.mem.indexOfScalar(u8, s, ' ') orelse s.len];
+    }
+    var i: usize = 1;
+    while (i < s.len) : (i += 1) {
+        switch (s[i]) {
+            '\\' => i += 1,
+            '"' => return s[1..i],
+            else => {},
+        }
+    }
+    return s[1..];
+}
+
+test "parse events" {
+    const t = std.testing;
+
+    var ev = parseEvent("STATUS_CLIENT NOTICE BOOTSTRAP PROGRESS=75 TAG=enough_dirinfo SUMMARY=\"Loaded enough directory info to build circuits\"").?;
+    try t.expectEqual(@as(u8, 75), ev.bootstrap.progress);
+    try t.expectEqualStrings("enough_dirinfo", ev.bootstrap.tag);
+    try t.expectEqualStrings("Loaded enough directory info to build circuits", ev.bootstrap.summary);
+
+    const b = parseBootstrap("WARN BOOTSTRAP PROGRESS=10 TAG=conn_done SUMMARY=\"Connected to a \\\"relay\\\"\" WARNING=\"Connection refused\" COUNT=3").?;
+    try t.expectEqual(@as(u8, 10), b.progress);
+    try t.expectEqualStrings("Connected to a \\\"relay\\\"", b.summary);
+    try t.expect(parseEvent("STATUS_CLIENT NOTICE CIRCUIT_ESTABLISHED") == null);
+
+    ev = parseEvent("CIRC 12 BUILT $AAAA~relay1,$BBBB~relay2 BUILD_FLAGS=NEED_CAPACITY PURPOSE=GENERAL").?;
+    try t.expectEqual(@as(u32, 12), ev.circuit.id);
+    try t.expectEqual(Circuit.Status.built, ev.circuit.status);
+    ev = parseEvent("CIRC 13 LAUNCHED BUILD_FLAGS=NEED_CAPACITY").?;
+    try t.expectEqual(Circuit.Status.launched, ev.circuit.status);
+    try t.expect(parseEvent("CIRC 14 GUARD_WAIT") == null);
+    try t.expect(parseEvent("STREAM 1 NEW 0 example.com:80") == null);
+
+    const rep = parseLine("250-status/bootstrap-phase=NOTICE BOOTSTRAP PROGRESS=100 TAG=done SUMMARY=\"Done\"");
+    try t.expectEqual(@as(u16, 250), rep.code);
+    try t.expectEqual(@as(u8, '-'), rep.sep);
+    try t.expectEqual(@as(u16, 0), parseLine("some data").code);
+
+    var fbs = std.io.fixedBufferStream("515 Authentication failed\r\n");
+    var buf: [64]u8 = undefined;
+    const line = try readLine(fbs.reader(), &buf);
+    try t.expectEqual(@as(u16, 515), line.code);
+    try t.expectEqualStrings("Authentication failed", line.text);
+}
@@ -0,0 +1,185 @@
+//! startup and wakeup tracing: begin/end spans with monotonic timestamps,
+//! written out in the Chrome trace event format for chrome://tracing or
+//! ui.perfetto.dev.
+//!
+//! compiled in only with -Dtrace=true; all functions are no-ops otherwise,
+//! and spans take no space. nd and ngui write to the same file for a single
+//! trace of both processes: nd creates it and passes the path on to ngui
+//! which appends to it. the closing bracket of the JSON array format is
+//! optional, which lets both processes append events until they exit.
+//! timestamps are CLOCK_MONOTONIC, the same in all processes on a host.
+//!
+//! events are kept in a fixed size buffer until `flush`; those recorded
+//! while it is full are dropped.
+//! safe for concurrent use.
+
+const buildopts = @import("build_options");
+const std = @import("std");
+const posix = std.posix;
+
+const logger = std.log.scoped(.trace);
+
+pub const enabled = buildopts.trace;
+
+/// max number of events waiting to be flushed.
+const max_events = 1024;
+
+/// an interval of time traced with begin and end.
+pub const Span = struct {
+    name: if (enabled) []const u8 else void,
+    start: if (enabled) u64 else void, // ns
+
+    /// records the span as ending now.
+    pub inline fn end(self: Span) void {
+        if (enabled) {
+            global.record(.{ .name = self.name, .start = self.start, .dur = now() - self.start });
+        }
+    }
+};
+
+/// starts a span; see Span.end.
+pub inline fn begin(comptime name: []const u8) Span {
+    if (!enabled) {
+        return .{ .name = {}, .start = {} };
+    }
+    return .{ .name = name, .start = now() };
+}
+
+/// records a point in time, like the arrival of a first report.
+pub inline fn instant(comptime name: []const u8) void {
+    if (enabled) {
+        global.record(.{ .name = name, .start = now(), .dur = null });
+    }
+}
+
+/// creates the trace file at path, or appends to it if it exists and append
+/// is true, naming the process pname in the trace.
+pub fn open(path: []const u8, pname: []const u8, opt: struct { append: bool = false }) !void {
+    if (!enabled) {
+        logger.warn("{s}: tracing is not compiled in; see -Dtrace", .{path});
+        return;
+    }
+    // a single write(2) in O_APPEND mode keeps lines of the two processes whole.
+    const fd = try posix.open(path, .{ .ACCMODE = .WRONLY, .CREAT = true, .APPEND = true, .TRUNC = !opt.append, .CLOEXEC = true }, 0o644);
+    const file = std.fs.File{ .handle = fd };
+    errdefer file.close();
+    if ((try file.getEndPos()) == 0) {
+        try file.writeAll("[\n");
+    }
+    global.mu.lock();
+    defer global.mu.unlock();
+    global.file = file;
+    global.pid = std.os.linux.getpid();
+    global.pname = pname;
+}
+
+/// writes out all events recorded since the previous flush.
+pub fn flush() void {
+    if (enabled) {
+        global.flush() catch |err| logger.err("flush: {!}", .{err});
+    }
+}
+
+var global: if (enabled) Recorder else void = if (enabled) .{} else {};
+
+fn now() u64 {
+    var ts: posix.timespec = undefined;
+    posix.clock_gettime(posix.CLOCK.MONOTONIC, &ts) catch return 0;
+    return @as(u64, @intCast(ts.tv_sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.tv_nsec));
+}
+
+const Event = struct {
+    name: []const u8,
+    start: u64, // ns
+    dur: ?u64, // ns; null for instants
+    tid: std.Thread.Id = 0,
+};
+
+const Recorder = struct {
+    mu: std.Thread.Mutex = .{},
+    file: ?std.fs.File = null,
+    pid: i32 = 0,
+    pname: []const u8 = "",
+    /// whether the process name metadata event was written.
+    named: bool = false,
+    events: [max_events]Event = undefined,
+    len: usize = 0,
+    dropped: usize = 0,
+
+    fn record(self: *Recorder, ev: Event) void {
+        var e = ev;
+        e.tid = std.Thread.getCurrentId();
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.len == self.events.len) {
+            self.dropped += 1;
+            return;
+        }
+        self.events[self.len] = e;
+        self.len += 1;
+    }
+
+    fn flush(self: *Recorder) !void {
+        self.mu.lock();
+        defer self.mu.unlock();
+        const file = self.file orelse return;
+        var buf: [512]u8 = undefined;
+        if (!self.named) {
+            try file.writeAll(try std.fmt.bufPrint(&buf,
+                \\{{"name":"process_name","ph":"M","pid":{d},"args":{{"name":"{s}"}}}},
+                \\
+            , .{ self.pid, self.pname }));
+            self.named = true;
+        }
+        // one write per line; other processes may append to the same file.
+        for (self.events[0..self.len]) |ev| {
+            try file.writeAll(try formatEvent(&buf, self.pid, ev));
+        }
+        self.len = 0;
+        if (self.dropped > 0) {
+            logger.warn("dropped {d} events; buffer is full", .{self.dropped});
+            self.dropped = 0;
+        }
+    }
+};
+
+/// formats ev as a JSON array line of the Chrome trace event format.
+/// timestamps are in microseconds.
+fn formatEvent(buf: []u8, pid: i32, ev: Event) ![]const u8 {
+    var fbs = std.io.fixedBufferStream(buf);
+    const w = fbs.writer();
+    try w.writeAll("{\"name\":");
+    try std.json.stringify(ev.name, .{}, w);
+    if (ev.dur) |dur| {
+        try w.print(",\"ph\":\"X\",\"ts\":{d}.{d:0>3},\"dur\":{d}.{d:0>3}", .{ ev.start / 1000, ev.start % 1000, dur / 1000, dur % 1000 });
+    } else {
+        try w.print(",\"ph\":\"i\",\"s\":\"p\",\"ts\":{d}.{d:0>3}", .{ ev.start / 1000, ev.start % 1000 });
+    }
+    try w.print(",\"pid\":{d},\"tid\":{d}}},\n", .{ pid, ev.tid });
+    return fbs.getWritten();
+}
+
+test "trace event format" {
+    const t = std.testing;
+
+    var buf: [256]u8 = undefined;
+    try t.expectEqualStrings(
+        \\{"name":"ui init","ph":"X","ts":1234.567,"dur":89.001,"pid":7,"tid":8},
+        \\
+    , try formatEvent(&buf, 7, .{ .name = "ui init", .start = 1234567, .dur = 89001, .tid = 8 }));
+    try t.expectEqualStrings(
+        \\{"name":"first report","ph":"i","s":"p","ts":0.042,"pid":7,"tid":8},
+        \\
+    , try formatEvent(&buf, 7, .{ .name = "first report", .start = 42, .dur = null, .tid = 8 }));
+}
+
+test "trace recorder drops events when full" {
+    const t = std.testing;
+
+    var r = Recorder{};
+    for (0..max_events + 3) |_| {
+        r.record(.{ .name = "e", .start = 1, .dur = 1 });
+    }
+    try t.expectEqual(max_events, r.len);
+    try t.expectEqual(3, r.dropped);
+}
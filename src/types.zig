@@ -3,12 +3,14 @@ const std = @import("std");
 const nif = @import("nif");
 
 const tt = @import("test.zig");
+const xfmt = @import("xfmt.zig");
 
 pub usingnamespace if (builtin.is_test) struct {
     // stubs, mocks, overrides for testing.
     pub const Timer = tt.TestTimer;
     pub const ChildProcess = tt.TestChildProcess;
     pub const WpaControl = tt.TestWpaControl;
+    pub const WpaAsyncControl = tt.TestWpaAsyncControl;
 
     /// always returns caller's (current process) user/group IDs.
     /// atm works only on linux via getuid syscalls.
@@ -24,6 +26,7 @@ pub usingnamespace if (builtin.is_test) struct {
     pub const Timer = std.time.Timer;
     pub const ChildProcess = std.ChildProcess;
     pub const WpaControl = nif.wpa.Control;
+    pub const WpaAsyncControl = nif.wpa.AsyncControl;
 
     pub fn getUserInfo(name: []const u8) !std.process.UserInfo {
         return std.process.getUserInfo(name);
@@ -130,10 +133,92 @@ pub const StringList = struct {
     }
 };
 
+/// interns strings, handing out stable ids: an equal string always gets the
+/// same id, so lists of strings compare as lists of ids. strings are stored
+/// once, null-terminated, in a single buffer, and never freed individually;
+/// see reset. strings must not contain null bytes.
+/// unsafe for concurrent use.
+pub const StringPool = struct {
+    allocator: std.mem.Allocator,
+    bytes: std.ArrayListUnmanaged(u8) = .{},
+    /// offsets of the strings in bytes.
+    map: std.HashMapUnmanaged(u32, void, std.hash_map.StringIndexContext, std.hash_map.default_max_load_percentage) = .{},
+
+    pub const Id = enum(u32) { _ };
+
+    pub fn init(allocator: std.mem.Allocator) StringPool {
+        return .{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *StringPool) void {
+        self.map.deinit(self.allocator);
+        self.bytes.deinit(self.allocator);
+    }
+
+    /// returns the id of s, storing a copy of s if new.
+    pub fn intern(self: *StringPool, s: []const u8) !Id {
+        const res = try self.map.getOrPutContextAdapted(
+            self.allocator,
+            s,
+            std.hash_map.StringIndexAdapter{ .bytes = &self.bytes },
+            std.hash_map.StringIndexContext{ .bytes = &self.bytes },
+        );
+        if (res.found_existing) {
+            return @enumFromInt(res.key_ptr.*);
+        }
+        errdefer self.map.removeByPtr(res.key_ptr);
+        const off = std.math.cast(u32, self.bytes.items.len) orelse return error.OutOfMemory;
+        try self.bytes.ensureUnusedCapacity(self.allocator, s.len + 1);
+        self.bytes.appendSliceAssumeCapacity(s);
+        self.bytes.appendAssumeCapacity(0);
+        res.key_ptr.* = off;
+        return @enumFromInt(off);
+    }
+
+    /// returns the string of an id from intern; valid until the next intern or reset.
+    pub fn get(self: StringPool, id: Id) [:0]const u8 {
+        const ptr: [*:0]const u8 = @ptrCast(self.bytes.items[@intFromEnum(id)..].ptr);
+        return std.mem.span(ptr);
+    }
+
+    /// returns the total size of stored strings, including terminators.
+    pub fn size(self: StringPool) usize {
+        return self.bytes.items.len;
+    }
+
+    /// forgets all strings, invalidating their ids, and keeps the memory.
+    pub fn reset(self: *StringPool) void {
+        self.map.clearRetainingCapacity();
+        self.bytes.clearRetainingCapacity();
+    }
+};
+
+test "StringPool" {
+    const t = std.testing;
+
+    var pool = StringPool.init(t.allocator);
+    defer pool.deinit();
+    const a = try pool.intern("home");
+    const b = try pool.intern("cafe");
+    try t.expect(a != b);
+    try t.expectEqual(a, try pool.intern("home"));
+    try t.expectEqualStrings("home", pool.get(a));
+    try t.expectEqualStrings("cafe", pool.get(b));
+    try t.expectEqual(@as(usize, 10), pool.size());
+    const empty = try pool.intern("");
+    try t.expectEqualStrings("", pool.get(empty));
+
+    pool.reset();
+    try t.expectEqual(@as(usize, 0), pool.size());
+    try t.expectEqualStrings("cafe", pool.get(try pool.intern("cafe")));
+}
+
 pub fn Deinitable(comptime T: type) type {
     return struct {
         value: T,
         arena: *std.heap.ArenaAllocator,
+        /// the arena is returned to the pool on deinit, if any.
+        pool: ?*ArenaPool = null,
 
         const Self = @This();
 
@@ -146,10 +231,381 @@ pub fn Deinitable(comptime T: type) type {
             return res;
         }
 
+        /// same as init but takes the arena from the pool.
+        pub fn initPooled(pool: *ArenaPool) !Self {
+            return .{ .arena = try pool.acquire(), .pool = pool, .value = undefined };
+        }
+
         pub fn deinit(self: Self) void {
+            if (self.pool) |pool| {
+                pool.release(self.arena);
+                return;
+            }
             const allocator = self.arena.child_allocator;
             self.arena.deinit();
             allocator.destroy(self.arena);
         }
     };
 }
+
+/// a pool of arena allocators for short-lived Deinitable values, like RPC
+/// results in a report cycle. released arenas are reset but retain their
+/// capacity, so that in steady state a cycle makes no backing allocator calls.
+/// safe for concurrent use.
+pub const ArenaPool = struct {
+    allocator: std.mem.Allocator,
+    mu: std.Thread.Mutex = .{},
+    idle: std.ArrayListUnmanaged(*std.heap.ArenaAllocator) = .{},
+
+    /// released arenas keep at most this much capacity, so that a single
+    /// unusually large result isn't held onto forever.
+    pub const retain_limit = 256 * 1024;
+    /// arenas released in excess of this are freed.
+    pub const max_idle = 16;
+
+    pub fn init(allocator: std.mem.Allocator) ArenaPool {
+        return .{ .allocator = allocator };
+    }
+
+    /// frees all idle arenas. all acquired arenas must be released before deinit.
+    pub fn deinit(self: *ArenaPool) void {
+        for (self.idle.items) |arena| {
+            arena.deinit();
+            self.allocator.destroy(arena);
+        }
+        self.idle.deinit(self.allocator);
+    }
+
+    /// returns an idle arena or creates a new one. callers release it when done.
+    pub fn acquire(self: *ArenaPool) !*std.heap.ArenaAllocator {
+        self.mu.lock();
+        if (self.idle.popOrNull()) |arena| {
+            self.mu.unlock();
+            return arena;
+        }
+        self.mu.unlock();
+        const arena = try self.allocator.create(std.heap.ArenaAllocator);
+        arena.* = std.heap.ArenaAllocator.init(self.allocator);
+        return arena;
+    }
+
+    /// resets the arena, invalidating all its allocations, and puts it back
+    /// into the pool.
+    pub fn release(self: *ArenaPool, arena: *std.heap.ArenaAllocator) void {
+        _ = arena.reset(.{ .retain_with_limit = retain_limit });
+        self.mu.lock();
+        defer self.mu.unlock();
+        if (self.idle.items.len < max_idle) {
+            if (self.idle.append(self.allocator, arena)) {
+                return;
+            } else |_| {}
+        }
+        arena.deinit();
+        self.allocator.destroy(arena);
+    }
+};
+
+test "ArenaPool" {
+    const t = std.testing;
+    var pool = ArenaPool.init(t.allocator);
+    defer pool.deinit();
+
+    var a = try Deinitable([]u8).initPooled(&pool);
+    a.value = try a.arena.allocator().alloc(u8, 1000);
+    const arena = a.arena;
+    a.deinit();
+    try t.expectEqual(1, pool.idle.items.len);
+
+    // reused, with no new allocations on the backing allocator.
+    var b = try Deinitable([]u8).initPooled(&pool);
+    try t.expectEqual(arena, b.arena);
+    var failing = std.testing.FailingAllocator.init(t.allocator, .{ .fail_index = 0 });
+    arena.child_allocator = failing.allocator();
+    b.value = try b.arena.allocator().alloc(u8, 1000);
+    arena.child_allocator = t.allocator;
+    b.deinit();
+
+    // unpooled values are deinit'ed as before.
+    const c = try Deinitable(u8).init(t.allocator);
+    c.deinit();
+}
+
+/// a 32 bytes hash, like a block hash or a txid.
+pub const Hash = HexBytes(32);
+/// a 33 bytes compressed public key, like a lightning node id.
+pub const PubKey = HexBytes(33);
+
+/// fixed size binary data which travels as hex strings in json, like hashes
+/// and public keys. json strings are decoded straight into the bytes, and the
+/// comm binary encoding sends the raw bytes, half the size of hex.
+/// the bytes are in the order of the hex string. for bitcoin hashes, that's
+/// the reverse of the internal byte order.
+pub fn HexBytes(comptime n: usize) type {
+    return struct {
+        bytes: [n]u8,
+
+        const Self = @This();
+        pub const hex_len = 2 * n;
+
+        /// parses exactly hex_len hex digits, in either case.
+        pub fn parse(s: []const u8) HexParseError!Self {
+            if (s.len != hex_len) {
+                return error.InvalidLength;
+            }
+            return .{ .bytes = try xfmt.parseHex(n, s[0..hex_len]) };
+        }
+
+        /// same as parse but at comptime, for literals.
+        pub fn literal(comptime s: []const u8) Self {
+            return comptime blk: {
+                break :blk parse(s) catch |err| @compileError(@errorName(err) ++ ": " ++ s);
+            };
+        }
+
+        /// returns lowercase hex digits.
+        pub fn hex(self: Self) [hex_len]u8 {
+            return xfmt.hexLower(n, self.bytes);
+        }
+
+        pub fn format(self: Self, comptime fmt: []const u8, opts: std.fmt.FormatOptions, w: anytype) !void {
+            _ = fmt;
+            _ = opts;
+            try w.writeAll(&self.hex());
+        }
+
+        pub fn jsonStringify(self: Self, jw: anytype) !void {
+            const h = self.hex();
+            try jw.write(@as([]const u8, &h));
+        }
+
+        pub fn jsonParse(allocator: std.mem.Allocator, source: anytype, opts: std.json.ParseOptions) !Self {
+            _ = opts;
+            return parse(try jsonNextString(allocator, source)) catch return error.UnexpectedToken;
+        }
+
+        pub fn jsonParseFromValue(_: std.mem.Allocator, v: std.json.Value, _: std.json.ParseOptions) !Self {
+            if (v != .string) {
+                return error.UnexpectedToken;
+            }
+            return parse(v.string) catch return error.UnexpectedToken;
+        }
+    };
+}
+
+pub const HexParseError = error{ InvalidLength, InvalidCharacter };
+
+/// a reference to a transaction output, like a lightning channel funding point.
+/// formatted as txid:index, also in json.
+pub const OutPoint = struct {
+    txid: Hash,
+    index: u32,
+
+    /// max length of the txid:index string form.
+    pub const max_str_len = Hash.hex_len + 1 + 10;
+
+    pub fn parse(s: []const u8) HexParseError!OutPoint {
+        const i = std.mem.lastIndexOfScalar(u8, s, ':') orelse return error.InvalidLength;
+        return .{
+            .txid = try Hash.parse(s[0..i]),
+            .index = std.fmt.parseInt(u32, s[i + 1 ..], 10) catch return error.InvalidCharacter,
+        };
+    }
+
+    /// same as parse but at comptime, for literals.
+    pub fn literal(comptime s: []const u8) OutPoint {
+        return comptime blk: {
+            break :blk parse(s) catch |err| @compileError(@errorName(err) ++ ": " ++ s);
+        };
+    }
+
+    pub fn format(self: OutPoint, comptime fmt: []const u8, opts: std.fmt.FormatOptions, w: anytype) !void {
+        _ = fmt;
+        _ = opts;
+        try w.print("{}:{d}", .{ self.txid, self.index });
+    }
+
+    pub fn jsonStringify(self: OutPoint, jw: anytype) !void {
+        var buf: [max_str_len]u8 = undefined;
+        const s = std.fmt.bufPrint(&buf, "{}", .{self}) catch unreachable; // buf fits max_str_len
+        try jw.write(s);
+    }
+
+    pub fn jsonParse(allocator: std.mem.Allocator, source: anytype, opts: std.json.ParseOptions) !OutPoint {
+        _ = opts;
+        return parse(try jsonNextString(allocator, source)) catch return error.UnexpectedToken;
+    }
+
+    pub fn jsonParseFromValue(_: std.mem.Allocator, v: std.json.Value, _: std.json.ParseOptions) !OutPoint {
+        if (v != .string) {
+            return error.UnexpectedToken;
+        }
+        return parse(v.string) catch return error.UnexpectedToken;
+    }
+};
+
+/// returns the next json token of source which must be a string.
+/// the string is copied with the allocator only if split in the input.
+fn jsonNextString(allocator: std.mem.Allocator, source: anytype) ![]const u8 {
+    return switch (try source.nextAlloc(allocator, .alloc_if_needed)) {
+        inline .string, .allocated_string => |s| s,
+        else => error.UnexpectedToken,
+    };
+}
+
+test "HexBytes and OutPoint" {
+    const t = std.testing;
+
+    const hexstr = "00000000000000000002bf8029f6be4e40b4a3e0e161b6a1044ddaf9eb126504";
+    const h = try Hash.parse(hexstr);
+    try t.expectEqual(0x02, h.bytes[9]);
+    try t.expectEqualStrings(hexstr, &h.hex());
+    try t.expectEqual(h, Hash.literal(hexstr));
+    try t.expectError(error.InvalidLength, Hash.parse("abcd"));
+    try t.expectError(error.InvalidCharacter, PubKey.parse("zz" ++ "ab" ** 32));
+
+    const op = try OutPoint.parse(hexstr ++ ":7");
+    try t.expectEqual(h, op.txid);
+    try t.expectEqual(7, op.index);
+    try t.expectError(error.InvalidLength, OutPoint.parse(hexstr));
+    try t.expectError(error.InvalidCharacter, OutPoint.parse(hexstr ++ ":x"));
+
+    const V = struct { hash: Hash, point: OutPoint, key: ?PubKey };
+    const js = "{\"hash\":\"" ++ hexstr ++ "\",\"point\":\"" ++ hexstr ++ ":7\",\"key\":null}";
+    const parsed = try std.json.parseFromSlice(V, t.allocator, js, .{});
+    defer parsed.deinit();
+    try t.expectEqual(V{ .hash = h, .point = op, .key = null }, parsed.value);
+    const out = try std.json.stringifyAlloc(t.allocator, parsed.value, .{});
+    defer t.allocator.free(out);
+    try t.expectEqualStrings(js, out);
+
+    const val = try std.json.parseFromSlice(std.json.Value, t.allocator, js, .{});
+    defer val.deinit();
+    const fromval = try std.json.parseFromValue(V, t.allocator, val.value, .{});
+    defer fromval.deinit();
+    try t.expectEqual(parsed.value, fromval.value);
+    try t.expectError(error.UnexpectedToken, std.json.parseFromSlice(Hash, t.allocator, "\"abcd\"", .{}));
+}
+
+/// an unbounded lock-free multi-producer single-consumer queue.
+/// push is safe for concurrent use; takeAll must be called from a single
+/// consumer thread. values are pushed onto an intrusive stack which the
+/// consumer detaches as a whole and reverses into FIFO order.
+pub fn MpscQueue(comptime T: type) type {
+    return struct {
+        allocator: std.mem.Allocator,
+        head: std.atomic.Value(?*Node) = std.atomic.Value(?*Node).init(null),
+
+        const Self = @This();
+
+        const Node = struct {
+            value: T,
+            next: ?*Node,
+        };
+
+        pub fn init(allocator: std.mem.Allocator) Self {
+            return .{ .allocator = allocator };
+        }
+
+        /// frees all queued nodes; values are discarded without deinit.
+        pub fn deinit(self: *Self) void {
+            var batch = self.takeAll();
+            while (batch.next()) |_| {}
+        }
+
+        pub fn push(self: *Self, v: T) !void {
+            const node = try self.allocator.create(Node);
+            node.* = .{ .value = v, .next = self.head.load(.monotonic) };
+            while (self.head.cmpxchgWeak(node.next, node, .release, .monotonic)) |cur| {
+                node.next = cur;
+            }
+        }
+
+        /// detaches all values queued so far, in push order.
+        pub fn takeAll(self: *Self) Batch {
+            var node = self.head.swap(null, .acquire);
+            var fifo: ?*Node = null;
+            while (node) |n| {
+                node = n.next;
+                n.next = fifo;
+                fifo = n;
+            }
+            return .{ .allocator = self.allocator, .node = fifo };
+        }
+
+        pub const Batch = struct {
+            allocator: std.mem.Allocator,
+            node: ?*Node,
+
+            /// returns the next value, or null when the batch is exhausted.
+            pub fn next(self: *Batch) ?T {
+                const n = self.node orelse return null;
+                defer self.allocator.destroy(n);
+                self.node = n.next;
+                return n.value;
+            }
+        };
+    };
+}
+
+test "MpscQueue" {
+    const t = std.testing;
+
+    var q = MpscQueue(u32).init(t.allocator);
+    defer q.deinit();
+    var batch = q.takeAll();
+    try t.expect(batch.next() == null);
+
+    try q.push(1);
+    try q.push(2);
+    try q.push(3);
+    batch = q.takeAll();
+    try t.expectEqual(@as(?u32, 1), batch.next());
+    try q.push(4); // not part of the batch
+    try t.expectEqual(@as(?u32, 2), batch.next());
+    try t.expectEqual(@as(?u32, 3), batch.next());
+    try t.expect(batch.next() == null);
+    try q.push(5);
+    // left for deinit
+}
+
+test "MpscQueue: concurrent producers" {
+    const t = std.testing;
+    const Q = MpscQueue(u32);
+    const nthreads = 4;
+    const per_thread = 1000;
+
+    var q = Q.init(std.heap.page_allocator);
+    defer q.deinit();
+    const producer = struct {
+        fn run(qq: *Q, id: u32) void {
+            var i: u32 = 0;
+            while (i < per_thread) : (i += 1) {
+                qq.push(id * per_thread + i) catch unreachable;
+            }
+        }
+    }.run;
+    var threads: [nthreads]std.Thread = undefined;
+    for (&threads, 0..) |*th, i| {
+        th.* = try std.Thread.spawn(.{}, producer, .{ &q, @as(u32, @intCast(i)) });
+    }
+
+    // values of each producer must come out in the order pushed.
+    var last = [_]?u32{null} ** nthreads;
+    var total: usize = 0;
+    while (total < nthreads * per_thread) {
+        var batch = q.takeAll();
+        while (batch.next()) |v| {
+            const id = v / per_thread;
+            if (last[id]) |prev| {
+                try t.expect(v > prev);
+            }
+            last[id] = v;
+            total += 1;
+        }
+        std.atomic.spinLoopHint();
+    }
+    for (threads) |th| {
+        th.join();
+    }
+    try t.expectEqual(@as(usize, nthreads * per_thread), total);
+}
@@ -1,11 +1,13 @@
 //! bitcoin main tab panel.
-//! all functions assume LVGL is init'ed and ui mutex is locked on entry.
+//! all functions assume LVGL is init'ed and are called from the UI thread.
 
 const std = @import("std");
 const fmt = std.fmt;
+const time = std.time;
 
 const lvgl = @import("lvgl.zig");
 const comm = @import("../comm.zig");
+const widget = @import("widget.zig");
 const xfmt = @import("../xfmt.zig");
 
 const logger = std.log.scoped(.ui);
@@ -15,37 +17,136 @@ const cmark = "#bbbbbb ";
 
 var tab: struct {
     // blockchain section
-    currblock: lvgl.Label,
-    timestamp: lvgl.Label,
-    blockhash: lvgl.Label,
-    diskusage: lvgl.Label,
-    conn_in: lvgl.Label,
-    conn_out: lvgl.Label,
+    chain_card: lvgl.Card,
+    /// minutes the shown data is behind, as last put in the card title;
+    /// null if current. see updateFreshness.
+    stale_min: ?u64,
+    currblock: lvgl.FmtCaption("{d}", struct { u64 }),
+    timestamp: lvgl.Caption,
+    blockhash: lvgl.FmtCaption("{s}\n{s}", struct { *const [32]u8, *const [32]u8 }),
+    diskusage: lvgl.Caption,
+    conn_in: lvgl.FmtCaption("{d}", struct { u16 }),
+    conn_out: lvgl.FmtCaption("{d}", struct { u16 }),
+    /// p2p download and upload rates.
+    traffic: lvgl.Caption,
+    /// initial block download pace; hidden once synced.
+    sync: lvgl.Caption,
+    /// bitcoind startup progress; hidden once bitcoind reports.
+    startup: lvgl.Label,
+    /// a UTXO snapshot bootstrap progress; hidden unless one is in progress.
+    bootstrap: lvgl.Label,
+    /// latest blocks, newest first.
+    recent_blocks: lvgl.Label,
     balance: struct {
         avail_bar: lvgl.Bar,
-        avail_pct: lvgl.Label,
-        total: lvgl.Label,
-        unconf: lvgl.Label,
-        locked: lvgl.Label,
-        reserved: lvgl.Label,
+        avail_pct: lvgl.Caption,
+        total: lvgl.Caption,
+        unconf: lvgl.Caption,
+        locked: lvgl.Caption,
+        reserved: lvgl.Caption,
+        trend: widget.TrendChart,
+    },
+    // onchain wallet transactions section
+    transactions: struct {
+        card: lvgl.Card,
+        empty: lvgl.Label, // shown when the history has no items
+        list: lvgl.RecycledList(TxRow),
+        /// transactions of the last page from nd, starting at history index
+        /// offset, newest first. allocated in arena, reset on every update.
+        data: []const comm.Message.OnchainTx,
+        offset: usize = 0,
+        arena: std.heap.ArenaAllocator,
+        /// whether any page was received from nd.
+        loaded: bool = false,
+        /// whether a page request is awaiting a reply.
+        requested: bool = false,
+
+        /// returns the transaction at index of the list, or null if not received yet.
+        fn at(self: @This(), index: usize) ?comm.Message.OnchainTx {
+            if (index < self.offset or index - self.offset >= self.data.len) {
+                return null;
+            }
+            return self.data[index - self.offset];
+        }
+
+        /// asks nd for a page of the history around index, unless a request
+        /// is already in flight. its reply rebinds all rows.
+        fn requestPage(self: *@This(), index: usize) !void {
+            if (self.requested) {
+                return;
+            }
+            const q: comm.Message.OnchainTxQuery = .{
+                .offset = std.math.lossyCast(u32, index -| tx_page_size / 2),
+                .limit = tx_page_size,
+            };
+            try comm.pipeWriteId(.{ .onchain_get_transactions = q }, comm.nextRequestId());
+            self.requested = true;
+        }
+    },
+    // onchain wallet unspent outputs section
+    utxos: struct {
+        card: lvgl.Card,
+        /// outputs count and amount by size bucket.
+        summary: lvgl.Label,
+        empty: lvgl.Label, // shown when the wallet has no outputs
+        list: lvgl.RecycledList(UtxoRow),
+        /// outputs of the last page from nd, starting at set index offset,
+        /// largest first. allocated in arena, reset on every update.
+        data: []const comm.Message.OnchainUtxo,
+        offset: usize = 0,
+        arena: std.heap.ArenaAllocator,
+        /// whether any page was received from nd.
+        loaded: bool = false,
+        /// whether a page request is awaiting a reply.
+        requested: bool = false,
+
+        /// returns the output at index of the list, or null if not received yet.
+        fn at(self: @This(), index: usize) ?comm.Message.OnchainUtxo {
+            if (index < self.offset or index - self.offset >= self.data.len) {
+                return null;
+            }
+            return self.data[index - self.offset];
+        }
+
+        /// asks nd for a page of outputs around index, unless a request
+        /// is already in flight. its reply rebinds all rows.
+        fn requestPage(self: *@This(), index: usize) !void {
+            if (self.requested) {
+                return;
+            }
+            const q: comm.Message.OnchainUtxoQuery = .{
+                .offset = std.math.lossyCast(u32, index -| utxo_page_size / 2),
+                .limit = utxo_page_size,
+            };
+            try comm.pipeWriteId(.{ .onchain_get_utxos = q }, comm.nextRequestId());
+            self.requested = true;
+        }
     },
     // mempool section
     mempool: struct {
-        txcount: lvgl.Label,
-        totalfee: lvgl.Label,
+        txcount: lvgl.FmtCaption("{d}", struct { usize }),
+        totalfee: lvgl.Caption,
         usage_bar: lvgl.Bar,
         usage_lab: lvgl.Label,
+        feerates: lvgl.Caption,
+        estimates: lvgl.Caption,
+        trend: widget.TrendChart,
     },
 } = undefined;
 
+/// at most so many fee rate buckets are shown, from the highest non-empty.
+const max_feerate_rows = 6;
+
 /// creates the tab content with all elements.
 /// must be called only once at UI init.
-pub fn initTabPanel(cont: lvgl.Container) !void {
+pub fn initTabPanel(allocator: std.mem.Allocator, cont: lvgl.Container) !void {
     const parent = cont.flex(.column, .{});
 
     // blockchain section
     {
-        const card = try lvgl.Card.new(parent, "BLOCKCHAIN", .{});
+        const card = try lvgl.Card.new(parent, "BLOCKCHAIN", .{ .scroll_snapshot = true });
+        tab.chain_card = card;
+        tab.stale_min = null;
         const row = try lvgl.FlexLayout.new(card, .row, .{});
         row.setWidth(lvgl.sizePercent(100));
         row.setHeightToContent();
@@ -55,21 +156,33 @@ pub fn initTabPanel(cont: lvgl.Container) !void {
         left.setWidth(lvgl.sizePercent(50));
         left.setHeightToContent();
         left.setPad(10, .row, .{});
-        tab.currblock = try lvgl.Label.new(left, "HEIGHT\n", .{ .recolor = true });
-        tab.timestamp = try lvgl.Label.new(left, "TIMESTAMP\n", .{ .recolor = true });
-        tab.blockhash = try lvgl.Label.new(left, "BLOCK HASH\n", .{ .recolor = true });
+        try tab.currblock.init(left, "HEIGHT");
+        tab.timestamp = try lvgl.Caption.new(left, "TIMESTAMP");
+        try tab.blockhash.init(left, "BLOCK HASH");
         // right column
         const right = try lvgl.FlexLayout.new(row, .column, .{});
         right.setWidth(lvgl.sizePercent(50));
         right.setHeightToContent();
         right.setPad(10, .row, .{});
-        tab.diskusage = try lvgl.Label.new(right, "DISK USAGE\n", .{ .recolor = true });
-        tab.conn_in = try lvgl.Label.new(right, "CONNECTIONS IN\n", .{ .recolor = true });
-        tab.conn_out = try lvgl.Label.new(right, "CONNECTIONS OUT\n", .{ .recolor = true });
+        tab.diskusage = try lvgl.Caption.new(right, "DISK USAGE");
+        try tab.conn_in.init(right, "CONNECTIONS IN");
+        try tab.conn_out.init(right, "CONNECTIONS OUT");
+        tab.traffic = try lvgl.Caption.new(right, "P2P TRAFFIC");
+        tab.startup = try lvgl.Label.new(card, "STARTING UP\n", .{ .recolor = true });
+        tab.startup.hide();
+        tab.sync = try lvgl.Caption.new(card, "SYNC");
+        tab.sync.hide();
+        tab.bootstrap = try lvgl.Label.new(card, "BOOTSTRAP\n", .{ .recolor = true });
+        tab.bootstrap.hide();
+    }
+    // recent blocks section
+    {
+        const card = try lvgl.Card.new(parent, "RECENT BLOCKS", .{ .scroll_snapshot = true });
+        tab.recent_blocks = try lvgl.Label.new(card, "none yet", .{ .recolor = true });
     }
     // balance section
     {
-        const card = try lvgl.Card.new(parent, "ON-CHAIN BALANCE", .{});
+        const card = try lvgl.Card.new(parent, "ON-CHAIN BALANCE", .{ .scroll_snapshot = true });
         const row = try lvgl.FlexLayout.new(card, .row, .{});
         row.setWidth(lvgl.sizePercent(100));
         row.setHeightToContent();
@@ -80,20 +193,53 @@ pub fn initTabPanel(cont: lvgl.Container) !void {
         left.setPad(8, .top, .{});
         left.setPad(10, .row, .{});
         tab.balance.avail_bar = try lvgl.Bar.new(left);
-        tab.balance.avail_pct = try lvgl.Label.new(left, "AVAILABLE\n", .{ .recolor = true });
-        tab.balance.total = try lvgl.Label.new(left, "TOTAL\n", .{ .recolor = true });
+        tab.balance.avail_pct = try lvgl.Caption.new(left, "AVAILABLE");
+        tab.balance.total = try lvgl.Caption.new(left, "TOTAL");
         // right column
         const right = try lvgl.FlexLayout.new(row, .column, .{});
         right.setWidth(lvgl.sizePercent(50));
         right.setHeightToContent();
         right.setPad(10, .row, .{});
-        tab.balance.locked = try lvgl.Label.new(right, "LOCKED\n", .{ .recolor = true });
-        tab.balance.reserved = try lvgl.Label.new(right, "RESERVED\n", .{ .recolor = true });
-        tab.balance.unconf = try lvgl.Label.new(right, "UNCONFIRMED\n", .{ .recolor = true });
+        tab.balance.locked = try lvgl.Caption.new(right, "LOCKED");
+        tab.balance.reserved = try lvgl.Caption.new(right, "RESERVED");
+        tab.balance.unconf = try lvgl.Caption.new(right, "UNCONFIRMED");
+        try tab.balance.trend.init(card, &.{
+            .{ .kind = .onchain_balance, .color = lvgl.Palette.main(.orange) },
+        }, .{ .unit = " sat" });
+    }
+    // transactions section
+    {
+        tab.transactions.card = try lvgl.Card.new(parent, "TRANSACTIONS", .{});
+        tab.transactions.empty = try lvgl.Label.new(tab.transactions.card, "no wallet transactions yet.", .{});
+        tab.transactions.data = &.{};
+        tab.transactions.offset = 0;
+        tab.transactions.loaded = false;
+        tab.transactions.requested = false;
+        tab.transactions.arena = std.heap.ArenaAllocator.init(allocator);
+        try tab.transactions.list.init(allocator, tab.transactions.card, cont, .{
+            .row_height = tx_row_height,
+            .gap = 10,
+        });
+    }
+    // unspent outputs section
+    {
+        tab.utxos.card = try lvgl.Card.new(parent, "UNSPENT OUTPUTS", .{});
+        tab.utxos.summary = try lvgl.Label.new(tab.utxos.card, null, .{ .recolor = true });
+        tab.utxos.summary.hide();
+        tab.utxos.empty = try lvgl.Label.new(tab.utxos.card, "listing unspent outputs...", .{});
+        tab.utxos.data = &.{};
+        tab.utxos.offset = 0;
+        tab.utxos.loaded = false;
+        tab.utxos.requested = false;
+        tab.utxos.arena = std.heap.ArenaAllocator.init(allocator);
+        try tab.utxos.list.init(allocator, tab.utxos.card, cont, .{
+            .row_height = utxo_row_height,
+            .gap = 10,
+        });
     }
     // mempool section
     {
-        const card = try lvgl.Card.new(parent, "MEMPOOL", .{});
+        const card = try lvgl.Card.new(parent, "MEMPOOL", .{ .scroll_snapshot = true });
         const row = try lvgl.FlexLayout.new(card, .row, .{});
         row.setWidth(lvgl.sizePercent(100));
         row.clearFlag(.scrollable);
@@ -103,26 +249,128 @@ pub fn initTabPanel(cont: lvgl.Container) !void {
         left.setPad(10, .row, .{});
         tab.mempool.usage_bar = try lvgl.Bar.new(left);
         tab.mempool.usage_lab = try lvgl.Label.new(left, "0Mb out of 0Mb (0%)", .{ .recolor = true });
+        tab.mempool.feerates = try lvgl.Caption.new(left, "BY FEE RATE");
+        tab.mempool.feerates.hide();
         const right = try lvgl.FlexLayout.new(row, .column, .{});
         right.setWidth(lvgl.sizePercent(50));
         right.setPad(10, .row, .{});
-        tab.mempool.txcount = try lvgl.Label.new(right, "TRANSACTIONS COUNT\n", .{ .recolor = true });
-        tab.mempool.totalfee = try lvgl.Label.new(right, "TOTAL FEES\n", .{ .recolor = true });
+        try tab.mempool.txcount.init(right, "TRANSACTIONS COUNT");
+        tab.mempool.totalfee = try lvgl.Caption.new(right, "TOTAL FEES");
+        tab.mempool.estimates = try lvgl.Caption.new(right, "FEE ESTIMATES");
+        tab.mempool.estimates.hide();
+        try tab.mempool.trend.init(card, &.{
+            .{ .kind = .mempool_txcount, .color = lvgl.Palette.main(.light_blue) },
+        }, .{ .unit = " tx" });
     }
 }
 
+/// shows bitcoind startup progress until the next updateTabPanel.
+pub fn updateStartup(rep: comm.Message.BitcoindStartup) !void {
+    var buf: [256]u8 = undefined;
+    if (rep.progress) |pct| {
+        try tab.startup.setTextFmt(&buf, cmark ++ "STARTING UP#\n{s} {d}%", .{ rep.phase, pct });
+    } else {
+        try tab.startup.setTextFmt(&buf, cmark ++ "STARTING UP#\n{s}", .{rep.phase});
+    }
+    tab.startup.show();
+}
+
+/// updates the bootstrap progress in the blockchain section.
+/// the label remains visible once done until ngui restarts.
+pub fn updateBootstrap(rep: comm.Message.BitcoinBootstrap) !void {
+    var buf: [256]u8 = undefined;
+    const label = cmark ++ "UTXO SNAPSHOT BOOTSTRAP#\n";
+    switch (rep.state) {
+        .downloading => if (rep.size) |size| {
+            const pct = if (size == 0) 0 else @min(100, rep.downloaded * 100 / size);
+            try tab.bootstrap.setTextFmt(&buf, label ++ "downloading {:.1} out of {:.1} ({d}%)", .{
+                fmt.fmtIntSizeBin(rep.downloaded),
+                fmt.fmtIntSizeBin(size),
+                pct,
+            });
+        } else {
+            try tab.bootstrap.setTextFmt(&buf, label ++ "downloading {:.1}", .{fmt.fmtIntSizeBin(rep.downloaded)});
+        },
+        .loading => try tab.bootstrap.setTextFmt(&buf, label ++ "loading the snapshot into bitcoind", .{}),
+        .validating => try tab.bootstrap.setTextFmt(&buf, label ++ "synced from block {d}; validated {d} out of {d} in the background", .{
+            rep.height,
+            rep.validated,
+            rep.height,
+        }),
+        .done => try tab.bootstrap.setTextFmt(&buf, label ++ "fully validated up to block {d}", .{rep.height}),
+        .failed => try tab.bootstrap.setTextFmt(&buf, label ++ "failed; syncing from genesis", .{}),
+    }
+    tab.bootstrap.show();
+}
+
 /// updates the tab with new data from the report.
 /// the tab must be inited first with initTabPanel.
 pub fn updateTabPanel(rep: comm.Message.OnchainReport) !void {
     var buf: [512]u8 = undefined;
 
     // blockchain section
-    try tab.currblock.setTextFmt(&buf, cmark ++ "HEIGHT#\n{d}", .{rep.blocks});
-    try tab.timestamp.setTextFmt(&buf, cmark ++ "TIMESTAMP#\n{}", .{xfmt.unix(rep.timestamp)});
-    try tab.blockhash.setTextFmt(&buf, cmark ++ "BLOCK HASH#\n{s}\n{s}", .{ rep.hash[0..32], rep.hash[32..] });
-    try tab.diskusage.setTextFmt(&buf, cmark ++ "DISK USAGE#\n{:.1}", .{fmt.fmtIntSizeBin(rep.diskusage)});
-    try tab.conn_in.setTextFmt(&buf, cmark ++ "CONNECTIONS IN#\n{d}", .{rep.conn_in});
-    try tab.conn_out.setTextFmt(&buf, cmark ++ "CONNECTIONS OUT#\n{d}", .{rep.conn_out});
+    if (rep.stale_sec) |sec| {
+        // restored by nd from a previous run, or bitcoind is slow to report.
+        const ns = sec / time.s_per_min * time.ns_per_min; // minutes precision
+        try tab.startup.setTextFmt(&buf, cmark ++ "LAST KNOWN#\nas of {} ago", .{fmt.fmtDuration(ns)});
+        tab.startup.show();
+    } else {
+        tab.startup.hide();
+    }
+    try tab.currblock.set(.{rep.blocks});
+    try tab.timestamp.setValueFmt(&buf, "{}", .{xfmt.unix(rep.timestamp)});
+    const hash = rep.hash.hex();
+    try tab.blockhash.set(.{ hash[0..32], hash[32..] });
+    try tab.diskusage.setValueFmt(&buf, "{:.1}", .{fmt.fmtIntSizeBin(rep.diskusage)});
+    try tab.conn_in.set(.{rep.conn_in});
+    try tab.conn_out.set(.{rep.conn_out});
+    if (rep.net) |net| {
+        try tab.traffic.setValueFmt(&buf, "{:.1}/s in\n{:.1}/s out", .{
+            fmt.fmtIntSizeBin(net.recv_bytes_per_sec),
+            fmt.fmtIntSizeBin(net.sent_bytes_per_sec),
+        });
+    } else {
+        try tab.traffic.setValueFmt(&buf, "measuring...", .{});
+    }
+    if (rep.sync) |sync| {
+        // disk rate against blocks rate tells whether storage or verification
+        // holds the sync back.
+        const pace = "{d}% verified, {d:.0} blocks/min, {:.1}/s to disk";
+        const args = .{ rep.verifyprogress, sync.blocks_per_min, fmt.fmtIntSizeBin(sync.disk_bytes_per_sec) };
+        if (sync.eta_sec) |sec| {
+            const ns = sec / time.s_per_min * time.ns_per_min; // minutes precision
+            try tab.sync.setValueFmt(&buf, pace ++ "\nabout {} left", args ++ .{fmt.fmtDuration(ns)});
+        } else {
+            try tab.sync.setValueFmt(&buf, pace ++ "\nstalled", args);
+        }
+        tab.sync.show();
+    } else {
+        tab.sync.hide();
+    }
+
+    // recent blocks section
+    if (rep.recent_blocks.len > 0) {
+        var blocksbuf: [1024]u8 = undefined;
+        var fbs = std.io.fixedBufferStream(&blocksbuf);
+        const w = fbs.writer();
+        for (rep.recent_blocks, 0..) |b, i| {
+            if (i > 0) {
+                try w.writeByte('\n');
+            }
+            try w.print(cmark ++ "{d}# {}\n{d} tx, {d}-{d} sat/vB, {:.1}", .{
+                b.height,
+                xfmt.unix(b.time),
+                b.txs,
+                b.minfeerate,
+                b.maxfeerate,
+                fmt.fmtIntSizeDec(b.size),
+            });
+        }
+        try w.writeByte(0);
+        tab.recent_blocks.setText(blocksbuf[0 .. fbs.pos - 1 :0]);
+    } else if (rep.ibd) {
+        tab.recent_blocks.setText("available once synced");
+    }
 
     // balance section
     if (rep.balance) |bal| {
@@ -137,14 +385,21 @@ pub fn updateTabPanel(rep: comm.Message.OnchainReport) !void {
             break :pct @floatCast(v * 100);
         };
         tab.balance.avail_bar.setValue(@as(i32, @intFromFloat(@round(confpct))));
-        try tab.balance.avail_pct.setTextFmt(&buf, cmark ++ "AVAILABLE#\n{} sat ({d:.1}%)", .{
+        try tab.balance.avail_pct.setValueFmt(&buf, "{} sat ({d:.1}%)", .{
             xfmt.imetric(bal.confirmed),
             confpct,
         });
-        try tab.balance.total.setTextFmt(&buf, cmark ++ "TOTAL#\n{} sat", .{xfmt.imetric(bal.total)});
-        try tab.balance.unconf.setTextFmt(&buf, cmark ++ "UNCONFIRMED#\n{} sat", .{xfmt.imetric(bal.unconfirmed)});
-        try tab.balance.locked.setTextFmt(&buf, cmark ++ "LOCKED#\n{} sat", .{xfmt.imetric(bal.locked)});
-        try tab.balance.reserved.setTextFmt(&buf, cmark ++ "RESERVED#\n{} sat", .{xfmt.imetric(bal.reserved)});
+        try tab.balance.total.setValueFmt(&buf, "{} sat", .{xfmt.imetric(bal.total)});
+        try tab.balance.unconf.setValueFmt(&buf, "{} sat", .{xfmt.imetric(bal.unconfirmed)});
+        try tab.balance.locked.setValueFmt(&buf, "{} sat", .{xfmt.imetric(bal.locked)});
+        try tab.balance.reserved.setValueFmt(&buf, "{} sat", .{xfmt.imetric(bal.reserved)});
+        // transactions section: nd sends pages only on request.
+        if (!tab.transactions.loaded) {
+            tab.transactions.requestPage(0) catch |err| logger.err("transactions requestPage: {any}", .{err});
+        }
+        if (!tab.utxos.loaded) {
+            tab.utxos.requestPage(0) catch |err| logger.err("utxos requestPage: {any}", .{err});
+        }
     }
 
     // mempool section
@@ -164,6 +419,237 @@ pub fn updateTabPanel(rep: comm.Message.OnchainReport) !void {
         fmt.fmtIntSizeBin(rep.mempool.max),
         mempool_pct,
     });
-    try tab.mempool.txcount.setTextFmt(&buf, cmark ++ "TRANSACTIONS COUNT#\n{d}", .{rep.mempool.txcount});
-    try tab.mempool.totalfee.setTextFmt(&buf, cmark ++ "TOTAL FEES#\n{d:10} BTC", .{rep.mempool.totalfee});
+    try tab.mempool.txcount.set(.{rep.mempool.txcount});
+    try tab.mempool.totalfee.setValueFmt(&buf, "{d:10} BTC", .{rep.mempool.totalfee});
+    if (rep.mempool.estimates) |est| {
+        try tab.mempool.estimates.setValueFmt(&buf, "next block {d:.1}, 1h {d:.1}, 1d {d:.1} sat/vB", .{
+            est.next_block,
+            est.hour,
+            est.day,
+        });
+        tab.mempool.estimates.show();
+    } else {
+        tab.mempool.estimates.hide();
+    }
+    if (rep.mempool.feerates.len > 0) {
+        var fbs = std.io.fixedBufferStream(&buf);
+        const w = fbs.writer();
+        var rows: usize = 0;
+        var i = rep.mempool.feerates.len;
+        while (i > 0 and rows < max_feerate_rows) {
+            i -= 1;
+            const b = rep.mempool.feerates[i];
+            if (b.count == 0) {
+                continue;
+            }
+            const vmb = @as(f64, @floatFromInt(b.vsize)) / 1e6;
+            if (rows > 0) {
+                try w.writeByte('\n');
+            }
+            try w.print("{d}+ sat/vB: {d:.2} MvB, {d} tx", .{ b.min, vmb, b.count });
+            rows += 1;
+        }
+        try w.writeByte(0);
+        tab.mempool.feerates.value.setText(buf[0 .. fbs.pos - 1 :0]);
+        tab.mempool.feerates.show();
+    } else {
+        tab.mempool.feerates.hide();
+    }
+}
+
+/// updates the tab trend charts with new data from the report.
+/// the tab must be inited first with initTabPanel.
+/// marks the blockchain card as behind by age_sec, or current if null, as nd
+/// failed to collect onchain reports for a while. the title changes only once
+/// a minute at most, so that a periodic check is cheap.
+pub fn updateFreshness(age_sec: ?u64) !void {
+    const min: ?u64 = if (age_sec) |sec| sec / time.s_per_min else null;
+    if (std.meta.eql(min, tab.stale_min)) {
+        return;
+    }
+    tab.stale_min = min;
+    if (min) |m| {
+        var buf: [64]u8 = undefined;
+        try tab.chain_card.title.setTextFmt(&buf, "BLOCKCHAIN - AS OF {} AGO", .{fmt.fmtDuration(m * time.ns_per_min)});
+    } else {
+        tab.chain_card.title.setText("BLOCKCHAIN");
+    }
 }
+
+pub fn updateHistory(rep: comm.Message.HistoryReport) void {
+    tab.balance.trend.update(rep);
+    tab.mempool.trend.update(rep);
+}
+
+/// shows a page of the onchain transactions history from nd, a reply to an
+/// onchain_get_transactions request or resent by nd when the history changes.
+/// the tab must be inited first with initTabPanel.
+pub fn updateTransactionsPage(page: comm.Message.OnchainTxPage) !void {
+    const txs = &tab.transactions;
+    txs.requested = false;
+    txs.loaded = true;
+    const bulk = lvgl.beginBulkUpdate(txs.card);
+    defer bulk.end();
+    _ = txs.arena.reset(.retain_capacity);
+    txs.offset = page.query.offset;
+    if (page.total == 0) {
+        txs.empty.show();
+    } else {
+        txs.empty.hide();
+    }
+    txs.data = comm.dupeDeep([]const comm.Message.OnchainTx, txs.arena.allocator(), page.transactions) catch |err| {
+        txs.data = &.{};
+        txs.list.update(0) catch {};
+        return err;
+    };
+    try txs.list.update(page.total);
+}
+
+/// shows a page of the onchain wallet unspent outputs from nd, a reply to an
+/// onchain_get_utxos request or resent by nd when the outputs change.
+/// the tab must be inited first with initTabPanel.
+pub fn updateUtxosPage(page: comm.Message.OnchainUtxoPage) !void {
+    const utxos = &tab.utxos;
+    utxos.requested = false;
+    // nd resends the page once listed.
+    utxos.loaded = page.loaded;
+    const bulk = lvgl.beginBulkUpdate(utxos.card);
+    defer bulk.end();
+    _ = utxos.arena.reset(.retain_capacity);
+    utxos.offset = page.query.offset;
+    if (page.total == 0) {
+        utxos.empty.setText(if (page.loaded) "no unspent outputs." else "listing unspent outputs...");
+        utxos.empty.show();
+        utxos.summary.hide();
+    } else {
+        utxos.empty.hide();
+        try setUtxoSummary(page.buckets);
+        utxos.summary.show();
+    }
+    utxos.data = comm.dupeDeep([]const comm.Message.OnchainUtxo, utxos.arena.allocator(), page.utxos) catch |err| {
+        utxos.data = &.{};
+        utxos.list.update(0) catch {};
+        return err;
+    };
+    try utxos.list.update(page.total);
+}
+
+/// formats the non-empty size buckets, one per line, largest first.
+fn setUtxoSummary(buckets: []const comm.Message.OnchainUtxoPage.Bucket) !void {
+    var buf: [512]u8 = undefined;
+    var fbs = std.io.fixedBufferStream(&buf);
+    const w = fbs.writer();
+    var i = buckets.len;
+    while (i > 0) {
+        i -= 1;
+        const b = buckets[i];
+        if (b.count == 0) {
+            continue;
+        }
+        if (fbs.pos > 0) {
+            try w.writeByte('\n');
+        }
+        if (i + 1 == buckets.len) {
+            try w.print(cmark ++ "{} sat and over:# ", .{xfmt.umetric(b.min)});
+        } else if (b.min == 0) {
+            try w.print(cmark ++ "below {} sat:# ", .{xfmt.umetric(buckets[i + 1].min)});
+        } else {
+            try w.print(cmark ++ "{} to {} sat:# ", .{ xfmt.umetric(b.min), xfmt.umetric(buckets[i + 1].min) });
+        }
+        try w.print("{d} totaling {} sat", .{ b.count, xfmt.umetric(b.amount) });
+    }
+    try w.writeByte(0);
+    const text = fbs.getWritten();
+    tab.utxos.summary.setText(text[0 .. text.len - 1 :0]);
+}
+
+/// height of a transaction row in the transactions card, including the gap between rows.
+const tx_row_height: lvgl.Coord = 80;
+
+/// number of transactions requested from nd at once.
+const tx_page_size = 20;
+
+/// height of an output row in the unspent outputs card, including the gap between rows.
+const utxo_row_height: lvgl.Coord = 80;
+
+/// number of unspent outputs requested from nd at once.
+const utxo_page_size = 20;
+
+/// widgets of a single transaction in the transactions card, re-used by
+/// tab.transactions.list for whichever item is scrolled into its position.
+const TxRow = struct {
+    lvobj: *lvgl.LvObj, // item box container
+    title: lvgl.Label, // direction and amount
+    detail: lvgl.Label, // time, confirmations and label
+
+    pub usingnamespace lvgl.BaseObjMethods;
+
+    pub fn new(parent: lvgl.Container) !TxRow {
+        const box = (try lvgl.Container.new(parent)).flex(.column, .{});
+        errdefer box.destroy();
+        box.setWidth(lvgl.sizePercent(100));
+        box.clearFlag(.scrollable); // height is set by the list
+        const title = try lvgl.Label.new(box, null, .{ .recolor = true });
+        const detail = try lvgl.Label.new(box, null, .{ .long_mode = .dot });
+        detail.setWidth(lvgl.sizePercent(100));
+        return .{ .lvobj = box.lvobj, .title = title, .detail = detail };
+    }
+
+    /// shows the transaction at index of the list. one not received yet is
+    /// requested from nd and the row stays hidden until it arrives.
+    pub fn bind(self: *TxRow, index: usize) !void {
+        const tx = tab.transactions.at(index) orelse {
+            self.hide();
+            return tab.transactions.requestPage(index);
+        };
+        var buf: [256]u8 = undefined;
+        if (tx.amount >= 0) {
+            try self.title.setTextFmt(&buf, "#00ff00 RECEIVED# {} sat", .{xfmt.imetric(tx.amount)});
+        } else {
+            try self.title.setTextFmt(&buf, "#ffff00 SENT# {} sat, fee {} sat", .{ xfmt.imetric(-tx.amount), xfmt.imetric(tx.fee) });
+        }
+        var confbuf: [32]u8 = undefined;
+        const conf = if (tx.confirmations == 0)
+            "unconfirmed"
+        else
+            try fmt.bufPrint(&confbuf, "{d} conf", .{tx.confirmations});
+        try self.detail.setTextFmt(&buf, "{}  {s}  {s}", .{ xfmt.unix(tx.time), conf, tx.label });
+    }
+};
+
+/// widgets of a single output in the unspent outputs card, re-used by
+/// tab.utxos.list for whichever item is scrolled into its position.
+const UtxoRow = struct {
+    lvobj: *lvgl.LvObj, // item box container
+    title: lvgl.Label, // amount and confirmations
+    detail: lvgl.Label, // outpoint and address
+
+    pub usingnamespace lvgl.BaseObjMethods;
+
+    pub fn new(parent: lvgl.Container) !UtxoRow {
+        const box = (try lvgl.Container.new(parent)).flex(.column, .{});
+        errdefer box.destroy();
+        box.setWidth(lvgl.sizePercent(100));
+        box.clearFlag(.scrollable); // height is set by the list
+        const title = try lvgl.Label.new(box, null, .{ .recolor = true });
+        const detail = try lvgl.Label.new(box, null, .{ .long_mode = .dot });
+        detail.setWidth(lvgl.sizePercent(100));
+        return .{ .lvobj = box.lvobj, .title = title, .detail = detail };
+    }
+
+    /// shows the output at index of the list. one not received yet is
+    /// requested from nd and the row stays hidden until it arrives.
+    pub fn bind(self: *UtxoRow, index: usize) !void {
+        const utxo = tab.utxos.at(index) orelse {
+            self.hide();
+            return tab.utxos.requestPage(index);
+        };
+        var buf: [256]u8 = undefined;
+        if (utxo.confirmations == 0) {
+            try self.title.setTextFmt(&buf, "{} sat  #ffff00 unconfirmed#", .{xfmt.imetric(utxo.amount)});
+        } else {
+            try self.title.setTextFmt(&buf, "{} sat  " ++ cmark ++ "{d} conf#", .{ xfmt.imetric(utxo.amount), utxo.confirmations });
+        }
+        try self.detail.setTextFmt(&buf, "{}  {s}", .{ utxo.outpoint, utxo.address });
+    }
+};
@@ -0,0 +1,909 @@
+/**
+ * OpenGL ES 2 drawing for LVGL, on top of the software renderer, RGB565 only;
+ * the EGL context is set up by drv_drmgl.c.
+ *
+ * the screen is a persistent RGBA texture attached to a framebuffer object,
+ * with rows in LVGL order, which the display driver presents after each frame.
+ * LVGL renders into it in direct mode. the draw context is the regular
+ * software one with these replaced:
+ * - draw_rect: backgrounds and full borders, with or without radius, as quads
+ *   shaded by a rounded rectangle distance function. shadows, gradients,
+ *   background images, outlines and partial borders go through
+ *   lv_draw_sw_rect, with the other parts of the rectangle turned off.
+ * - draw_img_decoded: true color images, with or without alpha, uploaded to a
+ *   texture and blitted. transformed or recolored images and the other color
+ *   formats are left to the software renderer.
+ * - draw_letter: glyphs cached in an alpha atlas texture; consecutive letters
+ *   of the same color are drawn in a single call.
+ * - blend: whatever the software renderer still produces, like arcs, lines or
+ *   anything under an active LVGL mask, as a quad textured with its mask and
+ *   pixels. consecutive rows of a masked fill are drawn in a single call.
+ * every op goes the software way when the draw buffer is not the screen, as
+ * with layers and snapshots which LVGL renders in memory.
+ *
+ * GL is entered from the UI thread only.
+ */
+
+#include "lvgl/lvgl.h"
+#include "lvgl/src/draw/sw/lv_draw_sw.h"
+
+#include <GLES2/gl2.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if LV_COLOR_DEPTH != 16 || LV_COLOR_16_SWAP != 0
+#error "draw_gles.c requires LV_COLOR_DEPTH 16 and LV_COLOR_16_SWAP 0"
+#endif
+
+#define ATLAS_SIZE 512
+#define ATLAS_SLOTS 1024 /* glyph hash table size; a power of 2 */
+#define MAX_BATCH_QUADS 256
+#define FLOATS_PER_VERT 6 /* x, y, src u, v, mask u, v */
+#define VERTS_PER_QUAD 6
+
+enum { ATTR_POS, ATTR_UV, ATTR_MUV };
+
+enum batch_kind {
+    BATCH_NONE,
+    BATCH_ROWS, /* mask rows of a solid fill, stacked in gl.rows */
+    BATCH_GLYPHS, /* atlas quads in gl.verts */
+};
+
+struct tex {
+    GLuint id;
+    GLsizei w, h;
+    GLenum format, type;
+};
+
+struct glyph {
+    const lv_font_t *font; /* NULL if the slot is free */
+    uint32_t letter;
+    uint16_t x, y; /* position in the atlas */
+};
+
+static struct {
+    void *screen; /* the display draw buffer; stands for the FBO */
+    lv_coord_t w, h;
+    GLuint fbo;
+    struct tex screen_tex, src_tex, mask_tex, atlas_tex;
+
+    struct {
+        GLuint id;
+        GLint color, use_src, use_mask;
+    } blend_prog;
+    struct {
+        GLuint id;
+        GLint color, outer, rout, inner, rin, ring;
+    } rect_prog;
+    GLuint present_prog;
+
+    /* glyph atlas, shelf packed and emptied as a whole when full */
+    struct glyph glyphs[ATLAS_SLOTS];
+    uint32_t nglyphs;
+    uint16_t shelf_x, shelf_y, shelf_h;
+
+    /* pending draw calls; see flush_batch */
+    enum batch_kind batch;
+    lv_area_t batch_clip;
+    lv_area_t batch_area; /* rows covered so far */
+    lv_color_t batch_color;
+    lv_opa_t batch_opa;
+    lv_blend_mode_t batch_mode;
+    GLfloat verts[MAX_BATCH_QUADS * VERTS_PER_QUAD * FLOATS_PER_VERT];
+    uint32_t nquads;
+    uint8_t *rows;
+    size_t rows_cap;
+
+    /* image conversion and glyph decoding */
+    uint8_t *scratch;
+    size_t scratch_cap;
+} gl;
+
+#define GLSL_PRECISION                                                                                                 \
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"                                                                              \
+    "precision highp float;\n"                                                                                         \
+    "#else\n"                                                                                                          \
+    "precision mediump float;\n"                                                                                       \
+    "#endif\n"
+
+/* a_pos is in LVGL pixels, at pixel edges */
+static const char *draw_vert_src =
+    "attribute vec2 a_pos;\n"
+    "attribute vec2 a_uv;\n"
+    "attribute vec2 a_muv;\n"
+    "uniform vec2 u_scale;\n"
+    "varying vec2 v_px;\n"
+    "varying vec2 v_uv;\n"
+    "varying vec2 v_muv;\n"
+    "void main() {\n"
+    "    v_px = a_pos;\n"
+    "    v_uv = a_uv;\n"
+    "    v_muv = a_muv;\n"
+    "    gl_Position = vec4(a_pos * u_scale - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+/* a solid color or an image, with an optional alpha mask; premultiplied out */
+static const char *blend_frag_src =
+    GLSL_PRECISION
+    "uniform vec4 u_color;\n"
+    "uniform float u_use_src;\n"
+    "uniform float u_use_mask;\n"
+    "uniform sampler2D u_src;\n"
+    "uniform sampler2D u_mask;\n"
+    "varying vec2 v_uv;\n"
+    "varying vec2 v_muv;\n"
+    "void main() {\n"
+    "    vec4 c = u_color;\n"
+    "    if (u_use_src > 0.5) {\n"
+    "        vec4 s = texture2D(u_src, v_uv);\n"
+    "        c = vec4(s.rgb, c.a * s.a);\n"
+    "    }\n"
+    "    if (u_use_mask > 0.5) {\n"
+    "        c.a *= texture2D(u_mask, v_muv).a;\n"
+    "    }\n"
+    "    gl_FragColor = vec4(c.rgb * c.a, c.a);\n"
+    "}\n";
+
+/* rounded rectangles and rings, antialiased over the outermost pixel.
+ * rects are pixel edges: x1, y1, x2 + 1, y2 + 1. */
+static const char *rect_frag_src =
+    GLSL_PRECISION
+    "uniform vec4 u_color;\n"
+    "uniform vec4 u_outer;\n"
+    "uniform float u_rout;\n"
+    "uniform vec4 u_inner;\n"
+    "uniform float u_rin;\n"
+    "uniform float u_ring;\n"
+    "varying vec2 v_px;\n"
+    "float rrect(vec4 r, float rad) {\n"
+    "    vec2 q = abs(v_px - (r.xy + r.zw) * 0.5) - (r.zw - r.xy) * 0.5 + rad;\n"
+    "    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - rad;\n"
+    "}\n"
+    "void main() {\n"
+    "    float a = clamp(0.5 - rrect(u_outer, u_rout), 0.0, 1.0);\n"
+    "    if (u_ring > 0.5) {\n"
+    "        a *= clamp(0.5 + rrect(u_inner, u_rin), 0.0, 1.0);\n"
+    "    }\n"
+    "    a *= u_color.a;\n"
+    "    gl_FragColor = vec4(u_color.rgb * a, a);\n"
+    "}\n";
+
+/* the screen texture onto the default framebuffer */
+static const char *present_vert_src =
+    "attribute vec2 a_pos;\n"
+    "attribute vec2 a_uv;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "    v_uv = a_uv;\n"
+    "    gl_Position = vec4(a_pos, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *present_frag_src =
+    GLSL_PRECISION
+    "uniform sampler2D u_src;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "    gl_FragColor = vec4(texture2D(u_src, v_uv).rgb, 1.0);\n"
+    "}\n";
+
+static GLuint compile_shader(GLenum type, const char *src)
+{
+    GLuint sh = glCreateShader(type);
+    glShaderSource(sh, 1, &src, NULL);
+    glCompileShader(sh);
+    GLint ok = 0;
+    glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetShaderInfoLog(sh, sizeof(log), NULL, log);
+        LV_LOG_ERROR("GL shader: %s", log);
+        glDeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+/* returns 0 on error */
+static GLuint link_program(const char *vert_src, const char *frag_src)
+{
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vert_src);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, frag_src);
+    if (vs == 0 || fs == 0) {
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return 0;
+    }
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glBindAttribLocation(prog, ATTR_POS, "a_pos");
+    glBindAttribLocation(prog, ATTR_UV, "a_uv");
+    glBindAttribLocation(prog, ATTR_MUV, "a_muv");
+    glLinkProgram(prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint ok = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+        LV_LOG_ERROR("GL program: %s", log);
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
+
+/* sets up the samplers and pixel scale of a drawing program */
+static void init_program(GLuint prog)
+{
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "u_src"), 0);
+    glUniform1i(glGetUniformLocation(prog, "u_mask"), 1);
+    glUniform2f(glGetUniformLocation(prog, "u_scale"), 2.0f / gl.w, 2.0f / gl.h);
+}
+
+static void init_tex(struct tex *t, GLenum format, GLenum type)
+{
+    glGenTextures(1, &t->id);
+    glBindTexture(GL_TEXTURE_2D, t->id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    t->w = 0;
+    t->h = 0;
+    t->format = format;
+    t->type = type;
+}
+
+/* replaces the whole texture contents, bound to texture unit. the storage is
+ * reused if the size and format are the same as the last upload's. */
+static void upload_tex(struct tex *t, GLuint unit, GLenum format, GLenum type, GLsizei w, GLsizei h, const void *px)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, t->id);
+    if (t->w == w && t->h == h && t->format == format && t->type == type) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type, px);
+        return;
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, type, px);
+    t->w = w;
+    t->h = h;
+    t->format = format;
+    t->type = type;
+}
+
+static void bind_tex(const struct tex *t, GLuint unit)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, t->id);
+}
+
+/* returns NULL if out of memory */
+static uint8_t *grow(uint8_t **buf, size_t *cap, size_t size)
+{
+    if (size > *cap) {
+        uint8_t *p = realloc(*buf, size);
+        if (p == NULL) {
+            return NULL;
+        }
+        *buf = p;
+        *cap = size;
+    }
+    return *buf;
+}
+
+static bool area_eq(const lv_area_t *a, const lv_area_t *b)
+{
+    return a->x1 == b->x1 && a->y1 == b->y1 && a->x2 == b->x2 && a->y2 == b->y2;
+}
+
+static void set_blend_mode(lv_blend_mode_t mode)
+{
+    /* fragments are premultiplied */
+    switch (mode) {
+        case LV_BLEND_MODE_ADDITIVE:
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_ONE, GL_ONE);
+            break;
+        case LV_BLEND_MODE_SUBTRACTIVE:
+            glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+            glBlendFunc(GL_ONE, GL_ONE);
+            break;
+        case LV_BLEND_MODE_MULTIPLY:
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+        case LV_BLEND_MODE_REPLACE:
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_ONE, GL_ZERO);
+            break;
+        default:
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+    }
+}
+
+static void set_color(GLint loc, lv_color_t c, lv_opa_t opa)
+{
+    if (opa >= LV_OPA_MAX) {
+        opa = LV_OPA_COVER;
+    }
+    glUniform4f(loc, c.ch.red / 31.0f, c.ch.green / 63.0f, c.ch.blue / 31.0f, opa / 255.0f);
+}
+
+static void set_clip(const lv_area_t *clip)
+{
+    glScissor(clip->x1, clip->y1, lv_area_get_width(clip), lv_area_get_height(clip));
+}
+
+/* texture coordinates of area a's edges within a texture of tex_w x tex_h
+ * holding the pixels of tex_area at ofs_x, ofs_y; out is u1, v1, u2, v2. */
+static void tex_coords(GLfloat out[4], const lv_area_t *a, const lv_area_t *tex_area, lv_coord_t ofs_x,
+                       lv_coord_t ofs_y, GLsizei tex_w, GLsizei tex_h)
+{
+    out[0] = (GLfloat)(a->x1 - tex_area->x1 + ofs_x) / tex_w;
+    out[1] = (GLfloat)(a->y1 - tex_area->y1 + ofs_y) / tex_h;
+    out[2] = (GLfloat)(a->x2 + 1 - tex_area->x1 + ofs_x) / tex_w;
+    out[3] = (GLfloat)(a->y2 + 1 - tex_area->y1 + ofs_y) / tex_h;
+}
+
+/* writes two triangles covering area a; uv and muv may be NULL */
+static void put_quad(GLfloat *v, const lv_area_t *a, const GLfloat uv[4], const GLfloat muv[4])
+{
+    static const GLfloat zero[4] = {0};
+    static const int corners[VERTS_PER_QUAD][2] = {{0, 1}, {2, 1}, {0, 3}, {2, 1}, {2, 3}, {0, 3}};
+    const GLfloat pos[4] = {a->x1, a->y1, a->x2 + 1, a->y2 + 1};
+    uv = uv ? uv : zero;
+    muv = muv ? muv : zero;
+    for (int i = 0; i < VERTS_PER_QUAD; i++) {
+        int x = corners[i][0];
+        int y = corners[i][1];
+        *v++ = pos[x];
+        *v++ = pos[y];
+        *v++ = uv[x];
+        *v++ = uv[y];
+        *v++ = muv[x];
+        *v++ = muv[y];
+    }
+}
+
+static void draw_quads(const GLfloat *v, uint32_t nquads)
+{
+    GLsizei stride = FLOATS_PER_VERT * sizeof(GLfloat);
+    glVertexAttribPointer(ATTR_POS, 2, GL_FLOAT, GL_FALSE, stride, v);
+    glVertexAttribPointer(ATTR_UV, 2, GL_FLOAT, GL_FALSE, stride, v + 2);
+    glVertexAttribPointer(ATTR_MUV, 2, GL_FLOAT, GL_FALSE, stride, v + 4);
+    glDrawArrays(GL_TRIANGLES, 0, nquads * VERTS_PER_QUAD);
+}
+
+static void use_blend_prog(const lv_area_t *clip, lv_color_t color, lv_opa_t opa, lv_blend_mode_t mode, bool src,
+                           bool mask)
+{
+    glUseProgram(gl.blend_prog.id);
+    set_color(gl.blend_prog.color, color, opa);
+    glUniform1f(gl.blend_prog.use_src, src ? 1.0f : 0.0f);
+    glUniform1f(gl.blend_prog.use_mask, mask ? 1.0f : 0.0f);
+    set_blend_mode(mode);
+    set_clip(clip);
+}
+
+/* issues the pending batch, if any. every other draw call is preceded by
+ * this, which keeps the drawing order of LVGL. */
+static void flush_batch(void)
+{
+    switch (gl.batch) {
+        case BATCH_NONE:
+            return;
+        case BATCH_ROWS: {
+            GLsizei w = lv_area_get_width(&gl.batch_area);
+            GLsizei h = lv_area_get_height(&gl.batch_area);
+            upload_tex(&gl.mask_tex, 1, GL_ALPHA, GL_UNSIGNED_BYTE, w, h, gl.rows);
+            use_blend_prog(&gl.batch_clip, gl.batch_color, gl.batch_opa, gl.batch_mode, false, true);
+            GLfloat muv[4];
+            tex_coords(muv, &gl.batch_area, &gl.batch_area, 0, 0, w, h);
+            put_quad(gl.verts, &gl.batch_area, NULL, muv);
+            draw_quads(gl.verts, 1);
+            break;
+        }
+        case BATCH_GLYPHS:
+            bind_tex(&gl.atlas_tex, 1);
+            use_blend_prog(&gl.batch_clip, gl.batch_color, gl.batch_opa, gl.batch_mode, false, true);
+            draw_quads(gl.verts, gl.nquads);
+            break;
+    }
+    gl.batch = BATCH_NONE;
+    gl.nquads = 0;
+}
+
+/* whether a new item of kind can join the pending batch */
+static bool batch_matches(enum batch_kind kind, const lv_area_t *clip, lv_color_t color, lv_opa_t opa,
+                          lv_blend_mode_t mode)
+{
+    return gl.batch == kind && area_eq(&gl.batch_clip, clip) && gl.batch_color.full == color.full &&
+           gl.batch_opa == opa && gl.batch_mode == mode;
+}
+
+static void start_batch(enum batch_kind kind, const lv_area_t *clip, lv_color_t color, lv_opa_t opa,
+                        lv_blend_mode_t mode)
+{
+    flush_batch();
+    gl.batch = kind;
+    gl.batch_clip = *clip;
+    gl.batch_color = color;
+    gl.batch_opa = opa;
+    gl.batch_mode = mode;
+}
+
+/* fills a rounded rect or, given inner, a ring between the two.
+ * radii are expected to fit the rects. */
+static void draw_rrect(const lv_area_t *clip, const lv_area_t *outer, lv_coord_t rout, const lv_area_t *inner,
+                       lv_coord_t rin, lv_color_t color, lv_opa_t opa, lv_blend_mode_t mode)
+{
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, outer, clip)) {
+        return;
+    }
+    flush_batch();
+    glUseProgram(gl.rect_prog.id);
+    set_color(gl.rect_prog.color, color, opa);
+    glUniform4f(gl.rect_prog.outer, outer->x1, outer->y1, outer->x2 + 1, outer->y2 + 1);
+    glUniform1f(gl.rect_prog.rout, rout);
+    if (inner) {
+        glUniform4f(gl.rect_prog.inner, inner->x1, inner->y1, inner->x2 + 1, inner->y2 + 1);
+        glUniform1f(gl.rect_prog.rin, rin);
+    }
+    glUniform1f(gl.rect_prog.ring, inner ? 1.0f : 0.0f);
+    set_blend_mode(mode);
+    set_clip(clip);
+    put_quad(gl.verts, &area, NULL, NULL);
+    draw_quads(gl.verts, 1);
+}
+
+static lv_coord_t clamp_radius(lv_coord_t radius, const lv_area_t *a)
+{
+    lv_coord_t short_side = LV_MIN(lv_area_get_width(a), lv_area_get_height(a));
+    return LV_MIN(radius, short_side >> 1);
+}
+
+/* the software renderer output, onto the screen */
+static void gl_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    if (draw_ctx->buf != gl.screen) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+    const lv_opa_t *mask = dsc->mask_buf;
+    if (mask && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP) {
+        return;
+    }
+    if (dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER) {
+        mask = NULL;
+    }
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area)) {
+        return;
+    }
+    if (mask && !_lv_area_intersect(&area, &area, dsc->mask_area)) {
+        return;
+    }
+
+    const lv_area_t *ba = dsc->blend_area;
+    lv_coord_t w = lv_area_get_width(ba);
+    lv_coord_t h = lv_area_get_height(ba);
+    if (mask && dsc->src_buf == NULL && area_eq(dsc->mask_area, ba)) {
+        /* masked fills come a row at a time: stack them up */
+        bool next = batch_matches(BATCH_ROWS, draw_ctx->clip_area, dsc->color, dsc->opa, dsc->blend_mode) &&
+                    gl.batch_area.x1 == ba->x1 && gl.batch_area.x2 == ba->x2 && gl.batch_area.y2 + 1 == ba->y1;
+        size_t have = next ? (size_t)w * lv_area_get_height(&gl.batch_area) : 0;
+        if (grow(&gl.rows, &gl.rows_cap, have + (size_t)w * h) == NULL) {
+            LV_LOG_WARN("out of memory for mask rows");
+            return;
+        }
+        if (next) {
+            gl.batch_area.y2 = ba->y2;
+        }
+        else {
+            start_batch(BATCH_ROWS, draw_ctx->clip_area, dsc->color, dsc->opa, dsc->blend_mode);
+            gl.batch_area = *ba;
+        }
+        memcpy(gl.rows + have, mask, (size_t)w * h);
+        return;
+    }
+
+    flush_batch();
+    GLfloat uv[4];
+    GLfloat muv[4];
+    if (dsc->src_buf) {
+        upload_tex(&gl.src_tex, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, w, h, dsc->src_buf);
+        tex_coords(uv, &area, ba, 0, 0, w, h);
+    }
+    if (mask) {
+        GLsizei mw = lv_area_get_width(dsc->mask_area);
+        GLsizei mh = lv_area_get_height(dsc->mask_area);
+        upload_tex(&gl.mask_tex, 1, GL_ALPHA, GL_UNSIGNED_BYTE, mw, mh, mask);
+        tex_coords(muv, &area, dsc->mask_area, 0, 0, mw, mh);
+    }
+    use_blend_prog(draw_ctx->clip_area, dsc->color, dsc->opa, dsc->blend_mode, dsc->src_buf != NULL, mask != NULL);
+    put_quad(gl.verts, &area, dsc->src_buf ? uv : NULL, mask ? muv : NULL);
+    draw_quads(gl.verts, 1);
+}
+
+static void gl_rect(lv_draw_ctx_t *draw_ctx, const lv_draw_rect_dsc_t *dsc, const lv_area_t *coords)
+{
+    if (draw_ctx->buf != gl.screen || lv_draw_mask_is_any(coords)) {
+        lv_draw_sw_rect(draw_ctx, dsc, coords);
+        return;
+    }
+
+    /* the same order as lv_draw_sw_rect. parts left to software are drawn
+     * from a copy of dsc with the others off; border_post skips the border. */
+    lv_draw_rect_dsc_t part;
+    if (dsc->shadow_width > 0 && dsc->shadow_opa > LV_OPA_MIN) {
+        part = *dsc;
+        part.bg_opa = LV_OPA_TRANSP;
+        part.bg_img_src = NULL;
+        part.border_post = 1;
+        part.outline_width = 0;
+        lv_draw_sw_rect(draw_ctx, &part, coords);
+    }
+
+    if (dsc->bg_opa > LV_OPA_MIN) {
+        lv_grad_dir_t grad_dir = dsc->bg_grad.dir;
+        lv_color_t bg_color = grad_dir == LV_GRAD_DIR_NONE ? dsc->bg_color : dsc->bg_grad.stops[0].color;
+        if (grad_dir != LV_GRAD_DIR_NONE && bg_color.full != dsc->bg_grad.stops[1].color.full) {
+            part = *dsc;
+            part.shadow_width = 0;
+            part.bg_img_src = NULL;
+            part.border_post = 1;
+            part.outline_width = 0;
+            lv_draw_sw_rect(draw_ctx, &part, coords);
+        }
+        else {
+            /* a fully covering border shrinks the background, same as in software */
+            lv_area_t bg = *coords;
+            if (dsc->border_width > 1 && dsc->border_opa >= LV_OPA_MAX && dsc->radius != 0) {
+                bg.x1 += (dsc->border_side & LV_BORDER_SIDE_LEFT) ? 1 : 0;
+                bg.y1 += (dsc->border_side & LV_BORDER_SIDE_TOP) ? 1 : 0;
+                bg.x2 -= (dsc->border_side & LV_BORDER_SIDE_RIGHT) ? 1 : 0;
+                bg.y2 -= (dsc->border_side & LV_BORDER_SIDE_BOTTOM) ? 1 : 0;
+            }
+            draw_rrect(draw_ctx->clip_area, &bg, clamp_radius(dsc->radius, &bg), NULL, 0, bg_color, dsc->bg_opa,
+                       dsc->blend_mode);
+        }
+    }
+
+    if (dsc->bg_img_src && dsc->bg_img_opa > LV_OPA_MIN) {
+        part = *dsc;
+        part.shadow_width = 0;
+        part.bg_opa = LV_OPA_TRANSP;
+        part.border_post = 1;
+        part.outline_width = 0;
+        lv_draw_sw_rect(draw_ctx, &part, coords);
+    }
+
+    if (!dsc->border_post && dsc->border_width > 0 && dsc->border_opa > LV_OPA_MIN &&
+        dsc->border_side != LV_BORDER_SIDE_NONE) {
+        if (dsc->border_side == LV_BORDER_SIDE_FULL) {
+            lv_coord_t rout = clamp_radius(dsc->radius, coords);
+            lv_coord_t rin = LV_MAX(rout - dsc->border_width, 0);
+            lv_area_t inner = *coords;
+            inner.x1 += dsc->border_width;
+            inner.y1 += dsc->border_width;
+            inner.x2 -= dsc->border_width;
+            inner.y2 -= dsc->border_width;
+            draw_rrect(draw_ctx->clip_area, coords, rout, &inner, rin, dsc->border_color, dsc->border_opa,
+                       dsc->blend_mode);
+        }
+        else {
+            part = *dsc;
+            part.shadow_width = 0;
+            part.bg_opa = LV_OPA_TRANSP;
+            part.bg_img_src = NULL;
+            part.outline_width = 0;
+            lv_draw_sw_rect(draw_ctx, &part, coords);
+        }
+    }
+
+    if (dsc->outline_width > 0 && dsc->outline_opa > LV_OPA_MIN) {
+        part = *dsc;
+        part.shadow_width = 0;
+        part.bg_opa = LV_OPA_TRANSP;
+        part.bg_img_src = NULL;
+        part.border_post = 1;
+        lv_draw_sw_rect(draw_ctx, &part, coords);
+    }
+}
+
+static void gl_img_decoded(lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *dsc, const lv_area_t *coords,
+                           const uint8_t *map_p, lv_img_cf_t cf)
+{
+    if (draw_ctx->buf != gl.screen || dsc->angle != 0 || dsc->zoom != LV_IMG_ZOOM_NONE ||
+        dsc->recolor_opa > LV_OPA_MIN || (cf != LV_IMG_CF_TRUE_COLOR && cf != LV_IMG_CF_TRUE_COLOR_ALPHA) ||
+        lv_draw_mask_is_any(coords)) {
+        lv_draw_sw_img_decoded(draw_ctx, dsc, coords, map_p, cf);
+        return;
+    }
+    if (dsc->opa <= LV_OPA_MIN) {
+        return;
+    }
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, coords, draw_ctx->clip_area)) {
+        return;
+    }
+    flush_batch();
+
+    /* only the visible rows are uploaded */
+    lv_coord_t w = lv_area_get_width(coords);
+    lv_coord_t h = lv_area_get_height(&area);
+    lv_area_t tex_area = {coords->x1, area.y1, coords->x2, area.y2};
+    size_t first = (size_t)(area.y1 - coords->y1) * w;
+    if (cf == LV_IMG_CF_TRUE_COLOR) {
+        upload_tex(&gl.src_tex, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, w, h, map_p + first * sizeof(lv_color_t));
+    }
+    else {
+        /* RGB565 followed by alpha, to RGBA8888 */
+        size_t n = (size_t)w * h;
+        uint8_t *out = grow(&gl.scratch, &gl.scratch_cap, n * 4);
+        if (out == NULL) {
+            LV_LOG_WARN("out of memory for image upload");
+            return;
+        }
+        const uint8_t *p = map_p + first * LV_IMG_PX_SIZE_ALPHA_BYTE;
+        for (size_t i = 0; i < n; i++, p += LV_IMG_PX_SIZE_ALPHA_BYTE) {
+            uint16_t c = p[0] | (uint16_t)p[1] << 8;
+            uint8_t r = (c >> 11) & 0x1f;
+            uint8_t g = (c >> 5) & 0x3f;
+            uint8_t b = c & 0x1f;
+            out[i * 4 + 0] = (uint8_t)(r << 3 | r >> 2);
+            out[i * 4 + 1] = (uint8_t)(g << 2 | g >> 4);
+            out[i * 4 + 2] = (uint8_t)(b << 3 | b >> 2);
+            out[i * 4 + 3] = p[2];
+        }
+        upload_tex(&gl.src_tex, 0, GL_RGBA, GL_UNSIGNED_BYTE, w, h, out);
+    }
+
+    GLfloat uv[4];
+    tex_coords(uv, &area, &tex_area, 0, 0, w, h);
+    use_blend_prog(draw_ctx->clip_area, lv_color_black(), dsc->opa, dsc->blend_mode, true, false);
+    put_quad(gl.verts, &area, uv, NULL);
+    draw_quads(gl.verts, 1);
+}
+
+static void atlas_reset(void)
+{
+    flush_batch(); /* pending glyph quads refer to the atlas */
+    memset(gl.glyphs, 0, sizeof(gl.glyphs));
+    gl.nglyphs = 0;
+    gl.shelf_x = 0;
+    gl.shelf_y = 0;
+    gl.shelf_h = 0;
+}
+
+static bool atlas_alloc(uint16_t w, uint16_t h, uint16_t *x, uint16_t *y)
+{
+    if (gl.shelf_x + w > ATLAS_SIZE) {
+        gl.shelf_y += gl.shelf_h + 1;
+        gl.shelf_x = 0;
+        gl.shelf_h = 0;
+    }
+    if (w > ATLAS_SIZE || gl.shelf_y + h > ATLAS_SIZE) {
+        return false;
+    }
+    *x = gl.shelf_x;
+    *y = gl.shelf_y;
+    gl.shelf_x += w + 1; /* a pixel apart */
+    if (h > gl.shelf_h) {
+        gl.shelf_h = h;
+    }
+    return true;
+}
+
+static struct glyph *atlas_find(const lv_font_t *font, uint32_t letter)
+{
+    uint32_t i = (uint32_t)(((uintptr_t)font >> 4) * 31 + letter * 2654435761u) & (ATLAS_SLOTS - 1);
+    while (gl.glyphs[i].font && (gl.glyphs[i].font != font || gl.glyphs[i].letter != letter)) {
+        i = (i + 1) & (ATLAS_SLOTS - 1);
+    }
+    return &gl.glyphs[i];
+}
+
+/* returns the atlas slot of a glyph, adding it if missing, or NULL if the
+ * glyph doesn't fit or on error. */
+static const struct glyph *atlas_get(const lv_font_glyph_dsc_t *g, uint32_t letter)
+{
+    const lv_font_t *font = g->resolved_font;
+    struct glyph *slot = atlas_find(font, letter);
+    if (slot->font) {
+        return slot;
+    }
+    uint16_t x, y;
+    if (gl.nglyphs >= ATLAS_SLOTS * 3 / 4 || !atlas_alloc(g->box_w, g->box_h, &x, &y)) {
+        atlas_reset();
+        if (!atlas_alloc(g->box_w, g->box_h, &x, &y)) {
+            return NULL;
+        }
+        slot = atlas_find(font, letter);
+    }
+
+    const uint8_t *map_p = lv_font_get_glyph_bitmap(font, letter);
+    uint8_t *px = grow(&gl.scratch, &gl.scratch_cap, (size_t)g->box_w * g->box_h);
+    if (map_p == NULL || px == NULL) {
+        return NULL;
+    }
+    /* rows are bit packed with no padding, same as in draw_letter_normal */
+    uint32_t bpp = g->bpp == 3 ? 4 : g->bpp;
+    uint32_t max = (1u << bpp) - 1;
+    uint32_t n = (uint32_t)g->box_w * g->box_h;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t bit = i * bpp;
+        uint32_t v = (map_p[bit >> 3] >> (8 - bpp - (bit & 7))) & max;
+        px[i] = (uint8_t)(v * 255 / max); /* the _lv_bppN_opa_table values */
+    }
+    bind_tex(&gl.atlas_tex, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, g->box_w, g->box_h, GL_ALPHA, GL_UNSIGNED_BYTE, px);
+
+    slot->font = font;
+    slot->letter = letter;
+    slot->x = x;
+    slot->y = y;
+    gl.nglyphs++;
+    return slot;
+}
+
+static void gl_letter(lv_draw_ctx_t *draw_ctx, const lv_draw_label_dsc_t *dsc, const lv_point_t *pos_p,
+                      uint32_t letter)
+{
+    if (draw_ctx->buf != gl.screen) {
+        lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+        return;
+    }
+    /* missing glyphs, with their placeholder, and the odd fonts are left to software */
+    lv_font_glyph_dsc_t g;
+    if (!lv_font_get_glyph_dsc(dsc->font, &g, letter, '\0') || g.resolved_font == NULL || g.resolved_font->subpx ||
+        (g.bpp != 1 && g.bpp != 2 && g.bpp != 3 && g.bpp != 4 && g.bpp != 8)) {
+        lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+        return;
+    }
+    if (g.box_w == 0 || g.box_h == 0 || dsc->opa <= LV_OPA_MIN) {
+        return;
+    }
+    lv_area_t box;
+    box.x1 = pos_p->x + g.ofs_x;
+    box.y1 = pos_p->y + (dsc->font->line_height - dsc->font->base_line) - g.box_h - g.ofs_y;
+    box.x2 = box.x1 + g.box_w - 1;
+    box.y2 = box.y1 + g.box_h - 1;
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, &box, draw_ctx->clip_area)) {
+        return;
+    }
+    if (lv_draw_mask_is_any(&box)) {
+        lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+        return;
+    }
+    const struct glyph *slot = atlas_get(&g, letter);
+    if (slot == NULL) {
+        lv_draw_sw_letter(draw_ctx, dsc, pos_p, letter);
+        return;
+    }
+
+    if (!batch_matches(BATCH_GLYPHS, draw_ctx->clip_area, dsc->color, dsc->opa, dsc->blend_mode) ||
+        gl.nquads == MAX_BATCH_QUADS) {
+        start_batch(BATCH_GLYPHS, draw_ctx->clip_area, dsc->color, dsc->opa, dsc->blend_mode);
+    }
+    GLfloat muv[4];
+    tex_coords(muv, &area, &box, slot->x, slot->y, ATLAS_SIZE, ATLAS_SIZE);
+    put_quad(gl.verts + gl.nquads * VERTS_PER_QUAD * FLOATS_PER_VERT, &area, NULL, muv);
+    gl.nquads++;
+}
+
+static void gl_wait_for_finish(lv_draw_ctx_t *draw_ctx)
+{
+    if (draw_ctx->buf == gl.screen) {
+        flush_batch();
+    }
+    lv_draw_sw_wait_for_finish(draw_ctx);
+}
+
+/**
+ * sets up the screen texture and shaders with a GL context current.
+ * screen is the display draw buffer, w x h pixels; see nm_draw_gl_ctx_init.
+ * returns 0 on success.
+ */
+int nm_draw_gl_init(void *screen, lv_coord_t w, lv_coord_t h)
+{
+    gl.screen = screen;
+    gl.w = w;
+    gl.h = h;
+
+    gl.blend_prog.id = link_program(draw_vert_src, blend_frag_src);
+    gl.rect_prog.id = link_program(draw_vert_src, rect_frag_src);
+    gl.present_prog = link_program(present_vert_src, present_frag_src);
+    if (gl.blend_prog.id == 0 || gl.rect_prog.id == 0 || gl.present_prog == 0) {
+        return -1;
+    }
+    init_program(gl.blend_prog.id);
+    gl.blend_prog.color = glGetUniformLocation(gl.blend_prog.id, "u_color");
+    gl.blend_prog.use_src = glGetUniformLocation(gl.blend_prog.id, "u_use_src");
+    gl.blend_prog.use_mask = glGetUniformLocation(gl.blend_prog.id, "u_use_mask");
+    init_program(gl.rect_prog.id);
+    gl.rect_prog.color = glGetUniformLocation(gl.rect_prog.id, "u_color");
+    gl.rect_prog.outer = glGetUniformLocation(gl.rect_prog.id, "u_outer");
+    gl.rect_prog.rout = glGetUniformLocation(gl.rect_prog.id, "u_rout");
+    gl.rect_prog.inner = glGetUniformLocation(gl.rect_prog.id, "u_inner");
+    gl.rect_prog.rin = glGetUniformLocation(gl.rect_prog.id, "u_rin");
+    gl.rect_prog.ring = glGetUniformLocation(gl.rect_prog.id, "u_ring");
+    glUseProgram(gl.present_prog);
+    glUniform1i(glGetUniformLocation(gl.present_prog, "u_src"), 0);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    init_tex(&gl.src_tex, GL_RGB, GL_UNSIGNED_SHORT_5_6_5);
+    init_tex(&gl.mask_tex, GL_ALPHA, GL_UNSIGNED_BYTE);
+    init_tex(&gl.atlas_tex, GL_ALPHA, GL_UNSIGNED_BYTE);
+    upload_tex(&gl.atlas_tex, 1, GL_ALPHA, GL_UNSIGNED_BYTE, ATLAS_SIZE, ATLAS_SIZE, NULL);
+    /* 8 bits per channel keeps the blending close to the software one */
+    init_tex(&gl.screen_tex, GL_RGBA, GL_UNSIGNED_BYTE);
+    upload_tex(&gl.screen_tex, 0, GL_RGBA, GL_UNSIGNED_BYTE, w, h, NULL);
+
+    glGenFramebuffers(1, &gl.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gl.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl.screen_tex.id, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LV_LOG_ERROR("GL screen framebuffer incomplete");
+        return -1;
+    }
+    glViewport(0, 0, w, h);
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_BLEND);
+    glEnableVertexAttribArray(ATTR_POS);
+    glEnableVertexAttribArray(ATTR_UV);
+    glEnableVertexAttribArray(ATTR_MUV);
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+/**
+ * draws the screen texture onto the default framebuffer of out_w x out_h,
+ * the EGL surface, to be swapped by the caller.
+ */
+void nm_draw_gl_present(int out_w, int out_h)
+{
+    /* LVGL row 0 at the top */
+    static const GLfloat quad[] = {
+        -1, 1, 0, 0, /* top left */
+        1, 1, 1, 0, /* top right */
+        -1, -1, 0, 1, /* bottom left */
+        1, -1, 1, 1, /* bottom right */
+    };
+    flush_batch();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, out_w, out_h);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+    glUseProgram(gl.present_prog);
+    bind_tex(&gl.screen_tex, 0);
+    glVertexAttribPointer(ATTR_POS, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), quad);
+    glVertexAttribPointer(ATTR_UV, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), quad + 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gl.fbo);
+    glViewport(0, 0, gl.w, gl.h);
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_BLEND);
+}
+
+/* a lv_disp_drv_t.draw_ctx_init replacement; draw_ctx_size stays the default
+ * sizeof(lv_draw_sw_ctx_t). */
+void nm_draw_gl_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+    draw_ctx->draw_rect = gl_rect;
+    draw_ctx->draw_img_decoded = gl_img_decoded;
+    draw_ctx->draw_letter = gl_letter;
+    draw_ctx->wait_for_finish = gl_wait_for_finish;
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = gl_blend;
+}
@@ -0,0 +1,316 @@
+/**
+ * NEON accelerated blending for the LVGL software renderer, RGB565 only.
+ *
+ * the draw context is the regular software one with its blend function
+ * replaced: solid and image fills with normal blending mode are done here,
+ * everything else is passed on to lv_draw_sw_blend_basic.
+ *
+ * pixels are mixed with the same arithmetic as lv_color_mix, so the output is
+ * identical to what the scalar code path produces for masked areas.
+ *
+ * large blends are split into horizontal bands, rendered concurrently by a
+ * small pool of worker threads and the UI thread, and joined before the blend
+ * returns: rows are independent of each other, and every band writes only its
+ * own rows of the draw buffer. everything else, like mask and glyph rendering,
+ * stays on the UI thread, so LVGL is never entered from a worker.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "lvgl/lvgl.h"
+#include "lvgl/src/draw/sw/lv_draw_sw.h"
+
+#include <arm_neon.h>
+#include <pthread.h>
+
+#if LV_COLOR_DEPTH != 16 || LV_COLOR_16_SWAP != 0 || LV_COLOR_MIX_ROUND_OFS != 0
+#error "draw_neon.c requires LV_COLOR_DEPTH 16, LV_COLOR_16_SWAP 0 and LV_COLOR_MIX_ROUND_OFS 0"
+#endif
+
+/* RGB565 spread over 32 bits with gaps between the channels; see lv_color_mix */
+#define SPREAD_MASK 0x7E0F81F
+
+static inline uint32x4_t spread4(uint16x4_t c)
+{
+    uint32x4_t w = vmovl_u16(c);
+    return vandq_u32(vorrq_u32(w, vshlq_n_u32(w, 16)), vdupq_n_u32(SPREAD_MASK));
+}
+
+static inline uint16x4_t mix4(uint16x4_t fg, uint16x4_t bg, uint16x4_t mix)
+{
+    uint32x4_t f = spread4(fg);
+    uint32x4_t b = spread4(bg);
+    uint32x4_t r = vmulq_u32(vsubq_u32(f, b), vmovl_u16(mix));
+    r = vandq_u32(vaddq_u32(vshrq_n_u32(r, 5), b), vdupq_n_u32(SPREAD_MASK));
+    return vmovn_u32(vorrq_u32(vshrq_n_u32(r, 16), r));
+}
+
+/* mixes 8 fg pixels into bg; mix values are in 0..32 range */
+static inline uint16x8_t mix8(uint16x8_t fg, uint16x8_t bg, uint16x8_t mix)
+{
+    uint16x4_t lo = mix4(vget_low_u16(fg), vget_low_u16(bg), vget_low_u16(mix));
+    uint16x4_t hi = mix4(vget_high_u16(fg), vget_high_u16(bg), vget_high_u16(mix));
+    return vcombine_u16(lo, hi);
+}
+
+/* effective 0..255 opacity of a masked pixel, same as lv_draw_sw_blend_basic */
+static inline lv_opa_t px_opa(lv_opa_t mask, lv_opa_t opa)
+{
+    if (opa >= LV_OPA_MAX) {
+        return mask;
+    }
+    return mask == LV_OPA_COVER ? opa : (lv_opa_t)(((uint32_t)mask * opa) >> 8);
+}
+
+/* converts 8 mask values to lv_color_mix weights, applying opa */
+static inline uint16x8_t mask_weights8(uint8x8_t mask, lv_opa_t opa)
+{
+    uint16x8_t m = vmovl_u8(mask);
+    if (opa < LV_OPA_MAX) {
+        uint16x8_t scaled = vshrq_n_u16(vmulq_n_u16(m, opa), 8);
+        uint16x8_t cover = vceqq_u16(m, vdupq_n_u16(LV_OPA_COVER));
+        m = vbslq_u16(cover, vdupq_n_u16(opa), scaled);
+    }
+    return vshrq_n_u16(vaddq_u16(m, vdupq_n_u16(4)), 3);
+}
+
+/* blends a single row of w pixels into dest. src is NULL for a solid color fill.
+ * mask is NULL if the whole row is covered. */
+static void blend_row(uint16_t *dest, const uint16_t *src, uint16_t color, const lv_opa_t *mask, lv_opa_t opa,
+                      int32_t w)
+{
+    const uint16x8_t vcolor = vdupq_n_u16(color);
+    const uint16x8_t vopa = vdupq_n_u16((uint16_t)(((uint32_t)opa + 4) >> 3));
+    int32_t x = 0;
+    for (; x + 8 <= w; x += 8) {
+        uint16x8_t fg = src ? vld1q_u16(src + x) : vcolor;
+        uint16x8_t weights;
+        if (mask) {
+            uint8x8_t m = vld1_u8(mask + x);
+            uint64_t m64 = vget_lane_u64(vreinterpret_u64_u8(m), 0);
+            if (m64 == 0) {
+                continue;
+            }
+            if (m64 == UINT64_MAX && opa >= LV_OPA_MAX) {
+                vst1q_u16(dest + x, fg);
+                continue;
+            }
+            weights = mask_weights8(m, opa);
+        }
+        else if (opa >= LV_OPA_MAX) {
+            vst1q_u16(dest + x, fg);
+            continue;
+        }
+        else {
+            weights = vopa;
+        }
+        vst1q_u16(dest + x, mix8(fg, vld1q_u16(dest + x), weights));
+    }
+    for (; x < w; x++) {
+        lv_color_t fg = {.full = src ? src[x] : color};
+        lv_color_t bg = {.full = dest[x]};
+        lv_opa_t a = mask ? px_opa(mask[x], opa) : opa;
+        if (a <= LV_OPA_MIN) {
+            continue;
+        }
+        dest[x] = a >= LV_OPA_MAX ? fg.full : lv_color_mix(fg, bg, a).full;
+    }
+}
+
+/* a blend of h rows of w pixels, each row as in blend_row. */
+struct blend_job {
+    uint16_t *dest;
+    const uint16_t *src;
+    const lv_opa_t *mask;
+    lv_coord_t dest_stride;
+    lv_coord_t src_stride;
+    lv_coord_t mask_stride;
+    uint16_t color;
+    lv_opa_t opa;
+    int32_t w;
+    int32_t h;
+};
+
+/* blends rows y0 up to y1 of the job. */
+static void blend_rows(const struct blend_job *job, int32_t y0, int32_t y1)
+{
+    uint16_t *dest = job->dest + job->dest_stride * y0;
+    const uint16_t *src = job->src ? job->src + job->src_stride * y0 : NULL;
+    const lv_opa_t *mask = job->mask ? job->mask + job->mask_stride * y0 : NULL;
+    for (int32_t y = y0; y < y1; y++) {
+        if (src && !mask && job->opa >= LV_OPA_MAX) {
+            lv_memcpy(dest, src, job->w * sizeof(uint16_t));
+        }
+        else {
+            blend_row(dest, src, job->color, mask, job->opa, job->w);
+        }
+        dest += job->dest_stride;
+        if (src) {
+            src += job->src_stride;
+        }
+        if (mask) {
+            mask += job->mask_stride;
+        }
+    }
+}
+
+/* bands of a blend, one per Pi 4 core: the UI thread renders the first. */
+#define NBANDS 4
+/* blends of fewer pixels are done on the UI thread: waking up the workers
+ * costs more than blending a few rows. */
+#define MIN_BANDED_PX (32 * 1024)
+
+static struct {
+    pthread_mutex_t mu;
+    pthread_cond_t start; /* signaled on a new generation */
+    pthread_cond_t done;  /* signaled when pending drops to 0 */
+    const struct blend_job *job;
+    uint32_t generation; /* incremented for each job */
+    int pending;         /* workers yet to finish the current job */
+    bool ok;             /* all workers are running */
+} bands = {
+    .mu = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static void band_range(const struct blend_job *job, int band, int32_t *y0, int32_t *y1)
+{
+    *y0 = job->h * band / NBANDS;
+    *y1 = job->h * (band + 1) / NBANDS;
+}
+
+static void *band_worker(void *arg)
+{
+    int band = (int)(intptr_t)arg;
+    uint32_t seen = 0;
+    pthread_mutex_lock(&bands.mu);
+    for (;;) {
+        while (bands.generation == seen) {
+            pthread_cond_wait(&bands.start, &bands.mu);
+        }
+        seen = bands.generation;
+        const struct blend_job *job = bands.job;
+        pthread_mutex_unlock(&bands.mu);
+
+        int32_t y0, y1;
+        band_range(job, band, &y0, &y1);
+        blend_rows(job, y0, y1);
+
+        pthread_mutex_lock(&bands.mu);
+        if (--bands.pending == 0) {
+            pthread_cond_signal(&bands.done);
+        }
+    }
+    return NULL;
+}
+
+/* spawns the band workers. blends stay on the UI thread if any fails. */
+static void bands_init(void)
+{
+    for (int i = 1; i < NBANDS; i++) {
+        pthread_t th;
+        if (pthread_create(&th, NULL, band_worker, (void *)(intptr_t)i) != 0) {
+            LV_LOG_WARN("band worker: pthread_create failed; blending on a single thread");
+            return;
+        }
+        pthread_detach(th);
+    }
+    bands.ok = true;
+}
+
+/* blends the job rows concurrently in NBANDS bands and waits for all. */
+static void blend_banded(const struct blend_job *job)
+{
+    pthread_mutex_lock(&bands.mu);
+    bands.job = job;
+    bands.pending = NBANDS - 1;
+    bands.generation++;
+    pthread_cond_broadcast(&bands.start);
+    pthread_mutex_unlock(&bands.mu);
+
+    int32_t y0, y1;
+    band_range(job, 0, &y0, &y1);
+    blend_rows(job, y0, y1);
+
+    pthread_mutex_lock(&bands.mu);
+    while (bands.pending > 0) {
+        pthread_cond_wait(&bands.done, &bands.mu);
+    }
+    pthread_mutex_unlock(&bands.mu);
+}
+
+static void neon_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    /* non-anti-aliased masks are rounded in place by the basic implementation */
+    bool basic = dsc->blend_mode != LV_BLEND_MODE_NORMAL || disp->driver->set_px_cb != NULL ||
+                 disp->driver->screen_transp || disp->driver->antialiasing == 0;
+    if (basic) {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        return;
+    }
+
+    const lv_opa_t *mask;
+    if (dsc->mask_buf && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP) {
+        return;
+    }
+    else if (dsc->mask_buf == NULL || dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER) {
+        mask = NULL;
+    }
+    else {
+        mask = dsc->mask_buf;
+    }
+
+    lv_area_t area;
+    if (!_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area)) {
+        return;
+    }
+
+    lv_coord_t dest_stride = lv_area_get_width(draw_ctx->buf_area);
+    uint16_t *dest = (uint16_t *)draw_ctx->buf;
+    dest += dest_stride * (area.y1 - draw_ctx->buf_area->y1) + (area.x1 - draw_ctx->buf_area->x1);
+
+    const uint16_t *src = NULL;
+    lv_coord_t src_stride = 0;
+    if (dsc->src_buf) {
+        src_stride = lv_area_get_width(dsc->blend_area);
+        src = (const uint16_t *)dsc->src_buf;
+        src += src_stride * (area.y1 - dsc->blend_area->y1) + (area.x1 - dsc->blend_area->x1);
+    }
+
+    lv_coord_t mask_stride = 0;
+    if (mask) {
+        mask_stride = lv_area_get_width(dsc->mask_area);
+        mask += mask_stride * (area.y1 - dsc->mask_area->y1) + (area.x1 - dsc->mask_area->x1);
+    }
+
+    struct blend_job job = {
+        .dest = dest,
+        .src = src,
+        .mask = mask,
+        .dest_stride = dest_stride,
+        .src_stride = src_stride,
+        .mask_stride = mask_stride,
+        .color = dsc->color.full,
+        .opa = dsc->opa,
+        .w = lv_area_get_width(&area),
+        .h = lv_area_get_height(&area),
+    };
+    if (bands.ok && job.h >= NBANDS && job.w * job.h >= MIN_BANDED_PX) {
+        blend_banded(&job);
+    }
+    else {
+        blend_rows(&job, 0, job.h);
+    }
+}
+
+/* a lv_disp_drv_t.draw_ctx_init replacement; draw_ctx_size stays the default
+ * sizeof(lv_draw_sw_ctx_t). */
+void nm_draw_neon_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+    ((lv_draw_sw_ctx_t *)draw_ctx)->blend = neon_blend;
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, bands_init);
+}
@@ -0,0 +1,40 @@
+/**
+ * DRM/KMS display driver init; input is in drv_evdev.c
+ *
+ * lv_drivers/display/drm.c allocates two dumb buffers in the pixel format
+ * matching LV_COLOR_DEPTH, RGB565 at the moment, and picks a primary plane
+ * which scans it out natively. LVGL renders directly into the back buffer
+ * (direct_mode) and the last area of a frame commits an atomic, non-blocking
+ * page flip. the flip completion event is awaited in the wait_cb before LVGL
+ * touches the buffers again, which paces the UI loop at display refresh rate
+ * with no tearing and no copying on flush.
+ */
+
+#include "lv_drivers/display/drm.h"
+#include "lvgl/lvgl.h"
+
+#ifdef NM_DRAW_NEON
+/* defined in draw_neon.c */
+void nm_draw_neon_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+#endif
+
+/* returns NULL on error */
+lv_disp_t *nm_disp_init(void)
+{
+    static lv_disp_drv_t disp_drv;
+    /* also calls lv_disp_drv_init and sets flush_cb, wait_cb and draw_buf */
+    if (drm_disp_drv_init(&disp_drv) != 0) {
+        LV_LOG_ERROR("DRM display init failed");
+        return NULL;
+    }
+    if (disp_drv.hor_res != NM_DISP_HOR || disp_drv.ver_res != NM_DISP_VER) {
+        LV_LOG_WARN("DRM display mismatch; expected %dx%d, got %dx%d",
+            NM_DISP_HOR, NM_DISP_VER, disp_drv.hor_res, disp_drv.ver_res);
+    }
+    disp_drv.antialiasing = 1;
+#ifdef NM_DRAW_NEON
+    disp_drv.draw_ctx_init = nm_draw_neon_ctx_init;
+#endif
+    LV_LOG_INFO("DRM page flipping enabled");
+    return lv_disp_drv_register(&disp_drv);
+}
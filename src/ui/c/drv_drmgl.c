@@ -0,0 +1,333 @@
+/**
+ * DRM/KMS display driver with OpenGL ES 2 drawing; input is in drv_evdev.c
+ *
+ * the mode is set on the first connected connector of DRM_CARD env variable,
+ * or the first card which has one: on a Pi 4 the display is driven by vc4
+ * while card0 may be the render only v3d. EGL renders into GBM buffers which
+ * are scanned out with page flips.
+ *
+ * LVGL draws in direct mode through draw_gles.c into a screen texture, and
+ * the last area of a frame composes it onto the EGL back buffer, swaps and
+ * flips. the previous flip completion is awaited before the swap, so that the
+ * next frame is drawn while the last one is pending, and the UI loop is paced
+ * at display refresh rate with no tearing, same as drv_drm.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define EGL_NO_X11
+
+#include "lvgl/lvgl.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <fcntl.h>
+#include <gbm.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+/* defined in draw_gles.c */
+int nm_draw_gl_init(void *screen, lv_coord_t w, lv_coord_t h);
+void nm_draw_gl_present(int out_w, int out_h);
+void nm_draw_gl_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+
+#define MAX_CARDS 4
+#define FLIP_TIMEOUT_MS 100
+
+static struct {
+    int fd;
+    uint32_t conn_id;
+    uint32_t crtc_id;
+    drmModeModeInfo mode;
+    struct gbm_device *gbm;
+    struct gbm_surface *surf;
+    struct gbm_bo *bo_shown; /* on screen */
+    struct gbm_bo *bo_next; /* flip pending, if flip_pending */
+    bool flip_pending;
+    bool crtc_set;
+    EGLDisplay dpy;
+    EGLContext ctx;
+    EGLSurface egl_surf;
+} kms = {.fd = -1};
+
+/* picks a connected connector, its preferred mode and a CRTC for it.
+ * returns 0 on success. */
+static int kms_pick(int fd)
+{
+    drmModeRes *res = drmModeGetResources(fd);
+    if (res == NULL) {
+        return -1;
+    }
+    int ret = -1;
+    for (int i = 0; i < res->count_connectors && ret != 0; i++) {
+        drmModeConnector *conn = drmModeGetConnector(fd, res->connectors[i]);
+        if (conn == NULL) {
+            continue;
+        }
+        if (conn->connection != DRM_MODE_CONNECTED || conn->count_modes == 0) {
+            drmModeFreeConnector(conn);
+            continue;
+        }
+        kms.mode = conn->modes[0];
+        for (int m = 0; m < conn->count_modes; m++) {
+            if (conn->modes[m].type & DRM_MODE_TYPE_PREFERRED) {
+                kms.mode = conn->modes[m];
+                break;
+            }
+        }
+        /* the CRTC already driving the connector, or any which can */
+        uint32_t crtc_id = 0;
+        drmModeEncoder *enc = conn->encoder_id ? drmModeGetEncoder(fd, conn->encoder_id) : NULL;
+        if (enc) {
+            crtc_id = enc->crtc_id;
+            drmModeFreeEncoder(enc);
+        }
+        for (int e = 0; e < conn->count_encoders && crtc_id == 0; e++) {
+            enc = drmModeGetEncoder(fd, conn->encoders[e]);
+            if (enc == NULL) {
+                continue;
+            }
+            for (int c = 0; c < res->count_crtcs; c++) {
+                if (enc->possible_crtcs & (1u << c)) {
+                    crtc_id = res->crtcs[c];
+                    break;
+                }
+            }
+            drmModeFreeEncoder(enc);
+        }
+        if (crtc_id != 0) {
+            kms.conn_id = conn->connector_id;
+            kms.crtc_id = crtc_id;
+            ret = 0;
+        }
+        drmModeFreeConnector(conn);
+    }
+    drmModeFreeResources(res);
+    return ret;
+}
+
+static int kms_init(void)
+{
+    const char *card = getenv("DRM_CARD");
+    for (int i = 0; i < MAX_CARDS; i++) {
+        char path[32];
+        if (card == NULL) {
+            snprintf(path, sizeof(path), "/dev/dri/card%d", i);
+        }
+        int fd = open(card ? card : path, O_RDWR | O_CLOEXEC);
+        if (fd >= 0 && kms_pick(fd) == 0) {
+            kms.fd = fd;
+            LV_LOG_INFO("DRM using %s, %dx%d", card ? card : path, kms.mode.hdisplay, kms.mode.vdisplay);
+            return 0;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (card) {
+            break;
+        }
+    }
+    LV_LOG_ERROR("no DRM card with a connected display");
+    return -1;
+}
+
+static int egl_init(void)
+{
+    kms.gbm = gbm_create_device(kms.fd);
+    if (kms.gbm == NULL) {
+        LV_LOG_ERROR("gbm_create_device failed");
+        return -1;
+    }
+    kms.surf = gbm_surface_create(kms.gbm, kms.mode.hdisplay, kms.mode.vdisplay, GBM_FORMAT_XRGB8888,
+                                  GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+    if (kms.surf == NULL) {
+        LV_LOG_ERROR("gbm_surface_create failed");
+        return -1;
+    }
+
+    kms.dpy = eglGetDisplay((EGLNativeDisplayType)kms.gbm);
+    if (kms.dpy == EGL_NO_DISPLAY || !eglInitialize(kms.dpy, NULL, NULL) || !eglBindAPI(EGL_OPENGL_ES_API)) {
+        LV_LOG_ERROR("EGL init failed: 0x%x", eglGetError());
+        return -1;
+    }
+    static const EGLint config_attrs[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE,
+    };
+    /* the config must match the GBM surface format */
+    EGLConfig configs[64];
+    EGLint nconfigs = 0;
+    if (!eglChooseConfig(kms.dpy, config_attrs, configs, 64, &nconfigs)) {
+        nconfigs = 0;
+    }
+    EGLConfig config = NULL;
+    for (EGLint i = 0; i < nconfigs && config == NULL; i++) {
+        EGLint id = 0;
+        if (eglGetConfigAttrib(kms.dpy, configs[i], EGL_NATIVE_VISUAL_ID, &id) && id == GBM_FORMAT_XRGB8888) {
+            config = configs[i];
+        }
+    }
+    if (config == NULL) {
+        LV_LOG_ERROR("no EGL config for XRGB8888");
+        return -1;
+    }
+
+    static const EGLint ctx_attrs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    kms.ctx = eglCreateContext(kms.dpy, config, EGL_NO_CONTEXT, ctx_attrs);
+    kms.egl_surf = eglCreateWindowSurface(kms.dpy, config, (EGLNativeWindowType)kms.surf, NULL);
+    if (kms.ctx == EGL_NO_CONTEXT || kms.egl_surf == EGL_NO_SURFACE ||
+        !eglMakeCurrent(kms.dpy, kms.egl_surf, kms.egl_surf, kms.ctx)) {
+        LV_LOG_ERROR("EGL context failed: 0x%x", eglGetError());
+        return -1;
+    }
+    LV_LOG_INFO("GL renderer %s", (const char *)glGetString(GL_RENDERER));
+    return 0;
+}
+
+static void fb_destroy(struct gbm_bo *bo, void *data)
+{
+    uint32_t fb = (uint32_t)(uintptr_t)data;
+    if (fb) {
+        drmModeRmFB(gbm_device_get_fd(gbm_bo_get_device(bo)), fb);
+    }
+}
+
+/* returns the framebuffer of a bo, adding one the first time; 0 on error */
+static uint32_t bo_fb(struct gbm_bo *bo)
+{
+    uint32_t fb = (uint32_t)(uintptr_t)gbm_bo_get_user_data(bo);
+    if (fb) {
+        return fb;
+    }
+    if (drmModeAddFB(kms.fd, gbm_bo_get_width(bo), gbm_bo_get_height(bo), 24, 32, gbm_bo_get_stride(bo),
+                     gbm_bo_get_handle(bo).u32, &fb) != 0) {
+        LV_LOG_ERROR("drmModeAddFB failed");
+        return 0;
+    }
+    gbm_bo_set_user_data(bo, (void *)(uintptr_t)fb, fb_destroy);
+    return fb;
+}
+
+static void flip_handler(int fd, unsigned int frame, unsigned int sec, unsigned int usec, void *data)
+{
+    LV_UNUSED(fd);
+    LV_UNUSED(frame);
+    LV_UNUSED(sec);
+    LV_UNUSED(usec);
+    LV_UNUSED(data);
+    kms.flip_pending = false;
+}
+
+/* waits for a pending flip and releases the buffer it took off screen */
+static void wait_flip(void)
+{
+    drmEventContext ev = {.version = 2, .page_flip_handler = flip_handler};
+    while (kms.flip_pending) {
+        struct pollfd pfd = {.fd = kms.fd, .events = POLLIN};
+        int n = poll(&pfd, 1, FLIP_TIMEOUT_MS);
+        if (n < 0) {
+            continue; /* EINTR */
+        }
+        if (n == 0) {
+            LV_LOG_WARN("DRM page flip timed out");
+            kms.flip_pending = false;
+            break;
+        }
+        drmHandleEvent(kms.fd, &ev);
+    }
+    if (kms.bo_next) {
+        if (kms.bo_shown) {
+            gbm_surface_release_buffer(kms.surf, kms.bo_shown);
+        }
+        kms.bo_shown = kms.bo_next;
+        kms.bo_next = NULL;
+    }
+}
+
+static void present(void)
+{
+    nm_draw_gl_present(kms.mode.hdisplay, kms.mode.vdisplay);
+    wait_flip();
+    eglSwapBuffers(kms.dpy, kms.egl_surf);
+    struct gbm_bo *bo = gbm_surface_lock_front_buffer(kms.surf);
+    if (bo == NULL) {
+        LV_LOG_ERROR("gbm_surface_lock_front_buffer failed");
+        return;
+    }
+    uint32_t fb = bo_fb(bo);
+    if (fb == 0) {
+        gbm_surface_release_buffer(kms.surf, bo);
+        return;
+    }
+    if (!kms.crtc_set) {
+        /* the first frame sets the mode, synchronously */
+        if (drmModeSetCrtc(kms.fd, kms.crtc_id, fb, 0, 0, &kms.conn_id, 1, &kms.mode) != 0) {
+            LV_LOG_ERROR("drmModeSetCrtc failed");
+            gbm_surface_release_buffer(kms.surf, bo);
+            return;
+        }
+        kms.crtc_set = true;
+        kms.bo_next = bo;
+        wait_flip();
+        return;
+    }
+    if (drmModePageFlip(kms.fd, kms.crtc_id, fb, DRM_MODE_PAGE_FLIP_EVENT, NULL) != 0) {
+        LV_LOG_WARN("drmModePageFlip failed");
+        gbm_surface_release_buffer(kms.surf, bo);
+        return;
+    }
+    kms.bo_next = bo;
+    kms.flip_pending = true;
+}
+
+static void drmgl_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    LV_UNUSED(area);
+    LV_UNUSED(color_p);
+    if (lv_disp_flush_is_last(drv)) {
+        present();
+    }
+    lv_disp_flush_ready(drv);
+}
+
+/* returns NULL on error */
+lv_disp_t *nm_disp_init(void)
+{
+    if (kms_init() != 0 || egl_init() != 0) {
+        return NULL;
+    }
+    lv_coord_t hor = kms.mode.hdisplay;
+    lv_coord_t ver = kms.mode.vdisplay;
+    if (hor != NM_DISP_HOR || ver != NM_DISP_VER) {
+        LV_LOG_WARN("DRM display mismatch; expected %dx%d, got %dx%d", NM_DISP_HOR, NM_DISP_VER, hor, ver);
+    }
+    /* LVGL needs a draw buffer, but the GL draw context never writes into it:
+     * it only tells the screen apart from layers and snapshots in memory. */
+    lv_color_t *buf = calloc((size_t)hor * ver, sizeof(lv_color_t));
+    if (buf == NULL || nm_draw_gl_init(buf, hor, ver) != 0) {
+        LV_LOG_ERROR("GL draw init failed");
+        return NULL;
+    }
+    static lv_disp_draw_buf_t disp_buf;
+    lv_disp_draw_buf_init(&disp_buf, buf, NULL, (uint32_t)hor * ver);
+
+    static lv_disp_drv_t disp_drv;
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.draw_buf = &disp_buf;
+    disp_drv.flush_cb = drmgl_flush;
+    disp_drv.hor_res = hor;
+    disp_drv.ver_res = ver;
+    disp_drv.direct_mode = 1; /* the screen texture persists across frames */
+    disp_drv.antialiasing = 1;
+    disp_drv.draw_ctx_init = nm_draw_gl_ctx_init;
+    LV_LOG_INFO("DRM page flipping with GLES2 drawing enabled");
+    return lv_disp_drv_register(&disp_drv);
+}
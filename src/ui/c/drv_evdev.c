@@ -0,0 +1,307 @@
+/**
+ * evdev touchpad input driver init, shared by the fbev and drmev combos.
+ * events are read in batches, many per syscall, and each touch frame
+ * terminated by a SYN_REPORT is passed on to LVGL as a separate sample.
+ * presses and releases are reported to perf.zig as they reach LVGL, along
+ * with their evdev event age, to measure touch latency.
+ * the device stays open for the lifetime of ngui: while the screen sleeps,
+ * a gate drops input instead, up to the release of the wake-up touch.
+ */
+
+#define _DEFAULT_SOURCE /* clock_gettime */
+
+#include "lv_drivers/indev/evdev.h"
+#include "lvgl/lvgl.h"
+
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#if USE_BSD_EVDEV
+#include <dev/evdev/input.h>
+#else
+#include <linux/input.h>
+#endif
+#ifndef input_event_sec
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
+void nm_perf_touch_read(uint32_t seq, uint32_t age_us);
+void nm_perf_touch_event(void);
+
+/* max input events fetched from the device with a single read syscall */
+#define EVBUF_LEN 64
+/* max pending touch samples; oldest are dropped when full */
+#define SAMPLES_LEN 32
+
+/* a touch point as of a SYN_REPORT, in device coordinates */
+struct touch_sample {
+    int x, y;
+    lv_indev_state_t state;
+    uint32_t seq; /* input sequence number, for latency tracking */
+    int64_t ts_us; /* SYN_REPORT event timestamp in the evdev clock */
+};
+
+/* input dropped rather than handed to LVGL; see nm_indev_gate. */
+enum touch_gate {
+    GATE_OPEN,
+    GATE_CLOSED,
+    GATE_CLOSING, /* until the touch in progress is released */
+};
+
+/* touchpad device and the samples not yet handed to LVGL.
+ * accessed only from the UI thread. */
+static struct {
+    evdev_device_t dev;
+    struct touch_sample cur; /* accumulated until the next SYN_REPORT */
+    bool syn_dropped; /* discard events until the next SYN_REPORT */
+    clockid_t clock; /* of the event timestamps */
+    uint32_t seq; /* of the last queued sample */
+    lv_indev_state_t last_state; /* of the last sample handed to LVGL */
+    struct touch_sample samples[SAMPLES_LEN];
+    unsigned int head, len;
+    uint32_t dropped; /* samples lost due to a full queue */
+    enum touch_gate gate;
+} touch = {.dev = {.fd = -1}};
+
+static void touch_push(const struct touch_sample *s)
+{
+    if (touch.len == SAMPLES_LEN) {
+        touch.head = (touch.head + 1) % SAMPLES_LEN;
+        touch.len--;
+        touch.dropped++;
+    }
+    touch.samples[(touch.head + touch.len) % SAMPLES_LEN] = *s;
+    touch.len++;
+}
+
+/* updates the current sample with ev; a SYN_REPORT queues it. */
+static void touch_process(const struct input_event *ev)
+{
+    if (ev->type == EV_SYN) {
+        if (ev->code == SYN_DROPPED) {
+            touch.syn_dropped = true;
+        } else if (ev->code == SYN_REPORT) {
+            if (!touch.syn_dropped) {
+                touch.cur.seq = ++touch.seq;
+                touch.cur.ts_us = (int64_t)ev->input_event_sec * 1000000 + ev->input_event_usec;
+                touch_push(&touch.cur);
+            }
+            touch.syn_dropped = false;
+        }
+        return;
+    }
+    if (touch.syn_dropped) {
+        return;
+    }
+    if (ev->type == EV_ABS) {
+        if (ev->code == ABS_X || ev->code == ABS_MT_POSITION_X) {
+            touch.cur.x = ev->value;
+        } else if (ev->code == ABS_Y || ev->code == ABS_MT_POSITION_Y) {
+            touch.cur.y = ev->value;
+        } else if (ev->code == ABS_MT_TRACKING_ID) {
+            if (ev->value == -1) {
+                touch.cur.state = LV_INDEV_STATE_RELEASED;
+            } else if (ev->value == 0) {
+                touch.cur.state = LV_INDEV_STATE_PRESSED;
+            }
+        }
+    } else if (ev->type == EV_KEY && ev->code == BTN_TOUCH) {
+        if (ev->value == 0) {
+            touch.cur.state = LV_INDEV_STATE_RELEASED;
+        } else if (ev->value == 1) {
+            touch.cur.state = LV_INDEV_STATE_PRESSED;
+        }
+    }
+}
+
+/* drains the device, up to EVBUF_LEN events per syscall. */
+static void touch_fetch(void)
+{
+    static struct input_event evbuf[EVBUF_LEN];
+    ssize_t n;
+    while ((n = read(touch.dev.fd, evbuf, sizeof(evbuf))) > 0) {
+        size_t count = (size_t)n / sizeof(struct input_event);
+        for (size_t i = 0; i < count; i++) {
+            touch_process(&evbuf[i]);
+        }
+        if (count < EVBUF_LEN) {
+            break; /* nothing more buffered in the kernel */
+        }
+    }
+}
+
+/* same mapping as lv_drivers evdev.c: optional axes swap and calibration. */
+static lv_point_t touch_point(lv_indev_drv_t *drv, const struct touch_sample *s)
+{
+    int x = touch.dev.swap_axes ? s->y : s->x;
+    int y = touch.dev.swap_axes ? s->x : s->y;
+    int w = lv_disp_get_hor_res(drv->disp);
+    int h = lv_disp_get_ver_res(drv->disp);
+    if (touch.dev.hor_min != touch.dev.hor_max) {
+        x = (x - touch.dev.hor_min) * (w - 1) / (touch.dev.hor_max - touch.dev.hor_min);
+    }
+    if (touch.dev.ver_min != touch.dev.ver_max) {
+        y = (y - touch.dev.ver_min) * (h - 1) / (touch.dev.ver_max - touch.dev.ver_min);
+    }
+    lv_point_t p = {.x = LV_CLAMP(0, x, w - 1), .y = LV_CLAMP(0, y, h - 1)};
+    return p;
+}
+
+/* returns how long ago the sample event happened, in us. */
+static uint32_t touch_age_us(const struct touch_sample *s)
+{
+    struct timespec now;
+    if (clock_gettime(touch.clock, &now) != 0) {
+        return 0;
+    }
+    int64_t age = (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 - s->ts_us;
+    return (uint32_t)LV_CLAMP(0, age, (int64_t)UINT32_MAX);
+}
+
+/* hands queued samples to LVGL one at a time, in order, so that drags see
+ * every intermediate point instead of only the last one of a read period. */
+static void touch_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    if (touch.dev.fd < 0) {
+        return;
+    }
+    if (touch.len == 0) {
+        touch_fetch();
+        if (touch.dropped > 0 && touch.gate == GATE_OPEN) {
+            LV_LOG_WARN("dropped %u touch samples", (unsigned int)touch.dropped);
+        }
+        touch.dropped = 0;
+    }
+    /* samples of the wake-up touch, up to its release, go nowhere */
+    while (touch.gate == GATE_CLOSING && touch.len > 0) {
+        lv_indev_state_t state = touch.samples[touch.head].state;
+        touch.head = (touch.head + 1) % SAMPLES_LEN;
+        touch.len--;
+        if (state == LV_INDEV_STATE_RELEASED) {
+            touch.gate = GATE_OPEN;
+        }
+    }
+    if (touch.gate != GATE_OPEN) {
+        data->state = LV_INDEV_STATE_RELEASED;
+        data->point = touch_point(drv, &touch.cur);
+        return;
+    }
+    /* no new samples: repeat the last known state */
+    struct touch_sample s = touch.cur;
+    if (touch.len > 0) {
+        s = touch.samples[touch.head];
+        touch.head = (touch.head + 1) % SAMPLES_LEN;
+        touch.len--;
+        if (s.state != touch.last_state) {
+            nm_perf_touch_read(s.seq, touch_age_us(&s));
+        }
+        touch.last_state = s.state;
+    }
+    data->state = s.state;
+    data->point = touch_point(drv, &s);
+    data->continue_reading = touch.len > 0;
+}
+
+/* called by LVGL before each event it sends on behalf of the touchpad. */
+static void touch_feedback(lv_indev_drv_t *drv, uint8_t code)
+{
+    (void)drv;
+    if (code == LV_EVENT_PRESSED || code == LV_EVENT_CLICKED) {
+        nm_perf_touch_event();
+    }
+}
+
+int nm_indev_init(void)
+{
+    /* closes and opens evdev again if already inited */
+    if (touch.dev.fd >= 0) {
+        close(touch.dev.fd);
+    }
+    evdev_device_init(&touch.dev);
+#if EVDEV_SWAP_AXES
+    evdev_device_set_swap_axes(&touch.dev, true);
+#endif
+#if EVDEV_CALIBRATE
+    evdev_device_set_calibration(&touch.dev, EVDEV_HOR_MIN, EVDEV_VER_MIN, EVDEV_HOR_MAX, EVDEV_VER_MAX);
+#endif
+    evdev_device_set_file(&touch.dev, EVDEV_NAME);
+    /* event timestamps are in CLOCK_REALTIME unless told otherwise,
+     * which jumps on a time sync */
+    touch.clock = CLOCK_REALTIME;
+#ifdef EVIOCSCLOCKID
+    int clk = CLOCK_MONOTONIC;
+    if (touch.dev.fd >= 0 && ioctl(touch.dev.fd, EVIOCSCLOCKID, &clk) == 0) {
+        touch.clock = CLOCK_MONOTONIC;
+    }
+#endif
+    touch.cur = (struct touch_sample){.state = LV_INDEV_STATE_RELEASED};
+    touch.last_state = LV_INDEV_STATE_RELEASED;
+    touch.syn_dropped = false;
+    touch.head = 0;
+    touch.len = 0;
+
+    /* keypad input devices default group;
+     * future-proof: don't have any atm */
+    lv_group_t *g = lv_group_create();
+    if (g == NULL) {
+        return -1;
+    }
+    lv_group_set_default(g);
+
+    static lv_indev_drv_t touchpad_drv;
+    lv_indev_drv_init(&touchpad_drv);
+    touchpad_drv.type = LV_INDEV_TYPE_POINTER;
+    touchpad_drv.read_cb = touch_read;
+    touchpad_drv.feedback_cb = touch_feedback;
+    lv_indev_t *touchpad = lv_indev_drv_register(&touchpad_drv);
+    if (touchpad == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * returns the non-blocking touchpad device fd, for the UI loop to poll while
+ * idle or asleep; -1 if unavailable. the fd is read only by the driver.
+ */
+int nm_indev_fd(void)
+{
+    return touch.dev.fd;
+}
+
+/**
+ * closes the gate, dropping all input with nm_indev_drain until opened
+ * again. an open gate keeps dropping input until the touch in progress, if
+ * any, is released, so that a wake-up tap triggers no action.
+ */
+void nm_indev_gate(bool closed)
+{
+    if (closed) {
+        touch.gate = GATE_CLOSED;
+        touch.len = 0;
+        touch.last_state = LV_INDEV_STATE_RELEASED;
+        lv_indev_reset(NULL, NULL);
+        return;
+    }
+    if (touch.gate == GATE_CLOSED) {
+        touch.gate = touch.cur.state == LV_INDEV_STATE_PRESSED ? GATE_CLOSING : GATE_OPEN;
+    }
+}
+
+/**
+ * reads and drops all pending input behind a closed gate. the touch state
+ * is still tracked, for nm_indev_gate. returns true if there was any.
+ */
+bool nm_indev_drain(void)
+{
+    if (touch.dev.fd < 0) {
+        return false;
+    }
+    uint32_t seq = touch.seq;
+    touch_fetch();
+    touch.len = 0;
+    touch.dropped = 0;
+    return touch.seq != seq;
+}
@@ -1,106 +1,350 @@
 /**
- * framebuffer display + evdev touchpad drivers init
+ * framebuffer display driver init; input is in drv_evdev.c
+ *
+ * LVGL renders in RGB565 only, fixed by LV_COLOR_DEPTH. at startup, a
+ * framebuffer in any other mode, such as 32bpp on some Pi firmware configs,
+ * is switched to RGB565 for the flushes to be page flips or straight copies.
+ * if the driver refuses, 24 and 32bpp modes are converted to on flush.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "lv_drivers/display/fbdev.h"
-#include "lv_drivers/indev/evdev.h"
 #include "lvgl/lvgl.h"
 
 #include <fcntl.h>
+#include <linux/fb.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
-#if USE_BSD_EVDEV
-#include <dev/evdev/input.h>
-#else
-#include <linux/input.h>
-#endif
 
 #define DISP_BUF_SIZE (NM_DISP_HOR * NM_DISP_VER / 10)
 
-/* returns NULL on error */
-lv_disp_t *nm_disp_init(void)
-{
-    fbdev_init();
+#ifdef NM_DRAW_NEON
+/* defined in draw_neon.c */
+void nm_draw_neon_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+#endif
 
-    static lv_disp_draw_buf_t buf;
-    static lv_color_t cb[DISP_BUF_SIZE];
-    lv_disp_draw_buf_init(&buf, cb, NULL, DISP_BUF_SIZE);
-    uint32_t hor, vert;
-    fbdev_get_sizes(&hor, &vert, NULL);
-    if (hor != NM_DISP_HOR || vert != NM_DISP_VER) {
-        LV_LOG_WARN("framebuffer display mismatch; expected %dx%d", NM_DISP_HOR, NM_DISP_VER);
+/* whether a screen info describes the LVGL pixel format. drivers which leave
+ * the bitfields unset are taken at their bits per pixel. */
+static bool is_native(const struct fb_var_screeninfo *v)
+{
+    if (v->bits_per_pixel != LV_COLOR_DEPTH) {
+        return false;
+    }
+    if (v->red.length == 0 && v->green.length == 0 && v->blue.length == 0) {
+        return true;
     }
+    return v->red.offset == 11 && v->red.length == 5 && v->green.offset == 5 && v->green.length == 6 &&
+           v->blue.offset == 0 && v->blue.length == 5;
+}
 
-    static lv_disp_drv_t disp_drv;
-    lv_disp_drv_init(&disp_drv);
-    disp_drv.draw_buf = &buf;
-    disp_drv.hor_res = NM_DISP_HOR;
-    disp_drv.ver_res = NM_DISP_VER;
-    disp_drv.antialiasing = 1;
-    disp_drv.flush_cb = fbdev_flush;
-    return lv_disp_drv_register(&disp_drv);
+/* switches the framebuffer to RGB565 unless already so. returns whether the
+ * framebuffer is in the LVGL pixel format. */
+static bool fb_probe(void)
+{
+    struct fb_var_screeninfo vinfo;
+    int fd = open(FBDEV_PATH, O_RDWR);
+    if (fd == -1) {
+        return false;
+    }
+    bool native = false;
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == -1) {
+        goto done;
+    }
+    native = is_native(&vinfo);
+    if (native) {
+        goto done;
+    }
+    LV_LOG_INFO("framebuffer is %ubpp; switching to RGB565", vinfo.bits_per_pixel);
+    vinfo.bits_per_pixel = 16;
+    vinfo.red = (struct fb_bitfield){.offset = 11, .length = 5};
+    vinfo.green = (struct fb_bitfield){.offset = 5, .length = 6};
+    vinfo.blue = (struct fb_bitfield){.offset = 0, .length = 5};
+    vinfo.transp = (struct fb_bitfield){0};
+    vinfo.activate = FB_ACTIVATE_NOW;
+    if (ioctl(fd, FBIOPUT_VSCREENINFO, &vinfo) == -1 || ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == -1) {
+        goto done;
+    }
+    native = is_native(&vinfo);
+done:
+    close(fd);
+    return native;
 }
 
-int nm_indev_init(void)
+/* conversion state for a framebuffer which stays in another pixel format */
+static struct {
+    uint8_t *fbp;
+    uint32_t line_length;
+    uint32_t xres, yres;
+    uint32_t bytes_pp; /* 3 or 4 */
+    /* framebuffer pixel bits of each RGB565 channel value */
+    uint32_t red[32];
+    uint32_t green[64];
+    uint32_t blue[32];
+} conv;
+
+/* expands an n-bit channel value into a framebuffer bitfield */
+static void conv_table(uint32_t *table, uint32_t n, const struct fb_bitfield *f)
 {
-    /* lv driver correctly closes and opens evdev again if already inited */
-    evdev_init();
+    uint32_t max = (1u << n) - 1;
+    uint32_t fmax = (1u << f->length) - 1;
+    for (uint32_t v = 0; v <= max; v++) {
+        table[v] = (v * fmax + max / 2) / max << f->offset;
+    }
+}
 
-    /* keypad input devices default group;
-     * future-proof: don't have any atm */
-    lv_group_t *g = lv_group_create();
-    if (g == NULL) {
+/* sets up converting flushes. returns 0 on success, or -1 if the
+ * framebuffer format is unsupported. */
+static int conv_init(void)
+{
+    struct fb_var_screeninfo vinfo;
+    struct fb_fix_screeninfo finfo;
+    int fd = open(FBDEV_PATH, O_RDWR);
+    if (fd == -1) {
         return -1;
     }
-    lv_group_set_default(g);
-
-    static lv_indev_drv_t touchpad_drv;
-    lv_indev_drv_init(&touchpad_drv);
-    touchpad_drv.type = LV_INDEV_TYPE_POINTER;
-    touchpad_drv.read_cb = evdev_read;
-    lv_indev_t *touchpad = lv_indev_drv_register(&touchpad_drv);
-    if (touchpad == NULL) {
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == -1 || ioctl(fd, FBIOGET_FSCREENINFO, &finfo) == -1 ||
+        (vinfo.bits_per_pixel != 24 && vinfo.bits_per_pixel != 32)) {
+        close(fd);
         return -1;
     }
-
+    void *fbp = mmap(NULL, finfo.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); /* the mapping stays */
+    if (fbp == MAP_FAILED) {
+        return -1;
+    }
+    conv.fbp = (uint8_t *)fbp + (size_t)vinfo.yoffset * finfo.line_length + vinfo.xoffset * (vinfo.bits_per_pixel / 8);
+    conv.line_length = finfo.line_length;
+    conv.xres = vinfo.xres;
+    conv.yres = vinfo.yres;
+    conv.bytes_pp = vinfo.bits_per_pixel / 8;
+    conv_table(conv.red, 5, &vinfo.red);
+    conv_table(conv.green, 6, &vinfo.green);
+    conv_table(conv.blue, 5, &vinfo.blue);
+    LV_LOG_INFO("framebuffer stays %ubpp; converting on flush", vinfo.bits_per_pixel);
     return 0;
 }
 
-int nm_open_evdev_nonblock(void)
+/* a fbdev_flush replacement for 24 and 32bpp framebuffers */
+static void conv_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
 {
-    // see lib/lv_drivers/indev/evdev.c
-#if USE_BSD_EVDEV
-    int fd = open(EVDEV_NAME, O_RDWR | O_NOCTTY);
-#else
-    int fd = open(EVDEV_NAME, O_RDWR | O_NOCTTY | O_NDELAY);
-#endif
-    if (fd == -1) {
-        return -1;
+    int32_t x1 = LV_MAX(area->x1, 0);
+    int32_t y1 = LV_MAX(area->y1, 0);
+    int32_t x2 = LV_MIN(area->x2, (int32_t)conv.xres - 1);
+    int32_t y2 = LV_MIN(area->y2, (int32_t)conv.yres - 1);
+    lv_coord_t w = lv_area_get_width(area);
+    for (int32_t y = y1; y <= y2; y++) {
+        const lv_color_t *src = color_p + (size_t)(y - area->y1) * w + (x1 - area->x1);
+        uint8_t *dst = conv.fbp + (size_t)y * conv.line_length + (size_t)x1 * conv.bytes_pp;
+        if (conv.bytes_pp == 4) {
+            uint32_t *d = (uint32_t *)dst;
+            for (int32_t x = x1; x <= x2; x++, src++) {
+                *d++ = conv.red[src->ch.red] | conv.green[src->ch.green] | conv.blue[src->ch.blue];
+            }
+        }
+        else {
+            for (int32_t x = x1; x <= x2; x++, src++) {
+                uint32_t px = conv.red[src->ch.red] | conv.green[src->ch.green] | conv.blue[src->ch.blue];
+                *dst++ = px & 0xff;
+                *dst++ = (px >> 8) & 0xff;
+                *dst++ = (px >> 16) & 0xff;
+            }
+        }
     }
-#if USE_BSD_EVDEV
-    fcntl(fd, F_SETFL, O_NONBLOCK);
-#else
-    fcntl(fd, F_SETFL, O_ASYNC | O_NONBLOCK);
-#endif
-    return fd;
+    lv_disp_flush_ready(drv);
 }
 
-void nm_close_evdev(int fd)
+/* page flipping state; flip.fd is -1 when unused */
+static struct {
+    int fd;
+    struct fb_var_screeninfo vinfo;
+    lv_color_t *front; /* first screen-sized buffer at yoffset 0 */
+} flip = {.fd = -1};
+
+/* LVGL renders directly into the off-screen half of the framebuffer and
+ * syncs the damaged areas between the two halves by itself (direct_mode).
+ * flushing is then only a matter of panning the display to the rendered half
+ * once the last area of a frame is ready. */
+static void flip_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
 {
-    if (fd != -1) {
-        close(fd);
+    (void)area;
+    if (lv_disp_flush_is_last(drv)) {
+        flip.vinfo.yoffset = color_p == flip.front ? 0 : flip.vinfo.yres;
+        if (ioctl(flip.fd, FBIOPAN_DISPLAY, &flip.vinfo) == -1) {
+            LV_LOG_WARN("FBIOPAN_DISPLAY failed");
+        }
+        /* not all drivers support vsync; tearing is still reduced without it */
+        int zero = 0;
+        ioctl(flip.fd, FBIO_WAITFORVSYNC, &zero);
     }
+    lv_disp_flush_ready(drv);
 }
 
-bool nm_consume_input_events(int fd)
+/* partial rendering flush worker state */
+static struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cond; /* signaled when a flush is queued */
+    lv_disp_drv_t *drv;  /* non-NULL while a flush is queued */
+    void (*flush)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *); /* into the framebuffer */
+    lv_area_t area;
+    lv_color_t *color_p;
+} copier = {
+    .mu = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* copies queued areas into the framebuffer, one at a time. copier.flush
+ * signals lv_disp_flush_ready once done, letting LVGL flush the other buffer
+ * it has rendered meanwhile. */
+static void *copier_loop(void *arg)
 {
+    (void)arg;
+    pthread_mutex_lock(&copier.mu);
+    for (;;) {
+        while (copier.drv == NULL) {
+            pthread_cond_wait(&copier.cond, &copier.mu);
+        }
+        lv_disp_drv_t *drv = copier.drv;
+        lv_area_t area = copier.area;
+        lv_color_t *color_p = copier.color_p;
+        copier.drv = NULL;
+        pthread_mutex_unlock(&copier.mu);
+        copier.flush(drv, &area, color_p);
+        pthread_mutex_lock(&copier.mu);
+    }
+    return NULL;
+}
+
+/* queues the area for the copier thread and returns right away, for LVGL to
+ * render into the other draw buffer. LVGL waits on flush ready before the next
+ * flush, so there is at most one area queued. */
+static void async_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    pthread_mutex_lock(&copier.mu);
+    copier.drv = drv;
+    copier.area = *area;
+    copier.color_p = color_p;
+    pthread_cond_signal(&copier.cond);
+    pthread_mutex_unlock(&copier.mu);
+}
+
+/* sets up two screen-sized buffers in the framebuffer memory for page flipping.
+ * returns 0 on success, or -1 if the framebuffer device lacks support for it,
+ * for example a too small virtual resolution or a pixel format different from
+ * LV_COLOR_DEPTH. */
+static int flip_init(lv_disp_draw_buf_t *buf)
+{
+    const size_t frame_size = (size_t)NM_DISP_HOR * NM_DISP_VER * sizeof(lv_color_t);
+    struct fb_var_screeninfo vinfo;
+    struct fb_fix_screeninfo finfo;
+    void *fbp;
+
+    int fd = open(FBDEV_PATH, O_RDWR);
     if (fd == -1) {
-        return false;
+        return -1;
+    }
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == -1) {
+        goto fail;
+    }
+    if (vinfo.xres != NM_DISP_HOR || vinfo.yres != NM_DISP_VER || vinfo.bits_per_pixel != LV_COLOR_DEPTH) {
+        goto fail;
     }
-    struct input_event in;
-    int count = 0;
-    while (read(fd, &in, sizeof(struct input_event)) > 0) {
-        count++;
+    if (vinfo.yres_virtual < 2 * vinfo.yres) {
+        vinfo.yres_virtual = 2 * vinfo.yres;
+        if (ioctl(fd, FBIOPUT_VSCREENINFO, &vinfo) == -1 || ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == -1) {
+            goto fail;
+        }
+        if (vinfo.yres_virtual < 2 * vinfo.yres) {
+            goto fail;
+        }
     }
-    return count > 0;
+    if (ioctl(fd, FBIOGET_FSCREENINFO, &finfo) == -1) {
+        goto fail;
+    }
+    /* LVGL direct mode assumes the buffer stride equals horizontal resolution */
+    if (finfo.line_length != NM_DISP_HOR * sizeof(lv_color_t) || finfo.smem_len < 2 * frame_size) {
+        goto fail;
+    }
+    fbp = mmap(NULL, 2 * frame_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fbp == MAP_FAILED) {
+        goto fail;
+    }
+    vinfo.xoffset = 0;
+    vinfo.yoffset = 0;
+    if (ioctl(fd, FBIOPAN_DISPLAY, &vinfo) == -1) {
+        munmap(fbp, 2 * frame_size);
+        goto fail;
+    }
+
+    flip.fd = fd;
+    flip.vinfo = vinfo;
+    flip.front = (lv_color_t *)fbp;
+    lv_disp_draw_buf_init(buf, flip.front, (char *)fbp + frame_size, NM_DISP_HOR * NM_DISP_VER);
+    return 0;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+/* returns NULL on error */
+lv_disp_t *nm_disp_init(void)
+{
+    static lv_disp_draw_buf_t buf;
+    static lv_disp_drv_t disp_drv;
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.draw_buf = &buf;
+    disp_drv.hor_res = NM_DISP_HOR;
+    disp_drv.ver_res = NM_DISP_VER;
+    disp_drv.antialiasing = 1;
+#ifdef NM_DRAW_NEON
+    disp_drv.draw_ctx_init = nm_draw_neon_ctx_init;
+#endif
+
+    bool native = fb_probe();
+    if (native && flip_init(&buf) == 0) {
+        LV_LOG_INFO("framebuffer page flipping enabled");
+        disp_drv.direct_mode = 1;
+        disp_drv.flush_cb = flip_flush;
+        return lv_disp_drv_register(&disp_drv);
+    }
+
+    /* fall back to partial rendering, copied into the framebuffer on flush */
+    LV_LOG_INFO("framebuffer page flipping unsupported; using partial buffer");
+    copier.flush = fbdev_flush;
+    uint32_t hor, vert;
+    if (!native && conv_init() == 0) {
+        copier.flush = conv_flush;
+        hor = conv.xres;
+        vert = conv.yres;
+    }
+    else {
+        if (!native) {
+            LV_LOG_WARN("unsupported framebuffer pixel format");
+        }
+        fbdev_init();
+        fbdev_get_sizes(&hor, &vert, NULL);
+    }
+    if (hor != NM_DISP_HOR || vert != NM_DISP_VER) {
+        LV_LOG_WARN("framebuffer display mismatch; expected %dx%d", NM_DISP_HOR, NM_DISP_VER);
+    }
+    /* two buffers: LVGL renders into one while the copier thread copies
+     * the other into the framebuffer. */
+    static lv_color_t cb[DISP_BUF_SIZE];
+    static lv_color_t cb2[DISP_BUF_SIZE];
+    pthread_t th;
+    if (pthread_create(&th, NULL, copier_loop, NULL) == 0) {
+        pthread_detach(th);
+        lv_disp_draw_buf_init(&buf, cb, cb2, DISP_BUF_SIZE);
+        disp_drv.flush_cb = async_flush;
+    }
+    else {
+        LV_LOG_WARN("flush thread: pthread_create failed; copying synchronously");
+        lv_disp_draw_buf_init(&buf, cb, NULL, DISP_BUF_SIZE);
+        disp_drv.flush_cb = copier.flush;
+    }
+    return lv_disp_drv_register(&disp_drv);
 }
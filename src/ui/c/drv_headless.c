@@ -0,0 +1,52 @@
+/**
+ * offscreen display driver with no input devices, for benchmarks and tests.
+ * flushed areas are copied into an in-memory framebuffer, similar to what
+ * fbdev does, so that flush times remain comparable.
+ */
+
+#include "lvgl/lvgl.h"
+
+#include <string.h>
+
+#define DISP_BUF_SIZE (NM_DISP_HOR * NM_DISP_VER / 10)
+
+static lv_color_t framebuf[NM_DISP_HOR * NM_DISP_VER];
+
+static void headless_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    lv_coord_t w = lv_area_get_width(area);
+    for (lv_coord_t y = area->y1; y <= area->y2; y++) {
+        memcpy(&framebuf[y * NM_DISP_HOR + area->x1], color_p, w * sizeof(lv_color_t));
+        color_p += w;
+    }
+    lv_disp_flush_ready(drv);
+}
+
+lv_disp_t *nm_disp_init(void)
+{
+    static lv_color_t buf[DISP_BUF_SIZE];
+    static lv_color_t buf2[DISP_BUF_SIZE];
+    static lv_disp_draw_buf_t disp_buf;
+    lv_disp_draw_buf_init(&disp_buf, buf, buf2, DISP_BUF_SIZE);
+
+    static lv_disp_drv_t disp_drv;
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.draw_buf = &disp_buf;
+    disp_drv.flush_cb = headless_flush;
+    disp_drv.hor_res = NM_DISP_HOR;
+    disp_drv.ver_res = NM_DISP_VER;
+    disp_drv.antialiasing = 1;
+    return lv_disp_drv_register(&disp_drv);
+}
+
+int nm_indev_init(void)
+{
+    /* keypad input devices default group, as with the other drivers */
+    lv_group_t *g = lv_group_create();
+    if (g == NULL) {
+        LV_LOG_WARN("lv_group_create returned NULL; won't set default group");
+        return -1;
+    }
+    lv_group_set_default(g);
+    return 0;
+}
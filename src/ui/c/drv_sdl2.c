@@ -1,8 +1,14 @@
 /**
- * SDL2 drivers init for display, keyboard and mouse
+ * SDL2 drivers init for display, keyboard and mouse.
+ * with USE_SDL_GPU, LVGL draws with SDL_Renderer into a screen texture
+ * instead of rendering in software into memory buffers.
  */
 
+#if USE_SDL_GPU
+#include "lv_drivers/sdl/sdl_gpu.h"
+#else
 #include "lv_drivers/sdl/sdl.h"
+#endif
 #include "lvgl/lvgl.h"
 #include "lvgl/src/misc/lv_log.h"
 
@@ -27,12 +33,18 @@ lv_disp_t *nm_disp_init(void)
         }
     }
 
+    static lv_disp_drv_t disp_drv;
+#if USE_SDL_GPU
+    /* also sets direct_mode, flush_cb and a texture draw_buf */
+    sdl_disp_drv_init(&disp_drv, NM_DISP_HOR, NM_DISP_VER);
+    LV_LOG_INFO("SDL renderer drawing enabled");
+    return lv_disp_drv_register(&disp_drv);
+#else
     static lv_disp_draw_buf_t buf;
     static lv_color_t cb1[NM_DISP_HOR * 100];
     static lv_color_t cb2[NM_DISP_HOR * 100];
     lv_disp_draw_buf_init(&buf, cb1, cb2, NM_DISP_HOR * 100);
 
-    static lv_disp_drv_t disp_drv;
     lv_disp_drv_init(&disp_drv);
     disp_drv.draw_buf = &buf;
     disp_drv.flush_cb = sdl_display_flush;
@@ -40,6 +52,7 @@ lv_disp_t *nm_disp_init(void)
     disp_drv.ver_res = NM_DISP_VER;
     disp_drv.antialiasing = 1;
     return lv_disp_drv_register(&disp_drv);
+#endif
 }
 
 int nm_indev_init(void)
@@ -0,0 +1,26 @@
+#ifndef NM_LV_CACHE_STATS_H
+#define NM_LV_CACHE_STATS_H
+
+/**
+ * LVGL cache counters, incremented by LVGL via LV_CACHE_STAT when built
+ * with LV_CACHE_STATS. the variable is defined in ui/lvgl.zig.
+ */
+
+#include <stdint.h>
+
+struct nm_lvgl_cache_stats {
+    uint32_t img_hit;
+    uint32_t img_miss;
+    uint32_t grad_hit;
+    uint32_t grad_miss;
+    uint32_t circle_hit;
+    uint32_t circle_miss;
+    uint32_t style_hit;
+    uint32_t style_miss;
+    uint32_t txt_hit;
+    uint32_t txt_miss;
+};
+
+extern struct nm_lvgl_cache_stats nm_lvgl_cache_stats;
+
+#endif
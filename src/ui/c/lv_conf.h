@@ -35,12 +35,12 @@
  *=========================*/
 
 /*1: use custom malloc/free, 0: use the built-in `lv_mem_alloc()` and `lv_mem_free()`*/
-// TODO: research benefits of lv_mem_alloc
+/*nm_lv_xxx pool small allocations in size classes; see lvmem.zig*/
 #define LV_MEM_CUSTOM 1
-#define LV_MEM_CUSTOM_INCLUDE <stdlib.h>
-#define LV_MEM_CUSTOM_ALLOC   malloc
-#define LV_MEM_CUSTOM_FREE    free
-#define LV_MEM_CUSTOM_REALLOC realloc
+#define LV_MEM_CUSTOM_INCLUDE "lv_custom_mem.h"
+#define LV_MEM_CUSTOM_ALLOC   nm_lv_malloc
+#define LV_MEM_CUSTOM_FREE    nm_lv_free
+#define LV_MEM_CUSTOM_REALLOC nm_lv_realloc
 
 /*Number of the intermediate memory buffer used during rendering and other internal processing mechanisms.
  *You will see an error log message if there wasn't enough buffers. */
@@ -84,7 +84,8 @@
 * The circumference of 1/4 circle are saved for anti-aliasing
 * radius * 4 bytes are used per circle (the most often used radiuses are saved)
 * 0: to disable caching */
-#define LV_CIRCLE_CACHE_SIZE 4
+/* defined in build.zig */
+/*#define LV_CIRCLE_CACHE_SIZE 4*/
 
 /**
  * "Simple layers" are used when a widget has `style_opa < 255` to buffer the widget into a layer
@@ -107,7 +108,8 @@
  *With complex image decoders (e.g. PNG or JPG) caching can save the continuous open/decode of images.
  *However the opened images might consume additional RAM.
  *0: to disable caching*/
-#define LV_IMG_CACHE_DEF_SIZE 0
+/* defined in build.zig */
+/*#define LV_IMG_CACHE_DEF_SIZE 0*/
 
 /*Number of stops allowed per gradient. Increase this to allow more stops.
  *This adds (sizeof(lv_color_t) + 1) bytes per additional stop*/
@@ -118,7 +120,29 @@
  *LV_GRAD_CACHE_DEF_SIZE sets the size of this cache in bytes.
  *If the cache is too small the map will be allocated only while it's required for the drawing.
  *0 mean no caching.*/
-#define LV_GRAD_CACHE_DEF_SIZE 0
+/* defined in build.zig */
+/*#define LV_GRAD_CACHE_DEF_SIZE 0*/
+
+/*Number of resolved style properties cached across all objects, to speed up
+ *lv_obj_get_style_prop. An entry is 32 bytes on 64-bit. 0: to disable caching*/
+/* defined in build.zig */
+/*#define LV_STYLE_CACHE_SIZE 0*/
+
+/*Number of text layouts, the line breaks and widths of a text in a font, cached
+ *to speed up measuring and drawing labels re-set to the same text.
+ *Texts of more than LV_TXT_CACHE_LINES lines are not cached. 0: to disable caching*/
+/* defined in build.zig */
+/*#define LV_TXT_CACHE_SIZE 0*/
+#define LV_TXT_CACHE_LINES 8
+
+/*Count image, gradient, circle, style and text cache hits and misses in nm_lvgl_cache_stats.
+ *LV_CACHE_STATS is defined in build.zig.*/
+#if LV_CACHE_STATS
+    #include "lv_cache_stats.h"
+    #define LV_CACHE_STAT(name) (nm_lvgl_cache_stats.name++)
+#else
+    #define LV_CACHE_STAT(name)
+#endif
 
 /*Allow dithering the gradients (to achieve visual smooth color gradients on limited color depth display)
  *LV_DITHER_GRADIENT implies allocating one or two more lines of the object's rendering surface
@@ -165,8 +189,10 @@
 /*Use NXP's VG-Lite GPU iMX RTxxx platforms*/
 #define LV_USE_GPU_NXP_VG_LITE 0
 
-/*Use SDL renderer API*/
+/*Use SDL renderer API; enabled by the sdl2gpu build driver*/
+#ifndef LV_USE_GPU_SDL
 #define LV_USE_GPU_SDL 0
+#endif
 #if LV_USE_GPU_SDL
     #define LV_GPU_SDL_INCLUDE_PATH <SDL2/SDL.h>
     /*Texture cache size, 8MB by default*/
@@ -304,7 +330,7 @@
 #define LV_EXPORT_CONST_INT(int_value) struct _silence_gcc_warning /*The default value just prevents GCC warning*/
 
 /*Extend the default -32k..32k coordinate range to -4M..4M by using int32_t for coordinates instead of int16_t*/
-#define LV_USE_LARGE_COORD 0
+#define LV_USE_LARGE_COORD 1
 
 /*==================
  *   FONT USAGE
@@ -410,7 +436,8 @@
 /*Support bidirectional texts. Allows mixing Left-to-Right and Right-to-Left texts.
  *The direction will be processed according to the Unicode Bidirectional Algorithm:
  *https://www.w3.org/International/articles/inline-bidi-markup/uba-basics*/
-#define LV_USE_BIDI 1
+/*ngui texts are all left-to-right.*/
+#define LV_USE_BIDI 0
 #if LV_USE_BIDI
     /*Set the default direction. Supported values:
     *`LV_BASE_DIR_LTR` Left-to-Right
@@ -429,7 +456,11 @@
 
 /*Documentation of the widgets: https://docs.lvgl.io/latest/en/html/widgets/index.html*/
 
-#define LV_USE_ARC        1
+/*Widgets and themes unused by ngui are set to NM_LVGL_ALL_WIDGETS, defined in build.zig:
+ *they are compiled out by default for a smaller binary and faster startup.
+ *Enabling a new widget in the UI code requires setting it to 1 here, along with its dependencies.*/
+
+#define LV_USE_ARC        1   /*Required by: lv_spinner*/
 
 #define LV_USE_BAR        1
 
@@ -437,9 +468,9 @@
 
 #define LV_USE_BTNMATRIX  1
 
-#define LV_USE_CANVAS     1
+#define LV_USE_CANVAS     1   /*Required by: lv_qrcode*/
 
-#define LV_USE_CHECKBOX   1
+#define LV_USE_CHECKBOX   NM_LVGL_ALL_WIDGETS
 
 #define LV_USE_DROPDOWN   1   /*Requires: lv_label*/
 
@@ -447,25 +478,25 @@
 
 #define LV_USE_LABEL      1
 #if LV_USE_LABEL
-    #define LV_LABEL_TEXT_SELECTION 1 /*Enable selecting text of the label*/
+    #define LV_LABEL_TEXT_SELECTION 0 /*Enable selecting text of the label; unused in ngui, including textareas*/
     #define LV_LABEL_LONG_TXT_HINT 1  /*Store some extra info in labels to speed up drawing of very long texts*/
 #endif
 
-#define LV_USE_LINE       1
+#define LV_USE_LINE       NM_LVGL_ALL_WIDGETS
 
-#define LV_USE_ROLLER     1   /*Requires: lv_label*/
+#define LV_USE_ROLLER     NM_LVGL_ALL_WIDGETS   /*Requires: lv_label*/
 #if LV_USE_ROLLER
     #define LV_ROLLER_INF_PAGES 7 /*Number of extra "pages" when the roller is infinite*/
 #endif
 
-#define LV_USE_SLIDER     1   /*Requires: lv_bar*/
+#define LV_USE_SLIDER     NM_LVGL_ALL_WIDGETS   /*Requires: lv_bar*/
 
-#define LV_USE_SWITCH     1
+#define LV_USE_SWITCH     NM_LVGL_ALL_WIDGETS
 
 #define LV_USE_TEXTAREA   1   /*Requires: lv_label*/
 #define LV_TEXTAREA_DEF_PWD_SHOW_TIME 1500    /*ms*/
 
-#define LV_USE_TABLE      1
+#define LV_USE_TABLE      NM_LVGL_ALL_WIDGETS
 
 /*==================
  * EXTRA COMPONENTS
@@ -474,9 +505,9 @@
 /*-----------
  * Widgets
  *----------*/
-#define LV_USE_ANIMIMG    1
+#define LV_USE_ANIMIMG    NM_LVGL_ALL_WIDGETS
 
-#define LV_USE_CALENDAR   1
+#define LV_USE_CALENDAR   NM_LVGL_ALL_WIDGETS
 #define LV_CALENDAR_WEEK_STARTS_MONDAY 1
 #if LV_CALENDAR_WEEK_STARTS_MONDAY
     #define LV_CALENDAR_DEFAULT_DAY_NAMES {"Mo", "Tu", "We", "Th", "Fr", "Sa", "Su"}
@@ -490,33 +521,33 @@
 
 #define LV_USE_CHART      1
 
-#define LV_USE_COLORWHEEL 1
+#define LV_USE_COLORWHEEL NM_LVGL_ALL_WIDGETS
 
-#define LV_USE_IMGBTN     1
+#define LV_USE_IMGBTN     NM_LVGL_ALL_WIDGETS
 
 #define LV_USE_KEYBOARD   1
 
-#define LV_USE_LED        1
+#define LV_USE_LED        NM_LVGL_ALL_WIDGETS
 
-#define LV_USE_LIST       1
+#define LV_USE_LIST       NM_LVGL_ALL_WIDGETS
 
-#define LV_USE_MENU       1
+#define LV_USE_MENU       NM_LVGL_ALL_WIDGETS
 
-#define LV_USE_METER      1
+#define LV_USE_METER      NM_LVGL_ALL_WIDGETS
 
 #define LV_USE_MSGBOX     1
 
-#define LV_USE_SPAN       1
+#define LV_USE_SPAN       NM_LVGL_ALL_WIDGETS
 /*A line text can contain maximum num of span descriptor */
 #define LV_SPAN_SNIPPET_STACK_SIZE 64
 
-#define LV_USE_SPINBOX    1
+#define LV_USE_SPINBOX    NM_LVGL_ALL_WIDGETS
 
 #define LV_USE_SPINNER    1
 
 #define LV_USE_TABVIEW    1
 
-#define LV_USE_TILEVIEW   1
+#define LV_USE_TILEVIEW   NM_LVGL_ALL_WIDGETS
 
 #define LV_USE_WIN        1
 
@@ -539,10 +570,10 @@
 #endif /*LV_USE_THEME_DEFAULT*/
 
 /*A very simple theme that is a good starting point for a custom theme*/
-#define LV_USE_THEME_BASIC 1
+#define LV_USE_THEME_BASIC NM_LVGL_ALL_WIDGETS
 
 /*A theme designed for monochrome displays*/
-#define LV_USE_THEME_MONO 1
+#define LV_USE_THEME_MONO NM_LVGL_ALL_WIDGETS
 
 /*-----------
  * Layouts
@@ -624,6 +655,13 @@
     #endif
 #endif
 
+/*Tiny TTF library*/
+#define LV_USE_TINY_TTF 1
+#if LV_USE_TINY_TTF
+    /*Load TTF data from files*/
+    #define LV_TINY_TTF_FILE_SUPPORT 0
+#endif
+
 /*Rlottie library*/
 #define LV_USE_RLOTTIE 0
 
@@ -640,7 +678,7 @@
  *----------*/
 
 /*1: Enable API to take snapshot for object*/
-#define LV_USE_SNAPSHOT 0
+#define LV_USE_SNAPSHOT 1
 
 /*1: Enable Monkey test*/
 #define LV_USE_MONKEY 0
@@ -695,8 +733,8 @@
 /*Demonstrate the usage of encoder and keyboard*/
 #define LV_USE_DEMO_KEYPAD_AND_ENCODER 0
 
-/*Benchmark your system*/
-#define LV_USE_DEMO_BENCHMARK 0
+/*Benchmark your system; only in lvbench builds, NM_LVBENCH defined in build.zig*/
+#define LV_USE_DEMO_BENCHMARK NM_LVBENCH
 #if LV_USE_DEMO_BENCHMARK
 /*Use RGB565A8 images with 16 bit color depth instead of ARGB8565*/
 #define LV_DEMO_BENCHMARK_RGB565A8 0
@@ -0,0 +1,15 @@
+#ifndef NM_LV_CUSTOM_MEM_H
+#define NM_LV_CUSTOM_MEM_H
+
+/**
+ * this file exists to satisfy LV_MEM_CUSTOM_INCLUDE.
+ * the functions are implemented in lvmem.zig.
+ */
+
+#include <stddef.h>
+
+void *nm_lv_malloc(size_t size);
+void nm_lv_free(void *ptr);
+void *nm_lv_realloc(void *ptr, size_t size);
+
+#endif
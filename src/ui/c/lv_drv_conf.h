@@ -192,6 +192,15 @@
 #  define USE_X11       0
 #endif
 
+#if USE_X11
+/*Share the frame with the X server over MIT-SHM instead of sending it
+ *through the socket on every flush. Falls back to XPutImage if the server
+ *doesn't support it, for example a remote display. Needs libXext.*/
+#  ifndef X11_USE_SHM
+#    define X11_USE_SHM 1
+#  endif
+#endif
+
 /*----------------
  *    SSD1963
  *--------------*/
@@ -337,8 +346,8 @@
 /*-----------------------------------------
  *  DRM/KMS device (/dev/dri/cardX)
  *-----------------------------------------*/
-// TODO: consider switching to DRM?
-// see https://forum.lvgl.io/t/drm-driver-is-slow/3479
+// enabled with -Ddriver=drmev; the card can be overriden at runtime
+// with DRM_CARD env variable.
 #ifndef USE_DRM
 #  define USE_DRM           0
 #endif
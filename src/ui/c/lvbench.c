@@ -0,0 +1,54 @@
+/**
+ * LVGL demo benchmark scenes driver for lvbench; see lvbench.zig.
+ * the demo keeps its scenes and results static: scenes are started one at
+ * a time and measured by the caller, which reads scene names off the title.
+ */
+
+#include <string.h>
+
+#include "lvgl/lvgl.h"
+#include "lvgl/demos/benchmark/lv_demo_benchmark.h"
+
+/**
+ * makes scenes run at the maximum frame rate and call done as they end,
+ * 1s after the start.
+ */
+void nm_lvbench_init(void (*done)(void))
+{
+    lv_demo_benchmark_set_max_speed(true);
+    lv_demo_benchmark_set_finished_cb(done);
+}
+
+/**
+ * starts scene n on the active screen, even n plain and odd n the same at 50%
+ * opacity. sets name to the scene name, valid until nm_lvbench_close_scene.
+ * returns -1 if there's no scene n.
+ */
+int nm_lvbench_run_scene(int n, const char **name)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+    /* the demo counts frames with its own monitor callback; keep perf.c one */
+    void (*monitor_cb)(lv_disp_drv_t *, uint32_t, uint32_t) = disp->driver->monitor_cb;
+    lv_demo_benchmark_run_scene(n);
+    disp->driver->monitor_cb = monitor_cb;
+
+    /* the title, first on the screen, reads "n/total: name" */
+    lv_obj_t *title = lv_obj_get_child(lv_scr_act(), 0);
+    const char *text = title != NULL ? lv_label_get_text(title) : NULL;
+    const char *sep = text != NULL ? strstr(text, ": ") : NULL;
+    if (sep == NULL) {
+        lv_demo_benchmark_close();
+        return -1;
+    }
+    *name = sep + 2;
+    return 0;
+}
+
+/**
+ * deletes the scene objects and animations; not to be called from the done
+ * callback, which the demo follows with updates to the scene.
+ */
+void nm_lvbench_close_scene(void)
+{
+    lv_demo_benchmark_close();
+}
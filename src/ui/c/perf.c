@@ -0,0 +1,50 @@
+/**
+ * display driver hooks feeding the frame time instrumentation in perf.zig.
+ * done in C because LVGL driver and timer structs are opaque to zig.
+ */
+
+#include "lvgl/lvgl.h"
+
+void nm_perf_frame_begin(void);
+void nm_perf_frame_pixels(uint32_t px);
+void nm_perf_frame_end(void);
+void nm_perf_flush_begin(void);
+void nm_perf_flush_end(void);
+
+static lv_timer_cb_t orig_refr_cb;
+static void (*orig_flush_cb)(lv_disp_drv_t *, const lv_area_t *, lv_color_t *);
+
+static void perf_refr(lv_timer_t *tmr)
+{
+    nm_perf_frame_begin();
+    orig_refr_cb(tmr);
+    nm_perf_frame_end();
+}
+
+static void perf_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    nm_perf_flush_begin();
+    orig_flush_cb(drv, area, color_p);
+    nm_perf_flush_end();
+}
+
+/* called by LVGL at the end of a refresh which redrew something */
+static void perf_monitor(lv_disp_drv_t *drv, uint32_t ms, uint32_t px)
+{
+    (void)drv;
+    (void)ms; /* tick resolution; perf.zig measures in us */
+    nm_perf_frame_pixels(px);
+}
+
+/**
+ * wraps the display refresh timer and flush callback with timing hooks.
+ * must be called once, after the display is initialized.
+ */
+void nm_perf_attach(lv_disp_t *disp)
+{
+    orig_refr_cb = disp->refr_timer->timer_cb;
+    disp->refr_timer->timer_cb = perf_refr;
+    orig_flush_cb = disp->driver->flush_cb;
+    disp->driver->flush_cb = perf_flush;
+    disp->driver->monitor_cb = perf_monitor;
+}
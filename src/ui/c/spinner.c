@@ -0,0 +1,150 @@
+/**
+ * a busy indicator looking like lv_spinner but played from a strip of frames
+ * rasterized once, on first use. lv_spinner redraws an anti-aliased arc
+ * through the software arc renderer on every display refresh while visible;
+ * here a frame change is an image blit, and the object is invalidated only
+ * when the frame actually changes, NM_SPINNER_FRAMES times per revolution
+ * instead of at the display refresh rate.
+ */
+
+#include <math.h>
+
+#include "lvgl/lvgl.h"
+
+#define NM_SPINNER_SIZE 20
+#define NM_SPINNER_ARC_WIDTH 4
+#define NM_SPINNER_ARC_LEN 60  /* degrees */
+#define NM_SPINNER_PERIOD 1000 /* ms per revolution */
+#define NM_SPINNER_FRAMES 16
+
+#define PI_F 3.14159265f
+
+static lv_img_dsc_t frames[NM_SPINNER_FRAMES];
+static uint8_t frames_data[NM_SPINNER_FRAMES][NM_SPINNER_SIZE * NM_SPINNER_SIZE * LV_IMG_PX_SIZE_ALPHA_BYTE];
+static bool frames_ready;
+
+static float clamp01(float v)
+{
+    return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+/* coverage of a pixel centered at (x, y) by a disc of radius r at (cx, cy) */
+static float disc_coverage(float x, float y, float cx, float cy, float r)
+{
+    return clamp01(r + 0.5f - hypotf(x - cx, y - cy));
+}
+
+/* angle of (x, y) around the origin in degrees, clockwise from 3 o'clock like LVGL arcs */
+static float angle_deg(float x, float y)
+{
+    float a = atan2f(y, x) * 180.0f / PI_F;
+    return a < 0 ? a + 360.0f : a;
+}
+
+static void render_frame(uint8_t *buf, float start, lv_color_t track_color, lv_opa_t track_opa,
+    lv_color_t ind_color, lv_opa_t ind_opa)
+{
+    const float c = NM_SPINNER_SIZE / 2.0f;
+    const float hw = NM_SPINNER_ARC_WIDTH / 2.0f;
+    const float rc = c - hw; /* arc center line radius */
+    const float end = start + NM_SPINNER_ARC_LEN;
+    /* rounded ends */
+    const float sx = c + rc * cosf(start * PI_F / 180.0f);
+    const float sy = c + rc * sinf(start * PI_F / 180.0f);
+    const float ex = c + rc * cosf(end * PI_F / 180.0f);
+    const float ey = c + rc * sinf(end * PI_F / 180.0f);
+
+    for (int py = 0; py < NM_SPINNER_SIZE; py++) {
+        for (int px = 0; px < NM_SPINNER_SIZE; px++) {
+            const float x = px + 0.5f;
+            const float y = py + 0.5f;
+            const float ring = clamp01(hw + 0.5f - fabsf(hypotf(x - c, y - c) - rc));
+
+            float a = angle_deg(x - c, y - c);
+            if (a < start) {
+                a += 360.0f;
+            }
+            float ind = a <= end ? ring : 0;
+            ind = LV_MAX(ind, disc_coverage(x, y, sx, sy, hw));
+            ind = LV_MAX(ind, disc_coverage(x, y, ex, ey, hw));
+
+            /* indicator over track */
+            const float ai = ind * ind_opa / 255.0f;
+            const float at = ring * track_opa / 255.0f;
+            const float out = ai + at * (1 - ai);
+            lv_color_t col = track_color;
+            if (out > 0) {
+                col = lv_color_mix(ind_color, track_color, (lv_opa_t)lroundf(ai / out * 255));
+            }
+            uint8_t *p = buf + (py * NM_SPINNER_SIZE + px) * LV_IMG_PX_SIZE_ALPHA_BYTE;
+            lv_memcpy_small(p, &col, sizeof(col));
+            p[LV_IMG_PX_SIZE_ALPHA_BYTE - 1] = (uint8_t)lroundf(out * 255);
+        }
+    }
+}
+
+/* rasterizes all frames with the colors a theme applies to lv_spinner */
+static bool render_frames(lv_obj_t *parent)
+{
+    lv_obj_t *ref = lv_spinner_create(parent, NM_SPINNER_PERIOD, NM_SPINNER_ARC_LEN);
+    if (ref == NULL) {
+        return false;
+    }
+    const lv_color_t track_color = lv_obj_get_style_arc_color(ref, LV_PART_MAIN);
+    const lv_opa_t track_opa = lv_obj_get_style_arc_opa(ref, LV_PART_MAIN);
+    const lv_color_t ind_color = lv_obj_get_style_arc_color(ref, LV_PART_INDICATOR);
+    const lv_opa_t ind_opa = lv_obj_get_style_arc_opa(ref, LV_PART_INDICATOR);
+    lv_obj_del(ref);
+
+    for (int i = 0; i < NM_SPINNER_FRAMES; i++) {
+        /* lv_spinner starts at 12 o'clock */
+        const float start = 270.0f + i * 360.0f / NM_SPINNER_FRAMES;
+        render_frame(frames_data[i], start >= 360.0f ? start - 360.0f : start,
+            track_color, track_opa, ind_color, ind_opa);
+        frames[i].header.always_zero = 0;
+        frames[i].header.w = NM_SPINNER_SIZE;
+        frames[i].header.h = NM_SPINNER_SIZE;
+        frames[i].header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+        frames[i].data_size = sizeof(frames_data[i]);
+        frames[i].data = frames_data[i];
+    }
+    frames_ready = true;
+    return true;
+}
+
+static void spinner_anim_cb(void *var, int32_t v)
+{
+    lv_obj_t *obj = var;
+    const lv_img_dsc_t *frame = &frames[v % NM_SPINNER_FRAMES];
+    if (lv_img_get_src(obj) == frame || lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) {
+        return;
+    }
+    lv_img_set_src(obj, frame);
+}
+
+/**
+ * creates a NM_SPINNER_SIZE spinner in parent.
+ * returns NULL on memory allocation failure.
+ */
+lv_obj_t *nm_spinner_create(lv_obj_t *parent)
+{
+    if (!frames_ready && !render_frames(parent)) {
+        return NULL;
+    }
+    lv_obj_t *obj = lv_img_create(parent);
+    if (obj == NULL) {
+        return NULL;
+    }
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE);
+    lv_img_set_src(obj, &frames[0]);
+
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, obj);
+    lv_anim_set_exec_cb(&a, spinner_anim_cb);
+    lv_anim_set_values(&a, 0, NM_SPINNER_FRAMES);
+    lv_anim_set_time(&a, NM_SPINNER_PERIOD);
+    lv_anim_set_repeat_count(&a, LV_ANIM_REPEAT_INFINITE);
+    lv_anim_start(&a);
+    return obj;
+}
@@ -8,20 +8,50 @@
 #include "lvgl/lvgl.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
-static lv_style_t style_title;
-static lv_style_t style_text_muted;
-static lv_style_t style_btn_red;
 static const lv_font_t *font_large;
-static lv_obj_t *virt_keyboard;
+/* TrueType fallbacks of the bitmap fonts; see nm_ui_init_fallback_font */
+static lv_font_t *fallback_text;
+static lv_font_t *fallback_title;
+static const void *fallback_ttf;
+static size_t fallback_len;
+static size_t fallback_cache_size;
+
+/**
+ * copies of the compiled-in bitmap fonts, which are const, with a fallback
+ * chained for missing glyphs. set in nm_ui_init_theme.
+ */
+lv_font_t nm_font_text;
+lv_font_t nm_font_title;
+static lv_obj_t *virt_keyboard; /* on the top layer, over the tabview */
+/* scroll room below the content of a tab panel, for the keyboard not to
+ * cover inputs at the bottom; see nm_keyboard_popon */
+static lv_obj_t *keyboard_room;
 static lv_obj_t *tabview; /* main tabs content parent; lv_tabview_create */
 
+/* main tabs in tab_changed_event_cb order.
+ * lightning and info panels are built on first activation; see build_tab */
+#define NM_TAB_COUNT 4
+static struct {
+    lv_obj_t *obj;
+    bool built;
+} tabs[NM_TAB_COUNT];
+
 /**
  * initiates system shutdown leading to poweroff.
  */
 void nm_sys_shutdown();
 
+/**
+ * return static const styles: a title with a larger font, a muted text
+ * and a "red" button to attract attention to a "dangerous" operation.
+ */
+lv_style_t *nm_style_title();
+lv_style_t *nm_style_text_muted();
+lv_style_t *nm_style_btn_red();
+
 /**
  * creates an info panel with build info, semver, about and other related items.
  */
@@ -57,6 +87,11 @@ lv_obj_t *nm_create_settings_sysupdates(lv_obj_t *parent);
  */
 void nm_tab_settings_active();
 
+/**
+ * invoked when the UI is switched to a tab at index n, after tab specific handlers.
+ */
+void nm_tab_changed(uint16_t n);
+
 /**
  * initiate connection to a wifi network with the given SSID and a password.
  * connection, if successful, is persisted in wpa_supplicant config.
@@ -87,19 +122,95 @@ extern void nm_obj_set_userdata(lv_obj_t *obj, void *data)
 }
 
 /**
- * returns a "red" style for a button. useful to attract particular attention
- * to a potentially "dangerous" operation.
- *
- * the returned value is static. available only after nm_ui_init.
+ * reports whether obj is a plain lv_obj, such as a container, as opposed to
+ * a widget which may rely on its children until deleted itself.
  */
-extern lv_style_t *nm_style_btn_red()
+extern bool nm_obj_is_plain(lv_obj_t *obj)
 {
-    return &style_btn_red;
+    return lv_obj_get_class(obj) == &lv_obj_class;
 }
 
-extern lv_style_t *nm_style_title()
+/**
+ * object census helpers for lvgl.census: lv_obj_t and lv_label_t fields
+ * read below are bit-fields, unsupported in zig cImport.
+ */
+static const struct {
+    const lv_obj_class_t *cls;
+    const char *name;
+} census_classes[] = {
+    {&lv_obj_class, "obj"},
+    {&lv_label_class, "label"},
+    {&lv_btn_class, "btn"},
+    {&lv_img_class, "img"},
+    {&lv_bar_class, "bar"},
+    {&lv_arc_class, "arc"},
+    {&lv_btnmatrix_class, "btnmatrix"},
+    {&lv_canvas_class, "canvas"},
+    {&lv_dropdown_class, "dropdown"},
+    {&lv_dropdownlist_class, "dropdownlist"},
+    {&lv_textarea_class, "textarea"},
+    {&lv_chart_class, "chart"},
+    {&lv_keyboard_class, "keyboard"},
+    {&lv_msgbox_class, "msgbox"},
+    {&lv_msgbox_backdrop_class, "msgbox_backdrop"},
+    {&lv_spinner_class, "spinner"},
+    {&lv_tabview_class, "tabview"},
+    {&lv_win_class, "win"},
+    {&lv_qrcode_class, "qrcode"},
+#if LV_USE_CHECKBOX
+    {&lv_checkbox_class, "checkbox"},
+#endif
+#if LV_USE_SWITCH
+    {&lv_switch_class, "switch"},
+#endif
+#if LV_USE_TABLE
+    {&lv_table_class, "table"},
+#endif
+#if LV_USE_SLIDER
+    {&lv_slider_class, "slider"},
+#endif
+#if LV_USE_ROLLER
+    {&lv_roller_class, "roller"},
+#endif
+};
+
+/**
+ * returns the name of the object class, or NULL if not a stock LVGL widget
+ * known to the census, for example a custom class.
+ */
+extern const char *nm_obj_class_name(const lv_obj_t *obj)
 {
-    return &style_title;
+    const lv_obj_class_t *cls = lv_obj_get_class(obj);
+    for (size_t i = 0; i < sizeof(census_classes) / sizeof(census_classes[0]); i++) {
+        if (census_classes[i].cls == cls) {
+            return census_classes[i].name;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * returns the number of styles added to the object, local style included.
+ */
+extern uint32_t nm_obj_style_count(const lv_obj_t *obj)
+{
+    return obj->style_cnt;
+}
+
+/**
+ * returns the heap bytes of a label text the label owns; 0 for static texts
+ * and objects other than labels.
+ */
+extern size_t nm_obj_label_text_size(const lv_obj_t *obj)
+{
+    if (!lv_obj_check_type(obj, &lv_label_class)) {
+        return 0;
+    }
+    const lv_label_t *label = (const lv_label_t *)obj;
+    if (label->static_txt || label->text == NULL) {
+        return 0;
+    }
+    return strlen(label->text) + 1;
 }
 
 extern const lv_font_t *nm_font_large()
@@ -107,6 +218,61 @@ extern const lv_font_t *nm_font_large()
     return font_large;
 }
 
+/**
+ * draw descriptors have bit-fields, unsupported in zig cImport.
+ * the following wrap them for lvgl.DrawCtx.
+ */
+extern void nm_draw_fill_rect(lv_draw_ctx_t *ctx, const lv_area_t *area, lv_color_t color, lv_opa_t opa, lv_coord_t radius)
+{
+    lv_draw_rect_dsc_t dsc;
+    lv_draw_rect_dsc_init(&dsc);
+    dsc.bg_color = color;
+    dsc.bg_opa = opa;
+    dsc.radius = radius;
+    lv_draw_rect(ctx, &dsc, area);
+}
+
+/**
+ * draws text in the font and color of the obj main part.
+ */
+extern void nm_draw_text(lv_draw_ctx_t *ctx, lv_obj_t *obj, const lv_area_t *area, const char *text, bool recolor)
+{
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init(&dsc);
+    lv_obj_init_draw_label_dsc(obj, LV_PART_MAIN, &dsc);
+    if (recolor) {
+        dsc.flag |= LV_TEXT_FLAG_RECOLOR;
+    }
+    lv_draw_label(ctx, &dsc, area, text, NULL);
+}
+
+/**
+ * returns text line height in the font of the obj main part, including line spacing.
+ */
+extern lv_coord_t nm_draw_line_height(lv_obj_t *obj)
+{
+    const lv_font_t *font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    return lv_font_get_line_height(font) + lv_obj_get_style_text_line_space(obj, LV_PART_MAIN);
+}
+
+/**
+ * draws an lv_snapshot_take image of the obj at its position. the snapshot
+ * includes the extra draw size around the object, such as shadows.
+ */
+extern void nm_draw_snapshot(lv_draw_ctx_t *ctx, lv_obj_t *obj, const lv_img_dsc_t *img)
+{
+    lv_area_t area;
+    lv_obj_get_coords(obj, &area);
+    lv_coord_t ext = (img->header.w - lv_area_get_width(&area)) / 2;
+    area.x1 -= ext;
+    area.y1 -= ext;
+    area.x2 = area.x1 + img->header.w - 1;
+    area.y2 = area.y1 + img->header.h - 1;
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+    lv_draw_img(ctx, &dsc, &area, img);
+}
+
 /**
  * a hack to prevent tabview from switching to the next tab
  * on a scroll event, for example coming from a top layer window.
@@ -117,20 +283,82 @@ extern void preserve_main_active_tab()
     lv_tabview_set_act(tabview, lv_tabview_get_tab_act(tabview), LV_ANIM_OFF);
 }
 
+/* min distance between an input and the keyboard top edge, in px */
+#define KEYBOARD_INPUT_MARGIN 10
+
+static bool is_descendant(const lv_obj_t *obj, const lv_obj_t *ancestor)
+{
+    for (obj = lv_obj_get_parent(obj); obj != NULL; obj = lv_obj_get_parent(obj)) {
+        if (obj == ancestor) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void keyboard_room_remove(void)
+{
+    if (keyboard_room != NULL) {
+        lv_obj_del(keyboard_room); /* the panel scrolls back as needed */
+        keyboard_room = NULL;
+    }
+}
+
+/**
+ * creates an invisible object of height h right below the content of panel,
+ * for the panel to scroll that much further. the other children stay put:
+ * only the room area and the scrollbar are invalidated.
+ */
+static void keyboard_room_add(lv_obj_t *panel, lv_coord_t h)
+{
+    if (keyboard_room != NULL && lv_obj_get_parent(keyboard_room) == panel) {
+        return;
+    }
+    keyboard_room_remove();
+    lv_coord_t content_end = lv_obj_get_scroll_y(panel) + lv_obj_get_content_height(panel) + lv_obj_get_scroll_bottom(panel);
+    keyboard_room = lv_obj_create(panel);
+    if (keyboard_room == NULL) {
+        return;
+    }
+    lv_obj_remove_style_all(keyboard_room);
+    lv_obj_add_flag(keyboard_room, LV_OBJ_FLAG_IGNORE_LAYOUT);
+    lv_obj_clear_flag(keyboard_room, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(keyboard_room, 1, h);
+    lv_obj_set_pos(keyboard_room, 0, content_end);
+}
+
+/**
+ * shows the keyboard over the bottom of the screen. the tabview keeps its
+ * size: the visible tab panel is scrolled only if the keyboard would cover
+ * the input, so that in most cases only the keyboard area is redrawn.
+ */
 extern void nm_keyboard_popon(lv_obj_t *input)
 {
     lv_keyboard_set_textarea(virt_keyboard, input);
-    lv_obj_update_layout(tabview); /* make sure sizes are recalculated */
-    lv_obj_set_height(tabview, NM_DISP_VER - lv_obj_get_height(virt_keyboard));
     lv_obj_clear_flag(virt_keyboard, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_scroll_to_view_recursive(input, LV_ANIM_OFF);
+    lv_obj_update_layout(virt_keyboard); /* the top layer only */
+    lv_obj_t *panel = tabs[lv_tabview_get_tab_act(tabview)].obj;
+    if (!is_descendant(input, panel)) {
+        return; /* not in the visible tab, as in a top layer window */
+    }
+    lv_obj_scroll_to_view_recursive(input, LV_ANIM_OFF); /* a no-op if visible */
+    lv_area_t in, kb;
+    lv_obj_get_coords(input, &in);
+    lv_obj_get_coords(virt_keyboard, &kb);
+    lv_coord_t covered = in.y2 + KEYBOARD_INPUT_MARGIN - kb.y1;
+    if (covered <= 0) {
+        return;
+    }
+    keyboard_room_add(panel, lv_area_get_height(&kb));
+    lv_obj_update_layout(panel);
+    lv_obj_scroll_by_bounded(panel, 0, -covered, LV_ANIM_OFF);
 }
 
 extern void nm_keyboard_popoff()
 {
     lv_keyboard_set_textarea(virt_keyboard, NULL);
     lv_obj_add_flag(virt_keyboard, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_set_height(tabview, NM_DISP_VER);
+    keyboard_room_remove();
 }
 
 static void wifi_pwd_input_cb(lv_event_t *e)
@@ -196,7 +424,7 @@ static int create_settings_panel(lv_obj_t *parent)
     lv_obj_set_height(wifi_panel, LV_SIZE_CONTENT);
     lv_obj_t *wifi_panel_title = lv_label_create(wifi_panel);
     lv_label_set_text_static(wifi_panel_title, LV_SYMBOL_WIFI " WIFI");
-    lv_obj_add_style(wifi_panel_title, &style_title, 0);
+    lv_obj_add_style(wifi_panel_title, nm_style_title(), 0);
 
     lv_obj_t *wifi_spinner = lv_spinner_create(wifi_panel, 1000 /* speed */, 60 /* arc in deg */);
     settings.wifi_spinner_obj = wifi_spinner;
@@ -213,14 +441,14 @@ static int create_settings_panel(lv_obj_t *parent)
 
     lv_obj_t *wifi_ssid_label = lv_label_create(wifi_panel);
     lv_label_set_text_static(wifi_ssid_label, "network name");
-    lv_obj_add_style(wifi_ssid_label, &style_text_muted, 0);
+    lv_obj_add_style(wifi_ssid_label, nm_style_text_muted(), 0);
     lv_obj_t *wifi_ssid = lv_dropdown_create(wifi_panel);
     settings.wifi_ssid_list_obj = wifi_ssid;
     lv_dropdown_clear_options(wifi_ssid);
 
     lv_obj_t *wifi_pwd_label = lv_label_create(wifi_panel);
     lv_label_set_text_static(wifi_pwd_label, "password");
-    lv_obj_add_style(wifi_pwd_label, &style_text_muted, 0);
+    lv_obj_add_style(wifi_pwd_label, nm_style_text_muted(), 0);
     lv_obj_t *wifi_pwd = lv_textarea_create(wifi_panel);
     settings.wifi_pwd_obj = wifi_pwd;
     lv_textarea_set_one_line(wifi_pwd, true);
@@ -242,7 +470,7 @@ static int create_settings_panel(lv_obj_t *parent)
     lv_obj_set_height(power_panel, LV_SIZE_CONTENT);
     lv_obj_t *power_panel_title = lv_label_create(power_panel);
     lv_label_set_text_static(power_panel_title, LV_SYMBOL_POWER " POWER");
-    lv_obj_add_style(power_panel_title, &style_title, 0);
+    lv_obj_add_style(power_panel_title, nm_style_title(), 0);
 
     lv_obj_t *poweroff_text = lv_label_create(power_panel);
     lv_label_set_text_static(poweroff_text, "once shut down, the power cord\ncan be removed.");
@@ -253,7 +481,7 @@ static int create_settings_panel(lv_obj_t *parent)
     lv_obj_t *power_halt_btn = lv_btn_create(power_panel);
     settings.power_halt_btn_obj = power_halt_btn;
     lv_obj_set_height(power_halt_btn, LV_SIZE_CONTENT);
-    lv_obj_add_style(power_halt_btn, &style_btn_red, 0);
+    lv_obj_add_style(power_halt_btn, nm_style_btn_red(), 0);
     lv_obj_add_event_cb(power_halt_btn, nm_poweroff_btn_callback, LV_EVENT_CLICKED, NULL);
     lv_obj_t *power_halt_btn_label = lv_label_create(power_halt_btn);
     lv_label_set_text_static(power_halt_btn_label, "SHUTDOWN");
@@ -325,10 +553,60 @@ static int create_settings_panel(lv_obj_t *parent)
     return 0;
 }
 
-static void tab_changed_event_cb(lv_event_t *e)
+/**
+ * creates the tab n panel, replacing the skeleton, unless already built.
+ */
+static int build_tab(uint16_t n)
 {
-    (void)e; /* unused */
-    uint16_t n = lv_tabview_get_tab_act(tabview);
+    if (n >= NM_TAB_COUNT || tabs[n].built) {
+        return 0;
+    }
+    lv_obj_t *tab = tabs[n].obj;
+    lv_obj_clean(tab);
+    int res = -1;
+    switch (n) {
+    case 0:
+        res = nm_create_bitcoin_panel(tab);
+        break;
+    case 1:
+        res = nm_create_lightning_panel(tab);
+        break;
+    case 2:
+        res = create_settings_panel(tab);
+        break;
+    case 3:
+        res = nm_create_info_panel(tab);
+        break;
+    }
+    tabs[n].built = res == 0;
+    return res;
+}
+
+/**
+ * placeholder content of a tab until built.
+ */
+static void tab_skeleton(lv_obj_t *tab)
+{
+    lv_obj_t *label = lv_label_create(tab);
+    lv_label_set_text_static(label, "loading...");
+    lv_obj_add_style(label, nm_style_text_muted(), 0);
+    lv_obj_center(label);
+}
+
+extern bool nm_ui_tab_built(uint16_t n)
+{
+    return n < NM_TAB_COUNT && tabs[n].built;
+}
+
+/**
+ * builds tab n if needed and notifies about it becoming active.
+ */
+static void tab_activated(uint16_t n)
+{
+    if (build_tab(n) != 0) {
+        LV_LOG_ERROR("tab %i build failed", n);
+        return;
+    }
     switch (n) {
     case 2:
         nm_tab_settings_active();
@@ -336,33 +614,128 @@ static void tab_changed_event_cb(lv_event_t *e)
     default:
         LV_LOG_INFO("unhandled tab index %i", n);
     }
+    nm_tab_changed(n);
+}
+
+static void tab_changed_event_cb(lv_event_t *e)
+{
+    (void)e; /* unused */
+    tab_activated(lv_tabview_get_tab_act(tabview));
+}
+
+/**
+ * builds tab n ahead of its activation, unless built already, and lays it
+ * out, so that a swipe to it shows neither the skeleton nor a rebuild at
+ * the end of the animation. returns nonzero if there's no such tab or the
+ * build failed.
+ */
+extern int nm_ui_prerender_tab(uint16_t n)
+{
+    if (n >= NM_TAB_COUNT) {
+        return -1;
+    }
+    int res = build_tab(n);
+    if (res != 0) {
+        return res;
+    }
+    lv_obj_update_layout(tabs[n].obj);
+    return 0;
+}
+
+/**
+ * returns the scrolling content of tab n; NULL if there's no such tab.
+ */
+extern lv_obj_t *nm_ui_tab_panel(uint16_t n)
+{
+    return n < NM_TAB_COUNT ? tabs[n].obj : NULL;
+}
+
+/**
+ * makes tab n visible, as if a user tapped on its button.
+ */
+extern void nm_ui_show_tab(uint16_t n)
+{
+    if (n >= NM_TAB_COUNT) {
+        return;
+    }
+    lv_tabview_set_act(tabview, n, LV_ANIM_OFF);
+    tab_activated(n);
+}
+
+/**
+ * creates TrueType fonts off the ttf data to fall back on for glyphs missing
+ * in the bitmap fonts, like non-latin scripts of peer aliases. only glyphs
+ * actually drawn are rasterized, into an LRU cache of at most cache_size bytes
+ * per font size. the data must stay valid for the lifetime of the UI.
+ * must be called before nm_ui_init_theme.
+ */
+extern int nm_ui_init_fallback_font(const void *ttf, size_t len, size_t cache_size)
+{
+    fallback_ttf = ttf;
+    fallback_len = len;
+    fallback_cache_size = cache_size;
+    fallback_text = lv_tiny_ttf_create_data_ex(ttf, len, 16 /* px, as the bitmap font */, cache_size);
+    if (fallback_text == NULL) {
+        return -1;
+    }
+    fallback_title = lv_tiny_ttf_create_data_ex(ttf, len, 24, cache_size);
+    if (fallback_title == NULL) {
+        lv_tiny_ttf_destroy(fallback_text);
+        fallback_text = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * frees glyphs rasterized into the fallback font caches by recreating the
+ * fonts; glyphs are rasterized again as drawn. a font which can't be
+ * recreated is kept as is. no-op without fallback fonts.
+ */
+extern void nm_ui_drop_font_cache(void)
+{
+    if (fallback_text != NULL) {
+        lv_font_t *f = lv_tiny_ttf_create_data_ex(fallback_ttf, fallback_len, 16, fallback_cache_size);
+        if (f != NULL) {
+            nm_font_text.fallback = f;
+            lv_tiny_ttf_destroy(fallback_text);
+            fallback_text = f;
+        }
+    }
+    if (fallback_title != NULL) {
+        lv_font_t *f = lv_tiny_ttf_create_data_ex(fallback_ttf, fallback_len, 24, fallback_cache_size);
+        if (f != NULL) {
+            nm_font_title.fallback = f;
+            lv_tiny_ttf_destroy(fallback_title);
+            fallback_title = f;
+        }
+    }
 }
 
 extern void nm_ui_init_theme(lv_disp_t *disp)
 {
+    nm_font_text = lv_font_courierprimecode_16;
+    nm_font_text.fallback = fallback_text;
+    nm_font_title = lv_font_courierprimecode_24;
+    nm_font_title.fallback = fallback_title;
+
     /* default theme is static */
     lv_theme_t *theme = lv_theme_default_init(disp, /**/
         lv_palette_main(LV_PALETTE_BLUE),           /* primary */
         lv_palette_main(LV_PALETTE_RED),            /* secondary */
         true,                                       /* dark mode, LV_THEME_DEFAULT_DARK */
-        LV_FONT_DEFAULT /* lv_conf.h def */);
+        &nm_font_text /* LV_FONT_DEFAULT with a fallback */);
     lv_disp_set_theme(disp, theme);
 
-    font_large = &lv_font_courierprimecode_24; /* static */
-    lv_style_init(&style_title);
-    lv_style_set_text_font(&style_title, font_large);
-
-    lv_style_init(&style_text_muted);
-    lv_style_set_text_opa(&style_text_muted, LV_OPA_50);
-
-    lv_style_init(&style_btn_red);
-    lv_style_set_bg_color(&style_btn_red, lv_palette_main(LV_PALETTE_RED));
+    font_large = &nm_font_title; /* static */
 }
 
 extern int nm_ui_init_main_tabview(lv_obj_t *scr)
 {
-    /* global virtual keyboard */
-    virt_keyboard = lv_keyboard_create(scr);
+    /* global virtual keyboard, over the tabview rather than resizing it;
+     * created ahead of other top layer objects, such as modals and the
+     * sleep topdrop, to stay below them */
+    virt_keyboard = lv_keyboard_create(lv_layer_top());
     if (virt_keyboard == NULL) {
         return -1;
     }
@@ -385,37 +758,25 @@ extern int nm_ui_init_main_tabview(lv_obj_t *scr)
      * 3: ndg build info and versioning
      */
 
-    lv_obj_t *tab_btc = lv_tabview_add_tab(tabview, NM_SYMBOL_BITCOIN " BITCOIN");
-    if (tab_btc == NULL) {
-        return -1;
-    }
-    if (nm_create_bitcoin_panel(tab_btc) != 0) {
-        return -1;
-    }
-
-    lv_obj_t *tab_lnd = lv_tabview_add_tab(tabview, NM_SYMBOL_BOLT " LIGHTNING");
-    if (tab_lnd == NULL) {
-        return -1;
-    }
-    if (nm_create_lightning_panel(tab_lnd) != 0) {
-        return -1;
-    }
-
-    lv_obj_t *tab_settings = lv_tabview_add_tab(tabview, LV_SYMBOL_SETTINGS " SETTINGS");
-    if (tab_settings == NULL) {
-        return -1;
-    }
-    if (create_settings_panel(tab_settings) != 0) {
-        return -1;
-    }
-
-    lv_obj_t *tab_info = lv_tabview_add_tab(tabview, NM_SYMBOL_INFO);
-    if (tab_info == NULL) {
-        return -1;
+    static const char *tab_names[NM_TAB_COUNT] = {
+        NM_SYMBOL_BITCOIN " BITCOIN",
+        NM_SYMBOL_BOLT " LIGHTNING",
+        LV_SYMBOL_SETTINGS " SETTINGS",
+        NM_SYMBOL_INFO,
+    };
+    for (uint16_t i = 0; i < NM_TAB_COUNT; i++) {
+        tabs[i].obj = lv_tabview_add_tab(tabview, tab_names[i]);
+        if (tabs[i].obj == NULL) {
+            return -1;
+        }
     }
-    if (nm_create_info_panel(tab_info) != 0) {
+    /* bitcoin is visible at start; settings widgets are updated by nd reports
+     * and settings messages from the start */
+    if (build_tab(0) != 0 || build_tab(2) != 0) {
         return -1;
     }
+    tab_skeleton(tabs[1].obj);
+    tab_skeleton(tabs[3].obj);
 
     /* make the info tab button narrower, just for the icon to fit,
      * by widening the other tab buttons relative width. */
@@ -4,8 +4,6 @@ const buildopts = @import("build_options");
 
 const lvgl = @import("lvgl.zig");
 
-const logger = std.log.scoped(.drv);
-
 extern "c" fn nm_disp_init() ?*lvgl.LvDisp;
 extern "c" fn nm_indev_init() c_int;
 
@@ -27,47 +25,43 @@ pub fn initInput() !void {
     }
 }
 
-/// deactivate and remove all input devices.
-pub fn deinitInput() void {
-    var indev: ?*lvgl.LvIndev = lvgl.LvIndev.first();
-    var count: usize = 0;
-    while (indev) |d| {
-        d.destroy();
-        count += 1;
-        indev = lvgl.LvIndev.first();
-    }
-    logger.debug("deinited {d} indev(s)", .{count});
-}
-
+/// touch screen input gating, evdev only: the input device stays in place
+/// across a screen sleep while its events are dropped.
 pub usingnamespace switch (buildopts.driver) {
-    .sdl2, .x11 => struct {
-        pub fn InputWatcher() !type {
-            return error.InputWatcherUnavailable;
+    .sdl2, .sdl2gpu, .x11, .headless => struct {
+        /// returns the touch screen input device fd for the UI loop to poll,
+        /// if any. the fd is read only by the driver.
+        pub fn inputFd() ?std.posix.fd_t {
+            return null;
         }
-    },
-    .fbev => struct {
-        extern "c" fn nm_open_evdev_nonblock() std.posix.fd_t;
-        extern "c" fn nm_close_evdev(fd: std.posix.fd_t) void;
-        extern "c" fn nm_consume_input_events(fd: std.posix.fd_t) bool;
 
-        pub fn InputWatcher() !EvdevWatcher {
-            const fd = nm_open_evdev_nonblock();
-            if (fd == -1) {
-                return error.InputWatcherUnavailable;
-            }
-            return .{ .evdev_fd = fd };
+        /// with gate open, input dropped while closed continues to be so up to
+        /// the release of the touch in progress.
+        pub fn gateInput(closed: bool) void {
+            _ = closed;
         }
 
-        pub const EvdevWatcher = struct {
-            evdev_fd: std.posix.fd_t,
+        /// reads and drops pending input while gated; reports whether there was any.
+        pub fn drainInput() bool {
+            return false;
+        }
+    },
+    .fbev, .drmev, .drmgl => struct {
+        extern "c" fn nm_indev_fd() c_int;
+        extern "c" fn nm_indev_gate(closed: bool) void;
+        extern "c" fn nm_indev_drain() bool;
 
-            pub fn consume(self: @This()) bool {
-                return nm_consume_input_events(self.evdev_fd);
-            }
+        pub fn inputFd() ?std.posix.fd_t {
+            const fd = nm_indev_fd();
+            return if (fd < 0) null else fd;
+        }
 
-            pub fn close(self: @This()) void {
-                nm_close_evdev(self.evdev_fd);
-            }
-        };
+        pub fn gateInput(closed: bool) void {
+            nm_indev_gate(closed);
+        }
+
+        pub fn drainInput() bool {
+            return nm_indev_drain();
+        }
     },
 };
@@ -1,5 +1,5 @@
 //! lightning main tab panel and other functionality.
-//! all functions assume LVGL is init'ed and ui mutex is locked on entry.
+//! all functions assume LVGL is init'ed and are called from the UI thread.
 
 const std = @import("std");
 
@@ -51,27 +51,125 @@ var tab: struct {
 
     info: struct {
         card: lvgl.Card, // parent
-        alias: lvgl.Label,
-        blockhash: lvgl.Label,
-        currblock: lvgl.Label,
-        npeers: lvgl.Label,
-        pubkey: lvgl.Label,
-        version: lvgl.Label,
+        alias: lvgl.Caption,
+        blockhash: lvgl.Caption,
+        currblock: lvgl.Caption,
+        npeers: lvgl.Caption,
+        pubkey: lvgl.Caption,
+        version: lvgl.Caption,
+        graph: lvgl.Caption, // network graph stats
+        /// minutes the shown data is behind, as last put in the card title;
+        /// null if current. see updateFreshness.
+        stale_min: ?u64,
     },
     balance: struct {
         card: lvgl.Card, // parent
         avail: lvgl.Bar, // local vs remote
-        local: lvgl.Label,
-        remote: lvgl.Label,
-        unsettled: lvgl.Label,
-        pending: lvgl.Label,
-        fees: lvgl.Label, // day, week, month
+        local: lvgl.Caption,
+        remote: lvgl.Caption,
+        unsettled: lvgl.Caption,
+        pending: lvgl.Caption,
+        fees: lvgl.Caption, // day, week, month
+        routing: lvgl.Caption, // live, off htlc events
+        trend: widget.TrendChart, // local and remote
+        fees_trend: widget.TrendChart,
     },
     channels: struct {
         card: lvgl.Card,
-        cont: lvgl.FlexLayout,
+        sortsel: lvgl.Dropdown,
+        filtersel: lvgl.Dropdown,
+        /// peer alias, pubkey or channel id search; filters as it is typed.
+        search: lvgl.TextArea,
+        /// holds query.search.
+        search_text: std.BoundedArray(u8, comm.Message.LightningChannelsQuery.max_search_len) = .{},
+        list: lvgl.RecycledList(ChannelRow),
+        /// channels shown by list rows on scroll: those of the last report or,
+        /// once nd sends pages, of the last page starting at view index offset.
+        /// allocated in arena, reset on every update.
+        data: []const comm.Message.LightningChannel,
+        offset: usize = 0,
+        arena: std.heap.ArenaAllocator,
+        /// whether channels come in pages from nd rather than with reports.
+        paged: bool = false,
+        /// the current view; offset and limit are of the last requested page.
+        query: comm.Message.LightningChannelsQuery = .{ .limit = channel_page_size },
+        /// whether a page request is awaiting a reply.
+        requested: bool = false,
+
+        /// returns the channel at index of the list, or null if not received yet.
+        fn at(self: @This(), index: usize) ?comm.Message.LightningChannel {
+            if (index < self.offset or index - self.offset >= self.data.len) {
+                return null;
+            }
+            return self.data[index - self.offset];
+        }
+
+        /// asks nd for a page of the current view around index, unless
+        /// a request is already in flight. its reply rebinds all rows.
+        fn requestPage(self: *@This(), index: usize) !void {
+            if (self.requested) {
+                return;
+            }
+            self.query.offset = std.math.lossyCast(u32, index -| channel_page_size / 2);
+            self.query.limit = channel_page_size;
+            try comm.pipeWriteId(.{ .lightning_get_channels = self.query }, comm.nextRequestId());
+            self.requested = true;
+        }
+    },
+    payments: struct {
+        card: lvgl.Card,
+        empty: lvgl.Label, // shown when the history has no items
+        list: lvgl.RecycledList(PaymentRow),
+        /// items of the last page from nd, starting at history index offset,
+        /// newest first. allocated in arena, reset on every update.
+        data: []const comm.Message.LightningPayment,
+        offset: usize = 0,
+        arena: std.heap.ArenaAllocator,
+        /// whether any page was received from nd.
+        loaded: bool = false,
+        /// whether a page request is awaiting a reply.
+        requested: bool = false,
+
+        /// returns the item at index of the list, or null if not received yet.
+        fn at(self: @This(), index: usize) ?comm.Message.LightningPayment {
+            if (index < self.offset or index - self.offset >= self.data.len) {
+                return null;
+            }
+            return self.data[index - self.offset];
+        }
+
+        /// asks nd for a page of the history around index, unless a request
+        /// is already in flight. its reply rebinds all rows.
+        fn requestPage(self: *@This(), index: usize) !void {
+            if (self.requested) {
+                return;
+            }
+            const q: comm.Message.LightningPaymentsQuery = .{
+                .offset = std.math.lossyCast(u32, index -| payment_page_size / 2),
+                .limit = payment_page_size,
+            };
+            try comm.pipeWriteId(.{ .lightning_get_payments = q }, comm.nextRequestId());
+            self.requested = true;
+        }
     },
+    /// the window of a tapped channel details, while open.
+    chan_detail: ?struct {
+        win: lvgl.Window,
+        text: lvgl.Label,
+        request: u32, // id of the lightning_get_channel_detail request
+    } = null,
+    /// the window of connected peers, while open; nd pushes lightning_peers
+    /// until it's closed.
+    peer_view: ?struct {
+        win: lvgl.Window,
+        text: lvgl.Label,
+        /// merged from full and delta lightning_peers, keyed by pubkey.
+        /// strings are allocated with tab.allocator; see putPeer.
+        peers: std.StringArrayHashMapUnmanaged(comm.Message.LightningPeer) = .{},
+    } = null,
     pairing: lvgl.Card,
+    /// rendered pairing QR codes; kept across pairing dialog opens.
+    pairing_qr: QrCache,
     reset: lvgl.Card,
 
     // elements visibile during lnd startup.
@@ -87,6 +185,7 @@ var tab: struct {
         topwin: lvgl.Window,
         arena: *std.heap.ArenaAllocator, // all non-UI elements are alloc'ed here
         mnemonic: ?types.StringList = null, // 24 words genseed result
+        request: u32 = 0, // id of the last genseed or ctrlconn request; see isPendingReply
         pairing: ?struct {
             // app_description key to connection URL.
             // keys are static, values are heap-alloc'ed in `setupPairing`.
@@ -108,7 +207,7 @@ var tab: struct {
         if (self.seed_setup == null) {
             return;
         }
-        self.seed_setup.?.topwin.destroy();
+        widget.releaseWindow(self.seed_setup.?.topwin);
         self.seed_setup.?.arena.deinit();
         self.allocator.destroy(self.seed_setup.?.arena);
         self.seed_setup = null;
@@ -118,11 +217,13 @@ var tab: struct {
     fn setMode(self: *@This(), m: enum { setup, startup, operational }) void {
         switch (m) {
             .setup => {
+                self.pairing_qr.clear(self.allocator); // a new wallet has new macaroons
                 self.nowallet.show();
                 self.startup.hide();
                 self.info.card.hide();
                 self.balance.card.hide();
                 self.channels.card.hide();
+                self.payments.card.hide();
                 self.pairing.hide();
                 self.reset.hide();
             },
@@ -132,6 +233,7 @@ var tab: struct {
                 self.info.card.hide();
                 self.balance.card.hide();
                 self.channels.card.hide();
+                self.payments.card.hide();
                 self.pairing.hide();
                 self.reset.hide();
             },
@@ -139,6 +241,7 @@ var tab: struct {
                 self.info.card.show();
                 self.balance.card.show();
                 self.channels.card.show();
+                self.payments.card.show();
                 self.pairing.show();
                 self.reset.show();
                 self.nowallet.hide();
@@ -152,8 +255,10 @@ var tab: struct {
 /// must be called only once at UI init.
 pub fn initTabPanel(allocator: std.mem.Allocator, cont: lvgl.Container) !void {
     tab.allocator = allocator;
+    tab.pairing_qr = .{};
+    tab.chan_detail = null;
+    tab.peer_view = null;
     const parent = cont.flex(.column, .{});
-    const recolor: lvgl.Label.Opt = .{ .recolor = true };
 
     // startup
     {
@@ -178,7 +283,8 @@ pub fn initTabPanel(allocator: std.mem.Allocator, cont: lvgl.Container) !void {
 
     // info section
     {
-        tab.info.card = try lvgl.Card.new(parent, "INFO", .{});
+        tab.info.card = try lvgl.Card.new(parent, "INFO", .{ .scroll_snapshot = true });
+        tab.info.stale_min = null;
         const row = try lvgl.FlexLayout.new(tab.info.card, .row, .{});
         row.setHeightToContent();
         row.setWidth(lvgl.sizePercent(100));
@@ -188,21 +294,26 @@ pub fn initTabPanel(allocator: std.mem.Allocator, cont: lvgl.Container) !void {
         left.setHeightToContent();
         left.setWidth(lvgl.sizePercent(50));
         left.setPad(10, .row, .{});
-        tab.info.alias = try lvgl.Label.new(left, "ALIAS\n", recolor);
-        tab.info.pubkey = try lvgl.Label.new(left, "PUBKEY\n", recolor);
-        tab.info.version = try lvgl.Label.new(left, "VERSION\n", recolor);
+        tab.info.alias = try lvgl.Caption.new(left, "ALIAS");
+        tab.info.pubkey = try lvgl.Caption.new(left, "PUBKEY");
+        tab.info.version = try lvgl.Caption.new(left, "VERSION");
         // right column
         const right = try lvgl.FlexLayout.new(row, .column, .{});
         right.setHeightToContent();
         right.setWidth(lvgl.sizePercent(50));
         right.setPad(10, .row, .{});
-        tab.info.currblock = try lvgl.Label.new(right, "HEIGHT\n", recolor);
-        tab.info.blockhash = try lvgl.Label.new(right, "BLOCK HASH\n", recolor);
-        tab.info.npeers = try lvgl.Label.new(right, "CONNECTED PEERS\n", recolor);
+        tab.info.currblock = try lvgl.Caption.new(right, "HEIGHT");
+        tab.info.blockhash = try lvgl.Caption.new(right, "BLOCK HASH");
+        tab.info.npeers = try lvgl.Caption.new(right, "CONNECTED PEERS");
+        tab.info.npeers.setFlag(.clickable);
+        _ = tab.info.npeers.on(.click, nm_lnd_peers_click, null);
+        // bottom
+        tab.info.graph = try lvgl.Caption.new(tab.info.card, "NETWORK GRAPH");
+        tab.info.graph.value.setTextStatic("loading ...");
     }
     // balance section
     {
-        tab.balance.card = try lvgl.Card.new(parent, "BALANCE", .{});
+        tab.balance.card = try lvgl.Card.new(parent, "BALANCE", .{ .scroll_snapshot = true });
         const row = try lvgl.FlexLayout.new(tab.balance.card, .row, .{});
         row.setWidth(lvgl.sizePercent(100));
         row.clearFlag(.scrollable);
@@ -215,25 +326,67 @@ pub fn initTabPanel(allocator: std.mem.Allocator, cont: lvgl.Container) !void {
         const subrow = try lvgl.FlexLayout.new(left, .row, .{ .main = .space_between });
         subrow.setWidth(lvgl.sizePercent(90));
         subrow.setHeightToContent();
-        tab.balance.local = try lvgl.Label.new(subrow, "LOCAL\n", recolor);
-        tab.balance.remote = try lvgl.Label.new(subrow, "REMOTE\n", recolor);
+        tab.balance.local = try lvgl.Caption.new(subrow, "LOCAL");
+        tab.balance.remote = try lvgl.Caption.new(subrow, "REMOTE");
         // right column
         const right = try lvgl.FlexLayout.new(row, .column, .{});
         right.setWidth(lvgl.sizePercent(50));
         right.setPad(10, .row, .{});
-        tab.balance.pending = try lvgl.Label.new(right, "PENDING\n", recolor);
-        tab.balance.unsettled = try lvgl.Label.new(right, "UNSETTLED\n", recolor);
+        tab.balance.pending = try lvgl.Caption.new(right, "PENDING");
+        tab.balance.unsettled = try lvgl.Caption.new(right, "UNSETTLED");
         // bottom
-        tab.balance.fees = try lvgl.Label.new(tab.balance.card, "ACCUMULATED FORWARDING FEES\n", recolor);
+        tab.balance.fees = try lvgl.Caption.new(tab.balance.card, "ACCUMULATED FORWARDING FEES");
+        tab.balance.routing = try lvgl.Caption.new(tab.balance.card, "LIVE ROUTING");
+        tab.balance.routing.value.setTextStatic("no recent activity");
+        try tab.balance.trend.init(tab.balance.card, &.{
+            .{ .kind = .ln_local, .color = lvgl.Palette.main(.light_blue) },
+            .{ .kind = .ln_remote, .color = lvgl.Palette.main(.orange) },
+        }, .{ .unit = " sat" });
+        try tab.balance.fees_trend.init(tab.balance.card, &.{
+            .{ .kind = .ln_fees_day, .color = lvgl.Palette.main(.light_green) },
+        }, .{ .unit = " sat/day" });
     }
     // channels section
     {
         tab.channels.card = try lvgl.Card.new(parent, "CHANNELS", .{});
-        tab.channels.cont = try lvgl.FlexLayout.new(tab.channels.card, .column, .{});
-        tab.channels.cont.setHeightToContent();
-        tab.channels.cont.setWidth(lvgl.sizePercent(100));
-        tab.channels.cont.clearFlag(.scrollable);
-        tab.channels.cont.setPad(10, .row, .{});
+        const row = try lvgl.FlexLayout.new(tab.channels.card, .row, .{ .width = lvgl.sizePercent(100), .height = .content });
+        tab.channels.sortsel = try lvgl.Dropdown.newStatic(row, channel_sorts_text);
+        tab.channels.sortsel.flexGrow(1);
+        _ = tab.channels.sortsel.on(.value_changed, nm_lnd_channels_view_changed, null);
+        tab.channels.filtersel = try lvgl.Dropdown.newStatic(row, channel_filters_text);
+        tab.channels.filtersel.flexGrow(1);
+        _ = tab.channels.filtersel.on(.value_changed, nm_lnd_channels_view_changed, null);
+        tab.channels.search = try lvgl.TextArea.new(tab.channels.card, .{
+            .maxlen = comm.Message.LightningChannelsQuery.max_search_len,
+            .placeholder = "search peer alias, pubkey or channel id",
+        });
+        tab.channels.search.setWidth(lvgl.sizePercent(100));
+        tab.channels.search.onEach(&.{ .focus, .defocus, .ready, .cancel, .value_changed }, nm_lnd_channels_search_input, null);
+        tab.channels.search_text = .{};
+        tab.channels.data = &.{};
+        tab.channels.offset = 0;
+        tab.channels.paged = false;
+        tab.channels.query = .{ .limit = channel_page_size };
+        tab.channels.requested = false;
+        tab.channels.arena = std.heap.ArenaAllocator.init(allocator);
+        try tab.channels.list.init(allocator, tab.channels.card, cont, .{
+            .row_height = channel_row_height,
+            .gap = 10,
+        });
+    }
+    // payments section
+    {
+        tab.payments.card = try lvgl.Card.new(parent, "PAYMENTS", .{});
+        tab.payments.empty = try lvgl.Label.new(tab.payments.card, "no settled invoices or payments yet.", .{});
+        tab.payments.data = &.{};
+        tab.payments.offset = 0;
+        tab.payments.loaded = false;
+        tab.payments.requested = false;
+        tab.payments.arena = std.heap.ArenaAllocator.init(allocator);
+        try tab.payments.list.init(allocator, tab.payments.card, cont, .{
+            .row_height = payment_row_height,
+            .gap = 10,
+        });
     }
     // pairing section
     {
@@ -260,6 +413,20 @@ pub fn initTabPanel(allocator: std.mem.Allocator, cont: lvgl.Container) !void {
     tab.setMode(.startup);
 }
 
+/// reports whether msg is a reply to the current setup or pairing request.
+/// replies to earlier requests, for example from a setup window closed since,
+/// are stale. a zero id is from a peer unaware of request ids and always matches.
+pub fn isPendingReply(msg: comm.ParsedMessage) bool {
+    const setup = tab.seed_setup orelse return false;
+    return msg.id == 0 or msg.id == setup.request;
+}
+
+/// frees pairing QR code images kept for re-display; they are rendered again
+/// when next shown. the tab must be inited first with initTabPanel.
+pub fn dropCaches() void {
+    tab.pairing_qr.clear(tab.allocator);
+}
+
 /// updates the tab with new data from a `comm.Message` tagged with .lightning_xxx,
 /// the tab must be inited first with initTabPanel.
 pub fn updateTabPanel(msg: comm.Message) !void {
@@ -279,6 +446,381 @@ pub fn updateTabPanel(msg: comm.Message) !void {
     };
 }
 
+/// shows a page of channels from nd, a reply to a lightning_get_channels request
+/// or resent by nd when channels change. pages of other views than the current
+/// one are stale and ignored.
+/// the tab must be inited first with initTabPanel.
+pub fn updateChannelsPage(page: comm.Message.LightningChannelsPage) !void {
+    const ch = &tab.channels;
+    const q = page.query;
+    if (q.sort != ch.query.sort or q.desc != ch.query.desc or q.filter != ch.query.filter or !std.mem.eql(u8, q.search, ch.query.search)) {
+        return;
+    }
+    ch.requested = false;
+    ch.paged = true;
+    const bulk = lvgl.beginBulkUpdate(ch.card);
+    defer bulk.end();
+    _ = ch.arena.reset(.retain_capacity);
+    ch.offset = q.offset;
+    ch.data = comm.dupeDeep([]const comm.Message.LightningChannel, ch.arena.allocator(), page.channels) catch |err| {
+        ch.data = &.{};
+        ch.list.update(0) catch {};
+        return err;
+    };
+    try ch.list.update(page.total);
+}
+
+export fn nm_lnd_channels_view_changed(_: *lvgl.LvEvent) void {
+    const ch = &tab.channels;
+    const sort = channel_sorts[ch.sortsel.getSelected()];
+    ch.query.sort = sort.sort;
+    ch.query.desc = sort.desc;
+    ch.query.filter = @enumFromInt(ch.filtersel.getSelected());
+    ch.requested = false; // a reply for the previous view is stale
+    ch.requestPage(0) catch |err| logger.err("channels requestPage: {any}", .{err});
+}
+
+/// nd filters the channels with its search index: each keystroke is a page
+/// request of the new view.
+export fn nm_lnd_channels_search_input(e: *lvgl.LvEvent) void {
+    const ch = &tab.channels;
+    switch (e.code()) {
+        .focus => widget.keyboardOn(ch.search),
+        .defocus, .ready, .cancel => widget.keyboardOff(),
+        .value_changed => {
+            const text = ch.search.text();
+            if (std.mem.eql(u8, text, ch.query.search)) {
+                return;
+            }
+            ch.search_text.len = 0;
+            ch.search_text.appendSliceAssumeCapacity(text[0..@min(text.len, ch.search_text.buffer.len)]);
+            ch.query.search = ch.search_text.constSlice();
+            ch.requested = false; // a reply for the previous view is stale
+            ch.requestPage(0) catch |err| logger.err("channels requestPage: {any}", .{err});
+        },
+        else => {},
+    }
+}
+
+/// shows a page of the payments history from nd, a reply to a lightning_get_payments
+/// request or resent by nd when new items arrive.
+/// the tab must be inited first with initTabPanel.
+pub fn updatePaymentsPage(page: comm.Message.LightningPaymentsPage) !void {
+    const pay = &tab.payments;
+    pay.requested = false;
+    pay.loaded = true;
+    const bulk = lvgl.beginBulkUpdate(pay.card);
+    defer bulk.end();
+    _ = pay.arena.reset(.retain_capacity);
+    pay.offset = page.query.offset;
+    if (page.total == 0) {
+        pay.empty.show();
+    } else {
+        pay.empty.hide();
+    }
+    pay.data = comm.dupeDeep([]const comm.Message.LightningPayment, pay.arena.allocator(), page.payments) catch |err| {
+        pay.data = &.{};
+        pay.list.update(0) catch {};
+        return err;
+    };
+    try pay.list.update(page.total);
+}
+
+/// updates the balance trend charts with new data from the report.
+/// the tab must be inited first with initTabPanel.
+/// updates the network graph stats in the info section.
+pub fn updateGraph(g: comm.Message.LightningGraph) !void {
+    var buf: [256]u8 = undefined;
+    try tab.info.graph.setValueFmt(&buf,
+        \{} nodes, {} channels, {} sat capacity
+        \reachable: {} nodes, {d:.1} hops on average
+        \own channels: {d}, ranked {d} by the number of channels
+    , .{
+        xfmt.umetric(g.nodes),
+        xfmt.umetric(g.channels),
+        xfmt.umetric(g.capacity_sat),
+        xfmt.umetric(g.reachable),
+        g.avg_hops,
+        g.own_channels,
+        g.own_rank,
+    });
+}
+
+/// updates the live routing activity in the balance section.
+pub fn updateHtlcActivity(act: comm.Message.HtlcActivity) !void {
+    const f = act.hour.failures;
+    var reasons: [128]u8 = undefined;
+    var fbs = std.io.fixedBufferStream(&reasons);
+    inline for (std.meta.fields(@TypeOf(f))) |field| {
+        const n = @field(f, field.name);
+        if (n > 0) {
+            try fbs.writer().print(", {d} {s}", .{ n, field.name });
+        }
+    }
+    var buf: [512]u8 = undefined;
+    try tab.balance.routing.setValueFmt(&buf,
+        \IN FLIGHT: {d}  LAST 5 MIN: {d} forwards, {d} failed
+        \LAST HOUR: {d} forwards, {} sat routed, {} sat fees
+        \FAILED IN THE LAST HOUR: {d}{s}
+    , .{
+        act.in_flight,
+        act.recent.forwards,
+        sumFailures(act.recent.failures),
+        act.hour.forwards,
+        xfmt.umetric(act.hour.routed_sat),
+        xfmt.umetric(act.hour.fees_msat / 1000),
+        sumFailures(f),
+        fbs.getWritten(),
+    });
+}
+
+fn sumFailures(f: comm.Message.HtlcActivity.Failures) u32 {
+    var n: u32 = 0;
+    inline for (std.meta.fields(@TypeOf(f))) |field| {
+        n += @field(f, field.name);
+    }
+    return n;
+}
+
+/// marks the info card as behind by age_sec, or current if null, as when nd
+/// failed to collect lightning reports for a while. the title changes only
+/// once a minute at most, so that a periodic check is cheap.
+pub fn updateFreshness(age_sec: ?u64) !void {
+    const min: ?u64 = if (age_sec) |sec| sec / std.time.s_per_min else null;
+    if (std.meta.eql(min, tab.info.stale_min)) {
+        return;
+    }
+    tab.info.stale_min = min;
+    if (min) |m| {
+        var buf: [64]u8 = undefined;
+        try tab.info.card.title.setTextFmt(&buf, "INFO - AS OF {} AGO", .{std.fmt.fmtDuration(m * std.time.ns_per_min)});
+    } else {
+        tab.info.card.title.setText("INFO");
+    }
+}
+
+pub fn updateHistory(rep: comm.Message.HistoryReport) void {
+    tab.balance.trend.update(rep);
+    tab.balance.fees_trend.update(rep);
+}
+
+/// opens a window with the routing policies and peer of the channel id,
+/// which nd looks up on request: lightning reports carry none.
+fn openChannelDetail(id: []const u8) !void {
+    if (tab.chan_detail != null) {
+        return;
+    }
+    const win = try widget.acquireWindow(" " ++ symbol.LightningBolt ++ " CHANNEL");
+    errdefer widget.releaseWindow(win);
+    const wincont = win.content().flex(.column, .{});
+    wincont.setPad(10, .row, .{});
+    const text = try lvgl.Label.new(wincont, "LOOKING UP CHANNEL ...", .{ .recolor = true });
+    text.setWidth(lvgl.sizePercent(100));
+    text.flexGrow(1);
+    const closebtn = try lvgl.TextButton.new(wincont, "CLOSE");
+    closebtn.setWidth(lvgl.sizePercent(100));
+    _ = closebtn.on(.click, nm_lnd_chan_detail_close, null);
+    const req = comm.nextRequestId();
+    try comm.pipeWriteId(.{ .lightning_get_channel_detail = .{ .id = id } }, req);
+    tab.chan_detail = .{ .win = win, .text = text, .request = req };
+}
+
+export fn nm_lnd_chan_detail_close(_: *lvgl.LvEvent) void {
+    const d = tab.chan_detail orelse return;
+    widget.releaseWindow(d.win);
+    tab.chan_detail = null;
+    preserve_main_active_tab();
+}
+
+/// shows channel details from nd in the channel window, if still open for
+/// the request reqid. replies to earlier requests are stale and ignored.
+/// the tab must be inited first with initTabPanel.
+pub fn updateChannelDetail(reqid: u32, detail: comm.Message.LightningChannelDetail) !void {
+    const d = tab.chan_detail orelse return;
+    if (reqid != 0 and reqid != d.request) {
+        return;
+    }
+    var buf: [1024]u8 = undefined;
+    const info = detail.info orelse {
+        return d.text.setTextFmt(&buf, "#ff0000 CHANNEL {s} LOOKUP FAILED#\n{s}", .{ detail.id, detail.err orelse "unknown error" });
+    };
+    var fbs = std.io.fixedBufferStream(&buf);
+    const w = fbs.writer();
+    try w.print(cmark ++ "ID# {s}\n" ++ cmark ++ "CAPACITY# {} sat\n" ++ cmark ++ "UPDATED# {}\n\n", .{
+        detail.id,
+        xfmt.imetric(info.capacity),
+        xfmt.unix(info.last_update),
+    });
+    // TODO: sanitize peer alias?
+    try w.print(cmark ++ "PEER# {s}\n{s}\n{d} channels, {} sat capacity\n\n", .{
+        if (info.peer.alias.len > 0) info.peer.alias else "unknown alias",
+        info.peer.pubkey,
+        info.peer.num_channels,
+        xfmt.imetric(info.peer.total_capacity),
+    });
+    try writeRoutingPolicy(w, "LOCAL POLICY", info.local);
+    try w.writeByte('\n');
+    try writeRoutingPolicy(w, "REMOTE POLICY", info.remote);
+    try w.writeByte(0);
+    const text = fbs.getWritten();
+    d.text.setText(text[0 .. text.len - 1 :0]);
+}
+
+fn writeRoutingPolicy(w: anytype, comptime title: []const u8, policy: ?comm.Message.LightningChannelDetail.RoutingPolicy) !void {
+    const p = policy orelse return w.writeAll(cmark ++ title ++ "# not announced\n");
+    try w.print(cmark ++ title ++ "#{s}\nbase fee {} msat, fee rate {d} ppm\ntimelock delta {d} blocks\nhtlc {} to {} msat\n", .{
+        if (p.disabled) " #ff0000 DISABLED#" else "",
+        xfmt.imetric(p.base_fee),
+        p.fee_ppm,
+        p.timelock_delta,
+        xfmt.imetric(p.min_htlc),
+        xfmt.umetric(p.max_htlc),
+    });
+}
+
+/// peers shown in the peer window at most, the busiest first.
+const max_shown_peers = 32;
+
+/// opens a window with the connected peers, pushed by nd while it's open:
+/// lightning reports carry only their number.
+fn openPeerView() !void {
+    if (tab.peer_view != null) {
+        return;
+    }
+    const win = try widget.acquireWindow(" " ++ symbol.LightningBolt ++ " PEERS");
+    errdefer widget.releaseWindow(win);
+    const wincont = win.content().flex(.column, .{});
+    wincont.setPad(10, .row, .{});
+    const text = try lvgl.Label.new(wincont, "LOOKING UP PEERS ...", .{ .recolor = true });
+    text.setWidth(lvgl.sizePercent(100));
+    text.flexGrow(1);
+    const closebtn = try lvgl.TextButton.new(wincont, "CLOSE");
+    closebtn.setWidth(lvgl.sizePercent(100));
+    _ = closebtn.on(.click, nm_lnd_peers_close, null);
+    try comm.pipeWrite(.subscribe_lightning_peers);
+    tab.peer_view = .{ .win = win, .text = text };
+}
+
+export fn nm_lnd_peers_click(_: *lvgl.LvEvent) void {
+    openPeerView() catch |err| logger.err("openPeerView: {any}", .{err});
+}
+
+export fn nm_lnd_peers_close(_: *lvgl.LvEvent) void {
+    if (tab.peer_view == null) {
+        return;
+    }
+    const v = &tab.peer_view.?;
+    comm.pipeWrite(.unsubscribe_lightning_peers) catch |err| logger.err("unsubscribe_lightning_peers: {any}", .{err});
+    clearPeers();
+    v.peers.deinit(tab.allocator);
+    widget.releaseWindow(v.win);
+    tab.peer_view = null;
+    preserve_main_active_tab();
+}
+
+/// merges peers from nd into the peer window, if still open, and shows them.
+/// the tab must be inited first with initTabPanel.
+pub fn updatePeers(msg: comm.Message.LightningPeers) !void {
+    if (tab.peer_view == null) {
+        return; // sent before nd got unsubscribe_lightning_peers
+    }
+    if (msg.full) {
+        clearPeers();
+    }
+    const v = &tab.peer_view.?;
+    for (msg.removed) |pubkey| {
+        if (v.peers.fetchSwapRemove(pubkey)) |kv| {
+            freePeer(kv.value);
+        }
+    }
+    for (msg.peers) |p| {
+        try putPeer(p);
+    }
+
+    // the busiest peers first.
+    const Sort = struct {
+        peers: []const comm.Message.LightningPeer,
+        pub fn lessThan(ctx: @This(), a: usize, b: usize) bool {
+            const x = ctx.peers[a];
+            const y = ctx.peers[b];
+            return x.sent_bps +| x.recv_bps > y.sent_bps +| y.recv_bps;
+        }
+    };
+    const all = v.peers.values();
+    const order = try tab.allocator.alloc(usize, all.len);
+    defer tab.allocator.free(order);
+    for (order, 0..) |*i, n| {
+        i.* = n;
+    }
+    std.mem.sort(usize, order, Sort{ .peers = all }, Sort.lessThan);
+    const nshown = @min(order.len, max_shown_peers);
+
+    var buf: [max_shown_peers * 192]u8 = undefined;
+    var fbs = std.io.fixedBufferStream(buf[0 .. buf.len - 1]); // room for the sentinel
+    const w = fbs.writer();
+    if (all.len == 0) {
+        try w.writeAll("NO CONNECTED PEERS");
+    } else if (all.len > nshown) {
+        try w.print(cmark ++ "{d} PEERS,# the {d} busiest shown\n\n", .{ all.len, nshown });
+    }
+    for (order[0..nshown]) |i| {
+        writePeer(w, all[i]) catch |err| switch (err) {
+            error.NoSpaceLeft => break, // a long address or alias
+        };
+    }
+    const n = fbs.getWritten().len;
+    buf[n] = 0;
+    v.text.setText(buf[0..n :0]);
+}
+
+fn writePeer(w: anytype, p: comm.Message.LightningPeer) !void {
+    // TODO: sanitize peer alias?
+    try w.print(cmark ++ "{s}# {s}\n{s}\nping {d}.{d} ms, out {}B/s, in {}B/s\nsent {}B, received {}B\n\n", .{
+        if (p.alias.len > 0) p.alias else p.pubkey[0..@min(p.pubkey.len, 16)],
+        if (p.inbound) "inbound" else "outbound",
+        p.address,
+        p.ping_us / 1000,
+        p.ping_us % 1000 / 100,
+        xfmt.umetric(p.sent_bps),
+        xfmt.umetric(p.recv_bps),
+        xfmt.umetric(p.bytes_sent),
+        xfmt.umetric(p.bytes_recv),
+    });
+}
+
+/// adds or replaces the peer in the peer window with a copy of p.
+fn putPeer(p: comm.Message.LightningPeer) !void {
+    const v = &tab.peer_view.?;
+    const pubkey = try tab.allocator.dupe(u8, p.pubkey);
+    errdefer tab.allocator.free(pubkey);
+    const alias = try tab.allocator.dupe(u8, p.alias);
+    errdefer tab.allocator.free(alias);
+    const address = try tab.allocator.dupe(u8, p.address);
+    errdefer tab.allocator.free(address);
+    if (v.peers.fetchSwapRemove(p.pubkey)) |kv| {
+        freePeer(kv.value);
+    }
+    var copy = p;
+    copy.pubkey = pubkey;
+    copy.alias = alias;
+    copy.address = address;
+    try v.peers.put(tab.allocator, pubkey, copy);
+}
+
+fn freePeer(p: comm.Message.LightningPeer) void {
+    tab.allocator.free(p.pubkey);
+    tab.allocator.free(p.alias);
+    tab.allocator.free(p.address);
+}
+
+fn clearPeers() void {
+    const v = &tab.peer_view.?;
+    for (v.peers.values()) |p| {
+        freePeer(p);
+    }
+    v.peers.clearRetainingCapacity();
+}
+
 export fn nm_lnd_setup_click(_: *lvgl.LvEvent) void {
     startSeedSetup() catch |err| logger.err("startSeedSetup: {any}", .{err});
 }
@@ -296,26 +838,28 @@ export fn nm_lnd_setup_finish(_: *lvgl.LvEvent) void {
 }
 
 fn startSeedSetup() !void {
-    const win = try lvgl.Window.newTop(60, " " ++ symbol.LightningBolt ++ " LIGHTNING SETUP");
+    const win = try widget.acquireWindow(" " ++ symbol.LightningBolt ++ " LIGHTNING SETUP");
     try tab.initSetup(win);
     errdefer tab.destroySetup(); // TODO: display an error instead
     const wincont = win.content().flex(.row, .{ .all = .center });
     _ = try lvgl.Spinner.new(wincont);
     _ = try lvgl.Label.new(wincont, "GENERATING SEED ...", .{});
-    try comm.pipeWrite(.lightning_genseed);
+    tab.seed_setup.?.request = comm.nextRequestId();
+    try comm.pipeWriteId(.lightning_genseed, tab.seed_setup.?.request);
 }
 
 /// similar to `startSeedSetup` but used when seed is already setup,
 /// at any time later.
 /// reuses tab.seed_setup elements for the same purpose.
 fn startPairing() !void {
-    const win = try lvgl.Window.newTop(60, " " ++ symbol.LightningBolt ++ " PAIRING SETUP");
+    const win = try widget.acquireWindow(" " ++ symbol.LightningBolt ++ " PAIRING SETUP");
     try tab.initSetup(win);
     errdefer tab.destroySetup(); // TODO: display an error instead
     const wincont = win.content().flex(.row, .{ .all = .center });
     _ = try lvgl.Spinner.new(wincont);
     _ = try lvgl.Label.new(wincont, "GATHERING CONNECTION DATA ...", .{});
-    try comm.pipeWrite(.lightning_get_ctrlconn);
+    tab.seed_setup.?.request = comm.nextRequestId();
+    try comm.pipeWriteId(.lightning_get_ctrlconn, tab.seed_setup.?.request);
 }
 
 fn confirmSetupSeed(mnemonic: []const []const u8) !void {
@@ -329,7 +873,7 @@ fn confirmSetupSeed(mnemonic: []const []const u8) !void {
     tab.seed_setup.?.mnemonic = try types.StringList.fromUnowned(tab.seed_setup.?.arena.allocator(), mnemonic);
 
     const wincont = tab.seed_setup.?.topwin.content().flex(.column, .{});
-    wincont.deleteChildren();
+    wincont.deleteChildrenDeferred();
     preserve_main_active_tab();
 
     _ = try lvgl.Label.new(wincont,
@@ -383,12 +927,13 @@ fn setupCommitSeed() !void {
         return error.LightningSetupNullMnemonic;
     }
     const wincont = tab.seed_setup.?.topwin.content().flex(.row, .{ .all = .center });
-    wincont.deleteChildren();
+    wincont.deleteChildrenDeferred();
     preserve_main_active_tab();
     _ = try lvgl.Spinner.new(wincont);
     _ = try lvgl.Label.new(wincont, "INITIALIZING WALLET ...", .{});
     try comm.pipeWrite(.{ .lightning_init_wallet = .{ .mnemonic = tab.seed_setup.?.mnemonic.?.items() } });
-    try comm.pipeWrite(.lightning_get_ctrlconn);
+    tab.seed_setup.?.request = comm.nextRequestId();
+    try comm.pipeWriteId(.lightning_get_ctrlconn, tab.seed_setup.?.request);
 }
 
 fn setupPairing(conn: comm.Message.LightningCtrlConn) !void {
@@ -412,7 +957,7 @@ fn setupPairing(conn: comm.Message.LightningCtrlConn) !void {
     const appsel_options = try std.mem.joinZ(alloc, "\n", urlmap.keys());
 
     const wincont = tab.seed_setup.?.topwin.content().flex(.row, .{ .width = lvgl.sizePercent(100), .height = .content });
-    wincont.deleteChildren();
+    wincont.deleteChildrenDeferred();
     preserve_main_active_tab();
 
     const colopt = lvgl.FlexLayout.AlignOpt{
@@ -463,7 +1008,7 @@ fn updatePairingApp() void {
         pairing.appdesc.setTextStatic(appdesc);
         pairing.qr.show();
         pairing.qrerr.hide();
-        pairing.qr.setQrData(pairing.urlmap.get(appname).?) catch |err| {
+        tab.pairing_qr.show(tab.allocator, pairing.qr, pairing.urlmap.get(appname).?) catch |err| {
             logger.err("updatePairingApp: setQrData: {!}", .{err});
             pairing.qr.hide();
             pairing.qrerr.show();
@@ -510,12 +1055,16 @@ fn updateReport(rep: comm.Message.LightningReport) !void {
     var buf: [512]u8 = undefined;
 
     // info section
-    try tab.info.alias.setTextFmt(&buf, cmark ++ "ALIAS#\n{s}", .{rep.alias});
-    try tab.info.pubkey.setTextFmt(&buf, cmark ++ "PUBKEY#\n{s}\n{s}", .{ rep.pubkey[0..33], rep.pubkey[33..] });
-    try tab.info.version.setTextFmt(&buf, cmark ++ "VERSION#\n{s}", .{rep.version});
-    try tab.info.currblock.setTextFmt(&buf, cmark ++ "HEIGHT#\n{d}", .{rep.height});
-    try tab.info.blockhash.setTextFmt(&buf, cmark ++ "BLOCK HASH#\n{s}\n{s}", .{ rep.hash[0..32], rep.hash[32..] });
-    try tab.info.npeers.setTextFmt(&buf, cmark ++ "CONNECTED PEERS#\n{d}", .{rep.npeers});
+    // restored by nd from a previous run, or lnd is slow to report.
+    try updateFreshness(rep.stale_sec);
+    try tab.info.alias.setValueFmt(&buf, "{s}", .{rep.alias});
+    const pubkey = rep.pubkey.hex();
+    try tab.info.pubkey.setValueFmt(&buf, "{s}\n{s}", .{ pubkey[0..33], pubkey[33..] });
+    try tab.info.version.setValueFmt(&buf, "{s}", .{rep.version});
+    try tab.info.currblock.setValueFmt(&buf, "{d}", .{rep.height});
+    const blockhash = rep.hash.hex();
+    try tab.info.blockhash.setValueFmt(&buf, "{s}\n{s}", .{ blockhash[0..32], blockhash[32..] });
+    try tab.info.npeers.setValueFmt(&buf, "{d}", .{rep.npeers});
 
     // balance section
     const local_pct: i32 = pct: {
@@ -527,42 +1076,343 @@ fn updateReport(rep: comm.Message.LightningReport) !void {
         break :pct @intFromFloat(v * 100);
     };
     tab.balance.avail.setValue(local_pct);
-    try tab.balance.local.setTextFmt(&buf, cmark ++ "LOCAL#\n{} sat", .{xfmt.imetric(rep.totalbalance.local)});
-    try tab.balance.remote.setTextFmt(&buf, cmark ++ "REMOTE#\n{} sat", .{xfmt.imetric(rep.totalbalance.remote)});
-    try tab.balance.pending.setTextFmt(&buf, cmark ++ "PENDING#\n{} sat", .{xfmt.imetric(rep.totalbalance.pending)});
-    try tab.balance.unsettled.setTextFmt(&buf, cmark ++ "UNSETTLED#\n{}", .{xfmt.imetric(rep.totalbalance.unsettled)});
-    try tab.balance.fees.setTextFmt(&buf, cmark ++ "ACCUMULATED FORWARDING FEES#\nDAY: {} sat  WEEK: {} sat  MONTH: {} sat", .{
+    try tab.balance.local.setValueFmt(&buf, "{} sat", .{xfmt.imetric(rep.totalbalance.local)});
+    try tab.balance.remote.setValueFmt(&buf, "{} sat", .{xfmt.imetric(rep.totalbalance.remote)});
+    try tab.balance.pending.setValueFmt(&buf, "{} sat", .{xfmt.imetric(rep.totalbalance.pending)});
+    try tab.balance.unsettled.setValueFmt(&buf, "{}", .{xfmt.imetric(rep.totalbalance.unsettled)});
+    try tab.balance.fees.setValueFmt(&buf, "DAY: {} sat  WEEK: {} sat  MONTH: {} sat", .{
         xfmt.umetric(rep.totalfees.day),
         xfmt.umetric(rep.totalfees.week),
         xfmt.umetric(rep.totalfees.month),
     });
 
-    // channels section
-    tab.channels.cont.deleteChildren();
-    for (rep.channels) |ch| {
-        const chbox = (try lvgl.Container.new(tab.channels.cont)).flex(.column, .{});
+    // payments section: nd sends pages only on request.
+    if (!tab.payments.loaded) {
+        tab.payments.requestPage(0) catch |err| logger.err("payments requestPage: {any}", .{err});
+    }
+
+    // channels section: nd with channel pages support sends none in reports;
+    // the first report is a good time to ask for a first page.
+    if (tab.channels.paged) {
+        return;
+    }
+    tab.channels.requestPage(0) catch |err| logger.err("channels requestPage: {any}", .{err});
+    // rows are materialized only when scrolled into view,
+    // so the report channels are copied to outlive rep.
+    const bulk = lvgl.beginBulkUpdate(tab.channels.card);
+    defer bulk.end();
+    _ = tab.channels.arena.reset(.retain_capacity);
+    tab.channels.data = comm.dupeDeep([]const comm.Message.LightningChannel, tab.channels.arena.allocator(), rep.channels) catch |err| {
+        tab.channels.data = &.{};
+        tab.channels.list.update(0) catch {};
+        return err;
+    };
+    try tab.channels.list.update(tab.channels.data.len);
+}
+
+/// height of a channel row in the channels card, including the gap between rows.
+/// fits all labels of a pending close channel.
+/// QR code images keyed by the encoded URL, so that switching between apps
+/// in the pairing dialog or opening it again doesn't re-encode and re-render
+/// the same data. accessed only from the UI thread.
+const QrCache = struct {
+    map: std.StringHashMapUnmanaged([]const u8) = .{},
+    size: lvgl.Coord = 0, // of the QR code widget all images are rendered for
+
+    /// the URLs are few: a couple per app, changing only with a new wallet.
+    const max_entries = 8;
+
+    /// displays url in qr, from the cache when available.
+    fn show(self: *QrCache, allocator: std.mem.Allocator, qr: lvgl.QrCode, url: []const u8) !void {
+        if (qr.size != self.size) {
+            self.clear(allocator);
+            self.size = qr.size;
+        }
+        if (self.map.get(url)) |img| {
+            return qr.setImageData(img);
+        }
+        try qr.setQrData(url);
+        self.put(allocator, url, qr.imageData()) catch |err| logger.err("QrCache.put: {!}", .{err});
+    }
+
+    fn put(self: *QrCache, allocator: std.mem.Allocator, url: []const u8, img: []const u8) !void {
+        if (self.map.count() >= max_entries) {
+            self.clear(allocator);
+        }
+        const key = try allocator.dupe(u8, url);
+        errdefer allocator.free(key);
+        const val = try allocator.dupe(u8, img);
+        errdefer allocator.free(val);
+        try self.map.put(allocator, key, val);
+    }
+
+    fn clear(self: *QrCache, allocator: std.mem.Allocator) void {
+        var it = self.map.iterator();
+        while (it.next()) |kv| {
+            allocator.free(kv.key_ptr.*);
+            allocator.free(kv.value_ptr.*);
+        }
+        self.map.clearAndFree(allocator);
+    }
+};
+
+const channel_row_height: lvgl.Coord = 260;
+
+/// number of channels requested from nd at once when paging.
+const channel_page_size = 20;
+
+/// sort orders of the channels sort dropdown items.
+const channel_sorts = [_]struct { sort: comm.Message.LightningChannelsQuery.Sort, desc: bool }{
+    .{ .sort = .none, .desc = false },
+    .{ .sort = .capacity, .desc = true },
+    .{ .sort = .local_balance, .desc = true },
+    .{ .sort = .fee_rate, .desc = true },
+    .{ .sort = .fees_earned, .desc = true },
+    .{ .sort = .inactive_first, .desc = false },
+};
+// items order must match that of channel_sorts.
+const channel_sorts_text = "lnd order\nlargest capacity\nlargest local balance\nhighest fee rate\nmost fees earned\ninactive first";
+// items order must match LightningChannelsQuery.Filter values.
+const channel_filters_text = blk: {
+    const F = comm.Message.LightningChannelsQuery.Filter;
+    break :blk @tagName(F.all) // index 0
+    ++ "\n" ++ @tagName(F.active) // index 1
+    ++ "\n" ++ @tagName(F.inactive) // index 2
+    ++ "\n" ++ @tagName(F.pending); // index 3
+};
+
+/// height of a payment row in the payments card, including the gap between rows.
+const payment_row_height: lvgl.Coord = 80;
+
+/// number of payments history items requested from nd at once.
+const payment_page_size = 20;
+
+/// widgets of a single item in the payments card, re-used by tab.payments.list
+/// for whichever item is scrolled into its position.
+const PaymentRow = struct {
+    lvobj: *lvgl.LvObj, // item box container
+    title: lvgl.Label, // direction and amount
+    detail: lvgl.Label, // time and memo
+
+    pub usingnamespace lvgl.BaseObjMethods;
+
+    pub fn new(parent: lvgl.Container) !PaymentRow {
+        const box = (try lvgl.Container.new(parent)).flex(.column, .{});
+        errdefer box.destroy();
+        box.setWidth(lvgl.sizePercent(100));
+        box.clearFlag(.scrollable); // height is set by the list
+        const title = try lvgl.Label.new(box, null, .{ .recolor = true });
+        const detail = try lvgl.Label.new(box, null, .{ .long_mode = .dot });
+        detail.setWidth(lvgl.sizePercent(100));
+        return .{ .lvobj = box.lvobj, .title = title, .detail = detail };
+    }
+
+    /// shows the item at index of the list. an item not received yet is
+    /// requested from nd and the row stays hidden until it arrives.
+    pub fn bind(self: *PaymentRow, index: usize) !void {
+        const p = tab.payments.at(index) orelse {
+            self.hide();
+            return tab.payments.requestPage(index);
+        };
+        var buf: [256]u8 = undefined;
+        switch (p.dir) {
+            .received => try self.title.setTextFmt(&buf, "#00ff00 RECEIVED# {} sat", .{xfmt.imetric(@divTrunc(p.amount, 1000))}),
+            .sent => try self.title.setTextFmt(&buf, "#ffff00 SENT# {} sat, fee {} sat", .{
+                xfmt.imetric(@divTrunc(p.amount, 1000)),
+                xfmt.imetric(@divTrunc(p.fee, 1000)),
+            }),
+        }
+        try self.detail.setTextFmt(&buf, "{}  {s}", .{ xfmt.unix(p.time), p.memo });
+    }
+};
+
+/// a single channel in the channels card, re-used by tab.channels.list
+/// for whichever channel is currently scrolled into its position.
+/// the row is one object drawing all of its texts and the balance bar in a
+/// draw callback, rather than a tree of a dozen labels and flex containers:
+/// rows are rebound on every scroll step, and each label set anew would
+/// take a layout pass and a redraw of its own.
+const ChannelRow = struct {
+    lvobj: *lvgl.LvObj, // channel box container
+    /// heap allocated since the list moves rows in memory while the draw
+    /// callback refers to it; freed along with the lvobj.
+    view: *View,
+    /// hash of the channel the row was last updated with.
+    hash: ?u64 = null,
+
+    pub usingnamespace lvgl.BaseObjMethods;
+
+    const Field = enum {
+        title, // peer alias and state
+        local,
+        received,
+        basefee, // active and inactive only
+        feeppm, // active and inactive only
+        remote,
+        sent,
+        id, // empty when unknown
+        funding,
+        closing, // pending close only
+    };
+
+    /// the rendered texts, empty when hidden, and their positions.
+    const View = struct {
+        bufs: std.EnumArray(Field, [192]u8) = undefined,
+        texts: std.EnumArray(Field, [:0]const u8) = std.EnumArray(Field, [:0]const u8).initFill(""),
+        title_recolor: bool = false,
+        local_pct: i32 = 0, // local vs remote balance
+        /// text and bar areas relative to the content top left corner,
+        /// as of layout_width; null if outdated.
+        areas: std.EnumArray(Field, lvgl.Area) = undefined,
+        bar: lvgl.Area = undefined,
+        layout_width: ?lvgl.Coord = null,
+        /// list index of the channel the row is bound to.
+        index: usize = 0,
+
+        fn set(self: *View, f: Field, comptime format: []const u8, args: anytype) !void {
+            self.texts.set(f, try std.fmt.bufPrintZ(self.bufs.getPtr(f), format, args));
+        }
+
+        fn clear(self: *View, f: Field) void {
+            self.texts.set(f, "");
+        }
+
+        /// positions the texts in three columns below the title, like so:
+        /// bar spanning the first two, followed by local, received and fees
+        /// in the first, remote and sent in the second; ids in the third.
+        fn layout(self: *View, width: lvgl.Coord, line_height: lvgl.Coord) void {
+            const gap = 10;
+            const bar_height = 20;
+            const left_width: lvgl.Coord = @intCast(@divTrunc(@as(i32, width) * 46, 100));
+            const top = self.height(.title, line_height) + gap;
+            self.areas.set(.title, .{ .x1 = 0, .y1 = 0, .x2 = width - 1, .y2 = top - gap - 1 });
+            self.bar = .{ .x1 = 0, .y1 = top, .x2 = left_width - 1, .y2 = top + bar_height - 1 };
+            const sub_top = top + bar_height + gap;
+            self.stack(&.{ .local, .received, .basefee, .feeppm }, 0, left_width, sub_top, gap, line_height);
+            self.stack(&.{ .remote, .sent }, left_width - @divTrunc(left_width, 3), left_width, sub_top, gap, line_height);
+            self.stack(&.{ .id, .funding, .closing }, left_width + gap, width, top, gap, line_height);
+            self.layout_width = width;
+        }
+
+        /// places fields in a column from x1 to x2, starting at y, skipping empty ones.
+        fn stack(self: *View, fields: []const Field, x1: lvgl.Coord, x2: lvgl.Coord, y: lvgl.Coord, gap: lvgl.Coord, line_height: lvgl.Coord) void {
+            var y1 = y;
+            for (fields) |f| {
+                const h = self.height(f, line_height);
+                self.areas.set(f, .{ .x1 = x1, .y1 = y1, .x2 = x2 - 1, .y2 = y1 + h - 1 });
+                if (h > 0) {
+                    y1 += h + gap;
+                }
+            }
+        }
+
+        fn height(self: *View, f: Field, line_height: lvgl.Coord) lvgl.Coord {
+            const text = self.texts.get(f);
+            if (text.len == 0) {
+                return 0;
+            }
+            const n: lvgl.Coord = @intCast(std.mem.count(u8, text, "\n") + 1);
+            return n * line_height;
+        }
+    };
+
+    pub fn new(parent: lvgl.Container) !ChannelRow {
+        const view = try tab.allocator.create(View);
+        view.* = .{};
+        const chbox = lvgl.Container.new(parent) catch |err| {
+            tab.allocator.destroy(view);
+            return err;
+        };
         chbox.setWidth(lvgl.sizePercent(100));
-        chbox.setHeightToContent();
-        _ = try switch (ch.state) {
-            // TODO: sanitize peer_alias?
-            .active => lvgl.Label.newFmt(chbox, &buf, "{s}", .{ch.peer_alias}, .{}),
-            .inactive => lvgl.Label.newFmt(chbox, &buf, "#ff0000 [INACTIVE]# {s}", .{ch.peer_alias}, .{ .recolor = true }),
-            .pending_open => lvgl.Label.new(chbox, "#00ff00 [PENDING OPEN]#", .{ .recolor = true }),
-            .pending_close => lvgl.Label.new(chbox, "#ffff00 [PENDING CLOSE]#", .{ .recolor = true }),
+        chbox.clearFlag(.scrollable); // height is set by the list
+        _ = chbox.on(.draw_main, onDraw, view);
+        _ = chbox.on(.delete, onDelete, view);
+        _ = chbox.on(.click, onClick, view);
+        return .{ .lvobj = chbox.lvobj, .view = view };
+    }
+
+    /// opens the details window of the channel the row is bound to.
+    fn onClick(e: *lvgl.LvEvent) callconv(.C) void {
+        const view: *View = @ptrCast(@alignCast(e.userdata()));
+        const ch = tab.channels.at(view.index) orelse return;
+        const id = ch.id orelse return; // pending channels aren't in the graph yet
+        openChannelDetail(id) catch |err| logger.err("openChannelDetail: {any}", .{err});
+    }
+
+    fn onDelete(e: *lvgl.LvEvent) callconv(.C) void {
+        const view: *View = @ptrCast(@alignCast(e.userdata()));
+        tab.allocator.destroy(view);
+    }
+
+    /// draws the row contents on top of the container background.
+    fn onDraw(e: *lvgl.LvEvent) callconv(.C) void {
+        const view: *View = @ptrCast(@alignCast(e.userdata()));
+        const obj = lvgl.Container{ .lvobj = e.target() };
+        const ctx = e.drawCtx();
+        const box = obj.contentCoords();
+        const width = box.x2 - box.x1 + 1;
+        if (view.layout_width != width) {
+            view.layout(width, lvgl.DrawCtx.lineHeight(obj.lvobj));
+        }
+
+        const bar = offset(view.bar, box);
+        const primary = obj.themePrimary();
+        ctx.fillRect(bar, primary, .{ .muted = true, .radius = @divTrunc(bar.y2 - bar.y1 + 1, 2) });
+        if (view.local_pct > 0) {
+            var ind = bar;
+            ind.x2 = bar.x1 + @as(lvgl.Coord, @intCast(@divTrunc((bar.x2 - bar.x1 + 1) * view.local_pct, 100))) - 1;
+            ctx.fillRect(ind, primary, .{ .radius = @divTrunc(bar.y2 - bar.y1 + 1, 2) });
+        }
+        for (std.enums.values(Field)) |f| {
+            const text = view.texts.get(f);
+            if (text.len == 0) {
+                continue;
+            }
+            const recolor = f != .title or view.title_recolor;
+            ctx.text(obj.lvobj, offset(view.areas.get(f), box), text.ptr, recolor);
+        }
+    }
+
+    /// translates an area relative to the box top left corner to screen coordinates.
+    fn offset(a: lvgl.Area, box: lvgl.Area) lvgl.Area {
+        return .{ .x1 = box.x1 + a.x1, .y1 = box.y1 + a.y1, .x2 = box.x1 + a.x2, .y2 = box.y1 + a.y2 };
+    }
+
+    /// shows the channel at index of the list. a channel not received yet
+    /// is requested from nd and the row stays hidden until it arrives.
+    pub fn bind(self: *ChannelRow, index: usize) !void {
+        self.view.index = index;
+        const ch = tab.channels.at(index) orelse {
+            self.hide();
+            return tab.channels.requestPage(index);
         };
-        const row = try lvgl.FlexLayout.new(chbox, .row, .{});
-        row.setWidth(lvgl.sizePercent(100));
-        row.clearFlag(.scrollable);
-        row.setHeightToContent();
+        try self.update(ch);
+    }
 
-        // left column
-        const left = try lvgl.FlexLayout.new(row, .column, .{});
-        left.setWidth(lvgl.sizePercent(46));
-        left.setHeightToContent();
-        left.setPad(10, .row, .{});
-        const bbar = try lvgl.Bar.new(left);
-        bbar.setWidth(lvgl.sizePercent(100));
-        const chan_local_pct: i32 = pct: {
+    /// renders the channel ch texts unless unchanged since the last update,
+    /// and schedules a redraw.
+    fn update(self: *ChannelRow, ch: comm.Message.LightningChannel) !void {
+        var hasher = std.hash.Wyhash.init(0);
+        std.hash.autoHashStrat(&hasher, ch, .Deep);
+        const hash = hasher.final();
+        if (self.hash == hash) {
+            return;
+        }
+        self.hash = null; // in case of a partial update
+        const view = self.view;
+        view.layout_width = null;
+        defer self.invalidate();
+
+        // TODO: sanitize peer_alias?
+        view.title_recolor = ch.state != .active;
+        switch (ch.state) {
+            .active => try view.set(.title, "{s}", .{ch.peer_alias}),
+            .inactive => try view.set(.title, "#ff0000 [INACTIVE]# {s}", .{ch.peer_alias}),
+            .pending_open => try view.set(.title, "#00ff00 [PENDING OPEN]#", .{}),
+            .pending_close => try view.set(.title, "#ffff00 [PENDING CLOSE]#", .{}),
+        }
+
+        view.local_pct = pct: {
             const total = ch.balance.local + ch.balance.remote;
             if (total == 0) {
                 break :pct 0;
@@ -570,35 +1420,31 @@ fn updateReport(rep: comm.Message.LightningReport) !void {
             const v = @as(f64, @floatFromInt(ch.balance.local)) / @as(f64, @floatFromInt(total));
             break :pct @intFromFloat(v * 100);
         };
-        bbar.setValue(chan_local_pct);
-        const subrow = try lvgl.FlexLayout.new(left, .row, .{ .main = .space_between });
-        subrow.setWidth(lvgl.sizePercent(100));
-        subrow.setHeightToContent();
-        const subcol1 = try lvgl.FlexLayout.new(subrow, .column, .{});
-        subcol1.setPad(10, .row, .{});
-        subcol1.setHeightToContent();
-        const subcol2 = try lvgl.FlexLayout.new(subrow, .column, .{});
-        subcol2.setPad(10, .row, .{});
-        _ = try lvgl.Label.newFmt(subcol1, &buf, cmark ++ "LOCAL#\n{} sat", .{xfmt.imetric(ch.balance.local)}, .{ .recolor = true });
-        _ = try lvgl.Label.newFmt(subcol1, &buf, cmark ++ "RECEIVED#\n{} sat", .{xfmt.imetric(ch.totalsats.received)}, .{ .recolor = true });
+        try view.set(.local, cmark ++ "LOCAL#\n{} sat", .{xfmt.imetric(ch.balance.local)});
+        try view.set(.received, cmark ++ "RECEIVED#\n{} sat", .{xfmt.imetric(ch.totalsats.received)});
         if (ch.state == .active or ch.state == .inactive) {
-            _ = try lvgl.Label.newFmt(subcol1, &buf, cmark ++ "BASE FEE#\n{} msat", .{xfmt.imetric(ch.fees.base)}, .{ .recolor = true });
-            _ = try lvgl.Label.newFmt(subcol1, &buf, cmark ++ "FEE PPM#\n{d}", .{ch.fees.ppm}, .{ .recolor = true });
+            try view.set(.basefee, cmark ++ "BASE FEE#\n{} msat", .{xfmt.imetric(ch.fees.base)});
+            try view.set(.feeppm, cmark ++ "FEE PPM#\n{d}, {} sat earned in 30 days", .{ ch.fees.ppm, xfmt.umetric(ch.fees.earned / 1000) });
+        } else {
+            view.clear(.basefee);
+            view.clear(.feeppm);
         }
-        _ = try lvgl.Label.newFmt(subcol2, &buf, cmark ++ "REMOTE#\n{} sat", .{xfmt.imetric(ch.balance.remote)}, .{ .recolor = true });
-        _ = try lvgl.Label.newFmt(subcol2, &buf, cmark ++ "SENT#\n{} sat", .{xfmt.imetric(ch.totalsats.sent)}, .{ .recolor = true });
+        try view.set(.remote, cmark ++ "REMOTE#\n{} sat", .{xfmt.imetric(ch.balance.remote)});
+        try view.set(.sent, cmark ++ "SENT#\n{} sat", .{xfmt.imetric(ch.totalsats.sent)});
 
-        // right column
-        const right = try lvgl.FlexLayout.new(row, .column, .{});
-        right.setWidth(lvgl.sizePercent(54));
-        right.setHeightToContent();
-        right.setPad(10, .row, .{});
         if (ch.id) |id| {
-            _ = try lvgl.Label.newFmt(right, &buf, cmark ++ "ID#\n{s}", .{id}, .{ .recolor = true });
+            try view.set(.id, cmark ++ "ID#\n{s}", .{id});
+        } else {
+            view.clear(.id);
         }
-        _ = try lvgl.Label.newFmt(right, &buf, cmark ++ "FUNDING TX#\n{s}\n{s}", .{ ch.point[0..32], ch.point[32..] }, .{ .recolor = true });
+        const txid = ch.point.txid.hex();
+        try view.set(.funding, cmark ++ "FUNDING TX#\n{s}\n{s}:{d}", .{ txid[0..32], txid[32..], ch.point.index });
         if (ch.closetxid) |tx| {
-            _ = try lvgl.Label.newFmt(right, &buf, cmark ++ "CLOSING TX#\n{s}\n{s}", .{ tx[0..32], tx[32..] }, .{ .recolor = true });
+            const closetxid = tx.hex();
+            try view.set(.closing, cmark ++ "CLOSING TX#\n{s}\n{s}", .{ closetxid[0..32], closetxid[32..] });
+        } else {
+            view.clear(.closing);
         }
+        self.hash = hash;
     }
-}
+};
@@ -0,0 +1,317 @@
+//! on-device rendering benchmark of the lvbench executable: ngui built with
+//! `zig build lvbench` for any driver, which talks to no nd and instead runs
+//! the LVGL demo benchmark scenes and then ndg's own on the real UI, printing
+//! a JSON line of results per scene to stdout, like:
+//!
+//!     {"suite":"lvgl","scene":"Rectangle","ms":1003,"frames":412,...}
+//!
+//! frames are timed by the perf.zig display driver hooks rather than the
+//! demo, whose results are made for its own summary screen: render excludes
+//! flush, the time the driver takes to get a frame onto the display.
+//! all scenes run on the UI thread, driven by an LVGL timer.
+
+const buildopts = @import("build_options");
+const std = @import("std");
+
+const comm = @import("../comm.zig");
+const lightning = @import("lightning.zig");
+const lvgl = @import("lvgl.zig");
+const perf = @import("perf.zig");
+const widget = @import("widget.zig");
+
+const logger = std.log.scoped(.lvbench);
+
+// defined in c/lvbench.c
+extern "c" fn nm_lvbench_init(done: *const fn () callconv(.C) void) void;
+extern "c" fn nm_lvbench_run_scene(n: c_int, name: *[*:0]const u8) c_int;
+extern "c" fn nm_lvbench_close_scene() void;
+// defined in c/ui.c
+extern "c" fn nm_ui_tab_panel(n: u16) ?*lvgl.LvObj;
+extern "c" fn nm_ui_show_tab(n: u16) void;
+
+/// tabs in the order of nm_ui_init_main_tabview.
+const ntabs = 4;
+const lightning_tab = 1;
+const settings_tab = 2;
+
+/// ndg scenes, run after the LVGL ones for a fixed time each.
+const Scene = enum { tab_switch, channel_scroll, keyboard_popup };
+const scene_ms = 3 * std.time.ms_per_s;
+/// time between tab switches and keyboard popups or popoffs, in ms.
+const switch_ms = 200;
+/// pixels the channel list scrolls by per frame.
+const scroll_step = 24;
+/// lightning channels in the report shown by the channel_scroll scene.
+const nchannels = 200;
+/// frame times kept per scene for percentiles; averages count all frames.
+const max_samples = 8192;
+
+const Stats = struct {
+    frames: u32 = 0,
+    render_sum: u64 = 0,
+    render_max: u64 = 0,
+    flush_sum: u64 = 0,
+    px_sum: u64 = 0,
+    renders: std.BoundedArray(u32, max_samples) = .{},
+};
+
+/// a line of results on stdout; durations in us unless noted otherwise.
+const Result = struct {
+    suite: []const u8, // "lvgl" or "ndg"
+    scene: []const u8,
+    ms: u64, // scene wall time
+    frames: u32,
+    fps: u64, // frames per second of wall time
+    render: struct { avg: u64, p50: u32, p99: u32, max: u64 },
+    flush_avg: u64,
+    px_avg: u64,
+};
+
+/// benchmark state; UI thread only.
+var arena_state: std.heap.ArenaAllocator = undefined;
+var done_event: *std.Thread.ResetEvent = undefined;
+var main_screen: lvgl.Screen = undefined;
+var demo_screen: lvgl.Screen = undefined;
+var stats: Stats = .{};
+var current: struct {
+    demo: c_int = 0, // LVGL demo scene number
+    demo_ended: bool = false, // set by the demo, 1s after the scene start
+    ndg: ?Scene = null, // non-null past the LVGL scenes
+    name: [64]u8 = undefined,
+    name_len: usize = 0,
+    start: u64 = 0, // perf.now timestamp
+    last_step: u64 = 0,
+    step: u32 = 0,
+    scroll_down: bool = true,
+    input: ?lvgl.TextArea = null, // keyboard_popup text input
+} = .{};
+
+/// starts the benchmark; must be called after ui.init and before the UI
+/// thread starts. done is set after the last scene.
+pub fn start(gpa: std.mem.Allocator, done: *std.Thread.ResetEvent) !void {
+    arena_state = std.heap.ArenaAllocator.init(gpa);
+    done_event = done;
+
+    var verbuf: [32]u8 = undefined;
+    const version = try std.fmt.bufPrint(&verbuf, "{any}", .{buildopts.semver});
+    try emit(.{ .lvbench = version, .driver = @tagName(buildopts.driver) });
+
+    main_screen = try lvgl.Screen.active();
+    demo_screen = try lvgl.Screen.new();
+    demo_screen.load();
+    nm_lvbench_init(demoSceneEnded);
+    perf.frame_hook = onFrame;
+    if (!startDemoScene()) {
+        try startNdgScene(.tab_switch);
+    }
+    // the demo leaves display refresh and animation timers at 1ms, so the
+    // ndg scenes run at the maximum frame rate as well.
+    _ = try lvgl.LvTimer.new(tick, 1, null);
+}
+
+fn tick(timer: *lvgl.LvTimer) callconv(.C) void {
+    if (current.ndg) |sc| {
+        stepNdgScene(sc) catch |err| logger.err("{s}: {any}", .{ @tagName(sc), err });
+        if (current.ndg == null) {
+            timer.setPaused(true);
+            perf.frame_hook = null;
+            done_event.set();
+        }
+        return;
+    }
+    if (!current.demo_ended) {
+        return;
+    }
+    current.demo_ended = false;
+    endScene("lvgl");
+    nm_lvbench_close_scene();
+    current.demo += 1;
+    if (!startDemoScene()) {
+        main_screen.load();
+        demo_screen.destroy();
+        startNdgScene(.tab_switch) catch |err| logger.err("tab_switch: {any}", .{err});
+    }
+}
+
+fn demoSceneEnded() callconv(.C) void {
+    current.demo_ended = true;
+}
+
+fn onFrame(render: u64, flush: u64, px: u32) void {
+    stats.frames += 1;
+    stats.render_sum += render;
+    stats.render_max = @max(stats.render_max, render);
+    stats.flush_sum += flush;
+    stats.px_sum += px;
+    stats.renders.append(std.math.lossyCast(u32, render)) catch {};
+}
+
+/// returns false past the last LVGL demo scene.
+fn startDemoScene() bool {
+    var name: [*:0]const u8 = undefined;
+    if (nm_lvbench_run_scene(current.demo, &name) != 0) {
+        return false;
+    }
+    beginScene(std.mem.span(name));
+    return true;
+}
+
+fn startNdgScene(sc: Scene) !void {
+    current.ndg = sc;
+    beginScene(@tagName(sc));
+    switch (sc) {
+        .tab_switch => nm_ui_show_tab(0),
+        .channel_scroll => {
+            nm_ui_show_tab(lightning_tab); // builds the panel
+            const report = try channelsReport(arena_state.allocator());
+            try lightning.updateTabPanel(.{ .lightning_report = report });
+            current.scroll_down = true;
+        },
+        .keyboard_popup => {
+            nm_ui_show_tab(settings_tab);
+            const panel = nm_ui_tab_panel(settings_tab) orelse return error.NoTabPanel;
+            current.input = try lvgl.TextArea.new(lvgl.Container{ .lvobj = panel }, .{});
+        },
+    }
+}
+
+/// advances the ndg scene sc by a frame, and to the next scene after scene_ms.
+fn stepNdgScene(sc: Scene) !void {
+    const now = perf.now();
+    if (now - current.start >= scene_ms * std.time.us_per_ms) {
+        endScene("ndg");
+        if (sc == .keyboard_popup) {
+            widget.keyboardOff();
+            if (current.input) |ta| ta.destroy();
+            current.input = null;
+        }
+        current.ndg = null;
+        const next = @intFromEnum(sc) + 1;
+        if (next < std.meta.fields(Scene).len) {
+            try startNdgScene(@enumFromInt(next));
+        }
+        return;
+    }
+    const switching = now - current.last_step >= switch_ms * std.time.us_per_ms;
+    switch (sc) {
+        .tab_switch => if (switching) {
+            current.last_step = now;
+            current.step += 1;
+            nm_ui_show_tab(@intCast(current.step % ntabs));
+        },
+        .channel_scroll => {
+            const lvobj = nm_ui_tab_panel(lightning_tab) orelse return error.NoTabPanel;
+            const panel = lvgl.Container{ .lvobj = lvobj };
+            const room = panel.scrollRoom();
+            if (current.scroll_down and room.bottom <= 0) {
+                current.scroll_down = false;
+            } else if (!current.scroll_down and room.top <= 0) {
+                current.scroll_down = true;
+            }
+            if (current.scroll_down) {
+                const dy: lvgl.Coord = @min(scroll_step, room.bottom);
+                panel.scrollBy(-dy);
+            } else {
+                const dy: lvgl.Coord = @min(scroll_step, room.top);
+                panel.scrollBy(dy);
+            }
+        },
+        .keyboard_popup => if (switching) {
+            current.last_step = now;
+            current.step += 1;
+            if (current.step % 2 == 1) {
+                widget.keyboardOn(current.input.?);
+            } else {
+                widget.keyboardOff();
+            }
+        },
+    }
+}
+
+fn beginScene(name: []const u8) void {
+    const n = @min(name.len, current.name.len);
+    @memcpy(current.name[0..n], name[0..n]);
+    current.name_len = n;
+    current.start = perf.now();
+    current.last_step = current.start;
+    current.step = 0;
+    stats = .{};
+}
+
+fn endScene(suite: []const u8) void {
+    const ms = (perf.now() - current.start) / std.time.us_per_ms;
+    const frames = @max(stats.frames, 1); // avoid division by zero
+    const renders = stats.renders.slice();
+    std.mem.sort(u32, renders, {}, std.sort.asc(u32));
+    emit(Result{
+        .suite = suite,
+        .scene = current.name[0..current.name_len],
+        .ms = ms,
+        .frames = stats.frames,
+        .fps = @as(u64, stats.frames) * std.time.ms_per_s / @max(ms, 1),
+        .render = .{
+            .avg = stats.render_sum / frames,
+            .p50 = percentile(renders, 50),
+            .p99 = percentile(renders, 99),
+            .max = stats.render_max,
+        },
+        .flush_avg = stats.flush_sum / frames,
+        .px_avg = stats.px_sum / frames,
+    }) catch |err| logger.err("emit: {any}", .{err});
+}
+
+/// returns the p-th percentile of sorted values; 0 if empty.
+fn percentile(sorted: []const u32, p: usize) u32 {
+    if (sorted.len == 0) {
+        return 0;
+    }
+    return sorted[(sorted.len - 1) * p / 100];
+}
+
+fn emit(v: anytype) !void {
+    const w = std.io.getStdOut().writer();
+    try std.json.stringify(v, .{}, w);
+    try w.writeByte('\n');
+}
+
+/// makes up a report of nchannels channels for the channel_scroll scene.
+fn channelsReport(arena: std.mem.Allocator) !comm.Message.LightningReport {
+    const channels = try arena.alloc(comm.Message.LightningChannel, nchannels);
+    var local: i64 = 0;
+    var remote: i64 = 0;
+    for (channels, 0..) |*ch, i| {
+        var txid = [_]u8{0} ** 32;
+        std.mem.writeInt(u32, txid[0..4], @intCast(i), .big);
+        var pubkey = [_]u8{0x02} ** 33;
+        @memcpy(pubkey[1..], &txid);
+        const capacity: i64 = 1_000_000;
+        const bal: i64 = @intCast(i * 7919 % 1_000_000);
+        ch.* = .{
+            .id = try std.fmt.allocPrint(arena, "{d}", .{848352385882718209 + i}),
+            .state = if (i % 5 == 0) .inactive else .active,
+            .private = i % 3 == 0,
+            .point = .{ .txid = .{ .bytes = txid }, .index = @intCast(i % 2) },
+            .peer_pubkey = .{ .bytes = pubkey },
+            .peer_alias = try std.fmt.allocPrint(arena, "lvbench peer {d}", .{i}),
+            .capacity = capacity,
+            .balance = .{ .local = bal, .remote = capacity - bal, .unsettled = 0, .limbo = 0 },
+            .totalsats = .{ .sent = @intCast(i * 1000), .received = @intCast(i * 2000) },
+            .fees = .{ .base = 1000, .ppm = 400 },
+        };
+        local += bal;
+        remote += capacity - bal;
+    }
+    return .{
+        .version = "lvbench",
+        .pubkey = .{ .bytes = [_]u8{0x03} ** 33 },
+        .alias = "lvbench",
+        .npeers = nchannels,
+        .height = 800000,
+        .hash = .{ .bytes = [_]u8{0} ** 32 },
+        .sync = .{ .chain = true, .graph = true },
+        .uris = &.{},
+        .totalbalance = .{ .local = local, .remote = remote, .unsettled = 0, .pending = 0 },
+        .totalfees = .{ .day = 0, .week = 0, .month = 0 },
+        .channels = channels,
+    };
+}
@@ -10,10 +10,15 @@
 //! the module usage must be started with a call to init.
 
 const std = @import("std");
+const builtin = @import("builtin");
 const c = @cImport({
     @cInclude("lvgl/lvgl.h");
 });
 
+/// LVGL memory allocator, wired in lv_conf.h.
+pub const mem = @import("lvmem.zig");
+const xfmt = @import("../xfmt.zig");
+
 // logs LV_LOG_xxx messages from LVGL lib.
 const logger = std.log.scoped(.lvgl);
 
@@ -38,6 +43,39 @@ export fn nm_lvgl_log(msg: [*:0]const u8) void {
     logger.info("{s}", .{std.mem.trimRight(u8, s, "\n")});
 }
 
+/// LVGL cache hit and miss counters, updated only when built with -Dlvgl_cache_stats.
+/// see ui/c/lv_cache_stats.h.
+pub const CacheStats = extern struct {
+    img_hit: u32 = 0,
+    img_miss: u32 = 0,
+    grad_hit: u32 = 0,
+    grad_miss: u32 = 0,
+    circle_hit: u32 = 0,
+    circle_miss: u32 = 0,
+    style_hit: u32 = 0,
+    style_miss: u32 = 0,
+    txt_hit: u32 = 0,
+    txt_miss: u32 = 0,
+
+    /// returns hits percentage of all lookups, or null if there were none.
+    pub fn hitRate(hit: u32, miss: u32) ?u8 {
+        const total = @as(u64, hit) + miss;
+        if (total == 0) {
+            return null;
+        }
+        return @intCast(@as(u64, hit) * 100 / total);
+    }
+};
+
+/// incremented by LVGL from the UI thread.
+export var nm_lvgl_cache_stats: CacheStats = .{};
+
+/// returns a snapshot of the cache counters.
+/// must be called from the thread running loopCycle.
+pub fn cacheStats() CacheStats {
+    return nm_lvgl_cache_stats;
+}
+
 /// the busy-wait loop cycle wrapper for LVGL.
 /// a program main loop must call this periodically.
 /// returns the period after which it is to be called again, in ms.
@@ -59,11 +97,31 @@ pub const LvTimer = opaque {
         lv_timer_del(self);
     }
 
+    /// changes the period, effective from the last run. may be called from
+    /// the timer callback to schedule the next run.
+    pub fn setPeriod(self: *LvTimer, period_ms: u32) void {
+        lv_timer_set_period(self, period_ms);
+    }
+
     /// after the repeat count is reached, the timer is destroy'ed automatically.
     /// to run the timer indefinitely, use -1 for repeat count.
     pub fn setRepeatCount(self: *LvTimer, n: i32) void {
         lv_timer_set_repeat_count(self, n);
     }
+
+    /// a paused timer is skipped by loopCycle until resumed.
+    pub fn setPaused(self: *LvTimer, paused: bool) void {
+        if (paused) {
+            lv_timer_pause(self);
+        } else {
+            lv_timer_resume(self);
+        }
+    }
+
+    /// makes the timer run on the next loopCycle.
+    pub fn ready(self: *LvTimer) void {
+        lv_timer_ready(self);
+    }
 };
 
 /// represents lv_indev_t in C, an input device such as touchscreen or a keyboard.
@@ -79,6 +137,11 @@ pub const LvIndev = opaque {
     pub fn destroy(self: *LvIndev) void {
         lv_indev_delete(self);
     }
+
+    /// returns the timer polling the device driver for input data.
+    pub fn readTimer(self: *LvIndev) ?*LvTimer {
+        return lv_indev_get_read_timer(self);
+    }
 };
 
 /// represents lv_event_t in C, required by all event callbacks.
@@ -166,6 +229,41 @@ pub const LvEvent = opaque {
     pub fn stopBubbling(self: *LvEvent) void {
         lv_event_stop_bubbling(self);
     }
+
+    /// returns the draw context of a drawing event such as Code.draw_main.
+    pub fn drawCtx(self: *LvEvent) *DrawCtx {
+        return lv_event_get_draw_ctx(self);
+    }
+};
+
+/// a rectangle with inclusive coordinates, equivalent to lv_area_t.
+pub const Area = c.lv_area_t;
+
+/// represents lv_draw_ctx_t in C: the target of custom drawing in drawing
+/// event callbacks, clipped to the screen area being redrawn.
+pub const DrawCtx = opaque {
+    pub const RectOpt = struct {
+        muted: bool = false, // 30% opacity
+        radius: Coord = 0,
+    };
+
+    /// fills the area with a solid color.
+    pub fn fillRect(self: *DrawCtx, area: Area, color: Color, opt: RectOpt) void {
+        const opa: u8 = if (opt.muted) c.LV_OPA_30 else c.LV_OPA_COVER;
+        nm_draw_fill_rect(self, &area, color, opa, opt.radius);
+    }
+
+    /// draws text within the area in the font and color of obj main part.
+    /// recolor enables color marks in the text, same as Label.Opt.recolor.
+    pub fn text(self: *DrawCtx, obj: *LvObj, area: Area, txt: [*:0]const u8, recolor: bool) void {
+        nm_draw_text(self, obj, &area, txt, recolor);
+    }
+
+    /// returns the height of a text line in the font of obj main part,
+    /// including line spacing.
+    pub fn lineHeight(obj: *LvObj) Coord {
+        return nm_draw_line_height(obj);
+    }
 };
 
 /// represents lv_disp_t in C.
@@ -183,11 +281,26 @@ pub const LvDisp = opaque {
     }
 };
 
+/// default display refresh period as in lv_conf.h, in ms.
+pub const default_refresh_ms: u32 = c.LV_DISP_DEF_REFR_PERIOD;
+
+/// sets the default display refresh period, which caps the frame rate.
+pub fn setRefreshPeriod(ms: u32) void {
+    const t = _lv_disp_get_refr_timer(null) orelse return;
+    t.setPeriod(ms);
+}
+
 /// forces redraw of dirty areas.
 pub fn redraw() void {
     lv_refr_now(null);
 }
 
+/// drops all decoded images from the image cache; they are decoded again
+/// when next drawn.
+pub fn dropImageCache() void {
+    lv_img_cache_invalidate_src(null);
+}
+
 /// resets user incativity time, as if a UI interaction happened "now".
 pub fn resetIdle() void {
     lv_disp_trig_activity(null);
@@ -199,6 +312,245 @@ pub fn idleTime() u32 {
     return lv_disp_get_inactive_time(null);
 }
 
+/// returns the number of currently running animations.
+pub fn runningAnimations() u16 {
+    return lv_anim_count_running();
+}
+
+/// returns the number of objects on the active screen and the top and system
+/// layers of the default display, the screen and layers included.
+pub fn objectCount() u32 {
+    var n: u32 = 0;
+    const roots = [_]?*LvObj{ lv_disp_get_scr_act(null), lv_disp_get_layer_top(null), lv_disp_get_layer_sys(null) };
+    for (roots) |root| {
+        if (root) |o| {
+            lv_obj_tree_walk(o, countObject, &n);
+        }
+    }
+    return n;
+}
+
+fn countObject(_: *LvObj, userdata: ?*anyopaque) callconv(.C) c.lv_obj_tree_walk_res_t {
+    const n: *u32 = @ptrCast(@alignCast(userdata));
+    n.* += 1;
+    return c.LV_OBJ_TREE_WALK_NEXT;
+}
+
+/// object tree figures, as counted by census.
+pub const Census = struct {
+    total: Tally = .{},
+    /// objects per class, most first. objects of classes unknown to the
+    /// census are counted under "other".
+    classes: std.BoundedArray(ClassCount, max_census_classes) = .{},
+    /// direct children of the screen and layers with the most objects,
+    /// each with its own children, most first.
+    subtrees: std.BoundedArray(Subtree, max_census_subtrees) = .{},
+
+    pub const Tally = struct {
+        objects: u32 = 0,
+        styles: u32 = 0, // styles added to objects; a shared style counts once per object
+        label_bytes: u64 = 0, // label texts owned by the labels, static ones excluded
+    };
+
+    pub const ClassCount = struct {
+        name: []const u8,
+        count: u32,
+    };
+
+    pub const Root = enum { screen, top, sys };
+
+    pub const Subtree = struct {
+        root: Root,
+        index: u32, // child index in the root
+        class: []const u8, // of the subtree top object
+        tally: Tally,
+    };
+
+    fn add(self: *Census, obj: *LvObj, t: *Tally) void {
+        t.objects += 1;
+        t.styles += nm_obj_style_count(obj);
+        t.label_bytes += nm_obj_label_text_size(obj);
+        const name = if (nm_obj_class_name(obj)) |s| std.mem.span(s) else "other";
+        for (self.classes.slice()) |*cc| {
+            if (std.mem.eql(u8, cc.name, name)) {
+                cc.count += 1;
+                return;
+            }
+        }
+        // the class names table in ui.c is shorter than max_census_classes.
+        self.classes.append(.{ .name = name, .count = 1 }) catch {};
+    }
+
+    /// keeps s if it is among the largest subtrees so far.
+    fn keep(self: *Census, s: Subtree) void {
+        if (self.subtrees.len < max_census_subtrees) {
+            self.subtrees.appendAssumeCapacity(s);
+            return;
+        }
+        var min: usize = 0;
+        for (self.subtrees.constSlice(), 0..) |x, i| {
+            if (x.tally.objects < self.subtrees.get(min).tally.objects) {
+                min = i;
+            }
+        }
+        if (s.tally.objects > self.subtrees.get(min).tally.objects) {
+            self.subtrees.set(min, s);
+        }
+    }
+};
+
+pub const max_census_classes = 32;
+pub const max_census_subtrees = 16;
+
+/// walks the active screen and the top and system layers of the default
+/// display, counting objects by class, styles and label text bytes, overall
+/// and per subtree. the walk visits every object: meant for on-demand
+/// diagnostics rather than every frame.
+/// must be called from the thread running loopCycle.
+pub fn census() Census {
+    var res = Census{};
+    const roots = [_]struct { Census.Root, ?*LvObj }{
+        .{ .screen, lv_disp_get_scr_act(null) },
+        .{ .top, lv_disp_get_layer_top(null) },
+        .{ .sys, lv_disp_get_layer_sys(null) },
+    };
+    for (roots) |r| {
+        const root = r[1] orelse continue;
+        res.add(root, &res.total);
+        var i: u32 = 0;
+        while (lv_obj_get_child(root, @intCast(i))) |child| : (i += 1) {
+            var walk = CensusWalk{ .census = &res };
+            lv_obj_tree_walk(child, censusObject, &walk);
+            res.total.objects += walk.tally.objects;
+            res.total.styles += walk.tally.styles;
+            res.total.label_bytes += walk.tally.label_bytes;
+            res.keep(.{
+                .root = r[0],
+                .index = i,
+                .class = if (nm_obj_class_name(child)) |s| std.mem.span(s) else "other",
+                .tally = walk.tally,
+            });
+        }
+    }
+    const byCount = struct {
+        fn classes(_: void, a: Census.ClassCount, b: Census.ClassCount) bool {
+            return a.count > b.count;
+        }
+        fn subtrees(_: void, a: Census.Subtree, b: Census.Subtree) bool {
+            return a.tally.objects > b.tally.objects;
+        }
+    };
+    std.mem.sort(Census.ClassCount, res.classes.slice(), {}, byCount.classes);
+    std.mem.sort(Census.Subtree, res.subtrees.slice(), {}, byCount.subtrees);
+    return res;
+}
+
+const CensusWalk = struct {
+    census: *Census,
+    tally: Census.Tally = .{},
+};
+
+fn censusObject(obj: *LvObj, userdata: ?*anyopaque) callconv(.C) c.lv_obj_tree_walk_res_t {
+    const walk: *CensusWalk = @ptrCast(@alignCast(userdata));
+    walk.census.add(obj, &walk.tally);
+    return c.LV_OBJ_TREE_WALK_NEXT;
+}
+
+/// events delivered to EventCode.all handlers, in debug builds only.
+var catchall_events: u32 = 0;
+
+/// returns the number of calls made to EventCode.all handlers since start,
+/// wrapping around; always 0 in non-debug builds.
+/// must be called from the thread running loopCycle.
+pub fn catchAllEvents() u32 {
+    return catchall_events;
+}
+
+fn countCatchAll(_: *LvEvent) callconv(.C) void {
+    catchall_events +%= 1;
+}
+
+/// a hidden object on the system layer holding objects pending deletion by
+/// destroyDeferred; created on first use.
+var reap_bin: ?*LvObj = null;
+
+/// loop cycle time budget of reapDeferred in the UI thread, in ns.
+pub const reap_budget_ns = 2 * std.time.ns_per_ms;
+
+/// hides obj and moves it to the reap bin; deletes it right away if the bin
+/// can't be created.
+fn deleteDeferred(obj: *LvObj) void {
+    const bin = reap_bin orelse blk: {
+        const o = lv_obj_create(lv_disp_get_layer_sys(null)) orelse {
+            lv_obj_del(obj);
+            return;
+        };
+        lv_obj_add_flag(o, c.LV_OBJ_FLAG_HIDDEN);
+        reap_bin = o;
+        break :blk o;
+    };
+    // invalidates the area and the parent layout while still visible.
+    lv_obj_add_flag(obj, c.LV_OBJ_FLAG_HIDDEN);
+    lv_obj_set_parent(obj, bin);
+}
+
+/// deletes objects pending from destroyDeferred in small batches until none
+/// are left or the time budget runs out, and reports whether any remain.
+/// children of plain objects such as containers go first, each widget with
+/// its own children at once.
+/// must be called from the thread running loopCycle.
+pub fn reapDeferred(budget_ns: u64) bool {
+    const bin = reap_bin orelse return false;
+    var timer = std.time.Timer.start() catch null;
+    while (lv_obj_get_child(bin, -1)) |top| {
+        var obj = top;
+        while (nm_obj_is_plain(obj)) {
+            obj = lv_obj_get_child(obj, -1) orelse break;
+        }
+        lv_obj_del(obj);
+        if (timer) |*t| {
+            if (t.read() >= budget_ns) {
+                break;
+            }
+        }
+    }
+    return lv_obj_get_child_cnt(bin) > 0;
+}
+
+/// a bulk update of an object subtree, started with `beginBulkUpdate`.
+/// while active, creating, deleting and restyling widgets on the display
+/// doesn't invalidate screen areas one widget at a time.
+pub const BulkUpdate = struct {
+    root: *LvObj,
+    disp: *LvDisp,
+
+    /// resumes invalidation, then recalculates the root layout in a single pass
+    /// and invalidates the root area once. nested bulk updates must be
+    /// within the outer root, since only the outermost end invalidates.
+    pub fn end(self: BulkUpdate) void {
+        lv_disp_enable_invalidation(self.disp, true);
+        lv_obj_update_layout(self.root);
+        lv_obj_invalidate(self.root);
+    }
+};
+
+/// starts a bulk update of root and its descendants. typical use is
+///
+///     const bulk = lvgl.beginBulkUpdate(cont);
+///     defer bulk.end();
+///     cont.deleteChildren();
+///     // create new children ...
+///
+/// LVGL already defers layout to the next refresh; code in between which
+/// needs up-to-date coordinates may still call `recalculateLayout`.
+pub fn beginBulkUpdate(root: anytype) BulkUpdate {
+    // the current area, in case the subtree shrinks.
+    lv_obj_invalidate(root.lvobj);
+    const disp = lv_obj_get_disp(root.lvobj);
+    lv_disp_enable_invalidation(disp, false);
+    return .{ .root = root.lvobj, .disp = disp };
+}
+
 /// represents lv_style_t in C.
 pub const LvStyle = opaque {
     /// indicates which parts and in which states to apply a style to an object.
@@ -213,9 +565,108 @@ pub const LvStyle = opaque {
     };
 };
 
+/// a style property and its value; see constStyle.
+pub const StyleProp = union(enum) {
+    bg_color: Color,
+    bg_opa: u8,
+    border_color: Color,
+    border_width: Coord,
+    radius: Coord,
+    text_color: Color,
+    text_opa: u8,
+    text_font: *const LvFont,
+
+    fn constProp(comptime self: StyleProp) ConstStyleProp {
+        return switch (self) {
+            .bg_color => |v| .{ .prop = c.LV_STYLE_BG_COLOR, .value = .{ .color = v } },
+            .bg_opa => |v| .{ .prop = c.LV_STYLE_BG_OPA, .value = .{ .num = v } },
+            .border_color => |v| .{ .prop = c.LV_STYLE_BORDER_COLOR, .value = .{ .color = v } },
+            .border_width => |v| .{ .prop = c.LV_STYLE_BORDER_WIDTH, .value = .{ .num = v } },
+            .radius => |v| .{ .prop = c.LV_STYLE_RADIUS, .value = .{ .num = v } },
+            .text_color => |v| .{ .prop = c.LV_STYLE_TEXT_COLOR, .value = .{ .color = v } },
+            .text_opa => |v| .{ .prop = c.LV_STYLE_TEXT_OPA, .value = .{ .num = v } },
+            .text_font => |v| .{ .prop = c.LV_STYLE_TEXT_FONT, .value = .{ .ptr = v } },
+        };
+    }
+};
+
+/// returns a style of props built at comptime: the style and its property
+/// table are in read-only memory, like LV_STYLE_CONST_INIT in C, and need
+/// no initialization or allocation at runtime.
+/// the style must never be modified with lv_style_set_xxx functions.
+pub fn constStyle(comptime props: []const StyleProp) *LvStyle {
+    const S = struct {
+        const table = blk: {
+            var t: [props.len]ConstStyleProp = undefined;
+            for (props, &t) |p, *cp| {
+                cp.* = p.constProp();
+            }
+            break :blk t;
+        };
+        const style = ConstStyle{ .const_props = &table, .prop_cnt = props.len };
+    };
+    // LVGL takes styles as mutable but only reads const ones, marked by prop1.
+    return @ptrCast(@constCast(&S.style));
+}
+
+/// lv_style_value_t in C.
+const StyleValue = extern union {
+    num: i32,
+    ptr: ?*const anyopaque,
+    color: Color,
+};
+
+/// lv_style_const_prop_t in C.
+const ConstStyleProp = extern struct {
+    prop: u16,
+    value: StyleValue,
+};
+
+/// lv_style_t in C as initialized by LV_STYLE_CONST_INIT.
+const ConstStyle = extern struct {
+    const_props: [*]const ConstStyleProp, // v_p union
+    prop1: u16 = c.LV_STYLE_PROP_ANY,
+    has_group: u8 = 0xff,
+    prop_cnt: u8,
+
+    comptime {
+        // the sentinel field is absent only without style asserts.
+        std.debug.assert(c.LV_USE_ASSERT_STYLE == 0);
+        std.debug.assert(@sizeOf(StyleValue) == @sizeOf(?*const anyopaque));
+    }
+};
+
 /// represents lv_font_t in C.
 pub const LvFont = opaque {};
 
+/// the large font of nm_font_large, for const styles; defined in ui.c.
+extern const nm_font_title: LvFont;
+
+/// a red button style. useful to attract particular attention
+/// to a potentially "dangerous" operation.
+const style_btn_red = constStyle(&.{.{ .bg_color = rgb(0xf4, 0x43, 0x36) }}); // Palette.red.main()
+/// a title style with a larger font.
+const style_title = constStyle(&.{.{ .text_font = &nm_font_title }});
+/// a style for secondary text, like input field labels.
+const style_text_muted = constStyle(&.{.{ .text_opa = c.LV_OPA_50 }});
+/// a style for captions of Caption values, in the color of "#bbbbbb " marks.
+const style_caption = constStyle(&.{.{ .text_color = rgb(0xbb, 0xbb, 0xbb) }});
+
+/// returns a red button style.
+pub export fn nm_style_btn_red() *LvStyle {
+    return style_btn_red;
+}
+
+/// returns a title style with a larger font.
+pub export fn nm_style_title() *LvStyle {
+    return style_title;
+}
+
+/// returns a muted text style.
+export fn nm_style_text_muted() *LvStyle {
+    return style_text_muted;
+}
+
 /// a simplified color type compatible with LVGL which defines lv_color_t
 /// as a union containing an bit-fields struct unsupported in zig cImport.
 pub const Color = u16; // originally c.lv_color_t; TODO: comptime switch for u32
@@ -327,11 +778,30 @@ pub const BaseObjMethods = struct {
         lv_obj_del(self.lvobj);
     }
 
+    /// moves the object above its siblings.
+    pub fn moveForeground(self: anytype) void {
+        lv_obj_move_to_index(self.lvobj, -1);
+    }
+
     /// deallocates all resources used by the object's children.
     pub fn deleteChildren(self: anytype) void {
         lv_obj_clean(self.lvobj);
     }
 
+    /// like destroy but only hides the object right away, leaving the
+    /// deletion to reapDeferred over the next loop cycles. the object must
+    /// not be used afterwards.
+    pub fn destroyDeferred(self: anytype) void {
+        deleteDeferred(self.lvobj);
+    }
+
+    /// like deleteChildren with the deletion deferred; see destroyDeferred.
+    pub fn deleteChildrenDeferred(self: anytype) void {
+        while (lv_obj_get_child(self.lvobj, 0)) |child| {
+            deleteDeferred(child);
+        }
+    }
+
     /// sets or clears an object flag.
     pub fn setFlag(self: anytype, v: LvObj.Flag) void {
         lv_obj_add_flag(self.lvobj, @intFromEnum(v));
@@ -346,6 +816,17 @@ pub const BaseObjMethods = struct {
         return lv_obj_has_flag(self.lvobj, @intFromEnum(v));
     }
 
+    /// scrolls the object content vertically by dy pixels without animation:
+    /// a negative dy moves it up to reveal what's below.
+    pub fn scrollBy(self: anytype, dy: Coord) void {
+        lv_obj_scroll_by(self.lvobj, 0, dy, c.LV_ANIM_OFF);
+    }
+
+    /// returns how far the content can scroll to reveal what's above and below.
+    pub fn scrollRoom(self: anytype) struct { top: Coord, bottom: Coord } {
+        return .{ .top = lv_obj_get_scroll_top(self.lvobj), .bottom = lv_obj_get_scroll_bottom(self.lvobj) };
+    }
+
     /// returns a user data pointer associated with the object.
     pub fn userdata(self: anytype) ?*anyopaque {
         return nm_obj_userdata(self.lvobj);
@@ -357,6 +838,23 @@ pub const BaseObjMethods = struct {
         nm_obj_set_userdata(self.lvobj, data);
     }
 
+    /// returns the object area without its padding and border, in screen coordinates.
+    pub fn contentCoords(self: anytype) Area {
+        var area: Area = undefined;
+        lv_obj_get_content_coords(self.lvobj, &area);
+        return area;
+    }
+
+    /// marks the object to be redrawn in the next refresh.
+    pub fn invalidate(self: anytype) void {
+        lv_obj_invalidate(self.lvobj);
+    }
+
+    /// returns the primary color of the theme applied to the object.
+    pub fn themePrimary(self: anytype) Color {
+        return lv_theme_get_color_primary(self.lvobj);
+    }
+
     /// updates layout of all children so that functions like `WidgetMethods.contentWidth`
     /// return correct results, when done in a single LVGL loop iteration.
     pub fn recalculateLayout(self: anytype) void {
@@ -367,9 +865,23 @@ pub const BaseObjMethods = struct {
     /// to make cb called on any event, use EventCode.all filter.
     /// multiple event handlers are called in the same order as they were added.
     /// the user data pointer udata is available in a handler using LvEvent.userdata fn.
+    ///
+    /// an EventCode.all handler is also called on each draw, style and scroll
+    /// event: prefer onEach. debug builds count such calls; see catchAllEvents.
     pub fn on(self: anytype, filter: LvEvent.Code, cb: LvEvent.Callback, udata: ?*anyopaque) *LvEvent.Descriptor {
+        if (builtin.mode == .Debug and filter == .all) {
+            _ = lv_obj_add_event_cb(self.lvobj, countCatchAll, .all, null);
+        }
         return lv_obj_add_event_cb(self.lvobj, cb, filter, udata);
     }
+
+    /// like on with a handler per filter code, so that cb is called only
+    /// on the events of interest.
+    pub fn onEach(self: anytype, filters: []const LvEvent.Code, cb: LvEvent.Callback, udata: ?*anyopaque) void {
+        for (filters) |f| {
+            _ = lv_obj_add_event_cb(self.lvobj, cb, f, udata);
+        }
+    }
 };
 
 /// methods applicable to visible objects like labels, buttons and containers.
@@ -649,6 +1161,13 @@ pub const Window = struct {
     pub fn content(self: Window) Container {
         return .{ .lvobj = lv_win_get_content(self.lvobj) };
     }
+
+    /// replaces the title set in new.
+    pub fn setTitle(self: Window, title: [*:0]const u8) void {
+        if (lv_obj_get_child(lv_win_get_header(self.lvobj), 0)) |label| {
+            lv_label_set_text(label, title);
+        }
+    }
 };
 
 /// a custom element consisting of a flex container with a title-sized label
@@ -661,9 +1180,17 @@ pub const Card = struct {
     pub usingnamespace BaseObjMethods;
     pub usingnamespace WidgetMethods;
 
+    /// cards with scroll_snapshot take snapshots only while this is true.
+    /// the bitmaps take memory, which is better left to the node under load.
+    pub var scroll_snapshots = true;
+
     pub const Opt = struct {
         /// embeds a spinner in the top-right corner; control with spin fn.
         spinner: bool = false,
+        /// draws the card from a snapshot bitmap while the parent scrolls;
+        /// see snapshot fn. for cards with no animations or interactive
+        /// elements: those freeze until the scroll ends.
+        scroll_snapshot: bool = false,
     };
 
     pub fn new(parent: anytype, title: [*:0]const u8, opt: Opt) !Card {
@@ -686,9 +1213,85 @@ pub const Card = struct {
         }
         card.title.addStyle(nm_style_title(), .{});
 
+        if (opt.scroll_snapshot) {
+            _ = lv_obj_add_event_cb(parent.lvobj, onParentScroll, .scroll_begin, flex.lvobj);
+            _ = lv_obj_add_event_cb(parent.lvobj, onParentScroll, .scroll_end, flex.lvobj);
+            _ = flex.on(.draw_main, onSnapshotDraw, null);
+            _ = flex.on(.child_changed, onSnapshotEvent, null);
+            _ = flex.on(.delete, onSnapshotEvent, null);
+        }
         return card;
     }
 
+    /// snapshot renders the card once into a bitmap and hides its children:
+    /// the card is then drawn with a single image blit per frame instead of
+    /// all the labels, borders and rounded corners, until thawed.
+    /// the bitmap is kept in the object user data. children changing size
+    /// or position thaw the card; it freezes again on the next scroll.
+    fn snapshot(obj: *LvObj) void {
+        if (!scroll_snapshots or nm_obj_userdata(obj) != null or lv_obj_has_flag(obj, c.LV_OBJ_FLAG_HIDDEN)) {
+            return;
+        }
+        lv_obj_update_layout(obj);
+        const img = lv_snapshot_take(obj, c.LV_IMG_CF_TRUE_COLOR_ALPHA) orelse {
+            logger.warn("card snapshot: out of memory", .{});
+            return;
+        };
+        // keep the size the children give the card while hidden.
+        lv_obj_set_height(obj, lv_obj_get_height(obj));
+        var i: u32 = 0;
+        while (i < lv_obj_get_child_cnt(obj)) : (i += 1) {
+            const child = lv_obj_get_child(obj, @intCast(i)) orelse continue;
+            if (!lv_obj_has_flag(child, c.LV_OBJ_FLAG_HIDDEN)) {
+                lv_obj_add_flag(child, c.LV_OBJ_FLAG_HIDDEN | c.LV_OBJ_FLAG_USER_1);
+            }
+        }
+        // set last so that child_changed events of the above are ignored.
+        nm_obj_set_userdata(obj, img);
+    }
+
+    /// restores the children hidden by snapshot and frees the bitmap.
+    fn thaw(obj: *LvObj) void {
+        const img: *c.lv_img_dsc_t = @ptrCast(nm_obj_userdata(obj) orelse return);
+        nm_obj_set_userdata(obj, null);
+        lv_snapshot_free(img);
+        var i: u32 = 0;
+        while (i < lv_obj_get_child_cnt(obj)) : (i += 1) {
+            const child = lv_obj_get_child(obj, @intCast(i)) orelse continue;
+            if (lv_obj_has_flag(child, c.LV_OBJ_FLAG_USER_1)) {
+                lv_obj_clear_flag(child, c.LV_OBJ_FLAG_HIDDEN | c.LV_OBJ_FLAG_USER_1);
+            }
+        }
+        lv_obj_set_height(obj, sizeContent);
+        lv_obj_invalidate(obj);
+    }
+
+    fn onParentScroll(e: *LvEvent) callconv(.C) void {
+        const obj: *LvObj = @ptrCast(e.userdata() orelse return);
+        switch (e.code()) {
+            .scroll_begin => snapshot(obj),
+            .scroll_end => thaw(obj),
+            else => {},
+        }
+    }
+
+    fn onSnapshotEvent(e: *LvEvent) callconv(.C) void {
+        const obj = lv_event_get_current_target(e);
+        if (e.code() == .delete) {
+            if (lv_obj_get_parent(obj)) |parent| {
+                _ = lv_obj_remove_event_cb_with_user_data(parent, onParentScroll, obj);
+            }
+        }
+        thaw(obj);
+    }
+
+    /// blits the snapshot, if any, on top of the card background.
+    fn onSnapshotDraw(e: *LvEvent) callconv(.C) void {
+        const obj = lv_event_get_current_target(e);
+        const img: *c.lv_img_dsc_t = @ptrCast(nm_obj_userdata(obj) orelse return);
+        nm_draw_snapshot(e.drawCtx(), obj, img);
+    }
+
     pub fn spin(self: Card, onoff: enum { on, off }) void {
         if (self.spinner) |p| switch (onoff) {
             .on => p.show(),
@@ -697,6 +1300,92 @@ pub const Card = struct {
     }
 };
 
+/// a custom element of a static caption on top of a value, same as a label
+/// "CAPTION\nvalue" with the caption color marked. the caption is set once,
+/// so that value updates neither parse color marks nor measure the caption.
+pub const Caption = struct {
+    lvobj: *LvObj, // column of both labels
+    value: Label,
+
+    pub usingnamespace BaseObjMethods;
+    pub usingnamespace WidgetMethods;
+
+    /// the caption text must outlive the element; typically a literal.
+    pub fn new(parent: anytype, caption: [*:0]const u8) !Caption {
+        const flex = try FlexLayout.new(parent, .column, .{ .width = sizeContent, .height = .content });
+        errdefer flex.destroy();
+        flex.clearFlag(.scrollable);
+        const cap = try Label.new(flex, null, .{});
+        cap.setTextStatic(caption);
+        cap.addStyle(style_caption, .{});
+        const value = try Label.new(flex, "", .{});
+        return .{ .lvobj = flex.lvobj, .value = value };
+    }
+
+    /// formats and sets the value text; see Label.setTextFmt.
+    pub fn setValueFmt(self: Caption, buf: []u8, comptime format: []const u8, args: anytype) !void {
+        try self.value.setTextFmt(buf, format, args);
+    }
+};
+
+/// a Caption whose value is an FmtLabel; see FmtLabel.
+pub fn FmtCaption(comptime format: []const u8, comptime Args: type) type {
+    return struct {
+        caption: Caption,
+        value: FmtLabel(format, Args),
+
+        const Self = @This();
+
+        /// creates the element in place; self must not move afterwards.
+        /// the caption text must outlive the element; typically a literal.
+        pub fn init(self: *Self, parent: anytype, caption: [*:0]const u8) !void {
+            self.caption = try Caption.new(parent, caption);
+            self.value.attach(self.caption.value);
+        }
+
+        /// formats and sets the value text; see FmtLabel.set.
+        pub fn set(self: *Self, args: Args) !void {
+            try self.value.set(args);
+        }
+    };
+}
+
+/// a label owning a fixed buffer its text is formatted into, sized for the
+/// longest text of the format with Args; see xfmt.Template. LVGL references
+/// the buffer instead of a heap copy of the text: an update makes no
+/// allocations.
+pub fn FmtLabel(comptime format: []const u8, comptime Args: type) type {
+    return struct {
+        label: Label,
+        buf: [max_len + 1]u8, // null-terminated
+
+        const Self = @This();
+        const Template = xfmt.Template(format, Args);
+        pub const max_len = Template.max_len;
+
+        /// makes the label show the buffer, initially empty: its previous
+        /// text is freed. self must not move afterwards.
+        pub fn attach(self: *Self, label: Label) void {
+            self.label = label;
+            self.buf[0] = 0;
+            lv_label_set_text_static(label.lvobj, @ptrCast(&self.buf));
+        }
+
+        /// formats the text into the buffer; no-op if unchanged.
+        /// LVGL re-measures and invalidates the label on change.
+        pub fn set(self: *Self, args: Args) !void {
+            var tmp: [max_len]u8 = undefined;
+            const s = Template.print(&tmp, args);
+            if (std.mem.eql(u8, s, std.mem.sliceTo(&self.buf, 0))) {
+                return;
+            }
+            @memcpy(self.buf[0..s.len], s);
+            self.buf[s.len] = 0;
+            lv_label_set_text_static(self.label.lvobj, @ptrCast(&self.buf));
+        }
+    };
+}
+
 /// represents lv_label_t in C, a text label.
 pub const Label = struct {
     lvobj: *LvObj,
@@ -745,12 +1434,27 @@ pub const Label = struct {
 
     /// sets label text to a new value.
     /// previous value is dealloc'ed.
+    /// no-op if the text is unchanged, to avoid a text re-layout and redraw.
     pub fn setText(self: Label, text: [:0]const u8) void {
+        if (self.hasText(text)) {
+            return;
+        }
         lv_label_set_text(self.lvobj, text.ptr);
     }
 
+    /// reports whether the label currently shows exactly the text.
+    /// LVGL already retains the text, so there's no need for a separate cache.
+    fn hasText(self: Label, text: []const u8) bool {
+        const curr = lv_label_get_text(self.lvobj) orelse return false;
+        return std.mem.eql(u8, std.mem.span(curr), text);
+    }
+
     /// sets label text without heap alloc but assumes text outlives the label obj.
+    /// no-op if the text is unchanged.
     pub fn setTextStatic(self: Label, text: [*:0]const u8) void {
+        if (self.hasText(std.mem.span(text))) {
+            return;
+        }
         lv_label_set_text_static(self.lvobj, text);
     }
 
@@ -761,6 +1465,11 @@ pub const Label = struct {
         self.setText(s);
     }
 
+    /// enables or disables inline text recoloring with "#rrggbb text#" marks.
+    pub fn setRecolor(self: Label, enable: bool) void {
+        lv_label_set_recolor(self.lvobj, enable);
+    }
+
     /// sets label text color.
     pub fn setColor(self: Label, v: Color, sel: LvStyle.Selector) void {
         lv_obj_set_style_text_color(self.lvobj, v, sel.value());
@@ -794,6 +1503,8 @@ pub const TextArea = struct {
         oneline: bool = true,
         password_mode: bool = false,
         maxlen: ?u32 = null,
+        /// shown while empty; copied by LVGL.
+        placeholder: ?[*:0]const u8 = null,
     };
 
     pub fn new(parent: anytype, opt: Opt) !TextArea {
@@ -809,6 +1520,9 @@ pub const TextArea = struct {
         if (opt.maxlen) |n| {
             lv_textarea_set_max_length(self.lvobj, n);
         }
+        if (opt.placeholder) |s| {
+            lv_textarea_set_placeholder_text(self.lvobj, s);
+        }
     }
 
     /// `text` arg is heap-duplicated by LVGL's alloc and owned by this text area object.
@@ -831,11 +1545,10 @@ pub const Spinner = struct {
     pub usingnamespace BaseObjMethods;
     pub usingnamespace WidgetMethods;
 
+    /// creates a 20x20 spinner. it looks like lv_spinner but plays pre-rendered
+    /// frames, which is a lot cheaper than drawing an arc on every refresh.
     pub fn new(parent: anytype) !Spinner {
-        const spin = lv_spinner_create(parent.lvobj, 1000, 60) orelse return error.OutOfMemory;
-        lv_obj_set_size(spin, 20, 20);
-        const ind: LvStyle.Selector = .{ .part = .indicator };
-        lv_obj_set_style_arc_width(spin, 4, ind.value());
+        const spin = nm_spinner_create(parent.lvobj) orelse return error.OutOfMemory;
         return .{ .lvobj = spin };
     }
 };
@@ -866,6 +1579,49 @@ pub const Bar = struct {
     }
 };
 
+/// represents lv_chart_t in C, configured as a line chart.
+/// see https://docs.lvgl.io/8.3/widgets/extra/chart.html for details.
+pub const Chart = struct {
+    lvobj: *LvObj,
+
+    pub usingnamespace BaseObjMethods;
+    pub usingnamespace WidgetMethods;
+
+    /// represents lv_chart_series_t in C; owned by the chart.
+    pub const Series = opaque {};
+
+    /// creates a line chart with npoints in each series, lines only: no point markers.
+    pub fn new(parent: anytype, npoints: u16) !Chart {
+        const o = lv_chart_create(parent.lvobj) orelse return error.OutOfMemory;
+        lv_chart_set_type(o, c.LV_CHART_TYPE_LINE);
+        lv_chart_set_point_count(o, npoints);
+        lv_chart_set_div_line_count(o, 3, 0);
+        const ind: LvStyle.Selector = .{ .part = .indicator };
+        lv_obj_set_style_width(o, 0, ind.value());
+        lv_obj_set_style_height(o, 0, ind.value());
+        return .{ .lvobj = o };
+    }
+
+    /// adds a new series of points drawn in the color.
+    pub fn addSeries(self: Chart, color: Color) !*Series {
+        return lv_chart_add_series(self.lvobj, color, c.LV_CHART_AXIS_PRIMARY_Y) orelse error.OutOfMemory;
+    }
+
+    /// sets y axis range; values outside of it are clipped.
+    pub fn setRange(self: Chart, min: Coord, max: Coord) void {
+        lv_chart_set_range(self.lvobj, c.LV_CHART_AXIS_PRIMARY_Y, min, max);
+    }
+
+    /// sets all point values of ser, oldest first, and redraws the chart once.
+    /// a null value leaves a gap in the line. values beyond the point count are ignored.
+    pub fn setPoints(self: Chart, ser: *Series, values: []const ?Coord) void {
+        for (values, 0..) |v, i| {
+            lv_chart_set_value_by_id(self.lvobj, ser, @intCast(i), v orelse std.math.maxInt(Coord));
+        }
+        lv_chart_refresh(self.lvobj);
+    }
+};
+
 pub const Dropdown = struct {
     lvobj: *LvObj,
 
@@ -938,13 +1694,14 @@ pub const Dropdown = struct {
 
 pub const QrCode = struct {
     lvobj: *LvObj,
+    size: Coord, // width and height in pixels
 
     pub usingnamespace BaseObjMethods;
     pub usingnamespace WidgetMethods;
 
     pub fn new(parent: anytype, size: Coord, data: ?[]const u8) !QrCode {
         const o = lv_qrcode_create(parent.lvobj, size, Black, White) orelse return error.OutOfMemory;
-        const q = QrCode{ .lvobj = o };
+        const q = QrCode{ .lvobj = o, .size = size };
         errdefer q.destroy();
         if (data) |d| {
             try q.setQrData(d);
@@ -962,6 +1719,33 @@ pub const QrCode = struct {
             return error.QrCodeSetData;
         }
     }
+
+    /// returns the currently rendered image, palette included, as stored in
+    /// the underlying 1 bit per pixel canvas. the memory is owned by the widget
+    /// and modified by the next setQrData call.
+    pub fn imageData(self: QrCode) []const u8 {
+        const img = lv_canvas_get_img(self.lvobj);
+        return img.data[0..imageDataLen(self.size)];
+    }
+
+    /// displays an image obtained from imageData of a QR code of the same size,
+    /// which is a lot cheaper than encoding and rendering the data again.
+    pub fn setImageData(self: QrCode, data: []const u8) !void {
+        if (data.len != imageDataLen(self.size)) {
+            return error.QrCodeImageSize;
+        }
+        const img = lv_canvas_get_img(self.lvobj);
+        @memcpy(img.data[0..data.len], data);
+        lv_img_cache_invalidate_src(img);
+        lv_obj_invalidate(self.lvobj);
+    }
+
+    /// the used part of an LV_CANVAS_BUF_SIZE_INDEXED_1BIT buffer: two 4 bytes
+    /// palette colors followed by rows of bits, each padded to a byte boundary.
+    fn imageDataLen(size: Coord) usize {
+        const n: usize = @intCast(size);
+        return 4 * 2 + ((n + 7) >> 3) * n;
+    }
 };
 
 pub const Keyboard = struct {
@@ -998,6 +1782,154 @@ pub const Keyboard = struct {
     }
 };
 
+/// a vertical list of fixed height rows which creates widgets only for the rows
+/// visible in the scroller viewport, plus overscan rows above and below.
+/// rows scrolled out of view are hidden and re-used for rows coming into view,
+/// so the number of widgets is independent of the list length.
+///
+/// Row must have an lvobj field and the following functions:
+///
+///     fn new(parent: Container) !Row // creates empty row widgets
+///     fn bind(self: *Row, index: usize) !void // shows item at index in the row
+///
+/// the list address must not change after init and the list must outlive
+/// the scroller: it is used as the scroll event handler user data.
+pub fn RecycledList(comptime Row: type) type {
+    return struct {
+        allocator: std.mem.Allocator,
+        cont: Container, // holds all rows
+        scroller: *LvObj, // scrollable ancestor of cont
+        opt: Opt,
+        /// number of items in the list.
+        len: usize = 0,
+        /// all created rows, either showing an item or hidden.
+        pool: std.ArrayListUnmanaged(Slot) = .{},
+
+        const Self = @This();
+
+        const Slot = struct {
+            row: Row,
+            index: ?usize, // item shown in the row; null if hidden
+        };
+
+        pub const Opt = struct {
+            row_height: Coord, // including the gap
+            gap: Coord = 0, // vertical space between rows
+            overscan: usize = 2, // rows to keep materialized above and below the viewport
+        };
+
+        /// creates the list container in parent. scroller is a scrollable ancestor
+        /// of parent which determines visible rows.
+        pub fn init(self: *Self, allocator: std.mem.Allocator, parent: anytype, scroller: anytype, opt: Opt) !void {
+            const cont = try Container.new(parent);
+            cont.removeBackgroundStyle();
+            cont.clearFlag(.scrollable);
+            cont.setWidth(sizePercent(100));
+            cont.setHeight(0);
+            self.* = .{ .allocator = allocator, .cont = cont, .scroller = scroller.lvobj, .opt = opt };
+            _ = scroller.on(.scroll, onScroll, self);
+        }
+
+        /// releases memory used by the list. widgets are destroyed together
+        /// with their parent.
+        pub fn deinit(self: *Self) void {
+            self.pool.deinit(self.allocator);
+        }
+
+        /// sets the number of items and re-binds all visible rows, since items
+        /// at any index may have changed.
+        pub fn update(self: *Self, len: usize) !void {
+            self.len = len;
+            const h = std.math.cast(Coord, len * @as(usize, @intCast(self.opt.row_height))) orelse return error.Overflow;
+            self.cont.setHeight(h);
+            for (self.pool.items) |*slot| {
+                slot.index = null;
+                lv_obj_add_flag(slot.row.lvobj, c.LV_OBJ_FLAG_HIDDEN);
+            }
+            self.cont.recalculateLayout();
+            try self.refresh();
+        }
+
+        /// materializes rows visible in the scroller viewport and hides the rest.
+        pub fn refresh(self: *Self) !void {
+            const vis = self.visibleRange();
+            for (self.pool.items) |*slot| {
+                const i = slot.index orelse continue;
+                if (i < vis.start or i >= vis.end) {
+                    slot.index = null;
+                    lv_obj_add_flag(slot.row.lvobj, c.LV_OBJ_FLAG_HIDDEN);
+                }
+            }
+            var i = vis.start;
+            while (i < vis.end) : (i += 1) {
+                if (self.isShown(i)) {
+                    continue;
+                }
+                const slot = try self.freeSlot();
+                slot.index = i;
+                lv_obj_set_y(slot.row.lvobj, @intCast(i * @as(usize, @intCast(self.opt.row_height))));
+                lv_obj_clear_flag(slot.row.lvobj, c.LV_OBJ_FLAG_HIDDEN);
+                slot.row.bind(i) catch |err| {
+                    slot.index = null;
+                    lv_obj_add_flag(slot.row.lvobj, c.LV_OBJ_FLAG_HIDDEN);
+                    return err;
+                };
+            }
+        }
+
+        /// returns item indices intersecting the scroller viewport, including overscan.
+        fn visibleRange(self: Self) struct { start: usize, end: usize } {
+            if (self.len == 0) {
+                return .{ .start = 0, .end = 0 };
+            }
+            var view: c.lv_area_t = undefined;
+            lv_obj_get_coords(self.scroller, &view);
+            var list: c.lv_area_t = undefined;
+            lv_obj_get_coords(self.cont.lvobj, &list);
+            const rh: i32 = self.opt.row_height;
+            // viewport top and bottom relative to the list top.
+            const top = @max(0, @as(i32, view.y1) - list.y1);
+            const bottom = @max(0, @as(i32, view.y2) - list.y1 + 1);
+            const first: usize = @intCast(@divFloor(top, rh));
+            const last: usize = @intCast(@divFloor(bottom + rh - 1, rh));
+            return .{
+                .start = @min(self.len, first -| self.opt.overscan),
+                .end = @min(self.len, last + self.opt.overscan),
+            };
+        }
+
+        fn isShown(self: Self, index: usize) bool {
+            for (self.pool.items) |slot| {
+                if (slot.index == index) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// returns a hidden row, creating a new one if none is available.
+        /// rows are never destroyed: the viewport height is constant, so the pool
+        /// stops growing once it covers the viewport and overscan.
+        fn freeSlot(self: *Self) !*Slot {
+            for (self.pool.items) |*slot| {
+                if (slot.index == null) {
+                    return slot;
+                }
+            }
+            try self.pool.ensureUnusedCapacity(self.allocator, 1);
+            const row = try Row.new(self.cont);
+            lv_obj_set_height(row.lvobj, self.opt.row_height - self.opt.gap);
+            self.pool.appendAssumeCapacity(.{ .row = row, .index = null });
+            return &self.pool.items[self.pool.items.len - 1];
+        }
+
+        fn onScroll(e: *LvEvent) callconv(.C) void {
+            const self: *Self = @ptrCast(@alignCast(e.userdata()));
+            self.refresh() catch |err| logger.err("RecycledList.refresh: {any}", .{err});
+        }
+    };
+}
+
 /// represents lv_obj_t type in C.
 pub const LvObj = opaque {
     /// feature-flags controlling object's behavior.
@@ -1089,7 +2021,7 @@ pub const sizeContent = LV_COORD_SET_SPEC(2001);
 //#else
 //#define _LV_COORD_TYPE_SHIFT    (13U)
 //#endif
-const _LV_COORD_TYPE_SHIFT = 13; // TODO: comptime switch between 13 and 29?
+const _LV_COORD_TYPE_SHIFT = if (c.LV_USE_LARGE_COORD != 0) 29 else 13;
 const _LV_COORD_TYPE_SPEC = 1 << _LV_COORD_TYPE_SHIFT;
 
 inline fn LV_COORD_SET_SPEC(x: Coord) Coord {
@@ -1127,16 +2059,16 @@ pub const PosAlign = enum(c.lv_align_t) {
 // imports from nakamochi custom C code that extends LVGL
 // ==========================================================================
 
-/// returns a red button style.
-pub extern fn nm_style_btn_red() *LvStyle; // TODO: make it private
-/// returns a title style with a larger font.
-pub extern fn nm_style_title() *LvStyle; // TODO: make it private
 /// returns default font of large size.
 pub extern fn nm_font_large() *const LvFont; // TODO: make it private
 
 // the "native" lv_obj_set/get user_data are static inline, so make our own funcs.
 extern "c" fn nm_obj_userdata(obj: *LvObj) ?*anyopaque;
 extern "c" fn nm_obj_set_userdata(obj: *LvObj, data: ?*const anyopaque) void;
+extern "c" fn nm_obj_is_plain(obj: *LvObj) bool;
+extern "c" fn nm_obj_class_name(obj: *const LvObj) ?[*:0]const u8;
+extern "c" fn nm_obj_style_count(obj: *const LvObj) u32;
+extern "c" fn nm_obj_label_text_size(obj: *const LvObj) usize;
 
 // ==========================================================================
 // imports from LVGL C code
@@ -1151,6 +2083,7 @@ extern fn lv_log_register_print_cb(*const fn (msg: [*:0]const u8) callconv(.C) v
 extern fn lv_indev_delete(indev: *LvIndev) void;
 /// return next device in the list or head if indev is null.
 extern fn lv_indev_get_next(indev: ?*LvIndev) ?*LvIndev;
+extern fn lv_indev_get_read_timer(indev: *LvIndev) ?*LvTimer;
 
 // timers -------------------------------------------------------------------
 
@@ -1160,6 +2093,10 @@ extern fn lv_timer_handler() u32;
 extern fn lv_timer_create(callback: LvTimer.Callback, period_ms: u32, userdata: ?*anyopaque) ?*LvTimer;
 extern fn lv_timer_del(timer: *LvTimer) void;
 extern fn lv_timer_set_repeat_count(timer: *LvTimer, n: i32) void;
+extern fn lv_timer_set_period(timer: *LvTimer, period: u32) void;
+extern fn lv_timer_pause(timer: *LvTimer) void;
+extern fn lv_timer_resume(timer: *LvTimer) void;
+extern fn lv_timer_ready(timer: *LvTimer) void;
 
 // events --------------------------------------------------------------------
 
@@ -1167,6 +2104,8 @@ extern fn lv_event_get_code(e: *LvEvent) LvEvent.Code;
 extern fn lv_event_get_current_target(e: *LvEvent) *LvObj;
 extern fn lv_event_get_target(e: *LvEvent) *LvObj;
 extern fn lv_event_get_user_data(e: *LvEvent) ?*anyopaque;
+extern fn lv_event_get_draw_ctx(e: *LvEvent) *DrawCtx;
+extern fn lv_obj_remove_event_cb_with_user_data(obj: *LvObj, cb: LvEvent.Callback, udata: ?*const anyopaque) bool;
 extern fn lv_event_stop_bubbling(e: *LvEvent) void;
 extern fn lv_obj_add_event_cb(obj: *LvObj, cb: LvEvent.Callback, filter: LvEvent.Code, userdata: ?*anyopaque) *LvEvent.Descriptor;
 
@@ -1175,7 +2114,9 @@ extern fn lv_obj_add_event_cb(obj: *LvObj, cb: LvEvent.Callback, filter: LvEvent
 /// returns pointer to the default display.
 extern fn lv_disp_get_default() *LvDisp;
 /// returns elapsed time since last user activity on a specific display or any if disp is null.
+extern fn _lv_disp_get_refr_timer(disp: ?*LvDisp) ?*LvTimer;
 extern fn lv_disp_get_inactive_time(disp: ?*LvDisp) u32;
+extern fn lv_anim_count_running() u16;
 /// makes it so as if a user activity happened.
 /// this resets an internal counter in lv_disp_get_inactive_time.
 extern fn lv_disp_trig_activity(disp: ?*LvDisp) void;
@@ -1191,15 +2132,20 @@ extern fn lv_disp_get_scr_act(disp: ?*LvDisp) ?*LvObj;
 /// returns the top layer on a given display or default if null.
 /// top layer is the same on every screen, above the normal screen layer.
 extern fn lv_disp_get_layer_top(disp: ?*LvDisp) *LvObj;
+/// returns the system layer on a given display or default if null.
+/// system layer is above the top layer, for example for a mouse cursor.
+extern fn lv_disp_get_layer_sys(disp: ?*LvDisp) *LvObj;
+/// calls cb on start and all its descendants, depth-first.
+extern fn lv_obj_tree_walk(start: *LvObj, cb: *const fn (*LvObj, ?*anyopaque) callconv(.C) c.lv_obj_tree_walk_res_t, userdata: ?*anyopaque) void;
 /// makes a screen active without animation.
 extern fn lv_disp_load_scr(scr: *LvObj) void;
+/// returns the display of an object's screen.
+extern fn lv_obj_get_disp(obj: *const LvObj) *LvDisp;
+/// disables or re-enables screen area invalidation on a display; calls nest.
+extern fn lv_disp_enable_invalidation(disp: ?*LvDisp, en: bool) void;
 
 // styling and colors --------------------------------------------------------
 
-/// initalizes a style struct. must be called only once per style.
-extern fn lv_style_init(style: *LvStyle) void;
-extern fn lv_style_set_bg_color(style: *LvStyle, color: Color) void;
-
 extern fn lv_obj_add_style(obj: *LvObj, style: *LvStyle, sel: c.lv_style_selector_t) void;
 extern fn lv_obj_remove_style(obj: *LvObj, style: ?*LvStyle, sel: c.lv_style_selector_t) void;
 extern fn lv_obj_remove_style_all(obj: *LvObj) void;
@@ -1212,7 +2158,8 @@ extern fn lv_obj_set_style_pad_top(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_sty
 extern fn lv_obj_set_style_pad_bottom(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_style_selector_t) void;
 extern fn lv_obj_set_style_pad_row(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_style_selector_t) void;
 extern fn lv_obj_set_style_pad_column(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_style_selector_t) void;
-extern fn lv_obj_set_style_arc_width(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_style_selector_t) void;
+extern fn lv_obj_set_style_height(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_style_selector_t) void;
+extern fn lv_obj_set_style_width(obj: *LvObj, val: c.lv_coord_t, sel: c.lv_style_selector_t) void;
 
 // TODO: port these to zig
 extern fn lv_palette_main(c.lv_palette_t) Color;
@@ -1227,6 +2174,11 @@ extern fn lv_obj_create(parent: ?*LvObj) ?*LvObj;
 extern fn lv_obj_del(obj: *LvObj) void;
 /// deletes children of the obj.
 extern fn lv_obj_clean(obj: *LvObj) void;
+extern fn lv_obj_get_parent(obj: *const LvObj) ?*LvObj;
+extern fn lv_obj_get_child(obj: *const LvObj, id: i32) ?*LvObj;
+extern fn lv_obj_get_child_cnt(obj: *const LvObj) u32;
+extern fn lv_obj_set_parent(obj: *LvObj, parent: *LvObj) void;
+extern fn lv_obj_move_to_index(obj: *LvObj, index: i32) void;
 /// recalculates an object layout based on all its children.
 pub extern fn lv_obj_update_layout(obj: *const LvObj) void;
 
@@ -1239,6 +2191,22 @@ extern fn lv_obj_has_flag(obj: *LvObj, v: c.lv_obj_flag_t) bool;
 extern fn lv_obj_align(obj: *LvObj, a: c.lv_align_t, x: c.lv_coord_t, y: c.lv_coord_t) void;
 extern fn lv_obj_align_to(obj: *LvObj, rel: *LvObj, a: c.lv_align_t, x: c.lv_coord_t, y: c.lv_coord_t) void;
 extern fn lv_obj_set_height(obj: *LvObj, h: c.lv_coord_t) void;
+extern fn lv_obj_get_height(obj: *const LvObj) c.lv_coord_t;
+extern fn lv_obj_scroll_by(obj: *LvObj, x: c.lv_coord_t, y: c.lv_coord_t, anim: c.lv_anim_enable_t) void;
+extern fn lv_obj_get_scroll_top(obj: *LvObj) c.lv_coord_t;
+extern fn lv_obj_get_scroll_bottom(obj: *LvObj) c.lv_coord_t;
+extern fn lv_obj_set_y(obj: *LvObj, y: c.lv_coord_t) void;
+extern fn lv_obj_get_coords(obj: *const LvObj, area: *c.lv_area_t) void;
+extern fn lv_obj_get_content_coords(obj: *const LvObj, area: *c.lv_area_t) void;
+extern fn lv_theme_get_color_primary(obj: *LvObj) Color;
+
+// draw descriptors have bit-fields, unsupported in zig cImport; defined in ui/c/ui.c.
+extern "c" fn nm_draw_fill_rect(ctx: *DrawCtx, area: *const c.lv_area_t, color: Color, opa: u8, radius: c.lv_coord_t) void;
+extern "c" fn nm_draw_text(ctx: *DrawCtx, obj: *LvObj, area: *const c.lv_area_t, text: [*:0]const u8, recolor: bool) void;
+extern "c" fn nm_draw_line_height(obj: *LvObj) c.lv_coord_t;
+extern "c" fn nm_draw_snapshot(ctx: *DrawCtx, obj: *LvObj, img: *const c.lv_img_dsc_t) void;
+extern fn lv_snapshot_take(obj: *LvObj, cf: c.lv_img_cf_t) ?*c.lv_img_dsc_t;
+extern fn lv_snapshot_free(dsc: *c.lv_img_dsc_t) void;
 extern fn lv_obj_set_width(obj: *LvObj, w: c.lv_coord_t) void;
 extern fn lv_obj_set_size(obj: *LvObj, w: c.lv_coord_t, h: c.lv_coord_t) void;
 extern fn lv_obj_get_content_width(obj: *const LvObj) c.lv_coord_t;
@@ -1258,6 +2226,7 @@ extern fn lv_btnmatrix_set_btn_ctrl_all(obj: *LvObj, ctrl: c.lv_btnmatrix_ctrl_t
 extern fn lv_label_create(parent: *LvObj) ?*LvObj;
 extern fn lv_label_set_text(label: *LvObj, text: [*:0]const u8) void;
 extern fn lv_label_set_text_static(label: *LvObj, text: [*:0]const u8) void;
+extern fn lv_label_get_text(label: *const LvObj) ?[*:0]const u8;
 extern fn lv_label_set_long_mode(label: *LvObj, mode: c.lv_label_long_mode_t) void;
 extern fn lv_label_set_recolor(label: *LvObj, enable: bool) void;
 
@@ -1266,6 +2235,7 @@ extern fn lv_textarea_get_text(obj: *LvObj) ?[*:0]const u8;
 extern fn lv_textarea_set_max_length(obj: *LvObj, n: u32) void;
 extern fn lv_textarea_set_one_line(obj: *LvObj, enable: bool) void;
 extern fn lv_textarea_set_password_mode(obj: *LvObj, enable: bool) void;
+extern fn lv_textarea_set_placeholder_text(obj: *LvObj, text: [*:0]const u8) void;
 extern fn lv_textarea_set_text(obj: *LvObj, text: [*:0]const u8) void;
 
 extern fn lv_dropdown_create(parent: *LvObj) ?*LvObj;
@@ -1278,7 +2248,18 @@ extern fn lv_dropdown_set_selected(obj: *LvObj, idx: u16) void;
 extern fn lv_dropdown_get_selected(obj: *const LvObj) u16;
 extern fn lv_dropdown_get_selected_str(obj: *const LvObj, buf: [*]u8, bufsize: u32) void;
 
-extern fn lv_spinner_create(parent: *LvObj, speed_ms: u32, arc_deg: u32) ?*LvObj;
+/// defined in spinner.c.
+extern fn nm_spinner_create(parent: *LvObj) ?*LvObj;
+
+extern fn lv_chart_create(parent: *LvObj) ?*LvObj;
+extern fn lv_chart_set_type(obj: *LvObj, typ: c.lv_chart_type_t) void;
+extern fn lv_chart_set_point_count(obj: *LvObj, n: u16) void;
+extern fn lv_chart_set_div_line_count(obj: *LvObj, hdiv: u8, vdiv: u8) void;
+extern fn lv_chart_set_range(obj: *LvObj, axis: c.lv_chart_axis_t, min: c.lv_coord_t, max: c.lv_coord_t) void;
+extern fn lv_chart_add_series(obj: *LvObj, color: Color, axis: c.lv_chart_axis_t) ?*Chart.Series;
+/// sets a point value without redrawing; LV_CHART_POINT_NONE, max coord value, hides the point.
+extern fn lv_chart_set_value_by_id(obj: *LvObj, ser: *Chart.Series, id: u16, val: c.lv_coord_t) void;
+extern fn lv_chart_refresh(obj: *LvObj) void;
 
 extern fn lv_bar_create(parent: *LvObj) ?*LvObj;
 extern fn lv_bar_set_value(bar: *LvObj, value: i32, c.lv_anim_enable_t) void;
@@ -1287,10 +2268,22 @@ extern fn lv_bar_set_range(bar: *LvObj, min: i32, max: i32) void;
 extern fn lv_win_create(parent: *LvObj, header_height: c.lv_coord_t) ?*LvObj;
 extern fn lv_win_add_title(win: *LvObj, title: [*:0]const u8) ?*LvObj;
 extern fn lv_win_get_content(win: *LvObj) *LvObj;
+extern fn lv_win_get_header(win: *LvObj) *LvObj;
 
 extern fn lv_qrcode_create(parent: *LvObj, size: c.lv_coord_t, dark: Color, light: Color) ?*LvObj;
 extern fn lv_qrcode_update(qrcode: *LvObj, data: *const anyopaque, data_len: u32) c.lv_res_t;
 
+/// lv_img_dsc_t with the bit-fields header unsupported in zig cImport
+/// as an opaque 32 bit value.
+const LvImgDsc = extern struct {
+    header: u32,
+    data_size: u32,
+    data: [*]u8, // const in C, but canvas buffers are writable
+};
+extern fn lv_canvas_get_img(canvas: *LvObj) *LvImgDsc;
+extern fn lv_img_cache_invalidate_src(src: ?*const anyopaque) void;
+extern fn lv_obj_invalidate(obj: *LvObj) void;
+
 extern fn lv_keyboard_create(parent: *LvObj) ?*LvObj;
 extern fn lv_keyboard_set_textarea(kb: *LvObj, ta: *LvObj) void;
 extern fn lv_keyboard_set_mode(kb: *LvObj, mode: c.lv_keyboard_mode_t) void;
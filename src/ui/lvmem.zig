@@ -0,0 +1,225 @@
+//! LVGL memory allocator.
+//!
+//! small allocations, typical for LVGL objects, styles and labels text, are
+//! served from per size class pools of fixed size blocks carved out of 64KiB
+//! slabs. freed blocks are kept in the pool free lists for re-use and slabs
+//! are never returned to the OS: widget churn re-uses the same memory instead
+//! of fragmenting the heap. larger allocations, for example draw layers,
+//! are passed on to libc malloc.
+//!
+//! nm_lv_malloc, nm_lv_free and nm_lv_realloc are wired to LVGL in lv_conf.h
+//! via LV_MEM_CUSTOM_ALLOC and friends.
+//! safe for concurrent use.
+
+const std = @import("std");
+
+/// pooled block sizes, including the header.
+const classes = [_]usize{ 32, 64, 128, 256, 512, 1024, 2048 };
+/// Header.class value of allocations passed on to libc.
+const large_class = classes.len;
+/// size of memory chunks requested from the OS to carve pool blocks from.
+const slab_size = 64 * 1024;
+
+/// precedes every allocation. its size is the same as malloc(3) alignment
+/// guarantee, so that the user data following it is equally aligned.
+const Header = extern struct {
+    size: usize, // as requested by the caller
+    class: usize, // index into classes or large_class
+};
+
+comptime {
+    std.debug.assert(@sizeOf(Header) == 2 * @sizeOf(usize));
+    for (classes) |n| std.debug.assert(n % @sizeOf(Header) == 0);
+}
+
+/// an unused pool block.
+const FreeBlock = struct {
+    next: ?*FreeBlock,
+};
+
+/// memory usage figures.
+pub const Stats = struct {
+    used: usize = 0, // bytes currently allocated by LVGL, including large
+    peak: usize = 0, // max used bytes since program start
+    large: usize = 0, // bytes currently allocated by LVGL from libc
+    pooled: usize = 0, // slab bytes obtained from the OS
+
+    /// percentage of pooled memory not holding LVGL data: free blocks and
+    /// headers plus rounding up to the block size.
+    pub fn fragmentation(self: Stats) u8 {
+        if (self.pooled == 0) {
+            return 0;
+        }
+        const data = self.used - self.large;
+        return @intCast((self.pooled -| data) * 100 / self.pooled);
+    }
+};
+
+/// guards all fields below.
+var mu: std.Thread.Mutex = .{};
+var free_lists = [_]?*FreeBlock{null} ** classes.len;
+var stats_: Stats = .{};
+
+/// returns a snapshot of the current memory usage figures.
+pub fn stats() Stats {
+    mu.lock();
+    defer mu.unlock();
+    return stats_;
+}
+
+export fn nm_lv_malloc(size: usize) ?*anyopaque {
+    mu.lock();
+    defer mu.unlock();
+    return alloc(size);
+}
+
+export fn nm_lv_free(ptr: ?*anyopaque) void {
+    const p = ptr orelse return;
+    mu.lock();
+    defer mu.unlock();
+    release(headerOf(p));
+}
+
+export fn nm_lv_realloc(ptr: ?*anyopaque, size: usize) ?*anyopaque {
+    mu.lock();
+    defer mu.unlock();
+    const p = ptr orelse return alloc(size);
+    const hdr = headerOf(p);
+    const total = std.math.add(usize, size, @sizeOf(Header)) catch return null;
+
+    // fits in the same block
+    if (hdr.class != large_class and total <= classes[hdr.class]) {
+        account(hdr.size, size);
+        hdr.size = size;
+        return p;
+    }
+    // large to large: let libc move it if needed
+    if (hdr.class == large_class and classOf(total) == null) {
+        const old = hdr.size;
+        const newhdr: *Header = @ptrCast(@alignCast(std.c.realloc(hdr, total) orelse return null));
+        newhdr.size = size;
+        account(old, size);
+        stats_.large = stats_.large - old + size;
+        return userData(newhdr);
+    }
+
+    const dst = alloc(size) orelse return null;
+    const n = @min(hdr.size, size);
+    @memcpy(@as([*]u8, @ptrCast(dst))[0..n], @as([*]const u8, @ptrCast(p))[0..n]);
+    release(hdr);
+    return dst;
+}
+
+/// callers must hold mu.
+fn alloc(size: usize) ?*anyopaque {
+    const total = std.math.add(usize, size, @sizeOf(Header)) catch return null;
+    const class = classOf(total) orelse large_class;
+    const hdr: *Header = blk: {
+        if (class != large_class) {
+            const b = popBlock(class) orelse return null;
+            break :blk @ptrCast(@alignCast(b));
+        }
+        const p = std.c.malloc(total) orelse return null;
+        stats_.large += size;
+        break :blk @ptrCast(@alignCast(p));
+    };
+    hdr.* = .{ .size = size, .class = class };
+    account(0, size);
+    return userData(hdr);
+}
+
+/// callers must hold mu.
+fn release(hdr: *Header) void {
+    account(hdr.size, 0);
+    if (hdr.class == large_class) {
+        stats_.large -= hdr.size;
+        std.c.free(hdr);
+        return;
+    }
+    const b: *FreeBlock = @ptrCast(@alignCast(hdr));
+    b.next = free_lists[hdr.class];
+    free_lists[hdr.class] = b;
+}
+
+/// returns a block of classes[ci] size, allocating a new slab if the pool is empty.
+/// callers must hold mu.
+fn popBlock(ci: usize) ?*FreeBlock {
+    if (free_lists[ci] == null) {
+        const slab = std.heap.page_allocator.alloc(u8, slab_size) catch return null;
+        stats_.pooled += slab_size;
+        const bsize = classes[ci];
+        var i: usize = slab_size / bsize;
+        while (i > 0) {
+            i -= 1;
+            const b: *FreeBlock = @ptrCast(@alignCast(slab[i * bsize ..].ptr));
+            b.next = free_lists[ci];
+            free_lists[ci] = b;
+        }
+    }
+    const b = free_lists[ci].?;
+    free_lists[ci] = b.next;
+    return b;
+}
+
+/// returns the smallest pool class fitting total bytes, or null if too large.
+fn classOf(total: usize) ?usize {
+    for (classes, 0..) |n, i| {
+        if (total <= n) {
+            return i;
+        }
+    }
+    return null;
+}
+
+fn account(old: usize, new: usize) void {
+    stats_.used = stats_.used - old + new;
+    stats_.peak = @max(stats_.peak, stats_.used);
+}
+
+fn headerOf(p: *anyopaque) *Header {
+    return @ptrFromInt(@intFromPtr(p) - @sizeOf(Header));
+}
+
+fn userData(hdr: *Header) *anyopaque {
+    return @ptrFromInt(@intFromPtr(hdr) + @sizeOf(Header));
+}
+
+test "lvmem" {
+    const t = std.testing;
+    const base = stats();
+
+    const a = nm_lv_malloc(10).?;
+    const b = nm_lv_malloc(10).?;
+    try t.expect(a != b);
+    try t.expect(@intFromPtr(a) % @sizeOf(Header) == 0);
+    try t.expectEqual(base.used + 20, stats().used);
+    @memset(@as([*]u8, @ptrCast(a))[0..10], 0xaa);
+
+    // grows in place within the same block
+    const a2 = nm_lv_realloc(a, 16).?;
+    try t.expect(a2 == a);
+    // moves to a larger class, preserving the data
+    const a3 = nm_lv_realloc(a2, 100).?;
+    try t.expect(a3 != a2);
+    try t.expectEqualSlices(u8, &[_]u8{0xaa} ** 10, @as([*]u8, @ptrCast(a3))[0..10]);
+    // the freed block is re-used
+    const c = nm_lv_malloc(8).?;
+    try t.expect(c == a2);
+
+    // large allocations
+    const big = nm_lv_malloc(10000).?;
+    try t.expectEqual(base.large + 10000, stats().large);
+    const big2 = nm_lv_realloc(big, 20000).?;
+    try t.expectEqual(base.large + 20000, stats().large);
+
+    nm_lv_free(a3);
+    nm_lv_free(b);
+    nm_lv_free(c);
+    nm_lv_free(big2);
+    nm_lv_free(null);
+    const end = stats();
+    try t.expectEqual(base.used, end.used);
+    try t.expectEqual(base.large, end.large);
+    try t.expect(end.peak >= base.used + 20000);
+    try t.expect(end.pooled > 0);
+}
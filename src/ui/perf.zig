@@ -0,0 +1,376 @@
+//! UI loop frame and render time instrumentation.
+//!
+//! the UI thread records timings into cumulative lock-free histograms:
+//! lv_timer_handler and comm messages and reports apply run time in the main UI loop, and
+//! render time, flush time and redrawn area of each frame via display driver
+//! hooks in c/perf.c. a report with the histograms since the previous one is
+//! periodically sent to nd as comm.Message.UiPerfReport, to find jank in the
+//! field without an on-screen overlay.
+//!
+//! touch latency is measured from the evdev driver: each press or release is
+//! followed by its input sequence number from the evdev event timestamp to
+//! LVGL reading it, to the press or click event dispatch, and to the end of
+//! the first frame redrawn after that, flush included.
+
+const builtin = @import("builtin");
+const std = @import("std");
+const comm = @import("../comm.zig");
+const tcalloc = @import("../tcalloc.zig");
+const lvgl = @import("lvgl.zig");
+
+const logger = std.log.scoped(.perf);
+
+extern "c" fn nm_perf_attach(disp: *lvgl.LvDisp) void;
+
+pub const Metric = enum {
+    timers,
+    queue,
+    render,
+    flush,
+    area,
+    touch_read,
+    touch_event,
+    touch_photon,
+};
+
+/// number of log2 histogram buckets; see comm.Message.UiPerfReport.Histogram.
+pub const nbuckets = 24;
+
+/// how often a report is sent to nd, in ms.
+const report_period = 60 * std.time.ms_per_s;
+
+/// touch input to redraw time above which the frame is taken for an unrelated
+/// one, such as a report update after a tap which changed nothing on screen.
+const max_touch_latency = 1 * std.time.us_per_s;
+
+/// catch-all event handler calls within a report period above which a
+/// warning is logged, in debug builds; see lvgl.catchAllEvents.
+const max_catchall_events = 1000;
+
+/// cumulative values histogram; safe for concurrent use.
+const Histogram = struct {
+    buckets: [nbuckets]Atomic(u32) = [_]Atomic(u32){Atomic(u32).init(0)} ** nbuckets,
+    count: Atomic(u32) = Atomic(u32).init(0),
+    sum: Atomic(u64) = Atomic(u64).init(0),
+    max: Atomic(u32) = Atomic(u32).init(0), // reset on each snapshot
+
+    const Atomic = std.atomic.Value;
+
+    fn record(self: *Histogram, v: u32) void {
+        _ = self.buckets[bucketOf(v)].fetchAdd(1, .monotonic);
+        _ = self.count.fetchAdd(1, .monotonic);
+        _ = self.sum.fetchAdd(v, .monotonic);
+        _ = self.max.fetchMax(v, .monotonic);
+    }
+
+    /// returns the histogram of values recorded since prev, and updates prev
+    /// to the current cumulative values. the result references buf.
+    fn since(self: *Histogram, prev: *Cumulative, buf: *[nbuckets]u32) comm.Message.UiPerfReport.Histogram {
+        const count = self.count.load(.monotonic);
+        const sum = self.sum.load(.monotonic);
+        for (&self.buckets, buf, &prev.buckets) |*b, *out, *p| {
+            const v = b.load(.monotonic);
+            out.* = v -% p.*;
+            p.* = v;
+        }
+        const res = comm.Message.UiPerfReport.Histogram{
+            .count = count -% prev.count,
+            .sum = sum -% prev.sum,
+            .max = self.max.swap(0, .monotonic),
+            .buckets = buf,
+        };
+        prev.count = count;
+        prev.sum = sum;
+        return res;
+    }
+};
+
+/// histogram values as of the last report.
+const Cumulative = struct {
+    buckets: [nbuckets]u32 = [_]u32{0} ** nbuckets,
+    count: u32 = 0,
+    sum: u64 = 0,
+};
+
+/// returns the bucket index of v: 0 for zero, i for [2^(i-1), 2^i) range.
+fn bucketOf(v: u32) usize {
+    return @min(nbuckets - 1, 32 - @as(usize, @clz(v)));
+}
+
+/// called at the end of each redrawn frame with its render and flush times,
+/// in microseconds, and redrawn pixels; see lvbench.zig.
+pub var frame_hook: ?*const fn (render: u64, flush: u64, px: u32) void = null;
+
+/// set once in init; durations are not recorded until then.
+var timer: ?std.time.Timer = null;
+var hists = [_]Histogram{.{}} ** std.meta.fields(Metric).len;
+
+/// the frame being refreshed; accessed only from the UI thread.
+var frame: struct {
+    start: u64 = 0,
+    flush_start: u64 = 0,
+    flush: u64 = 0, // total flush time of the frame
+    px: u32 = 0, // redrawn pixels; zero if nothing was redrawn
+} = .{};
+
+/// the latest touch press or release followed to its redraw;
+/// accessed only from the UI thread.
+var touch: struct {
+    seq: u32 = 0, // evdev driver input sequence number
+    start: u64 = 0, // evdev event timestamp
+    read: u64 = 0,
+    event: u64 = 0, // 0 until dispatched to an object
+    pending: bool = false, // no frame redrawn since
+} = .{};
+
+/// collection times of the reports shown; accessed only from the UI thread.
+/// see setCollected.
+var collected: comm.Message.UiPerfReport.Collected = .{};
+
+/// previous report state; accessed only from the UI thread.
+var last: struct {
+    ts: u64 = 0,
+    catchall: u32 = 0, // lvgl.catchAllEvents
+    hists: [std.meta.fields(Metric).len]Cumulative = [_]Cumulative{.{}} ** std.meta.fields(Metric).len,
+} = .{};
+
+/// starts recording and a periodic report timer.
+/// must be called from the UI thread once the display is initialized.
+pub fn init(disp: *lvgl.LvDisp) !void {
+    timer = try std.time.Timer.start();
+    nm_perf_attach(disp);
+    _ = try lvgl.LvTimer.new(nm_perf_report, report_period, null);
+}
+
+/// returns a monotonic timestamp in microseconds, or 0 before init.
+pub fn now() u64 {
+    if (timer) |*t| {
+        return t.read() / std.time.ns_per_us;
+    }
+    return 0;
+}
+
+/// adds v to the metric m histogram; v is a duration in microseconds
+/// or a pixels count for area.
+pub fn record(m: Metric, v: u64) void {
+    if (timer == null) {
+        return;
+    }
+    hists[@intFromEnum(m)].record(std.math.lossyCast(u32, v));
+}
+
+export fn nm_perf_frame_begin() void {
+    frame = .{ .start = now() };
+}
+
+export fn nm_perf_frame_pixels(px: u32) void {
+    frame.px = px;
+}
+
+export fn nm_perf_frame_end() void {
+    if (frame.px == 0) {
+        return; // nothing was redrawn
+    }
+    const end = now();
+    const total = end - frame.start;
+    record(.render, total -| frame.flush);
+    record(.flush, frame.flush);
+    record(.area, frame.px);
+    if (frame_hook) |f| {
+        f(total -| frame.flush, frame.flush, frame.px);
+    }
+    if (touch.pending and touch.event != 0 and frame.start >= touch.event) {
+        touch.pending = false;
+        const photon = end - touch.start;
+        if (photon <= max_touch_latency) {
+            record(.touch_photon, photon);
+            logger.debug("touch {d}: read {d}us, event {d}us, photon {d}us", .{
+                touch.seq,
+                touch.read - touch.start,
+                touch.event - touch.read,
+                photon,
+            });
+        }
+    }
+}
+
+export fn nm_perf_flush_begin() void {
+    frame.flush_start = now();
+}
+
+export fn nm_perf_flush_end() void {
+    frame.flush += now() - frame.flush_start;
+}
+
+/// called by the evdev driver as LVGL reads a touch press or release sample
+/// with sequence number seq, age_us after its evdev event timestamp.
+/// starts following it, dropping a previous input not yet redrawn.
+export fn nm_perf_touch_read(seq: u32, age_us: u32) void {
+    if (timer == null) {
+        return;
+    }
+    const ts = now();
+    touch = .{ .seq = seq, .start = ts -| age_us, .read = ts, .pending = true };
+    record(.touch_read, age_us);
+}
+
+/// called by the evdev driver as LVGL dispatches a press or click event
+/// to an object; only the first one after a touch read counts.
+export fn nm_perf_touch_event() void {
+    if (!touch.pending or touch.event != 0) {
+        return;
+    }
+    touch.event = now();
+    record(.touch_event, touch.event - touch.read);
+}
+
+/// sends histograms since the previous report to nd, unless no frames were
+/// redrawn meanwhile, for example in standby.
+export fn nm_perf_report(_: *lvgl.LvTimer) void {
+    sendReport(.periodic) catch |err| logger.err("ui_perf_report: {any}", .{err});
+}
+
+/// sends histograms since the previous report, including when nothing was
+/// redrawn, along with an object census. used to answer
+/// comm.Message.get_ui_perf_report; the periodic schedule is unaffected.
+/// must be called from the UI thread.
+/// sets the unix time of the onchain and lightning report collections the
+/// data on screen is from, sent along with the next report.
+/// must be called from the UI thread.
+pub fn setCollected(v: comm.Message.UiPerfReport.Collected) void {
+    collected = v;
+}
+
+pub fn reportNow() !void {
+    return sendReport(.now);
+}
+
+fn sendReport(mode: enum { periodic, now }) !void {
+    var bufs: [std.meta.fields(Metric).len][nbuckets]u32 = undefined;
+    var out: [std.meta.fields(Metric).len]comm.Message.UiPerfReport.Histogram = undefined;
+    for (&hists, &last.hists, &bufs, &out) |*h, *prev, *buf, *o| {
+        o.* = h.since(prev, buf);
+    }
+    const ts = now();
+    defer last.ts = ts;
+    const catchall = lvgl.catchAllEvents();
+    defer last.catchall = catchall;
+    if (catchall -% last.catchall > max_catchall_events) {
+        logger.warn("{d} events to catch-all handlers since the last report", .{catchall -% last.catchall});
+    }
+    if (mode == .periodic and out[@intFromEnum(Metric.render)].count == 0) {
+        return;
+    }
+    var classes: [lvgl.max_census_classes]comm.Message.UiPerfReport.Census.Class = undefined;
+    var subtrees: [lvgl.max_census_subtrees]comm.Message.UiPerfReport.Census.Subtree = undefined;
+    const lvmem = lvgl.mem.stats();
+    var rep = comm.Message.UiPerfReport{
+        .period = std.math.lossyCast(u32, (ts - last.ts) / std.time.us_per_ms),
+        .timers = out[@intFromEnum(Metric.timers)],
+        .queue = out[@intFromEnum(Metric.queue)],
+        .render = out[@intFromEnum(Metric.render)],
+        .flush = out[@intFromEnum(Metric.flush)],
+        .area = out[@intFromEnum(Metric.area)],
+        .touch_read = out[@intFromEnum(Metric.touch_read)],
+        .touch_event = out[@intFromEnum(Metric.touch_event)],
+        .touch_photon = out[@intFromEnum(Metric.touch_photon)],
+        .mem_peak = lvmem.peak,
+        .collected = collected,
+    };
+    if (mode == .periodic) {
+        rep.objects = lvgl.objectCount();
+        return comm.pipeWrite(.{ .ui_perf_report = rep });
+    }
+    const cen = lvgl.census();
+    for (cen.classes.constSlice(), classes[0..cen.classes.len]) |cc, *o| {
+        o.* = .{ .name = cc.name, .count = cc.count };
+    }
+    for (cen.subtrees.constSlice(), subtrees[0..cen.subtrees.len]) |s, *o| {
+        o.* = .{
+            .root = @enumFromInt(@intFromEnum(s.root)), // same tags order
+            .index = s.index,
+            .class = s.class,
+            .objects = s.tally.objects,
+            .styles = s.tally.styles,
+            .label_bytes = s.tally.label_bytes,
+        };
+    }
+    rep.objects = cen.total.objects;
+    rep.census = .{
+        .objects = cen.total.objects,
+        .styles = cen.total.styles,
+        .label_bytes = cen.total.label_bytes,
+        .classes = classes[0..cen.classes.len],
+        .subtrees = subtrees[0..cen.subtrees.len],
+        .lvgl_mem = .{ .used = lvmem.used, .peak = lvmem.peak, .large = lvmem.large, .pooled = lvmem.pooled },
+    };
+    if (builtin.mode != .Debug) {
+        const hs = tcalloc.stats();
+        rep.census.?.heap = .{ .used = hs.used, .peak = hs.peak, .large = hs.large, .pooled = hs.pooled };
+    }
+    return comm.pipeWrite(.{ .ui_perf_report = rep });
+}
+
+test "perf histogram" {
+    const t = std.testing;
+
+    try t.expectEqual(@as(usize, 0), bucketOf(0));
+    try t.expectEqual(@as(usize, 1), bucketOf(1));
+    try t.expectEqual(@as(usize, 2), bucketOf(3));
+    try t.expectEqual(@as(usize, 3), bucketOf(4));
+    try t.expectEqual(@as(usize, nbuckets - 1), bucketOf(std.math.maxInt(u32)));
+
+    var h = Histogram{};
+    var prev = Cumulative{};
+    var buf: [nbuckets]u32 = undefined;
+    h.record(0);
+    h.record(5);
+    h.record(6);
+    var res = h.since(&prev, &buf);
+    try t.expectEqual(@as(u32, 3), res.count);
+    try t.expectEqual(@as(u64, 11), res.sum);
+    try t.expectEqual(@as(u32, 6), res.max);
+    try t.expectEqual(@as(u32, 1), res.buckets[0]);
+    try t.expectEqual(@as(u32, 2), res.buckets[3]);
+
+    h.record(100);
+    res = h.since(&prev, &buf);
+    try t.expectEqual(@as(u32, 1), res.count);
+    try t.expectEqual(@as(u64, 100), res.sum);
+    try t.expectEqual(@as(u32, 100), res.max);
+    try t.expectEqual(@as(u32, 0), res.buckets[3]);
+    try t.expectEqual(@as(u32, 1), res.buckets[7]);
+    try t.expectEqual(@as(u64, 100), res.percentile(50));
+}
+
+test "perf touch latency" {
+    const t = std.testing;
+
+    timer = try std.time.Timer.start();
+    defer timer = null;
+    const h = &hists[@intFromEnum(Metric.touch_photon)];
+    const count = h.count.load(.monotonic);
+
+    // no object event: the frame is not attributed to the input.
+    nm_perf_touch_read(1, 500);
+    nm_perf_frame_begin();
+    nm_perf_frame_pixels(100);
+    nm_perf_frame_end();
+    try t.expectEqual(count, h.count.load(.monotonic));
+
+    nm_perf_touch_read(2, 500);
+    nm_perf_touch_event();
+    nm_perf_touch_event(); // bubbling; ignored
+    try t.expectEqual(@as(u32, 2), touch.seq);
+    nm_perf_frame_begin();
+    nm_perf_frame_pixels(100);
+    nm_perf_frame_end();
+    try t.expectEqual(count + 1, h.count.load(.monotonic));
+    try t.expect(!touch.pending);
+
+    // only the first frame counts.
+    nm_perf_frame_begin();
+    nm_perf_frame_pixels(100);
+    nm_perf_frame_end();
+    try t.expectEqual(count + 1, h.count.load(.monotonic));
+}
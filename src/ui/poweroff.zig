@@ -1,5 +1,5 @@
 //! poweroff workflow.
-//! all functions assume ui_mutex is always locked.
+//! all functions must be called from the UI thread.
 const std = @import("std");
 
 const comm = @import("../comm.zig");
@@ -50,6 +50,8 @@ var global_progress_win: ?ProgressWin = null;
 pub fn updateStatus(report: comm.Message.PoweroffProgress) !void {
     if (global_progress_win) |win| {
         var all_stopped = true;
+        const bulk = lvgl.beginBulkUpdate(win.svcont);
+        defer bulk.end();
         win.resetSvContainer();
         for (report.services) |sv| {
             try win.addServiceStatus(sv.name, sv.stopped, sv.err);
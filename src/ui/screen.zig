@@ -1,6 +1,7 @@
 ///! display and touch screen helper functions.
 const builtin = @import("builtin");
 const std = @import("std");
+const posix = std.posix;
 const Thread = std.Thread;
 
 const lvgl = @import("lvgl.zig");
@@ -11,39 +12,198 @@ const logger = std.log.scoped(.screen);
 
 /// cover the whole screen in black (top layer) and block until either
 /// a touch screen activity or wake event is triggered.
-/// sleep removes all input devices at enter and reinstates them at exit so that
-/// a touch event triggers no accidental action.
+/// input devices stay in place but gated for the duration: touch input is
+/// dropped, the wake-up touch included up to its release, so that it triggers
+/// no accidental action.
 ///
-/// the UI mutex is held while calling LVGL UI functions, and released during
-/// idling or waiting for wake event.
-/// although sleep is safe for concurrent use, the input drivers init/deinit
-/// implementation used on entry and exit might not be.
-pub fn sleep(ui: *std.Thread.Mutex, wake: *const Thread.ResetEvent) void {
-    ui.lock();
-    drv.deinitInput();
+/// must be called from the UI thread: it blocks LVGL loop for the whole duration.
+pub fn sleep(wake: *WakeEvent) void {
+    const evdev_fd = drv.inputFd() orelse {
+        logger.err("sleep: no touch screen input device", .{});
+        return;
+    };
+    drv.gateInput(true);
     widget.topdrop(.show);
-    ui.unlock();
     defer {
-        ui.lock();
-        defer ui.unlock();
-        drv.initInput() catch |err| logger.err("drv.initInput: {any}", .{err});
+        drv.gateInput(false);
         widget.topdrop(.remove);
     }
 
-    const watcher = drv.InputWatcher() catch |err| {
-        logger.err("drv.InputWatcher: {any}", .{err});
-        return;
-    };
-    defer watcher.close();
+    _ = drv.drainInput(); // the input from before sleep is no wake up
+    // block in poll until either fd is ready; fall back to polling without eventfd.
     while (!wake.isSet()) {
-        if (watcher.consume()) {
+        const wakefd = wake.fd orelse {
+            if (drv.drainInput()) {
+                return;
+            }
+            std.atomic.spinLoopHint();
+            std.time.sleep(10 * std.time.ns_per_ms);
+            continue;
+        };
+        var fds = [_]posix.pollfd{
+            .{ .fd = evdev_fd, .events = posix.POLL.IN, .revents = 0 },
+            .{ .fd = wakefd, .events = posix.POLL.IN, .revents = 0 },
+        };
+        _ = posix.poll(&fds, -1) catch |err| {
+            logger.err("sleep poll: {any}", .{err});
+            return;
+        };
+        if (fds[0].revents & (posix.POLL.ERR | posix.POLL.HUP | posix.POLL.NVAL) != 0) {
+            return; // wake up rather than spin on a broken input device
+        }
+        if (drv.drainInput()) {
             return;
         }
-        std.atomic.spinLoopHint();
-        std.time.sleep(10 * std.time.ns_per_ms);
     }
 }
 
+/// reports whether touch screen input awaits reading, for background UI work
+/// to yield to it. always false with no evdev input.
+pub fn inputPending() bool {
+    const fd = drv.inputFd() orelse return false;
+    var fds = [_]posix.pollfd{.{ .fd = fd, .events = posix.POLL.IN, .revents = 0 }};
+    const n = posix.poll(&fds, 0) catch return false;
+    return n > 0;
+}
+
+/// a reset event which sleep can wait for in poll along with touch screen input.
+/// safe for concurrent use.
+pub const WakeEvent = struct {
+    ev: Thread.ResetEvent = .{},
+    fd: ?posix.fd_t = null, // eventfd readable while ev is set; null if unavailable
+
+    /// an eventfd creation failure is non-fatal: sleep falls back to polling.
+    pub fn init() WakeEvent {
+        const fd = posix.eventfd(0, std.os.linux.EFD.CLOEXEC | std.os.linux.EFD.NONBLOCK) catch |err| {
+            logger.err("WakeEvent eventfd: {any}", .{err});
+            return .{};
+        };
+        return .{ .fd = fd };
+    }
+
+    pub fn set(self: *WakeEvent) void {
+        self.ev.set();
+        if (self.fd) |fd| {
+            const one: u64 = 1;
+            _ = posix.write(fd, std.mem.asBytes(&one)) catch {};
+        }
+    }
+
+    pub fn reset(self: *WakeEvent) void {
+        self.ev.reset();
+        if (self.fd) |fd| {
+            var buf: [8]u8 = undefined;
+            _ = posix.read(fd, &buf) catch {}; // EAGAIN if not set
+        }
+    }
+
+    pub fn isSet(self: *WakeEvent) bool {
+        return self.ev.isSet();
+    }
+};
+
+/// lets the UI loop block while idle instead of waking up at LVGL timers
+/// default periods. idle is when no animations are running and there was no
+/// recent user input. input devices polling is paused meanwhile, until the
+/// touch screen reports new events, on the same input device fd LVGL reads.
+/// the display refresh timer needs no pausing here: LVGL pauses it after each
+/// refresh, with its perf and mem monitors off as in lv_conf.h, until an area
+/// is invalidated. so a static screen blocks until the next deadline of the
+/// remaining timers.
+/// available only with evdev input, i.e. fbev, drmev and drmgl drivers.
+pub const Idler = struct {
+    evdev_fd: posix.fd_t, // touch screen input device; read only by the driver
+    wakefd: posix.fd_t, // eventfd signaled by wake
+    paused: bool = false, // input devices polling; accessed only from the UI thread
+
+    /// no user input time after which the UI loop may idle, in ms.
+    /// long enough to cover a press held in between input device reads.
+    const input_quiet_ms = 200;
+    /// max wait duration, in ms. a static screen has no LVGL timers due for
+    /// longer than this, but for the standby check; see nm_check_idle_time.
+    const max_wait_ms = 60 * 1000;
+
+    pub fn init() !Idler {
+        const evdev_fd = drv.inputFd() orelse return error.IdlerUnavailable;
+        const wakefd = try posix.eventfd(0, std.os.linux.EFD.CLOEXEC | std.os.linux.EFD.NONBLOCK);
+        return .{ .evdev_fd = evdev_fd, .wakefd = wakefd };
+    }
+
+    /// interrupts a blocked wait, for example after a UI update from another thread.
+    /// safe for concurrent use.
+    pub fn wake(self: *Idler) void {
+        const one: u64 = 1;
+        _ = posix.write(self.wakefd, std.mem.asBytes(&one)) catch {};
+    }
+
+    /// reports whether the UI loop may block in wait, pausing input devices
+    /// polling when entering idle. must be called from the UI thread.
+    pub fn enter(self: *Idler) bool {
+        if (self.paused) {
+            return true;
+        }
+        if (lvgl.runningAnimations() > 0 or lvgl.idleTime() < input_quiet_ms) {
+            return false;
+        }
+        setInputPaused(true);
+        self.paused = true;
+        return true;
+    }
+
+    /// resumes input devices polling if paused. must be called from the UI thread.
+    pub fn leave(self: *Idler) void {
+        if (self.paused) {
+            setInputPaused(false);
+            self.paused = false;
+        }
+    }
+
+    /// blocks for up to timeout_ms, until touch screen input or wake.
+    /// returns true on input, in which case the caller is expected to leave idle.
+    pub fn wait(self: *Idler, timeout_ms: u32) bool {
+        var fds = [_]posix.pollfd{
+            .{ .fd = self.evdev_fd, .events = posix.POLL.IN, .revents = 0 },
+            .{ .fd = self.wakefd, .events = posix.POLL.IN, .revents = 0 },
+        };
+        _ = posix.poll(&fds, @min(timeout_ms, max_wait_ms)) catch |err| {
+            logger.err("idler poll: {any}", .{err});
+            return true;
+        };
+        if (fds[1].revents != 0) {
+            var buf: [8]u8 = undefined;
+            _ = posix.read(self.wakefd, &buf) catch {};
+        }
+        if (fds[0].revents != 0) {
+            return true; // left for LVGL to read once polling resumes
+        }
+        return false;
+    }
+
+    fn setInputPaused(paused: bool) void {
+        var indev = lvgl.LvIndev.first();
+        while (indev) |d| : (indev = d.next()) {
+            const t = d.readTimer() orelse continue;
+            t.setPaused(paused);
+            if (!paused) {
+                t.ready(); // pick up the input which ended idle right away
+            }
+        }
+    }
+};
+
+/// max display backlight brightness, as in rpi_backlight max_brightness.
+pub const max_brightness = 255;
+
+/// sets display backlight brightness, from 0 to max_brightness.
+/// independent of backlight power: a brightness set while off applies once on.
+pub fn setBrightness(level: u8) !void {
+    const path = if (builtin.is_test) "/dev/null" else "/sys/class/backlight/rpi_backlight/brightness";
+    const f = try std.fs.openFileAbsolute(path, .{ .mode = .write_only });
+    defer f.close();
+    var buf: [3]u8 = undefined;
+    _ = try f.write(std.fmt.bufPrint(&buf, "{d}", .{level}) catch unreachable);
+}
+
 /// turn on or off display backlight.
 pub fn backlight(onoff: enum { on, off }) !void {
     const blpath = if (builtin.is_test) "/dev/null" else "/sys/class/backlight/rpi_backlight/bl_power";
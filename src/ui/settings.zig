@@ -1,5 +1,5 @@
 //! settings main tab.
-//! all functions assume LVGL is init'ed and ui mutex is locked on entry.
+//! all functions assume LVGL is init'ed and are called from the UI thread.
 //!
 //! TODO: at the moment, most of the code is still in C; need to port to zig from src/ui/c/ui.c
 
@@ -68,6 +68,7 @@ var tab: struct {
         chansel: lvgl.Dropdown,
         switchbtn: lvgl.TextButton,
         currchan: lvgl.Label,
+        progress: lvgl.Label, // script output while an update is running
     },
 } = undefined;
 
@@ -115,7 +116,7 @@ pub fn initNodenamePanel(cont: lvgl.Container) !lvgl.Card {
         .oneline = true,
     });
     tab.nodename.textarea.setWidth(lvgl.sizePercent(100));
-    _ = tab.nodename.textarea.on(.all, nm_nodename_textarea_input, null);
+    tab.nodename.textarea.onEach(&.{ .focus, .defocus, .ready, .cancel, .value_changed }, nm_nodename_textarea_input, null);
 
     tab.nodename.changebtn = try lvgl.TextButton.new(right, textChange);
     tab.nodename.changebtn.setWidth(lvgl.sizePercent(100));
@@ -186,6 +187,9 @@ pub fn initSysupdatesPanel(cont: lvgl.Container) !lvgl.Card {
     const lab = try lvgl.Label.new(left, "edge channel may contain some experimental and unstable features.", .{});
     lab.setWidth(lvgl.sizePercent(100));
     lab.setHeightToContent();
+    tab.sysupdates.progress = try lvgl.Label.new(left, null, .{ .long_mode = .dot });
+    tab.sysupdates.progress.setWidth(lvgl.sizePercent(100));
+    tab.sysupdates.progress.hide();
 
     // right column
     const right = try lvgl.FlexLayout.new(row, .column, .{});
@@ -254,6 +258,25 @@ pub fn update(sett: comm.Message.Settings) !void {
     }
 }
 
+/// shows the output of a running system update, and restores the switch
+/// controls once it's done.
+pub fn updateSysupdatesProgress(rep: comm.Message.SysupdatesProgress) !void {
+    var buf: [256]u8 = undefined;
+    tab.sysupdates.progress.show();
+    if (!rep.done) {
+        try tab.sysupdates.progress.setTextFmt(&buf, "UPDATING ({d} lines): {s}", .{ rep.lines, rep.last });
+        return;
+    }
+    if (rep.ok) {
+        try tab.sysupdates.progress.setTextFmt(&buf, "DONE: {s}", .{rep.last});
+    } else {
+        try tab.sysupdates.progress.setTextFmt(&buf, "FAILED: {s}", .{rep.last});
+    }
+    tab.sysupdates.card.spin(.off);
+    tab.sysupdates.chansel.enable();
+    tab.sysupdates.switchbtn.label.setTextStatic(textSwitch);
+}
+
 export fn nm_nodename_textarea_input(e: *lvgl.LvEvent) void {
     switch (e.code()) {
         .focus => widget.keyboardOn(tab.nodename.textarea),
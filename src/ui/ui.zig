@@ -1,7 +1,9 @@
 const buildopts = @import("build_options");
 const std = @import("std");
 
+const allocprof = @import("../allocprof.zig");
 const comm = @import("../comm.zig");
+const trace = @import("../trace.zig");
 const drv = @import("drv.zig");
 const lvgl = @import("lvgl.zig");
 const symbol = @import("symbol.zig");
@@ -9,6 +11,8 @@ const widget = @import("widget.zig");
 
 pub const bitcoin = @import("bitcoin.zig");
 pub const lightning = @import("lightning.zig");
+pub const lvbench = @import("lvbench.zig");
+pub const perf = @import("perf.zig");
 pub const poweroff = @import("poweroff.zig");
 pub const screenlock = @import("screenlock.zig");
 pub const settings = @import("settings.zig");
@@ -17,9 +21,20 @@ const logger = std.log.scoped(.ui);
 
 // defined in src/ui/c/ui.c
 extern "c" fn nm_ui_init_theme(disp: *lvgl.LvDisp) void;
+extern "c" fn nm_ui_init_fallback_font(ttf: [*]const u8, len: usize, cache_size: usize) c_int;
+extern "c" fn nm_ui_drop_font_cache() void;
 // calls back into nm_create_xxx_panel functions defined here during init.
 extern "c" fn nm_ui_init_main_tabview(screen: *lvgl.LvObj) c_int;
 
+/// info tab panel elements; set in createInfoPanel.
+var info: struct {
+    system: lvgl.Label,
+    compaction: lvgl.Label,
+    backup: lvgl.Label,
+    tor: lvgl.Label,
+    job: lvgl.Label,
+} = undefined;
+
 // global allocator set on init.
 // must be set before a call to nm_ui_init.
 var allocator: std.mem.Allocator = undefined;
@@ -27,32 +42,65 @@ var allocator: std.mem.Allocator = undefined;
 pub const InitOpt = struct {
     allocator: std.mem.Allocator,
     slock: bool, // whether to start the UI in screen locked mode
+    fallback_font: ?[]const u8 = null, // TrueType font file path
 };
 
+/// rasterized glyphs cache of each fallback font size, in bytes.
+const fallback_font_cache = 32 * 1024;
+
 pub fn init(opt: InitOpt) !void {
     allocator = opt.allocator;
     settings.allocator = opt.allocator;
+    const drv_span = trace.begin("lvgl and drivers init");
     lvgl.init();
     const disp = try drv.initDisplay();
+    perf.init(disp) catch |err| logger.err("perf.init: {any}", .{err});
     drv.initInput() catch |err| {
         // TODO: or continue without the touchpad?
         // at the very least must disable screen blanking timeout in case of a failure.
         // otherwise, impossible to wake up the screen. */
         return err;
     };
+    drv_span.end();
 
+    const theme_span = trace.begin("theme init");
+    if (opt.fallback_font) |path| {
+        initFallbackFont(path) catch |err| switch (err) {
+            error.FileNotFound => logger.info("no fallback font at {s}", .{path}),
+            else => logger.err("fallback font {s}: {any}", .{ path, err }),
+        };
+    }
     nm_ui_init_theme(disp);
+    theme_span.end();
 
     const main_scr = try lvgl.Screen.active();
+    const tabview_span = trace.begin("main tabview");
     if (nm_ui_init_main_tabview(main_scr.lvobj) != 0) {
         return error.UiInitMainTabview;
     }
+    tabview_span.end();
+    const slock_span = trace.begin("screenlock init");
     try screenlock.init(main_scr);
+    slock_span.end();
     if (opt.slock) {
         screenlock.activate();
     }
 }
 
+/// maps the TrueType font file at path for the lifetime of the process and
+/// chains it behind the bitmap fonts. unlike a compiled-in font of the same
+/// coverage, a mapping costs only the pages glyph lookups actually touch.
+fn initFallbackFont(path: []const u8) !void {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+    const size: usize = @intCast((try file.stat()).size);
+    const data = try std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+    errdefer std.posix.munmap(data);
+    if (nm_ui_init_fallback_font(data.ptr, data.len, fallback_font_cache) != 0) {
+        return error.UiFallbackFontInit;
+    }
+}
+
 export fn nm_create_info_panel(parent: *lvgl.LvObj) c_int {
     createInfoPanel(lvgl.Container{ .lvobj = parent }) catch |err| {
         logger.err("createInfoPanel: {any}", .{err});
@@ -62,7 +110,7 @@ export fn nm_create_info_panel(parent: *lvgl.LvObj) c_int {
 }
 
 export fn nm_create_bitcoin_panel(parent: *lvgl.LvObj) c_int {
-    bitcoin.initTabPanel(lvgl.Container{ .lvobj = parent }) catch |err| {
+    bitcoin.initTabPanel(allocator, lvgl.Container{ .lvobj = parent }) catch |err| {
         logger.err("createBitcoinPanel: {any}", .{err});
         return -1;
     };
@@ -70,7 +118,7 @@ export fn nm_create_bitcoin_panel(parent: *lvgl.LvObj) c_int {
 }
 
 export fn nm_create_lightning_panel(parent: *lvgl.LvObj) c_int {
-    lightning.initTabPanel(allocator, lvgl.Container{ .lvobj = parent }) catch |err| {
+    lightning.initTabPanel(allocprof.tagged(.ui_lightning, allocator), lvgl.Container{ .lvobj = parent }) catch |err| {
         logger.err("createLightningPanel: {any}", .{err});
         return -1;
     };
@@ -105,4 +153,153 @@ fn createInfoPanel(cont: lvgl.Container) !void {
     const flex = cont.flex(.column, .{});
     var buf: [100]u8 = undefined;
     _ = try lvgl.Label.newFmt(flex, &buf, "GUI version: {any}", .{buildopts.semver}, .{});
+    const card = try lvgl.Card.new(flex, "SYSTEM", .{});
+    info.system = try lvgl.Label.new(card, "waiting for the first sample...", .{ .recolor = true });
+    const dbcard = try lvgl.Card.new(flex, "LIGHTNING DATABASE", .{});
+    info.compaction = try lvgl.Label.new(dbcard, "compacted while the screen is off, once grown.", .{ .recolor = true });
+    const backupcard = try lvgl.Card.new(flex, "CHANNEL BACKUP", .{});
+    info.backup = try lvgl.Label.new(backupcard, "exported once lnd is up and whenever channels change.", .{ .recolor = true });
+    const torcard = try lvgl.Card.new(flex, "TOR", .{});
+    info.tor = try lvgl.Label.new(torcard, "lightning waits for tor to bootstrap.", .{ .recolor = true });
+    const jobcard = try lvgl.Card.new(flex, "MAINTENANCE", .{});
+    info.job = try lvgl.Label.new(jobcard, "heavy jobs wait until the screen is off and the node is idle.", .{ .recolor = true });
+}
+
+/// frees memory of decoded images and rasterized fallback font glyphs, which
+/// are redone as drawn. must be called from the UI thread.
+pub fn dropCaches() void {
+    lvgl.dropImageCache();
+    nm_ui_drop_font_cache();
+}
+
+/// updates the info tab lightning database section with the compaction report.
+/// the tab must be built first; see nm_create_info_panel.
+pub fn updateInfoCompaction(rep: comm.Message.LndCompaction) !void {
+    const cmark = "#bbbbbb ";
+    var buf: [256]u8 = undefined;
+    const text = switch (rep.state) {
+        .running => try std.fmt.bufPrintZ(&buf, cmark ++ "compacting:# {:.1}, about {:.1} expected; lnd is restarting", .{
+            std.fmt.fmtIntSizeBin(rep.before),
+            std.fmt.fmtIntSizeBin(rep.estimate),
+        }),
+        .done => try std.fmt.bufPrintZ(&buf, cmark ++ "compacted:# {:.1} to {:.1}, lnd restarted in {d}s", .{
+            std.fmt.fmtIntSizeBin(rep.before),
+            std.fmt.fmtIntSizeBin(rep.after orelse rep.estimate),
+            rep.duration / std.time.ms_per_s,
+        }),
+        .failed => try std.fmt.bufPrintZ(&buf, cmark ++ "compaction:# " ++ symbol.Warning ++ " failed after {d}s", .{
+            rep.duration / std.time.ms_per_s,
+        }),
+    };
+    info.compaction.setText(text);
+}
+
+/// updates the info tab channel backup section with the export report.
+/// the tab must be built first; see nm_create_info_panel.
+pub fn updateInfoBackup(rep: comm.Message.ChannelBackup) !void {
+    const cmark = "#bbbbbb ";
+    var buf: [512]u8 = undefined;
+    const text = switch (rep.state) {
+        .written, .unchanged => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# {d} channels, {:.1}\n" ++ cmark ++ "file:# {s}", .{
+            if (rep.state == .written) "exported" else "up to date",
+            rep.channels,
+            std.fmt.fmtIntSizeBin(rep.size),
+            rep.path,
+        }),
+        .failed => try std.fmt.bufPrintZ(&buf, cmark ++ "export:# " ++ symbol.Warning ++ " failed to write {s}", .{rep.path}),
+    };
+    info.backup.setText(text);
+}
+
+/// updates the info tab tor section with bootstrap progress and circuit builds.
+/// the tab must be built first; see nm_create_info_panel.
+pub fn updateInfoTor(rep: comm.Message.TorStatus) !void {
+    const cmark = "#bbbbbb ";
+    var buf: [256]u8 = undefined;
+    const text = if (rep.progress < 100)
+        try std.fmt.bufPrintZ(&buf, cmark ++ "bootstrap:# {d}%, {s}\n" ++ cmark ++ "lightning:# waiting for tor", .{ rep.progress, rep.summary })
+    else if (rep.build_ms) |ms|
+        try std.fmt.bufPrintZ(&buf, cmark ++ "bootstrap:# done\n" ++ cmark ++ "circuits:# {d} built, {d} failed; the last in {d}.{d}s", .{ rep.circuits, rep.failed, ms / 1000, ms % 1000 / 100 })
+    else
+        try std.fmt.bufPrintZ(&buf, cmark ++ "bootstrap:# done", .{});
+    info.tor.setText(text);
+}
+
+/// updates the info tab maintenance section with the latest job state.
+/// the tab must be built first; see nm_create_info_panel.
+pub fn updateInfoJob(rep: comm.Message.JobProgress) !void {
+    const cmark = "#bbbbbb ";
+    var buf: [256]u8 = undefined;
+    const text = switch (rep.state) {
+        .queued => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# waiting for its turn", .{rep.name}),
+        .running => if (rep.progress) |pct|
+            try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# running, {d}% done", .{ rep.name, pct })
+        else
+            try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# running", .{rep.name}),
+        .done => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# done", .{rep.name}),
+        .failed => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# " ++ symbol.Warning ++ " failed", .{rep.name}),
+        .expired => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# skipped, the node was busy", .{rep.name}),
+    };
+    info.job.setText(text);
+}
+
+/// shows the outcome of a task nd ran on behalf of a request in the info
+/// tab maintenance section. the tab must be built first; see nm_create_info_panel.
+pub fn updateInfoTask(rep: comm.Message.TaskResult) !void {
+    const cmark = "#bbbbbb ";
+    var buf: [256]u8 = undefined;
+    const text = switch (rep.state) {
+        .done => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# done", .{rep.name}),
+        .failed => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# " ++ symbol.Warning ++ " failed: {s}", .{ rep.name, rep.err orelse "unknown error" }),
+        .cancelled => try std.fmt.bufPrintZ(&buf, cmark ++ "{s}:# cancelled", .{rep.name}),
+    };
+    info.job.setText(text);
+}
+
+/// updates the info tab system section with the report.
+/// the tab must be built first; see nm_create_info_panel.
+pub fn updateInfoPanel(rep: comm.Message.SystemReport) !void {
+    const cmark = "#bbbbbb "; // "label:" color, as in other tabs
+    var buf: [1024]u8 = undefined;
+    var fbs = std.io.fixedBufferStream(buf[0 .. buf.len - 1]); // room for the sentinel
+    const w = fbs.writer();
+    for (rep.services) |s| {
+        if (!s.running) {
+            try w.print(cmark ++ "{s}:# " ++ symbol.Warning ++ " not running\n", .{s.name});
+            continue;
+        }
+        try w.print(cmark ++ "{s}:# cpu {d}%, memory {:.1}", .{ s.name, s.cpu, std.fmt.fmtIntSizeBin(s.rss) });
+        if (s.read != null and s.write != null) {
+            try w.print(", disk {:.1}/s read, {:.1}/s written", .{ std.fmt.fmtIntSizeBin(s.read.?), std.fmt.fmtIntSizeBin(s.write.?) });
+        }
+        try w.writeByte('\n');
+    }
+    for (rep.disks) |d| {
+        try w.print(cmark ++ "{s}:# {:.1}/s read, {:.1}/s written, {d}% busy\n", .{
+            d.name,
+            std.fmt.fmtIntSizeBin(d.read),
+            std.fmt.fmtIntSizeBin(d.write),
+            d.busy,
+        });
+    }
+    for (rep.temps) |mc| {
+        try w.print(cmark ++ "cpu temperature:# {d:.1}C\n", .{@as(f32, @floatFromInt(mc)) / 1000});
+    }
+    if (rep.throttled) |bits| {
+        // current state in the low bits; the high ones are since boot.
+        const now = [_][]const u8{ "under-voltage", "frequency capped", "throttled", "soft temperature limit" };
+        try w.writeAll(cmark ++ "throttling:# ");
+        if (bits & 0xf == 0) {
+            try w.writeAll("none");
+        } else {
+            try w.writeAll(symbol.Warning);
+            for (now, 0..) |name, i| {
+                if (bits & (@as(u32, 1) << @intCast(i)) != 0) {
+                    try w.print(" {s}", .{name});
+                }
+            }
+        }
+    }
+    buf[fbs.pos] = 0;
+    info.system.setText(buf[0..fbs.pos :0]);
 }
@@ -1,5 +1,7 @@
 const std = @import("std");
+const comm = @import("../comm.zig");
 const lvgl = @import("lvgl.zig");
+const xfmt = @import("../xfmt.zig");
 
 const logger = std.log.scoped(.ui);
 
@@ -9,13 +11,14 @@ extern fn nm_keyboard_popoff() void;
 
 /// show keyboard on the default display and attach it to a UI input widget.
 /// the widget is any `lvgl.BaseObjMethods`.
-/// TODO: at the moment, the parent layer is always assumed to be the tabview,
-/// and it is resized to fit the keyboard. this won't work for a pop up screen like the `modal`.
+/// the keyboard overlays the tabview, whose visible tab is scrolled for the
+/// input to stay above the keyboard. inputs elsewhere, as in a pop up screen
+/// like the `modal`, are left where they are.
 pub fn keyboardOn(input: anytype) void {
     nm_keyboard_popon(input.lvobj);
 }
 
-/// hides the keyboard and restores the tabview dimensions.
+/// hides the keyboard and drops the scroll room it added to the tab.
 pub fn keyboardOff() void {
     nm_keyboard_popoff();
 }
@@ -56,25 +59,114 @@ pub fn topdrop(onoff: enum { show, remove }) void {
     }
 }
 
+/// top windows kept hidden once released, for reuse by acquireWindow.
+var window_pool: std.BoundedArray(struct { win: lvgl.Window, in_use: bool }, 2) = .{};
+
+/// returns a window on top of all other elements, empty but for its title:
+/// a free one from the pool if any, so that it shows up without building
+/// a window anew. give it back with releaseWindow instead of destroying.
+pub fn acquireWindow(title: [*:0]const u8) !lvgl.Window {
+    for (window_pool.slice()) |*p| {
+        if (!p.in_use) {
+            p.in_use = true;
+            p.win.setTitle(title);
+            p.win.moveForeground();
+            p.win.show();
+            return p.win;
+        }
+    }
+    const win = try lvgl.Window.newTop(60, title);
+    window_pool.append(.{ .win = win, .in_use = true }) catch {}; // unpooled
+    return win;
+}
+
+/// hides a window from acquireWindow for reuse and deletes its content,
+/// deferred. windows the pool had no room for are destroyed.
+pub fn releaseWindow(win: lvgl.Window) void {
+    for (window_pool.slice()) |*p| {
+        if (p.win.lvobj == win.lvobj) {
+            p.win.hide();
+            p.win.content().deleteChildrenDeferred();
+            p.in_use = false;
+            return;
+        }
+    }
+    win.destroyDeferred();
+}
+
 /// modal callback func type. it receives 0-based index of a button item
 /// provided as btns arg to modal.
 pub const ModalButtonCallbackFn = *const fn (index: usize) void;
 
+const max_modal_buttons = 4;
+
+/// a modal window with its message and buttons, kept hidden once closed
+/// and repopulated by the next modal call.
+const Modal = struct {
+    win: lvgl.Window,
+    msg: lvgl.Label,
+    btncont: lvgl.FlexLayout,
+    btns: std.BoundedArray(lvgl.TextButton, max_modal_buttons) = .{},
+    cb: ?ModalButtonCallbackFn = null, // null while closed
+};
+
+/// modals are referenced from LVGL event callbacks: never removed.
+var modals: std.BoundedArray(Modal, 2) = .{};
+
 /// shows a non-dismissible window using the whole screen real estate;
 /// for use in place of lv_msgbox_create.
 ///
-/// while all heap-alloc'ed resources are free'd automatically right before cb is called,
-/// the value of title, text and btns args must live at least as long as cb; they are
-/// memory-managed by the callers.
-///
-/// note: the cb callback must have @alignOf(ModalbuttonCallbackFn) alignment.
+/// title, text and btns are copied. the window is hidden and kept for the
+/// next modal right before cb is called.
 pub fn modal(title: [*:0]const u8, text: [*:0]const u8, btns: []const [*:0]const u8, cb: ModalButtonCallbackFn) !void {
+    if (btns.len == 0 or btns.len > max_modal_buttons) {
+        return error.ModalButtonsCount;
+    }
+    const m = try closedModal(title);
+    m.msg.setText(std.mem.span(text));
+    // leave 5% as an extra spacing.
+    const btnwidth = lvgl.sizePercent(@intCast(95 / btns.len));
+    while (m.btns.len < btns.len) {
+        const btn = try lvgl.TextButton.new(m.btncont, "");
+        btn.setFlag(.event_bubble);
+        btn.setFlag(.user1); // .user1 indicates actionable button in callback
+        btn.setUserdata(@ptrFromInt(m.btns.len)); // button index in callback
+        if (m.btns.len == 0) {
+            btn.addStyle(lvgl.nm_style_btn_red(), .{});
+        }
+        m.btns.appendAssumeCapacity(btn);
+    }
+    for (m.btns.constSlice(), 0..) |btn, i| {
+        if (i < btns.len) {
+            btn.label.setText(std.mem.span(btns[i]));
+            btn.setWidth(btnwidth);
+            btn.show();
+        } else {
+            btn.hide();
+        }
+    }
+    m.cb = cb;
+    m.win.moveForeground();
+    m.win.show();
+}
+
+/// returns a closed, hidden modal with the title, creating one if none.
+fn closedModal(title: [*:0]const u8) !*Modal {
+    for (modals.slice()) |*m| {
+        if (m.cb == null) {
+            m.win.setTitle(title);
+            return m;
+        }
+    }
+    if (modals.len == modals.capacity()) {
+        return error.TooManyModals;
+    }
     const win = try lvgl.Window.newTop(60, title);
     errdefer win.destroy(); // also deletes all children created below
-    win.setUserdata(cb);
+    win.hide();
 
     const wincont = win.content().flex(.column, .{ .cross = .center, .track = .center });
-    const msg = try lvgl.Label.new(wincont, text, .{ .pos = .center });
+    const msg = try lvgl.Label.new(wincont, "", .{ .pos = .center });
     msg.setWidth(lvgl.LvDisp.horiz() - 100);
     msg.flexGrow(1);
 
@@ -83,19 +175,10 @@ pub fn modal(title: [*:0]const u8, text: [*:0]const u8, btns: []const [*:0]const
     btncont.setWidth(lvgl.LvDisp.horiz() - 40);
     btncont.setHeightToContent();
 
-    // leave 5% as an extra spacing.
-    const btnwidth = lvgl.sizePercent(try std.math.divFloor(i16, 95, @as(u8, @truncate(btns.len))));
-    for (btns, 0..) |btext, i| {
-        const btn = try lvgl.TextButton.new(btncont, btext);
-        btn.setFlag(.event_bubble);
-        btn.setFlag(.user1); // .user1 indicates actionable button in callback
-        btn.setUserdata(@ptrFromInt(i)); // button index in callback
-        btn.setWidth(btnwidth);
-        if (i == 0) {
-            btn.addStyle(lvgl.nm_style_btn_red(), .{});
-        }
-    }
-    _ = btncont.on(.click, nm_modal_callback, win.lvobj);
+    modals.appendAssumeCapacity(.{ .win = win, .msg = msg, .btncont = btncont });
+    const m = &modals.slice()[modals.len - 1];
+    _ = btncont.on(.click, nm_modal_callback, m);
+    return m;
 }
 
 export fn nm_modal_callback(e: *lvgl.LvEvent) void {
@@ -106,9 +189,140 @@ export fn nm_modal_callback(e: *lvgl.LvEvent) void {
         }
 
         const btn_index = @intFromPtr(target.userdata());
-        const win = lvgl.Window{ .lvobj = @ptrCast(edata) };
-        const cb: ModalButtonCallbackFn = @alignCast(@ptrCast(win.userdata()));
-        win.destroy();
+        const m: *Modal = @ptrCast(@alignCast(edata));
+        const cb = m.cb orelse return;
+        m.win.hide();
+        m.cb = null;
         cb(btn_index);
     }
 }
+
+/// a line chart of history report series with a span selector and a legend
+/// showing the value range of the selected span. all lines share the y axis:
+/// values are scaled jointly so that the lowest point is at the bottom and
+/// the highest at the top.
+///
+/// series of all spans are retained from the last report, so that switching
+/// the span re-renders the chart right away with no need to wait for the next one.
+/// a TrendChart must not move in memory after init: the span selector refers to it.
+pub const TrendChart = struct {
+    pub const max_lines = 2;
+    const Kind = comm.Message.HistoryReport.Kind;
+    const Span = comm.Message.HistoryReport.Span;
+    const npoints = comm.Message.HistoryReport.points;
+    const nspans = @typeInfo(Span).Enum.fields.len;
+    /// chart y axis range, all values are scaled into.
+    const yrange = 1000;
+    const no_values = [_]?i64{null} ** npoints;
+    const no_points = [_]?lvgl.Coord{null} ** npoints;
+
+    chart: lvgl.Chart,
+    span: lvgl.Dropdown,
+    legend: lvgl.Label,
+    unit: []const u8,
+    lines: [max_lines]Kind,
+    series: [max_lines]*lvgl.Chart.Series,
+    nlines: usize,
+    data: [nspans][max_lines][npoints]?i64,
+
+    pub const Line = struct {
+        kind: Kind,
+        color: lvgl.Color,
+    };
+
+    pub const Opt = struct {
+        /// legend values suffix, like " sat".
+        unit: []const u8 = "",
+        height: lvgl.Coord = 100,
+    };
+
+    /// creates the chart widgets in parent, with no data until the first update.
+    pub fn init(self: *TrendChart, parent: anytype, lines: []const Line, opt: Opt) !void {
+        std.debug.assert(lines.len > 0 and lines.len <= max_lines);
+        const cont = try lvgl.FlexLayout.new(parent, .column, .{ .width = lvgl.sizePercent(100), .height = .content });
+        cont.setPad(5, .row, .{});
+        const top = try lvgl.FlexLayout.new(cont, .row, .{ .cross = .center, .width = lvgl.sizePercent(100), .height = .content });
+        top.clearFlag(.scrollable);
+        const legend = try lvgl.Label.new(top, "", .{ .recolor = true });
+        legend.flexGrow(1);
+        const span = try lvgl.Dropdown.newStatic(top, "1H\n24H\n30D\n1Y");
+        span.setWidth(110);
+        const chart = try lvgl.Chart.new(cont, npoints);
+        chart.setWidth(lvgl.sizePercent(100));
+        chart.setHeight(opt.height);
+        chart.setRange(0, yrange);
+
+        self.* = .{
+            .chart = chart,
+            .span = span,
+            .legend = legend,
+            .unit = opt.unit,
+            .lines = undefined,
+            .series = undefined,
+            .nlines = lines.len,
+            .data = [_][max_lines][npoints]?i64{[_][npoints]?i64{no_values} ** max_lines} ** nspans,
+        };
+        for (lines, 0..) |ln, i| {
+            self.lines[i] = ln.kind;
+            self.series[i] = try chart.addSeries(ln.color);
+        }
+        span.setSelected(@intFromEnum(Span.day));
+        _ = span.on(.value_changed, onSpanChanged, self);
+    }
+
+    /// retains the series of all spans from the report and re-renders the chart.
+    pub fn update(self: *TrendChart, rep: comm.Message.HistoryReport) void {
+        for (rep.ranges) |range| {
+            const dst = &self.data[@intFromEnum(range.span)];
+            for (self.lines[0..self.nlines], dst[0..self.nlines]) |kind, *vals| {
+                vals.* = no_values;
+                for (range.series) |ser| {
+                    if (ser.kind != kind) {
+                        continue;
+                    }
+                    // align to the most recent point if the lengths ever differ.
+                    const n = @min(ser.values.len, npoints);
+                    @memcpy(vals[npoints - n ..], ser.values[ser.values.len - n ..]);
+                }
+            }
+        }
+        self.render();
+    }
+
+    fn render(self: *TrendChart) void {
+        const sel = @min(self.span.getSelected(), nspans - 1);
+        const data = self.data[sel][0..self.nlines];
+        var min: i64 = std.math.maxInt(i64);
+        var max: i64 = std.math.minInt(i64);
+        for (data) |vals| {
+            for (vals) |v| {
+                min = @min(min, v orelse continue);
+                max = @max(max, v.?);
+            }
+        }
+        if (min > max) { // no data
+            self.legend.setText("");
+            for (self.series[0..self.nlines]) |ser| {
+                self.chart.setPoints(ser, &no_points);
+            }
+            return;
+        }
+        const width: i128 = @max(@as(i128, max) - min, 1);
+        for (data, self.series[0..self.nlines]) |vals, ser| {
+            var points: [npoints]?lvgl.Coord = undefined;
+            for (vals, &points) |v, *p| {
+                p.* = if (v) |x| @intCast(@divTrunc((@as(i128, x) - min) * yrange, width)) else null;
+            }
+            self.chart.setPoints(ser, &points);
+        }
+        var buf: [64]u8 = undefined;
+        self.legend.setTextFmt(&buf, "{} - {}{s}", .{ xfmt.imetric(min), xfmt.imetric(max), self.unit }) catch {
+            self.legend.setText("");
+        };
+    }
+
+    fn onSpanChanged(e: *lvgl.LvEvent) callconv(.C) void {
+        const self: *TrendChart = @alignCast(@ptrCast(e.userdata() orelse return));
+        self.render();
+    }
+};
@@ -18,6 +18,314 @@ pub fn umetric(val: u64) std.fmt.Formatter(formatMetricU) {
     return .{ .data = val };
 }
 
+/// returns the max length of the std.fmt.format output of format with
+/// args of type Args, a tuple. only integers, bools and fixed-size strings are
+/// bounded and supported, with a width but no positional or named args.
+pub fn maxLen(comptime format: []const u8, comptime Args: type) usize {
+    return comptime blk: {
+        const fields = std.meta.fields(Args);
+        var n: usize = 0;
+        var arg: usize = 0;
+        var i: usize = 0;
+        while (i < format.len) {
+            const ch = format[i];
+            if ((ch == '{' or ch == '}') and i + 1 < format.len and format[i + 1] == ch) {
+                n += 1; // escaped brace
+                i += 2;
+                continue;
+            }
+            if (ch != '{') {
+                n += 1;
+                i += 1;
+                continue;
+            }
+            const end = std.mem.indexOfScalarPos(u8, format, i, '}') orelse @compileError("missing closing }");
+            if (arg == fields.len) {
+                @compileError("too few arguments");
+            }
+            n += argMaxLen(fields[arg].type, format[i + 1 .. end]);
+            arg += 1;
+            i = end + 1;
+        }
+        if (arg != fields.len) {
+            @compileError("unused arguments");
+        }
+        break :blk n;
+    };
+}
+
+/// a parsed placeholder content: [specifier][:[[fill]alignment][width][.precision]].
+/// the precision is ignored.
+const Spec = struct {
+    conv: []const u8 = "",
+    fill: u8 = ' ',
+    alignment: std.fmt.Alignment = .right,
+    width: usize = 0,
+};
+
+fn parseSpec(comptime spec: []const u8) Spec {
+    const colon = std.mem.indexOfScalar(u8, spec, ':');
+    var s: Spec = .{ .conv = spec[0 .. colon orelse spec.len] };
+    if (s.conv.len > 0 and (s.conv[0] == '[' or std.ascii.isDigit(s.conv[0]))) {
+        @compileError("positional and named args are unsupported: {" ++ spec ++ "}");
+    }
+    if (colon) |c| {
+        var opt = spec[c + 1 ..];
+        if (opt.len > 1 and alignmentOf(opt[1]) != null) {
+            s.fill = opt[0];
+            s.alignment = alignmentOf(opt[1]).?;
+            opt = opt[2..];
+        } else if (opt.len > 0 and alignmentOf(opt[0]) != null) {
+            s.alignment = alignmentOf(opt[0]).?;
+            opt = opt[1..];
+        }
+        var j: usize = 0;
+        while (j < opt.len and std.ascii.isDigit(opt[j])) j += 1;
+        if (j > 0) {
+            s.width = std.fmt.parseUnsigned(usize, opt[0..j], 10) catch unreachable;
+        }
+    }
+    return s;
+}
+
+fn alignmentOf(ch: u8) ?std.fmt.Alignment {
+    return switch (ch) {
+        '<' => .left,
+        '^' => .center,
+        '>' => .right,
+        else => null,
+    };
+}
+
+fn intBase(comptime conv: []const u8) comptime_int {
+    if (std.mem.eql(u8, conv, "x") or std.mem.eql(u8, conv, "X")) return 16;
+    if (std.mem.eql(u8, conv, "b")) return 2;
+    if (std.mem.eql(u8, conv, "o")) return 8;
+    return 10;
+}
+
+/// spec is a placeholder content; see Spec.
+fn argMaxLen(comptime T: type, comptime spec: []const u8) usize {
+    const s = parseSpec(spec);
+    const len = switch (@typeInfo(T)) {
+        .Int => |info| blk: {
+            const base = intBase(s.conv);
+            comptime var v: comptime_int = if (info.signedness == .signed) -std.math.minInt(T) else std.math.maxInt(T);
+            var digits: usize = 1;
+            while (v >= base) : (digits += 1) v /= base;
+            break :blk digits + @intFromBool(info.signedness == .signed);
+        },
+        .Bool => "false".len,
+        .Array => |info| info.len,
+        .Pointer => |info| if (info.size == .One and @typeInfo(info.child) == .Array)
+            @typeInfo(info.child).Array.len
+        else
+            @compileError("unbounded argument type " ++ @typeName(T)),
+        else => @compileError("unbounded argument type " ++ @typeName(T)),
+    };
+    return @max(len, s.width);
+}
+
+/// a format compiled at comptime into straight-line code writing its literal
+/// parts and args into a fixed buffer, without the std.fmt writer and format
+/// options indirection at runtime. the output is that of std.fmt, for
+/// the formats and args maxLen supports; {s} is required for strings.
+pub fn Template(comptime format: []const u8, comptime Args: type) type {
+    return struct {
+        pub const max_len = maxLen(format, Args);
+        const segs = compile(format);
+
+        /// formats args into buf, returning the written part.
+        pub fn print(buf: *[max_len]u8, args: Args) []u8 {
+            var n: usize = 0;
+            inline for (segs) |seg| {
+                if (seg.arg) |i| {
+                    const v = args[i];
+                    switch (@typeInfo(@TypeOf(v))) {
+                        .Int => putInt(buf, &n, v, seg.spec),
+                        .Bool => putStr(buf, &n, if (v) "true" else "false", seg.spec),
+                        .Array => putStr(buf, &n, &v, comptime strSpec(seg.spec)),
+                        .Pointer => putStr(buf, &n, v, comptime strSpec(seg.spec)),
+                        else => unreachable, // rejected by maxLen
+                    }
+                } else {
+                    @memcpy(buf[n..][0..seg.lit.len], seg.lit);
+                    n += seg.lit.len;
+                }
+            }
+            return buf[0..n];
+        }
+    };
+}
+
+/// a Template part: either a literal or an arg placeholder.
+const Seg = struct {
+    lit: []const u8 = "",
+    arg: ?usize = null,
+    spec: Spec = .{},
+};
+
+fn compile(comptime format: []const u8) []const Seg {
+    comptime {
+        var segs: []const Seg = &.{};
+        var lit: []const u8 = "";
+        var arg: usize = 0;
+        var i: usize = 0;
+        while (i < format.len) {
+            const ch = format[i];
+            if ((ch == '{' or ch == '}') and i + 1 < format.len and format[i + 1] == ch) {
+                lit = lit ++ &[_]u8{ch}; // escaped brace
+                i += 2;
+                continue;
+            }
+            if (ch != '{') {
+                lit = lit ++ &[_]u8{ch};
+                i += 1;
+                continue;
+            }
+            const end = std.mem.indexOfScalarPos(u8, format, i, '}') orelse @compileError("missing closing }");
+            if (lit.len > 0) {
+                segs = segs ++ &[_]Seg{.{ .lit = lit }};
+                lit = "";
+            }
+            segs = segs ++ &[_]Seg{.{ .arg = arg, .spec = parseSpec(format[i + 1 .. end]) }};
+            arg += 1;
+            i = end + 1;
+        }
+        if (lit.len > 0) {
+            segs = segs ++ &[_]Seg{.{ .lit = lit }};
+        }
+        const out: [segs.len]Seg = segs[0..segs.len].*;
+        return &out;
+    }
+}
+
+inline fn putInt(buf: []u8, n: *usize, v: anytype, comptime spec: Spec) void {
+    const T = @TypeOf(v);
+    const base = intBase(spec.conv);
+    if (comptime base == 10 and !(spec.conv.len == 0 or std.mem.eql(u8, spec.conv, "d"))) {
+        @compileError("unsupported integer specifier {" ++ spec.conv ++ "}");
+    }
+    const digits = if (std.mem.eql(u8, spec.conv, "X")) "0123456789ABCDEF" else "0123456789abcdef";
+    // at least 8 bits for the base to fit.
+    var a: std.meta.Int(.unsigned, @max(@bitSizeOf(T), 8)) = @abs(v);
+    var tmp: [@bitSizeOf(T) + 2]u8 = undefined;
+    var i: usize = tmp.len;
+    while (true) {
+        i -= 1;
+        tmp[i] = digits[@intCast(a % base)];
+        a /= base;
+        if (a == 0) break;
+    }
+    if (@typeInfo(T).Int.signedness == .signed and v < 0) {
+        i -= 1;
+        tmp[i] = '-';
+    }
+    putStr(buf, n, tmp[i..], spec);
+}
+
+fn strSpec(comptime spec: Spec) Spec {
+    if (!std.mem.eql(u8, spec.conv, "s")) {
+        @compileError("strings require {s}, got {" ++ spec.conv ++ "}");
+    }
+    return spec;
+}
+
+inline fn putStr(buf: []u8, n: *usize, s: []const u8, comptime spec: Spec) void {
+    const pad = spec.width -| s.len;
+    const left = switch (spec.alignment) {
+        .left => 0,
+        .center => pad / 2,
+        .right => pad,
+    };
+    @memset(buf[n.*..][0..left], spec.fill);
+    n.* += left;
+    @memcpy(buf[n.*..][0..s.len], s);
+    n.* += s.len;
+    @memset(buf[n.*..][0 .. pad - left], spec.fill);
+    n.* += pad - left;
+}
+
+/// returns lowercase hex digits of bytes. 16 bytes are converted at a time
+/// with vector ops, which lower to SSE on x86 and NEON on arm.
+pub fn hexLower(comptime n: usize, bytes: [n]u8) [2 * n]u8 {
+    const V = @Vector(16, u8);
+    var out: [2 * n]u8 = undefined;
+    var i: usize = 0;
+    while (i + 16 <= n) : (i += 16) {
+        const v: V = bytes[i..][0..16].*;
+        const hi = hexDigits(v >> @as(@Vector(16, u3), @splat(4)));
+        const lo = hexDigits(v & @as(V, @splat(0xf)));
+        const pairs: @Vector(32, u8) = @shuffle(u8, hi, lo, interleave_mask);
+        out[2 * i ..][0..32].* = pairs;
+    }
+    const digits = "0123456789abcdef";
+    while (i < n) : (i += 1) {
+        out[2 * i] = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0xf];
+    }
+    return out;
+}
+
+/// parses 2*n hex digits into bytes, in either case, vectorized as hexLower.
+pub fn parseHex(comptime n: usize, s: *const [2 * n]u8) error{InvalidCharacter}![n]u8 {
+    const V = @Vector(16, u8);
+    var out: [n]u8 = undefined;
+    var i: usize = 0;
+    while (i + 16 <= n) : (i += 16) {
+        const pairs: @Vector(32, u8) = s[2 * i ..][0..32].*;
+        const hi = hexValues(@shuffle(u8, pairs, pairs, even_mask));
+        const lo = hexValues(@shuffle(u8, pairs, pairs, odd_mask));
+        if (@reduce(.Max, hi | lo) > 0xf) {
+            return error.InvalidCharacter;
+        }
+        out[i..][0..16].* = (hi << @as(@Vector(16, u3), @splat(4))) | lo;
+    }
+    while (i < n) : (i += 1) {
+        const hi = std.fmt.charToDigit(s[2 * i], 16) catch return error.InvalidCharacter;
+        const lo = std.fmt.charToDigit(s[2 * i + 1], 16) catch return error.InvalidCharacter;
+        out[i] = hi << 4 | lo;
+    }
+    return out;
+}
+
+/// nibbles to their lowercase hex digits.
+inline fn hexDigits(v: @Vector(16, u8)) @Vector(16, u8) {
+    const V = @Vector(16, u8);
+    const alpha = v >= @as(V, @splat(10));
+    return v + @select(u8, alpha, @as(V, @splat('a' - 10)), @as(V, @splat('0')));
+}
+
+/// hex digits to their values; 0xff for an invalid character.
+inline fn hexValues(c: @Vector(16, u8)) @Vector(16, u8) {
+    const V = @Vector(16, u8);
+    const digit = c -% @as(V, @splat('0'));
+    const alpha = (c | @as(V, @splat(0x20))) -% @as(V, @splat('a'));
+    const invalid: V = @splat(0xff);
+    const letter = @select(u8, alpha < @as(V, @splat(6)), alpha +% @as(V, @splat(10)), invalid);
+    return @select(u8, digit < @as(V, @splat(10)), digit, letter);
+}
+
+/// picks a[0], b[0], a[1], b[1], ...
+const interleave_mask: @Vector(32, i32) = blk: {
+    var m: [32]i32 = undefined;
+    for (0..16) |k| {
+        m[2 * k] = k;
+        m[2 * k + 1] = ~@as(i32, k);
+    }
+    break :blk m;
+};
+const even_mask: @Vector(16, i32) = blk: {
+    var m: [16]i32 = undefined;
+    for (&m, 0..) |*it, k| it.* = 2 * k;
+    break :blk m;
+};
+const odd_mask: @Vector(16, i32) = blk: {
+    var m: [16]i32 = undefined;
+    for (&m, 0..) |*it, k| it.* = 2 * k + 1;
+    break :blk m;
+};
+
 fn formatUnix(sec: u64, comptime fmt: []const u8, opts: std.fmt.FormatOptions, w: anytype) !void {
     _ = fmt; // unused
     _ = opts;
@@ -30,14 +338,16 @@ fn formatUnix(sec: u64, comptime fmt: []const u8, opts: std.fmt.FormatOptions, w
     const daysec = epoch.getDaySeconds();
     const yearday = epoch.getEpochDay().calculateYearDay();
     const monthday = yearday.calculateMonthDay();
-    return std.fmt.format(w, "{d}-{d:0>2}-{d:0>2} {d:0>2}:{d:0>2}:{d:0>2} UTC", .{
+    const T = Template("{d}-{d:0>2}-{d:0>2} {d:0>2}:{d:0>2}:{d:0>2} UTC", struct { u16, u4, u5, u5, u6, u6 });
+    var buf: [T.max_len]u8 = undefined;
+    return w.writeAll(T.print(&buf, .{
         yearday.year,
         monthday.month.numeric(),
         monthday.day_index + 1,
         daysec.getHoursIntoDay(),
         daysec.getMinutesIntoHour(),
         daysec.getSecondsIntoMinute(),
-    });
+    }));
 }
 
 fn formatMetricI(value: i64, comptime fmt: []const u8, opts: std.fmt.FormatOptions, w: anytype) !void {
@@ -120,3 +430,65 @@ test "umetric" {
         try t.expectEqualStrings(item.str, fbs.getWritten());
     }
 }
+
+test "maxLen" {
+    const t = std.testing;
+
+    try t.expectEqual(@as(usize, 20), comptime maxLen("{d}", struct { u64 }));
+    try t.expectEqual(@as(usize, 4), comptime maxLen("{d}", struct { i8 }));
+    try t.expectEqual(@as(usize, 6), comptime maxLen("{x:0>6}", struct { u16 }));
+    try t.expectEqual(@as(usize, 11), comptime maxLen("{{{}}} {s}", struct { bool, *const [3]u8 }));
+    try t.expectEqual(@as(usize, 65), comptime maxLen("{s}\n{s}", struct { *const [32]u8, *const [32]u8 }));
+
+    const Args = struct { u16, i32 };
+    var buf: [maxLen("in {d}, out {d}", Args)]u8 = undefined;
+    const s = try std.fmt.bufPrint(&buf, "in {d}, out {d}", Args{ std.math.maxInt(u16), std.math.minInt(i32) });
+    try t.expectEqual(buf.len, s.len);
+}
+
+test "Template" {
+    const t = std.testing;
+
+    const cases = .{
+        .{ "{d}", .{@as(u64, 0)} },
+        .{ "{d}", .{@as(u64, std.math.maxInt(u64))} },
+        .{ "{d}", .{@as(i8, std.math.minInt(i8))} },
+        .{ "in {d}, out {d}", .{ @as(u16, 8), @as(i32, -125) } },
+        .{ "{x:0>6}", .{@as(u16, 0xbeef)} },
+        .{ "{X} {b} {o}", .{ @as(u8, 0xab), @as(u8, 5), @as(u8, 8) } },
+        .{ "[{d:<5}] [{d:^5}] [{d:5}] [{d:*>5}]", .{ @as(u8, 7), @as(u8, 42), @as(i8, -3), @as(u8, 1) } },
+        .{ "{{{}}} {s}", .{ true, "abc" } },
+        .{ "{s:>6}|{s:<6}|", .{ "ab", "cd" } },
+        .{ "{s}\n{s}", .{ "a" ** 32, "b" ** 32 } },
+    };
+    inline for (cases) |c| {
+        const Args = @TypeOf(c[1]);
+        const T = Template(c[0], Args);
+        var buf: [T.max_len]u8 = undefined;
+        var want: [T.max_len]u8 = undefined;
+        try t.expectEqualStrings(try std.fmt.bufPrint(&want, c[0], c[1]), T.print(&buf, c[1]));
+    }
+}
+
+test "hexLower and parseHex" {
+    const t = std.testing;
+
+    var bytes: [33]u8 = undefined;
+    for (&bytes, 0..) |*b, i| b.* = @intCast(i * 7 + 3);
+    const hex = hexLower(33, bytes);
+    try t.expectEqualStrings(&std.fmt.bytesToHex(bytes, .lower), &hex);
+    try t.expectEqual(bytes, try parseHex(33, &hex));
+
+    var upper: [66]u8 = undefined;
+    _ = std.ascii.upperString(&upper, &hex);
+    try t.expectEqual(bytes, try parseHex(33, &upper));
+
+    for ([_]usize{ 0, 31, 40, 65 }) |i| {
+        for ("g/:@`G ") |ch| {
+            var bad = hex;
+            bad[i] = ch;
+            try t.expectError(error.InvalidCharacter, parseHex(33, &bad));
+        }
+    }
+    try t.expectEqual([_]u8{ 0x00, 0xff }, try parseHex(2, "00ff"));
+}